@@ -28,6 +28,8 @@ def allocate_char(chars_used, name):
 
 funcdefs = []
 matchers = []
+# match string of each matcher, used to build the primary opcode lookup table
+matchstrs = []
 
 d = yaml.safe_load(open('grammar.yaml'))
 
@@ -103,6 +105,7 @@ for k, v in d.items():
                 f'{indentation}{char*size} = {name} ({bitinfo}{arginfo})')
 
     annotation = '\n'.join(annotations)
+    matchstrs.append(matchstr)
     matchers.append(f'// {description}\n/*\n{annotation}\n*/\n{PREFIX}{matchstr}{SUFFIX}')
 
 def replace_file(file, pat, replace):
@@ -144,6 +147,41 @@ def update_matcher():
     num_str = ' '+str(num)
     replace_file('../../vita3k/shader/src/usse_translator_entry.cpp', entry_pat, r'\1'+num_str+r'\2'+out+r'    \3')
 
+# Number of bits of the primary opcode (the highest bits of an instruction)
+PRIMARY_OPCODE_BITS = 5
+# Marks the end of an entry of the lookup table
+END_OF_ENTRY = 0xFF
+
+def build_primary_opcode_table():
+    # For each primary opcode, list all the matchers which can match an instruction starting with it,
+    # in the same order as the matcher table so that the first matching one is still chosen
+    table = []
+    for opcode in range(1 << PRIMARY_OPCODE_BITS):
+        opcode_bits = format(opcode, f'0{PRIMARY_OPCODE_BITS}b')
+        entry = []
+        for index, matchstr in enumerate(matchstrs):
+            prefix = matchstr[:PRIMARY_OPCODE_BITS]
+            if all(m not in '01' or m == b for m, b in zip(prefix, opcode_bits)):
+                entry.append(index)
+        table.append(entry)
+
+    assert len(matchstrs) < END_OF_ENTRY, 'Too many matchers for the lookup table'
+    width = max(len(entry) for entry in table) + 1
+    return table, width
+
+def update_lookup_table():
+    entry_pat = r'(static constexpr std::array<std::array<uint8_t,) \d+(>, \d+> primary_opcode_table = {{)[^;]+(}};)'
+    table, width = build_primary_opcode_table()
+    lines = []
+    for opcode, entry in enumerate(table):
+        values = entry + [END_OF_ENTRY] * (width - len(entry))
+        values_str = ', '.join('0xFF' if v == END_OF_ENTRY else str(v) for v in values)
+        opcode_bits = format(opcode, f'0{PRIMARY_OPCODE_BITS}b')
+        lines.append(f'        {{ {values_str} }}, // {opcode_bits}')
+    out = '\n' + '\n'.join(lines) + '\n    '
+    replace_file('../../vita3k/shader/src/usse_translator_entry.cpp', entry_pat,
+        r'\1 ' + str(width) + r'\2' + out + r'\3')
+
 def update_visitor():
     # update headers
     header_pat = r'(// Instructions start)[^/]+(// Instructions end)'
@@ -166,4 +204,5 @@ def update_visitor():
         replace_file(file, [src_pat(func[0]) for func in funcdefs], [r'\1\n    '+func[1]+r'\2' for func in funcdefs])
 
 update_matcher()
+update_lookup_table()
 update_visitor()
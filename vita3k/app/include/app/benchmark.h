@@ -0,0 +1,49 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/frame_stats.h>
+#include <util/fs.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct EmuEnvState;
+
+// Frames measured by a benchmark run, from the first frame displayed by the app
+struct Benchmark {
+    std::vector<FrameSample> samples;
+    std::chrono::steady_clock::time_point first_frame;
+    std::chrono::steady_clock::time_point last_frame;
+    FrameCounters first_counters = {};
+    FrameCounters last_counters = {};
+    uint64_t first_audio_callback_ns = 0;
+    // frame count of the emulated environment at the last sample
+    size_t last_frame_count = 0;
+};
+
+namespace app {
+
+// disables the vblank pacing, starts measuring the host times and loads the input script
+bool start_benchmark(EmuEnvState &emuenv);
+// called by the main loop, adds a sample for each frame displayed since the last call
+void sample_benchmark(EmuEnvState &emuenv, Benchmark &benchmark);
+bool write_benchmark_report(EmuEnvState &emuenv, const Benchmark &benchmark, const fs::path &path);
+
+} // namespace app
@@ -0,0 +1,37 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#pragma once
+
+#include <util/fs.h>
+
+struct EmuEnvState;
+
+namespace app {
+
+// A checkpoint only holds the guest memory and the contexts of the guest threads, not the kernel, IO, audio,
+// NGS or GXM states, so it is not a save state: it can only be loaded back in the session it was made in,
+// and only while no guest thread is waiting in the kernel.
+
+// checkpoint of the running title in the cache folder
+fs::path get_checkpoint_path(const EmuEnvState &emuenv);
+// write the guest memory and the contexts of the guest threads, paused meanwhile
+bool save_checkpoint(EmuEnvState &emuenv, const fs::path &path);
+// replace the guest memory and the contexts of the guest threads by the ones of the checkpoint
+// the running session must have the same threads as when the checkpoint was made, all of them running or dormant
+bool load_checkpoint(EmuEnvState &emuenv, const fs::path &path);
+
+} // namespace app
@@ -48,5 +48,7 @@ void error_dialog(const std::string &message, SDL_Window *window = nullptr);
 
 void set_window_title(EmuEnvState &emuenv);
 void calculate_fps(EmuEnvState &emuenv);
+// called for each frame displayed, keeps the frames longer than the stutter threshold
+void sample_stutters(EmuEnvState &emuenv);
 
 } // namespace app
@@ -0,0 +1,44 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#pragma once
+
+#include <util/fs.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+struct EmuEnvState;
+
+// Settings known to improve the performance of a title without breaking it
+struct TitleProfile {
+    // mask of CPUUnsafeOptimization
+    uint32_t cpu_unsafe_optimizations = 0;
+    std::optional<bool> disable_surface_sync;
+    std::optional<bool> hashless_texture_cache;
+    std::optional<bool> texture_write_tracking;
+};
+
+namespace app {
+
+// looks up the title in the bundled profile database, the entries of the user database replace the bundled ones
+std::optional<TitleProfile> get_title_profile(const fs::path &shared_path, const fs::path &config_path, const std::string &title_id);
+// applies the cpu and surface sync settings of the profile of the running title, called before the kernel is initialized
+// the texture cache policies are left to the caller as they belong to the global config
+std::optional<TitleProfile> apply_title_profile(EmuEnvState &emuenv);
+
+} // namespace app
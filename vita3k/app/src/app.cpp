@@ -17,15 +17,23 @@
 
 #include <app/functions.h>
 
+#include <audio/state.h>
 #include <config/state.h>
 #include <config/version.h>
 #include <display/state.h>
 #include <emuenv/state.h>
 #include <io/state.h>
+#include <kernel/state.h>
+#include <mem/state.h>
+#include <renderer/state.h>
+#include <util/frame_stats.h>
 #include <util/log.h>
+#include <util/stutter.h>
 
 #include <SDL.h>
 
+#include <chrono>
+
 namespace app {
 
 void error_dialog(const std::string &message, SDL_Window *window) {
@@ -34,8 +42,65 @@ void error_dialog(const std::string &message, SDL_Window *window) {
     }
 }
 
+static void sample_frame_stats(EmuEnvState &emuenv) {
+    const bool detailed = emuenv.cfg.performance_overlay && emuenv.cfg.performance_overlay_detail == DETAILED;
+    if (detailed != emuenv.kernel.measure_host_time.load(std::memory_order_relaxed)) {
+        // the times are only measured in the detailed mode, the next frame starts a new history
+        emuenv.kernel.measure_host_time = detailed;
+        reset_frame_stats(emuenv.frame_stats, true);
+    }
+    if (!detailed)
+        return;
+
+    // the frames are not counted while the game is paused
+    if (emuenv.kernel.is_threads_paused()) {
+        reset_frame_stats(emuenv.frame_stats, false);
+        return;
+    }
+
+    const FrameCounters counters = {
+        .guest_cpu_ns = emuenv.kernel.guest_cpu_ns.load(std::memory_order_relaxed),
+        .hle_ns = emuenv.kernel.hle_ns.load(std::memory_order_relaxed),
+        .batches_ns = emuenv.renderer->process_batches_ns.load(std::memory_order_relaxed),
+        .present_ns = emuenv.renderer->present_wait_ns.load(std::memory_order_relaxed),
+    };
+    add_frame_sample(emuenv.frame_stats, std::chrono::steady_clock::now(), counters, emuenv.renderer->gpu_frame_time);
+}
+
+static StutterCounters get_stutter_counters(EmuEnvState &emuenv) {
+    const renderer::State &renderer = *emuenv.renderer;
+    return {
+        .shader_translations = renderer.shader_translation_count.load(std::memory_order_relaxed),
+        .pipeline_creations = renderer.pipelines_count_compiled.load(std::memory_order_relaxed),
+        .texture_uploads = renderer.texture_uploads.count.load(std::memory_order_relaxed),
+        .texture_upload_bytes = renderer.texture_uploads.bytes.load(std::memory_order_relaxed),
+        .surface_syncs = renderer.surface_sync_count.load(std::memory_order_relaxed),
+        .protect_faults = emuenv.mem.protect_fault_count.load(std::memory_order_relaxed),
+        .write_track_faults = emuenv.mem.write_track_fault_count.load(std::memory_order_relaxed),
+        .module_loads = emuenv.kernel.module_load_profile.module_count.load(std::memory_order_relaxed),
+        .translated_blocks = emuenv.kernel.jit_profile.translated_block_count.load(std::memory_order_relaxed),
+    };
+}
+
+void sample_stutters(EmuEnvState &emuenv) {
+    if (emuenv.cfg.stutter_threshold_ms <= 0)
+        return;
+
+    // the frames are not counted while the game is paused
+    if (emuenv.kernel.is_threads_paused()) {
+        reset_stutter_frame(emuenv.stutter_detector);
+        return;
+    }
+
+    add_stutter_frame(emuenv.stutter_detector, std::chrono::steady_clock::now(), get_stutter_counters(emuenv),
+        static_cast<float>(emuenv.cfg.stutter_threshold_ms), emuenv.renderer->gpu_frame_time.load(std::memory_order_relaxed));
+}
+
 static const uint32_t frames_size = 20;
 void calculate_fps(EmuEnvState &emuenv) {
+    sample_frame_stats(emuenv);
+    sample_stutters(emuenv);
+
     const uint32_t sdl_ticks_now = SDL_GetTicks();
     const uint32_t ms = sdl_ticks_now - emuenv.sdl_ticks;
 
@@ -49,6 +114,13 @@ void calculate_fps(EmuEnvState &emuenv) {
         emuenv.frame_count = 0;
         set_window_title(emuenv);
 
+        const uint64_t protect_fault_count = emuenv.mem.protect_fault_count.load(std::memory_order_relaxed);
+        const uint64_t write_track_fault_count = emuenv.mem.write_track_fault_count.load(std::memory_order_relaxed);
+        emuenv.protect_faults_per_frame = static_cast<uint32_t>((protect_fault_count - emuenv.last_protect_fault_count + frame_count / 2) / frame_count);
+        emuenv.write_track_faults_per_frame = static_cast<uint32_t>((write_track_fault_count - emuenv.last_write_track_fault_count + frame_count / 2) / frame_count);
+        emuenv.last_protect_fault_count = protect_fault_count;
+        emuenv.last_write_track_fault_count = write_track_fault_count;
+
         // Set FPS Statistics
         emuenv.fps_values[emuenv.current_fps_offset] = float(emuenv.fps);
         emuenv.current_fps_offset = (emuenv.current_fps_offset + 1) % frames_size;
@@ -58,6 +130,9 @@ void calculate_fps(EmuEnvState &emuenv) {
         emuenv.avg_fps = avg_fps / frames_size;
         emuenv.min_fps = uint32_t(*std::min_element(emuenv.fps_values, std::next(emuenv.fps_values, frames_size)));
         emuenv.max_fps = uint32_t(*std::max_element(emuenv.fps_values, std::next(emuenv.fps_values, frames_size)));
+
+        if (emuenv.kernel.measure_host_time)
+            update_frame_stats(emuenv.frame_stats, emuenv.audio.callback_ns, emuenv.audio.callback_audio_ns);
     }
 }
 
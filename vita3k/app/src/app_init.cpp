@@ -16,8 +16,10 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <app/functions.h>
+#include <app/title_profile.h>
 
 #include <audio/state.h>
+#include <codec/recorder.h>
 #include <config/functions.h>
 #include <config/state.h>
 #include <config/version.h>
@@ -25,6 +27,7 @@
 #include <emuenv/state.h>
 #include <gui/imgui_impl_sdl.h>
 #include <io/functions.h>
+#include <io/io_trace.h>
 #include <kernel/state.h>
 #include <ngs/state.h>
 #include <renderer/state.h>
@@ -32,10 +35,14 @@
 #include <nids/functions.h>
 #include <renderer/functions.h>
 #include <rtc/rtc.h>
+#include <util/boot_profiler.h>
 #include <util/fs.h>
 #include <util/lock_and_find.h>
+#include <util/lock_profiler.h>
 #include <util/log.h>
 #include <util/string_utils.h>
+#include <util/stutter.h>
+#include <util/trace_log.h>
 
 #if USE_DISCORD
 #include <app/discord.h>
@@ -55,18 +62,24 @@ void update_viewport(EmuEnvState &state) {
     int w = 0;
     int h = 0;
 
-    switch (state.renderer->current_backend) {
-    case renderer::Backend::OpenGL:
-        SDL_GL_GetDrawableSize(state.window.get(), &w, &h);
-        break;
-
-    case renderer::Backend::Vulkan:
-        SDL_Vulkan_GetDrawableSize(state.window.get(), &w, &h);
-        break;
-
-    default:
-        LOG_ERROR("Unimplemented backend render: {}.", static_cast<int>(state.renderer->current_backend));
-        break;
+    // without a window, the frames are rendered at the resolution of the console
+    if (!state.window) {
+        w = DEFAULT_RES_WIDTH;
+        h = DEFAULT_RES_HEIGHT;
+    } else {
+        switch (state.renderer->current_backend) {
+        case renderer::Backend::OpenGL:
+            SDL_GL_GetDrawableSize(state.window.get(), &w, &h);
+            break;
+
+        case renderer::Backend::Vulkan:
+            SDL_Vulkan_GetDrawableSize(state.window.get(), &w, &h);
+            break;
+
+        default:
+            LOG_ERROR("Unimplemented backend render: {}.", static_cast<int>(state.renderer->current_backend));
+            break;
+        }
     }
 
     state.drawable_size.x = w;
@@ -174,8 +187,18 @@ void init_paths(Root &root_paths) {
 }
 
 bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
+    const BootScope boot_scope(state.boot_profiler, "app::init", "app::init");
     state.cfg = std::move(cfg);
 
+    // 48 bytes per record, 3 MiB per thread
+    constexpr size_t TRACE_LOG_RECORDS_PER_THREAD = 1 << 16;
+    if (!state.cfg.trace_log_path.empty())
+        start_trace_log(TRACE_LOG_RECORDS_PER_THREAD);
+    if (!state.cfg.lock_report_path.empty())
+        start_lock_profiler();
+    if (!state.cfg.io_trace_path.empty())
+        start_io_trace();
+
     state.base_path = root_paths.get_base_path_string();
     state.default_path = root_paths.get_pref_path_string();
     state.log_path = string_utils::utf_to_wide(root_paths.get_log_path_string());
@@ -216,54 +239,60 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
 #endif
     }
 
-    int window_type = 0;
-    switch (state.backend_renderer) {
-    case renderer::Backend::OpenGL:
-        window_type = SDL_WINDOW_OPENGL;
-        break;
-
-    case renderer::Backend::Vulkan:
-        window_type = SDL_WINDOW_VULKAN;
-        break;
-
-    default:
-        LOG_ERROR("Unimplemented backend render: {}.", state.cfg.backend_renderer);
-        break;
-    }
+    if (state.cfg.headless) {
+        // nothing is presented without a window, only the Vulkan renderer can run without one
+        LOG_INFO_IF(state.backend_renderer != renderer::Backend::Vulkan, "Headless mode uses the Vulkan renderer");
+        state.backend_renderer = renderer::Backend::Vulkan;
+    } else {
+        int window_type = 0;
+        switch (state.backend_renderer) {
+        case renderer::Backend::OpenGL:
+            window_type = SDL_WINDOW_OPENGL;
+            break;
+
+        case renderer::Backend::Vulkan:
+            window_type = SDL_WINDOW_VULKAN;
+            break;
+
+        default:
+            LOG_ERROR("Unimplemented backend render: {}.", state.cfg.backend_renderer);
+            break;
+        }
 
-    if (state.cfg.fullscreen) {
-        state.display.fullscreen = true;
-        window_type |= SDL_WINDOW_FULLSCREEN_DESKTOP;
-    }
+        if (state.cfg.fullscreen) {
+            state.display.fullscreen = true;
+            window_type |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+        }
 #if defined(WIN32) || defined(__linux__)
-    const auto isSteamDeck = []() {
+        const auto isSteamDeck = []() {
 #ifdef __linux__
-        std::ifstream file("/etc/os-release");
-        if (file.is_open()) {
-            std::string line;
-            while (std::getline(file, line)) {
-                if (line.find("VARIANT_ID=steamdeck") != std::string::npos)
-                    return true;
+            std::ifstream file("/etc/os-release");
+            if (file.is_open()) {
+                std::string line;
+                while (std::getline(file, line)) {
+                    if (line.find("VARIANT_ID=steamdeck") != std::string::npos)
+                        return true;
+                }
             }
-        }
 #endif
-        return false;
-    };
+            return false;
+        };
 
-    if (!isSteamDeck()) {
-        float ddpi, hdpi, vdpi;
-        SDL_GetDisplayDPI(0, &ddpi, &hdpi, &vdpi);
-        window_type |= SDL_WINDOW_ALLOW_HIGHDPI;
-        state.dpi_scale = ddpi / 96;
-    }
+        if (!isSteamDeck()) {
+            float ddpi, hdpi, vdpi;
+            SDL_GetDisplayDPI(0, &ddpi, &hdpi, &vdpi);
+            window_type |= SDL_WINDOW_ALLOW_HIGHDPI;
+            state.dpi_scale = ddpi / 96;
+        }
 #endif
-    state.res_width_dpi_scale = static_cast<uint32_t>(DEFAULT_RES_WIDTH * state.dpi_scale);
-    state.res_height_dpi_scale = static_cast<uint32_t>(DEFAULT_RES_HEIGHT * state.dpi_scale);
-    state.window = WindowPtr(SDL_CreateWindow(window_title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, state.res_width_dpi_scale, state.res_height_dpi_scale, window_type | SDL_WINDOW_RESIZABLE), SDL_DestroyWindow);
+        state.res_width_dpi_scale = static_cast<uint32_t>(DEFAULT_RES_WIDTH * state.dpi_scale);
+        state.res_height_dpi_scale = static_cast<uint32_t>(DEFAULT_RES_HEIGHT * state.dpi_scale);
+        state.window = WindowPtr(SDL_CreateWindow(window_title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, state.res_width_dpi_scale, state.res_height_dpi_scale, window_type | SDL_WINDOW_RESIZABLE), SDL_DestroyWindow);
 
-    if (!state.window) {
-        LOG_ERROR("SDL failed to create window!");
-        return false;
+        if (!state.window) {
+            LOG_ERROR("SDL failed to create window!");
+            return false;
+        }
     }
 
     // initialize the renderer first because we need to know if we need a page table
@@ -302,10 +331,57 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
     return true;
 }
 
+static void start_recording(EmuEnvState &state) {
+    const fs::path record_path = fs::path(string_utils::utf_to_wide(state.cfg.record_path));
+
+    // the audio is copied from the mixed output of the host callback
+    AudioState &audio = state.audio;
+    GameplayRecorder::AudioSource audio_source;
+    if (audio.start_capture()) {
+        audio_source = [&audio](int16_t *samples, size_t count) {
+            return audio.capture_ring.read(count, [&](const int16_t *span, size_t span_count) {
+                samples = std::copy_n(span, span_count, samples);
+            });
+        };
+    } else {
+        LOG_WARN("The {} audio backend does not mix the ports itself, the gameplay is recorded without audio.", state.audio.audio_backend);
+    }
+
+    if (!state.recorder.start(record_path, audio.spec.freq, std::move(audio_source))) {
+        audio.stop_capture();
+        return;
+    }
+
+    GameplayRecorder &recorder = state.recorder;
+    const bool started = state.renderer->start_recording([&recorder](const renderer::RecordedFrame &frame) {
+        recorder.push_frame(frame.nv12 ? RecordedPixelFormat::NV12 : RecordedPixelFormat::RGBA, frame.width, frame.height, frame.data, frame.pitch, frame.timestamp_ns);
+    });
+    if (!started) {
+        LOG_ERROR("The gameplay can only be recorded with the Vulkan renderer and a window.");
+        recorder.stop();
+        audio.stop_capture();
+    }
+}
+
 bool late_init(EmuEnvState &state) {
-    state.renderer->late_init(state.cfg, state.app_path);
+    const BootScope boot_scope(state.boot_profiler, "late_init", "late_init");
+    const auto profile = apply_title_profile(state);
+    if (profile) {
+        // the texture cache policies of the profile only last for this run, they must not end up in the saved config
+        const bool hashless_texture_cache = state.cfg.hashless_texture_cache;
+        const bool texture_write_tracking = state.cfg.texture_write_tracking;
+        state.cfg.hashless_texture_cache = profile->hashless_texture_cache.value_or(hashless_texture_cache);
+        state.cfg.texture_write_tracking = profile->texture_write_tracking.value_or(texture_write_tracking);
+        state.renderer->late_init(state.cfg, state.app_path);
+        state.cfg.hashless_texture_cache = hashless_texture_cache;
+        state.cfg.texture_write_tracking = texture_write_tracking;
+    } else {
+        state.renderer->late_init(state.cfg, state.app_path);
+    }
+    if (!state.cfg.gxm_capture_path.empty())
+        renderer::capture::init(*state.renderer, fs::path(string_utils::utf_to_wide(state.cfg.gxm_capture_path)), state.cfg.gxm_capture_start_frame, state.cfg.gxm_capture_frames);
 
-    if (!init(state.mem, state.renderer->need_page_table)) {
+    if (!init(state.mem, state.renderer->need_page_table, state.cfg.huge_pages)) {
         LOG_ERROR("Failed to initialize memory for emulator state!");
         return false;
     }
@@ -314,13 +390,16 @@ bool late_init(EmuEnvState &state) {
         LOG_CRITICAL("Unicorn backend is not supported with a page table");
 
     const ResumeAudioThread resume_thread = [&state](SceUID thread_id) {
-        const auto thread = lock_and_find(thread_id, state.kernel.threads, state.kernel.mutex);
+        const auto thread = state.kernel.get_thread(thread_id);
         const std::lock_guard<std::mutex> lock(thread->mutex);
         if (thread->status == ThreadStatus::wait) {
             thread->update_status(ThreadStatus::run);
         }
     };
-    if (!state.audio.init(resume_thread, state.cfg.audio_backend)) {
+    state.audio.sdl_latency_ms = std::max(state.cfg.sdl_audio_latency, 0);
+    state.audio.cubeb_latency_ms = std::max(state.cfg.cubeb_audio_latency, 0);
+    state.audio.time_stretch = state.cfg.audio_time_stretch;
+    if (!state.audio.init(resume_thread, state.cfg.headless ? "Null" : state.cfg.audio_backend)) {
         LOG_WARN("Failed to initialize audio! Audio will not work.");
     }
 
@@ -329,11 +408,15 @@ bool late_init(EmuEnvState &state) {
         return false;
     }
 
+    if (!state.cfg.record_path.empty())
+        start_recording(state);
+
     return true;
 }
 
 void destroy(EmuEnvState &emuenv, ImGui_State *imgui) {
-    ImGui_ImplSdl_Shutdown(imgui);
+    if (imgui)
+        ImGui_ImplSdl_Shutdown(imgui);
 
 #ifdef USE_DISCORD
     discordrpc::shutdown();
@@ -342,6 +425,42 @@ void destroy(EmuEnvState &emuenv, ImGui_State *imgui) {
     if (emuenv.cfg.gdbstub)
         server_close(emuenv);
 
+    if (emuenv.stutter_detector.frame_count > 0)
+        dump_stutter_events(emuenv.stutter_detector);
+
+    if (emuenv.recorder.is_recording()) {
+        emuenv.renderer->stop_recording();
+        emuenv.recorder.stop();
+        emuenv.audio.stop_capture();
+    }
+
+    if (is_trace_log_enabled()) {
+        stop_trace_log();
+        const fs::path trace_log_path = fs::path(string_utils::utf_to_wide(emuenv.cfg.trace_log_path));
+        if (save_trace_log(trace_log_path))
+            LOG_INFO("Trace log saved to {}", trace_log_path.string());
+        else
+            LOG_ERROR("Failed to save the trace log to {}", trace_log_path.string());
+    }
+
+    if (is_lock_profiler_enabled()) {
+        stop_lock_profiler();
+        const fs::path lock_report_path = fs::path(string_utils::utf_to_wide(emuenv.cfg.lock_report_path));
+        if (save_lock_report(lock_report_path))
+            LOG_INFO("Lock report saved to {}", lock_report_path.string());
+        else
+            LOG_ERROR("Failed to save the lock report to {}", lock_report_path.string());
+    }
+
+    if (is_io_trace_enabled()) {
+        stop_io_trace();
+        const fs::path io_trace_path = fs::path(string_utils::utf_to_wide(emuenv.cfg.io_trace_path));
+        if (save_io_trace(io_trace_path, emuenv.io))
+            LOG_INFO("IO trace saved to {}", io_trace_path.string());
+        else
+            LOG_ERROR("Failed to save the IO trace to {}", io_trace_path.string());
+    }
+
     // There may be changes that made in the GUI, so we should save, again
     if (emuenv.cfg.overwrite_config)
         config::serialize_config(emuenv.cfg, emuenv.cfg.config_path);
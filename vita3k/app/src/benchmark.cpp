@@ -0,0 +1,194 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <app/benchmark.h>
+
+#include <audio/state.h>
+#include <config/state.h>
+#include <config/version.h>
+#include <ctrl/state.h>
+#include <display/state.h>
+#include <emuenv/state.h>
+#include <io/state.h>
+#include <kernel/state.h>
+#include <packages/sfo.h>
+#include <renderer/state.h>
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <numeric>
+
+#ifdef WIN32
+#include <Windows.h>
+
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// peak resident memory of the process, in bytes
+static uint64_t get_peak_memory() {
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    // in kilobytes on Linux
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static FrameCounters get_frame_counters(EmuEnvState &emuenv) {
+    return {
+        .guest_cpu_ns = emuenv.kernel.guest_cpu_ns.load(std::memory_order_relaxed),
+        .hle_ns = emuenv.kernel.hle_ns.load(std::memory_order_relaxed),
+        .batches_ns = emuenv.renderer->process_batches_ns.load(std::memory_order_relaxed),
+        .present_ns = emuenv.renderer->present_wait_ns.load(std::memory_order_relaxed),
+    };
+}
+
+static float get_delta_ms(uint64_t now_ns, uint64_t last_ns) {
+    return now_ns >= last_ns ? static_cast<float>(now_ns - last_ns) / 1e6f : 0.f;
+}
+
+namespace app {
+
+bool start_benchmark(EmuEnvState &emuenv) {
+    if (!emuenv.cfg.benchmark_input_path.empty()) {
+        auto script = std::make_unique<InputScript>();
+        if (!load_input_script(*script, fs::path(string_utils::utf_to_wide(emuenv.cfg.benchmark_input_path))))
+            return false;
+        const std::lock_guard<std::mutex> guard(emuenv.ctrl.mutex);
+        emuenv.ctrl.input_script = std::move(script);
+    }
+
+    emuenv.display.unpaced = true;
+    emuenv.kernel.measure_host_time = true;
+
+    return true;
+}
+
+void sample_benchmark(EmuEnvState &emuenv, Benchmark &benchmark) {
+    const size_t frame_count = emuenv.frame_count;
+    if (frame_count <= benchmark.last_frame_count)
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+    const FrameCounters counters = get_frame_counters(emuenv);
+    if (benchmark.first_frame == std::chrono::steady_clock::time_point()) {
+        // the measure starts at the first frame, the boot is not part of it
+        benchmark.first_frame = now;
+        benchmark.first_counters = counters;
+        benchmark.first_audio_callback_ns = emuenv.audio.callback_ns.load(std::memory_order_relaxed);
+    } else {
+        // the main loop can miss frames, the time is split between them
+        const size_t frames = frame_count - benchmark.last_frame_count;
+        const float scale = 1.f / frames;
+        const FrameSample sample = {
+            .frame_time = std::chrono::duration<float, std::milli>(now - benchmark.last_frame).count() * scale,
+            .guest_cpu_time = get_delta_ms(counters.guest_cpu_ns, benchmark.last_counters.guest_cpu_ns) * scale,
+            .hle_time = get_delta_ms(counters.hle_ns, benchmark.last_counters.hle_ns) * scale,
+            .batches_time = get_delta_ms(counters.batches_ns, benchmark.last_counters.batches_ns) * scale,
+            .gpu_time = emuenv.renderer->gpu_frame_time.load(std::memory_order_relaxed),
+            .present_time = get_delta_ms(counters.present_ns, benchmark.last_counters.present_ns) * scale,
+        };
+        benchmark.samples.insert(benchmark.samples.end(), frames, sample);
+    }
+
+    benchmark.last_frame = now;
+    benchmark.last_counters = counters;
+    benchmark.last_frame_count = frame_count;
+}
+
+bool write_benchmark_report(EmuEnvState &emuenv, const Benchmark &benchmark, const fs::path &path) {
+    const size_t frame_count = benchmark.samples.size();
+    const double duration_ms = std::chrono::duration<double, std::milli>(benchmark.last_frame - benchmark.first_frame).count();
+
+    std::vector<float> frame_times(frame_count);
+    std::transform(benchmark.samples.begin(), benchmark.samples.end(), frame_times.begin(), [](const FrameSample &sample) { return sample.frame_time; });
+    std::sort(frame_times.begin(), frame_times.end());
+    const auto percentile = [&](double p) {
+        if (frame_times.empty())
+            return 0.f;
+        return frame_times[std::min(static_cast<size_t>(p * frame_count), frame_count - 1)];
+    };
+    const auto average = [&](float FrameSample::*time) {
+        if (frame_count == 0)
+            return 0.0;
+        return std::accumulate(benchmark.samples.begin(), benchmark.samples.end(), 0.0, [&](double sum, const FrameSample &sample) { return sum + sample.*time; }) / frame_count;
+    };
+    const uint64_t audio_ns = emuenv.audio.callback_ns.load(std::memory_order_relaxed) - benchmark.first_audio_callback_ns;
+
+    fs::ofstream report(path, std::ios::out);
+    if (!report.is_open()) {
+        LOG_ERROR("Could not write the benchmark report to {}", path.string());
+        return false;
+    }
+
+    report << "{\n";
+    report << fmt::format("  \"emulator\": \"{}\",\n", string_utils::escape_json(window_title));
+    report << fmt::format("  \"title_id\": \"{}\",\n", string_utils::escape_json(emuenv.io.title_id));
+    report << fmt::format("  \"title\": \"{}\",\n", string_utils::escape_json(emuenv.current_app_title));
+    report << fmt::format("  \"app_version\": \"{}\",\n", string_utils::escape_json(emuenv.app_info.app_version));
+    report << fmt::format("  \"renderer\": \"{}\",\n", string_utils::escape_json(emuenv.cfg.backend_renderer));
+    report << fmt::format("  \"input_script\": {},\n", emuenv.ctrl.input_script ? "true" : "false");
+    report << fmt::format("  \"frames\": {},\n", frame_count);
+    report << fmt::format("  \"duration_ms\": {:.3f},\n", duration_ms);
+    report << fmt::format("  \"average_fps\": {:.3f},\n", duration_ms > 0 ? frame_count * 1000.0 / duration_ms : 0.0);
+    report << "  \"frame_time_ms\": {\n";
+    report << fmt::format("    \"average\": {:.3f},\n", average(&FrameSample::frame_time));
+    report << fmt::format("    \"min\": {:.3f},\n", frame_times.empty() ? 0.f : frame_times.front());
+    report << fmt::format("    \"p50\": {:.3f},\n", percentile(0.5));
+    report << fmt::format("    \"p90\": {:.3f},\n", percentile(0.9));
+    report << fmt::format("    \"p99\": {:.3f},\n", percentile(0.99));
+    report << fmt::format("    \"p99.9\": {:.3f},\n", percentile(0.999));
+    report << fmt::format("    \"max\": {:.3f}\n", frame_times.empty() ? 0.f : frame_times.back());
+    report << "  },\n";
+    // the cpu times are summed over all the host threads doing this work, per frame
+    report << "  \"time_per_frame_ms\": {\n";
+    report << fmt::format("    \"guest_cpu\": {:.3f},\n", average(&FrameSample::guest_cpu_time));
+    report << fmt::format("    \"hle\": {:.3f},\n", average(&FrameSample::hle_time));
+    report << fmt::format("    \"gpu_commands\": {:.3f},\n", average(&FrameSample::batches_time));
+    report << fmt::format("    \"present_wait\": {:.3f},\n", average(&FrameSample::present_time));
+    report << fmt::format("    \"audio_mixing\": {:.3f},\n", frame_count > 0 ? audio_ns / 1e6 / frame_count : 0.0);
+    report << fmt::format("    \"gpu\": {:.3f}\n", average(&FrameSample::gpu_time));
+    report << "  },\n";
+    report << fmt::format("  \"shaders_compiled\": {},\n", emuenv.renderer->shaders_count_compiled);
+    report << fmt::format("  \"pipelines_compiled\": {},\n", emuenv.renderer->pipelines_count_compiled.load());
+    report << "  \"peak_memory_mib\": {\n";
+    report << fmt::format("    \"host\": {:.1f},\n", get_peak_memory() / 1048576.0);
+    report << fmt::format("    \"textures\": {:.1f}\n", emuenv.renderer->texture_memory_peak.load() / 1048576.0);
+    report << "  }\n";
+    report << "}\n";
+
+    LOG_INFO("Benchmark: {} frames, {:.2f} fps, frame time average {:.2f} ms, 99th percentile {:.2f} ms, report saved to {}",
+        frame_count, duration_ms > 0 ? frame_count * 1000.0 / duration_ms : 0.0, average(&FrameSample::frame_time), percentile(0.99), path.string());
+    return true;
+}
+
+} // namespace app
@@ -0,0 +1,254 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <app/checkpoint.h>
+
+#include <cpu/functions.h>
+#include <emuenv/state.h>
+#include <io/state.h>
+#include <kernel/state.h>
+#include <mem/functions.h>
+#include <util/log.h>
+
+#include <fmt/format.h>
+
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace app {
+
+constexpr uint32_t CHECKPOINT_MAGIC = 0x4B433356; // V3CK
+constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+struct CheckpointThread {
+    SceUID id = 0;
+    std::string name;
+    // status of the thread before it was paused
+    ThreadStatus status = ThreadStatus::dormant;
+    CPUContext context;
+};
+
+// pause the guest threads until the end of the scope and wait until the running ones are stopped
+struct ThreadPauseScope {
+    KernelState &kernel;
+    const bool was_paused;
+
+    explicit ThreadPauseScope(KernelState &kernel)
+        : kernel(kernel)
+        , was_paused(kernel.is_threads_paused()) {
+        if (!was_paused)
+            kernel.pause_threads();
+
+        for (const auto &[id, thread] : get_threads()) {
+            std::unique_lock<std::mutex> lock(thread->mutex);
+            thread->status_cond.wait(lock, [&]() { return thread->status != ThreadStatus::run; });
+        }
+    }
+
+    ~ThreadPauseScope() {
+        if (!was_paused)
+            kernel.resume_threads();
+    }
+
+    ThreadStatePtrs get_threads() const {
+        const ProfiledLockGuard lock(kernel.mutex);
+        return kernel.threads;
+    }
+
+    // the state of a thread waiting in the kernel (sync objects, callbacks, delays) is not in the checkpoint,
+    // only the threads running guest code or dormant can be restored from their context
+    const ThreadState *find_waiting_thread() const {
+        for (const auto &[id, thread] : get_threads()) {
+            const ThreadStatus status = kernel.get_paused_status(*thread);
+            if (status != ThreadStatus::run && status != ThreadStatus::dormant)
+                return thread.get();
+        }
+        return nullptr;
+    }
+};
+
+// the host side of the kernel objects is not in the checkpoint, it can only be loaded in the session it was made in
+static uint64_t get_session_id() {
+    static const uint64_t session_id = [] {
+        std::random_device device;
+        return (static_cast<uint64_t>(device()) << 32) | device();
+    }();
+    return session_id;
+}
+
+template <typename T>
+static void write_value(std::ostream &stream, const T &value) {
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_value(std::istream &stream, T &value) {
+    return static_cast<bool>(stream.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+static void write_string(std::ostream &stream, const std::string &value) {
+    write_value(stream, static_cast<uint32_t>(value.size()));
+    stream.write(value.data(), value.size());
+}
+
+static bool read_string(std::istream &stream, std::string &value) {
+    uint32_t size = 0;
+    if (!read_value(stream, size) || size > KiB(4))
+        return false;
+    value.resize(size);
+    return static_cast<bool>(stream.read(value.data(), size));
+}
+
+static void write_thread(std::ostream &stream, const CheckpointThread &thread) {
+    write_value(stream, thread.id);
+    write_string(stream, thread.name);
+    write_value(stream, thread.status);
+    write_value(stream, thread.context.cpu_registers);
+    write_value(stream, thread.context.fpu_registers);
+    write_value(stream, thread.context.cpsr);
+    write_value(stream, thread.context.fpscr);
+}
+
+static bool read_thread(std::istream &stream, CheckpointThread &thread) {
+    return read_value(stream, thread.id) && read_string(stream, thread.name) && read_value(stream, thread.status)
+        && read_value(stream, thread.context.cpu_registers) && read_value(stream, thread.context.fpu_registers)
+        && read_value(stream, thread.context.cpsr) && read_value(stream, thread.context.fpscr);
+}
+
+fs::path get_checkpoint_path(const EmuEnvState &emuenv) {
+    return emuenv.cache_path / "checkpoints" / fmt::format("{}.bin", emuenv.io.title_id);
+}
+
+bool save_checkpoint(EmuEnvState &emuenv, const fs::path &path) {
+    if (emuenv.io.title_id.empty())
+        return false;
+
+    const ThreadPauseScope pause(emuenv.kernel);
+    if (const ThreadState *thread = pause.find_waiting_thread()) {
+        LOG_ERROR("Cannot make a checkpoint while the thread {} is waiting in the kernel", thread->name);
+        return false;
+    }
+
+    // written next to the checkpoint first, so a failure does not lose the previous one
+    const fs::path temp_path = fs::path(path).replace_extension(".tmp");
+    fs::create_directories(path.parent_path());
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        if (!file) {
+            LOG_ERROR("Failed to create the checkpoint {}", temp_path.string());
+            return false;
+        }
+
+        write_value(file, CHECKPOINT_MAGIC);
+        write_value(file, CHECKPOINT_VERSION);
+        write_string(file, emuenv.io.title_id);
+        write_value(file, get_session_id());
+
+        const auto threads = pause.get_threads();
+        write_value(file, static_cast<uint32_t>(threads.size()));
+        for (const auto &[id, thread] : threads)
+            write_thread(file, { id, thread->name, emuenv.kernel.get_paused_status(*thread), save_context(*thread->cpu) });
+
+        if (!save_memory_snapshot(emuenv.mem, file)) {
+            LOG_ERROR("Failed to write the checkpoint {}", temp_path.string());
+            file.close();
+            fs::remove(temp_path);
+            return false;
+        }
+    }
+
+    fs::rename(temp_path, path);
+    LOG_INFO("Checkpoint saved to {}", path.string());
+    return true;
+}
+
+bool load_checkpoint(EmuEnvState &emuenv, const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        LOG_ERROR("Checkpoint {} not found", path.string());
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    std::string title_id;
+    uint64_t session_id = 0;
+    uint32_t thread_count = 0;
+    if (!read_value(file, magic) || magic != CHECKPOINT_MAGIC || !read_value(file, version)) {
+        LOG_ERROR("Invalid checkpoint {}", path.string());
+        return false;
+    }
+    if (version != CHECKPOINT_VERSION) {
+        LOG_ERROR("Checkpoint {} has the version {}, only the version {} is supported", path.string(), version, CHECKPOINT_VERSION);
+        return false;
+    }
+    if (!read_string(file, title_id) || !read_value(file, session_id) || !read_value(file, thread_count)) {
+        LOG_ERROR("Invalid checkpoint {}", path.string());
+        return false;
+    }
+    if (title_id != emuenv.io.title_id) {
+        LOG_ERROR("Checkpoint {} was made with {}, the running title is {}", path.string(), title_id, emuenv.io.title_id);
+        return false;
+    }
+    if (session_id != get_session_id()) {
+        LOG_ERROR("Checkpoint {} was made in another session, it can only be loaded in the session it was made in", path.string());
+        return false;
+    }
+
+    std::vector<CheckpointThread> checkpoint_threads(thread_count);
+    for (CheckpointThread &thread : checkpoint_threads) {
+        if (!read_thread(file, thread)) {
+            LOG_ERROR("Invalid checkpoint {}", path.string());
+            return false;
+        }
+    }
+
+    const ThreadPauseScope pause(emuenv.kernel);
+    if (const ThreadState *thread = pause.find_waiting_thread()) {
+        LOG_ERROR("Cannot load the checkpoint {} while the thread {} is waiting in the kernel", path.string(), thread->name);
+        return false;
+    }
+
+    // the kernel objects are not in the checkpoint, the threads must be the ones which were running when it was made
+    const auto threads = pause.get_threads();
+    bool same_threads = threads.size() == checkpoint_threads.size();
+    for (const CheckpointThread &checkpoint_thread : checkpoint_threads) {
+        const auto it = threads.find(checkpoint_thread.id);
+        same_threads = same_threads && it != threads.end() && it->second->name == checkpoint_thread.name
+            && emuenv.kernel.get_paused_status(*it->second) == checkpoint_thread.status;
+    }
+    if (!same_threads) {
+        LOG_ERROR("Checkpoint {} was made with other threads than the ones running", path.string());
+        return false;
+    }
+
+    if (!load_memory_snapshot(emuenv.mem, file)) {
+        LOG_CRITICAL("Failed to load the memory of the checkpoint {}, the guest memory is left in an undefined state", path.string());
+        return false;
+    }
+
+    for (const CheckpointThread &checkpoint_thread : checkpoint_threads)
+        load_context(*threads.at(checkpoint_thread.id)->cpu, checkpoint_thread.context);
+
+    // the code may have changed with the memory
+    emuenv.kernel.invalidate_jit_cache(0, GiB(4));
+
+    LOG_INFO("Checkpoint loaded from {}", path.string());
+    return true;
+}
+
+} // namespace app
@@ -0,0 +1,109 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <app/title_profile.h>
+
+#include <config/state.h>
+#include <cpu/common.h>
+#include <emuenv/state.h>
+#include <io/state.h>
+#include <kernel/state.h>
+#include <renderer/state.h>
+#include <util/log.h>
+
+#include <pugixml.hpp>
+
+#include <array>
+#include <utility>
+
+namespace app {
+
+static const std::array<std::pair<const char *, CPUUnsafeOptimization>, 4> cpu_unsafe_attributes = { {
+    { "unsafe-unfuse-fma", CPU_UNSAFE_UNFUSE_FMA },
+    { "unsafe-reduced-error-fp", CPU_UNSAFE_REDUCED_ERROR_FP },
+    { "unsafe-inaccurate-nan", CPU_UNSAFE_INACCURATE_NAN },
+    { "unsafe-ignore-global-monitor", CPU_UNSAFE_IGNORE_GLOBAL_MONITOR },
+} };
+
+static std::optional<bool> get_optional_bool(const pugi::xml_node &node, const char *name) {
+    const auto attribute = node.attribute(name);
+    if (attribute.empty())
+        return std::nullopt;
+    return attribute.as_bool();
+}
+
+static std::optional<TitleProfile> load_title_profile(const fs::path &path, const std::string &title_id) {
+    if (!fs::exists(path))
+        return std::nullopt;
+
+    pugi::xml_document doc;
+    const pugi::xml_parse_result result = doc.load_file(path.c_str());
+    if (!result) {
+        LOG_ERROR("Title profile database {} could not be loaded: {}", path.string(), result.description());
+        return std::nullopt;
+    }
+
+    const auto profile_child = doc.child("title-profiles").find_child_by_attribute("profile", "title-id", title_id.c_str());
+    if (profile_child.empty())
+        return std::nullopt;
+
+    TitleProfile profile;
+    const auto cpu_child = profile_child.child("cpu");
+    for (const auto &[name, optimization] : cpu_unsafe_attributes) {
+        if (cpu_child.attribute(name).as_bool())
+            profile.cpu_unsafe_optimizations |= optimization;
+    }
+
+    const auto gpu_child = profile_child.child("gpu");
+    profile.disable_surface_sync = get_optional_bool(gpu_child, "disable-surface-sync");
+    profile.hashless_texture_cache = get_optional_bool(gpu_child, "hashless-texture-cache");
+    profile.texture_write_tracking = get_optional_bool(gpu_child, "texture-write-tracking");
+
+    return profile;
+}
+
+std::optional<TitleProfile> get_title_profile(const fs::path &shared_path, const fs::path &config_path, const std::string &title_id) {
+    if (title_id.empty())
+        return std::nullopt;
+
+    if (auto profile = load_title_profile(config_path / "config" / "title-profiles.xml", title_id))
+        return profile;
+
+    return load_title_profile(shared_path / "data" / "config" / "title-profiles.xml", title_id);
+}
+
+std::optional<TitleProfile> apply_title_profile(EmuEnvState &emuenv) {
+    emuenv.kernel.cpu_unsafe_optimizations = 0;
+
+    const auto profile = get_title_profile(emuenv.shared_path, emuenv.config_path, emuenv.io.title_id);
+    if (!profile)
+        return std::nullopt;
+
+    LOG_INFO("Applying the performance profile of {}", emuenv.io.title_id);
+    emuenv.kernel.cpu_unsafe_optimizations = profile->cpu_unsafe_optimizations;
+    LOG_INFO_IF(profile->cpu_unsafe_optimizations && !emuenv.cfg.current_config.cpu_opt, "The unsafe CPU optimizations of the profile need the CPU optimizations enabled");
+
+    // a setting chosen in the custom config of the app is kept over the profile
+    const bool has_custom_config = fs::exists(emuenv.config_path / "config" / fmt::format("config_{}.xml", emuenv.io.app_path));
+    if (profile->disable_surface_sync && !has_custom_config) {
+        emuenv.cfg.current_config.disable_surface_sync = *profile->disable_surface_sync;
+        emuenv.renderer->set_surface_sync_state(emuenv.cfg.current_config.disable_surface_sync);
+    }
+
+    return profile;
+}
+
+} // namespace app
@@ -32,13 +32,15 @@ struct CubebAudioOutPort : AudioOutPort {
     cubeb_stream *out_stream = nullptr;
     cubeb_stream_params spec;
     // sync variables used to wait for the buffer to be ready
-    std::mutex mutex;
-    std::condition_variable cond_var;
+    ProfiledMutex mutex{ "CubebAudioOutPort::mutex" };
+    std::condition_variable_any cond_var;
     // buffer filled with audio data to pass to cubeb
     std::vector<AudioBuffer> audio_buffers;
     // position of the next audio buffer to put audio
     int next_audio_buffer = 0;
     int nb_buffers_ready = 0;
+    // incremented by the cubeb callback when it runs out of data
+    std::atomic<uint32_t> *underrun_count = nullptr;
 
     // use the destructor to destroy the cubeb stream
     ~CubebAudioOutPort();
@@ -0,0 +1,45 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include "../state.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Mixes the ports at the pace of a real device but drops the output, used when no audio device is wanted
+class NullAudioAdapter : public AudioAdapter {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool exiting = false;
+    std::atomic<bool> paused = false;
+    std::vector<uint8_t> buffer;
+
+    void run();
+
+public:
+    NullAudioAdapter(AudioState &audio_state);
+    ~NullAudioAdapter();
+
+    bool init() override;
+    void switch_state(const bool pause) override;
+};
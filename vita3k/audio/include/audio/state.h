@@ -17,10 +17,15 @@
 
 #pragma once
 
+#include <audio/time_stretch.h>
+#include <util/lock_profiler.h>
 #include <util/types.h>
 
 #include <SDL_audio.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
@@ -33,12 +38,50 @@
 typedef std::shared_ptr<SDL_AudioStream> AudioStreamPtr;
 typedef std::function<void(SceUID)> ResumeAudioThread;
 
+// Lock-free ring of s16 samples, written by the thread outputting to the port and read by the host audio callback.
+class AudioRing {
+public:
+    // the capacity is rounded up to a power of two
+    void init(size_t min_capacity);
+    bool is_initialized() const {
+        return buffer != nullptr;
+    }
+    size_t available() const {
+        return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire);
+    }
+    // returns the number of samples written, less than count if the ring is full
+    size_t write(const int16_t *samples, size_t count);
+
+    // calls read_span on the up to 2 contiguous parts of the first count samples then frees them
+    template <typename F>
+    size_t read(size_t count, F read_span) {
+        const size_t read_at = read_pos.load(std::memory_order_relaxed);
+        count = std::min(count, write_pos.load(std::memory_order_acquire) - read_at);
+        const size_t offset = read_at & mask;
+        const size_t first_count = std::min(count, mask + 1 - offset);
+        if (first_count > 0)
+            read_span(&buffer[offset], first_count);
+        if (count > first_count)
+            read_span(&buffer[0], count - first_count);
+        read_pos.store(read_at + count, std::memory_order_release);
+
+        return count;
+    }
+
+private:
+    std::unique_ptr<int16_t[]> buffer;
+    size_t mask = 0;
+    // both only increase, the producer owns write_pos and the consumer read_pos
+    std::atomic<size_t> read_pos = 0;
+    std::atomic<size_t> write_pos = 0;
+};
+
 struct AudioOutPort {
     // Channel range from 0 - 32768
     int left_channel_volume = SCE_AUDIO_VOLUME_0DB;
     int right_channel_volume = SCE_AUDIO_VOLUME_0DB;
     // Volume range from 0 to 1
-    float volume = 1.0f;
+    std::atomic<float> volume = 1.0f;
     // length of the buffer for each call
     int len_bytes = 0;
 
@@ -48,11 +91,22 @@ struct AudioOutPort {
     int freq = 0;
     int mode = 0;
 
-    std::mutex mutex;
-    // stream to get the data
+    ProfiledMutex mutex{ "AudioOutPort::mutex" };
+    // converts the data to the host format, only used by the thread outputting to the port
     AudioStreamPtr stream;
+    std::vector<int16_t> convert_buffer;
+    // converted samples waiting for the host callback
+    AudioRing ring;
+    // stretches the audio when the guest is too slow to output it in time, only used by the thread outputting
+    std::unique_ptr<TimeStretcher> stretcher;
+    std::vector<int16_t> stretch_buffer;
+    std::chrono::steady_clock::time_point last_output;
+    // rate at which the guest outputs the audio, 1 at full speed
+    float speed = 1.0f;
     // thread currently waiting for the audio to be processed
-    SceUID thread = -1;
+    std::atomic<SceUID> thread = -1;
+    // the port had enough data for the last host callback, only used by the callback
+    bool playing = false;
 };
 
 typedef std::shared_ptr<AudioOutPort> AudioOutPortPtr;
@@ -62,6 +116,12 @@ struct AudioInPort {
     SDL_AudioDeviceID id;
     bool running = false;
     int len_bytes = 0;
+    // samples returned by each input
+    int grain = 0;
+    // captured samples waiting for the thread inputting, written by the host capture callback
+    AudioRing ring;
+    // thread waiting for a full grain
+    std::atomic<SceUID> thread = -1;
 };
 
 struct AudioSpec {
@@ -78,8 +138,10 @@ struct AudioState;
 // abstract class that need to be overloaded with an audio implementation
 class AudioAdapter {
 private:
-    // buffer used to mix audio
-    std::vector<uint8_t> temp_buffer;
+    // buffer used to mix audio, in the s16 range
+    std::vector<float> mix_buffer;
+    // ports mixed by the last callback, kept while the list is modified
+    std::vector<AudioOutPortPtr> callback_ports;
 
 protected:
     AudioState &state;
@@ -115,10 +177,46 @@ struct AudioState {
     ResumeAudioThread resume_thread;
     std::string audio_backend;
 
+    // host latency targets in milliseconds, 0 for the lowest latency allowed by the backend
+    int sdl_latency_ms = 40;
+    int cubeb_latency_ms = 0;
+    // stretch the audio of the ports opened when the emulation runs below full speed
+    bool time_stretch = false;
+
+    // host callbacks buffered in the ports before the thread outputting waits
+    // grows when the callback runs out of data, shrinks back to the latency target once it stops
+    static constexpr uint32_t MAX_BUFFERED_CALLBACKS = 16;
+    std::atomic<uint32_t> buffered_callbacks = 3;
+    uint32_t min_buffered_callbacks = 3;
+    uint32_t callbacks_without_underrun = 0;
+
+    // telemetry shown in the performance overlay
+    std::atomic<uint32_t> underrun_count = 0;
+    std::atomic<uint32_t> latency_ms = 0;
+    // host time spent mixing in the host callback and duration of the audio it mixed, in nanoseconds
+    std::atomic<uint64_t> callback_ns = 0;
+    std::atomic<uint64_t> callback_audio_ns = 0;
+
+    // copy of the mixed output of the host callback while the gameplay is recorded, only filled by the adapters mixing in it
+    // the callback is the producer, the ring is allocated once by start_capture and kept after stop_capture
+    AudioRing capture_ring;
+    std::atomic<bool> capture_enabled = false;
+
     bool init(const ResumeAudioThread &resume_thread, const std::string &adapter_name);
     void set_backend(const std::string &adapter_name);
     AudioOutPortPtr open_port(int nb_channels, int freq, int nb_sample);
     void audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer);
+    // the host capture device is opened by the in port itself, whatever the adapter
+    bool open_in_port(int grain, int freq);
+    void close_in_port();
+    // wait for a full grain of captured samples then copy it to buffer
+    void audio_input(ThreadState &thread, void *buffer);
     void set_volume(AudioOutPort &out_port, float volume);
     void switch_state(const bool pause);
+    // called by the adapters mixing in the host callback once the host buffer size is known
+    void init_buffering(int target_samples);
+    void update_buffering(bool underrun);
+    // start copying the mixed output to capture_ring, return false if the adapter does not mix the ports itself
+    bool start_capture();
+    void stop_capture();
 };
@@ -0,0 +1,53 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// WSOLA time-stretching of interleaved stereo s16 samples, keeps the pitch while making the audio last longer.
+// The segments are overlapped with the offset matching best the end of the previous segment.
+class TimeStretcher {
+public:
+    // length in frames of the overlapped segments
+    static constexpr size_t SEGMENT_FRAMES = 1024;
+    static constexpr size_t HOP_FRAMES = SEGMENT_FRAMES / 2;
+    // offsets tried around the nominal position
+    static constexpr size_t SEEK_FRAMES = 256;
+
+    TimeStretcher();
+
+    // ratio is the duration of the output over the duration of the input, 1 to let it through unchanged
+    // the audio can only be made longer, a lower ratio is handled as 1
+    // the output is delayed by about a segment
+    void process(const int16_t *samples, size_t frame_count, float ratio, std::vector<int16_t> &output);
+
+private:
+    size_t find_best_offset(size_t first, size_t last, size_t target) const;
+
+    std::vector<float> fade_in;
+    // interleaved stereo frames not consumed yet
+    std::vector<float> input;
+    // second half of the last segment, windowed
+    std::vector<float> overlap;
+    // nominal position of the next segment in input, in frames
+    double position = 0.0;
+    size_t previous = 0;
+    bool started = false;
+};
@@ -20,6 +20,7 @@
 #include <tracy/Tracy.hpp>
 
 #include <audio/impl/cubeb_audio.h>
+#include <audio/impl/null_audio.h>
 #include <audio/impl/sdl_audio.h>
 
 #include <kernel/thread/thread_state.h>
@@ -27,58 +28,110 @@
 #include <util/log.h>
 
 #include <algorithm>
-#include <cassert>
-#include <cstring>
+#include <bit>
+#include <chrono>
 
-static void mix_out_port(uint8_t *stream, uint8_t *temp_buffer, int len, AudioOutPort &port, const ResumeAudioThread &resume_thread) {
+void AudioRing::init(size_t min_capacity) {
+    const size_t capacity = std::bit_ceil(min_capacity);
+    buffer = std::make_unique<int16_t[]>(capacity);
+    mask = capacity - 1;
+    read_pos = 0;
+    write_pos = 0;
+}
+
+size_t AudioRing::write(const int16_t *samples, size_t count) {
+    const size_t write_at = write_pos.load(std::memory_order_relaxed);
+    count = std::min(count, mask + 1 - (write_at - read_pos.load(std::memory_order_acquire)));
+    const size_t offset = write_at & mask;
+    const size_t first_count = std::min(count, mask + 1 - offset);
+    std::copy_n(samples, first_count, &buffer[offset]);
+    std::copy_n(samples + first_count, count - first_count, &buffer[0]);
+    write_pos.store(write_at + count, std::memory_order_release);
+
+    return count;
+}
+
+// called on the real-time host thread, it must neither block nor allocate
+// returns true if the port ran out of data while playing
+static bool mix_out_port(float *mix_buffer, size_t sample_count, size_t buffered_samples, AudioOutPort &port, const ResumeAudioThread &resume_thread) {
     ZoneScopedC(0xF6C2FF); // Tracy - Track function scope with color thistle
 
     // How much data is available?
-    std::unique_lock<std::mutex> lock(port.mutex);
-    const int bytes_available = SDL_AudioStreamAvailable(port.stream.get());
-    assert(bytes_available >= 0);
+    const size_t samples_available = port.ring.available();
 
     // Running out of data?
-    // The (len * 3) is according to the value in sceAudioOutOutput
-    if (bytes_available < len * 3) {
+    // The buffered_samples is according to the value in sceAudioOutOutput
+    if (samples_available < buffered_samples) {
         // Is there a thread waiting for playback to finish?
-        if (port.thread >= 0) {
+        const SceUID thread = port.thread.exchange(-1);
+        if (thread >= 0) {
             // Wake the thread up.
-            resume_thread(port.thread);
-            port.thread = -1;
+            resume_thread(thread);
         }
     }
 
-    if (bytes_available == 0)
-        return;
-
     // Mix as much as we need.
-    const int bytes_to_get = std::min(len, bytes_available);
-    const int bytes_got = SDL_AudioStreamGet(port.stream.get(), temp_buffer, bytes_to_get);
-    lock.unlock();
-    if (bytes_got > 0) {
-        SDL_MixAudioFormat(stream, temp_buffer, AUDIO_S16LSB, bytes_got, static_cast<int>(port.volume * SDL_MIX_MAXVOLUME));
-    }
+    const float volume = port.volume;
+    port.ring.read(sample_count, [&](const int16_t *samples, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            mix_buffer[i] += samples[i] * volume;
+        mix_buffer += count;
+    });
+
+    // a port stopping to output also counts once, the buffering shrinks back after a while anyway
+    const bool underrun = port.playing && samples_available < sample_count;
+    port.playing = samples_available >= sample_count;
+
+    return underrun;
+}
+
+// number of samples buffered in a port before the thread outputting to it waits
+static size_t buffered_callbacks_samples(const AudioState &state) {
+    return state.buffered_callbacks * state.spec.nb_samples * 2;
 }
 
 void AudioAdapter::audio_callback(uint8_t *stream, int len_bytes) {
     tracy::SetThreadName("Host audio thread"); // Tracy - Declare belonging of this function to the audio thread
     ZoneScopedC(0xF6C2FF); // Tracy - Track function scope with color thistle
 
-    std::vector<AudioOutPortPtr> ports;
-    {
-        // Read from shared state.
-        const std::lock_guard<std::mutex> lock(state.mutex);
-        ports.reserve(state.out_ports.size());
+    const auto start = std::chrono::steady_clock::now();
+
+    // Read from shared state, if it is being modified keep the ports of the last callback instead of waiting
+    if (state.mutex.try_lock()) {
+        callback_ports.clear();
         for (const AudioOutPortPtrs::value_type &port : state.out_ports) {
-            ports.push_back(port.second);
+            callback_ports.push_back(port.second);
         }
+        state.mutex.unlock();
     }
-    std::memset(stream, state.spec.silence, len_bytes);
 
-    for (const AudioOutPortPtr &port : ports) {
-        mix_out_port(stream, temp_buffer.data(), len_bytes, *port.get(), state.resume_thread);
+    // The ports are mixed as floats and only converted to the host format once
+    int16_t *output = reinterpret_cast<int16_t *>(stream);
+    const size_t buffered_samples = buffered_callbacks_samples(state);
+    bool underrun = false;
+    size_t samples_left = len_bytes / sizeof(int16_t);
+    while (samples_left > 0) {
+        const size_t sample_count = std::min(samples_left, mix_buffer.size());
+        std::fill_n(mix_buffer.begin(), sample_count, 0.0f);
+        for (const AudioOutPortPtr &port : callback_ports) {
+            underrun |= mix_out_port(mix_buffer.data(), sample_count, buffered_samples, *port, state.resume_thread);
+        }
+
+        for (size_t i = 0; i < sample_count; i++)
+            output[i] = static_cast<int16_t>(std::clamp(mix_buffer[i], -32768.0f, 32767.0f));
+        // the samples the recorder is too late to read are dropped
+        if (state.capture_enabled.load(std::memory_order_relaxed))
+            state.capture_ring.write(output, sample_count);
+
+        output += sample_count;
+        samples_left -= sample_count;
     }
+    state.update_buffering(underrun);
+
+    // the output is stereo
+    const uint64_t audio_ns = static_cast<uint64_t>(len_bytes / (2 * sizeof(int16_t))) * 1'000'000'000 / state.spec.freq;
+    state.callback_audio_ns.fetch_add(audio_ns, std::memory_order_relaxed);
+    state.callback_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
 
     FrameMarkNamed("Audio"); // Tracy - End discontinuous frame for audio rendering
 }
@@ -104,6 +157,8 @@ void AudioState::set_backend(const std::string &adapter_name) {
         adapter = std::make_unique<SDLAudioAdapter>(*this);
     } else if (adapter_name == "Cubeb") {
         adapter = std::make_unique<CubebAudioAdapter>(*this);
+    } else if (adapter_name == "Null") {
+        adapter = std::make_unique<NullAudioAdapter>(*this);
     } else {
         LOG_ERROR("Unknown audio adapter {}", adapter_name);
         return;
@@ -117,7 +172,27 @@ void AudioState::set_backend(const std::string &adapter_name) {
         return;
     }
 
-    adapter->temp_buffer.resize(spec.nb_samples * 2 * sizeof(uint16_t));
+    adapter->mix_buffer.resize(spec.nb_samples * 2);
+    // enough for all the ports the guest can open, so the callback never allocates
+    adapter->callback_ports.reserve(32);
+}
+
+bool AudioState::start_capture() {
+    if (!adapter || !adapter->single_stream)
+        return false;
+
+    // one second of stereo samples, the recorder reads them much more often
+    if (!capture_ring.is_initialized())
+        capture_ring.init(spec.freq * 2);
+    // the samples left by a previous recording are dropped, the callback does not write to the ring yet
+    capture_ring.read(capture_ring.available(), [](const int16_t *, size_t) {});
+    capture_enabled = true;
+
+    return true;
+}
+
+void AudioState::stop_capture() {
+    capture_enabled = false;
 }
 
 AudioOutPortPtr AudioState::open_port(int nb_channels, int freq, int nb_sample) {
@@ -131,6 +206,14 @@ AudioOutPortPtr AudioState::open_port(int nb_channels, int freq, int nb_sample)
         port->len_bytes = nb_sample * nb_channels * sizeof(int16_t);
         port->stream = stream;
 
+        // room for the samples of an output once converted, with some margin for the resampling
+        const int converted_samples = (nb_sample * spec.freq / freq + 16) * 2;
+        port->convert_buffer.resize(converted_samples);
+        // the thread outputting waits once enough callbacks are buffered, the ring has to hold them and the next output
+        port->ring.init(MAX_BUFFERED_CALLBACKS * spec.nb_samples * 2 + converted_samples * 2);
+        if (time_stretch)
+            port->stretcher = std::make_unique<TimeStretcher>();
+
         return port;
     } else {
         // let the adapter open the port
@@ -139,26 +222,62 @@ AudioOutPortPtr AudioState::open_port(int nb_channels, int freq, int nb_sample)
     }
 }
 
+// how much to stretch the audio of the port so that the callback does not run out of it
+static float get_stretch_ratio(const AudioState &state, AudioOutPort &port) {
+    // the time between the outputs includes the time waiting for the callback, so it gives the speed of the guest
+    const auto now = std::chrono::steady_clock::now();
+    const float elapsed = std::chrono::duration<float>(now - port.last_output).count();
+    port.last_output = now;
+    if (elapsed > 0.5f || port.freq <= 0) {
+        // the port was idle, start again from full speed
+        port.speed = 1.0f;
+        return 1.0f;
+    }
+    const float output_duration = static_cast<float>(port.len) / port.freq;
+    port.speed += (std::min(output_duration / elapsed, 1.0f) - port.speed) * 0.1f;
+
+    // the speed measured is noisy, only stretch once the buffered audio gets low
+    if (port.ring.available() * 2 >= buffered_callbacks_samples(state))
+        return 1.0f;
+
+    return std::clamp(1.0f / port.speed, 1.0f, 2.0f);
+}
+
 void AudioState::audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer) {
     if (adapter->single_stream) {
-        // Put audio to the port's stream and see how much is left to play.
-        std::unique_lock<std::mutex> lock(out_port.mutex);
+        // Put audio to the port's stream and move the converted samples to the ring read by the callback.
+        // The mutex is only shared with the other threads outputting to this port, never with the callback
+        std::unique_lock<ProfiledMutex> lock(out_port.mutex);
         SDL_AudioStreamPut(out_port.stream.get(), buffer, out_port.len_bytes);
-        const int available = SDL_AudioStreamAvailable(out_port.stream.get());
+        const float stretch_ratio = out_port.stretcher ? get_stretch_ratio(*this, out_port) : 1.0f;
+        int bytes_got;
+        while ((bytes_got = SDL_AudioStreamGet(out_port.stream.get(), out_port.convert_buffer.data(), out_port.convert_buffer.size() * sizeof(int16_t))) > 0) {
+            const int16_t *samples = out_port.convert_buffer.data();
+            size_t sample_count = bytes_got / sizeof(int16_t);
+            if (out_port.stretcher) {
+                out_port.stretch_buffer.clear();
+                out_port.stretcher->process(samples, sample_count / 2, stretch_ratio, out_port.stretch_buffer);
+                samples = out_port.stretch_buffer.data();
+                sample_count = out_port.stretch_buffer.size();
+            }
+            if (out_port.ring.write(samples, sample_count) < sample_count)
+                LOG_WARN_ONCE("Audio port ring is full, dropping samples");
+        }
+        const size_t available = out_port.ring.available() * sizeof(int16_t);
         lock.unlock();
 
         // If there's lots of audio left to play, stop this thread.
         // The audio callback will wake it up later when it's running out of data.
-        // the 3*(nb of samples for each callback) is needed for some games with an 480 host audiobuffer
+        // the buffering of several callbacks is needed for some games with an 480 host audiobuffer
         // sample size (what SDL audio gives us) to make sure this does not happen
         // we are supposed to wait for the existing samples to be processed (except the ones just passed)
         // but this would give a bad audio because the host buffer size is different compared to the guest buffer size
-        // so we need to cache more data to make sure we always have enough
-        if (available >= 3 * spec.nb_samples * 2 * sizeof(uint16_t)) {
-            out_port.thread = thread.id;
-
+        // so we need to cache more data to make sure we always have enough, adapted to the underruns of the callback
+        if (available >= buffered_callbacks_samples(*this) * sizeof(int16_t)) {
             std::unique_lock<std::mutex> mlock(thread.mutex);
             thread.update_status(ThreadStatus::wait);
+            // the callback resumes the thread with its mutex locked, so it can't do it before the thread waits
+            out_port.thread = thread.id;
             thread.status_cond.wait(mlock, [&]() { return thread.status == ThreadStatus::run; });
         }
     } else {
@@ -166,6 +285,84 @@ void AudioState::audio_output(ThreadState &thread, AudioOutPort &out_port, const
     }
 }
 
+// called on the real-time host thread, it must neither block nor allocate
+static void SDLCALL audio_in_callback(void *userdata, Uint8 *stream, int len) {
+    AudioState &state = *static_cast<AudioState *>(userdata);
+    AudioInPort &in_port = state.in_port;
+    if (in_port.ring.write(reinterpret_cast<const int16_t *>(stream), len / sizeof(int16_t)) < len / sizeof(int16_t))
+        LOG_WARN_ONCE("Audio input ring is full, dropping samples");
+
+    if (in_port.ring.available() >= static_cast<size_t>(in_port.grain)) {
+        const SceUID thread = in_port.thread.exchange(-1);
+        if (thread >= 0)
+            state.resume_thread(thread);
+    }
+}
+
+bool AudioState::open_in_port(int grain, int freq) {
+    // the callback is called several times per grain so that a grain is available as soon as it is captured
+    SDL_AudioSpec desired = {};
+    SDL_AudioSpec received = {};
+    desired.freq = freq;
+    desired.format = AUDIO_S16LSB;
+    desired.channels = 1;
+    desired.samples = std::bit_floor(static_cast<uint32_t>(std::max(grain / 4, 1)));
+    desired.callback = audio_in_callback;
+    desired.userdata = this;
+
+    in_port.grain = grain;
+    in_port.len_bytes = grain * sizeof(int16_t);
+    in_port.thread = -1;
+    // the inputs only keep the last grains, the ring can also hold what the device captures while one is copied
+    in_port.ring.init(grain * 4 + desired.samples * 2);
+
+    in_port.id = SDL_OpenAudioDevice(nullptr, true, &desired, &received, 0);
+    if (in_port.id == 0) {
+        LOG_ERROR("Failed to open the audio capture device: {}", SDL_GetError());
+        return false;
+    }
+
+    SDL_PauseAudioDevice(in_port.id, 0);
+    in_port.running = true;
+    return true;
+}
+
+void AudioState::close_in_port() {
+    in_port.running = false;
+    SDL_CloseAudioDevice(in_port.id);
+
+    // the callback is no longer called, the waiting thread would not be resumed
+    const SceUID thread = in_port.thread.exchange(-1);
+    if (thread >= 0)
+        resume_thread(thread);
+}
+
+void AudioState::audio_input(ThreadState &thread, void *buffer) {
+    const size_t grain = in_port.grain;
+    if (in_port.ring.available() < grain) {
+        std::unique_lock<std::mutex> mlock(thread.mutex);
+        thread.update_status(ThreadStatus::wait);
+        // the callback resumes the thread with its mutex locked, so it can't do it before the thread waits
+        in_port.thread = thread.id;
+        // the callback may have captured the grain before it could see the thread
+        if (in_port.ring.available() >= grain && in_port.thread.exchange(-1) >= 0)
+            thread.update_status(ThreadStatus::run);
+        thread.status_cond.wait(mlock, [&]() { return thread.status == ThreadStatus::run; });
+    }
+
+    // when the guest inputs late, drop the oldest samples so that the latency stays below 2 grains
+    const size_t available = in_port.ring.available();
+    if (available > grain * 2)
+        in_port.ring.read(available - grain * 2, [](const int16_t *, size_t) {});
+
+    int16_t *dest = static_cast<int16_t *>(buffer);
+    const size_t count = in_port.ring.read(grain, [&](const int16_t *samples, size_t count) {
+        dest = std::copy_n(samples, count, dest);
+    });
+    // the port was released while waiting
+    std::fill_n(dest, grain - count, 0);
+}
+
 void AudioState::set_volume(AudioOutPort &out_port, float volume) {
     out_port.volume = volume;
 
@@ -175,3 +372,36 @@ void AudioState::set_volume(AudioOutPort &out_port, float volume) {
 void AudioState::switch_state(const bool pause) {
     adapter->switch_state(pause);
 }
+
+static void update_latency(AudioState &state) {
+    // the host buffer being played plus the buffered callbacks
+    state.latency_ms = (state.buffered_callbacks + 1) * state.spec.nb_samples * 1000 / state.spec.freq;
+}
+
+void AudioState::init_buffering(int target_samples) {
+    // the host buffer is part of the latency, the ports buffer the rest
+    const int callbacks = (target_samples + spec.nb_samples / 2) / spec.nb_samples - 1;
+    min_buffered_callbacks = std::clamp<int>(callbacks, 1, MAX_BUFFERED_CALLBACKS);
+    buffered_callbacks = min_buffered_callbacks;
+    callbacks_without_underrun = 0;
+    update_latency(*this);
+}
+
+void AudioState::update_buffering(bool underrun) {
+    if (underrun) {
+        underrun_count++;
+        callbacks_without_underrun = 0;
+        if (buffered_callbacks < MAX_BUFFERED_CALLBACKS) {
+            buffered_callbacks++;
+            update_latency(*this);
+        }
+        return;
+    }
+
+    // go back to the latency target after 10 seconds without underrun
+    if (++callbacks_without_underrun >= static_cast<uint32_t>(10 * spec.freq / spec.nb_samples) && buffered_callbacks > min_buffered_callbacks) {
+        callbacks_without_underrun = 0;
+        buffered_callbacks--;
+        update_latency(*this);
+    }
+}
@@ -35,6 +35,8 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
         if (port->nb_buffers_ready == 0) {
             // no data available, should we wait for it or return nothing?
             // return nothing for now
+            if (port->playing)
+                (*port->underrun_count)++;
             break;
         }
 
@@ -46,7 +48,7 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
 
         if (audio_buffer.buffer_position == port->len_bytes) {
             // if we are done with this buffer, tell it
-            std::unique_lock<std::mutex> lock(port->mutex);
+            std::unique_lock<ProfiledMutex> lock(port->mutex);
             port->next_audio_buffer = (port->next_audio_buffer + 1) % port->audio_buffers.size();
             port->nb_buffers_ready--;
             lock.unlock();
@@ -55,6 +57,7 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
 
         bytes_given += bytes_to_copy;
     }
+    port->playing = bytes_given == bytes_to_give;
 
     return nframes;
 }
@@ -101,8 +104,10 @@ AudioOutPortPtr CubebAudioAdapter::open_port(int nb_channels, int freq, int nb_s
         .prefs = CUBEB_STREAM_PREF_NONE
     };
 
+    // the latency target can't go below the minimum of the host
     uint32_t latency;
     cubeb_get_min_latency(cubeb_ctx, &port->spec, &latency);
+    latency = std::max<uint32_t>(latency, state.cubeb_latency_ms * freq / 1000);
 
     if (cubeb_stream_init(cubeb_ctx, &port->out_stream, "Vita3K audio out", nullptr, nullptr, nullptr,
             &port->spec, latency, impl_cubeb_audio_callback, impl_cubeb_state_callback, port.get())
@@ -115,6 +120,8 @@ AudioOutPortPtr CubebAudioAdapter::open_port(int nb_channels, int freq, int nb_s
 
     // allocate enough buffers to be able to satisfy a callback (+1 to make sure one buffer can be ready)
     const int nb_buffers = (latency + nb_sample - 1) / nb_sample + 1;
+    port->underrun_count = &state.underrun_count;
+    state.latency_ms = (latency + nb_buffers * nb_sample) * 1000 / freq;
     port->audio_buffers.resize(nb_buffers);
     for (AudioBuffer &audio_buffer : port->audio_buffers) {
         // initialize all of the buffers
@@ -129,7 +136,7 @@ AudioOutPortPtr CubebAudioAdapter::open_port(int nb_channels, int freq, int nb_s
 void CubebAudioAdapter::audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer) {
     CubebAudioOutPort &port = static_cast<CubebAudioOutPort &>(out_port);
 
-    std::unique_lock<std::mutex> lock(port.mutex);
+    std::unique_lock<ProfiledMutex> lock(port.mutex);
     if (port.nb_buffers_ready == port.audio_buffers.size()) {
         // is it really useful to update the thread status?
         thread.update_status(ThreadStatus::wait);
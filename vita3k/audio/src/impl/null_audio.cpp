@@ -0,0 +1,84 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "audio/impl/null_audio.h"
+
+#include <chrono>
+
+static constexpr int NULL_AUDIO_FREQ = 48000;
+static constexpr int NULL_AUDIO_SAMPLES = 512;
+
+NullAudioAdapter::NullAudioAdapter(AudioState &audio_state)
+    : AudioAdapter(audio_state) {}
+
+NullAudioAdapter::~NullAudioAdapter() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        cond.notify_one();
+    }
+
+    if (thread.joinable())
+        thread.join();
+}
+
+void NullAudioAdapter::run() {
+    // the state mutex is held until the initialisation of the adapter is done
+    {
+        const std::lock_guard<std::mutex> state_lock(state.mutex);
+    }
+
+    // the callbacks are scheduled on absolute deadlines so the guest sees the same rate as with a device
+    const auto period = std::chrono::nanoseconds(1'000'000'000LL * NULL_AUDIO_SAMPLES / NULL_AUDIO_FREQ);
+    auto next = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!exiting) {
+        if (cond.wait_until(lock, next, [&] { return exiting; }))
+            break;
+        next += period;
+
+        lock.unlock();
+        if (!paused.load(std::memory_order_relaxed))
+            audio_callback(buffer.data(), static_cast<int>(buffer.size()));
+        lock.lock();
+
+        // do not try to catch up after the process was suspended
+        const auto now = std::chrono::steady_clock::now();
+        if (now > next + period * 4)
+            next = now;
+    }
+}
+
+bool NullAudioAdapter::init() {
+    state.spec = {
+        .freq = NULL_AUDIO_FREQ,
+        .nb_samples = NULL_AUDIO_SAMPLES,
+        .silence = 0
+    };
+    state.init_buffering(state.sdl_latency_ms * NULL_AUDIO_FREQ / 1000);
+
+    // stereo s16 output
+    buffer.resize(NULL_AUDIO_SAMPLES * 2 * sizeof(int16_t));
+    thread = std::thread(&NullAudioAdapter::run, this);
+
+    return true;
+}
+
+void NullAudioAdapter::switch_state(const bool pause) {
+    paused.store(pause, std::memory_order_relaxed);
+}
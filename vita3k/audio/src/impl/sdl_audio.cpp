@@ -21,6 +21,9 @@
 
 #include "util/log.h"
 
+#include <algorithm>
+#include <bit>
+
 static void SDLCALL sdl_audio_callback(void *userdata, Uint8 *stream, int len) {
     assert(userdata != nullptr);
     assert(stream != nullptr);
@@ -44,7 +47,9 @@ bool SDLAudioAdapter::init() {
     desired.freq = 48000;
     desired.format = AUDIO_S16LSB;
     desired.channels = 2;
-    desired.samples = 512;
+    // the host buffer holds about a quarter of the latency target, the ports buffer the rest
+    const int target_samples = state.sdl_latency_ms * desired.freq / 1000;
+    desired.samples = std::clamp<uint32_t>(std::bit_ceil<uint32_t>(target_samples / 4), 64, 8192);
     desired.callback = sdl_audio_callback;
     desired.userdata = this;
 
@@ -62,6 +67,7 @@ bool SDLAudioAdapter::init() {
         .nb_samples = spec.samples,
         .silence = spec.silence
     };
+    state.init_buffering(std::max(target_samples * spec.freq / desired.freq, 0));
 
     SDL_PauseAudioDevice(device_id, 0);
 
@@ -0,0 +1,95 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <audio/time_stretch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+TimeStretcher::TimeStretcher()
+    : fade_in(HOP_FRAMES)
+    , overlap(HOP_FRAMES * 2, 0.0f) {
+    // the fade out is 1 - fade in, so that the overlapped segments keep the same level
+    for (size_t i = 0; i < HOP_FRAMES; i++) {
+        const float sine = std::sin(static_cast<float>(std::numbers::pi) * 0.5f * i / HOP_FRAMES);
+        fade_in[i] = sine * sine;
+    }
+}
+
+// offset in [first, last] of the segment starting like the one at target
+size_t TimeStretcher::find_best_offset(size_t first, size_t last, size_t target) const {
+    // compare the sum of the channels of every other frame, that is accurate enough for the correlation
+    constexpr size_t STEP = 2;
+    const float *target_frames = &input[target * 2];
+
+    size_t best = first;
+    float best_score = -2.0f;
+    for (size_t offset = first; offset <= last; offset++) {
+        const float *frames = &input[offset * 2];
+        float correlation = 0.0f;
+        float energy = 0.0f;
+        for (size_t i = 0; i < HOP_FRAMES * 2; i += STEP * 2) {
+            const float sample = frames[i] + frames[i + 1];
+            correlation += sample * (target_frames[i] + target_frames[i + 1]);
+            energy += sample * sample;
+        }
+        const float score = energy > 0.0f ? correlation / std::sqrt(energy) : 0.0f;
+        if (score > best_score) {
+            best_score = score;
+            best = offset;
+        }
+    }
+
+    return best;
+}
+
+void TimeStretcher::process(const int16_t *samples, size_t frame_count, float ratio, std::vector<int16_t> &output) {
+    for (size_t i = 0; i < frame_count * 2; i++)
+        input.push_back(samples[i] / 32768.0f);
+
+    while (true) {
+        const size_t nominal = static_cast<size_t>(position);
+        const size_t first = started ? nominal - std::min(nominal, SEEK_FRAMES) : nominal;
+        const size_t last = started ? nominal + SEEK_FRAMES : nominal;
+        if (last + SEGMENT_FRAMES > input.size() / 2)
+            break;
+
+        // the natural continuation of the previous segment is the one to match
+        const size_t offset = started ? find_best_offset(first, last, previous + HOP_FRAMES) : nominal;
+        const float *segment = &input[offset * 2];
+        for (size_t i = 0; i < HOP_FRAMES; i++) {
+            for (size_t channel = 0; channel < 2; channel++) {
+                const float sample = overlap[i * 2 + channel] + segment[i * 2 + channel] * fade_in[i];
+                output.push_back(static_cast<int16_t>(std::clamp(sample * 32768.0f, -32768.0f, 32767.0f)));
+                overlap[i * 2 + channel] = segment[(HOP_FRAMES + i) * 2 + channel] * (1.0f - fade_in[i]);
+            }
+        }
+
+        previous = offset;
+        position += HOP_FRAMES / std::max(ratio, 1.0f);
+        started = true;
+
+        // drop the frames no segment can start from anymore
+        const size_t lowest = std::min(previous, static_cast<size_t>(position) - std::min(static_cast<size_t>(position), SEEK_FRAMES));
+        if (lowest > 0) {
+            input.erase(input.begin(), input.begin() + lowest * 2);
+            previous -= lowest;
+            position -= lowest;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "fixtures.h"
+
+#include <audio/state.h>
+#include <ngs/dsp.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// frames of a ngs voice update at 48kHz
+static constexpr uint32_t NGS_FRAME_COUNT = 512;
+
+static void ngs_mix_accumulate(benchmark::State &state) {
+    const std::vector<float> src = make_float_fixture(NGS_FRAME_COUNT * 2, 1);
+    std::vector<float> dest = make_float_fixture(NGS_FRAME_COUNT * 2, 2);
+    const float matrix[2][2] = { { 0.7f, 0.2f }, { 0.1f, 0.8f } };
+
+    for (auto _ : state) {
+        ngs::dsp::mix_accumulate(dest.data(), src.data(), matrix, NGS_FRAME_COUNT);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NGS_FRAME_COUNT));
+}
+BENCHMARK(ngs_mix_accumulate);
+
+static void ngs_apply_gain(benchmark::State &state) {
+    const std::vector<float> src = make_float_fixture(NGS_FRAME_COUNT * 2, 3);
+    std::vector<float> dest(NGS_FRAME_COUNT * 2);
+
+    for (auto _ : state) {
+        ngs::dsp::apply_gain(dest.data(), src.data(), 0.5f, 0.75f, NGS_FRAME_COUNT);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NGS_FRAME_COUNT));
+}
+BENCHMARK(ngs_apply_gain);
+
+// arg: number of stages, the equalizer runs up to 4 of them
+static void ngs_apply_biquads(benchmark::State &state) {
+    const uint32_t stage_count = static_cast<uint32_t>(state.range(0));
+    const std::vector<float> src = make_float_fixture(NGS_FRAME_COUNT * 2, 4);
+    std::vector<float> dest(NGS_FRAME_COUNT * 2);
+    // a stable low pass filter
+    std::vector<ngs::dsp::BiquadCoefficients> coefficients(stage_count, { 0.0675f, 0.135f, 0.0675f, -1.143f, 0.413f });
+    std::vector<ngs::dsp::BiquadState> states(stage_count);
+
+    for (auto _ : state) {
+        ngs::dsp::apply_biquads(dest.data(), src.data(), coefficients.data(), states.data(), stage_count, NGS_FRAME_COUNT);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NGS_FRAME_COUNT));
+}
+BENCHMARK(ngs_apply_biquads)->Arg(1)->Arg(4);
+
+static void ngs_float_to_s16(benchmark::State &state) {
+    const std::vector<float> src = make_float_fixture(NGS_FRAME_COUNT * 2, 5);
+    std::vector<int16_t> dest(NGS_FRAME_COUNT * 2);
+
+    for (auto _ : state) {
+        ngs::dsp::float_to_s16(dest.data(), src.data(), NGS_FRAME_COUNT * 2);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NGS_FRAME_COUNT * 2));
+}
+BENCHMARK(ngs_float_to_s16);
+
+// arg: number of ports open, each one having the data of the callback ready
+static void audio_mix_ports(benchmark::State &state) {
+    // the null backend is paused so only the benchmark calls the host callback
+    AudioState audio;
+    if (!audio.init([](SceUID) {}, "Null")) {
+        state.SkipWithError("could not init the null audio backend");
+        return;
+    }
+    audio.switch_state(true);
+    std::vector<int16_t> output(audio.spec.nb_samples * 2);
+
+    const size_t sample_count = output.size();
+    std::vector<int16_t> samples(sample_count);
+    const std::vector<uint8_t> fixture = make_fixture(sample_count * sizeof(int16_t), 6);
+    std::copy_n(reinterpret_cast<const int16_t *>(fixture.data()), sample_count, samples.begin());
+    for (int i = 0; i < state.range(0); i++) {
+        const AudioOutPortPtr port = std::make_shared<AudioOutPort>();
+        port->ring.init(sample_count * 2);
+        audio.out_ports.emplace(i, port);
+    }
+
+    for (auto _ : state) {
+        // filling the rings is counted too, it is much cheaper than the mixing
+        for (const auto &[id, port] : audio.out_ports)
+            port->ring.write(samples.data(), sample_count);
+
+        audio.adapter->audio_callback(reinterpret_cast<uint8_t *>(output.data()), static_cast<int>(output.size() * sizeof(int16_t)));
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * audio.spec.nb_samples));
+}
+BENCHMARK(audio_mix_ports)->Arg(1)->Arg(8);
@@ -0,0 +1,112 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <mem/allocator.h>
+#include <threads/queue.h>
+#include <util/containers.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// arg: number of slots of the bitmap
+static void bitmap_allocator_churn(benchmark::State &state) {
+    const size_t slot_count = static_cast<size_t>(state.range(0));
+    BitmapAllocator allocator(slot_count);
+
+    // fragment the bitmap with allocations of random sizes, then free and allocate them again in a random order
+    std::mt19937 rng(0x42495441);
+    std::uniform_int_distribution<int> size_distribution(1, 64);
+    std::vector<std::pair<int, int>> allocations;
+    for (;;) {
+        int size = size_distribution(rng);
+        const int offset = allocator.allocate_from(0, size);
+        if (offset < 0)
+            break;
+        allocations.emplace_back(offset, size);
+    }
+    // keep some room so the allocations can move
+    for (size_t i = 0; i < allocations.size(); i += 4)
+        allocator.free(allocations[i].first, allocations[i].second);
+
+    std::uniform_int_distribution<size_t> index_distribution(0, allocations.size() - 1);
+    for (auto _ : state) {
+        std::pair<int, int> &allocation = allocations[index_distribution(rng)];
+        if (allocation.first >= 0)
+            allocator.free(allocation.first, allocation.second);
+        allocation.first = allocator.allocate_from(0, allocation.second, state.range(1) != 0);
+        benchmark::DoNotOptimize(allocation.first);
+    }
+}
+BENCHMARK(bitmap_allocator_churn)->ArgsProduct({ { 1 << 12, 1 << 16, 1 << 20 }, { 0, 1 } });
+
+// arg: number of items, the ones used are picked at random like the cache of the renderer does
+static void lru_queue(benchmark::State &state) {
+    const size_t size = static_cast<size_t>(state.range(0));
+    lru::Queue<uint64_t> queue;
+    queue.init(size);
+    std::vector<uint64_t *> items;
+    for (size_t i = 0; i < size; i++) {
+        items.push_back(queue.get_lru());
+        queue.set_as_mru(items.back());
+    }
+
+    std::mt19937 rng(0x4C5255);
+    std::uniform_int_distribution<size_t> index_distribution(0, size - 1);
+    for (auto _ : state) {
+        queue.set_as_mru(items[index_distribution(rng)]);
+        benchmark::DoNotOptimize(queue.get_lru());
+    }
+}
+BENCHMARK(lru_queue)->Arg(64)->Arg(1024)->Arg(16384);
+
+// push and pop from the same thread, the cost of the locking without contention
+static void queue_push_pop(benchmark::State &state) {
+    Queue<uint64_t> queue;
+    uint64_t value = 0;
+    for (auto _ : state) {
+        queue.push(value++);
+        benchmark::DoNotOptimize(queue.pop());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(queue_push_pop);
+
+// arg: maximum number of pending items, one thread pushes while the benchmark thread pops
+static void queue_producer_consumer(benchmark::State &state) {
+    Queue<uint64_t> queue;
+    queue.maxPendingCount_ = static_cast<unsigned int>(state.range(0));
+    std::atomic<bool> done = false;
+    std::thread producer([&] {
+        // once aborted, push returns right away
+        for (uint64_t value = 0; !done; value++)
+            queue.push(value);
+    });
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(queue.pop());
+    state.SetItemsProcessed(state.iterations());
+
+    done = true;
+    queue.abort();
+    producer.join();
+}
+BENCHMARK(queue_producer_consumer)->Arg(1)->Arg(64)->UseRealTime();
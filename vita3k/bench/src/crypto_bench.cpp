@@ -0,0 +1,84 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "fixtures.h"
+
+#include <crypto/aes.h>
+
+#include <benchmark/benchmark.h>
+
+// size of the buffers crypted at once, about what a pfs read gives
+static constexpr size_t AES_DATA_SIZE = 64 * 1024;
+
+// the implementation selected by default is restored once the benchmark is done
+struct AesImplementation {
+    explicit AesImplementation(const bool hw) {
+        aes_set_hw_enabled(hw);
+    }
+    ~AesImplementation() {
+        aes_set_hw_enabled(1);
+    }
+};
+
+// arg: use the AES instructions of the host
+static bool select_aes_implementation(benchmark::State &state) {
+    if (state.range(0) && !aes_hw_available()) {
+        state.SkipWithError("the host has no AES instructions");
+        return false;
+    }
+    return true;
+}
+
+static void aes_128_ctr(benchmark::State &state) {
+    if (!select_aes_implementation(state))
+        return;
+    const AesImplementation implementation(state.range(0));
+    const std::vector<uint8_t> key = make_fixture(16, 1);
+    std::vector<uint8_t> data = make_fixture(AES_DATA_SIZE, 2);
+    aes_context ctx;
+    aes_setkey_enc(&ctx, key.data(), 128);
+
+    for (auto _ : state) {
+        unsigned char counter[16] = {};
+        unsigned char stream_block[16];
+        size_t nc_off = 0;
+        aes_crypt_ctr(&ctx, data.size(), &nc_off, counter, stream_block, data.data(), data.data());
+        benchmark::DoNotOptimize(data.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * AES_DATA_SIZE));
+}
+BENCHMARK(aes_128_ctr)->ArgName("hw")->Arg(0)->Arg(1);
+
+static void aes_128_cbc_decrypt(benchmark::State &state) {
+    if (!select_aes_implementation(state))
+        return;
+    const AesImplementation implementation(state.range(0));
+    const std::vector<uint8_t> key = make_fixture(16, 3);
+    std::vector<uint8_t> data = make_fixture(AES_DATA_SIZE, 4);
+    aes_context ctx;
+    aes_setkey_dec(&ctx, key.data(), 128);
+
+    for (auto _ : state) {
+        unsigned char iv[16] = {};
+        aes_crypt_cbc(&ctx, AES_DECRYPT, data.size(), iv, data.data(), data.data());
+        benchmark::DoNotOptimize(data.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * AES_DATA_SIZE));
+}
+BENCHMARK(aes_128_cbc_decrypt)->ArgName("hw")->Arg(0)->Arg(1);
@@ -0,0 +1,43 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The fixtures are generated from a fixed seed, so every run and every machine works on the same data.
+// The results of two builds (for example two SIMD variants of a kernel) can then be compared directly.
+inline std::vector<uint8_t> make_fixture(const size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (uint8_t &byte : data) {
+        seed = seed * 1664525 + 1013904223;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+    return data;
+}
+
+// interleaved stereo samples in [-1, 1]
+inline std::vector<float> make_float_fixture(const size_t count, uint32_t seed) {
+    std::vector<float> samples(count);
+    for (float &sample : samples) {
+        seed = seed * 1664525 + 1013904223;
+        sample = static_cast<float>(static_cast<int32_t>(seed)) / 2147483648.0f;
+    }
+    return samples;
+}
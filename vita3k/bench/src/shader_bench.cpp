@@ -0,0 +1,118 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <features/state.h>
+#include <gxm/types.h>
+#include <shader/spirv_recompiler.h>
+#include <shader/usse_translator_entry.h>
+#include <util/fs.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace shader;
+
+// The gxp files can't be shipped with the sources, the shaders are loaded from the folder pointed by
+// VITA3K_GXP_CORPUS (for example the shaders dumped with the log shaders option).
+static const std::vector<std::vector<uint8_t>> &get_gxp_corpus() {
+    static const std::vector<std::vector<uint8_t>> corpus = [] {
+        std::vector<std::vector<uint8_t>> programs;
+        const char *corpus_path = std::getenv("VITA3K_GXP_CORPUS");
+        if (!corpus_path || !fs::is_directory(corpus_path))
+            return programs;
+
+        std::vector<fs::path> paths;
+        for (const auto &entry : fs::recursive_directory_iterator(corpus_path)) {
+            if (entry.path().extension() == ".gxp")
+                paths.push_back(entry.path());
+        }
+        // always in the same order, so the runs can be compared
+        std::sort(paths.begin(), paths.end());
+
+        for (const fs::path &path : paths) {
+            fs::ifstream file(path, std::ios::binary);
+            std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (data.size() < sizeof(SceGxmProgram) || reinterpret_cast<const SceGxmProgram *>(data.data())->size > data.size())
+                continue;
+            programs.push_back(std::move(data));
+        }
+        return programs;
+    }();
+    return corpus;
+}
+
+static void usse_decode(benchmark::State &state) {
+    std::vector<uint64_t> instructions;
+    for (const std::vector<uint8_t> &data : get_gxp_corpus()) {
+        const SceGxmProgram &program = *reinterpret_cast<const SceGxmProgram *>(data.data());
+        const uint64_t *primary = program.primary_program_start();
+        const uint64_t *secondary = program.secondary_program_start();
+        const uint8_t *end = data.data() + data.size();
+        if (reinterpret_cast<const uint8_t *>(primary + program.primary_program_instr_count) <= end)
+            instructions.insert(instructions.end(), primary, primary + program.primary_program_instr_count);
+        if (reinterpret_cast<const uint8_t *>(secondary + program.secondary_program_instr_count) <= end)
+            instructions.insert(instructions.end(), secondary, secondary + program.secondary_program_instr_count);
+    }
+    if (instructions.empty()) {
+        // no corpus, use random instructions, all the primary opcodes are then used
+        std::mt19937_64 rng(0x5553534500000000ULL);
+        instructions.resize(1 << 16);
+        for (uint64_t &instruction : instructions)
+            instruction = rng();
+    }
+
+    for (auto _ : state) {
+        for (const uint64_t instruction : instructions)
+            benchmark::DoNotOptimize(usse::get_instruction_name(instruction));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * instructions.size()));
+}
+BENCHMARK(usse_decode);
+
+// arg: target of the translation
+static void translate_gxp(benchmark::State &state) {
+    const std::vector<std::vector<uint8_t>> &corpus = get_gxp_corpus();
+    if (corpus.empty()) {
+        state.SkipWithError("VITA3K_GXP_CORPUS does not point to a folder with gxp files");
+        return;
+    }
+
+    FeatureState features;
+    features.direct_fragcolor = false;
+    features.support_shader_interlock = true;
+    Hints hints{
+        .attributes = nullptr,
+        .color_format = SCE_GXM_COLOR_FORMAT_U8U8U8U8_ABGR,
+    };
+    std::fill_n(hints.vertex_textures, SCE_GXM_MAX_TEXTURE_UNITS, SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR);
+    std::fill_n(hints.fragment_textures, SCE_GXM_MAX_TEXTURE_UNITS, SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR);
+    const Target target = static_cast<Target>(state.range(0));
+
+    for (auto _ : state) {
+        for (const std::vector<uint8_t> &data : corpus) {
+            const SceGxmProgram &program = *reinterpret_cast<const SceGxmProgram *>(data.data());
+            GeneratedShader shader = convert_gxp(program, "bench", features, target, hints);
+            benchmark::DoNotOptimize(shader);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * corpus.size()));
+}
+BENCHMARK(translate_gxp)->Arg(static_cast<int>(Target::GLSLOpenGL))->Arg(static_cast<int>(Target::SpirVVulkan))->Unit(benchmark::kMillisecond);
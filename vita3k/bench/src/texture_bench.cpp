@@ -0,0 +1,134 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "fixtures.h"
+
+#include <gxm/types.h>
+#include <mem/functions.h>
+#include <mem/state.h>
+#include <renderer/functions.h>
+#include <renderer/pvrt-dec.h>
+
+#include <benchmark/benchmark.h>
+
+static void set_texture_counters(benchmark::State &state, const size_t bytes) {
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+// args: size of the square texture, bits per pixel
+static void texture_args(benchmark::internal::Benchmark *bench) {
+    for (const int size : { 128, 512, 1024 }) {
+        for (const int bpp : { 8, 32, 64 })
+            bench->Args({ size, bpp });
+    }
+}
+
+static void swizzled_to_linear(benchmark::State &state) {
+    const uint16_t size = static_cast<uint16_t>(state.range(0));
+    const uint8_t bpp = static_cast<uint8_t>(state.range(1));
+    const size_t bytes = size_t(size) * size * bpp / 8;
+    const std::vector<uint8_t> src = make_fixture(bytes, 1);
+    std::vector<uint8_t> dest(bytes);
+
+    for (auto _ : state) {
+        renderer::texture::swizzled_texture_to_linear_texture(dest.data(), src.data(), size, size, bpp);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    set_texture_counters(state, bytes);
+}
+BENCHMARK(swizzled_to_linear)->Apply(texture_args);
+
+static void tiled_to_linear(benchmark::State &state) {
+    const uint16_t size = static_cast<uint16_t>(state.range(0));
+    const uint8_t bpp = static_cast<uint8_t>(state.range(1));
+    const size_t bytes = size_t(size) * size * bpp / 8;
+    const std::vector<uint8_t> src = make_fixture(bytes, 2);
+    std::vector<uint8_t> dest(bytes);
+
+    for (auto _ : state) {
+        renderer::texture::tiled_texture_to_linear_texture(dest.data(), src.data(), size, size, bpp);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    set_texture_counters(state, bytes);
+}
+BENCHMARK(tiled_to_linear)->Apply(texture_args);
+
+// arg: format id given to decompress_bc_image, from 1 (BC1) to 7 (BC5S)
+static void decompress_bc(benchmark::State &state) {
+    constexpr uint32_t size = 512;
+    const uint8_t format_id = static_cast<uint8_t>(state.range(0));
+    const uint32_t block_size = (format_id != 1 && format_id != 4 && format_id != 5) ? 16 : 8;
+    const std::vector<uint8_t> blocks = make_fixture((size / 4) * (size / 4) * block_size, 3);
+    std::vector<uint32_t> image(size * size);
+
+    for (auto _ : state) {
+        renderer::texture::decompress_bc_image(size, size, blocks.data(), image.data(), format_id);
+        benchmark::DoNotOptimize(image.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * size * size));
+}
+BENCHMARK(decompress_bc)->DenseRange(1, 7);
+
+// args: 2bpp mode, PVRTC-II
+static void decompress_pvrtc(benchmark::State &state) {
+    constexpr uint32_t size = 512;
+    const bool is_2bpp = state.range(0);
+    const std::vector<uint8_t> words = make_fixture(size * size / (is_2bpp ? 4 : 2), 4);
+    std::vector<uint8_t> image(size * size * 4);
+
+    for (auto _ : state) {
+        pvr::PVRTDecompressPVRTC(words.data(), is_2bpp, size, size, static_cast<uint32_t>(state.range(1)), image.data());
+        benchmark::DoNotOptimize(image.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * size * size));
+}
+BENCHMARK(decompress_pvrtc)->ArgsProduct({ { 0, 1 }, { 0, 1 } });
+
+static MemState &get_mem() {
+    static MemState mem;
+    static const bool initialized = init(mem, false);
+    (void)initialized;
+    return mem;
+}
+
+// arg: size of the texture data in KiB
+static void hash_texture(benchmark::State &state) {
+    MemState &mem = get_mem();
+    const uint32_t size = static_cast<uint32_t>(state.range(0)) * 1024;
+    const Address address = alloc(mem, size, "bench texture");
+    if (!address) {
+        state.SkipWithError("could not allocate the texture data");
+        return;
+    }
+    const std::vector<uint8_t> data = make_fixture(size, 5);
+    std::copy(data.begin(), data.end(), Ptr<uint8_t>(address).get(mem));
+
+    SceGxmTexture texture = {};
+    texture.base_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8 >> 24;
+    texture.data_addr = address >> 2;
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(renderer::texture::hash_texture_data(texture, size, mem));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+
+    free(mem, address);
+}
+BENCHMARK(hash_texture)->Arg(16)->Arg(256)->Arg(4096);
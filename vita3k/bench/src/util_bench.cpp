@@ -0,0 +1,62 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "fixtures.h"
+
+#include <util/bytes.h>
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+// a palette of 64 bones, each one a 3x4 matrix, set with sceGxmSetUniformDataF
+static constexpr int UNIFORM_COMPONENT_COUNT = 64 * 12;
+
+static void uniform_float_to_half(benchmark::State &state) {
+    const std::vector<float> src = make_float_fixture(UNIFORM_COMPONENT_COUNT, 1);
+    std::vector<uint16_t> dest(UNIFORM_COMPONENT_COUNT);
+
+    for (auto _ : state) {
+        float_to_half(src.data(), dest.data(), UNIFORM_COMPONENT_COUNT);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * UNIFORM_COMPONENT_COUNT));
+}
+BENCHMARK(uniform_float_to_half);
+
+template <typename T>
+static void uniform_float_to_integer(benchmark::State &state) {
+    // the fixture is in [-1, 1), it is scaled to go past the range of the small types
+    std::vector<float> src = make_float_fixture(UNIFORM_COMPONENT_COUNT, 2);
+    for (float &value : src)
+        value *= 40000.f;
+    std::vector<T> dest(UNIFORM_COMPONENT_COUNT);
+
+    for (auto _ : state) {
+        float_to_integer(src.data(), dest.data(), UNIFORM_COMPONENT_COUNT);
+        benchmark::DoNotOptimize(dest.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * UNIFORM_COMPONENT_COUNT));
+}
+BENCHMARK_TEMPLATE(uniform_float_to_integer, int8_t);
+BENCHMARK_TEMPLATE(uniform_float_to_integer, uint8_t);
+BENCHMARK_TEMPLATE(uniform_float_to_integer, int16_t);
+BENCHMARK_TEMPLATE(uniform_float_to_integer, uint16_t);
+BENCHMARK_TEMPLATE(uniform_float_to_integer, int32_t);
+BENCHMARK_TEMPLATE(uniform_float_to_integer, uint32_t);
@@ -0,0 +1,119 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AVBufferRef;
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct AVStream;
+struct SwsContext;
+
+enum class RecordedPixelFormat {
+    // the luma plane followed by the interleaved chroma plane, both with the same pitch
+    NV12,
+    RGBA,
+};
+
+// records the presented frames and the mixed audio to a video file, encoded by the GPU of the host when it has an encoder
+// the frames are queued by the thread presenting them and encoded with the audio on a thread of the recorder
+class GameplayRecorder {
+public:
+    // reads up to count interleaved stereo samples, returns the number read
+    using AudioSource = std::function<size_t(int16_t *samples, size_t count)>;
+
+    ~GameplayRecorder();
+
+    // the encoders are opened with the size of the first frame, audio_source can be empty to record the video only
+    bool start(const fs::path &path, int sample_rate, AudioSource audio_source);
+    // the frames still queued are encoded before the file is closed
+    void stop();
+    bool is_recording() const {
+        return recording;
+    }
+
+    // copies the frame, it is dropped when the encoder is behind
+    // timestamp_ns is the host time at which the frame was presented
+    void push_frame(RecordedPixelFormat format, uint32_t width, uint32_t height, const uint8_t *data, uint32_t pitch, uint64_t timestamp_ns);
+
+    // frames dropped since the start because the encoder was behind
+    std::atomic<uint32_t> dropped_frames = 0;
+
+private:
+    struct QueuedFrame {
+        RecordedPixelFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t pitch;
+        uint64_t timestamp_ns;
+        std::vector<uint8_t> data;
+    };
+
+    bool open_encoders(const QueuedFrame &first_frame);
+    bool encode_video(const QueuedFrame &frame);
+    bool encode_audio();
+    bool write_packets(AVCodecContext *context, AVStream *stream);
+    void encode_thread_loop();
+    void close();
+
+    fs::path path;
+    int sample_rate = 0;
+    AudioSource audio_source;
+    bool recording = false;
+
+    std::thread encode_thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<QueuedFrame> queue;
+    // buffers of the frames already encoded, reused so that queuing a frame does not allocate
+    std::vector<QueuedFrame> free_frames;
+    bool exiting = false;
+
+    // only used by the encode thread
+    AVFormatContext *format = nullptr;
+    AVCodecContext *video_context = nullptr;
+    AVCodecContext *audio_context = nullptr;
+    AVStream *video_stream = nullptr;
+    AVStream *audio_stream = nullptr;
+    // set for the encoders taking only frames in the GPU memory, like VAAPI, the frames are uploaded to it
+    AVBufferRef *hw_frames = nullptr;
+    AVFrame *video_frame = nullptr;
+    AVFrame *hw_frame = nullptr;
+    AVFrame *audio_frame = nullptr;
+    AVPacket *packet = nullptr;
+    SwsContext *sws_context = nullptr;
+    uint64_t first_timestamp_ns = 0;
+    int64_t last_video_pts = -1;
+    int64_t audio_pts = 0;
+    std::vector<int16_t> audio_samples;
+    // the file is broken after an error, the next frames are dropped
+    bool failed = false;
+};
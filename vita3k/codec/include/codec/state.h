@@ -18,10 +18,14 @@
 #pragma once
 
 #include <array>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <thread>
 
 struct AVFrame;
 struct AVPacket;
@@ -31,6 +35,7 @@ struct AVFormatContext;
 struct AVCodecParserContext;
 struct AVCodec;
 struct SwrContext;
+struct SwsContext;
 
 union DecoderSize {
     struct {
@@ -113,18 +118,23 @@ struct H264DecoderState : public DecoderState {
     void get_res(uint32_t &width, uint32_t &height);
     void get_pts(uint32_t &upper, uint32_t &lower);
 
-    H264DecoderState(uint32_t width, uint32_t height);
+    H264DecoderState(uint32_t width, uint32_t height, bool hw_decoding = false);
     ~H264DecoderState() override;
 };
 
 struct MjpegDecoderState : public DecoderState {
     DecoderColorSpace color_space_out;
+    // kept between the images, it is only created again when their size or sampling changes
+    SwsContext *rgba_context = nullptr;
 
     bool send(const uint8_t *data, uint32_t size) override;
     bool receive(uint8_t *data, DecoderSize *size) override;
+    // convert the decoded image straight to the RGBA buffer, which is rgba_size bytes long
+    bool receive_rgba(uint8_t *rgba, uint32_t rgba_size, DecoderSize *size);
     DecoderColorSpace get_color_space();
 
     MjpegDecoderState();
+    ~MjpegDecoderState() override;
 };
 
 struct Atrac9DecoderSavedState {
@@ -149,6 +159,9 @@ struct Atrac9DecoderState : public DecoderState {
 
     void export_state(Atrac9DecoderSavedState *dest);
     void load_state(const Atrac9DecoderSavedState *src);
+    // decodes frame_count frames following each other, the samples of all of them are put in output
+    // returns the number of frames decoded, less than frame_count on a decode error
+    uint32_t decode_frames(const uint8_t *data, uint32_t frame_count, int16_t *output, uint32_t &bytes_used);
 
     explicit Atrac9DecoderState(uint32_t config_data);
     ~Atrac9DecoderState() override;
@@ -232,6 +245,18 @@ struct PlayerState {
 
     std::queue<AVPacket *> audio_packets;
     std::queue<AVPacket *> video_packets;
+    // the end of the file was reached and the decoder was asked to output the frames it still holds
+    bool video_drained = false;
+    bool audio_drained = false;
+
+    // the video frames are decoded ahead of their presentation on decode_thread, to not decode them on the game thread
+    static constexpr size_t DECODE_AHEAD_FRAMES = 4;
+    // held while using the FFmpeg contexts and the queues
+    std::mutex mutex;
+    std::condition_variable decode_cond;
+    std::thread decode_thread;
+    std::queue<AVFrame *> decoded_frames;
+    bool exiting = false;
 
     uint64_t time_of_last_frame = 0;
     uint64_t framerate_microseconds = 0;
@@ -241,25 +266,58 @@ struct PlayerState {
     uint32_t last_sample_rate = 0;
     uint32_t last_sample_count = 0;
 
+    bool hw_decoding = false;
+
     DecoderSize get_size();
     uint64_t get_framerate_microseconds();
+    bool is_playing();
 
+    // start playing the next video of the queue if there is one
     void pop_video();
     void free_video();
-    void switch_video(const std::string &path);
-
-    bool next_packet(int32_t stream_id);
 
     std::vector<int16_t> receive_audio();
-    std::vector<uint8_t> receive_video();
+    // decode the next frame to data, which is size bytes long, returns false if there is none
+    bool receive_video(uint8_t *data, uint32_t size);
 
     void queue(const std::string &path);
 
+private:
+    // the functions below are called with the mutex held
+    void close_video();
+    void clear_decoded_frames();
+    void switch_video(const std::string &path);
+    bool next_packet(int32_t stream_id);
+    AVFrame *decode_video_frame();
+    void decode_ahead();
+
+public:
+
     ~PlayerState();
 };
 
 void convert_rgb_to_yuv(const uint8_t *rgba, uint8_t *yuv, uint32_t width, uint32_t height, const DecoderColorSpace color_space, int32_t inPitch);
 void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height, const DecoderColorSpace color_space);
 int convert_yuv_to_jpeg(const uint8_t *yuv, uint8_t *jpeg, uint32_t width, uint32_t height, uint32_t max_size, const DecoderColorSpace color_space, int32_t compress_ratio);
+// read the size and the sampling of a JPEG image from its frame header, without decoding it
+// returns false if it could not be read or if the decoder would not output the image in one of the YUV color spaces
+bool read_jpeg_info(const uint8_t *data, uint32_t size, DecoderSize &image_size, DecoderColorSpace &color_space);
 void copy_yuv_data_from_frame(AVFrame *frame, uint8_t *dest, const uint32_t width, const uint32_t height);
+
+// decode on the host cores not used by the emulation, with frame threading if the decoder can output the frames late
+void configure_decoder_threads(AVCodecContext *context, bool frame_threading);
+// Opens a video decoder using the hardware of the host if hw_decoding is set, falls back to software decoding if it can't.
+// setup fills the context before it is opened, it may be called twice.
+AVCodecContext *open_video_decoder(const AVCodec *codec, bool hw_decoding, const std::function<void(AVCodecContext *)> &setup);
+// moves the frame to the host memory if it was decoded by the hardware, returns false if it failed
+bool download_video_frame(AVFrame *frame);
 std::string codec_error_name(int error);
+
+// The decoders and the resamplers released are kept initialized, so that the next voices using the same format reuse them.
+// They can be used from any thread.
+std::unique_ptr<Atrac9DecoderState> acquire_atrac9_decoder(uint32_t config_data);
+void release_atrac9_decoder(std::unique_ptr<Atrac9DecoderState> decoder);
+// resampler of interleaved stereo float samples, starting without any sample buffered
+SwrContext *acquire_resampler(int src_rate, int dest_rate);
+// sets swr to nullptr
+void release_resampler(SwrContext *&swr);
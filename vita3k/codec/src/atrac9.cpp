@@ -109,6 +109,34 @@ bool Atrac9DecoderState::send(const uint8_t *data, uint32_t size) {
     return true;
 }
 
+uint32_t Atrac9DecoderState::decode_frames(const uint8_t *data, uint32_t frame_count, int16_t *output, uint32_t &bytes_used) {
+    Atrac9CodecInfo *info = reinterpret_cast<Atrac9CodecInfo *>(atrac9_info);
+    const uint32_t frame_samples = info->frameSamples * info->channels;
+
+    bytes_used = 0;
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        // decode straight to the output instead of going through result
+        int decode_used = 0;
+        const int res = Atrac9Decode(decoder_handle, data + bytes_used, output + frame * frame_samples, &decode_used);
+        if (res != At9Status::ERR_SUCCESS) {
+            LOG_ERROR("Decode failure with code {}", res);
+            return frame;
+        }
+
+        bytes_used += decode_used;
+        superframe_data_left -= decode_used;
+        superframe_frame_idx++;
+        if (superframe_frame_idx == info->framesInSuperframe) {
+            // add the padding between two superframes as size used if there is
+            bytes_used += superframe_data_left;
+            superframe_frame_idx = 0;
+            superframe_data_left = info->superframeSize;
+        }
+    }
+
+    return frame_count;
+}
+
 bool Atrac9DecoderState::receive(uint8_t *data, DecoderSize *size) {
     Atrac9CodecInfo *info = reinterpret_cast<Atrac9CodecInfo *>(atrac9_info);
 
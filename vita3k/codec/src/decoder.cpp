@@ -23,7 +23,9 @@ extern "C" {
 
 #include <util/log.h>
 
+#include <algorithm>
 #include <cassert>
+#include <thread>
 
 uint32_t DecoderState::get(DecoderQuery query) {
     return 0;
@@ -41,6 +43,15 @@ DecoderState::~DecoderState() {
     avcodec_free_context(&context);
 }
 
+void configure_decoder_threads(AVCodecContext *context, bool frame_threading) {
+    // leave a host core to each of the 3 guest cores and to the renderer
+    constexpr int RESERVED_CORES = 4;
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    context->thread_count = std::clamp(cores - RESERVED_CORES, 1, 8);
+    // each frame thread delays the output by one frame, only the decoders which can wait for the frames can use them
+    context->thread_type = frame_threading ? FF_THREAD_FRAME | FF_THREAD_SLICE : FF_THREAD_SLICE;
+}
+
 // Handy to have this in logs, some debuggers dont seem to be able to evaluate there error macros properly.
 std::string codec_error_name(int error) {
     switch (error) {
@@ -30,6 +30,20 @@ void copy_yuv_data_from_frame(AVFrame *frame, uint8_t *dest, const uint32_t widt
         memcpy(dest, &frame->data[0][frame->linesize[0] * a], width);
         dest += width;
     }
+    if (frame->format == AV_PIX_FMT_NV12) {
+        // the frames of the hardware decoders have the chroma planes interleaved
+        uint8_t *dest_v = dest + (width / 2) * (height / 2);
+        for (uint32_t a = 0; a < height / 2; a++) {
+            const uint8_t *src = &frame->data[1][frame->linesize[1] * a];
+            for (uint32_t b = 0; b < width / 2; b++) {
+                dest[b] = src[b * 2];
+                dest_v[b] = src[b * 2 + 1];
+            }
+            dest += width / 2;
+            dest_v += width / 2;
+        }
+        return;
+    }
     for (uint32_t a = 0; a < height / 2; a++) {
         memcpy(dest, &frame->data[1][frame->linesize[1] * a], width / 2);
         dest += width / 2;
@@ -103,6 +117,11 @@ bool H264DecoderState::receive(uint8_t *data, DecoderSize *size) {
         return false;
     }
 
+    if (!download_video_frame(frame)) {
+        av_frame_free(&frame);
+        return false;
+    }
+
     if (data) {
         copy_yuv_data_from_frame(frame, data, width_in, height_in);
     }
@@ -142,7 +161,7 @@ void H264DecoderState::get_pts(uint32_t &upper, uint32_t &lower) {
     lower = pts_out & 0xFFFFFFFF;
 }
 
-H264DecoderState::H264DecoderState(uint32_t width, uint32_t height) {
+H264DecoderState::H264DecoderState(uint32_t width, uint32_t height, bool hw_decoding) {
     const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
     assert(codec);
 
@@ -150,13 +169,13 @@ H264DecoderState::H264DecoderState(uint32_t width, uint32_t height) {
     assert(parser);
     parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
 
-    context = avcodec_alloc_context3(codec);
+    context = open_video_decoder(codec, hw_decoding, [&](AVCodecContext *codec_context) {
+        codec_context->width = width;
+        codec_context->height = height;
+        // the frame of an access unit must be received right after sending it
+        configure_decoder_threads(codec_context, false);
+    });
     assert(context);
-    context->width = width;
-    context->height = height;
-
-    int result = avcodec_open2(context, codec, nullptr);
-    assert(result == 0);
 }
 
 H264DecoderState::~H264DecoderState() {
@@ -0,0 +1,143 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <codec/state.h>
+
+#include <util/log.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include <cassert>
+#include <cstdint>
+
+#ifndef __ANDROID__
+// the hardware decoding APIs tried in order, MediaCodec on Android is a decoder of its own instead
+#ifdef _WIN32
+static constexpr AVHWDeviceType HW_DEVICE_TYPES[] = { AV_HWDEVICE_TYPE_D3D11VA, AV_HWDEVICE_TYPE_DXVA2 };
+#elif defined(__APPLE__)
+static constexpr AVHWDeviceType HW_DEVICE_TYPES[] = { AV_HWDEVICE_TYPE_VIDEOTOOLBOX };
+#else
+static constexpr AVHWDeviceType HW_DEVICE_TYPES[] = { AV_HWDEVICE_TYPE_VAAPI, AV_HWDEVICE_TYPE_VDPAU };
+#endif
+
+static AVPixelFormat get_hw_format(AVCodecContext *context, const AVPixelFormat *formats) {
+    const auto hw_format = static_cast<AVPixelFormat>(reinterpret_cast<intptr_t>(context->opaque));
+    for (const AVPixelFormat *format = formats; *format != AV_PIX_FMT_NONE; format++) {
+        if (*format == hw_format)
+            return hw_format;
+    }
+
+    // the hardware can't decode this stream (like an unsupported profile), FFmpeg decodes it in software with the first software format
+    LOG_WARN("The hardware cannot decode this {} stream, falling back to software decoding.", context->codec->name);
+    for (const AVPixelFormat *format = formats; *format != AV_PIX_FMT_NONE; format++) {
+        if (!(av_pix_fmt_desc_get(*format)->flags & AV_PIX_FMT_FLAG_HWACCEL))
+            return *format;
+    }
+
+    return AV_PIX_FMT_NONE;
+}
+
+static bool setup_hw_device(AVCodecContext *context, const AVCodec *codec) {
+    for (const AVHWDeviceType type : HW_DEVICE_TYPES) {
+        const AVCodecHWConfig *config = nullptr;
+        for (int i = 0; (config = avcodec_get_hw_config(codec, i)); i++) {
+            if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type)
+                break;
+        }
+        if (!config)
+            continue;
+
+        AVBufferRef *device = nullptr;
+        if (av_hwdevice_ctx_create(&device, type, nullptr, nullptr, 0) < 0)
+            continue;
+
+        // the context owns the device from now on
+        context->hw_device_ctx = device;
+        context->opaque = reinterpret_cast<void *>(static_cast<intptr_t>(config->pix_fmt));
+        context->get_format = get_hw_format;
+        LOG_INFO("Using {} to decode the {} videos.", av_hwdevice_get_type_name(type), codec->name);
+        return true;
+    }
+
+    return false;
+}
+#endif
+
+static AVCodecContext *open_decoder(const AVCodec *codec, const std::function<void(AVCodecContext *)> &setup, bool hw_decoding) {
+    AVCodecContext *context = avcodec_alloc_context3(codec);
+    assert(context);
+    setup(context);
+
+#ifndef __ANDROID__
+    if (hw_decoding && !setup_hw_device(context, codec)) {
+        avcodec_free_context(&context);
+        return nullptr;
+    }
+#endif
+
+    const int error = avcodec_open2(context, codec, nullptr);
+    if (error < 0) {
+        LOG_WARN("Error opening the {} decoder: {}.", codec->name, codec_error_name(error));
+        if (hw_decoding) {
+            avcodec_free_context(&context);
+            return nullptr;
+        }
+    }
+
+    return context;
+}
+
+AVCodecContext *open_video_decoder(const AVCodec *codec, bool hw_decoding, const std::function<void(AVCodecContext *)> &setup) {
+    if (hw_decoding) {
+#ifdef __ANDROID__
+        const AVCodec *hw_codec = avcodec_find_decoder_by_name(fmt::format("{}_mediacodec", codec->name).c_str());
+#else
+        const AVCodec *hw_codec = codec;
+#endif
+        AVCodecContext *context = hw_codec ? open_decoder(hw_codec, setup, true) : nullptr;
+        if (context)
+            return context;
+
+        LOG_WARN("No hardware decoder available for the {} videos, using software decoding.", codec->name);
+    }
+
+    return open_decoder(codec, setup, false);
+}
+
+bool download_video_frame(AVFrame *frame) {
+    if (!frame->hw_frames_ctx)
+        return true;
+
+    AVFrame *sw_frame = av_frame_alloc();
+    int error = av_hwframe_transfer_data(sw_frame, frame, 0);
+    if (error >= 0)
+        error = av_frame_copy_props(sw_frame, frame);
+    if (error < 0) {
+        LOG_WARN("Error transferring the video frame from the hardware: {}.", codec_error_name(error));
+        av_frame_free(&sw_frame);
+        return false;
+    }
+
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, sw_frame);
+    av_frame_free(&sw_frame);
+    return true;
+}
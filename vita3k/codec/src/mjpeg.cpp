@@ -29,6 +29,91 @@ extern "C" {
 
 #include <cassert>
 
+static DecoderColorSpace get_frame_color_space(int format) {
+    switch (format) {
+    case AV_PIX_FMT_YUVJ444P:
+        return COLORSPACE_YUV444P;
+    case AV_PIX_FMT_YUVJ422P:
+        return COLORSPACE_YUV422P;
+    case AV_PIX_FMT_YUVJ420P:
+        return COLORSPACE_YUV420P;
+    default:
+        return COLORSPACE_UNKNOWN;
+    }
+}
+
+// format given to swscale for the conversion to RGBA, the same as in convert_yuv_to_rgb
+static AVPixelFormat get_rgba_conversion_format(DecoderColorSpace color_space) {
+    switch (color_space) {
+    case COLORSPACE_YUV422P:
+        return AV_PIX_FMT_YUV422P;
+    case COLORSPACE_YUV420P:
+        return AV_PIX_FMT_YUV420P;
+    default:
+        return AV_PIX_FMT_YUV444P;
+    }
+}
+
+bool read_jpeg_info(const uint8_t *data, uint32_t size, DecoderSize &image_size, DecoderColorSpace &color_space) {
+    // start of image
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+
+    uint32_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF)
+            return false;
+
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            // fill byte
+            pos++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            // markers without a length
+            pos += 2;
+            continue;
+        }
+        // start of scan, the frame header should be before it
+        if (marker == 0xDA)
+            return false;
+
+        const uint32_t length = (data[pos + 2] << 8) | data[pos + 3];
+        if (length < 2 || pos + 2 + length > size)
+            return false;
+
+        // SOF0 to SOF15, except DHT, JPG and DAC
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            const uint8_t *frame_header = data + pos + 4;
+            // the grayscale images are not given as YUV by the decoder
+            if (length < 17 || frame_header[5] != 3)
+                return false;
+
+            image_size.height = (frame_header[1] << 8) | frame_header[2];
+            image_size.width = (frame_header[3] << 8) | frame_header[4];
+            if (image_size.width == 0 || image_size.height == 0)
+                return false;
+
+            // sampling factors of each component, the chroma ones are given relative to the luma one
+            const uint8_t luma_sampling = frame_header[7];
+            if (frame_header[10] != 0x11 || frame_header[13] != 0x11)
+                return false;
+
+            switch (luma_sampling) {
+            case 0x11: color_space = COLORSPACE_YUV444P; return true;
+            case 0x21: color_space = COLORSPACE_YUV422P; return true;
+            case 0x22: color_space = COLORSPACE_YUV420P; return true;
+            default: return false;
+            }
+        }
+
+        pos += 2 + length;
+    }
+
+    return false;
+}
+
 void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height, const DecoderColorSpace color_space) {
     AVPixelFormat format = AV_PIX_FMT_YUVJ444P;
     int strides_divisor = 1;
@@ -340,6 +425,53 @@ bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
     return true;
 }
 
+bool MjpegDecoderState::receive_rgba(uint8_t *rgba, uint32_t rgba_size, DecoderSize *size) {
+    AVFrame *frame = av_frame_alloc();
+    int error = avcodec_receive_frame(context, frame);
+    if (error < 0) {
+        LOG_WARN("Error receiving Mjpeg frame: {}.", codec_error_name(error));
+        av_frame_free(&frame);
+        return false;
+    }
+
+    color_space_out = get_frame_color_space(frame->format);
+    if (color_space_out == COLORSPACE_UNKNOWN) {
+        LOG_WARN("Mjpeg frame is in unimplemented format {}.", frame->format);
+        av_frame_free(&frame);
+        return false;
+    }
+
+    if (static_cast<uint64_t>(frame->width) * frame->height * 4 > rgba_size) {
+        LOG_WARN("The RGBA buffer ({} bytes) is too small for the {}x{} image.", rgba_size, frame->width, frame->height);
+        av_frame_free(&frame);
+        return false;
+    }
+
+    // convert from the planes of the frame instead of copying them to a YUV buffer first
+    rgba_context = sws_getCachedContext(rgba_context, frame->width, frame->height, get_rgba_conversion_format(color_space_out),
+        frame->width, frame->height, AV_PIX_FMT_RGBA, SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND, nullptr, nullptr, nullptr);
+    assert(rgba_context);
+
+    uint8_t *dst_slices[] = {
+        rgba,
+    };
+
+    const int dst_strides[] = {
+        frame->width * 4,
+    };
+
+    error = sws_scale(rgba_context, frame->data, frame->linesize, 0, frame->height, dst_slices, dst_strides);
+    assert(error == frame->height);
+
+    if (size) {
+        size->width = frame->width;
+        size->height = frame->height;
+    }
+
+    av_frame_free(&frame);
+    return true;
+}
+
 DecoderColorSpace MjpegDecoderState::get_color_space() {
     return this->color_space_out;
 }
@@ -354,3 +486,7 @@ MjpegDecoderState::MjpegDecoderState() {
     assert(error == 0);
     this->color_space_out = COLORSPACE_UNKNOWN;
 }
+
+MjpegDecoderState::~MjpegDecoderState() {
+    sws_freeContext(rgba_context);
+}
@@ -29,23 +29,42 @@ extern "C" {
 #include <chrono>
 
 uint64_t PlayerState::get_framerate_microseconds() {
+    const std::lock_guard<std::mutex> lock(mutex);
     AVRational rational = format->streams[video_stream_id]->avg_frame_rate;
     return static_cast<float>(rational.den) / static_cast<float>(rational.num) * 1000000;
 }
 
 DecoderSize PlayerState::get_size() {
+    const std::lock_guard<std::mutex> lock(mutex);
     if (video_context)
         return { { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) } };
 
     return {};
 }
 
+bool PlayerState::is_playing() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    // the last frames of the video can still be waiting to be presented
+    return !video_playing.empty() || !decoded_frames.empty();
+}
+
 void PlayerState::pop_video() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (videos_queue.empty())
+        return;
+
+    clear_decoded_frames();
     switch_video(videos_queue.front());
     videos_queue.pop();
 }
 
 void PlayerState::free_video() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    clear_decoded_frames();
+    close_video();
+}
+
+void PlayerState::close_video() {
     if (video_context)
         avcodec_free_context(&video_context);
 
@@ -67,11 +86,21 @@ void PlayerState::free_video() {
         audio_packets.pop();
     }
 
+    video_drained = false;
+    audio_drained = false;
     video_playing = "";
 }
 
+void PlayerState::clear_decoded_frames() {
+    while (!decoded_frames.empty()) {
+        AVFrame *frame = decoded_frames.front();
+        av_frame_free(&frame);
+        decoded_frames.pop();
+    }
+}
+
 void PlayerState::switch_video(const std::string &path) {
-    free_video();
+    close_video();
     video_playing = path;
 
     int error;
@@ -89,9 +118,13 @@ void PlayerState::switch_video(const std::string &path) {
     if (video_stream_id >= 0) {
         AVStream *video_stream = format->streams[video_stream_id];
         const AVCodec *video_codec = avcodec_find_decoder(video_stream->codecpar->codec_id);
-        video_context = avcodec_alloc_context3(video_codec);
-        avcodec_parameters_to_context(video_context, video_stream->codecpar);
-        avcodec_open2(video_context, video_codec, nullptr);
+        video_context = open_video_decoder(video_codec, hw_decoding, [&](AVCodecContext *context) {
+            avcodec_parameters_to_context(context, video_stream->codecpar);
+            configure_decoder_threads(context, true);
+        });
+
+        if (!decode_thread.joinable())
+            decode_thread = std::thread(&PlayerState::decode_ahead, this);
     }
 
     if (audio_stream_id >= 0) {
@@ -101,6 +134,8 @@ void PlayerState::switch_video(const std::string &path) {
         avcodec_parameters_to_context(audio_context, audio_stream->codecpar);
         avcodec_open2(audio_context, audio_codec, nullptr);
     }
+
+    decode_cond.notify_one();
 }
 
 bool PlayerState::next_packet(int32_t stream_id) {
@@ -127,8 +162,17 @@ bool PlayerState::next_packet(int32_t stream_id) {
         }
 
         AVPacket *packet = av_packet_alloc();
-        if (av_read_frame(format, packet) != 0)
-            return false;
+        if (av_read_frame(format, packet) != 0) {
+            av_packet_free(&packet);
+
+            // the frame threads still hold the last frames, a null packet makes the decoder output them
+            bool &drained = stream_id == video_stream_id ? video_drained : audio_drained;
+            if (drained)
+                return false;
+            drained = true;
+            avcodec_send_packet(stream_id == video_stream_id ? video_context : audio_context, nullptr);
+            return true;
+        }
 
         if (packet->stream_index == stream_id) {
             this_queue.push(packet);
@@ -139,6 +183,7 @@ bool PlayerState::next_packet(int32_t stream_id) {
 }
 
 std::vector<int16_t> PlayerState::receive_audio() {
+    const std::lock_guard<std::mutex> lock(mutex);
     if (audio_stream_id < 0)
         return {};
 
@@ -192,16 +237,15 @@ std::vector<int16_t> PlayerState::receive_audio() {
     return data;
 }
 
-std::vector<uint8_t> PlayerState::receive_video() {
+AVFrame *PlayerState::decode_video_frame() {
     if (video_stream_id < 0)
-        return {};
+        return nullptr;
 
     if (video_playing.empty())
-        return {};
+        return nullptr;
 
     int error;
     AVFrame *frame = av_frame_alloc();
-    std::vector<uint8_t> data;
     while (true) {
         error = avcodec_receive_frame(video_context, frame);
 
@@ -221,22 +265,65 @@ std::vector<uint8_t> PlayerState::receive_video() {
             }
         }
 
-        last_timestamp = frame->best_effort_timestamp;
+        if (!download_video_frame(frame))
+            continue;
+
+        return frame;
+    }
 
-        data.resize(H264DecoderState::buffer_size(
-            { { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) } }));
-        copy_yuv_data_from_frame(frame, data.data(), frame->width, frame->height);
+    av_frame_free(&frame);
+    return nullptr;
+}
 
-        break;
+void PlayerState::decode_ahead() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        decode_cond.wait(lock, [&] {
+            return exiting || (!video_playing.empty() && video_stream_id >= 0 && decoded_frames.size() < DECODE_AHEAD_FRAMES);
+        });
+        if (exiting)
+            return;
+
+        AVFrame *frame = decode_video_frame();
+        if (frame)
+            decoded_frames.push(frame);
+    }
+}
+
+bool PlayerState::receive_video(uint8_t *data, uint32_t size) {
+    const std::lock_guard<std::mutex> lock(mutex);
+
+    AVFrame *frame;
+    if (decoded_frames.empty()) {
+        // the decode thread is late, do not wait for it
+        frame = decode_video_frame();
+    } else {
+        frame = decoded_frames.front();
+        decoded_frames.pop();
+        decode_cond.notify_one();
     }
+    if (!frame)
+        return false;
+
+    last_timestamp = frame->best_effort_timestamp;
+
+    // the next video of the queue may be bigger than the buffer
+    const uint32_t frame_size = H264DecoderState::buffer_size({ { static_cast<uint32_t>(frame->width), static_cast<uint32_t>(frame->height) } });
+    const bool fits = frame_size <= size;
+    if (fits)
+        // decode straight to the guest buffer
+        copy_yuv_data_from_frame(frame, data, frame->width, frame->height);
+    else
+        LOG_WARN("The video frame ({} bytes) does not fit in the buffer ({} bytes).", frame_size, size);
 
     av_frame_free(&frame);
-    return data;
+    return fits;
 }
 
 void PlayerState::queue(const std::string &path) {
     if (fs::exists(path)) {
         LOG_INFO("Queued video: '{}'.", path);
+        const std::lock_guard<std::mutex> lock(mutex);
         if (video_playing.empty())
             switch_video(path);
         else
@@ -247,6 +334,14 @@ void PlayerState::queue(const std::string &path) {
 }
 
 PlayerState::~PlayerState() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        decode_cond.notify_one();
+    }
+    if (decode_thread.joinable())
+        decode_thread.join();
+
     free_video();
 
     video_playing = "";
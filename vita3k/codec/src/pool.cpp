@@ -0,0 +1,119 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <codec/state.h>
+
+extern "C" {
+#include <libavutil/opt.h>
+#include <libswresample/swresample.h>
+}
+
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// enough for the voices switching between a few formats, the ones released above it are freed
+static constexpr size_t MAX_POOLED_PER_FORMAT = 8;
+
+struct CodecPool {
+    std::mutex mutex;
+    std::map<uint32_t, std::vector<std::unique_ptr<Atrac9DecoderState>>> atrac9_decoders;
+    // keyed by source and destination sample rates
+    std::map<std::pair<int64_t, int64_t>, std::vector<SwrContext *>> resamplers;
+
+    ~CodecPool() {
+        for (auto &[rates, contexts] : resamplers) {
+            for (SwrContext *&swr : contexts)
+                swr_free(&swr);
+        }
+    }
+};
+
+static CodecPool pool;
+
+std::unique_ptr<Atrac9DecoderState> acquire_atrac9_decoder(uint32_t config_data) {
+    {
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        const auto it = pool.atrac9_decoders.find(config_data);
+        if (it != pool.atrac9_decoders.end() && !it->second.empty()) {
+            std::unique_ptr<Atrac9DecoderState> decoder = std::move(it->second.back());
+            it->second.pop_back();
+            return decoder;
+        }
+    }
+
+    return std::make_unique<Atrac9DecoderState>(config_data);
+}
+
+void release_atrac9_decoder(std::unique_ptr<Atrac9DecoderState> decoder) {
+    if (!decoder)
+        return;
+
+    // the next user starts from a clean state
+    decoder->flush();
+
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    auto &decoders = pool.atrac9_decoders[decoder->config_data];
+    if (decoders.size() < MAX_POOLED_PER_FORMAT)
+        decoders.push_back(std::move(decoder));
+}
+
+SwrContext *acquire_resampler(int src_rate, int dest_rate) {
+    SwrContext *swr = nullptr;
+    {
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        const auto it = pool.resamplers.find({ src_rate, dest_rate });
+        if (it != pool.resamplers.end() && !it->second.empty()) {
+            swr = it->second.back();
+            it->second.pop_back();
+        }
+    }
+
+    if (!swr) {
+        AVChannelLayout layout_stereo = AV_CHANNEL_LAYOUT_STEREO;
+        const int ret = swr_alloc_set_opts2(&swr,
+            &layout_stereo, AV_SAMPLE_FMT_FLT, dest_rate,
+            &layout_stereo, AV_SAMPLE_FMT_FLT, src_rate,
+            0, nullptr);
+        assert(ret == 0);
+    }
+
+    // initializing a context again drops the samples it buffered, the filter is kept as the rates are the same
+    const int ret = swr_init(swr);
+    assert(ret == 0);
+
+    return swr;
+}
+
+void release_resampler(SwrContext *&swr) {
+    if (!swr)
+        return;
+
+    int64_t src_rate = 0;
+    int64_t dest_rate = 0;
+    av_opt_get_int(swr, "in_sample_rate", 0, &src_rate);
+    av_opt_get_int(swr, "out_sample_rate", 0, &dest_rate);
+
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    auto &contexts = pool.resamplers[{ src_rate, dest_rate }];
+    if (contexts.size() < MAX_POOLED_PER_FORMAT)
+        contexts.push_back(swr);
+    else
+        swr_free(&swr);
+    swr = nullptr;
+}
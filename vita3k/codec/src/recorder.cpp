@@ -0,0 +1,524 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <codec/recorder.h>
+#include <codec/state.h>
+
+#include <util/log.h>
+#include <util/string_utils.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <chrono>
+
+// frame rate given to the rate control of the encoders, the frames keep their presentation time in the file
+static constexpr int RECORD_FRAME_RATE = 60;
+// frames waiting for the encoder, the next ones are dropped
+static constexpr size_t MAX_QUEUED_FRAMES = 4;
+// about 12 Mb/s at 1080p
+static constexpr double VIDEO_BITS_PER_PIXEL = 0.1;
+static constexpr int64_t AUDIO_BIT_RATE = 192'000;
+// how often the audio is encoded when no frame is presented, the capture ring holds one second
+static constexpr auto AUDIO_POLL_INTERVAL = std::chrono::milliseconds(20);
+
+// the encoders tried in order, the hardware ones first
+static constexpr const char *VIDEO_ENCODERS[] = {
+#ifdef _WIN32
+    "h264_nvenc",
+    "h264_amf",
+    "h264_qsv",
+#elif defined(__APPLE__)
+    "h264_videotoolbox",
+#elif defined(__ANDROID__)
+    "h264_mediacodec",
+#else
+    "h264_nvenc",
+    "h264_vaapi",
+#endif
+    "libx264",
+    "libopenh264",
+    "mpeg4",
+};
+
+static bool is_hw_format(AVPixelFormat format) {
+    return av_pix_fmt_desc_get(format)->flags & AV_PIX_FMT_FLAG_HWACCEL;
+}
+
+// NV12 when the encoder takes it, it is what the renderer converts the frames to
+// AV_PIX_FMT_NONE if the encoder only takes frames in the GPU memory
+static AVPixelFormat get_sw_format(const AVCodec *codec) {
+    if (!codec->pix_fmts)
+        return AV_PIX_FMT_YUV420P;
+
+    AVPixelFormat sw_format = AV_PIX_FMT_NONE;
+    for (const AVPixelFormat *format = codec->pix_fmts; *format != AV_PIX_FMT_NONE; format++) {
+        if (*format == AV_PIX_FMT_NV12)
+            return *format;
+        if (sw_format == AV_PIX_FMT_NONE && !is_hw_format(*format))
+            sw_format = *format;
+    }
+
+    return sw_format;
+}
+
+// the NV12 frames are uploaded to these frames before being encoded
+static AVBufferRef *create_hw_frames(const AVCodec *codec, uint32_t width, uint32_t height) {
+    const AVCodecHWConfig *config = nullptr;
+    for (int i = 0; (config = avcodec_get_hw_config(codec, i)); i++) {
+        if (!(config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX))
+            continue;
+
+        AVBufferRef *device = nullptr;
+        if (av_hwdevice_ctx_create(&device, config->device_type, nullptr, nullptr, 0) < 0)
+            continue;
+
+        // the frames keep a reference to the device
+        AVBufferRef *frames_ref = av_hwframe_ctx_alloc(device);
+        av_buffer_unref(&device);
+        if (!frames_ref)
+            continue;
+
+        auto *frames = reinterpret_cast<AVHWFramesContext *>(frames_ref->data);
+        frames->format = config->pix_fmt;
+        frames->sw_format = AV_PIX_FMT_NV12;
+        frames->width = width;
+        frames->height = height;
+        frames->initial_pool_size = MAX_QUEUED_FRAMES * 2;
+        if (av_hwframe_ctx_init(frames_ref) < 0) {
+            av_buffer_unref(&frames_ref);
+            continue;
+        }
+
+        return frames_ref;
+    }
+
+    return nullptr;
+}
+
+static AVCodecContext *open_video_encoder(const AVCodec *codec, uint32_t width, uint32_t height, bool global_header, AVBufferRef *&hw_frames) {
+    const AVPixelFormat sw_format = get_sw_format(codec);
+    AVBufferRef *frames = nullptr;
+    if (sw_format == AV_PIX_FMT_NONE) {
+        frames = create_hw_frames(codec, width, height);
+        if (!frames)
+            return nullptr;
+    }
+
+    AVCodecContext *context = avcodec_alloc_context3(codec);
+    context->width = width;
+    context->height = height;
+    if (frames) {
+        context->pix_fmt = reinterpret_cast<AVHWFramesContext *>(frames->data)->format;
+        context->hw_frames_ctx = av_buffer_ref(frames);
+    } else {
+        context->pix_fmt = sw_format;
+    }
+    // the timestamps are in milliseconds
+    context->time_base = { 1, 1000 };
+    context->framerate = { RECORD_FRAME_RATE, 1 };
+    context->bit_rate = static_cast<int64_t>(width * height * RECORD_FRAME_RATE * VIDEO_BITS_PER_PIXEL);
+    context->gop_size = RECORD_FRAME_RATE * 2;
+    // the renderer and swscale both convert with BT.601 limited range
+    context->colorspace = AVCOL_SPC_SMPTE170M;
+    context->color_range = AVCOL_RANGE_MPEG;
+    // no frame is held back by the encoder
+    context->max_b_frames = 0;
+    if (global_header)
+        context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    const int error = avcodec_open2(context, codec, nullptr);
+    if (error < 0) {
+        LOG_WARN("Error opening the {} encoder: {}.", codec->name, codec_error_name(error));
+        avcodec_free_context(&context);
+        av_buffer_unref(&frames);
+        return nullptr;
+    }
+
+    hw_frames = frames;
+    return context;
+}
+
+GameplayRecorder::~GameplayRecorder() {
+    stop();
+}
+
+bool GameplayRecorder::start(const fs::path &path, int sample_rate, AudioSource audio_source) {
+    if (recording)
+        return false;
+
+    // the container is guessed from the extension
+    const std::string path_str = string_utils::wide_to_utf(path.wstring());
+    int error = avformat_alloc_output_context2(&format, nullptr, nullptr, path_str.c_str());
+    if (error >= 0) {
+        error = avio_open(&format->pb, path_str.c_str(), AVIO_FLAG_WRITE);
+        if (error < 0) {
+            avformat_free_context(format);
+            format = nullptr;
+        }
+    }
+    if (error < 0) {
+        LOG_ERROR("Cannot record the gameplay to {}: {}.", path_str, codec_error_name(error));
+        return false;
+    }
+
+    this->path = path;
+    this->sample_rate = sample_rate;
+    this->audio_source = std::move(audio_source);
+    dropped_frames = 0;
+    first_timestamp_ns = 0;
+    last_video_pts = -1;
+    audio_pts = 0;
+    failed = false;
+    exiting = false;
+    recording = true;
+    encode_thread = std::thread(&GameplayRecorder::encode_thread_loop, this);
+
+    return true;
+}
+
+void GameplayRecorder::stop() {
+    if (!recording)
+        return;
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+    }
+    cond.notify_all();
+    encode_thread.join();
+    recording = false;
+    audio_source = nullptr;
+
+    LOG_INFO("Gameplay recorded to {}, {} frames dropped.", path.string(), dropped_frames.load());
+}
+
+void GameplayRecorder::push_frame(RecordedPixelFormat pixel_format, uint32_t width, uint32_t height, const uint8_t *data, uint32_t pitch, uint64_t timestamp_ns) {
+    QueuedFrame frame;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (!recording || exiting)
+            return;
+        if (queue.size() >= MAX_QUEUED_FRAMES) {
+            dropped_frames++;
+            return;
+        }
+        if (!free_frames.empty()) {
+            frame = std::move(free_frames.back());
+            free_frames.pop_back();
+        }
+    }
+
+    // the copy is done without the lock, the encode thread keeps going meanwhile
+    const size_t size = static_cast<size_t>(pitch) * (pixel_format == RecordedPixelFormat::NV12 ? height + height / 2 : height);
+    frame.format = pixel_format;
+    frame.width = width;
+    frame.height = height;
+    frame.pitch = pitch;
+    frame.timestamp_ns = timestamp_ns;
+    frame.data.assign(data, data + size);
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(frame));
+    }
+    cond.notify_one();
+}
+
+bool GameplayRecorder::open_encoders(const QueuedFrame &first_frame) {
+    // the chroma of the encoded frames is subsampled
+    const uint32_t width = first_frame.width & ~1u;
+    const uint32_t height = first_frame.height & ~1u;
+    const bool global_header = format->oformat->flags & AVFMT_GLOBALHEADER;
+
+    const char *encoder_name = nullptr;
+    for (const char *name : VIDEO_ENCODERS) {
+        const AVCodec *codec = avcodec_find_encoder_by_name(name);
+        if (!codec)
+            continue;
+
+        video_context = open_video_encoder(codec, width, height, global_header, hw_frames);
+        if (video_context) {
+            encoder_name = name;
+            break;
+        }
+    }
+    if (!video_context) {
+        LOG_ERROR("No video encoder is available to record the gameplay.");
+        return false;
+    }
+
+    video_stream = avformat_new_stream(format, nullptr);
+    avcodec_parameters_from_context(video_stream->codecpar, video_context);
+    video_stream->time_base = video_context->time_base;
+
+    video_frame = av_frame_alloc();
+    video_frame->format = hw_frames ? AV_PIX_FMT_NV12 : video_context->pix_fmt;
+    video_frame->width = width;
+    video_frame->height = height;
+    int error = av_frame_get_buffer(video_frame, 0);
+    if (error < 0) {
+        LOG_ERROR("Error allocating the recorded frames: {}.", codec_error_name(error));
+        return false;
+    }
+    if (hw_frames)
+        hw_frame = av_frame_alloc();
+    packet = av_packet_alloc();
+
+    if (audio_source) {
+        const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+        error = AVERROR_ENCODER_NOT_FOUND;
+        if (codec) {
+            audio_context = avcodec_alloc_context3(codec);
+            audio_context->sample_fmt = AV_SAMPLE_FMT_FLTP;
+            audio_context->sample_rate = sample_rate;
+            audio_context->ch_layout = AV_CHANNEL_LAYOUT_STEREO;
+            audio_context->bit_rate = AUDIO_BIT_RATE;
+            audio_context->time_base = { 1, sample_rate };
+            if (global_header)
+                audio_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+            error = avcodec_open2(audio_context, codec, nullptr);
+        }
+        if (error < 0) {
+            LOG_WARN("Error opening the AAC encoder, the gameplay is recorded without audio: {}.", codec_error_name(error));
+            avcodec_free_context(&audio_context);
+        } else {
+            audio_stream = avformat_new_stream(format, nullptr);
+            avcodec_parameters_from_context(audio_stream->codecpar, audio_context);
+            audio_stream->time_base = audio_context->time_base;
+
+            audio_frame = av_frame_alloc();
+            audio_frame->format = AV_SAMPLE_FMT_FLTP;
+            audio_frame->sample_rate = sample_rate;
+            audio_frame->ch_layout = AV_CHANNEL_LAYOUT_STEREO;
+            audio_frame->nb_samples = audio_context->frame_size;
+            error = av_frame_get_buffer(audio_frame, 0);
+            if (error < 0) {
+                LOG_ERROR("Error allocating the recorded audio frames: {}.", codec_error_name(error));
+                return false;
+            }
+            audio_samples.reserve(audio_context->frame_size * 2 * 2);
+        }
+    }
+
+    error = avformat_write_header(format, nullptr);
+    if (error < 0) {
+        LOG_ERROR("Error writing the header of the recording: {}.", codec_error_name(error));
+        return false;
+    }
+
+    // the audio mixed before the first frame is not recorded
+    if (audio_context) {
+        audio_samples.resize(audio_context->frame_size * 2);
+        while (audio_source(audio_samples.data(), audio_samples.size()) > 0) {
+        }
+        audio_samples.clear();
+    }
+    first_timestamp_ns = first_frame.timestamp_ns;
+
+    LOG_INFO("Recording the gameplay at {}x{} with the {} encoder{}.", width, height, encoder_name, audio_context ? "" : ", without audio");
+    return true;
+}
+
+bool GameplayRecorder::write_packets(AVCodecContext *context, AVStream *stream) {
+    while (true) {
+        int error = avcodec_receive_packet(context, packet);
+        if (error == AVERROR(EAGAIN) || error == AVERROR_EOF)
+            return true;
+        if (error < 0) {
+            LOG_ERROR("Error encoding the recording: {}.", codec_error_name(error));
+            return false;
+        }
+
+        av_packet_rescale_ts(packet, context->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        // the packet is unreferenced by the muxer
+        error = av_interleaved_write_frame(format, packet);
+        if (error < 0) {
+            LOG_ERROR("Error writing the recording: {}.", codec_error_name(error));
+            return false;
+        }
+    }
+}
+
+bool GameplayRecorder::encode_video(const QueuedFrame &frame) {
+    int error = av_frame_make_writable(video_frame);
+    if (error < 0) {
+        LOG_ERROR("Error allocating the recorded frames: {}.", codec_error_name(error));
+        return false;
+    }
+
+    const bool is_nv12 = frame.format == RecordedPixelFormat::NV12;
+    const AVPixelFormat src_format = is_nv12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_RGBA;
+    const uint8_t *src_data[4] = { frame.data.data(), is_nv12 ? frame.data.data() + static_cast<size_t>(frame.pitch) * frame.height : nullptr };
+    const int src_pitch[4] = { static_cast<int>(frame.pitch), is_nv12 ? static_cast<int>(frame.pitch) : 0 };
+    if (src_format == video_frame->format && (frame.width & ~1u) == static_cast<uint32_t>(video_frame->width) && (frame.height & ~1u) == static_cast<uint32_t>(video_frame->height)) {
+        av_image_copy(video_frame->data, video_frame->linesize, src_data, src_pitch, src_format, video_frame->width, video_frame->height);
+    } else {
+        // the encoder takes another format, or the renderer could not convert the frame
+        sws_context = sws_getCachedContext(sws_context, frame.width, frame.height, src_format, video_frame->width, video_frame->height,
+            static_cast<AVPixelFormat>(video_frame->format), SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!sws_context) {
+            LOG_ERROR("Cannot convert the recorded frames to the format of the encoder.");
+            return false;
+        }
+        sws_scale(sws_context, src_data, src_pitch, 0, frame.height, video_frame->data, video_frame->linesize);
+    }
+
+    // the encoders need increasing timestamps, the frames presented in the same millisecond are shifted
+    const int64_t pts = std::max(static_cast<int64_t>(frame.timestamp_ns - first_timestamp_ns) / 1'000'000, last_video_pts + 1);
+    last_video_pts = pts;
+
+    AVFrame *encoded_frame = video_frame;
+    if (hw_frames) {
+        av_frame_unref(hw_frame);
+        error = av_hwframe_get_buffer(hw_frames, hw_frame, 0);
+        if (error >= 0)
+            error = av_hwframe_transfer_data(hw_frame, video_frame, 0);
+        if (error < 0) {
+            LOG_ERROR("Error uploading the recorded frame to the encoder: {}.", codec_error_name(error));
+            return false;
+        }
+        encoded_frame = hw_frame;
+    }
+    encoded_frame->pts = pts;
+
+    error = avcodec_send_frame(video_context, encoded_frame);
+    if (error < 0) {
+        LOG_ERROR("Error encoding the recorded frame: {}.", codec_error_name(error));
+        return false;
+    }
+
+    return write_packets(video_context, video_stream);
+}
+
+bool GameplayRecorder::encode_audio() {
+    if (!audio_context)
+        return true;
+
+    const size_t frame_samples = audio_context->frame_size * 2;
+    while (true) {
+        const size_t buffered = audio_samples.size();
+        audio_samples.resize(buffered + frame_samples);
+        const size_t read = audio_source(&audio_samples[buffered], frame_samples);
+        audio_samples.resize(buffered + read);
+
+        while (audio_samples.size() >= frame_samples) {
+            int error = av_frame_make_writable(audio_frame);
+            if (error < 0) {
+                LOG_ERROR("Error allocating the recorded audio frames: {}.", codec_error_name(error));
+                return false;
+            }
+
+            // the encoder takes one plane of floats per channel
+            auto *left = reinterpret_cast<float *>(audio_frame->data[0]);
+            auto *right = reinterpret_cast<float *>(audio_frame->data[1]);
+            for (int i = 0; i < audio_context->frame_size; i++) {
+                left[i] = audio_samples[i * 2] / 32768.0f;
+                right[i] = audio_samples[i * 2 + 1] / 32768.0f;
+            }
+            audio_samples.erase(audio_samples.begin(), audio_samples.begin() + frame_samples);
+
+            audio_frame->pts = audio_pts;
+            audio_pts += audio_context->frame_size;
+            error = avcodec_send_frame(audio_context, audio_frame);
+            if (error < 0) {
+                LOG_ERROR("Error encoding the recorded audio: {}.", codec_error_name(error));
+                return false;
+            }
+            if (!write_packets(audio_context, audio_stream))
+                return false;
+        }
+
+        if (read < frame_samples)
+            return true;
+    }
+}
+
+void GameplayRecorder::encode_thread_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait_for(lock, AUDIO_POLL_INTERVAL, [&] { return exiting || !queue.empty(); });
+        if (queue.empty()) {
+            if (exiting)
+                break;
+
+            lock.unlock();
+            if (video_context && !failed)
+                failed = !encode_audio();
+            lock.lock();
+            continue;
+        }
+
+        QueuedFrame frame = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+
+        if (!failed && !video_context)
+            failed = !open_encoders(frame);
+        if (!failed)
+            failed = !encode_video(frame) || !encode_audio();
+
+        lock.lock();
+        free_frames.push_back(std::move(frame));
+    }
+    lock.unlock();
+
+    close();
+}
+
+void GameplayRecorder::close() {
+    if (!video_context) {
+        LOG_WARN("No frame was presented, the recording {} is empty.", path.string());
+    } else if (!failed) {
+        // drain the encoders
+        bool drained = encode_audio();
+        avcodec_send_frame(video_context, nullptr);
+        drained &= write_packets(video_context, video_stream);
+        if (audio_context) {
+            avcodec_send_frame(audio_context, nullptr);
+            drained &= write_packets(audio_context, audio_stream);
+        }
+        if (drained)
+            av_write_trailer(format);
+    }
+
+    avcodec_free_context(&video_context);
+    avcodec_free_context(&audio_context);
+    av_frame_free(&video_frame);
+    av_frame_free(&hw_frame);
+    av_frame_free(&audio_frame);
+    av_packet_free(&packet);
+    av_buffer_unref(&hw_frames);
+    sws_freeContext(sws_context);
+    sws_context = nullptr;
+    video_stream = nullptr;
+    audio_stream = nullptr;
+    audio_samples.clear();
+
+    avio_closep(&format->pb);
+    avformat_free_context(format);
+    format = nullptr;
+}
@@ -22,9 +22,13 @@
 
 #include <compat/state.h>
 
+#include <optional>
+
 namespace compat {
 
 bool load_app_compat_db(GuiState &gui, EmuEnvState &emuenv);
 bool update_app_compat_db(GuiState &gui, EmuEnvState &emuenv);
+// binary search in the mapped database, nothing if it is not loaded or the app is not listed
+std::optional<Compatibility> find_app_compat(CompatState &compat, const std::string &title_id);
 
 } // namespace compat
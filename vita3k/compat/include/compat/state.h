@@ -17,9 +17,12 @@
 
 #pragma once
 
+#include <util/mapped_file.h>
+
 #include <cstdint>
 #include <imgui.h>
 #include <map>
+#include <mutex>
 #include <string>
 
 namespace compat {
@@ -43,7 +46,11 @@ struct Compatibility {
 
 struct CompatState {
     bool compat_db_loaded = false;
-    std::map<std::string, Compatibility> app_compat_db;
+    // table of the apps sorted by title id, written once from the downloaded xml and looked up with find_app_compat
+    MappedFile app_compat_db;
+    uint32_t app_compat_count = 0;
+    // the database is mapped again by the thread updating it while the gui looks it up
+    std::mutex app_compat_db_mutex;
     std::map<CompatibilityState, ImVec4> compat_color{
         { UNKNOWN, ImVec4(0.54f, 0.54f, 0.54f, 1.f) },
         { NOTHING, ImVec4(1.00f, 0.00f, 0.00f, 1.f) }, // #ff0000
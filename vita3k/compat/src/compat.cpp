@@ -27,6 +27,11 @@
 
 #include <pugixml.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
+
 enum LabelIdState {
     Nothing = 1260231569, // 0x4b1d9b91
     Bootable = 1344750319, // 0x502742ef
@@ -42,18 +47,59 @@ namespace compat {
 static std::string db_updated_at;
 static const uint32_t db_version = 1;
 
-bool load_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
-    const auto app_compat_db_path = emuenv.cache_path / "app_compat_db.xml";
-    if (!fs::exists(app_compat_db_path)) {
-        LOG_WARN("Compatibility database not found at {}.", app_compat_db_path.string());
-        return false;
+constexpr uint32_t COMPAT_DB_MAGIC = 0x434B3356; // V3KC
+// version of the binary table, the xml keeps its own db_version
+constexpr uint32_t COMPAT_DB_BINARY_VERSION = 1;
+
+struct CompatDbHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t reserved;
+    char db_updated_at[32];
+};
+
+struct CompatDbEntry {
+    // zero padded, the entries are sorted by it
+    char title_id[12];
+    uint32_t issue_id;
+    int32_t state;
+    int32_t reserved;
+    int64_t updated_at;
+};
+
+typedef std::array<char, sizeof(CompatDbEntry::title_id)> CompatDbKey;
+
+static CompatDbKey make_key(const std::string &title_id) {
+    CompatDbKey key{};
+    std::memcpy(key.data(), title_id.data(), std::min(title_id.size(), key.size()));
+    return key;
+}
+
+static CompatibilityState get_state(const pugi::xml_node &labels) {
+    auto state = CompatibilityState::UNKNOWN;
+    for (const auto &label : labels) {
+        const auto label_id = static_cast<LabelIdState>(label.text().as_uint());
+        switch (label_id) {
+        case LabelIdState::Nothing: state = NOTHING; break;
+        case LabelIdState::Bootable: state = BOOTABLE; break;
+        case LabelIdState::Intro: state = INTRO; break;
+        case LabelIdState::Menu: state = MENU; break;
+        case LabelIdState::Ingame_Less: state = INGAME_LESS; break;
+        case LabelIdState::Ingame_More: state = INGAME_MORE; break;
+        case LabelIdState::Playable: state = PLAYABLE; break;
+        default: break;
+        }
     }
+    return state;
+}
 
-    // Parse and load file of compatibility database
+// parse the downloaded xml once and write its apps as a table sorted by title id, the only parse of the xml
+static bool convert_app_compat_db(EmuEnvState &emuenv, const fs::path &xml_path, const fs::path &db_path) {
     pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(app_compat_db_path.c_str());
+    pugi::xml_parse_result result = doc.load_file(xml_path.c_str());
     if (!result) {
-        LOG_ERROR("Compatibility database {} could not be loaded: {}", app_compat_db_path.string(), result.description());
+        LOG_ERROR("Compatibility database {} could not be loaded: {}", xml_path.string(), result.description());
         return false;
     }
 
@@ -62,48 +108,21 @@ bool load_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
     const auto version = compatibility.attribute("version").as_uint();
     if (db_version != version) {
         LOG_WARN("Compatibility database version {} is outdated, download it again.", version);
-        return update_app_compat_db(gui, emuenv);
-    }
-
-    // Check if compatibility database is up to date in first load
-    if (db_updated_at.empty()) {
-        db_updated_at = compatibility.attribute("db_updated_at").as_string();
-        if (update_app_compat_db(gui, emuenv))
-            return true;
+        return false;
     }
 
-    // Clear old compat database
-    gui.compat.compat_db_loaded = false;
-    gui.compat.app_compat_db.clear();
-
-    //  Load compatibility database
-    for (const auto &app : doc.child("compatibility")) {
+    std::map<CompatDbKey, CompatDbEntry> entries;
+    for (const auto &app : compatibility) {
         const std::string title_id = app.attribute("title_id").as_string();
         const auto issue_id = app.child("issue_id").text().as_uint();
 
         // Check if title ID is valid
-        if ((title_id.find("PCS") == std::string::npos) && (title_id != "NPXS10007")) {
+        if (((title_id.find("PCS") == std::string::npos) && (title_id != "NPXS10007")) || (title_id.size() >= sizeof(CompatDbEntry::title_id))) {
             LOG_WARN_IF(emuenv.cfg.log_compat_warn, "Title ID {} is invalid. Please check GitHub issue {} and verify it!", title_id, issue_id);
             continue;
         }
 
-        auto state = CompatibilityState::UNKNOWN;
-        const auto labels = app.child("labels");
-        if (!labels.empty()) {
-            for (const auto &label : labels) {
-                const auto label_id = static_cast<LabelIdState>(label.text().as_uint());
-                switch (label_id) {
-                case LabelIdState::Nothing: state = NOTHING; break;
-                case LabelIdState::Bootable: state = BOOTABLE; break;
-                case LabelIdState::Intro: state = INTRO; break;
-                case LabelIdState::Menu: state = MENU; break;
-                case LabelIdState::Ingame_Less: state = INGAME_LESS; break;
-                case LabelIdState::Ingame_More: state = INGAME_MORE; break;
-                case LabelIdState::Playable: state = PLAYABLE; break;
-                default: break;
-                }
-            }
-        }
+        const auto state = get_state(app.child("labels"));
         const auto updated_at = app.child("updated_at").text().as_llong();
 
         // Check if app missing a status label
@@ -111,24 +130,134 @@ bool load_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
             LOG_WARN_IF(emuenv.cfg.log_compat_warn, "App with Title ID {} has an issue but no status label. Please check GitHub issue {} and request a status label be added.", title_id, issue_id);
 
         // Check if app already exists in compatibility database
-        if (gui.compat.app_compat_db.contains(title_id))
-            LOG_WARN_IF(emuenv.cfg.log_compat_warn, "App with Title ID {} already exists in compatibility database. Please check and close GitHub issue {}.", title_id, gui.compat.app_compat_db[title_id].issue_id);
+        const auto key = make_key(title_id);
+        if (entries.contains(key))
+            LOG_WARN_IF(emuenv.cfg.log_compat_warn, "App with Title ID {} already exists in compatibility database. Please check and close GitHub issue {}.", title_id, entries[key].issue_id);
+
+        CompatDbEntry entry{};
+        std::memcpy(entry.title_id, key.data(), key.size());
+        entry.issue_id = issue_id;
+        entry.state = state;
+        entry.updated_at = updated_at;
+        entries[key] = entry;
+    }
+
+    CompatDbHeader header{};
+    header.magic = COMPAT_DB_MAGIC;
+    header.version = COMPAT_DB_BINARY_VERSION;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    const std::string updated_at = compatibility.attribute("db_updated_at").as_string();
+    std::memcpy(header.db_updated_at, updated_at.data(), std::min(updated_at.size(), sizeof(header.db_updated_at) - 1));
+
+    // written next to the table then renamed, the table is never seen half written
+    const auto new_db_path = fs::path(db_path).replace_extension(".tmp");
+    {
+        fs::ofstream file(new_db_path, std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &[key, entry] : entries)
+            file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+        if (!file) {
+            LOG_ERROR("Could not write the compatibility database {}", new_db_path.string());
+            file.close();
+            fs::remove(new_db_path);
+            return false;
+        }
+    }
+    fs::rename(new_db_path, db_path);
+
+    return true;
+}
+
+static const CompatDbHeader *get_header(const MappedFile &db) {
+    if (db.size() < sizeof(CompatDbHeader))
+        return nullptr;
+
+    const auto header = reinterpret_cast<const CompatDbHeader *>(db.data());
+    if ((header->magic != COMPAT_DB_MAGIC) || (header->version != COMPAT_DB_BINARY_VERSION) || (db.size() < sizeof(CompatDbHeader) + header->entry_count * sizeof(CompatDbEntry)))
+        return nullptr;
+
+    return header;
+}
+
+std::optional<Compatibility> find_app_compat(CompatState &compat, const std::string &title_id) {
+    const std::lock_guard<std::mutex> lock(compat.app_compat_db_mutex);
+    if (!compat.app_compat_db.is_open())
+        return std::nullopt;
+
+    const auto key = make_key(title_id);
+    const auto entries = reinterpret_cast<const CompatDbEntry *>(compat.app_compat_db.data() + sizeof(CompatDbHeader));
+    const auto entries_end = entries + compat.app_compat_count;
+    const auto entry = std::lower_bound(entries, entries_end, key, [](const CompatDbEntry &entry, const CompatDbKey &key) {
+        return std::memcmp(entry.title_id, key.data(), key.size()) < 0;
+    });
+    if ((entry == entries_end) || (std::memcmp(entry->title_id, key.data(), key.size()) != 0))
+        return std::nullopt;
+
+    return Compatibility{ entry->issue_id, static_cast<CompatibilityState>(entry->state), static_cast<time_t>(entry->updated_at) };
+}
+
+static void close_app_compat_db(CompatState &compat) {
+    const std::lock_guard<std::mutex> lock(compat.app_compat_db_mutex);
+    compat.app_compat_db.close();
+    compat.app_compat_count = 0;
+}
+
+bool load_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
+    const auto app_compat_db_path = emuenv.cache_path / "app_compat_db.bin";
+
+    // the xml downloaded before the binary table existed is converted once
+    const auto old_app_compat_db_path = emuenv.cache_path / "app_compat_db.xml";
+    if (!fs::exists(app_compat_db_path) && fs::exists(old_app_compat_db_path)) {
+        if (convert_app_compat_db(emuenv, old_app_compat_db_path, app_compat_db_path))
+            fs::remove(old_app_compat_db_path);
+    }
 
-        gui.compat.app_compat_db[title_id] = { issue_id, state, updated_at };
+    if (!fs::exists(app_compat_db_path)) {
+        LOG_WARN("Compatibility database not found at {}.", app_compat_db_path.string());
+        return false;
+    }
+
+    MappedFile db;
+    const CompatDbHeader *header = db.open(app_compat_db_path) ? get_header(db) : nullptr;
+    if (!header) {
+        LOG_WARN("Compatibility database {} is outdated, download it again.", app_compat_db_path.string());
+        db.close();
+        fs::remove(app_compat_db_path);
+        db_updated_at.clear();
+        return update_app_compat_db(gui, emuenv);
+    }
+
+    // Check if compatibility database is up to date in first load
+    if (db_updated_at.empty()) {
+        db_updated_at = std::string(header->db_updated_at, strnlen(header->db_updated_at, sizeof(header->db_updated_at)));
+        db.close();
+        if (update_app_compat_db(gui, emuenv))
+            return true;
+        if (!db.open(app_compat_db_path) || !(header = get_header(db)))
+            return false;
+    }
+
+    // the entries are only read when an app is looked up
+    {
+        const std::lock_guard<std::mutex> lock(gui.compat.app_compat_db_mutex);
+        gui.compat.app_compat_count = header->entry_count;
+        gui.compat.app_compat_db = std::move(db);
     }
 
     // Update compatibility status of all user apps
-    for (auto &app : gui.app_selector.user_apps)
-        app.compat = gui.compat.app_compat_db.contains(app.title_id) ? gui.compat.app_compat_db[app.title_id].state : CompatibilityState::UNKNOWN;
+    for (auto &app : gui.app_selector.user_apps) {
+        const auto compat = find_app_compat(gui.compat, app.title_id);
+        app.compat = compat ? compat->state : CompatibilityState::UNKNOWN;
+    }
 
-    return !gui.compat.app_compat_db.empty();
+    return gui.compat.app_compat_count > 0;
 }
 
 static const std::string latest_link = "https://api.github.com/repos/Vita3K/compatibility/releases/latest";
 static const std::string app_compat_db_link = "https://github.com/Vita3K/compatibility/releases/download/compat_db/app_compat_db.xml";
 
 bool update_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
-    const auto app_compat_db_path = emuenv.cache_path / "app_compat_db.xml";
+    const auto app_compat_db_path = emuenv.cache_path / "app_compat_db.bin";
     gui.info_message.function = SPDLOG_FUNCTION;
 
     auto &lang = gui.lang.compat_db;
@@ -160,14 +289,16 @@ bool update_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
         return false;
     }
 
-    // Rename new database to replace old database
-    fs::rename(new_app_compat_db_path, app_compat_db_path);
-
     const auto old_db_updated_at = db_updated_at;
-    const auto old_compat_db_count = gui.compat.app_compat_db.size();
+    const auto old_compat_db_count = gui.compat.app_compat_count;
     db_updated_at = updated_at;
 
-    gui.compat.compat_db_loaded = load_app_compat_db(gui, emuenv);
+    // the old table must be unmapped to be replaced
+    close_app_compat_db(gui.compat);
+    const auto converted = convert_app_compat_db(emuenv, new_app_compat_db_path, app_compat_db_path);
+    fs::remove(new_app_compat_db_path);
+
+    gui.compat.compat_db_loaded = converted && load_app_compat_db(gui, emuenv);
     if (!gui.compat.compat_db_loaded) {
         gui.info_message.level = spdlog::level::err;
         gui.info_message.msg = fmt::format(fmt::runtime(lang["load_failed"].c_str()), updated_at);
@@ -178,13 +309,13 @@ bool update_app_compat_db(GuiState &gui, EmuEnvState &emuenv) {
     gui.info_message.level = spdlog::level::info;
 
     if (compat_db_exist) {
-        const auto dif = static_cast<int32_t>(gui.compat.app_compat_db.size() - old_compat_db_count);
+        const auto dif = static_cast<int32_t>(gui.compat.app_compat_count - old_compat_db_count);
         if (!old_db_updated_at.empty() && dif > 0)
-            gui.info_message.msg = fmt::format(fmt::runtime(lang["new_app_listed"].c_str()), old_db_updated_at, db_updated_at, dif, gui.compat.app_compat_db.size());
+            gui.info_message.msg = fmt::format(fmt::runtime(lang["new_app_listed"].c_str()), old_db_updated_at, db_updated_at, dif, gui.compat.app_compat_count);
         else
-            gui.info_message.msg = fmt::format(fmt::runtime(lang["app_listed"].c_str()), old_db_updated_at, db_updated_at, gui.compat.app_compat_db.size());
+            gui.info_message.msg = fmt::format(fmt::runtime(lang["app_listed"].c_str()), old_db_updated_at, db_updated_at, gui.compat.app_compat_count);
     } else
-        gui.info_message.msg = fmt::format(fmt::runtime(lang["download_app_listed"].c_str()), db_updated_at, gui.compat.app_compat_db.size());
+        gui.info_message.msg = fmt::format(fmt::runtime(lang["download_app_listed"].c_str()), db_updated_at, gui.compat.app_compat_count);
 
     return true;
 }
@@ -28,11 +28,22 @@ enum ModulesMode {
     MANUAL
 };
 
+enum FramePacing {
+    // a few frames in flight, the best present mode available
+    FRAME_PACING_DEFAULT,
+    // less frames in flight, wait for the previous frame to be presented before starting the next one
+    FRAME_PACING_LOW_LATENCY,
+    // more frames in flight and swapchain images, never wait for the display
+    FRAME_PACING_THROUGHPUT,
+};
+
 enum PerfomanceOverleyDetail {
     MINIMUM,
     LOW,
     MEDIUM,
     MAXIMUM,
+    // maximum with the frame time breakdown and the lows
+    DETAILED,
 };
 
 enum PerfomanceOverleyPosition {
@@ -53,6 +64,8 @@ enum PerfomanceOverleyPosition {
     code(bool, "gdbstub", false, gdbstub)                                                               \
     code(bool, "log-active-shaders", false, log_active_shaders)                                         \
     code(bool, "log-uniforms", false, log_uniforms)                                                     \
+    code(bool, "guest-profiler", false, guest_profiler)                                                 \
+    code(bool, "hle-profiler", false, hle_profiler)                                                     \
     code(bool, "log-compat-warn", false, log_compat_warn)                                               \
     code(bool, "validation-layer", true, validation_layer)                                              \
     code(bool, "pstv-mode", false, pstv_mode)                                                           \
@@ -70,24 +83,43 @@ enum PerfomanceOverleyPosition {
     code(int, "gpu-idx", 0, gpu_idx)                                                                    \
     code(bool, "high-accuracy", true, high_accuracy)                                                    \
     code(int, "resolution-multiplier", 1, resolution_multiplier)                                        \
+    code(bool, "dynamic-resolution", false, dynamic_resolution)                                         \
+    code(int, "dynamic-resolution-min", 1, dynamic_resolution_min)                                      \
+    code(int, "dynamic-resolution-target-fps", 60, dynamic_resolution_target_fps)                       \
+    code(bool, "thermal-governor", true, thermal_governor)                                              \
     code(bool, "disable-surface-sync", true, disable_surface_sync)                                      \
     code(std::string, "screen-filter", "Bilinear", screen_filter)                                       \
     code(bool, "v-sync", true, v_sync)                                                                  \
+    code(int, "frame-pacing", static_cast<int>(FRAME_PACING_DEFAULT), frame_pacing)                     \
+    code(int, "frames-in-flight", 0, frames_in_flight)                                                  \
+    code(bool, "auto-frameskip", false, auto_frameskip)                                                 \
+    code(int, "auto-frameskip-max", 2, auto_frameskip_max)                                              \
     code(int, "anisotropic-filtering", 1, anisotropic_filtering)                                        \
     code(bool, "texture-cache", true, texture_cache)                                                    \
     code(bool, "show-compile-shaders", true, show_compile_shaders)                                      \
+    code(bool, "async-pipeline-compilation", false, async_pipeline_compilation)                         \
+    code(bool, "spirv-optimization", false, spirv_optimization)                                         \
     code(bool, "hashless-texture-cache", false, hashless_texture_cache)                                 \
+    code(bool, "texture-write-tracking", false, texture_write_tracking)                                 \
+    code(bool, "draw-batching", false, draw_batching)                                                   \
+    code(bool, "rebar-mapped-memory", false, rebar_mapped_memory)                                       \
     code(bool, "import-textures", false, import_textures)                                               \
     code(bool, "export-textures", false, export_textures)                                               \
     code(bool, "export-as-png", true, export_as_png)                                                    \
     code(bool, "boot-apps-full-screen", false, boot_apps_full_screen)                                   \
     code(std::string, "audio-backend", "SDL", audio_backend)                                            \
+    code(int, "sdl-audio-latency", 40, sdl_audio_latency)                                               \
+    code(int, "cubeb-audio-latency", 0, cubeb_audio_latency)                                            \
+    code(bool, "audio-time-stretch", false, audio_time_stretch)                                         \
+    code(bool, "video-hw-decoding", true, video_hw_decoding)                                            \
     code(bool, "ngs-enable", true, ngs_enable)                                                          \
     code(int, "sys-button", static_cast<int>(SCE_SYSTEM_PARAM_ENTER_BUTTON_CROSS), sys_button)          \
     code(int, "sys-lang", static_cast<int>(SCE_SYSTEM_PARAM_LANG_ENGLISH_US), sys_lang)                 \
     code(int, "sys-date-format", (int)SCE_SYSTEM_PARAM_DATE_FORMAT_MMDDYYYY, sys_date_format)           \
     code(int, "sys-time-format", (int)SCE_SYSTEM_PARAM_TIME_FORMAT_12HOUR, sys_time_format)             \
     code(int, "cpu-pool-size", 10, cpu_pool_size)                                                       \
+    code(bool, "host-thread-priority", false, host_thread_priority)                                     \
+    code(bool, "host-thread-affinity", false, host_thread_affinity)                                     \
     code(int, "modules-mode", static_cast<int>(ModulesMode::AUTOMATIC), modules_mode)                   \
     code(int, "delay-background", 4, delay_background)                                                  \
     code(int, "delay-start", 10, delay_start)                                                           \
@@ -100,9 +132,12 @@ enum PerfomanceOverleyPosition {
     code(bool, "wait-for-debugger", false, wait_for_debugger)                                           \
     code(bool, "color-surface-debug", false, color_surface_debug)                                       \
     code(bool, "show-touchpad-cursor", true, show_touchpad_cursor)                                      \
+    code(bool, "low-latency-input", false, low_latency_input)                                           \
     code(bool, "performance-overlay", false, performance_overlay)                                       \
     code(int, "perfomance-overlay-detail", static_cast<int>(MINIMUM), performance_overlay_detail)       \
     code(int, "perfomance-overlay-position", static_cast<int>(TOP_LEFT), performance_overlay_position)  \
+    code(int, "stutter-threshold-ms", 100, stutter_threshold_ms)                                        \
+    code(int, "turbo-speed", 4, turbo_speed)                                                            \
     code(int, "keyboard-button-select", 229, keyboard_button_select)                                    \
     code(int, "keyboard-button-start", 40, keyboard_button_start)                                       \
     code(int, "keyboard-button-up", 82, keyboard_button_up)                                             \
@@ -131,6 +166,9 @@ enum PerfomanceOverleyPosition {
     code(int, "keyboard-gui-toggle-gui", 10, keyboard_gui_toggle_gui)                                   \
     code(int, "keyboard-gui-fullscreen", 68, keyboard_gui_fullscreen)                                   \
     code(int, "keyboard-gui-toggle-touch", 23, keyboard_gui_toggle_touch)                               \
+    code(int, "keyboard-gui-toggle-turbo", 43, keyboard_gui_toggle_turbo)                               \
+    code(int, "keyboard-gui-save-checkpoint", 62, keyboard_gui_save_checkpoint)                         \
+    code(int, "keyboard-gui-load-checkpoint", 65, keyboard_gui_load_checkpoint)                         \
     code(std::string, "user-id", std::string{}, user_id)                                                \
     code(bool, "user-auto-connect", false, auto_user_login)                                             \
     code(bool, "display-info-message", true, display_info_message)                                      \
@@ -138,6 +176,13 @@ enum PerfomanceOverleyPosition {
     code(bool, "check-for-updates", true, check_for_updates)                                            \
     code(bool, "asia-font-support", false, asia_font_support)                                           \
     code(bool, "shader-cache", true, shader_cache)                                                      \
+    code(std::string, "shared-shader-cache-path", std::string{}, shared_shader_cache_path)              \
+    code(bool, "jit-precompile", true, jit_precompile)                                                  \
+    code(bool, "hle-hot-routines", false, hle_hot_routines)                                             \
+    code(bool, "host-display-callbacks", true, host_display_callbacks)                                  \
+    code(bool, "huge-pages", false, huge_pages)                                                         \
+    code(int, "delay-spin-us", 200, delay_spin_us)                                                      \
+    code(bool, "guest-scheduler", false, guest_scheduler)                                               \
     code(bool, "spirv-shader", false, spirv_shader)                                                     \
     code(uint64_t, "current-ime-lang", 4, current_ime_lang)                                             \
     code(int, "psn-status", static_cast<int>(SCE_NP_SERVICE_STATE_UNKNOWN), psn_status)                 \
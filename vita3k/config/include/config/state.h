@@ -83,6 +83,24 @@ private:
         load_config = rhs.load_config;
         fullscreen = rhs.fullscreen;
         console = rhs.console;
+        mount_archive = rhs.mount_archive;
+        boot_profile_path = rhs.boot_profile_path;
+        trace_log_path = rhs.trace_log_path;
+        lock_report_path = rhs.lock_report_path;
+        io_trace_path = rhs.io_trace_path;
+        record_path = rhs.record_path;
+        exit_after_boot = rhs.exit_after_boot;
+        headless = rhs.headless;
+        exit_after_frames = rhs.exit_after_frames;
+        benchmark_frames = rhs.benchmark_frames;
+        benchmark_input_path = rhs.benchmark_input_path;
+        benchmark_report_path = rhs.benchmark_report_path;
+        gxm_capture_path = rhs.gxm_capture_path;
+        gxm_capture_start_frame = rhs.gxm_capture_start_frame;
+        gxm_capture_frames = rhs.gxm_capture_frames;
+        color_surface_debug_start_frame = rhs.color_surface_debug_start_frame;
+        color_surface_debug_frames = rhs.color_surface_debug_frames;
+        color_surface_debug_targets = rhs.color_surface_debug_targets;
         app_args = rhs.app_args;
         load_app_list = rhs.load_app_list;
         self_path = rhs.self_path;
@@ -97,6 +115,8 @@ public:
     std::optional<std::string> pkg_path;
     std::optional<std::string> pkg_zrif;
     std::optional<std::string> pup_path;
+    // merge the shader cache of this instance into the shared one then quit
+    bool merge_shader_cache = false;
 
     // Setting not present in the YAML file
     fs::path config_path = {};
@@ -107,6 +127,38 @@ public:
     bool fullscreen = false;
     bool console = false;
     bool load_app_list = false;
+    bool mount_archive = false;
+    // the timeline of the boot of the app is saved there as a Chrome trace when it is not empty
+    std::string boot_profile_path;
+    // the binary trace of the imports and file accesses is saved there at the exit when it is not empty, see vita3k-trace
+    std::string trace_log_path;
+    // the wait and hold times of the profiled mutexes for each call site are saved there at the exit when it is not empty
+    std::string lock_report_path;
+    // the trace of the calls to the io layer is saved there at the exit when it is not empty, see vita3k-io-bench
+    std::string io_trace_path;
+    // the presented frames and the mixed audio are recorded to this video file when it is not empty
+    std::string record_path;
+    // quit once the app has displayed its first frame
+    bool exit_after_boot = false;
+    // run the app without window, gui or audio device, the frames are rendered but not presented
+    bool headless = false;
+    // quit once the app has rendered this many frames, 0 to run until the app exits
+    uint64_t exit_after_frames = 0;
+    // frames measured by the benchmark, 0 when not running one
+    uint64_t benchmark_frames = 0;
+    // inputs replayed during the benchmark, the host inputs are used when it is empty
+    std::string benchmark_input_path;
+    std::string benchmark_report_path;
+    // the renderer commands are captured to this file for vita3k-replay when it is not empty
+    std::string gxm_capture_path;
+    // frames to skip before the capture starts, then frames captured
+    uint32_t gxm_capture_start_frame = 0;
+    uint32_t gxm_capture_frames = 1;
+    // with color-surface-debug, frames to skip before the surfaces are saved, then frames saved (0 for all of them)
+    uint32_t color_surface_debug_start_frame = 0;
+    uint32_t color_surface_debug_frames = 0;
+    // hexadecimal addresses of the color surfaces saved, all of them when it is empty
+    std::vector<std::string> color_surface_debug_targets;
 
     /**
      * @brief Config struct for per-app configurable settings
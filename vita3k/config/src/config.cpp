@@ -148,12 +148,22 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         ->default_str("")->group("Input");
     input->add_option("--load-app-list,-a", command_line.load_app_list, "Starts the emulator with load app list.")
        ->default_val(false)->group("Input");
+    input->add_flag("--mount-archive,-M", command_line.mount_archive, "Run the app of the .vpk/.zip content path from the archive, without installing it.")
+       ->default_val(false)->group("Input");
     input->add_option("--self,-S", command_line.self_path, "Path to the self to run inside Title ID")
         ->default_str("eboot.bin")->group("Input");
     input->add_option("--installed-path,-r", command_line.run_app_path, "Path to the installed app to run")
         ->default_str({})->check(CLI::IsMember(get_file_set(fs::path(cfg.pref_path) / "ux0/app")))->group("Input");
+    input->add_option("--benchmark", command_line.benchmark_frames, "Run the app headless for the given number of frames without vblank pacing and write a JSON report of the frame times")
+        ->group("Input");
+    input->add_option("--benchmark-input", command_line.benchmark_input_path, "Input script replayed during the benchmark, each line is a frame followed by the inputs held from it:\n120 buttons=cross,up lstick=0.5,-1 front=960,544")
+        ->group("Input");
+    input->add_option("--benchmark-report", command_line.benchmark_report_path, "Path of the benchmark report, benchmark.json in the log folder by default")
+        ->group("Input");
     input->add_option("--recompile-shader,-s", command_line.recompile_shader_path, "Recompile the given PS Vita shader (GXP format) to SPIR_V / GLSL and quit")
         ->default_str({})->group("Input");
+    input->add_flag("--merge-shader-cache", command_line.merge_shader_cache, "Add the shaders and pipelines cached by this instance to the shared shader cache given with --shared-shader-cache-path and quit\nIf it fails to replace the shared cache, run it again once no instance uses it")
+        ->group("Input");
     input->add_option("--deleted-id,-d", command_line.delete_title_id, "Title ID of installed app to delete")
         ->default_str({})->check(CLI::IsMember(get_file_set(fs::path(cfg.pref_path) / "ux0/app")))->group("Input");
     input->add_option("--firmware", command_line.pup_path, "Path to the firmware file (.pup extension) to install");
@@ -171,6 +181,16 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         ->ignore_case()->check(CLI::IsMember(std::set<std::string>{ "OpenGL", "Vulkan" }))->group("Vita Emulation");
     config->add_flag("--" + cfg[e_color_surface_debug] + ",-C", command_line.color_surface_debug, "Save color surfaces")
         ->group("Vita Emulation");
+    config->add_option("--color-surface-debug-start", command_line.color_surface_debug_start_frame, "Number of frames rendered before the color surfaces are saved")
+        ->group("Vita Emulation");
+    config->add_option("--color-surface-debug-frames", command_line.color_surface_debug_frames, "Number of frames whose color surfaces are saved, all of them by default")
+        ->group("Vita Emulation");
+    config->add_option("--color-surface-debug-targets", command_line.color_surface_debug_targets, "Only save the color surfaces at the given addresses, in hexadecimal.\nSeparate by commas to specify multiple surfaces. Example: --color-surface-debug-targets 81000000,81200000")
+        ->delimiter(',')->group("Vita Emulation");
+    config->add_option("--record", command_line.record_path, "Record the gameplay to the given video file (.mp4, .mkv), encoded with the GPU of the host when it has a video encoder.\nOnly supported with the Vulkan renderer")
+        ->group("Vita Emulation");
+    config->add_option("--" + cfg[e_shared_shader_cache_path], command_line.shared_shader_cache_path, "Read-only shader cache shared by several instances, the shaders missing from it are still cached by each instance.\nThey are added to it with --merge-shader-cache")
+        ->group("Vita Emulation");
     config->add_option("--config-location,-c", command_line.config_path, "Get a configuration file from a given location. If a filename is given, it must end with \".yml\", otherwise it will be assumed to be a directory. \nDefault loaded: <Vita3K>/config.yml \nDefaults: <Vita3K>/data/config/default.yml")
         ->group("YML");
     config->add_flag("!--keep-config,!-w", command_line.overwrite_config, "Do not modify the configuration file after loading.")
@@ -189,6 +209,28 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         ->group("Logging");
     config->add_flag("--" + cfg[e_log_uniforms] + ",-U", command_line.log_uniforms, "Log Uniforms")
         ->group("Logging");
+    config->add_flag("--" + cfg[e_guest_profiler] + ",-P", command_line.guest_profiler, "Sample the guest threads and write a flamegraph report when the app exits")
+        ->group("Logging");
+    config->add_option("--boot-profile", command_line.boot_profile_path, "Save the timeline of the boot of the app to the given file, as a Chrome trace (chrome://tracing, Perfetto)")
+        ->group("Logging");
+    config->add_option("--trace-log", command_line.trace_log_path, "Record the imports and file accesses to a compact binary trace saved to the given file at the exit, to read with vita3k-trace")
+        ->group("Logging");
+    config->add_option("--lock-report", command_line.lock_report_path, "Record the wait and hold times of the emulator mutexes for each call site, saved to the given file at the exit")
+        ->group("Logging");
+    config->add_option("--io-trace", command_line.io_trace_path, "Record the file and directory accesses of the app to a binary trace saved to the given file at the exit, to replay with vita3k-io-bench")
+        ->group("Logging");
+    config->add_flag("--exit-after-boot", command_line.exit_after_boot, "Quit once the app displays its first frame, the boot time is logged before")
+        ->group("Logging");
+    config->add_flag("--headless", command_line.headless, "Run the app given with -r or a .vpk without window, GUI or audio device, for automated testing.\nThe frames are rendered with Vulkan but not presented")
+        ->group("Testing");
+    config->add_option("--exit-after-frames", command_line.exit_after_frames, "Quit once the app has rendered the given number of frames, the frame rate is logged before")
+        ->group("Testing");
+    config->add_option("--gxm-capture", command_line.gxm_capture_path, "Capture the renderer commands and the guest memory they use to the given file, to run them again with vita3k-replay")
+        ->group("Testing");
+    config->add_option("--gxm-capture-start", command_line.gxm_capture_start_frame, "Number of frames rendered before the capture starts")
+        ->group("Testing");
+    config->add_option("--gxm-capture-frames", command_line.gxm_capture_frames, "Number of frames captured, 1 by default")
+        ->check(CLI::PositiveNumber)->group("Testing");
     // clang-format on
 
     // Parse the inputs
@@ -214,6 +256,12 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         cfg.recompile_shader_path = std::move(command_line.recompile_shader_path);
         return QuitRequested;
     }
+    if (command_line.merge_shader_cache) {
+        if (!command_line.shared_shader_cache_path.empty())
+            cfg.shared_shader_cache_path = command_line.shared_shader_cache_path;
+        cfg.merge_shader_cache = true;
+        return QuitRequested;
+    }
     if (command_line.delete_title_id.has_value()) {
         cfg.delete_title_id = std::move(command_line.delete_title_id);
         return QuitRequested;
@@ -241,6 +289,15 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         return InitConfigFailed;
     }
 
+    // a benchmark is a headless run, ended once the frames are measured
+    if (command_line.benchmark_frames > 0)
+        command_line.headless = true;
+
+    if (command_line.headless && !command_line.run_app_path && !command_line.content_path) {
+        LOG_ERROR("Headless mode needs an app to run, given with -r or as a .vpk.");
+        return InitConfigFailed;
+    }
+
     // Get LLE modules from the command line, otherwise get the modules from the YML file
     if (!lle_modules.empty()) {
         if (command_line.load_config) {
@@ -267,6 +324,7 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         LOG_INFO("{}: {}", cfg[e_log_level], cfg.log_level);
         LOG_INFO_IF(cfg.log_active_shaders, "{}: enabled", cfg[e_log_active_shaders]);
         LOG_INFO_IF(cfg.log_uniforms, "{}: enabled", cfg[e_log_uniforms]);
+        LOG_INFO_IF(cfg.guest_profiler, "{}: enabled", cfg[e_guest_profiler]);
     }
     // Save any changes made in command-line arguments
     if (cfg.overwrite_config || !fs::exists(check_path(cfg.config_path))) {
@@ -45,7 +45,13 @@ typedef void *ExclusiveMonitorPtr;
 struct CPUProtocolBase {
     virtual void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) = 0;
     virtual Address get_watch_memory_addr(Address addr) = 0;
+    // page table where the pages of the watched ranges are null, null if all the memory is watched
+    virtual uint8_t **get_watch_page_table() = 0;
     virtual ExclusiveMonitorPtr get_exlusive_monitor() = 0;
+    // called by the jit each time it translates a new block
+    virtual void block_translated(Address pc, bool thumb) = 0;
+    // the jit stops before running the instruction at a breakpoint, the code itself is left untouched
+    virtual bool is_breakpoint(Address addr) = 0;
     virtual ~CPUProtocolBase() = default;
 };
 
@@ -113,6 +119,14 @@ enum class CPUBackend {
     Unicorn,
 };
 
+// optimizations trading accuracy for speed, only enabled for the titles known to work with them
+enum CPUUnsafeOptimization : uint32_t {
+    CPU_UNSAFE_UNFUSE_FMA = 1 << 0,
+    CPU_UNSAFE_REDUCED_ERROR_FP = 1 << 1,
+    CPU_UNSAFE_INACCURATE_NAN = 1 << 2,
+    CPU_UNSAFE_IGNORE_GLOBAL_MONITOR = 1 << 3,
+};
+
 union DoubleReg {
     double d;
     float f[2];
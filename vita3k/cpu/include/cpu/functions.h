@@ -26,7 +26,7 @@
 #include <functional>
 #include <stack>
 
-CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol);
+CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, uint32_t unsafe_optimizations, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol);
 int run(CPUState &state);
 int step(CPUState &state);
 void stop(CPUState &state);
@@ -47,8 +47,12 @@ void write_tpidruro(CPUState &state, uint32_t value);
 bool is_thumb_mode(CPUState &state);
 CPUContext save_context(CPUState &state);
 void load_context(CPUState &state, CPUContext ctx);
+// faster than save_context and load_context, for the context switches done by a call
+void save_callee_saved_context(CPUState &state, CPUContext &ctx);
+void load_callee_saved_context(CPUState &state, const CPUContext &ctx);
 std::size_t get_processor_id(CPUState &state);
 void invalidate_jit_cache(CPUState &state, Address start, size_t length);
+void translate_block(CPUState &state, Address pc, bool thumb);
 
 uint32_t read_fpscr(CPUState &state);
 void write_fpscr(CPUState &state, uint32_t value);
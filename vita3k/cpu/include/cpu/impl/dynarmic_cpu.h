@@ -25,6 +25,7 @@
 #include <cpu/functions.h>
 #include <cpu/impl/unicorn_cpu.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 
@@ -49,12 +50,28 @@ class DynarmicCPU : public CPUInterface {
 
     bool log_mem = false;
     bool log_code = false;
+    // page table used while logging accesses to some watched ranges only
+    uint8_t **watch_page_table = nullptr;
     bool cpu_opt;
+    // mask of CPUUnsafeOptimization, only used with cpu_opt
+    uint32_t unsafe_optimizations;
+
+    struct PendingInvalidation {
+        Address start;
+        size_t length;
+        PendingInvalidation *next;
+    };
+
+    // ranges invalidated from any thread, they are pushed without locking
+    // and applied by the thread running this cpu before it enters the jit again
+    std::atomic<PendingInvalidation *> pending_invalidations = nullptr;
+    std::atomic<bool> running = false;
 
     std::unique_ptr<Dynarmic::A32::Jit> make_jit();
+    void apply_pending_invalidations();
 
 public:
-    DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt);
+    DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt, uint32_t unsafe_optimizations);
     ~DynarmicCPU() override;
     int run() override;
     void stop() override;
@@ -85,6 +102,8 @@ public:
 
     CPUContext save_context() override;
     void load_context(CPUContext context) override;
+    void save_callee_saved_context(CPUContext &context) override;
+    void load_callee_saved_context(const CPUContext &context) override;
 
     bool is_thumb_mode() override;
     int step() override;
@@ -98,4 +117,5 @@ public:
 
     std::size_t processor_id() const override;
     void invalidate_jit_cache(Address start, size_t length) override;
+    void translate_block(Address pc, bool thumb) override;
 };
@@ -55,7 +55,12 @@ struct CPUInterface {
 
     virtual CPUContext save_context() = 0;
     virtual void load_context(CPUContext context) = 0;
+    // only the registers preserved across a call: r4-r11, sp, lr, pc, s16-s31 and the status registers
+    virtual void save_callee_saved_context(CPUContext &context) = 0;
+    virtual void load_callee_saved_context(const CPUContext &context) = 0;
     virtual void invalidate_jit_cache(Address start, size_t length) = 0;
+    // translate the block at pc without running it, the cpu must not be running
+    virtual void translate_block(Address pc, bool thumb) = 0;
 
     virtual bool is_thumb_mode() = 0;
     virtual int step() = 0;
@@ -97,7 +97,10 @@ public:
 
     CPUContext save_context() override;
     void load_context(CPUContext context) override;
+    void save_callee_saved_context(CPUContext &context) override;
+    void load_callee_saved_context(const CPUContext &context) override;
     void invalidate_jit_cache(Address start, size_t length) override;
+    void translate_block(Address pc, bool thumb) override;
 
     bool hit_breakpoint() override;
     void trigger_breakpoint() override;
@@ -46,7 +46,7 @@ SceUID get_thread_id(CPUState &state) {
     return state.thread_id;
 }
 
-CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol) {
+CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, uint32_t unsafe_optimizations, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol) {
     CPUStatePtr state(new CPUState(), delete_cpu_state);
     state->mem = &mem;
     state->protocol = protocol;
@@ -67,7 +67,7 @@ CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::si
     switch (backend) {
     case CPUBackend::Dynarmic: {
         Dynarmic::ExclusiveMonitor *monitor = reinterpret_cast<Dynarmic::ExclusiveMonitor *>(protocol->get_exlusive_monitor());
-        state->cpu = std::make_unique<DynarmicCPU>(state.get(), processor_id, monitor, cpu_opt);
+        state->cpu = std::make_unique<DynarmicCPU>(state.get(), processor_id, monitor, cpu_opt, unsafe_optimizations);
         break;
     }
     case CPUBackend::Unicorn: {
@@ -193,6 +193,10 @@ void invalidate_jit_cache(CPUState &state, Address start, size_t length) {
     state.cpu->invalidate_jit_cache(start, length);
 }
 
+void translate_block(CPUState &state, Address pc, bool thumb) {
+    state.cpu->translate_block(pc, thumb);
+}
+
 std::string disassemble(CPUState &state, uint64_t at, bool thumb, uint16_t *insn_size) {
     MemState &mem = *state.mem;
     const uint8_t *const code = Ptr<const uint8_t>(static_cast<Address>(at)).get(mem);
@@ -213,6 +217,14 @@ void load_context(CPUState &state, CPUContext ctx) {
     state.cpu->load_context(ctx);
 }
 
+void save_callee_saved_context(CPUState &state, CPUContext &ctx) {
+    state.cpu->save_callee_saved_context(ctx);
+}
+
+void load_callee_saved_context(CPUState &state, const CPUContext &ctx) {
+    state.cpu->load_callee_saved_context(ctx);
+}
+
 uint32_t stack_alloc(CPUState &state, size_t size) {
     const uint32_t new_sp = read_sp(state) - size;
     write_sp(state, new_sp);
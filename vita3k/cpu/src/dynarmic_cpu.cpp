@@ -20,8 +20,11 @@
 #include <cpu/impl/dynarmic_cpu.h>
 #include <cpu/impl/interface.h>
 #include <cpu/state.h>
+#include <algorithm>
 #include <set>
+#include <utility>
 #include <util/log.h>
+#include <util/memory_accounting.h>
 
 #include <mem/ptr.h>
 
@@ -117,12 +120,28 @@ public:
         LOG_TRACE("{} ({}): {} {}", log_hex(self_), self.parent->thread_id, log_hex(address), disassembly);
     }
 
+    bool PreCodeReadHook(bool is_thumb, Dynarmic::A32::VAddr pc, Dynarmic::A32::IREmitter &ir) override {
+        if (!parent->protocol->is_breakpoint(pc))
+            return true;
+
+        // end the block before the instruction, ExceptionRaised halts the jit with the pc on it
+        ir.ExceptionRaised(Dynarmic::A32::Exception::Breakpoint);
+        ir.SetTerm(Dynarmic::IR::Term::CheckHalt{ Dynarmic::IR::Term::ReturnToDispatch{} });
+        return false;
+    }
+
     void PreCodeTranslationHook(bool is_thumb, Dynarmic::A32::VAddr pc, Dynarmic::A32::IREmitter &ir) override {
+        parent->protocol->block_translated(pc, is_thumb);
         if (cpu->log_code) {
             ir.CallHostFunction(&TraceInstruction, ir.Imm64((uint64_t)this), ir.Imm64(pc), ir.Imm64(is_thumb));
         }
     }
 
+    // with a watch page table, the callbacks are also called for the addresses of the watched pages outside of the watched ranges
+    bool is_watched(Dynarmic::A32::VAddr addr) const {
+        return cpu->log_mem && (!cpu->watch_page_table || parent->protocol->get_watch_memory_addr(addr) != 0);
+    }
+
     template <typename T>
     T MemoryRead(Dynarmic::A32::VAddr addr) {
         Ptr<T> ptr{ addr };
@@ -138,7 +157,7 @@ public:
         }
 
         T ret = *ptr.get(*parent->mem);
-        if (cpu->log_mem) {
+        if (is_watched(addr)) {
             LOG_TRACE("Read uint{}_t at address: 0x{:x}, val = 0x{:x}", sizeof(T) * 8, addr, ret);
         }
         return ret;
@@ -175,7 +194,7 @@ public:
         }
 
         *ptr.get(*parent->mem) = value;
-        if (cpu->log_mem) {
+        if (is_watched(addr)) {
             LOG_TRACE("Write uint{}_t at addr: 0x{:x}, val = 0x{:x}", sizeof(T) * 8, addr, value);
         }
     }
@@ -211,7 +230,7 @@ public:
         }
 
         auto result = Ptr<T>(addr).atomic_compare_and_swap(*parent->mem, value, expected);
-        if (cpu->log_mem) {
+        if (is_watched(addr)) {
             LOG_TRACE("Write uint{}_t at addr: 0x{:x}, val = 0x{:x}, expected = 0x{:x}", sizeof(T) * 8, addr, value, expected);
         }
         return result;
@@ -298,7 +317,11 @@ std::unique_ptr<Dynarmic::A32::Jit> DynarmicCPU::make_jit() {
     Dynarmic::A32::UserConfig config;
     config.arch_version = Dynarmic::A32::ArchVersion::v7;
     config.callbacks = cb.get();
-    if (parent->mem->use_page_table) {
+    watch_page_table = log_mem ? parent->protocol->get_watch_page_table() : nullptr;
+    if (watch_page_table && cpu_opt) {
+        config.page_table = reinterpret_cast<decltype(config.page_table)>(watch_page_table);
+        config.absolute_offset_page_table = true;
+    } else if (parent->mem->use_page_table) {
         config.page_table = (log_mem || !cpu_opt) ? nullptr : reinterpret_cast<decltype(config.page_table)>(parent->mem->page_table.get());
         config.absolute_offset_page_table = true;
     } else {
@@ -310,21 +333,39 @@ std::unique_ptr<Dynarmic::A32::Jit> DynarmicCPU::make_jit() {
     config.coprocessors[15] = cp15;
     config.processor_id = core_id;
     config.optimizations = cpu_opt ? Dynarmic::all_safe_optimizations : Dynarmic::no_optimizations;
+    if (cpu_opt && unsafe_optimizations) {
+        static constexpr std::array<std::pair<CPUUnsafeOptimization, Dynarmic::OptimizationFlag>, 4> unsafe_flags = { {
+            { CPU_UNSAFE_UNFUSE_FMA, Dynarmic::OptimizationFlag::Unsafe_UnfuseFMA },
+            { CPU_UNSAFE_REDUCED_ERROR_FP, Dynarmic::OptimizationFlag::Unsafe_ReducedErrorFP },
+            { CPU_UNSAFE_INACCURATE_NAN, Dynarmic::OptimizationFlag::Unsafe_InaccurateNaN },
+            { CPU_UNSAFE_IGNORE_GLOBAL_MONITOR, Dynarmic::OptimizationFlag::Unsafe_IgnoreGlobalMonitor },
+        } };
+        config.unsafe_optimizations = true;
+        for (const auto &[optimization, flag] : unsafe_flags) {
+            if (unsafe_optimizations & optimization)
+                config.optimizations = config.optimizations | flag;
+        }
+    }
 
     return std::make_unique<Dynarmic::A32::Jit>(config);
 }
 
-DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt)
+DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt, uint32_t unsafe_optimizations)
     : parent(state)
     , cb(std::make_unique<ArmDynarmicCallback>(*state, *this))
     , cp15(std::make_shared<ArmDynarmicCP15>())
     , monitor(monitor)
     , core_id(processor_id)
-    , cpu_opt(cpu_opt) {
+    , cpu_opt(cpu_opt)
+    , unsafe_optimizations(unsafe_optimizations) {
     jit = make_jit();
+    // the code cache is reserved when the jit is created, the host only commits the pages it writes
+    add_memory_usage(MemoryCategory::JitCode, Dynarmic::A32::UserConfig{}.code_cache_size);
 }
 
 DynarmicCPU::~DynarmicCPU() {
+    apply_pending_invalidations();
+    remove_memory_usage(MemoryCategory::JitCode, Dynarmic::A32::UserConfig{}.code_cache_size);
 }
 
 int DynarmicCPU::run() {
@@ -332,13 +373,19 @@ int DynarmicCPU::run() {
     break_ = false;
     exit_request = false;
     parent->svc_called = false;
+    running = true;
+    apply_pending_invalidations();
     jit->Run();
+    running = false;
     return halted;
 }
 
 int DynarmicCPU::step() {
     parent->svc_called = false;
+    running = true;
+    apply_pending_invalidations();
     jit->Step();
+    running = false;
     return 0;
 }
 
@@ -377,6 +424,9 @@ bool DynarmicCPU::get_log_mem() {
 
 void DynarmicCPU::stop() {
     exit_request = true;
+    // the halt flag is only set atomically, so this is safe from any thread
+    // if the jit is not running, the next run returns before running anything
+    jit->HaltExecution(Dynarmic::HaltReason::UserDefined5);
 }
 
 uint32_t DynarmicCPU::get_reg(uint8_t idx) {
@@ -460,6 +510,25 @@ void DynarmicCPU::load_context(CPUContext ctx) {
     jit->LoadContext(dctx);
 }
 
+void DynarmicCPU::save_callee_saved_context(CPUContext &ctx) {
+    // the registers are copied directly, without going through a whole context of the jit
+    const auto &regs = jit->Regs();
+    std::copy(regs.begin() + 4, regs.end(), ctx.cpu_registers.begin() + 4);
+    const auto &ext_regs = jit->ExtRegs();
+    memcpy(&ctx.fpu_registers[16], &ext_regs[16], sizeof(float) * 16);
+    ctx.cpsr = jit->Cpsr();
+    ctx.fpscr = jit->Fpscr();
+}
+
+void DynarmicCPU::load_callee_saved_context(const CPUContext &ctx) {
+    auto &regs = jit->Regs();
+    std::copy(ctx.cpu_registers.begin() + 4, ctx.cpu_registers.end(), regs.begin() + 4);
+    auto &ext_regs = jit->ExtRegs();
+    memcpy(&ext_regs[16], &ctx.fpu_registers[16], sizeof(float) * 16);
+    jit->SetCpsr(ctx.cpsr);
+    jit->SetFpscr(ctx.fpscr);
+}
+
 uint32_t DynarmicCPU::get_lr() {
     return jit->Regs()[14];
 }
@@ -481,7 +550,34 @@ std::size_t DynarmicCPU::processor_id() const {
 }
 
 void DynarmicCPU::invalidate_jit_cache(Address start, size_t length) {
-    jit->InvalidateCacheRange(start, length);
+    PendingInvalidation *const invalidation = new PendingInvalidation{ start, length, pending_invalidations.load(std::memory_order_relaxed) };
+    while (!pending_invalidations.compare_exchange_weak(invalidation->next, invalidation, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+
+    // the running thread applies the invalidation when the jit returns to run
+    // the halt flag is only set atomically, so this is safe from any thread
+    if (running)
+        jit->HaltExecution(Dynarmic::HaltReason::UserDefined7);
+}
+
+void DynarmicCPU::translate_block(Address pc, bool thumb) {
+    // the jit translates the block it enters before checking if a halt was requested,
+    // so the block is translated without running any of it
+    const Dynarmic::A32::Context context = jit->SaveContext();
+    set_pc(thumb ? (pc | 1) : pc);
+    jit->HaltExecution(Dynarmic::HaltReason::UserDefined6);
+    jit->Run();
+    jit->LoadContext(context);
+}
+
+void DynarmicCPU::apply_pending_invalidations() {
+    PendingInvalidation *invalidation = pending_invalidations.exchange(nullptr, std::memory_order_acquire);
+    while (invalidation) {
+        jit->InvalidateCacheRange(invalidation->start, invalidation->length);
+        PendingInvalidation *const next = invalidation->next;
+        delete invalidation;
+        invalidation = next;
+    }
 }
 
 // TODO: proper abstraction
@@ -386,10 +386,40 @@ void UnicornCPU::load_context(CPUContext ctx) {
     set_pc(ctx.thumb() ? ctx.get_pc() | 1 : ctx.get_pc());
 }
 
+void UnicornCPU::save_callee_saved_context(CPUContext &ctx) {
+    for (size_t i = 4; i < 12; i++) {
+        ctx.cpu_registers[i] = get_reg(i);
+    }
+    ctx.cpu_registers[13] = get_sp();
+    ctx.cpu_registers[14] = get_lr();
+    ctx.set_pc(is_thumb_mode() ? get_pc() | 1 : get_pc());
+
+    for (size_t i = 16; i < 32; i++) {
+        ctx.fpu_registers[i] = get_float_reg(i);
+    }
+}
+
+void UnicornCPU::load_callee_saved_context(const CPUContext &ctx) {
+    for (size_t i = 16; i < 32; i++) {
+        set_float_reg(i, ctx.fpu_registers[i]);
+    }
+
+    for (size_t i = 4; i < 12; i++) {
+        set_reg(i, ctx.cpu_registers[i]);
+    }
+    set_sp(ctx.get_sp());
+    set_lr(ctx.get_lr());
+    set_pc(ctx.thumb() ? ctx.get_pc() | 1 : ctx.get_pc());
+}
+
 void UnicornCPU::invalidate_jit_cache(Address start, size_t length) {
     uc_ctl_remove_cache(uc.get(), start, start + length);
 }
 
+void UnicornCPU::translate_block(Address pc, bool thumb) {
+    // unicorn only translates the code it runs
+}
+
 bool UnicornCPU::hit_breakpoint() {
     return did_break;
 }
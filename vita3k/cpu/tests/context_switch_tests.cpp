@@ -0,0 +1,122 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <cpu/functions.h>
+#include <mem/functions.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+// the cpu is only used to switch contexts, it never runs any code
+struct NullProtocol : CPUProtocolBase {
+    void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) override {}
+    Address get_watch_memory_addr(Address addr) override { return addr; }
+    uint8_t **get_watch_page_table() override { return nullptr; }
+    ExclusiveMonitorPtr get_exlusive_monitor() override { return nullptr; }
+    void block_translated(Address pc, bool thumb) override {}
+    bool is_breakpoint(Address addr) override { return false; }
+};
+
+static MemState &get_mem() {
+    static MemState mem;
+    static const bool initialized = init(mem, false);
+    EXPECT_TRUE(initialized);
+    return mem;
+}
+
+// a context of the thread with a different value in each register
+static CPUContext make_context(CPUState &cpu, const uint32_t seed) {
+    CPUContext context = save_context(cpu);
+    for (size_t i = 0; i < context.cpu_registers.size(); i++)
+        context.cpu_registers[i] = seed + static_cast<uint32_t>(i) * 4;
+    for (size_t i = 0; i < context.fpu_registers.size(); i++)
+        context.fpu_registers[i] = static_cast<float>(seed) + static_cast<float>(i) * 0.5f;
+    context.set_sp(0x81000000 + seed);
+    context.set_pc(0x81100000 + seed);
+    return context;
+}
+
+static CPUStatePtr make_cpu(NullProtocol &protocol) {
+    return init_cpu(CPUBackend::Dynarmic, true, 0, 1, 0, get_mem(), &protocol);
+}
+
+TEST(context_switch, full_context_round_trips) {
+    NullProtocol protocol;
+    CPUStatePtr cpu = make_cpu(protocol);
+    ASSERT_TRUE(cpu);
+
+    const CPUContext context = make_context(*cpu, 0x1000);
+    load_context(*cpu, context);
+    const CPUContext saved = save_context(*cpu);
+    EXPECT_EQ(saved.cpu_registers, context.cpu_registers);
+    EXPECT_EQ(saved.fpu_registers, context.fpu_registers);
+    EXPECT_EQ(saved.cpsr, context.cpsr);
+    EXPECT_EQ(saved.fpscr, context.fpscr);
+}
+
+// only r4-r15 and s16-s31 are switched, the registers a call can change are left as they are
+TEST(context_switch, callee_saved_context_round_trips) {
+    NullProtocol protocol;
+    CPUStatePtr cpu = make_cpu(protocol);
+    ASSERT_TRUE(cpu);
+
+    const CPUContext current = make_context(*cpu, 0x1000);
+    const CPUContext next = make_context(*cpu, 0x2000);
+    load_context(*cpu, current);
+    load_callee_saved_context(*cpu, next);
+
+    const CPUContext loaded = save_context(*cpu);
+    for (size_t i = 0; i < loaded.cpu_registers.size(); i++)
+        EXPECT_EQ(loaded.cpu_registers[i], i < 4 ? current.cpu_registers[i] : next.cpu_registers[i]) << "r" << i;
+    for (size_t i = 0; i < 32; i++)
+        EXPECT_EQ(loaded.fpu_registers[i], i < 16 ? current.fpu_registers[i] : next.fpu_registers[i]) << "s" << i;
+
+    CPUContext saved{};
+    save_callee_saved_context(*cpu, saved);
+    for (size_t i = 0; i < saved.cpu_registers.size(); i++)
+        EXPECT_EQ(saved.cpu_registers[i], i < 4 ? 0 : next.cpu_registers[i]) << "r" << i;
+    for (size_t i = 0; i < 32; i++)
+        EXPECT_EQ(saved.fpu_registers[i], i < 16 ? 0.0f : next.fpu_registers[i]) << "s" << i;
+    EXPECT_EQ(saved.cpsr, next.cpsr);
+    EXPECT_EQ(saved.fpscr, next.fpscr);
+}
+
+// the fibers switch back and forth, each one must get back the registers it left
+TEST(context_switch, fibers_keep_their_contexts) {
+    NullProtocol protocol;
+    CPUStatePtr cpu = make_cpu(protocol);
+    ASSERT_TRUE(cpu);
+
+    const CPUContext expected[2] = { make_context(*cpu, 0x1000), make_context(*cpu, 0x2000) };
+    CPUContext contexts[2] = { expected[0], expected[1] };
+    load_context(*cpu, contexts[0]);
+    for (int i = 0; i < 16; i++) {
+        save_callee_saved_context(*cpu, contexts[i & 1]);
+        load_callee_saved_context(*cpu, contexts[(i + 1) & 1]);
+    }
+
+    // an even number of switches was done, the first fiber is running again
+    const CPUContext running = save_context(*cpu);
+    for (size_t i = 4; i < running.cpu_registers.size(); i++) {
+        EXPECT_EQ(running.cpu_registers[i], expected[0].cpu_registers[i]) << "r" << i;
+        EXPECT_EQ(contexts[1].cpu_registers[i], expected[1].cpu_registers[i]) << "r" << i;
+    }
+    for (size_t i = 16; i < 32; i++) {
+        EXPECT_EQ(running.fpu_registers[i], expected[0].fpu_registers[i]) << "s" << i;
+        EXPECT_EQ(contexts[1].fpu_registers[i], expected[1].fpu_registers[i]) << "s" << i;
+    }
+}
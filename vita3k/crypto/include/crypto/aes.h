@@ -173,6 +173,23 @@ int aes_crypt_ctr(aes_context *ctx,
 
 void aes_cmac(aes_context *ctx, int length, unsigned char *input, unsigned char *output);
 
+/**
+ * \brief          Tells if the host has AES instructions (AES-NI or the
+ *                 ARMv8 crypto extension)
+ *
+ * \return         1 if it has them
+ */
+int aes_hw_available(void);
+
+/**
+ * \brief          Selects the implementation used by the functions above,
+ *                 the AES instructions of the host are used by default when
+ *                 it has them
+ *
+ * \param enabled  0 to use the table-based implementation
+ */
+void aes_set_hw_enabled(int enabled);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,8 @@
 #include <aes.h>
 #include <crypto/aes.h>
 
+#include "aes_hw.h"
+
 /*
  * 32-bit integer manipulation macros (little endian)
  */
@@ -422,6 +424,19 @@ static void aes_gen_tables(void) {
 
 #endif
 
+/*
+ * The modes use the AES instructions of the host when it has them
+ */
+static bool hw_enabled = aes_hw_supported();
+
+int aes_hw_available(void) {
+    return aes_hw_supported();
+}
+
+void aes_set_hw_enabled(int enabled) {
+    hw_enabled = enabled && aes_hw_supported();
+}
+
 /*
  * AES key schedule (encryption)
  */
@@ -577,6 +592,11 @@ int aes_crypt_ecb(aes_context *ctx,
     int i;
     uint32_t *RK, X0, X1, X2, X3, Y0, Y1, Y2, Y3;
 
+    if (hw_enabled) {
+        aes_hw_crypt_ecb(ctx, mode, input, output, 1);
+        return (0);
+    }
+
     RK = ctx->rk;
 
     GET_UINT32_LE(X0, input, 0);
@@ -645,6 +665,14 @@ int aes_crypt_cbc(aes_context *ctx,
     if (length % 16)
         return (POLARSSL_ERR_AES_INVALID_INPUT_LENGTH);
 
+    if (hw_enabled) {
+        if (mode == AES_DECRYPT)
+            aes_hw_decrypt_cbc(ctx, length / 16, iv, input, output);
+        else
+            aes_hw_encrypt_cbc(ctx, length / 16, iv, input, output);
+        return (0);
+    }
+
     if (mode == AES_DECRYPT) {
         memcpy(orig_iv, iv, 16);
         while (length > 0) {
@@ -731,6 +759,21 @@ int aes_crypt_ctr(aes_context *ctx,
     int c, i;
     size_t n = *nc_off;
 
+    if (hw_enabled) {
+        /* the rest of the current stream block, then the whole blocks at once */
+        while (n != 0 && length > 0) {
+            *output++ = (unsigned char)(*input++ ^ stream_block[n]);
+            n = (n + 1) & 0x0F;
+            length--;
+        }
+
+        const size_t block_count = length / 16;
+        aes_hw_crypt_ctr(ctx, block_count, nonce_counter, input, output);
+        input += block_count * 16;
+        output += block_count * 16;
+        length -= block_count * 16;
+    }
+
     while (length--) {
         if (n == 0) {
             aes_crypt_ecb(ctx, AES_ENCRYPT, nonce_counter, stream_block);
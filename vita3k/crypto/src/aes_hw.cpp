@@ -0,0 +1,258 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "aes_hw.h"
+
+#include <util/instrset_detect.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AES_HW_X86_64
+#include <immintrin.h>
+// msvc allows to use any intrinsic, other compilers need the functions to be marked
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AES
+#else
+#define TARGET_AES __attribute__((target("aes,sse2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define AES_HW_AARCH64
+#include <arm_neon.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AES
+#elif defined(__clang__)
+#define TARGET_AES __attribute__((target("aes")))
+#else
+#define TARGET_AES __attribute__((target("+crypto")))
+#endif
+#endif
+
+bool aes_hw_supported() {
+#if defined(AES_HW_X86_64) || defined(AES_HW_AARCH64)
+    return util::instrset::hasAES();
+#else
+    return false;
+#endif
+}
+
+#if defined(AES_HW_X86_64) || defined(AES_HW_AARCH64)
+
+// blocks done at once by the pipelined modes, the instructions have a latency of several cycles
+// but a new one can be started each cycle
+constexpr size_t PARALLEL_BLOCKS = 8;
+constexpr int MAX_ROUNDS = 14;
+
+#ifdef AES_HW_X86_64
+typedef __m128i AesBlock;
+
+TARGET_AES static inline AesBlock load_block(const unsigned char *data) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+TARGET_AES static inline void store_block(unsigned char *data, const AesBlock block) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data), block);
+}
+
+TARGET_AES static inline AesBlock xor_block(const AesBlock a, const AesBlock b) {
+    return _mm_xor_si128(a, b);
+}
+
+template <size_t N>
+TARGET_AES static inline void encrypt_blocks(const AesBlock *rk, const int nr, AesBlock *blocks) {
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_xor_si128(blocks[i], rk[0]);
+    for (int round = 1; round < nr; round++) {
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = _mm_aesenc_si128(blocks[i], rk[round]);
+    }
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_aesenclast_si128(blocks[i], rk[nr]);
+}
+
+template <size_t N>
+TARGET_AES static inline void decrypt_blocks(const AesBlock *rk, const int nr, AesBlock *blocks) {
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_xor_si128(blocks[i], rk[0]);
+    for (int round = 1; round < nr; round++) {
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = _mm_aesdec_si128(blocks[i], rk[round]);
+    }
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_aesdeclast_si128(blocks[i], rk[nr]);
+}
+#else
+typedef uint8x16_t AesBlock;
+
+TARGET_AES static inline AesBlock load_block(const unsigned char *data) {
+    return vld1q_u8(data);
+}
+
+TARGET_AES static inline void store_block(unsigned char *data, const AesBlock block) {
+    vst1q_u8(data, block);
+}
+
+TARGET_AES static inline AesBlock xor_block(const AesBlock a, const AesBlock b) {
+    return veorq_u8(a, b);
+}
+
+// AESE and AESD add the round key before the substitution, so the last round key is added on its own
+template <size_t N>
+TARGET_AES static inline void encrypt_blocks(const AesBlock *rk, const int nr, AesBlock *blocks) {
+    for (int round = 0; round < nr - 1; round++) {
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = vaesmcq_u8(vaeseq_u8(blocks[i], rk[round]));
+    }
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = veorq_u8(vaeseq_u8(blocks[i], rk[nr - 1]), rk[nr]);
+}
+
+template <size_t N>
+TARGET_AES static inline void decrypt_blocks(const AesBlock *rk, const int nr, AesBlock *blocks) {
+    for (int round = 0; round < nr - 1; round++) {
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = vaesimcq_u8(vaesdq_u8(blocks[i], rk[round]));
+    }
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = veorq_u8(vaesdq_u8(blocks[i], rk[nr - 1]), rk[nr]);
+}
+#endif
+
+// returns the number of rounds
+TARGET_AES static int load_round_keys(const aes_context *ctx, AesBlock (&rk)[MAX_ROUNDS + 1]) {
+    const unsigned char *keys = reinterpret_cast<const unsigned char *>(ctx->rk);
+    for (int i = 0; i <= ctx->nr; i++)
+        rk[i] = load_block(keys + i * 16);
+    return ctx->nr;
+}
+
+static void increment_counter(unsigned char counter[16]) {
+    for (int i = 15; i >= 0; i--) {
+        if (++counter[i] != 0)
+            break;
+    }
+}
+
+TARGET_AES void aes_hw_crypt_ecb(const aes_context *ctx, const int mode, const unsigned char *input, unsigned char *output, size_t block_count) {
+    AesBlock rk[MAX_ROUNDS + 1];
+    const int nr = load_round_keys(ctx, rk);
+
+    AesBlock blocks[PARALLEL_BLOCKS];
+    for (; block_count >= PARALLEL_BLOCKS; block_count -= PARALLEL_BLOCKS) {
+        for (size_t i = 0; i < PARALLEL_BLOCKS; i++)
+            blocks[i] = load_block(input + i * 16);
+        if (mode == AES_DECRYPT)
+            decrypt_blocks<PARALLEL_BLOCKS>(rk, nr, blocks);
+        else
+            encrypt_blocks<PARALLEL_BLOCKS>(rk, nr, blocks);
+        for (size_t i = 0; i < PARALLEL_BLOCKS; i++)
+            store_block(output + i * 16, blocks[i]);
+        input += PARALLEL_BLOCKS * 16;
+        output += PARALLEL_BLOCKS * 16;
+    }
+
+    for (; block_count > 0; block_count--) {
+        blocks[0] = load_block(input);
+        if (mode == AES_DECRYPT)
+            decrypt_blocks<1>(rk, nr, blocks);
+        else
+            encrypt_blocks<1>(rk, nr, blocks);
+        store_block(output, blocks[0]);
+        input += 16;
+        output += 16;
+    }
+}
+
+// each block depends on the previous one, so it cannot be pipelined
+TARGET_AES void aes_hw_encrypt_cbc(const aes_context *ctx, size_t block_count, unsigned char iv[16], const unsigned char *input, unsigned char *output) {
+    AesBlock rk[MAX_ROUNDS + 1];
+    const int nr = load_round_keys(ctx, rk);
+
+    AesBlock block = load_block(iv);
+    for (; block_count > 0; block_count--) {
+        block = xor_block(block, load_block(input));
+        encrypt_blocks<1>(rk, nr, &block);
+        store_block(output, block);
+        input += 16;
+        output += 16;
+    }
+    store_block(iv, block);
+}
+
+TARGET_AES void aes_hw_decrypt_cbc(const aes_context *ctx, size_t block_count, const unsigned char iv[16], const unsigned char *input, unsigned char *output) {
+    AesBlock rk[MAX_ROUNDS + 1];
+    const int nr = load_round_keys(ctx, rk);
+
+    // the input may be the output, the ciphertext is kept for the next block
+    AesBlock previous = load_block(iv);
+    AesBlock ciphertexts[PARALLEL_BLOCKS];
+    AesBlock blocks[PARALLEL_BLOCKS];
+    for (; block_count >= PARALLEL_BLOCKS; block_count -= PARALLEL_BLOCKS) {
+        for (size_t i = 0; i < PARALLEL_BLOCKS; i++)
+            blocks[i] = ciphertexts[i] = load_block(input + i * 16);
+        decrypt_blocks<PARALLEL_BLOCKS>(rk, nr, blocks);
+        store_block(output, xor_block(blocks[0], previous));
+        for (size_t i = 1; i < PARALLEL_BLOCKS; i++)
+            store_block(output + i * 16, xor_block(blocks[i], ciphertexts[i - 1]));
+        previous = ciphertexts[PARALLEL_BLOCKS - 1];
+        input += PARALLEL_BLOCKS * 16;
+        output += PARALLEL_BLOCKS * 16;
+    }
+
+    for (; block_count > 0; block_count--) {
+        blocks[0] = ciphertexts[0] = load_block(input);
+        decrypt_blocks<1>(rk, nr, blocks);
+        store_block(output, xor_block(blocks[0], previous));
+        previous = ciphertexts[0];
+        input += 16;
+        output += 16;
+    }
+}
+
+TARGET_AES void aes_hw_crypt_ctr(const aes_context *ctx, size_t block_count, unsigned char nonce_counter[16], const unsigned char *input, unsigned char *output) {
+    AesBlock rk[MAX_ROUNDS + 1];
+    const int nr = load_round_keys(ctx, rk);
+
+    AesBlock blocks[PARALLEL_BLOCKS];
+    while (block_count > 0) {
+        const size_t count = block_count < PARALLEL_BLOCKS ? block_count : PARALLEL_BLOCKS;
+        for (size_t i = 0; i < count; i++) {
+            blocks[i] = load_block(nonce_counter);
+            increment_counter(nonce_counter);
+        }
+
+        if (count == PARALLEL_BLOCKS) {
+            encrypt_blocks<PARALLEL_BLOCKS>(rk, nr, blocks);
+        } else {
+            for (size_t i = 0; i < count; i++)
+                encrypt_blocks<1>(rk, nr, &blocks[i]);
+        }
+
+        for (size_t i = 0; i < count; i++)
+            store_block(output + i * 16, xor_block(blocks[i], load_block(input + i * 16)));
+        input += count * 16;
+        output += count * 16;
+        block_count -= count;
+    }
+}
+
+#else
+
+void aes_hw_crypt_ecb(const aes_context *ctx, int mode, const unsigned char *input, unsigned char *output, size_t block_count) {}
+void aes_hw_encrypt_cbc(const aes_context *ctx, size_t block_count, unsigned char iv[16], const unsigned char *input, unsigned char *output) {}
+void aes_hw_decrypt_cbc(const aes_context *ctx, size_t block_count, const unsigned char iv[16], const unsigned char *input, unsigned char *output) {}
+void aes_hw_crypt_ctr(const aes_context *ctx, size_t block_count, unsigned char nonce_counter[16], const unsigned char *input, unsigned char *output) {}
+
+#endif
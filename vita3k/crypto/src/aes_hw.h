@@ -0,0 +1,35 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <crypto/aes.h>
+
+#include <cstddef>
+
+// AES done with the instructions of the host (AES-NI on x86-64, the crypto extension on ARMv8).
+// The round keys are the ones of aes_context: aes_setkey_enc gives the key schedule of FIPS-197,
+// and aes_setkey_dec the keys of the equivalent inverse cipher, which is what both instruction sets use.
+
+bool aes_hw_supported();
+
+void aes_hw_crypt_ecb(const aes_context *ctx, int mode, const unsigned char *input, unsigned char *output, size_t block_count);
+void aes_hw_encrypt_cbc(const aes_context *ctx, size_t block_count, unsigned char iv[16], const unsigned char *input, unsigned char *output);
+// iv is left unchanged, like aes_crypt_cbc does
+void aes_hw_decrypt_cbc(const aes_context *ctx, size_t block_count, const unsigned char iv[16], const unsigned char *input, unsigned char *output);
+// the big-endian counter is incremented once per block
+void aes_hw_crypt_ctr(const aes_context *ctx, size_t block_count, unsigned char nonce_counter[16], const unsigned char *input, unsigned char *output);
@@ -0,0 +1,183 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <crypto/aes.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// the implementation selected by default is restored by each test
+struct AesImplementation {
+    AesImplementation(const bool hw) {
+        aes_set_hw_enabled(hw);
+    }
+    ~AesImplementation() {
+        aes_set_hw_enabled(1);
+    }
+};
+
+static std::vector<uint8_t> make_data(const size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (uint8_t &byte : data) {
+        seed = seed * 1664525 + 1013904223;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+    return data;
+}
+
+static std::vector<uint8_t> crypt_cbc(const bool hw, const unsigned int keysize, const int mode, const std::vector<uint8_t> &input) {
+    const AesImplementation implementation(hw);
+    const std::vector<uint8_t> key = make_data(keysize / 8, 1);
+    std::vector<uint8_t> iv = make_data(16, 2);
+
+    aes_context ctx;
+    if (mode == AES_DECRYPT)
+        aes_setkey_dec(&ctx, key.data(), keysize);
+    else
+        aes_setkey_enc(&ctx, key.data(), keysize);
+    std::vector<uint8_t> output(input.size());
+    // in two calls, to check the IV
+    const size_t first_size = input.size() / 32 * 16;
+    aes_crypt_cbc(&ctx, mode, first_size, iv.data(), input.data(), output.data());
+    aes_crypt_cbc(&ctx, mode, input.size() - first_size, iv.data(), input.data() + first_size, output.data() + first_size);
+    output.insert(output.end(), iv.begin(), iv.end());
+    return output;
+}
+
+// the data is given in pieces of the sizes given, to check the resuming inside a block
+static std::vector<uint8_t> crypt_ctr(const bool hw, const unsigned int keysize, const std::vector<uint8_t> &input, const std::vector<size_t> &sizes) {
+    const AesImplementation implementation(hw);
+    const std::vector<uint8_t> key = make_data(keysize / 8, 3);
+    std::vector<uint8_t> counter = make_data(16, 4);
+    // the counter carries over several bytes while the data is crypted
+    std::fill(counter.begin() + 10, counter.end(), 0xFF);
+
+    aes_context ctx;
+    aes_setkey_enc(&ctx, key.data(), keysize);
+    std::vector<uint8_t> output(input.size());
+    unsigned char stream_block[16] = {};
+    size_t nc_off = 0;
+    size_t offset = 0;
+    for (const size_t size : sizes) {
+        aes_crypt_ctr(&ctx, size, &nc_off, counter.data(), stream_block, input.data() + offset, output.data() + offset);
+        offset += size;
+    }
+    output.insert(output.end(), counter.begin(), counter.end());
+    return output;
+}
+
+TEST(aes, fips_197_vectors) {
+    const uint8_t key[32] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+    };
+    const uint8_t plaintext[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    const uint8_t ciphertext_128[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+    const uint8_t ciphertext_256[16] = { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 };
+
+    for (const bool hw : { false, true }) {
+        if (hw && !aes_hw_available())
+            continue;
+        const AesImplementation implementation(hw);
+
+        aes_context ctx;
+        uint8_t output[16];
+        aes_setkey_enc(&ctx, key, 128);
+        aes_crypt_ecb(&ctx, AES_ENCRYPT, plaintext, output);
+        EXPECT_EQ(memcmp(output, ciphertext_128, 16), 0) << "hw: " << hw;
+        aes_setkey_dec(&ctx, key, 128);
+        aes_crypt_ecb(&ctx, AES_DECRYPT, ciphertext_128, output);
+        EXPECT_EQ(memcmp(output, plaintext, 16), 0) << "hw: " << hw;
+
+        aes_setkey_enc(&ctx, key, 256);
+        aes_crypt_ecb(&ctx, AES_ENCRYPT, plaintext, output);
+        EXPECT_EQ(memcmp(output, ciphertext_256, 16), 0) << "hw: " << hw;
+        aes_setkey_dec(&ctx, key, 256);
+        aes_crypt_ecb(&ctx, AES_DECRYPT, ciphertext_256, output);
+        EXPECT_EQ(memcmp(output, plaintext, 16), 0) << "hw: " << hw;
+    }
+}
+
+TEST(aes, hw_matches_tables) {
+    if (!aes_hw_available())
+        GTEST_SKIP() << "the host has no AES instructions";
+
+    // not a multiple of the blocks done at once
+    const std::vector<uint8_t> data = make_data(16 * 77, 5);
+    for (const unsigned int keysize : { 128u, 192u, 256u }) {
+        EXPECT_EQ(crypt_cbc(true, keysize, AES_ENCRYPT, data), crypt_cbc(false, keysize, AES_ENCRYPT, data)) << keysize;
+        EXPECT_EQ(crypt_cbc(true, keysize, AES_DECRYPT, data), crypt_cbc(false, keysize, AES_DECRYPT, data)) << keysize;
+
+        const std::vector<uint8_t> odd_data = make_data(16 * 77 + 9, 6);
+        const std::vector<size_t> sizes = { 5, 16 * 20 + 3, 8, 16 * 50, odd_data.size() - (5 + 16 * 20 + 3 + 8 + 16 * 50) };
+        EXPECT_EQ(crypt_ctr(true, keysize, odd_data, sizes), crypt_ctr(false, keysize, odd_data, sizes)) << keysize;
+    }
+}
+
+// throughput in MiB/s of a mode on a big buffer, the data is crypted in place
+template <typename Crypt>
+static double measure_mib_per_s(const bool hw, Crypt crypt, std::vector<uint8_t> &data) {
+    const AesImplementation implementation(hw);
+
+    const auto start = std::chrono::steady_clock::now();
+    crypt(data.data(), data.size());
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return data.size() / (1024.0 * 1024.0) / elapsed.count();
+}
+
+// the throughputs are only recorded, the timings of a shared host cannot decide the result
+TEST(aes, hw_throughput) {
+    if (!aes_hw_available())
+        GTEST_SKIP() << "the host has no AES instructions";
+
+    const std::vector<uint8_t> key = make_data(16, 8);
+    aes_context enc_ctx;
+    aes_context dec_ctx;
+    aes_setkey_enc(&enc_ctx, key.data(), 128);
+    aes_setkey_dec(&dec_ctx, key.data(), 128);
+
+    const auto ctr = [&](uint8_t *data, const size_t size) {
+        unsigned char counter[16] = {};
+        unsigned char stream_block[16];
+        size_t nc_off = 0;
+        aes_crypt_ctr(&enc_ctx, size, &nc_off, counter, stream_block, data, data);
+    };
+    const auto cbc_decrypt = [&](uint8_t *data, const size_t size) {
+        unsigned char iv[16] = {};
+        aes_crypt_cbc(&dec_ctx, AES_DECRYPT, size, iv, data, data);
+    };
+
+    const std::vector<uint8_t> data = make_data(16 * 1024 * 1024, 7);
+    std::vector<uint8_t> table_ctr_data = data;
+    std::vector<uint8_t> hw_ctr_data = data;
+    std::vector<uint8_t> table_cbc_data = data;
+    std::vector<uint8_t> hw_cbc_data = data;
+    RecordProperty("table_ctr_mib_per_s", std::to_string(measure_mib_per_s(false, ctr, table_ctr_data)));
+    RecordProperty("hw_ctr_mib_per_s", std::to_string(measure_mib_per_s(true, ctr, hw_ctr_data)));
+    RecordProperty("table_cbc_decrypt_mib_per_s", std::to_string(measure_mib_per_s(false, cbc_decrypt, table_cbc_data)));
+    RecordProperty("hw_cbc_decrypt_mib_per_s", std::to_string(measure_mib_per_s(true, cbc_decrypt, hw_cbc_data)));
+
+    EXPECT_FALSE(hw_ctr_data == data);
+    EXPECT_TRUE(hw_ctr_data == table_ctr_data);
+    EXPECT_TRUE(hw_cbc_data == table_cbc_data);
+}
@@ -0,0 +1,55 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct CtrlState;
+
+// State of the inputs from a frame on, until the frame of the next entry
+struct InputScriptEntry {
+    uint64_t frame = 0;
+    // SceCtrlButtons of the extended mode, L1/R1 are the L/R buttons of the non-extended mode
+    uint32_t buttons = 0;
+    // lx, ly, rx, ry, from -1 to 1
+    std::array<float, 4> axes = {};
+    // front and back touch panels, in their coordinates
+    std::array<bool, 2> touched = {};
+    std::array<uint16_t, 2> touch_x = {};
+    std::array<uint16_t, 2> touch_y = {};
+};
+
+// Input timeline replayed instead of the host inputs, the frames are the ones displayed by the app.
+// Each line of the file is a frame number followed by the inputs held from this frame on, for example:
+//   120 buttons=cross,up lstick=0.5,-1 front=960,544
+//   130
+// The inputs not on a line are released, the lines starting with # are comments.
+struct InputScript {
+    std::vector<InputScriptEntry> entries;
+    size_t next_entry = 0;
+    uint64_t frame = 0;
+    InputScriptEntry current;
+};
+
+bool load_input_script(InputScript &script, const fs::path &path);
+// called each time the app displays a frame, does nothing without a script
+void advance_input_script(CtrlState &state);
@@ -19,12 +19,14 @@
 
 #include <ctrl/ctrl.h>
 #include <ctrl/functions.h>
+#include <ctrl/input_script.h>
 
 #include <SDL_gamecontroller.h>
 #include <SDL_haptic.h>
 #include <SDL_joystick.h>
 
 #include <array>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -67,4 +69,9 @@ struct CtrlState {
 
     // last vsync the data was read
     uint64_t last_vcount[5] = {};
+    // last time the controllers were updated when read by the guest, with low-latency-input
+    std::chrono::steady_clock::time_point last_controllers_update;
+
+    // when set, replayed instead of the inputs of the first port and of the touch panels
+    std::unique_ptr<InputScript> input_script;
 };
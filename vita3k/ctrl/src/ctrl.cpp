@@ -27,6 +27,9 @@
 
 #include <SDL_keyboard.h>
 
+// the games reading all the ports only update the controllers once
+constexpr std::chrono::microseconds CONTROLLERS_UPDATE_INTERVAL(1000);
+
 static int reserve_port(CtrlState &state) {
     for (int i = 0; i < SCE_CTRL_MAX_WIRELESS_NUM; i++) {
         if (state.free_ports[i]) {
@@ -104,6 +107,17 @@ void refresh_controllers(CtrlState &state, EmuEnvState &emuenv) {
     state.has_motion_support = found_gyro && found_accel;
 }
 
+// The state of the controllers is otherwise the one of the events handled by the main loop, once per host frame,
+// which can be up to a frame old when the guest reads it. The keyboard state can only be updated by the main thread.
+static void update_controllers(CtrlState &state) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - state.last_controllers_update < CONTROLLERS_UPDATE_INTERVAL)
+        return;
+
+    state.last_controllers_update = now;
+    SDL_GameControllerUpdate();
+}
+
 static float keys_to_axis(const uint8_t *keys, SDL_Scancode code1, SDL_Scancode code2) {
     float temp = 0;
     if (keys[code1]) {
@@ -166,6 +180,23 @@ static void apply_keyboard(uint32_t *buttons, float axes[4], bool ext, EmuEnvSta
     axes[3] += keys_to_axis(keys, static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_up), static_cast<SDL_Scancode>(emuenv.cfg.keyboard_rightstick_down));
 }
 
+static void apply_input_script(const InputScript &script, uint32_t *buttons, float axes[4], bool ext) {
+    const InputScriptEntry &entry = script.current;
+    if (ext) {
+        *buttons |= entry.buttons;
+    } else {
+        // like with the keyboard, L1 and R1 are the shoulder buttons
+        *buttons |= entry.buttons & ~(SCE_CTRL_L1 | SCE_CTRL_R1 | SCE_CTRL_L2 | SCE_CTRL_R2 | SCE_CTRL_L3 | SCE_CTRL_R3);
+        if (entry.buttons & SCE_CTRL_L1)
+            *buttons |= SCE_CTRL_L;
+        if (entry.buttons & SCE_CTRL_R1)
+            *buttons |= SCE_CTRL_R;
+    }
+
+    for (int i = 0; i < 4; i++)
+        axes[i] += entry.axes[i];
+}
+
 static float axis_to_axis(int16_t axis) {
     const auto unsigned_axis = static_cast<float>(axis - INT16_MIN);
     assert(unsigned_axis >= 0);
@@ -263,6 +294,8 @@ static void retrieve_ctrl_data(EmuEnvState &emuenv, int port, bool is_v2, bool n
     }
     CtrlState &state = emuenv.ctrl;
     refresh_controllers(state, emuenv);
+    if (emuenv.cfg.low_latency_input && !state.input_script)
+        update_controllers(state);
 
     std::array<float, 4> axes;
     axes.fill(0);
@@ -289,12 +322,18 @@ static void retrieve_ctrl_data(EmuEnvState &emuenv, int port, bool is_v2, bool n
         return;
     }
 
-    if (port == 1) {
-        apply_keyboard(&buttons, axes.data(), is_v2, emuenv);
-    }
-    for (const auto &controller : state.controllers) {
-        if (controller.second.port == port) {
-            apply_controller(emuenv, &buttons, axes.data(), controller.second.controller.get(), is_v2);
+    if (state.input_script) {
+        // the host inputs are ignored for the replay to be the same on every run
+        if (port == 1)
+            apply_input_script(*state.input_script, &buttons, axes.data(), is_v2);
+    } else {
+        if (port == 1) {
+            apply_keyboard(&buttons, axes.data(), is_v2, emuenv);
+        }
+        for (const auto &controller : state.controllers) {
+            if (controller.second.port == port) {
+                apply_controller(emuenv, &buttons, axes.data(), controller.second.controller.get(), is_v2);
+            }
         }
     }
 
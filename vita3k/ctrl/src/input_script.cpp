@@ -0,0 +1,164 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <ctrl/ctrl.h>
+#include <ctrl/input_script.h>
+#include <ctrl/state.h>
+
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+static const std::map<std::string, uint32_t> script_buttons = {
+    { "select", SCE_CTRL_SELECT },
+    { "l3", SCE_CTRL_L3 },
+    { "r3", SCE_CTRL_R3 },
+    { "start", SCE_CTRL_START },
+    { "up", SCE_CTRL_UP },
+    { "right", SCE_CTRL_RIGHT },
+    { "down", SCE_CTRL_DOWN },
+    { "left", SCE_CTRL_LEFT },
+    { "l1", SCE_CTRL_L1 },
+    { "r1", SCE_CTRL_R1 },
+    { "l2", SCE_CTRL_L2 },
+    { "r2", SCE_CTRL_R2 },
+    { "triangle", SCE_CTRL_TRIANGLE },
+    { "circle", SCE_CTRL_CIRCLE },
+    { "cross", SCE_CTRL_CROSS },
+    { "square", SCE_CTRL_SQUARE },
+    { "psbutton", SCE_CTRL_PSBUTTON },
+};
+
+static bool parse_pair(const std::string &value, float &x, float &y) {
+    const std::vector<std::string> values = string_utils::split_string(value, ',');
+    if (values.size() != 2)
+        return false;
+
+    try {
+        x = std::stof(values[0]);
+        y = std::stof(values[1]);
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool parse_entry(InputScriptEntry &entry, const std::string &line) {
+    std::istringstream tokens(line);
+    std::string token;
+    if (!(tokens >> token))
+        return false;
+
+    try {
+        size_t end = 0;
+        entry.frame = std::stoull(token, &end);
+        if (end != token.size())
+            return false;
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    while (tokens >> token) {
+        const size_t separator = token.find('=');
+        if (separator == std::string::npos)
+            return false;
+
+        const std::string key = token.substr(0, separator);
+        const std::string value = token.substr(separator + 1);
+        if (key == "buttons") {
+            for (const std::string &name : string_utils::split_string(value, ',')) {
+                const auto button = script_buttons.find(name);
+                if (button == script_buttons.end())
+                    return false;
+                entry.buttons |= button->second;
+            }
+        } else if (key == "lstick" || key == "rstick") {
+            const size_t axis = key == "lstick" ? 0 : 2;
+            float x, y;
+            if (!parse_pair(value, x, y))
+                return false;
+            entry.axes[axis] = std::clamp(x, -1.f, 1.f);
+            entry.axes[axis + 1] = std::clamp(y, -1.f, 1.f);
+        } else if (key == "front" || key == "back") {
+            const size_t port = key == "front" ? 0 : 1;
+            float x, y;
+            if (!parse_pair(value, x, y))
+                return false;
+            entry.touched[port] = true;
+            entry.touch_x[port] = static_cast<uint16_t>(std::clamp(x, 0.f, 1919.f));
+            entry.touch_y[port] = static_cast<uint16_t>(std::clamp(y, 0.f, 1087.f));
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the entries of the frames reached replace the held inputs
+static void apply_entries(InputScript &script) {
+    while (script.next_entry < script.entries.size() && script.entries[script.next_entry].frame <= script.frame) {
+        script.current = script.entries[script.next_entry];
+        script.next_entry++;
+    }
+}
+
+bool load_input_script(InputScript &script, const fs::path &path) {
+    fs::ifstream file(path, std::ios::in);
+    if (!file.is_open()) {
+        LOG_ERROR("Could not open the input script {}", path.string());
+        return false;
+    }
+
+    script = {};
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        InputScriptEntry entry;
+        if (!parse_entry(entry, line)) {
+            LOG_ERROR("Invalid line {} in the input script {}: {}", line_number, path.string(), line);
+            return false;
+        }
+        if (!script.entries.empty() && entry.frame < script.entries.back().frame) {
+            LOG_ERROR("The frames of the input script {} must be in order, line {}", path.string(), line_number);
+            return false;
+        }
+        script.entries.push_back(entry);
+    }
+
+    apply_entries(script);
+
+    LOG_INFO("Loaded {} entries from the input script {}", script.entries.size(), path.string());
+    return true;
+}
+
+void advance_input_script(CtrlState &state) {
+    if (!state.input_script)
+        return;
+
+    const std::lock_guard<std::mutex> guard(state.mutex);
+    InputScript &script = *state.input_script;
+    script.frame++;
+    apply_entries(script);
+}
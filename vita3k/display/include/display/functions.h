@@ -26,4 +26,6 @@ struct KernelState;
 struct EmuEnvState;
 
 void start_sync_thread(EmuEnvState &emuenv);
+// speed up the vblanks and the guest clocks, 1 for real time and 0 for unlimited
+void set_emulation_speed(DisplayState &display, uint32_t speed);
 void wait_vblank(DisplayState &display, KernelState &kernel, const ThreadStatePtr &wait_thread, const uint64_t target_vcount, const bool is_cb);
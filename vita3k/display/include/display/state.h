@@ -18,10 +18,12 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <kernel/callback.h>
 #include <mem/ptr.h>
 #include <memory>
 #include <mutex>
+#include <queue>
 #include <thread>
 #include <vector>
 
@@ -39,6 +41,13 @@ struct DisplayStateVBlankWaitInfo {
     uint64_t target_vcount;
 };
 
+// orders the waits so that the one with the lowest target vcount is on top of the queue
+struct DisplayStateVBlankWaitCompare {
+    bool operator()(const DisplayStateVBlankWaitInfo &lhs, const DisplayStateVBlankWaitInfo &rhs) const {
+        return lhs.target_vcount > rhs.target_vcount;
+    }
+};
+
 struct DisplayFrameInfo {
     Ptr<const void> base;
     uint32_t pitch = 0;
@@ -57,7 +66,16 @@ struct DisplayState {
     std::atomic<bool> imgui_render{ true };
     std::atomic<bool> fullscreen{ false };
     std::atomic<std::uint64_t> vblank_count{ 0 };
-    std::vector<DisplayStateVBlankWaitInfo> vblank_wait_infos;
+    std::priority_queue<DisplayStateVBlankWaitInfo, std::vector<DisplayStateVBlankWaitInfo>, DisplayStateVBlankWaitCompare> vblank_wait_infos;
+    // the vblanks are sent as soon as a thread waits for one instead of at 60 Hz, for the benchmarks
+    std::atomic<bool> unpaced{ false };
+    // multiplier of the vblank rate and of the guest clocks, 0 to send the vblanks unpaced
+    std::atomic<uint32_t> speed{ 1 };
+    // notified when a thread starts waiting for a vblank
+    std::condition_variable vblank_wait_cond;
+    // delay between the deadline of the vblanks and the time they are handled, over the last second
+    std::atomic<uint32_t> vblank_jitter_avg_us{ 0 };
+    std::atomic<uint32_t> vblank_jitter_max_us{ 0 };
     std::uint64_t last_setframe_vblank_count = 0;
     std::map<SceUID, CallbackPtr> vblank_callbacks{};
 };
@@ -23,18 +23,33 @@
 #include <kernel/state.h>
 #include <renderer/state.h>
 
+#include <algorithm>
 #include <chrono>
 #include <motion/functions.h>
+#include <rtc/rtc.h>
 #include <touch/functions.h>
 #include <util/find.h>
+#include <util/host_thread.h>
+#include <util/precise_sleep.h>
 
 // Code heavily influenced by PPSSSPP's SceDisplay.cpp
 
 static constexpr int TARGET_FPS = 60;
-static constexpr int64_t TARGET_MICRO_PER_FRAME = 1000000LL / TARGET_FPS;
+typedef std::chrono::duration<int64_t, std::ratio<1, TARGET_FPS>> VBlankPeriod;
 
 static void vblank_sync_thread(EmuEnvState &emuenv) {
     DisplayState &display = emuenv.display;
+    if (emuenv.kernel.host_thread_priority)
+        set_current_thread_priority(HostThreadPriority::Highest);
+
+    // the deadlines are computed from the first one so that the rounding errors do not add up
+    auto first_vblank = std::chrono::steady_clock::now();
+    int64_t vblank_index = 0;
+    uint32_t speed = 1;
+
+    uint64_t jitter_sum_us = 0;
+    uint32_t jitter_max_us = 0;
+    uint32_t jitter_count = 0;
 
     while (!display.abort.load()) {
         {
@@ -50,32 +65,61 @@ static void vblank_sync_thread(EmuEnvState &emuenv) {
 
                 // in this case, even though no new game frames are being rendered, we still need to update the screen
                 if (emuenv.kernel.is_threads_paused() || (emuenv.common_dialog.status == SCE_COMMON_DIALOG_STATUS_RUNNING))
-                    emuenv.renderer->should_display = true;
+                    emuenv.renderer->request_display();
             }
 
-            // maybe we should also use a mutex for this part, but it shouldn't be an issue
-            touch_vsync_update(emuenv);
-            refresh_motion(emuenv.motion, emuenv.ctrl);
-
             // Notify Vblank callback in each VBLANK start
             for (auto &cb : display.vblank_callbacks)
                 cb.second->event_notify(cb.second->get_notifier_id());
 
-            for (std::size_t i = 0; i < display.vblank_wait_infos.size();) {
-                auto &vblank_wait_info = display.vblank_wait_infos[i];
-                if (vblank_wait_info.target_vcount <= display.vblank_count) {
-                    ThreadStatePtr target_wait = vblank_wait_info.target_thread;
-
-                    target_wait->update_status(ThreadStatus::run);
-                    display.vblank_wait_infos.erase(display.vblank_wait_infos.begin() + i);
-                } else {
-                    i++;
-                }
+            while (!display.vblank_wait_infos.empty() && display.vblank_wait_infos.top().target_vcount <= display.vblank_count) {
+                display.vblank_wait_infos.top().target_thread->update_status(ThreadStatus::run);
+                display.vblank_wait_infos.pop();
             }
         }
-        const auto time_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-        const auto time_left = TARGET_MICRO_PER_FRAME - (time_ms % TARGET_MICRO_PER_FRAME);
-        std::this_thread::sleep_for(std::chrono::microseconds(time_left));
+
+        // the input states have their own locks
+        touch_vsync_update(emuenv);
+        refresh_motion(emuenv.motion, emuenv.ctrl);
+
+        if (display.unpaced.load() || display.speed.load() == 0) {
+            // the next vblank is sent once a thread waits for one, or after a period for the apps only polling
+            std::unique_lock<std::mutex> lock(display.mutex);
+            display.vblank_wait_cond.wait_for(lock, VBlankPeriod(1), [&] { return !display.vblank_wait_infos.empty() || display.abort.load(); });
+            first_vblank = std::chrono::steady_clock::now();
+            vblank_index = 0;
+            continue;
+        }
+
+        // the deadlines start again from the last vblank when the speed changes
+        const uint32_t current_speed = std::max<uint32_t>(display.speed.load(), 1);
+        if (current_speed != speed) {
+            speed = current_speed;
+            first_vblank = std::chrono::steady_clock::now();
+            vblank_index = 0;
+        }
+
+        vblank_index++;
+        const auto deadline = first_vblank + std::chrono::duration_cast<std::chrono::steady_clock::duration>(VBlankPeriod(vblank_index)) / speed;
+        precise_sleep_until(deadline, emuenv.kernel.delay_spin_us);
+
+        const auto now = std::chrono::steady_clock::now();
+        const uint32_t jitter_us = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - deadline).count());
+        jitter_sum_us += jitter_us;
+        jitter_max_us = std::max(jitter_max_us, jitter_us);
+        if (++jitter_count == TARGET_FPS) {
+            display.vblank_jitter_avg_us = static_cast<uint32_t>(jitter_sum_us / jitter_count);
+            display.vblank_jitter_max_us = jitter_max_us;
+            jitter_sum_us = 0;
+            jitter_max_us = 0;
+            jitter_count = 0;
+        }
+
+        // when the thread was stalled for more than a vblank, start again from now instead of sending the missed vblanks in a row
+        if (now - deadline > VBlankPeriod(1) / speed) {
+            first_vblank = now;
+            vblank_index = 0;
+        }
     }
 }
 
@@ -83,6 +127,14 @@ void start_sync_thread(EmuEnvState &emuenv) {
     emuenv.display.vblank_thread = std::make_unique<std::thread>(vblank_sync_thread, std::ref(emuenv));
 }
 
+void set_emulation_speed(DisplayState &display, uint32_t speed) {
+    display.speed = speed;
+    // the guest clocks run at real time when unlimited, only the vblanks are not waited for
+    rtc_set_speed(speed == 0 ? 1 : speed);
+    if (speed == 0)
+        display.vblank_wait_cond.notify_one();
+}
+
 void wait_vblank(DisplayState &display, KernelState &kernel, const ThreadStatePtr &wait_thread, const uint64_t target_vcount, const bool is_cb) {
     if (!wait_thread) {
         return;
@@ -98,7 +150,9 @@ void wait_vblank(DisplayState &display, KernelState &kernel, const ThreadStatePt
                 return;
 
             wait_thread->update_status(ThreadStatus::wait);
-            display.vblank_wait_infos.push_back({ wait_thread, target_vcount });
+            display.vblank_wait_infos.push({ wait_thread, target_vcount });
+            if (display.unpaced.load(std::memory_order_relaxed))
+                display.vblank_wait_cond.notify_one();
         }
 
         wait_thread->status_cond.wait(thread_lock, [=]() { return wait_thread->status == ThreadStatus::run; });
@@ -59,6 +59,10 @@ struct RegMgrState;
 struct SfoFile;
 struct GDBState;
 struct HTTPState;
+struct BootProfiler;
+struct FrameStats;
+struct StutterDetector;
+class GameplayRecorder;
 
 typedef int32_t SceInt;
 struct IVector2 {
@@ -103,6 +107,10 @@ private:
     std::unique_ptr<SfoFile> _sfo_handle;
     std::unique_ptr<GDBState> _gdb;
     std::unique_ptr<HTTPState> _http;
+    std::unique_ptr<BootProfiler> _boot_profiler;
+    std::unique_ptr<FrameStats> _frame_stats;
+    std::unique_ptr<StutterDetector> _stutter_detector;
+    std::unique_ptr<GameplayRecorder> _recorder;
 
 public:
     // App info contained in its `param.sfo` file
@@ -137,6 +145,11 @@ public:
     float fps_values[20] = {};
     uint32_t current_fps_offset = 0;
     uint32_t ms_per_frame = 0;
+    // access violations handled for each frame during the last second
+    uint32_t protect_faults_per_frame = 0;
+    uint32_t write_track_faults_per_frame = 0;
+    uint64_t last_protect_fault_count = 0;
+    uint64_t last_write_track_fault_count = 0;
     WindowPtr window = WindowPtr(nullptr, nullptr);
     renderer::Backend backend_renderer{};
     RendererPtr renderer{};
@@ -167,6 +180,13 @@ public:
     uint32_t res_height_dpi_scale = 0;
     GDBState &gdb;
     HTTPState &http;
+    BootProfiler &boot_profiler;
+    // only sampled for the detailed performance overlay
+    FrameStats &frame_stats;
+    // frames longer than cfg.stutter_threshold_ms, dumped in the log on exit
+    StutterDetector &stutter_detector;
+    // records the presented frames and the audio to the file given with --record
+    GameplayRecorder &recorder;
 
     EmuEnvState();
     // declaring a destructor is necessary to forward declare unique_ptrs
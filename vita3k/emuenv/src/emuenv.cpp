@@ -18,6 +18,7 @@
 #include <emuenv/state.h>
 
 #include <audio/state.h>
+#include <codec/recorder.h>
 #include <config/state.h>
 #include <ctrl/state.h>
 #include <dialog/state.h>
@@ -37,6 +38,9 @@
 #include <regmgr/state.h>
 #include <renderer/state.h>
 #include <touch/state.h>
+#include <util/boot_profiler.h>
+#include <util/frame_stats.h>
+#include <util/stutter.h>
 #include <util/string_utils.h>
 
 #include <gdbstub/state.h>
@@ -85,7 +89,15 @@ EmuEnvState::EmuEnvState()
     , _gdb(new GDBState)
     , gdb(*_gdb)
     , _http(new HTTPState)
-    , http(*_http) {
+    , http(*_http)
+    , _boot_profiler(new BootProfiler)
+    , boot_profiler(*_boot_profiler)
+    , _frame_stats(new FrameStats)
+    , frame_stats(*_frame_stats)
+    , _stutter_detector(new StutterDetector)
+    , stutter_detector(*_stutter_detector)
+    , _recorder(new GameplayRecorder)
+    , recorder(*_recorder) {
 }
 
 // this is necessary to forward declare unique_ptrs (so that they can call the appropriate destructor)
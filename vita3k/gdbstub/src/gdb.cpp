@@ -27,6 +27,8 @@
 
 #include <kernel/state.h>
 #include <mem/state.h>
+
+#include <algorithm>
 #include <sstream>
 
 // Sockets
@@ -57,7 +59,11 @@
 
 // Credit to jfhs for their GDB stub for RPCS3 which this stub is based on.
 
-typedef char PacketData[1200];
+// largest packet the client may send, advertised in qSupported
+constexpr int64_t GDB_PACKET_SIZE = 0x1000;
+
+// room for a full packet, the acks and the next packet start
+typedef char PacketData[GDB_PACKET_SIZE * 2];
 
 struct PacketCommand {
     char *data{};
@@ -111,7 +117,7 @@ static uint8_t make_checksum(const char *data, int64_t length) {
     size_t sum = 0;
 
     for (int64_t a = 0; a < length; a++) {
-        sum += data[a];
+        sum += static_cast<uint8_t>(data[a]);
     }
 
     return static_cast<uint8_t>(sum % 256);
@@ -123,13 +129,12 @@ static PacketCommand parse_command(char *data, int64_t length) {
     command.data = data;
     command.length = length;
 
-    // TODO: Use std::find() to find packet begin and end.
+    // '#' is escaped in binary data, so the first one ends the packet
     if (length > 1)
         command.begin_index = 1;
-    for (int64_t a = 0; a < length; a++) {
-        if (data[a] == '#')
-            command.end_index = a;
-    }
+    const char *end = std::find(data + 1, data + length, '#');
+    if (end != data + length)
+        command.end_index = end - data;
 
     command.is_valid = command.begin_index != -1 && command.end_index != -1
         && command.end_index > command.begin_index && command.end_index + 2 < length;
@@ -163,9 +168,39 @@ static int64_t server_ack(GDBState &state, char ack = '+') {
     return send(state.client_socket, &ack, 1, 0);
 }
 
+// binary data is sent with '#', '$', '}' and '*' replaced by '}' followed by the byte xored with 0x20
+static std::string escape_binary(const uint8_t *data, size_t size) {
+    std::string escaped;
+    escaped.reserve(size);
+    for (size_t a = 0; a < size; a++) {
+        const char c = static_cast<char>(data[a]);
+        if (c == '#' || c == '$' || c == '}' || c == '*') {
+            escaped += '}';
+            escaped += static_cast<char>(c ^ 0x20);
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string unescape_binary(const char *data, size_t size) {
+    std::string unescaped;
+    unescaped.reserve(size);
+    for (size_t a = 0; a < size; a++) {
+        if (data[a] == '}' && a + 1 < size)
+            unescaped += static_cast<char>(data[++a] ^ 0x20);
+        else
+            unescaped += data[a];
+    }
+    return unescaped;
+}
+
 static std::string cmd_supported(EmuEnvState &state, PacketCommand &command) {
-    return "multiprocess-;swbreak+;hwbreak-;qRelocInsn-;fork-events-;vfork-events-;"
-           "exec-events-;vContSupported+;QThreadEvents-;no-resumed-;xmlRegisters=arm";
+    return fmt::format("PacketSize={:x};multiprocess-;swbreak+;hwbreak-;qRelocInsn-;fork-events-;vfork-events-;"
+                       "exec-events-;vContSupported+;QThreadEvents-;no-resumed-;xmlRegisters=arm;"
+                       "qXfer:threads:read+;binary-upload+",
+        GDB_PACKET_SIZE);
 }
 
 static std::string cmd_reply_empty(EmuEnvState &state, PacketCommand &command) {
@@ -183,7 +218,7 @@ static SceUID select_thread(EmuEnvState &state, int thread_id) {
 }
 
 static std::string cmd_set_current_thread(EmuEnvState &state, PacketCommand &command) {
-    const auto guard = std::lock_guard(state.kernel.mutex);
+    const ProfiledLockGuard guard(state.kernel.mutex);
     int32_t thread_id = parse_hex(std::string(
         command.content_start + 2, static_cast<unsigned long>(command.content_length - 2)));
 
@@ -285,7 +320,7 @@ static std::string cmd_read_registers(EmuEnvState &state, PacketCommand &command
 }
 
 static std::string cmd_write_registers(EmuEnvState &state, PacketCommand &command) {
-    const auto guard = std::lock_guard(state.kernel.mutex);
+    const ProfiledLockGuard guard(state.kernel.mutex);
     if (state.gdb.current_thread == -1
         || !state.kernel.threads.contains(state.gdb.current_thread))
         return "E00";
@@ -303,7 +338,7 @@ static std::string cmd_write_registers(EmuEnvState &state, PacketCommand &comman
 }
 
 static std::string cmd_read_register(EmuEnvState &state, PacketCommand &command) {
-    const auto guard = std::lock_guard(state.kernel.mutex);
+    const ProfiledLockGuard guard(state.kernel.mutex);
     if (state.gdb.current_thread == -1
         || !state.kernel.threads.contains(state.gdb.current_thread))
         return "E00";
@@ -317,7 +352,7 @@ static std::string cmd_read_register(EmuEnvState &state, PacketCommand &command)
 }
 
 static std::string cmd_write_register(EmuEnvState &state, PacketCommand &command) {
-    const auto guard = std::lock_guard(state.kernel.mutex);
+    const ProfiledLockGuard guard(state.kernel.mutex);
     if (state.gdb.current_thread == -1
         || !state.kernel.threads.contains(state.gdb.current_thread))
         return "E00";
@@ -391,8 +426,6 @@ static std::string cmd_write_memory(EmuEnvState &state, PacketCommand &command)
     return "OK";
 }
 
-// server_next() might not be able to tell the difference between the end of the packet ($) and 0x24 ($).
-// Thus, cmd_write_binary is disabled.
 static std::string cmd_write_binary(EmuEnvState &state, PacketCommand &command) {
     const std::string content = content_string(command);
     const size_t pos_first = content.find(',');
@@ -402,18 +435,76 @@ static std::string cmd_write_binary(EmuEnvState &state, PacketCommand &command)
     const std::string second = content.substr(pos_first + 1, pos_second - pos_first);
     const uint32_t address = parse_hex(first);
     const uint32_t length = parse_hex(second);
-    const char *data = command.content_start + pos_second + 1;
+    const std::string data = unescape_binary(command.content_start + pos_second + 1, command.content_length - pos_second - 1);
 
+    if (data.size() != length)
+        return "E01";
     if (!check_memory_region(address, length, state.mem))
         return "EAA";
 
-    for (uint32_t a = 0; a < length; a++) {
-        state.mem.memory[address + a] = data[a];
-    }
+    std::memcpy(&state.mem.memory[address], data.data(), length);
 
     return "OK";
 }
 
+static std::string cmd_read_binary(EmuEnvState &state, PacketCommand &command) {
+    const std::string content = content_string(command);
+    const size_t pos = content.find(',');
+
+    const uint32_t address = parse_hex(content.substr(1, pos - 1));
+    const uint32_t length = parse_hex(content.substr(pos + 1));
+
+    if (!check_memory_region(address, length, state.mem))
+        return "EAA";
+
+    return "b" + escape_binary(&state.mem.memory[address], length);
+}
+
+static std::string escape_xml(const std::string &text) {
+    std::string escaped;
+    for (const char c : text) {
+        switch (c) {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+// reply to qXfer:<object>:read:<annex>:<offset>,<length> with the requested part of the document
+static std::string xfer_reply(const std::string &document, PacketCommand &command) {
+    const std::string content = content_string(command);
+    const size_t pos_first = content.rfind(':');
+    const size_t pos_second = content.find(',', pos_first);
+    if (pos_first == std::string::npos || pos_second == std::string::npos)
+        return "E01";
+
+    const size_t offset = parse_hex(content.substr(pos_first + 1, pos_second - pos_first - 1));
+    const size_t length = parse_hex(content.substr(pos_second + 1));
+    if (offset >= document.size())
+        return "l";
+
+    const size_t size = std::min(length, document.size() - offset);
+    const char status = offset + size < document.size() ? 'm' : 'l';
+    return status + escape_binary(reinterpret_cast<const uint8_t *>(document.data()) + offset, size);
+}
+
+// the whole thread list with the names at once, instead of a qfThreadInfo and qsThreadInfo packet for each thread
+static std::string cmd_read_threads(EmuEnvState &state, PacketCommand &command) {
+    std::string document = "<?xml version=\"1.0\"?>\n<threads>\n";
+    {
+        const ProfiledLockGuard guard(state.kernel.mutex);
+        for (const auto &[id, thread] : state.kernel.threads)
+            document += fmt::format("<thread id=\"{}\" name=\"{}\"/>\n", to_hex(id), escape_xml(thread->name));
+    }
+    document += "</threads>\n";
+
+    return xfer_reply(document, command);
+}
+
 static std::string cmd_detach(EmuEnvState &state, PacketCommand &command) { return "OK"; }
 
 static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
@@ -440,7 +531,7 @@ static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
             // step or run that thread
 
             if (state.gdb.inferior_thread != 0) {
-                const auto guard = std::lock_guard(state.kernel.mutex);
+                const ProfiledLockGuard guard(state.kernel.mutex);
                 auto thread = state.kernel.threads[state.gdb.inferior_thread];
                 auto thread_lock = std::unique_lock(thread->mutex);
                 thread->resume(step);
@@ -454,7 +545,7 @@ static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
             if (!step) {
                 // resume the world
                 {
-                    auto lock = std::unique_lock(state.kernel.mutex);
+                    auto lock = std::unique_lock(state.kernel.mutex.get_mutex());
                     for (const auto &pair : state.kernel.threads) {
                         auto &thread = pair.second;
                         if (thread->status == ThreadStatus::suspend) {
@@ -494,7 +585,7 @@ static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
 
                 // stop the world
                 {
-                    auto lock = std::unique_lock(state.kernel.mutex);
+                    auto lock = std::unique_lock(state.kernel.mutex.get_mutex());
                     for (const auto &pair : state.kernel.threads) {
                         auto thread = pair.second;
                         if (thread->status == ThreadStatus::run) {
@@ -524,7 +615,7 @@ static std::string cmd_continue_supported(EmuEnvState &state, PacketCommand &com
 }
 
 static std::string cmd_thread_alive(EmuEnvState &state, PacketCommand &command) {
-    const auto guard = std::lock_guard(state.kernel.mutex);
+    const ProfiledLockGuard guard(state.kernel.mutex);
     const std::string content = content_string(command);
     const int32_t thread_id = parse_hex(content.substr(1));
 
@@ -551,7 +642,7 @@ static std::string cmd_thread_status(EmuEnvState &state, PacketCommand &command)
 static std::string cmd_reason(EmuEnvState &state, PacketCommand &command) { return "S05"; }
 
 static std::string cmd_get_first_thread(EmuEnvState &state, PacketCommand &command) {
-    const auto guard = std::lock_guard(state.kernel.mutex);
+    const ProfiledLockGuard guard(state.kernel.mutex);
     std::stringstream stream;
 
     stream << "m";
@@ -563,7 +654,7 @@ static std::string cmd_get_first_thread(EmuEnvState &state, PacketCommand &comma
 }
 
 static std::string cmd_get_next_thread(EmuEnvState &state, PacketCommand &command) {
-    const auto guard = std::lock_guard(state.kernel.mutex);
+    const ProfiledLockGuard guard(state.kernel.mutex);
     std::stringstream stream;
 
     ++state.gdb.thread_info_index;
@@ -645,7 +736,8 @@ const static PacketFunctionBundle functions[] = {
     { "G", cmd_write_registers },
     { "m", cmd_read_memory },
     { "M", cmd_write_memory },
-    { "X", cmd_unimplemented }, // change cmd_unimplemented to cmd_write_binary to enable binary downloading
+    { "X", cmd_write_binary },
+    { "x", cmd_read_binary },
 
     // Query Packets
     { "qfThreadInfo", cmd_get_first_thread },
@@ -654,6 +746,7 @@ const static PacketFunctionBundle functions[] = {
     { "qAttached", cmd_attached },
     { "qTStatus", cmd_thread_status },
     { "qC", cmd_get_current_thread },
+    { "qXfer:threads:read", cmd_read_threads },
     { "q", cmd_unimplemented },
     { "Q", cmd_unimplemented },
 
@@ -702,6 +795,17 @@ static bool command_begins_with(PacketCommand &command, const std::string &small
     return std::memcmp(command.content_start, small_str.c_str(), small_str.size()) == 0;
 }
 
+// '$' and '#' are escaped in binary data, so the last '$' starts the last packet
+static bool is_last_packet_complete(const char *data, int64_t length) {
+    const char *const end = data + length;
+    const auto begin = std::find(std::make_reverse_iterator(end), std::make_reverse_iterator(data), '$');
+    if (begin == std::make_reverse_iterator(data))
+        return true;
+
+    const char *const hash = std::find(begin.base(), end, '#');
+    return end - hash >= 3;
+}
+
 static int64_t server_next(EmuEnvState &state) {
     PacketData buffer;
 
@@ -715,11 +819,21 @@ static int64_t server_next(EmuEnvState &state) {
     if (state.gdb.server_die)
         return -1;
 
-    const int64_t length = recv(state.gdb.client_socket, buffer, sizeof(buffer), 0);
+    int64_t length = recv(state.gdb.client_socket, buffer, sizeof(buffer) - 1, 0);
     if (length <= 0) {
         LOG_GDB("GDB Server Connection Closed");
         return -1;
     }
+
+    // a large packet can be received in several parts, wait for its end
+    while (!is_last_packet_complete(buffer, length) && length < static_cast<int64_t>(sizeof(buffer)) - 1) {
+        const int64_t received = recv(state.gdb.client_socket, buffer + length, sizeof(buffer) - 1 - length, 0);
+        if (received <= 0) {
+            LOG_GDB("GDB Server Connection Closed");
+            return -1;
+        }
+        length += received;
+    }
     buffer[length] = '\0';
 
     for (int64_t a = 0; a < length; a++) {
@@ -729,7 +843,7 @@ static int64_t server_next(EmuEnvState &state) {
         }
         case '-': {
             LOG_GDB("GDB Server Transmission Error. {}", std::string(buffer, length));
-            server_reply(state.gdb, state.gdb.last_reply.c_str());
+            server_reply(state.gdb, state.gdb.last_reply.data(), state.gdb.last_reply.size());
             break;
         }
         case '$': {
@@ -744,7 +858,7 @@ static int64_t server_next(EmuEnvState &state) {
                         state.gdb.last_reply = function.function(state, command);
                         if (state.gdb.server_die)
                             break;
-                        server_reply(state.gdb, state.gdb.last_reply.c_str());
+                        server_reply(state.gdb, state.gdb.last_reply.data(), state.gdb.last_reply.size());
                         break;
                     }
                 }
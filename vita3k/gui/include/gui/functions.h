@@ -20,6 +20,7 @@
 #include <gui/state.h>
 
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -46,12 +47,16 @@ void close_live_area_app(GuiState &gui, EmuEnvState &emuenv, const std::string &
 void close_system_app(GuiState &gui, EmuEnvState &emuenv);
 void delete_app(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 void get_app_info(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
-size_t get_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
+// compute the size of the app and its additional content away from the UI thread
+void request_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
+// empty while the size is computed
+std::optional<size_t> get_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 std::vector<App>::iterator get_app_index(GuiState &gui, const std::string &app_path);
 std::map<std::string, ImGui_Texture>::const_iterator get_app_icon(GuiState &gui, const std::string &app_path);
 std::vector<std::string>::iterator get_live_area_current_open_apps_list_index(GuiState &gui, const std::string &app_path);
 std::map<DateTime, std::string> get_date_time(GuiState &gui, EmuEnvState &emuenv, const tm &date_time);
 std::string get_unit_size(const size_t size);
+std::string get_unit_size(const std::optional<size_t> &size);
 void get_app_param(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 std::string get_cpu_backend(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 void get_firmware_file(EmuEnvState &emuenv);
@@ -65,6 +70,7 @@ void get_users_list(GuiState &gui, EmuEnvState &emuenv);
 bool get_sys_apps_state(GuiState &gui);
 void get_sys_apps_title(GuiState &gui, EmuEnvState &emuenv);
 std::string get_sys_lang_name(uint32_t lang_id);
+bool has_pending_updates(GuiState &gui);
 void init(GuiState &gui, EmuEnvState &emuenv);
 void init_app_background(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 void init_app_icon(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
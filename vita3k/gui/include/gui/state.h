@@ -30,8 +30,16 @@
 #include <gui/imgui_impl_sdl_state.h>
 
 #include <glutil/object.h>
+#include <io/VitaIoDevice.h>
+#include <util/mapped_file.h>
+#include <util/task_pool.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <list>
 #include <mutex>
 #include <optional>
 #include <queue>
@@ -74,10 +82,17 @@ struct App {
     compat::CompatibilityState compat;
 };
 
+// modification times of an installed app when its param.sfo was read, the app is read again once one of them changes
+struct AppCacheStamp {
+    std::time_t dir_mtime = 0;
+    std::time_t sfo_mtime = 0;
+
+    bool operator==(const AppCacheStamp &rhs) const = default;
+};
+
 struct AppInfo {
     std::string trophy;
     tm updated;
-    size_t size;
 };
 
 struct IconData {
@@ -89,24 +104,150 @@ struct IconData {
     IconData();
 };
 
+// decoded icon kept in the icon cache, the pixels are RGBA
+struct CachedIcon {
+    // modification time of the icon0.png file it was decoded from
+    std::time_t mtime = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // either in the mapping of the cache file or in pixel_data
+    const uint8_t *pixels = nullptr;
+    std::vector<uint8_t> pixel_data;
+};
+
 struct IconAsyncLoader {
     std::mutex mutex;
 
     std::unordered_map<std::string, IconData> icon_data;
+    // the apps whose icon is not loaded yet, the visible ones are moved to the front
+    std::deque<std::string> queue;
 
-    std::thread thread;
+    // the icons are decoded by tasks of the task pool
+    TaskGroup tasks{ TaskPriority::Normal };
+    uint32_t running_count = 0;
     std::atomic_bool quit = false;
 
+    // icons decoded by a previous run, not modified once the tasks are started
+    fs::path icon_cache_path;
+    MappedFile icon_cache;
+    std::unordered_map<std::string, CachedIcon> cached_icons;
+    // icons decoded by this run, written to the cache by the last task
+    std::unordered_map<std::string, CachedIcon> decoded_icons;
+
     void commit(GuiState &gui);
+    // true while icons are decoded or are waiting to be committed
+    bool is_loading();
+    // move the icons of these apps to the front of the queue
+    void prioritize(const std::vector<std::string> &paths);
 
     IconAsyncLoader(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list);
     ~IconAsyncLoader();
 };
 
+struct DecodedImage {
+    int32_t width = 0;
+    int32_t height = 0;
+    // RGBA
+    std::vector<uint8_t> pixels;
+};
+
+typedef std::shared_ptr<const DecodedImage> DecodedImagePtr;
+
+struct ImageRequest {
+    VitaIoDevice device;
+    fs::path vfs_path;
+};
+
+// called on the UI thread with the images in the order of the requests, null for the ones which could not be loaded
+typedef std::function<void(GuiState &gui, const std::vector<DecodedImagePtr> &images)> ImagesCallback;
+
+// Reads and decodes the images of the live area and the backgrounds of the apps away from the UI thread.
+// The decoded images of the last apps are kept, so going back to one of them does not read them again.
+struct ImageAsyncLoader {
+    static constexpr size_t CACHE_SIZE = 128 * 1024 * 1024;
+
+    struct Job {
+        std::string app_path;
+        std::wstring pref_path;
+        std::vector<ImageRequest> requests;
+        ImagesCallback callback;
+        std::vector<DecodedImagePtr> images;
+    };
+
+    std::mutex mutex;
+    // notified when a job is added or the threads have to exit
+    std::condition_variable cond;
+    std::vector<std::thread> threads;
+    bool exiting = false;
+
+    std::deque<Job> pending_jobs;
+    // decoded by the threads, waiting for commit_loaded_images
+    std::vector<Job> done_jobs;
+    uint32_t running_jobs = 0;
+
+    // the least recently used images are at the back
+    std::list<std::pair<std::string, DecodedImagePtr>> cache;
+    std::unordered_map<std::string, std::list<std::pair<std::string, DecodedImagePtr>>::iterator> cache_index;
+    size_t cache_size = 0;
+
+    // the callback is called by commit once all the images are loaded
+    void load(EmuEnvState &emuenv, const std::string &app_path, std::vector<ImageRequest> requests, ImagesCallback callback);
+    void commit(GuiState &gui);
+    // true while images are decoded or are waiting to be committed
+    bool is_loading();
+    // forget the images of this app, they are read again the next time
+    void drop(const std::string &app_path);
+
+    ImageAsyncLoader() = default;
+    ImageAsyncLoader(const ImageAsyncLoader &) = delete;
+    ImageAsyncLoader &operator=(const ImageAsyncLoader &) = delete;
+    ~ImageAsyncLoader();
+};
+
+// size of the files of a directory, computed for this modification time of the directory
+struct DirSize {
+    std::time_t mtime = 0;
+    uint64_t size = 0;
+};
+
+// Computes the sizes of the directories shown by the content manager away from the UI thread.
+// A size is computed again once the modification time of its directory changes, the sizes are kept in the apps cache.
+struct SizeAsyncLoader {
+    std::mutex mutex;
+    // notified when a directory is added or the threads have to exit
+    std::condition_variable cond;
+    std::vector<std::thread> threads;
+    bool exiting = false;
+
+    std::deque<std::pair<fs::path, std::time_t>> pending_paths;
+    uint32_t running_jobs = 0;
+    // by generic path
+    std::map<std::string, DirSize> sizes;
+    // increased once a size is computed, the UI takes the new sizes when it changes
+    uint32_t generation = 0;
+    uint32_t saved_generation = 0;
+
+    // compute the size of the directory if it is not known for its current modification time
+    void request(const fs::path &path);
+    // the size of the directory, empty while it is computed
+    std::optional<uint64_t> find(const fs::path &path);
+    uint32_t get_generation();
+    // true once all the sizes are computed and some were not saved
+    bool should_save();
+    // true while sizes are computed or are waiting to be saved
+    bool is_loading();
+
+    SizeAsyncLoader() = default;
+    SizeAsyncLoader(const SizeAsyncLoader &) = delete;
+    SizeAsyncLoader &operator=(const SizeAsyncLoader &) = delete;
+    ~SizeAsyncLoader();
+};
+
 struct AppsSelector {
     std::vector<App> sys_apps;
     std::vector<App> user_apps;
     uint32_t apps_cache_lang;
+    std::map<std::string, AppCacheStamp> user_apps_stamps;
     AppInfo app_info;
     std::optional<IconAsyncLoader> icon_async_loader;
     std::map<std::string, ImGui_Texture> sys_apps_icon;
@@ -351,6 +492,8 @@ struct GuiState {
     ImGui_Texture start_background;
 
     std::map<std::string, ImGui_Texture> apps_background;
+    gui::ImageAsyncLoader image_loader;
+    gui::SizeAsyncLoader size_loader;
 
     InfoBarColor information_bar_color;
 
@@ -18,6 +18,7 @@
 #include "private.h"
 
 #include <cpu/functions.h>
+#include <util/memory_accounting.h>
 
 #include <imgui_memory_editor.h>
 
@@ -30,10 +31,50 @@ const char *blacklist[] = {
     "export_sceGxmDisplayQueueAddEntry"
 };
 
+// host memory reported by each module, the budgets are soft and make the caches evict their entries
+static void draw_host_memory() {
+    if (!ImGui::CollapsingHeader(fmt::format("Host Memory: {} MiB###host_memory", get_total_memory_usage() >> 20).c_str()))
+        return;
+
+    if (ImGui::BeginTable("##host_memory_table", 4, ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_NoSavedSettings)) {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("Used");
+        ImGui::TableSetupColumn("Peak");
+        ImGui::TableSetupColumn("Budget (MiB)");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+            const MemoryCategory category = static_cast<MemoryCategory>(i);
+            const MemoryCategoryUsage usage = get_memory_usage(category);
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(get_memory_category_name(category));
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%.1f MiB", usage.used / 1048576.0);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.1f MiB", usage.peak / 1048576.0);
+            ImGui::TableSetColumnIndex(3);
+            if (!is_memory_budget_enforced(category)) {
+                ImGui::TextDisabled("-");
+                continue;
+            }
+            // 0 for no budget
+            int budget = static_cast<int>(usage.budget >> 20);
+            ImGui::SetNextItemWidth(-FLT_MIN);
+            if (ImGui::InputInt(fmt::format("##budget_{}", i).c_str(), &budget, 16, 128))
+                set_memory_budget(category, static_cast<uint64_t>(std::max(budget, 0)) << 20);
+        }
+        ImGui::EndTable();
+    }
+    if (ImGui::Button("Reset Peaks"))
+        reset_memory_peaks();
+}
+
 void draw_allocations_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Memory Allocations", &gui.debug_menu.allocations_dialog);
 
-    const std::lock_guard<std::mutex> lock(emuenv.mem.generation_mutex);
+    draw_host_memory();
+
+    const ProfiledLockGuard lock(emuenv.mem.generation_mutex);
     for (const auto &pair : emuenv.mem.page_name_map) {
         const auto generation_num = pair.first;
         const auto generation_name = pair.second;
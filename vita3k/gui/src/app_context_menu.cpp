@@ -17,6 +17,7 @@
 
 #include "private.h"
 
+#include <compat/functions.h>
 #include <config/state.h>
 #include <config/version.h>
 #include <gui/functions.h>
@@ -308,8 +309,9 @@ void draw_app_context_menu(GuiState &gui, EmuEnvState &emuenv, const std::string
     auto &lang_compat = gui.lang.compatibility;
 
     const auto is_commercial_app = title_id.find("PCS") != std::string::npos;
-    const auto has_state_report = gui.compat.compat_db_loaded ? gui.compat.app_compat_db.contains(title_id) : false;
-    const auto compat_state = has_state_report ? gui.compat.app_compat_db[title_id].state : compat::UNKNOWN;
+    const auto app_compat = gui.compat.compat_db_loaded ? compat::find_app_compat(gui.compat, title_id) : std::nullopt;
+    const auto has_state_report = app_compat.has_value();
+    const auto compat_state = has_state_report ? app_compat->state : compat::UNKNOWN;
     const auto compat_state_color = gui.compat.compat_color[compat_state];
     const auto compat_state_str = has_state_report ? lang_compat.states[compat_state] : lang_compat.states[compat::UNKNOWN];
 
@@ -333,7 +335,7 @@ void draw_app_context_menu(GuiState &gui, EmuEnvState &emuenv, const std::string
                     ImGui::Spacing();
                     if (has_state_report) {
                         tm updated_at_tm = {};
-                        SAFE_LOCALTIME(&gui.compat.app_compat_db[title_id].updated_at, &updated_at_tm);
+                        SAFE_LOCALTIME(&app_compat->updated_at, &updated_at_tm);
                         auto UPDATED_AT = get_date_time(gui, emuenv, updated_at_tm);
                         ImGui::Spacing();
                         const auto updated_at_str = fmt::format("{} {} {} {}", lang.info["updated"].c_str(), UPDATED_AT[DateTime::DATE_MINI], UPDATED_AT[DateTime::CLOCK], is_12_hour_format ? UPDATED_AT[DateTime::DAY_MOMENT] : "");
@@ -356,7 +358,7 @@ void draw_app_context_menu(GuiState &gui, EmuEnvState &emuenv, const std::string
                             copy_vita3k_summary();
                         if (ImGui::MenuItem(lang.main["open_state_report"].c_str())) {
                             copy_vita3k_summary();
-                            open_path(fmt::format("{}/{}", ISSUES_URL, gui.compat.app_compat_db[title_id].issue_id));
+                            open_path(fmt::format("{}/{}", ISSUES_URL, app_compat->issue_id));
                         }
                     } else {
                         if (ImGui::MenuItem(lang.main["create_state_report"].c_str())) {
@@ -501,8 +503,7 @@ void draw_app_context_menu(GuiState &gui, EmuEnvState &emuenv, const std::string
         if (ImGui::MenuItem(lang.main["information"].c_str(), nullptr, &gui.vita_area.app_information)) {
             if (title_id.find("NPXS") == std::string::npos) {
                 get_app_info(gui, emuenv, app_path);
-                const auto app_size = get_app_size(gui, emuenv, app_path);
-                gui.app_selector.app_info.size = app_size;
+                request_app_size(gui, emuenv, app_path);
             }
             gui.vita_area.information_bar = false;
         }
@@ -629,7 +630,7 @@ void draw_app_context_menu(GuiState &gui, EmuEnvState &emuenv, const std::string
             }
             ImGui::Spacing();
             ImGui::SetCursorPosX((display_size.x / 2.f) - ImGui::CalcTextSize((lang.info["size"] + "  ").c_str()).x);
-            ImGui::TextColored(GUI_COLOR_TEXT, "%s", (lang.info["size"] + "  " + get_unit_size(gui.app_selector.app_info.size)).c_str());
+            ImGui::TextColored(GUI_COLOR_TEXT, "%s", (lang.info["size"] + "  " + get_unit_size(get_app_size(gui, emuenv, app_path))).c_str());
             ImGui::Spacing();
             ImGui::SetCursorPosX((display_size.x / 2.f) - ImGui::CalcTextSize((lang.info["version"] + "  ").c_str()).x);
             ImGui::TextColored(GUI_COLOR_TEXT, "%s  %s", lang.info["version"].c_str(), APP_INDEX->app_ver.c_str());
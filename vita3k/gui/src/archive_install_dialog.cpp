@@ -23,11 +23,10 @@
 #include <packages/sfo.h>
 
 #include <util/string_utils.h>
+#include <util/task_pool.h>
 
 #include <fmt/std.h>
 
-#include <thread>
-
 namespace gui {
 
 static bool delete_archive_file;
@@ -126,7 +125,7 @@ void draw_archive_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
                 type.clear();
             }
         } else if (state == "install") {
-            std::thread installation([&emuenv, &gui]() {
+            submit_task(TaskPriority::Background, [&emuenv, &gui]() {
                 global_progress = 1.f;
                 const auto install_archive_contents = [&](const fs::path &archive_path) {
                     const auto result = install_archive(emuenv, &gui, archive_path, progress_callback);
@@ -157,7 +156,6 @@ void draw_archive_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
                 global_progress = 0.f;
                 state = "finished";
             });
-            installation.detach();
             state = "installing";
         } else if (state == "installing") {
             title = indicator["installing"];
@@ -64,7 +64,7 @@ void draw_pre_compiling_shaders_progress(GuiState &gui, EmuEnvState &emuenv, con
     ImGui::ProgressBar(progress_programs / 100.f, ImVec2(PROGRESS_BAR_WIDTH, 15.f * emuenv.dpi_scale), "");
     ImGui::PopStyleColor();
     ImGui::PopStyleVar();
-    const auto progress_programs_str = fmt::format("{}/{}", emuenv.renderer->programs_count_pre_compiled, total);
+    const auto progress_programs_str = fmt::format("{}/{}", emuenv.renderer->programs_count_pre_compiled.load(), total);
     ImGui::SetCursorPos(ImVec2((ImGui::GetWindowWidth() / 2.f) - (ImGui::CalcTextSize(progress_programs_str.c_str()).x / 2.f), ImGui::GetCursorPosY() + (6.f * emuenv.dpi_scale)));
     ImGui::TextColored(GUI_COLOR_TEXT, "%s", progress_programs_str.c_str());
     ImGui::End();
@@ -25,7 +25,7 @@ void draw_condvars_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Condition Variables", &gui.debug_menu.condvars_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-16s %-16s", "ID", "Name", "Attributes", "Waiting Threads");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
 
     for (const auto &condvar : emuenv.kernel.condvars) {
         std::shared_ptr<Condvar> sema_state = condvar.second;
@@ -42,7 +42,7 @@ void draw_lw_condvars_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Lightweight Condition Variables", &gui.debug_menu.lwcondvars_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-16s %-16s", "ID", "Name", "Attributes", "Waiting Threads");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
 
     for (const auto &condvar : emuenv.kernel.lwcondvars) {
         std::shared_ptr<Condvar> sema_state = condvar.second;
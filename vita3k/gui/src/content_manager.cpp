@@ -32,18 +32,6 @@
 #include <util/safe_time.h>
 
 namespace gui {
-namespace {
-template <typename T>
-auto get_recursive_directory_size(const T &path) {
-    const auto &path_list = fs::recursive_directory_iterator(path);
-    const auto pred = [](const auto acc, const auto &app) {
-        if (fs::is_regular_file(app.path()))
-            return acc + fs::file_size(app.path());
-        return acc;
-    };
-    return boost::accumulate(path_list, boost::uintmax_t{}, pred);
-}
-} // namespace
 
 void get_app_info(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
     const auto APP_PATH{ emuenv.pref_path / "ux0/app" / app_path };
@@ -58,17 +46,18 @@ void get_app_info(GuiState &gui, EmuEnvState &emuenv, const std::string &app_pat
     }
 }
 
-size_t get_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
-    const auto APP_PATH{ emuenv.pref_path / "ux0/app" / app_path };
-    boost::uintmax_t app_size = 0;
-    if (fs::exists(APP_PATH) && !fs::is_empty(APP_PATH)) {
-        app_size += get_recursive_directory_size(APP_PATH);
-    }
-    const auto ADDCONT_PATH{ emuenv.pref_path / "ux0/addcont" / get_app_index(gui, app_path)->title_id };
-    if (fs::exists(ADDCONT_PATH) && !fs::is_empty(ADDCONT_PATH)) {
-        app_size += get_recursive_directory_size(ADDCONT_PATH);
-    }
-    return app_size;
+void request_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    gui.size_loader.request(emuenv.pref_path / "ux0/app" / app_path);
+    gui.size_loader.request(emuenv.pref_path / "ux0/addcont" / get_app_index(gui, app_path)->title_id);
+}
+
+std::optional<size_t> get_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    const auto app_size = gui.size_loader.find(emuenv.pref_path / "ux0/app" / app_path);
+    const auto addcont_size = gui.size_loader.find(emuenv.pref_path / "ux0/addcont" / get_app_index(gui, app_path)->title_id);
+    if (!app_size || !addcont_size)
+        return std::nullopt;
+
+    return *app_size + *addcont_size;
 }
 
 std::string get_unit_size(const size_t size) {
@@ -85,10 +74,14 @@ std::string get_unit_size(const size_t size) {
     return size_str;
 }
 
+std::string get_unit_size(const std::optional<size_t> &size) {
+    return size ? get_unit_size(*size) : "...";
+}
+
 struct SaveData {
     std::string title;
     std::string title_id;
-    size_t size;
+    fs::path path;
     tm date;
 };
 
@@ -109,8 +102,8 @@ static void get_save_data_list(GuiState &gui, EmuEnvState &emuenv) {
             const auto last_writen = fs::last_write_time(save);
             SAFE_LOCALTIME(&last_writen, &updated_tm);
 
-            const auto size = get_recursive_directory_size(save);
-            save_data_list.push_back({ get_app_index(gui, title_id)->title, title_id, size, updated_tm });
+            gui.size_loader.request(save.path());
+            save_data_list.push_back({ get_app_index(gui, title_id)->title, title_id, save.path(), updated_tm });
         }
     }
     std::sort(save_data_list.begin(), save_data_list.end(), [](const SaveData &sa, const SaveData &sb) {
@@ -120,83 +113,100 @@ static void get_save_data_list(GuiState &gui, EmuEnvState &emuenv) {
 
 static std::map<std::string, size_t> apps_size;
 static std::map<std::string, std::string> space;
-
-void init_content_manager(GuiState &gui, EmuEnvState &emuenv) {
-    space.clear();
-
-    const auto free_size{ fs::space(emuenv.pref_path).free };
-    space["free"] = get_unit_size(free_size);
-
-    const auto query_app = [&gui, &emuenv] {
-        const auto &directory_list = gui.app_selector.user_apps;
-        const auto pred = [&](const auto acc, const auto &app) {
-            apps_size[app.path] = get_app_size(gui, emuenv, app.path);
-            return acc + apps_size[app.path];
-        };
-        return boost::accumulate(directory_list, boost::uintmax_t{}, pred);
+// generation of the size loader the sizes were taken from
+static uint32_t sizes_generation;
+
+// take the sizes computed since the last call, the totals are shown once all their sizes are known
+static void update_content_sizes(GuiState &gui, EmuEnvState &emuenv) {
+    sizes_generation = gui.size_loader.get_generation();
+
+    const auto get_list_size_or_dash = [](const auto query) -> std::string {
+        const std::optional<size_t> list_size = query();
+        if (!list_size)
+            return "...";
+        return *list_size ? get_unit_size(*list_size) : "-";
     };
 
-    const auto query_savedata = [] {
-        const auto &directory_list = save_data_list;
-        const auto pred = [](const auto acc, const auto &save) { return acc + save.size; };
-        return boost::accumulate(directory_list, boost::uintmax_t{}, pred);
+    const auto query_app = [&gui, &emuenv] {
+        std::optional<size_t> total_size = 0;
+        for (const auto &app : gui.app_selector.user_apps) {
+            const auto app_size = get_app_size(gui, emuenv, app.path);
+            if (app_size)
+                apps_size[app.path] = *app_size;
+            total_size = (total_size && app_size) ? std::optional<size_t>(*total_size + *app_size) : std::nullopt;
+        }
+        return total_size;
     };
 
-    const auto query_themes = [&emuenv] {
-        const auto THEME_PATH{ emuenv.pref_path / "ux0/theme" };
-        if (fs::exists(THEME_PATH) && !fs::is_empty(THEME_PATH)) {
-            return get_recursive_directory_size(THEME_PATH);
+    const auto query_savedata = [&gui] {
+        std::optional<size_t> total_size = 0;
+        for (const auto &save : save_data_list) {
+            const auto save_size = gui.size_loader.find(save.path);
+            total_size = (total_size && save_size) ? std::optional<size_t>(*total_size + *save_size) : std::nullopt;
         }
-        return boost::uintmax_t{};
+        return total_size;
     };
 
-    const auto get_list_size_or_dash = [](const auto query) {
-        const auto list_size = query();
-        return list_size ? get_unit_size(list_size) : "-";
+    const auto query_themes = [&gui, &emuenv] {
+        return gui.size_loader.find(emuenv.pref_path / "ux0/theme");
     };
 
     space["app"] = get_list_size_or_dash(query_app);
-    get_save_data_list(gui, emuenv);
     space["savedata"] = get_list_size_or_dash(query_savedata);
     space["themes"] = get_list_size_or_dash(query_themes);
 }
 
+void init_content_manager(GuiState &gui, EmuEnvState &emuenv) {
+    space.clear();
+    apps_size.clear();
+
+    const auto free_size{ fs::space(emuenv.pref_path).free };
+    space["free"] = get_unit_size(free_size);
+
+    // the sizes are computed by the size loader, the ones already known are shown right away
+    for (const auto &app : gui.app_selector.user_apps)
+        request_app_size(gui, emuenv, app.path);
+    get_save_data_list(gui, emuenv);
+    gui.size_loader.request(emuenv.pref_path / "ux0/theme");
+
+    update_content_sizes(gui, emuenv);
+}
+
 static std::map<std::string, bool> contents_selected;
 static std::string app_selected, size_selected_contents, menu, title;
 
 static bool get_size_selected_contents(GuiState &gui, EmuEnvState &emuenv) {
     size_selected_contents.clear();
-    const auto pred = [](const auto acc, const auto &content) {
+    const auto pred = [&gui](const auto acc, const auto &content) {
         if (content.second) {
             if (menu == "app")
-                return acc + apps_size[content.first];
+                return acc + (apps_size.contains(content.first) ? apps_size[content.first] : 0);
             else {
                 const auto save_index = std::find_if(save_data_list.begin(), save_data_list.end(), [&](const SaveData &s) {
                     return s.title_id == content.first;
                 });
-                return acc + save_index->size;
+                return acc + gui.size_loader.find(save_index->path).value_or(0);
             }
         }
         return acc;
     };
     const auto contents_size = boost::accumulate(contents_selected, size_t{}, pred);
     size_selected_contents = get_unit_size(contents_size);
-    return contents_size;
+
+    // the contents whose size is still computed can be deleted too
+    return std::any_of(contents_selected.begin(), contents_selected.end(), [](const auto &content) { return content.second; });
 }
 
 struct AddCont {
     std::string name;
-    std::string size;
+    fs::path path;
     tm date;
 };
 
 static std::map<std::string, AddCont> addcont_info;
 
 static void get_content_info(GuiState &gui, EmuEnvState &emuenv) {
-    const auto APP_PATH{ emuenv.pref_path / "ux0/app" / app_selected };
-    if (fs::exists(APP_PATH) && !fs::is_empty(APP_PATH)) {
-        gui.app_selector.app_info.size = get_recursive_directory_size(APP_PATH);
-    }
+    gui.size_loader.request(emuenv.pref_path / "ux0/app" / app_selected);
 
     addcont_info.clear();
     const auto ADDCONT_PATH{ emuenv.pref_path / "ux0/addcont" / app_selected };
@@ -207,8 +217,8 @@ static void get_content_info(GuiState &gui, EmuEnvState &emuenv) {
             const auto last_writen = fs::last_write_time(addcont);
             SAFE_LOCALTIME(&last_writen, &addcont_info[content_id].date);
 
-            const auto addcont_size = get_recursive_directory_size(addcont);
-            addcont_info[content_id].size = get_unit_size(addcont_size);
+            gui.size_loader.request(addcont.path());
+            addcont_info[content_id].path = addcont.path();
 
             const auto content_path{ fs::path("addcont") / app_selected / content_id };
             vfs::FileBuffer params;
@@ -251,6 +261,9 @@ void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
     const auto has_background = gui.apps_background.contains("NPXS10026");
     const auto is_12_hour_format = emuenv.cfg.sys_time_format == SCE_SYSTEM_PARAM_TIME_FORMAT_12HOUR;
 
+    if (gui.size_loader.get_generation() != sizes_generation)
+        update_content_sizes(gui, emuenv);
+
     ImGui::SetNextWindowPos(WINDOW_POS, ImGuiCond_Always);
     ImGui::SetNextWindowSize(WINDOW_SIZE, ImGuiCond_Always);
     ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.f);
@@ -441,7 +454,7 @@ void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
                     ImGui::TextColored(GUI_COLOR_TEXT, "%s", app.title.c_str());
                     ImGui::SetCursorPosY(Title_POS + (46.f * SCALE.y));
                     ImGui::SetWindowFontScale(0.8f);
-                    ImGui::TextColored(GUI_COLOR_TEXT, "%s", get_unit_size(apps_size[app.path]).c_str());
+                    ImGui::TextColored(GUI_COLOR_TEXT, "%s", (apps_size.contains(app.path) ? get_unit_size(apps_size[app.path]) : get_unit_size(std::nullopt)).c_str());
                     ImGui::NextColumn();
                     ImGui::SetWindowFontScale(1.2f);
                     ImGui::SetCursorPosY(ImGui::GetCursorPosY() + (15.f * SCALE.y));
@@ -525,7 +538,7 @@ void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
             ImGui::SetCursorPosY(ImGui::GetCursorPosY() + (35.f * SCALE.y));
             ImGui::TextColored(GUI_COLOR_TEXT, "%s", info["size"].c_str());
             ImGui::SameLine(310.f * SCALE.x);
-            ImGui::TextColored(GUI_COLOR_TEXT, "%s", get_unit_size(gui.app_selector.app_info.size).c_str());
+            ImGui::TextColored(GUI_COLOR_TEXT, "%s", get_unit_size(gui.size_loader.find(emuenv.pref_path / "ux0/app" / app_selected)).c_str());
             ImGui::SetCursorPosY(ImGui::GetCursorPosY() + (35.f * SCALE.y));
             ImGui::TextColored(GUI_COLOR_TEXT, "%s", info["version"].c_str());
             ImGui::SameLine(310.f * SCALE.x);
@@ -551,7 +564,7 @@ void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
                 ImGui::SetCursorPosY(ImGui::GetCursorPosY() + (35.f * SCALE.y));
                 ImGui::TextColored(GUI_COLOR_TEXT, "%s", info["size"].c_str());
                 ImGui::SameLine(280.f * SCALE.x);
-                ImGui::TextColored(GUI_COLOR_TEXT, "%s", addcont.second.size.c_str());
+                ImGui::TextColored(GUI_COLOR_TEXT, "%s", get_unit_size(gui.size_loader.find(addcont.second.path)).c_str());
             }
         }
     }
@@ -44,7 +44,7 @@ static char const *SDL_key_to_string[]{ "[unset]", "[unknown]", "[unknown]", "[u
     "Keypad Mem+", "Keypad Mem-", "Keypad Mem*", "Keypad Mem/", "Keypad +/-", "Keypad Clear", "Keypad ClearEntry", "Keypad Binary", "Keypad Octal",
     "Keypad Dec", "Keypad HexaDec", "[unset]", "[unset]", "LCtrl", "LShift", "LAlt", "Win/Cmd", "RCtrl", "RShift", "RAlt", "RWin/Cmd" };
 
-static const short total_key_entries = 28;
+static const short total_key_entries = 31;
 
 static bool exists_in_array(int *ptr, int val, size_t size) {
     if (!ptr || !size) {
@@ -83,6 +83,9 @@ static void prepare_map_array(EmuEnvState &emuenv, std::array<int, total_key_ent
     map[25] = emuenv.cfg.keyboard_gui_toggle_gui;
     map[26] = emuenv.cfg.keyboard_gui_fullscreen;
     map[27] = emuenv.cfg.keyboard_gui_toggle_touch;
+    map[28] = emuenv.cfg.keyboard_gui_toggle_turbo;
+    map[29] = emuenv.cfg.keyboard_gui_save_checkpoint;
+    map[30] = emuenv.cfg.keyboard_gui_load_checkpoint;
 }
 
 bool need_open_error_duplicate_key_popup = false;
@@ -185,6 +188,7 @@ void draw_controls_dialog(GuiState &gui, EmuEnvState &emuenv) {
         remapper_button(gui, emuenv, &emuenv.cfg.keyboard_gui_fullscreen, lang["full_screen"].c_str());
         remapper_button(gui, emuenv, &emuenv.cfg.keyboard_gui_toggle_touch, lang["toggle_touch"].c_str(), lang["toggle_touch_description"].c_str());
         remapper_button(gui, emuenv, &emuenv.cfg.keyboard_gui_toggle_gui, lang["toggle_gui_visibility"].c_str(), lang["toggle_gui_visibility_description"].c_str());
+        remapper_button(gui, emuenv, &emuenv.cfg.keyboard_gui_toggle_turbo, lang["toggle_turbo"].c_str(), lang["toggle_turbo_description"].c_str());
         ImGui::EndTable();
     }
     if (need_open_error_duplicate_key_popup) {
@@ -23,8 +23,7 @@
 #include <packages/functions.h>
 #include <util/log.h>
 #include <util/string_utils.h>
-
-#include <thread>
+#include <util/task_pool.h>
 
 namespace gui {
 
@@ -73,13 +72,12 @@ void draw_firmware_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
         finished_installing = false;
 
         if (result == host::dialog::filesystem::Result::SUCCESS) {
-            std::thread installation([&emuenv]() {
+            submit_task(TaskPriority::Background, [&emuenv]() {
                 install_pup(emuenv.pref_path.wstring(), pup_path.string(), progress_callback);
                 std::lock_guard<std::mutex> lock(install_mutex);
                 finished_installing = true;
                 get_firmware_version(emuenv);
             });
-            installation.detach();
         } else if (result == host::dialog::filesystem::Result::CANCEL) {
             gui.file_menu.firmware_install_dialog = false;
             draw_file_dialog = true;
@@ -42,7 +42,12 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -324,6 +329,164 @@ void init_app_icon(GuiState &gui, EmuEnvState &emuenv, const std::string &app_pa
 IconData::IconData()
     : data(nullptr, stbi_image_free) {}
 
+static constexpr char icon_cache_magic[4] = { 'V', 'I', 'C', 'N' };
+// increase this value when the format of the cache changes
+static constexpr uint32_t icon_cache_version = 1;
+
+struct IconCacheHeader {
+    char magic[4];
+    uint32_t format_version;
+    uint32_t icon_count;
+    uint32_t reserved;
+};
+
+struct IconCacheEntry {
+    int64_t mtime;
+    uint32_t width;
+    uint32_t height;
+    // offsets from the start of the file
+    uint64_t path_offset;
+    uint64_t pixels_offset;
+    uint32_t path_size;
+    uint32_t reserved;
+};
+
+static fs::path get_icon_path(EmuEnvState &emuenv, const std::string &app_path) {
+    return emuenv.pref_path / "ux0/app" / app_path / "sce_sys/icon0.png";
+}
+
+static void open_icon_cache(IconAsyncLoader &loader) {
+    if (!fs::exists(loader.icon_cache_path) || !loader.icon_cache.open(loader.icon_cache_path))
+        return;
+
+    const uint8_t *const data = loader.icon_cache.data();
+    const size_t size = loader.icon_cache.size();
+    const IconCacheHeader *const header = reinterpret_cast<const IconCacheHeader *>(data);
+    if (size < sizeof(IconCacheHeader) || memcmp(header->magic, icon_cache_magic, sizeof(icon_cache_magic)) != 0
+        || header->format_version != icon_cache_version
+        || size < sizeof(IconCacheHeader) + sizeof(IconCacheEntry) * static_cast<size_t>(header->icon_count)) {
+        LOG_WARN("Icon cache {} is invalid, ignoring it", loader.icon_cache_path.string());
+        loader.icon_cache.close();
+        return;
+    }
+
+    const IconCacheEntry *const entries = reinterpret_cast<const IconCacheEntry *>(data + sizeof(IconCacheHeader));
+    for (uint32_t i = 0; i < header->icon_count; i++) {
+        const IconCacheEntry &entry = entries[i];
+        const uint64_t pixels_size = static_cast<uint64_t>(entry.width) * entry.height * 4;
+        if (entry.path_offset > size || entry.path_size > size - entry.path_offset
+            || entry.pixels_offset > size || pixels_size > size - entry.pixels_offset) {
+            LOG_WARN("Icon cache {} is truncated, ignoring it", loader.icon_cache_path.string());
+            loader.cached_icons.clear();
+            loader.icon_cache.close();
+            return;
+        }
+
+        CachedIcon &icon = loader.cached_icons[std::string(reinterpret_cast<const char *>(data + entry.path_offset), entry.path_size)];
+        icon.mtime = static_cast<std::time_t>(entry.mtime);
+        icon.width = entry.width;
+        icon.height = entry.height;
+        icon.pixels = data + entry.pixels_offset;
+    }
+}
+
+static void save_icon_cache(IconAsyncLoader &loader, EmuEnvState &emuenv) {
+    // the icons of the previous runs are kept as long as their app is installed
+    std::map<std::string, const CachedIcon *> icons;
+    for (const auto &[path, icon] : loader.cached_icons) {
+        if (fs::exists(get_icon_path(emuenv, path)))
+            icons.emplace(path, &icon);
+    }
+    for (const auto &[path, icon] : loader.decoded_icons)
+        icons[path] = &icon;
+
+    IconCacheHeader header{};
+    memcpy(header.magic, icon_cache_magic, sizeof(icon_cache_magic));
+    header.format_version = icon_cache_version;
+    header.icon_count = static_cast<uint32_t>(icons.size());
+
+    std::vector<IconCacheEntry> entries;
+    uint64_t path_offset = sizeof(IconCacheHeader) + sizeof(IconCacheEntry) * icons.size();
+    uint64_t pixels_offset = path_offset;
+    for (const auto &[path, icon] : icons)
+        pixels_offset += path.size();
+    for (const auto &[path, icon] : icons) {
+        entries.push_back({ static_cast<int64_t>(icon->mtime), icon->width, icon->height, path_offset, pixels_offset, static_cast<uint32_t>(path.size()), 0 });
+        path_offset += path.size();
+        pixels_offset += static_cast<uint64_t>(icon->width) * icon->height * 4;
+    }
+
+    // the cache is written under a temporary name so another instance never maps a partial cache
+    boost::system::error_code error;
+    const fs::path temp_path = fs::path(loader.icon_cache_path).concat(".tmp");
+    {
+        fs::ofstream cache_file(temp_path, std::ios::out | std::ios::binary);
+        if (!cache_file.is_open()) {
+            LOG_ERROR("Failed to create icon cache {}", temp_path.string());
+            return;
+        }
+
+        cache_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        cache_file.write(reinterpret_cast<const char *>(entries.data()), sizeof(IconCacheEntry) * entries.size());
+        for (const auto &[path, icon] : icons)
+            cache_file.write(path.data(), path.size());
+        for (const auto &[path, icon] : icons)
+            cache_file.write(reinterpret_cast<const char *>(icon->pixels), static_cast<size_t>(icon->width) * icon->height * 4);
+
+        if (!cache_file.good()) {
+            LOG_ERROR("Failed to write icon cache {}", temp_path.string());
+            cache_file.close();
+            fs::remove(temp_path, error);
+            return;
+        }
+    }
+
+    // the mapping must be closed for the file to be replaced on Windows, the icons of the cache are all copied by now
+    loader.cached_icons.clear();
+    loader.icon_cache.close();
+    fs::rename(temp_path, loader.icon_cache_path, error);
+    if (error) {
+        LOG_ERROR("Failed to save icon cache {}: {}", loader.icon_cache_path.string(), error.message());
+        fs::remove(temp_path, error);
+    }
+}
+
+static IconData load_cached_app_icon(IconAsyncLoader &loader, GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    boost::system::error_code error;
+    const std::time_t mtime = fs::last_write_time(get_icon_path(emuenv, app_path), error);
+    // the default icon is used, it is not worth caching
+    if (error)
+        return load_app_icon(gui, emuenv, app_path);
+
+    const auto cached = loader.cached_icons.find(app_path);
+    if (cached != loader.cached_icons.end() && cached->second.mtime == mtime) {
+        const CachedIcon &icon = cached->second;
+        const size_t size = static_cast<size_t>(icon.width) * icon.height * 4;
+        IconData image;
+        image.width = static_cast<int32_t>(icon.width);
+        image.height = static_cast<int32_t>(icon.height);
+        image.data = std::unique_ptr<void, void (*)(void *)>(malloc(size), free);
+        memcpy(image.data.get(), icon.pixels, size);
+        return image;
+    }
+
+    IconData image = load_app_icon(gui, emuenv, app_path);
+    if (image.data) {
+        CachedIcon icon;
+        icon.mtime = mtime;
+        icon.width = static_cast<uint32_t>(image.width);
+        icon.height = static_cast<uint32_t>(image.height);
+        const uint8_t *const pixels = static_cast<const uint8_t *>(image.data.get());
+        icon.pixel_data.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * 4);
+        icon.pixels = icon.pixel_data.data();
+
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.decoded_icons[app_path] = std::move(icon);
+    }
+
+    return image;
+}
+
 void IconAsyncLoader::commit(GuiState &gui) {
     std::lock_guard<std::mutex> lock(mutex);
 
@@ -336,72 +499,106 @@ void IconAsyncLoader::commit(GuiState &gui) {
     icon_data.clear();
 }
 
+bool IconAsyncLoader::is_loading() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (running_count > 0) || !icon_data.empty();
+}
+
+void IconAsyncLoader::prioritize(const std::vector<std::string> &paths) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // the first path ends up at the front
+    for (auto path = paths.rbegin(); path != paths.rend(); ++path) {
+        const auto it = std::find(queue.begin(), queue.end(), *path);
+        if (it == queue.end() || it == queue.begin())
+            continue;
+        std::string moved = std::move(*it);
+        queue.erase(it);
+        queue.push_front(std::move(moved));
+    }
+}
+
 IconAsyncLoader::IconAsyncLoader(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list) {
     // I don't feel comfortable passing app_list down to be iterated by thread.
     // Methods like delete_app might mutate it, so I'd like to copy what I need now.
-    auto paths = [&app_list]() {
-        std::vector<std::string> copy(app_list.size());
-        std::transform(app_list.begin(), app_list.end(), copy.begin(), [](const auto &a) { return a.path; });
+    for (const auto &app : app_list)
+        queue.push_back(app.path);
 
-        return copy;
-    };
+    icon_cache_path = emuenv.pref_path / "ux0/temp/icons.dat";
+    open_icon_cache(*this);
 
-    quit = false;
-    thread = std::thread([&, paths = paths()]() {
-        for (const auto &path : paths) {
-            if (quit)
-                return;
-
-            // load the actual texture
-            IconData data = load_app_icon(gui, emuenv, path);
-
-            // Duplicate code here from init_app_icon
+    const auto load_icons = [this, &gui, &emuenv]() {
+        while (true) {
+            std::string path;
             {
                 std::lock_guard<std::mutex> lock(mutex);
-                icon_data[path] = std::move(data);
+                if (quit || queue.empty())
+                    break;
+                path = std::move(queue.front());
+                queue.pop_front();
             }
+
+            // load the actual texture
+            IconData data = load_cached_app_icon(*this, gui, emuenv, path);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            icon_data[path] = std::move(data);
         }
-    });
+
+        // the last task to finish saves the icons decoded by all of them
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--running_count > 0 || quit || decoded_icons.empty())
+                return;
+        }
+        save_icon_cache(*this, emuenv);
+    };
+
+    const uint32_t task_count = std::min(std::clamp(std::thread::hardware_concurrency() / 2, 1U, 4U), static_cast<uint32_t>(std::max<size_t>(queue.size(), 1)));
+    quit = false;
+    running_count = task_count;
+    for (uint32_t i = 0; i < task_count; i++)
+        tasks.submit(load_icons);
 }
 
 IconAsyncLoader::~IconAsyncLoader() {
     quit = true;
-    thread.join();
+    tasks.wait();
+}
+
+bool has_pending_updates(GuiState &gui) {
+    return (gui.app_selector.icon_async_loader && gui.app_selector.icon_async_loader->is_loading()) || gui.image_loader.is_loading() || gui.size_loader.is_loading();
 }
 
 void init_apps_icon(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list) {
     gui.app_selector.icon_async_loader.emplace(gui, emuenv, app_list);
 }
 
+// the apps whose background is read by the image loader
+static std::set<std::string> apps_background_loading;
+
 void init_app_background(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
-    if (gui.apps_background.contains(app_path))
+    if (gui.apps_background.contains(app_path) || apps_background_loading.contains(app_path))
         return;
 
     const auto APP_INDEX = get_app_index(gui, app_path);
-    int32_t width = 0;
-    int32_t height = 0;
-    vfs::FileBuffer buffer;
-
     const auto is_sys = app_path.find("NPXS") != std::string::npos;
-    if (is_sys)
-        vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path.wstring(), "app/" + app_path + "/sce_sys/pic0.png");
-    else
-        vfs::read_app_file(buffer, emuenv.pref_path.wstring(), app_path, "sce_sys/pic0.png");
+    const ImageRequest request = is_sys ? ImageRequest{ VitaIoDevice::vs0, fs::path("app") / app_path / "sce_sys/pic0.png" } : ImageRequest{ VitaIoDevice::ux0, fs::path("app") / app_path / "sce_sys/pic0.png" };
 
     const auto title = (APP_INDEX != gui.app_selector.sys_apps.end()) && (APP_INDEX != gui.app_selector.user_apps.end()) ? APP_INDEX->title : app_path;
 
-    if (buffer.empty()) {
-        LOG_WARN("Background not found for application {} [{}].", title, app_path);
-        return;
-    }
+    // the background of the app is drawn once it is loaded, the default one is drawn until then
+    apps_background_loading.insert(app_path);
+    gui.image_loader.load(emuenv, app_path, { request }, [app_path, title](GuiState &gui, const std::vector<DecodedImagePtr> &images) {
+        apps_background_loading.erase(app_path);
+        const DecodedImagePtr &image = images.front();
+        if (!image) {
+            LOG_WARN("Background not found or invalid for application {} [{}].", title, app_path);
+            return;
+        }
 
-    stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-    if (!data) {
-        LOG_ERROR("Invalid background for application {} [{}].", title, app_path);
-        return;
-    }
-    gui.apps_background[app_path].init(gui.imgui_state.get(), data, width, height);
-    stbi_image_free(data);
+        gui.apps_background[app_path].init(gui.imgui_state.get(), const_cast<uint8_t *>(image->pixels.data()), image->width, image->height);
+    });
 }
 
 std::string get_sys_lang_name(uint32_t lang_id) {
@@ -412,63 +609,168 @@ std::string get_sys_lang_name(uint32_t lang_id) {
     return current_sys_lang->second;
 }
 
-static bool get_user_apps(GuiState &gui, EmuEnvState &emuenv) {
-    const auto apps_cache_path{ emuenv.pref_path / "ux0/temp/apps.dat" };
-    fs::ifstream apps_cache(apps_cache_path, std::ios::in | std::ios::binary);
-    if (apps_cache.is_open()) {
-        gui.app_selector.user_apps.clear();
-        // Read size of apps list
-        size_t size;
-        apps_cache.read((char *)&size, sizeof(size));
-
-        // Check version of cache
-        uint32_t versionInFile;
-        apps_cache.read((char *)&versionInFile, sizeof(uint32_t));
-        if (versionInFile != 1) {
-            LOG_WARN("Current version of cache: {}, is outdated, recreate it.", versionInFile);
-            return false;
-        }
+static constexpr char apps_cache_magic[4] = { 'V', 'A', 'P', 'P' };
+// increase this value when the format of the cache changes
+static constexpr uint32_t apps_cache_version = 3;
+
+struct AppsCacheHeader {
+    char magic[4];
+    uint32_t format_version;
+    uint32_t lang;
+    uint32_t app_count;
+    uint32_t dir_size_count;
+};
+
+struct AppsCacheString {
+    // from the start of the file
+    uint32_t offset;
+    uint32_t size;
+};
+
+// the fields of an app stored in the cache, in their order in AppsCacheEntry
+template <typename T>
+static auto get_cached_app_fields(T &app) {
+    return std::array{ &app.app_ver, &app.category, &app.content_id, &app.addcont, &app.savedata, &app.parental_level, &app.stitle, &app.title, &app.title_id, &app.path };
+}
 
-        // Read language of cache
-        apps_cache.read((char *)&gui.app_selector.apps_cache_lang, sizeof(uint32_t));
-        if (gui.app_selector.apps_cache_lang != emuenv.cfg.sys_lang) {
-            LOG_WARN("Current lang of cache: {}, is diferent config: {}, recreate it.", get_sys_lang_name(gui.app_selector.apps_cache_lang), get_sys_lang_name(emuenv.cfg.sys_lang));
-            return false;
-        }
+static constexpr size_t APPS_CACHE_FIELD_COUNT = std::tuple_size_v<decltype(get_cached_app_fields(std::declval<App &>()))>;
 
-        // Read App info value
-        for (size_t a = 0; a < size; a++) {
-            auto read = [&apps_cache]() {
-                size_t size;
+struct AppsCacheEntry {
+    int64_t dir_mtime;
+    int64_t sfo_mtime;
+    AppsCacheString fields[APPS_CACHE_FIELD_COUNT];
+};
 
-                apps_cache.read((char *)&size, sizeof(size));
+// size of a directory computed by the size loader, they follow the entries of the apps
+struct AppsCacheDirSize {
+    AppsCacheString path;
+    int64_t mtime;
+    uint64_t size;
+};
 
-                std::vector<char> buffer(size); // dont trust std::string to hold buffer enough
-                apps_cache.read(buffer.data(), size);
+static fs::path get_apps_cache_path(EmuEnvState &emuenv) {
+    return emuenv.pref_path / "ux0/temp/apps.dat";
+}
+
+static AppCacheStamp get_app_stamp(EmuEnvState &emuenv, const std::string &app_path) {
+    const auto APP_PATH{ emuenv.pref_path / "ux0/app" / app_path };
+    AppCacheStamp stamp;
+    boost::system::error_code error;
+    stamp.dir_mtime = fs::last_write_time(APP_PATH, error);
+    stamp.sfo_mtime = fs::last_write_time(APP_PATH / "sce_sys/param.sfo", error);
+
+    return stamp;
+}
 
-                return std::string(buffer.begin(), buffer.end());
-            };
+// fills cached_apps with the apps of the cache, returns false when there is no usable cache
+static bool load_apps_cache(GuiState &gui, EmuEnvState &emuenv, std::map<std::string, App> &cached_apps) {
+    const auto apps_cache_path{ get_apps_cache_path(emuenv) };
+    MappedFile apps_cache;
+    if (!fs::exists(apps_cache_path) || !apps_cache.open(apps_cache_path))
+        return false;
+
+    const uint8_t *const data = apps_cache.data();
+    const size_t size = apps_cache.size();
+    const AppsCacheHeader *const header = reinterpret_cast<const AppsCacheHeader *>(data);
+
+    // Check version of cache
+    if (size < sizeof(AppsCacheHeader) || memcmp(header->magic, apps_cache_magic, sizeof(apps_cache_magic)) != 0
+        || header->format_version != apps_cache_version) {
+        LOG_WARN("Current version of cache is outdated, recreate it.");
+        return false;
+    }
 
-            App app;
+    // Check language of cache
+    gui.app_selector.apps_cache_lang = header->lang;
+    if (gui.app_selector.apps_cache_lang != emuenv.cfg.sys_lang) {
+        LOG_WARN("Current lang of cache: {}, is diferent config: {}, recreate it.", get_sys_lang_name(gui.app_selector.apps_cache_lang), get_sys_lang_name(emuenv.cfg.sys_lang));
+        return false;
+    }
 
-            app.app_ver = read();
-            app.category = read();
-            app.content_id = read();
-            app.addcont = read();
-            app.savedata = read();
-            app.parental_level = read();
-            app.stitle = read();
-            app.title = read();
-            app.title_id = read();
-            app.path = read();
+    if (size < sizeof(AppsCacheHeader) + sizeof(AppsCacheEntry) * static_cast<size_t>(header->app_count) + sizeof(AppsCacheDirSize) * static_cast<size_t>(header->dir_size_count)) {
+        LOG_WARN("Apps cache is truncated, recreate it.");
+        return false;
+    }
 
-            gui.app_selector.user_apps.push_back(app);
+    // Read App info value
+    const AppsCacheEntry *const entries = reinterpret_cast<const AppsCacheEntry *>(data + sizeof(AppsCacheHeader));
+    for (uint32_t i = 0; i < header->app_count; i++) {
+        const AppsCacheEntry &entry = entries[i];
+        App app{};
+        const auto fields = get_cached_app_fields(app);
+        for (size_t f = 0; f < APPS_CACHE_FIELD_COUNT; f++) {
+            const AppsCacheString &field = entry.fields[f];
+            if (field.offset > size || field.size > size - field.offset) {
+                LOG_WARN("Apps cache is truncated, recreate it.");
+                cached_apps.clear();
+                return false;
+            }
+            fields[f]->assign(reinterpret_cast<const char *>(data + field.offset), field.size);
         }
 
-        init_apps_icon(gui, emuenv, gui.app_selector.user_apps);
-        load_and_update_compat_user_apps(gui, emuenv);
+        gui.app_selector.user_apps_stamps[app.path] = { static_cast<std::time_t>(entry.dir_mtime), static_cast<std::time_t>(entry.sfo_mtime) };
+        const std::string app_path = app.path;
+        cached_apps.emplace(app_path, std::move(app));
     }
 
+    // the sizes are only used once the modification time of their directory is checked
+    const AppsCacheDirSize *const dir_sizes = reinterpret_cast<const AppsCacheDirSize *>(entries + header->app_count);
+    const std::lock_guard<std::mutex> lock(gui.size_loader.mutex);
+    for (uint32_t i = 0; i < header->dir_size_count; i++) {
+        const AppsCacheDirSize &dir_size = dir_sizes[i];
+        if (dir_size.path.offset > size || dir_size.path.size > size - dir_size.path.offset)
+            break;
+        const std::string path(reinterpret_cast<const char *>(data + dir_size.path.offset), dir_size.path.size);
+        gui.size_loader.sizes.emplace(path, DirSize{ static_cast<std::time_t>(dir_size.mtime), dir_size.size });
+    }
+
+    return true;
+}
+
+// the apps found in the cache with unchanged modification times are not read again
+static void scan_user_apps(GuiState &gui, EmuEnvState &emuenv, std::map<std::string, App> &cached_apps) {
+    const fs::path app_path{ emuenv.pref_path / "ux0/app" };
+    gui.app_selector.user_apps.clear();
+    if (!fs::exists(app_path))
+        return;
+
+    size_t read_count = 0;
+    for (const auto &app : fs::directory_iterator(app_path)) {
+        if (!app.path().empty() && fs::is_directory(app.path())
+            && !app.path().filename_is_dot() && !app.path().filename_is_dot_dot()) {
+            const auto app_path = app.path().stem().generic_string();
+            const auto cached_app = cached_apps.find(app_path);
+            const auto stamp = gui.app_selector.user_apps_stamps.find(app_path);
+            const auto is_unchanged = (cached_app != cached_apps.end()) && (stamp != gui.app_selector.user_apps_stamps.end()) && (stamp->second == get_app_stamp(emuenv, app_path));
+            if (is_unchanged)
+                gui.app_selector.user_apps.push_back(std::move(cached_app->second));
+            else {
+                get_app_param(gui, emuenv, app_path);
+                read_count++;
+            }
+            if (cached_app != cached_apps.end())
+                cached_apps.erase(cached_app);
+        }
+    }
+
+    // the apps left in the cache were removed
+    for (const auto &[path, app] : cached_apps)
+        gui.app_selector.user_apps_stamps.erase(path);
+
+    LOG_DEBUG("Found {} applications, {} read again", gui.app_selector.user_apps.size(), read_count);
+    if ((read_count > 0) || !cached_apps.empty())
+        save_apps_cache(gui, emuenv);
+}
+
+static bool get_user_apps(GuiState &gui, EmuEnvState &emuenv) {
+    std::map<std::string, App> cached_apps;
+    if (!load_apps_cache(gui, emuenv, cached_apps))
+        return false;
+
+    scan_user_apps(gui, emuenv, cached_apps);
+    init_apps_icon(gui, emuenv, gui.app_selector.user_apps);
+    load_and_update_compat_user_apps(gui, emuenv);
+
     return !gui.app_selector.user_apps.empty();
 }
 
@@ -477,41 +779,77 @@ void save_apps_cache(GuiState &gui, EmuEnvState &emuenv) {
     if (!fs::exists(temp_path))
         fs::create_directory(temp_path);
 
-    fs::ofstream apps_cache(temp_path / "apps.dat", std::ios::out | std::ios::binary);
-    if (apps_cache.is_open()) {
-        // Write Size of apps list
-        const auto size = gui.app_selector.user_apps.size();
-        apps_cache.write((char *)&size, sizeof(size));
-
-        // Write version of cache
-        const uint32_t versionInFile = 1;
-        apps_cache.write((char *)&versionInFile, sizeof(uint32_t));
-
-        // Write language of cache
-        gui.app_selector.apps_cache_lang = emuenv.cfg.sys_lang;
-        apps_cache.write((char *)&gui.app_selector.apps_cache_lang, sizeof(uint32_t));
-
-        // Write Apps list
-        for (const App &app : gui.app_selector.user_apps) {
-            auto write = [&apps_cache](const std::string &i) {
-                const auto size = i.length();
-
-                apps_cache.write((char *)&size, sizeof(size));
-                apps_cache.write(i.c_str(), size);
-            };
-
-            write(app.app_ver);
-            write(app.category);
-            write(app.content_id);
-            write(app.addcont);
-            write(app.savedata);
-            write(app.parental_level);
-            write(app.stitle);
-            write(app.title);
-            write(app.title_id);
-            write(app.path);
+    // Write header of cache
+    AppsCacheHeader header{};
+    memcpy(header.magic, apps_cache_magic, sizeof(apps_cache_magic));
+    header.format_version = apps_cache_version;
+    gui.app_selector.apps_cache_lang = emuenv.cfg.sys_lang;
+    header.lang = gui.app_selector.apps_cache_lang;
+    header.app_count = static_cast<uint32_t>(gui.app_selector.user_apps.size());
+
+    // the sizes of the directories which are still there
+    std::vector<std::pair<std::string, DirSize>> sizes;
+    {
+        const std::lock_guard<std::mutex> lock(gui.size_loader.mutex);
+        for (const auto &[path, size] : gui.size_loader.sizes) {
+            if (size.mtime != 0)
+                sizes.emplace_back(path, size);
+        }
+    }
+    header.dir_size_count = static_cast<uint32_t>(sizes.size());
+
+    // Write Apps list, the strings of all the apps and sizes follow their entries
+    std::vector<AppsCacheEntry> entries;
+    std::vector<AppsCacheDirSize> dir_sizes;
+    std::string strings;
+    const size_t strings_offset = sizeof(AppsCacheHeader) + sizeof(AppsCacheEntry) * gui.app_selector.user_apps.size() + sizeof(AppsCacheDirSize) * sizes.size();
+    for (const App &app : gui.app_selector.user_apps) {
+        const auto stamp = gui.app_selector.user_apps_stamps.find(app.path);
+        AppsCacheEntry entry{};
+        if (stamp != gui.app_selector.user_apps_stamps.end()) {
+            entry.dir_mtime = static_cast<int64_t>(stamp->second.dir_mtime);
+            entry.sfo_mtime = static_cast<int64_t>(stamp->second.sfo_mtime);
+        }
+
+        const auto fields = get_cached_app_fields(app);
+        for (size_t f = 0; f < APPS_CACHE_FIELD_COUNT; f++) {
+            entry.fields[f] = { static_cast<uint32_t>(strings_offset + strings.size()), static_cast<uint32_t>(fields[f]->size()) };
+            strings += *fields[f];
+        }
+        entries.push_back(entry);
+    }
+    for (const auto &[path, size] : sizes) {
+        dir_sizes.push_back({ { static_cast<uint32_t>(strings_offset + strings.size()), static_cast<uint32_t>(path.size()) }, static_cast<int64_t>(size.mtime), size.size });
+        strings += path;
+    }
+
+    // the cache is written under a temporary name so it is never read partially written
+    boost::system::error_code error;
+    const auto apps_cache_path{ get_apps_cache_path(emuenv) };
+    const auto apps_cache_temp_path{ temp_path / "apps.dat.tmp" };
+    {
+        fs::ofstream apps_cache(apps_cache_temp_path, std::ios::out | std::ios::binary);
+        if (!apps_cache.is_open()) {
+            LOG_ERROR("Failed to create apps cache {}", apps_cache_temp_path.string());
+            return;
+        }
+
+        apps_cache.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        apps_cache.write(reinterpret_cast<const char *>(entries.data()), sizeof(AppsCacheEntry) * entries.size());
+        apps_cache.write(reinterpret_cast<const char *>(dir_sizes.data()), sizeof(AppsCacheDirSize) * dir_sizes.size());
+        apps_cache.write(strings.data(), strings.size());
+        if (!apps_cache.good()) {
+            LOG_ERROR("Failed to write apps cache {}", apps_cache_temp_path.string());
+            apps_cache.close();
+            fs::remove(apps_cache_temp_path, error);
+            return;
         }
-        apps_cache.close();
+    }
+
+    fs::rename(apps_cache_temp_path, apps_cache_path, error);
+    if (error) {
+        LOG_ERROR("Failed to save apps cache {}: {}", apps_cache_path.string(), error.message());
+        fs::remove(apps_cache_temp_path, error);
     }
 }
 
@@ -581,6 +919,7 @@ void get_app_param(GuiState &gui, EmuEnvState &emuenv, const std::string &app_pa
         emuenv.app_info.app_version = emuenv.app_info.app_category = emuenv.app_info.app_parental_level = "N/A";
     }
     gui.app_selector.user_apps.push_back({ emuenv.app_info.app_version, emuenv.app_info.app_category, emuenv.app_info.app_content_id, emuenv.app_info.app_addcont, emuenv.app_info.app_savedata, emuenv.app_info.app_parental_level, emuenv.app_info.app_short_title, emuenv.app_info.app_title, emuenv.app_info.app_title_id, emuenv.app_path });
+    gui.app_selector.user_apps_stamps[app_path] = get_app_stamp(emuenv, app_path);
 }
 
 void get_user_apps_title(GuiState &gui, EmuEnvState &emuenv) {
@@ -588,16 +927,10 @@ void get_user_apps_title(GuiState &gui, EmuEnvState &emuenv) {
     if (!fs::exists(app_path))
         return;
 
-    gui.app_selector.user_apps.clear();
-    for (const auto &app : fs::directory_iterator(app_path)) {
-        if (!app.path().empty() && fs::is_directory(app.path())
-            && !app.path().filename_is_dot() && !app.path().filename_is_dot_dot()) {
-            const auto app_path = app.path().stem().generic_string();
-            get_app_param(gui, emuenv, app_path);
-        }
-    }
-
-    save_apps_cache(gui, emuenv);
+    std::map<std::string, App> cached_apps;
+    gui.app_selector.user_apps_stamps.clear();
+    load_apps_cache(gui, emuenv, cached_apps);
+    scan_user_apps(gui, emuenv, cached_apps);
 }
 
 void get_sys_apps_title(GuiState &gui, EmuEnvState &emuenv) {
@@ -735,6 +1068,11 @@ void draw_begin(GuiState &gui, EmuEnvState &emuenv) {
     // cant bind opengl context outside main thread on macos now
     if (gui.app_selector.icon_async_loader)
         gui.app_selector.icon_async_loader->commit(gui);
+    gui.image_loader.commit(gui);
+
+    // the sizes are kept with the apps once they are all computed
+    if (gui.size_loader.should_save())
+        save_apps_cache(gui, emuenv);
 }
 
 void draw_end(GuiState &gui, SDL_Window *window) {
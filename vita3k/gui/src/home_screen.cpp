@@ -32,6 +32,7 @@
 #include <util/log.h>
 #include <util/safe_time.h>
 #include <util/string_utils.h>
+#include <util/task_pool.h>
 
 using namespace std::string_literals;
 
@@ -47,7 +48,7 @@ void init_user_apps(GuiState &gui, EmuEnvState &emuenv) {
     if (gui.app_selector.icon_async_loader)
         gui.app_selector.icon_async_loader->quit = true;
 
-    std::thread init_apps([&gui, &emuenv]() {
+    submit_task(TaskPriority::Normal, [&gui, &emuenv]() {
         auto app_list_size = gui.app_selector.user_apps.size();
         gui.app_selector.user_apps.clear();
         get_user_apps_title(gui, emuenv);
@@ -75,7 +76,6 @@ void init_user_apps(GuiState &gui, EmuEnvState &emuenv) {
 
         return true;
     });
-    init_apps.detach();
 }
 
 void init_last_time_apps(GuiState &gui, EmuEnvState &emuenv) {
@@ -95,13 +95,13 @@ void init_last_time_apps(GuiState &gui, EmuEnvState &emuenv) {
 }
 
 void load_and_update_compat_user_apps(GuiState &gui, EmuEnvState &emuenv) {
-    std::thread load_and_update_compat_user_apps_thread([&gui, &emuenv]() {
+    // the compatibility database may be downloaded
+    submit_task(TaskPriority::Background, [&gui, &emuenv]() {
         if (!gui.compat.compat_db_loaded && compat::load_app_compat_db(gui, emuenv))
             gui.compat.compat_db_loaded = true;
         else if (compat::update_app_compat_db(gui, emuenv) && !emuenv.io.user_id.empty() && gui.users[emuenv.io.user_id].sort_apps_type == COMPAT)
             gui.app_selector.is_app_list_sorted = false;
     });
-    load_and_update_compat_user_apps_thread.detach();
 }
 
 std::vector<std::string>::iterator get_live_area_current_open_apps_list_index(GuiState &gui, const std::string &app_path) {
@@ -748,6 +748,8 @@ void draw_home_screen(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::PushStyleColor(ImGuiCol_Text, GUI_COLOR_TEXT);
 
     std::vector<int32_t> visible_apps{};
+    // visible apps whose icon is still loading
+    std::vector<std::string> visible_apps_without_icon{};
 
     const auto display_app = [&](const std::vector<gui::App> &apps_list, std::map<std::string, ImGui_Texture> &apps_icon) {
         for (const auto &app : apps_list) {
@@ -839,7 +841,8 @@ void draw_home_screen(GuiState &gui, EmuEnvState &emuenv) {
                     const auto POS_MIN = ImGui::GetCursorScreenPos();
                     const ImVec2 POS_MAX(POS_MIN.x + ICON_SIZE.x, POS_MIN.y + ICON_SIZE.y);
                     ImGui::GetWindowDrawList()->AddImageRounded(apps_icon[app.path], POS_MIN, POS_MAX, ImVec2(0, 0), ImVec2(1, 1), IM_COL32_WHITE, ICON_SIZE.x * VIEWPORT_SCALE.x, ImDrawFlags_RoundCornersAll);
-                }
+                } else if (is_not_sys_app)
+                    visible_apps_without_icon.push_back(app.path);
 
                 // Draw the custom config button
                 const auto IS_CUSTOM_CONFIG = fs::exists(emuenv.config_path / "config" / fmt::format("config_{}.xml", app.path));
@@ -861,7 +864,8 @@ void draw_home_screen(GuiState &gui, EmuEnvState &emuenv) {
 
             // Draw the compatibility badge for commercial apps when they are within the visible area.
             if (element_is_within_visible_area && (app.title_id.find("PCS") != std::string::npos)) {
-                const auto compat_state = (gui.compat.compat_db_loaded ? gui.compat.app_compat_db.contains(app.title_id) : false) ? gui.compat.app_compat_db[app.title_id].state : compat::UNKNOWN;
+                const auto app_compat = gui.compat.compat_db_loaded ? compat::find_app_compat(gui.compat, app.title_id) : std::nullopt;
+                const auto compat_state = app_compat ? app_compat->state : compat::UNKNOWN;
                 const auto compat_state_vec4 = gui.compat.compat_color[compat_state];
                 const ImU32 compat_state_color = IM_COL32((int)(compat_state_vec4.x * 255.0f), (int)(compat_state_vec4.y * 255.0f), (int)(compat_state_vec4.z * 255.0f), (int)(compat_state_vec4.w * 255.0f));
                 const auto current_pos = ImGui::GetCursorPos();
@@ -924,6 +928,10 @@ void draw_home_screen(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::SetWindowFontScale(1.f);
     ImGui::EndChild();
 
+    // Load the icons of the visible apps first
+    if (!visible_apps_without_icon.empty() && gui.app_selector.icon_async_loader)
+        gui.app_selector.icon_async_loader->prioritize(visible_apps_without_icon);
+
     // When visible apps list is not empty, set first visible app index to 0
     if (!visible_apps.empty())
         first_visible_app_index = visible_apps.front();
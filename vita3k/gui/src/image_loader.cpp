@@ -0,0 +1,169 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gui/state.h>
+
+#include <emuenv/state.h>
+#include <io/vfs.h>
+#include <util/log.h>
+
+#include <stb_image.h>
+
+#include <algorithm>
+
+namespace gui {
+
+static std::string get_cache_key(const std::string &app_path, const ImageRequest &request) {
+    return fmt::format("{}|{}:{}", app_path, request.device._to_string(), request.vfs_path.generic_string());
+}
+
+static DecodedImagePtr decode_image(const std::wstring &pref_path, const ImageRequest &request) {
+    vfs::FileBuffer buffer;
+    if (!vfs::read_file(request.device, buffer, pref_path, request.vfs_path) || buffer.empty())
+        return nullptr;
+
+    int32_t width = 0;
+    int32_t height = 0;
+    stbi_uc *data = stbi_load_from_memory(buffer.data(), static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
+    if (!data)
+        return nullptr;
+
+    auto image = std::make_shared<DecodedImage>();
+    image->width = width;
+    image->height = height;
+    image->pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
+    stbi_image_free(data);
+
+    return image;
+}
+
+static DecodedImagePtr find_cached_image(ImageAsyncLoader &loader, const std::string &key) {
+    const std::lock_guard<std::mutex> lock(loader.mutex);
+    const auto it = loader.cache_index.find(key);
+    if (it == loader.cache_index.end())
+        return nullptr;
+
+    loader.cache.splice(loader.cache.begin(), loader.cache, it->second);
+    return it->second->second;
+}
+
+static void add_cached_image(ImageAsyncLoader &loader, const std::string &key, const DecodedImagePtr &image) {
+    const std::lock_guard<std::mutex> lock(loader.mutex);
+    if (loader.cache_index.contains(key))
+        return;
+
+    loader.cache.emplace_front(key, image);
+    loader.cache_index.emplace(key, loader.cache.begin());
+    loader.cache_size += image->pixels.size();
+
+    // the image just added is kept even if it is larger than the cache on its own
+    while ((loader.cache_size > ImageAsyncLoader::CACHE_SIZE) && (loader.cache.size() > 1)) {
+        const auto &[oldest_key, oldest_image] = loader.cache.back();
+        loader.cache_size -= oldest_image->pixels.size();
+        loader.cache_index.erase(oldest_key);
+        loader.cache.pop_back();
+    }
+}
+
+static void run_image_loader(ImageAsyncLoader &loader) {
+    while (true) {
+        ImageAsyncLoader::Job job;
+        {
+            std::unique_lock<std::mutex> lock(loader.mutex);
+            loader.cond.wait(lock, [&] { return loader.exiting || !loader.pending_jobs.empty(); });
+            if (loader.exiting)
+                return;
+            job = std::move(loader.pending_jobs.front());
+            loader.pending_jobs.pop_front();
+            loader.running_jobs++;
+        }
+
+        for (const auto &request : job.requests) {
+            const std::string key = get_cache_key(job.app_path, request);
+            DecodedImagePtr image = find_cached_image(loader, key);
+            if (!image) {
+                image = decode_image(job.pref_path, request);
+                if (image)
+                    add_cached_image(loader, key, image);
+            }
+            job.images.push_back(std::move(image));
+        }
+
+        const std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.done_jobs.push_back(std::move(job));
+        loader.running_jobs--;
+    }
+}
+
+void ImageAsyncLoader::load(EmuEnvState &emuenv, const std::string &app_path, std::vector<ImageRequest> requests, ImagesCallback callback) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (exiting)
+        return;
+
+    // the threads are only started once an image is needed
+    if (threads.empty()) {
+        const uint32_t thread_count = std::clamp(std::thread::hardware_concurrency() / 4, 1U, 2U);
+        for (uint32_t i = 0; i < thread_count; i++)
+            threads.emplace_back(run_image_loader, std::ref(*this));
+    }
+
+    pending_jobs.push_back({ app_path, emuenv.pref_path.wstring(), std::move(requests), std::move(callback), {} });
+    cond.notify_one();
+}
+
+void ImageAsyncLoader::commit(GuiState &gui) {
+    std::vector<Job> jobs;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        jobs.swap(done_jobs);
+    }
+
+    // the callbacks can load other images
+    for (const auto &job : jobs)
+        job.callback(gui, job.images);
+}
+
+bool ImageAsyncLoader::is_loading() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return !pending_jobs.empty() || !done_jobs.empty() || (running_jobs > 0);
+}
+
+void ImageAsyncLoader::drop(const std::string &app_path) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const std::string prefix = app_path + "|";
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (it->first.starts_with(prefix)) {
+            cache_size -= it->second->pixels.size();
+            cache_index.erase(it->first);
+            it = cache.erase(it);
+        } else
+            ++it;
+    }
+}
+
+ImageAsyncLoader::~ImageAsyncLoader() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        cond.notify_all();
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+}
+
+} // namespace gui
@@ -623,8 +623,9 @@ IMGUI_API ImTextureID ImGui_ImplSdlVulkan_CreateTexture(ImGui_VulkanState &state
 
     std::tie(texture->image, texture->allocation) = vk_state.allocator.createImage(image_info, vkutil::vma_auto_alloc);
 
+    // the image is used by the graphics queue right after, so don't use a dedicated transfer queue
     vk::CommandBuffer transfer_buffer = vkutil::create_single_time_command(vk_state.device,
-        vk_state.transfer_command_pool);
+        vk_state.general_command_pool);
 
     vk::ImageMemoryBarrier image_transfer_optimal_barrier{
         .srcAccessMask = vk::AccessFlagBits(),
@@ -683,7 +684,10 @@ IMGUI_API ImTextureID ImGui_ImplSdlVulkan_CreateTexture(ImGui_VulkanState &state
         1, &image_shader_read_only_barrier // Image Memory Barriers
     );
 
-    vkutil::end_single_time_command(vk_state.device, vk_state.transfer_queue, vk_state.transfer_command_pool, transfer_buffer);
+    {
+        const ProfiledLockGuard guard(vk_state.general_queue_mutex);
+        vkutil::end_single_time_command(vk_state.device, vk_state.general_queue, vk_state.general_command_pool, transfer_buffer);
+    }
     vk_state.allocator.destroyBuffer(temp_buffer, temp_allocation);
 
     const vk::ComponentMapping mapping = is_alpha ? vk::ComponentMapping{ vk::ComponentSwizzle::eOne, vk::ComponentSwizzle::eOne, vk::ComponentSwizzle::eOne, vk::ComponentSwizzle::eR }
@@ -706,7 +710,10 @@ IMGUI_API void ImGui_ImplSdlVulkan_DeleteTexture(ImGui_VulkanState &state, ImTex
     auto texture_ptr = reinterpret_cast<TextureState *>(texture);
     auto &vk_state = get_renderer(state);
 
-    vk_state.device.waitIdle();
+    {
+        const ProfiledLockGuard guard(vk_state.general_queue_mutex);
+        vk_state.device.waitIdle();
+    }
     vk_state.device.destroy(texture_ptr->image_view);
     vk_state.allocator.destroyImage(texture_ptr->image, texture_ptr->allocation);
 
@@ -34,7 +34,6 @@
 #include <pugixml.hpp>
 
 #include <chrono>
-#include <stb_image.h>
 
 namespace gui {
 
@@ -62,6 +61,17 @@ static std::map<std::string, std::map<std::string, std::string>> target;
 static std::map<std::string, std::map<std::string, uint64_t>> current_item, last_time;
 static std::map<std::string, std::string> type;
 static std::map<std::string, int32_t> sku_flag;
+// increased each time the live area of an app is loaded, so the images of a previous load are not added
+static std::map<std::string, uint32_t> live_area_generation;
+
+// image of the live area read by the image loader
+struct LiveAreaImage {
+    // empty for the contents of the live area
+    std::string frame;
+    // name of the content, or background or image for the items of a frame
+    std::string item;
+    std::string name;
+};
 
 struct Items {
     ImVec2 gate_pos;
@@ -242,36 +252,22 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string &app_p
                 name["livearea-background"].erase(remove(name["livearea-background"].begin(), name["livearea-background"].end(), '\n'), name["livearea-background"].end());
             name["livearea-background"].erase(remove_if(name["livearea-background"].begin(), name["livearea-background"].end(), isspace), name["livearea-background"].end());
 
+            // the images are read by the image loader, they are added once all of them are loaded
+            std::vector<ImageRequest> requests;
+            std::vector<LiveAreaImage> images;
             for (const auto &contents : name) {
-                int32_t width = 0;
-                int32_t height = 0;
-                vfs::FileBuffer buffer;
-
                 if (contents.second.empty()) {
                     LOG_WARN("Content '{}' is empty for title {} [{}].", contents.first, app_path, APP_INDEX->title);
                     continue;
                 }
 
                 if (default_contents)
-                    vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path.wstring(), "data/internal/livearea/default/sce_sys/livearea/contents/" + contents.second);
+                    requests.push_back({ VitaIoDevice::vs0, "data/internal/livearea/default/sce_sys/livearea/contents/" + contents.second });
                 else if (app_device == VitaIoDevice::vs0)
-                    vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path.wstring(), "app/" + app_path + "/sce_sys/livearea/contents/" + contents.second);
+                    requests.push_back({ VitaIoDevice::vs0, "app/" + app_path + "/sce_sys/livearea/contents/" + contents.second });
                 else
-                    vfs::read_app_file(buffer, emuenv.pref_path.wstring(), app_path, live_area_path.string() + "/contents/" + contents.second);
-
-                if (buffer.empty()) {
-                    if (is_ps_app || is_sys_app)
-                        LOG_WARN("Contents {} '{}' Not found for title {} [{}].", contents.first, contents.second, app_path, APP_INDEX->title);
-                    continue;
-                }
-                stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-                if (!data) {
-                    LOG_ERROR("Invalid Live Area Contents for title {} [{}].", app_path, APP_INDEX->title);
-                    continue;
-                }
-
-                gui.live_area_contents[app_path][contents.first].init(gui.imgui_state.get(), data, width, height);
-                stbi_image_free(data);
+                    requests.push_back({ VitaIoDevice::ux0, fs::path("app") / app_path / (live_area_path.string() + "/contents/" + contents.second) });
+                images.push_back({ {}, contents.first, contents.second });
             }
 
             std::map<std::string, std::map<std::string, std::vector<std::string>>> items_name;
@@ -438,29 +434,11 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string &app_p
                                 bg_name.erase(remove(bg_name.begin(), bg_name.end(), '\n'), bg_name.end());
                             bg_name.erase(remove_if(bg_name.begin(), bg_name.end(), isspace), bg_name.end());
 
-                            int32_t width = 0;
-                            int32_t height = 0;
-                            vfs::FileBuffer buffer;
-
                             if (app_device == VitaIoDevice::vs0)
-                                vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path.wstring(), "app/" + app_path + "/sce_sys/livearea/contents/" + bg_name);
+                                requests.push_back({ VitaIoDevice::vs0, "app/" + app_path + "/sce_sys/livearea/contents/" + bg_name });
                             else
-                                vfs::read_app_file(buffer, emuenv.pref_path.wstring(), app_path, live_area_path.string() + "/contents/" + bg_name);
-
-                            if (buffer.empty()) {
-                                if (is_ps_app || is_sys_app)
-                                    LOG_WARN("background, Id: {}, Name: '{}', Not found for title: {} [{}].", item.first, bg_name, app_path, APP_INDEX->title);
-                                continue;
-                            }
-                            stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-                            if (!data) {
-                                LOG_ERROR("Frame: {}, Invalid Live Area Contents for title: {} [{}].", item.first, app_path, APP_INDEX->title);
-                                continue;
-                            }
-
-                            items_size[app_path][item.first]["background"] = ImVec2(float(width), float(height));
-                            gui.live_items[app_path][item.first]["background"].emplace_back(gui.imgui_state.get(), data, width, height);
-                            stbi_image_free(data);
+                                requests.push_back({ VitaIoDevice::ux0, fs::path("app") / app_path / (live_area_path.string() + "/contents/" + bg_name) });
+                            images.push_back({ item.first, "background", bg_name });
                         }
                     }
 
@@ -470,33 +448,43 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string &app_p
                                 img_name.erase(remove(img_name.begin(), img_name.end(), '\n'), img_name.end());
                             img_name.erase(remove_if(img_name.begin(), img_name.end(), isspace), img_name.end());
 
-                            int32_t width = 0;
-                            int32_t height = 0;
-                            vfs::FileBuffer buffer;
-
                             if (app_device == VitaIoDevice::vs0)
-                                vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path.wstring(), "app/" + app_path + "/sce_sys/livearea/contents/" + img_name);
+                                requests.push_back({ VitaIoDevice::vs0, "app/" + app_path + "/sce_sys/livearea/contents/" + img_name });
                             else
-                                vfs::read_app_file(buffer, emuenv.pref_path.wstring(), app_path, live_area_path.string() + "/contents/" + img_name);
-
-                            if (buffer.empty()) {
-                                if (is_ps_app || is_sys_app)
-                                    LOG_WARN("Image, Id: {} Name: '{}', Not found for title {} [{}].", item.first, img_name, app_path, APP_INDEX->title);
-                                continue;
-                            }
-                            stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-                            if (!data) {
-                                LOG_ERROR("Frame: {}, Invalid Live Area Contents for title: {} [{}].", item.first, app_path, APP_INDEX->title);
-                                continue;
-                            }
-
-                            items_size[app_path][item.first]["image"] = ImVec2(float(width), float(height));
-                            gui.live_items[app_path][item.first]["image"].emplace_back(gui.imgui_state.get(), data, width, height);
-                            stbi_image_free(data);
+                                requests.push_back({ VitaIoDevice::ux0, fs::path("app") / app_path / (live_area_path.string() + "/contents/" + img_name) });
+                            images.push_back({ item.first, "image", img_name });
                         }
                     }
                 }
             }
+
+            // the placeholders of the live area are drawn until the images are loaded
+            gui.live_area_contents[app_path];
+            const auto generation = ++live_area_generation[app_path];
+            const auto title = APP_INDEX->title;
+            gui.image_loader.load(emuenv, app_path, std::move(requests), [app_path, title, is_ps_app, is_sys_app, generation, images = std::move(images)](GuiState &gui, const std::vector<DecodedImagePtr> &decoded_images) {
+                // the live area was closed or loaded again in the meantime
+                if ((live_area_generation[app_path] != generation) || !gui.live_area_contents.contains(app_path))
+                    return;
+
+                for (size_t i = 0; i < images.size(); i++) {
+                    const LiveAreaImage &image = images[i];
+                    const DecodedImagePtr &decoded = decoded_images[i];
+                    if (!decoded) {
+                        if (is_ps_app || is_sys_app)
+                            LOG_WARN("Live Area Contents {}, Id: {}, Name: '{}', Not found or invalid for title: {} [{}].", image.item, image.frame, image.name, app_path, title);
+                        continue;
+                    }
+
+                    void *pixels = const_cast<uint8_t *>(decoded->pixels.data());
+                    if (image.frame.empty())
+                        gui.live_area_contents[app_path][image.item].init(gui.imgui_state.get(), pixels, decoded->width, decoded->height);
+                    else {
+                        items_size[app_path][image.frame][image.item] = ImVec2(float(decoded->width), float(decoded->height));
+                        gui.live_items[app_path][image.frame][image.item].emplace_back(gui.imgui_state.get(), pixels, decoded->width, decoded->height);
+                    }
+                }
+            });
         }
     }
     if (type[app_path].empty())
@@ -516,6 +504,7 @@ void open_search(const std::string &title) {
 }
 
 void update_app(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    gui.image_loader.drop(app_path);
     if (gui.live_area_contents.contains(app_path))
         gui.live_area_contents.erase(app_path);
     if (gui.live_items.contains(app_path))
@@ -534,7 +523,7 @@ void close_live_area_app(GuiState &gui, EmuEnvState &emuenv, const std::string &
         emuenv.kernel.exit_delete_all_threads();
         emuenv.load_exec = true;
         // make sure we are not stuck waiting for a gpu command
-        emuenv.renderer->should_display = true;
+        emuenv.renderer->request_display();
     } else {
         gui.live_area_current_open_apps_list.erase(get_live_area_current_open_apps_list_index(gui, app_path));
         if (gui.live_area_app_current_open == 0) {
@@ -18,8 +18,10 @@
 #include <config/state.h>
 #include <gui/functions.h>
 #include <io/state.h>
+#include <kernel/state.h>
 
 #include <util/string_utils.h>
+#include <util/stutter.h>
 
 #include "private.h"
 
@@ -93,7 +95,7 @@ static void draw_emulation_menu(GuiState &gui, EmuEnvState &emuenv) {
     }
 }
 
-static void draw_debug_menu(DebugMenuState &state) {
+static void draw_debug_menu(DebugMenuState &state, EmuEnvState &emuenv) {
     if (ImGui::BeginMenu("Debug")) {
         ImGui::MenuItem("Threads", nullptr, &state.threads_dialog);
         ImGui::MenuItem("Semaphores", nullptr, &state.semaphores_dialog);
@@ -104,6 +106,18 @@ static void draw_debug_menu(DebugMenuState &state) {
         ImGui::MenuItem("Event Flags", nullptr, &state.eventflags_dialog);
         ImGui::MenuItem("Memory Allocations", nullptr, &state.allocations_dialog);
         ImGui::MenuItem("Disassembly", nullptr, &state.disassembly_dialog);
+        ImGui::Separator();
+        if (ImGui::MenuItem("Guest Profiler", nullptr, is_guest_profiler_running(emuenv.kernel.guest_profiler), !emuenv.io.title_id.empty())) {
+            if (is_guest_profiler_running(emuenv.kernel.guest_profiler))
+                stop_guest_profiler(emuenv.kernel);
+            else
+                start_guest_profiler(emuenv.kernel);
+        }
+        bool hle_profiler = emuenv.kernel.hle_profiler.enabled;
+        if (ImGui::MenuItem("HLE Call Profiler", nullptr, &hle_profiler))
+            emuenv.kernel.hle_profiler.enabled = hle_profiler;
+        if (ImGui::MenuItem("Dump Stutters to Log", nullptr, false, emuenv.stutter_detector.frame_count > 0))
+            dump_stutter_events(emuenv.stutter_detector);
         ImGui::EndMenu();
     }
 }
@@ -151,7 +165,7 @@ void draw_main_menu_bar(GuiState &gui, EmuEnvState &emuenv) {
 
         draw_file_menu(gui, emuenv);
         draw_emulation_menu(gui, emuenv);
-        draw_debug_menu(gui.debug_menu);
+        draw_debug_menu(gui.debug_menu, emuenv);
         draw_config_menu(gui, emuenv);
         draw_controls_menu(gui);
         draw_help_menu(gui);
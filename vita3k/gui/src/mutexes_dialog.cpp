@@ -20,6 +20,7 @@
 #include <emuenv/state.h>
 
 #include <kernel/state.h>
+#include <kernel/sync_primitives.h>
 #include <kernel/thread/thread_state.h>
 
 namespace gui {
@@ -28,7 +29,7 @@ void draw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Mutexes", &gui.debug_menu.mutexes_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s   %-16s   %-16s", "ID", "Mutex Name", "Status", "Attributes", "Waiting Threads", "Owner");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
 
     for (const auto &mutex : emuenv.kernel.mutexes) {
         std::shared_ptr<Mutex> mutex_state = mutex.second;
@@ -47,17 +48,19 @@ void draw_lw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Lightweight Mutexes", &gui.debug_menu.lwmutexes_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s  %-16s   %-16s", "ID", "LwMutex Name", "Status", "Attributes", "Waiting Threads", "Owner");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
 
     for (const auto &mutex : emuenv.kernel.lwmutexes) {
         std::shared_ptr<Mutex> mutex_state = mutex.second;
+        // the lock state of lightweight mutexes is in their workarea
+        const auto owner = emuenv.kernel.threads.find(lwmutex_get_owner(emuenv.mem, mutex_state->workarea));
         ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d           %02zu                 %s",
             mutex.first,
             mutex_state->name,
-            mutex_state->lock_count,
+            static_cast<int>(mutex_state->workarea.get(emuenv.mem)->lockCount),
             mutex_state->attr,
             mutex_state->waiting_threads->size(),
-            mutex_state->owner == nullptr ? "not owned" : mutex_state->owner->name.c_str());
+            owner == emuenv.kernel.threads.end() ? "not owned" : owner->second->name.c_str());
     }
     ImGui::End();
 }
@@ -17,7 +17,20 @@
 
 #include "private.h"
 
+#include <audio/state.h>
 #include <config/state.h>
+#include <display/state.h>
+#include <io/state.h>
+#include <renderer/state.h>
+#include <util/frame_stats.h>
+#include <util/memory_accounting.h>
+#include <util/task_pool.h>
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <mutex>
+#include <vector>
 
 namespace gui {
 static const ImVec2 PERF_OVERLAY_PAD = ImVec2(12.f, 12.f);
@@ -43,10 +56,137 @@ static ImVec2 get_perf_pos(ImVec2 window_size, EmuEnvState &emuenv) {
     return ImVec2(LEFT, TOP);
 }
 
-static float get_perf_height(EmuEnvState &emuenv) {
+// height of the lines showing the memory used by the textures, the draw batching, the render passes, the mapped memory, the GPU time, the memory faults, the vblank jitter, the audio latency, the read-ahead, the host memory or the task pool
+static const float TEXTURE_MEMORY_HEIGHT = 20.f;
+
+static bool show_texture_memory(EmuEnvState &emuenv) {
+    // only shown if the backend tracks it
+    return emuenv.cfg.performance_overlay_detail >= MEDIUM && emuenv.renderer->texture_memory_peak > 0;
+}
+
+static bool show_draw_batching(EmuEnvState &emuenv) {
+    // only shown if the backend merges draws
+    return emuenv.cfg.performance_overlay_detail >= MEDIUM && emuenv.renderer->frame_draw_command_count > 0;
+}
+
+static bool show_render_passes(EmuEnvState &emuenv) {
+    // only shown if the backend tracks them
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM && emuenv.renderer->frame_render_pass_count > 0;
+}
+
+static bool show_mapped_memory(EmuEnvState &emuenv) {
+    // only shown if the backend maps the guest memory
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM && (emuenv.renderer->mapped_device_local_bytes + emuenv.renderer->mapped_host_bytes) > 0;
+}
+
+static bool show_gpu_time(EmuEnvState &emuenv) {
+    // only shown if the backend measures it
+    return emuenv.cfg.performance_overlay_detail >= MEDIUM && emuenv.renderer->gpu_frame_time > 0.f;
+}
+
+// most expensive scenes of the last measured frame, shown with the maximum detail
+static constexpr size_t GPU_SCENE_COUNT = 3;
+
+static std::vector<renderer::GpuSceneTime> get_top_gpu_scenes(EmuEnvState &emuenv) {
+    if (emuenv.cfg.performance_overlay_detail < MAXIMUM || !show_gpu_time(emuenv))
+        return {};
+
+    std::vector<renderer::GpuSceneTime> scenes;
+    {
+        const std::lock_guard<std::mutex> lock(emuenv.renderer->gpu_scene_times_mutex);
+        scenes = emuenv.renderer->gpu_scene_times;
+    }
+    const size_t count = std::min(scenes.size(), GPU_SCENE_COUNT);
+    std::partial_sort(scenes.begin(), scenes.begin() + count, scenes.end(), [](const renderer::GpuSceneTime &a, const renderer::GpuSceneTime &b) {
+        return a.time > b.time;
+    });
+    scenes.resize(count);
+    return scenes;
+}
+
+static bool show_memory_faults(EmuEnvState &emuenv) {
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM;
+}
+
+static bool show_vblank_jitter(EmuEnvState &emuenv) {
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM;
+}
+
+static bool show_audio_latency(EmuEnvState &emuenv) {
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM && emuenv.audio.adapter;
+}
+
+static bool show_read_ahead(EmuEnvState &emuenv) {
+    // only shown once a file has been read through it
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM && (emuenv.io.read_ahead_stats.hit_bytes + emuenv.io.read_ahead_stats.miss_bytes) > 0;
+}
+
+static bool show_host_memory(EmuEnvState &emuenv) {
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM;
+}
+
+static bool show_task_pool(EmuEnvState &emuenv) {
+    // only shown once the pool has started
+    return emuenv.cfg.performance_overlay_detail >= MAXIMUM && get_task_pool_stats().worker_count > 0;
+}
+
+static bool show_emulation_speed(EmuEnvState &emuenv) {
+    // only shown while the turbo mode is on
+    return emuenv.display.speed != 1;
+}
+
+static float get_stats_extra_height(EmuEnvState &emuenv, size_t gpu_scene_count) {
+    return (show_texture_memory(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f) + (show_draw_batching(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f) + (show_render_passes(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f)
+        + (show_mapped_memory(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f) + (show_gpu_time(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f) + static_cast<float>(gpu_scene_count) * TEXTURE_MEMORY_HEIGHT + (show_memory_faults(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f)
+        + (show_vblank_jitter(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f) + (show_audio_latency(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f)
+        + (show_read_ahead(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f) + (show_host_memory(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f)
+        + (show_task_pool(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f)
+        + (show_emulation_speed(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f);
+}
+
+// frames shown by the graphs of the detailed mode
+static constexpr size_t DETAIL_GRAPH_FRAMES = 240;
+static const float DETAIL_GRAPH_HEIGHT = 28.f;
+
+struct DetailGraph {
+    const char *name;
+    float FrameSample::*time;
+};
+
+static const std::array<DetailGraph, 6> DETAIL_GRAPHS = { {
+    { "frame", &FrameSample::frame_time },
+    { "guest_cpu", &FrameSample::guest_cpu_time },
+    { "hle", &FrameSample::hle_time },
+    { "commands", &FrameSample::batches_time },
+    { "gpu", &FrameSample::gpu_time },
+    { "present", &FrameSample::present_time },
+} };
+
+static bool show_detail_graph(EmuEnvState &emuenv, const DetailGraph &graph) {
+    // the gpu time is only shown if the backend measures it
+    return graph.time != &FrameSample::gpu_time || emuenv.renderer->gpu_frame_time > 0.f;
+}
+
+static bool show_audio_load(EmuEnvState &emuenv) {
+    // only shown once the host callback mixed some audio
+    return emuenv.audio.adapter && emuenv.frame_stats.last_audio_ns > 0;
+}
+
+static float get_details_height(EmuEnvState &emuenv) {
+    if (emuenv.cfg.performance_overlay_detail != DETAILED)
+        return 0.f;
+
+    // the lows, the graphs, the audio load and the padding of the child
+    const auto graph_count = std::count_if(DETAIL_GRAPHS.begin(), DETAIL_GRAPHS.end(), [&](const DetailGraph &graph) { return show_detail_graph(emuenv, graph); });
+    return TEXTURE_MEMORY_HEIGHT + static_cast<float>(graph_count) * DETAIL_GRAPH_HEIGHT + (show_audio_load(emuenv) ? TEXTURE_MEMORY_HEIGHT : 0.f) + 12.f;
+}
+
+static float get_perf_height(EmuEnvState &emuenv, size_t gpu_scene_count) {
+    const float extra_height = get_stats_extra_height(emuenv, gpu_scene_count);
     switch (emuenv.cfg.performance_overlay_detail) {
-    case MAXIMUM: return 138.f;
-    case MEDIUM: return 80.f;
+    case DETAILED: return 138.f + extra_height + get_details_height(emuenv);
+    case MAXIMUM: return 138.f + extra_height;
+    case MEDIUM: return 80.f + extra_height;
     case LOW:
     case MINIMUM:
     default: break;
@@ -55,6 +195,57 @@ static float get_perf_height(EmuEnvState &emuenv) {
     return 57.f;
 }
 
+struct DetailGraphValues {
+    const FrameStats *stats;
+    float FrameSample::*time;
+    size_t frame_count;
+};
+
+static float get_detail_graph_value(void *data, int idx) {
+    // the oldest frame first
+    const DetailGraphValues &values = *static_cast<const DetailGraphValues *>(data);
+    return get_frame_sample(*values.stats, values.frame_count - 1 - idx).*values.time;
+}
+
+static void draw_frame_details(GuiState &gui, EmuEnvState &emuenv, const ImVec2 &size, const ImVec2 &res_scale, const ImVec2 &scale) {
+    auto &lang = gui.lang.performance_overlay;
+    const FrameStats &stats = emuenv.frame_stats;
+
+    ImGui::PushStyleColor(ImGuiCol_ChildBg, PERF_OVERLAY_BG_COLOR);
+    ImGui::PushStyleVar(ImGuiStyleVar_ChildRounding, 5.f * scale.x);
+    ImGui::BeginChild("#perf_details", size, true, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+    ImGui::PushFont(gui.vita_font);
+    ImGui::SetWindowFontScale(0.7f * res_scale.x);
+    ImGui::Text("%s 1%%: %.0f 0.1%%: %.0f", lang["lows"].c_str(), stats.low_1_fps, stats.low_01_fps);
+
+    // host time spent by each subsystem on the last frames, the guest cpu time is summed over the threads
+    const size_t frame_count = std::min(stats.sample_count, DETAIL_GRAPH_FRAMES);
+    const ImVec2 graph_size(ImGui::GetContentRegionAvail().x, (DETAIL_GRAPH_HEIGHT - 4.f) * scale.y);
+    for (const DetailGraph &graph : DETAIL_GRAPHS) {
+        if (!show_detail_graph(emuenv, graph))
+            continue;
+
+        DetailGraphValues values = { &stats, graph.time, frame_count };
+        float average = 0.f;
+        for (size_t i = 0; i < frame_count; i++)
+            average += get_frame_sample(stats, i).*graph.time;
+        if (frame_count > 0)
+            average /= frame_count;
+
+        const std::string overlay = fmt::format("{}: {:.2f} ms", lang[graph.name], average);
+        ImGui::PlotLines(fmt::format("##{}_graph", graph.name).c_str(), get_detail_graph_value, &values, static_cast<int>(frame_count), 0, overlay.c_str(), 0.f, FLT_MAX, graph_size);
+    }
+
+    if (show_audio_load(emuenv)) {
+        // share of the duration of the audio mixed by the host callback spent mixing it
+        ImGui::Text("%s %s: %.1f%%", lang["audio"].c_str(), lang["load"].c_str(), stats.audio_load);
+    }
+    ImGui::PopFont();
+    ImGui::EndChild();
+    ImGui::PopStyleVar();
+    ImGui::PopStyleColor();
+}
+
 void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
     auto lang = gui.lang.performance_overlay;
 
@@ -62,10 +253,24 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
     const auto RES_SCALE = ImVec2(display_size.x / emuenv.res_width_dpi_scale, display_size.y / emuenv.res_height_dpi_scale);
     const auto SCALE = ImVec2(RES_SCALE.x * emuenv.dpi_scale, RES_SCALE.y * emuenv.dpi_scale);
 
-    const auto MAIN_WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 95.5f : 152.f) * SCALE.x, get_perf_height(emuenv) * SCALE.y);
+    // copied once as the renderer can publish a new frame while drawing
+    const std::vector<renderer::GpuSceneTime> gpu_scenes = get_top_gpu_scenes(emuenv);
+    const auto MAIN_WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 95.5f : 152.f) * SCALE.x, get_perf_height(emuenv, gpu_scenes.size()) * SCALE.y);
 
     const auto WINDOW_POS = get_perf_pos(MAIN_WINDOW_SIZE, emuenv);
     const auto WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 72.5f : 130.f) * SCALE.x, (emuenv.cfg.performance_overlay_detail <= LOW ? 35.f : 58.f) * SCALE.y);
+    const bool texture_memory = show_texture_memory(emuenv);
+    const bool draw_batching = show_draw_batching(emuenv);
+    const bool render_passes = show_render_passes(emuenv);
+    const bool mapped_memory = show_mapped_memory(emuenv);
+    const bool gpu_time = show_gpu_time(emuenv);
+    const bool memory_faults = show_memory_faults(emuenv);
+    const bool vblank_jitter = show_vblank_jitter(emuenv);
+    const bool audio_latency = show_audio_latency(emuenv);
+    const bool read_ahead = show_read_ahead(emuenv);
+    const bool host_memory = show_host_memory(emuenv);
+    const bool task_pool = show_task_pool(emuenv);
+    const auto STATS_SIZE = ImVec2(WINDOW_SIZE.x, WINDOW_SIZE.y + get_stats_extra_height(emuenv, gpu_scenes.size()) * SCALE.y);
 
     ImGui::SetNextWindowSize(MAIN_WINDOW_SIZE);
     ImGui::SetNextWindowPos(WINDOW_POS);
@@ -73,7 +278,7 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("##performance", nullptr, ImGuiWindowFlags_NoBackground | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoBringToFrontOnFocus);
     ImGui::PushStyleColor(ImGuiCol_ChildBg, PERF_OVERLAY_BG_COLOR);
     ImGui::PushStyleVar(ImGuiStyleVar_ChildRounding, 5.f * SCALE.x);
-    ImGui::BeginChild("#perf_stats", WINDOW_SIZE, true, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+    ImGui::BeginChild("#perf_stats", STATS_SIZE, true, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
     ImGui::PushFont(gui.vita_font);
     ImGui::SetWindowFontScale(0.7f * RES_SCALE.x);
     if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MINIMUM)
@@ -84,14 +289,98 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Separator();
         ImGui::Text("%s: %d %s: %d", lang["min"].c_str(), emuenv.min_fps, lang["max"].c_str(), emuenv.max_fps);
     }
+    if (show_emulation_speed(emuenv)) {
+        const uint32_t speed = emuenv.display.speed;
+        ImGui::Separator();
+        if (speed == 0)
+            ImGui::Text("%s: %s", lang["speed"].c_str(), lang["unlimited"].c_str());
+        else
+            ImGui::Text("%s: %ux", lang["speed"].c_str(), speed);
+    }
+    if (texture_memory) {
+        ImGui::Separator();
+        ImGui::Text("%s: %llu MiB %s: %llu MiB", lang["textures"].c_str(), static_cast<unsigned long long>(emuenv.renderer->texture_memory_used >> 20),
+            lang["peak"].c_str(), static_cast<unsigned long long>(emuenv.renderer->texture_memory_peak >> 20));
+    }
+    if (draw_batching) {
+        // number of draws done by the game for each draw command recorded
+        const uint32_t draw_count = emuenv.renderer->frame_draw_count;
+        const uint32_t draw_command_count = emuenv.renderer->frame_draw_command_count;
+        ImGui::Separator();
+        ImGui::Text("%s: %u %s: %.2f", lang["draws"].c_str(), draw_count, lang["batching"].c_str(), static_cast<float>(draw_count) / draw_command_count);
+    }
+    if (render_passes) {
+        // attachment loads and stores skipped by the render passes of the last frame
+        ImGui::Separator();
+        ImGui::Text("%s: %u %s: %u/%u", lang["passes"].c_str(), emuenv.renderer->frame_render_pass_count.load(), lang["elided"].c_str(),
+            emuenv.renderer->frame_elided_load_count.load(), emuenv.renderer->frame_elided_store_count.load());
+    }
+    if (mapped_memory) {
+        // guest memory the GPU reads from the device-local heap (resizable BAR) and through the host memory
+        ImGui::Separator();
+        ImGui::Text("%s: %llu MiB %s: %llu MiB", lang["vram"].c_str(), static_cast<unsigned long long>(emuenv.renderer->mapped_device_local_bytes >> 20),
+            lang["host"].c_str(), static_cast<unsigned long long>(emuenv.renderer->mapped_host_bytes >> 20));
+    }
+    if (gpu_time) {
+        // the resolution multiplier can change with the dynamic resolution
+        ImGui::Separator();
+        ImGui::Text("%s: %.2f ms %s: %dx", lang["gpu"].c_str(), emuenv.renderer->gpu_frame_time.load(), lang["resolution"].c_str(), emuenv.renderer->res_multiplier);
+    }
+    for (const renderer::GpuSceneTime &scene : gpu_scenes) {
+        // tagged with the color surface rendered to, the time of its render passes is in parentheses
+        ImGui::Separator();
+        ImGui::Text("0x%08X %ux%u: %.2f (%.2f) ms", scene.color_address, scene.width, scene.height, scene.time, scene.render_pass_time);
+    }
+    if (memory_faults) {
+        // write faults on protected memory for each frame, for the protected ranges and the pages tracked for the surface sync
+        ImGui::Separator();
+        ImGui::Text("%s: %u %s: %u", lang["faults"].c_str(), emuenv.protect_faults_per_frame, lang["tracked"].c_str(), emuenv.write_track_faults_per_frame);
+    }
+    if (vblank_jitter) {
+        // delay of the vblanks after their deadline, over the last second
+        ImGui::Separator();
+        ImGui::Text("%s: %u us %s: %u us", lang["vblank"].c_str(), emuenv.display.vblank_jitter_avg_us.load(), lang["max"].c_str(), emuenv.display.vblank_jitter_max_us.load());
+    }
+    if (audio_latency) {
+        // the buffering grows with the underruns of the host audio
+        ImGui::Separator();
+        ImGui::Text("%s: %u ms %s: %u", lang["audio"].c_str(), emuenv.audio.latency_ms.load(), lang["underruns"].c_str(), emuenv.audio.underrun_count.load());
+    }
+    if (read_ahead) {
+        // share of the bytes read by the guest that were already in a read-ahead buffer
+        const uint64_t hit_bytes = emuenv.io.read_ahead_stats.hit_bytes;
+        const uint64_t read_bytes = hit_bytes + emuenv.io.read_ahead_stats.miss_bytes;
+        ImGui::Separator();
+        ImGui::Text("%s: %u%% %s: %llu MiB", lang["read_ahead"].c_str(), static_cast<uint32_t>(hit_bytes * 100 / read_bytes),
+            lang["read"].c_str(), static_cast<unsigned long long>(read_bytes >> 20));
+    }
+    if (host_memory) {
+        // memory reported to the accounting, with the category using the most, the details are in the allocations dialog
+        const auto usage = get_all_memory_usage();
+        const auto largest = std::max_element(usage.begin(), usage.end(), [](const MemoryCategoryUsage &a, const MemoryCategoryUsage &b) {
+            return a.used < b.used;
+        });
+        ImGui::Separator();
+        ImGui::Text("%s: %llu MiB %s: %llu MiB", lang["host"].c_str(), static_cast<unsigned long long>(get_total_memory_usage() >> 20),
+            get_memory_category_name(static_cast<MemoryCategory>(largest - usage.begin())), static_cast<unsigned long long>(largest->used >> 20));
+    }
+    if (task_pool) {
+        // tasks waiting for a worker, by priority from the latency critical ones to the background ones
+        const TaskPoolStats stats = get_task_pool_stats();
+        ImGui::Separator();
+        ImGui::Text("%s: %u/%u/%u %s: %u/%u", lang["tasks"].c_str(), stats.queued[0], stats.queued[1], stats.queued[2],
+            lang["running"].c_str(), stats.running, stats.worker_count);
+    }
     ImGui::PopFont();
     ImGui::EndChild();
     ImGui::PopStyleVar();
     ImGui::PopStyleColor();
-    if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MAXIMUM) {
+    if (emuenv.cfg.performance_overlay_detail >= PerfomanceOverleyDetail::MAXIMUM) {
         ImGui::SetCursorPosY(ImGui::GetCursorPosY() - (3.f * SCALE.y));
         ImGui::PlotLines("##fps_graphic", emuenv.fps_values, IM_ARRAYSIZE(emuenv.fps_values), emuenv.current_fps_offset, nullptr, 0.f, float(emuenv.max_fps), WINDOW_SIZE);
     }
+    if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::DETAILED)
+        draw_frame_details(gui, emuenv, ImVec2(WINDOW_SIZE.x, get_details_height(emuenv) * SCALE.y), RES_SCALE, SCALE);
     ImGui::End();
     ImGui::PopStyleVar();
 }
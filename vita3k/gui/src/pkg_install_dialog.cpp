@@ -26,8 +26,7 @@
 #include <rif2zrif.h>
 #include <util/log.h>
 #include <util/string_utils.h>
-
-#include <thread>
+#include <util/task_pool.h>
 
 namespace gui {
 
@@ -127,7 +126,7 @@ void draw_pkg_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
             if (ImGui::Button(common["ok"].c_str(), BUTTON_SIZE) && !zRIF.empty())
                 state = "install";
         } else if (state == "install") {
-            std::thread installation([&emuenv]() {
+            submit_task(TaskPriority::Background, [&emuenv]() {
                 if (install_pkg(pkg_path.string(), emuenv, zRIF, progress_callback)) {
                     std::lock_guard<std::mutex> lock(install_mutex);
                     state = "success";
@@ -136,7 +135,6 @@ void draw_pkg_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
                 }
                 zRIF.clear();
             });
-            installation.detach();
             state = "installing";
         } else if (state == "success") {
             title = indicator["install_complete"];
@@ -25,7 +25,7 @@ void draw_semaphores_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Semaphores", &gui.debug_menu.semaphores_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-16s   %-16s", "ID", "Semaphore Name", "Status", "Locked Threads");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
 
     for (const auto &semaphore : emuenv.kernel.semaphores) {
         std::shared_ptr<Semaphore> sema_state = semaphore.second;
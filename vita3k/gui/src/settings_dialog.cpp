@@ -27,6 +27,7 @@
 #include <io/state.h>
 #include <kernel/state.h>
 #include <renderer/state.h>
+#include <shader/spirv_recompiler.h>
 
 #include <gui/functions.h>
 #include <gui/state.h>
@@ -404,7 +405,7 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
     }
 
     // If backend render or resolution multiplier is changed when app run, reboot emu and app
-    if (!emuenv.io.title_id.empty() && ((emuenv.renderer->current_backend != emuenv.backend_renderer) || (emuenv.renderer->res_multiplier != emuenv.cfg.current_config.resolution_multiplier))) {
+    if (!emuenv.io.title_id.empty() && ((emuenv.renderer->current_backend != emuenv.backend_renderer) || (emuenv.renderer->max_res_multiplier != emuenv.cfg.current_config.resolution_multiplier))) {
         emuenv.load_exec = true;
         emuenv.load_app_path = emuenv.io.app_path;
         emuenv.load_exec_path = emuenv.self_path;
@@ -419,7 +420,10 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
     if (emuenv.renderer->current_backend == renderer::Backend::OpenGL)
         set_vsync_state(emuenv.cfg.current_config.v_sync);
 
-    emuenv.renderer->res_multiplier = emuenv.cfg.current_config.resolution_multiplier;
+    emuenv.renderer->max_res_multiplier = emuenv.cfg.current_config.resolution_multiplier;
+    // the dynamic resolution changes the multiplier on its own while an app is running
+    if (emuenv.io.title_id.empty())
+        emuenv.renderer->res_multiplier = emuenv.cfg.current_config.resolution_multiplier;
     emuenv.renderer->set_anisotropic_filtering(emuenv.cfg.current_config.anisotropic_filtering);
     emuenv.renderer->set_stretch_display(emuenv.cfg.stretch_the_display_area);
     emuenv.renderer->set_texture_state(emuenv.cfg.current_config.import_textures, emuenv.cfg.current_config.export_textures, emuenv.cfg.current_config.export_as_png);
@@ -428,7 +432,8 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
     if (emuenv.io.title_id.empty()) {
         emuenv.kernel.cpu_backend = set_cpu_backend(emuenv.cfg.current_config.cpu_backend);
         emuenv.kernel.cpu_opt = emuenv.cfg.current_config.cpu_opt;
-        emuenv.audio.set_backend(emuenv.cfg.audio_backend);
+        emuenv.audio.time_stretch = emuenv.cfg.audio_time_stretch;
+        emuenv.audio.set_backend(emuenv.cfg.headless ? "Null" : emuenv.cfg.audio_backend);
     }
 }
 
@@ -726,6 +731,20 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Checkbox("Use shader cache", &emuenv.cfg.shader_cache);
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Check the box to enable shader cache to pre-compile it at game startup\nUncheck to disable this feature.");
+        if (emuenv.backend_renderer == renderer::Backend::Vulkan) {
+            ImGui::SameLine();
+            ImGui::Checkbox("Asynchronous pipeline compilation", &emuenv.cfg.async_pipeline_compilation);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Check the box to compile pipelines on background threads.\nThis removes most stutters when a new effect appears, "
+                                  "at the cost of a few missing draws while they are compiling.\nTakes effect at the next game start.");
+            if (shader::is_spirv_optimizer_available()) {
+                ImGui::SameLine();
+                ImGui::Checkbox("Optimize shaders", &emuenv.cfg.spirv_optimization);
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("Check the box to optimize the translated shaders on a background thread.\nThe optimized shaders are saved in the shader cache "
+                                      "and used from the next time they are loaded.\nCan improve the performance on mobile and integrated GPUs.");
+            }
+        }
         if (emuenv.renderer->features.spirv_shader) {
             ImGui::SameLine();
             ImGui::Checkbox("Use Spir-V shader (deprecated)", &emuenv.cfg.spirv_shader);
@@ -789,6 +808,9 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
             emuenv.cfg.audio_backend = LIST_BACKEND_AUDIO[audio_backend_idx];
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Select your preferred audio backend.");
+        ImGui::Checkbox("Audio time stretching", &emuenv.cfg.audio_time_stretch);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Check the box to stretch the audio instead of crackling when the emulation is slower than full speed.\nOnly used by the SDL backend.");
 
         if (!emuenv.io.app_path.empty())
             ImGui::EndDisabled();
@@ -796,6 +818,9 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Checkbox("Enable NGS support", &config.ngs_enable);
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Uncheck the box to disable support for advanced audio library NGS.");
+        ImGui::Checkbox("Hardware video decoding", &emuenv.cfg.video_hw_decoding);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Check the box to decode the videos with the GPU when the host supports it, which lowers the CPU usage of the video playback.\nThe videos the GPU cannot decode are decoded by the CPU.");
         ImGui::Spacing();
         ImGui::Separator();
         ImGui::Spacing();
@@ -841,9 +866,9 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Display performance information on the screen as an overlay.");
         if (emuenv.cfg.performance_overlay) {
-            ImGui::Combo("Detail", &emuenv.cfg.performance_overlay_detail, "Minimum\0Low\0Medium\0Maximum\0");
+            ImGui::Combo("Detail", &emuenv.cfg.performance_overlay_detail, "Minimum\0Low\0Medium\0Maximum\0Detailed\0");
             if (ImGui::IsItemHovered())
-                ImGui::SetTooltip("Select your preferred performance overlay detail.");
+                ImGui::SetTooltip("Select your preferred performance overlay detail.\nDetailed also measures the host time spent on each frame by the emulated CPU, the HLE functions, the renderer and the presentation.");
             ImGui::Combo("Position", &emuenv.cfg.performance_overlay_position, "Top Left\0Top Center\0Top Right\0Bottom Left\0Bottom Center\0Bottom Right\0");
             if (ImGui::IsItemHovered())
                 ImGui::SetTooltip("Select your preferred performance overlay position.");
@@ -0,0 +1,137 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <gui/state.h>
+
+#include <algorithm>
+
+namespace gui {
+
+static std::time_t get_dir_mtime(const fs::path &path) {
+    boost::system::error_code error;
+    const auto mtime = fs::last_write_time(path, error);
+    return error ? 0 : mtime;
+}
+
+static uint64_t get_recursive_directory_size(const fs::path &path) {
+    boost::system::error_code error;
+    uint64_t size = 0;
+    for (fs::recursive_directory_iterator it(path, error), end; !error && (it != end); it.increment(error)) {
+        if (fs::is_regular_file(it->path(), error))
+            size += fs::file_size(it->path(), error);
+    }
+    return size;
+}
+
+static void run_size_loader(SizeAsyncLoader &loader) {
+    while (true) {
+        std::pair<fs::path, std::time_t> path;
+        {
+            std::unique_lock<std::mutex> lock(loader.mutex);
+            loader.cond.wait(lock, [&] { return loader.exiting || !loader.pending_paths.empty(); });
+            if (loader.exiting)
+                return;
+            path = std::move(loader.pending_paths.front());
+            loader.pending_paths.pop_front();
+            loader.running_jobs++;
+        }
+
+        const uint64_t size = get_recursive_directory_size(path.first);
+
+        const std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.sizes[path.first.generic_string()] = { path.second, size };
+        loader.generation++;
+        loader.running_jobs--;
+    }
+}
+
+void SizeAsyncLoader::request(const fs::path &path) {
+    const auto mtime = get_dir_mtime(path);
+    const auto key = path.generic_string();
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (exiting)
+        return;
+
+    const auto size = sizes.find(key);
+    if ((size != sizes.end()) && (size->second.mtime == mtime))
+        return;
+    if (std::find_if(pending_paths.begin(), pending_paths.end(), [&](const auto &pending) { return pending.first == path; }) != pending_paths.end())
+        return;
+
+    // a missing directory has no size to compute
+    if (mtime == 0) {
+        sizes[key] = {};
+        generation++;
+        return;
+    }
+
+    // the threads are only started once a size is needed
+    if (threads.empty()) {
+        const uint32_t thread_count = std::clamp(std::thread::hardware_concurrency() / 2, 1U, 4U);
+        for (uint32_t i = 0; i < thread_count; i++)
+            threads.emplace_back(run_size_loader, std::ref(*this));
+    }
+
+    // the size of the previous modification time is not shown while the new one is computed
+    if (size != sizes.end())
+        sizes.erase(size);
+    pending_paths.emplace_back(path, mtime);
+    cond.notify_one();
+}
+
+std::optional<uint64_t> SizeAsyncLoader::find(const fs::path &path) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto size = sizes.find(path.generic_string());
+    if (size == sizes.end())
+        return std::nullopt;
+
+    return size->second.size;
+}
+
+uint32_t SizeAsyncLoader::get_generation() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return generation;
+}
+
+bool SizeAsyncLoader::should_save() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (!pending_paths.empty() || (running_jobs > 0) || (saved_generation == generation))
+        return false;
+
+    saved_generation = generation;
+    return true;
+}
+
+bool SizeAsyncLoader::is_loading() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return !pending_paths.empty() || (running_jobs > 0) || (saved_generation != generation);
+}
+
+SizeAsyncLoader::~SizeAsyncLoader() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        cond.notify_all();
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+}
+
+} // namespace gui
@@ -65,7 +65,7 @@ void draw_threads_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE,
         "%-16s %-32s   %-16s   %-16s", "ID", "Thread Name", "Status", "Stack Pointer");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
 
     for (const auto &thread : emuenv.kernel.threads) {
         std::shared_ptr<ThreadState> th_state = thread.second;
@@ -50,6 +50,8 @@ bool is_yuv_format(SceGxmTextureBaseFormat base_format);
 uint32_t attribute_format_size(SceGxmAttributeFormat format);
 uint32_t index_element_size(SceGxmIndexFormat format);
 bool is_stream_instancing(SceGxmIndexSource source);
+// return the biggest index of the index buffer (0 if count is 0)
+uint32_t get_max_index(const void *indices, uint32_t count, SceGxmIndexFormat format);
 bool convert_color_format_to_texture_format(SceGxmColorFormat format, SceGxmTextureFormat &dest_format);
 
 // Transfer
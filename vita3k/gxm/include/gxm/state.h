@@ -23,6 +23,7 @@
 
 #include <map>
 #include <mutex>
+#include <unordered_map>
 
 struct SDL_Thread;
 
@@ -53,6 +54,12 @@ struct MemoryMapInfo {
     std::uint32_t perm;
 };
 
+struct MaxIndexCacheEntry {
+    uint32_t max_index;
+    // given by track_writes when the max index was computed
+    uint64_t write_stamp;
+};
+
 struct GxmState {
     SceGxmInitializeParams params;
     Queue<DisplayCallback> display_queue;
@@ -62,4 +69,8 @@ struct GxmState {
     std::map<Address, MemoryMapInfo> memory_mapped_regions;
     std::mutex callback_lock;
     SDL_Thread *sdl_thread;
+    // max index of the big index buffers, indexed by their address, count and format
+    // only used if the vertex streams are copied, the entries stay valid until the index buffer is written
+    std::mutex max_index_cache_mutex;
+    std::unordered_map<uint64_t, MaxIndexCacheEntry> max_index_cache;
 };
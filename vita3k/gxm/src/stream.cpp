@@ -16,9 +16,115 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <gxm/functions.h>
+#include <util/instrset_detect.h>
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VITA3K_X86_64
+#include <immintrin.h>
+// msvc allows to use any intrinsic, other compilers need the functions to be marked
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VITA3K_AARCH64
+#include <arm_neon.h>
+#endif
 
 namespace gxm {
 bool is_stream_instancing(SceGxmIndexSource source) {
     return (source == SCE_GXM_INDEX_SOURCE_EACH_INSTANCE_16BIT) || (source == SCE_GXM_INDEX_SOURCE_EACH_INSTANCE_32BIT);
 }
+
+template <typename T>
+static uint32_t get_max_index_basic(const T *indices, uint32_t count) {
+    T max_index = 0;
+    for (uint32_t i = 0; i < count; i++)
+        max_index = std::max(max_index, indices[i]);
+
+    return max_index;
+}
+
+#ifdef VITA3K_X86_64
+static const bool use_avx2 = util::instrset::instrset_detect() >= util::instrset::instrset_AVX2;
+
+TARGET_AVX2 static uint32_t get_max_index_u16_avx2(const uint16_t *indices, uint32_t count) {
+    __m256i max_vec = _mm256_setzero_si256();
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16)
+        max_vec = _mm256_max_epu16(max_vec, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + i)));
+
+    __m128i max_128 = _mm_max_epu16(_mm256_castsi256_si128(max_vec), _mm256_extracti128_si256(max_vec, 1));
+    // there is only an horizontal min instruction, use it on the complement
+    max_128 = _mm_minpos_epu16(_mm_xor_si128(max_128, _mm_set1_epi16(-1)));
+    const uint32_t max_index = static_cast<uint16_t>(~_mm_extract_epi16(max_128, 0));
+
+    return std::max(max_index, get_max_index_basic(indices + i, count - i));
+}
+
+TARGET_AVX2 static uint32_t get_max_index_u32_avx2(const uint32_t *indices, uint32_t count) {
+    __m256i max_vec = _mm256_setzero_si256();
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        max_vec = _mm256_max_epu32(max_vec, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + i)));
+
+    __m128i max_128 = _mm_max_epu32(_mm256_castsi256_si128(max_vec), _mm256_extracti128_si256(max_vec, 1));
+    max_128 = _mm_max_epu32(max_128, _mm_shuffle_epi32(max_128, _MM_SHUFFLE(1, 0, 3, 2)));
+    max_128 = _mm_max_epu32(max_128, _mm_shuffle_epi32(max_128, _MM_SHUFFLE(2, 3, 0, 1)));
+    const uint32_t max_index = static_cast<uint32_t>(_mm_cvtsi128_si32(max_128));
+
+    return std::max(max_index, get_max_index_basic(indices + i, count - i));
+}
+#endif
+
+#ifdef VITA3K_AARCH64
+static uint32_t get_max_index_u16_neon(const uint16_t *indices, uint32_t count) {
+    uint16x8_t max_vec = vdupq_n_u16(0);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        max_vec = vmaxq_u16(max_vec, vld1q_u16(indices + i));
+
+    const uint32_t max_index = vmaxvq_u16(max_vec);
+    return std::max(max_index, get_max_index_basic(indices + i, count - i));
+}
+
+static uint32_t get_max_index_u32_neon(const uint32_t *indices, uint32_t count) {
+    uint32x4_t max_vec = vdupq_n_u32(0);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        max_vec = vmaxq_u32(max_vec, vld1q_u32(indices + i));
+
+    const uint32_t max_index = vmaxvq_u32(max_vec);
+    return std::max(max_index, get_max_index_basic(indices + i, count - i));
+}
+#endif
+
+uint32_t get_max_index(const void *indices, uint32_t count, SceGxmIndexFormat format) {
+    if (format == SCE_GXM_INDEX_FORMAT_U16) {
+        const uint16_t *data = static_cast<const uint16_t *>(indices);
+#ifdef VITA3K_X86_64
+        if (use_avx2)
+            return get_max_index_u16_avx2(data, count);
+        return get_max_index_basic(data, count);
+#elif defined(VITA3K_AARCH64)
+        return get_max_index_u16_neon(data, count);
+#else
+        return get_max_index_basic(data, count);
+#endif
+    } else {
+        const uint32_t *data = static_cast<const uint32_t *>(indices);
+#ifdef VITA3K_X86_64
+        if (use_avx2)
+            return get_max_index_u32_avx2(data, count);
+        return get_max_index_basic(data, count);
+#elif defined(VITA3K_AARCH64)
+        return get_max_index_u32_neon(data, count);
+#else
+        return get_max_index_basic(data, count);
+#endif
+    }
+}
 } // namespace gxm
@@ -19,8 +19,13 @@
 
 #include <mem/ptr.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <util/types.h>
 #include <vector>
 
@@ -235,7 +240,9 @@ struct SceConnection {
     std::string url;
     SceBool keepAlive;
     bool isSecure;
-    int sockfd;
+    // the host socket is taken from the connection pool when a request is sent
+    std::string hostname;
+    std::string port;
 };
 
 struct SceRequestResponse {
@@ -264,6 +271,51 @@ struct SceRequest {
     std::vector<Ptr<void>> guestPointers;
 };
 
+// Host socket of a request, ssl is null for http
+struct HttpHostConnection {
+    int sockfd = -1;
+    void *ssl = nullptr;
+    // in milliseconds, on the steady clock
+    uint64_t idle_since = 0;
+};
+
+// Kept alive connections shared by all the templates and connections, by scheme, host and port
+struct HttpConnectionPool {
+    static constexpr size_t MAX_IDLE_PER_HOST = 4;
+    static constexpr uint64_t IDLE_TIMEOUT_MS = 30000;
+
+    std::mutex mutex;
+    std::map<std::string, std::vector<HttpHostConnection>> idle_connections;
+    // last TLS session of each host, resumed by the next handshake
+    std::map<std::string, void *> tls_sessions;
+};
+
+// Host threads doing the network round trips of the requests, started when a request is sent
+struct HttpIoThreads {
+    static constexpr size_t MAX_THREADS = 4;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> threads;
+    size_t idle_threads = 0;
+    bool exiting = false;
+
+    HttpIoThreads() = default;
+    HttpIoThreads(const HttpIoThreads &) = delete;
+    HttpIoThreads &operator=(const HttpIoThreads &) = delete;
+    ~HttpIoThreads() {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            exiting = true;
+            cond.notify_all();
+        }
+
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+};
+
 struct HTTPState {
     bool inited = false;
     bool sslInited = false;
@@ -276,4 +328,6 @@ struct HTTPState {
     std::map<SceInt, SceRequest> requests;
     std::vector<Ptr<void>> guestPointers;
     void *ssl_ctx = nullptr;
+    HttpConnectionPool pool;
+    HttpIoThreads io_threads;
 };
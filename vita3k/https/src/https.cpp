@@ -35,6 +35,10 @@ typedef int abs_socket;
 
 #include <util/log.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 namespace https {
 
 static void close_socket(const abs_socket sockfd) {
@@ -56,7 +60,8 @@ struct Https {
     abs_socket sockfd = 0;
 };
 
-static Https init(const std::string &url, const std::string &method = "GET", const uint64_t downloaded_file_size = 0) {
+// range_end is exclusive, 0 requests everything from range_start
+static Https init(const std::string &url, const std::string &method = "GET", const uint64_t range_start = 0, const uint64_t range_end = 0) {
 #ifdef WIN32
     // Initialize Winsock
     WORD versionWanted = MAKEWORD(2, 2);
@@ -172,9 +177,9 @@ static Https init(const std::string &url, const std::string &method = "GET", con
     // Send HTTP GET request to extracted URI
     std::string request = method + " " + uri + " HTTP/1.1\r\n";
     request += "Host: " + host + "\r\n";
-    if (downloaded_file_size > 0) {
+    if ((range_start > 0) || (range_end > 0)) {
         request += "Accept-Ranges: bytes\r\n";
-        request += "Range: bytes=" + std::to_string(downloaded_file_size) + "-\r\n";
+        request += "Range: bytes=" + std::to_string(range_start) + "-" + (range_end > 0 ? std::to_string(range_end - 1) : "") + "\r\n";
     }
     request += "User-Agent: OpenSSL/1.1.1\r\n";
     request += "Connection: close\r\n\r\n";
@@ -276,28 +281,6 @@ static std::string convert_md5_bytes_to_str(unsigned char *md5_bytes) {
     return content_md5;
 }
 
-static std::string calculate_md5_file(const std::string &file_path) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file) {
-        LOG_ERROR("Failed to open file: {}", file_path);
-        return {};
-    }
-
-    MD5_CTX md5_context;
-    MD5_Init(&md5_context);
-
-    char buffer[1024];
-    while (!file.eof()) {
-        file.read(buffer, sizeof(buffer));
-        MD5_Update(&md5_context, buffer, file.gcount());
-    }
-
-    unsigned char md5_digest[MD5_DIGEST_LENGTH];
-    MD5_Final(md5_digest, &md5_context);
-
-    return convert_md5_bytes_to_str(md5_digest);
-}
-
 static std::string get_content_md5(const std::string &header) {
     std::smatch match;
     std::string content_md5_base64;
@@ -339,6 +322,231 @@ static std::string get_content_md5(const std::string &header) {
     return convert_md5_bytes_to_str(md5_bytes);
 }
 
+// Part of the file downloaded by its own connection, end is exclusive
+struct DownloadSegment {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    // bytes written to the output file from start
+    std::atomic<uint64_t> done = 0;
+    std::atomic<bool> finished = false;
+    std::atomic<bool> failed = false;
+};
+
+struct DownloadControl {
+    std::atomic<bool> pause = false;
+    std::atomic<bool> cancel = false;
+};
+
+// the segments are saved beside the output file to resume the download later
+static constexpr uint32_t SEGMENTS_MAGIC = 0x44534B33; // "3KSD"
+static constexpr uint32_t SEGMENTS_VERSION = 1;
+static constexpr size_t MAX_SEGMENTS = 4;
+static constexpr uint64_t MIN_SEGMENT_SIZE = 4 * 1024 * 1024;
+static constexpr int MAX_SEGMENT_RETRIES = 5;
+
+static fs::path get_segments_path(const std::string &output_file_path) {
+    return fs::path(output_file_path + ".segments");
+}
+
+static bool load_segments(const std::string &output_file_path, const uint64_t file_size, std::vector<DownloadSegment> &segments) {
+    std::ifstream file(get_segments_path(output_file_path).string(), std::ios::binary);
+    if (!file)
+        return false;
+
+    uint32_t magic = 0, version = 0, count = 0;
+    uint64_t saved_file_size = 0;
+    file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    file.read(reinterpret_cast<char *>(&saved_file_size), sizeof(saved_file_size));
+    file.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if (!file || (magic != SEGMENTS_MAGIC) || (version != SEGMENTS_VERSION) || (saved_file_size != file_size) || (count == 0) || (count > MAX_SEGMENTS))
+        return false;
+
+    std::vector<DownloadSegment> loaded(count);
+    uint64_t expected_start = 0;
+    for (auto &segment : loaded) {
+        uint64_t done = 0;
+        file.read(reinterpret_cast<char *>(&segment.start), sizeof(segment.start));
+        file.read(reinterpret_cast<char *>(&segment.end), sizeof(segment.end));
+        file.read(reinterpret_cast<char *>(&done), sizeof(done));
+        // the segments must cover the whole file in order
+        if (!file || (segment.start != expected_start) || (segment.end <= segment.start) || (done > segment.end - segment.start))
+            return false;
+        segment.done = done;
+        expected_start = segment.end;
+    }
+    if (expected_start != file_size)
+        return false;
+
+    segments.swap(loaded);
+    return true;
+}
+
+static void save_segments(const std::string &output_file_path, const uint64_t file_size, const std::vector<DownloadSegment> &segments) {
+    const auto segments_path = get_segments_path(output_file_path);
+    const auto temp_path = fs::path(segments_path.string() + ".tmp");
+    {
+        std::ofstream file(temp_path.string(), std::ios::binary);
+        const uint32_t count = static_cast<uint32_t>(segments.size());
+        file.write(reinterpret_cast<const char *>(&SEGMENTS_MAGIC), sizeof(SEGMENTS_MAGIC));
+        file.write(reinterpret_cast<const char *>(&SEGMENTS_VERSION), sizeof(SEGMENTS_VERSION));
+        file.write(reinterpret_cast<const char *>(&file_size), sizeof(file_size));
+        file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        for (const auto &segment : segments) {
+            const uint64_t done = segment.done;
+            file.write(reinterpret_cast<const char *>(&segment.start), sizeof(segment.start));
+            file.write(reinterpret_cast<const char *>(&segment.end), sizeof(segment.end));
+            file.write(reinterpret_cast<const char *>(&done), sizeof(done));
+        }
+        if (!file) {
+            LOG_WARN("Failed to save the download segments: {}", segments_path.string());
+            return;
+        }
+    }
+
+    boost::system::error_code err;
+    fs::rename(temp_path, segments_path, err);
+    if (err)
+        LOG_WARN("Failed to save the download segments: {}", err.message());
+}
+
+// Reads the response up to the end of the header, the start of the body read with it is put in body
+static bool read_header(const Https &https, std::string &header, std::string &body) {
+    std::vector<char> read_buffer(4096);
+    std::string response;
+    size_t header_end = std::string::npos;
+    while (header_end == std::string::npos) {
+        const int bytes_read = SSL_read(https.ssl, read_buffer.data(), static_cast<uint32_t>(read_buffer.size()));
+        if (bytes_read <= 0)
+            return false;
+
+        response.append(read_buffer.data(), bytes_read);
+        header_end = response.find("\r\n\r\n");
+    }
+
+    header = response.substr(0, header_end + 4);
+    body = response.substr(header_end + 4);
+    return true;
+}
+
+// Downloads what is left of the segment with one connection, returns false if it has to be tried again
+static bool download_range(const std::string &url, const std::string &output_file_path, DownloadSegment &segment, const DownloadControl &control) {
+    const uint64_t offset = segment.start + segment.done;
+    auto https = init(url, "GET", offset, segment.end);
+    if (!https.ssl)
+        return false;
+
+    std::string header, body;
+    if (!read_header(https, header, body)) {
+        LOG_ERROR("Error reading header of range {}-{}", offset, segment.end);
+        close_ssl(https.ssl);
+        close_socket(https.sockfd);
+        return false;
+    }
+
+    // a server ignoring the range sends the whole file, which is only fine from the start
+    const auto status_end = header.find("\r\n");
+    const auto status_line = header.substr(0, status_end);
+    if ((status_line.find(" 206") == std::string::npos) && ((offset > 0) || (status_line.find(" 200") == std::string::npos))) {
+        LOG_ERROR("Unexpected response for range {}-{}: {}", offset, segment.end, status_line);
+        close_ssl(https.ssl);
+        close_socket(https.sockfd);
+        return false;
+    }
+
+    std::fstream outfile(output_file_path, std::ios::in | std::ios::out | std::ios::binary);
+    outfile.seekp(offset);
+
+    const auto write_data = [&](const char *data, uint64_t size) {
+        size = std::min(size, segment.end - segment.start - segment.done);
+        outfile.write(data, size);
+        // flushed before being counted, so the data is there to be hashed and resumed from
+        outfile.flush();
+        if (outfile)
+            segment.done += size;
+    };
+
+    write_data(body.data(), body.size());
+
+    std::vector<char> read_buffer(64 * 1024);
+    while (outfile && !control.cancel && !control.pause && (segment.done < segment.end - segment.start)) {
+        const int bytes_read = SSL_read(https.ssl, read_buffer.data(), static_cast<uint32_t>(read_buffer.size()));
+        if (bytes_read <= 0)
+            break;
+
+        write_data(read_buffer.data(), bytes_read);
+    }
+
+    close_ssl(https.ssl);
+    close_socket(https.sockfd);
+
+    if (!outfile) {
+        LOG_ERROR("Failed to write to file: {}", output_file_path);
+        segment.failed = true;
+    }
+
+    return control.cancel || control.pause || (segment.done == segment.end - segment.start);
+}
+
+static void download_segment(const std::string &url, const std::string &output_file_path, DownloadSegment &segment, const DownloadControl &control) {
+    int failures = 0;
+    while (!control.cancel && !segment.failed && (segment.done < segment.end - segment.start)) {
+        if (control.pause) {
+            // the connection is closed while paused, a new one continues from where it stopped
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        const uint64_t done_before = segment.done;
+        if (download_range(url, output_file_path, segment, control))
+            continue;
+
+        // only failures without progress in between count against the segment
+        if (segment.done > done_before)
+            failures = 0;
+        if (++failures > MAX_SEGMENT_RETRIES) {
+            LOG_ERROR("Giving up on range {}-{} after {} attempts", segment.start + segment.done, segment.end, failures);
+            segment.failed = true;
+            break;
+        }
+
+        LOG_WARN("Download of range {}-{} interrupted, resuming it, attempt {}", segment.start + segment.done, segment.end, failures);
+        std::this_thread::sleep_for(std::chrono::seconds(failures));
+    }
+
+    segment.finished = true;
+}
+
+// Hashes the data of the output file downloaded contiguously from the start, from where the last call stopped
+static void update_md5(MD5_CTX &md5_context, std::ifstream &file, uint64_t &hashed_size, const std::vector<DownloadSegment> &segments) {
+    std::vector<char> buffer(64 * 1024);
+    for (const auto &segment : segments) {
+        const uint64_t done_end = segment.start + segment.done;
+        if (hashed_size < segment.start)
+            return;
+        if (hashed_size >= done_end) {
+            if (done_end < segment.end)
+                return;
+            continue;
+        }
+
+        file.clear();
+        file.seekg(hashed_size);
+        while (hashed_size < done_end) {
+            const auto size = std::min<uint64_t>(buffer.size(), done_end - hashed_size);
+            file.read(buffer.data(), size);
+            if (!file)
+                return;
+
+            MD5_Update(&md5_context, buffer.data(), size);
+            hashed_size += size;
+        }
+
+        if (done_end < segment.end)
+            return;
+    }
+}
+
 bool download_file(std::string url, const std::string &output_file_path, ProgressCallback progress_callback) {
     // Get the HEAD of response
     auto response = get_web_response(url, "HEAD");
@@ -390,46 +598,41 @@ bool download_file(std::string url, const std::string &output_file_path, Progres
 
     // Get the downloaded file size
     uint64_t downloaded_file_size = 0;
-    std::ifstream file(output_file_path, std::ios::binary);
-    if (file.is_open()) {
-        file.seekg(0, std::ios::end);
-        downloaded_file_size = file.tellg();
-        file.close();
-    }
-
-    // Init SSL and socket connection with the downloaded file size (if exists)
-    auto https = init(url, "GET", downloaded_file_size);
-    if (!https.ssl)
-        return false;
-
-    // Calculate the header size based on the HEAD of response
-    auto header_size = response.length();
-    if (downloaded_file_size > 0) {
-        // Calculate the size of the added line of Content-Range with the end of line characters
-        const auto content_range_length = fmt::format("\r\nContent-Range: bytes {}-{}/{}\r\n", downloaded_file_size, file_size, file_size).length();
-        // Add the size of diference between the HEAD of response and the GET of response
-        header_size += 13 + content_range_length - (std::to_string(file_size).length() - std::to_string(downloaded_file_size).length());
-    }
-
-    // Create read buffer with using header size
-    std::vector<char> read_buffer(header_size);
-
-    // Read the header of the response and check if the response is resource not found
-    uint32_t bytes_read = SSL_read(https.ssl, read_buffer.data(), static_cast<uint32_t>(read_buffer.size()));
-    if (std::string(read_buffer.data()).find("HTTP/1.1 404 Not Found") != std::string::npos) {
-        LOG_ERROR("404 Not Found");
-        close_ssl(https.ssl);
-        close_socket(https.sockfd);
-
-        return false;
-    }
-
-    // Check if bytes read is diferent of header size
-    if (bytes_read < (header_size * 0.99f)) {
-        LOG_ERROR("Error reading header: {}/{}\n{}", bytes_read, header_size, read_buffer.data());
-        close_ssl(https.ssl);
-        close_socket(https.sockfd);
-        return false;
+    boost::system::error_code err;
+    if (fs::exists(output_file_path))
+        downloaded_file_size = fs::file_size(output_file_path, err);
+
+    // Resume the segments of the last download, a file without them was downloaded in one go up to its size
+    std::vector<DownloadSegment> segments;
+    if ((downloaded_file_size != file_size) || !load_segments(output_file_path, file_size, segments)) {
+        const uint64_t remaining_size = file_size - std::min(downloaded_file_size, file_size);
+        const bool accept_ranges = response.find("Accept-Ranges: bytes") != std::string::npos;
+        const size_t count = remaining_size == 0 ? 0 : (accept_ranges ? std::clamp<size_t>(remaining_size / MIN_SEGMENT_SIZE, 1, MAX_SEGMENTS) : 1);
+
+        std::vector<DownloadSegment> new_segments(count + (remaining_size < file_size ? 1 : 0));
+        auto segment = new_segments.begin();
+        if (remaining_size < file_size) {
+            segment->end = file_size - remaining_size;
+            segment->done = segment->end;
+            ++segment;
+        }
+        for (size_t i = 0; i < count; i++, ++segment) {
+            segment->start = file_size - remaining_size + (remaining_size * i / count);
+            segment->end = file_size - remaining_size + (remaining_size * (i + 1) / count);
+        }
+        segments.swap(new_segments);
+
+        if (downloaded_file_size > file_size)
+            fs::remove(output_file_path);
+        if (!fs::exists(output_file_path))
+            std::ofstream(output_file_path, std::ios::binary).close();
+        // the segments write to their own part of the file
+        fs::resize_file(output_file_path, file_size, err);
+        if (err) {
+            LOG_ERROR("Failed to allocate file: {}, {}", output_file_path, err.message());
+            return false;
+        }
+        save_segments(output_file_path, file_size, segments);
     }
 
     // Create lambda to get current time in milliseconds
@@ -437,77 +640,109 @@ bool download_file(std::string url, const std::string &output_file_path, Progres
         return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
     };
 
-    // Open the output file
-    std::ofstream outfile(output_file_path, std::ios::app | std::ios::binary);
+    const auto get_downloaded_size = [&]() {
+        uint64_t size = 0;
+        for (const auto &segment : segments)
+            size += segment.done;
+        return size;
+    };
+
+    DownloadControl control;
+    std::vector<std::thread> threads;
+    for (auto &segment : segments) {
+        if (segment.done < segment.end - segment.start)
+            threads.emplace_back(download_segment, std::cref(url), std::cref(output_file_path), std::ref(segment), std::cref(control));
+        else
+            segment.finished = true;
+    }
+
+    // The MD5 is computed while the file is downloaded, from the data just written
+    MD5_CTX md5_context;
+    MD5_Init(&md5_context);
+    uint64_t hashed_size = 0;
+    std::ifstream hashed_file(output_file_path, std::ios::binary);
 
     // Set the initial downloaded file size to calculate the remaining time of download
+    downloaded_file_size = get_downloaded_size();
     auto initial_downloaded_file_size = downloaded_file_size;
 
     // Set the initial time to calculate the remaining time of download
     auto start_time = get_current_time_ms();
+    auto last_save_time = start_time;
 
     float progress_percent = 0.f;
     uint64_t remaining_time = 0;
     ProgressState progress_state{};
 
-    while (progress_state.download && bytes_read) {
-        if (!progress_state.pause) {
-            if ((bytes_read = SSL_read(https.ssl, read_buffer.data(), static_cast<uint32_t>(read_buffer.size())))) {
-                // Write the read buffer to the output file
-                outfile.write(read_buffer.data(), bytes_read);
+    const auto is_finished = [&]() {
+        return std::all_of(segments.begin(), segments.end(), [](const DownloadSegment &segment) { return segment.finished.load(); });
+    };
 
-                // Update the downloaded file size
-                downloaded_file_size += bytes_read;
+    while (!is_finished()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        update_md5(md5_context, hashed_file, hashed_size, segments);
 
-                if (progress_callback) {
-                    // Update progress percent
-                    progress_percent = static_cast<float>(downloaded_file_size) / static_cast<float>(file_size) * 100.0f;
+        downloaded_file_size = get_downloaded_size();
+        if (!progress_state.pause) {
+            if (progress_callback) {
+                // Update progress percent
+                progress_percent = static_cast<float>(downloaded_file_size) / static_cast<float>(file_size) * 100.0f;
 
-                    // Calculate elapsed time since start of download in seconds
-                    const auto elapsed_time_ms = std::difftime(get_current_time_ms(), start_time);
+                // Calculate elapsed time since start of download in seconds
+                const auto elapsed_time_ms = std::difftime(get_current_time_ms(), start_time);
 
-                    // Calculate remaining time in seconds
-                    const auto downloaded_bytes = static_cast<double>(downloaded_file_size - initial_downloaded_file_size);
-                    const auto remaining_bytes = static_cast<double>(file_size - downloaded_file_size);
+                // Calculate remaining time in seconds
+                const auto downloaded_bytes = static_cast<double>(downloaded_file_size - initial_downloaded_file_size);
+                const auto remaining_bytes = static_cast<double>(file_size - downloaded_file_size);
+                if (downloaded_bytes > 0)
                     remaining_time = static_cast<uint64_t>((remaining_bytes / downloaded_bytes) * elapsed_time_ms) / 1000;
-                }
             }
         } else {
-            // Sleep for 100ms to not consume CPU
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
             // Reset initial downloaded file size and start time to calculate remaining time correctly when resume download
             initial_downloaded_file_size = downloaded_file_size;
             start_time = get_current_time_ms();
         }
 
+        if (get_current_time_ms() - last_save_time >= 1000) {
+            save_segments(output_file_path, file_size, segments);
+            last_save_time = get_current_time_ms();
+        }
+
         // Call progress callback function to update progress info and state
-        if (progress_callback)
+        if (progress_callback) {
             progress_state = progress_callback(progress_percent, remaining_time);
+            control.pause = progress_state.pause;
+            control.cancel = !progress_state.download;
+        }
     }
 
-    // Close the output file
-    outfile.close();
+    for (auto &thread : threads)
+        thread.join();
 
-    // Close SSL and socket connection
-    close_ssl(https.ssl);
-    close_socket(https.sockfd);
+    update_md5(md5_context, hashed_file, hashed_size, segments);
+    hashed_file.close();
+    downloaded_file_size = get_downloaded_size();
 
     // Reset progress state to 0
     if (progress_callback)
         progress_state = progress_callback(0, 0);
 
     // Check if download file size is same of file size
-    if (downloaded_file_size < (file_size * 0.99)) {
-        if (progress_state.download)
+    if (downloaded_file_size < file_size) {
+        save_segments(output_file_path, file_size, segments);
+        if (!control.cancel)
             LOG_ERROR("Downloaded size is not equal to file size, downloaded size: {}/{}", downloaded_file_size, file_size);
         else
             LOG_WARN("Canceled by user, dowloaded size: {}/{}", downloaded_file_size, file_size);
         return false;
     }
 
+    fs::remove(get_segments_path(output_file_path), err);
+
     // Check if the downloaded file is corrupted
-    const auto downloaded_file_md5 = calculate_md5_file(output_file_path);
+    unsigned char md5_digest[MD5_DIGEST_LENGTH];
+    MD5_Final(md5_digest, &md5_context);
+    const auto downloaded_file_md5 = hashed_size == file_size ? convert_md5_bytes_to_str(md5_digest) : std::string();
     if (downloaded_file_md5 != content_md5) {
         LOG_ERROR("Downloaded file is corrupted, MD5 Expected: {}; Downloaded: {}", content_md5, downloaded_file_md5);
         fs::remove(output_file_path);
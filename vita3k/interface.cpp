@@ -19,6 +19,7 @@
 
 #include "module/load_module.h"
 
+#include <app/checkpoint.h>
 #include <config/state.h>
 #include <ctrl/functions.h>
 #include <ctrl/state.h>
@@ -29,6 +30,7 @@
 #include <io/device.h>
 #include <io/functions.h>
 #include <io/vfs.h>
+#include <io/zip.h>
 #include <kernel/load_self.h>
 #include <kernel/state.h>
 #include <packages/functions.h>
@@ -39,6 +41,7 @@
 #include <string>
 #include <touch/functions.h>
 #include <touch/touch.h>
+#include <util/boot_profiler.h>
 #include <util/find.h>
 #include <util/log.h>
 #include <util/string_utils.h>
@@ -46,6 +49,7 @@
 #include <gui/imgui_impl_sdl.h>
 
 #include <regex>
+#include <thread>
 
 #include <SDL.h>
 
@@ -322,6 +326,37 @@ std::vector<ContentInfo> install_archive(EmuEnvState &emuenv, GuiState *gui, con
     return content_installed;
 }
 
+bool mount_app_archive(EmuEnvState &emuenv, const fs::path &archive_path) {
+    const ZipArchivePtr archive = open_zip_archive(archive_path);
+    if (!archive)
+        return false;
+
+    if (archive->files.contains("sce_module/steroid.suprx")) {
+        LOG_CRITICAL("A Vitamin dump was detected, aborting...");
+        return false;
+    }
+    // the files of a NoNpDrm app are decrypted while it is installed
+    if (archive->files.contains("sce_sys/package/work.bin")) {
+        LOG_ERROR("The app of {} is encrypted, it cannot be run from the archive", archive_path.string());
+        return false;
+    }
+
+    const ZipFileStreamPtr sfo = open_zip_file(archive, "sce_sys/param.sfo", false);
+    vfs::FileBuffer buffer(get_zip_file_size(*sfo));
+    if (read_zip_file(*sfo, buffer.data(), buffer.size()) != static_cast<SceOff>(buffer.size()))
+        return false;
+    sfo::get_param_info(emuenv.app_info, buffer, emuenv.cfg.sys_lang);
+    if (emuenv.app_info.app_category.find("gd") == std::string::npos) {
+        LOG_ERROR("The content of {} is not an app, it cannot be run from the archive", archive_path.string());
+        return false;
+    }
+
+    register_app_archive(emuenv.app_info.app_title_id, archive);
+    LOG_INFO("{} [{}] is run from its archive", emuenv.app_info.app_title, emuenv.app_info.app_title_id);
+
+    return true;
+}
+
 static std::vector<fs::path> get_contents_path(const fs::path &path) {
     std::vector<fs::path> contents_path;
 
@@ -419,9 +454,19 @@ static ExitCode load_app_impl(SceUID &main_module_id, EmuEnvState &emuenv, const
     if (path.empty())
         return InvalidApplicationPath;
 
-    const auto call_import = [&emuenv](CPUState &cpu, uint32_t nid, SceUID thread_id) {
-        ::call_import(emuenv, cpu, nid, thread_id);
+    const BootScope boot_scope(emuenv.boot_profiler, "load_app", "load_app");
+
+    const auto call_import = [&emuenv](CPUState &cpu, uint32_t nid, uint32_t import_index, const ThreadStatePtr &thread) {
+        ::call_import(emuenv, cpu, nid, import_index, thread);
     };
+    emuenv.kernel.cpu_pool_size = std::max(emuenv.cfg.cpu_pool_size, 0);
+    emuenv.kernel.hle_hot_routines = emuenv.cfg.hle_hot_routines;
+    emuenv.kernel.self_cache_path = emuenv.cache_path / "self";
+    emuenv.kernel.host_thread_priority = emuenv.cfg.host_thread_priority;
+    emuenv.kernel.host_thread_affinity = emuenv.cfg.host_thread_affinity;
+    emuenv.kernel.delay_spin_us = static_cast<uint32_t>(std::max(emuenv.cfg.delay_spin_us, 0));
+    emuenv.kernel.timer_wheel.spin_us = emuenv.kernel.delay_spin_us;
+    emuenv.kernel.guest_scheduler.enabled = emuenv.cfg.guest_scheduler;
     if (!emuenv.kernel.init(emuenv.mem, call_import, emuenv.kernel.cpu_backend, emuenv.kernel.cpu_opt)) {
         LOG_WARN("Failed to init kernel!");
         return KernelInitFailed;
@@ -464,6 +509,7 @@ static ExitCode load_app_impl(SceUID &main_module_id, EmuEnvState &emuenv, const
 
     init_device_paths(emuenv.io);
     init_savedata_app_path(emuenv.io, emuenv.pref_path);
+    prefetch_app_metadata(emuenv.io, emuenv.pref_path.wstring());
 
     // todo: VAR_NID(__sce_libcparam, 0xDF084DFA) is loaded wrong
     for (const auto &var : get_var_exports()) {
@@ -492,7 +538,8 @@ static ExitCode load_app_impl(SceUID &main_module_id, EmuEnvState &emuenv, const
         }
     }
     const auto module_app_path{ emuenv.pref_path / "ux0/app" / emuenv.io.app_path / "sce_module" };
-    const auto is_app = fs::exists(module_app_path) && !fs::is_empty(module_app_path);
+    const ZipArchivePtr app_archive = find_app_archive(emuenv.io.app_path);
+    const auto is_app = app_archive ? get_zip_dir(*app_archive, "sce_module", false) != nullptr : fs::exists(module_app_path) && !fs::is_empty(module_app_path);
     std::vector<std::string> lib_load_list = {};
     // todo: check if module is imported
     auto add_preload_module = [&](uint32_t code, SceSysmoduleModuleId module_id, const std::string &name, bool load_from_app) {
@@ -545,6 +592,15 @@ static void switch_full_screen(EmuEnvState &emuenv) {
     app::update_viewport(emuenv);
 }
 
+static void toggle_turbo_mode(EmuEnvState &emuenv) {
+    const uint32_t speed = emuenv.display.speed == 1 ? static_cast<uint32_t>(std::max(emuenv.cfg.turbo_speed, 0)) : 1;
+    set_emulation_speed(emuenv.display, speed);
+    if (speed == 0)
+        LOG_INFO("Emulation speed: unlimited");
+    else
+        LOG_INFO("Emulation speed: {}x", speed);
+}
+
 bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
     refresh_controllers(emuenv.ctrl, emuenv);
     const auto allow_switch_state = !emuenv.io.title_id.empty() && !gui.vita_area.app_close && !gui.vita_area.home_screen && !gui.vita_area.user_management && !gui.configuration_menu.custom_settings_dialog && !gui.configuration_menu.settings_dialog && !gui.controls_menu.controls_dialog && gui::get_sys_apps_state(gui);
@@ -694,6 +750,12 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
                 toggle_touchscreen();
             if (event.key.keysym.scancode == emuenv.cfg.keyboard_gui_fullscreen && !gui.is_key_capture_dropped)
                 switch_full_screen(emuenv);
+            if (allow_switch_state && event.key.keysym.scancode == emuenv.cfg.keyboard_gui_toggle_turbo && !gui.is_key_capture_dropped)
+                toggle_turbo_mode(emuenv);
+            if (allow_switch_state && event.key.keysym.scancode == emuenv.cfg.keyboard_gui_save_checkpoint && !gui.is_key_capture_dropped)
+                app::save_checkpoint(emuenv, app::get_checkpoint_path(emuenv));
+            if (allow_switch_state && event.key.keysym.scancode == emuenv.cfg.keyboard_gui_load_checkpoint && !gui.is_key_capture_dropped)
+                app::load_checkpoint(emuenv, app::get_checkpoint_path(emuenv));
 
             if (sce_ctrl_btn != 0)
                 ui_navigation(sce_ctrl_btn);
@@ -820,6 +882,11 @@ ExitCode run_app(EmuEnvState &emuenv, int32_t main_module_id) {
             affinity = *affinity_ptr.get(emuenv.mem);
         }
     }
+
+    init_jit_profile(emuenv.kernel.jit_profile, emuenv.cache_path / "jit" / emuenv.io.title_id / emuenv.self_name, emuenv.cfg.jit_precompile);
+    init_guest_profiler(emuenv.kernel.guest_profiler, emuenv.log_path / "profiles" / fmt::format("{}-{}.folded", emuenv.io.title_id, emuenv.self_name));
+    init_hle_profiler(emuenv.kernel.hle_profiler, emuenv.log_path / "profiles" / fmt::format("{}-{}-hle", emuenv.io.title_id, emuenv.self_name), emuenv.cfg.hle_profiler);
+
     const ThreadStatePtr main_thread = emuenv.kernel.create_thread(emuenv.mem, emuenv.io.title_id.c_str(), entry_point, priority, affinity, stack_size, nullptr);
     if (!main_thread) {
         app::error_dialog("Failed to init main thread.", emuenv.window.get());
@@ -827,12 +894,35 @@ ExitCode run_app(EmuEnvState &emuenv, int32_t main_module_id) {
     }
     emuenv.main_thread_id = main_thread->id;
 
+    // Translate the code run during the last boot with the cpu of the main thread while the libraries are started,
+    // the main thread does not run before it is started
+    std::thread precompile_thread;
+    std::vector<Address> precompile_blocks = load_jit_profile(emuenv.kernel);
+    if (!precompile_blocks.empty()) {
+        LOG_INFO("Translating {} blocks from the jit profile", precompile_blocks.size());
+        precompile_thread = std::thread([cpu = main_thread->cpu.get(), blocks = std::move(precompile_blocks)]() {
+            for (const Address block : blocks)
+                translate_block(*cpu, block & ~1U, block & 1);
+        });
+    }
+
+    const ModuleLoadProfile &load_profile = emuenv.kernel.module_load_profile;
+    LOG_INFO("Loaded {} modules in {} ms (segments: {} ms, relocation: {} ms, exports: {} ms, imports: {} ms)", load_profile.module_count.load(),
+        (load_profile.segments_us + load_profile.relocation_us + load_profile.exports_us + load_profile.imports_us) / 1000,
+        load_profile.segments_us / 1000, load_profile.relocation_us / 1000, load_profile.exports_us / 1000, load_profile.imports_us / 1000);
+
     // Run `module_start` export (entry point) of loaded libraries
     for (auto &[_, module] : emuenv.kernel.loaded_modules) {
         if (module->modid != main_module_id)
             start_module(emuenv, module);
     }
 
+    if (precompile_thread.joinable())
+        precompile_thread.join();
+
+    if (emuenv.cfg.guest_profiler)
+        start_guest_profiler(emuenv.kernel);
+
     SceKernelThreadOptParam param{ 0, 0 };
     if (!emuenv.cfg.app_args.empty()) {
         auto args = split(emuenv.cfg.app_args, ",\\s+");
@@ -56,6 +56,8 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui);
 
 std::vector<ContentInfo> install_archive(EmuEnvState &emuenv, GuiState *gui, const fs::path &archive_path, const std::function<void(ArchiveContents)> &progress_callback = nullptr);
 uint32_t install_contents(EmuEnvState &emuenv, GuiState *gui, const fs::path &path);
+// the app of the archive is then run from it as a read-only app0, returns false if it has to be installed instead
+bool mount_app_archive(EmuEnvState &emuenv, const fs::path &archive_path);
 
 ExitCode load_app(int32_t &main_module_id, EmuEnvState &emuenv, const std::wstring &path);
 ExitCode run_app(EmuEnvState &emuenv, int32_t main_module_id);
@@ -0,0 +1,78 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <io/VitaIoDevice.h>
+#include <io/types.h>
+#include <threads/queue.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct IOState;
+
+typedef std::function<void()> AsyncIoTask;
+// does the operation on the worker and returns its result, the same as the synchronous export
+typedef std::function<SceInt64()> AsyncIoRequest;
+
+struct AsyncIoOp {
+    // an operation can only be cancelled until its worker starts it
+    bool started = false;
+    bool cancelled = false;
+    bool done = false;
+    SceInt64 result = 0;
+};
+
+typedef std::shared_ptr<AsyncIoOp> AsyncIoOpPtr;
+
+struct AsyncIoWorker {
+    Queue<AsyncIoTask> tasks;
+    std::thread thread;
+};
+
+// Runs the asynchronous requests on host threads, so that the guest threads do not wait for the disk.
+// Each device has its own worker: the requests of a device, and so of a file, are done in the order they were submitted.
+struct AsyncIoState {
+    std::mutex mutex;
+    std::map<int, std::unique_ptr<AsyncIoWorker>> workers;
+    // the operations not completed yet, by the UID given to the guest
+    std::map<SceUID, AsyncIoOpPtr> ops;
+    bool exiting = false;
+
+    AsyncIoState() = default;
+    AsyncIoState(const AsyncIoState &) = delete;
+    AsyncIoState &operator=(const AsyncIoState &) = delete;
+    ~AsyncIoState();
+};
+
+// the worker of the device is started by its first request
+void submit_async_io(AsyncIoState &async_io, VitaIoDevice device, AsyncIoTask task);
+// on_done is called on the worker once the result of the operation is set, even if it was cancelled
+void submit_async_io_op(AsyncIoState &async_io, SceUID op_id, VitaIoDevice device, AsyncIoRequest request, std::function<void()> on_done);
+bool is_async_io_op(AsyncIoState &async_io, SceUID op_id);
+// returns false if the operation has already been started
+bool cancel_async_io_op(AsyncIoState &async_io, SceUID op_id);
+// the operation is forgotten once its result is taken, returns false if it is not done
+bool take_async_io_result(AsyncIoState &async_io, SceUID op_id, SceInt64 &result);
+// returns the device holding the file or directory opened as fd, VitaIoDevice::_INVALID if there is none
+VitaIoDevice get_fd_device(const IOState &io, SceUID fd);
+// the requests not started yet are dropped
+void stop_async_io(AsyncIoState &async_io);
@@ -0,0 +1,161 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <io/VitaIoDevice.h>
+#include <io/types.h>
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct IOState;
+
+constexpr int SCE_FIOS_OK = 0;
+constexpr int SCE_FIOS_ERROR_UNKNOWN = 0x80820001;
+constexpr int SCE_FIOS_ERROR_BAD_PATH = 0x80820002;
+constexpr int SCE_FIOS_ERROR_BAD_PTR = 0x80820003;
+constexpr int SCE_FIOS_ERROR_BAD_OFFSET = 0x80820004;
+constexpr int SCE_FIOS_ERROR_BAD_SIZE = 0x80820005;
+constexpr int SCE_FIOS_ERROR_BAD_IOVCNT = 0x80820006;
+constexpr int SCE_FIOS_ERROR_BAD_OP = 0x80820007;
+constexpr int SCE_FIOS_ERROR_BAD_FH = 0x80820008;
+constexpr int SCE_FIOS_ERROR_TIMEOUT = 0x8082000F;
+constexpr int SCE_FIOS_ERROR_CANCELLED = 0x80820010;
+
+// no deadline, the operation is done after the ones having one
+constexpr SceInt64 SCE_FIOS_TIME_NULL = 0;
+
+// part of the guest memory read or written by an operation
+struct FiosIoVec {
+    uint8_t *data;
+    SceSize size;
+};
+
+struct FiosOp {
+    SceUID id = 0;
+    const char *export_name = nullptr;
+    // higher first, then the earliest deadline, then in the order they were submitted
+    int8_t priority = 0;
+    SceInt64 deadline = SCE_FIOS_TIME_NULL;
+    uint64_t order = 0;
+
+    // set for the reads of a file handle, which are merged with the reads of the same file following them
+    SceUID fd = -1;
+    // guest path of the file, after the overlays are applied
+    std::string path;
+    SceOff offset = 0;
+    std::vector<FiosIoVec> buffers;
+    // does the other operations, returns the same value as the synchronous export
+    std::function<SceInt64()> request;
+
+    bool started = false;
+    bool cancelled = false;
+    bool done = false;
+    // number of bytes read or written, or the error
+    SceInt64 result = 0;
+    std::condition_variable done_cond;
+
+    bool is_read() const {
+        return !request;
+    }
+
+    SceInt64 requested_size() const;
+};
+
+typedef std::shared_ptr<FiosOp> FiosOpPtr;
+
+struct FiosFile {
+    SceUID fd = -1;
+    std::string path;
+    VitaIoDevice device = VitaIoDevice::_INVALID;
+    // position used by the reads and writes without offset
+    SceOff pos = 0;
+    SceOff size = 0;
+};
+
+struct FiosCacheBlock {
+    std::vector<uint8_t> data;
+    std::list<std::pair<std::string, SceOff>>::iterator lru;
+};
+
+// Blocks of the files prefetched by the guest, the least recently used are dropped once the cache is full.
+struct FiosCache {
+    static constexpr SceOff BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_SIZE = 64 * 1024 * 1024;
+
+    // by guest path and block index
+    std::map<std::pair<std::string, SceOff>, FiosCacheBlock> blocks;
+    // most recently used first
+    std::list<std::pair<std::string, SceOff>> lru;
+    size_t size = 0;
+};
+
+// SceFios2 operations, file handles and prefetch cache.
+// The operations are done on the IO workers: each operation submits a task to the worker of its device,
+// which does the most urgent operation of the device waiting at that time.
+struct FiosState {
+    std::mutex mutex;
+    bool initialized = false;
+    SceUID next_id = 1;
+
+    std::map<SceUID, FiosOpPtr> ops;
+    // operations not started yet, by device
+    std::map<int, std::vector<FiosOpPtr>> pending;
+    uint64_t next_order = 0;
+
+    std::map<SceUID, FiosFile> files;
+    // the archives mounted, by the file handle given to the guest
+    std::map<SceUID, FiosFile> archives;
+
+    // used for the operations submitted without attributes
+    int8_t default_priority = 0;
+    SceInt64 default_deadline = SCE_FIOS_TIME_NULL;
+
+    std::mutex cache_mutex;
+    FiosCache cache;
+};
+
+// in nanoseconds, the same clock as the deadlines
+SceInt64 fios_time_now();
+
+// returns the id of the operation
+SceUID submit_fios_op(IOState &io, VitaIoDevice device, FiosOpPtr op);
+FiosOpPtr get_fios_op(FiosState &fios, SceUID op_id);
+// returns false if the deadline was reached first, SCE_FIOS_TIME_NULL waits without deadline
+bool wait_fios_op(FiosState &fios, FiosOp &op, SceInt64 deadline = SCE_FIOS_TIME_NULL);
+// an operation can only be cancelled until it is started
+bool cancel_fios_op(FiosState &fios, SceUID op_id);
+void delete_fios_op(FiosState &fios, SceUID op_id);
+bool reschedule_fios_op(FiosState &fios, SceUID op_id, SceInt64 deadline, int8_t priority);
+// returns the number of operations cancelled
+int cancel_all_fios_ops(FiosState &fios);
+bool is_fios_idle(FiosState &fios);
+
+// reads the blocks of the range not in the cache yet, a negative length goes to the end of the file,
+// returns the number of bytes of the range in the cache or an error
+SceInt64 prefetch_fios_file(IOState &io, SceUID fd, const std::string &path, SceOff offset, SceInt64 length, const char *export_name);
+bool fios_cache_contains(FiosState &fios, const std::string &path, SceOff offset, SceInt64 length);
+// an empty path flushes the whole cache, a negative length goes to the end of the file
+void flush_fios_cache(FiosState &fios, const std::string &path, SceOff offset = 0, SceInt64 length = -1);
@@ -37,8 +37,13 @@ void init_device_paths(IOState &io);
 bool init_savedata_app_path(IOState &io, const fs::path &pref_path);
 bool init(IOState &io, const fs::path &cache_path, const fs::path &log_path, const fs::path &pref_path, bool redirect_stdout);
 
-bool find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &translated_path, const fs::path &system_path);
-fs::path find_in_cache(IOState &io, const std::string &system_path);
+// starts listing the app0 tree in the background, so that its metadata is cached before the app needs it
+void prefetch_app_metadata(IOState &io, const std::wstring &pref_path);
+
+// returns the path matching system_path without taking the case into account, or an empty path if there is none
+fs::path find_case_isens_path(IOState &io, const fs::path &system_path);
+// to be called once the entries of the directory holding path have changed, path itself is also dropped if it is a directory
+void invalidate_case_isens_path(IOState &io, const fs::path &path);
 
 std::string expand_path(IOState &io, const char *path, const std::wstring &pref_path);
 std::string translate_path(const char *path, VitaIoDevice &device, const IOState::DevicePaths &device_paths);
@@ -69,12 +74,22 @@ bool copy_path(const fs::path &src_path, const std::wstring &pref_path, const st
 SceUID open_file(IOState &io, const char *path, const int flags, const std::wstring &pref_path, const char *export_name);
 int read_file(void *data, IOState &io, SceUID fd, SceSize size, const char *export_name);
 int write_file(SceUID fd, const void *data, SceSize size, const IOState &io, const char *export_name);
+// read and write at the offset without moving the position of the file, can be done while the guest uses it
+int pread_file(void *data, IOState &io, SceUID fd, SceSize size, SceOff offset, const char *export_name);
+int pwrite_file(SceUID fd, const void *data, SceSize size, SceOff offset, const IOState &io, const char *export_name);
 int truncate_file(SceUID fd, unsigned long long length, const IOState &io, const char *export_name);
 SceOff seek_file(SceUID fd, SceOff offset, SceIoSeekMode whence, IOState &io, const char *export_name);
 SceOff tell_file(IOState &io, const SceUID fd, const char *export_name);
 int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstring &pref_path, const char *export_name, SceUID fd = invalid_fd);
 int stat_file_by_fd(IOState &io, const SceUID fd, SceIoStat *statp, const std::wstring &pref_path, const char *export_name);
 int close_file(IOState &io, SceUID fd, const char *export_name);
+// writes the data gathered for the file to the host
+int sync_file(IOState &io, SceUID fd, const char *export_name);
+// writes the data gathered for all the files of the device to the host
+int sync_device(IOState &io, const char *device, const char *export_name);
+// writes the data at the offset of the file, cut after it if truncate is set, or only resizes the file if data is null
+// the new content is written on the write-back thread to a temporary file renamed over the file, the file is used again once it is written
+int stage_file_write(IOState &io, const char *path, SceOff offset, const void *data, SceSize size, bool truncate, const std::wstring &pref_path, const char *export_name);
 int remove_file(IOState &io, const char *file, const std::wstring &pref_path, const char *export_name);
 int rename(IOState &io, const char *old_name, const char *new_name, const std::wstring &pref_path, const char *export_name);
 
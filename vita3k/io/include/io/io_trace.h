@@ -0,0 +1,87 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <util/fs.h>
+#include <util/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Trace of the calls to the io layer, with their arguments and results, replayed by vita3k-io-bench
+// to measure the caches on the same workload.
+enum class IoTraceOp : uint8_t {
+    OpenFile, // path, flags
+    ReadFile, // fd, size
+    SeekFile, // fd, offset, whence
+    StatFile, // path, fd when it is statted by fd
+    CloseFile, // fd
+    OpenDir, // path
+    ReadDir, // fd
+    CloseDir, // fd
+    COUNT
+};
+
+constexpr size_t IO_TRACE_OP_COUNT = static_cast<size_t>(IoTraceOp::COUNT);
+
+struct IoTraceRecord {
+    // from the start of the trace
+    uint64_t timestamp_ns = 0;
+    IoTraceOp op = IoTraceOp::OpenFile;
+    SceUID fd = -1;
+    int64_t arg = 0;
+    int64_t arg2 = 0;
+    // the fd given by the opens
+    int64_t result = 0;
+    std::string path;
+};
+
+struct IOState;
+
+struct IoTrace {
+    // same as IOState::DevicePaths
+    std::string app0;
+    std::string savedata0;
+    std::string addcont0;
+    bool case_isens_find_enabled = false;
+    std::vector<IoTraceRecord> records;
+};
+
+// only read before recording, the calls cost a relaxed load when the trace is stopped
+inline std::atomic<bool> io_trace_enabled = false;
+
+inline bool is_io_trace_enabled() {
+    return io_trace_enabled.load(std::memory_order_relaxed);
+}
+
+void start_io_trace();
+void stop_io_trace();
+void record_io_trace(IoTraceOp op, SceUID fd, const char *path, int64_t arg, int64_t arg2, int64_t result);
+// the device paths of the app are taken from io, so that the paths of the trace are translated the same way
+bool save_io_trace(const fs::path &path, const IOState &io);
+bool load_io_trace(const fs::path &path, IoTrace &trace);
+const char *get_io_trace_op_name(IoTraceOp op);
+
+#define IO_TRACE(op, fd, path, arg, arg2, result)             \
+    do {                                                      \
+        if (is_io_trace_enabled())                            \
+            record_io_trace(op, fd, path, arg, arg2, result); \
+    } while (0)
@@ -0,0 +1,127 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <io/types.h>
+#include <util/fs.h>
+#include <util/mapped_file.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct IOState;
+struct PsarcState;
+
+enum class PsarcCompression {
+    Zlib,
+    Lzma
+};
+
+struct PsarcEntry {
+    uint32_t first_block;
+    uint64_t size;
+};
+
+// A PSARC archive mounted by the guest, its table of contents is parsed once when it is mounted
+// and its blocks are read from its memory mapping.
+struct PsarcArchive {
+    uint32_t id;
+    fs::path path;
+    MappedFile file;
+    PsarcCompression compression;
+    uint32_t block_size;
+    // stored size of each block, 0 for a full block stored as is
+    std::vector<uint32_t> block_sizes;
+    std::vector<uint64_t> block_offsets;
+    // entry 0 is the manifest listing the names of the others
+    std::vector<PsarcEntry> entries;
+    // index of the entries by name, lowercase if the archive ignores the case
+    std::unordered_map<std::string, size_t> files;
+    bool ignore_case;
+};
+
+typedef std::shared_ptr<const PsarcArchive> PsarcArchivePtr;
+
+struct PsarcMount {
+    SceUID id;
+    // guest path the files of the archive are found in
+    std::string mount_point;
+    PsarcArchivePtr archive;
+};
+
+// A file of a mounted archive, opened by the guest
+struct PsarcFileStream {
+    PsarcState *state;
+    PsarcArchivePtr archive;
+    size_t entry;
+    SceOff pos = 0;
+};
+
+typedef std::shared_ptr<PsarcFileStream> PsarcFileStreamPtr;
+typedef std::shared_ptr<const std::vector<uint8_t>> PsarcBlock;
+
+struct PsarcState {
+    static constexpr size_t DEFAULT_DECOMPRESSOR_COUNT = 2;
+    static constexpr size_t MAX_CACHE_SIZE = 32 * 1024 * 1024;
+
+    std::mutex mutex;
+    std::vector<PsarcMount> mounts;
+    uint32_t next_archive_id = 1;
+
+    // decompressed blocks, by archive id and block index, most recently used first
+    std::mutex cache_mutex;
+    std::list<std::pair<uint64_t, PsarcBlock>> lru;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, PsarcBlock>>::iterator> blocks;
+    size_t cache_size = 0;
+
+    // the blocks of a read are decompressed in parallel, the threads are started by the first reads needing them
+    std::mutex decompressor_resize_mutex;
+    std::mutex decompressor_mutex;
+    std::condition_variable decompressor_cond;
+    std::deque<std::function<void()>> decompressor_tasks;
+    std::vector<std::thread> decompressors;
+    size_t decompressor_count = DEFAULT_DECOMPRESSOR_COUNT;
+
+    PsarcState() = default;
+    PsarcState(const PsarcState &) = delete;
+    PsarcState &operator=(const PsarcState &) = delete;
+    ~PsarcState();
+};
+
+// returns the size of the header and table of contents of the archive, or an error (-1 if it is not a valid archive)
+SceInt64 get_psarc_toc_size(IOState &io, const char *archive_path, const std::wstring &pref_path);
+// the files of the archive are then opened from mount_point, returns an error or 0
+int mount_psarc(IOState &io, SceUID mount_id, const char *archive_path, const char *mount_point, const std::wstring &pref_path);
+bool unmount_psarc(PsarcState &psarc, SceUID mount_id);
+// returns nullptr if the path is not in a mounted archive, or the archive does not hold it
+PsarcFileStreamPtr open_psarc_file(PsarcState &psarc, const std::string &path);
+// returns the number of bytes read, or -1 if the blocks could not be decompressed
+SceOff read_psarc_file(PsarcFileStream &stream, void *data, size_t size);
+uint64_t get_psarc_file_size(const PsarcFileStream &stream);
+// the threads above the count exit once their task is done
+void set_psarc_decompressor_count(PsarcState &psarc, size_t count);
+size_t get_psarc_decompressor_count(PsarcState &psarc);
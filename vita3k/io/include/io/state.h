@@ -17,23 +17,196 @@
 
 #pragma once
 
+#include <io/async.h>
 #include <io/filesystem.h>
+#include <io/fios.h>
+#include <io/psarc.h>
 #include <io/types.h>
 #include <io/util.h>
+#include <io/zip.h>
+#include <util/mapped_file.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+// A file of a read-only device read straight from its memory mapping
+struct MappedFileStream {
+    MappedFile file;
+    SceOff pos = 0;
+    // used to detect the sequential reads
+    SceOff last_read_end = -1;
+    uint32_t sequential_reads = 0;
+    bool advised_sequential = false;
+};
+
+typedef std::shared_ptr<MappedFileStream> MappedFileStreamPtr;
+
+// bytes of all the files read through the read-ahead
+struct ReadAheadStats {
+    // copied from a buffer filled in advance
+    std::atomic<uint64_t> hit_bytes = 0;
+    // read from the host file when the guest asked for them
+    std::atomic<uint64_t> miss_bytes = 0;
+};
+
+// A file opened without write flags, read through a buffer filled in advance on the IO worker of its device
+// once it is read sequentially.
+struct ReadAheadStream : std::enable_shared_from_this<ReadAheadStream> {
+    FilePtr file;
+    // held while the host file is read, before the mutex of the stream if both are needed
+    std::mutex file_mutex;
+
+    std::mutex mutex;
+    // position given to the guest, the host file is seeked before each read
+    SceOff pos = 0;
+    // data of the file from buffer_start
+    std::vector<uint8_t> buffer;
+    SceOff buffer_start = 0;
+    bool fill_pending = false;
+    // set once a fill reached the end of the file, until the next random access
+    bool reached_end = false;
+
+    // used to detect the sequential reads
+    SceOff last_read_end = -1;
+    uint32_t sequential_reads = 0;
+    // size of the next fill, doubled by each fill of a sequential stream
+    size_t window = 0;
+    // capacity of the buffer reported to the memory accounting
+    size_t accounted_bytes = 0;
+
+    ReadAheadStats *stats = nullptr;
+    // submits the fills to the IO worker
+    std::function<void(AsyncIoTask)> schedule;
+
+    ~ReadAheadStream();
+};
+
+typedef std::shared_ptr<ReadAheadStream> ReadAheadStreamPtr;
+
+struct WriteBackState;
+
+// data of a write gathered by a write-back stream, with the contiguous writes following it
+struct WriteBackExtent {
+    SceOff start = 0;
+    std::vector<uint8_t> data;
+};
+
+// A file opened with write flags, its writes are gathered in extents written to the host file in the order of
+// the writes when they are full, a bit after the first write gathered, on close, or when the guest syncs it.
+// The writes at random offsets of the databases are then written together when the guest syncs the file.
+struct WriteBackStream : std::enable_shared_from_this<WriteBackStream> {
+    FilePtr file;
+    // held while the host file is used, before the mutex of the stream if both are needed
+    std::mutex file_mutex;
+
+    std::mutex mutex;
+    // position given to the guest, the host file is seeked before each access
+    SceOff pos = 0;
+    // data to write to the file, a later extent overwrites the earlier ones it overlaps
+    std::vector<WriteBackExtent> extents;
+    // size of the data of the extents
+    size_t buffered_size = 0;
+
+    WriteBackState *state = nullptr;
+    // host path, used to wait for the file to be written once closed
+    std::string path;
+
+    WriteBackStream() = default;
+    WriteBackStream(const WriteBackStream &) = delete;
+    WriteBackStream &operator=(const WriteBackStream &) = delete;
+    // writes what is left in the buffer
+    ~WriteBackStream();
+};
+
+typedef std::shared_ptr<WriteBackStream> WriteBackStreamPtr;
+
+// content of a whole host file, written to a temporary file renamed over the file so it is never left half written
+struct WriteBackCommit {
+    fs::path path;
+    // host path as the key of the pending paths
+    std::string key;
+    std::vector<uint8_t> data;
+};
+
+// Writes the buffered data of the write-back streams on its own host thread.
+struct WriteBackState {
+    std::mutex mutex;
+    // notified when there is data to write or the thread has to exit
+    std::condition_variable cond;
+    std::thread thread;
+    bool exiting = false;
+
+    // streams holding data, by the time it has to be written
+    std::multimap<std::chrono::steady_clock::time_point, std::weak_ptr<WriteBackStream>> deadlines;
+    // streams of the files closed by the guest with data still to write, their host file is closed once written
+    std::deque<WriteBackStreamPtr> closed;
+    // files staged as a whole, written in order after the closed streams, the ones left are written on exit
+    std::deque<WriteBackCommit> commits;
+    // number of closed streams not written yet, by host path
+    std::unordered_map<std::string, uint32_t> pending_paths;
+    // notified when a closed stream has been written
+    std::condition_variable written_cond;
+
+    WriteBackState() = default;
+    WriteBackState(const WriteBackState &) = delete;
+    WriteBackState &operator=(const WriteBackState &) = delete;
+    ~WriteBackState();
+};
+
+// stages the content of the host file to be written by the write-back thread, reads of the file wait for it
+void stage_write_back_commit(WriteBackState &state, WriteBackCommit commit);
+// copies the content of the last staged commit of the host path, returns false if none is waiting to be written
+bool find_write_back_commit(WriteBackState &state, const std::string &key, std::vector<uint8_t> &data);
+// waits until the closed streams of the host path, or of the paths inside it, have been written, all of them if it is empty
+void wait_write_back(WriteBackState &state, const std::string &path);
+// true if the host path is the given one or inside it
+bool is_write_back_path(const std::string &stream_path, const std::string &path);
 
 // Class for all needed information to access files on Vita3K.
 class FileStats : public VitaStats {
     // Shared file pointer
     FilePtr wrapped_file;
+    // set instead of the file pointer when the file is mapped
+    MappedFileStreamPtr mapped_file;
+    // set instead of the file pointer when the file is read through the read-ahead
+    ReadAheadStreamPtr read_ahead;
+    // set instead of the file pointer for the files of the mounted archives
+    PsarcFileStreamPtr psarc_file;
+    // set instead of the file pointer for the files of an app run from its archive
+    ZipFileStreamPtr zip_file;
+    // set instead of the file pointer when the writes are gathered
+    WriteBackStreamPtr write_back;
+    // held by each operation using the position of the file, so that the positional ones done on the IO workers
+    // never move it under the others, shared by the copies of the handle
+    std::shared_ptr<std::mutex> position_mutex = std::make_shared<std::mutex>();
+
+    SceOff read_impl(void *input_data, int element_size, SceSize element_count) const;
+    SceOff write_impl(const void *data, SceSize size, int count) const;
+    bool seek_impl(SceOff offset, SceIoSeekMode seek_mode) const;
+    SceOff tell_impl() const;
 
 public:
     // Constructor used for files
     // Based on https://codereview.stackexchange.com/questions/4679/
-    explicit FileStats(const char *vita, const std::string &t, const fs::path &file, const int open) {
-        wrapped_file = create_shared_file(file, open);
+    // A file opened without write flags is mapped in memory if map_file is set, the reads are then a single copy.
+    explicit FileStats(const char *vita, const std::string &t, const fs::path &file, const int open, const bool map_file = false) {
+        if (map_file && !can_write(open)) {
+            mapped_file = std::make_shared<MappedFileStream>();
+            // empty files cannot be mapped
+            if (!mapped_file->file.open(file))
+                mapped_file.reset();
+        }
+        if (!mapped_file)
+            wrapped_file = create_shared_file(file, open);
 
         file_info.vita_loc = vita;
         file_info.translated = t;
@@ -43,6 +216,45 @@ public:
         file_info.access_mode = SCE_S_IFREG;
     }
 
+    // Constructor used for the files of the mounted archives
+    FileStats(const char *vita, PsarcFileStreamPtr stream) {
+        file_info.vita_loc = vita;
+        file_info.translated = vita;
+        file_info.sys_loc = stream->archive->path;
+        file_info.open_mode = SCE_O_RDONLY;
+        file_info.file_mode = SCE_SO_IFREG | SCE_SO_IROTH;
+        file_info.access_mode = SCE_S_IFREG;
+        psarc_file = std::move(stream);
+    }
+
+    // Constructor used for the files of an app run from its archive
+    FileStats(const char *vita, const std::string &t, ZipFileStreamPtr stream) {
+        file_info.vita_loc = vita;
+        file_info.translated = t;
+        file_info.sys_loc = stream->archive->path;
+        file_info.open_mode = SCE_O_RDONLY;
+        file_info.file_mode = SCE_SO_IFREG | SCE_SO_IROTH;
+        file_info.access_mode = SCE_S_IFREG;
+        zip_file = std::move(stream);
+    }
+
+    const ZipFileStream *get_zip_file() const {
+        return zip_file.get();
+    }
+
+    const PsarcFileStream *get_psarc_file() const {
+        return psarc_file.get();
+    }
+
+    // only done for the files opened without write flags and not mapped
+    void enable_read_ahead(ReadAheadStats &stats, std::function<void(AsyncIoTask)> schedule);
+    // only done for the files opened with write flags, without SCE_O_APPEND
+    void enable_write_back(WriteBackState &state);
+
+    bool has_write_back() const {
+        return write_back != nullptr;
+    }
+
     bool is_regular_file() const {
         return file_info.file_mode & SCE_SO_IFREG;
     }
@@ -57,7 +269,7 @@ public:
 
     // File operations
     FILE *get_file_pointer() const {
-        return wrapped_file.get();
+        return write_back ? write_back->file.get() : wrapped_file.get();
     }
 
     // File functions
@@ -66,17 +278,28 @@ public:
     int truncate(const SceSize size) const;
     bool seek(SceOff offset, SceIoSeekMode seek_mode) const;
     SceOff tell() const;
+    // read and write at the offset, the position of the file is left where it was, -1 if it cannot be used
+    SceOff pread(void *data, SceSize size, SceOff offset) const;
+    SceOff pwrite(const void *data, SceSize size, SceOff offset) const;
+    // writes the buffered data to the host file, returns false if it could not be written
+    bool sync() const;
+    // called when the guest closes the file: the buffered data is written by the write-back thread,
+    // which closes the host file afterwards
+    void close_write_back() const;
 };
 
+// names of the entries of a host directory, without . and ..
+typedef std::shared_ptr<const std::vector<std::string>> DirListing;
+
 // Class for implementing Directory structure; path names are wide for Windows, normal for else
 class DirStats : public VitaStats {
     // Shared directory pointer
     DirPtr dir_ptr;
+    // used instead of the directory pointer for the directories of the read-only devices
+    DirListing listing;
+    size_t next_entry = 0;
 
-public:
-    DirStats(const char *vita, const std::string &t, const fs::path &file, DirPtr ptr) {
-        dir_ptr = std::move(ptr);
-
+    void init(const char *vita, const std::string &t, const fs::path &file) {
         file_info.vita_loc = vita;
         file_info.translated = t;
         file_info.sys_loc = file;
@@ -85,10 +308,30 @@ public:
         file_info.access_mode = SCE_S_IFDIR | SCE_S_IRUSR;
     }
 
+public:
+    DirStats(const char *vita, const std::string &t, const fs::path &file, DirPtr ptr) {
+        dir_ptr = std::move(ptr);
+        init(vita, t, file);
+    }
+
+    DirStats(const char *vita, const std::string &t, const fs::path &file, DirListing cached_listing) {
+        listing = std::move(cached_listing);
+        init(vita, t, file);
+    }
+
     auto get_dir_ptr() const {
         return get_system_dir_ptr(dir_ptr);
     }
 
+    bool has_listing() const {
+        return listing != nullptr;
+    }
+
+    // returns nullptr once all the entries have been read
+    const std::string *next_listed_entry() {
+        return next_entry < listing->size() ? &(*listing)[next_entry++] : nullptr;
+    }
+
     bool is_directory() const {
         return file_info.file_mode & SCE_SO_IFDIR;
     }
@@ -98,6 +341,30 @@ typedef std::map<SceUID, TtyType> TtyFiles;
 typedef std::map<SceUID, FileStats> StdFiles;
 typedef std::map<SceUID, DirStats> DirEntries;
 
+// metadata of a host file, as given to the guest
+struct FileMetadata {
+    bool exists = false;
+    SceIoStat stat{};
+};
+
+// Metadata of the read-only devices (app0, vs0 and os0): their files cannot change while the app runs,
+// so the host filesystem is only asked the first time they are used.
+struct MetadataCache {
+    std::mutex mutex;
+    // by host path
+    std::unordered_map<std::string, FileMetadata> files;
+    std::unordered_map<std::string, DirListing> dirs;
+
+    // lists the whole app0 tree in the background at launch
+    std::thread prefetch_thread;
+    std::atomic<bool> stop_prefetch = false;
+
+    MetadataCache() = default;
+    MetadataCache(const MetadataCache &) = delete;
+    MetadataCache &operator=(const MetadataCache &) = delete;
+    ~MetadataCache();
+};
+
 struct IOState {
     struct DevicePaths {
         std::string app0;
@@ -120,11 +387,25 @@ struct IOState {
     StdFiles std_files;
     DirEntries dir_entries;
 
-    std::unordered_map<std::string, std::string> cachemap;
+    // listing of the host directories gone through by the case-insensitive lookups, by directory path:
+    // the lowercase name of each entry gives its real name
+    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> case_isens_dirs;
+    std::mutex case_isens_mutex;
     bool case_isens_find_enabled = false;
+    // the metadata cache, the mapping of the read-only files and the read-ahead are skipped when false, to measure them
+    bool caches_enabled = true;
 
     std::mutex overlay_mutex;
     SceUID next_overlay_id = 1;
     // overlay in the order they should be applied
     std::vector<FiosOverlay> overlays;
+
+    MetadataCache metadata_cache;
+    ReadAheadStats read_ahead_stats;
+    FiosState fios;
+    PsarcState psarc;
+    WriteBackState write_back;
+
+    // kept last so that the workers are stopped before the files they use are closed
+    AsyncIoState async_io;
 };
@@ -0,0 +1,97 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <io/types.h>
+#include <util/fs.h>
+#include <util/mapped_file.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ZipEntry {
+    // offset of the data in the archive, past the local header
+    uint64_t data_offset;
+    uint64_t compressed_size;
+    uint64_t size;
+    // stored as is otherwise
+    bool deflated;
+};
+
+typedef std::shared_ptr<const std::vector<uint8_t>> ZipBlock;
+
+// A VPK or ZIP archive used as the folder of an app instead of being extracted.
+// The central directory is read once when it is opened, the stored entries are then copied from the memory mapping
+// of the archive and the deflated ones are inflated on demand into a cache of blocks.
+struct ZipArchive {
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_CACHE_SIZE = 64 * 1024 * 1024;
+
+    fs::path path;
+    MappedFile file;
+    // directory of the archive holding sce_sys/param.sfo, the paths are relative to it
+    std::string root;
+    std::vector<ZipEntry> entries;
+    std::unordered_map<std::string, size_t> files;
+    // used by the case insensitive lookups
+    std::unordered_map<std::string, size_t> lowercase_files;
+    // names of the entries of each directory, by path, the root being ""
+    std::unordered_map<std::string, std::shared_ptr<const std::vector<std::string>>> dirs;
+    std::unordered_map<std::string, std::string> lowercase_dirs;
+
+    // inflated blocks, by entry and block index, most recently used first
+    std::mutex cache_mutex;
+    std::list<std::pair<uint64_t, ZipBlock>> lru;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, ZipBlock>>::iterator> blocks;
+    size_t cache_size = 0;
+};
+
+typedef std::shared_ptr<ZipArchive> ZipArchivePtr;
+
+struct ZipInflater;
+
+// A file of an archive, opened by the guest
+struct ZipFileStream {
+    ZipArchivePtr archive;
+    size_t entry;
+    SceOff pos = 0;
+    // the deflated entries are inflated sequentially, from their start again if a block before is needed
+    std::shared_ptr<ZipInflater> inflater;
+};
+
+typedef std::shared_ptr<ZipFileStream> ZipFileStreamPtr;
+
+// returns nullptr if the archive cannot be read or does not hold an app
+ZipArchivePtr open_zip_archive(const fs::path &path);
+// returns nullptr if the archive does not hold the file
+ZipFileStreamPtr open_zip_file(const ZipArchivePtr &archive, const std::string &path, bool case_insensitive);
+// returns nullptr if the archive does not hold the directory
+std::shared_ptr<const std::vector<std::string>> get_zip_dir(const ZipArchive &archive, const std::string &path, bool case_insensitive);
+// returns the number of bytes read, or -1 if the data could not be inflated
+SceOff read_zip_file(ZipFileStream &stream, void *data, size_t size);
+uint64_t get_zip_file_size(const ZipFileStream &stream);
+
+// the archive is then used for the files of ux0:app/<app_path>, so for app0 when the app runs, until it is unregistered
+void register_app_archive(const std::string &app_path, ZipArchivePtr archive);
+void unregister_app_archive(const std::string &app_path);
+ZipArchivePtr find_app_archive(const std::string &app_path);
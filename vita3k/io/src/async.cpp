@@ -0,0 +1,130 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/async.h>
+
+#include <io/device.h>
+#include <io/io.h>
+#include <io/state.h>
+
+static void run_worker(AsyncIoWorker &worker) {
+    while (true) {
+        const auto task = worker.tasks.pop();
+        if (!task)
+            break;
+        (*task)();
+    }
+}
+
+AsyncIoState::~AsyncIoState() {
+    stop_async_io(*this);
+}
+
+void submit_async_io(AsyncIoState &async_io, VitaIoDevice device, AsyncIoTask task) {
+    const std::lock_guard<std::mutex> lock(async_io.mutex);
+    if (async_io.exiting)
+        return;
+
+    std::unique_ptr<AsyncIoWorker> &worker = async_io.workers[device._to_integral()];
+    if (!worker) {
+        worker = std::make_unique<AsyncIoWorker>();
+        worker->thread = std::thread(run_worker, std::ref(*worker));
+    }
+    worker->tasks.push(std::move(task));
+}
+
+void submit_async_io_op(AsyncIoState &async_io, const SceUID op_id, VitaIoDevice device, AsyncIoRequest request, std::function<void()> on_done) {
+    const AsyncIoOpPtr op = std::make_shared<AsyncIoOp>();
+    {
+        const std::lock_guard<std::mutex> lock(async_io.mutex);
+        async_io.ops.emplace(op_id, op);
+    }
+
+    submit_async_io(async_io, device, [&async_io, op, request = std::move(request), on_done = std::move(on_done)]() {
+        {
+            const std::lock_guard<std::mutex> lock(async_io.mutex);
+            op->started = true;
+        }
+
+        const SceInt64 result = op->cancelled ? SCE_ERROR_ERRNO_ECANCELED : request();
+        {
+            const std::lock_guard<std::mutex> lock(async_io.mutex);
+            op->result = result;
+            op->done = true;
+        }
+        on_done();
+    });
+}
+
+bool is_async_io_op(AsyncIoState &async_io, const SceUID op_id) {
+    const std::lock_guard<std::mutex> lock(async_io.mutex);
+    return async_io.ops.contains(op_id);
+}
+
+bool cancel_async_io_op(AsyncIoState &async_io, const SceUID op_id) {
+    const std::lock_guard<std::mutex> lock(async_io.mutex);
+    const auto op = async_io.ops.find(op_id);
+    if (op == async_io.ops.end() || op->second->started)
+        return false;
+
+    op->second->cancelled = true;
+    return true;
+}
+
+bool take_async_io_result(AsyncIoState &async_io, const SceUID op_id, SceInt64 &result) {
+    const std::lock_guard<std::mutex> lock(async_io.mutex);
+    const auto op = async_io.ops.find(op_id);
+    if (op == async_io.ops.end() || !op->second->done)
+        return false;
+
+    result = op->second->result;
+    async_io.ops.erase(op);
+    return true;
+}
+
+VitaIoDevice get_fd_device(const IOState &io, const SceUID fd) {
+    const auto file = io.std_files.find(fd);
+    if (file != io.std_files.end())
+        return device::get_device(file->second.get_vita_loc());
+
+    const auto dir = io.dir_entries.find(fd);
+    if (dir != io.dir_entries.end())
+        return device::get_device(dir->second.get_vita_loc());
+
+    const auto tty_file = io.tty_files.find(fd);
+    if (tty_file != io.tty_files.end())
+        return VitaIoDevice::tty0;
+
+    return VitaIoDevice::_INVALID;
+}
+
+void stop_async_io(AsyncIoState &async_io) {
+    // the tasks lock the mutex, it must not be held while joining the workers
+    std::map<int, std::unique_ptr<AsyncIoWorker>> workers;
+    {
+        const std::lock_guard<std::mutex> lock(async_io.mutex);
+        async_io.exiting = true;
+        workers.swap(async_io.workers);
+    }
+
+    for (auto &[device, worker] : workers)
+        worker->tasks.abort();
+    for (auto &[device, worker] : workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
@@ -0,0 +1,395 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/fios.h>
+
+#include <io/functions.h>
+#include <io/state.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+// the reads merged together are read in a temporary buffer, up to this size
+constexpr SceInt64 MAX_MERGED_READ_SIZE = 4 * 1024 * 1024;
+
+SceInt64 FiosOp::requested_size() const {
+    return std::accumulate(buffers.begin(), buffers.end(), SceInt64(0), [](SceInt64 size, const FiosIoVec &buffer) {
+        return size + buffer.size;
+    });
+}
+
+SceInt64 fios_time_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static SceInt64 pread_fios_file(IOState &io, const SceUID fd, uint8_t *data, const SceOff offset, const SceInt64 size, const char *export_name) {
+    const SceOff pos = seek_file(fd, offset, SCE_SEEK_SET, io, export_name);
+    if (pos < 0)
+        return pos;
+    return read_file(data, io, fd, static_cast<SceSize>(size), export_name);
+}
+
+// the cache mutex must be held
+static void add_cache_block(FiosCache &cache, const std::string &path, const SceOff index, std::vector<uint8_t> data) {
+    while (!cache.lru.empty() && cache.size + data.size() > FiosCache::MAX_SIZE) {
+        const auto block = cache.blocks.find(cache.lru.back());
+        cache.size -= block->second.data.size();
+        cache.blocks.erase(block);
+        cache.lru.pop_back();
+    }
+
+    cache.lru.emplace_front(path, index);
+    cache.size += data.size();
+    cache.blocks.emplace(cache.lru.front(), FiosCacheBlock{ std::move(data), cache.lru.begin() });
+}
+
+// the blocks of the range in the cache are copied from it, the others are read from the file
+static SceInt64 read_fios_range(IOState &io, const SceUID fd, const std::string &path, const SceOff offset, uint8_t *data, const SceInt64 size, const char *export_name) {
+    FiosState &fios = io.fios;
+    SceInt64 read_size = 0;
+    while (read_size < size) {
+        const SceOff pos = offset + read_size;
+        const SceOff index = pos / FiosCache::BLOCK_SIZE;
+        const SceOff block_offset = pos % FiosCache::BLOCK_SIZE;
+
+        SceInt64 host_size;
+        {
+            const std::lock_guard<std::mutex> lock(fios.cache_mutex);
+            FiosCache &cache = fios.cache;
+            const auto block = cache.blocks.find({ path, index });
+            if (block != cache.blocks.end()) {
+                cache.lru.splice(cache.lru.begin(), cache.lru, block->second.lru);
+
+                // only the last block of the file is not full
+                const std::vector<uint8_t> &block_data = block->second.data;
+                if (block_offset >= static_cast<SceOff>(block_data.size()))
+                    break;
+                const SceInt64 copy_size = std::min<SceInt64>(size - read_size, block_data.size() - block_offset);
+                memcpy(data + read_size, block_data.data() + block_offset, copy_size);
+                read_size += copy_size;
+                if (block_data.size() < FiosCache::BLOCK_SIZE && block_offset + copy_size == static_cast<SceOff>(block_data.size()))
+                    break;
+                continue;
+            }
+
+            // the following blocks not in the cache are read at the same time
+            const SceOff last_index = (offset + size - 1) / FiosCache::BLOCK_SIZE;
+            SceOff next_index = index + 1;
+            while (next_index <= last_index && !cache.blocks.contains({ path, next_index }))
+                next_index++;
+            host_size = std::min<SceInt64>(size - read_size, next_index * FiosCache::BLOCK_SIZE - pos);
+        }
+
+        const SceInt64 host_read = pread_fios_file(io, fd, data + read_size, pos, host_size, export_name);
+        if (host_read < 0)
+            return read_size > 0 ? read_size : host_read;
+        read_size += host_read;
+        if (host_read < host_size)
+            break;
+    }
+
+    return read_size;
+}
+
+static void complete_fios_op(FiosState &fios, FiosOp &op, const SceInt64 result) {
+    const std::lock_guard<std::mutex> lock(fios.mutex);
+    op.result = result;
+    op.done = true;
+    op.done_cond.notify_all();
+}
+
+static void read_fios_ops(IOState &io, const std::vector<FiosOpPtr> &ops) {
+    const FiosOp &first = *ops.front();
+    if (ops.size() == 1 && first.buffers.size() == 1) {
+        const FiosIoVec &buffer = first.buffers.front();
+        complete_fios_op(io.fios, *ops.front(), read_fios_range(io, first.fd, first.path, first.offset, buffer.data, buffer.size, first.export_name));
+        return;
+    }
+
+    // the reads follow each other, they are read at once and copied to their buffers
+    const SceInt64 size = std::accumulate(ops.begin(), ops.end(), SceInt64(0), [](SceInt64 size, const FiosOpPtr &op) {
+        return size + op->requested_size();
+    });
+    std::vector<uint8_t> data(size);
+    const SceInt64 read_size = read_fios_range(io, first.fd, first.path, first.offset, data.data(), size, first.export_name);
+
+    for (const FiosOpPtr &op : ops) {
+        if (read_size < 0) {
+            complete_fios_op(io.fios, *op, read_size);
+            continue;
+        }
+
+        const SceInt64 op_start = op->offset - first.offset;
+        const SceInt64 op_size = std::clamp<SceInt64>(read_size - op_start, 0, op->requested_size());
+        SceInt64 copied = 0;
+        for (const FiosIoVec &buffer : op->buffers) {
+            const SceInt64 copy_size = std::min<SceInt64>(buffer.size, op_size - copied);
+            if (copy_size <= 0)
+                break;
+            memcpy(buffer.data, data.data() + op_start + copied, copy_size);
+            copied += copy_size;
+        }
+        complete_fios_op(io.fios, *op, op_size);
+    }
+}
+
+static bool is_more_urgent(const FiosOpPtr &op, const FiosOpPtr &other) {
+    if (op->priority != other->priority)
+        return op->priority > other->priority;
+
+    // the operations without deadline are done last
+    const SceInt64 deadline = op->deadline == SCE_FIOS_TIME_NULL ? std::numeric_limits<SceInt64>::max() : op->deadline;
+    const SceInt64 other_deadline = other->deadline == SCE_FIOS_TIME_NULL ? std::numeric_limits<SceInt64>::max() : other->deadline;
+    if (deadline != other_deadline)
+        return deadline < other_deadline;
+
+    return op->order < other->order;
+}
+
+static void run_next_fios_op(IOState &io, const int device) {
+    FiosState &fios = io.fios;
+    std::vector<FiosOpPtr> ops;
+    {
+        const std::lock_guard<std::mutex> lock(fios.mutex);
+        std::vector<FiosOpPtr> &queue = fios.pending[device];
+        // the operation this task was submitted for has been merged with another one or cancelled
+        if (queue.empty())
+            return;
+
+        const auto op = std::min_element(queue.begin(), queue.end(), is_more_urgent);
+        ops.push_back(*op);
+        queue.erase(op);
+
+        // the reads of the same file starting where it ends are done with it, whatever their priority
+        if (ops.front()->is_read()) {
+            const SceUID fd = ops.front()->fd;
+            SceInt64 size = ops.front()->requested_size();
+            SceOff end = ops.front()->offset + size;
+            while (size < MAX_MERGED_READ_SIZE) {
+                const auto next = std::find_if(queue.begin(), queue.end(), [&](const FiosOpPtr &op) {
+                    return op->is_read() && op->fd == fd && op->offset == end;
+                });
+                if (next == queue.end())
+                    break;
+
+                size += (*next)->requested_size();
+                end += (*next)->requested_size();
+                ops.push_back(*next);
+                queue.erase(next);
+            }
+        }
+
+        for (const FiosOpPtr &op : ops)
+            op->started = true;
+    }
+
+    if (ops.front()->is_read())
+        read_fios_ops(io, ops);
+    else
+        complete_fios_op(fios, *ops.front(), ops.front()->request());
+}
+
+SceUID submit_fios_op(IOState &io, VitaIoDevice device, FiosOpPtr op) {
+    FiosState &fios = io.fios;
+    SceUID op_id;
+    {
+        const std::lock_guard<std::mutex> lock(fios.mutex);
+        op_id = fios.next_id++;
+        op->id = op_id;
+        op->order = fios.next_order++;
+        fios.pending[device._to_integral()].push_back(op);
+        fios.ops.emplace(op_id, std::move(op));
+    }
+
+    // the task does the most urgent operation of the device, not necessarily this one
+    submit_async_io(io.async_io, device, [&io, device = device._to_integral()]() {
+        run_next_fios_op(io, device);
+    });
+
+    return op_id;
+}
+
+FiosOpPtr get_fios_op(FiosState &fios, const SceUID op_id) {
+    const std::lock_guard<std::mutex> lock(fios.mutex);
+    const auto op = fios.ops.find(op_id);
+    return op != fios.ops.end() ? op->second : nullptr;
+}
+
+bool wait_fios_op(FiosState &fios, FiosOp &op, const SceInt64 deadline) {
+    std::unique_lock<std::mutex> lock(fios.mutex);
+    if (deadline == SCE_FIOS_TIME_NULL) {
+        op.done_cond.wait(lock, [&] { return op.done; });
+        return true;
+    }
+
+    const std::chrono::steady_clock::time_point wait_end{ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline)) };
+    return op.done_cond.wait_until(lock, wait_end, [&] { return op.done; });
+}
+
+// the mutex must be held
+static bool remove_pending_op(FiosState &fios, const FiosOpPtr &op) {
+    for (auto &[device, queue] : fios.pending) {
+        const auto pending_op = std::find(queue.begin(), queue.end(), op);
+        if (pending_op != queue.end()) {
+            queue.erase(pending_op);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// the mutex must be held
+static void set_cancelled(FiosOp &op) {
+    op.cancelled = true;
+    op.result = SCE_FIOS_ERROR_CANCELLED;
+    op.done = true;
+    op.done_cond.notify_all();
+}
+
+bool cancel_fios_op(FiosState &fios, const SceUID op_id) {
+    const std::lock_guard<std::mutex> lock(fios.mutex);
+    const auto op = fios.ops.find(op_id);
+    if (op == fios.ops.end() || op->second->started || op->second->done)
+        return false;
+
+    remove_pending_op(fios, op->second);
+    set_cancelled(*op->second);
+    return true;
+}
+
+void delete_fios_op(FiosState &fios, const SceUID op_id) {
+    const std::lock_guard<std::mutex> lock(fios.mutex);
+    const auto op = fios.ops.find(op_id);
+    if (op == fios.ops.end())
+        return;
+
+    // an operation deleted before being started is not done
+    if (!op->second->started && remove_pending_op(fios, op->second))
+        set_cancelled(*op->second);
+    fios.ops.erase(op);
+}
+
+bool reschedule_fios_op(FiosState &fios, const SceUID op_id, const SceInt64 deadline, const int8_t priority) {
+    const std::lock_guard<std::mutex> lock(fios.mutex);
+    const auto op = fios.ops.find(op_id);
+    if (op == fios.ops.end() || op->second->started)
+        return false;
+
+    // the pending operations are sorted when the next one is taken
+    op->second->deadline = deadline;
+    op->second->priority = priority;
+    return true;
+}
+
+int cancel_all_fios_ops(FiosState &fios) {
+    const std::lock_guard<std::mutex> lock(fios.mutex);
+    int count = 0;
+    for (auto &[device, queue] : fios.pending) {
+        for (const FiosOpPtr &op : queue)
+            set_cancelled(*op);
+        count += static_cast<int>(queue.size());
+        queue.clear();
+    }
+
+    return count;
+}
+
+bool is_fios_idle(FiosState &fios) {
+    const std::lock_guard<std::mutex> lock(fios.mutex);
+    return std::none_of(fios.ops.begin(), fios.ops.end(), [](const auto &op) {
+        return !op.second->done;
+    });
+}
+
+SceInt64 prefetch_fios_file(IOState &io, const SceUID fd, const std::string &path, const SceOff offset, const SceInt64 length, const char *export_name) {
+    FiosState &fios = io.fios;
+    SceInt64 cached_size = 0;
+    for (SceOff index = offset / FiosCache::BLOCK_SIZE; length < 0 || index * FiosCache::BLOCK_SIZE < offset + length; index++) {
+        SceOff block_size = -1;
+        {
+            const std::lock_guard<std::mutex> lock(fios.cache_mutex);
+            const auto block = fios.cache.blocks.find({ path, index });
+            if (block != fios.cache.blocks.end()) {
+                fios.cache.lru.splice(fios.cache.lru.begin(), fios.cache.lru, block->second.lru);
+                block_size = block->second.data.size();
+            }
+        }
+
+        if (block_size < 0) {
+            std::vector<uint8_t> data(FiosCache::BLOCK_SIZE);
+            block_size = pread_fios_file(io, fd, data.data(), index * FiosCache::BLOCK_SIZE, FiosCache::BLOCK_SIZE, export_name);
+            if (block_size < 0)
+                return block_size;
+
+            if (block_size > 0) {
+                data.resize(block_size);
+                const std::lock_guard<std::mutex> lock(fios.cache_mutex);
+                add_cache_block(fios.cache, path, index, std::move(data));
+            }
+        }
+
+        const SceOff block_start = index * FiosCache::BLOCK_SIZE;
+        const SceOff start = std::max(offset, block_start);
+        const SceOff end = length < 0 ? block_start + block_size : std::min(offset + length, block_start + block_size);
+        if (end > start)
+            cached_size += end - start;
+
+        // end of the file
+        if (block_size < FiosCache::BLOCK_SIZE)
+            break;
+    }
+
+    return cached_size;
+}
+
+bool fios_cache_contains(FiosState &fios, const std::string &path, const SceOff offset, const SceInt64 length) {
+    const std::lock_guard<std::mutex> lock(fios.cache_mutex);
+    for (SceOff index = offset / FiosCache::BLOCK_SIZE; length < 0 || index * FiosCache::BLOCK_SIZE < offset + length; index++) {
+        const auto block = fios.cache.blocks.find({ path, index });
+        if (block == fios.cache.blocks.end())
+            return false;
+
+        // the rest of the range is past the end of the file
+        if (block->second.data.size() < FiosCache::BLOCK_SIZE)
+            break;
+    }
+
+    return true;
+}
+
+void flush_fios_cache(FiosState &fios, const std::string &path, const SceOff offset, const SceInt64 length) {
+    const std::lock_guard<std::mutex> lock(fios.cache_mutex);
+    FiosCache &cache = fios.cache;
+    if (path.empty()) {
+        cache.blocks.clear();
+        cache.lru.clear();
+        cache.size = 0;
+        return;
+    }
+
+    auto block = cache.blocks.lower_bound({ path, offset / FiosCache::BLOCK_SIZE });
+    while (block != cache.blocks.end() && block->first.first == path
+        && (length < 0 || block->first.second * FiosCache::BLOCK_SIZE < offset + length)) {
+        cache.size -= block->second.data.size();
+        cache.lru.erase(block->second.lru);
+        block = cache.blocks.erase(block);
+    }
+}
@@ -18,6 +18,7 @@
 #include <io/device.h>
 #include <io/functions.h>
 #include <io/io.h>
+#include <io/io_trace.h>
 #include <io/state.h>
 #include <io/types.h>
 #include <io/util.h>
@@ -27,6 +28,7 @@
 #include <util/log.h>
 #include <util/preprocessor.h>
 #include <util/string_utils.h>
+#include <util/trace_log.h>
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -37,6 +39,7 @@
 #endif
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <string>
@@ -62,9 +65,32 @@ constexpr bool log_file_read = false;
 constexpr bool log_file_seek = false;
 constexpr bool log_file_stat = false;
 
+// the files of ux0:app/<app_path> are in the archive of the app if it is run from it, archive_path is then set to their path in it
+static ZipArchivePtr find_app_archive_path(const VitaIoDevice device, const std::string &translated_path, std::string &archive_path) {
+    const std::string app_dir = "app/";
+    if (device != VitaIoDevice::ux0 || !translated_path.starts_with(app_dir))
+        return nullptr;
+
+    const size_t separator = translated_path.find('/', app_dir.size());
+    ZipArchivePtr archive = find_app_archive(translated_path.substr(app_dir.size(), separator - app_dir.size()));
+    if (archive)
+        archive_path = separator == std::string::npos ? "" : translated_path.substr(separator + 1);
+    return archive;
+}
+
 namespace vfs {
 
 bool read_file(const VitaIoDevice device, FileBuffer &buf, const std::wstring &pref_path, const fs::path &vfs_file_path) {
+    std::string archive_path;
+    if (const ZipArchivePtr archive = find_app_archive_path(device, vfs_file_path.generic_path().string(), archive_path)) {
+        const ZipFileStreamPtr stream = open_zip_file(archive, archive_path, false);
+        if (!stream)
+            return false;
+
+        buf.resize(get_zip_file_size(*stream));
+        return read_zip_file(*stream, buf.data(), buf.size()) == static_cast<SceOff>(buf.size());
+    }
+
     const auto host_file_path = device::construct_emulated_path(device, vfs_file_path, pref_path).generic_path();
 
     fs::ifstream f{ host_file_path, fs::ifstream::binary };
@@ -175,43 +201,256 @@ bool init_savedata_app_path(IOState &io, const fs::path &pref_path) {
     return true;
 }
 
-bool find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &translated_path, const fs::path &system_path) {
-    std::string final_path{};
+static std::string host_path_key(const fs::path &dir) {
+    return fs::path(dir).remove_trailing_separator().lexically_normal().string();
+}
 
-    switch (device) {
-    case +VitaIoDevice::app0: {
-        std::string app_id = translated_path.string().substr(0, 14);
-        final_path = system_path.string().substr(0, system_path.string().find(app_id)) + app_id;
-        break;
+// returns the real name of the entry of dir matching name, the entries of dir are only listed the first time
+static std::string find_case_isens_entry(IOState &io, const fs::path &dir, const std::string &name) {
+    const std::lock_guard<std::mutex> lock(io.case_isens_mutex);
+    auto listing = io.case_isens_dirs.find(host_path_key(dir));
+    if (listing == io.case_isens_dirs.end()) {
+        std::unordered_map<std::string, std::string> entries;
+        boost::system::error_code error_code{};
+        for (fs::directory_iterator it(dir, error_code), end; !error_code && it != end; it.increment(error_code)) {
+            const std::string entry_name = it->path().filename().string();
+            entries.emplace(string_utils::tolower(entry_name), entry_name);
+        }
+        listing = io.case_isens_dirs.emplace(host_path_key(dir), std::move(entries)).first;
     }
-    case +VitaIoDevice::addcont0: {
-        std::string addcont_id = translated_path.string().substr(0, 18);
-        final_path = system_path.string().substr(0, system_path.string().find(addcont_id)) + addcont_id;
-        break;
+
+    const auto entry = listing->second.find(string_utils::tolower(name));
+    return entry != listing->second.end() ? entry->second : std::string{};
+}
+
+fs::path find_case_isens_path(IOState &io, const fs::path &system_path) {
+    // only the directories of the path whose case does not match are listed
+    fs::path found_path = system_path.root_path();
+    for (const auto &component : system_path.relative_path()) {
+        if (component.empty() || component.filename_is_dot())
+            continue;
+
+        fs::path next_path = found_path / component;
+        if (!fs::exists(next_path)) {
+            const std::string entry_name = find_case_isens_entry(io, found_path, component.string());
+            if (entry_name.empty())
+                return fs::path{};
+            next_path = found_path / entry_name;
+        }
+        found_path = std::move(next_path);
     }
-    default: {
-        return false;
+
+    return found_path;
+}
+
+void invalidate_case_isens_path(IOState &io, const fs::path &path) {
+    const std::lock_guard<std::mutex> lock(io.case_isens_mutex);
+    if (io.case_isens_dirs.empty())
+        return;
+
+    const std::string key = host_path_key(path);
+    io.case_isens_dirs.erase(host_path_key(fs::path(key).parent_path()));
+
+    // a removed or renamed directory takes its subdirectories with it
+    const std::string subdir_prefix = key + static_cast<char>(fs::path::preferred_separator);
+    for (auto it = io.case_isens_dirs.begin(); it != io.case_isens_dirs.end();) {
+        if (it->first == key || it->first.starts_with(subdir_prefix))
+            it = io.case_isens_dirs.erase(it);
+        else
+            ++it;
+    }
+}
+
+static bool is_read_only_device(const VitaIoDevice device) {
+    return device == VitaIoDevice::app0 || device == VitaIoDevice::vs0 || device == VitaIoDevice::os0;
+}
+
+static bool can_cache_metadata(const IOState &io, const VitaIoDevice device) {
+    return io.caches_enabled && is_read_only_device(device);
+}
+
+static FileMetadata read_file_metadata(const fs::path &path) {
+    FileMetadata metadata;
+
+#ifdef _WIN32
+    struct _stati64 sb;
+    if (_wstati64(path.generic_path().wstring().c_str(), &sb) < 0)
+        return metadata;
+#else
+    struct stat64 sb;
+    if (stat64(path.generic_path().string().c_str(), &sb) < 0)
+        return metadata;
+#endif
+    metadata.exists = true;
+
+    const std::uint64_t last_access_time_ticks = (uint64_t)sb.st_atime * VITA_CLOCKS_PER_SEC;
+    const std::uint64_t creation_time_ticks = (uint64_t)sb.st_ctime * VITA_CLOCKS_PER_SEC;
+    const std::uint64_t last_modification_time_ticks = (uint64_t)sb.st_mtime * VITA_CLOCKS_PER_SEC;
+
+#ifndef WIN32
+#undef st_atime
+#undef st_mtime
+#undef st_ctime
+#endif
+
+    SceIoStat &stat = metadata.stat;
+    stat.st_mode = SCE_S_IRUSR | SCE_S_IRGRP | SCE_S_IROTH | SCE_S_IXUSR | SCE_S_IXGRP | SCE_S_IXOTH;
+
+    if ((sb.st_mode & S_IFMT) == S_IFREG) {
+        stat.st_size = sb.st_size;
+        stat.st_attr = SCE_SO_IFREG;
+        stat.st_mode |= SCE_S_IFREG;
     }
+    if ((sb.st_mode & S_IFMT) == S_IFDIR) {
+        stat.st_attr = SCE_SO_IFDIR;
+        stat.st_mode |= SCE_S_IFDIR;
     }
 
-    if (!fs::exists(final_path))
-        return false;
+    __RtcTicksToPspTime(&stat.st_atime, last_access_time_ticks);
+    __RtcTicksToPspTime(&stat.st_mtime, last_modification_time_ticks);
+    __RtcTicksToPspTime(&stat.st_ctime, creation_time_ticks);
 
-    for (const auto &file : fs::recursive_directory_iterator(final_path)) {
-        io.cachemap.insert(std::make_pair(string_utils::tolower(file.path().string()), file.path().string()));
+    return metadata;
+}
+
+static FileMetadata get_file_metadata(MetadataCache &cache, const fs::path &path, const bool use_cache) {
+    if (!use_cache)
+        return read_file_metadata(path);
+
+    const std::string key = host_path_key(path);
+    {
+        const std::lock_guard<std::mutex> lock(cache.mutex);
+        const auto cached = cache.files.find(key);
+        if (cached != cache.files.end())
+            return cached->second;
     }
 
-    return true;
+    // the host is not asked with the mutex held, the prefetch thread may be using it
+    const FileMetadata metadata = read_file_metadata(path);
+    const std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.files.emplace(key, metadata);
+    return metadata;
 }
 
-fs::path find_in_cache(IOState &io, const std::string &system_path) {
-    const auto find_path = io.cachemap.find(system_path);
+// the files of the archives have the times of the archive and cannot be written
+static FileMetadata get_archive_file_metadata(const fs::path &archive_path, const uint64_t size) {
+    FileMetadata metadata = read_file_metadata(archive_path);
+    metadata.stat.st_size = size;
+    metadata.stat.st_attr = SCE_SO_IFREG;
+    metadata.stat.st_mode = SCE_S_IFREG | SCE_S_IRUSR | SCE_S_IRGRP | SCE_S_IROTH;
+    return metadata;
+}
 
-    if (find_path != io.cachemap.end()) {
-        return fs::path{ find_path->second.c_str() };
-    } else {
-        return fs::path{};
+static FileMetadata get_zip_metadata(const ZipArchivePtr &archive, const std::string &path, const bool case_insensitive) {
+    if (const ZipFileStreamPtr stream = open_zip_file(archive, path, case_insensitive))
+        return get_archive_file_metadata(archive->path, get_zip_file_size(*stream));
+    if (!get_zip_dir(*archive, path, case_insensitive))
+        return {};
+
+    FileMetadata metadata = read_file_metadata(archive->path);
+    metadata.stat.st_size = 0;
+    metadata.stat.st_attr = SCE_SO_IFDIR;
+    metadata.stat.st_mode = SCE_S_IFDIR | SCE_S_IRUSR | SCE_S_IRGRP | SCE_S_IROTH | SCE_S_IXUSR | SCE_S_IXGRP | SCE_S_IXOTH;
+    return metadata;
+}
+
+static DirListing get_dir_listing(MetadataCache &cache, const fs::path &dir) {
+    const std::string key = host_path_key(dir);
+    {
+        const std::lock_guard<std::mutex> lock(cache.mutex);
+        const auto cached = cache.dirs.find(key);
+        if (cached != cache.dirs.end())
+            return cached->second;
+    }
+
+    auto entries = std::make_shared<std::vector<std::string>>();
+    boost::system::error_code error_code{};
+    for (fs::directory_iterator it(dir, error_code), end; !error_code && it != end; it.increment(error_code))
+        entries->push_back(it->path().filename().string());
+
+    const std::lock_guard<std::mutex> lock(cache.mutex);
+    return cache.dirs.emplace(key, std::move(entries)).first->second;
+}
+
+static void forget_metadata(MetadataCache &cache, const fs::path &path) {
+    const std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.files.empty() && cache.dirs.empty())
+        return;
+
+    const std::string key = host_path_key(path);
+    cache.dirs.erase(host_path_key(fs::path(key).parent_path()));
+
+    const std::string subdir_prefix = key + static_cast<char>(fs::path::preferred_separator);
+    const auto is_changed = [&](const std::string &entry_key) {
+        return entry_key == key || entry_key.starts_with(subdir_prefix);
+    };
+    std::erase_if(cache.files, [&](const auto &entry) { return is_changed(entry.first); });
+    std::erase_if(cache.dirs, [&](const auto &entry) { return is_changed(entry.first); });
+}
+
+// to be called once path has been created, removed or renamed
+static void on_path_changed(IOState &io, const fs::path &path) {
+    invalidate_case_isens_path(io, path);
+    forget_metadata(io.metadata_cache, path);
+}
+
+// the data gathered for the host path, or for the paths inside it, is written before it is used through another handle
+static void write_back_path(IOState &io, const fs::path &path) {
+    const std::string key = path.generic_path().string();
+    for (const auto &[fd, file] : io.std_files) {
+        if (file.has_write_back() && is_write_back_path(file.get_system_location().generic_path().string(), key))
+            file.sync();
+    }
+    wait_write_back(io.write_back, key);
+}
+
+static void prefetch_metadata(MetadataCache &cache, const fs::path &root) {
+    std::vector<fs::path> dirs{ root };
+    while (!dirs.empty() && !cache.stop_prefetch) {
+        const fs::path dir = std::move(dirs.back());
+        dirs.pop_back();
+
+        const DirListing listing = get_dir_listing(cache, dir);
+        for (const std::string &name : *listing) {
+            if (cache.stop_prefetch)
+                return;
+
+            const fs::path entry_path = dir / name;
+            const FileMetadata metadata = get_file_metadata(cache, entry_path, true);
+            if (metadata.stat.st_attr & SCE_SO_IFDIR)
+                dirs.push_back(entry_path);
+        }
+    }
+}
+
+MetadataCache::~MetadataCache() {
+    stop_prefetch = true;
+    if (prefetch_thread.joinable())
+        prefetch_thread.join();
+}
+
+void prefetch_app_metadata(IOState &io, const std::wstring &pref_path) {
+    MetadataCache &cache = io.metadata_cache;
+    if (cache.prefetch_thread.joinable()) {
+        cache.stop_prefetch = true;
+        cache.prefetch_thread.join();
+    }
+
+    VitaIoDevice device = VitaIoDevice::app0;
+    const auto translated_path = translate_path("app0:", device, io.device_paths);
+    const fs::path app_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
+
+    {
+        // another app may have been run before
+        const std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.files.clear();
+        cache.dirs.clear();
     }
+    // the files of an app run from its archive are already indexed
+    if (find_app_archive(io.app_path))
+        return;
+    cache.stop_prefetch = false;
+    cache.prefetch_thread = std::thread(prefetch_metadata, std::ref(cache), app_path);
 }
 
 std::string translate_path(const char *path, VitaIoDevice &device, const IOState::DevicePaths &device_paths) {
@@ -286,9 +525,21 @@ std::string expand_path(IOState &io, const char *path, const std::wstring &pref_
     return device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio).string();
 }
 
-SceUID open_file(IOState &io, const char *path, const int flags, const std::wstring &pref_path, const char *export_name) {
+static SceUID open_file_impl(IOState &io, const char *path, const int flags, const std::wstring &pref_path, const char *export_name) {
+    if (PsarcFileStreamPtr stream = open_psarc_file(io.psarc, path)) {
+        if (can_write(flags)) {
+            LOG_ERROR("Cannot open file {} of a mounted archive for writing", path);
+            return IO_ERROR(SCE_ERROR_ERRNO_EROFS);
+        }
+
+        const auto fd = io.next_fd++;
+        io.std_files.emplace(fd, FileStats{ path, std::move(stream) });
+
+        LOG_TRACE_IF(log_file_op, "{}: Opening file {} of a mounted archive, fd: {}", export_name, path, log_hex(fd));
+        return fd;
+    }
+
     auto device = device::get_device(path);
-    auto device_for_icase = device;
     if (device == VitaIoDevice::_INVALID) {
         LOG_ERROR("Cannot find device for path: {}", path);
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
@@ -310,38 +561,58 @@ SceUID open_file(IOState &io, const char *path, const int flags, const std::wstr
         return fd;
     }
 
+    const bool read_only_device = is_read_only_device(device);
     const auto translated_path = translate_path(path, device, io.device_paths);
     if (translated_path.empty()) {
         LOG_ERROR("Cannot translate path: {}", path);
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
 
+    std::string archive_path;
+    if (const ZipArchivePtr archive = find_app_archive_path(device, translated_path, archive_path)) {
+        if (can_write(flags)) {
+            LOG_ERROR("Cannot open file {} of an app run from its archive for writing", path);
+            return IO_ERROR(SCE_ERROR_ERRNO_EROFS);
+        }
+
+        ZipFileStreamPtr stream = open_zip_file(archive, archive_path, io.case_isens_find_enabled);
+        if (!stream) {
+            LOG_ERROR("Missing file {} in archive {} (target path: {})", archive_path, archive->path.string(), path);
+            return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+        }
+
+        const auto normalized_path = device::construct_normalized_path(device, translated_path);
+        const auto fd = io.next_fd++;
+        io.std_files.emplace(fd, FileStats{ path, normalized_path, std::move(stream) });
+
+        LOG_TRACE_IF(log_file_op, "{}: Opening file {} ({}) of the app archive, fd: {}", export_name, path, normalized_path, log_hex(fd));
+        return fd;
+    }
+
     auto system_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
-    if (fs::is_directory(system_path)) {
+    // a file written on a read-only device is no longer taken from the cache
+    if (read_only_device && can_write(flags))
+        forget_metadata(io.metadata_cache, system_path);
+    if (!read_only_device)
+        write_back_path(io, system_path);
+    const FileMetadata metadata = get_file_metadata(io.metadata_cache, system_path, can_cache_metadata(io, device) && !can_write(flags));
+    if (metadata.stat.st_attr & SCE_SO_IFDIR) {
         LOG_ERROR("Cannot open directory: {}", system_path.string(), path);
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
 
     // Do not allow any new files if they do not have a write flag.
-    if (!fs::exists(system_path)) {
+    if (!metadata.exists) {
         if (!(flags & SCE_O_CREAT)) {
             if (io.case_isens_find_enabled) {
                 // Attempt a case-insensitive file search.
-                const auto original_system_path = system_path;
-                const auto cached_path = find_in_cache(io, string_utils::tolower(system_path.string()));
-                if (!cached_path.empty()) {
-                    system_path = cached_path;
-                    LOG_TRACE("Found cached filepath at {}", system_path.string());
-                } else {
-                    const bool path_found = find_case_isens_path(io, device_for_icase, translated_path, system_path);
-                    system_path = find_in_cache(io, string_utils::tolower(system_path.string()));
-                    if (!system_path.empty() && path_found) {
-                        LOG_TRACE("Found file on case-sensitive filesystem at {}", system_path.string());
-                    } else {
-                        LOG_ERROR("Missing file at {} (target path: {})", original_system_path.string(), path);
-                        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
-                    }
+                const auto found_path = find_case_isens_path(io, system_path);
+                if (found_path.empty()) {
+                    LOG_ERROR("Missing file at {} (target path: {})", system_path.string(), path);
+                    return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
                 }
+                system_path = found_path;
+                LOG_TRACE("Found file on case-sensitive filesystem at {}", system_path.string());
             } else {
                 LOG_ERROR("Missing file at {} (target path: {})", system_path.string(), path);
                 return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
@@ -349,14 +620,23 @@ SceUID open_file(IOState &io, const char *path, const int flags, const std::wstr
         } else {
             if (!fs::exists(system_path.parent_path())) {
                 fs::create_directories(system_path.parent_path());
+                on_path_changed(io, system_path.parent_path());
             }
             std::ofstream file(system_path.string());
+            on_path_changed(io, system_path);
         }
     }
 
     const auto normalized_path = device::construct_normalized_path(device, translated_path);
 
-    FileStats f{ path, normalized_path, system_path, flags };
+    FileStats f{ path, normalized_path, system_path, flags, read_only_device && io.caches_enabled };
+    if (io.caches_enabled) {
+        f.enable_read_ahead(io.read_ahead_stats, [&async_io = io.async_io, device](AsyncIoTask task) {
+            submit_async_io(async_io, device, std::move(task));
+        });
+    }
+    if (!read_only_device)
+        f.enable_write_back(io.write_back);
     const auto fd = io.next_fd++;
     io.std_files.emplace(fd, f);
 
@@ -364,13 +644,20 @@ SceUID open_file(IOState &io, const char *path, const int flags, const std::wstr
     return fd;
 }
 
-int read_file(void *data, IOState &io, const SceUID fd, const SceSize size, const char *export_name) {
+SceUID open_file(IOState &io, const char *path, const int flags, const std::wstring &pref_path, const char *export_name) {
+    const SceUID fd = open_file_impl(io, path, flags, pref_path, export_name);
+    IO_TRACE(IoTraceOp::OpenFile, invalid_fd, path, flags, 0, fd);
+    return fd;
+}
+
+static int read_file_impl(void *data, IOState &io, const SceUID fd, const SceSize size, const char *export_name) {
     assert(data != nullptr);
     assert(size >= 0);
 
     const auto file = io.std_files.find(fd);
     if (file != io.std_files.end()) {
         const auto read = file->second.read(data, 1, size);
+        TRACE_EVENT(TraceEvent::FileRead, fd, size, read);
         LOG_TRACE_IF(log_file_op && log_file_read, "{}: Reading {} bytes of fd {}", export_name, read, log_hex(fd));
         return static_cast<int>(read);
     }
@@ -388,6 +675,12 @@ int read_file(void *data, IOState &io, const SceUID fd, const SceSize size, cons
     return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
 }
 
+int read_file(void *data, IOState &io, const SceUID fd, const SceSize size, const char *export_name) {
+    const int read = read_file_impl(data, io, fd, size, export_name);
+    IO_TRACE(IoTraceOp::ReadFile, fd, nullptr, size, 0, read);
+    return read;
+}
+
 int write_file(SceUID fd, const void *data, const SceSize size, const IOState &io, const char *export_name) {
     assert(data != nullptr);
     assert(size >= 0);
@@ -426,6 +719,7 @@ int write_file(SceUID fd, const void *data, const SceSize size, const IOState &i
 
     if (file->second.can_write_file()) {
         const auto written = file->second.write(data, 1, size);
+        TRACE_EVENT(TraceEvent::FileWrite, fd, size, written);
         LOG_TRACE_IF(log_file_op, "{}: Writing to fd: {}, size: {}", export_name, log_hex(fd), size);
         return static_cast<int>(written);
     }
@@ -433,6 +727,45 @@ int write_file(SceUID fd, const void *data, const SceSize size, const IOState &i
     return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
 }
 
+int pread_file(void *data, IOState &io, const SceUID fd, const SceSize size, const SceOff offset, const char *export_name) {
+    assert(data != nullptr);
+
+    const auto file = io.std_files.find(fd);
+    if (file == io.std_files.end())
+        return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+
+    const SceOff read = file->second.pread(data, size, offset);
+    if (read < 0)
+        return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+    TRACE_EVENT(TraceEvent::FileRead, fd, size, read);
+    LOG_TRACE_IF(log_file_op && log_file_read, "{}: Reading {} bytes at offset {} of fd {}", export_name, read, log_hex(offset), log_hex(fd));
+    // replayed as the seeks and the read it replaces
+    const SceOff pos = file->second.tell();
+    IO_TRACE(IoTraceOp::SeekFile, fd, nullptr, offset, SCE_SEEK_SET, offset);
+    IO_TRACE(IoTraceOp::ReadFile, fd, nullptr, size, 0, read);
+    IO_TRACE(IoTraceOp::SeekFile, fd, nullptr, pos, SCE_SEEK_SET, pos);
+    return static_cast<int>(read);
+}
+
+int pwrite_file(const SceUID fd, const void *data, const SceSize size, const SceOff offset, const IOState &io, const char *export_name) {
+    assert(data != nullptr);
+
+    const auto file = io.std_files.find(fd);
+    if (file == io.std_files.end() || !file->second.can_write_file())
+        return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+
+    if (!fs::is_directory(file->second.get_system_location().parent_path())) {
+        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+    }
+
+    const SceOff written = file->second.pwrite(data, size, offset);
+    if (written < 0)
+        return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+    TRACE_EVENT(TraceEvent::FileWrite, fd, size, written);
+    LOG_TRACE_IF(log_file_op, "{}: Writing to fd: {}, offset: {}, size: {}", export_name, log_hex(fd), log_hex(offset), size);
+    return static_cast<int>(written);
+}
+
 int truncate_file(const SceUID fd, unsigned long long length, const IOState &io, const char *export_name) {
     if (fd < 0)
         return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
@@ -445,7 +778,7 @@ int truncate_file(const SceUID fd, unsigned long long length, const IOState &io,
     return trunc;
 }
 
-SceOff seek_file(const SceUID fd, const SceOff offset, const SceIoSeekMode whence, IOState &io, const char *export_name) {
+static SceOff seek_file_impl(const SceUID fd, const SceOff offset, const SceIoSeekMode whence, IOState &io, const char *export_name) {
     if (!(whence == SCE_SEEK_SET || whence == SCE_SEEK_CUR || whence == SCE_SEEK_END))
         return IO_ERROR(SCE_ERROR_ERRNO_EOPNOTSUPP);
 
@@ -457,6 +790,7 @@ SceOff seek_file(const SceUID fd, const SceOff offset, const SceIoSeekMode whenc
         return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
     if (!file->second.seek(offset, whence))
         return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+    TRACE_EVENT(TraceEvent::FileSeek, fd, offset, whence);
 
     const auto log_mode = [](const SceIoSeekMode whence) -> const char * {
         switch (whence) {
@@ -472,6 +806,12 @@ SceOff seek_file(const SceUID fd, const SceOff offset, const SceIoSeekMode whenc
     return file->second.tell();
 }
 
+SceOff seek_file(const SceUID fd, const SceOff offset, const SceIoSeekMode whence, IOState &io, const char *export_name) {
+    const SceOff pos = seek_file_impl(fd, offset, whence, io, export_name);
+    IO_TRACE(IoTraceOp::SeekFile, fd, nullptr, offset, whence, pos);
+    return pos;
+}
+
 SceOff tell_file(IOState &io, const SceUID fd, const char *export_name) {
     if (fd < 0)
         return IO_ERROR(SCE_ERROR_ERRNO_EMFILE);
@@ -485,42 +825,58 @@ SceOff tell_file(IOState &io, const SceUID fd, const char *export_name) {
     return std_file->second.tell();
 }
 
-int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstring &pref_path, const char *export_name,
+static int stat_file_impl(IOState &io, const char *file, SceIoStat *statp, const std::wstring &pref_path, const char *export_name,
     const SceUID fd) {
     assert(statp != nullptr);
 
     memset(statp, '\0', sizeof(SceIoStat));
 
-    fs::path file_path = "";
+    // the files of the mounted archives are not on the host
+    const auto fd_file = io.std_files.find(fd);
+    const PsarcFileStreamPtr psarc_file = fd == invalid_fd ? open_psarc_file(io.psarc, file) : nullptr;
+    if (psarc_file || (fd_file != io.std_files.end() && fd_file->second.get_psarc_file())) {
+        const PsarcFileStream &stream = psarc_file ? *psarc_file : *fd_file->second.get_psarc_file();
+        *statp = get_archive_file_metadata(stream.archive->path, get_psarc_file_size(stream)).stat;
+        LOG_TRACE_IF(log_file_op && log_file_stat, "{}: Statting file {} of a mounted archive", export_name, file);
+        return 0;
+    }
+    if (fd_file != io.std_files.end() && fd_file->second.get_zip_file()) {
+        const ZipFileStream &stream = *fd_file->second.get_zip_file();
+        *statp = get_archive_file_metadata(stream.archive->path, get_zip_file_size(stream)).stat;
+        LOG_TRACE_IF(log_file_op && log_file_stat, "{}: Statting fd: {}", export_name, log_hex(fd));
+        return 0;
+    }
+
+    FileMetadata metadata;
     if (fd == invalid_fd) {
         auto device = device::get_device(file);
-        auto device_for_icase = device;
         if (device == VitaIoDevice::_INVALID) {
             LOG_ERROR("Cannot find device for path: {}", file);
             return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
         }
 
+        const bool cache_metadata = can_cache_metadata(io, device);
         const auto translated_path = translate_path(file, device, io.device_paths);
-        file_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
-
-        if (!fs::exists(file_path)) {
-            if (io.case_isens_find_enabled) {
+        const fs::path file_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
+
+        std::string archive_path;
+        const ZipArchivePtr archive = find_app_archive_path(device, translated_path, archive_path);
+        if (!archive && !is_read_only_device(device))
+            write_back_path(io, file_path);
+        if (archive)
+            metadata = get_zip_metadata(archive, archive_path, io.case_isens_find_enabled);
+        else
+            metadata = get_file_metadata(io.metadata_cache, file_path, cache_metadata);
+        if (!metadata.exists) {
+            if (io.case_isens_find_enabled && !archive) {
                 // Attempt a case-insensitive file search.
-                const auto original_file_path = file_path;
-                const auto cached_path = find_in_cache(io, string_utils::tolower(file_path.string()));
-                if (!cached_path.empty()) {
-                    file_path = cached_path;
-                    LOG_TRACE("Found cached filepath at {}", file_path.string());
-                } else {
-                    const bool path_found = find_case_isens_path(io, device_for_icase, translated_path, file_path);
-                    file_path = find_in_cache(io, string_utils::tolower(file_path.string()));
-                    if (!file_path.empty() && path_found) {
-                        LOG_TRACE("Found file on case-sensitive filesystem at {}", file_path.string());
-                    } else {
-                        LOG_ERROR("Missing file at {} (target path: {})", original_file_path.string(), file);
-                        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
-                    }
+                const auto found_path = find_case_isens_path(io, file_path);
+                if (found_path.empty()) {
+                    LOG_ERROR("Missing file at {} (target path: {})", file_path.string(), file);
+                    return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
                 }
+                metadata = get_file_metadata(io.metadata_cache, found_path, cache_metadata);
+                LOG_TRACE("Found file on case-sensitive filesystem at {}", found_path.string());
             } else {
                 LOG_ERROR("Missing file at {} (target path: {})", file_path.string(), file);
                 return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
@@ -528,59 +884,33 @@ int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstrin
         }
         LOG_TRACE_IF(log_file_op && log_file_stat, "{}: Statting file: {} ({})", export_name, file, device::construct_normalized_path(device, translated_path));
     } else { // We have previously opened and defined the location
-        const auto fd_file = io.std_files.find(fd);
         if (fd_file == io.std_files.end())
             return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
 
-        file_path = fd_file->second.get_system_location();
+        // the file may have been written since it was opened
+        fd_file->second.sync();
+        const bool cache_metadata = can_cache_metadata(io, device::get_device(fd_file->second.get_vita_loc())) && !can_write(fd_file->second.get_open_mode());
+        metadata = get_file_metadata(io.metadata_cache, fd_file->second.get_system_location(), cache_metadata);
         LOG_TRACE_IF(log_file_op && log_file_stat, "{}: Statting fd: {}", export_name, log_hex(fd));
 
-        statp->st_attr = fd_file->second.get_file_mode();
+        if (metadata.stat.st_attr == 0)
+            metadata.stat.st_attr = fd_file->second.get_file_mode();
     }
 
-    std::uint64_t last_access_time_ticks;
-    std::uint64_t creation_time_ticks;
-    std::uint64_t last_modification_time_ticks;
-
-#ifdef _WIN32
-    struct _stati64 sb;
-    if (_wstati64(file_path.generic_path().wstring().c_str(), &sb) < 0)
+    if (!metadata.exists)
         return IO_ERROR_UNK();
-#else
-    struct stat64 sb;
-    if (stat64(file_path.generic_path().string().c_str(), &sb) < 0)
-        return IO_ERROR_UNK();
-#endif
-
-    last_access_time_ticks = (uint64_t)sb.st_atime * VITA_CLOCKS_PER_SEC;
-    creation_time_ticks = (uint64_t)sb.st_ctime * VITA_CLOCKS_PER_SEC;
-    last_modification_time_ticks = (uint64_t)sb.st_mtime * VITA_CLOCKS_PER_SEC;
-
-#ifndef WIN32
-#undef st_atime
-#undef st_mtime
-#undef st_ctime
-#endif
-
-    statp->st_mode = SCE_S_IRUSR | SCE_S_IRGRP | SCE_S_IROTH | SCE_S_IXUSR | SCE_S_IXGRP | SCE_S_IXOTH;
-
-    if (fs::is_regular_file(file_path)) {
-        statp->st_size = fs::file_size(file_path);
-        statp->st_attr = SCE_SO_IFREG;
-        statp->st_mode |= SCE_S_IFREG;
-    }
-    if (fs::is_directory(file_path)) {
-        statp->st_attr = SCE_SO_IFDIR;
-        statp->st_mode |= SCE_S_IFDIR;
-    }
-
-    __RtcTicksToPspTime(&statp->st_atime, last_access_time_ticks);
-    __RtcTicksToPspTime(&statp->st_mtime, last_modification_time_ticks);
-    __RtcTicksToPspTime(&statp->st_ctime, creation_time_ticks);
 
+    *statp = metadata.stat;
     return 0;
 }
 
+int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstring &pref_path, const char *export_name,
+    const SceUID fd) {
+    const int result = stat_file_impl(io, file, statp, pref_path, export_name, fd);
+    IO_TRACE(IoTraceOp::StatFile, fd, file, 0, 0, result);
+    return result;
+}
+
 int stat_file_by_fd(IOState &io, const SceUID fd, SceIoStat *statp, const std::wstring &pref_path, const char *export_name) {
     assert(statp != nullptr);
     memset(statp, '\0', sizeof(SceIoStat));
@@ -593,14 +923,110 @@ int stat_file_by_fd(IOState &io, const SceUID fd, SceIoStat *statp, const std::w
     return stat_file(io, std_file->second.get_vita_loc(), statp, pref_path, export_name, fd);
 }
 
-int close_file(IOState &io, const SceUID fd, const char *export_name) {
+static int close_file_impl(IOState &io, const SceUID fd, const char *export_name) {
     if (fd < 0)
         return IO_ERROR(SCE_ERROR_ERRNO_EMFILE);
 
     LOG_TRACE_IF(log_file_op, "{}: Closing file fd: {}", export_name, log_hex(fd));
 
     io.tty_files.erase(fd);
-    io.std_files.erase(fd);
+    const auto file = io.std_files.find(fd);
+    if (file != io.std_files.end()) {
+        file->second.close_write_back();
+        io.std_files.erase(file);
+    }
+
+    return 0;
+}
+
+int close_file(IOState &io, const SceUID fd, const char *export_name) {
+    const int result = close_file_impl(io, fd, export_name);
+    IO_TRACE(IoTraceOp::CloseFile, fd, nullptr, 0, 0, result);
+    return result;
+}
+
+int sync_file(IOState &io, const SceUID fd, const char *export_name) {
+    if (io.tty_files.contains(fd))
+        return 0;
+
+    const auto file = io.std_files.find(fd);
+    if (file == io.std_files.end())
+        return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+
+    LOG_TRACE_IF(log_file_op, "{}: Syncing fd: {}", export_name, log_hex(fd));
+
+    if (!file->second.sync())
+        return IO_ERROR(SCE_ERROR_ERRNO_EIO);
+    return 0;
+}
+
+int sync_device(IOState &io, const char *device, const char *export_name) {
+    const auto sync_device = device::get_device(device);
+    if (sync_device == VitaIoDevice::_INVALID) {
+        LOG_ERROR("Cannot find device for path: {}", device);
+        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+    }
+
+    LOG_TRACE_IF(log_file_op, "{}: Syncing device {}", export_name, device);
+
+    bool synced = true;
+    for (const auto &[fd, file] : io.std_files) {
+        if (file.has_write_back() && device::get_device(file.get_vita_loc()) == sync_device)
+            synced &= file.sync();
+    }
+    // the files closed are written by the write-back thread
+    wait_write_back(io.write_back, "");
+
+    if (!synced)
+        return IO_ERROR(SCE_ERROR_ERRNO_EIO);
+    return 0;
+}
+
+int stage_file_write(IOState &io, const char *path, SceOff offset, const void *data, SceSize size, bool truncate, const std::wstring &pref_path, const char *export_name) {
+    assert(offset >= 0);
+
+    auto device = device::get_device(path);
+    if (device == VitaIoDevice::_INVALID) {
+        LOG_ERROR("Cannot find device for path: {}", path);
+        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+    }
+
+    const auto translated_path = translate_path(path, device, io.device_paths);
+    if (translated_path.empty()) {
+        LOG_ERROR("Cannot translate path: {}", path);
+        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+    }
+
+    WriteBackCommit commit;
+    commit.path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
+    commit.key = commit.path.generic_path().string();
+    if (fs::is_directory(commit.path)) {
+        LOG_ERROR("Cannot write directory: {}", commit.path.string());
+        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+    }
+
+    // the content is the one of the last commit staged for the file, or the one of the host file
+    if (!find_write_back_commit(io.write_back, commit.key, commit.data)) {
+        write_back_path(io, commit.path);
+        fs::ifstream file(commit.path, std::ios::binary | std::ios::ate);
+        if (file) {
+            commit.data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(commit.data.data()), commit.data.size());
+        }
+    }
+
+    const size_t end = static_cast<size_t>(offset) + size;
+    if (truncate || commit.data.size() < end)
+        commit.data.resize(end);
+    if (data)
+        memcpy(commit.data.data() + offset, data, size);
+
+    LOG_TRACE_IF(log_file_op, "{}: Staging {} bytes at offset {} of file {} ({})", export_name, size, offset, path, device::construct_normalized_path(device, translated_path));
+
+    const fs::path system_path = commit.path;
+    stage_write_back_commit(io.write_back, std::move(commit));
+    on_path_changed(io, system_path);
 
     return 0;
 }
@@ -619,6 +1045,7 @@ int remove_file(IOState &io, const char *file, const std::wstring &pref_path, co
     }
 
     const auto emulated_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
+    write_back_path(io, emulated_path);
     if (!fs::exists(emulated_path) || fs::is_directory(emulated_path)) {
         LOG_ERROR("File does not exist at path: {} (target path: {})", emulated_path.string(), file);
     }
@@ -633,6 +1060,7 @@ int remove_file(IOState &io, const char *file, const std::wstring &pref_path, co
         LOG_ERROR("Error code: {} ({})", error_code.value(), error_code.message());
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
+    on_path_changed(io, emulated_path);
 
     return 0;
 }
@@ -657,12 +1085,14 @@ int rename(IOState &io, const char *old_name, const char *new_name, const std::w
     }
 
     const auto emulated_old_path = device::construct_emulated_path(device, translated_old_path, pref_path, io.redirect_stdio);
+    write_back_path(io, emulated_old_path);
     if (!fs::exists(emulated_old_path)) {
         LOG_ERROR("File does not exist at path: {} (target path: {})", emulated_old_path.string(), old_name);
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
 
     const auto emulated_new_path = device::construct_emulated_path(device, translated_new_path, pref_path, io.redirect_stdio);
+    write_back_path(io, emulated_new_path);
 
     LOG_TRACE_IF(log_file_op, "{}: Renaming file {} to {} ({} to {})", export_name, old_name, new_name, emulated_old_path.string(), emulated_new_path.string());
 
@@ -674,57 +1104,75 @@ int rename(IOState &io, const char *old_name, const char *new_name, const std::w
         LOG_ERROR("Error code: {} ({})", error_code.value(), error_code.message());
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
+    on_path_changed(io, emulated_old_path);
+    on_path_changed(io, emulated_new_path);
 
     return 0;
 }
 
-SceUID open_dir(IOState &io, const char *path, const std::wstring &pref_path, const char *export_name) {
+static SceUID open_dir_impl(IOState &io, const char *path, const std::wstring &pref_path, const char *export_name) {
     auto device = device::get_device(path);
-    auto device_for_icase = device;
+    const bool cache_metadata = can_cache_metadata(io, device);
     const auto translated_path = translate_path(path, device, io.device_paths);
 
+    std::string archive_path;
+    if (const ZipArchivePtr archive = find_app_archive_path(device, translated_path, archive_path)) {
+        auto listing = get_zip_dir(*archive, archive_path, io.case_isens_find_enabled);
+        if (!listing) {
+            LOG_ERROR("Directory {} does not exist in archive {} (target path: {})", archive_path, archive->path.string(), path);
+            return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+        }
+
+        const auto normalized = device::construct_normalized_path(device, translated_path);
+        const auto fd = io.next_fd++;
+        io.dir_entries.emplace(fd, DirStats{ path, normalized, archive->path / archive_path, std::move(listing) });
+
+        LOG_TRACE_IF(log_file_op, "{}: Opening dir {} ({}) of the app archive, fd: {}", export_name, path, normalized, log_hex(fd));
+        return fd;
+    }
+
     auto dir_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio) / std::string{ fs::path::preferred_separator };
-    if (!fs::exists(dir_path)) {
+    if (!get_file_metadata(io.metadata_cache, dir_path, cache_metadata).exists) {
         if (io.case_isens_find_enabled) {
-            // Attempt a case-insensitive file search.
-            const auto original_dir_path = dir_path;
-            const auto cached_path = find_in_cache(io, string_utils::tolower(dir_path.string()));
-            if (!cached_path.empty()) {
-                dir_path = cached_path;
-                LOG_TRACE("Found cached directory path at {}", dir_path.string());
-            } else {
-                const bool path_found = find_case_isens_path(io, device_for_icase, translated_path, dir_path);
-                dir_path = find_in_cache(io, string_utils::tolower(dir_path.string().substr(0, dir_path.string().size() - 1)));
-                if (!dir_path.empty() && path_found) {
-                    LOG_TRACE("Found directory on case-sensitive filesystem at {}", dir_path.string());
-                } else {
-                    LOG_ERROR("Directory does not exist at {} (target path: {})", original_dir_path.string(), path);
-                    return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
-                }
+            // Attempt a case-insensitive directory search.
+            const auto found_path = find_case_isens_path(io, dir_path);
+            if (found_path.empty() || !fs::is_directory(found_path)) {
+                LOG_ERROR("Directory does not exist at {} (target path: {})", dir_path.string(), path);
+                return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
             }
+            dir_path = found_path;
+            LOG_TRACE("Found directory on case-sensitive filesystem at {}", dir_path.string());
         } else {
             LOG_ERROR("Directory does not exist at: {} (target path: {})", dir_path.string(), path);
             return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
         }
     }
 
-    const DirPtr opened = create_shared_dir(dir_path);
-    if (!opened) {
-        LOG_ERROR("Failed to open directory at: {} (target path: {})", dir_path.string(), path);
-        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
-    }
-
     const auto normalized = device::construct_normalized_path(device, translated_path);
-    const DirStats d{ path, normalized, dir_path, opened };
     const auto fd = io.next_fd++;
-    io.dir_entries.emplace(fd, d);
+    if (cache_metadata) {
+        io.dir_entries.emplace(fd, DirStats{ path, normalized, dir_path, get_dir_listing(io.metadata_cache, dir_path) });
+    } else {
+        const DirPtr opened = create_shared_dir(dir_path);
+        if (!opened) {
+            LOG_ERROR("Failed to open directory at: {} (target path: {})", dir_path.string(), path);
+            return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+        }
+        io.dir_entries.emplace(fd, DirStats{ path, normalized, dir_path, opened });
+    }
 
     LOG_TRACE_IF(log_file_op, "{}: Opening dir {} ({}), fd: {}", export_name, path, normalized, log_hex(fd));
 
     return fd;
 }
 
-SceUID read_dir(IOState &io, const SceUID fd, SceIoDirent *dent, const std::wstring &pref_path, const char *export_name) {
+SceUID open_dir(IOState &io, const char *path, const std::wstring &pref_path, const char *export_name) {
+    const SceUID fd = open_dir_impl(io, path, pref_path, export_name);
+    IO_TRACE(IoTraceOp::OpenDir, invalid_fd, path, 0, 0, fd);
+    return fd;
+}
+
+static SceUID read_dir_impl(IOState &io, const SceUID fd, SceIoDirent *dent, const std::wstring &pref_path, const char *export_name) {
     assert(dent != nullptr);
 
     memset(dent->d_name, '\0', sizeof(dent->d_name));
@@ -736,11 +1184,18 @@ SceUID read_dir(IOState &io, const SceUID fd, SceIoDirent *dent, const std::wstr
         if (!dir->second.is_directory())
             return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
 
-        const auto d = dir->second.get_dir_ptr();
-        if (!d)
-            return 0;
-
-        const auto d_name_utf8 = get_file_in_dir(d);
+        std::string d_name_utf8;
+        if (dir->second.has_listing()) {
+            const std::string *entry = dir->second.next_listed_entry();
+            if (!entry)
+                return 0;
+            d_name_utf8 = *entry;
+        } else {
+            const auto d = dir->second.get_dir_ptr();
+            if (!d)
+                return 0;
+            d_name_utf8 = get_file_in_dir(d);
+        }
         strncpy(dent->d_name, d_name_utf8.c_str(), sizeof(dent->d_name));
 
         const auto cur_path = dir->second.get_system_location() / d_name_utf8;
@@ -748,17 +1203,24 @@ SceUID read_dir(IOState &io, const SceUID fd, SceIoDirent *dent, const std::wstr
             const auto file_path = std::string(dir->second.get_vita_loc()) + '/' + d_name_utf8;
 
             LOG_TRACE_IF(log_file_op, "{}: Reading entry {} of fd: {}", export_name, file_path, log_hex(fd));
-            if (stat_file(io, file_path.c_str(), &dent->d_stat, pref_path, export_name) < 0)
+            // the stats of the entries are not traced, the replayed read does them again
+            if (stat_file_impl(io, file_path.c_str(), &dent->d_stat, pref_path, export_name, invalid_fd) < 0)
                 return IO_ERROR(SCE_ERROR_ERRNO_EMFILE);
             else
                 return 1; // move to the next file
         }
-        return read_dir(io, fd, dent, pref_path, export_name);
+        return read_dir_impl(io, fd, dent, pref_path, export_name);
     }
 
     return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
 }
 
+SceUID read_dir(IOState &io, const SceUID fd, SceIoDirent *dent, const std::wstring &pref_path, const char *export_name) {
+    const SceUID result = read_dir_impl(io, fd, dent, pref_path, export_name);
+    IO_TRACE(IoTraceOp::ReadDir, fd, nullptr, 0, 0, result);
+    return result;
+}
+
 bool copy_directories(const fs::path &src_path, const fs::path &dst_path) {
     try {
         if (!fs::exists(dst_path))
@@ -806,8 +1268,12 @@ int create_dir(IOState &io, const char *dir, int mode, const std::wstring &pref_
     }
 
     const auto emulated_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
-    if (recursive)
-        return fs::create_directories(emulated_path);
+    if (recursive) {
+        const bool created = fs::create_directories(emulated_path);
+        if (created)
+            on_path_changed(io, emulated_path);
+        return created;
+    }
     if (fs::exists(emulated_path))
         return IO_ERROR(SCE_ERROR_ERRNO_EEXIST);
 
@@ -821,11 +1287,12 @@ int create_dir(IOState &io, const char *dir, int mode, const std::wstring &pref_
         LOG_ERROR("Failed to create directory at {} (target path: {})", emulated_path.string(), dir);
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
+    on_path_changed(io, emulated_path);
 
     return 0;
 }
 
-int close_dir(IOState &io, const SceUID fd, const char *export_name) {
+static int close_dir_impl(IOState &io, const SceUID fd, const char *export_name) {
     if (fd < 0)
         return IO_ERROR(SCE_ERROR_ERRNO_EMFILE);
 
@@ -839,6 +1306,12 @@ int close_dir(IOState &io, const SceUID fd, const char *export_name) {
     return 0;
 }
 
+int close_dir(IOState &io, const SceUID fd, const char *export_name) {
+    const int result = close_dir_impl(io, fd, export_name);
+    IO_TRACE(IoTraceOp::CloseDir, fd, nullptr, 0, 0, result);
+    return result;
+}
+
 int remove_dir(IOState &io, const char *dir, const std::wstring &pref_path, const char *export_name) {
     auto device = device::get_device(dir);
     if (device == VitaIoDevice::_INVALID) {
@@ -854,10 +1327,13 @@ int remove_dir(IOState &io, const char *dir, const std::wstring &pref_path, cons
 
     LOG_TRACE_IF(log_file_op, "{}: Removing dir {} ({})", export_name, dir, device::construct_normalized_path(device, translated_path));
 
-    if (!fs::remove_all(device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio))) {
+    const auto emulated_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
+    write_back_path(io, emulated_path);
+    if (!fs::remove_all(emulated_path)) {
         LOG_ERROR("Cannot remove dir: {} ({})", dir, device::construct_normalized_path(device, translated_path));
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
+    on_path_changed(io, emulated_path);
 
     return 0;
 }
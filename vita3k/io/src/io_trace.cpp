@@ -0,0 +1,169 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <io/io_trace.h>
+
+#include <io/state.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+constexpr uint32_t IO_TRACE_MAGIC = 0x494B3356; // V3KI
+constexpr uint32_t IO_TRACE_VERSION = 1;
+
+namespace {
+
+struct IoTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_count;
+    uint32_t case_isens_find_enabled;
+};
+
+// the path follows each record
+struct IoTraceFileRecord {
+    uint64_t timestamp_ns;
+    int64_t arg;
+    int64_t arg2;
+    int64_t result;
+    int32_t fd;
+    uint16_t path_size;
+    uint8_t op;
+    uint8_t padding;
+};
+
+constexpr std::array<const char *, IO_TRACE_OP_COUNT> op_names = {
+    "open file",
+    "read file",
+    "seek file",
+    "stat file",
+    "close file",
+    "open dir",
+    "read dir",
+    "close dir",
+};
+
+std::mutex records_mutex;
+std::vector<IoTraceRecord> records;
+int64_t start_ns = 0;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void write_string(std::ofstream &file, const std::string &str) {
+    const uint32_t size = static_cast<uint32_t>(str.size());
+    file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    file.write(str.data(), size);
+}
+
+bool read_string(std::ifstream &file, std::string &str) {
+    uint32_t size = 0;
+    if (!file.read(reinterpret_cast<char *>(&size), sizeof(size)))
+        return false;
+    str.resize(size);
+    return static_cast<bool>(file.read(str.data(), size));
+}
+
+} // namespace
+
+void start_io_trace() {
+    {
+        const std::lock_guard<std::mutex> lock(records_mutex);
+        records.clear();
+        start_ns = now_ns();
+    }
+    io_trace_enabled.store(true, std::memory_order_release);
+}
+
+void stop_io_trace() {
+    io_trace_enabled.store(false, std::memory_order_release);
+}
+
+void record_io_trace(IoTraceOp op, SceUID fd, const char *path, int64_t arg, int64_t arg2, int64_t result) {
+    // the async requests call the io layer from their workers
+    const std::lock_guard<std::mutex> lock(records_mutex);
+    IoTraceRecord &record = records.emplace_back();
+    record.timestamp_ns = static_cast<uint64_t>(now_ns() - start_ns);
+    record.op = op;
+    record.fd = fd;
+    record.arg = arg;
+    record.arg2 = arg2;
+    record.result = result;
+    if (path)
+        record.path = path;
+}
+
+bool save_io_trace(const fs::path &path, const IOState &io) {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(records_mutex);
+    const IoTraceHeader header = { IO_TRACE_MAGIC, IO_TRACE_VERSION, static_cast<uint32_t>(records.size()), io.case_isens_find_enabled };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_string(file, io.device_paths.app0);
+    write_string(file, io.device_paths.savedata0);
+    write_string(file, io.device_paths.addcont0);
+
+    for (const IoTraceRecord &record : records) {
+        const IoTraceFileRecord file_record = { record.timestamp_ns, record.arg, record.arg2, record.result, record.fd,
+            static_cast<uint16_t>(std::min<size_t>(record.path.size(), UINT16_MAX)), static_cast<uint8_t>(record.op), 0 };
+        file.write(reinterpret_cast<const char *>(&file_record), sizeof(file_record));
+        file.write(record.path.data(), file_record.path_size);
+    }
+    return static_cast<bool>(file);
+}
+
+bool load_io_trace(const fs::path &path, IoTrace &trace) {
+    std::ifstream file(path, std::ios::binary);
+    IoTraceHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return false;
+    if (header.magic != IO_TRACE_MAGIC || header.version != IO_TRACE_VERSION)
+        return false;
+
+    trace.case_isens_find_enabled = header.case_isens_find_enabled != 0;
+    if (!read_string(file, trace.app0) || !read_string(file, trace.savedata0) || !read_string(file, trace.addcont0))
+        return false;
+
+    trace.records.resize(header.record_count);
+    for (IoTraceRecord &record : trace.records) {
+        IoTraceFileRecord file_record;
+        if (!file.read(reinterpret_cast<char *>(&file_record), sizeof(file_record)) || file_record.op >= IO_TRACE_OP_COUNT)
+            return false;
+        record.timestamp_ns = file_record.timestamp_ns;
+        record.op = static_cast<IoTraceOp>(file_record.op);
+        record.fd = file_record.fd;
+        record.arg = file_record.arg;
+        record.arg2 = file_record.arg2;
+        record.result = file_record.result;
+        record.path.resize(file_record.path_size);
+        if (!file.read(record.path.data(), file_record.path_size))
+            return false;
+    }
+    return true;
+}
+
+const char *get_io_trace_op_name(IoTraceOp op) {
+    return static_cast<size_t>(op) < op_names.size() ? op_names[static_cast<size_t>(op)] : "unknown";
+}
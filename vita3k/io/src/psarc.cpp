@@ -0,0 +1,392 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/psarc.h>
+
+#include <io/functions.h>
+#include <io/io.h>
+#include <io/state.h>
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <cstring>
+
+constexpr uint32_t PSARC_MAGIC = 0x50534152; // PSAR
+constexpr size_t PSARC_HEADER_SIZE = 32;
+constexpr size_t PSARC_ENTRY_MIN_SIZE = 30;
+// the first byte of the compressed blocks, the others are stored as is
+constexpr uint8_t ZLIB_BLOCK_MARKER = 0x78;
+constexpr uint8_t LZMA_BLOCK_MARKER = 0x5D;
+
+struct PsarcHeader {
+    uint32_t magic;
+    PsarcCompression compression;
+    uint32_t toc_size;
+    uint32_t entry_size;
+    uint32_t entry_count;
+    uint32_t block_size;
+    uint32_t flags;
+};
+
+// the integers of the archive are big endian
+static uint64_t read_be(const uint8_t *data, const size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+        value = (value << 8) | data[i];
+    return value;
+}
+
+static bool parse_psarc_header(const uint8_t *data, const size_t size, PsarcHeader &header) {
+    if (size < PSARC_HEADER_SIZE)
+        return false;
+
+    header.magic = static_cast<uint32_t>(read_be(data, 4));
+    if (memcmp(data + 8, "zlib", 4) == 0)
+        header.compression = PsarcCompression::Zlib;
+    else if (memcmp(data + 8, "lzma", 4) == 0)
+        header.compression = PsarcCompression::Lzma;
+    else
+        return false;
+    header.toc_size = static_cast<uint32_t>(read_be(data + 12, 4));
+    header.entry_size = static_cast<uint32_t>(read_be(data + 16, 4));
+    header.entry_count = static_cast<uint32_t>(read_be(data + 20, 4));
+    header.block_size = static_cast<uint32_t>(read_be(data + 24, 4));
+    header.flags = static_cast<uint32_t>(read_be(data + 28, 4));
+
+    return header.magic == PSARC_MAGIC && header.entry_size >= PSARC_ENTRY_MIN_SIZE && header.block_size > 0
+        && header.toc_size >= PSARC_HEADER_SIZE + static_cast<uint64_t>(header.entry_size) * header.entry_count && header.toc_size <= size;
+}
+
+static uint64_t block_key(const PsarcArchive &archive, const uint32_t index) {
+    return (static_cast<uint64_t>(archive.id) << 32) | index;
+}
+
+// block is the index of the block in the entry
+static PsarcBlock decompress_psarc_block(const PsarcArchive &archive, const PsarcEntry &entry, const uint32_t block) {
+    const uint32_t index = entry.first_block + block;
+    const uint64_t size = std::min<uint64_t>(archive.block_size, entry.size - static_cast<uint64_t>(block) * archive.block_size);
+    const uint64_t stored_size = archive.block_sizes[index] == 0 ? archive.block_size : archive.block_sizes[index];
+    const uint64_t offset = archive.block_offsets[index];
+    if (offset + std::min(stored_size, size) > archive.file.size()) {
+        LOG_ERROR("Block {} of {} is past the end of the archive", index, archive.path.string());
+        return nullptr;
+    }
+
+    const uint8_t *src = archive.file.data() + offset;
+    const auto data = std::make_shared<std::vector<uint8_t>>(size);
+    const uint8_t marker = archive.compression == PsarcCompression::Zlib ? ZLIB_BLOCK_MARKER : LZMA_BLOCK_MARKER;
+    if (stored_size >= size || src[0] != marker) {
+        memcpy(data->data(), src, size);
+        return data;
+    }
+
+    mz_ulong data_size = static_cast<mz_ulong>(size);
+    if (mz_uncompress(data->data(), &data_size, src, static_cast<mz_ulong>(stored_size)) != MZ_OK || data_size != size) {
+        LOG_ERROR("Could not decompress block {} of {}", index, archive.path.string());
+        return nullptr;
+    }
+
+    return data;
+}
+
+static void run_decompressor(PsarcState &psarc, const size_t index) {
+    std::unique_lock<std::mutex> lock(psarc.decompressor_mutex);
+    while (true) {
+        psarc.decompressor_cond.wait(lock, [&] { return index >= psarc.decompressor_count || !psarc.decompressor_tasks.empty(); });
+        if (index >= psarc.decompressor_count)
+            return;
+
+        const std::function<void()> task = std::move(psarc.decompressor_tasks.front());
+        psarc.decompressor_tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+static void submit_decompression(PsarcState &psarc, std::function<void()> task) {
+    const std::lock_guard<std::mutex> lock(psarc.decompressor_mutex);
+    psarc.decompressor_tasks.push_back(std::move(task));
+    if (psarc.decompressors.size() < psarc.decompressor_count && psarc.decompressors.size() < psarc.decompressor_tasks.size())
+        psarc.decompressors.emplace_back(run_decompressor, std::ref(psarc), psarc.decompressors.size());
+    psarc.decompressor_cond.notify_one();
+}
+
+// first and last are the indexes of the blocks in the entry, the blocks could not be decompressed if one is nullptr
+static std::vector<PsarcBlock> get_psarc_blocks(PsarcState &psarc, const PsarcArchive &archive, const PsarcEntry &entry, const uint32_t first, const uint32_t last) {
+    std::vector<PsarcBlock> blocks(last - first + 1);
+    std::vector<uint32_t> missing;
+    {
+        const std::lock_guard<std::mutex> lock(psarc.cache_mutex);
+        for (uint32_t block = first; block <= last; block++) {
+            const auto cached = psarc.blocks.find(block_key(archive, entry.first_block + block));
+            if (cached == psarc.blocks.end()) {
+                missing.push_back(block);
+                continue;
+            }
+
+            psarc.lru.splice(psarc.lru.begin(), psarc.lru, cached->second);
+            blocks[block - first] = cached->second->second;
+        }
+    }
+
+    if (missing.empty())
+        return blocks;
+
+    // this thread decompresses the first block while the decompressors take the others
+    std::mutex done_mutex;
+    std::condition_variable done_cond;
+    size_t remaining = missing.size() - 1;
+    for (size_t i = 1; i < missing.size(); i++) {
+        submit_decompression(psarc, [&, block = missing[i]]() {
+            PsarcBlock data = decompress_psarc_block(archive, entry, block);
+            const std::lock_guard<std::mutex> lock(done_mutex);
+            blocks[block - first] = std::move(data);
+            if (--remaining == 0)
+                done_cond.notify_one();
+        });
+    }
+    PsarcBlock data = decompress_psarc_block(archive, entry, missing.front());
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        blocks[missing.front() - first] = std::move(data);
+        done_cond.wait(lock, [&] { return remaining == 0; });
+    }
+
+    const std::lock_guard<std::mutex> lock(psarc.cache_mutex);
+    for (const uint32_t block : missing) {
+        const PsarcBlock &data = blocks[block - first];
+        const uint64_t key = block_key(archive, entry.first_block + block);
+        if (!data || psarc.blocks.contains(key))
+            continue;
+
+        while (!psarc.lru.empty() && psarc.cache_size + data->size() > PsarcState::MAX_CACHE_SIZE) {
+            psarc.cache_size -= psarc.lru.back().second->size();
+            psarc.blocks.erase(psarc.lru.back().first);
+            psarc.lru.pop_back();
+        }
+        psarc.lru.emplace_front(key, data);
+        psarc.blocks.emplace(key, psarc.lru.begin());
+        psarc.cache_size += data->size();
+    }
+
+    return blocks;
+}
+
+static std::string normalize_psarc_name(std::string name, const bool ignore_case) {
+    // the names may be absolute
+    const size_t start = name.find_first_not_of('/');
+    name.erase(0, std::min(start, name.size()));
+    if (ignore_case)
+        name = string_utils::tolower(name);
+    return name;
+}
+
+// the manifest is decompressed without the cache, it is only read once
+static bool read_psarc_manifest(PsarcArchive &archive) {
+    const PsarcEntry &manifest = archive.entries.front();
+    std::string names;
+    for (uint32_t block = 0; static_cast<uint64_t>(block) * archive.block_size < manifest.size; block++) {
+        const PsarcBlock data = decompress_psarc_block(archive, manifest, block);
+        if (!data)
+            return false;
+        names.append(data->begin(), data->end());
+    }
+
+    size_t entry = 1;
+    size_t start = 0;
+    while (start < names.size() && entry < archive.entries.size()) {
+        const size_t end = std::min(names.find('\n', start), names.size());
+        archive.files.emplace(normalize_psarc_name(names.substr(start, end - start), archive.ignore_case), entry++);
+        start = end + 1;
+    }
+
+    return true;
+}
+
+static bool parse_psarc_toc(PsarcArchive &archive) {
+    const uint8_t *data = archive.file.data();
+    PsarcHeader header;
+    if (!parse_psarc_header(data, archive.file.size(), header))
+        return false;
+
+    archive.compression = header.compression;
+    archive.block_size = header.block_size;
+    archive.ignore_case = header.flags & 1;
+
+    // the size of the blocks is stored on as many bytes as needed for the block size
+    size_t block_size_bytes = 1;
+    while (block_size_bytes < 4 && (1ULL << (8 * block_size_bytes)) < header.block_size)
+        block_size_bytes++;
+
+    const uint8_t *entry_data = data + PSARC_HEADER_SIZE;
+    std::vector<uint64_t> entry_offsets;
+    for (uint32_t i = 0; i < header.entry_count; i++, entry_data += header.entry_size) {
+        // the entries start with the MD5 of their name
+        archive.entries.push_back({ static_cast<uint32_t>(read_be(entry_data + 16, 4)), read_be(entry_data + 20, 5) });
+        entry_offsets.push_back(read_be(entry_data + 25, 5));
+    }
+
+    const size_t block_table_offset = PSARC_HEADER_SIZE + static_cast<size_t>(header.entry_size) * header.entry_count;
+    const size_t block_count = (header.toc_size - block_table_offset) / block_size_bytes;
+    for (size_t i = 0; i < block_count; i++)
+        archive.block_sizes.push_back(static_cast<uint32_t>(read_be(data + block_table_offset + i * block_size_bytes, block_size_bytes)));
+
+    // the blocks of an entry follow each other from its offset
+    archive.block_offsets.resize(block_count);
+    for (size_t i = 0; i < archive.entries.size(); i++) {
+        const PsarcEntry &entry = archive.entries[i];
+        const uint64_t entry_block_count = (entry.size + archive.block_size - 1) / archive.block_size;
+        if (entry.first_block + entry_block_count > block_count)
+            return false;
+
+        uint64_t offset = entry_offsets[i];
+        for (uint64_t block = entry.first_block; block < entry.first_block + entry_block_count; block++) {
+            archive.block_offsets[block] = offset;
+            offset += archive.block_sizes[block] == 0 ? archive.block_size : archive.block_sizes[block];
+        }
+    }
+
+    return !archive.entries.empty() && read_psarc_manifest(archive);
+}
+
+SceInt64 get_psarc_toc_size(IOState &io, const char *archive_path, const std::wstring &pref_path) {
+    MappedFile file;
+    if (!file.open(expand_path(io, archive_path, pref_path)))
+        return SCE_ERROR_ERRNO_ENOENT;
+
+    PsarcHeader header;
+    if (!parse_psarc_header(file.data(), file.size(), header))
+        return -1;
+
+    return header.toc_size;
+}
+
+int mount_psarc(IOState &io, const SceUID mount_id, const char *archive_path, const char *mount_point, const std::wstring &pref_path) {
+    const auto archive = std::make_shared<PsarcArchive>();
+    archive->path = expand_path(io, archive_path, pref_path);
+    if (!archive->file.open(archive->path.string())) {
+        LOG_ERROR("Missing archive at {} (target path: {})", archive->path.string(), archive_path);
+        return SCE_ERROR_ERRNO_ENOENT;
+    }
+
+    if (!parse_psarc_toc(*archive)) {
+        LOG_ERROR("Invalid archive at {}", archive->path.string());
+        return -1;
+    }
+    if (archive->compression == PsarcCompression::Lzma) {
+        LOG_ERROR("Cannot mount {}, LZMA archives are not supported", archive->path.string());
+        return SCE_ERROR_ERRNO_EOPNOTSUPP;
+    }
+
+    std::string mount_path = mount_point;
+    while (mount_path.size() > 1 && mount_path.back() == '/')
+        mount_path.pop_back();
+
+    LOG_INFO("Mounting {} ({} files) at {}", archive->path.string(), archive->files.size(), mount_path);
+    const std::lock_guard<std::mutex> lock(io.psarc.mutex);
+    archive->id = io.psarc.next_archive_id++;
+    io.psarc.mounts.push_back({ mount_id, std::move(mount_path), archive });
+
+    return 0;
+}
+
+bool unmount_psarc(PsarcState &psarc, const SceUID mount_id) {
+    const std::lock_guard<std::mutex> lock(psarc.mutex);
+    // the files still open keep their archive
+    return std::erase_if(psarc.mounts, [&](const PsarcMount &mount) { return mount.id == mount_id; }) > 0;
+}
+
+PsarcFileStreamPtr open_psarc_file(PsarcState &psarc, const std::string &path) {
+    const std::lock_guard<std::mutex> lock(psarc.mutex);
+    // the last archive mounted first
+    for (auto mount = psarc.mounts.rbegin(); mount != psarc.mounts.rend(); ++mount) {
+        const std::string &mount_point = mount->mount_point;
+        if (path.size() <= mount_point.size() || !path.starts_with(mount_point) || (path[mount_point.size()] != '/' && mount_point.back() != '/'))
+            continue;
+
+        const PsarcArchive &archive = *mount->archive;
+        const auto file = archive.files.find(normalize_psarc_name(path.substr(mount_point.size()), archive.ignore_case));
+        if (file == archive.files.end())
+            continue;
+
+        return std::make_shared<PsarcFileStream>(PsarcFileStream{ &psarc, mount->archive, file->second });
+    }
+
+    return nullptr;
+}
+
+uint64_t get_psarc_file_size(const PsarcFileStream &stream) {
+    return stream.archive->entries[stream.entry].size;
+}
+
+SceOff read_psarc_file(PsarcFileStream &stream, void *data, size_t size) {
+    const PsarcArchive &archive = *stream.archive;
+    const PsarcEntry &entry = archive.entries[stream.entry];
+    if (stream.pos < 0 || static_cast<uint64_t>(stream.pos) >= entry.size || size == 0)
+        return 0;
+
+    size = std::min<uint64_t>(size, entry.size - stream.pos);
+    const uint32_t first = static_cast<uint32_t>(stream.pos / archive.block_size);
+    const uint32_t last = static_cast<uint32_t>((stream.pos + size - 1) / archive.block_size);
+    const std::vector<PsarcBlock> blocks = get_psarc_blocks(*stream.state, archive, entry, first, last);
+
+    uint8_t *dst = static_cast<uint8_t *>(data);
+    size_t block_offset = stream.pos % archive.block_size;
+    size_t copied = 0;
+    for (const PsarcBlock &block : blocks) {
+        if (!block)
+            return -1;
+
+        const size_t copy_size = std::min(size - copied, block->size() - block_offset);
+        memcpy(dst + copied, block->data() + block_offset, copy_size);
+        copied += copy_size;
+        block_offset = 0;
+    }
+    stream.pos += copied;
+
+    return copied;
+}
+
+void set_psarc_decompressor_count(PsarcState &psarc, const size_t count) {
+    const std::lock_guard<std::mutex> resize_lock(psarc.decompressor_resize_mutex);
+    std::vector<std::thread> stopped;
+    {
+        const std::lock_guard<std::mutex> lock(psarc.decompressor_mutex);
+        psarc.decompressor_count = count;
+        while (psarc.decompressors.size() > count) {
+            stopped.push_back(std::move(psarc.decompressors.back()));
+            psarc.decompressors.pop_back();
+        }
+        psarc.decompressor_cond.notify_all();
+    }
+
+    for (std::thread &thread : stopped)
+        thread.join();
+}
+
+size_t get_psarc_decompressor_count(PsarcState &psarc) {
+    const std::lock_guard<std::mutex> lock(psarc.decompressor_mutex);
+    return psarc.decompressor_count;
+}
+
+PsarcState::~PsarcState() {
+    set_psarc_decompressor_count(*this, 0);
+}
@@ -25,22 +25,608 @@
 #endif
 
 #include <io/state.h>
+#include <util/log.h>
+#include <util/memory_accounting.h>
 
-SceOff FileStats::read(void *input_data, const int element_size, const SceSize element_count) const {
+#include <algorithm>
+#include <cstring>
+
+// after this many reads starting where the previous one ended, the file is read sequentially
+constexpr uint32_t SEQUENTIAL_READ_COUNT = 4;
+// below this size, the page faults of the copy are cheaper than a hint
+constexpr size_t WILLNEED_MIN_SIZE = 256 * 1024;
+// size of the first fill of the read-ahead and of its largest fill
+constexpr size_t READ_AHEAD_MIN_WINDOW = 64 * 1024;
+constexpr size_t READ_AHEAD_MAX_WINDOW = 2 * 1024 * 1024;
+// the writes of this size or bigger are not gathered, the extents are written once they would go past it
+constexpr size_t WRITE_BACK_SIZE = 256 * 1024;
+// each extent costs a seek when written
+constexpr size_t WRITE_BACK_MAX_EXTENTS = 256;
+// the gathered data is written at most this long after the first write gathered
+constexpr std::chrono::milliseconds WRITE_BACK_DELAY(500);
+
+static SceOff read_mapped_file(MappedFileStream &stream, void *input_data, const int element_size, const SceSize element_count) {
+    const size_t file_size = stream.file.size();
+    const size_t pos = static_cast<size_t>(stream.pos);
+    if (pos >= file_size)
+        return 0;
+    const size_t element_read_count = std::min<size_t>(element_count, (file_size - pos) / element_size);
+    const size_t size = element_read_count * element_size;
+
+    if (stream.pos == stream.last_read_end) {
+        if (!stream.advised_sequential && ++stream.sequential_reads >= SEQUENTIAL_READ_COUNT) {
+            stream.file.advise(0, file_size, MappedFileAdvice::Sequential);
+            stream.advised_sequential = true;
+        }
+    } else {
+        stream.sequential_reads = 0;
+        // a big random read gets its pages read at once instead of on each fault
+        if (size >= WILLNEED_MIN_SIZE)
+            stream.file.advise(pos, size, MappedFileAdvice::WillNeed);
+    }
+
+    memcpy(input_data, stream.file.data() + pos, size);
+    stream.pos += size;
+    stream.last_read_end = stream.pos;
+
+    return element_read_count;
+}
+
+static bool seek_host_file(FILE *file, const SceOff offset, const int base) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, base) == 0;
+#else
+    return fseeko(file, offset, base) == 0;
+#endif
+}
+
+static SceOff tell_host_file(FILE *file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+}
+
+// the file mutex must be held
+static size_t read_host_file(ReadAheadStream &stream, void *data, const SceOff offset, const size_t size) {
+    if (!seek_host_file(stream.file.get(), offset, SEEK_SET))
+        return 0;
+    return fread(data, 1, size, stream.file.get());
+}
+
+// the mutex must be held, returns the number of bytes copied
+static size_t copy_from_buffer(ReadAheadStream &stream, uint8_t *data, const size_t size) {
+    const SceOff buffer_end = stream.buffer_start + static_cast<SceOff>(stream.buffer.size());
+    if (stream.pos < stream.buffer_start || stream.pos >= buffer_end)
+        return 0;
+
+    const size_t copy_size = std::min<size_t>(size, buffer_end - stream.pos);
+    memcpy(data, stream.buffer.data() + (stream.pos - stream.buffer_start), copy_size);
+    stream.pos += copy_size;
+    return copy_size;
+}
+
+// the mutex must be held
+static void account_buffer(ReadAheadStream &stream) {
+    const size_t capacity = stream.buffer.capacity();
+    if (capacity > stream.accounted_bytes)
+        add_memory_usage(MemoryCategory::IoReadBuffers, capacity - stream.accounted_bytes);
+    else
+        remove_memory_usage(MemoryCategory::IoReadBuffers, stream.accounted_bytes - capacity);
+    stream.accounted_bytes = capacity;
+}
+
+ReadAheadStream::~ReadAheadStream() {
+    remove_memory_usage(MemoryCategory::IoReadBuffers, accounted_bytes);
+}
+
+static void fill_read_ahead(const std::weak_ptr<ReadAheadStream> &weak_stream) {
+    const ReadAheadStreamPtr stream = weak_stream.lock();
+    // the file has been closed
+    if (!stream)
+        return;
+
+    SceOff offset;
+    size_t size;
+    {
+        const std::lock_guard<std::mutex> lock(stream->mutex);
+        // the guest read past the buffer while the fill was waiting, it is started again at the position of the guest
+        const SceOff buffer_end = stream->buffer_start + static_cast<SceOff>(stream->buffer.size());
+        if (stream->pos < stream->buffer_start || stream->pos > buffer_end) {
+            stream->buffer.clear();
+            stream->buffer_start = stream->pos;
+        }
+        offset = stream->buffer_start + static_cast<SceOff>(stream->buffer.size());
+        size = stream->window;
+    }
+
+    std::vector<uint8_t> data(size);
+    const std::lock_guard<std::mutex> file_lock(stream->file_mutex);
+    data.resize(read_host_file(*stream, data.data(), offset, size));
+
+    const std::lock_guard<std::mutex> lock(stream->mutex);
+    stream->fill_pending = false;
+    if (data.size() < size)
+        stream->reached_end = true;
+    // a guest read done while the file mutex was waited for moved the buffer
+    if (stream->buffer_start + static_cast<SceOff>(stream->buffer.size()) != offset)
+        return;
+
+    // the data already given to the guest is dropped
+    if (stream->pos > stream->buffer_start) {
+        stream->buffer.erase(stream->buffer.begin(), stream->buffer.begin() + (stream->pos - stream->buffer_start));
+        stream->buffer_start = stream->pos;
+    }
+    stream->buffer.insert(stream->buffer.end(), data.begin(), data.end());
+    account_buffer(*stream);
+}
+
+// the mutex must be held
+static void update_read_ahead(ReadAheadStream &stream, const SceOff read_start) {
+    if (read_start == stream.last_read_end) {
+        stream.sequential_reads++;
+    } else {
+        stream.sequential_reads = 0;
+        stream.window = READ_AHEAD_MIN_WINDOW;
+        stream.reached_end = false;
+    }
+    stream.last_read_end = stream.pos;
+
+    if (stream.sequential_reads < SEQUENTIAL_READ_COUNT || stream.fill_pending || stream.reached_end)
+        return;
+
+    // the next fill is started once less than half a window is left in the buffer
+    const SceOff buffer_end = stream.buffer_start + static_cast<SceOff>(stream.buffer.size());
+    if (stream.pos >= stream.buffer_start && buffer_end - stream.pos >= static_cast<SceOff>(stream.window / 2))
+        return;
+
+    // above the budget, the stream is read from the host file and its buffer is released once consumed
+    if (is_over_memory_budget(MemoryCategory::IoReadBuffers)) {
+        if (stream.pos < stream.buffer_start || stream.pos >= buffer_end) {
+            std::vector<uint8_t>().swap(stream.buffer);
+            stream.buffer_start = stream.pos;
+            account_buffer(stream);
+        }
+        return;
+    }
+
+    stream.fill_pending = true;
+    stream.schedule([weak_stream = std::weak_ptr<ReadAheadStream>(stream.shared_from_this())]() {
+        fill_read_ahead(weak_stream);
+    });
+    // the sequential streams are read ahead further each time
+    stream.window = std::min(stream.window * 2, READ_AHEAD_MAX_WINDOW);
+}
+
+static SceOff read_read_ahead(ReadAheadStream &stream, void *input_data, const int element_size, const SceSize element_count) {
+    uint8_t *data = static_cast<uint8_t *>(input_data);
+    const size_t size = static_cast<size_t>(element_size) * element_count;
+
+    std::unique_lock<std::mutex> lock(stream.mutex);
+    const SceOff read_start = stream.pos;
+    size_t read_size = copy_from_buffer(stream, data, size);
+    uint64_t hit_size = read_size;
+
+    if (read_size < size) {
+        // a fill being done holds the file mutex, the data it read can then be used once it is locked
+        lock.unlock();
+        const std::lock_guard<std::mutex> file_lock(stream.file_mutex);
+        lock.lock();
+
+        // the position cannot be changed by the fill, only by another read or seek of the guest
+        if (stream.pos == read_start + static_cast<SceOff>(read_size)) {
+            const size_t buffered_size = copy_from_buffer(stream, data + read_size, size - read_size);
+            read_size += buffered_size;
+            hit_size += buffered_size;
+        }
+
+        const size_t host_size = read_host_file(stream, data + read_size, stream.pos, size - read_size);
+        stream.pos += host_size;
+        read_size += host_size;
+        stream.stats->miss_bytes += host_size;
+    }
+    stream.stats->hit_bytes += hit_size;
+
+    update_read_ahead(stream, read_start);
+
+    return read_size / element_size;
+}
+
+void FileStats::enable_read_ahead(ReadAheadStats &stats, std::function<void(AsyncIoTask)> schedule) {
+    if (!wrapped_file || can_write(file_info.open_mode))
+        return;
+
+    read_ahead = std::make_shared<ReadAheadStream>();
+    read_ahead->file = std::move(wrapped_file);
+    read_ahead->window = READ_AHEAD_MIN_WINDOW;
+    read_ahead->stats = &stats;
+    read_ahead->schedule = std::move(schedule);
+}
+
+// writes the buffered data to the host file, returns false if it could not be written
+static bool flush_write_back(WriteBackStream &stream) {
+    const std::lock_guard<std::mutex> file_lock(stream.file_mutex);
+    std::vector<WriteBackExtent> extents;
+    {
+        const std::lock_guard<std::mutex> lock(stream.mutex);
+        if (stream.extents.empty())
+            return true;
+        extents.swap(stream.extents);
+        stream.buffered_size = 0;
+    }
+
+    FILE *file = stream.file.get();
+    bool written = true;
+    for (const WriteBackExtent &extent : extents) {
+        if (!seek_host_file(file, extent.start, SEEK_SET) || fwrite(extent.data.data(), 1, extent.data.size(), file) != extent.data.size()) {
+            LOG_ERROR("Could not write {} bytes at offset {} of {}", extent.data.size(), extent.start, stream.path);
+            written = false;
+        }
+    }
+    // the other handles of the file only see the data once the host buffer is flushed
+    if (fflush(file) != 0) {
+        LOG_ERROR("Could not flush {}", stream.path);
+        return false;
+    }
+    return written;
+}
+
+WriteBackStream::~WriteBackStream() {
+    if (file)
+        flush_write_back(*this);
+}
+
+static void write_commit(const WriteBackCommit &commit) {
+    fs::path temp_path = commit.path;
+    temp_path += ".vita3k_tmp";
+
+    boost::system::error_code error_code;
+    fs::create_directories(commit.path.parent_path(), error_code);
+    {
+        fs::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(commit.data.data()), commit.data.size());
+        file.close();
+        if (!file) {
+            LOG_ERROR("Cannot write the file {}", temp_path.string());
+            fs::remove(temp_path, error_code);
+            return;
+        }
+    }
+
+    fs::rename(temp_path, commit.path, error_code);
+    if (error_code) {
+        LOG_ERROR("Cannot replace the file {}: {}", commit.path.string(), error_code.message());
+        fs::remove(temp_path, error_code);
+    }
+}
+
+static void written_path(WriteBackState &state, const std::string &path) {
+    const auto pending = state.pending_paths.find(path);
+    if (--pending->second == 0)
+        state.pending_paths.erase(pending);
+    state.written_cond.notify_all();
+}
+
+static void run_write_back(WriteBackState &state) {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    while (!state.exiting) {
+        if (!state.closed.empty()) {
+            WriteBackStreamPtr stream = std::move(state.closed.front());
+            state.closed.pop_front();
+            const std::string path = stream->path;
+            lock.unlock();
+            flush_write_back(*stream);
+            // the host file is closed before the path can be used again
+            stream.reset();
+            lock.lock();
+
+            written_path(state, path);
+            continue;
+        }
+
+        if (!state.commits.empty()) {
+            const WriteBackCommit commit = std::move(state.commits.front());
+            state.commits.pop_front();
+            lock.unlock();
+            write_commit(commit);
+            lock.lock();
+
+            written_path(state, commit.key);
+            continue;
+        }
+
+        if (state.deadlines.empty()) {
+            state.cond.wait(lock);
+            continue;
+        }
+        const auto deadline = state.deadlines.begin()->first;
+        if (std::chrono::steady_clock::now() < deadline) {
+            state.cond.wait_until(lock, deadline);
+            continue;
+        }
+
+        // the stream may have been written and closed since, or written and filled again, which only writes it earlier
+        WriteBackStreamPtr stream = state.deadlines.begin()->second.lock();
+        state.deadlines.erase(state.deadlines.begin());
+        lock.unlock();
+        if (stream)
+            flush_write_back(*stream);
+        stream.reset();
+        lock.lock();
+    }
+}
+
+WriteBackState::~WriteBackState() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        cond.notify_one();
+    }
+
+    if (thread.joinable())
+        thread.join();
+    // the streams left are written by their destructor
+    for (const WriteBackCommit &commit : commits)
+        write_commit(commit);
+}
+
+bool is_write_back_path(const std::string &stream_path, const std::string &path) {
+    return stream_path.starts_with(path) && (stream_path.size() == path.size() || stream_path[path.size()] == '/');
+}
+
+void wait_write_back(WriteBackState &state, const std::string &path) {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.written_cond.wait(lock, [&]() {
+        if (path.empty())
+            return state.pending_paths.empty();
+        return std::none_of(state.pending_paths.begin(), state.pending_paths.end(), [&](const auto &pending) {
+            return is_write_back_path(pending.first, path);
+        });
+    });
+}
+
+// the write-back thread is started by the first data gathered
+static void start_write_back(WriteBackState &state) {
+    if (!state.thread.joinable())
+        state.thread = std::thread(run_write_back, std::ref(state));
+}
+
+void stage_write_back_commit(WriteBackState &state, WriteBackCommit commit) {
+    const std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.exiting) {
+        write_commit(commit);
+        return;
+    }
+    start_write_back(state);
+    state.pending_paths[commit.key]++;
+    state.commits.push_back(std::move(commit));
+    state.cond.notify_one();
+}
+
+bool find_write_back_commit(WriteBackState &state, const std::string &key, std::vector<uint8_t> &data) {
+    const std::lock_guard<std::mutex> lock(state.mutex);
+    const auto commit = std::find_if(state.commits.rbegin(), state.commits.rend(), [&](const WriteBackCommit &commit) {
+        return commit.key == key;
+    });
+    if (commit == state.commits.rend())
+        return false;
+
+    data = commit->data;
+    return true;
+}
+
+static SceOff extent_end(const WriteBackExtent &extent) {
+    return extent.start + static_cast<SceOff>(extent.data.size());
+}
+
+// the mutex of the stream must be held, returns true if the range overlaps the buffered data
+static bool overlaps_write_back(const WriteBackStream &stream, const SceOff start, const SceOff end) {
+    return std::any_of(stream.extents.begin(), stream.extents.end(), [&](const WriteBackExtent &extent) {
+        return extent.start < end && start < extent_end(extent);
+    });
+}
+
+// the mutex of the stream must be held, returns false if the data cannot be gathered with the buffered data
+static bool append_to_buffer(WriteBackStream &stream, const void *data, const size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    const SceOff end = stream.pos + static_cast<SceOff>(size);
+
+    // a range written again, as the pages of a database in a transaction, is overwritten in the latest extent overlapping it
+    // if the extent holds all of it, the extents after it do not overlap it so the order of the writes is kept
+    for (auto extent = stream.extents.rbegin(); extent != stream.extents.rend(); ++extent) {
+        if (extent->start >= end || stream.pos >= extent_end(*extent))
+            continue;
+        if (extent->start > stream.pos || extent_end(*extent) < end)
+            break;
+        memcpy(extent->data.data() + (stream.pos - extent->start), bytes, size);
+        stream.pos = end;
+        return true;
+    }
+
+    if (stream.buffered_size + size > WRITE_BACK_SIZE)
+        return false;
+
+    const bool was_empty = stream.extents.empty();
+    if (!was_empty && extent_end(stream.extents.back()) == stream.pos) {
+        WriteBackExtent &last = stream.extents.back();
+        last.data.insert(last.data.end(), bytes, bytes + size);
+    } else {
+        if (stream.extents.size() == WRITE_BACK_MAX_EXTENTS)
+            return false;
+        stream.extents.push_back({ stream.pos, std::vector<uint8_t>(bytes, bytes + size) });
+    }
+    stream.buffered_size += size;
+    stream.pos = end;
+
+    if (was_empty) {
+        WriteBackState &state = *stream.state;
+        const std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.exiting) {
+            start_write_back(state);
+            state.deadlines.emplace(std::chrono::steady_clock::now() + WRITE_BACK_DELAY, stream.weak_from_this());
+            state.cond.notify_one();
+        }
+    }
+    return true;
+}
+
+static size_t write_write_back(WriteBackStream &stream, const void *data, const size_t size) {
+    if (size == 0)
+        return 0;
+
+    if (size < WRITE_BACK_SIZE) {
+        const std::lock_guard<std::mutex> lock(stream.mutex);
+        if (append_to_buffer(stream, data, size))
+            return size;
+    }
+
+    // the buffered data is written first so that the writes stay in order
+    flush_write_back(stream);
+
+    if (size < WRITE_BACK_SIZE) {
+        const std::lock_guard<std::mutex> lock(stream.mutex);
+        if (append_to_buffer(stream, data, size))
+            return size;
+    }
+
+    const std::lock_guard<std::mutex> file_lock(stream.file_mutex);
+    const std::lock_guard<std::mutex> lock(stream.mutex);
+    FILE *file = stream.file.get();
+    if (!seek_host_file(file, stream.pos, SEEK_SET))
+        return 0;
+    const size_t written = fwrite(data, 1, size, file);
+    stream.pos += written;
+    return written;
+}
+
+// size of the host file with the buffered data
+static SceOff get_write_back_size(WriteBackStream &stream) {
+    const std::lock_guard<std::mutex> file_lock(stream.file_mutex);
+    const std::lock_guard<std::mutex> lock(stream.mutex);
+    if (!seek_host_file(stream.file.get(), 0, SEEK_END))
+        return -1;
+    SceOff size = tell_host_file(stream.file.get());
+    for (const WriteBackExtent &extent : stream.extents)
+        size = std::max(size, extent_end(extent));
+    return size;
+}
+
+void FileStats::enable_write_back(WriteBackState &state) {
+    if (!wrapped_file || !can_write(file_info.open_mode) || (file_info.open_mode & SCE_O_APPEND))
+        return;
+
+    write_back = std::make_shared<WriteBackStream>();
+    write_back->pos = tell_host_file(wrapped_file.get());
+    write_back->file = std::move(wrapped_file);
+    write_back->state = &state;
+    write_back->path = file_info.sys_loc.generic_path().string();
+}
+
+bool FileStats::sync() const {
+    if (write_back)
+        return flush_write_back(*write_back);
+    if (wrapped_file)
+        return fflush(wrapped_file.get()) == 0;
+    return true;
+}
+
+void FileStats::close_write_back() const {
+    if (!write_back)
+        return;
+    {
+        // nothing to write, the host file is closed with the handle
+        const std::lock_guard<std::mutex> lock(write_back->mutex);
+        if (write_back->extents.empty())
+            return;
+    }
+
+    WriteBackState &state = *write_back->state;
+    const std::lock_guard<std::mutex> lock(state.mutex);
+    // the destructor of the stream writes it once the handle is gone
+    if (state.exiting)
+        return;
+    start_write_back(state);
+    state.pending_paths[write_back->path]++;
+    state.closed.push_back(write_back);
+    state.cond.notify_one();
+}
+
+// only whole elements are read, like fread
+static size_t element_read_size(const SceOff pos, const uint64_t file_size, const int element_size, const SceSize element_count) {
+    if (pos < 0 || static_cast<uint64_t>(pos) >= file_size)
+        return 0;
+    return std::min<uint64_t>(element_count, (file_size - pos) / element_size) * element_size;
+}
+
+SceOff FileStats::read_impl(void *input_data, const int element_size, const SceSize element_count) const {
+    if (mapped_file)
+        return read_mapped_file(*mapped_file, input_data, element_size, element_count);
+    if (read_ahead)
+        return read_read_ahead(*read_ahead, input_data, element_size, element_count);
+    if (psarc_file) {
+        const SceOff read_size = read_psarc_file(*psarc_file, input_data, element_read_size(psarc_file->pos, get_psarc_file_size(*psarc_file), element_size, element_count));
+        return read_size < 0 ? -1 : read_size / element_size;
+    }
+    if (zip_file) {
+        const SceOff read_size = read_zip_file(*zip_file, input_data, element_read_size(zip_file->pos, get_zip_file_size(*zip_file), element_size, element_count));
+        return read_size < 0 ? -1 : read_size / element_size;
+    }
+    if (write_back) {
+        bool flushed;
+        {
+            // only the data read has to be written first
+            const std::lock_guard<std::mutex> lock(write_back->mutex);
+            const SceOff end = write_back->pos + static_cast<SceOff>(element_size) * element_count;
+            flushed = overlaps_write_back(*write_back, write_back->pos, end);
+        }
+        if (flushed)
+            flush_write_back(*write_back);
+
+        size_t read_count = 0;
+        while (true) {
+            {
+                const std::lock_guard<std::mutex> file_lock(write_back->file_mutex);
+                const std::lock_guard<std::mutex> lock(write_back->mutex);
+                FILE *file = write_back->file.get();
+                if (!seek_host_file(file, write_back->pos, SEEK_SET))
+                    return read_count;
+                const size_t count = fread(static_cast<uint8_t *>(input_data) + read_count * element_size, element_size, element_count - read_count, file);
+                read_count += count;
+                write_back->pos += static_cast<SceOff>(count) * element_size;
+                // the end of the host file is before the data still buffered
+                if (read_count == element_count || flushed || write_back->extents.empty())
+                    return read_count;
+            }
+            flush_write_back(*write_back);
+            flushed = true;
+        }
+    }
     if (!wrapped_file)
         return -1;
 
     return fread(input_data, element_size, element_count, wrapped_file.get());
 }
 
-SceOff FileStats::write(const void *data, const SceSize size, const int count) const {
+SceOff FileStats::write_impl(const void *data, const SceSize size, const int count) const {
     if (!can_write_file())
         return -1;
+    if (write_back)
+        return write_write_back(*write_back, data, static_cast<size_t>(size) * count) / size;
 
     return fwrite(data, size, count, get_file_pointer());
 }
 
 int FileStats::truncate(const SceSize size) const {
+    if (!can_write_file())
+        return -1;
+    std::unique_lock<std::mutex> file_lock;
+    if (write_back) {
+        // the buffered data could be written past the new end
+        flush_write_back(*write_back);
+        file_lock = std::unique_lock<std::mutex>(write_back->file_mutex);
+    }
+
 #ifdef _WIN32
     return _chsize_s(_fileno(get_file_pointer()), size);
 #else
@@ -48,7 +634,74 @@ int FileStats::truncate(const SceSize size) const {
 #endif
 }
 
-bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
+// seek in a file whose size is known, without host file
+static bool seek_memory_file(SceOff &pos, const uint64_t size, const SceOff offset, const SceIoSeekMode seek_mode) {
+    SceOff base = 0;
+    switch (seek_mode) {
+    case SCE_SEEK_SET:
+        break;
+    case SCE_SEEK_CUR:
+        base = pos;
+        break;
+    case SCE_SEEK_END:
+        base = static_cast<SceOff>(size);
+        break;
+    default:
+        return false;
+    }
+
+    // same as fseek, the position can go past the end of the file but not before its start
+    if (base + offset < 0)
+        return false;
+    pos = base + offset;
+    return true;
+}
+
+bool FileStats::seek_impl(const SceOff offset, const SceIoSeekMode seek_mode) const {
+    if (mapped_file)
+        return seek_memory_file(mapped_file->pos, mapped_file->file.size(), offset, seek_mode);
+    if (psarc_file)
+        return seek_memory_file(psarc_file->pos, get_psarc_file_size(*psarc_file), offset, seek_mode);
+    if (zip_file)
+        return seek_memory_file(zip_file->pos, get_zip_file_size(*zip_file), offset, seek_mode);
+
+    if (write_back) {
+        // the size is only needed to seek from the end
+        const SceOff size = seek_mode == SCE_SEEK_END ? get_write_back_size(*write_back) : 0;
+        if (size < 0)
+            return false;
+        const std::lock_guard<std::mutex> lock(write_back->mutex);
+        return seek_memory_file(write_back->pos, size, offset, seek_mode);
+    }
+
+    if (read_ahead) {
+        SceOff base = 0;
+        switch (seek_mode) {
+        case SCE_SEEK_SET:
+            break;
+        case SCE_SEEK_CUR: {
+            const std::lock_guard<std::mutex> lock(read_ahead->mutex);
+            base = read_ahead->pos;
+            break;
+        }
+        case SCE_SEEK_END: {
+            const std::lock_guard<std::mutex> file_lock(read_ahead->file_mutex);
+            if (!seek_host_file(read_ahead->file.get(), 0, SEEK_END))
+                return false;
+            base = tell_host_file(read_ahead->file.get());
+            break;
+        }
+        default:
+            return false;
+        }
+
+        if (base + offset < 0)
+            return false;
+        const std::lock_guard<std::mutex> lock(read_ahead->mutex);
+        read_ahead->pos = base + offset;
+        return true;
+    }
+
     if (!wrapped_file)
         return false;
 
@@ -67,20 +720,66 @@ bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
         return false;
     }
 
-#ifdef _WIN32
-    return _fseeki64(wrapped_file.get(), offset, base) == 0;
-#else
-    return fseeko(wrapped_file.get(), offset, base) == 0;
-#endif
+    return seek_host_file(wrapped_file.get(), offset, base);
 }
 
-SceOff FileStats::tell() const {
+SceOff FileStats::tell_impl() const {
+    if (mapped_file)
+        return mapped_file->pos;
+    if (read_ahead) {
+        const std::lock_guard<std::mutex> lock(read_ahead->mutex);
+        return read_ahead->pos;
+    }
+    if (psarc_file)
+        return psarc_file->pos;
+    if (zip_file)
+        return zip_file->pos;
+    if (write_back) {
+        const std::lock_guard<std::mutex> lock(write_back->mutex);
+        return write_back->pos;
+    }
     if (!wrapped_file)
         return -1;
 
-#ifdef _WIN32
-    return _ftelli64(wrapped_file.get());
-#else
-    return ftello(wrapped_file.get());
-#endif
+    return tell_host_file(wrapped_file.get());
+}
+
+SceOff FileStats::read(void *input_data, const int element_size, const SceSize element_count) const {
+    const std::lock_guard<std::mutex> lock(*position_mutex);
+    return read_impl(input_data, element_size, element_count);
+}
+
+SceOff FileStats::write(const void *data, const SceSize size, const int count) const {
+    const std::lock_guard<std::mutex> lock(*position_mutex);
+    return write_impl(data, size, count);
+}
+
+bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
+    const std::lock_guard<std::mutex> lock(*position_mutex);
+    return seek_impl(offset, seek_mode);
+}
+
+SceOff FileStats::tell() const {
+    const std::lock_guard<std::mutex> lock(*position_mutex);
+    return tell_impl();
+}
+
+SceOff FileStats::pread(void *data, const SceSize size, const SceOff offset) const {
+    const std::lock_guard<std::mutex> lock(*position_mutex);
+    const SceOff pos = tell_impl();
+    if (pos < 0 || !seek_impl(offset, SCE_SEEK_SET))
+        return -1;
+    const SceOff read = read_impl(data, 1, size);
+    seek_impl(pos, SCE_SEEK_SET);
+    return read;
+}
+
+SceOff FileStats::pwrite(const void *data, const SceSize size, const SceOff offset) const {
+    const std::lock_guard<std::mutex> lock(*position_mutex);
+    const SceOff pos = tell_impl();
+    if (pos < 0 || !seek_impl(offset, SCE_SEEK_SET))
+        return -1;
+    const SceOff written = write_impl(data, 1, size);
+    seek_impl(pos, SCE_SEEK_SET);
+    return written;
 }
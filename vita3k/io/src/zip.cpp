@@ -0,0 +1,428 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/zip.h>
+
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+
+constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034B50;
+constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014B50;
+constexpr uint32_t END_OF_CENTRAL_DIR_SIGNATURE = 0x06054B50;
+constexpr uint32_t ZIP64_END_OF_CENTRAL_DIR_SIGNATURE = 0x06064B50;
+constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064B50;
+constexpr size_t LOCAL_HEADER_SIZE = 30;
+constexpr size_t CENTRAL_HEADER_SIZE = 46;
+constexpr size_t END_OF_CENTRAL_DIR_SIZE = 22;
+constexpr size_t ZIP64_END_OF_CENTRAL_DIR_SIZE = 56;
+constexpr size_t ZIP64_LOCATOR_SIZE = 20;
+constexpr uint16_t ZIP64_EXTRA_ID = 0x0001;
+constexpr uint16_t METHOD_STORED = 0;
+constexpr uint16_t METHOD_DEFLATED = 8;
+constexpr uint16_t FLAG_ENCRYPTED = 0x1;
+// the inflate stream takes its input in chunks of this size at most
+constexpr uint64_t MAX_INFLATE_INPUT = 1024 * 1024 * 1024;
+
+const std::string PARAM_SFO_PATH = "sce_sys/param.sfo";
+
+struct ZipInflater {
+    mz_stream stream{};
+    // compressed bytes given to the stream
+    uint64_t in_offset = 0;
+    // index of the block the stream inflates next
+    uint32_t next_block = 0;
+
+    ZipInflater() = default;
+    ZipInflater(const ZipInflater &) = delete;
+    ZipInflater &operator=(const ZipInflater &) = delete;
+    ~ZipInflater() {
+        mz_inflateEnd(&stream);
+    }
+};
+
+// the integers of the archive are little endian
+static uint64_t read_le(const uint8_t *data, const size_t size) {
+    uint64_t value = 0;
+    for (size_t i = size; i > 0; i--)
+        value = (value << 8) | data[i - 1];
+    return value;
+}
+
+struct CentralDirectory {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t entry_count;
+};
+
+static bool find_central_directory(const MappedFile &file, CentralDirectory &dir) {
+    const uint8_t *data = file.data();
+    const size_t size = file.size();
+    if (size < END_OF_CENTRAL_DIR_SIZE)
+        return false;
+
+    // the end of central directory record is followed by a comment of 64 KiB at most
+    const size_t min_offset = size > END_OF_CENTRAL_DIR_SIZE + 0xFFFF ? size - END_OF_CENTRAL_DIR_SIZE - 0xFFFF : 0;
+    size_t offset = size - END_OF_CENTRAL_DIR_SIZE;
+    while (read_le(data + offset, 4) != END_OF_CENTRAL_DIR_SIGNATURE) {
+        if (offset == min_offset)
+            return false;
+        offset--;
+    }
+
+    dir.entry_count = read_le(data + offset + 10, 2);
+    dir.size = read_le(data + offset + 12, 4);
+    dir.offset = read_le(data + offset + 16, 4);
+
+    // the archives of more than 4 GiB or 65535 entries have their values in the zip64 record
+    if (offset >= ZIP64_LOCATOR_SIZE && read_le(data + offset - ZIP64_LOCATOR_SIZE, 4) == ZIP64_LOCATOR_SIGNATURE) {
+        const uint64_t record_offset = read_le(data + offset - ZIP64_LOCATOR_SIZE + 8, 8);
+        if (record_offset + ZIP64_END_OF_CENTRAL_DIR_SIZE > size || read_le(data + record_offset, 4) != ZIP64_END_OF_CENTRAL_DIR_SIGNATURE)
+            return false;
+
+        dir.entry_count = read_le(data + record_offset + 32, 8);
+        dir.size = read_le(data + record_offset + 40, 8);
+        dir.offset = read_le(data + record_offset + 48, 8);
+    }
+
+    return dir.offset + dir.size <= size;
+}
+
+// the values too large for the central header are in its zip64 extra field, in this order
+static void read_zip64_extra(const uint8_t *extra, const size_t extra_size, uint64_t &size, uint64_t &compressed_size, uint64_t &local_offset) {
+    size_t pos = 0;
+    while (pos + 4 <= extra_size) {
+        const uint16_t id = static_cast<uint16_t>(read_le(extra + pos, 2));
+        const uint16_t field_size = static_cast<uint16_t>(read_le(extra + pos + 2, 2));
+        pos += 4;
+        if (pos + field_size > extra_size)
+            return;
+
+        if (id == ZIP64_EXTRA_ID) {
+            size_t field_pos = pos;
+            for (uint64_t *value : { &size, &compressed_size, &local_offset }) {
+                if (*value != 0xFFFFFFFF)
+                    continue;
+                if (field_pos + 8 > pos + field_size)
+                    return;
+                *value = read_le(extra + field_pos, 8);
+                field_pos += 8;
+            }
+            return;
+        }
+        pos += field_size;
+    }
+}
+
+static void add_zip_dirs(std::map<std::string, std::set<std::string>> &dirs, const std::string &path) {
+    std::string dir = path;
+    while (!dir.empty()) {
+        const size_t separator = dir.rfind('/');
+        const std::string parent = separator == std::string::npos ? "" : dir.substr(0, separator);
+        const bool added = dirs[parent].insert(dir.substr(separator + 1)).second;
+        dirs.emplace(dir, std::set<std::string>{});
+        if (!added)
+            return;
+        dir = parent;
+    }
+}
+
+static bool read_central_directory(ZipArchive &archive) {
+    CentralDirectory central_dir;
+    if (!find_central_directory(archive.file, central_dir))
+        return false;
+
+    struct NamedEntry {
+        std::string name;
+        ZipEntry entry;
+    };
+    std::vector<NamedEntry> named_entries;
+    const uint8_t *data = archive.file.data();
+    const size_t file_size = archive.file.size();
+    uint64_t offset = central_dir.offset;
+    const uint64_t end = central_dir.offset + central_dir.size;
+    for (uint64_t i = 0; i < central_dir.entry_count; i++) {
+        if (offset + CENTRAL_HEADER_SIZE > end || read_le(data + offset, 4) != CENTRAL_HEADER_SIGNATURE)
+            return false;
+
+        const uint8_t *header = data + offset;
+        const uint16_t flags = static_cast<uint16_t>(read_le(header + 8, 2));
+        const uint16_t method = static_cast<uint16_t>(read_le(header + 10, 2));
+        uint64_t compressed_size = read_le(header + 20, 4);
+        uint64_t size = read_le(header + 24, 4);
+        const size_t name_size = read_le(header + 28, 2);
+        const size_t extra_size = read_le(header + 30, 2);
+        const size_t comment_size = read_le(header + 32, 2);
+        uint64_t local_offset = read_le(header + 42, 4);
+        offset += CENTRAL_HEADER_SIZE + name_size + extra_size + comment_size;
+        if (offset > end)
+            return false;
+
+        std::string name(reinterpret_cast<const char *>(header + CENTRAL_HEADER_SIZE), name_size);
+        string_utils::replace(name, "\\", "/");
+        read_zip64_extra(header + CENTRAL_HEADER_SIZE + name_size, extra_size, size, compressed_size, local_offset);
+        if (name.empty() || name.back() == '/') {
+            named_entries.push_back({ name, {} });
+            continue;
+        }
+        if ((flags & FLAG_ENCRYPTED) || (method != METHOD_STORED && method != METHOD_DEFLATED)) {
+            LOG_WARN("Skipping {} of {}, it is encrypted or compressed with an unsupported method ({})", name, archive.path.string(), method);
+            continue;
+        }
+
+        // the size of the extra field of the local header may differ from the central one
+        if (local_offset + LOCAL_HEADER_SIZE > file_size || read_le(data + local_offset, 4) != LOCAL_HEADER_SIGNATURE)
+            return false;
+        const uint64_t data_offset = local_offset + LOCAL_HEADER_SIZE + read_le(data + local_offset + 26, 2) + read_le(data + local_offset + 28, 2);
+        if (data_offset + compressed_size > file_size || (method == METHOD_STORED && compressed_size != size))
+            return false;
+
+        named_entries.push_back({ name, { data_offset, compressed_size, size, method == METHOD_DEFLATED } });
+    }
+
+    // the content of the app may be in a directory of the archive, the shortest path to a param.sfo gives it
+    const auto sfo = std::min_element(named_entries.begin(), named_entries.end(), [](const NamedEntry &a, const NamedEntry &b) {
+        const bool a_is_sfo = a.name.ends_with(PARAM_SFO_PATH);
+        const bool b_is_sfo = b.name.ends_with(PARAM_SFO_PATH);
+        return a_is_sfo != b_is_sfo ? a_is_sfo : a.name.size() < b.name.size();
+    });
+    if (sfo == named_entries.end() || !sfo->name.ends_with(PARAM_SFO_PATH))
+        return false;
+    archive.root = sfo->name.substr(0, sfo->name.size() - PARAM_SFO_PATH.size());
+    if (!archive.root.empty() && archive.root.back() != '/')
+        return false;
+
+    std::map<std::string, std::set<std::string>> dirs;
+    dirs[""];
+    for (NamedEntry &named_entry : named_entries) {
+        if (!named_entry.name.starts_with(archive.root))
+            continue;
+        std::string path = named_entry.name.substr(archive.root.size());
+        const bool is_dir = path.empty() || path.back() == '/';
+        while (!path.empty() && path.back() == '/')
+            path.pop_back();
+        if (path.empty())
+            continue;
+
+        add_zip_dirs(dirs, path);
+        if (is_dir)
+            continue;
+
+        archive.lowercase_files.emplace(string_utils::tolower(path), archive.entries.size());
+        archive.files.emplace(std::move(path), archive.entries.size());
+        archive.entries.push_back(named_entry.entry);
+    }
+
+    for (auto &[path, names] : dirs) {
+        // files are not directories
+        if (archive.files.contains(path))
+            continue;
+        archive.lowercase_dirs.emplace(string_utils::tolower(path), path);
+        archive.dirs.emplace(path, std::make_shared<const std::vector<std::string>>(names.begin(), names.end()));
+    }
+
+    return true;
+}
+
+ZipArchivePtr open_zip_archive(const fs::path &path) {
+    const ZipArchivePtr archive = std::make_shared<ZipArchive>();
+    archive->path = path;
+    if (!archive->file.open(path)) {
+        LOG_ERROR("Could not open archive {}", path.string());
+        return nullptr;
+    }
+    if (!read_central_directory(*archive)) {
+        LOG_ERROR("Could not read the central directory of {}, or it does not hold an app", path.string());
+        return nullptr;
+    }
+
+    LOG_INFO("Opened archive {} ({} files)", path.string(), archive->entries.size());
+    return archive;
+}
+
+ZipFileStreamPtr open_zip_file(const ZipArchivePtr &archive, const std::string &path, const bool case_insensitive) {
+    auto file = archive->files.find(path);
+    if (file == archive->files.end() && case_insensitive) {
+        file = archive->lowercase_files.find(string_utils::tolower(path));
+        if (file == archive->lowercase_files.end())
+            return nullptr;
+    } else if (file == archive->files.end()) {
+        return nullptr;
+    }
+
+    return std::make_shared<ZipFileStream>(ZipFileStream{ archive, file->second, 0, nullptr });
+}
+
+std::shared_ptr<const std::vector<std::string>> get_zip_dir(const ZipArchive &archive, const std::string &path, const bool case_insensitive) {
+    auto dir = archive.dirs.find(path);
+    if (dir == archive.dirs.end() && case_insensitive) {
+        const auto lowercase_dir = archive.lowercase_dirs.find(string_utils::tolower(path));
+        if (lowercase_dir == archive.lowercase_dirs.end())
+            return nullptr;
+        dir = archive.dirs.find(lowercase_dir->second);
+    }
+
+    return dir == archive.dirs.end() ? nullptr : dir->second;
+}
+
+uint64_t get_zip_file_size(const ZipFileStream &stream) {
+    return stream.archive->entries[stream.entry].size;
+}
+
+static uint64_t block_key(const size_t entry, const uint32_t block) {
+    return (static_cast<uint64_t>(entry) << 32) | block;
+}
+
+static ZipBlock find_cached_block(ZipArchive &archive, const uint64_t key) {
+    const std::lock_guard<std::mutex> lock(archive.cache_mutex);
+    const auto cached = archive.blocks.find(key);
+    if (cached == archive.blocks.end())
+        return nullptr;
+
+    archive.lru.splice(archive.lru.begin(), archive.lru, cached->second);
+    return cached->second->second;
+}
+
+static void cache_block(ZipArchive &archive, const uint64_t key, const ZipBlock &block) {
+    const std::lock_guard<std::mutex> lock(archive.cache_mutex);
+    if (archive.blocks.contains(key))
+        return;
+
+    while (!archive.lru.empty() && archive.cache_size + block->size() > ZipArchive::MAX_CACHE_SIZE) {
+        archive.cache_size -= archive.lru.back().second->size();
+        archive.blocks.erase(archive.lru.back().first);
+        archive.lru.pop_back();
+    }
+    archive.lru.emplace_front(key, block);
+    archive.blocks.emplace(key, archive.lru.begin());
+    archive.cache_size += block->size();
+}
+
+// inflates the next block of the stream, returns nullptr if the data is invalid
+static ZipBlock inflate_next_block(const ZipArchive &archive, const ZipEntry &entry, ZipInflater &inflater) {
+    const uint64_t block_start = static_cast<uint64_t>(inflater.next_block) * ZipArchive::BLOCK_SIZE;
+    const auto block = std::make_shared<std::vector<uint8_t>>(std::min<uint64_t>(ZipArchive::BLOCK_SIZE, entry.size - block_start));
+    mz_stream &stream = inflater.stream;
+    stream.next_out = block->data();
+    stream.avail_out = static_cast<unsigned int>(block->size());
+    while (stream.avail_out > 0) {
+        if (stream.avail_in == 0 && inflater.in_offset < entry.compressed_size) {
+            const uint64_t input_size = std::min(entry.compressed_size - inflater.in_offset, MAX_INFLATE_INPUT);
+            stream.next_in = archive.file.data() + entry.data_offset + inflater.in_offset;
+            stream.avail_in = static_cast<unsigned int>(input_size);
+            inflater.in_offset += input_size;
+        }
+
+        const int status = mz_inflate(&stream, MZ_NO_FLUSH);
+        if (status == MZ_STREAM_END)
+            break;
+        if (status != MZ_OK)
+            return nullptr;
+    }
+    if (stream.avail_out > 0)
+        return nullptr;
+
+    inflater.next_block++;
+    return block;
+}
+
+static ZipBlock get_inflated_block(ZipFileStream &stream, const uint32_t block) {
+    ZipArchive &archive = *stream.archive;
+    const ZipEntry &entry = archive.entries[stream.entry];
+    const uint64_t key = block_key(stream.entry, block);
+    if (ZipBlock cached = find_cached_block(archive, key))
+        return cached;
+
+    // deflate streams cannot be seeked, the block has to be reached from the start of the entry
+    if (!stream.inflater || stream.inflater->next_block > block) {
+        stream.inflater = std::make_shared<ZipInflater>();
+        if (mz_inflateInit2(&stream.inflater->stream, -MZ_DEFAULT_WINDOW_BITS) != MZ_OK) {
+            stream.inflater.reset();
+            return nullptr;
+        }
+    }
+
+    while (true) {
+        const uint32_t index = stream.inflater->next_block;
+        const ZipBlock inflated = inflate_next_block(archive, entry, *stream.inflater);
+        if (!inflated) {
+            LOG_ERROR("Could not inflate block {} of entry {} of {}", index, stream.entry, archive.path.string());
+            stream.inflater.reset();
+            return nullptr;
+        }
+
+        cache_block(archive, block_key(stream.entry, index), inflated);
+        if (index == block)
+            return inflated;
+    }
+}
+
+SceOff read_zip_file(ZipFileStream &stream, void *data, size_t size) {
+    const ZipArchive &archive = *stream.archive;
+    const ZipEntry &entry = archive.entries[stream.entry];
+    if (stream.pos < 0 || static_cast<uint64_t>(stream.pos) >= entry.size || size == 0)
+        return 0;
+
+    size = std::min<uint64_t>(size, entry.size - stream.pos);
+    if (!entry.deflated) {
+        memcpy(data, archive.file.data() + entry.data_offset + stream.pos, size);
+        stream.pos += size;
+        return size;
+    }
+
+    uint8_t *dst = static_cast<uint8_t *>(data);
+    size_t copied = 0;
+    while (copied < size) {
+        const uint64_t pos = stream.pos + copied;
+        const ZipBlock block = get_inflated_block(stream, static_cast<uint32_t>(pos / ZipArchive::BLOCK_SIZE));
+        if (!block)
+            return -1;
+
+        const size_t block_offset = pos % ZipArchive::BLOCK_SIZE;
+        const size_t copy_size = std::min(size - copied, block->size() - block_offset);
+        memcpy(dst + copied, block->data() + block_offset, copy_size);
+        copied += copy_size;
+    }
+    stream.pos += copied;
+
+    return copied;
+}
+
+static std::mutex app_archives_mutex;
+static std::map<std::string, ZipArchivePtr> app_archives;
+
+void register_app_archive(const std::string &app_path, ZipArchivePtr archive) {
+    const std::lock_guard<std::mutex> lock(app_archives_mutex);
+    app_archives[app_path] = std::move(archive);
+}
+
+void unregister_app_archive(const std::string &app_path) {
+    const std::lock_guard<std::mutex> lock(app_archives_mutex);
+    app_archives.erase(app_path);
+}
+
+ZipArchivePtr find_app_archive(const std::string &app_path) {
+    const std::lock_guard<std::mutex> lock(app_archives_mutex);
+    const auto archive = app_archives.find(app_path);
+    return archive == app_archives.end() ? nullptr : archive->second;
+}
@@ -0,0 +1,217 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+// Replays the file accesses recorded with --io-trace against the io layer, with and without its caches,
+// and reports the time taken by each kind of access.
+
+#include <io/functions.h>
+#include <io/io_trace.h>
+#include <io/state.h>
+#include <io/util.h>
+#include <util/fs.h>
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+constexpr const char *EXPORT_NAME = "vita3k-io-bench";
+
+struct OpStats {
+    uint64_t count = 0;
+    uint64_t errors = 0;
+    uint64_t time_ns = 0;
+};
+
+struct ReplayResult {
+    std::array<OpStats, IO_TRACE_OP_COUNT> ops;
+    uint64_t bytes_read = 0;
+    uint64_t total_ns = 0;
+    // the files opened for writing and the accesses to them are not replayed
+    uint64_t skipped = 0;
+};
+
+static ReplayResult replay(const IoTrace &trace, const std::wstring &pref_path, const bool caches_enabled) {
+    IOState io;
+    io.device_paths = { trace.app0, trace.savedata0, trace.addcont0 };
+    io.case_isens_find_enabled = trace.case_isens_find_enabled;
+    io.caches_enabled = caches_enabled;
+    io.redirect_stdio = false;
+
+    // by the fd given when recording
+    std::map<SceUID, SceUID> fds;
+    const auto find_fd = [&](const SceUID recorded_fd, SceUID &fd) {
+        const auto it = fds.find(recorded_fd);
+        if (it == fds.end())
+            return false;
+        fd = it->second;
+        return true;
+    };
+
+    ReplayResult result;
+    std::vector<uint8_t> buffer;
+    for (const IoTraceRecord &record : trace.records) {
+        SceUID fd = invalid_fd;
+        if (record.fd != invalid_fd && !find_fd(record.fd, fd)) {
+            result.skipped++;
+            continue;
+        }
+        if (record.op == IoTraceOp::OpenFile && can_write(static_cast<int>(record.arg))) {
+            result.skipped++;
+            continue;
+        }
+
+        int64_t ret = 0;
+        const auto start = std::chrono::steady_clock::now();
+        switch (record.op) {
+        case IoTraceOp::OpenFile:
+            ret = open_file(io, record.path.c_str(), static_cast<int>(record.arg), pref_path, EXPORT_NAME);
+            break;
+        case IoTraceOp::ReadFile:
+            buffer.resize(std::max<size_t>(buffer.size(), record.arg));
+            ret = read_file(buffer.data(), io, fd, static_cast<SceSize>(record.arg), EXPORT_NAME);
+            break;
+        case IoTraceOp::SeekFile:
+            ret = seek_file(fd, record.arg, static_cast<SceIoSeekMode>(record.arg2), io, EXPORT_NAME);
+            break;
+        case IoTraceOp::StatFile: {
+            SceIoStat stat;
+            ret = stat_file(io, record.path.c_str(), &stat, pref_path, EXPORT_NAME, fd);
+            break;
+        }
+        case IoTraceOp::CloseFile:
+            ret = close_file(io, fd, EXPORT_NAME);
+            break;
+        case IoTraceOp::OpenDir:
+            ret = open_dir(io, record.path.c_str(), pref_path, EXPORT_NAME);
+            break;
+        case IoTraceOp::ReadDir: {
+            SceIoDirent dirent;
+            ret = read_dir(io, fd, &dirent, pref_path, EXPORT_NAME);
+            break;
+        }
+        case IoTraceOp::CloseDir:
+            ret = close_dir(io, fd, EXPORT_NAME);
+            break;
+        default:
+            break;
+        }
+        const uint64_t time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        OpStats &stats = result.ops[static_cast<size_t>(record.op)];
+        stats.count++;
+        stats.time_ns += time_ns;
+        result.total_ns += time_ns;
+        // an access failing in the trace is expected to fail again
+        if ((ret < 0) != (record.result < 0))
+            stats.errors++;
+
+        if (record.op == IoTraceOp::ReadFile && ret > 0)
+            result.bytes_read += ret;
+        if ((record.op == IoTraceOp::OpenFile || record.op == IoTraceOp::OpenDir) && ret >= 0 && record.result >= 0)
+            fds[static_cast<SceUID>(record.result)] = static_cast<SceUID>(ret);
+        if (record.op == IoTraceOp::CloseFile || record.op == IoTraceOp::CloseDir)
+            fds.erase(record.fd);
+    }
+
+    return result;
+}
+
+static void print_result(const char *mode, const int iteration, const ReplayResult &result) {
+    const double total_ms = result.total_ns / 1e6;
+    std::cout << fmt::format("{} #{}: {:.2f} ms, {:.1f} MiB read ({:.1f} MiB/s), {} accesses skipped\n", mode, iteration, total_ms,
+        result.bytes_read / 1048576.0, total_ms > 0 ? result.bytes_read / 1048576.0 / (total_ms / 1000.0) : 0.0, result.skipped);
+    for (size_t i = 0; i < IO_TRACE_OP_COUNT; i++) {
+        const OpStats &stats = result.ops[i];
+        if (stats.count == 0)
+            continue;
+        std::cout << fmt::format("  {:<12} {:>8} calls {:>10.2f} ms {:>8.2f} us per call{}\n", get_io_trace_op_name(static_cast<IoTraceOp>(i)), stats.count,
+            stats.time_ns / 1e6, stats.time_ns / 1e3 / stats.count, stats.errors > 0 ? fmt::format(", {} results differ from the trace", stats.errors) : "");
+    }
+}
+
+static void print_usage() {
+    std::cout << "Usage: vita3k-io-bench <trace file> --pref-path <dir> [options]\n"
+              << "Replays the file accesses recorded with vita3k --io-trace against the io layer, with and without its caches.\n"
+              << "The files opened for writing are skipped, the emulated storage is only read.\n"
+              << "  --pref-path <dir>         Vita3K storage folder holding ux0, vs0..., the one the trace was recorded with\n"
+              << "  --iterations <n>          Replays of each mode, 3 by default, the first one also warms the host file cache\n"
+              << "  --cached                  Only replay with the caches\n"
+              << "  --uncached                Only replay without the caches\n"
+              << "  --verbose                 Log the errors of the io layer\n";
+}
+
+int main(int argc, char *argv[]) {
+    fs::path trace_path;
+    fs::path pref_path;
+    int iterations = 3;
+    bool run_cached = true;
+    bool run_uncached = true;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--pref-path" && has_value)
+            pref_path = fs::path(string_utils::utf_to_wide(argv[++i]));
+        else if (arg == "--iterations" && has_value)
+            iterations = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--cached")
+            run_uncached = false;
+        else if (arg == "--uncached")
+            run_cached = false;
+        else if (arg == "--verbose")
+            verbose = true;
+        else if (trace_path.empty() && !arg.starts_with("--"))
+            trace_path = fs::path(string_utils::utf_to_wide(arg));
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (trace_path.empty() || pref_path.empty() || (!run_cached && !run_uncached)) {
+        print_usage();
+        return 1;
+    }
+
+    logging::set_level(verbose ? spdlog::level::err : spdlog::level::off);
+
+    IoTrace trace;
+    if (!load_io_trace(trace_path, trace)) {
+        std::cerr << "Could not read the IO trace " << trace_path.string() << "\n";
+        return 1;
+    }
+    std::cout << fmt::format("{} accesses recorded over {:.2f} s\n", trace.records.size(), trace.records.empty() ? 0.0 : trace.records.back().timestamp_ns / 1e9);
+
+    const std::wstring pref_path_str = pref_path.wstring();
+    for (int i = 1; i <= iterations; i++) {
+        if (run_uncached)
+            print_result("uncached", i, replay(trace, pref_path_str, false));
+        if (run_cached)
+            print_result("cached", i, replay(trace, pref_path_str, true));
+    }
+
+    return 0;
+}
@@ -130,4 +130,4 @@ private:
 };
 
 typedef std::shared_ptr<Callback> CallbackPtr;
-uint32_t process_callbacks(KernelState &kernel, SceUID thread_id);
+uint32_t process_callbacks(KernelState &kernel, const ThreadStatePtr &thread);
@@ -20,15 +20,24 @@
 #include <cpu/common.h>
 
 struct KernelState;
+struct ThreadState;
 
-typedef std::function<void(CPUState &cpu, uint32_t nid, SceUID thread_id)> CallImportFunc;
+typedef std::shared_ptr<ThreadState> ThreadStatePtr;
+
+// set in the svc immediate of the import stubs resolved to an HLE function, the lower bits are its import_index
+constexpr uint32_t HLE_IMPORT_SVC = 0x800000;
+
+typedef std::function<void(CPUState &cpu, uint32_t nid, uint32_t import_index, const ThreadStatePtr &thread)> CallImportFunc;
 
 struct CPUProtocol : public CPUProtocolBase {
     CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func);
     ~CPUProtocol() override = default;
     void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) override;
     Address get_watch_memory_addr(Address addr) override;
+    uint8_t **get_watch_page_table() override;
     ExclusiveMonitorPtr get_exlusive_monitor() override;
+    void block_translated(Address pc, bool thumb) override;
+    bool is_breakpoint(Address addr) override;
 
 private:
     CallImportFunc call_import;
@@ -16,6 +16,7 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #pragma once
+#include <atomic>
 #include <cpu/state.h>
 #include <map>
 #include <mem/state.h>
@@ -40,6 +41,7 @@ struct Trampoline {
 
 struct Breakpoint {
     bool thumb_mode;
+    // original code, only patched with a bkpt instruction for unicorn, dynarmic stops on the address itself
     unsigned char data[4];
 };
 
@@ -65,20 +67,30 @@ struct Debugger {
     bool log_exports = false;
     bool dump_elfs = false;
 
-    void add_watch_memory_addr(Address addr, size_t size);
-    void remove_watch_memory_addr(KernelState &state, Address addr);
+    void add_watch_memory_addr(MemState &mem, Address addr, size_t size);
+    void remove_watch_memory_addr(MemState &mem, Address addr);
     void add_breakpoint(MemState &mem, uint32_t addr, bool thumb_mode);
     void remove_breakpoint(MemState &mem, uint32_t addr);
-    void add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, TrampolineCallback callback);
+    bool is_breakpoint(Address addr);
+    // when run_original is false the replaced instruction is not executed, the callback takes over the whole function
+    void add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, TrampolineCallback callback, bool run_original = true);
     Trampoline *get_trampoline(Address addr);
     void remove_trampoline(MemState &mem, uint32_t addr);
     Address get_watch_memory_addr(Address addr);
+    uint8_t **get_watch_page_table();
     void update_watches();
 
 private:
+    bool update_watch_page_table(MemState &mem);
+
     std::mutex mutex;
     KernelState &parent;
     WatchMemoryAddrs watch_memory_addrs;
+    // given to the jit instead of the fastmem pointer while memory is watched, it is never freed as the jits keep using it
+    std::unique_ptr<uint8_t *[]> watch_page_table;
+    bool use_watch_page_table = false;
     Breakpoints breakpoints;
+    // checked first for each translated instruction, to not lock the mutex when there is no breakpoint
+    std::atomic<bool> has_breakpoints = false;
     Trampolines trampolines;
 };
@@ -0,0 +1,68 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/ptr.h>
+#include <util/fs.h>
+#include <util/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+struct KernelState;
+
+struct GuestSample {
+    SceUID thread_id;
+    Address pc;
+    Address lr;
+
+    bool operator==(const GuestSample &other) const = default;
+};
+
+struct GuestSampleHash {
+    size_t operator()(const GuestSample &sample) const {
+        return std::hash<uint64_t>()((static_cast<uint64_t>(sample.pc) << 32) | sample.lr) ^ sample.thread_id;
+    }
+};
+
+// Periodically samples the pc and lr of the running guest threads, the report is written
+// in the folded stack format read by the flamegraph tools
+struct GuestProfiler {
+    fs::path path;
+    std::chrono::microseconds interval{ 1000 };
+
+    std::atomic<bool> running = false;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::unordered_map<GuestSample, uint64_t, GuestSampleHash> samples;
+    std::map<SceUID, std::string> thread_names;
+
+    ~GuestProfiler();
+};
+
+void init_guest_profiler(GuestProfiler &profiler, const fs::path &path);
+bool is_guest_profiler_running(const GuestProfiler &profiler);
+void start_guest_profiler(KernelState &kernel);
+// stops the sampling and writes the report of the samples taken since the profiler was started
+void stop_guest_profiler(KernelState &kernel);
@@ -0,0 +1,67 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct ThreadState;
+
+// Runs the guest code of at most 3 threads at once, like the user cores of the Vita.
+// A thread takes a core before entering the jit and gives it back when the jit returns, so at each svc:
+// the threads waiting in the HLE functions don't hold a core. A free core goes to the waiting thread
+// of highest priority allowed on it by its affinity mask, and a running thread of lower priority
+// is stopped to give its core to a thread of higher priority.
+struct GuestScheduler {
+    static constexpr int CORE_COUNT = 3;
+    // after waiting this long, a thread also takes the core of a thread of the same priority,
+    // so the threads spinning without any svc don't keep the others waiting forever
+    static constexpr std::chrono::milliseconds TIME_SLICE{ 10 };
+
+    struct Waiter {
+        ThreadState *thread;
+        int priority;
+        uint32_t core_mask;
+        // order of arrival between the waiters of the same priority
+        uint64_t order;
+        // -1 once given no core because the scheduler was stopped
+        int core = -1;
+        bool done = false;
+        std::condition_variable cond;
+    };
+
+    bool enabled = false;
+    std::mutex mutex;
+    // thread running guest code on each core, null if the core is free
+    std::array<ThreadState *, CORE_COUNT> core_threads{};
+    // set once the thread of the core was asked to stop, until it gives the core back
+    std::array<bool, CORE_COUNT> preempting{};
+    std::vector<Waiter *> waiters;
+    uint64_t next_order = 0;
+    bool stopped = false;
+};
+
+// block until a core is given to the thread, return it or -1 if the scheduler is disabled or stopped
+int acquire_guest_core(GuestScheduler &scheduler, ThreadState &thread);
+void release_guest_core(GuestScheduler &scheduler, int core);
+// give no core to the waiting threads and let all the threads run, for the exit of the app
+void stop_guest_scheduler(GuestScheduler &scheduler);
+void reset_guest_scheduler(GuestScheduler &scheduler);
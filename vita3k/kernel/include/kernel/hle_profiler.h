@@ -0,0 +1,59 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+#include <util/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct KernelState;
+struct ThreadState;
+
+// only written by the thread the counters belong to, relaxed atomics let the report read them at any time
+struct HleCallCounter {
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> total_ns = 0;
+    std::atomic<uint64_t> max_ns = 0;
+};
+
+struct HleThreadCounters {
+    SceUID thread_id;
+    std::string thread_name;
+    // indexed by import_index
+    std::unique_ptr<HleCallCounter[]> calls;
+};
+
+// Call count and host time of the HLE functions called by each thread, saved as CSV and JSON when the app exits
+struct HleProfiler {
+    std::atomic<bool> enabled = false;
+    // path of the reports, without extension
+    fs::path path;
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<HleThreadCounters>> threads;
+};
+
+void init_hle_profiler(HleProfiler &profiler, const fs::path &path, bool enabled);
+void record_hle_call(HleProfiler &profiler, ThreadState &thread, uint32_t import_index, std::chrono::steady_clock::duration duration);
+void save_hle_profile(HleProfiler &profiler);
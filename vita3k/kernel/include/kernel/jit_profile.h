@@ -0,0 +1,48 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/ptr.h>
+#include <util/fs.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+struct KernelState;
+
+// Entry points of the blocks translated by the jit, saved for each app so that the next boot
+// can translate them before the app runs instead of when the code is reached
+struct JitProfile {
+    bool enabled = false;
+    fs::path path;
+
+    // blocks translated by all the jits since the start, even if the profile is disabled
+    std::atomic<uint64_t> translated_block_count = 0;
+
+    std::mutex mutex;
+    // guest address of the block, bit 0 is set for thumb blocks
+    std::unordered_set<Address> translated_blocks;
+};
+
+void init_jit_profile(JitProfile &profile, const fs::path &path, bool enabled);
+void record_translated_block(JitProfile &profile, Address pc, bool thumb);
+// returns the blocks of the saved profile found in the loaded modules
+std::vector<Address> load_jit_profile(KernelState &kernel);
+void save_jit_profile(KernelState &kernel);
@@ -19,6 +19,7 @@
 
 #include <util/types.h>
 
+#include <cstddef>
 #include <string>
 
 struct Config;
@@ -27,4 +28,4 @@ struct MemState;
 template <class T>
 class Ptr;
 
-SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std::string &self_path, const std::string &dump_path);
+SceUID load_self(KernelState &kernel, MemState &mem, const void *self, size_t self_size, const std::string &self_path, const std::string &dump_path);
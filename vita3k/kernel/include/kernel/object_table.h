@@ -0,0 +1,105 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/lock_and_find.h>
+#include <util/types.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Table of kernel objects indexed by their uid, used to find them without taking the kernel lock.
+// The uids are never reused, so the uid stored in a slot tells if it holds the object looked up.
+// When the slot of an object is already used, it is only in the map, and the lookups fall back to it.
+template <typename T>
+class ObjectTable {
+public:
+    static constexpr size_t SLOT_COUNT = 4096;
+
+    ObjectTable()
+        : slots(std::make_unique<Slot[]>(SLOT_COUNT)) {}
+
+    void insert(SceUID uid, const std::shared_ptr<T> &object) {
+        Slot &slot = get_slot(uid);
+        const SlotLock lock(slot);
+        if (slot.object)
+            return;
+        slot.object = object;
+        slot.uid.store(uid, std::memory_order_release);
+    }
+
+    void erase(SceUID uid) {
+        Slot &slot = get_slot(uid);
+        const SlotLock lock(slot);
+        if (slot.uid.load(std::memory_order_relaxed) != uid)
+            return;
+        slot.uid.store(0, std::memory_order_relaxed);
+        slot.object.reset();
+    }
+
+    // returns nullptr if the object is not in the table, it may still be in the map
+    std::shared_ptr<T> find(SceUID uid) const {
+        Slot &slot = get_slot(uid);
+        if (slot.uid.load(std::memory_order_acquire) != uid)
+            return nullptr;
+        const SlotLock lock(slot);
+        if (slot.uid.load(std::memory_order_relaxed) != uid)
+            return nullptr;
+        return slot.object;
+    }
+
+private:
+    struct Slot {
+        std::atomic<SceUID> uid{ 0 };
+        // only held while the shared pointer is copied
+        std::atomic_flag busy;
+        std::shared_ptr<T> object;
+    };
+
+    struct SlotLock {
+        Slot &slot;
+
+        explicit SlotLock(Slot &slot)
+            : slot(slot) {
+            while (slot.busy.test_and_set(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+
+        ~SlotLock() {
+            slot.busy.clear(std::memory_order_release);
+        }
+    };
+
+    std::unique_ptr<Slot[]> slots;
+
+    Slot &get_slot(SceUID uid) const {
+        return slots[static_cast<uint32_t>(uid) % SLOT_COUNT];
+    }
+};
+
+// same as lock_and_find, but the objects in the table are found without taking the lock
+template <typename T>
+std::shared_ptr<T> lock_and_find(SceUID uid, const std::map<SceUID, std::shared_ptr<T>> &map, ProfiledMutex &mutex, const ObjectTable<T> &table,
+    const std::source_location &location = std::source_location::current()) {
+    if (std::shared_ptr<T> object = table.find(uid))
+        return object;
+    return lock_and_find(uid, map, mutex, location);
+}
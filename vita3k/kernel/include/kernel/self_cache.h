@@ -0,0 +1,42 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+#include <util/mapped_file.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+// Decompressed segments of a SELF, stored in the cache directory under the hash of the SELF file
+// so the segments of a module are only decompressed the first time it is loaded.
+struct SelfImage {
+    MappedFile file;
+    // index of the segment -> its decompressed content, in the mapping
+    std::map<uint16_t, std::span<const uint8_t>> segments;
+};
+
+// name of the cache file of the SELF, from the hash of its content
+std::string get_self_image_name(const void *self, size_t self_size);
+// return false if the image is not in the cache or is invalid
+bool open_self_image(SelfImage &image, const fs::path &cache_path, const std::string &name);
+void save_self_image(const fs::path &cache_path, const std::string &name, const std::map<uint16_t, std::vector<uint8_t>> &segments);
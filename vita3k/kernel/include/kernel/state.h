@@ -21,16 +21,25 @@
 #include <kernel/callback.h>
 #include <kernel/cpu_protocol.h>
 #include <kernel/debugger.h>
+#include <kernel/guest_profiler.h>
+#include <kernel/hle_profiler.h>
+#include <kernel/jit_profile.h>
+#include <kernel/object_table.h>
 #include <kernel/sync_primitives.h>
+#include <kernel/guest_scheduler.h>
+#include <kernel/timer_wheel.h>
 #include <kernel/types.h>
 #include <mem/allocator.h>
 #include <mem/ptr.h>
 #include <mem/util.h>
 #include <rtc/rtc.h>
 #include <util/containers.h>
+#include <util/fs.h>
+#include <util/lock_profiler.h>
 #include <util/pool.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <kernel/object_store.h>
 #include <map>
 #include <mutex>
@@ -83,6 +92,18 @@ struct CorenumAllocator {
     void free_corenum(const int num);
 };
 
+// Host threads of exited guest threads, parked until a new guest thread is created
+struct HostThreadPool {
+    std::mutex mutex;
+    std::condition_variable cond;
+    // guest threads given to a parked host thread which has not taken them yet
+    std::vector<SceUID> pending_threads;
+    // parked host threads not given a guest thread yet
+    std::size_t available_count = 0;
+    std::size_t parked_count = 0;
+    bool exiting = false;
+};
+
 struct late_binding_info {
     void *entries;
     uint32_t size;
@@ -91,12 +112,22 @@ struct late_binding_info {
 
 typedef std::multimap<uint32_t, late_binding_info> VarLateBindingInfos;
 
+// time spent in each phase of load_self, summed over the loaded modules
+struct ModuleLoadProfile {
+    // can be read without the mutex
+    std::atomic<uint32_t> module_count = 0;
+    uint64_t segments_us = 0;
+    uint64_t relocation_us = 0;
+    uint64_t exports_us = 0;
+    uint64_t imports_us = 0;
+};
+
 typedef std::map<uint32_t, uint32_t> ModuleUidByNid;
 
 struct KernelState {
     KernelState();
 
-    std::mutex mutex;
+    ProfiledMutex mutex{ "KernelState::mutex" };
     CodecEngineBlocks codec_blocks;
 
     Ptr<const void> tls_address = Ptr<const void>(0);
@@ -122,17 +153,58 @@ struct KernelState {
 
     ThreadStatePtrs threads;
 
+    // the objects used the most, also in their map, found without taking the kernel lock
+    ObjectTable<Semaphore> semaphore_table;
+    ObjectTable<Condvar> condvar_table;
+    ObjectTable<Condvar> lwcondvar_table;
+    ObjectTable<Mutex> mutex_table;
+    ObjectTable<Mutex> lwmutex_table;
+    ObjectTable<EventFlag> eventflag_table;
+    ObjectTable<ThreadState> thread_table;
+
     SceKernelModuleInfoPtrs loaded_modules;
+    // protected by mutex, like loaded_modules
+    ModuleLoadProfile module_load_profile;
     LoadedSysmodules loaded_sysmodules;
     LoadedInternalSysmodules loaded_internal_sysmodules;
     ExportNids export_nids;
     std::mutex export_nids_mutex;
+    // indexed by import_index, set when a loaded module exports a NID also implemented in HLE
+    std::vector<std::atomic<bool>> hle_import_exported;
     VarLateBindingInfos late_binding_infos;
     ModuleUidByNid module_uid_by_nid;
 
     bool cpu_opt;
+    // mask of CPUUnsafeOptimization enabled by the profile of the running title
+    uint32_t cpu_unsafe_optimizations = 0;
     CPUBackend cpu_backend;
+    // replace the libc routines found in the loaded modules by host implementations
+    bool hle_hot_routines = false;
+    // map the priority and the cpu affinity of the guest threads to their host threads
+    bool host_thread_priority = false;
+    bool host_thread_affinity = false;
+    // CPUs of exited threads, reused by new threads to skip their creation and keep the code their jit compiled
+    std::vector<CPUStatePtr> cpu_pool;
+    // also the number of host threads kept parked in host_thread_pool
+    std::size_t cpu_pool_size = 0;
+    HostThreadPool host_thread_pool;
+    // only used when enabled, the host threads of the guest threads are used otherwise
+    GuestScheduler guest_scheduler;
+    // directory of the decompressed segments of the loaded modules, the cache is not used when it is empty
+    fs::path self_cache_path;
     CorenumAllocator corenum_allocator;
+    JitProfile jit_profile;
+    GuestProfiler guest_profiler;
+    HleProfiler hle_profiler;
+    // host time spent by all the threads running the guest code and in the HLE functions, in nanoseconds
+    // only measured for the detailed performance overlay
+    std::atomic<bool> measure_host_time = false;
+    std::atomic<uint64_t> guest_cpu_ns = 0;
+    std::atomic<uint64_t> hle_ns = 0;
+    // timeouts of the waits and the timers
+    TimerWheel timer_wheel;
+    // time spent yielding at the end of the thread delays and of the timeouts, for a better precision
+    uint32_t delay_spin_us = 200;
     CPUProtocolPtr cpu_protocol;
     ExclusiveMonitorPtr exclusive_monitor;
 
@@ -160,9 +232,18 @@ struct KernelState {
     bool is_threads_paused() { return !paused_threads_status.empty(); };
     void pause_threads();
     void resume_threads();
+    // status of the thread when the threads were paused, its current status if they are not
+    ThreadStatus get_paused_status(const ThreadState &thread);
 
     void set_memory_watch(bool enabled);
     void invalidate_jit_cache(Address start, size_t length);
+    CPUStatePtr take_pooled_cpu(SceUID thread_id);
+    void release_cpu(CPUStatePtr cpu);
+    // give the guest thread to a parked host thread, return false if there is none
+    bool run_on_parked_host_thread(SceUID thread_id);
+    // called by a host thread whose guest thread exited, wait for a new guest thread to run
+    // return SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID if the host thread must exit instead
+    SceUID park_host_thread();
     std::shared_ptr<SceKernelModuleInfo> find_module_by_addr(Address address);
 
 private:
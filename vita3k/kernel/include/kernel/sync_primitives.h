@@ -53,6 +53,10 @@ struct WaitingThreadData {
         // struct { }; // condvar
         struct { // msgpipe
             SceSize request_size;
+            // buffer of a receiver removing the data, a sender finding the pipe empty copies the data there directly
+            void *recv_buffer;
+            SceSize recv_size;
+            SceSize *handed_size;
         } mp;
     };
 
@@ -184,6 +188,7 @@ struct Condvar : SyncPrimitive {
 
     WaitingThreadQueuePtr waiting_threads;
     MutexPtr associated_mutex;
+    Ptr<SceKernelLwCondWork> workarea;
 };
 typedef std::shared_ptr<Condvar> CondvarPtr;
 typedef std::map<SceUID, CondvarPtr> CondvarPtrs;
@@ -209,63 +214,69 @@ enum class SyncWeight {
 };
 
 // simple events
-SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr, SceUInt32 init_pattern);
-SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait);
-SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt64 user_data, bool is_set);
-SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 clear_pattern);
-SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id);
+SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt32 attr, SceUInt32 init_pattern);
+SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait);
+SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 pattern, SceUInt64 user_data, bool is_set);
+SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 clear_pattern);
+SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id);
 
 // Timer
-SceUID timer_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr);
+SceUID timer_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt32 attr);
 SceUID timer_find(KernelState &kernel, const char *export_name, const char *pName);
-SceInt32 timer_waitorpoll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait);
-SceInt32 timer_clear(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 clear_pattern);
-SceInt32 timer_set(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID timer_handle, SceUID type, SceKernelSysClock *interval, SceInt32 repeats);
-SceInt32 timer_start(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID timer_handle);
-SceInt32 timer_stop(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID timer_handle);
+SceInt32 timer_waitorpoll(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait);
+SceInt32 timer_clear(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 clear_pattern);
+SceInt32 timer_set(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID timer_handle, SceUID type, SceKernelSysClock *interval, SceInt32 repeats);
+SceInt32 timer_start(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID timer_handle);
+SceInt32 timer_stop(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID timer_handle);
 
 // Mutex
-SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, int init_count, Ptr<SceKernelLwMutexWork> workarea, SyncWeight weight);
+SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt attr, int init_count, Ptr<SceKernelLwMutexWork> workarea, SyncWeight weight);
 SceUID mutex_find(KernelState &kernel, const char *export_name, const char *pName);
-int mutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int lock_count, unsigned int *timeout, SyncWeight weight);
-int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int lock_count, SyncWeight weight);
-int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight);
-int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
-MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
+int mutex_lock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, int lock_count, unsigned int *timeout, SyncWeight weight);
+int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, int lock_count, SyncWeight weight);
+int mutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, int unlock_count, SyncWeight weight);
+int mutex_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, SyncWeight weight);
+MutexPtr mutex_get(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, SyncWeight weight);
+
+// Lightweight mutex fast paths, they only use the workarea and return false when the kernel object is needed
+bool lwmutex_try_lock_fast(MemState &mem, Ptr<SceKernelLwMutexWork> workarea, const ThreadStatePtr &thread, int lock_count);
+bool lwmutex_unlock_fast(MemState &mem, Ptr<SceKernelLwMutexWork> workarea, const ThreadStatePtr &thread, int unlock_count);
+SceUID lwmutex_get_owner(MemState &mem, Ptr<SceKernelLwMutexWork> workarea);
 
 // RWLock
-SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr);
-SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, uint32_t *timeout, bool is_write);
-SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, bool is_write);
-SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id);
+SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt32 attr);
+SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID lock_id, uint32_t *timeout, bool is_write);
+SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID lock_id, bool is_write);
+SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID lock_id);
 
 // Semaphore
-SceUID semaphore_create(KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, int initVal, int maxVal);
+SceUID semaphore_create(KernelState &kernel, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt attr, int initVal, int maxVal);
 SceUID semaphore_find(KernelState &kernel, const char *export_name, const char *pName);
-SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout);
-int semaphore_signal(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaid, int signal);
-int semaphore_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaid);
-int semaphore_cancel(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaid, SceInt32 setCount, SceUInt32 *pNumWaitThreads);
+SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout);
+int semaphore_signal(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaid, int signal);
+int semaphore_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaid);
+int semaphore_cancel(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaid, SceInt32 setCount, SceUInt32 *pNumWaitThreads);
 
 // Condition Variable
-SceUID condvar_create(SceUID *uid_out, KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, SceUID assoc_mutexid, SyncWeight weight);
-int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID semaid, SceUInt *timeout, SyncWeight weight);
-int condvar_signal(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID condid, Condvar::SignalTarget signal_target, SyncWeight weight);
-int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
+SceUID condvar_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt attr, SceUID assoc_mutexid, Ptr<SceKernelLwCondWork> workarea, SyncWeight weight);
+int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID semaid, SceUInt *timeout, SyncWeight weight);
+int condvar_signal(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID condid, Condvar::SignalTarget signal_target, SyncWeight weight);
+int condvar_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, SyncWeight weight);
+bool lwcond_has_waiters(MemState &mem, Ptr<SceKernelLwCondWork> workarea);
 
 // Event Flag
 SceUID eventflag_clear(KernelState &kernel, const char *export_name, SceUID evfId, SceUInt32 bitPattern);
-SceUID eventflag_create(KernelState &kernel, const char *export_name, SceUID thread_id, const char *pName, SceUInt32 attr, SceUInt32 initPattern);
+SceUID eventflag_create(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, const char *pName, SceUInt32 attr, SceUInt32 initPattern);
 SceUID eventflag_find(KernelState &kernel, const char *export_name, const char *pName);
-SceInt32 eventflag_wait(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout);
-int eventflag_poll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID eventflagid, unsigned int flags, unsigned int wait, unsigned int *outBits);
-SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID evfId, SceUInt32 bitPattern);
-SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt32 *num_wait_threads);
-int eventflag_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id);
+SceInt32 eventflag_wait(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout);
+int eventflag_poll(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID eventflagid, unsigned int flags, unsigned int wait, unsigned int *outBits);
+SceInt32 eventflag_set(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID evfId, SceUInt32 bitPattern);
+SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 pattern, SceUInt32 *num_wait_threads);
+int eventflag_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id);
 
 // Message Pipe
-SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, SceSize bufSize);
+SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt attr, SceSize bufSize);
 SceUID msgpipe_find(KernelState &kernel, const char *export_name, const char *pName);
-SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID msgPipeId, SceUInt32 waitMode, void *pRecvBuf, SceSize recvSize, SceUInt32 *pTimeout);
-SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID msgPipeId, SceUInt32 waitMode, const void *pSendBuf, SceSize sendSize, SceUInt32 *pTimeout);
-SceInt32 msgpipe_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID msgpipe_id);
+SceSize msgpipe_recv(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID msgPipeId, SceUInt32 waitMode, void *pRecvBuf, SceSize recvSize, SceUInt32 *pTimeout);
+SceSize msgpipe_send(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID msgPipeId, SceUInt32 waitMode, const void *pSendBuf, SceSize sendSize, SceUInt32 *pTimeout);
+SceInt32 msgpipe_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID msgpipe_id);
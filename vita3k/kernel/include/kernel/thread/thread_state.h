@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <cpu/state.h>
 #include <kernel/callback.h>
@@ -24,6 +25,7 @@
 #include <list>
 #include <mem/block.h>
 #include <mem/ptr.h>
+#include <mem/slab.h>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -34,6 +36,7 @@ struct CPUContext;
 struct ThreadState;
 struct ThreadParams;
 struct KernelState;
+struct HleThreadCounters;
 
 typedef std::unique_ptr<CPUState, std::function<void(CPUState *)>> CPUStatePtr;
 typedef std::function<void(CPUState &, uint32_t, SceUID)> CallImport;
@@ -59,6 +62,16 @@ private:
     bool signaled = false;
 };
 
+// host time spent by a thread, in nanoseconds, only measured while KernelState::measure_host_time is set
+struct ThreadHostTime {
+    // 0 if the thread is not waiting or started waiting before the measure
+    uint64_t wait_start_ns = 0;
+    uint64_t wait_ns = 0;
+    uint64_t guest_cpu_ns = 0;
+    // without the waits and the guest code run by the HLE functions
+    uint64_t hle_ns = 0;
+};
+
 // Internal
 enum class ThreadToDo {
     remove,
@@ -68,7 +81,7 @@ enum class ThreadToDo {
     wait,
 };
 
-struct ThreadState {
+struct ThreadState : public std::enable_shared_from_this<ThreadState> {
     std::mutex mutex;
     std::string name;
     SceUID id;
@@ -93,6 +106,19 @@ struct ThreadState {
     std::condition_variable status_cond;
     std::vector<std::shared_ptr<ThreadState>> waiting_threads;
     uint32_t returned_value = 0;
+    // only used by the thread itself, see HleProfiler
+    std::shared_ptr<HleThreadCounters> hle_counters;
+    // the waits are also counted by the threads waking this one up, the rest only by the thread itself
+    ThreadHostTime host_time;
+    // the thread can also be run from another host thread, like module_start, only its own host thread follows its scheduling
+    bool has_host_thread = false;
+    // set when the priority or the affinity changed, the host thread created for this thread applies them before running
+    std::atomic<bool> host_scheduling_changed = false;
+    // imports called by the thread, used to find out what a guest function does
+    uint32_t import_call_count = 0;
+    uint32_t last_import_nid = 0;
+    // blocks of the libc heap freed by the thread, only used while it runs
+    SlabCache slab_cache;
 
     ThreadState() = delete;
     explicit ThreadState(SceUID id, KernelState &kernel, MemState &mem);
@@ -103,7 +129,11 @@ struct ThreadState {
     void exit_delete(bool exit = true);
 
     void update_status(ThreadStatus status, std::optional<ThreadStatus> expected = std::nullopt);
+    // must be called from the host thread created for this thread
+    void update_host_scheduling();
     Address stack_top() const;
+    // address of a slot of the kernel TLS of this thread, null if the key is invalid
+    Ptr<Ptr<void>> get_tls_addr(int key) const;
 
     bool run_loop();
     void raise_waiting_threads();
@@ -145,3 +175,20 @@ private:
 };
 
 typedef std::shared_ptr<ThreadState> ThreadStatePtr;
+
+uint64_t get_host_time_ns();
+
+// measures the host time spent in an HLE function, without the waits and the guest code it runs
+class HleHostTimeScope {
+public:
+    HleHostTimeScope(KernelState &kernel, ThreadState &thread);
+    ~HleHostTimeScope();
+    HleHostTimeScope(const HleHostTimeScope &) = delete;
+    HleHostTimeScope &operator=(const HleHostTimeScope &) = delete;
+
+private:
+    KernelState &kernel;
+    ThreadState &thread;
+    const ThreadHostTime start_time;
+    const uint64_t start_ns;
+};
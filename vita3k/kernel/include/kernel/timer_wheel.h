@@ -0,0 +1,76 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// called by the timer wheel thread once the deadline is reached, returns false to be called again a bit later
+typedef std::function<bool()> TimeoutCallback;
+
+struct TimeoutEntry {
+    uint64_t id;
+    // in microseconds, on the clock of timer_wheel_now
+    uint64_t deadline;
+    // index of the slot holding it
+    size_t slot;
+    TimeoutCallback callback;
+};
+
+// Hashed timer wheel handling the timeouts of all the kernel waits on one host thread.
+// The timeouts are hashed by their tick, the timeouts of the same tick are fired together.
+struct TimerWheel {
+    static constexpr uint64_t TICK_US = 64;
+    static constexpr size_t SLOT_COUNT = 1024;
+    // below this delay, the thread yields until the deadline instead of sleeping to be woken up on time
+    uint32_t spin_us = 200;
+
+    std::mutex mutex;
+    // notified when a timeout is added or the thread has to exit
+    std::condition_variable cond;
+    std::thread thread;
+    bool exiting = false;
+
+    // last tick handled by the thread
+    uint64_t current_tick = 0;
+    uint64_t next_id = 1;
+    std::array<std::list<TimeoutEntry>, SLOT_COUNT> slots;
+    std::unordered_map<uint64_t, std::list<TimeoutEntry>::iterator> entries;
+
+    TimerWheel() = default;
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+    ~TimerWheel();
+};
+
+uint64_t timer_wheel_now();
+// the thread of the wheel is started by the first timeout, returns 0 once the wheel is stopped
+uint64_t add_timeout(TimerWheel &wheel, uint64_t deadline, TimeoutCallback callback);
+// once it returns, the callback is not running and will not be called anymore
+void cancel_timeout(TimerWheel &wheel, uint64_t id);
+void stop_timer_wheel(TimerWheel &wheel);
+
+// Same as cond.wait_until, but the deadline is handled by the wheel instead of by the waiting thread.
+// Returns the value of pred, so false if the deadline was reached first.
+bool timed_wait(TimerWheel &wheel, std::condition_variable &cond, std::unique_lock<std::mutex> &lock, uint64_t deadline, const std::function<bool()> &pred);
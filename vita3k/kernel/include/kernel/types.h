@@ -34,6 +34,7 @@
 #define SCE_KERNEL_HIGHEST_PRIORITY_USER 64
 #define SCE_KERNEL_LOWEST_PRIORITY_USER 191
 
+#define SCE_KERNEL_CPU_MASK_USER_0 0x10000
 #define SCE_KERNEL_CPU_MASK_USER_ALL 0x70000
 #define SCE_KERNEL_THREAD_CPU_AFFINITY_MASK_DEFAULT 0
 
@@ -53,6 +54,8 @@
 #define SCE_KERNEL_MUTEX_ATTR_RECURSIVE 0x2U
 #define SCE_KERNEL_MUTEX_ATTR_CEILING 0x4U
 
+#define SCE_KERNEL_EVENT_IN 0x00000001U
+#define SCE_KERNEL_EVENT_OUT 0x00000002U
 #define SCE_KERNEL_EVENT_TIMER 0x00008000U
 
 #define SCE_KERNEL_MSG_PIPE_MODE_ASAP 0x00000000U
@@ -646,7 +649,8 @@ struct SceKernelLMOption {
     SceSize size;
 };
 
-// We only use workarea for uid
+// owner and lockCount hold the lock state, they are updated directly by the HLE fast path
+// the kernel object found with uid is only used when threads have to wait
 struct SceKernelLwMutexWork {
     std::uint32_t owner;
     std::uint32_t unknown0;
@@ -673,10 +677,14 @@ struct SceKernelLwMutexInfo {
 // We only use workarea for uid
 struct SceKernelLwCondWork {
     SceUID uid;
+    // kept up to date by the kernel so that signaling without waiters does not need to find the condvar
+    std::uint32_t numWaitThreads;
 
-    std::uint8_t padding[28];
+    std::uint8_t padding[24];
 };
 
+static_assert(sizeof(SceKernelLwCondWork) == 32, "Incorrect size");
+
 struct SceKernelCreateLwMutex_opt {
     int init_count;
     Ptr<SceKernelLwMutexOptParam> opt_param;
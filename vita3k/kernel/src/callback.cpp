@@ -22,8 +22,7 @@
 #include <mutex>
 #include <util/log.h>
 
-uint32_t process_callbacks(KernelState &kernel, SceUID thread_id) {
-    ThreadStatePtr thread = kernel.get_thread(thread_id);
+uint32_t process_callbacks(KernelState &kernel, const ThreadStatePtr &thread) {
     if (thread->is_processing_callbacks)
         return 0;
 
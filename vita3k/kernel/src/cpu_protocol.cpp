@@ -17,6 +17,8 @@
 
 #include <kernel/cpu_protocol.h>
 #include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
+#include <nids/functions.h>
 #include <util/lock_and_find.h>
 
 CPUProtocol::CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func)
@@ -50,9 +52,8 @@ void CPUProtocol::call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState
 
     // This is usual service call
     uint32_t nid = *Ptr<uint32_t>(pc + 4).get(*mem);
-    // TODO: just supply ThreadStatePtr to call_import
-    // the only benefit of using thread_id instead--namely less locking-- has been gone for long
-    call_import(cpu, nid, thread.id);
+    const uint32_t import_index = (svc & HLE_IMPORT_SVC) ? (svc & ~HLE_IMPORT_SVC) : INVALID_IMPORT_INDEX;
+    call_import(cpu, nid, import_index, thread.shared_from_this());
 
     // ARM recommends claering exclusive state inside interrupt handler
     clear_exclusive(kernel->exclusive_monitor, get_processor_id(cpu));
@@ -62,6 +63,18 @@ Address CPUProtocol::get_watch_memory_addr(Address addr) {
     return kernel->debugger.get_watch_memory_addr(addr);
 }
 
+uint8_t **CPUProtocol::get_watch_page_table() {
+    return kernel->debugger.get_watch_page_table();
+}
+
 ExclusiveMonitorPtr CPUProtocol::get_exlusive_monitor() {
     return kernel->exclusive_monitor;
 }
+
+void CPUProtocol::block_translated(Address pc, bool thumb) {
+    record_translated_block(kernel->jit_profile, pc, thumb);
+}
+
+bool CPUProtocol::is_breakpoint(Address addr) {
+    return kernel->debugger.is_breakpoint(addr);
+}
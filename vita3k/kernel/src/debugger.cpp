@@ -32,14 +32,18 @@ void Debugger::add_breakpoint(MemState &mem, uint32_t addr, bool thumb_mode) {
     const auto lock = std::lock_guard(mutex);
     Breakpoint bk;
     bk.thumb_mode = thumb_mode;
-    if (thumb_mode) {
-        std::memcpy(&bk.data, &mem.memory[addr], sizeof(THUMB_BREAKPOINT));
-        std::memcpy(&mem.memory[addr], THUMB_BREAKPOINT, sizeof(THUMB_BREAKPOINT));
-    } else {
-        std::memcpy(&bk.data, &mem.memory[addr], sizeof(ARM_BREAKPOINT));
-        std::memcpy(&mem.memory[addr], ARM_BREAKPOINT, sizeof(ARM_BREAKPOINT));
+    if (parent.cpu_backend == CPUBackend::Unicorn) {
+        if (thumb_mode) {
+            std::memcpy(&bk.data, &mem.memory[addr], sizeof(THUMB_BREAKPOINT));
+            std::memcpy(&mem.memory[addr], THUMB_BREAKPOINT, sizeof(THUMB_BREAKPOINT));
+        } else {
+            std::memcpy(&bk.data, &mem.memory[addr], sizeof(ARM_BREAKPOINT));
+            std::memcpy(&mem.memory[addr], ARM_BREAKPOINT, sizeof(ARM_BREAKPOINT));
+        }
     }
     breakpoints.emplace(addr, bk);
+    has_breakpoints = true;
+    // only the blocks holding the address are translated again
     parent.invalidate_jit_cache(addr, 4);
 }
 
@@ -47,13 +51,23 @@ void Debugger::remove_breakpoint(MemState &mem, uint32_t addr) {
     const auto lock = std::lock_guard(mutex);
     if (breakpoints.contains(addr)) {
         auto last = breakpoints[addr];
-        std::memcpy(&mem.memory[addr], &last.data, last.thumb_mode ? sizeof(THUMB_BREAKPOINT) : sizeof(ARM_BREAKPOINT));
+        if (parent.cpu_backend == CPUBackend::Unicorn)
+            std::memcpy(&mem.memory[addr], &last.data, last.thumb_mode ? sizeof(THUMB_BREAKPOINT) : sizeof(ARM_BREAKPOINT));
         breakpoints.erase(addr);
+        has_breakpoints = !breakpoints.empty();
         parent.invalidate_jit_cache(addr, 4);
     }
 }
 
-void Debugger::add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, TrampolineCallback callback) {
+bool Debugger::is_breakpoint(Address addr) {
+    if (!has_breakpoints)
+        return false;
+
+    const auto lock = std::lock_guard(mutex);
+    return breakpoints.contains(addr);
+}
+
+void Debugger::add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, TrampolineCallback callback, bool run_original) {
     const auto swap_inst = [](uint32_t inst) {
         return (inst << 16) | ((inst >> 16) & 0xFFFF);
     };
@@ -88,6 +102,8 @@ void Debugger::add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, Tram
         tr->lr = tr->addr + 4;
         back_inst = tr->original;
     }
+    if (!run_original)
+        back_inst = thumb_mode ? 0xBF00BF00 : 0xE320F000; // NOP
 
     // Create trampoline body
     uint32_t *trampoline_insts = reinterpret_cast<uint32_t *>(&mem.memory[trampoline_addr]);
@@ -124,14 +140,56 @@ Debugger::Debugger(KernelState &kernel)
     : parent(kernel) {
 }
 
-void Debugger::add_watch_memory_addr(Address addr, size_t size) {
-    std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.emplace(addr, WatchMemory{ addr, size });
+// Only the accesses to the watched pages go through the jit callbacks, the other ones keep using the host memory directly.
+// The table is built from the current page table, external mappings added while memory is watched are not seen.
+bool Debugger::update_watch_page_table(MemState &mem) {
+    const bool was_used = use_watch_page_table;
+    use_watch_page_table = !watch_memory_addrs.empty();
+    if (!use_watch_page_table)
+        return was_used;
+
+    constexpr size_t page_count = GiB(4) / KiB(4);
+    if (!watch_page_table)
+        watch_page_table = std::make_unique<uint8_t *[]>(page_count);
+    for (size_t page = 0; page < page_count; page++)
+        watch_page_table[page] = mem.use_page_table ? mem.page_table[page] : mem.memory.get();
+
+    for (const auto &item : watch_memory_addrs) {
+        const uint64_t end_page = (static_cast<uint64_t>(item.second.start) + item.second.size + KiB(4) - 1) / KiB(4);
+        for (uint64_t page = item.second.start / KiB(4); page < std::min<uint64_t>(end_page, page_count); page++)
+            watch_page_table[page] = nullptr;
+    }
+
+    return !was_used;
 }
 
-void Debugger::remove_watch_memory_addr(KernelState &state, Address addr) {
-    std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.erase(addr);
+void Debugger::add_watch_memory_addr(MemState &mem, Address addr, size_t size) {
+    bool table_changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        watch_memory_addrs.emplace(addr, WatchMemory{ addr, size });
+        table_changed = update_watch_page_table(mem);
+    }
+
+    // the jits must be created again to start or stop using the table
+    if (table_changed && watch_memory) {
+        parent.set_memory_watch(false);
+        parent.set_memory_watch(true);
+    }
+}
+
+void Debugger::remove_watch_memory_addr(MemState &mem, Address addr) {
+    bool table_changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        watch_memory_addrs.erase(addr);
+        table_changed = update_watch_page_table(mem);
+    }
+
+    if (table_changed && watch_memory) {
+        parent.set_memory_watch(false);
+        parent.set_memory_watch(true);
+    }
 }
 
 // TODO use boost icl or interval tree instead if this turns out to be a significant bottleneck
@@ -145,6 +203,11 @@ Address Debugger::get_watch_memory_addr(Address addr) {
     return 0;
 }
 
+uint8_t **Debugger::get_watch_page_table() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return use_watch_page_table ? watch_page_table.get() : nullptr;
+}
+
 void Debugger::update_watches() {
     parent.set_memory_watch(watch_memory);
 }
@@ -0,0 +1,192 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/guest_profiler.h>
+
+#include <cpu/functions.h>
+#include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
+#include <nids/functions.h>
+#include <util/log.h>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+GuestProfiler::~GuestProfiler() {
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+void init_guest_profiler(GuestProfiler &profiler, const fs::path &path) {
+    profiler.path = path;
+}
+
+bool is_guest_profiler_running(const GuestProfiler &profiler) {
+    return profiler.running;
+}
+
+static void sample_threads(KernelState &kernel) {
+    GuestProfiler &profiler = kernel.guest_profiler;
+    while (profiler.running) {
+        {
+            // threads release their cpu with the kernel mutex locked when they exit
+            const ProfiledLockGuard kernel_lock(kernel.mutex);
+            const std::lock_guard<std::mutex> profiler_lock(profiler.mutex);
+            for (const auto &[id, thread] : kernel.threads) {
+                if (thread->status != ThreadStatus::run || !thread->cpu)
+                    continue;
+
+                CPUState &cpu = *thread->cpu;
+                profiler.samples[{ id, read_pc(cpu), read_lr(cpu) }]++;
+                if (!profiler.thread_names.contains(id))
+                    profiler.thread_names.emplace(id, thread->name);
+            }
+        }
+        std::this_thread::sleep_for(profiler.interval);
+    }
+}
+
+void start_guest_profiler(KernelState &kernel) {
+    GuestProfiler &profiler = kernel.guest_profiler;
+    if (profiler.running.exchange(true))
+        return;
+
+    {
+        const std::lock_guard<std::mutex> lock(profiler.mutex);
+        profiler.samples.clear();
+        profiler.thread_names.clear();
+    }
+    profiler.thread = std::thread(sample_threads, std::ref(kernel));
+    LOG_INFO("Guest profiler started");
+}
+
+namespace {
+
+std::string get_module_name(const SceKernelModuleInfo &module) {
+    return std::string(module.module_name, strnlen(module.module_name, sizeof(module.module_name)));
+}
+
+struct Symbolizer {
+    KernelState &kernel;
+    // exported functions, sorted by address
+    std::map<Address, uint32_t> exports;
+    std::unordered_map<Address, std::string> frames;
+    std::unordered_map<Address, std::string> modules;
+
+    explicit Symbolizer(KernelState &kernel)
+        : kernel(kernel) {
+        const std::lock_guard<std::mutex> lock(kernel.export_nids_mutex);
+        for (const auto &[nid, address] : kernel.export_nids)
+            exports.emplace(address & ~1U, nid);
+    }
+
+    const std::string &module_name(Address addr) {
+        addr &= ~1U;
+        const auto it = modules.find(addr);
+        if (it != modules.end())
+            return it->second;
+
+        const auto module = kernel.find_module_by_addr(addr);
+        return modules.emplace(addr, module ? get_module_name(*module) : "unknown").first->second;
+    }
+
+    const std::string &frame(Address addr) {
+        addr &= ~1U;
+        const auto it = frames.find(addr);
+        if (it != frames.end())
+            return it->second;
+
+        const auto module = kernel.find_module_by_addr(addr);
+        if (!module)
+            return frames.emplace(addr, log_hex(addr)).first->second;
+
+        // the code is attributed to the closest export before it in the same module,
+        // functions which are not exported are merged with it
+        auto export_it = exports.upper_bound(addr);
+        if (export_it != exports.begin()) {
+            --export_it;
+            if (kernel.find_module_by_addr(export_it->first) == module)
+                return frames.emplace(addr, fmt::format("{}!{}", get_module_name(*module), import_name(export_it->second))).first->second;
+        }
+
+        for (uint32_t i = 0; i < MODULE_INFO_NUM_SEGMENTS; i++) {
+            const auto &segment = module->segments[i];
+            if (segment.size != 0 && addr >= segment.vaddr.address() && addr < segment.vaddr.address() + segment.memsz)
+                return frames.emplace(addr, fmt::format("{}!seg{}+{}", get_module_name(*module), i, log_hex(addr - segment.vaddr.address()))).first->second;
+        }
+        return frames.emplace(addr, fmt::format("{}!{}", get_module_name(*module), log_hex(addr))).first->second;
+    }
+};
+
+} // namespace
+
+void stop_guest_profiler(KernelState &kernel) {
+    GuestProfiler &profiler = kernel.guest_profiler;
+    if (!profiler.running.exchange(false))
+        return;
+    if (profiler.thread.joinable())
+        profiler.thread.join();
+
+    std::unordered_map<GuestSample, uint64_t, GuestSampleHash> samples;
+    std::map<SceUID, std::string> thread_names;
+    {
+        const std::lock_guard<std::mutex> lock(profiler.mutex);
+        samples = std::move(profiler.samples);
+        thread_names = std::move(profiler.thread_names);
+        profiler.samples.clear();
+        profiler.thread_names.clear();
+    }
+    if (samples.empty()) {
+        LOG_INFO("Guest profiler stopped without any sample");
+        return;
+    }
+
+    Symbolizer symbolizer(kernel);
+    std::map<std::string, uint64_t> stacks;
+    std::map<std::string, uint64_t> module_samples;
+    uint64_t total = 0;
+    for (const auto &[sample, count] : samples) {
+        std::string thread_name = thread_names[sample.thread_id];
+        std::replace(thread_name.begin(), thread_name.end(), ';', '_');
+        stacks[fmt::format("{};{};{}", thread_name, symbolizer.frame(sample.lr), symbolizer.frame(sample.pc))] += count;
+        module_samples[symbolizer.module_name(sample.pc)] += count;
+        total += count;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> modules(module_samples.begin(), module_samples.end());
+    std::sort(modules.begin(), modules.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+    LOG_INFO("Guest profiler stopped with {} samples", total);
+    for (const auto &[name, count] : modules)
+        LOG_INFO("    {}: {} samples ({:.1f}%)", name, count, count * 100.0 / total);
+
+    if (!fs::exists(profiler.path.parent_path()))
+        fs::create_directories(profiler.path.parent_path());
+
+    fs::ofstream report(profiler.path, std::ios::out);
+    if (!report.is_open()) {
+        LOG_ERROR("Failed to write the guest profile to {}", profiler.path.string());
+        return;
+    }
+    for (const auto &[stack, count] : stacks)
+        report << stack << ' ' << count << '\n';
+
+    LOG_INFO("Guest profile written to {}", profiler.path.string());
+}
@@ -0,0 +1,121 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <kernel/guest_scheduler.h>
+
+#include <cpu/functions.h>
+#include <kernel/thread/thread_state.h>
+#include <kernel/types.h>
+
+#include <algorithm>
+
+static uint32_t get_guest_core_mask(SceInt32 affinity_mask) {
+    const uint32_t core_mask = (affinity_mask & SCE_KERNEL_CPU_MASK_USER_ALL) / SCE_KERNEL_CPU_MASK_USER_0;
+    // the default affinity lets the thread run on any core
+    return core_mask ? core_mask : (1U << GuestScheduler::CORE_COUNT) - 1;
+}
+
+static void give_core(GuestScheduler &scheduler, GuestScheduler::Waiter &waiter, int core) {
+    scheduler.waiters.erase(std::find(scheduler.waiters.begin(), scheduler.waiters.end(), &waiter));
+    scheduler.core_threads[core] = waiter.thread;
+    waiter.core = core;
+    waiter.done = true;
+    waiter.cond.notify_one();
+}
+
+// stop the thread of lowest priority running on a core allowed for the waiter, if it is below the priority given
+static void preempt_core(GuestScheduler &scheduler, const GuestScheduler::Waiter &waiter, int min_priority) {
+    int preempted_core = -1;
+    for (int core = 0; core < GuestScheduler::CORE_COUNT; core++) {
+        ThreadState *const thread = scheduler.core_threads[core];
+        if (!(waiter.core_mask & (1U << core)) || !thread || scheduler.preempting[core] || thread->priority < min_priority)
+            continue;
+        // a greater value is a lower priority
+        if (preempted_core < 0 || thread->priority > scheduler.core_threads[preempted_core]->priority)
+            preempted_core = core;
+    }
+
+    if (preempted_core >= 0) {
+        scheduler.preempting[preempted_core] = true;
+        stop(*scheduler.core_threads[preempted_core]->cpu);
+    }
+}
+
+int acquire_guest_core(GuestScheduler &scheduler, ThreadState &thread) {
+    if (!scheduler.enabled)
+        return -1;
+
+    std::unique_lock<std::mutex> lock(scheduler.mutex);
+    if (scheduler.stopped)
+        return -1;
+
+    GuestScheduler::Waiter waiter{ &thread, thread.priority, get_guest_core_mask(thread.affinity_mask), scheduler.next_order++ };
+    // the free cores already went to the waiters allowed on them, so a free core here can be taken right away
+    for (int core = 0; core < GuestScheduler::CORE_COUNT; core++) {
+        if ((waiter.core_mask & (1U << core)) && !scheduler.core_threads[core]) {
+            scheduler.core_threads[core] = &thread;
+            return core;
+        }
+    }
+
+    scheduler.waiters.push_back(&waiter);
+    preempt_core(scheduler, waiter, waiter.priority + 1);
+    while (!waiter.done) {
+        if (waiter.cond.wait_for(lock, GuestScheduler::TIME_SLICE, [&]() { return waiter.done; }))
+            break;
+        preempt_core(scheduler, waiter, waiter.priority);
+    }
+
+    return waiter.core;
+}
+
+void release_guest_core(GuestScheduler &scheduler, int core) {
+    if (core < 0)
+        return;
+
+    const std::lock_guard<std::mutex> lock(scheduler.mutex);
+    scheduler.core_threads[core] = nullptr;
+    scheduler.preempting[core] = false;
+
+    GuestScheduler::Waiter *next = nullptr;
+    for (GuestScheduler::Waiter *waiter : scheduler.waiters) {
+        if (!(waiter->core_mask & (1U << core)))
+            continue;
+        if (!next || waiter->priority < next->priority || (waiter->priority == next->priority && waiter->order < next->order))
+            next = waiter;
+    }
+
+    if (next)
+        give_core(scheduler, *next, core);
+}
+
+void stop_guest_scheduler(GuestScheduler &scheduler) {
+    const std::lock_guard<std::mutex> lock(scheduler.mutex);
+    scheduler.stopped = true;
+    for (GuestScheduler::Waiter *waiter : scheduler.waiters) {
+        waiter->done = true;
+        waiter->cond.notify_one();
+    }
+    scheduler.waiters.clear();
+}
+
+void reset_guest_scheduler(GuestScheduler &scheduler) {
+    const std::lock_guard<std::mutex> lock(scheduler.mutex);
+    scheduler.core_threads = {};
+    scheduler.preempting = {};
+    scheduler.waiters.clear();
+    scheduler.stopped = false;
+}
@@ -0,0 +1,129 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/hle_profiler.h>
+
+#include <kernel/thread/thread_state.h>
+#include <nids/functions.h>
+#include <util/log.h>
+
+#include <spdlog/fmt/fmt.h>
+
+void init_hle_profiler(HleProfiler &profiler, const fs::path &path, bool enabled) {
+    const std::lock_guard<std::mutex> lock(profiler.mutex);
+    profiler.enabled = enabled;
+    profiler.path = path;
+    profiler.threads.clear();
+}
+
+static HleThreadCounters &get_thread_counters(HleProfiler &profiler, ThreadState &thread) {
+    if (!thread.hle_counters) {
+        auto counters = std::make_shared<HleThreadCounters>();
+        counters->thread_id = thread.id;
+        counters->thread_name = thread.name;
+        counters->calls = std::make_unique<HleCallCounter[]>(import_count());
+
+        const std::lock_guard<std::mutex> lock(profiler.mutex);
+        profiler.threads.push_back(counters);
+        thread.hle_counters = std::move(counters);
+    }
+    return *thread.hle_counters;
+}
+
+void record_hle_call(HleProfiler &profiler, ThreadState &thread, uint32_t import_index, std::chrono::steady_clock::duration duration) {
+    if (import_index >= import_count())
+        return;
+
+    HleCallCounter &counter = get_thread_counters(profiler, thread).calls[import_index];
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    // the thread is the only writer, no need for atomic read-modify-write
+    counter.count.store(counter.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    counter.total_ns.store(counter.total_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    if (ns > counter.max_ns.load(std::memory_order_relaxed))
+        counter.max_ns.store(ns, std::memory_order_relaxed);
+}
+
+static std::string escape_json(const std::string &str) {
+    std::string escaped;
+    for (const char c : str) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+            escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+static std::string escape_csv(const std::string &str) {
+    std::string escaped = "\"";
+    for (const char c : str) {
+        if (c == '"')
+            escaped += '"';
+        escaped += c;
+    }
+    return escaped + '"';
+}
+
+void save_hle_profile(HleProfiler &profiler) {
+    std::vector<std::shared_ptr<HleThreadCounters>> threads;
+    {
+        const std::lock_guard<std::mutex> lock(profiler.mutex);
+        threads = std::move(profiler.threads);
+        profiler.threads.clear();
+    }
+    if (threads.empty())
+        return;
+
+    if (!fs::exists(profiler.path.parent_path()))
+        fs::create_directories(profiler.path.parent_path());
+
+    fs::path csv_path = profiler.path;
+    csv_path += ".csv";
+    fs::path json_path = profiler.path;
+    json_path += ".json";
+    fs::ofstream csv(csv_path, std::ios::out);
+    fs::ofstream json(json_path, std::ios::out);
+    if (!csv.is_open() || !json.is_open()) {
+        LOG_ERROR("Failed to save the HLE profile to {}", profiler.path.string());
+        return;
+    }
+
+    csv << "thread_id,thread_name,nid,name,count,total_us,max_us\n";
+    json << "[\n";
+    bool first = true;
+    for (const auto &thread : threads) {
+        for (uint32_t i = 0; i < import_count(); i++) {
+            const HleCallCounter &counter = thread->calls[i];
+            const uint64_t count = counter.count.load(std::memory_order_relaxed);
+            if (count == 0)
+                continue;
+
+            const uint32_t nid = import_nid(i);
+            const double total_us = counter.total_ns.load(std::memory_order_relaxed) / 1000.0;
+            const double max_us = counter.max_ns.load(std::memory_order_relaxed) / 1000.0;
+            csv << fmt::format("{},{},{},{},{},{:.3f},{:.3f}\n", thread->thread_id, escape_csv(thread->thread_name), log_hex_full(nid), import_name(nid), count, total_us, max_us);
+            json << fmt::format("{}  {{ \"thread_id\": {}, \"thread_name\": \"{}\", \"nid\": \"{}\", \"name\": \"{}\", \"count\": {}, \"total_us\": {:.3f}, \"max_us\": {:.3f} }}",
+                first ? "" : ",\n", thread->thread_id, escape_json(thread->thread_name), log_hex_full(nid), import_name(nid), count, total_us, max_us);
+            first = false;
+        }
+    }
+    json << "\n]\n";
+
+    LOG_INFO("HLE profile saved to {}", profiler.path.string());
+}
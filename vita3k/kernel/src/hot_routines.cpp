@@ -0,0 +1,131 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/hot_routines.h>
+
+#include <cpu/functions.h>
+#include <kernel/state.h>
+#include <util/log.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+typedef uint32_t (*HotRoutineImpl)(uint8_t *memory, uint32_t r0, uint32_t r1, uint32_t r2);
+
+struct HotRoutine {
+    const char *name;
+    // thumb-2 code of the whole routine, it must not be reached other than through its first instruction
+    std::vector<uint8_t> code;
+    HotRoutineImpl impl;
+};
+
+uint32_t hot_strlen(uint8_t *memory, uint32_t str, uint32_t, uint32_t) {
+    return static_cast<uint32_t>(strlen(reinterpret_cast<const char *>(&memory[str])));
+}
+
+uint32_t hot_strcmp(uint8_t *memory, uint32_t str1, uint32_t str2, uint32_t) {
+    const uint8_t *const s1 = &memory[str1];
+    const uint8_t *const s2 = &memory[str2];
+    // the guest routine returns the difference of the first mismatching bytes, not only its sign
+    size_t i = 0;
+    while (s1[i] != 0 && s1[i] == s2[i])
+        i++;
+    return static_cast<uint32_t>(s1[i] - s2[i]);
+}
+
+uint32_t hot_memset(uint8_t *memory, uint32_t dest, uint32_t value, uint32_t size) {
+    memset(&memory[dest], static_cast<uint8_t>(value), size);
+    return dest;
+}
+
+uint32_t hot_memcpy(uint8_t *memory, uint32_t dest, uint32_t src, uint32_t size) {
+    if (dest > src && dest - src < size) {
+        // the guest routine copies byte by byte, an overlapping copy repeats the start of the source
+        for (uint32_t i = 0; i < size; i++)
+            memory[dest + i] = memory[src + i];
+    } else {
+        memmove(&memory[dest], &memory[src], size);
+    }
+    return dest;
+}
+
+uint32_t hot_memmove(uint8_t *memory, uint32_t dest, uint32_t src, uint32_t size) {
+    memmove(&memory[dest], &memory[src], size);
+    return dest;
+}
+
+// byte loops produced by the compilers for the C implementations of these routines, the host versions are vectorized
+// longer routines come first, memmove ends with the same code as memcpy
+const std::vector<HotRoutine> hot_routines = {
+    { "memmove",
+        { 0x81, 0x42, 0x05, 0xd2, 0x62, 0xb1, 0x01, 0x3a, 0x8b, 0x5c, 0x83, 0x54, 0xfb, 0xd1, 0x70, 0x47,
+            0x32, 0xb1, 0x03, 0x46, 0x11, 0xf8, 0x01, 0xcb, 0x03, 0xf8, 0x01, 0xcb, 0x01, 0x3a, 0xf9, 0xd1, 0x70, 0x47 },
+        hot_memmove },
+    { "strcmp",
+        { 0x10, 0xf8, 0x01, 0x2b, 0x11, 0xf8, 0x01, 0x3b, 0x01, 0x2a, 0x28, 0xbf, 0x9a, 0x42, 0xf7, 0xd0, 0xd0, 0x1a, 0x70, 0x47 },
+        hot_strcmp },
+    { "memcpy",
+        { 0x32, 0xb1, 0x03, 0x46, 0x11, 0xf8, 0x01, 0xcb, 0x03, 0xf8, 0x01, 0xcb, 0x01, 0x3a, 0xf9, 0xd1, 0x70, 0x47 },
+        hot_memcpy },
+    { "strlen",
+        { 0x01, 0x46, 0x11, 0xf8, 0x01, 0x2b, 0x00, 0x2a, 0xfb, 0xd1, 0x08, 0x1a, 0x01, 0x38, 0x70, 0x47 },
+        hot_strlen },
+    { "memset",
+        { 0x22, 0xb1, 0x03, 0x46, 0x03, 0xf8, 0x01, 0x1b, 0x01, 0x3a, 0xfb, 0xd1, 0x70, 0x47 },
+        hot_memset },
+};
+
+} // namespace
+
+uint32_t replace_hot_routines(KernelState &kernel, MemState &mem, Address start, uint32_t size, const char *module_name) {
+    const uint8_t *const code = Ptr<const uint8_t>(start).get(mem);
+    uint32_t replaced = 0;
+
+    // thumb instructions are aligned on 2 bytes
+    uint32_t offset = 0;
+    while (offset + 2 <= size) {
+        const HotRoutine *found = nullptr;
+        for (const HotRoutine &routine : hot_routines) {
+            if (offset + routine.code.size() <= size && memcmp(&code[offset], routine.code.data(), routine.code.size()) == 0) {
+                found = &routine;
+                break;
+            }
+        }
+        if (!found) {
+            offset += 2;
+            continue;
+        }
+
+        const HotRoutineImpl impl = found->impl;
+        kernel.debugger.add_trampoile(
+            mem, start + offset, true, [impl](CPUState &cpu, MemState &mem, Address) {
+                const uint32_t result = impl(mem.memory.get(), read_reg(cpu, 0), read_reg(cpu, 1), read_reg(cpu, 2));
+                write_reg(cpu, 0, result);
+                // return to the caller of the routine
+                write_pc(cpu, read_lr(cpu));
+                return true;
+            },
+            false);
+        LOG_DEBUG("Replaced {} of {} at {}", found->name, module_name, log_hex(start + offset));
+        replaced++;
+        offset += static_cast<uint32_t>(found->code.size());
+    }
+
+    return replaced;
+}
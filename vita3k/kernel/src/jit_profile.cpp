@@ -0,0 +1,145 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/jit_profile.h>
+
+#include <kernel/state.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t JIT_PROFILE_VERSION = 1;
+static constexpr const char *JIT_PROFILE_FILE_NAME = "blocks.dat";
+
+// blocks are saved relative to their module segment, modules are not always loaded at the same address
+struct JitProfileEntry {
+    char module_name[28];
+    uint32_t segment;
+    // bit 0 is set for thumb blocks
+    uint32_t offset;
+};
+
+void init_jit_profile(JitProfile &profile, const fs::path &path, bool enabled) {
+    const std::lock_guard<std::mutex> lock(profile.mutex);
+    profile.enabled = enabled;
+    profile.path = path;
+    profile.translated_blocks.clear();
+}
+
+void record_translated_block(JitProfile &profile, Address pc, bool thumb) {
+    profile.translated_block_count.fetch_add(1, std::memory_order_relaxed);
+    if (!profile.enabled)
+        return;
+
+    const std::lock_guard<std::mutex> lock(profile.mutex);
+    profile.translated_blocks.insert(pc | static_cast<Address>(thumb));
+}
+
+std::vector<Address> load_jit_profile(KernelState &kernel) {
+    JitProfile &profile = kernel.jit_profile;
+    if (!profile.enabled)
+        return {};
+
+    fs::ifstream profile_file(profile.path / JIT_PROFILE_FILE_NAME, std::ios::in | std::ios::binary);
+    if (!profile_file.is_open())
+        return {};
+
+    uint32_t version = 0;
+    uint32_t count = 0;
+    profile_file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    profile_file.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if (!profile_file || version != JIT_PROFILE_VERSION) {
+        LOG_WARN("Ignoring the jit profile of an older version");
+        return {};
+    }
+
+    std::vector<JitProfileEntry> entries(count);
+    profile_file.read(reinterpret_cast<char *>(entries.data()), count * sizeof(JitProfileEntry));
+    if (!profile_file) {
+        LOG_WARN("The jit profile is truncated, ignoring it");
+        return {};
+    }
+
+    std::vector<Address> blocks;
+    blocks.reserve(count);
+
+    const ProfiledLockGuard lock(kernel.mutex);
+    for (const auto &entry : entries) {
+        const auto module = std::find_if(kernel.loaded_modules.begin(), kernel.loaded_modules.end(), [&](const auto &module) {
+            return strncmp(module.second->module_name, entry.module_name, sizeof(entry.module_name)) == 0;
+        });
+        if (module == kernel.loaded_modules.end() || entry.segment >= MODULE_INFO_NUM_SEGMENTS)
+            continue;
+
+        const auto &segment = module->second->segments[entry.segment];
+        if (segment.size == 0 || (entry.offset & ~1U) >= segment.memsz)
+            continue;
+
+        blocks.push_back(segment.vaddr.address() + entry.offset);
+    }
+
+    return blocks;
+}
+
+void save_jit_profile(KernelState &kernel) {
+    JitProfile &profile = kernel.jit_profile;
+    if (!profile.enabled)
+        return;
+
+    std::vector<JitProfileEntry> entries;
+    {
+        const ProfiledLockGuard kernel_lock(kernel.mutex);
+        const std::lock_guard<std::mutex> profile_lock(profile.mutex);
+        if (profile.translated_blocks.empty())
+            return;
+
+        for (const auto &[_, module] : kernel.loaded_modules) {
+            for (uint32_t i = 0; i < MODULE_INFO_NUM_SEGMENTS; i++) {
+                const auto &segment = module->segments[i];
+                if (segment.size == 0)
+                    continue;
+
+                const Address start = segment.vaddr.address();
+                for (const Address block : profile.translated_blocks) {
+                    if (block < start || block >= start + segment.memsz)
+                        continue;
+
+                    JitProfileEntry entry{};
+                    std::copy_n(module->module_name, sizeof(entry.module_name), entry.module_name);
+                    entry.segment = i;
+                    entry.offset = block - start;
+                    entries.push_back(entry);
+                }
+            }
+        }
+    }
+
+    if (!fs::exists(profile.path))
+        fs::create_directories(profile.path);
+
+    fs::ofstream profile_file(profile.path / JIT_PROFILE_FILE_NAME, std::ios::out | std::ios::binary);
+    if (!profile_file.is_open()) {
+        LOG_ERROR("Failed to save the jit profile to {}", profile.path.string());
+        return;
+    }
+
+    const uint32_t count = static_cast<uint32_t>(entries.size());
+    profile_file.write(reinterpret_cast<const char *>(&JIT_PROFILE_VERSION), sizeof(JIT_PROFILE_VERSION));
+    profile_file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    profile_file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(JitProfileEntry));
+}
@@ -25,10 +25,12 @@
 
 #include <cpu/functions.h>
 #include <mem/ptr.h>
+#include <nids/functions.h>
 #include <util/align.h>
 #include <util/arm.h>
-#include <util/find.h>
 #include <util/log.h>
+#include <util/memory_accounting.h>
+#include <util/trace_log.h>
 
 #include <SDL_thread.h>
 #include <spdlog/fmt/fmt.h>
@@ -58,11 +60,8 @@ struct ThreadParams {
     std::shared_ptr<SDL_semaphore> host_may_destroy_params = std::shared_ptr<SDL_semaphore>(SDL_CreateSemaphore(0), SDL_DestroySemaphore);
 };
 
-static int SDLCALL thread_function(void *data) {
-    assert(data != nullptr);
-    const ThreadParams params = *static_cast<const ThreadParams *>(data);
-    SDL_SemPost(params.host_may_destroy_params.get());
-    const ThreadStatePtr thread = lock_and_find(params.thid, params.kernel->threads, params.kernel->mutex);
+static uint32_t run_guest_thread(KernelState &kernel, SceUID thid) {
+    const ThreadStatePtr thread = kernel.get_thread(thid);
 #ifdef TRACY_ENABLE
     if (!thread->name.empty()) {
         tracy::SetThreadName(thread->name.c_str());
@@ -72,12 +71,34 @@ static int SDLCALL thread_function(void *data) {
     }
 #endif
 
+    thread->has_host_thread = true;
+    set_trace_thread_id(thread->id);
+    if (kernel.host_thread_priority || kernel.host_thread_affinity)
+        thread->update_host_scheduling();
+
     thread->run_loop();
     const uint32_t r0 = read_reg(*thread->cpu, 0);
 
-    std::lock_guard<std::mutex> lock(params.kernel->mutex);
-    params.kernel->threads.erase(thread->id);
-    params.kernel->corenum_allocator.free_corenum(get_processor_id(*thread->cpu));
+    const ProfiledLockGuard lock(kernel.mutex);
+    kernel.threads.erase(thread->id);
+    kernel.thread_table.erase(thread->id);
+    kernel.release_cpu(std::move(thread->cpu));
+
+    return r0;
+}
+
+static int SDLCALL thread_function(void *data) {
+    assert(data != nullptr);
+    const ThreadParams params = *static_cast<const ThreadParams *>(data);
+    SDL_SemPost(params.host_may_destroy_params.get());
+
+    // the host thread keeps the host name of the first guest thread it runs
+    SceUID thid = params.thid;
+    uint32_t r0;
+    do {
+        r0 = run_guest_thread(*params.kernel, thid);
+        thid = params.kernel->park_host_thread();
+    } while (thid != SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID);
 
     return r0;
 }
@@ -94,8 +115,15 @@ bool KernelState::init(MemState &mem, CallImportFunc call_import, CPUBackend cpu
     start_tick = rtc_get_ticks(rtc_base_ticks());
     base_tick = { rtc_base_ticks() };
     cpu_protocol = std::make_unique<CPUProtocol>(*this, mem, call_import);
+    hle_import_exported = std::vector<std::atomic<bool>>(import_count());
     this->cpu_backend = cpu_backend;
     this->cpu_opt = cpu_opt;
+    cpu_pool.clear();
+    {
+        const std::lock_guard<std::mutex> lock(host_thread_pool.mutex);
+        host_thread_pool.exiting = false;
+    }
+    reset_guest_scheduler(guest_scheduler);
 
     return true;
 }
@@ -111,7 +139,7 @@ void KernelState::load_process_param(MemState &mem, Ptr<uint32_t> ptr) {
 }
 
 void KernelState::set_memory_watch(bool enabled) {
-    std::lock_guard<std::mutex> lock(mutex);
+    const ProfiledLockGuard lock(mutex);
     for (const auto &thread : threads) {
         auto &cpu = *thread.second->cpu;
         if (enabled != get_log_mem(cpu)) {
@@ -124,14 +152,74 @@ void KernelState::set_memory_watch(bool enabled) {
 }
 
 void KernelState::invalidate_jit_cache(Address start, size_t length) {
-    std::lock_guard<std::mutex> lock(mutex);
+    const ProfiledLockGuard lock(mutex);
     for (auto thread : threads) {
         ::invalidate_jit_cache(*thread.second->cpu, start, length);
     }
+    for (auto &cpu : cpu_pool) {
+        ::invalidate_jit_cache(*cpu, start, length);
+    }
+}
+
+CPUStatePtr KernelState::take_pooled_cpu(SceUID thread_id) {
+    const ProfiledLockGuard lock(mutex);
+    if (cpu_pool.empty())
+        return nullptr;
+
+    CPUStatePtr cpu = std::move(cpu_pool.back());
+    cpu_pool.pop_back();
+    set_thread_id(*cpu, thread_id);
+    clear_exclusive(exclusive_monitor, get_processor_id(*cpu));
+
+    return cpu;
+}
+
+// Assumes the kernel mutex is locked
+void KernelState::release_cpu(CPUStatePtr cpu) {
+    // the pooled cpus keep their code cache, they are not kept above the budget
+    if (cpu_pool.size() < cpu_pool_size && !is_over_memory_budget(MemoryCategory::JitCode)) {
+        // the core number stays allocated, the jit of the cpu was created with it
+        cpu_pool.push_back(std::move(cpu));
+        return;
+    }
+
+    corenum_allocator.free_corenum(get_processor_id(*cpu));
+}
+
+bool KernelState::run_on_parked_host_thread(SceUID thread_id) {
+    const std::lock_guard<std::mutex> lock(host_thread_pool.mutex);
+    if (host_thread_pool.available_count == 0)
+        return false;
+
+    host_thread_pool.available_count--;
+    host_thread_pool.pending_threads.push_back(thread_id);
+    host_thread_pool.cond.notify_one();
+    return true;
+}
+
+SceUID KernelState::park_host_thread() {
+    std::unique_lock<std::mutex> lock(host_thread_pool.mutex);
+    if (host_thread_pool.exiting || host_thread_pool.parked_count >= cpu_pool_size)
+        return SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+
+    host_thread_pool.parked_count++;
+    host_thread_pool.available_count++;
+    host_thread_pool.cond.wait(lock, [&]() { return host_thread_pool.exiting || !host_thread_pool.pending_threads.empty(); });
+    host_thread_pool.parked_count--;
+
+    // the guest threads given to the pool before it exited still have to be run
+    if (host_thread_pool.pending_threads.empty()) {
+        host_thread_pool.available_count--;
+        return SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+    }
+
+    const SceUID thread_id = host_thread_pool.pending_threads.back();
+    host_thread_pool.pending_threads.pop_back();
+    return thread_id;
 }
 
 ThreadStatePtr KernelState::get_thread(SceUID thread_id) {
-    return lock_and_find(thread_id, threads, mutex);
+    return lock_and_find(thread_id, threads, mutex, thread_table);
 }
 
 ThreadStatePtr KernelState::create_thread(MemState &mem, const char *name, Ptr<const void> entry_point) {
@@ -144,6 +232,11 @@ ThreadStatePtr KernelState::create_thread(MemState &mem, const char *name, Ptr<c
         return nullptr;
     const auto lock = std::lock_guard(mutex);
     threads.emplace(thread->id, thread);
+    thread_table.insert(thread->id, thread);
+
+    // skip the host thread creation when one of an exited thread is parked
+    if (run_on_parked_host_thread(thread->id))
+        return thread;
 
     ThreadParams params;
     params.kernel = this;
@@ -155,26 +248,35 @@ ThreadStatePtr KernelState::create_thread(MemState &mem, const char *name, Ptr<c
 }
 
 Ptr<Ptr<void>> KernelState::get_thread_tls_addr(MemState &mem, SceUID thread_id, int key) {
-    Ptr<Ptr<void>> address(0);
-    // magic numbers taken from decompiled source. There is 0x400 unused bytes of unknown usage
-    if (key <= 0x100 && key >= 0) {
-        const ThreadStatePtr thread = util::find(thread_id, threads);
-        address = thread->tls.get_ptr<Ptr<void>>() + key;
-    } else {
-        LOG_ERROR("Wrong tls slot index. TID:{} index:{}", thread_id, key);
+    const ThreadStatePtr thread = get_thread(thread_id);
+    if (!thread) {
+        LOG_ERROR("Thread {} not found for its tls slot {}", thread_id, key);
+        return Ptr<Ptr<void>>(0);
     }
-    return address;
+
+    return thread->get_tls_addr(key);
 }
 
 void KernelState::exit_delete_all_threads() {
-    const std::lock_guard<std::mutex> lock(mutex);
+    save_jit_profile(*this);
+    stop_guest_profiler(*this);
+    save_hle_profile(hle_profiler);
+
+    {
+        const std::lock_guard<std::mutex> lock(host_thread_pool.mutex);
+        host_thread_pool.exiting = true;
+        host_thread_pool.cond.notify_all();
+    }
+    stop_guest_scheduler(guest_scheduler);
+
+    const ProfiledLockGuard lock(mutex);
     for (auto [_, thread] : threads) {
         thread->exit_delete();
     }
 }
 
 void KernelState::pause_threads() {
-    const std::lock_guard<std::mutex> lock(mutex);
+    const ProfiledLockGuard lock(mutex);
     for (auto [_, thread] : threads) {
         paused_threads_status[thread->id] = thread->status;
         if (thread->status == ThreadStatus::run)
@@ -183,7 +285,7 @@ void KernelState::pause_threads() {
 }
 
 void KernelState::resume_threads() {
-    const std::lock_guard<std::mutex> lock(mutex);
+    const ProfiledLockGuard lock(mutex);
     for (auto [_, thread] : threads) {
         if (paused_threads_status[thread->id] == ThreadStatus::run)
             thread->resume();
@@ -191,6 +293,12 @@ void KernelState::resume_threads() {
     paused_threads_status.clear();
 }
 
+ThreadStatus KernelState::get_paused_status(const ThreadState &thread) {
+    const ProfiledLockGuard lock(mutex);
+    const auto it = paused_threads_status.find(thread.id);
+    return it != paused_threads_status.end() ? it->second : thread.status;
+}
+
 std::shared_ptr<SceKernelModuleInfo> KernelState::find_module_by_addr(Address address) {
     const auto lock = std::lock_guard(mutex);
     for (auto [_, mod] : loaded_modules) {
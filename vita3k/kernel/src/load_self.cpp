@@ -16,8 +16,10 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <cpu/functions.h>
+#include <kernel/hot_routines.h>
 #include <kernel/load_self.h>
 #include <kernel/relocation.h>
+#include <kernel/self_cache.h>
 #include <kernel/state.h>
 #include <kernel/types.h>
 
@@ -36,7 +38,9 @@
 #include <miniz.h>
 #include <self.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
@@ -58,66 +62,72 @@ struct VarImportsHeader {
 };
 static_assert(sizeof(VarImportsHeader) == sizeof(uint32_t));
 
-static bool load_var_imports(const uint32_t *nids, const Ptr<uint32_t> *entries, size_t count, const SegmentInfosForReloc &segments, KernelState &kernel, MemState &mem, uint32_t module_id) {
-    for (size_t i = 0; i < count; ++i) {
-        const uint32_t nid = nids[i];
-        const Ptr<uint32_t> entry = entries[i];
+struct FuncImport {
+    uint32_t nid;
+    Ptr<uint32_t> entry;
+    // 0 when no loaded module exports the nid
+    Address export_address;
+};
 
-        if (kernel.debugger.log_imports) {
-            const char *const name = import_name(nid);
-            LOG_DEBUG("\tNID {} ({}). entry: {}, *entry: {}", log_hex(nid), name, log_hex(entry.address()), log_hex(*entry.get(mem)));
-        }
+struct VarImport {
+    uint32_t nid;
+    Ptr<uint32_t> entry;
+    void *reloc_entries;
+    uint32_t reloc_size;
+    Address export_address;
+};
 
-        VarImportsHeader *const var_reloc_header = reinterpret_cast<VarImportsHeader *>(entry.get(mem));
-        const auto var_reloc_entries = static_cast<void *>(var_reloc_header + 1);
-        const uint32_t reloc_size = (var_reloc_header->reloc_data_size > sizeof(VarImportsHeader)) ? (var_reloc_header->reloc_data_size - sizeof(VarImportsHeader)) : 0;
+// the nids of all the imports of the module are resolved while holding the lock once
+static void resolve_imports(std::vector<FuncImport> &func_imports, std::vector<VarImport> &var_imports, KernelState &kernel, MemState &mem, uint32_t module_id) {
+    const std::lock_guard<std::mutex> guard(kernel.export_nids_mutex);
+    for (FuncImport &import : func_imports) {
+        const ExportNids::iterator export_address_it = kernel.export_nids.find(import.nid);
+        import.export_address = (export_address_it != kernel.export_nids.end()) ? export_address_it->second : 0;
+    }
 
+    for (VarImport &import : var_imports) {
+        const uint32_t nid = import.nid;
         const char *const name = import_name(nid);
-        Address export_address;
-        {
-            const std::lock_guard<std::mutex> guard(kernel.export_nids_mutex);
-            const ExportNids::iterator export_address_it = kernel.export_nids.find(nid);
-            if (export_address_it != kernel.export_nids.end()) {
-                export_address = export_address_it->second;
-                if (kernel.late_binding_infos.contains(nid)) {
-                    kernel.late_binding_infos.emplace(nid, late_binding_info({ var_reloc_entries, reloc_size, module_id }));
-                    LOG_WARN("\tNID NOT FOUND AGAIN {} ({}) at {}, setting to stub value {}", log_hex(nid), name, log_hex(entry.address()), *Ptr<uint32_t>(export_address).get(mem));
-                }
-            } else {
-                constexpr auto STUB_SYMVAL = 0xDEADBEEF;
-                LOG_WARN("\tNID NOT FOUND {} ({}) at {}, setting to stub value {}", log_hex(nid), name, log_hex(entry.address()), log_hex(STUB_SYMVAL));
+        const ExportNids::iterator export_address_it = kernel.export_nids.find(nid);
+        if (export_address_it != kernel.export_nids.end()) {
+            import.export_address = export_address_it->second;
+            if (kernel.late_binding_infos.contains(nid)) {
+                kernel.late_binding_infos.emplace(nid, late_binding_info({ import.reloc_entries, import.reloc_size, module_id }));
+                LOG_WARN("\tNID NOT FOUND AGAIN {} ({}) at {}, setting to stub value {}", log_hex(nid), name, log_hex(import.entry.address()), *Ptr<uint32_t>(import.export_address).get(mem));
+            }
+        } else {
+            constexpr auto STUB_SYMVAL = 0xDEADBEEF;
+            LOG_WARN("\tNID NOT FOUND {} ({}) at {}, setting to stub value {}", log_hex(nid), name, log_hex(import.entry.address()), log_hex(STUB_SYMVAL));
 
-                auto alloc_name = fmt::format("Stub var import reloc symval, NID {} ({})", log_hex(nid), name);
-                auto stub_symval_ptr = Ptr<uint32_t>(alloc(mem, 4, alloc_name.c_str()));
-                *stub_symval_ptr.get(mem) = STUB_SYMVAL;
+            auto alloc_name = fmt::format("Stub var import reloc symval, NID {} ({})", log_hex(nid), name);
+            auto stub_symval_ptr = Ptr<uint32_t>(alloc(mem, 4, alloc_name.c_str()));
+            *stub_symval_ptr.get(mem) = STUB_SYMVAL;
 
-                export_address = stub_symval_ptr.address();
+            import.export_address = stub_symval_ptr.address();
 
-                // Use same stub for other var imports
-                kernel.export_nids.emplace(nid, export_address);
-                kernel.late_binding_infos.emplace(nid, late_binding_info({ var_reloc_entries, reloc_size, module_id }));
-            }
+            // Use same stub for other var imports
+            kernel.export_nids.emplace(nid, import.export_address);
+            kernel.late_binding_infos.emplace(nid, late_binding_info({ import.reloc_entries, import.reloc_size, module_id }));
         }
-        if (reloc_size)
+    }
+}
+
+static bool load_var_imports(const std::vector<VarImport> &var_imports, const SegmentInfosForReloc &segments, const MemState &mem) {
+    for (const VarImport &import : var_imports) {
+        if (import.reloc_size)
             // 8 is sizeof(EntryFormat1Alt)
-            if (!relocate(var_reloc_entries, reloc_size, segments, mem, true, export_address))
+            if (!relocate(import.reloc_entries, import.reloc_size, segments, mem, true, import.export_address))
                 return false;
     }
 
     return true;
 }
 
-static bool load_func_imports(const uint32_t *nids, const Ptr<uint32_t> *entries, size_t count, const SegmentInfosForReloc &segments, KernelState &kernel, const MemState &mem) {
-    for (size_t i = 0; i < count; ++i) {
-        const uint32_t nid = nids[i];
-        const Ptr<uint32_t> entry = entries[i];
-
-        if (kernel.debugger.log_imports) {
-            const char *const name = import_name(nid);
-            LOG_DEBUG("\tNID {} ({}) at {}", log_hex(nid), name, log_hex(entry.address()));
-        }
+static bool load_func_imports(const std::vector<FuncImport> &func_imports, const SegmentInfosForReloc &segments, const MemState &mem) {
+    for (const FuncImport &import : func_imports) {
+        const uint32_t nid = import.nid;
+        const Ptr<uint32_t> entry = import.entry;
 
-        const ExportNids::iterator export_address = kernel.export_nids.find(nid);
         uint32_t *const stub = entry.get(mem);
         // TODO resurrect this
         /*
@@ -136,12 +146,16 @@ static bool load_func_imports(const uint32_t *nids, const Ptr<uint32_t> *entries
         }
         */
 
-        if (export_address == kernel.export_nids.end()) {
-            stub[0] = 0xef000000; // svc #0 - Call our interrupt hook.
+        if (import.export_address == 0) {
+            const uint32_t index = import_index(nid);
+            if (index != INVALID_IMPORT_INDEX)
+                stub[0] = 0xef000000 | HLE_IMPORT_SVC | index; // svc #index - Call our interrupt hook with the resolved HLE function.
+            else
+                stub[0] = 0xef000000; // svc #0 - Call our interrupt hook.
             stub[1] = 0xe1a0f00e; // mov pc, lr - Return to the caller.
             stub[2] = nid; // Our interrupt hook will read this.
         } else {
-            Address func_address = export_address->second;
+            Address func_address = import.export_address;
             stub[0] = encode_arm_inst(INSTRUCTION_MOVW, (uint16_t)func_address, 12);
             stub[1] = encode_arm_inst(INSTRUCTION_MOVT, (uint16_t)(func_address >> 16), 12);
             stub[2] = encode_arm_inst(INSTRUCTION_BRANCH, 0, 12);
@@ -165,6 +179,8 @@ static bool load_imports(const sce_module_info_raw &module, Ptr<const void> segm
     const sce_module_imports_raw *const imports_begin = reinterpret_cast<const sce_module_imports_raw *>(base + module.import_top);
     const sce_module_imports_raw *const imports_end = reinterpret_cast<const sce_module_imports_raw *>(base + module.import_end);
 
+    std::vector<FuncImport> func_imports;
+    std::vector<VarImport> var_imports;
     for (const sce_module_imports_raw *imports = imports_begin; imports < imports_end; imports = reinterpret_cast<const sce_module_imports_raw *>(reinterpret_cast<const uint8_t *>(imports) + imports->size)) {
         assert(imports->num_syms_tls_vars == 0);
 
@@ -200,8 +216,12 @@ static bool load_imports(const sce_module_info_raw &module, Ptr<const void> segm
         const Ptr<uint32_t> *const entries = Ptr<Ptr<uint32_t>>(func_entry_table).get(mem);
 
         const size_t num_syms_funcs = imports->num_syms_funcs;
-        if (!load_func_imports(nids, entries, num_syms_funcs, segments, kernel, mem)) {
-            return false;
+        for (size_t i = 0; i < num_syms_funcs; ++i) {
+            if (kernel.debugger.log_imports) {
+                const char *const name = import_name(nids[i]);
+                LOG_DEBUG("\tNID {} ({}) at {}", log_hex(nids[i]), name, log_hex(entries[i].address()));
+            }
+            func_imports.push_back({ nids[i], entries[i], 0 });
         }
 
         const uint32_t *const var_nids = Ptr<const uint32_t>(var_nid_table).get(mem);
@@ -213,12 +233,25 @@ static bool load_imports(const sce_module_info_raw &module, Ptr<const void> segm
             LOG_INFO("Loading var imports from {}", lib_name);
         }
 
-        if (!load_var_imports(var_nids, var_entries, var_count, segments, kernel, mem, module.module_nid)) {
-            return false;
+        for (size_t i = 0; i < var_count; ++i) {
+            const uint32_t nid = var_nids[i];
+            const Ptr<uint32_t> entry = var_entries[i];
+
+            if (kernel.debugger.log_imports) {
+                const char *const name = import_name(nid);
+                LOG_DEBUG("\tNID {} ({}). entry: {}, *entry: {}", log_hex(nid), name, log_hex(entry.address()), log_hex(*entry.get(mem)));
+            }
+
+            VarImportsHeader *const var_reloc_header = reinterpret_cast<VarImportsHeader *>(entry.get(mem));
+            const auto var_reloc_entries = static_cast<void *>(var_reloc_header + 1);
+            const uint32_t reloc_size = (var_reloc_header->reloc_data_size > sizeof(VarImportsHeader)) ? (var_reloc_header->reloc_data_size - sizeof(VarImportsHeader)) : 0;
+            var_imports.push_back({ nid, entry, var_reloc_entries, reloc_size, 0 });
         }
     }
 
-    return true;
+    resolve_imports(func_imports, var_imports, kernel, mem, module.module_nid);
+
+    return load_func_imports(func_imports, segments, mem) && load_var_imports(var_imports, segments, mem);
 }
 
 static bool load_func_exports(SceKernelModuleInfo *kernel_module_info, const uint32_t *nids, const Ptr<uint32_t> *entries, size_t count, KernelState &kernel) {
@@ -244,6 +277,10 @@ static bool load_func_exports(SceKernelModuleInfo *kernel_module_info, const uin
             const std::lock_guard<std::mutex> guard(kernel.export_nids_mutex);
             kernel.export_nids.emplace(nid, entry.address());
         }
+        // the HLE stubs already written for this NID must now jump to the exported function
+        const uint32_t index = import_index(nid);
+        if (index != INVALID_IMPORT_INDEX)
+            kernel.hle_import_exported[index] = true;
 
         if (kernel.debugger.log_exports) {
             const char *const name = import_name(nid);
@@ -299,12 +336,9 @@ static bool load_var_exports(const uint32_t *nids, const Ptr<uint32_t> *entries,
                     auto &late_binding_info_v = i->second;
                     if (late_binding_info_v.size > 0) {
                         if (last_module_nid != late_binding_info_v.module_nid) {
-                            // TODO: uncomment when invalidate_jit_cache will be thread safe
-                            /* if (!seg.empty()) {
-                                for (const auto &[key, value] : seg) {
-                                    kernel.invalidate_jit_cache(value.addr, value.size);
-                                }
-                            }*/
+                            for (const auto &[key, value] : seg) {
+                                kernel.invalidate_jit_cache(value.addr, value.size);
+                            }
                             seg.clear();
                             const auto module_info = kernel.loaded_modules[kernel.module_uid_by_nid[late_binding_info_v.module_nid]];
                             if (!module_info) {
@@ -335,14 +369,9 @@ static bool load_var_exports(const uint32_t *nids, const Ptr<uint32_t> *entries,
             }
         }
     }
-    // TODO: uncomment when invalidate_jit_cache will be thread safe
-    /*
-    if (!seg.empty()) {
-        for (const auto &[key, value] : seg) {
-            kernel.invalidate_jit_cache(value.addr, value.size);
-        }
+    for (const auto &[key, value] : seg) {
+        kernel.invalidate_jit_cache(value.addr, value.size);
     }
-    */
     return true;
 }
 
@@ -381,7 +410,7 @@ static bool load_exports(SceKernelModuleInfo *kernel_module_info, const sce_modu
 /**
  * \return Negative on failure
  */
-SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std::string &self_path, const std::string &dump_path) {
+SceUID load_self(KernelState &kernel, MemState &mem, const void *self, size_t self_size, const std::string &self_path, const std::string &dump_path) {
     // TODO: use raw I/O from path when io becomes less bad
     const uint8_t *const self_bytes = static_cast<const uint8_t *>(self);
     const SCE_header &self_header = *static_cast<const SCE_header *>(self);
@@ -484,6 +513,40 @@ SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std
         }
     };
 
+    // the decompressed segments are taken from the cache once the module has been loaded a first time
+    const bool has_compressed_segments = std::any_of(seg_infos, seg_infos + elf.e_phnum, [](const segment_info &info) {
+        return info.compression == 2;
+    });
+    const bool use_self_cache = !kernel.self_cache_path.empty() && has_compressed_segments;
+    std::string self_image_name;
+    SelfImage self_image;
+    std::map<uint16_t, std::vector<uint8_t>> decompressed_segments;
+    if (use_self_cache) {
+        self_image_name = get_self_image_name(self, self_size);
+        open_self_image(self_image, kernel.self_cache_path, self_image_name);
+    }
+
+    const auto decompress_segment = [&](Elf_Half seg_index, uint8_t *dest, uint32_t size) {
+        const auto cached = self_image.segments.find(seg_index);
+        if (cached != self_image.segments.end() && cached->second.size() == size) {
+            memcpy(dest, cached->second.data(), size);
+            return;
+        }
+
+        mz_ulong dest_bytes = size;
+        const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[seg_index].offset;
+        int res = mz_uncompress(dest, &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
+        assert(res == MZ_OK);
+        if (use_self_cache)
+            decompressed_segments[seg_index].assign(dest, dest + size);
+    };
+
+    const auto get_elapsed_us = [](std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    };
+    const auto segments_start = std::chrono::steady_clock::now();
+    uint64_t relocation_us = 0;
+
     for (Elf_Half seg_index = 0; seg_index < elf.e_phnum; ++seg_index) {
         const Elf32_Phdr &seg_header = segments[seg_index];
         const uint8_t *const seg_bytes = self_bytes + self_header.header_len + seg_header.p_offset;
@@ -535,11 +598,7 @@ SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std
 
                 const Ptr<uint8_t> seg_ptr(segment_address);
                 if (seg_infos[seg_index].compression == 2) {
-                    unsigned long dest_bytes = seg_header.p_filesz;
-                    const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[seg_index].offset;
-
-                    int res = mz_uncompress(reinterpret_cast<uint8_t *>(seg_ptr.get(mem)), &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
-                    assert(res == MZ_OK);
+                    decompress_segment(seg_index, seg_ptr.get(mem), seg_header.p_filesz);
                 } else {
                     memcpy(seg_ptr.get(mem), seg_bytes, seg_header.p_filesz);
                 }
@@ -548,20 +607,20 @@ SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std
             }
         } else if (seg_header.p_type == PT_SCE_RELA) {
             if (seg_infos[seg_index].compression == 2) {
-                unsigned long dest_bytes = seg_header.p_filesz;
-                const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[seg_index].offset;
-                auto uncompressed = std::make_unique<uint8_t[]>(dest_bytes);
-
-                int res = mz_uncompress(uncompressed.get(), &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
-                assert(res == MZ_OK);
+                auto uncompressed = std::make_unique<uint8_t[]>(seg_header.p_filesz);
+                decompress_segment(seg_index, uncompressed.get(), seg_header.p_filesz);
+                const auto relocation_start = std::chrono::steady_clock::now();
                 if (!relocate(uncompressed.get(), seg_header.p_filesz, segment_reloc_info, mem)) {
                     return -1;
                 }
+                relocation_us += get_elapsed_us(relocation_start);
 
             } else {
+                const auto relocation_start = std::chrono::steady_clock::now();
                 if (!relocate(seg_bytes, seg_header.p_filesz, segment_reloc_info, mem)) {
                     return -1;
                 }
+                relocation_us += get_elapsed_us(relocation_start);
             }
         } else if ((seg_header.p_type == PT_SCE_COMMENT) || (seg_header.p_type == PT_SCE_VERSION)
             || (seg_header.p_type == PT_ARM_EXIDX) /* TODO: this may be important and require being loaded */) {
@@ -571,6 +630,13 @@ SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std
         }
     }
 
+    const uint64_t segments_us = get_elapsed_us(segments_start) - relocation_us;
+
+    if (!decompressed_segments.empty()) {
+        self_image.file.close();
+        save_self_image(kernel.self_cache_path, self_image_name, decompressed_segments);
+    }
+
     if (kernel.debugger.dump_elfs) {
         // Dump elf
         std::vector<uint8_t> dump_elf(self_bytes + self_header.header_len, self_bytes + self_header.self_filesize);
@@ -646,25 +712,43 @@ SceUID load_self(KernelState &kernel, MemState &mem, const void *self, const std
         segment.vaddr = it->second.addr;
         segment.memsz = segments[segment_index].p_memsz;
         segment.filesz = segments[segment_index].p_filesz;
+
+        if (kernel.hle_hot_routines && (segments[segment_index].p_flags & PF_X)) {
+            const uint32_t replaced = replace_hot_routines(kernel, mem, segment.vaddr.address(), segment.filesz, sceKernelModuleInfo->module_name);
+            if (replaced > 0)
+                LOG_INFO("Replaced {} libc routines of module {} by host implementations", replaced, sceKernelModuleInfo->module_name);
+        }
     }
 
     sceKernelModuleInfo->state = module_info->type;
 
     LOG_INFO("Linking SELF {}...", self_path);
 
+    const auto exports_start = std::chrono::steady_clock::now();
     if (!load_exports(sceKernelModuleInfo.get(), *module_info, module_info_segment_address, kernel, mem)) {
         return -1;
     }
+    const uint64_t exports_us = get_elapsed_us(exports_start);
 
+    const auto imports_start = std::chrono::steady_clock::now();
     if (!load_imports(*module_info, module_info_segment_address, segment_reloc_info, kernel, mem)) {
         return -1;
     }
+    const uint64_t imports_us = get_elapsed_us(imports_start);
+
+    LOG_DEBUG_IF(LOG_MODULE_LOADING, "Loaded {} in {} us (segments: {} us, relocation: {} us, exports: {} us, imports: {} us)", self_path, segments_us + relocation_us + exports_us + imports_us, segments_us, relocation_us, exports_us, imports_us);
 
     const SceUID uid = kernel.get_next_uid();
     sceKernelModuleInfo->modid = uid;
     {
-        const std::lock_guard<std::mutex> lock(kernel.mutex);
+        const ProfiledLockGuard lock(kernel.mutex);
         kernel.loaded_modules.emplace(uid, sceKernelModuleInfo);
+        ModuleLoadProfile &profile = kernel.module_load_profile;
+        profile.module_count++;
+        profile.segments_us += segments_us;
+        profile.relocation_us += relocation_us;
+        profile.exports_us += exports_us;
+        profile.imports_us += imports_us;
     }
     {
         const std::lock_guard<std::mutex> guard(kernel.export_nids_mutex);
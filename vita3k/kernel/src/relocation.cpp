@@ -20,11 +20,20 @@
 
 #include <self.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
+#include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
 static constexpr bool LOG_RELOCATIONS = false;
+// below this size, the entries are relocated on the calling thread only
+static constexpr uint32_t PARALLEL_RELOCATION_SIZE = 256 * 1024;
+// size of the parts of the entries relocated by each worker
+static constexpr uint32_t RELOCATION_CHUNK_SIZE = 64 * 1024;
 
 enum Code {
     None = 0,
@@ -245,6 +254,19 @@ static void write_thumb_mov_abs(void *data, uint16_t symbol) {
     pair->upper.imm4 = symbol >> 12;
 }
 
+// registers of the relocation stream, most formats are relative to the entries before them
+struct RelocationState {
+    Address addr = 0;
+    Address offset = 0;
+    Address patchseg = 0;
+    Address saddr = 0;
+    Address addend = 0;
+    Address type = 0;
+    Address type2 = 0;
+    // set when saddr has to be found from the original value at this address, see resolve_symbol
+    std::optional<Address> saddr_address;
+};
+
 static bool relocate_entry(void *data, uint32_t code, uint32_t symval, uint32_t addend, uint32_t addr) {
     LOG_DEBUG_IF(LOG_RELOCATIONS, "code: {}, *data: {}, data: {}, addr: {}, symval: {}, addend: {}", code, log_hex(*(reinterpret_cast<uint32_t *>(data))), data, log_hex(addr), log_hex(symval), log_hex(addend));
     switch (code) {
@@ -301,28 +323,23 @@ static bool relocate_entry(void *data, uint32_t code, uint32_t symval, uint32_t
     return true; // ignore unhandled relocations
 }
 
-bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem, bool is_var_import, uint32_t explicit_symval) {
-    const void *const end = static_cast<const uint8_t *>(entries) + size;
-    const Entry *entry = static_cast<const Entry *>(entries);
-
-    const auto segment_count = segments.size();
-
-    if (LOG_RELOCATIONS) {
-        LOG_DEBUG("Relocating patch of size: {}, # of segments: {}", log_hex(size), segment_count);
-        for (const auto &seg : segments)
-            LOG_DEBUG("    Segment: {} -> {} (size: {})", seg.first, log_hex(seg.second.addr), seg.second.size);
-    }
+// Relocates the entries from entry to end, starting from the registers left by the entries before them.
+// When apply is false, only the registers are updated. Returns the entry after the last one, or nullptr on error.
+static const Entry *relocate_entries(const Entry *entry, const void *end, RelocationState &state, const SegmentInfosForReloc &segments, const MemState &mem, bool is_var_import, uint32_t explicit_symval, bool apply) {
+    const auto patch = [&](Address p, uint32_t code, uint32_t s, uint32_t a) {
+        return !apply || relocate_entry(Ptr<uint32_t>(p).get(mem), code, s, a, p);
+    };
 
     // initialized in format 1 and 2
-    Address g_addr = 0,
-            g_offset = 0,
-            g_patchseg = 0;
+    Address &g_addr = state.addr,
+            &g_offset = state.offset,
+            &g_patchseg = state.patchseg;
 
     // initiliazed in format 0, 1, 2, and 3
-    Address g_saddr = 0,
-            g_addend = 0,
-            g_type = 0,
-            g_type2 = 0;
+    Address &g_saddr = state.saddr,
+            &g_addend = state.addend,
+            &g_type = state.type,
+            &g_type2 = state.type2;
 
     const EntryFormatUnknown *generic_entry = nullptr;
     while (entry < end) {
@@ -347,8 +364,8 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT0]: offset: {}, code: {}, sym_seg: {}, sym_start: {}, patch_seg: {}, patch_start: {}, s: {}, p: {}, a: {}. {}",
                 format0_entry->offset, format0_entry->code, symbol_seg, log_hex(symbol_seg_start), patch_seg, log_hex(patch_seg_start), log_hex(s), log_hex(p), log_hex(a), log_hex((uint64_t)Ptr<uint32_t>(p).get(mem)));
 
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format0_entry->code, s, a, p)) {
-                return false;
+            if (!patch(p, format0_entry->code, s, a)) {
+                return nullptr;
             }
 
             const Address addr2 = p + format0_entry->dist2 * 2;
@@ -357,8 +374,8 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT0/2]: code: {}, sym_seg: {}, sym_start: {}, s: {}, patch_seg: {}, p: {}, a: {}. {}",
                     format0_entry->code2, format0_entry->symbol_segment, symbol_seg_start, format0_entry->patch_segment, log_hex(patch_seg_start), log_hex(s), log_hex(addr2), log_hex(a), log_hex((uint64_t)Ptr<uint32_t>(addr2).get(mem)));
 
-                if (!relocate_entry(Ptr<uint32_t>(addr2).get(mem), format0_entry->code2, s, a, addr2)) {
-                    return false;
+                if (!patch(addr2, format0_entry->code2, s, a)) {
+                    return nullptr;
                 }
             }
 
@@ -366,6 +383,7 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             g_offset = format0_entry->offset;
             g_patchseg = format0_entry->patch_segment;
             g_saddr = s;
+            state.saddr_address.reset();
             g_addend = a;
             g_type = format0_entry->code;
             g_type2 = format0_entry->code2;
@@ -389,14 +407,15 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT1]: code: {}, sym_seg: {}, sym_start: {}, patch_seg: {}, data_start: {}, s: {}, offset: {}, p: {}, a: {}",
                     format1_entry->code, symbol_seg, log_hex(symbol_seg_start), patch_seg, log_hex(patch_seg_start), log_hex(s), format1_entry->patch_segment, patch_seg_start, log_hex(offset), log_hex(p), log_hex(a));
 
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format1_entry->code, s, a, p)) {
-                    return false;
+                if (!patch(p, format1_entry->code, s, a)) {
+                    return nullptr;
                 }
 
                 g_addr = patch_seg_start;
                 g_offset = offset;
                 g_patchseg = format1_entry->patch_segment;
                 g_saddr = s;
+                state.saddr_address.reset();
                 g_addend = a;
                 g_type = format1_entry->code;
                 g_type2 = 0;
@@ -423,14 +442,15 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT1_VAR_IMPORT]: code: {}, patch_seg: {}, data_start: {}, s: {}, offset: {}, p: {}, a: {}",
                     format1_entry->code, patch_seg, log_hex(patch_seg_start), log_hex(s), format1_entry->patch_segment, patch_seg_start, log_hex(offset), log_hex(p), log_hex(a));
 
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format1_entry->code, s, a, p)) {
-                    return false;
+                if (!patch(p, format1_entry->code, s, a)) {
+                    return nullptr;
                 }
 
                 g_addr = patch_seg_start;
                 g_offset = offset;
                 g_patchseg = format1_entry->patch_segment;
                 g_saddr = s;
+                state.saddr_address.reset();
                 g_addend = a;
                 g_type = format1_entry->code;
                 g_type2 = 0;
@@ -447,6 +467,7 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
 
                 g_offset += format2_entry->offset;
                 g_saddr = (format2_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
+                state.saddr_address.reset();
                 g_addend = format2_entry->addend;
                 g_type = format2_entry->code;
 
@@ -457,8 +478,8 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT2]: code: {}, sym_seg: {}, sym_start: {}, offset: {}, s: {}, p: {}, a: {}",
                     format2_entry->code, symbol_seg, log_hex(symbol_seg_start), log_hex(format2_entry->offset), log_hex(s), log_hex(p), log_hex(a));
 
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                    return false;
+                if (!patch(p, g_type, s, a)) {
+                    return nullptr;
                 }
 
                 g_type2 = 0;
@@ -484,14 +505,15 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT2_VAR_IMPORT]: code: {}, patch_seg: {}, data_start: {}, s: {}, offset: {}, p: {}, a: {}",
                     format1_entry->code, patch_seg, log_hex(patch_seg_start), log_hex(s), format1_entry->patch_segment, patch_seg_start, log_hex(offset), log_hex(p), log_hex(a));
 
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), format1_entry->code, s, a, p)) {
-                    return false;
+                if (!patch(p, format1_entry->code, s, a)) {
+                    return nullptr;
                 }
 
                 g_addr = patch_seg_start;
                 g_offset = offset;
                 g_patchseg = format1_entry->patch_segment;
                 g_saddr = s;
+                state.saddr_address.reset();
                 g_addend = a;
                 g_type = format1_entry->code;
                 g_type2 = 0;
@@ -523,17 +545,18 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
 
             g_offset += offset;
             g_saddr = s;
+            state.saddr_address.reset();
             g_addend = format3_entry->addend;
 
             const auto a = g_addend;
             const auto p = g_addr + g_offset;
 
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
+            if (!patch(p, g_type, s, a)) {
+                return nullptr;
             }
 
-            if (!relocate_entry(Ptr<uint32_t>(p + dist2).get(mem), g_type2, s, a, p + dist2)) {
-                return false;
+            if (!patch(p + dist2, g_type2, s, a)) {
+                return nullptr;
             }
 
             break;
@@ -551,12 +574,12 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             const auto a = g_addend;
             const auto p = g_addr + g_offset;
 
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
+            if (!patch(p, g_type, s, a)) {
+                return nullptr;
             }
 
-            if (!relocate_entry(Ptr<uint32_t>(p + dist2).get(mem), g_type2, s, a, p + dist2)) {
-                return false;
+            if (!patch(p + dist2, g_type2, s, a)) {
+                return nullptr;
             }
 
             break;
@@ -570,23 +593,23 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             const auto a = g_addend;
             const auto p = g_addr + g_offset;
 
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
+            if (!patch(p, g_type, s, a)) {
+                return nullptr;
             }
 
-            if (!relocate_entry(Ptr<uint32_t>(p + format5_entry->dist2).get(mem), g_type2, s, a, p + format5_entry->dist2)) {
-                return false;
+            if (!patch(p + format5_entry->dist2, g_type2, s, a)) {
+                return nullptr;
             }
 
             g_offset += format5_entry->dist3;
             const auto p2 = g_addr + g_offset;
 
-            if (!relocate_entry(Ptr<uint32_t>(p2).get(mem), g_type, s, a, p2)) {
-                return false;
+            if (!patch(p2, g_type, s, a)) {
+                return nullptr;
             }
 
-            if (!relocate_entry(Ptr<uint32_t>(p2 + format5_entry->dist4).get(mem), g_type2, s, a, p2 + format5_entry->dist4)) {
-                return false;
+            if (!patch(p2 + format5_entry->dist4, g_type2, s, a)) {
+                return nullptr;
             }
 
             break;
@@ -598,6 +621,14 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
 
             const auto patch_seg_start = segments.find(g_patchseg)->second.addr;
 
+            if (!apply) {
+                // the symbol is only needed by the entries after it, it is found from the original value once the registers are known
+                g_type2 = 0;
+                g_type = Abs32;
+                state.saddr_address = patch_seg_start + g_offset;
+                break;
+            }
+
             const uint32_t orgval = *Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
 
             uint32_t segbase = 0;
@@ -619,8 +650,8 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             const auto a = addend;
             const auto p = g_addr + g_offset;
 
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
+            if (!patch(p, g_type, s, a)) {
+                return nullptr;
             }
 
             break;
@@ -650,6 +681,13 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
 
                 const auto patch_seg_start = segments.find(g_patchseg)->second.addr;
 
+                if (!apply) {
+                    g_type2 = 0;
+                    g_type = Abs32;
+                    state.saddr_address = patch_seg_start + g_offset;
+                    continue;
+                }
+
                 const uint32_t orgval = *Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
 
                 uint32_t segbase = 0;
@@ -671,8 +709,8 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 const auto a = addend;
                 const auto p = g_addr + g_offset;
 
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                    return false;
+                if (!patch(p, g_type, s, a)) {
+                    return nullptr;
                 }
             } while (offsets >>= bitsize);
 
@@ -680,7 +718,7 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
         }
         default: {
             LOG_WARN("Unknown relocation entry format {} ", generic_entry->format);
-            return false;
+            return nullptr;
         }
         }
 
@@ -701,5 +739,74 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
         // clang-format on
     }
 
-    return true;
+    return entry;
+}
+
+// the formats 6 to 9 take the symbol from the segment holding the original value they patch,
+// which is always an address of the module
+static void resolve_symbol(RelocationState &state, const SegmentInfosForReloc &segments, const MemState &mem) {
+    if (!state.saddr_address)
+        return;
+
+    const uint32_t orgval = *Ptr<uint32_t>(*state.saddr_address).get(mem);
+    for (const auto &seg_ : segments) {
+        const auto seg = seg_.second;
+        if (orgval >= seg.p_vaddr && orgval < seg.p_vaddr + seg.size)
+            state.saddr = seg.addr;
+    }
+    state.saddr_address.reset();
+}
+
+bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem, bool is_var_import, uint32_t explicit_symval) {
+    const uint8_t *const end = static_cast<const uint8_t *>(entries) + size;
+    const Entry *const begin = static_cast<const Entry *>(entries);
+
+    if (LOG_RELOCATIONS) {
+        LOG_DEBUG("Relocating patch of size: {}, # of segments: {}", log_hex(size), segments.size());
+        for (const auto &seg : segments)
+            LOG_DEBUG("    Segment: {} -> {} (size: {})", seg.first, log_hex(seg.second.addr), seg.second.size);
+    }
+
+    RelocationState state;
+    const size_t worker_count = std::min<size_t>(std::thread::hardware_concurrency(), size / RELOCATION_CHUNK_SIZE);
+    if (is_var_import || size < PARALLEL_RELOCATION_SIZE || worker_count < 2)
+        return relocate_entries(begin, end, state, segments, mem, is_var_import, explicit_symval, true) != nullptr;
+
+    // The entries patch disjoint addresses, but each entry depends on the registers left by the ones before it.
+    // The registers at the start of each chunk are found first without patching anything, then the chunks are patched in parallel.
+    struct Chunk {
+        const Entry *begin;
+        const Entry *end;
+        RelocationState state;
+    };
+    std::vector<Chunk> chunks;
+    for (const Entry *chunk_begin = begin; chunk_begin < static_cast<const void *>(end);) {
+        const uint8_t *const chunk_target = reinterpret_cast<const uint8_t *>(chunk_begin) + std::min<size_t>(RELOCATION_CHUNK_SIZE, end - reinterpret_cast<const uint8_t *>(chunk_begin));
+        Chunk chunk{ chunk_begin, nullptr, state };
+        chunk.end = relocate_entries(chunk_begin, chunk_target, state, segments, mem, is_var_import, explicit_symval, false);
+        if (!chunk.end)
+            return false;
+        resolve_symbol(state, segments, mem);
+        chunks.push_back(chunk);
+        chunk_begin = chunk.end;
+    }
+
+    std::atomic<size_t> next_chunk = 0;
+    std::atomic<bool> failed = false;
+    const auto run_chunks = [&]() {
+        for (size_t index = next_chunk++; index < chunks.size() && !failed; index = next_chunk++) {
+            Chunk &chunk = chunks[index];
+            if (!relocate_entries(chunk.begin, chunk.end, chunk.state, segments, mem, is_var_import, explicit_symval, true))
+                failed = true;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < worker_count; i++)
+        workers.emplace_back(run_chunks);
+    run_chunks();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    return !failed;
 }
@@ -0,0 +1,125 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/self_cache.h>
+
+#include <util/log.h>
+
+#include <fmt/format.h>
+#include <xxh3.h>
+
+#include <cstring>
+
+static constexpr char image_magic[4] = { 'V', 'S', 'I', 'M' };
+// increase this value when the format of the images changes
+static constexpr uint32_t image_format_version = 1;
+
+struct ImageHeader {
+    char magic[4];
+    uint32_t format_version;
+    uint32_t segment_count;
+    uint32_t reserved;
+};
+
+struct ImageSegment {
+    uint32_t index;
+    uint32_t size;
+    // from the start of the file
+    uint64_t offset;
+};
+
+std::string get_self_image_name(const void *self, size_t self_size) {
+    const XXH128_hash_t hash = XXH3_128bits(self, self_size);
+    return fmt::format("{:016x}{:016x}.img", hash.high64, hash.low64);
+}
+
+bool open_self_image(SelfImage &image, const fs::path &cache_path, const std::string &name) {
+    const fs::path image_path = cache_path / name;
+    if (!fs::exists(image_path) || !image.file.open(image_path))
+        return false;
+
+    const uint8_t *const data = image.file.data();
+    const size_t size = image.file.size();
+    const ImageHeader *const header = reinterpret_cast<const ImageHeader *>(data);
+    if (size < sizeof(ImageHeader) || memcmp(header->magic, image_magic, sizeof(image_magic)) != 0
+        || header->format_version != image_format_version
+        || size < sizeof(ImageHeader) + sizeof(ImageSegment) * static_cast<size_t>(header->segment_count)) {
+        LOG_WARN("SELF image {} is invalid, ignoring it", image_path.string());
+        image.file.close();
+        return false;
+    }
+
+    const ImageSegment *const segments = reinterpret_cast<const ImageSegment *>(data + sizeof(ImageHeader));
+    for (uint32_t i = 0; i < header->segment_count; i++) {
+        const ImageSegment &segment = segments[i];
+        if (segment.offset > size || segment.size > size - segment.offset) {
+            LOG_WARN("SELF image {} is truncated, ignoring it", image_path.string());
+            image.segments.clear();
+            image.file.close();
+            return false;
+        }
+        image.segments.emplace(static_cast<uint16_t>(segment.index), std::span<const uint8_t>(data + segment.offset, segment.size));
+    }
+
+    return true;
+}
+
+void save_self_image(const fs::path &cache_path, const std::string &name, const std::map<uint16_t, std::vector<uint8_t>> &segments) {
+    boost::system::error_code error;
+    fs::create_directories(cache_path, error);
+
+    ImageHeader header{};
+    memcpy(header.magic, image_magic, sizeof(image_magic));
+    header.format_version = image_format_version;
+    header.segment_count = static_cast<uint32_t>(segments.size());
+
+    std::vector<ImageSegment> index;
+    uint64_t offset = sizeof(ImageHeader) + sizeof(ImageSegment) * segments.size();
+    for (const auto &[segment_index, content] : segments) {
+        index.push_back({ segment_index, static_cast<uint32_t>(content.size()), offset });
+        offset += content.size();
+    }
+
+    // the image is written under a temporary name so another instance never maps a partial image
+    const fs::path image_path = cache_path / name;
+    const fs::path temp_path = cache_path / (name + ".tmp");
+    {
+        fs::ofstream image_file(temp_path, std::ios::out | std::ios::binary);
+        if (!image_file.is_open()) {
+            LOG_ERROR("Failed to create SELF image {}", temp_path.string());
+            return;
+        }
+
+        image_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        image_file.write(reinterpret_cast<const char *>(index.data()), sizeof(ImageSegment) * index.size());
+        for (const auto &[segment_index, content] : segments)
+            image_file.write(reinterpret_cast<const char *>(content.data()), content.size());
+
+        if (!image_file.good()) {
+            LOG_ERROR("Failed to write SELF image {}", temp_path.string());
+            image_file.close();
+            fs::remove(temp_path, error);
+            return;
+        }
+    }
+
+    fs::rename(temp_path, image_path, error);
+    if (error) {
+        LOG_ERROR("Failed to save SELF image {}: {}", image_path.string(), error.message());
+        fs::remove(temp_path, error);
+    }
+}
@@ -20,6 +20,8 @@
 #include <kernel/sync_primitives.h>
 
 #include <kernel/types.h>
+#include <mem/atomic.h>
+#include <rtc/rtc.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 
@@ -49,9 +51,17 @@ inline CondvarPtrs &get_condvars(KernelState &kernel, SyncWeight weight) {
     return weight == SyncWeight::Light ? kernel.lwcondvars : kernel.condvars;
 }
 
+inline ObjectTable<Mutex> &get_mutex_table(KernelState &kernel, SyncWeight weight) {
+    return weight == SyncWeight::Light ? kernel.lwmutex_table : kernel.mutex_table;
+}
+
+inline ObjectTable<Condvar> &get_condvar_table(KernelState &kernel, SyncWeight weight) {
+    return weight == SyncWeight::Light ? kernel.lwcondvar_table : kernel.condvar_table;
+}
+
 inline int find_mutex(MutexPtr &mutex_out, MutexPtrs **mutexes_out, KernelState &kernel, const char *export_name, SceUID mutexid, SyncWeight weight) {
     MutexPtrs &mutexes = get_mutexes(kernel, weight);
-    mutex_out = lock_and_find(mutexid, mutexes, kernel.mutex);
+    mutex_out = lock_and_find(mutexid, mutexes, kernel.mutex, get_mutex_table(kernel, weight));
     if (!mutex_out) {
         return unknown_mutex_id(export_name, weight);
     }
@@ -64,7 +74,7 @@ inline int find_mutex(MutexPtr &mutex_out, MutexPtrs **mutexes_out, KernelState
 
 inline int find_condvar(CondvarPtr &condvar_out, CondvarPtrs **condvars_out, KernelState &kernel, const char *export_name, SceUID condid, SyncWeight weight) {
     CondvarPtrs &condvars = get_condvars(kernel, weight);
-    condvar_out = lock_and_find(condid, condvars, kernel.mutex);
+    condvar_out = lock_and_find(condid, condvars, kernel.mutex, get_condvar_table(kernel, weight));
     if (!condvar_out) {
         return unknown_cond_id(export_name, weight);
     }
@@ -77,15 +87,15 @@ inline int find_condvar(CondvarPtr &condvar_out, CondvarPtrs **condvars_out, Ker
 
 // TODO: Write remaining time to timeout ptr when it's successfully signaled
 // Assumes primitive_lock is locked and thread_lock is unlocked
-inline int handle_timeout(const ThreadStatePtr &thread, std::unique_lock<std::mutex> &thread_lock,
+inline int handle_timeout(KernelState &kernel, const ThreadStatePtr &thread, std::unique_lock<std::mutex> &thread_lock,
     std::unique_lock<std::mutex> &primitive_lock, WaitingThreadQueuePtr &queue,
-    const WaitingThreadData &data, const ThreadDataQueueInterator<WaitingThreadData> &data_it,
+    const WaitingThreadData &data, const ThreadDataQueue<WaitingThreadData>::iterator &data_it,
     const char *export_name, SceUInt *const timeout) {
     if (timeout) {
         bool status = false;
         auto start = std::chrono::steady_clock::now();
         if (*timeout > 0) {
-            status = thread->status_cond.wait_for(primitive_lock, std::chrono::microseconds{ *timeout }, [&] { return thread->status == ThreadStatus::run; });
+            status = timed_wait(kernel.timer_wheel, thread->status_cond, primitive_lock, timer_wheel_now() + rtc_host_duration(*timeout), [&] { return thread->status == ThreadStatus::run; });
         }
 
         if (!status) {
@@ -100,11 +110,11 @@ inline int handle_timeout(const ThreadStatePtr &thread, std::unique_lock<std::mu
             return RET_ERROR(SCE_KERNEL_ERROR_WAIT_TIMEOUT);
         } else {
             auto end = std::chrono::steady_clock::now();
-            uint32_t real_timeout = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+            const uint64_t real_timeout = rtc_guest_duration(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
             if (real_timeout > *timeout) {
                 *timeout = 0;
             } else {
-                *timeout = *timeout - real_timeout;
+                *timeout = *timeout - static_cast<SceUInt>(real_timeout);
             }
         }
     } else {
@@ -118,7 +128,7 @@ inline int handle_timeout(const ThreadStatePtr &thread, std::unique_lock<std::mu
 // * Simple events *
 // *****************
 
-SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr, SceUInt32 init_pattern) {
+SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt32 attr, SceUInt32 init_pattern) {
     if ((strlen(name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -127,7 +137,7 @@ SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *expor
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} pattern: {:#b}",
-            export_name, uid, thread_id, name, attr, init_pattern);
+            export_name, uid, thread->id, name, attr, init_pattern);
     }
 
     const SimpleEventPtr event = std::make_shared<SimpleEvent>();
@@ -145,28 +155,26 @@ SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *expor
     event->auto_reset = (event->attr & SCE_KERNEL_EVENT_ATTR_AUTO_RESET);
     event->cb_wakeup_only = (event->attr & SCE_KERNEL_ATTR_NOTIFY_CB_WAKEUP_ONLY);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     kernel.simple_events.emplace(uid, event);
 
     return uid;
 }
 
-SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 wait_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait) {
+SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 wait_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait) {
     const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
     if (!event) {
         // this may also be a timer event
-        return timer_waitorpoll(kernel, export_name, thread_id, event_id, wait_pattern, result_pattern, user_data, timeout, is_wait);
+        return timer_waitorpoll(kernel, export_name, thread, event_id, wait_pattern, result_pattern, user_data, timeout, is_wait);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} existing_pattern: {:#b} wait_pattern: {:#b} timeout: {}"
                   " waiting_threads: {}",
-            export_name, event->uid, thread_id, event->name, event->attr, event->pattern, wait_pattern, timeout ? *timeout : 0,
+            export_name, event->uid, thread->id, event->name, event->attr, event->pattern, wait_pattern, timeout ? *timeout : 0,
             event->waiting_threads->size());
     }
 
-    const ThreadStatePtr thread = kernel.get_thread(thread_id);
-
     std::unique_lock<std::mutex> event_lock(event->mutex);
 
     if (result_pattern)
@@ -195,7 +203,7 @@ SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, S
         const auto data_it = event->waiting_threads->push(data);
         thread_lock.unlock();
 
-        const int err = handle_timeout(thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
+        const int err = handle_timeout(kernel, thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
         if (err < 0) {
             // set it only if a timeout occurs
             // otherwise set in simple_event_setorpulse
@@ -210,7 +218,7 @@ SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, S
     }
 }
 
-SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt64 user_data, bool is_set) {
+SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 pattern, SceUInt64 user_data, bool is_set) {
     const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
@@ -219,7 +227,7 @@ SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, S
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} existing_pattern: {:#b} set_pattern: {:#b}"
                   " waiting_threads: {}",
-            export_name, event->uid, thread_id, event->name, event->attr, event->pattern, pattern,
+            export_name, event->uid, thread->id, event->name, event->attr, event->pattern, pattern,
             event->waiting_threads->size());
     }
 
@@ -265,16 +273,16 @@ SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, S
     return SCE_KERNEL_OK;
 }
 
-SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 clear_pattern) {
+SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 clear_pattern) {
     const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
     if (!event) {
         // this may also be a timer event
-        return timer_clear(kernel, export_name, thread_id, event_id, clear_pattern);
+        return timer_clear(kernel, export_name, thread, event_id, clear_pattern);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} clear_pattern: {:#b}",
-            export_name, event_id, thread_id, clear_pattern);
+            export_name, event_id, thread->id, clear_pattern);
     }
 
     const std::lock_guard<std::mutex> event_lock(event->mutex);
@@ -284,7 +292,7 @@ SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, SceUID
     return SCE_KERNEL_OK;
 }
 
-SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id) {
+SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id) {
     const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
@@ -292,11 +300,11 @@ SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUI
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} existing_pattern: {:#b} waiting_threads: {}",
-            export_name, event->uid, thread_id, event->name, event->attr, event->pattern, event->waiting_threads->size());
+            export_name, event->uid, thread->id, event->name, event->attr, event->pattern, event->waiting_threads->size());
     }
 
     if (event->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+        const ProfiledLockGuard kernel_lock(kernel.mutex);
         kernel.eventflags.erase(event_id);
     } else {
         // TODO:
@@ -311,12 +319,10 @@ SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUI
 // *********
 
 inline uint64_t get_current_time() {
-    return std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch())
-        .count();
+    return rtc_ticks_since_epoch();
 }
 
-SceUID timer_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr) {
+SceUID timer_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt32 attr) {
     if ((strlen(name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -325,7 +331,7 @@ SceUID timer_create(KernelState &kernel, MemState &mem, const char *export_name,
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
-            export_name, uid, thread_id, name, attr);
+            export_name, uid, thread->id, name, attr);
     }
 
     const TimerPtr timer = std::make_shared<Timer>();
@@ -339,7 +345,7 @@ SceUID timer_create(KernelState &kernel, MemState &mem, const char *export_name,
         timer->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     kernel.timers.emplace(uid, timer);
 
     return uid;
@@ -352,7 +358,7 @@ SceUID timer_find(KernelState &kernel, const char *export_name, const char *pNam
     if (LOG_SYNC_PRIMITIVES)
         LOG_DEBUG("{}: name: \"{}\"", export_name, pName);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
 
     const auto it = std::find_if(kernel.timers.begin(), kernel.timers.end(), [=](const auto &timer) {
         return strncmp(timer.second->name, pName, KERNELOBJECT_MAX_NAME_LENGTH) == 0;
@@ -371,7 +377,7 @@ static void timer_schedule_event(TimerPtr &timer) {
     timer->condvar.notify_all();
 }
 
-SceInt32 timer_set(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID timer_handle, SceUID type, SceKernelSysClock *interval, SceInt32 repeats) {
+SceInt32 timer_set(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID timer_handle, SceUID type, SceKernelSysClock *interval, SceInt32 repeats) {
     TimerPtr timer = lock_and_find(timer_handle, kernel.timers, kernel.mutex);
     if (!timer)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_TIMER_ID);
@@ -382,7 +388,7 @@ SceInt32 timer_set(KernelState &kernel, const char *export_name, SceUID thread_i
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} type: {} interval: {} repeats: {}"
                   " waiting_threads: {}",
-            export_name, timer->uid, thread_id, timer->name, timer->attr, type, *interval,
+            export_name, timer->uid, thread->id, timer->name, timer->attr, type, *interval,
             repeats, timer->waiting_threads->size());
     }
 
@@ -399,7 +405,7 @@ SceInt32 timer_set(KernelState &kernel, const char *export_name, SceUID thread_i
 
 // this function is actually only called by simple_event_waitorpoll
 // as the only way to wait for a timer is using the event function (a timer is an event)
-SceInt32 timer_waitorpoll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait) {
+SceInt32 timer_waitorpoll(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait) {
     TimerPtr timer = lock_and_find(event_id, kernel.timers, kernel.mutex);
     if (!timer) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
@@ -408,15 +414,13 @@ SceInt32 timer_waitorpoll(KernelState &kernel, const char *export_name, SceUID t
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} timeout: {}"
                   " waiting_threads: {}",
-            export_name, timer->uid, thread_id, timer->name, timer->attr, timeout ? *timeout : 0,
+            export_name, timer->uid, thread->id, timer->name, timer->attr, timeout ? *timeout : 0,
             timer->waiting_threads->size());
     }
 
     if (timeout)
         LOG_WARN_ONCE("Ignoring timeout");
 
-    const ThreadStatePtr thread = kernel.get_thread(thread_id);
-
     std::unique_lock<std::mutex> lock(timer->mutex);
 
     if (result_pattern)
@@ -462,10 +466,12 @@ SceInt32 timer_waitorpoll(KernelState &kernel, const char *export_name, SceUID t
 
         bool got_event = false;
         while (!got_event) {
-            uint64_t wait_time = timer->next_event - current_time;
             // wait before we got an event and we are the first thread in the waiting list
-            timer->condvar.wait_for(lock, std::chrono::microseconds(wait_time), [&] {
-                return (*timer->waiting_threads->begin()).thread->id == thread_id;
+            const uint64_t wait_time = rtc_host_duration(timer->next_event - current_time);
+            const uint64_t now = timer_wheel_now();
+            const uint64_t deadline = wait_time > std::numeric_limits<uint64_t>::max() - now ? std::numeric_limits<uint64_t>::max() : now + wait_time;
+            timed_wait(kernel.timer_wheel, timer->condvar, lock, deadline, [&] {
+                return (*timer->waiting_threads->begin()).thread->id == thread->id;
             });
             current_time = get_current_time();
             got_event = timer->event_set || current_time > timer->next_event;
@@ -486,7 +492,7 @@ SceInt32 timer_waitorpoll(KernelState &kernel, const char *export_name, SceUID t
 }
 
 // this function is actually only called by simple_event_clear
-SceInt32 timer_clear(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 clear_pattern) {
+SceInt32 timer_clear(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 clear_pattern) {
     TimerPtr timer = lock_and_find(event_id, kernel.timers, kernel.mutex);
     if (!timer) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
@@ -494,7 +500,7 @@ SceInt32 timer_clear(KernelState &kernel, const char *export_name, SceUID thread
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {}",
-            export_name, event_id, thread_id);
+            export_name, event_id, thread->id);
     }
 
     std::lock_guard<std::mutex> guard(timer->mutex);
@@ -502,7 +508,7 @@ SceInt32 timer_clear(KernelState &kernel, const char *export_name, SceUID thread
     return SCE_KERNEL_OK;
 }
 
-SceInt32 timer_start(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID timer_handle) {
+SceInt32 timer_start(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID timer_handle) {
     TimerPtr timer = lock_and_find(timer_handle, kernel.timers, kernel.mutex);
     if (!timer)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_TIMER_ID);
@@ -520,7 +526,7 @@ SceInt32 timer_start(KernelState &kernel, const char *export_name, SceUID thread
     return SCE_KERNEL_OK;
 }
 
-SceInt32 timer_stop(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID timer_handle) {
+SceInt32 timer_stop(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID timer_handle) {
     const TimerPtr timer = lock_and_find(timer_handle, kernel.timers, kernel.mutex);
     if (!timer)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_TIMER_ID);
@@ -538,7 +544,7 @@ SceInt32 timer_stop(KernelState &kernel, const char *export_name, SceUID thread_
 // * Mutex *
 // *********
 
-SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const char *export_name, const char *mutex_name, SceUID thread_id, SceUInt attr, int init_count, Ptr<SceKernelLwMutexWork> workarea, SyncWeight weight) {
+SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const char *export_name, const char *mutex_name, const ThreadStatePtr &thread, SceUInt attr, int init_count, Ptr<SceKernelLwMutexWork> workarea, SyncWeight weight) {
     if ((strlen(mutex_name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -559,7 +565,6 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     mutex->attr = attr;
     mutex->owner = nullptr;
     if (init_count > 0) {
-        const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
         mutex->owner = thread;
     }
     if (mutex->attr & SCE_KERNEL_ATTR_TH_PRIO) {
@@ -571,18 +576,18 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     if (weight == SyncWeight::Light) {
         SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
         workarea_mem->lockCount = init_count;
-        if (workarea_mem->lockCount)
-            workarea_mem->owner = thread_id;
+        workarea_mem->owner = init_count > 0 ? thread->id : 0;
         workarea_mem->attr = attr;
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     auto &mutexes = get_mutexes(kernel, weight);
     mutexes.emplace(uid, mutex);
+    get_mutex_table(kernel, weight).insert(uid, mutex);
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} init_count: {}",
-            export_name, uid, thread_id, mutex_name, attr, init_count);
+            export_name, uid, thread->id, mutex_name, attr, init_count);
     }
 
     if (uid_out) {
@@ -599,7 +604,7 @@ SceUID mutex_find(KernelState &kernel, const char *export_name, const char *pNam
     if (LOG_SYNC_PRIMITIVES)
         LOG_DEBUG("{}: name: \"{}\"", export_name, pName);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
 
     const auto it = std::find_if(kernel.mutexes.begin(), kernel.mutexes.end(), [=](const auto &mutex) {
         return strncmp(mutex.second->name, pName, KERNELOBJECT_MAX_NAME_LENGTH) == 0;
@@ -611,14 +616,161 @@ SceUID mutex_find(KernelState &kernel, const char *export_name, const char *pNam
     return RET_ERROR(SCE_KERNEL_ERROR_UID_CANNOT_FIND_BY_NAME);
 }
 
-inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int lock_count, MutexPtr &mutex, SyncWeight weight, SceUInt *timeout, bool only_try) {
+// The owner field of a lightweight mutex workarea is its lock word, it holds the id of the owner thread
+// and this flag is set once a thread waits in the kernel, so that the owner does not unlock it on its own
+static constexpr uint32_t LW_MUTEX_HAS_WAITERS = 0x80000000U;
+
+bool lwmutex_try_lock_fast(MemState &mem, Ptr<SceKernelLwMutexWork> workarea, const ThreadStatePtr &thread, int lock_count) {
+    SceKernelLwMutexWork *const work = workarea.get(mem);
+    const uint32_t thread_id = thread->id;
+    if (lock_count <= 0)
+        return false;
+
+    const uint32_t owner = work->owner;
+    if (owner == 0) {
+        if (!atomic_compare_and_swap(&work->owner, thread_id, 0U))
+            return false;
+
+        // only the owner changes the lock count
+        work->lockCount = lock_count;
+        return true;
+    }
+
+    if ((owner & ~LW_MUTEX_HAS_WAITERS) == thread_id && (work->attr & SCE_KERNEL_MUTEX_ATTR_RECURSIVE)) {
+        work->lockCount += lock_count;
+        return true;
+    }
+
+    return false;
+}
+
+bool lwmutex_unlock_fast(MemState &mem, Ptr<SceKernelLwMutexWork> workarea, const ThreadStatePtr &thread, int unlock_count) {
+    SceKernelLwMutexWork *const work = workarea.get(mem);
+    const uint32_t thread_id = thread->id;
+
+    const uint32_t owner = work->owner;
+    if ((owner & ~LW_MUTEX_HAS_WAITERS) != thread_id || unlock_count <= 0 || static_cast<uint32_t>(unlock_count) > work->lockCount)
+        return false;
+
+    if (static_cast<uint32_t>(unlock_count) < work->lockCount) {
+        work->lockCount -= unlock_count;
+        return true;
+    }
+
+    if (owner & LW_MUTEX_HAS_WAITERS)
+        return false;
+
+    work->lockCount = 0;
+    if (atomic_compare_and_swap(&work->owner, 0U, thread_id))
+        return true;
+
+    // a thread started waiting in the meantime, the kernel has to hand the mutex over
+    work->lockCount = unlock_count;
+    return false;
+}
+
+SceUID lwmutex_get_owner(MemState &mem, Ptr<SceKernelLwMutexWork> workarea) {
+    return static_cast<SceUID>(workarea.get(mem)->owner & ~LW_MUTEX_HAS_WAITERS);
+}
+
+// Slow path of lightweight mutexes, the lock state stays in the workarea and the kernel object only holds the waiting threads
+inline int lwmutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, int lock_count, MutexPtr &mutex, SceUInt *timeout, bool only_try) {
+    SceKernelLwMutexWork *const work = mutex->workarea.get(mem);
+    const uint32_t thread_id = thread->id;
+
+    std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
+
+    while (true) {
+        const uint32_t owner = work->owner;
+        // Not owned
+        if (owner == 0) {
+            if (atomic_compare_and_swap(&work->owner, thread_id, 0U)) {
+                work->lockCount = lock_count;
+                return SCE_KERNEL_OK;
+            }
+            continue;
+        }
+
+        // Owned by ourselves
+        if ((owner & ~LW_MUTEX_HAS_WAITERS) == thread_id) {
+            if (mutex->attr & SCE_KERNEL_MUTEX_ATTR_RECURSIVE) {
+                work->lockCount += lock_count;
+                return SCE_KERNEL_OK;
+            }
+            return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
+        }
+
+        // Owned by someone else
+        if (only_try)
+            return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_FAILED_TO_OWN);
+
+        // the flag can only be set while the owner did not release the mutex
+        if ((owner & LW_MUTEX_HAS_WAITERS) || atomic_compare_and_swap(&work->owner, owner | LW_MUTEX_HAS_WAITERS, owner))
+            break;
+    }
+
+    // Sleep thread! The thread unlocking the mutex gives us its ownership
+    std::unique_lock<std::mutex> thread_lock(thread->mutex);
+    thread->update_status(ThreadStatus::wait, ThreadStatus::run);
+
+    WaitingThreadData data;
+    data.thread = thread;
+    data.lock_count = lock_count;
+    data.priority = thread->priority;
+
+    const auto data_it = mutex->waiting_threads->push(data);
+    thread_lock.unlock();
+
+    return handle_timeout(kernel, thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
+}
+
+inline int lwmutex_unlock_impl(MemState &mem, const char *export_name, const ThreadStatePtr &thread, int unlock_count, MutexPtr &mutex) {
+    SceKernelLwMutexWork *const work = mutex->workarea.get(mem);
+    const uint32_t thread_id = thread->id;
+
+    const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
+
+    const uint32_t owner = work->owner;
+    if ((owner & ~LW_MUTEX_HAS_WAITERS) != thread_id)
+        return SCE_KERNEL_OK;
+
+    if (unlock_count < 0 || static_cast<uint32_t>(unlock_count) > work->lockCount)
+        return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_UNLOCK_UDF);
+
+    work->lockCount -= unlock_count;
+    if (work->lockCount > 0)
+        return SCE_KERNEL_OK;
+
+    // other threads only set the waiter flag while holding the primitive lock, so the lock word can't change here
+    if (mutex->waiting_threads->empty()) {
+        atomic_compare_and_swap(&work->owner, 0U, owner);
+        return SCE_KERNEL_OK;
+    }
+
+    const auto waiting_thread_data = *mutex->waiting_threads->begin();
+    const auto waiting_thread = waiting_thread_data.thread;
+
+    const std::lock_guard<std::mutex> waiting_thread_lock(waiting_thread->mutex);
+    mutex->waiting_threads->pop();
+
+    work->lockCount = waiting_thread_data.lock_count;
+    const uint32_t new_owner = static_cast<uint32_t>(waiting_thread->id) | (mutex->waiting_threads->empty() ? 0 : LW_MUTEX_HAS_WAITERS);
+    atomic_compare_and_swap(&work->owner, new_owner, owner);
+
+    waiting_thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+
+    return SCE_KERNEL_OK;
+}
+
+inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, int lock_count, MutexPtr &mutex, SyncWeight weight, SceUInt *timeout, bool only_try) {
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} lock_count: {} timeout: {} waiting_threads: {}",
-            export_name, mutex->uid, thread_id, mutex->name, mutex->attr, mutex->lock_count, timeout ? *timeout : 0,
+            export_name, mutex->uid, thread->id, mutex->name, mutex->attr, mutex->lock_count, timeout ? *timeout : 0,
             mutex->waiting_threads->size());
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    if (weight == SyncWeight::Light)
+        return lwmutex_lock_impl(kernel, mem, export_name, thread, lock_count, mutex, timeout, only_try);
 
     std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
 
@@ -630,23 +782,14 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
         if (mutex->owner == thread) {
             if (is_recursive) {
                 mutex->lock_count += lock_count;
-                if (weight == SyncWeight::Light)
-                    mutex->workarea.get(mem)->lockCount += lock_count;
-
                 return SCE_KERNEL_OK;
             }
-            if (weight == SyncWeight::Light)
-                return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
-
             return RET_ERROR(SCE_KERNEL_ERROR_MUTEX_RECURSIVE);
         }
         // Owned by someone else
 
         // Don't sleep if only_try is set
         if (only_try) {
-            if (weight == SyncWeight::Light)
-                return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_FAILED_TO_OWN);
-
             return RET_ERROR(SCE_KERNEL_ERROR_MUTEX_FAILED_TO_OWN);
         }
 
@@ -662,16 +805,7 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
         const auto data_it = mutex->waiting_threads->push(data);
         thread_lock.unlock();
 
-        int res = handle_timeout(thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
-
-        if (weight == SyncWeight::Light) {
-            mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-            if (mutex->owner == thread) {
-                mutex->workarea.get(mem)->owner = thread_id;
-            }
-        }
-
-        return res;
+        return handle_timeout(kernel, thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
     }
     // Not owned
     // Take ownership!
@@ -679,42 +813,36 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
     mutex->lock_count += lock_count;
     mutex->owner = thread;
 
-    if (weight == SyncWeight::Light) {
-        mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-        if (mutex->owner == thread) {
-            mutex->workarea.get(mem)->owner = thread_id;
-        }
-    }
-
     return SCE_KERNEL_OK;
 }
 
-int mutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int lock_count, unsigned int *timeout, SyncWeight weight) {
+int mutex_lock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, int lock_count, unsigned int *timeout, SyncWeight weight) {
     assert(mutexid >= 0);
 
     MutexPtr mutex;
     if (auto error = find_mutex(mutex, nullptr, kernel, export_name, mutexid, weight))
         return error;
 
-    return mutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex, weight, timeout, false);
+    return mutex_lock_impl(kernel, mem, export_name, thread, lock_count, mutex, weight, timeout, false);
 }
 
-int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int lock_count, SyncWeight weight) {
+int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, int lock_count, SyncWeight weight) {
     assert(mutexid >= 0);
 
     MutexPtr mutex;
     if (auto error = find_mutex(mutex, nullptr, kernel, export_name, mutexid, weight))
         return error;
 
-    return mutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex, weight, nullptr, true);
+    return mutex_lock_impl(kernel, mem, export_name, thread, lock_count, mutex, weight, nullptr, true);
 }
 
-inline int mutex_unlock_impl(KernelState &kernel, const char *export_name, SceUID thread_id, int unlock_count, MutexPtr &mutex) {
-    const ThreadStatePtr current_thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+inline int mutex_unlock_impl(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, int unlock_count, MutexPtr &mutex, SyncWeight weight) {
+    if (weight == SyncWeight::Light)
+        return lwmutex_unlock_impl(mem, export_name, thread, unlock_count, mutex);
 
     const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
 
-    if (current_thread == mutex->owner) {
+    if (thread == mutex->owner) {
         if (unlock_count > mutex->lock_count) {
             return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_UNLOCK_UDF);
         }
@@ -742,7 +870,7 @@ inline int mutex_unlock_impl(KernelState &kernel, const char *export_name, SceUI
     return SCE_KERNEL_OK;
 }
 
-int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight) {
+int mutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, int unlock_count, SyncWeight weight) {
     assert(mutexid >= 0);
 
     MutexPtr mutex;
@@ -751,14 +879,14 @@ int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id,
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} lock_count: {} waiting_threads: {}",
-            export_name, mutexid, thread_id, mutex->name, mutex->attr, mutex->lock_count, unlock_count,
+            export_name, mutexid, thread->id, mutex->name, mutex->attr, mutex->lock_count, unlock_count,
             mutex->waiting_threads->size());
     }
 
-    return mutex_unlock_impl(kernel, export_name, thread_id, unlock_count, mutex);
+    return mutex_unlock_impl(kernel, mem, export_name, thread, unlock_count, mutex, weight);
 }
 
-int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight) {
+int mutex_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, SyncWeight weight) {
     assert(mutexid >= 0);
 
     MutexPtr mutex;
@@ -768,13 +896,14 @@ int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id,
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} lock_count: {} waiting_threads: {}",
-            export_name, mutexid, thread_id, mutex->name, mutex->attr, mutex->lock_count,
+            export_name, mutexid, thread->id, mutex->name, mutex->attr, mutex->lock_count,
             mutex->waiting_threads->size());
     }
 
     if (mutex->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_guard(kernel.mutex);
+        const ProfiledLockGuard kernel_guard(kernel.mutex);
         mutexes->erase(mutexid);
+        get_mutex_table(kernel, weight).erase(mutexid);
     } else {
         // TODO:
         LOG_WARN("Can't delete sync object, it has waiting threads.");
@@ -783,7 +912,7 @@ int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id,
     return SCE_KERNEL_OK;
 }
 
-MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight) {
+MutexPtr mutex_get(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID mutexid, SyncWeight weight) {
     assert(mutexid >= 0);
 
     MutexPtr mutex;
@@ -793,7 +922,7 @@ MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_i
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} lock_count: {} waiting_threads: {}",
-            export_name, mutexid, thread_id, mutex->name, mutex->attr, mutex->lock_count,
+            export_name, mutexid, thread->id, mutex->name, mutex->attr, mutex->lock_count,
             mutex->waiting_threads->size());
     }
     return mutex;
@@ -803,7 +932,7 @@ MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_i
 // * RWLock *
 // **************
 
-SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr) {
+SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt32 attr) {
     if ((strlen(name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -820,19 +949,18 @@ SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name
         rwlock->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     kernel.rwlocks.emplace(uid, rwlock);
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
-            export_name, uid, thread_id, name, attr);
+            export_name, uid, thread->id, name, attr);
     }
 
     return uid;
 }
 
-SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, uint32_t *timeout, bool is_write) {
-    const ThreadStatePtr thread = kernel.get_thread(thread_id);
+SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID lock_id, uint32_t *timeout, bool is_write) {
     const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
 
     if (!rwlock)
@@ -840,7 +968,7 @@ SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} timeout: {} waiting_threads: {}",
-            export_name, lock_id, thread_id, rwlock->name, rwlock->attr, timeout ? *timeout : 0,
+            export_name, lock_id, thread->id, rwlock->name, rwlock->attr, timeout ? *timeout : 0,
             rwlock->waiting_threads->size());
     }
 
@@ -881,12 +1009,11 @@ SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name
         const auto data_it = rwlock->waiting_threads->push(data);
         thread_lock.unlock();
 
-        return handle_timeout(thread, thread_lock, rwlock_lock, rwlock->waiting_threads, data, data_it, export_name, timeout);
+        return handle_timeout(kernel, thread, thread_lock, rwlock_lock, rwlock->waiting_threads, data, data_it, export_name, timeout);
     }
 }
 
-SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, bool is_write) {
-    const ThreadStatePtr current_thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID lock_id, bool is_write) {
     const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
 
     if (!rwlock)
@@ -894,13 +1021,13 @@ SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_na
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} waiting_threads: {}",
-            export_name, lock_id, thread_id, rwlock->name, rwlock->attr,
+            export_name, lock_id, thread->id, rwlock->name, rwlock->attr,
             rwlock->waiting_threads->size());
     }
 
     const std::lock_guard<std::mutex> rwlock_lock(rwlock->mutex);
 
-    auto it = rwlock->owners.find(current_thread);
+    auto it = rwlock->owners.find(thread);
     if (it == rwlock->owners.end()) {
         return RET_ERROR(SCE_KERNEL_ERROR_RW_LOCK_FAILED_TO_UNLOCK);
     }
@@ -908,7 +1035,7 @@ SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_na
     // decrease the lock count
     it->second--;
     if (it->second == 0)
-        rwlock->owners.erase(current_thread);
+        rwlock->owners.erase(thread);
 
     // if it is still locked
     if (!rwlock->owners.empty())
@@ -918,7 +1045,7 @@ SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_na
 
     if (!rwlock->waiting_threads->empty()) {
         for (auto it = rwlock->waiting_threads->begin(); it != rwlock->waiting_threads->end();) {
-            const auto &waiting_thread_data = *it;
+            const auto waiting_thread_data = *it;
             const auto waiting_thread = waiting_thread_data.thread;
             const auto waiting_is_write = waiting_thread_data.is_write;
 
@@ -947,8 +1074,7 @@ SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_na
     return SCE_KERNEL_OK;
 }
 
-SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id) {
-    const ThreadStatePtr thread = kernel.get_thread(thread_id);
+SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID lock_id) {
     const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
 
     if (!rwlock)
@@ -956,12 +1082,12 @@ SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_na
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} waiting_threads: {}",
-            export_name, lock_id, thread_id, rwlock->name, rwlock->attr,
+            export_name, lock_id, thread->id, rwlock->name, rwlock->attr,
             rwlock->waiting_threads->size());
     }
 
     if (rwlock->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_guard(kernel.mutex);
+        const ProfiledLockGuard kernel_guard(kernel.mutex);
         kernel.rwlocks.erase(lock_id);
     } else {
         // TODO:
@@ -975,7 +1101,7 @@ SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_na
 // * Semaphore *
 // **************
 
-SceUID semaphore_create(KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, int init_val, int max_val) {
+SceUID semaphore_create(KernelState &kernel, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt attr, int init_val, int max_val) {
     if ((strlen(name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -997,11 +1123,12 @@ SceUID semaphore_create(KernelState &kernel, const char *export_name, const char
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} init_val: {} max_val: {}",
-            export_name, uid, thread_id, name, attr, init_val, max_val);
+            export_name, uid, thread->id, name, attr, init_val, max_val);
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     kernel.semaphores.emplace(uid, semaphore);
+    kernel.semaphore_table.insert(uid, semaphore);
 
     return uid;
 }
@@ -1013,7 +1140,7 @@ SceUID semaphore_find(KernelState &kernel, const char *export_name, const char *
     if (LOG_SYNC_PRIMITIVES)
         LOG_DEBUG("{}: name: \"{}\"", export_name, pName);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
 
     const auto it = std::find_if(kernel.semaphores.begin(), kernel.semaphores.end(), [=](const auto &sema) {
         return strncmp(sema.second->name, pName, KERNELOBJECT_MAX_NAME_LENGTH) == 0;
@@ -1025,23 +1152,21 @@ SceUID semaphore_find(KernelState &kernel, const char *export_name, const char *
     return RET_ERROR(SCE_KERNEL_ERROR_UID_CANNOT_FIND_BY_NAME);
 }
 
-SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout) {
+SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout) {
     assert(semaId >= 0);
 
     // TODO Don't lock twice.
-    const SemaphorePtr semaphore = lock_and_find(semaId, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = lock_and_find(semaId, kernel.semaphores, kernel.mutex, kernel.semaphore_table);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} val: {} timeout: {} waiting_threads: {}",
-            export_name, semaphore->uid, thread_id, semaphore->name, semaphore->attr, semaphore->val,
+            export_name, semaphore->uid, thread->id, semaphore->name, semaphore->attr, semaphore->val,
             pTimeout ? *pTimeout : 0, semaphore->waiting_threads->size());
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
-
     std::unique_lock<std::mutex> semaphore_lock(semaphore->mutex);
 
     if (semaphore->val < needCount) {
@@ -1059,7 +1184,7 @@ SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thr
         const auto data_it = semaphore->waiting_threads->push(data);
         thread_lock.unlock();
 
-        auto res = handle_timeout(thread, thread_lock, semaphore_lock, semaphore->waiting_threads, data, data_it, export_name, pTimeout);
+        auto res = handle_timeout(kernel, thread, thread_lock, semaphore_lock, semaphore->waiting_threads, data, data_it, export_name, pTimeout);
         if (was_canceled)
             res = SCE_KERNEL_ERROR_WAIT_CANCEL;
         return res;
@@ -1070,18 +1195,18 @@ SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thr
     return SCE_KERNEL_OK;
 }
 
-int semaphore_signal(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaid, int signal) {
+int semaphore_signal(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaid, int signal) {
     assert(semaid >= 0);
 
     // TODO Don't lock twice.
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex, kernel.semaphore_table);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} val: {} signal: {} waiting_threads: {}",
-            export_name, semaphore->uid, thread_id, semaphore->name, semaphore->attr, semaphore->val, signal,
+            export_name, semaphore->uid, thread->id, semaphore->name, semaphore->attr, semaphore->val, signal,
             semaphore->waiting_threads->size());
     }
 
@@ -1111,24 +1236,25 @@ int semaphore_signal(KernelState &kernel, const char *export_name, SceUID thread
     return SCE_KERNEL_OK;
 }
 
-int semaphore_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaid) {
+int semaphore_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaid) {
     assert(semaid >= 0);
 
     // TODO: Don't lock twice
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex, kernel.semaphore_table);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} val: {} waiting_threads: {}",
-            export_name, semaphore->uid, thread_id, semaphore->name, semaphore->attr, semaphore->val,
+            export_name, semaphore->uid, thread->id, semaphore->name, semaphore->attr, semaphore->val,
             semaphore->waiting_threads->size());
     }
 
     if (semaphore->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+        const ProfiledLockGuard kernel_lock(kernel.mutex);
         kernel.semaphores.erase(semaid);
+        kernel.semaphore_table.erase(semaid);
     } else {
         // TODO:
         LOG_WARN("Can't delete sync object, it has waiting threads.");
@@ -1137,25 +1263,25 @@ int semaphore_delete(KernelState &kernel, const char *export_name, SceUID thread
     return SCE_KERNEL_OK;
 }
 
-int semaphore_cancel(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID semaid, SceInt32 setCount, SceUInt32 *pNumWaitThreads) {
+int semaphore_cancel(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID semaid, SceInt32 setCount, SceUInt32 *pNumWaitThreads) {
     assert(semaid >= 0);
 
     // TODO: Don't lock twice
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex, kernel.semaphore_table);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} val: {} waiting_threads: {}",
-            export_name, semaphore->uid, thread_id, semaphore->name, semaphore->attr, semaphore->val,
+            export_name, semaphore->uid, thread->id, semaphore->name, semaphore->attr, semaphore->val,
             semaphore->waiting_threads->size());
     }
 
     SceUInt32 nb_threads = 0;
     const std::lock_guard<std::mutex> semaphore_lock(semaphore->mutex);
     while (!semaphore->waiting_threads->empty()) {
-        const auto &waiting_thread_data = *semaphore->waiting_threads->begin();
+        const auto waiting_thread_data = *semaphore->waiting_threads->begin();
         const auto waiting_thread = waiting_thread_data.thread;
 
         const std::lock_guard<std::mutex> waiting_thread_lock(waiting_thread->mutex);
@@ -1187,7 +1313,13 @@ int semaphore_cancel(KernelState &kernel, const char *export_name, SceUID thread
 // * Condition Variable *
 // **********************
 
-SceUID condvar_create(SceUID *uid_out, KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, SceUID assoc_mutexid, SyncWeight weight) {
+// Assumes the condvar primitive lock is locked
+inline void update_lwcond_waiters(MemState &mem, Condvar &condvar, SyncWeight weight) {
+    if (weight == SyncWeight::Light)
+        condvar.workarea.get(mem)->numWaitThreads = static_cast<uint32_t>(condvar.waiting_threads->size());
+}
+
+SceUID condvar_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt attr, SceUID assoc_mutexid, Ptr<SceKernelLwCondWork> workarea, SyncWeight weight) {
     if ((strlen(name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -1199,12 +1331,13 @@ SceUID condvar_create(SceUID *uid_out, KernelState &kernel, const char *export_n
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} assoc_mutexid: {}",
-            export_name, uid, thread_id, name, attr, assoc_mutexid);
+            export_name, uid, thread->id, name, attr, assoc_mutexid);
     }
 
     const CondvarPtr condvar = std::make_shared<Condvar>();
     condvar->attr = attr;
     condvar->associated_mutex = std::move(assoc_mutex);
+    condvar->workarea = workarea;
     std::copy(name, name + KERNELOBJECT_MAX_NAME_LENGTH, condvar->name);
 
     if (condvar->attr & SCE_KERNEL_ATTR_TH_PRIO) {
@@ -1213,16 +1346,20 @@ SceUID condvar_create(SceUID *uid_out, KernelState &kernel, const char *export_n
         condvar->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    if (weight == SyncWeight::Light)
+        workarea.get(mem)->numWaitThreads = 0;
+
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     auto &condvars = get_condvars(kernel, weight);
     condvars.emplace(uid, condvar);
+    get_condvar_table(kernel, weight).insert(uid, condvar);
 
     if (uid_out)
         *uid_out = uid;
     return SCE_KERNEL_OK;
 }
 
-int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID condid, SceUInt *timeout, SyncWeight weight) {
+int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID condid, SceUInt *timeout, SyncWeight weight) {
     assert(condid >= 0);
 
     CondvarPtr condvar;
@@ -1236,12 +1373,16 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
             timeout ? *timeout : 0, condvar->waiting_threads->size());
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
-
     std::unique_lock<std::mutex> condition_variable_lock(condvar->mutex);
 
-    if (auto error = mutex_unlock_impl(kernel, export_name, thread_id, 1, condvar->associated_mutex))
+    // the waiter must be visible before the mutex is released, otherwise a signal could skip the kernel and be lost
+    if (weight == SyncWeight::Light)
+        condvar->workarea.get(mem)->numWaitThreads = static_cast<uint32_t>(condvar->waiting_threads->size() + 1);
+
+    if (auto error = mutex_unlock_impl(kernel, mem, export_name, thread, 1, condvar->associated_mutex, weight)) {
+        update_lwcond_waiters(mem, *condvar, weight);
         return error;
+    }
 
     std::unique_lock<std::mutex> thread_lock(thread->mutex);
     thread->update_status(ThreadStatus::wait, ThreadStatus::run);
@@ -1253,14 +1394,16 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
     const auto data_it = condvar->waiting_threads->push(data);
     thread_lock.unlock();
 
-    if (auto error = handle_timeout(thread, thread_lock, condition_variable_lock, condvar->waiting_threads, data, data_it, export_name, timeout))
+    if (auto error = handle_timeout(kernel, thread, thread_lock, condition_variable_lock, condvar->waiting_threads, data, data_it, export_name, timeout)) {
+        update_lwcond_waiters(mem, *condvar, weight);
         return error;
+    }
 
     condition_variable_lock.unlock();
-    return mutex_lock_impl(kernel, mem, export_name, thread_id, 1, condvar->associated_mutex, weight, timeout, false);
+    return mutex_lock_impl(kernel, mem, export_name, thread, 1, condvar->associated_mutex, weight, timeout, false);
 }
 
-int condvar_signal(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID condid, Condvar::SignalTarget signal_target, SyncWeight weight) {
+int condvar_signal(KernelState &kernel, MemState &mem, const char *export_name, const ThreadStatePtr &thread, SceUID condid, Condvar::SignalTarget signal_target, SyncWeight weight) {
     assert(condid >= 0);
 
     CondvarPtr condvar;
@@ -1280,7 +1423,7 @@ int condvar_signal(KernelState &kernel, const char *export_name, SceUID thread_i
     auto &waiting_threads = condvar->waiting_threads;
 
     if (target_type == Condvar::SignalTarget::Type::Specific) {
-        ThreadStatePtr waiting_thread = lock_and_find(signal_target.thread_id, kernel.threads, kernel.mutex);
+        ThreadStatePtr waiting_thread = kernel.get_thread(signal_target.thread_id);
         // Search for specified waiting thread
         auto waiting_thread_iter = waiting_threads->find(waiting_thread);
         if (waiting_thread_iter != waiting_threads->end()) {
@@ -1301,13 +1444,19 @@ int condvar_signal(KernelState &kernel, const char *export_name, SceUID thread_i
 
             waiting_thread->update_status(ThreadStatus::run, ThreadStatus::wait);
             waiting_threads->pop();
+
+            // the other waiters stay asleep, the first one in the order of the attribute is the one woken up
+            if (target_type == Condvar::SignalTarget::Type::Any)
+                break;
         }
     }
 
+    update_lwcond_waiters(mem, *condvar, weight);
+
     return SCE_KERNEL_OK;
 }
 
-int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID condid, SyncWeight weight) {
+int condvar_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID condid, SyncWeight weight) {
     assert(condid >= 0);
 
     CondvarPtr condvar;
@@ -1317,13 +1466,14 @@ int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_i
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} assoc_mutexid: {} waiting_threads: {}",
-            export_name, condvar->uid, thread_id, condvar->name, condvar->attr, condvar->associated_mutex->uid,
+            export_name, condvar->uid, thread->id, condvar->name, condvar->attr, condvar->associated_mutex->uid,
             condvar->waiting_threads->size());
     }
 
     if (condvar->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+        const ProfiledLockGuard kernel_lock(kernel.mutex);
         condvars->erase(condid);
+        get_condvar_table(kernel, weight).erase(condid);
     } else {
         // TODO:
         LOG_WARN("Can't delete sync object, it has waiting threads.");
@@ -1332,12 +1482,16 @@ int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_i
     return SCE_KERNEL_OK;
 }
 
+bool lwcond_has_waiters(MemState &mem, Ptr<SceKernelLwCondWork> workarea) {
+    return workarea.get(mem)->numWaitThreads != 0;
+}
+
 // **************
 // * Event Flag *
 // **************
 
 SceUID eventflag_clear(KernelState &kernel, const char *export_name, SceUID evfId, SceUInt32 bitPattern) {
-    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex, kernel.eventflag_table);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1354,7 +1508,7 @@ SceUID eventflag_clear(KernelState &kernel, const char *export_name, SceUID evfI
     return SCE_KERNEL_OK;
 }
 
-SceUID eventflag_create(KernelState &kernel, const char *export_name, SceUID thread_id, const char *pName, SceUInt32 attr, SceUInt32 initPattern) {
+SceUID eventflag_create(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, const char *pName, SceUInt32 attr, SceUInt32 initPattern) {
     if ((strlen(pName) > KERNELOBJECT_MAX_NAME_LENGTH) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -1363,7 +1517,7 @@ SceUID eventflag_create(KernelState &kernel, const char *export_name, SceUID thr
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} bitPattern: {:#b}",
-            export_name, uid, thread_id, pName, attr, initPattern);
+            export_name, uid, thread->id, pName, attr, initPattern);
     }
 
     const EventFlagPtr event = std::make_shared<EventFlag>();
@@ -1377,8 +1531,9 @@ SceUID eventflag_create(KernelState &kernel, const char *export_name, SceUID thr
         event->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     kernel.eventflags.emplace(uid, event);
+    kernel.eventflag_table.insert(uid, event);
 
     return uid;
 }
@@ -1390,7 +1545,7 @@ SceUID eventflag_find(KernelState &kernel, const char *export_name, const char *
     if (LOG_SYNC_PRIMITIVES)
         LOG_DEBUG("{}: name: \"{}\"", export_name, pName);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
 
     const auto it = std::find_if(kernel.eventflags.begin(), kernel.eventflags.end(), [=](const auto &evf) {
         return strncmp(evf.second->name, pName, KERNELOBJECT_MAX_NAME_LENGTH) == 0;
@@ -1402,11 +1557,11 @@ SceUID eventflag_find(KernelState &kernel, const char *export_name, const char *
     return RET_ERROR(SCE_KERNEL_ERROR_UID_CANNOT_FIND_BY_NAME);
 }
 
-static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, unsigned int flags, unsigned int wait, unsigned int *outBits, SceUInt *timeout, bool dowait) {
+static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, unsigned int flags, unsigned int wait, unsigned int *outBits, SceUInt *timeout, bool dowait) {
     assert(event_id >= 0);
 
     // TODO Don't lock twice.
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex, kernel.eventflag_table);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1414,7 +1569,7 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} existing_flags: {:#b} wait_flags: {:#b} timeout: {}"
                   " waiting_threads: {}",
-            export_name, event->uid, thread_id, event->name, event->attr, event->flags, flags, timeout ? *timeout : 0,
+            export_name, event->uid, thread->id, event->name, event->attr, event->flags, flags, timeout ? *timeout : 0,
             event->waiting_threads->size());
     }
 
@@ -1422,8 +1577,6 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
         return RET_ERROR(SCE_KERNEL_ERROR_EVF_MULTI);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
-
     std::unique_lock<std::mutex> event_lock(event->mutex);
 
     bool condition;
@@ -1464,7 +1617,7 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
         const auto data_it = event->waiting_threads->push(data);
         thread_lock.unlock();
 
-        int err = handle_timeout(thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
+        int err = handle_timeout(kernel, thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
         if (err < 0 && outBits) {
             // set it only if a timeout occurs
             // otherwise set in eventflag_set
@@ -1479,19 +1632,19 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
     }
 }
 
-SceInt32 eventflag_wait(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout) {
-    return eventflag_waitorpoll(kernel, export_name, thread_id, evfId, bitPattern, waitMode, pResultPat, pTimeout, true);
+SceInt32 eventflag_wait(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout) {
+    return eventflag_waitorpoll(kernel, export_name, thread, evfId, bitPattern, waitMode, pResultPat, pTimeout, true);
 }
 
-int eventflag_poll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, unsigned int flags, unsigned int wait, unsigned int *outBits) {
-    return eventflag_waitorpoll(kernel, export_name, thread_id, event_id, flags, wait, outBits, 0, false);
+int eventflag_poll(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, unsigned int flags, unsigned int wait, unsigned int *outBits) {
+    return eventflag_waitorpoll(kernel, export_name, thread, event_id, flags, wait, outBits, 0, false);
 }
 
-SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID evfId, SceUInt32 bitPattern) {
+SceInt32 eventflag_set(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID evfId, SceUInt32 bitPattern) {
     assert(evfId >= 0);
 
     // TODO Don't lock twice.
-    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex, kernel.eventflag_table);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1499,7 +1652,7 @@ SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thre
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} existing_flags: {:#b} set_flags: {:#b}"
                   " waiting_threads: {}",
-            export_name, event->uid, thread_id, event->name, event->attr, event->flags, bitPattern,
+            export_name, event->uid, thread->id, event->name, event->attr, event->flags, bitPattern,
             event->waiting_threads->size());
     }
 
@@ -1544,17 +1697,17 @@ SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thre
     return 0;
 }
 
-SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt32 *num_wait_threads) {
+SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id, SceUInt32 pattern, SceUInt32 *num_wait_threads) {
     assert(event_id >= 0);
 
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex, kernel.eventflag_table);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} existing_flags: {:#b} waiting_threads: {}",
-            export_name, event->uid, thread_id, event->name, event->attr, event->flags, event->waiting_threads->size());
+            export_name, event->uid, thread->id, event->name, event->attr, event->flags, event->waiting_threads->size());
     }
 
     SceUInt32 nb_threads = 0;
@@ -1562,7 +1715,7 @@ SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID t
     const std::lock_guard<std::mutex> event_lock(event->mutex);
 
     while (!event->waiting_threads->empty()) {
-        const auto &waiting_thread_data = *event->waiting_threads->begin();
+        const auto waiting_thread_data = *event->waiting_threads->begin();
         const auto waiting_thread = waiting_thread_data.thread;
 
         const std::lock_guard<std::mutex> waiting_thread_lock(waiting_thread->mutex);
@@ -1585,22 +1738,23 @@ SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID t
     return SCE_KERNEL_OK;
 }
 
-int eventflag_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id) {
+int eventflag_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID event_id) {
     assert(event_id >= 0);
 
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex, kernel.eventflag_table);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} existing_flags: {:#b} waiting_threads: {}",
-            export_name, event->uid, thread_id, event->name, event->attr, event->flags, event->waiting_threads->size());
+            export_name, event->uid, thread->id, event->name, event->attr, event->flags, event->waiting_threads->size());
     }
 
     if (event->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+        const ProfiledLockGuard kernel_lock(kernel.mutex);
         kernel.eventflags.erase(event_id);
+        kernel.eventflag_table.erase(event_id);
     } else {
         // TODO:
         LOG_WARN("Can't delete sync object, it has waiting threads.");
@@ -1613,7 +1767,7 @@ int eventflag_delete(KernelState &kernel, const char *export_name, SceUID thread
 // * Msg Pipe  *
 // *************
 
-SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, SceSize bufSize) {
+SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *name, const ThreadStatePtr &thread, SceUInt attr, SceSize bufSize) {
     if ((strlen(name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
@@ -1622,7 +1776,7 @@ SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
-            export_name, uid, thread_id, name, attr);
+            export_name, uid, thread->id, name, attr);
     }
 
     const MsgPipePtr msgpipe = std::make_shared<MsgPipe>(bufSize);
@@ -1640,7 +1794,7 @@ SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *
     // TODO do senders respect priority?
     msgpipe->senders = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     kernel.msgpipes.emplace(uid, msgpipe);
 
     return uid;
@@ -1653,7 +1807,7 @@ SceUID msgpipe_find(KernelState &kernel, const char *export_name, const char *pN
     if (LOG_SYNC_PRIMITIVES)
         LOG_DEBUG("{}: name: \"{}\"", export_name, pName);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
 
     const auto it = std::find_if(kernel.msgpipes.begin(), kernel.msgpipes.end(), [=](const auto &msg_pipe) {
         return strncmp(msg_pipe.second->name, pName, KERNELOBJECT_MAX_NAME_LENGTH) == 0;
@@ -1665,7 +1819,7 @@ SceUID msgpipe_find(KernelState &kernel, const char *export_name, const char *pN
     return RET_ERROR(SCE_KERNEL_ERROR_UID_CANNOT_FIND_BY_NAME);
 }
 
-SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID msgPipeId, SceUInt32 waitMode, void *pRecvBuf, SceSize recvSize, SceUInt32 *pTimeout) {
+SceSize msgpipe_recv(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID msgPipeId, SceUInt32 waitMode, void *pRecvBuf, SceSize recvSize, SceUInt32 *pTimeout) {
     assert(msgPipeId >= 0);
 
     const bool ASAP = !(waitMode & SCE_KERNEL_MSG_PIPE_MODE_FULL);
@@ -1678,7 +1832,7 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" pipe attr: {} wait_mode: {:#b} ({})"
                   " senders: {} receivers: {}",
-            export_name, msgpipe->uid, thread_id, msgpipe->name, msgpipe->attr, waitMode, ASAP ? "ASAP" : "FULL",
+            export_name, msgpipe->uid, thread->id, msgpipe->name, msgpipe->attr, waitMode, ASAP ? "ASAP" : "FULL",
             msgpipe->senders->size(), msgpipe->receivers->size());
     }
 
@@ -1693,7 +1847,6 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
         }
     };
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
     std::unique_lock msgpipe_lock(msgpipe->mutex);
     // check in case of delete happens while waiting (un)lock
     if (msgpipe->beingDeleted) {
@@ -1727,8 +1880,12 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
         wait_data.thread = thread;
         wait_data.priority = thread->priority;
         wait_data.mp.request_size = (ASAP) ? 1 : recvSize; // If ASAP, we can read as low as 1 byte
+        SceSize handed_size = 0;
+        wait_data.mp.recv_buffer = (waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_REMOVE) ? nullptr : pRecvBuf;
+        wait_data.mp.recv_size = recvSize;
+        wait_data.mp.handed_size = &handed_size;
 
-        msgpipe->receivers->push(wait_data);
+        const auto wait_it = msgpipe->receivers->push(wait_data);
 
         std::unique_lock thread_lock(thread->mutex); // Lock thread - needed for condition variable
         thread->update_status(ThreadStatus::wait, ThreadStatus::run); // Mark ourselves as sleeping
@@ -1736,6 +1893,10 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
         const auto finish = [&] {
             thread->update_status(ThreadStatus::run); // Wake up
 
+            // the sender already copied the data in our buffer
+            if (handed_size)
+                return handed_size;
+
             SceSize readSize = (SceSize)copyOut();
             // msgpipe->receivers->erase(wait_data); //we've already been erased by the sender
             wakeup_senders();
@@ -1753,29 +1914,51 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
                 }
                 msgpipe_lock.lock(); // Lock message pipe again
                 availableSize = msgpipe->data_buffer.Used();
-            } while (!((availableSize >= recvSize) || (ASAP && (availableSize > 0))));
+            } while (!handed_size && !((availableSize >= recvSize) || (ASAP && (availableSize > 0))));
 
             return finish();
         } else { // There's a timeout - wait until we can fill buffer or timeout
             msgpipe_lock.unlock(); // Unlock message pipe object, else we'll deadlock
-            auto status = thread->status_cond.wait_for(thread_lock, std::chrono::microseconds{ *pTimeout }, [&] { return thread->status == ThreadStatus::run; });
+            auto status = timed_wait(kernel.timer_wheel, thread->status_cond, thread_lock, timer_wheel_now() + rtc_host_duration(*pTimeout), [&] { return thread->status == ThreadStatus::run; });
             if (msgpipe->beingDeleted) {
                 std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
                 return SCE_KERNEL_ERROR_WAIT_DELETE;
             }
 
-            if (!status) { // Timed out and buffer hasn't been touched
-                thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+            msgpipe_lock.lock(); // Lock message pipe again
+            if (!status && !handed_size) { // Timed out and buffer hasn't been touched
+                // a sender must not copy to our buffer once returned
+                if (thread->status == ThreadStatus::wait)
+                    msgpipe->receivers->erase(wait_it);
+                thread->update_status(ThreadStatus::run);
                 return RET_ERROR(SCE_KERNEL_ERROR_WAIT_TIMEOUT);
             }
-            msgpipe_lock.lock(); // Lock message pipe again
             return finish();
         }
     }
 }
 
+// copy the data to the buffer of the first receiver if it is waiting to remove data from an empty pipe, return the size copied
+static SceSize msgpipe_hand_off(MsgPipe &msgpipe, const void *data, SceSize size) {
+    if (!msgpipe.data_buffer.Empty() || msgpipe.receivers->empty())
+        return 0;
+
+    const auto it = msgpipe.receivers->begin();
+    const auto &receiver = it->mp;
+    if (!receiver.recv_buffer || size < receiver.request_size)
+        return 0;
+
+    const SceSize handed_size = std::min(size, receiver.recv_size);
+    memcpy(receiver.recv_buffer, data, handed_size);
+    *receiver.handed_size = handed_size;
+    it->thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+    msgpipe.receivers->erase(it);
+
+    return handed_size;
+}
+
 // FIXME this should be SendVector!
-SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID msgPipeId, SceUInt32 waitMode, const void *pSendBuf, SceSize sendSize, SceUInt32 *pTimeout) {
+SceSize msgpipe_send(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID msgPipeId, SceUInt32 waitMode, const void *pSendBuf, SceSize sendSize, SceUInt32 *pTimeout) {
     assert(msgPipeId >= 0);
 
     const bool ASAP = !(waitMode & SCE_KERNEL_MSG_PIPE_MODE_FULL);
@@ -1788,7 +1971,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" pipe attr: {} wait_mode: {:#b}"
                   " senders: {} receivers: {}",
-            export_name, msgpipe->uid, thread_id, msgpipe->name, msgpipe->attr, waitMode,
+            export_name, msgpipe->uid, thread->id, msgpipe->name, msgpipe->attr, waitMode,
             msgpipe->senders->size(), msgpipe->receivers->size());
     }
 
@@ -1808,13 +1991,19 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
         }
     };
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
     std::unique_lock<std::mutex> msgpipe_lock(msgpipe->mutex);
     // check in case of delete happens while waiting (un)lock
     if (msgpipe->beingDeleted) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
 
+    // the first receiver gets the data straight in its buffer if it is waiting, the rest goes through the ring
+    const SceSize handed_size = msgpipe_hand_off(*msgpipe, pSendBuf, sendSize);
+    if (handed_size == sendSize)
+        return handed_size;
+    pSendBuf = static_cast<const uint8_t *>(pSendBuf) + handed_size;
+    sendSize -= handed_size;
+
     // If ASAP and there's at least 1 free byte, or FULL and there's enough space, copy and return directly.
     std::size_t freeSize = msgpipe->data_buffer.Free();
     if ((freeSize >= sendSize) || (ASAP && (freeSize >= 1))) {
@@ -1822,9 +2011,9 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
 
         wakeup_receivers();
 
-        return copied_size;
+        return handed_size + copied_size;
     } else if (waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT) {
-        return 0;
+        return handed_size;
     } else { // Go to sleep until there's more space
         WaitingThreadData wait_data;
         wait_data.thread = thread;
@@ -1842,7 +2031,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
             SceSize insertedSize = (SceSize)msgpipe->data_buffer.Insert(pSendBuf, sendSize);
             // msgpipe->senders->erase(wait_data); //Don't erase ourselves - recv will do it
             wakeup_receivers();
-            return (int)insertedSize;
+            return (int)(handed_size + insertedSize);
         };
 
         if (!pTimeout) { // No timeout - loop forever until we can fill the buffer
@@ -1862,7 +2051,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
             return finish();
         } else { // There's a timeout - wait until we can fill buffer or timeout
             msgpipe_lock.unlock(); // Unlock message pipe object, else we'll deadlock
-            auto status = thread->status_cond.wait_for(thread_lock, std::chrono::microseconds{ *pTimeout }, [&] { return thread->status == ThreadStatus::run; });
+            auto status = timed_wait(kernel.timer_wheel, thread->status_cond, thread_lock, timer_wheel_now() + rtc_host_duration(*pTimeout), [&] { return thread->status == ThreadStatus::run; });
             if (msgpipe->beingDeleted) {
                 std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
                 return SCE_KERNEL_ERROR_WAIT_DELETE;
@@ -1878,7 +2067,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
     }
 }
 
-SceInt32 msgpipe_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID msgpipe_id) {
+SceInt32 msgpipe_delete(KernelState &kernel, const char *export_name, const ThreadStatePtr &thread, SceUID msgpipe_id) {
     assert(msgpipe_id >= 0);
 
     const MsgPipePtr msgpipe = lock_and_find(msgpipe_id, kernel.msgpipes, kernel.mutex);
@@ -1888,7 +2077,7 @@ SceInt32 msgpipe_delete(KernelState &kernel, const char *export_name, SceUID thr
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
-            export_name, msgpipe->uid, thread_id, msgpipe->name, msgpipe->attr);
+            export_name, msgpipe->uid, thread->id, msgpipe->name, msgpipe->attr);
     }
 
     if (!msgpipe->receivers->empty() || !msgpipe->senders->empty()) {
@@ -1908,7 +2097,7 @@ SceInt32 msgpipe_delete(KernelState &kernel, const char *export_name, SceUID thr
             std::this_thread::yield();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+    const ProfiledLockGuard kernel_lock(kernel.mutex);
     kernel.msgpipes.erase(msgpipe->uid);
 
     return SCE_KERNEL_OK;
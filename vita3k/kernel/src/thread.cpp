@@ -24,14 +24,18 @@
 
 #include <cpu/functions.h>
 #include <util/find.h>
+#include <util/host_thread.h>
 #include <util/lock_and_find.h>
 
 #include <util/log.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <memory>
 #include <sstream>
+#include <thread>
 
 void ThreadSignal::wait() {
     std::unique_lock<std::mutex> lock(mutex);
@@ -55,12 +59,6 @@ int ThreadState::init(const char *name, Ptr<const void> entry_point, int init_pr
     this->name = name;
     this->entry_point = entry_point.address();
 
-    int core_num = kernel.corenum_allocator.new_corenum();
-    if (core_num < 0) {
-        LOG_ERROR("Out of core number to allocate, use 0");
-        core_num = 0;
-    }
-
     if (init_priority > SCE_KERNEL_LOWEST_PRIORITY_USER) {
         assert(SCE_KERNEL_HIGHEST_DEFAULT_PRIORITY <= init_priority && init_priority <= SCE_KERNEL_LOWEST_DEFAULT_PRIORITY);
         priority = init_priority - SCE_KERNEL_DEFAULT_PRIORITY + SCE_KERNEL_GAME_DEFAULT_PRIORITY_ACTUAL;
@@ -72,16 +70,22 @@ int ThreadState::init(const char *name, Ptr<const void> entry_point, int init_pr
     start_tick = rtc_get_ticks(kernel.base_tick.tick);
     last_vblank_waited = 0;
 
-    cpu = init_cpu(kernel.cpu_backend, kernel.cpu_opt, id, static_cast<std::size_t>(core_num), mem, kernel.cpu_protocol.get());
+    cpu = kernel.take_pooled_cpu(id);
     if (!cpu) {
-        return SCE_KERNEL_ERROR_ERROR;
-    }
-    if (kernel.debugger.watch_code) {
-        set_log_code(*cpu, true);
-    }
-    if (kernel.debugger.watch_memory) {
-        set_log_mem(*cpu, true);
+        int core_num = kernel.corenum_allocator.new_corenum();
+        if (core_num < 0) {
+            LOG_ERROR("Out of core number to allocate, use 0");
+            core_num = 0;
+        }
+
+        cpu = init_cpu(kernel.cpu_backend, kernel.cpu_opt, kernel.cpu_unsafe_optimizations, id, static_cast<std::size_t>(core_num), mem, kernel.cpu_protocol.get());
+        if (!cpu) {
+            return SCE_KERNEL_ERROR_ERROR;
+        }
     }
+    // a pooled cpu keeps the logging state of its previous thread
+    set_log_code(*cpu, kernel.debugger.watch_code);
+    set_log_mem(*cpu, kernel.debugger.watch_memory);
 
     std::string alloc_name = fmt::format("Stack for thread {} (#{})", name, id);
     stack = alloc_block(mem, stack_size, alloc_name.c_str());
@@ -182,6 +186,8 @@ void ThreadState::exit_delete(bool exit) {
 
 bool ThreadState::run_loop() {
     int res = 0;
+    // core of the guest scheduler taken while running the jit
+    int guest_core = -1;
     int run_level = std::max(call_level, 1);
     std::unique_lock<std::mutex> lock(mutex);
 
@@ -233,6 +239,9 @@ bool ThreadState::run_loop() {
 
             lock.unlock();
 
+            if (has_host_thread && host_scheduling_changed)
+                update_host_scheduling();
+
             if (run_start_callback) {
                 run_start_callback = false;
 
@@ -244,16 +253,24 @@ bool ThreadState::run_loop() {
             }
 
             // Run the cpu
+            guest_core = acquire_guest_core(kernel.guest_scheduler, *this);
             if (to_do == ThreadToDo::step) {
                 res = step(*cpu);
                 to_do = ThreadToDo::suspend;
 
+            } else if (kernel.measure_host_time.load(std::memory_order_relaxed)) {
+                const uint64_t start_ns = get_host_time_ns();
+                res = run(*cpu);
+                const uint64_t guest_cpu_ns = get_host_time_ns() - start_ns;
+                host_time.guest_cpu_ns += guest_cpu_ns;
+                kernel.guest_cpu_ns.fetch_add(guest_cpu_ns, std::memory_order_relaxed);
             } else
                 res = run(*cpu);
+            release_guest_core(kernel.guest_scheduler, guest_core);
 
             // handle svc call if this was what stopped the cpu
             if (cpu->svc_called) {
-                cpu->protocol->call_svc(*cpu, cpu->svc_called, read_pc(*cpu), *this);
+                cpu->protocol->call_svc(*cpu, cpu->svc, read_pc(*cpu), *this);
             }
 
             lock.lock();
@@ -372,10 +389,51 @@ ThreadState::ThreadState(SceUID id, KernelState &kernel, MemState &mem)
     , mem(mem) {
 }
 
+// user priorities go from 64 (highest) to 191 (lowest), most game threads stay around the default of 160
+static HostThreadPriority get_host_priority(int priority) {
+    if (priority < 96)
+        return HostThreadPriority::Highest;
+    if (priority < 128)
+        return HostThreadPriority::High;
+    if (priority < 176)
+        return HostThreadPriority::Normal;
+    return HostThreadPriority::Low;
+}
+
+// each of the 3 user cores gets a third of the host cores, a thread which can run on any core is not restricted
+static uint64_t get_host_core_mask(SceInt32 affinity_mask) {
+    const uint32_t host_core_count = std::min(std::thread::hardware_concurrency(), 64U);
+    affinity_mask &= SCE_KERNEL_CPU_MASK_USER_ALL;
+    if (host_core_count < 3 || affinity_mask == 0 || affinity_mask == SCE_KERNEL_CPU_MASK_USER_ALL)
+        return 0;
+
+    uint64_t core_mask = 0;
+    for (uint32_t core = 0; core < host_core_count; core++) {
+        if (affinity_mask & (SCE_KERNEL_CPU_MASK_USER_0 << (core % 3)))
+            core_mask |= 1ULL << core;
+    }
+    return core_mask;
+}
+
+void ThreadState::update_host_scheduling() {
+    host_scheduling_changed = false;
+    if (kernel.host_thread_priority && !set_current_thread_priority(get_host_priority(priority)))
+        LOG_DEBUG("Could not change the host priority of thread {} to match {}", name, priority);
+    if (kernel.host_thread_affinity && !set_current_thread_affinity(get_host_core_mask(affinity_mask)))
+        LOG_DEBUG("Could not change the host affinity of thread {} to match {}", name, log_hex(affinity_mask));
+}
+
 void ThreadState::update_status(ThreadStatus status, std::optional<ThreadStatus> expected) {
     if (expected)
         assert(expected.value() == this->status);
 
+    if (status == ThreadStatus::wait && this->status != ThreadStatus::wait) {
+        host_time.wait_start_ns = kernel.measure_host_time.load(std::memory_order_relaxed) ? get_host_time_ns() : 0;
+    } else if (status != ThreadStatus::wait && host_time.wait_start_ns != 0) {
+        host_time.wait_ns += get_host_time_ns() - host_time.wait_start_ns;
+        host_time.wait_start_ns = 0;
+    }
+
     this->status = status;
     status_cond.notify_all();
 
@@ -388,6 +446,16 @@ Address ThreadState::stack_top() const {
     return stack.get() + stack_size;
 }
 
+Ptr<Ptr<void>> ThreadState::get_tls_addr(int key) const {
+    // magic numbers taken from decompiled source. There is 0x400 unused bytes of unknown usage
+    if (key > 0x100 || key < 0) {
+        LOG_ERROR("Wrong tls slot index. TID:{} index:{}", id, key);
+        return Ptr<Ptr<void>>(0);
+    }
+
+    return tls.get_ptr<Ptr<void>>() + key;
+}
+
 void ThreadState::suspend() {
     assert(to_do == ThreadToDo::run);
     to_do = ThreadToDo::suspend;
@@ -416,4 +484,25 @@ std::string ThreadState::log_stack_traceback() const {
             ss << fmt::format("{} (module: {})\n", log_hex(value), mod->module_name);
     }
     return ss.str();
-}
\ No newline at end of file
+}
+
+uint64_t get_host_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+HleHostTimeScope::HleHostTimeScope(KernelState &kernel, ThreadState &thread)
+    : kernel(kernel)
+    , thread(thread)
+    , start_time(thread.host_time)
+    , start_ns(get_host_time_ns()) {
+}
+
+HleHostTimeScope::~HleHostTimeScope() {
+    const uint64_t elapsed_ns = get_host_time_ns() - start_ns;
+    const ThreadHostTime &end_time = thread.host_time;
+    // the nested HLE functions, called from the callbacks, already counted their own time
+    const uint64_t excluded_ns = (end_time.wait_ns - start_time.wait_ns) + (end_time.guest_cpu_ns - start_time.guest_cpu_ns) + (end_time.hle_ns - start_time.hle_ns);
+    const uint64_t hle_ns = elapsed_ns > excluded_ns ? elapsed_ns - excluded_ns : 0;
+    thread.host_time.hle_ns += hle_ns;
+    kernel.hle_ns.fetch_add(hle_ns, std::memory_order_relaxed);
+}
@@ -0,0 +1,182 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/timer_wheel.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+static constexpr uint64_t NO_DEADLINE = std::numeric_limits<uint64_t>::max();
+
+uint64_t timer_wheel_now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t next_deadline(const TimerWheel &wheel) {
+    // the first slot holding a timeout of the current revolution gives the next deadline
+    for (size_t i = 0; i < TimerWheel::SLOT_COUNT; i++) {
+        const uint64_t tick = wheel.current_tick + i;
+        uint64_t earliest = NO_DEADLINE;
+        for (const TimeoutEntry &entry : wheel.slots[tick % TimerWheel::SLOT_COUNT]) {
+            if (entry.deadline / TimerWheel::TICK_US <= tick)
+                earliest = std::min(earliest, entry.deadline);
+        }
+        if (earliest != NO_DEADLINE)
+            return earliest;
+    }
+
+    // only timeouts of the next revolutions are left
+    uint64_t earliest = NO_DEADLINE;
+    for (const auto &[id, entry] : wheel.entries)
+        earliest = std::min(earliest, entry->deadline);
+    return earliest;
+}
+
+// fire the timeouts reached in the ticks elapsed since the last call, returns true if a callback has to be called again
+static bool fire_timeouts(TimerWheel &wheel, uint64_t now) {
+    const uint64_t now_tick = now / TimerWheel::TICK_US;
+    const size_t now_slot = now_tick % TimerWheel::SLOT_COUNT;
+    const uint64_t tick_count = std::min<uint64_t>(now_tick - wheel.current_tick + 1, TimerWheel::SLOT_COUNT);
+
+    bool retry = false;
+    for (uint64_t i = 0; i < tick_count; i++) {
+        const size_t slot_index = (wheel.current_tick + i) % TimerWheel::SLOT_COUNT;
+        std::list<TimeoutEntry> &slot = wheel.slots[slot_index];
+        for (auto it = slot.begin(); it != slot.end();) {
+            if (it->deadline > now) {
+                ++it;
+                continue;
+            }
+
+            if (it->callback()) {
+                wheel.entries.erase(it->id);
+                it = slot.erase(it);
+                continue;
+            }
+
+            // the timeout is tried again on the next pass, from the slot of the current tick
+            retry = true;
+            if (slot_index == now_slot) {
+                ++it;
+            } else {
+                it->slot = now_slot;
+                wheel.slots[now_slot].splice(wheel.slots[now_slot].end(), slot, it++);
+            }
+        }
+    }
+    wheel.current_tick = now_tick;
+
+    return retry;
+}
+
+static void run_timer_wheel(TimerWheel &wheel) {
+    std::unique_lock<std::mutex> lock(wheel.mutex);
+    while (!wheel.exiting) {
+        const uint64_t now = timer_wheel_now();
+        const bool retry = fire_timeouts(wheel, now);
+        const uint64_t deadline = next_deadline(wheel);
+
+        if (retry || (deadline != NO_DEADLINE && deadline <= now + wheel.spin_us)) {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        } else if (deadline == NO_DEADLINE) {
+            wheel.cond.wait(lock);
+        } else {
+            wheel.cond.wait_for(lock, std::chrono::microseconds(deadline - now - wheel.spin_us));
+        }
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    stop_timer_wheel(*this);
+}
+
+uint64_t add_timeout(TimerWheel &wheel, uint64_t deadline, TimeoutCallback callback) {
+    const std::lock_guard<std::mutex> lock(wheel.mutex);
+    if (wheel.exiting)
+        return 0;
+
+    if (!wheel.thread.joinable()) {
+        wheel.current_tick = timer_wheel_now() / TimerWheel::TICK_US;
+        wheel.thread = std::thread(run_timer_wheel, std::ref(wheel));
+    }
+
+    // a deadline already reached goes in the slot of the current tick
+    const size_t slot_index = std::max(deadline / TimerWheel::TICK_US, wheel.current_tick) % TimerWheel::SLOT_COUNT;
+    std::list<TimeoutEntry> &slot = wheel.slots[slot_index];
+    const uint64_t id = wheel.next_id++;
+    slot.push_back({ id, deadline, slot_index, std::move(callback) });
+    wheel.entries.emplace(id, std::prev(slot.end()));
+
+    wheel.cond.notify_one();
+    return id;
+}
+
+void cancel_timeout(TimerWheel &wheel, uint64_t id) {
+    // the callbacks are called with the mutex held, so none is running once it is locked
+    const std::lock_guard<std::mutex> lock(wheel.mutex);
+    const auto it = wheel.entries.find(id);
+    if (it == wheel.entries.end())
+        return;
+
+    wheel.slots[it->second->slot].erase(it->second);
+    wheel.entries.erase(it);
+}
+
+void stop_timer_wheel(TimerWheel &wheel) {
+    {
+        const std::lock_guard<std::mutex> lock(wheel.mutex);
+        wheel.exiting = true;
+        wheel.cond.notify_one();
+    }
+
+    if (wheel.thread.joinable())
+        wheel.thread.join();
+}
+
+bool timed_wait(TimerWheel &wheel, std::condition_variable &cond, std::unique_lock<std::mutex> &lock, uint64_t deadline, const std::function<bool()> &pred) {
+    if (pred())
+        return true;
+    if (deadline == NO_DEADLINE) {
+        cond.wait(lock, pred);
+        return true;
+    }
+
+    // the wheel thread must not block on the mutex, it is held by this thread while cancelling the timeout
+    std::mutex &mutex = *lock.mutex();
+    bool expired = false;
+    const uint64_t id = add_timeout(wheel, deadline, [&]() {
+        if (!mutex.try_lock())
+            return false;
+        expired = true;
+        mutex.unlock();
+        cond.notify_all();
+        return true;
+    });
+
+    if (id == 0) {
+        const uint64_t now = timer_wheel_now();
+        return cond.wait_for(lock, std::chrono::microseconds(deadline > now ? deadline - now : 0), pred);
+    }
+
+    cond.wait(lock, [&] { return expired || pred(); });
+    cancel_timeout(wheel, id);
+
+    return pred();
+}
@@ -287,6 +287,8 @@ struct LangState {
         { "toggle_touch_description", "Toggles between back touch and screen touch." },
         { "toggle_gui_visibility", "Toggle GUI Visibility" },
         { "toggle_gui_visibility_description", "Toggles between showing and hiding the GUI at the top of the screen while the app is running." },
+        { "toggle_turbo", "Toggle Turbo Mode" },
+        { "toggle_turbo_description", "Toggles between running the app at real time and at the turbo speed set in the config." },
         { "error", "Error" },
         { "error_duplicate_key", "The key is used for other bindings or it is reserved." }
     };
@@ -413,7 +415,35 @@ struct LangState {
     std::map<std::string, std::string> performance_overlay = {
         { "avg", "Avg" },
         { "min", "Min" },
-        { "max", "Max" }
+        { "max", "Max" },
+        { "textures", "Textures" },
+        { "peak", "Peak" },
+        { "draws", "Draws" },
+        { "batching", "Batching" },
+        { "passes", "Passes" },
+        { "elided", "Elided" },
+        { "vram", "VRAM" },
+        { "gpu", "GPU" },
+        { "resolution", "Res" },
+        { "faults", "Faults" },
+        { "tracked", "Tracked" },
+        { "vblank", "VBlank" },
+        { "audio", "Audio" },
+        { "underruns", "Underruns" },
+        { "read_ahead", "Read-ahead" },
+        { "read", "Read" },
+        { "host", "Host" },
+        { "tasks", "Tasks" },
+        { "running", "Running" },
+        { "lows", "Lows" },
+        { "frame", "Frame" },
+        { "guest_cpu", "CPU" },
+        { "hle", "HLE" },
+        { "commands", "Commands" },
+        { "present", "Present" },
+        { "load", "Load" },
+        { "speed", "Speed" },
+        { "unlimited", "Unlimited" }
     };
     struct Settings {
         std::map<std::string, std::string> main = { { "title", "Settings" } };
@@ -17,6 +17,7 @@
 
 #include "interface.h"
 
+#include <app/benchmark.h>
 #include <app/functions.h>
 #include <config/functions.h>
 #include <config/version.h>
@@ -24,6 +25,7 @@
 #include <emuenv/state.h>
 #include <gui/functions.h>
 #include <gui/state.h>
+#include <gxm/state.h>
 #include <io/state.h>
 #include <kernel/state.h>
 #include <modules/module_parent.h>
@@ -34,7 +36,9 @@
 #include <renderer/shaders.h>
 #include <renderer/state.h>
 #include <shader/spirv_recompiler.h>
+#include <util/boot_profiler.h>
 #include <util/log.h>
+#include <util/performance_hint.h>
 #include <util/string_utils.h>
 
 #if USE_DISCORD
@@ -83,6 +87,108 @@ static void run_execv(char *argv[], EmuEnvState &emuenv) {
 #endif
 };
 
+static bool is_main_thread_running(EmuEnvState &emuenv) {
+    const ThreadStatePtr main_thread = emuenv.kernel.get_thread(emuenv.main_thread_id);
+    if (!main_thread)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(main_thread->mutex);
+    return main_thread->status != ThreadStatus::dormant;
+}
+
+// Runs the app without window, gui or audio device until it exits or has rendered cfg.exit_after_frames frames
+static ExitCode run_headless(EmuEnvState &emuenv) {
+    if (!app::late_init(emuenv)) {
+        LOG_ERROR("Failed to initialize Vita3K");
+        return InitConfigFailed;
+    }
+
+    int32_t main_module_id;
+    {
+        const auto err = load_app(main_module_id, emuenv, string_utils::utf_to_wide(emuenv.io.app_path));
+        if (err != Success)
+            return err;
+    }
+
+    emuenv.renderer->title_id = emuenv.io.title_id.c_str();
+    emuenv.renderer->self_name = emuenv.self_name.c_str();
+    if (renderer::get_shaders_cache_hashs(*emuenv.renderer) && emuenv.cfg.shader_cache) {
+        LOG_INFO("Compiling {} shaders", emuenv.renderer->shaders_cache_hashs.size());
+        if (emuenv.renderer->start_parallel_precompile()) {
+            while (!emuenv.renderer->is_parallel_precompile_done())
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        } else {
+            for (const auto &hash : emuenv.renderer->shaders_cache_hashs)
+                emuenv.renderer->precompile_shader(hash);
+        }
+        emuenv.renderer->precompile_pipelines();
+    }
+
+    const bool is_benchmark = emuenv.cfg.benchmark_frames > 0;
+    if (is_benchmark && !app::start_benchmark(emuenv))
+        return BenchmarkFailed;
+
+    {
+        const auto err = run_app(emuenv, main_module_id);
+        if (err != Success)
+            return err;
+    }
+
+    Benchmark benchmark;
+    size_t last_frame_count = 0;
+    const auto start = std::chrono::steady_clock::now();
+    bool quit_requested = false;
+    while (!quit_requested && !emuenv.load_exec && is_main_thread_running(emuenv)) {
+        // Driver acto!
+        renderer::process_batches(*emuenv.renderer.get(), emuenv.renderer->features, emuenv.mem, emuenv.cfg);
+
+        if (is_benchmark) {
+            app::sample_benchmark(emuenv, benchmark);
+            if (benchmark.samples.size() >= emuenv.cfg.benchmark_frames)
+                break;
+        } else if (emuenv.cfg.exit_after_frames > 0 && emuenv.frame_count >= emuenv.cfg.exit_after_frames) {
+            break;
+        }
+
+        // calculate_fps is not called here, a new frame is detected from the frame counter
+        if (emuenv.frame_count != last_frame_count) {
+            last_frame_count = emuenv.frame_count;
+            app::sample_stutters(emuenv);
+        }
+
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT)
+                quit_requested = true;
+        }
+    }
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Headless run ended after {} frames in {:.2f}s ({:.2f} fps){}", emuenv.frame_count, elapsed,
+        elapsed > 0 ? emuenv.frame_count / elapsed : 0.0, emuenv.load_exec ? ", the app asked to be relaunched" : "");
+
+    ExitCode result = Success;
+    if (is_benchmark) {
+        const fs::path report_path = emuenv.cfg.benchmark_report_path.empty() ? emuenv.log_path / "benchmark.json" : fs::path(string_utils::utf_to_wide(emuenv.cfg.benchmark_report_path));
+        if (benchmark.samples.size() < emuenv.cfg.benchmark_frames)
+            LOG_ERROR("The app exited after {} of the {} frames of the benchmark", benchmark.samples.size(), emuenv.cfg.benchmark_frames);
+        if (!app::write_benchmark_report(emuenv, benchmark, report_path) || benchmark.samples.size() < emuenv.cfg.benchmark_frames)
+            result = BenchmarkFailed;
+    }
+
+    emuenv.kernel.exit_delete_all_threads();
+    emuenv.gxm.display_queue.abort();
+    emuenv.display.abort = true;
+    if (emuenv.display.vblank_thread) {
+        emuenv.display.vblank_thread->join();
+    }
+
+    emuenv.renderer->preclose_action();
+    app::destroy(emuenv, nullptr);
+
+    return result;
+}
+
 int main(int argc, char *argv[]) {
     ZoneScoped; // Tracy - Track main function scope
     Root root_paths;
@@ -135,6 +241,14 @@ int main(int argc, char *argv[]) {
                 LOG_INFO("Recompiling {}", *cfg.recompile_shader_path);
                 shader::convert_gxp_to_glsl_from_filepath(*cfg.recompile_shader_path);
             }
+            if (cfg.merge_shader_cache) {
+                if (cfg.shared_shader_cache_path.empty()) {
+                    LOG_ERROR("No shared shader cache to merge into, set it with --shared-shader-cache-path");
+                    return InitConfigFailed;
+                }
+                const size_t added = renderer::merge_shader_cache(root_paths.get_cache_path_string().c_str(), cfg.shared_shader_cache_path.c_str());
+                LOG_INFO("Added {} shaders to the shared shader cache {}", added, cfg.shared_shader_cache_path);
+            }
             if (cfg.delete_title_id.has_value()) {
                 LOG_INFO("Deleting title id {}", *cfg.delete_title_id);
                 fs::remove_all(fs::path(cfg.pref_path) / "ux0/app" / *cfg.delete_title_id);
@@ -178,7 +292,9 @@ int main(int argc, char *argv[]) {
         SDL_SetHint(SDL_HINT_JOYSTICK_HIDAPI_SWITCH, "1");
         SDL_SetHint(SDL_HINT_JOYSTICK_HIDAPI_JOY_CONS, "1");
 
-        if (SDL_Init(SDL_INIT_GAMECONTROLLER | SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+        // without window and audio device, only the events are needed to be told to quit
+        const Uint32 sdl_subsystems = cfg.headless ? SDL_INIT_EVENTS : SDL_INIT_GAMECONTROLLER | SDL_INIT_VIDEO | SDL_INIT_AUDIO;
+        if (SDL_Init(sdl_subsystems) < 0) {
             app::error_dialog("SDL initialisation failed.");
             return SDLInitFailed;
         }
@@ -193,6 +309,7 @@ int main(int argc, char *argv[]) {
     if (cfg.run_app_path)
         run_type = app::AppRunType::Extracted;
 
+    emuenv.boot_profiler.trace_path = fs::path(string_utils::utf_to_wide(cfg.boot_profile_path));
     if (!app::init(emuenv, cfg, root_paths)) {
         app::error_dialog("Emulated environment initialization failed.", emuenv.window.get());
         return 1;
@@ -204,7 +321,7 @@ int main(int argc, char *argv[]) {
     init_libraries(emuenv);
 
     GuiState gui;
-    if (!cfg.console) {
+    if (!cfg.console && !emuenv.cfg.headless) {
         gui::pre_init(gui, emuenv);
         if (!emuenv.cfg.initial_setup) {
             while (!emuenv.cfg.initial_setup) {
@@ -223,13 +340,19 @@ int main(int argc, char *argv[]) {
     }
 
     if (cfg.content_path.has_value()) {
-        auto gui_ptr = cfg.console ? nullptr : &gui;
+        auto gui_ptr = (cfg.console || emuenv.cfg.headless) ? nullptr : &gui;
         const auto extention = string_utils::tolower(cfg.content_path->extension().string());
         const auto is_archive = (extention == ".vpk") || (extention == ".zip");
         const auto is_rif = (extention == ".rif") || (extention == "work.bin");
         const auto is_directory = fs::is_directory(*cfg.content_path);
 
         const auto content_is_app = [&]() {
+            if (cfg.mount_archive) {
+                if (mount_app_archive(emuenv, string_utils::utf_to_wide(cfg.content_path->string())))
+                    return true;
+                LOG_WARN("Installing the archive instead of running the app from it");
+            }
+
             std::vector<ContentInfo> contents_info = install_archive(emuenv, gui_ptr, string_utils::utf_to_wide(cfg.content_path->string()));
             const auto content_index = std::find_if(contents_info.begin(), contents_info.end(), [&](const ContentInfo &c) {
                 return c.category == "gd";
@@ -250,21 +373,30 @@ int main(int argc, char *argv[]) {
                 LOG_ERROR("File dropped: [{}] is not supported.", cfg.content_path->string());
 
             emuenv.cfg.content_path.reset();
-            if (!cfg.console)
+            if (!cfg.console && !emuenv.cfg.headless)
                 gui::init_home(gui, emuenv);
         }
     }
 
     if (run_type == app::AppRunType::Extracted) {
         emuenv.io.app_path = cfg.run_app_path ? *cfg.run_app_path : emuenv.app_info.app_title_id;
-        gui::init_user_app(gui, emuenv, emuenv.io.app_path);
+        // there is no icon to load without gui
+        if (emuenv.cfg.headless)
+            gui::get_app_param(gui, emuenv, emuenv.io.app_path);
+        else
+            gui::init_user_app(gui, emuenv, emuenv.io.app_path);
         if (emuenv.cfg.run_app_path.has_value())
             emuenv.cfg.run_app_path.reset();
         else if (emuenv.cfg.content_path.has_value())
             emuenv.cfg.content_path.reset();
     }
 
-    if (!cfg.console) {
+    if (emuenv.cfg.headless && (run_type != app::AppRunType::Extracted)) {
+        LOG_ERROR("Headless mode could not find an app to run.");
+        return InitConfigFailed;
+    }
+
+    if (!cfg.console && !emuenv.cfg.headless) {
 #if USE_DISCORD
         auto discord_rich_presence_old = emuenv.cfg.discord_rich_presence;
 #endif
@@ -272,17 +404,34 @@ int main(int argc, char *argv[]) {
         std::chrono::system_clock::time_point present = std::chrono::system_clock::now();
         std::chrono::system_clock::time_point later = std::chrono::system_clock::now();
         const double frame_time = 1000.0 / 60.0;
+        // Without input or pending updates, the UI is only redrawn at this rate, for the clock and the live area frames
+        const auto idle_frame_time = std::chrono::milliseconds(100);
+        // ImGui needs a few more frames after an input to settle its hover and navigation states
+        const auto active_time = std::chrono::milliseconds(500);
+        std::chrono::steady_clock::time_point last_activity = std::chrono::steady_clock::now();
+        const auto is_idle = [&]() {
+            SDL_PumpEvents();
+            if (SDL_HasEvents(SDL_FIRSTEVENT, SDL_LASTEVENT) || gui::has_pending_updates(gui))
+                last_activity = std::chrono::steady_clock::now();
+            return std::chrono::steady_clock::now() - last_activity > active_time;
+        };
         // Application not provided via argument, show app selector
         while (run_type == app::AppRunType::Unknown) {
-            // get the current time & get the time we worked for
-            present = std::chrono::system_clock::now();
-            std::chrono::duration<double, std::milli> work_time = present - later;
-            // check if we are running faster than ~60fps (16.67ms)
-            if (work_time.count() < frame_time) {
-                // sleep for delta time.
-                std::chrono::duration<double, std::milli> delta_ms(frame_time - work_time.count());
-                auto delta_ms_duration = std::chrono::duration_cast<std::chrono::milliseconds>(delta_ms);
-                std::this_thread::sleep_for(std::chrono::milliseconds(delta_ms_duration.count()));
+            if (is_idle()) {
+                // sleep until the next input or the next idle frame
+                if (SDL_WaitEventTimeout(nullptr, static_cast<int>(idle_frame_time.count())))
+                    last_activity = std::chrono::steady_clock::now();
+            } else {
+                // get the current time & get the time we worked for
+                present = std::chrono::system_clock::now();
+                std::chrono::duration<double, std::milli> work_time = present - later;
+                // check if we are running faster than ~60fps (16.67ms)
+                if (work_time.count() < frame_time) {
+                    // sleep for delta time.
+                    std::chrono::duration<double, std::milli> delta_ms(frame_time - work_time.count());
+                    auto delta_ms_duration = std::chrono::duration_cast<std::chrono::milliseconds>(delta_ms);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(delta_ms_duration.count()));
+                }
             }
             // save the later time
             later = std::chrono::system_clock::now();
@@ -342,6 +491,12 @@ int main(int argc, char *argv[]) {
             return main_thread->status == ThreadStatus::dormant;
         });
         return Success;
+    } else if (emuenv.cfg.headless) {
+        const auto err = run_headless(emuenv);
+#ifdef WIN32
+        CoUninitialize();
+#endif
+        return err;
     } else {
         gui.imgui_state->do_clear_screen = false;
     }
@@ -378,18 +533,37 @@ int main(int argc, char *argv[]) {
     emuenv.renderer->title_id = emuenv.io.title_id.c_str();
     emuenv.renderer->self_name = emuenv.self_name.c_str();
     if (renderer::get_shaders_cache_hashs(*emuenv.renderer) && cfg.shader_cache) {
+        const auto shaders_start = std::chrono::steady_clock::now();
         SDL_SetWindowTitle(emuenv.window.get(), fmt::format("{} | {} ({}) | Please wait, compiling shaders...", window_title, emuenv.current_app_title, emuenv.io.title_id).c_str());
-        for (const auto &hash : emuenv.renderer->shaders_cache_hashs) {
-            handle_events(emuenv, gui);
-            gui::draw_begin(gui, emuenv);
-            draw_app_background(gui, emuenv);
+        if (emuenv.renderer->start_parallel_precompile()) {
+            // the shaders are compiled by worker threads, only display the progress here
+            while (!emuenv.renderer->is_parallel_precompile_done()) {
+                handle_events(emuenv, gui);
+                gui::draw_begin(gui, emuenv);
+                draw_app_background(gui, emuenv);
 
-            emuenv.renderer->precompile_shader(hash);
-            gui::draw_pre_compiling_shaders_progress(gui, emuenv, uint32_t(emuenv.renderer->shaders_cache_hashs.size()));
+                gui::draw_pre_compiling_shaders_progress(gui, emuenv, uint32_t(emuenv.renderer->shaders_cache_hashs.size()));
 
-            gui::draw_end(gui, emuenv.window.get());
-            emuenv.renderer->swap_window(emuenv.window.get());
+                gui::draw_end(gui, emuenv.window.get());
+                emuenv.renderer->swap_window(emuenv.window.get());
+            }
+        } else {
+            for (const auto &hash : emuenv.renderer->shaders_cache_hashs) {
+                handle_events(emuenv, gui);
+                gui::draw_begin(gui, emuenv);
+                draw_app_background(gui, emuenv);
+
+                emuenv.renderer->precompile_shader(hash);
+                gui::draw_pre_compiling_shaders_progress(gui, emuenv, uint32_t(emuenv.renderer->shaders_cache_hashs.size()));
+
+                gui::draw_end(gui, emuenv.window.get());
+                emuenv.renderer->swap_window(emuenv.window.get());
+            }
         }
+        const auto pipelines_start = std::chrono::steady_clock::now();
+        record_boot_event(emuenv.boot_profiler, "shader precompile", "shader precompile", shaders_start, pipelines_start);
+        emuenv.renderer->precompile_pipelines();
+        record_boot_event(emuenv.boot_profiler, "pipeline precompile", "pipeline precompile", pipelines_start, std::chrono::steady_clock::now());
     }
     {
         const auto err = run_app(emuenv, main_module_id);
@@ -407,7 +581,10 @@ int main(int argc, char *argv[]) {
             const std::lock_guard<std::mutex> guard(emuenv.display.display_info_mutex);
             const SceFVector2 viewport_pos = { emuenv.viewport_pos.x, emuenv.viewport_pos.y };
             const SceFVector2 viewport_size = { emuenv.viewport_size.x, emuenv.viewport_size.y };
+            const auto render_start = std::chrono::steady_clock::now();
             emuenv.renderer->render_frame(viewport_pos, viewport_size, emuenv.display, emuenv.gxm, emuenv.mem);
+            if (emuenv.frame_count > 0)
+                record_boot_event(emuenv.boot_profiler, "render_frame", "first frame", render_start, std::chrono::steady_clock::now());
         }
 
         gui::draw_begin(gui, emuenv);
@@ -418,22 +595,44 @@ int main(int argc, char *argv[]) {
         emuenv.renderer->swap_window(emuenv.window.get());
         FrameMark; // Tracy - Frame end mark for game loading loop
     }
+    finish_boot_profile(emuenv.boot_profiler);
+
+    // the host renderer thread and the guest threads presenting the frames must render one per vblank of the Vita
+    add_performance_hint_thread();
+    if (start_performance_hint(std::chrono::nanoseconds(std::chrono::seconds(1)).count() / 60))
+        LOG_INFO("The host performance hints are used for the frame threads");
 
-    while (handle_events(emuenv, gui) && !emuenv.load_exec) {
+    while (!emuenv.cfg.exit_after_boot && handle_events(emuenv, gui) && !emuenv.load_exec) {
         ZoneScopedN("Game rendering"); // Tracy - Track game rendering loop scope
+        const auto frame_start = std::chrono::steady_clock::now();
         // Driver acto!
         renderer::process_batches(*emuenv.renderer.get(), emuenv.renderer->features, emuenv.mem, emuenv.cfg);
 
+        renderer::FrameSkip &frame_skip = emuenv.renderer->frame_skip;
+        Address displayed_surface = 0;
         {
             const std::lock_guard<std::mutex> guard(emuenv.display.display_info_mutex);
-            const SceFVector2 viewport_pos = { emuenv.viewport_pos.x, emuenv.viewport_pos.y };
-            const SceFVector2 viewport_size = { emuenv.viewport_size.x, emuenv.viewport_size.y };
-            emuenv.renderer->render_frame(viewport_pos, viewport_size, emuenv.display, emuenv.gxm, emuenv.mem);
+            displayed_surface = emuenv.display.frame.base.address();
+            if (frame_skip.is_skipping()) {
+                // the guest goes on with the next frame, it is not presented
+                emuenv.renderer->should_display = false;
+            } else {
+                const SceFVector2 viewport_pos = { emuenv.viewport_pos.x, emuenv.viewport_pos.y };
+                const SceFVector2 viewport_size = { emuenv.viewport_size.x, emuenv.viewport_size.y };
+                emuenv.renderer->render_frame(viewport_pos, viewport_size, emuenv.display, emuenv.gxm, emuenv.mem);
+            }
         }
 
         // Calculate FPS
         app::calculate_fps(emuenv);
 
+        if (frame_skip.is_skipping()) {
+            frame_skip.end_frame(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frame_start).count(),
+                emuenv.display.vblank_count, displayed_surface);
+            FrameMark; // Tracy - Frame end mark for game rendering loop
+            continue;
+        }
+
         // Set shaders compiled display
         gui::set_shaders_compiled_display(gui, emuenv);
 
@@ -453,9 +652,14 @@ int main(int argc, char *argv[]) {
         }
 
         gui::draw_end(gui, emuenv.window.get());
+        // the wait for the vsync in the swap is not work
+        report_frame_work_duration(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frame_start).count());
         emuenv.renderer->swap_window(emuenv.window.get());
+        frame_skip.end_frame(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frame_start).count(),
+            emuenv.display.vblank_count, displayed_surface);
         FrameMark; // Tracy - Frame end mark for game rendering loop
     }
+    stop_performance_hint();
 
 #ifdef WIN32
     CoUninitialize();
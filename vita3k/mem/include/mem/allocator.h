@@ -21,13 +21,42 @@
 #include <mutex>
 #include <vector>
 
+// A set bit is a free slot, the first slot of a word is its most significant bit
 struct BitmapAllocator {
     std::vector<std::uint32_t> words;
-    std::size_t max_offset;
+    std::size_t max_offset = 0;
+
+    // Free runs of a range of slots
+    struct RunSummary {
+        std::uint32_t length = 0;
+        std::uint32_t prefix = 0; // free slots at the start of the range
+        std::uint32_t suffix = 0; // free slots at the end of the range
+        std::uint32_t longest = 0;
+    };
 
 protected:
+    static constexpr std::uint32_t GROUP_WORDS = 64;
+    static constexpr std::uint32_t GROUP_BITS = GROUP_WORDS * 32;
+
+    // Segment tree of the free runs of each group of GROUP_WORDS words, the root is at index 1 and the groups are the leaves.
+    // It lets the searches skip the parts of the bitmap which can't hold the allocation.
+    // It is built on the first allocation, words changed directly after it are not seen by allocate_from.
+    std::vector<RunSummary> summary;
+    std::size_t summary_leaves = 0;
+    bool summary_valid = false;
+
     int force_fill(const std::uint32_t offset, const int size, const bool or_mode = false);
 
+    std::uint32_t get_word(const std::size_t index) const;
+    std::uint32_t total_bits() const;
+    RunSummary summarize_group(const std::size_t group) const;
+    void build_summary();
+    void update_summary(const std::uint32_t offset, const int size);
+    int find_first_fit(const std::uint32_t start_offset, const std::uint32_t size) const;
+    int find_first_fit(const std::size_t node, const std::size_t begin, const std::size_t end, const std::size_t first_group, std::uint32_t &carry, const std::uint32_t size) const;
+    std::uint32_t free_prefix(const std::size_t node, const std::size_t begin, const std::size_t end, const std::size_t first_group, bool &ended) const;
+    std::uint32_t free_run_length(const std::uint32_t offset) const;
+
 public:
     BitmapAllocator() = default;
     explicit BitmapAllocator(const std::size_t total_bits);
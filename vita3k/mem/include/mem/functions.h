@@ -20,6 +20,8 @@
 #include <mem/block.h>
 #include <mem/util.h>
 
+#include <iosfwd>
+
 struct MemState;
 
 typedef std::function<bool(uint8_t *addr, bool write)> AccessViolationHandler;
@@ -33,7 +35,10 @@ enum struct MemPerm {
     ReadWrite = ReadOnly | WriteOnly
 };
 
-bool init(MemState &state, const bool use_page_table);
+// page size of the host (4 KiB, 16 KiB on arm64 macOS and some Android devices...), never smaller than 4 KiB
+// the guest memory is allocated and protected with this granularity, can be called before init
+uint32_t get_host_page_size();
+bool init(MemState &state, const bool use_page_table, const bool use_huge_pages = false);
 Address alloc(MemState &state, uint32_t size, const char *name);
 Address alloc(MemState &state, uint32_t size, const char *name, unsigned int alignment);
 void protect_inner(MemState &state, Address addr, uint32_t size, const MemPerm perm);
@@ -44,6 +49,18 @@ void close_access_parent_protect_segment(MemState &mem, Address addr);
 void add_external_mapping(MemState &mem, Address addr, uint32_t size, uint8_t *addr_ptr);
 void remove_external_mapping(MemState &mem, uint8_t *addr_ptr);
 bool is_protecting(MemState &state, Address addr, MemPerm *perm = nullptr);
+// write protect the pages of the range until they are written, return 0 if the range could not be tracked
+// (it is not allocated or it is already protected by add_protect), a stamp to give to is_range_written otherwise
+uint64_t track_writes(MemState &state, Address addr, uint32_t size);
+// return true if a page of the range was written since track_writes returned stamp (always true if stamp is 0)
+// the pages can be shared by multiple users, each one keeps its own stamp
+bool is_range_written(const MemState &state, Address addr, uint32_t size, uint64_t stamp);
+// to be called when the range was written by something else than the CPU (the GPU for example)
+void mark_range_written(MemState &state, Address addr, uint32_t size);
+// copy and fill done on the host, the large ones are split between the calling thread and the transfer workers
+// return once the transfer is done, or false without doing anything if a range is not valid
+bool copy_memory(MemState &state, Address dst, Address src, uint32_t size);
+bool fill_memory(MemState &state, Address dst, uint8_t value, uint32_t size);
 bool is_valid_addr(const MemState &state, Address addr);
 bool is_valid_addr_range(const MemState &state, Address start, Address end);
 bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcept;
@@ -52,4 +69,11 @@ Address alloc_at(MemState &state, Address address, uint32_t size, const char *na
 Address try_alloc_at(MemState &state, Address address, uint32_t size, const char *name);
 void free(MemState &state, Address address);
 uint32_t mem_available(MemState &state);
+// size of the allocation starting at this address, 0 if none starts there
+uint32_t get_alloc_size(const MemState &state, Address address);
+// write the allocations and their content, compressed by chunks on all the host cores
+// the memory must not be written by anything else meanwhile
+bool save_memory_snapshot(const MemState &state, std::ostream &stream);
+// replace the allocations and the content of the memory by the ones of the snapshot
+bool load_memory_snapshot(MemState &state, std::istream &stream);
 const char *mem_name(Address address, MemState &state);
@@ -0,0 +1,72 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <mem/util.h>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// size classes of the blocks given by the slab allocator, the larger allocations take whole pages
+constexpr std::array<uint32_t, 13> SLAB_BLOCK_SIZES = { 16, 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512 };
+constexpr size_t SLAB_CLASS_COUNT = SLAB_BLOCK_SIZES.size();
+constexpr uint32_t SLAB_MAX_BLOCK_SIZE = SLAB_BLOCK_SIZES.back();
+// alignment of all the blocks, the blocks needing more also take whole pages
+constexpr uint32_t SLAB_BLOCK_ALIGNMENT = 16;
+
+// Allocator of the small blocks of the guest heaps. Each slab is a host page holding the blocks of a single size
+// class after a header giving the class, so a small allocation neither takes a whole page nor changes the
+// protection of the memory. A block is never at the start of a page, which tells the slab blocks apart from the
+// page allocations. The slabs are taken by batches of pages and are never freed.
+struct SlabAllocator {
+    std::mutex mutex;
+    std::array<std::vector<Address>, SLAB_CLASS_COUNT> free_blocks;
+    // pages of the last batch not used yet
+    Address next_page = 0;
+    Address end_page = 0;
+    // incremented when the free blocks are forgotten, the caches filled before are then dropped
+    std::atomic<uint32_t> generation = 0;
+};
+
+// Blocks freed by a guest thread, reused by its next allocations without taking the lock of the allocator.
+// Must only be used by its thread, the blocks are given back to the allocator when it is destroyed.
+struct SlabCache {
+    static constexpr size_t MAX_BLOCKS = 64;
+
+    MemState *mem = nullptr;
+    uint32_t generation = 0;
+    std::array<std::vector<Address>, SLAB_CLASS_COUNT> blocks;
+
+    SlabCache() = default;
+    SlabCache(const SlabCache &) = delete;
+    SlabCache &operator=(const SlabCache &) = delete;
+    ~SlabCache();
+};
+
+// the blocks up to SLAB_MAX_BLOCK_SIZE are not cleared, the larger ones are page allocations
+Address slab_alloc(MemState &mem, SlabCache &cache, uint32_t size, const char *name);
+// the address must have been returned by slab_alloc or alloc, nothing is done for 0
+void slab_free(MemState &mem, SlabCache &cache, Address address);
+// size which can be used from the block, 0 if the address is not the start of an allocation
+uint32_t slab_usable_size(MemState &mem, Address address);
+// forget the free blocks, to be called when the content of the memory is replaced
+// the blocks in use are still freed correctly since their classes are in the guest memory
+void reset_slab_allocator(SlabAllocator &allocator);
@@ -18,9 +18,13 @@
 #pragma once
 
 #include <mem/allocator.h>
+#include <mem/slab.h>
+#include <mem/transfer.h>
 #include <mem/util.h>
+#include <util/lock_profiler.h>
 
 #include <array>
+#include <atomic>
 #include <map>
 #include <mutex>
 #include <set>
@@ -36,6 +40,8 @@ typedef uint8_t *PagePtr;
 typedef std::unique_ptr<uint8_t[], std::function<void(uint8_t *)>> Memory;
 typedef std::unique_ptr<AllocMemPage[]> AllocPageTable;
 typedef std::unique_ptr<PagePtr[]> PageTable;
+typedef std::unique_ptr<std::atomic<uint64_t>[]> PageBitmap;
+typedef std::unique_ptr<std::atomic<uint64_t>[]> PageStamps;
 typedef std::map<int, std::string> PageNameMap;
 
 struct ProtectBlockInfo {
@@ -57,6 +63,7 @@ struct ProtectSegmentInfo {
 };
 
 typedef std::map<Address, ProtectSegmentInfo, std::greater<Address>> ProtectSegmentTrees;
+typedef std::unique_ptr<std::atomic<ProtectSegmentTrees::value_type *>[]> PageSegmentTable;
 
 struct MemExternalMapping {
     Address address;
@@ -64,7 +71,7 @@ struct MemExternalMapping {
 };
 
 struct MemState {
-    std::mutex generation_mutex;
+    ProfiledMutex generation_mutex{ "MemState::generation_mutex" };
     std::mutex protect_mutex;
 
     uint32_t page_size = 0;
@@ -72,9 +79,27 @@ struct MemState {
     AllocPageTable alloc_table;
     BitmapAllocator allocator;
     ProtectSegmentTrees protect_tree;
+    // for each page, segment of protect_tree covering it or null, only written with protect_mutex held
+    PageSegmentTable page_segments;
+    // one bit per page, set while the page is write protected by track_writes and has not been written since
+    PageBitmap write_tracked_pages;
+    // for each page, value of write_stamp when a tracked write to it was last seen
+    PageStamps page_write_stamps;
+    // one bit per page, set when a free page may still hold the content of its last allocation
+    // the other free pages are zero and only backed by the host once touched, so alloc does not clear them
+    PageBitmap dirty_pages;
+    std::atomic<uint64_t> write_stamp = 1;
+    // access violations handled for the protect tree and for the pages tracked by track_writes
+    std::atomic<uint64_t> protect_fault_count = 0;
+    std::atomic<uint64_t> write_track_fault_count = 0;
 
     PageNameMap page_name_map;
 
+    // small blocks of the libc heap
+    SlabAllocator slab_allocator;
+
+    TransferWorkers transfer_workers;
+
     bool use_page_table = false;
     PageTable page_table;
     std::map<uint64_t, MemExternalMapping, std::greater<uint64_t>> external_mapping;
@@ -0,0 +1,61 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/util.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// below this size, a transfer is done by the calling thread alone
+constexpr uint32_t PARALLEL_TRANSFER_MIN_SIZE = MiB(1);
+constexpr uint32_t TRANSFER_CHUNK_SIZE = KiB(256);
+
+// Transfer shared by the calling thread and the transfer workers, each one runs the next chunk until none is left.
+struct TransferJob {
+    std::function<void(uint32_t offset, uint32_t size)> run_chunk;
+    uint32_t size = 0;
+    uint32_t chunk_count = 0;
+    std::atomic<uint32_t> next_chunk = 0;
+    std::atomic<uint32_t> done_chunks = 0;
+
+    std::mutex mutex;
+    // notified once all the chunks are done
+    std::condition_variable done;
+};
+
+struct TransferWorkers {
+    std::mutex mutex;
+    std::condition_variable cond;
+    // jobs which still have chunks left to start, the workers only remove them
+    std::deque<std::shared_ptr<TransferJob>> jobs;
+    // started by the first large transfer
+    std::vector<std::thread> threads;
+    bool exiting = false;
+
+    TransferWorkers() = default;
+    TransferWorkers(const TransferWorkers &) = delete;
+    TransferWorkers &operator=(const TransferWorkers &) = delete;
+    ~TransferWorkers();
+};
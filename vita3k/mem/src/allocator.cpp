@@ -17,6 +17,9 @@
 
 #include <mem/allocator.h>
 
+#include <algorithm>
+#include <bit>
+
 BitmapAllocator::BitmapAllocator(const std::size_t total_bits)
     : words((total_bits >> 5) + ((total_bits % 32 != 0) ? 1 : 0), 0xFFFFFFFF)
     , max_offset(total_bits) {
@@ -35,10 +38,13 @@ void BitmapAllocator::set_maximum(const std::size_t total_bits) {
     }
 
     max_offset = total_bits;
+    summary_valid = false;
 }
 
 void BitmapAllocator::reset() {
     words.clear();
+    summary.clear();
+    summary_valid = false;
 }
 
 int BitmapAllocator::force_fill(const std::uint32_t offset, const int size, const bool or_mode) {
@@ -94,6 +100,218 @@ void BitmapAllocator::free(const std::uint32_t offset, const int size) {
     }
 
     force_fill(offset, size, true);
+    update_summary(offset, size);
+}
+
+// Calls on_run(start, length) for each free run of [begin, end) until it returns true, the runs are cut at the limits of the range
+template <typename GetWord, typename OnRun>
+static bool for_each_free_run(const GetWord &get_word, const std::uint32_t begin, const std::uint32_t end, const OnRun &on_run) {
+    std::uint32_t run_start = 0;
+    std::uint32_t run_length = 0;
+    std::uint32_t bit = begin;
+
+    while (bit < end) {
+        const std::uint32_t bit_in_word = bit & 31;
+        const std::uint32_t available = std::min<std::uint32_t>(32 - bit_in_word, end - bit);
+        const std::uint32_t value = get_word(bit >> 5) << bit_in_word;
+
+        const std::uint32_t free_bits = std::min<std::uint32_t>(std::countl_one(value), available);
+        if (free_bits > 0) {
+            if (run_length == 0)
+                run_start = bit;
+            run_length += free_bits;
+            bit += free_bits;
+            continue;
+        }
+
+        if (run_length > 0) {
+            if (on_run(run_start, run_length))
+                return true;
+            run_length = 0;
+        }
+        bit += std::min<std::uint32_t>(std::countl_zero(value), available);
+    }
+
+    return run_length > 0 && on_run(run_start, run_length);
+}
+
+static BitmapAllocator::RunSummary combine(const BitmapAllocator::RunSummary &left, const BitmapAllocator::RunSummary &right) {
+    BitmapAllocator::RunSummary summary;
+    summary.length = left.length + right.length;
+    summary.prefix = left.prefix == left.length ? left.length + right.prefix : left.prefix;
+    summary.suffix = right.suffix == right.length ? right.length + left.suffix : right.suffix;
+    summary.longest = std::max({ left.longest, right.longest, left.suffix + right.prefix });
+    return summary;
+}
+
+// The slots past max_offset are seen as allocated
+std::uint32_t BitmapAllocator::get_word(const std::size_t index) const {
+    const std::size_t first_bit = index << 5;
+    if (index >= words.size() || first_bit >= max_offset)
+        return 0;
+
+    const std::size_t valid_bits = max_offset - first_bit;
+    return valid_bits >= 32 ? words[index] : words[index] & ~(0xFFFFFFFFU >> valid_bits);
+}
+
+std::uint32_t BitmapAllocator::total_bits() const {
+    return static_cast<std::uint32_t>(std::min<std::size_t>(max_offset, words.size() << 5));
+}
+
+BitmapAllocator::RunSummary BitmapAllocator::summarize_group(const std::size_t group) const {
+    const std::uint32_t begin = static_cast<std::uint32_t>(group * GROUP_BITS);
+    const std::uint32_t end = std::min(begin + GROUP_BITS, total_bits());
+
+    RunSummary summary;
+    summary.length = end - begin;
+    const auto get = [this](const std::size_t index) { return get_word(index); };
+    for_each_free_run(get, begin, end, [&](const std::uint32_t start, const std::uint32_t length) {
+        if (start == begin)
+            summary.prefix = length;
+        if (start + length == end)
+            summary.suffix = length;
+        summary.longest = std::max(summary.longest, length);
+        return false;
+    });
+
+    return summary;
+}
+
+void BitmapAllocator::build_summary() {
+    const std::size_t group_count = (total_bits() + GROUP_BITS - 1) / GROUP_BITS;
+    summary_leaves = std::bit_ceil(std::max<std::size_t>(group_count, 1));
+    summary.assign(summary_leaves * 2, RunSummary{});
+
+    for (std::size_t group = 0; group < group_count; group++)
+        summary[summary_leaves + group] = summarize_group(group);
+    for (std::size_t node = summary_leaves - 1; node > 0; node--)
+        summary[node] = combine(summary[node * 2], summary[node * 2 + 1]);
+
+    summary_valid = true;
+}
+
+void BitmapAllocator::update_summary(const std::uint32_t offset, const int size) {
+    if (!summary_valid || size <= 0)
+        return;
+
+    const std::size_t group_count = (total_bits() + GROUP_BITS - 1) / GROUP_BITS;
+    const std::size_t first_group = offset / GROUP_BITS;
+    if (first_group >= group_count)
+        return;
+    const std::size_t last_group = std::min<std::size_t>((static_cast<std::size_t>(offset) + size - 1) / GROUP_BITS, group_count - 1);
+
+    for (std::size_t group = first_group; group <= last_group; group++)
+        summary[summary_leaves + group] = summarize_group(group);
+
+    std::size_t first_node = (summary_leaves + first_group) >> 1;
+    std::size_t last_node = (summary_leaves + last_group) >> 1;
+    while (first_node > 0) {
+        for (std::size_t node = first_node; node <= last_node; node++)
+            summary[node] = combine(summary[node * 2], summary[node * 2 + 1]);
+        first_node >>= 1;
+        last_node >>= 1;
+    }
+}
+
+// Lowest offset of a free run of size slots in the groups of the node starting from first_group,
+// carry is the length of the free run ending right before the part of the node looked at
+int BitmapAllocator::find_first_fit(const std::size_t node, const std::size_t begin, const std::size_t end, const std::size_t first_group, std::uint32_t &carry, const std::uint32_t size) const {
+    if (end <= first_group)
+        return -1;
+
+    const RunSummary &node_summary = summary[node];
+    if (begin >= first_group) {
+        const std::uint32_t node_start = static_cast<std::uint32_t>(begin * GROUP_BITS);
+        if (carry + node_summary.prefix >= size)
+            return static_cast<int>(node_start - carry);
+
+        if (node_summary.longest < size) {
+            carry = node_summary.prefix == node_summary.length ? carry + node_summary.length : node_summary.suffix;
+            return -1;
+        }
+
+        if (end - begin == 1) {
+            // The run is inside this group
+            int found = -1;
+            const auto get = [this](const std::size_t index) { return get_word(index); };
+            for_each_free_run(get, node_start, node_start + node_summary.length, [&](const std::uint32_t start, const std::uint32_t length) {
+                if (length < size)
+                    return false;
+                found = static_cast<int>(start);
+                return true;
+            });
+            return found;
+        }
+    }
+
+    const std::size_t middle = (begin + end) / 2;
+    const int found = find_first_fit(node * 2, begin, middle, first_group, carry, size);
+    if (found >= 0)
+        return found;
+    return find_first_fit(node * 2 + 1, middle, end, first_group, carry, size);
+}
+
+int BitmapAllocator::find_first_fit(const std::uint32_t start_offset, const std::uint32_t size) const {
+    const std::uint32_t total = total_bits();
+    if (start_offset >= total)
+        return -1;
+
+    // The first group is only looked at from start_offset
+    const std::size_t first_group = start_offset / GROUP_BITS;
+    const std::uint32_t group_end = std::min(static_cast<std::uint32_t>((first_group + 1) * GROUP_BITS), total);
+    int found = -1;
+    std::uint32_t carry = 0;
+    const auto get = [this](const std::size_t index) { return get_word(index); };
+    for_each_free_run(get, start_offset, group_end, [&](const std::uint32_t start, const std::uint32_t length) {
+        if (length >= size) {
+            found = static_cast<int>(start);
+            return true;
+        }
+        if (start + length == group_end)
+            carry = length;
+        return false;
+    });
+    if (found >= 0)
+        return found;
+
+    return find_first_fit(1, 0, summary_leaves, first_group + 1, carry, size);
+}
+
+// Free slots at the start of the groups of the node starting from first_group, ended is set once an allocated slot is reached
+std::uint32_t BitmapAllocator::free_prefix(const std::size_t node, const std::size_t begin, const std::size_t end, const std::size_t first_group, bool &ended) const {
+    if (end <= first_group || ended)
+        return 0;
+
+    const RunSummary &node_summary = summary[node];
+    if (begin >= first_group) {
+        if (node_summary.prefix != node_summary.length)
+            ended = true;
+        return node_summary.prefix;
+    }
+
+    const std::size_t middle = (begin + end) / 2;
+    const std::uint32_t left = free_prefix(node * 2, begin, middle, first_group, ended);
+    return left + free_prefix(node * 2 + 1, middle, end, first_group, ended);
+}
+
+// Length of the free run starting at offset
+std::uint32_t BitmapAllocator::free_run_length(const std::uint32_t offset) const {
+    const std::size_t group = offset / GROUP_BITS;
+    const std::uint32_t group_end = std::min(static_cast<std::uint32_t>((group + 1) * GROUP_BITS), total_bits());
+
+    std::uint32_t length = 0;
+    const auto get = [this](const std::size_t index) { return get_word(index); };
+    for_each_free_run(get, offset, group_end, [&](const std::uint32_t start, const std::uint32_t run_length) {
+        if (start == offset)
+            length = run_length;
+        return true;
+    });
+
+    if (offset + length == group_end) {
+        bool ended = false;
+        length += free_prefix(1, 0, summary_leaves, group + 1, ended);
+    }
+    return length;
 }
 
 int BitmapAllocator::allocate_from(const std::uint32_t start_offset, int &size, const bool best_fit) {
@@ -101,79 +319,38 @@ int BitmapAllocator::allocate_from(const std::uint32_t start_offset, int &size,
         return -1;
     }
 
-    std::uint32_t *word = &words[0] + (start_offset >> 5);
-
-    // We have arrived at le word that still have free position (bit 1)
-    std::uint32_t *word_end = &words[words.size() - 1];
-
-    int bflmin = 0xFFFFFF;
-    int bofmin = -1;
-    std::uint32_t *wordmin = nullptr;
-
-    // Keep finding
-    while (word <= word_end) {
-        std::uint32_t wv = *word;
-
-        if (wv != 0) {
-            // Still have free stuff
-            int bflen = 0;
-            int boff = 0;
-            std::uint32_t *bword = nullptr;
-
-            int cursor = 31;
-
-            while (cursor >= 0) {
-                if (((wv >> cursor) & 1) == 1) {
-                    boff = cursor;
-                    bflen = 0;
-                    bword = word;
-
-                    while (cursor >= 0 && (((wv >> cursor) & 1) == 1)) {
-                        bflen++;
-                        cursor--;
-
-                        if (cursor < 0 && (word + 1 <= word_end)) {
-                            cursor = 31;
-                            word++;
-                            wv = *word;
-                        }
-                    }
-
-                    if (bflen >= size) {
-                        if (!best_fit) {
-                            // Force allocate and then return
-                            const int offset = static_cast<int>(31 - boff + ((bword - &words[0]) << 5));
-                            if ((static_cast<std::size_t>(offset) + size) <= max_offset) {
-                                size = force_fill(static_cast<const std::uint32_t>(offset), size, false);
-                                return offset;
-                            }
-                        } else {
-                            if (bflen < bflmin) {
-                                bflmin = bflen;
-                                bofmin = boff;
-                                wordmin = bword;
-                            }
-                        }
-                    }
-                }
-
-                cursor--;
+    if (!summary_valid)
+        build_summary();
+
+    const std::uint32_t needed = static_cast<std::uint32_t>(std::max(size, 1));
+    int offset = find_first_fit(start_offset, needed);
+
+    if (best_fit && offset >= 0) {
+        // Go through the free runs large enough, the smallest one is used
+        std::uint32_t best_length = free_run_length(offset);
+        std::uint32_t next_offset = offset + best_length;
+        while (best_length != needed) {
+            const int found = find_first_fit(next_offset, needed);
+            if (found < 0)
+                break;
+
+            const std::uint32_t length = free_run_length(found);
+            if (length < best_length) {
+                offset = found;
+                best_length = length;
             }
+            next_offset = found + length;
         }
-
-        word++;
     }
 
-    if (best_fit && bofmin != -1) {
-        // Force allocate and then return
-        const int offset = static_cast<int>(31 - bofmin + ((wordmin - &words[0]) << 5));
-        if ((static_cast<std::size_t>(offset) + size) <= max_offset) {
-            size = force_fill(static_cast<std::uint32_t>(offset), size, false);
-            return offset;
-        }
+    if (offset < 0) {
+        return -1;
     }
 
-    return -1;
+    const int requested_size = size;
+    size = force_fill(static_cast<std::uint32_t>(offset), size, false);
+    update_summary(offset, requested_size);
+    return offset;
 }
 
 int BitmapAllocator::allocate_at(const std::uint32_t start_offset, int size) {
@@ -182,6 +359,7 @@ int BitmapAllocator::allocate_at(const std::uint32_t start_offset, int size) {
     }
 
     force_fill(start_offset, size, false);
+    update_summary(start_offset, size);
     return 0;
 }
 
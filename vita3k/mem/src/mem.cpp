@@ -21,6 +21,7 @@
 #include <util/align.h>
 #include <util/float_to_half.h>
 #include <util/log.h>
+#include <util/memory_accounting.h>
 
 #include <algorithm>
 #include <cassert>
@@ -47,6 +48,8 @@ static void register_access_violation_handler(AccessViolationHandler handler);
 
 static Address alloc_inner(MemState &state, uint32_t start_page, int page_count, const char *name, const bool force);
 static void delete_memory(uint8_t *memory);
+static void clear_tracked_pages(MemState &state, Address addr, uint32_t size);
+static void clear_dirty_pages(MemState &state, uint32_t start_page, uint32_t page_count);
 
 #ifdef WIN32
 static std::string get_error_msg() {
@@ -58,15 +61,19 @@ static std::string get_error_msg() {
 }
 #endif
 
-bool init(MemState &state, const bool use_page_table) {
+uint32_t get_host_page_size() {
 #ifdef WIN32
     SYSTEM_INFO system_info = {};
     GetSystemInfo(&system_info);
-    state.page_size = system_info.dwPageSize;
+    const uint32_t page_size = system_info.dwPageSize;
 #else
-    state.page_size = static_cast<int>(sysconf(_SC_PAGESIZE));
+    const uint32_t page_size = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
 #endif
-    state.page_size = std::max(STANDARD_PAGE_SIZE, state.page_size);
+    return std::max(STANDARD_PAGE_SIZE, page_size);
+}
+
+bool init(MemState &state, const bool use_page_table, const bool use_huge_pages) {
+    state.page_size = get_host_page_size();
 
     assert(state.page_size >= 4096); // Limit imposed by Unicorn.
     assert(!use_page_table || state.page_size == KiB(4));
@@ -98,12 +105,38 @@ bool init(MemState &state, const bool use_page_table) {
     }
 #endif
 
+    if (use_huge_pages) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        // the pages are only backed once committed by alloc_inner, and a huge page is split by the kernel
+        // when a part of it gets another protection, so protect_inner and track_writes keep working on 4K pages
+        const int ret = madvise(state.memory.get(), TOTAL_MEM_SIZE, MADV_HUGEPAGE);
+        LOG_WARN_IF(ret == -1, "madvise failed, huge pages are not used: {}", get_error_msg());
+#else
+        // the large pages of Windows and the superpages of macOS can't be protected by parts
+        LOG_WARN("Huge pages are not supported on this platform");
+#endif
+    }
+
     const size_t table_length = TOTAL_MEM_SIZE / state.page_size;
     state.alloc_table = AllocPageTable(new AllocMemPage[table_length]);
     memset(state.alloc_table.get(), 0, sizeof(AllocMemPage) * table_length);
 
     state.allocator.set_maximum(table_length);
 
+    const size_t tracked_words = table_length / 64;
+    state.write_tracked_pages = PageBitmap(new std::atomic<uint64_t>[tracked_words]);
+    for (size_t i = 0; i < tracked_words; i++)
+        state.write_tracked_pages[i] = 0;
+    state.dirty_pages = PageBitmap(new std::atomic<uint64_t>[tracked_words]);
+    for (size_t i = 0; i < tracked_words; i++)
+        state.dirty_pages[i] = 0;
+    state.page_write_stamps = PageStamps(new std::atomic<uint64_t>[table_length]);
+    for (size_t i = 0; i < table_length; i++)
+        state.page_write_stamps[i] = 0;
+    state.page_segments = PageSegmentTable(new std::atomic<ProtectSegmentTrees::value_type *>[table_length]);
+    for (size_t i = 0; i < table_length; i++)
+        state.page_segments[i] = nullptr;
+
     const auto handler = [&state](uint8_t *addr, bool write) noexcept {
         return handle_access_violation(state, addr, write);
     };
@@ -177,7 +210,9 @@ static Address alloc_inner(MemState &state, uint32_t start_page, int page_count,
     const int ret = mprotect(memory, size, PROT_READ | PROT_WRITE);
     LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
 #endif
-    std::memset(memory, 0, size);
+    clear_tracked_pages(state, addr, size);
+    clear_dirty_pages(state, page_num, page_count);
+    add_memory_usage(MemoryCategory::GuestPages, size);
 
     AllocMemPage &page = state.alloc_table[page_num];
     assert(!page.allocated);
@@ -194,7 +229,7 @@ static Address alloc_inner(MemState &state, uint32_t start_page, int page_count,
 Address alloc(MemState &state, uint32_t size, const char *name, unsigned int alignment) {
     if (alignment == 0)
         return alloc(state, size, name);
-    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    const ProfiledLockGuard lock(state.generation_mutex);
     size += alignment;
     const uint32_t page_count = align(size, state.page_size) / state.page_size;
     const Address addr = alloc_inner(state, 0, page_count, name, false);
@@ -207,6 +242,8 @@ Address alloc(MemState &state, uint32_t size, const char *name, unsigned int ali
         AllocMemPage &align_page = state.alloc_table[align_page_num];
         const uint32_t remnant_front = align_page_num - page_num;
         state.allocator.free(page_num, remnant_front);
+        // the pages in front can be allocated again, they are counted by that allocation
+        remove_memory_usage(MemoryCategory::GuestPages, remnant_front * state.page_size);
         page.allocated = 0;
         align_page.allocated = 1;
         align_page.size = page.size - remnant_front;
@@ -215,39 +252,92 @@ Address alloc(MemState &state, uint32_t size, const char *name, unsigned int ali
     return align_addr;
 }
 
+// the caller must hold generation_mutex
+static void clear_dirty_pages(MemState &state, uint32_t start_page, uint32_t page_count) {
+    const uint32_t end_page = start_page + page_count;
+    uint32_t page = start_page;
+    while (page < end_page) {
+        std::atomic<uint64_t> &word = state.dirty_pages[page / 64];
+        if ((word.load(std::memory_order_relaxed) & (1ULL << (page % 64))) == 0) {
+            // the rest of the word is skipped at once when it holds no dirty page
+            page = (word.load(std::memory_order_relaxed) >> (page % 64)) == 0 ? align(page + 1, 64) : page + 1;
+            continue;
+        }
+
+        const uint32_t run_start = page;
+        while (page < end_page && (state.dirty_pages[page / 64].load(std::memory_order_relaxed) & (1ULL << (page % 64))) != 0) {
+            state.dirty_pages[page / 64].fetch_and(~(1ULL << (page % 64)), std::memory_order_relaxed);
+            page++;
+        }
+        std::memset(&state.memory[static_cast<size_t>(run_start) * state.page_size], 0, static_cast<size_t>(page - run_start) * state.page_size);
+    }
+}
+
 static void align_to_page(MemState &state, Address &addr, Address &size) {
     const Address end = align(addr + size, state.page_size);
     addr = align_down(addr, state.page_size);
     size = end - addr;
 }
 
-void unprotect_inner(MemState &state, Address addr, uint32_t size) {
-    if (LOG_PROTECT) {
-        fmt::print("Unprotect: {} {}\n", log_hex(addr), size);
-    }
+// change the protection of the host pages without touching the write tracking state
+static void set_host_protection(MemState &state, Address addr, uint32_t size, const MemPerm perm) {
     uint8_t *addr_ptr = state.use_page_table ? state.page_table[addr / KiB(4)] : state.memory.get();
 
 #ifdef WIN32
     DWORD old_protect = 0;
-    const BOOL ret = VirtualProtect(&addr_ptr[addr], size - 1, PAGE_READWRITE, &old_protect);
+    const BOOL ret = VirtualProtect(&addr_ptr[addr], size - 1, (perm == MemPerm::None) ? PAGE_NOACCESS : ((perm == MemPerm::ReadOnly) ? PAGE_READONLY : PAGE_READWRITE), &old_protect);
     LOG_CRITICAL_IF(!ret, "VirtualAlloc failed: {}", get_error_msg());
 #else
-    const int ret = mprotect(&addr_ptr[addr], size, PROT_READ | PROT_WRITE);
+    const int ret = mprotect(&addr_ptr[addr], size, (perm == MemPerm::None) ? PROT_NONE : ((perm == MemPerm::ReadOnly) ? PROT_READ : (PROT_READ | PROT_WRITE)));
     LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
 #endif
 }
 
-void protect_inner(MemState &state, Address addr, uint32_t size, const MemPerm perm) {
-    uint8_t *addr_ptr = state.use_page_table ? state.page_table[addr / KiB(4)] : state.memory.get();
+static bool is_page_tracked(const MemState &state, uint32_t page) {
+    return state.write_tracked_pages[page / 64].load(std::memory_order_acquire) & (1ULL << (page % 64));
+}
 
-#ifdef WIN32
-    DWORD old_protect = 0;
-    const BOOL ret = VirtualProtect(&addr_ptr[addr], size - 1, (perm == MemPerm::None) ? PAGE_NOACCESS : ((perm == MemPerm::ReadOnly) ? PAGE_READONLY : PAGE_READWRITE), &old_protect);
-    LOG_CRITICAL_IF(!ret, "VirtualAlloc failed: {}", get_error_msg());
-#else
-    const int ret = mprotect(&addr_ptr[addr], size, (perm == MemPerm::None) ? PROT_NONE : ((perm == MemPerm::ReadOnly) ? PROT_READ : (PROT_READ | PROT_WRITE)));
-    LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
-#endif
+// stop tracking the page, every stamp given by track_writes until now is now older than the page
+static void set_page_written(MemState &state, uint32_t page) {
+    state.write_tracked_pages[page / 64].fetch_and(~(1ULL << (page % 64)), std::memory_order_release);
+    state.page_write_stamps[page].store(state.write_stamp.fetch_add(1) + 1, std::memory_order_release);
+}
+
+// the protection of these pages is about to be changed by something else, consider them as written
+static void clear_tracked_pages(MemState &state, Address addr, uint32_t size) {
+    if (size == 0)
+        return;
+
+    const uint32_t first_page = addr / state.page_size;
+    const uint32_t last_page = (addr + size - 1) / state.page_size;
+    for (uint32_t page = first_page; page <= last_page; page++) {
+        if (is_page_tracked(state, page))
+            set_page_written(state, page);
+    }
+}
+
+// keep the segment table in sync with the protect tree, must be called with protect_mutex held
+static void set_segment_pages(MemState &state, Address addr, uint32_t size, ProtectSegmentTrees::value_type *segment) {
+    if (size == 0)
+        return;
+
+    const uint64_t first_page = addr / state.page_size;
+    const uint64_t end_page = (static_cast<uint64_t>(addr) + size + state.page_size - 1) / state.page_size;
+    for (uint64_t page = first_page; page < end_page; page++)
+        state.page_segments[page].store(segment, std::memory_order_release);
+}
+
+void unprotect_inner(MemState &state, Address addr, uint32_t size) {
+    if (LOG_PROTECT) {
+        fmt::print("Unprotect: {} {}\n", log_hex(addr), size);
+    }
+    clear_tracked_pages(state, addr, size);
+    set_host_protection(state, addr, size, MemPerm::ReadWrite);
+}
+
+void protect_inner(MemState &state, Address addr, uint32_t size, const MemPerm perm) {
+    clear_tracked_pages(state, addr, size);
+    set_host_protection(state, addr, size, perm);
 }
 
 bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcept {
@@ -255,20 +345,17 @@ bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcep
     const uintptr_t fault_addr = reinterpret_cast<uintptr_t>(addr);
 
     Address vaddr = 0;
-    const std::unique_lock<std::mutex> lock(state.protect_mutex);
     if (fault_addr < memory_addr || fault_addr >= memory_addr + TOTAL_MEM_SIZE) {
-        if (state.use_page_table) {
-            // this may come from an external mapping
-            uint64_t addr_val = std::bit_cast<uint64_t>(addr);
-            auto it = state.external_mapping.lower_bound(addr_val);
-            if (it != state.external_mapping.end() && addr_val < it->first + it->second.size) {
-                vaddr = static_cast<Address>(addr_val - it->first + it->second.address);
-            } else {
-                return false;
-            }
-        } else {
+        if (!state.use_page_table)
             return false;
-        }
+
+        // this may come from an external mapping
+        const std::lock_guard<std::mutex> lock(state.protect_mutex);
+        uint64_t addr_val = std::bit_cast<uint64_t>(addr);
+        auto it = state.external_mapping.lower_bound(addr_val);
+        if (it == state.external_mapping.end() || addr_val >= it->first + it->second.size)
+            return false;
+        vaddr = static_cast<Address>(addr_val - it->first + it->second.address);
     } else {
         vaddr = static_cast<Address>(fault_addr - memory_addr);
     }
@@ -280,23 +367,29 @@ bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcep
         fmt::print("Access: {}\n", log_hex(vaddr));
     }
 
-    auto it = state.protect_tree.lower_bound(vaddr);
-    if (it == state.protect_tree.end()) {
-        // HACK: keep going
-        unprotect_inner(state, vaddr, 4);
-        LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
+    const uint32_t page = vaddr / state.page_size;
+    const std::unique_lock<std::mutex> lock(state.protect_mutex);
+
+    // pages tracked by track_writes are never part of the protect tree
+    if (is_page_tracked(state, page)) {
+        state.write_track_fault_count.fetch_add(1, std::memory_order_relaxed);
+        set_page_written(state, page);
+        set_host_protection(state, page * state.page_size, state.page_size, MemPerm::ReadWrite);
         return true;
     }
 
-    ProtectSegmentInfo &info = it->second;
-    if (vaddr < it->first || vaddr >= it->first + info.size) {
+    // the segment table gives the segment without searching the tree
+    ProtectSegmentTrees::value_type *segment = state.page_segments[page].load(std::memory_order_relaxed);
+    if (!segment) {
         // HACK: keep going
         unprotect_inner(state, vaddr, 4);
         LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
         return true;
     }
+    state.protect_fault_count.fetch_add(1, std::memory_order_relaxed);
 
-    Address previous_beg = it->first;
+    const Address previous_beg = segment->first;
+    ProtectSegmentInfo &info = segment->second;
     for (auto ite = info.blocks.begin(); ite != info.blocks.end();) {
         if (vaddr >= ite->first && vaddr < ite->first + ite->second.size && ite->second.callback(vaddr, write)) {
             Address beg_unpr = align_down(ite->first, state.page_size);
@@ -309,9 +402,10 @@ bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcep
         }
     }
 
+    set_segment_pages(state, previous_beg, info.size, nullptr);
     if (info.blocks.size() == 0 && info.ref_count == 0) {
-        unprotect_inner(state, it->first, info.size);
-        state.protect_tree.erase(it);
+        unprotect_inner(state, previous_beg, info.size);
+        state.protect_tree.erase(previous_beg);
     } else {
         Address beg_region = info.blocks.begin()->first;
         Address end_region = info.blocks.rbegin()->first + info.blocks.rbegin()->second.size;
@@ -323,11 +417,12 @@ bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcep
             ProtectSegmentInfo new_info = std::move(info);
             new_info.size = end_region - beg_region;
 
-            state.protect_tree.erase(it);
-            state.protect_tree.emplace(beg_region, std::move(new_info));
+            state.protect_tree.erase(previous_beg);
+            segment = &*state.protect_tree.emplace(beg_region, std::move(new_info)).first;
         } else {
             info.size = end_region - beg_region;
         }
+        set_segment_pages(state, segment->first, segment->second.size, segment);
     }
 
     return true;
@@ -372,11 +467,17 @@ bool add_protect(MemState &state, Address addr, const uint32_t size, const MemPe
         protect_inner(state, addr, protect.size, perm);
     }
 
-    state.protect_tree.emplace(addr, std::move(protect));
+    // the merged segments were all inside the new one
+    ProtectSegmentTrees::value_type &segment = *state.protect_tree.emplace(addr, std::move(protect)).first;
+    set_segment_pages(state, segment.first, segment.second.size, &segment);
     return true;
 }
 
 bool is_protecting(MemState &state, Address addr, MemPerm *perm) {
+    // the segments are page aligned, the table is enough when the permission is not needed
+    if (!perm)
+        return state.page_segments[addr / state.page_size].load(std::memory_order_acquire) != nullptr;
+
     const std::lock_guard<std::mutex> lock(state.protect_mutex);
     auto ite = state.protect_tree.lower_bound(addr);
 
@@ -390,6 +491,82 @@ bool is_protecting(MemState &state, Address addr, MemPerm *perm) {
     return false;
 }
 
+uint64_t track_writes(MemState &state, Address addr, uint32_t size) {
+    if (size == 0)
+        return state.write_stamp.load();
+
+    const std::lock_guard<std::mutex> lock(state.protect_mutex);
+    align_to_page(state, addr, size);
+    if (!is_valid_addr_range(state, addr, addr + size))
+        return 0;
+
+    // do not interfere with the protections done by add_protect
+    auto it = state.protect_tree.lower_bound(addr + size - 1);
+    if (it != state.protect_tree.end() && it->first + it->second.size > addr)
+        return 0;
+
+    // write protect the runs of pages which are not already tracked
+    const uint32_t first_page = addr / state.page_size;
+    const uint32_t end_page = (addr + size) / state.page_size;
+    uint32_t run_start = end_page;
+    const auto protect_run = [&](uint32_t run_end) {
+        if (run_start != end_page)
+            set_host_protection(state, run_start * state.page_size, (run_end - run_start) * state.page_size, MemPerm::ReadOnly);
+        run_start = end_page;
+    };
+
+    for (uint32_t page = first_page; page < end_page; page++) {
+        if (is_page_tracked(state, page)) {
+            protect_run(page);
+            continue;
+        }
+
+        // with a page table, a run must not cross a change of host base pointer (external mappings)
+        if (state.use_page_table && run_start != end_page && state.page_table[page * state.page_size / KiB(4)] != state.page_table[run_start * state.page_size / KiB(4)])
+            protect_run(page);
+
+        state.write_tracked_pages[page / 64].fetch_or(1ULL << (page % 64), std::memory_order_release);
+        if (run_start == end_page)
+            run_start = page;
+    }
+    protect_run(end_page);
+
+    // all the pages are now tracked, a write happening after this point gets a bigger stamp
+    return state.write_stamp.load();
+}
+
+bool is_range_written(const MemState &state, Address addr, uint32_t size, uint64_t stamp) {
+    if (stamp == 0)
+        return true;
+    if (size == 0)
+        return false;
+
+    const uint32_t first_page = addr / state.page_size;
+    const uint32_t last_page = (addr + size - 1) / state.page_size;
+    for (uint32_t page = first_page; page <= last_page; page++) {
+        if (state.page_write_stamps[page].load(std::memory_order_acquire) > stamp)
+            return true;
+    }
+
+    return false;
+}
+
+void mark_range_written(MemState &state, Address addr, uint32_t size) {
+    if (size == 0)
+        return;
+
+    const std::lock_guard<std::mutex> lock(state.protect_mutex);
+    const uint32_t first_page = addr / state.page_size;
+    const uint32_t last_page = (addr + size - 1) / state.page_size;
+    for (uint32_t page = first_page; page <= last_page; page++) {
+        if (!is_page_tracked(state, page))
+            continue;
+
+        set_page_written(state, page);
+        set_host_protection(state, page * state.page_size, state.page_size, MemPerm::ReadWrite);
+    }
+}
+
 void open_access_parent_protect_segment(MemState &state, Address addr) {
     const std::lock_guard<std::mutex> lock(state.protect_mutex);
     auto ite = state.protect_tree.lower_bound(addr);
@@ -416,6 +593,7 @@ void close_access_parent_protect_segment(MemState &state, Address addr) {
 
         if (info.ref_count == 0) {
             if (info.blocks.size() == 0 || info.size == 0) {
+                set_segment_pages(state, ite->first, info.size, nullptr);
                 state.protect_tree.erase(ite);
             } else {
                 protect_inner(state, ite->first, info.size, info.perm);
@@ -470,6 +648,7 @@ void remove_external_mapping(MemState &mem, uint8_t *addr_ptr) {
         }
 
         while (prot_it != mem.protect_tree.end() && prot_it->first < mapping.address + mapping.size) {
+            set_segment_pages(mem, prot_it->first, prot_it->second.size, nullptr);
             if (prot_it == mem.protect_tree.begin()) {
                 mem.protect_tree.erase(prot_it);
                 break;
@@ -491,14 +670,14 @@ void remove_external_mapping(MemState &mem, uint8_t *addr_ptr) {
 }
 
 Address alloc(MemState &state, uint32_t size, const char *name) {
-    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    const ProfiledLockGuard lock(state.generation_mutex);
     const uint32_t page_count = align(size, state.page_size) / state.page_size;
     const Address addr = alloc_inner(state, 0, page_count, name, false);
     return addr;
 }
 
 Address alloc_at(MemState &state, Address address, uint32_t size, const char *name) {
-    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    const ProfiledLockGuard lock(state.generation_mutex);
     const uint32_t wanted_page = address / state.page_size;
     size += address % state.page_size;
     const uint32_t page_count = align(size, state.page_size) / state.page_size;
@@ -525,7 +704,7 @@ Block alloc_block(MemState &mem, uint32_t size, const char *name) {
 }
 
 void free(MemState &state, Address address) {
-    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    const ProfiledLockGuard lock(state.generation_mutex);
     const uint32_t page_num = address / state.page_size;
     assert(page_num >= 0);
 
@@ -536,12 +715,14 @@ void free(MemState &state, Address address) {
     page.allocated = 0;
 
     state.allocator.free(page_num, page.size);
+    remove_memory_usage(MemoryCategory::GuestPages, static_cast<uint64_t>(page.size) * state.page_size);
     if (PAGE_NAME_TRACKING) {
         state.page_name_map.erase(page_num);
     }
 
     assert(!state.use_page_table || state.page_table[address / KiB(4)] == state.memory.get());
     uint8_t *const memory = &state.memory[page_num * state.page_size];
+    clear_tracked_pages(state, page_num * state.page_size, page.size * state.page_size);
 
 #ifdef WIN32
     const BOOL ret = VirtualFree(memory, page.size * state.page_size, MEM_DECOMMIT);
@@ -551,6 +732,11 @@ void free(MemState &state, Address address) {
     LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
     ret = madvise(memory, page.size * state.page_size, MADV_DONTNEED);
     LOG_CRITICAL_IF(ret == -1, "madvise failed: {}", get_error_msg());
+#ifndef __linux__
+    // only Linux gives back zero pages after MADV_DONTNEED, elsewhere the content can be kept
+    for (uint32_t i = page_num; i < page_num + page.size; i++)
+        state.dirty_pages[i / 64].fetch_or(1ULL << (i % 64), std::memory_order_relaxed);
+#endif
 #endif
 }
 
@@ -558,6 +744,14 @@ uint32_t mem_available(MemState &state) {
     return state.allocator.free_slot_count(0, state.allocator.max_offset) * state.page_size;
 }
 
+uint32_t get_alloc_size(const MemState &state, Address address) {
+    if (address % state.page_size != 0)
+        return 0;
+
+    const AllocMemPage &page = state.alloc_table[address / state.page_size];
+    return page.allocated ? page.size * state.page_size : 0;
+}
+
 const char *mem_name(Address address, MemState &state) {
     if (PAGE_NAME_TRACKING) {
         return state.page_name_map.find(address / state.page_size)->second.c_str();
@@ -0,0 +1,186 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <mem/slab.h>
+
+#include <mem/functions.h>
+#include <mem/ptr.h>
+#include <mem/state.h>
+
+#include <util/align.h>
+#include <util/log.h>
+
+#include <algorithm>
+
+// pages taken at once, so that the slabs of a heap are not spread in the memory and alloc is seldom called
+static constexpr uint32_t SLAB_BATCH_SIZE = KiB(64);
+static constexpr uint32_t SLAB_MAGIC = 0x42414C53; // SLAB
+
+struct SlabHeader {
+    uint32_t magic;
+    uint32_t class_index;
+    uint32_t reserved[2];
+};
+
+static_assert(sizeof(SlabHeader) == SLAB_BLOCK_ALIGNMENT);
+
+static size_t get_class_index(uint32_t size) {
+    return std::lower_bound(SLAB_BLOCK_SIZES.begin(), SLAB_BLOCK_SIZES.end(), size) - SLAB_BLOCK_SIZES.begin();
+}
+
+// the caller must hold the mutex of the allocator
+static bool add_slab(MemState &mem, size_t class_index, const char *name) {
+    SlabAllocator &allocator = mem.slab_allocator;
+    if (allocator.next_page == allocator.end_page) {
+        const Address batch = alloc(mem, SLAB_BATCH_SIZE, name);
+        if (!batch)
+            return false;
+        allocator.next_page = batch;
+        allocator.end_page = batch + align(SLAB_BATCH_SIZE, mem.page_size);
+    }
+
+    const Address page = allocator.next_page;
+    allocator.next_page += mem.page_size;
+
+    SlabHeader *header = Ptr<SlabHeader>(page).get(mem);
+    header->magic = SLAB_MAGIC;
+    header->class_index = static_cast<uint32_t>(class_index);
+
+    // the blocks at the end of the page are given first
+    const uint32_t block_size = SLAB_BLOCK_SIZES[class_index];
+    auto &free_blocks = allocator.free_blocks[class_index];
+    for (Address block = page + sizeof(SlabHeader); block + block_size <= page + mem.page_size; block += block_size)
+        free_blocks.push_back(block);
+
+    return true;
+}
+
+static void check_generation(MemState &mem, SlabCache &cache) {
+    const uint32_t generation = mem.slab_allocator.generation.load(std::memory_order_acquire);
+    if (cache.mem == &mem && cache.generation == generation)
+        return;
+
+    for (auto &blocks : cache.blocks)
+        blocks.clear();
+    cache.mem = &mem;
+    cache.generation = generation;
+}
+
+// the caller must hold the mutex of the allocator
+static void flush_blocks(SlabAllocator &allocator, SlabCache &cache, size_t class_index, size_t count) {
+    auto &blocks = cache.blocks[class_index];
+    auto &free_blocks = allocator.free_blocks[class_index];
+    free_blocks.insert(free_blocks.end(), blocks.end() - count, blocks.end());
+    blocks.resize(blocks.size() - count);
+}
+
+SlabCache::~SlabCache() {
+    if (!mem)
+        return;
+
+    SlabAllocator &allocator = mem->slab_allocator;
+    const std::lock_guard<std::mutex> lock(allocator.mutex);
+    if (generation != allocator.generation.load(std::memory_order_relaxed))
+        return;
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; i++)
+        flush_blocks(allocator, *this, i, blocks[i].size());
+}
+
+Address slab_alloc(MemState &mem, SlabCache &cache, uint32_t size, const char *name) {
+    if (size > SLAB_MAX_BLOCK_SIZE)
+        return alloc(mem, size, name);
+
+    check_generation(mem, cache);
+    const size_t class_index = get_class_index(std::max(size, 1U));
+    auto &blocks = cache.blocks[class_index];
+    if (blocks.empty()) {
+        // take half of a full cache at once, so that the lock is seldom taken by a thread doing many allocations
+        SlabAllocator &allocator = mem.slab_allocator;
+        const std::lock_guard<std::mutex> lock(allocator.mutex);
+        auto &free_blocks = allocator.free_blocks[class_index];
+        if (free_blocks.empty() && !add_slab(mem, class_index, name))
+            return 0;
+
+        const size_t count = std::min(free_blocks.size(), SlabCache::MAX_BLOCKS / 2);
+        blocks.insert(blocks.end(), free_blocks.end() - count, free_blocks.end());
+        free_blocks.resize(free_blocks.size() - count);
+    }
+
+    const Address block = blocks.back();
+    blocks.pop_back();
+    return block;
+}
+
+static const SlabHeader *get_slab_header(MemState &mem, Address address) {
+    // a stale or garbage pointer may be in a page which is not allocated, its header cannot be read
+    const Address page = align_down(address, mem.page_size);
+    if (!is_valid_addr(mem, page)) {
+        LOG_ERROR("Address {} is in an unallocated page", log_hex(address));
+        return nullptr;
+    }
+
+    const SlabHeader *header = Ptr<SlabHeader>(page).get(mem);
+    if (header->magic != SLAB_MAGIC || header->class_index >= SLAB_CLASS_COUNT) {
+        LOG_ERROR("Address {} was not given by the slab allocator", log_hex(address));
+        return nullptr;
+    }
+    return header;
+}
+
+void slab_free(MemState &mem, SlabCache &cache, Address address) {
+    if (!address)
+        return;
+
+    if (address % mem.page_size == 0) {
+        free(mem, address);
+        return;
+    }
+
+    const SlabHeader *header = get_slab_header(mem, address);
+    if (!header)
+        return;
+
+    check_generation(mem, cache);
+    auto &blocks = cache.blocks[header->class_index];
+    blocks.push_back(address);
+    if (blocks.size() > SlabCache::MAX_BLOCKS) {
+        SlabAllocator &allocator = mem.slab_allocator;
+        const std::lock_guard<std::mutex> lock(allocator.mutex);
+        flush_blocks(allocator, cache, header->class_index, SlabCache::MAX_BLOCKS / 2);
+    }
+}
+
+uint32_t slab_usable_size(MemState &mem, Address address) {
+    if (!address)
+        return 0;
+
+    if (address % mem.page_size == 0)
+        return get_alloc_size(mem, address);
+
+    const SlabHeader *header = get_slab_header(mem, address);
+    return header ? SLAB_BLOCK_SIZES[header->class_index] : 0;
+}
+
+void reset_slab_allocator(SlabAllocator &allocator) {
+    const std::lock_guard<std::mutex> lock(allocator.mutex);
+    for (auto &free_blocks : allocator.free_blocks)
+        free_blocks.clear();
+    allocator.next_page = 0;
+    allocator.end_page = 0;
+    allocator.generation.fetch_add(1, std::memory_order_release);
+}
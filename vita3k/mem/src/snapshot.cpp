@@ -0,0 +1,231 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <mem/functions.h>
+#include <mem/state.h>
+
+#include <util/log.h>
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x534D454D; // MEMS
+constexpr uint32_t SNAPSHOT_CHUNK_SIZE = MiB(1);
+// chunks compressed at once before being written, per compression thread
+constexpr uint32_t SNAPSHOT_CHUNKS_PER_THREAD = 4;
+
+struct SnapshotAllocation {
+    uint32_t page;
+    uint32_t page_count;
+
+    bool operator==(const SnapshotAllocation &other) const = default;
+};
+
+struct SnapshotChunk {
+    Address address;
+    uint32_t size;
+    // empty if the chunk only holds zeroes
+    std::vector<uint8_t> data;
+};
+
+template <typename T>
+static void write_value(std::ostream &stream, const T &value) {
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_value(std::istream &stream, T &value) {
+    return static_cast<bool>(stream.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+static std::vector<SnapshotAllocation> get_allocations(const MemState &state) {
+    std::vector<SnapshotAllocation> allocations;
+    const uint32_t page_count = static_cast<uint32_t>(state.allocator.max_offset);
+    // the null page is allocated by init and never accessible
+    for (uint32_t page = 1; page < page_count;) {
+        const AllocMemPage &alloc_page = state.alloc_table[page];
+        if (alloc_page.allocated && alloc_page.size > 0) {
+            allocations.push_back({ page, alloc_page.size });
+            page += alloc_page.size;
+        } else {
+            page++;
+        }
+    }
+    return allocations;
+}
+
+// run the job for each index by up to hardware_concurrency threads, the calling thread included
+static void run_parallel(size_t count, const std::function<void(size_t index)> &job) {
+    const size_t thread_count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), count);
+    std::atomic<size_t> next_index = 0;
+    const auto run_jobs = [&]() {
+        size_t index;
+        while ((index = next_index.fetch_add(1, std::memory_order_relaxed)) < count)
+            job(index);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++)
+        threads.emplace_back(run_jobs);
+    run_jobs();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+static void compress_chunk(const MemState &state, SnapshotChunk &chunk) {
+    const uint8_t *const memory = &state.memory[chunk.address];
+    if (std::all_of(memory, memory + chunk.size, [](uint8_t value) { return value == 0; })) {
+        chunk.data.clear();
+        return;
+    }
+
+    mz_ulong compressed_size = mz_compressBound(chunk.size);
+    chunk.data.resize(compressed_size);
+    mz_compress2(chunk.data.data(), &compressed_size, memory, chunk.size, MZ_BEST_SPEED);
+    chunk.data.resize(compressed_size);
+}
+
+bool save_memory_snapshot(const MemState &state, std::ostream &stream) {
+    const std::vector<SnapshotAllocation> allocations = get_allocations(state);
+
+    write_value(stream, SNAPSHOT_MAGIC);
+    write_value(stream, state.page_size);
+    write_value(stream, static_cast<uint32_t>(allocations.size()));
+    for (const SnapshotAllocation &allocation : allocations) {
+        write_value(stream, allocation.page);
+        write_value(stream, allocation.page_count);
+    }
+
+    std::vector<SnapshotChunk> chunks;
+    for (const SnapshotAllocation &allocation : allocations) {
+        const Address start = allocation.page * state.page_size;
+        const Address end = start + allocation.page_count * state.page_size;
+        for (Address address = start; address < end; address += SNAPSHOT_CHUNK_SIZE)
+            chunks.push_back({ address, std::min(SNAPSHOT_CHUNK_SIZE, end - address), {} });
+    }
+    write_value(stream, static_cast<uint32_t>(chunks.size()));
+
+    // the chunks are compressed by batches and written in order, so the compressed memory is never held at once
+    const size_t batch_size = std::max(std::thread::hardware_concurrency(), 1U) * SNAPSHOT_CHUNKS_PER_THREAD;
+    for (size_t batch_start = 0; batch_start < chunks.size(); batch_start += batch_size) {
+        const size_t batch_end = std::min(batch_start + batch_size, chunks.size());
+        run_parallel(batch_end - batch_start, [&](size_t index) {
+            compress_chunk(state, chunks[batch_start + index]);
+        });
+
+        for (size_t i = batch_start; i < batch_end; i++) {
+            SnapshotChunk &chunk = chunks[i];
+            write_value(stream, chunk.address);
+            write_value(stream, chunk.size);
+            write_value(stream, static_cast<uint32_t>(chunk.data.size()));
+            stream.write(reinterpret_cast<const char *>(chunk.data.data()), chunk.data.size());
+            chunk.data = {};
+        }
+    }
+
+    return static_cast<bool>(stream);
+}
+
+bool load_memory_snapshot(MemState &state, std::istream &stream) {
+    uint32_t magic = 0;
+    uint32_t page_size = 0;
+    uint32_t allocation_count = 0;
+    if (!read_value(stream, magic) || magic != SNAPSHOT_MAGIC || !read_value(stream, page_size) || !read_value(stream, allocation_count)) {
+        LOG_ERROR("Invalid memory snapshot");
+        return false;
+    }
+    if (page_size != state.page_size) {
+        LOG_ERROR("The memory snapshot was made with pages of {} bytes, the host uses {} bytes", page_size, state.page_size);
+        return false;
+    }
+
+    std::vector<SnapshotAllocation> allocations(allocation_count);
+    for (SnapshotAllocation &allocation : allocations) {
+        if (!read_value(stream, allocation.page) || !read_value(stream, allocation.page_count)) {
+            LOG_ERROR("Invalid memory snapshot");
+            return false;
+        }
+    }
+
+    // the allocations made since the snapshot are freed and the ones freed since are made again
+    for (const SnapshotAllocation &allocation : get_allocations(state)) {
+        if (std::find(allocations.begin(), allocations.end(), allocation) == allocations.end())
+            free(state, allocation.page * page_size);
+    }
+    for (const SnapshotAllocation &allocation : allocations) {
+        const Address address = allocation.page * page_size;
+        if (!state.alloc_table[allocation.page].allocated && !try_alloc_at(state, address, allocation.page_count * page_size, "snapshot")) {
+            LOG_ERROR("Failed to allocate the memory of the snapshot at {}", log_hex(address));
+            return false;
+        }
+    }
+
+    // the free blocks of the heaps are not in the snapshot, the ones freed before it are lost
+    reset_slab_allocator(state.slab_allocator);
+
+    uint32_t chunk_count = 0;
+    if (!read_value(stream, chunk_count))
+        return false;
+
+    const size_t batch_size = std::max(std::thread::hardware_concurrency(), 1U) * SNAPSHOT_CHUNKS_PER_THREAD;
+    std::vector<SnapshotChunk> chunks;
+    std::vector<uint8_t> valid;
+    for (uint32_t batch_start = 0; batch_start < chunk_count; batch_start += batch_size) {
+        chunks.resize(std::min<size_t>(batch_size, chunk_count - batch_start));
+        for (SnapshotChunk &chunk : chunks) {
+            uint32_t compressed_size = 0;
+            if (!read_value(stream, chunk.address) || !read_value(stream, chunk.size) || !read_value(stream, compressed_size)
+                || chunk.size > SNAPSHOT_CHUNK_SIZE || !is_valid_addr_range(state, chunk.address, chunk.address + chunk.size)) {
+                LOG_ERROR("Invalid memory snapshot");
+                return false;
+            }
+            chunk.data.resize(compressed_size);
+            if (!stream.read(reinterpret_cast<char *>(chunk.data.data()), compressed_size))
+                return false;
+        }
+
+        // the tracked pages are marked at once, the pages protected for the renderer fault and have their callbacks called
+        for (const SnapshotChunk &chunk : chunks)
+            mark_range_written(state, chunk.address, chunk.size);
+
+        valid.assign(chunks.size(), 1);
+        run_parallel(chunks.size(), [&](size_t index) {
+            const SnapshotChunk &chunk = chunks[index];
+            uint8_t *const memory = &state.memory[chunk.address];
+            if (chunk.data.empty()) {
+                std::memset(memory, 0, chunk.size);
+                return;
+            }
+            mz_ulong size = chunk.size;
+            valid[index] = mz_uncompress(memory, &size, chunk.data.data(), static_cast<mz_ulong>(chunk.data.size())) == MZ_OK && size == chunk.size;
+        });
+
+        if (std::find(valid.begin(), valid.end(), 0) != valid.end()) {
+            LOG_ERROR("Failed to decompress the memory snapshot");
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,146 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <mem/functions.h>
+#include <mem/ptr.h>
+#include <mem/state.h>
+#include <mem/transfer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+static void run_transfer_chunks(TransferJob &job) {
+    uint32_t chunk;
+    while ((chunk = job.next_chunk.fetch_add(1, std::memory_order_relaxed)) < job.chunk_count) {
+        const uint32_t offset = chunk * TRANSFER_CHUNK_SIZE;
+        job.run_chunk(offset, std::min(TRANSFER_CHUNK_SIZE, job.size - offset));
+
+        if (job.done_chunks.fetch_add(1, std::memory_order_acq_rel) + 1 == job.chunk_count) {
+            const std::lock_guard<std::mutex> lock(job.mutex);
+            job.done.notify_one();
+        }
+    }
+}
+
+static void run_transfer_worker(TransferWorkers &workers) {
+    std::unique_lock<std::mutex> lock(workers.mutex);
+    while (true) {
+        workers.cond.wait(lock, [&]() { return workers.exiting || !workers.jobs.empty(); });
+        if (workers.exiting)
+            return;
+
+        const std::shared_ptr<TransferJob> job = workers.jobs.front();
+        lock.unlock();
+        run_transfer_chunks(*job);
+        lock.lock();
+
+        // all the chunks of the job are started, the ones still running are waited for by the calling thread
+        if (!workers.jobs.empty() && workers.jobs.front() == job)
+            workers.jobs.pop_front();
+    }
+}
+
+TransferWorkers::~TransferWorkers() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        cond.notify_all();
+    }
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+static void run_transfer(MemState &state, uint32_t size, std::function<void(uint32_t offset, uint32_t size)> run_chunk) {
+    if (size < PARALLEL_TRANSFER_MIN_SIZE) {
+        run_chunk(0, size);
+        return;
+    }
+
+    const auto job = std::make_shared<TransferJob>();
+    job->run_chunk = std::move(run_chunk);
+    job->size = size;
+    job->chunk_count = (size + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE;
+
+    TransferWorkers &workers = state.transfer_workers;
+    {
+        const std::lock_guard<std::mutex> lock(workers.mutex);
+        if (workers.threads.empty()) {
+            // a copy is limited by the memory bandwidth, a few threads are enough
+            const uint32_t worker_count = std::clamp(std::thread::hardware_concurrency() / 4, 1U, 3U);
+            for (uint32_t i = 0; i < worker_count; i++)
+                workers.threads.emplace_back(run_transfer_worker, std::ref(workers));
+        }
+        workers.jobs.push_back(job);
+    }
+    workers.cond.notify_all();
+
+    // the calling thread takes its share of the chunks, so the transfer is done even if all the workers are busy
+    run_transfer_chunks(*job);
+
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->done.wait(lock, [&]() { return job->done_chunks.load(std::memory_order_acquire) == job->chunk_count; });
+    }
+
+    const std::lock_guard<std::mutex> lock(workers.mutex);
+    const auto it = std::find(workers.jobs.begin(), workers.jobs.end(), job);
+    if (it != workers.jobs.end())
+        workers.jobs.erase(it);
+}
+
+static bool is_valid_transfer_range(const MemState &state, Address addr, uint32_t size) {
+    return addr <= std::numeric_limits<Address>::max() - size && is_valid_addr_range(state, addr, addr + size);
+}
+
+bool copy_memory(MemState &state, Address dst, Address src, uint32_t size) {
+    if (size == 0)
+        return true;
+    if (!is_valid_transfer_range(state, dst, size) || !is_valid_transfer_range(state, src, size))
+        return false;
+
+    // the tracked pages are marked at once instead of faulting one after the other,
+    // the pages protected for the renderer still fault and have their callbacks called
+    mark_range_written(state, dst, size);
+
+    // the chunks of overlapping ranges would be written while others are read
+    const bool overlapping = dst < src + size && src < dst + size;
+    if (overlapping) {
+        std::memmove(Ptr<uint8_t>(dst).get(state), Ptr<const uint8_t>(src).get(state), size);
+        return true;
+    }
+
+    run_transfer(state, size, [&state, dst, src](uint32_t offset, uint32_t chunk_size) {
+        std::memcpy(Ptr<uint8_t>(dst + offset).get(state), Ptr<const uint8_t>(src + offset).get(state), chunk_size);
+    });
+    return true;
+}
+
+bool fill_memory(MemState &state, Address dst, uint8_t value, uint32_t size) {
+    if (size == 0)
+        return true;
+    if (!is_valid_transfer_range(state, dst, size))
+        return false;
+
+    mark_range_written(state, dst, size);
+
+    run_transfer(state, size, [&state, dst, value](uint32_t offset, uint32_t chunk_size) {
+        std::memset(Ptr<uint8_t>(dst + offset).get(state), value, chunk_size);
+    });
+    return true;
+}
@@ -0,0 +1,59 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include "test_mem.h"
+
+#include <mem/functions.h>
+#include <mem/ptr.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+TEST(alloc, reused_pages_are_cleared) {
+    MemState &mem = get_mem();
+    const uint32_t size = mem.page_size * 8;
+
+    const Address first = alloc(mem, size, "first");
+    ASSERT_NE(first, 0);
+    std::fill_n(Ptr<uint8_t>(first).get(mem), size, uint8_t(0xAB));
+    free(mem, first);
+
+    // the same pages are given again, whether the host kept their content or not
+    const Address second = alloc(mem, size, "second");
+    ASSERT_EQ(second, first);
+    const uint8_t *data = Ptr<uint8_t>(second).get(mem);
+    EXPECT_TRUE(std::all_of(data, data + size, [](uint8_t value) { return value == 0; }));
+    free(mem, second);
+}
+
+TEST(alloc, dirty_pages_are_cleared) {
+    MemState &mem = get_mem();
+    const Address address = alloc(mem, mem.page_size * 3, "dirty");
+    ASSERT_NE(address, 0);
+    free(mem, address);
+
+    // as done by free when the host keeps the content of the pages
+    const uint32_t page = address / mem.page_size + 1;
+    mem.dirty_pages[page / 64].fetch_or(1ULL << (page % 64));
+
+    ASSERT_EQ(alloc(mem, mem.page_size * 3, "dirty"), address);
+    EXPECT_EQ(mem.dirty_pages[page / 64].load() & (1ULL << (page % 64)), 0);
+    free(mem, address);
+}
@@ -18,6 +18,7 @@
 #include <list>
 #include <mem/allocator.h>
 #include <mem/util.h>
+#include <random>
 
 #include <gtest/gtest.h>
 
@@ -151,6 +152,99 @@ TEST(bitmap_allocator, battle_test) {
     }
 }
 
+// Compare the allocations with a search done slot by slot
+TEST(bitmap_allocator, matches_linear_search) {
+    constexpr int MEM_SIZE = KiB(20) + 7;
+    constexpr int TEST_EPOCH = KiB(20);
+    constexpr int MAX_MEM_CHUNK_SIZE = 3000;
+
+    std::mt19937 rng(1234);
+    BitmapAllocator allocator(MEM_SIZE);
+    std::vector<bool> used(MEM_SIZE, false);
+
+    const auto find_fit = [&](int start_offset, int size, bool best_fit) {
+        int best = -1;
+        int best_length = MEM_SIZE + 1;
+        for (int offset = start_offset; offset < MEM_SIZE;) {
+            if (used[offset]) {
+                offset++;
+                continue;
+            }
+            int length = 0;
+            while (offset + length < MEM_SIZE && !used[offset + length])
+                length++;
+            if (length >= size && length < best_length) {
+                best = offset;
+                best_length = length;
+                if (!best_fit)
+                    break;
+            }
+            offset += length;
+        }
+        return best;
+    };
+
+    for (int i = 0; i < TEST_EPOCH; ++i) {
+        const int start_offset = rng() % 4 == 0 ? static_cast<int>(rng() % MEM_SIZE) : 0;
+        const bool best_fit = rng() % 2;
+        int size = rng() % 8 == 0 ? static_cast<int>(rng() % MAX_MEM_CHUNK_SIZE) + 1 : static_cast<int>(rng() % 40) + 1;
+
+        const int expected = find_fit(start_offset, size, best_fit);
+        const int ret = allocator.allocate_from(start_offset, size, best_fit);
+        ASSERT_EQ(ret, expected);
+        if (ret >= 0) {
+            for (int slot = ret; slot < ret + size; slot++)
+                used[slot] = true;
+        }
+
+        // Free a random range so that the bitmap stays fragmented
+        const int free_offset = rng() % MEM_SIZE;
+        const int free_size = std::min<int>(rng() % 64 + 1, MEM_SIZE - free_offset);
+        allocator.free(free_offset, free_size);
+        for (int slot = free_offset; slot < free_offset + free_size; slot++)
+            used[slot] = false;
+    }
+}
+
+TEST(bitmap_allocator, fragmented_allocation) {
+    // One slot per page of a 4 GiB address space
+    constexpr int MEM_SIZE = static_cast<int>(GiB(4) / KiB(4));
+    constexpr int ALLOC_COUNT = 2000;
+
+    BitmapAllocator allocator(MEM_SIZE);
+    for (int i = 0; i < MEM_SIZE; ++i) {
+        int size = 1;
+        ASSERT_EQ(allocator.allocate_from(0, size), i);
+    }
+    // Leave only single free slots, and a large run at the end
+    for (int i = 0; i < MEM_SIZE - 2 * ALLOC_COUNT * 16; i += 2)
+        allocator.free(i, 1);
+    allocator.free(MEM_SIZE - 2 * ALLOC_COUNT * 16, 2 * ALLOC_COUNT * 16);
+
+    const int run_start = MEM_SIZE - 2 * ALLOC_COUNT * 16;
+    for (int i = 0; i < ALLOC_COUNT; ++i) {
+        int size = 16;
+        ASSERT_EQ(allocator.allocate_from(0, size, i % 2), run_start + i * 16);
+    }
+    // the single slots were all skipped
+    EXPECT_EQ(allocator.free_slot_count(0, run_start), run_start / 2);
+    EXPECT_EQ(allocator.free_slot_count(run_start, MEM_SIZE), ALLOC_COUNT * 16);
+
+    // a slot freed in the middle of the allocations is the best fit, not the first one
+    allocator.free(run_start + 100 * 16, 16);
+    int size = 16;
+    EXPECT_EQ(allocator.allocate_from(0, size, true), run_start + 100 * 16);
+    size = 16;
+    EXPECT_EQ(allocator.allocate_from(0, size), run_start + ALLOC_COUNT * 16);
+    // the single slots are still found from any start
+    size = 1;
+    EXPECT_EQ(allocator.allocate_from(0, size), 0);
+    size = 1;
+    EXPECT_EQ(allocator.allocate_from(1, size), 2);
+    size = 2;
+    EXPECT_EQ(allocator.allocate_from(0, size, true), run_start + (ALLOC_COUNT + 1) * 16);
+}
+
 // These tests are from EKA2L1 (https://github.com/EKA2L1/EKA2L1/blob/4fbd057da2a0c4f66a5c0f9dfc406c5d90f7531f/src/tests/common/allocator.cpp)
 TEST(bitmap_allocator, no_best_fit_only_one_fit) {
     BitmapAllocator alloc(32);
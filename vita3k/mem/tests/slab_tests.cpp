@@ -0,0 +1,122 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include "test_mem.h"
+
+#include <mem/functions.h>
+#include <mem/slab.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+TEST(slab_allocator, small_blocks_share_pages) {
+    MemState &mem = get_mem();
+    SlabCache cache;
+
+    std::set<Address> blocks;
+    for (int i = 0; i < 100; i++) {
+        const Address block = slab_alloc(mem, cache, 24, "slab test");
+        ASSERT_NE(block, 0);
+        EXPECT_NE(block % mem.page_size, 0);
+        EXPECT_EQ(block % SLAB_BLOCK_ALIGNMENT, 0);
+        EXPECT_EQ(slab_usable_size(mem, block), 32);
+        EXPECT_TRUE(blocks.insert(block).second);
+    }
+
+    std::set<Address> pages;
+    for (const Address block : blocks)
+        pages.insert(block / mem.page_size);
+    EXPECT_LE(pages.size(), 2);
+
+    for (const Address block : blocks)
+        slab_free(mem, cache, block);
+}
+
+TEST(slab_allocator, freed_blocks_are_reused) {
+    MemState &mem = get_mem();
+    SlabCache cache;
+
+    const Address block = slab_alloc(mem, cache, 100, "slab test");
+    slab_free(mem, cache, block);
+    EXPECT_EQ(slab_alloc(mem, cache, 100, "slab test"), block);
+    slab_free(mem, cache, block);
+}
+
+TEST(slab_allocator, blocks_are_shared_between_caches) {
+    MemState &mem = get_mem();
+    SlabCache first;
+
+    // go past the cache size, so that the blocks are given back to the allocator
+    std::vector<Address> blocks;
+    for (size_t i = 0; i < SlabCache::MAX_BLOCKS * 2; i++)
+        blocks.push_back(slab_alloc(mem, first, SLAB_MAX_BLOCK_SIZE, "slab test"));
+    for (const Address block : blocks)
+        slab_free(mem, first, block);
+    EXPECT_LE(first.blocks.back().size(), SlabCache::MAX_BLOCKS);
+
+    SlabCache second;
+    const Address block = slab_alloc(mem, second, SLAB_MAX_BLOCK_SIZE, "slab test");
+    EXPECT_NE(std::find(blocks.begin(), blocks.end(), block), blocks.end());
+    slab_free(mem, second, block);
+}
+
+TEST(slab_allocator, large_blocks_are_pages) {
+    MemState &mem = get_mem();
+    SlabCache cache;
+
+    const Address block = slab_alloc(mem, cache, SLAB_MAX_BLOCK_SIZE + 1, "slab test");
+    ASSERT_NE(block, 0);
+    EXPECT_EQ(block % mem.page_size, 0);
+    EXPECT_EQ(slab_usable_size(mem, block), mem.page_size);
+
+    slab_free(mem, cache, block);
+    EXPECT_FALSE(mem.alloc_table[block / mem.page_size].allocated);
+}
+
+TEST(slab_allocator, unallocated_pages_are_not_read) {
+    MemState &mem = get_mem();
+    SlabCache cache;
+
+    const Address page = alloc(mem, mem.page_size, "slab test");
+    ASSERT_NE(page, 0);
+    free(mem, page);
+
+    // the page is no longer accessible, only an error is logged
+    const Address stale = page + 64;
+    EXPECT_EQ(slab_usable_size(mem, stale), 0);
+    slab_free(mem, cache, stale);
+}
+
+TEST(slab_allocator, reset_drops_the_cached_blocks) {
+    MemState &mem = get_mem();
+    SlabCache cache;
+
+    const Address block = slab_alloc(mem, cache, 16, "slab test");
+    slab_free(mem, cache, block);
+    reset_slab_allocator(mem.slab_allocator);
+
+    // the block is lost, a new slab is used
+    const Address other = slab_alloc(mem, cache, 16, "slab test");
+    EXPECT_NE(other, block);
+    EXPECT_NE(other / mem.page_size, block / mem.page_size);
+    slab_free(mem, cache, other);
+}
@@ -0,0 +1,62 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include "test_mem.h"
+
+#include <mem/functions.h>
+#include <mem/ptr.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+
+TEST(snapshot, content_and_allocations_are_restored) {
+    MemState &mem = get_mem();
+    const uint32_t size = MiB(3) + mem.page_size;
+    const Address kept = alloc(mem, size, "kept");
+    const Address freed = alloc(mem, mem.page_size, "freed");
+    uint8_t *const data = Ptr<uint8_t>(kept).get(mem);
+    for (uint32_t i = 0; i < size; i += 7)
+        data[i] = static_cast<uint8_t>(i / 7);
+    // one chunk only holds zeroes
+    std::memset(data + MiB(1), 0, MiB(1));
+
+    std::stringstream stream;
+    ASSERT_TRUE(save_memory_snapshot(mem, stream));
+
+    std::vector<uint8_t> expected(data, data + size);
+    std::memset(data, 0xFF, size);
+    free(mem, freed);
+    const Address added = alloc(mem, mem.page_size * 2, "added");
+
+    ASSERT_TRUE(load_memory_snapshot(mem, stream));
+    EXPECT_EQ(std::memcmp(data, expected.data(), size), 0);
+    EXPECT_TRUE(mem.alloc_table[freed / mem.page_size].allocated);
+    EXPECT_EQ(mem.alloc_table[freed / mem.page_size].size, 1);
+    if (added != freed)
+        EXPECT_FALSE(mem.alloc_table[added / mem.page_size].allocated);
+
+    free(mem, freed);
+    free(mem, kept);
+}
+
+TEST(snapshot, invalid_stream_is_rejected) {
+    MemState &mem = get_mem();
+    std::stringstream stream("not a snapshot");
+    EXPECT_FALSE(load_memory_snapshot(mem, stream));
+}
@@ -0,0 +1,108 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "test_mem.h"
+
+#include <mem/functions.h>
+#include <mem/ptr.h>
+#include <mem/state.h>
+#include <mem/transfer.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+TEST(transfer, small_copy) {
+    MemState &mem = get_mem();
+    const Address src = alloc(mem, KiB(4), "small_copy_src");
+    const Address dst = alloc(mem, KiB(4), "small_copy_dst");
+    uint8_t *src_data = Ptr<uint8_t>(src).get(mem);
+    std::iota(src_data, src_data + 100, 0);
+
+    EXPECT_TRUE(copy_memory(mem, dst, src, 100));
+    EXPECT_EQ(std::memcmp(Ptr<uint8_t>(dst).get(mem), src_data, 100), 0);
+
+    free(mem, dst);
+    free(mem, src);
+}
+
+TEST(transfer, large_copy_and_fill) {
+    MemState &mem = get_mem();
+    // not a multiple of the chunk size, so the last chunk is smaller
+    const uint32_t size = PARALLEL_TRANSFER_MIN_SIZE * 3 + 1234;
+    const Address src = alloc(mem, size, "large_copy_src");
+    const Address dst = alloc(mem, size, "large_copy_dst");
+    uint32_t *src_data = Ptr<uint32_t>(src).get(mem);
+    std::iota(src_data, src_data + size / sizeof(uint32_t), 0);
+
+    EXPECT_TRUE(copy_memory(mem, dst, src, size));
+    EXPECT_EQ(std::memcmp(Ptr<uint8_t>(dst).get(mem), src_data, size), 0);
+
+    EXPECT_TRUE(fill_memory(mem, dst + 1, 0xAB, size - 1));
+    const uint8_t *dst_data = Ptr<uint8_t>(dst).get(mem);
+    EXPECT_EQ(dst_data[0], 0);
+    EXPECT_TRUE(std::all_of(dst_data + 1, dst_data + size, [](uint8_t value) { return value == 0xAB; }));
+
+    free(mem, dst);
+    free(mem, src);
+}
+
+TEST(transfer, overlapping_copy) {
+    MemState &mem = get_mem();
+    const uint32_t size = PARALLEL_TRANSFER_MIN_SIZE * 2;
+    const Address addr = alloc(mem, size + KiB(4), "overlapping_copy");
+    uint32_t *data = Ptr<uint32_t>(addr).get(mem);
+    std::iota(data, data + size / sizeof(uint32_t), 0);
+
+    EXPECT_TRUE(copy_memory(mem, addr + KiB(4), addr, size));
+    const uint32_t *moved = Ptr<uint32_t>(addr + KiB(4)).get(mem);
+    for (uint32_t i = 0; i < size / sizeof(uint32_t); i++)
+        ASSERT_EQ(moved[i], i);
+
+    free(mem, addr);
+}
+
+TEST(transfer, invalid_range_is_rejected) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, KiB(4), "invalid_range");
+    const uint8_t value = Ptr<uint8_t>(addr).get(mem)[0];
+
+    EXPECT_FALSE(fill_memory(mem, addr, value + 1, KiB(8)));
+    EXPECT_FALSE(copy_memory(mem, addr, addr + KiB(4), 16));
+    EXPECT_FALSE(fill_memory(mem, addr, 0, std::numeric_limits<uint32_t>::max()));
+    EXPECT_EQ(Ptr<uint8_t>(addr).get(mem)[0], value);
+
+    free(mem, addr);
+}
+
+TEST(transfer, destination_is_marked_written) {
+    MemState &mem = get_mem();
+    const uint32_t size = PARALLEL_TRANSFER_MIN_SIZE * 2;
+    const Address addr = alloc(mem, size, "marked_written");
+
+    const uint64_t stamp = track_writes(mem, addr, size);
+    ASSERT_NE(stamp, 0);
+
+    EXPECT_TRUE(fill_memory(mem, addr + size / 2, 1, size / 2));
+    EXPECT_FALSE(is_range_written(mem, addr, size / 2, stamp));
+    EXPECT_TRUE(is_range_written(mem, addr + size / 2, size / 2, stamp));
+
+    free(mem, addr);
+}
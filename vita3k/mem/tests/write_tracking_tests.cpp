@@ -0,0 +1,162 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "test_mem.h"
+
+#include <mem/functions.h>
+#include <mem/ptr.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+TEST(write_tracking, pages_use_the_host_granularity) {
+    MemState &mem = get_mem();
+    EXPECT_EQ(mem.page_size, get_host_page_size());
+    EXPECT_GE(mem.page_size, KiB(4));
+    EXPECT_EQ(mem.page_size & (mem.page_size - 1), 0);
+
+    // a write anywhere in a host page is seen by a tracked range only covering 4 KiB of it
+    const Address addr = alloc(mem, mem.page_size, "host_page");
+    EXPECT_EQ(addr % mem.page_size, 0);
+    const uint64_t stamp = track_writes(mem, addr, KiB(4));
+    ASSERT_NE(stamp, 0);
+    Ptr<uint8_t>(addr + mem.page_size - 1).get(mem)[0] = 1;
+    EXPECT_TRUE(is_range_written(mem, addr, KiB(4), stamp));
+
+    free(mem, addr);
+}
+
+TEST(write_tracking, untracked_range_is_written) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 2, "untracked");
+
+    EXPECT_TRUE(is_range_written(mem, addr, mem.page_size * 2, 0));
+
+    free(mem, addr);
+}
+
+TEST(write_tracking, cpu_write_is_detected) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 4, "cpu_write");
+    uint8_t *data = Ptr<uint8_t>(addr).get(mem);
+
+    uint64_t stamp = track_writes(mem, addr, mem.page_size * 4);
+    ASSERT_NE(stamp, 0);
+    EXPECT_FALSE(is_range_written(mem, addr, mem.page_size * 4, stamp));
+
+    // reads do not count as writes
+    EXPECT_EQ(data[mem.page_size], 0);
+    EXPECT_FALSE(is_range_written(mem, addr, mem.page_size * 4, stamp));
+
+    // only the page written is no longer tracked
+    data[mem.page_size * 2 + 5] = 42;
+    EXPECT_EQ(data[mem.page_size * 2 + 5], 42);
+    EXPECT_TRUE(is_range_written(mem, addr, mem.page_size * 4, stamp));
+    EXPECT_FALSE(is_range_written(mem, addr, mem.page_size * 2, stamp));
+    EXPECT_TRUE(is_range_written(mem, addr + mem.page_size * 2, 1, stamp));
+
+    // tracking again only protects the written page
+    stamp = track_writes(mem, addr, mem.page_size * 4);
+    ASSERT_NE(stamp, 0);
+    EXPECT_FALSE(is_range_written(mem, addr, mem.page_size * 4, stamp));
+
+    free(mem, addr);
+    EXPECT_TRUE(is_range_written(mem, addr, mem.page_size * 4, stamp));
+}
+
+TEST(write_tracking, shared_page_is_written_for_every_user) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size, "shared_page");
+    uint8_t *data = Ptr<uint8_t>(addr).get(mem);
+
+    const uint64_t first_stamp = track_writes(mem, addr, 16);
+    const uint64_t second_stamp = track_writes(mem, addr + 16, 16);
+    ASSERT_NE(first_stamp, 0);
+    ASSERT_NE(second_stamp, 0);
+
+    data[0] = 1;
+
+    // the first user tracks the page again, the second user must still see the write
+    const uint64_t new_first_stamp = track_writes(mem, addr, 16);
+    EXPECT_FALSE(is_range_written(mem, addr, 16, new_first_stamp));
+    EXPECT_TRUE(is_range_written(mem, addr + 16, 16, second_stamp));
+
+    free(mem, addr);
+}
+
+TEST(write_tracking, external_write_is_detected) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 2, "external_write");
+
+    const uint64_t stamp = track_writes(mem, addr, mem.page_size * 2);
+    ASSERT_NE(stamp, 0);
+    mark_range_written(mem, addr + mem.page_size, 4);
+    EXPECT_FALSE(is_range_written(mem, addr, mem.page_size, stamp));
+    EXPECT_TRUE(is_range_written(mem, addr + mem.page_size, mem.page_size, stamp));
+
+    // the page must be writable again
+    Ptr<uint8_t>(addr + mem.page_size).get(mem)[0] = 1;
+
+    free(mem, addr);
+}
+
+TEST(write_tracking, protected_range_is_not_tracked) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 2, "protected");
+
+    add_protect(mem, addr, mem.page_size, MemPerm::ReadOnly, [](Address, bool) { return true; });
+    EXPECT_EQ(track_writes(mem, addr, mem.page_size * 2), 0);
+    EXPECT_NE(track_writes(mem, addr + mem.page_size, mem.page_size), 0);
+
+    // trigger the protect callback so that the protection is removed
+    Ptr<uint8_t>(addr).get(mem)[0] = 1;
+
+    free(mem, addr);
+}
+
+TEST(write_tracking, merged_protections_are_handled) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 3, "merged");
+
+    int first_calls = 0;
+    int second_calls = 0;
+    add_protect(mem, addr, mem.page_size * 2, MemPerm::ReadOnly, [&](Address, bool) {
+        first_calls++;
+        return true;
+    });
+    add_protect(mem, addr + mem.page_size, mem.page_size * 2, MemPerm::ReadOnly, [&](Address, bool) {
+        second_calls++;
+        return true;
+    });
+    EXPECT_TRUE(is_protecting(mem, addr));
+    EXPECT_TRUE(is_protecting(mem, addr + mem.page_size * 2));
+
+    // only the block of the written page is removed, the rest of the segment stays protected
+    const uint64_t fault_count = mem.protect_fault_count;
+    Ptr<uint8_t>(addr + mem.page_size * 2).get(mem)[0] = 1;
+    EXPECT_EQ(first_calls, 0);
+    EXPECT_EQ(second_calls, 1);
+    EXPECT_EQ(mem.protect_fault_count, fault_count + 1);
+    EXPECT_TRUE(is_protecting(mem, addr));
+    EXPECT_FALSE(is_protecting(mem, addr + mem.page_size * 2));
+
+    Ptr<uint8_t>(addr).get(mem)[0] = 1;
+    EXPECT_EQ(first_calls, 1);
+    EXPECT_FALSE(is_protecting(mem, addr));
+
+    free(mem, addr);
+}
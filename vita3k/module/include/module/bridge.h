@@ -30,33 +30,36 @@
 #include <config/state.h>
 #include <emuenv/state.h>
 
-using ImportFn = std::function<void(EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id)>;
+struct ThreadState;
+typedef std::shared_ptr<ThreadState> ThreadStatePtr;
+
+using ImportFn = std::function<void(EmuEnvState &emuenv, CPUState &cpu, const ThreadStatePtr &thread)>;
 using ImportVarFactory = std::function<Address(EmuEnvState &emuenv)>;
 
 // Function returns a value that is written to CPU registers.
 template <typename Ret, typename... Args, size_t... indices>
-std::enable_if_t<!std::is_same_v<Ret, void>> call(Ret (*export_fn)(EmuEnvState &, SceUID, const char *, Args...), const char *export_name, const ArgsLayout<Args...> &args_layout, const LayoutArgsState &state, std::index_sequence<indices...>, SceUID thread_id, CPUState &cpu, EmuEnvState &emuenv) {
-    const Ret ret = (*export_fn)(emuenv, thread_id, export_name, read<Args, indices, Args...>(cpu, args_layout, state, emuenv.mem)...);
+std::enable_if_t<!std::is_same_v<Ret, void>> call(Ret (*export_fn)(EmuEnvState &, const ThreadStatePtr &, const char *, Args...), const char *export_name, const ArgsLayout<Args...> &args_layout, const LayoutArgsState &state, std::index_sequence<indices...>, const ThreadStatePtr &thread, CPUState &cpu, EmuEnvState &emuenv) {
+    const Ret ret = (*export_fn)(emuenv, thread, export_name, read<Args, indices, Args...>(cpu, args_layout, state, emuenv.mem)...);
     write_return_value(cpu, ret);
 }
 
 // Function does not return a value.
 template <typename... Args, size_t... indices>
-void call(void (*export_fn)(EmuEnvState &, SceUID, const char *, Args...), const char *export_name, const ArgsLayout<Args...> &args_layout, const LayoutArgsState &state, std::index_sequence<indices...>, SceUID thread_id, CPUState &cpu, EmuEnvState &emuenv) {
-    (*export_fn)(emuenv, thread_id, export_name, read<Args, indices, Args...>(cpu, args_layout, state, emuenv.mem)...);
+void call(void (*export_fn)(EmuEnvState &, const ThreadStatePtr &, const char *, Args...), const char *export_name, const ArgsLayout<Args...> &args_layout, const LayoutArgsState &state, std::index_sequence<indices...>, const ThreadStatePtr &thread, CPUState &cpu, EmuEnvState &emuenv) {
+    (*export_fn)(emuenv, thread, export_name, read<Args, indices, Args...>(cpu, args_layout, state, emuenv.mem)...);
 }
 
 template <typename Ret, typename... Args>
-ImportFn bridge(Ret (*export_fn)(EmuEnvState &, SceUID, const char *, Args...), const char *export_name) {
+ImportFn bridge(Ret (*export_fn)(EmuEnvState &, const ThreadStatePtr &, const char *, Args...), const char *export_name) {
     constexpr std::tuple<ArgsLayout<Args...>, LayoutArgsState> args_layout = lay_out<typename BridgeTypes<Args>::ArmType...>();
 
-    return [export_fn, export_name, args_layout](EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id) {
+    return [export_fn, export_name, args_layout](EmuEnvState &emuenv, CPUState &cpu, const ThreadStatePtr &thread) {
 #ifdef TRACY_ENABLE
         ZoneNamedC(___tracy_scoped_zone, 0xFFF34C, emuenv.cfg.tracy_primitive_impl); // Tracy - Track function scope and set color to yellow
         ZoneNameV(___tracy_scoped_zone, export_name, strlen(export_name)); // Tracy - Edit scope name based on export_name
 #endif
 
         using Indices = std::index_sequence_for<Args...>;
-        call(export_fn, export_name, std::get<0>(args_layout), std::get<1>(args_layout), Indices(), thread_id, cpu, emuenv);
+        call(export_fn, export_name, std::get<0>(args_layout), std::get<1>(args_layout), Indices(), thread, cpu, emuenv);
     };
 }
@@ -422,7 +422,7 @@ EXPORT(SceInt32, _sceAppMgrLoadExec, const char *appPath, Ptr<char> const argv[]
         emuenv.load_exec_path = exec_path;
         emuenv.load_exec = true;
         // make sure we are not stuck waiting for a gpu command
-        emuenv.renderer->should_display = true;
+        emuenv.renderer->request_display();
 
         return SCE_KERNEL_OK;
     }
@@ -260,35 +260,32 @@ EXPORT(int, sceAppUtilSaveDataDataRemove, SceAppUtilSaveDataFileSlot *slot, SceA
 
 EXPORT(int, sceAppUtilSaveDataDataSave, SceAppUtilSaveDataFileSlot *slot, SceAppUtilSaveDataDataSaveItem *files, unsigned int fileNum, SceAppUtilMountPoint *mountPoint, SceSize *requiredSizeKiB) {
     TRACY_FUNC(sceAppUtilSaveDataDataSave, slot, files, fileNum, mountPoint, requiredSizeKiB);
-    SceUID fd;
+
+    for (unsigned int i = 0; i < fileNum; i++) {
+        if (!files[i].dataPath || files[i].offset < 0)
+            return RET_ERROR(SCE_APPUTIL_ERROR_PARAMETER);
+        if (files[i].mode != SCE_APPUTIL_SAVEDATA_DATA_SAVE_MODE_DIRECTORY && files[i].mode != SCE_APPUTIL_SAVEDATA_DATA_SAVE_MODE_FILE_TRUNCATE && !files[i].buf && files[i].bufSize > 0)
+            return RET_ERROR(SCE_APPUTIL_ERROR_PARAMETER);
+    }
 
     if (requiredSizeKiB)
         // requiredSizeKiB must be set to 0 if there is enough space available
         *requiredSizeKiB = 0;
 
+    // the files are copied and written in the background, they are used again by the guest once written
     for (unsigned int i = 0; i < fileNum; i++) {
         const auto file_path = construct_savedata0_path(files[i].dataPath.get(emuenv.mem));
+        const void *data = files[i].buf ? files[i].buf.get(emuenv.mem) : nullptr;
         switch (files[i].mode) {
         case SCE_APPUTIL_SAVEDATA_DATA_SAVE_MODE_DIRECTORY:
             create_dir(emuenv.io, file_path.c_str(), 0777, emuenv.pref_path.wstring(), export_name);
             break;
         case SCE_APPUTIL_SAVEDATA_DATA_SAVE_MODE_FILE_TRUNCATE:
-            if (files[i].buf) {
-                fd = open_file(emuenv.io, file_path.c_str(), SCE_O_WRONLY | SCE_O_CREAT, emuenv.pref_path.wstring(), export_name);
-                seek_file(fd, static_cast<int>(files[i].offset), SCE_SEEK_SET, emuenv.io, export_name);
-                write_file(fd, files[i].buf.get(emuenv.mem), files[i].bufSize, emuenv.io, export_name);
-                close_file(emuenv.io, fd, export_name);
-            }
-            fd = open_file(emuenv.io, file_path.c_str(), SCE_O_WRONLY | SCE_O_APPEND | SCE_O_TRUNC, emuenv.pref_path.wstring(), export_name);
-            truncate_file(fd, files[i].bufSize + files[i].offset, emuenv.io, export_name);
-            close_file(emuenv.io, fd, export_name);
+            stage_file_write(emuenv.io, file_path.c_str(), files[i].offset, data, files[i].bufSize, true, emuenv.pref_path.wstring(), export_name);
             break;
         case SCE_APPUTIL_SAVEDATA_DATA_SAVE_MODE_FILE:
         default:
-            fd = open_file(emuenv.io, file_path.c_str(), SCE_O_WRONLY | SCE_O_CREAT, emuenv.pref_path.wstring(), export_name);
-            seek_file(fd, static_cast<int>(files[i].offset), SCE_SEEK_SET, emuenv.io, export_name);
-            write_file(fd, files[i].buf.get(emuenv.mem), files[i].bufSize, emuenv.io, export_name);
-            close_file(emuenv.io, fd, export_name);
+            stage_file_write(emuenv.io, file_path.c_str(), files[i].offset, data, files[i].bufSize, false, emuenv.pref_path.wstring(), export_name);
             break;
         }
     }
@@ -306,9 +303,7 @@ EXPORT(int, sceAppUtilSaveDataDataSave, SceAppUtilSaveDataFileSlot *slot, SceApp
         modified_time.minute = local.tm_min;
         modified_time.second = local.tm_sec;
         slot->slotParam.get(emuenv.mem)->modifiedTime = modified_time;
-        fd = open_file(emuenv.io, construct_slotparam_path(slot->id).c_str(), SCE_O_WRONLY | SCE_O_CREAT, emuenv.pref_path.wstring(), export_name);
-        write_file(fd, slot->slotParam.get(emuenv.mem), sizeof(SceAppUtilSaveDataSlotParam), emuenv.io, export_name);
-        close_file(emuenv.io, fd, export_name);
+        stage_file_write(emuenv.io, construct_slotparam_path(slot->id).c_str(), 0, slot->slotParam.get(emuenv.mem), sizeof(SceAppUtilSaveDataSlotParam), false, emuenv.pref_path.wstring(), export_name);
     }
 
     return 0;
@@ -194,11 +194,6 @@ EXPORT(int, sceAudioOutOutput, int port, const void *buf) {
         return RET_ERROR(SCE_AUDIO_OUT_ERROR_INVALID_PORT);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread) {
-        return RET_ERROR(SCE_AUDIO_OUT_ERROR_INVALID_PORT);
-    }
-
     emuenv.audio.audio_output(*thread, *prt, buf);
 
     return 0;
@@ -211,10 +206,8 @@ EXPORT(int, sceAudioOutGetRestSample, int port) {
         return RET_ERROR(SCE_AUDIO_OUT_ERROR_INVALID_PORT);
     }
 
-    const int bytes_available = SDL_AudioStreamAvailable(prt->stream.get());
-
-    // we have the number of bytes left, we can convert it back to the number of samples left
-    return bytes_available / (2 * sizeof(int16_t));
+    // the ring holds the samples left once converted to stereo, convert it back to the number of samples left
+    return static_cast<int>(prt->ring.available() / 2);
 }
 
 EXPORT(int, sceAudioOutOpenExtPort) {
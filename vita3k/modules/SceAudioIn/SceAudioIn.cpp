@@ -80,6 +80,11 @@ enum SceAudioInErrorCode {
     SCE_AUDIO_IN_ERROR_INVALID_PARAMETER = 0x8026010B
 };
 
+// only the first word is known to be written, it is set while the input device is capturing
+struct SceAudioInDeviceState {
+    SceUInt32 state;
+};
+
 EXPORT(int, sceAudioInGetAdopt, SceAudioInPortType portType) {
     TRACY_FUNC(sceAudioInGetAdopt, portType);
     if (portType != SCE_AUDIO_IN_PORT_TYPE_VOICE && portType != SCE_AUDIO_IN_PORT_TYPE_RAW) {
@@ -114,15 +119,29 @@ EXPORT(int, sceAudioInInput, int port, void *destPtr) {
     if (port != PORT_ID) {
         return RET_ERROR(SCE_AUDIO_IN_ERROR_INVALID_PORT_PARAM);
     }
-
-    while (SDL_DequeueAudio(emuenv.audio.in_port.id, destPtr, emuenv.audio.in_port.len_bytes) > 0) {
+    if (!destPtr) {
+        return RET_ERROR(SCE_AUDIO_IN_ERROR_INVALID_POINTER);
     }
+
+    emuenv.audio.audio_input(*thread, destPtr);
     return 0;
 }
 
-EXPORT(int, sceAudioInInputWithInputDeviceState) {
-    TRACY_FUNC(sceAudioInInputWithInputDeviceState);
-    return UNIMPLEMENTED();
+EXPORT(int, sceAudioInInputWithInputDeviceState, int port, void *destPtr, SceAudioInDeviceState *state) {
+    TRACY_FUNC(sceAudioInInputWithInputDeviceState, port, destPtr, state);
+    if (!emuenv.audio.in_port.running) {
+        return RET_ERROR(SCE_AUDIO_IN_ERROR_NOT_OPENED);
+    }
+    if (port != PORT_ID) {
+        return RET_ERROR(SCE_AUDIO_IN_ERROR_INVALID_PORT_PARAM);
+    }
+    if (!destPtr || !state) {
+        return RET_ERROR(SCE_AUDIO_IN_ERROR_INVALID_POINTER);
+    }
+
+    emuenv.audio.audio_input(*thread, destPtr);
+    state->state = emuenv.audio.in_port.running ? 1 : 0;
+    return 0;
 }
 
 EXPORT(int, sceAudioInOpenPort, SceAudioInPortType portType, int grain, int freq, SceAudioInParam param) {
@@ -153,24 +172,10 @@ EXPORT(int, sceAudioInOpenPort, SceAudioInPortType portType, int grain, int freq
         }
     }
 
-    SDL_AudioSpec desired = {};
-    SDL_AudioSpec received = {};
-    desired.freq = freq;
-    desired.format = AUDIO_S16LSB;
-    desired.channels = 1;
-    desired.samples = grain;
-    desired.callback = nullptr;
-    desired.userdata = nullptr;
-
-    emuenv.audio.in_port.id = SDL_OpenAudioDevice(nullptr, true, &desired, &received, 0);
-    if (emuenv.audio.in_port.id == 0) {
+    if (!emuenv.audio.open_in_port(grain, freq)) {
         return RET_ERROR(SCE_AUDIO_IN_ERROR_FATAL);
     }
 
-    SDL_PauseAudioDevice(emuenv.audio.in_port.id, 0);
-
-    emuenv.audio.in_port.len_bytes = grain * 2;
-    emuenv.audio.in_port.running = true;
     return PORT_ID;
 }
 
@@ -187,9 +192,7 @@ EXPORT(int, sceAudioInReleasePort, int port) {
     if (!emuenv.audio.in_port.running) {
         return RET_ERROR(SCE_AUDIO_IN_ERROR_NOT_OPENED);
     }
-    emuenv.audio.in_port.running = false;
-    SDL_PauseAudioDevice(emuenv.audio.in_port.id, 1);
-    SDL_CloseAudioDevice(emuenv.audio.in_port.id);
+    emuenv.audio.close_in_port();
     return 0;
 }
 
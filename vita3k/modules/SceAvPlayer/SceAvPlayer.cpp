@@ -20,6 +20,7 @@
 #include <codec/state.h>
 #include <io/functions.h>
 #include <kernel/state.h>
+#include <renderer/state.h>
 
 #include <util/lock_and_find.h>
 #include <util/log.h>
@@ -240,8 +241,6 @@ EXPORT(int32_t, sceAvPlayerAddSource, SceUID player_handle, Ptr<const char> path
         return RET_ERROR(SCE_AVPLAYER_ERROR_INVALID_ARGUMENT);
     }
 
-    const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-
     auto file_path = expand_path(emuenv.io, path.get(emuenv.mem), emuenv.pref_path.wstring());
     if (!fs::exists(file_path) && player_info->file_manager.open_file && player_info->file_manager.close_file && player_info->file_manager.read_file && player_info->file_manager.file_size) {
         if (!fs::exists(emuenv.cache_path))
@@ -285,7 +284,6 @@ EXPORT(int32_t, sceAvPlayerAddSource, SceUID player_handle, Ptr<const char> path
 EXPORT(int, sceAvPlayerClose, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
-    const auto thread = emuenv.kernel.get_thread(thread_id);
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_STOP, 0, Ptr<void>(0));
     std::lock_guard<std::mutex> lock(state->mutex);
     state->players.erase(player_handle);
@@ -410,17 +408,18 @@ EXPORT(bool, sceAvPlayerGetVideoData, SceUID player_handle, SceAvPlayerFrameInfo
             else
                 buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), false);
         } else {
-            buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), true);
+            const uint32_t buffer_size = H264DecoderState::buffer_size(size);
+            buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, buffer_size, true);
 
-            std::vector<uint8_t> data = player_info->player.receive_video();
-            std::memcpy(buffer.get(emuenv.mem), data.data(), data.size());
+            if (player_info->player.receive_video(buffer.get(emuenv.mem), buffer_size))
+                emuenv.renderer->video_frames.frame_written(buffer.address(), buffer_size);
         }
     } else {
         buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), false);
     }
     // TODO: catch eof error and call
     // uint32_t buf = SCE_AVPLAYER_ERROR_MAYBE_EOF;
-    // run_event_callback(emuenv, thread_id, player_info, SCE_AVPLAYER_STATE_ERROR, 0, &buf);
+    // run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_ERROR, 0, &buf);
 
     frame_info->timestamp = player_info->player.last_timestamp;
     frame_info->stream_details.video.width = size.width;
@@ -441,6 +440,7 @@ EXPORT(SceUID, sceAvPlayerInit, SceAvPlayerInfo *info) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     SceUID player_handle = emuenv.kernel.get_next_uid();
     PlayerPtr player = std::make_shared<PlayerInfoState>();
+    player->player.hw_decoding = emuenv.cfg.video_hw_decoding;
     state->players[player_handle] = player;
 
     player->last_frame_time = current_time();
@@ -460,7 +460,7 @@ EXPORT(bool, sceAvPlayerIsActive, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
 
-    return !player_info->player.video_playing.empty();
+    return player_info->player.is_playing();
 }
 
 EXPORT(int, sceAvPlayerJumpToTime) {
@@ -471,7 +471,6 @@ EXPORT(int, sceAvPlayerPause, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
     player_info->paused = true;
-    const auto thread = emuenv.kernel.get_thread(thread_id);
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_PAUSE, 0, Ptr<void>(0));
     return 0;
 }
@@ -484,7 +483,6 @@ EXPORT(int, sceAvPlayerResume, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
     if (!player_info->paused) {
-        const auto thread = emuenv.kernel.get_thread(thread_id);
         run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_PLAY, 0, Ptr<void>(0));
     }
     player_info->paused = false;
@@ -506,10 +504,7 @@ EXPORT(int, sceAvPlayerSetTrickSpeed) {
 EXPORT(int, sceAvPlayerStart, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
-    if (!player_info->player.videos_queue.empty()) {
-        player_info->player.pop_video();
-    }
-    const auto thread = emuenv.kernel.get_thread(thread_id);
+    player_info->player.pop_video();
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_PLAY, 0, Ptr<void>(0));
     return 0;
 }
@@ -518,7 +513,6 @@ EXPORT(int, sceAvPlayerStop, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, emuenv.kernel.mutex);
     player_info->player.free_video();
-    const auto thread = emuenv.kernel.get_thread(thread_id);
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_STOP, 0, Ptr<void>(0));
     return 0;
 }
@@ -33,7 +33,7 @@ enum SceCodecEngineErrorCode {
 EXPORT(int32_t, sceCodecEngineAllocMemoryFromUnmapMemBlock, SceUID uid, uint32_t size, uint32_t alignment) {
     TRACY_FUNC(sceCodecEngineAllocMemoryFromUnmapMemBlock, uid, size, alignment);
     STUBBED("fake vaddr");
-    auto guard = std::lock_guard<std::mutex>(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
     auto it = emuenv.kernel.codec_blocks.find(uid);
     if (it == emuenv.kernel.codec_blocks.end())
         return SCE_CODECENGINE_ERROR_INVALID_VALUE;
@@ -43,7 +43,7 @@ EXPORT(int32_t, sceCodecEngineAllocMemoryFromUnmapMemBlock, SceUID uid, uint32_t
 
 EXPORT(int, sceCodecEngineCloseUnmapMemBlock, SceUID uid) {
     TRACY_FUNC(sceCodecEngineCloseUnmapMemBlock, uid);
-    auto guard = std::lock_guard<std::mutex>(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
     if (!emuenv.kernel.codec_blocks.contains(uid))
         return SCE_CODECENGINE_ERROR_INVALID_VALUE;
 
@@ -60,7 +60,7 @@ EXPORT(int, sceCodecEngineFreeMemoryFromUnmapMemBlock) {
 EXPORT(SceUID, sceCodecEngineOpenUnmapMemBlock, Address memBlock, uint32_t size) {
     TRACY_FUNC(sceCodecEngineOpenUnmapMemBlock, memBlock, size);
     auto uid = emuenv.kernel.get_next_uid();
-    auto guard = std::lock_guard<std::mutex>(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
     CodecEngineBlock block;
     block.size = size;
     emuenv.kernel.codec_blocks.emplace(uid, block);
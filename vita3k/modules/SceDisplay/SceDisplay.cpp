@@ -17,20 +17,20 @@
 
 #include "SceDisplay.h"
 
+#include <ctrl/state.h>
 #include <display/functions.h>
 #include <display/state.h>
 #include <kernel/state.h>
 #include <packages/functions.h>
 #include <renderer/state.h>
 #include <util/lock_and_find.h>
+#include <util/performance_hint.h>
 #include <util/types.h>
 
 #include <util/tracy.h>
 TRACY_MODULE_NAME(SceDisplay);
 
-static int display_wait(EmuEnvState &emuenv, SceUID thread_id, int vcount, const bool is_since_setbuf, const bool is_cb) {
-    const auto &thread = emuenv.kernel.get_thread(thread_id);
-
+static int display_wait(EmuEnvState &emuenv, const ThreadStatePtr &thread, int vcount, const bool is_since_setbuf, const bool is_cb) {
     uint64_t target_vcount;
     if (is_since_setbuf) {
         target_vcount = emuenv.display.last_setframe_vblank_count + vcount;
@@ -140,10 +140,14 @@ EXPORT(SceInt32, _sceDisplaySetFrameBuf, const SceDisplayFrameBuf *pFrameBuf, Sc
         // so set this buffer as ready to be displayed
         // this should decrease the latency
         emuenv.display.frame = emuenv.display.next_frame;
-        emuenv.renderer->should_display = true;
+        emuenv.renderer->request_display();
     }
 
     emuenv.frame_count++;
+    // the thread presenting the frames is on the critical path of each of them
+    add_performance_hint_thread();
+    // the scripted inputs follow the frames of the app, not the host time
+    advance_input_script(emuenv.ctrl);
 
 #ifdef TRACY_ENABLE
     FrameMarkNamed("SCE frame buffer"); // Tracy - Secondary frame end mark for the emulated frame buffer
@@ -206,40 +210,40 @@ EXPORT(SceInt32, sceDisplayUnregisterVblankStartCallback, SceUID uid) {
 
 EXPORT(SceInt32, sceDisplayWaitSetFrameBuf) {
     TRACY_FUNC(sceDisplayWaitSetFrameBuf);
-    return display_wait(emuenv, thread_id, 1, true, false);
+    return display_wait(emuenv, thread, 1, true, false);
 }
 
 EXPORT(SceInt32, sceDisplayWaitSetFrameBufCB) {
     TRACY_FUNC(sceDisplayWaitSetFrameBufCB);
-    return display_wait(emuenv, thread_id, 1, true, true);
+    return display_wait(emuenv, thread, 1, true, true);
 }
 
 EXPORT(SceInt32, sceDisplayWaitSetFrameBufMulti, SceUInt vcount) {
     TRACY_FUNC(sceDisplayWaitSetFrameBufMulti, vcount);
-    return display_wait(emuenv, thread_id, static_cast<int>(vcount), true, false);
+    return display_wait(emuenv, thread, static_cast<int>(vcount), true, false);
 }
 
 EXPORT(SceInt32, sceDisplayWaitSetFrameBufMultiCB, SceUInt vcount) {
     TRACY_FUNC(sceDisplayWaitSetFrameBufMultiCB, vcount);
-    return display_wait(emuenv, thread_id, static_cast<int>(vcount), true, true);
+    return display_wait(emuenv, thread, static_cast<int>(vcount), true, true);
 }
 
 EXPORT(SceInt32, sceDisplayWaitVblankStart) {
     TRACY_FUNC(sceDisplayWaitVblankStart);
-    return display_wait(emuenv, thread_id, 1, false, false);
+    return display_wait(emuenv, thread, 1, false, false);
 }
 
 EXPORT(SceInt32, sceDisplayWaitVblankStartCB) {
     TRACY_FUNC(sceDisplayWaitVblankStartCB);
-    return display_wait(emuenv, thread_id, 1, false, true);
+    return display_wait(emuenv, thread, 1, false, true);
 }
 
 EXPORT(SceInt32, sceDisplayWaitVblankStartMulti, SceUInt vcount) {
     TRACY_FUNC(sceDisplayWaitVblankStartMulti, vcount);
-    return display_wait(emuenv, thread_id, static_cast<int>(vcount), false, false);
+    return display_wait(emuenv, thread, static_cast<int>(vcount), false, false);
 }
 
 EXPORT(SceInt32, sceDisplayWaitVblankStartMultiCB, SceUInt vcount) {
     TRACY_FUNC(sceDisplayWaitVblankStartMultiCB, vcount);
-    return display_wait(emuenv, thread_id, static_cast<int>(vcount), false, true);
+    return display_wait(emuenv, thread, static_cast<int>(vcount), false, true);
 }
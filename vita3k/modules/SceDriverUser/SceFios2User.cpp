@@ -22,10 +22,6 @@
 #include <util/tracy.h>
 TRACY_MODULE_NAME(SceFios2User);
 
-enum SceFiosErrorCode {
-    SCE_FIOS_OK = 0
-};
-
 typedef SceUID SceFiosOverlayID;
 
 enum SceFiosOverlayResolveMode {
@@ -74,6 +74,9 @@ struct FiberState {
     std::mutex mutex;
     std::map<SceUID, SceFiber *> thread_fibers;
     std::map<SceUID, CPUContext> thread_contexts;
+    // where the value given to sceFiberReturnToThread is written, for each thread running a fiber
+    std::map<SceUID, Ptr<SceUInt32>> thread_args_on_return;
+    bool context_size_check = false;
 };
 
 LIBRARY_INIT(SceFiber) {
@@ -94,14 +97,23 @@ SceFiber *get_thread_fiber(FiberState &state, const SceUID &tid) {
     return fiber->second;
 }
 
-void set_thread_context(FiberState &state, const SceUID &tid, const CPUContext &ctx) {
-    state.thread_contexts[tid] = ctx;
+// The fibers are switched during a call, so only the registers preserved across calls are switched.
+// This is done directly on the registers of the cpu, without copying its whole context.
+void save_thread_context(FiberState &state, const SceUID &tid, CPUState &cpu, Ptr<SceUInt32> argOnReturn) {
+    save_callee_saved_context(cpu, state.thread_contexts[tid]);
+    state.thread_args_on_return[tid] = argOnReturn;
 }
 
-CPUContext get_thread_context(FiberState &state, const SceUID &tid) {
+const CPUContext &get_thread_context(FiberState &state, const SceUID &tid) {
     return state.thread_contexts[tid];
 }
 
+void load_fiber_context(CPUState &cpu, const CPUContext &ctx) {
+    load_callee_saved_context(cpu, ctx);
+    // the entry point of a fiber also gets its arguments in r0 and r1, r0 is set by the return value
+    write_reg(cpu, 1, ctx.cpu_registers[1]);
+}
+
 std::string describe_fiber(FiberState &state, ThreadStatePtr thread, SceFiber *fiber) {
     std::stringstream ss;
     ss << fmt::format("Fiber (name: {})\n", fiber->name);
@@ -158,13 +170,12 @@ void initialize_fiber(EmuEnvState &emuenv, const ThreadStatePtr thread, SceFiber
     fiber->cpu->set_lr(0xDEADBEAF);
 }
 
-EXPORT(int, _sceFiberAttachContextAndRun, SceFiber *fiber, Address addrContext, SceSize sizeContext, SceUInt32 argOnRunTo, Ptr<SceUInt32> argOnRun) {
-    TRACY_FUNC(_sceFiberAttachContextAndRun, fiber, addrContext, sizeContext, argOnRunTo, argOnRun);
+EXPORT(int, _sceFiberAttachContextAndRun, SceFiber *fiber, Address addrContext, SceSize sizeContext, SceUInt32 argOnRunTo, Ptr<SceUInt32> argOnReturn) {
+    TRACY_FUNC(_sceFiberAttachContextAndRun, fiber, addrContext, sizeContext, argOnRunTo, argOnReturn);
     // Maybe Need more check on real hw
     STUBBED("Todo: not sure for now");
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     assert(!get_thread_fiber(*state, thread->id));
     assert(!fiber->addrContext);
     if (LOG_FIBER) {
@@ -178,10 +189,10 @@ EXPORT(int, _sceFiberAttachContextAndRun, SceFiber *fiber, Address addrContext,
     }
 
     setup_fiber_to_run(emuenv, thread, fiber, read_sp(*thread->cpu), argOnRunTo);
-    set_thread_context(*state, thread->id, save_context(*thread->cpu));
+    save_thread_context(*state, thread->id, *thread->cpu, argOnReturn);
     set_thread_fiber(*state, thread->id, fiber);
 
-    load_context(*thread->cpu, *fiber->cpu);
+    load_fiber_context(*thread->cpu, *fiber->cpu);
     return fiber->cpu->cpu_registers[0];
 }
 
@@ -191,8 +202,7 @@ EXPORT(int, _sceFiberAttachContextAndSwitch, SceFiber *fiber, Address addrContex
     STUBBED("Todo: not sure for now");
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    auto ctx = get_thread_context(*state, thread->id);
+    const CPUContext &ctx = get_thread_context(*state, thread->id);
     SceFiber *thread_fiber = get_thread_fiber(*state, thread->id);
     if (LOG_FIBER) {
         log_fiber(*state, thread, fiber, "Attach context and switch");
@@ -206,13 +216,13 @@ EXPORT(int, _sceFiberAttachContextAndSwitch, SceFiber *fiber, Address addrContex
         fiber->cpu->set_sp(addrContext + sizeContext);
     }
 
-    *thread_fiber->cpu = save_context(*thread->cpu);
+    save_callee_saved_context(*thread->cpu, *thread_fiber->cpu);
     setup_fiber_to_run(emuenv, thread, fiber, ctx.get_sp(), argOnRunTo);
     thread_fiber->status = FiberStatus::SUSPEND;
     thread_fiber->argOnRun = argOnRun;
     thread_fiber->cpu->cpu_registers[0] = SCE_FIBER_OK;
     set_thread_fiber(*state, thread->id, fiber);
-    load_context(*thread->cpu, *fiber->cpu);
+    load_fiber_context(*thread->cpu, *fiber->cpu);
 
     return fiber->cpu->cpu_registers[0];
 }
@@ -231,11 +241,6 @@ EXPORT(SceInt32, _sceFiberInitializeImpl, SceFiber *fiber, const char *name, Ptr
         return RET_ERROR(SCE_FIBER_ERROR_INVALID);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread) {
-        return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
-    }
-
     initialize_fiber(emuenv, thread, fiber, name, entry, argOnInitialize, addrContext, sizeContext, params);
 
     return SCE_FIBER_OK;
@@ -255,11 +260,6 @@ EXPORT(int, _sceFiberInitializeWithInternalOptionImpl, SceFiber *fiber, const ch
         return RET_ERROR(SCE_FIBER_ERROR_INVALID);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread) {
-        return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
-    }
-
     initialize_fiber(emuenv, thread, fiber, name, entry, argOnInitialize, addrContext, sizeContext, nullptr);
 
     return SCE_FIBER_OK;
@@ -299,8 +299,19 @@ EXPORT(int, sceFiberGetInfo, SceFiber *fiber, SceFiberInfo *fiberInfo) {
     fiberInfo->addrContext = fiber->addrContext;
     fiberInfo->sizeContext = fiber->sizeContext;
     memcpy(fiberInfo->name, fiber->name, sizeof(fiberInfo->name));
-    STUBBED("sizeContextMargin is stubbed");
-    fiberInfo->sizeContextMargin = -1;
+
+    const auto state = emuenv.kernel.obj_store.get<FiberState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->context_size_check && fiber->addrContext) {
+        // the context is filled with 0xCC when the fiber is initialized and its stack grows down from its end
+        const uint8_t *context = Ptr<uint8_t>(fiber->addrContext).get(emuenv.mem);
+        SceUInt32 margin = 0;
+        while (margin < fiber->sizeContext && context[margin] == 0xCC)
+            margin++;
+        fiberInfo->sizeContextMargin = margin;
+    } else {
+        fiberInfo->sizeContextMargin = -1;
+    }
     return 0;
 }
 
@@ -311,7 +322,6 @@ EXPORT(SceUInt32, sceFiberGetSelf, Ptr<SceFiber> *fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_NULL);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     SceFiber *thread_fiber = get_thread_fiber(*state, thread->id);
     if (thread_fiber)
         *fiber = Ptr<SceFiber>(thread_fiber, emuenv.mem);
@@ -321,52 +331,69 @@ EXPORT(SceUInt32, sceFiberGetSelf, Ptr<SceFiber> *fiber) {
     return SCE_FIBER_OK;
 }
 
-EXPORT(int, sceFiberOptParamInitialize) {
-    TRACY_FUNC(sceFiberOptParamInitialize);
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiberOptParamInitialize, SceFiberOptParam *optParam) {
+    TRACY_FUNC(sceFiberOptParamInitialize, optParam);
+    if (!optParam) {
+        return RET_ERROR(SCE_FIBER_ERROR_NULL);
+    }
+
+    memset(optParam, 0, sizeof(SceFiberOptParam));
+    return SCE_FIBER_OK;
 }
 
+// the user markers are only shown by the Razor HUD
 EXPORT(int, sceFiberPopUserMarkerWithHud) {
     TRACY_FUNC(sceFiberPopUserMarkerWithHud);
-    return UNIMPLEMENTED();
+    return SCE_FIBER_OK;
 }
 
 EXPORT(int, sceFiberPushUserMarkerWithHud) {
     TRACY_FUNC(sceFiberPushUserMarkerWithHud);
-    return UNIMPLEMENTED();
+    return SCE_FIBER_OK;
 }
 
-EXPORT(int, sceFiberRenameSelf) {
-    TRACY_FUNC(sceFiberRenameSelf);
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiberRenameSelf, const char *name) {
+    TRACY_FUNC(sceFiberRenameSelf, name);
+    if (!name) {
+        return RET_ERROR(SCE_FIBER_ERROR_NULL);
+    }
+
+    const auto state = emuenv.kernel.obj_store.get<FiberState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    SceFiber *fiber = get_thread_fiber(*state, thread->id);
+    if (!fiber) {
+        return RET_ERROR(SCE_FIBER_ERROR_PERMISSION);
+    }
+
+    strncpy(fiber->name, name, 32);
+    return SCE_FIBER_OK;
 }
 
 EXPORT(SceInt32, sceFiberReturnToThread, uint32_t argOnReturnTo, Ptr<uint32_t> argOnRun) {
     TRACY_FUNC(sceFiberReturnToThread, argOnReturnTo, argOnRun);
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     SceFiber *fiber = get_thread_fiber(*state, thread->id);
     if (!fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_PERMISSION);
     }
 
-    CPUContext thread_context = get_thread_context(*state, thread->id);
+    const CPUContext &thread_context = get_thread_context(*state, thread->id);
     assert(fiber->status == FiberStatus::RUN);
     if (LOG_FIBER) {
         log_fiber(*state, thread, fiber, "Return to thread");
     }
 
-    *fiber->cpu = save_context(*thread->cpu);
+    save_callee_saved_context(*thread->cpu, *fiber->cpu);
     fiber->cpu->cpu_registers[0] = SCE_FIBER_OK;
     fiber->status = FiberStatus::SUSPEND;
     fiber->argOnRun = argOnRun;
     set_thread_fiber(*state, thread->id, nullptr);
 
-    load_context(*thread->cpu, thread_context);
-    Address argOnReturn = thread_context.cpu_registers[2];
+    load_callee_saved_context(*thread->cpu, thread_context);
+    const Ptr<SceUInt32> argOnReturn = state->thread_args_on_return[thread->id];
     if (argOnReturn) {
-        *(Ptr<uint32_t>(argOnReturn).get(emuenv.mem)) = argOnReturnTo;
+        *argOnReturn.get(emuenv.mem) = argOnReturnTo;
     }
 
     return SCE_FIBER_OK;
@@ -376,7 +403,6 @@ EXPORT(SceUInt32, sceFiberRun, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<SceUIn
     TRACY_FUNC(sceFiberRun, fiber, argOnRunTo, argOnReturn);
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     if (!fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_NULL);
     }
@@ -394,29 +420,46 @@ EXPORT(SceUInt32, sceFiberRun, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<SceUIn
     }
 
     setup_fiber_to_run(emuenv, thread, fiber, read_sp(*thread->cpu), argOnRunTo);
-    set_thread_context(*state, thread->id, save_context(*thread->cpu));
+    save_thread_context(*state, thread->id, *thread->cpu, argOnReturn);
     set_thread_fiber(*state, thread->id, fiber);
 
-    load_context(*thread->cpu, *fiber->cpu);
+    load_fiber_context(*thread->cpu, *fiber->cpu);
     return fiber->cpu->cpu_registers[0];
 }
 
-EXPORT(int, sceFiberStartContextSizeCheck) {
-    TRACY_FUNC(sceFiberStartContextSizeCheck);
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiberStartContextSizeCheck, SceUInt32 flags) {
+    TRACY_FUNC(sceFiberStartContextSizeCheck, flags);
+    if (flags != 0) {
+        return RET_ERROR(SCE_FIBER_ERROR_INVALID);
+    }
+
+    const auto state = emuenv.kernel.obj_store.get<FiberState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->context_size_check) {
+        return RET_ERROR(SCE_FIBER_ERROR_STATE);
+    }
+
+    state->context_size_check = true;
+    return SCE_FIBER_OK;
 }
 
 EXPORT(int, sceFiberStopContextSizeCheck) {
     TRACY_FUNC(sceFiberStopContextSizeCheck);
-    return UNIMPLEMENTED();
+    const auto state = emuenv.kernel.obj_store.get<FiberState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->context_size_check) {
+        return RET_ERROR(SCE_FIBER_ERROR_STATE);
+    }
+
+    state->context_size_check = false;
+    return SCE_FIBER_OK;
 }
 
 EXPORT(SceUInt32, sceFiberSwitch, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<SceUInt32> argOnRun) {
     TRACY_FUNC(sceFiberSwitch, fiber, argOnRunTo, argOnRun);
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    auto ctx = get_thread_context(*state, thread->id);
+    const CPUContext &ctx = get_thread_context(*state, thread->id);
     if (!fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_NULL);
     }
@@ -434,13 +477,13 @@ EXPORT(SceUInt32, sceFiberSwitch, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<Sce
         log_fiber(*state, thread, fiber, "Switch");
     }
 
-    *thread_fiber->cpu = save_context(*thread->cpu);
+    save_callee_saved_context(*thread->cpu, *thread_fiber->cpu);
     thread_fiber->status = FiberStatus::SUSPEND;
     thread_fiber->argOnRun = argOnRun;
     thread_fiber->cpu->cpu_registers[0] = SCE_FIBER_OK;
     set_thread_fiber(*state, thread->id, fiber);
     setup_fiber_to_run(emuenv, thread, fiber, ctx.get_sp(), argOnRunTo);
-    load_context(*thread->cpu, *fiber->cpu);
+    load_fiber_context(*thread->cpu, *fiber->cpu);
 
     return fiber->cpu->cpu_registers[0];
 }
@@ -17,84 +17,487 @@
 
 #include <module/module.h>
 
-EXPORT(int, sceFiosArchiveGetDecompressorThreadCount) {
-    return UNIMPLEMENTED();
+#include <io/device.h>
+#include <io/fios.h>
+#include <io/functions.h>
+#include <io/io.h>
+#include <io/psarc.h>
+#include <io/state.h>
+
+#include <util/tracy.h>
+TRACY_MODULE_NAME(SceFios2);
+
+typedef SceUID SceFiosOp;
+typedef SceUID SceFiosFH;
+typedef SceInt64 SceFiosTime;
+typedef SceInt64 SceFiosOffset;
+typedef SceInt64 SceFiosSize;
+
+struct SceFiosOpAttr {
+    SceFiosTime deadline;
+    Ptr<void> pCallback;
+    Ptr<void> pCallbackContext;
+    int32_t priority : 8;
+    uint32_t opflags : 24;
+    uint32_t userTag;
+    Ptr<void> userPtr;
+    Ptr<void> pReserved;
+};
+
+struct SceFiosBuffer {
+    Ptr<void> pPtr;
+    SceSize length;
+};
+
+struct SceFiosOpenParams {
+    uint32_t openFlags : 16;
+    uint32_t opFlags : 16;
+    uint32_t reserved;
+    SceFiosBuffer buffer;
+};
+
+enum SceFiosOpenFlags {
+    SCE_FIOS_O_READ = 0x1,
+    SCE_FIOS_O_WRITE = 0x2,
+    SCE_FIOS_O_APPEND = 0x4,
+    SCE_FIOS_O_CREAT = 0x8,
+    SCE_FIOS_O_TRUNC = 0x10
+};
+
+enum SceFiosWhence {
+    SCE_FIOS_SEEK_SET = 0,
+    SCE_FIOS_SEEK_CUR = 1,
+    SCE_FIOS_SEEK_END = 2
+};
+
+static FiosOpPtr create_op(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const char *export_name) {
+    FiosOpPtr op = std::make_shared<FiosOp>();
+    op->export_name = export_name;
+    if (attr) {
+        op->priority = static_cast<int8_t>(attr->priority);
+        op->deadline = attr->deadline;
+        if (attr->pCallback)
+            LOG_WARN_ONCE("{}: the callbacks of the operations are not supported", export_name);
+    } else {
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        op->priority = emuenv.io.fios.default_priority;
+        op->deadline = emuenv.io.fios.default_deadline;
+    }
+
+    return op;
+}
+
+// the synchronous exports submit their operation like the others so that it is scheduled with them
+static SceInt64 wait_and_delete_op(EmuEnvState &emuenv, const SceFiosOp op_id) {
+    if (op_id < 0)
+        return op_id;
+
+    const FiosOpPtr op = get_fios_op(emuenv.io.fios, op_id);
+    if (!op)
+        return SCE_FIOS_ERROR_BAD_OP;
+    wait_fios_op(emuenv.io.fios, *op);
+    delete_fios_op(emuenv.io.fios, op_id);
+    return op->result;
+}
+
+static int to_error(const SceInt64 result) {
+    return result < 0 ? static_cast<int>(result) : SCE_FIOS_OK;
+}
+
+static bool get_file(EmuEnvState &emuenv, const SceFiosFH fh, FiosFile &file) {
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    const auto it = emuenv.io.fios.files.find(fh);
+    if (it == emuenv.io.fios.files.end())
+        return false;
+
+    file = it->second;
+    return true;
+}
+
+static SceFiosOp submit_open(EmuEnvState &emuenv, const SceFiosOpAttr *attr, SceFiosFH *out_fh, const char *path, const SceFiosOpenParams *params, const char *export_name) {
+    if (!out_fh || !path)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    uint32_t fios_flags = SCE_FIOS_O_READ;
+    if (params)
+        fios_flags = params->openFlags;
+    int flags = 0;
+    if (fios_flags & SCE_FIOS_O_READ)
+        flags |= SCE_O_RDONLY;
+    if (fios_flags & SCE_FIOS_O_WRITE)
+        flags |= SCE_O_WRONLY;
+    if (fios_flags & SCE_FIOS_O_APPEND)
+        flags |= SCE_O_APPEND;
+    if (fios_flags & SCE_FIOS_O_CREAT)
+        flags |= SCE_O_CREAT;
+    if (fios_flags & SCE_FIOS_O_TRUNC)
+        flags |= SCE_O_TRUNC;
+
+    const std::string resolved_path = resolve_path(emuenv.io, path, can_write(flags));
+    const VitaIoDevice device = device::get_device(resolved_path.c_str());
+    if (device == VitaIoDevice::_INVALID)
+        return SCE_FIOS_ERROR_BAD_PATH;
+
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->path = resolved_path;
+    op->request = [&emuenv, out_fh, resolved_path, device, flags, export_name]() -> SceInt64 {
+        const SceUID fd = open_file(emuenv.io, resolved_path.c_str(), flags, emuenv.pref_path.wstring(), export_name);
+        if (fd < 0)
+            return fd;
+
+        FiosFile file{ fd, resolved_path, device };
+        file.size = std::max<SceOff>(seek_file(fd, 0, SCE_SEEK_END, emuenv.io, export_name), 0);
+        if (flags & SCE_O_APPEND)
+            file.pos = file.size;
+
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        const SceFiosFH fh = emuenv.io.fios.next_id++;
+        emuenv.io.fios.files.emplace(fh, std::move(file));
+        *out_fh = fh;
+        return SCE_FIOS_OK;
+    };
+
+    return submit_fios_op(emuenv.io, device, op);
+}
+
+// a negative offset reads from the position of the file handle, which is moved past the data read
+static SceFiosOp submit_read(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const SceFiosFH fh, std::vector<FiosIoVec> buffers, const SceFiosOffset offset, const char *export_name) {
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->buffers = std::move(buffers);
+    const SceInt64 size = op->requested_size();
+
+    VitaIoDevice device = VitaIoDevice::_INVALID;
+    {
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        const auto file = emuenv.io.fios.files.find(fh);
+        if (file == emuenv.io.fios.files.end())
+            return SCE_FIOS_ERROR_BAD_FH;
+
+        op->fd = file->second.fd;
+        op->path = file->second.path;
+        device = file->second.device;
+        if (offset < 0) {
+            op->offset = file->second.pos;
+            file->second.pos += std::clamp<SceInt64>(file->second.size - file->second.pos, 0, size);
+        } else {
+            op->offset = offset;
+        }
+    }
+
+    return submit_fios_op(emuenv.io, device, op);
+}
+
+static SceFiosOp submit_write(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const SceFiosFH fh, std::vector<FiosIoVec> buffers, const SceFiosOffset offset, const char *export_name) {
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->buffers = std::move(buffers);
+    const SceInt64 size = op->requested_size();
+
+    FiosFile file;
+    SceOff write_offset = offset;
+    {
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        const auto it = emuenv.io.fios.files.find(fh);
+        if (it == emuenv.io.fios.files.end())
+            return SCE_FIOS_ERROR_BAD_FH;
+
+        if (offset < 0) {
+            write_offset = it->second.pos;
+            it->second.pos += size;
+        }
+        it->second.size = std::max(it->second.size, write_offset + size);
+        file = it->second;
+    }
+
+    op->path = file.path;
+    op->offset = write_offset;
+    op->request = [&emuenv, fd = file.fd, path = file.path, write_offset, buffers = op->buffers, export_name]() -> SceInt64 {
+        const SceOff pos = seek_file(fd, write_offset, SCE_SEEK_SET, emuenv.io, export_name);
+        if (pos < 0)
+            return pos;
+
+        SceInt64 written = 0;
+        for (const FiosIoVec &buffer : buffers) {
+            const int result = write_file(fd, buffer.data, buffer.size, emuenv.io, export_name);
+            if (result < 0)
+                return written > 0 ? written : result;
+            written += result;
+        }
+        // the prefetched data is not up to date anymore
+        flush_fios_cache(emuenv.io.fios, path, write_offset, written);
+        return written;
+    };
+
+    return submit_fios_op(emuenv.io, file.device, op);
+}
+
+static std::vector<FiosIoVec> single_buffer(void *data, const SceFiosSize size) {
+    return { FiosIoVec{ static_cast<uint8_t *>(data), static_cast<SceSize>(size) } };
+}
+
+static bool get_buffers(EmuEnvState &emuenv, const SceFiosBuffer *iov, const int iovcnt, std::vector<FiosIoVec> &buffers) {
+    if (!iov || iovcnt <= 0)
+        return false;
+
+    for (int i = 0; i < iovcnt; i++)
+        buffers.push_back({ iov[i].pPtr.cast<uint8_t>().get(emuenv.mem), iov[i].length });
+    return true;
+}
+
+static SceFiosOp submit_prefetch_fh(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const SceFiosFH fh, const SceFiosOffset offset, const SceFiosSize length, const char *export_name) {
+    FiosFile file;
+    if (!get_file(emuenv, fh, file))
+        return SCE_FIOS_ERROR_BAD_FH;
+
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->path = file.path;
+    op->offset = offset;
+    op->request = [&emuenv, file, offset, length, export_name]() {
+        return prefetch_fios_file(emuenv.io, file.fd, file.path, offset, length, export_name);
+    };
+
+    return submit_fios_op(emuenv.io, file.device, op);
+}
+
+static SceFiosOp submit_prefetch_file(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const char *path, const SceFiosOffset offset, const SceFiosSize length, const char *export_name) {
+    if (!path)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    const std::string resolved_path = resolve_path(emuenv.io, path, false);
+    const VitaIoDevice device = device::get_device(resolved_path.c_str());
+    if (device == VitaIoDevice::_INVALID)
+        return SCE_FIOS_ERROR_BAD_PATH;
+
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->path = resolved_path;
+    op->offset = offset;
+    op->request = [&emuenv, resolved_path, offset, length, export_name]() -> SceInt64 {
+        const SceUID fd = open_file(emuenv.io, resolved_path.c_str(), SCE_O_RDONLY, emuenv.pref_path.wstring(), export_name);
+        if (fd < 0)
+            return fd;
+
+        const SceInt64 result = prefetch_fios_file(emuenv.io, fd, resolved_path, offset, length, export_name);
+        close_file(emuenv.io, fd, export_name);
+        return result;
+    };
+
+    return submit_fios_op(emuenv.io, device, op);
+}
+
+static SceFiosOp submit_close(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const SceFiosFH fh, const char *export_name) {
+    FiosFile file;
+    {
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        const auto it = emuenv.io.fios.files.find(fh);
+        if (it == emuenv.io.fios.files.end())
+            return SCE_FIOS_ERROR_BAD_FH;
+
+        // the handle cannot be used anymore, the host file is closed after the operations submitted before
+        file = it->second;
+        emuenv.io.fios.files.erase(it);
+    }
+
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->path = file.path;
+    op->request = [&emuenv, fd = file.fd, export_name]() -> SceInt64 {
+        return close_file(emuenv.io, fd, export_name);
+    };
+
+    return submit_fios_op(emuenv.io, file.device, op);
 }
 
-EXPORT(int, sceFiosArchiveGetMountBufferSize) {
-    return UNIMPLEMENTED();
+// the archives could not be used by the guest if they were not found, for any other reason
+static SceInt64 to_archive_error(const SceInt64 result) {
+    if (result >= 0)
+        return result;
+    return result == SCE_ERROR_ERRNO_ENOENT ? SCE_FIOS_ERROR_BAD_PATH : SCE_FIOS_ERROR_UNKNOWN;
 }
 
-EXPORT(int, sceFiosArchiveGetMountBufferSizeSync) {
-    return UNIMPLEMENTED();
+static SceFiosOp submit_get_mount_buffer_size(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const char *archive_path, const char *export_name) {
+    if (!archive_path)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    const std::string resolved_path = resolve_path(emuenv.io, archive_path, false);
+    const VitaIoDevice device = device::get_device(resolved_path.c_str());
+    if (device == VitaIoDevice::_INVALID)
+        return SCE_FIOS_ERROR_BAD_PATH;
+
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->path = resolved_path;
+    op->request = [&emuenv, resolved_path]() {
+        return to_archive_error(get_psarc_toc_size(emuenv.io, resolved_path.c_str(), emuenv.pref_path.wstring()));
+    };
+
+    return submit_fios_op(emuenv.io, device, op);
 }
 
-EXPORT(int, sceFiosArchiveMount) {
-    return UNIMPLEMENTED();
+// the table of contents is kept in host memory, the mount buffer of the guest is not used
+static SceFiosOp submit_archive_mount(EmuEnvState &emuenv, const SceFiosOpAttr *attr, SceFiosFH *out_fh, const char *archive_path, const char *mount_point, const char *export_name) {
+    if (!out_fh || !archive_path || !mount_point)
+        return SCE_FIOS_ERROR_BAD_PTR;
+
+    const std::string resolved_path = resolve_path(emuenv.io, archive_path, false);
+    const VitaIoDevice device = device::get_device(resolved_path.c_str());
+    if (device == VitaIoDevice::_INVALID)
+        return SCE_FIOS_ERROR_BAD_PATH;
+
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->path = resolved_path;
+    op->request = [&emuenv, out_fh, resolved_path, device, mount_path = std::string(mount_point)]() -> SceInt64 {
+        SceFiosFH fh;
+        {
+            const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+            fh = emuenv.io.fios.next_id++;
+        }
+
+        const int result = mount_psarc(emuenv.io, fh, resolved_path.c_str(), mount_path.c_str(), emuenv.pref_path.wstring());
+        if (result < 0)
+            return to_archive_error(result);
+
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        emuenv.io.fios.archives.emplace(fh, FiosFile{ -1, resolved_path, device });
+        *out_fh = fh;
+        return SCE_FIOS_OK;
+    };
+
+    return submit_fios_op(emuenv.io, device, op);
 }
 
-EXPORT(int, sceFiosArchiveMountSync) {
-    return UNIMPLEMENTED();
+static SceFiosOp submit_archive_unmount(EmuEnvState &emuenv, const SceFiosOpAttr *attr, const SceFiosFH fh, const char *export_name) {
+    FiosFile archive;
+    {
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        const auto it = emuenv.io.fios.archives.find(fh);
+        if (it == emuenv.io.fios.archives.end())
+            return SCE_FIOS_ERROR_BAD_FH;
+
+        archive = it->second;
+        emuenv.io.fios.archives.erase(it);
+    }
+
+    const FiosOpPtr op = create_op(emuenv, attr, export_name);
+    op->path = archive.path;
+    op->request = [&emuenv, fh]() -> SceInt64 {
+        return unmount_psarc(emuenv.io.psarc, fh) ? SCE_FIOS_OK : SCE_FIOS_ERROR_BAD_FH;
+    };
+
+    return submit_fios_op(emuenv.io, archive.device, op);
 }
 
-EXPORT(int, sceFiosArchiveSetDecompressorThreadCount) {
-    return UNIMPLEMENTED();
+EXPORT(SceUInt32, sceFiosArchiveGetDecompressorThreadCount) {
+    TRACY_FUNC(sceFiosArchiveGetDecompressorThreadCount);
+    return static_cast<SceUInt32>(get_psarc_decompressor_count(emuenv.io.psarc));
 }
 
-EXPORT(int, sceFiosArchiveUnmount) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosArchiveGetMountBufferSize, const SceFiosOpAttr *pAttr, const char *pArchivePath, const SceFiosOpenParams *pOpenParams) {
+    TRACY_FUNC(sceFiosArchiveGetMountBufferSize, pAttr, pArchivePath, pOpenParams);
+    return submit_get_mount_buffer_size(emuenv, pAttr, pArchivePath, export_name);
 }
 
-EXPORT(int, sceFiosArchiveUnmountSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosArchiveGetMountBufferSizeSync, const SceFiosOpAttr *pAttr, const char *pArchivePath, const SceFiosOpenParams *pOpenParams) {
+    TRACY_FUNC(sceFiosArchiveGetMountBufferSizeSync, pAttr, pArchivePath, pOpenParams);
+    return wait_and_delete_op(emuenv, submit_get_mount_buffer_size(emuenv, pAttr, pArchivePath, export_name));
 }
 
-EXPORT(int, sceFiosCacheContainsFileRangeSync) {
-    return UNIMPLEMENTED();
+// the mount buffer is given as a SceFiosBuffer passed by value
+EXPORT(SceFiosOp, sceFiosArchiveMount, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pArchivePath, const char *pMountPoint, Ptr<void> pMountBuffer, SceSize mountBufferLength, const void *pParams) {
+    TRACY_FUNC(sceFiosArchiveMount, pAttr, pOutFH, pArchivePath, pMountPoint, pMountBuffer, mountBufferLength, pParams);
+    return submit_archive_mount(emuenv, pAttr, pOutFH, pArchivePath, pMountPoint, export_name);
 }
 
-EXPORT(int, sceFiosCacheContainsFileSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosArchiveMountSync, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pArchivePath, const char *pMountPoint, Ptr<void> pMountBuffer, SceSize mountBufferLength, const void *pParams) {
+    TRACY_FUNC(sceFiosArchiveMountSync, pAttr, pOutFH, pArchivePath, pMountPoint, pMountBuffer, mountBufferLength, pParams);
+    return to_error(wait_and_delete_op(emuenv, submit_archive_mount(emuenv, pAttr, pOutFH, pArchivePath, pMountPoint, export_name)));
 }
 
-EXPORT(int, sceFiosCacheFlushFileRangeSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosArchiveSetDecompressorThreadCount, SceUInt32 threadCount) {
+    TRACY_FUNC(sceFiosArchiveSetDecompressorThreadCount, threadCount);
+    if (threadCount == 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+
+    set_psarc_decompressor_count(emuenv.io.psarc, threadCount);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosCacheFlushFileSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosArchiveUnmount, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosArchiveUnmount, pAttr, fh);
+    return submit_archive_unmount(emuenv, pAttr, fh, export_name);
 }
 
-EXPORT(int, sceFiosCacheFlushSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosArchiveUnmountSync, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosArchiveUnmountSync, pAttr, fh);
+    return to_error(wait_and_delete_op(emuenv, submit_archive_unmount(emuenv, pAttr, fh, export_name)));
 }
 
-EXPORT(int, sceFiosCachePrefetchFH) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosCacheContainsFileRangeSync, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosOffset startOffset, SceFiosSize length) {
+    TRACY_FUNC(sceFiosCacheContainsFileRangeSync, pAttr, pPath, startOffset, length);
+    if (!pPath)
+        return false;
+    return fios_cache_contains(emuenv.io.fios, resolve_path(emuenv.io, pPath, false), startOffset, length);
 }
 
-EXPORT(int, sceFiosCachePrefetchFHRange) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosCacheContainsFileSync, const SceFiosOpAttr *pAttr, const char *pPath) {
+    TRACY_FUNC(sceFiosCacheContainsFileSync, pAttr, pPath);
+    if (!pPath)
+        return false;
+    return fios_cache_contains(emuenv.io.fios, resolve_path(emuenv.io, pPath, false), 0, -1);
 }
 
-EXPORT(int, sceFiosCachePrefetchFHRangeSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCacheFlushFileRangeSync, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosOffset startOffset, SceFiosSize length) {
+    TRACY_FUNC(sceFiosCacheFlushFileRangeSync, pAttr, pPath, startOffset, length);
+    if (!pPath)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    flush_fios_cache(emuenv.io.fios, resolve_path(emuenv.io, pPath, false), startOffset, length);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosCachePrefetchFHSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCacheFlushFileSync, const SceFiosOpAttr *pAttr, const char *pPath) {
+    TRACY_FUNC(sceFiosCacheFlushFileSync, pAttr, pPath);
+    if (!pPath)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    flush_fios_cache(emuenv.io.fios, resolve_path(emuenv.io, pPath, false));
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosCachePrefetchFile) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosCacheFlushSync, const SceFiosOpAttr *pAttr) {
+    TRACY_FUNC(sceFiosCacheFlushSync, pAttr);
+    flush_fios_cache(emuenv.io.fios, "");
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosCachePrefetchFileRange) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosCachePrefetchFH, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosCachePrefetchFH, pAttr, fh);
+    return submit_prefetch_fh(emuenv, pAttr, fh, 0, -1, export_name);
+}
+
+EXPORT(SceFiosOp, sceFiosCachePrefetchFHRange, const SceFiosOpAttr *pAttr, SceFiosFH fh, SceFiosOffset startOffset, SceFiosSize length) {
+    TRACY_FUNC(sceFiosCachePrefetchFHRange, pAttr, fh, startOffset, length);
+    return submit_prefetch_fh(emuenv, pAttr, fh, startOffset, length, export_name);
+}
+
+EXPORT(int, sceFiosCachePrefetchFHRangeSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, SceFiosOffset startOffset, SceFiosSize length) {
+    TRACY_FUNC(sceFiosCachePrefetchFHRangeSync, pAttr, fh, startOffset, length);
+    return to_error(wait_and_delete_op(emuenv, submit_prefetch_fh(emuenv, pAttr, fh, startOffset, length, export_name)));
+}
+
+EXPORT(int, sceFiosCachePrefetchFHSync, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosCachePrefetchFHSync, pAttr, fh);
+    return to_error(wait_and_delete_op(emuenv, submit_prefetch_fh(emuenv, pAttr, fh, 0, -1, export_name)));
+}
+
+EXPORT(SceFiosOp, sceFiosCachePrefetchFile, const SceFiosOpAttr *pAttr, const char *pPath) {
+    TRACY_FUNC(sceFiosCachePrefetchFile, pAttr, pPath);
+    return submit_prefetch_file(emuenv, pAttr, pPath, 0, -1, export_name);
+}
+
+EXPORT(SceFiosOp, sceFiosCachePrefetchFileRange, const SceFiosOpAttr *pAttr, const char *pPath, SceFiosOffset startOffset, SceFiosSize length) {
+    TRACY_FUNC(sceFiosCachePrefetchFileRange, pAttr, pPath, startOffset, length);
+    return submit_prefetch_file(emuenv, pAttr, pPath, startOffset, length, export_name);
 }
 
 EXPORT(int, sceFiosCancelAllOps) {
-    return UNIMPLEMENTED();
+    TRACY_FUNC(sceFiosCancelAllOps);
+    cancel_all_fios_ops(emuenv.io.fios);
+    return SCE_FIOS_OK;
 }
 
 EXPORT(int, sceFiosChangeStat) {
@@ -106,7 +509,17 @@ EXPORT(int, sceFiosChangeStatSync) {
 }
 
 EXPORT(int, sceFiosCloseAllFiles) {
-    return UNIMPLEMENTED();
+    TRACY_FUNC(sceFiosCloseAllFiles);
+    std::vector<SceFiosFH> handles;
+    {
+        const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+        for (const auto &[fh, file] : emuenv.io.fios.files)
+            handles.push_back(fh);
+    }
+
+    for (const SceFiosFH fh : handles)
+        wait_and_delete_op(emuenv, submit_close(emuenv, nullptr, fh, export_name));
+    return SCE_FIOS_OK;
 }
 
 EXPORT(int, sceFiosDHClose) {
@@ -237,12 +650,14 @@ EXPORT(int, sceFiosExistsSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHClose) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHClose, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosFHClose, pAttr, fh);
+    return submit_close(emuenv, pAttr, fh, export_name);
 }
 
-EXPORT(int, sceFiosFHCloseSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFHCloseSync, const SceFiosOpAttr *pAttr, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosFHCloseSync, pAttr, fh);
+    return to_error(wait_and_delete_op(emuenv, submit_close(emuenv, pAttr, fh, export_name)));
 }
 
 EXPORT(int, sceFiosFHGetOpenParams) {
@@ -253,8 +668,12 @@ EXPORT(int, sceFiosFHGetPath) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHGetSize) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHGetSize, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosFHGetSize, fh);
+    FiosFile file;
+    if (!get_file(emuenv, fh, file))
+        return SCE_FIOS_ERROR_BAD_FH;
+    return file.size;
 }
 
 EXPORT(int, sceFiosFHIoctl) {
@@ -265,44 +684,76 @@ EXPORT(int, sceFiosFHIoctlSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHOpen) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHOpen, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams) {
+    TRACY_FUNC(sceFiosFHOpen, pAttr, pOutFH, pPath, pOpenParams);
+    return submit_open(emuenv, pAttr, pOutFH, pPath, pOpenParams, export_name);
 }
 
-EXPORT(int, sceFiosFHOpenSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFHOpenSync, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams) {
+    TRACY_FUNC(sceFiosFHOpenSync, pAttr, pOutFH, pPath, pOpenParams);
+    return to_error(wait_and_delete_op(emuenv, submit_open(emuenv, pAttr, pOutFH, pPath, pOpenParams, export_name)));
 }
 
-EXPORT(int, sceFiosFHOpenWithMode) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHOpenWithMode, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams, int32_t nativeMode) {
+    TRACY_FUNC(sceFiosFHOpenWithMode, pAttr, pOutFH, pPath, pOpenParams, nativeMode);
+    return submit_open(emuenv, pAttr, pOutFH, pPath, pOpenParams, export_name);
 }
 
-EXPORT(int, sceFiosFHOpenWithModeSync) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosFHOpenWithModeSync, const SceFiosOpAttr *pAttr, SceFiosFH *pOutFH, const char *pPath, const SceFiosOpenParams *pOpenParams, int32_t nativeMode) {
+    TRACY_FUNC(sceFiosFHOpenWithModeSync, pAttr, pOutFH, pPath, pOpenParams, nativeMode);
+    return to_error(wait_and_delete_op(emuenv, submit_open(emuenv, pAttr, pOutFH, pPath, pOpenParams, export_name)));
 }
 
-EXPORT(int, sceFiosFHPread) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHPread, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    TRACY_FUNC(sceFiosFHPread, pAttr, fh, pBuf, length, offset);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return submit_read(emuenv, pAttr, fh, single_buffer(pBuf, length), offset, export_name);
 }
 
-EXPORT(int, sceFiosFHPreadSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHPreadSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    TRACY_FUNC(sceFiosFHPreadSync, pAttr, fh, pBuf, length, offset);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return wait_and_delete_op(emuenv, submit_read(emuenv, pAttr, fh, single_buffer(pBuf, length), offset, export_name));
 }
 
-EXPORT(int, sceFiosFHPreadv) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHPreadv, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosBuffer *iov, int iovcnt, SceFiosOffset offset) {
+    TRACY_FUNC(sceFiosFHPreadv, pAttr, fh, iov, iovcnt, offset);
+    std::vector<FiosIoVec> buffers;
+    if (!get_buffers(emuenv, iov, iovcnt, buffers))
+        return SCE_FIOS_ERROR_BAD_IOVCNT;
+    return submit_read(emuenv, pAttr, fh, std::move(buffers), offset, export_name);
 }
 
-EXPORT(int, sceFiosFHPreadvSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHPreadvSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosBuffer *iov, int iovcnt, SceFiosOffset offset) {
+    TRACY_FUNC(sceFiosFHPreadvSync, pAttr, fh, iov, iovcnt, offset);
+    std::vector<FiosIoVec> buffers;
+    if (!get_buffers(emuenv, iov, iovcnt, buffers))
+        return SCE_FIOS_ERROR_BAD_IOVCNT;
+    return wait_and_delete_op(emuenv, submit_read(emuenv, pAttr, fh, std::move(buffers), offset, export_name));
 }
 
-EXPORT(int, sceFiosFHPwrite) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHPwrite, const SceFiosOpAttr *pAttr, SceFiosFH fh, const void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    TRACY_FUNC(sceFiosFHPwrite, pAttr, fh, pBuf, length, offset);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return submit_write(emuenv, pAttr, fh, single_buffer(const_cast<void *>(pBuf), length), offset, export_name);
 }
 
-EXPORT(int, sceFiosFHPwriteSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHPwriteSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, const void *pBuf, SceFiosSize length, SceFiosOffset offset) {
+    TRACY_FUNC(sceFiosFHPwriteSync, pAttr, fh, pBuf, length, offset);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return wait_and_delete_op(emuenv, submit_write(emuenv, pAttr, fh, single_buffer(const_cast<void *>(pBuf), length), offset, export_name));
 }
 
 EXPORT(int, sceFiosFHPwritev) {
@@ -313,24 +764,66 @@ EXPORT(int, sceFiosFHPwritevSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHRead) {
-    return UNIMPLEMENTED();
-}
-
-EXPORT(int, sceFiosFHReadSync) {
-    return UNIMPLEMENTED();
-}
-
-EXPORT(int, sceFiosFHReadv) {
-    return UNIMPLEMENTED();
-}
-
-EXPORT(int, sceFiosFHReadvSync) {
-    return UNIMPLEMENTED();
-}
-
-EXPORT(int, sceFiosFHSeek) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHRead, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length) {
+    TRACY_FUNC(sceFiosFHRead, pAttr, fh, pBuf, length);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return submit_read(emuenv, pAttr, fh, single_buffer(pBuf, length), -1, export_name);
+}
+
+EXPORT(SceFiosSize, sceFiosFHReadSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, void *pBuf, SceFiosSize length) {
+    TRACY_FUNC(sceFiosFHReadSync, pAttr, fh, pBuf, length);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return wait_and_delete_op(emuenv, submit_read(emuenv, pAttr, fh, single_buffer(pBuf, length), -1, export_name));
+}
+
+EXPORT(SceFiosOp, sceFiosFHReadv, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosBuffer *iov, int iovcnt) {
+    TRACY_FUNC(sceFiosFHReadv, pAttr, fh, iov, iovcnt);
+    std::vector<FiosIoVec> buffers;
+    if (!get_buffers(emuenv, iov, iovcnt, buffers))
+        return SCE_FIOS_ERROR_BAD_IOVCNT;
+    return submit_read(emuenv, pAttr, fh, std::move(buffers), -1, export_name);
+}
+
+EXPORT(SceFiosSize, sceFiosFHReadvSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, const SceFiosBuffer *iov, int iovcnt) {
+    TRACY_FUNC(sceFiosFHReadvSync, pAttr, fh, iov, iovcnt);
+    std::vector<FiosIoVec> buffers;
+    if (!get_buffers(emuenv, iov, iovcnt, buffers))
+        return SCE_FIOS_ERROR_BAD_IOVCNT;
+    return wait_and_delete_op(emuenv, submit_read(emuenv, pAttr, fh, std::move(buffers), -1, export_name));
+}
+
+EXPORT(SceFiosOffset, sceFiosFHSeek, SceFiosFH fh, SceFiosOffset offset, SceFiosWhence whence) {
+    TRACY_FUNC(sceFiosFHSeek, fh, offset, whence);
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    const auto file = emuenv.io.fios.files.find(fh);
+    if (file == emuenv.io.fios.files.end())
+        return SCE_FIOS_ERROR_BAD_FH;
+
+    SceFiosOffset base;
+    switch (whence) {
+    case SCE_FIOS_SEEK_SET:
+        base = 0;
+        break;
+    case SCE_FIOS_SEEK_CUR:
+        base = file->second.pos;
+        break;
+    case SCE_FIOS_SEEK_END:
+        base = file->second.size;
+        break;
+    default:
+        return SCE_FIOS_ERROR_BAD_OFFSET;
+    }
+
+    if (base + offset < 0)
+        return SCE_FIOS_ERROR_BAD_OFFSET;
+    file->second.pos = base + offset;
+    return file->second.pos;
 }
 
 EXPORT(int, sceFiosFHStat) {
@@ -349,8 +842,12 @@ EXPORT(int, sceFiosFHSyncSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHTell) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOffset, sceFiosFHTell, SceFiosFH fh) {
+    TRACY_FUNC(sceFiosFHTell, fh);
+    FiosFile file;
+    if (!get_file(emuenv, fh, file))
+        return SCE_FIOS_ERROR_BAD_FH;
+    return file.pos;
 }
 
 EXPORT(int, sceFiosFHToFileno) {
@@ -365,12 +862,22 @@ EXPORT(int, sceFiosFHTruncateSync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosFHWrite) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOp, sceFiosFHWrite, const SceFiosOpAttr *pAttr, SceFiosFH fh, const void *pBuf, SceFiosSize length) {
+    TRACY_FUNC(sceFiosFHWrite, pAttr, fh, pBuf, length);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return submit_write(emuenv, pAttr, fh, single_buffer(const_cast<void *>(pBuf), length), -1, export_name);
 }
 
-EXPORT(int, sceFiosFHWriteSync) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosFHWriteSync, const SceFiosOpAttr *pAttr, SceFiosFH fh, const void *pBuf, SceFiosSize length) {
+    TRACY_FUNC(sceFiosFHWriteSync, pAttr, fh, pBuf, length);
+    if (!pBuf)
+        return SCE_FIOS_ERROR_BAD_PTR;
+    if (length < 0)
+        return SCE_FIOS_ERROR_BAD_SIZE;
+    return wait_and_delete_op(emuenv, submit_write(emuenv, pAttr, fh, single_buffer(const_cast<void *>(pBuf), length), -1, export_name));
 }
 
 EXPORT(int, sceFiosFHWritev) {
@@ -445,12 +952,21 @@ EXPORT(int, sceFiosGetAllOps) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosGetDefaultOpAttr) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosGetDefaultOpAttr, SceFiosOpAttr *pOutAttr) {
+    TRACY_FUNC(sceFiosGetDefaultOpAttr, pOutAttr);
+    if (!pOutAttr)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    *pOutAttr = {};
+    pOutAttr->deadline = emuenv.io.fios.default_deadline;
+    pOutAttr->priority = emuenv.io.fios.default_priority;
+    return true;
 }
 
-EXPORT(int, sceFiosGetGlobalDefaultOpAttr) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosGetGlobalDefaultOpAttr, SceFiosOpAttr *pOutAttr) {
+    TRACY_FUNC(sceFiosGetGlobalDefaultOpAttr, pOutAttr);
+    return CALL_EXPORT(sceFiosGetDefaultOpAttr, pOutAttr);
 }
 
 EXPORT(int, sceFiosGetSuspendCount) {
@@ -477,36 +993,57 @@ EXPORT(int, sceFiosIOFilterRemove) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosInitialize) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosInitialize, const void *pParameters) {
+    TRACY_FUNC(sceFiosInitialize, pParameters);
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    emuenv.io.fios.initialized = true;
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosIsIdle) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosIsIdle) {
+    TRACY_FUNC(sceFiosIsIdle);
+    return is_fios_idle(emuenv.io.fios);
 }
 
-EXPORT(int, sceFiosIsInitialized) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosIsInitialized, void *pOutParameters) {
+    TRACY_FUNC(sceFiosIsInitialized, pOutParameters);
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return emuenv.io.fios.initialized;
 }
 
 EXPORT(int, sceFiosIsSuspended) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosIsValidHandle) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosIsValidHandle, SceUID h) {
+    TRACY_FUNC(sceFiosIsValidHandle, h);
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return emuenv.io.fios.files.contains(h) || emuenv.io.fios.ops.contains(h);
 }
 
-EXPORT(int, sceFiosOpCancel) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpCancel, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpCancel, op);
+    if (!get_fios_op(emuenv.io.fios, op))
+        return SCE_FIOS_ERROR_BAD_OP;
+    // an operation already started is completed normally
+    cancel_fios_op(emuenv.io.fios, op);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosOpDelete) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpDelete, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpDelete, op);
+    delete_fios_op(emuenv.io.fios, op);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosOpGetActualCount) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosOpGetActualCount, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpGetActualCount, op);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return fios_op->done && fios_op->result > 0 ? fios_op->result : 0;
 }
 
 EXPORT(int, sceFiosOpGetAttr) {
@@ -517,52 +1054,108 @@ EXPORT(int, sceFiosOpGetBuffer) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosOpGetError) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpGetError, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpGetError, op);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return fios_op->done ? to_error(fios_op->result) : SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosOpGetOffset) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosOffset, sceFiosOpGetOffset, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpGetOffset, op);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return fios_op->offset;
 }
 
 EXPORT(int, sceFiosOpGetPath) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosOpGetRequestCount) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosOpGetRequestCount, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpGetRequestCount, op);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return fios_op->requested_size();
 }
 
-EXPORT(int, sceFiosOpIsCancelled) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosOpIsCancelled, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpIsCancelled, op);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return fios_op->cancelled;
 }
 
-EXPORT(int, sceFiosOpIsDone) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosOpIsDone, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpIsDone, op);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    return fios_op->done;
 }
 
-EXPORT(int, sceFiosOpReschedule) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpReschedule, SceFiosOp op, SceFiosTime newDeadline) {
+    TRACY_FUNC(sceFiosOpReschedule, op, newDeadline);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+    reschedule_fios_op(emuenv.io.fios, op, newDeadline, fios_op->priority);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosOpRescheduleWithPriority) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpRescheduleWithPriority, SceFiosOp op, SceFiosTime newDeadline, int8_t newPriority) {
+    TRACY_FUNC(sceFiosOpRescheduleWithPriority, op, newDeadline, newPriority);
+    if (!get_fios_op(emuenv.io.fios, op))
+        return SCE_FIOS_ERROR_BAD_OP;
+    reschedule_fios_op(emuenv.io.fios, op, newDeadline, newPriority);
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosOpSyncWait) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpSyncWait, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpSyncWait, op);
+    if (!get_fios_op(emuenv.io.fios, op))
+        return SCE_FIOS_ERROR_BAD_OP;
+    return to_error(wait_and_delete_op(emuenv, op));
 }
 
-EXPORT(int, sceFiosOpSyncWaitForIO) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosSize, sceFiosOpSyncWaitForIO, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpSyncWaitForIO, op);
+    if (!get_fios_op(emuenv.io.fios, op))
+        return SCE_FIOS_ERROR_BAD_OP;
+    return wait_and_delete_op(emuenv, op);
 }
 
-EXPORT(int, sceFiosOpWait) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpWait, SceFiosOp op) {
+    TRACY_FUNC(sceFiosOpWait, op);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+    wait_fios_op(emuenv.io.fios, *fios_op);
+    return to_error(fios_op->result);
 }
 
-EXPORT(int, sceFiosOpWaitUntil) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceFiosOpWaitUntil, SceFiosOp op, SceFiosTime deadline) {
+    TRACY_FUNC(sceFiosOpWaitUntil, op, deadline);
+    const FiosOpPtr fios_op = get_fios_op(emuenv.io.fios, op);
+    if (!fios_op)
+        return SCE_FIOS_ERROR_BAD_OP;
+    if (!wait_fios_op(emuenv.io.fios, *fios_op, deadline))
+        return SCE_FIOS_ERROR_TIMEOUT;
+    return to_error(fios_op->result);
 }
 
 EXPORT(int, sceFiosOverlayAdd) {
@@ -625,12 +1218,23 @@ EXPORT(int, sceFiosResume) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceFiosSetGlobalDefaultOpAttr) {
-    return UNIMPLEMENTED();
+EXPORT(bool, sceFiosSetGlobalDefaultOpAttr, const SceFiosOpAttr *pAttr) {
+    TRACY_FUNC(sceFiosSetGlobalDefaultOpAttr, pAttr);
+    if (!pAttr)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    emuenv.io.fios.default_deadline = pAttr->deadline;
+    emuenv.io.fios.default_priority = static_cast<int8_t>(pAttr->priority);
+    return true;
 }
 
+DECL_EXPORT(int, sceFiosTerminate);
+
 EXPORT(int, sceFiosShutdownAndCancelOps) {
-    return UNIMPLEMENTED();
+    TRACY_FUNC(sceFiosShutdownAndCancelOps);
+    cancel_all_fios_ops(emuenv.io.fios);
+    return CALL_EXPORT(sceFiosTerminate);
 }
 
 EXPORT(int, sceFiosStat) {
@@ -666,19 +1270,29 @@ EXPORT(int, sceFiosSyncSync) {
 }
 
 EXPORT(int, sceFiosTerminate) {
-    return UNIMPLEMENTED();
+    TRACY_FUNC(sceFiosTerminate);
+    CALL_EXPORT(sceFiosCloseAllFiles);
+    flush_fios_cache(emuenv.io.fios, "");
+
+    const std::lock_guard<std::mutex> lock(emuenv.io.fios.mutex);
+    emuenv.io.fios.initialized = false;
+    return SCE_FIOS_OK;
 }
 
-EXPORT(int, sceFiosTimeGetCurrent) {
-    return UNIMPLEMENTED();
+EXPORT(SceFiosTime, sceFiosTimeGetCurrent) {
+    TRACY_FUNC(sceFiosTimeGetCurrent);
+    return fios_time_now();
 }
 
-EXPORT(int, sceFiosTimeIntervalFromNanoseconds) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt64, sceFiosTimeIntervalFromNanoseconds, SceInt64 ns) {
+    TRACY_FUNC(sceFiosTimeIntervalFromNanoseconds, ns);
+    // the times are in nanoseconds
+    return ns;
 }
 
-EXPORT(int, sceFiosTimeIntervalToNanoseconds) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt64, sceFiosTimeIntervalToNanoseconds, SceInt64 interval) {
+    TRACY_FUNC(sceFiosTimeIntervalToNanoseconds, interval);
+    return interval;
 }
 
 EXPORT(int, sceFiosUpdateParameters) {
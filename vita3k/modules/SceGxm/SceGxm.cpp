@@ -17,8 +17,11 @@
 
 #include "SceGxm.h"
 
+#include "../SceDisplay/SceDisplay.h"
+
 #include <modules/module_parent.h>
 
+#include <bitset>
 #include <span>
 #include <xxh3.h>
 
@@ -26,9 +29,13 @@
 #include <gxm/state.h>
 #include <gxm/types.h>
 #include <kernel/state.h>
+#include <mem/functions.h>
 #include <mem/state.h>
 
 #include <SDL.h>
+#include <config/state.h>
+#include <cpu/functions.h>
+#include <display/state.h>
 #include <io/state.h>
 #include <mem/allocator.h>
 #include <mem/mempool.h>
@@ -36,6 +43,7 @@
 #include <renderer/state.h>
 #include <renderer/types.h>
 #include <util/bytes.h>
+#include <util/host_thread.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 #include <util/string_utils.h>
@@ -888,10 +896,9 @@ std::string to_debug_str<SceGxmTransferFlags>(const MemState &mem, SceGxmTransfe
 }
 
 static Ptr<void> gxmRunDeferredMemoryCallback(KernelState &kernel, const MemState &mem, std::mutex &global_lock, std::uint32_t &return_size, Ptr<SceGxmDeferredContextCallback> callback, Ptr<void> userdata,
-    const std::uint32_t size, const SceUID thread_id) {
+    const std::uint32_t size, const ThreadStatePtr &thread) {
     const std::lock_guard<std::mutex> guard(global_lock);
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
     const Address final_size_addr = stack_alloc(*thread->cpu, 4);
 
     Ptr<void> result(static_cast<Address>(thread->run_callback(callback.address(),
@@ -944,6 +951,7 @@ struct SceGxmContext {
     // for immediate context only
     // we use the fact that everything is done in an ordered manner
     // (i.e if command a is allocated before b, then it is freed before b)
+    // commands are packed in the vdm buffer, these are byte positions,
     // the real positions are these ones modulo command_allocator_size
     size_t command_next_free_pos;
     // this one is atomic as it is read from one thread and written to by another
@@ -1028,7 +1036,7 @@ struct SceGxmContext {
         curr_command_list->memory_ranges.push(it);
     }
 
-    bool make_new_alloc_space(KernelState &kern, const MemState &mem, const SceUID thread_id, bool force = false) {
+    bool make_new_alloc_space(KernelState &kern, const MemState &mem, const ThreadStatePtr &thread, bool force = false) {
         if (alloc_space && (state.type == SCE_GXM_CONTEXT_TYPE_IMMEDIATE)) {
             return false;
         }
@@ -1050,9 +1058,13 @@ struct SceGxmContext {
             actual_size = state.vdm_buffer_size;
 
             if (state.type == SCE_GXM_CONTEXT_TYPE_IMMEDIATE) {
-                command_allocator_size = state.vdm_buffer_size / sizeof(renderer::Command);
+                // keep the commands aligned
+                const uintptr_t aligned_space = align(reinterpret_cast<uintptr_t>(alloc_space), renderer::COMMAND_ALIGNMENT);
+                actual_size -= static_cast<uint32_t>(aligned_space - reinterpret_cast<uintptr_t>(alloc_space));
+                alloc_space = reinterpret_cast<uint8_t *>(aligned_space);
+                command_allocator_size = align_down(actual_size, renderer::COMMAND_ALIGNMENT);
                 command_next_free_pos = 0;
-                command_last_free_pos = command_allocator_size - 1;
+                command_last_free_pos = command_allocator_size;
             } else {
                 // setting the vdm buffer size to 0 means we are using it
                 state.vdm_buffer_size = 0;
@@ -1061,7 +1073,7 @@ struct SceGxmContext {
             constexpr uint32_t DEFAULT_SIZE = 1024;
 
             Ptr<void> space = gxmRunDeferredMemoryCallback(kern, mem, callback_lock, actual_size, state.vdm_memory_callback,
-                state.memory_callback_userdata, DEFAULT_SIZE, thread_id);
+                state.memory_callback_userdata, DEFAULT_SIZE, thread);
 
             if (!space) {
                 LOG_ERROR("VDM callback runs out of memory!");
@@ -1076,7 +1088,7 @@ struct SceGxmContext {
         return true;
     }
 
-    std::uint8_t *linearly_allocate(KernelState &kern, const MemState &mem, const SceUID thread_id, const std::uint32_t size) {
+    std::uint8_t *linearly_allocate(KernelState &kern, const MemState &mem, const ThreadStatePtr &thread, const std::uint32_t size) {
         if (state.type != SCE_GXM_CONTEXT_TYPE_DEFERRED) {
             return nullptr;
         }
@@ -1086,7 +1098,7 @@ struct SceGxmContext {
         constexpr uint32_t allocated_on_vdm = 4;
 
         if (alloc_space + allocated_on_vdm > alloc_space_end) {
-            if (!make_new_alloc_space(kern, mem, thread_id, true)) {
+            if (!make_new_alloc_space(kern, mem, thread, true)) {
                 return nullptr;
             }
         }
@@ -1098,39 +1110,54 @@ struct SceGxmContext {
     }
 
     template <typename T>
-    T *linearly_allocate(KernelState &kern, const MemState &mem, const SceUID thread_id) {
-        return reinterpret_cast<T *>(linearly_allocate(kern, mem, thread_id, sizeof(T)));
+    T *linearly_allocate(KernelState &kern, const MemState &mem, const ThreadStatePtr &thread) {
+        return reinterpret_cast<T *>(linearly_allocate(kern, mem, thread, sizeof(T)));
     }
 
-    renderer::Command *allocate_new_command(KernelState &kern, const MemState &mem, SceUID current_thread_id) {
+    renderer::Command *allocate_new_command(KernelState &kern, const MemState &mem, const ThreadStatePtr &thread, const size_t data_size) {
         renderer::Command *new_command = nullptr;
+        const size_t command_size = renderer::get_command_alloc_size(data_size);
 
         if (state.type == SCE_GXM_CONTEXT_TYPE_IMMEDIATE) {
-            if (command_allocator_size > 0 && command_next_free_pos <= command_last_free_pos) {
-                size_t offset = command_next_free_pos % command_allocator_size;
-                command_next_free_pos++;
-                new_command = reinterpret_cast<renderer::Command *>(alloc_space) + offset;
+            size_t offset = command_allocator_size > 0 ? command_next_free_pos % command_allocator_size : 0;
+            // a command can't wrap around the end of the buffer, the space left there is given to it
+            const size_t padding = (offset + command_size > command_allocator_size) ? command_allocator_size - offset : 0;
+            const size_t alloc_size = padding + command_size;
+
+            if (command_allocator_size > 0 && command_size <= command_allocator_size
+                && command_next_free_pos + alloc_size <= command_last_free_pos) {
+                if (padding > 0)
+                    offset = 0;
+                command_next_free_pos += alloc_size;
+                new_command = reinterpret_cast<renderer::Command *>(alloc_space + offset);
                 new (new_command) renderer::Command;
+                new_command->alloc_size = static_cast<uint32_t>(alloc_size);
             } else {
-                new_command = new renderer::Command;
+                new_command = renderer::generic_command_allocate(data_size);
+                if (!new_command)
+                    return nullptr;
                 new_command->flags |= renderer::Command::FLAG_FROM_HOST;
+                return new_command;
             }
         } else {
-            new_command = linearly_allocate<renderer::Command>(kern, mem, current_thread_id);
+            new_command = reinterpret_cast<renderer::Command *>(linearly_allocate(kern, mem, thread, static_cast<uint32_t>(command_size)));
+            if (!new_command)
+                return nullptr;
 
             new (new_command) renderer::Command;
             new_command->flags |= renderer::Command::FLAG_NO_FREE;
         }
 
+        new_command->size = static_cast<uint16_t>(data_size);
         return new_command;
     }
 
     void free_new_command(renderer::Command *cmd) {
         if (!(cmd->flags & renderer::Command::FLAG_NO_FREE)) {
             if (cmd->flags & renderer::Command::FLAG_FROM_HOST) {
-                delete cmd;
+                renderer::generic_command_free(cmd);
             } else {
-                command_last_free_pos++;
+                command_last_free_pos += cmd->alloc_size;
             }
         }
     }
@@ -1376,7 +1403,7 @@ EXPORT(int, sceGxmBeginCommandList, SceGxmContext *deferredContext) {
 
     deferredContext->curr_command_list = new SceGxmCommandList();
 
-    if (!deferredContext->make_new_alloc_space(emuenv.kernel, emuenv.mem, thread_id)) {
+    if (!deferredContext->make_new_alloc_space(emuenv.kernel, emuenv.mem, thread)) {
         return RET_ERROR(SCE_GXM_ERROR_RESERVE_FAILED);
     }
 
@@ -1385,7 +1412,7 @@ EXPORT(int, sceGxmBeginCommandList, SceGxmContext *deferredContext) {
 
     if (!deferredContext->state.vertex_ring_buffer) {
         deferredContext->state.vertex_ring_buffer = gxmRunDeferredMemoryCallback(emuenv.kernel, emuenv.mem, emuenv.gxm.callback_lock, deferredContext->state.vertex_ring_buffer_size,
-            deferredContext->state.vertex_memory_callback, deferredContext->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread_id);
+            deferredContext->state.vertex_memory_callback, deferredContext->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread);
 
         if (!deferredContext->state.vertex_ring_buffer) {
             return RET_ERROR(SCE_GXM_ERROR_RESERVE_FAILED);
@@ -1394,7 +1421,7 @@ EXPORT(int, sceGxmBeginCommandList, SceGxmContext *deferredContext) {
 
     if (!deferredContext->state.fragment_ring_buffer) {
         deferredContext->state.fragment_ring_buffer = gxmRunDeferredMemoryCallback(emuenv.kernel, emuenv.mem, emuenv.gxm.callback_lock, deferredContext->state.fragment_ring_buffer_size,
-            deferredContext->state.fragment_memory_callback, deferredContext->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread_id);
+            deferredContext->state.fragment_memory_callback, deferredContext->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread);
 
         if (!deferredContext->state.fragment_ring_buffer) {
             return RET_ERROR(SCE_GXM_ERROR_RESERVE_FAILED);
@@ -1405,8 +1432,8 @@ EXPORT(int, sceGxmBeginCommandList, SceGxmContext *deferredContext) {
     KernelState *kernel = &emuenv.kernel;
     MemState *mem = &emuenv.mem;
 
-    deferredContext->renderer->alloc_func = [deferredContext, kernel, mem, thread_id]() {
-        return deferredContext->allocate_new_command(*kernel, *mem, thread_id);
+    deferredContext->renderer->alloc_func = [deferredContext, kernel, mem, thread](size_t data_size) {
+        return deferredContext->allocate_new_command(*kernel, *mem, thread, data_size);
     };
 
     deferredContext->renderer->free_func = [](renderer::Command *cmd) {
@@ -1743,15 +1770,15 @@ EXPORT(int, sceGxmCreateContext, const SceGxmContextParams *params, Ptr<SceGxmCo
     ctx->state.vdm_buffer = params->vdmRingBufferMem;
     ctx->state.vdm_buffer_size = params->vdmRingBufferMemSize;
 
-    ctx->make_new_alloc_space(emuenv.kernel, emuenv.mem, thread_id);
+    ctx->make_new_alloc_space(emuenv.kernel, emuenv.mem, thread);
 
     // Set command allocate functions
     // The command buffer will not be reallocated, so this is fine to use this thread ID
     KernelState *kernel = &emuenv.kernel;
     MemState *mem = &emuenv.mem;
 
-    ctx->renderer->alloc_func = [ctx, kernel, mem, thread_id]() {
-        return ctx->allocate_new_command(*kernel, *mem, thread_id);
+    ctx->renderer->alloc_func = [ctx, kernel, mem, thread](size_t data_size) {
+        return ctx->allocate_new_command(*kernel, *mem, thread, data_size);
     };
 
     ctx->renderer->free_func = [ctx](renderer::Command *cmd) {
@@ -2013,7 +2040,7 @@ EXPORT(int, sceGxmDisplayQueueAddEntry, Ptr<SceGxmSyncObject> oldBuffer, Ptr<Sce
     if (newBuffer == emuenv.gxm.last_fbo_sync_object) {
         // don't know why, some games like NFS send twice in a row the same buffer to the front...
         // act like it is not displaying anymore
-        renderer::subject_done(newBufferSync, newBufferSync->last_display);
+        renderer::subject_done(*emuenv.renderer, newBufferSync, newBufferSync->last_display);
     }
 
     newBufferSync->last_display = newBufferSync->timestamp_ahead;
@@ -2044,7 +2071,9 @@ EXPORT(int, sceGxmDisplayQueueFinish) {
     return 0;
 }
 
-static void gxmSetUniformBuffers(renderer::State &state, GxmState &gxm, SceGxmContext *context, const SceGxmProgram &program, std::span<UniformBuffer> buffers, const UniformBufferSizes &sizes, KernelState &kern, const MemState &mem, const SceUID current_thread) {
+// get the uniform buffers read by the program with the number of bytes to copy from them, returns how many were written to out
+static size_t gxmGetUniformBuffers(GxmState &gxm, const SceGxmProgram &program, std::span<UniformBuffer> buffers, const UniformBufferSizes &sizes, renderer::PrecomputedUniformBuffer *out) {
+    size_t count = 0;
     for (size_t i = 0; i < buffers.size(); i++) {
         if (!buffers[i] || sizes.at(i) == 0) {
             continue;
@@ -2069,11 +2098,69 @@ static void gxmSetUniformBuffers(renderer::State &state, GxmState &gxm, SceGxmCo
                 }
             }
         }
-        renderer::set_uniform_buffer(state, context->renderer.get(), !program.is_fragment(), i, bytes_to_copy, buffers[i]);
+        out[count++] = { !program.is_fragment(), static_cast<int>(i), static_cast<std::uint16_t>(bytes_to_copy), buffers[i] };
+    }
+
+    return count;
+}
+
+static void gxmSetUniformBuffers(renderer::State &state, GxmState &gxm, SceGxmContext *context, const SceGxmProgram &program, std::span<UniformBuffer> buffers, const UniformBufferSizes &sizes, KernelState &kern, const MemState &mem, const SceUID current_thread) {
+    std::array<renderer::PrecomputedUniformBuffer, std::tuple_size_v<UniformBufferSizes>> uniform_buffers;
+    const size_t count = gxmGetUniformBuffers(gxm, program, buffers, sizes, uniform_buffers.data());
+    for (size_t i = 0; i < count; i++) {
+        const renderer::PrecomputedUniformBuffer &uniform_buffer = uniform_buffers[i];
+        renderer::set_uniform_buffer(state, context->renderer.get(), uniform_buffer.is_vertex, uniform_buffer.block_num, uniform_buffer.size, uniform_buffer.buffer);
+    }
+}
+
+// bake the streams read by the attributes of the program, so that a draw does not have to go through them
+static void gxmBakeVertexStreams(SceGxmVertexProgram &program) {
+    for (const SceGxmVertexAttribute &attribute : program.attributes) {
+        const SceGxmAttributeFormat attribute_format = static_cast<SceGxmAttributeFormat>(attribute.format);
+        const uint32_t attribute_size = gxm::attribute_format_size(attribute_format) * attribute.componentCount;
+        program.stream_used |= (1 << attribute.streamIndex);
+        program.stream_element_size[attribute.streamIndex] = std::max<uint32_t>(program.stream_element_size[attribute.streamIndex], attribute.offset + attribute_size);
     }
 }
 
-static int gxmDrawElementGeneral(EmuEnvState &emuenv, const char *export_name, const SceUID thread_id, SceGxmContext *context, SceGxmPrimitiveType primType, SceGxmIndexFormat indexType, Ptr<const void> indexData, uint32_t indexCount, uint32_t instanceCount) {
+// size of the data read from a vertex stream by a draw
+static size_t gxmGetVertexStreamSize(const SceGxmVertexProgram &program, const size_t stream_index, const size_t max_index, const uint32_t instance_count) {
+    const SceGxmVertexStream &stream = program.streams[stream_index];
+    const SceGxmIndexSource index_source = static_cast<SceGxmIndexSource>(stream.indexSource);
+    const size_t data_passed_length = gxm::is_stream_instancing(index_source) ? ((instance_count - 1) * stream.stride) : (max_index * stream.stride);
+    return program.stream_element_size[stream_index] + data_passed_length;
+}
+
+// index buffers with less indices are scanned every time, this is faster than tracking their writes
+static constexpr uint32_t MAX_INDEX_CACHE_MIN_COUNT = 1024;
+static constexpr size_t MAX_INDEX_CACHE_MAX_ENTRIES = 4096;
+
+// get the biggest index used by a draw, used to know the size of the vertex streams to copy
+static uint32_t get_max_index(EmuEnvState &emuenv, Ptr<const void> indices, uint32_t count, SceGxmIndexFormat format) {
+    const void *indices_ptr = indices.get(emuenv.mem);
+    if (count < MAX_INDEX_CACHE_MIN_COUNT)
+        return gxm::get_max_index(indices_ptr, count, format);
+
+    // the index count of a draw is always less than 2^31
+    const uint64_t key = (static_cast<uint64_t>(indices.address()) << 32) | (count << 1) | (format == SCE_GXM_INDEX_FORMAT_U32);
+    const uint32_t size = count * gxm::index_element_size(format);
+
+    const std::lock_guard<std::mutex> lock(emuenv.gxm.max_index_cache_mutex);
+    auto it = emuenv.gxm.max_index_cache.find(key);
+    if (it != emuenv.gxm.max_index_cache.end() && !is_range_written(emuenv.mem, indices.address(), size, it->second.write_stamp))
+        return it->second.max_index;
+
+    if (emuenv.gxm.max_index_cache.size() >= MAX_INDEX_CACHE_MAX_ENTRIES)
+        emuenv.gxm.max_index_cache.clear();
+
+    // start tracking the writes before reading the indices so that none is missed
+    MaxIndexCacheEntry &entry = emuenv.gxm.max_index_cache[key];
+    entry.write_stamp = track_writes(emuenv.mem, indices.address(), size);
+    entry.max_index = gxm::get_max_index(indices_ptr, count, format);
+    return entry.max_index;
+}
+
+static int gxmDrawElementGeneral(EmuEnvState &emuenv, const char *export_name, const ThreadStatePtr &thread, SceGxmContext *context, SceGxmPrimitiveType primType, SceGxmIndexFormat indexType, Ptr<const void> indexData, uint32_t indexCount, uint32_t instanceCount) {
     if (!context || !indexData)
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
 
@@ -2096,12 +2183,10 @@ static int gxmDrawElementGeneral(EmuEnvState &emuenv, const char *export_name, c
     const SceGxmProgram &vertex_program_gxp = *gxm_vertex_program.program.get(emuenv.mem);
     const SceGxmProgram &fragment_program_gxp = *gxm_fragment_program.program.get(emuenv.mem);
 
-    const void *indices_ptr = indexData.get(emuenv.mem);
-
     gxmSetUniformBuffers(*emuenv.renderer, emuenv.gxm, context, vertex_program_gxp, context->state.vertex_uniform_buffers, gxm_vertex_program.renderer_data->uniform_buffer_sizes,
-        emuenv.kernel, emuenv.mem, thread_id);
+        emuenv.kernel, emuenv.mem, thread->id);
     gxmSetUniformBuffers(*emuenv.renderer, emuenv.gxm, context, fragment_program_gxp, context->state.fragment_uniform_buffers, gxm_fragment_program.renderer_data->uniform_buffer_sizes,
-        emuenv.kernel, emuenv.mem, thread_id);
+        emuenv.kernel, emuenv.mem, thread->id);
 
     if (context->last_precomputed) {
         // Need to re-set the data
@@ -2133,36 +2218,14 @@ static int gxmDrawElementGeneral(EmuEnvState &emuenv, const char *export_name, c
     size_t max_index = 0;
     if (!emuenv.renderer->features.support_memory_mapping) {
         // we don't need to get the vertex buffer size with memory mapping
-        if (indexType == SCE_GXM_INDEX_FORMAT_U16) {
-            const uint16_t *const data = reinterpret_cast<const uint16_t *>(indices_ptr);
-            max_index = *std::max_element(&data[0], &data[indexCount]);
-        } else {
-            const uint32_t *const data = reinterpret_cast<const uint32_t *>(indices_ptr);
-            max_index = *std::max_element(&data[0], &data[indexCount]);
-        }
-    }
-
-    size_t max_data_length[SCE_GXM_MAX_VERTEX_STREAMS] = {};
-    std::uint32_t stream_used = 0;
-    for (const SceGxmVertexAttribute &attribute : gxm_vertex_program.attributes) {
-        if (!emuenv.renderer->features.support_memory_mapping) {
-            const SceGxmAttributeFormat attribute_format = static_cast<SceGxmAttributeFormat>(attribute.format);
-            const size_t attribute_size = gxm::attribute_format_size(attribute_format) * attribute.componentCount;
-            const SceGxmVertexStream &stream = gxm_vertex_program.streams[attribute.streamIndex];
-            const SceGxmIndexSource index_source = static_cast<SceGxmIndexSource>(stream.indexSource);
-            const size_t data_passed_length = gxm::is_stream_instancing(index_source) ? ((instanceCount - 1) * stream.stride) : (max_index * stream.stride);
-            const size_t data_length = attribute.offset + data_passed_length + attribute_size;
-            max_data_length[attribute.streamIndex] = std::max<size_t>(max_data_length[attribute.streamIndex], data_length);
-        }
-
-        stream_used |= (1 << attribute.streamIndex);
+        max_index = get_max_index(emuenv, indexData, indexCount, indexType);
     }
 
     // Copy and queue upload
     for (size_t stream_index = 0; stream_index < SCE_GXM_MAX_VERTEX_STREAMS; ++stream_index) {
         // Upload it
-        if (stream_used & (1 << static_cast<std::uint16_t>(stream_index))) {
-            const size_t data_length = max_data_length[stream_index];
+        if (gxm_vertex_program.stream_used & (1 << static_cast<std::uint16_t>(stream_index))) {
+            const size_t data_length = emuenv.renderer->features.support_memory_mapping ? 0 : gxmGetVertexStreamSize(gxm_vertex_program, stream_index, max_index, instanceCount);
             const Ptr<const void> data = context->state.stream_data[stream_index];
 
             renderer::set_vertex_stream(*emuenv.renderer, context->renderer.get(), stream_index,
@@ -2190,7 +2253,7 @@ static int gxmDrawElementGeneral(EmuEnvState &emuenv, const char *export_name, c
 
 EXPORT(int, sceGxmDraw, SceGxmContext *context, SceGxmPrimitiveType primType, SceGxmIndexFormat indexType, Ptr<const void> indexData, uint32_t indexCount) {
     TRACY_FUNC(sceGxmDraw, context, primType, indexType, indexData, indexCount);
-    return gxmDrawElementGeneral(emuenv, export_name, thread_id, context, primType, indexType, indexData, indexCount, 1);
+    return gxmDrawElementGeneral(emuenv, export_name, thread, context, primType, indexType, indexData, indexCount, 1);
 }
 
 EXPORT(int, sceGxmDrawInstanced, SceGxmContext *context, SceGxmPrimitiveType primType, SceGxmIndexFormat indexType, Ptr<const void> indexData, uint32_t indexCount, uint32_t indexWrap) {
@@ -2199,7 +2262,7 @@ EXPORT(int, sceGxmDrawInstanced, SceGxmContext *context, SceGxmPrimitiveType pri
         LOG_WARN("Extra vertexes are requested to be drawn (ignored)");
     }
 
-    return gxmDrawElementGeneral(emuenv, export_name, thread_id, context, primType, indexType, indexData, indexWrap, indexCount / indexWrap);
+    return gxmDrawElementGeneral(emuenv, export_name, thread, context, primType, indexType, indexData, indexWrap, indexCount / indexWrap);
 }
 
 EXPORT(int, sceGxmDrawPrecomputed, SceGxmContext *context, SceGxmPrecomputedDraw *draw) {
@@ -2235,9 +2298,6 @@ EXPORT(int, sceGxmDrawPrecomputed, SceGxmContext *context, SceGxmPrecomputedDraw
         return RET_ERROR(SCE_GXM_ERROR_NULL_PROGRAM);
     }
 
-    renderer::set_program(*emuenv.renderer, context->renderer.get(), fragment_program_gptr, true);
-    renderer::set_program(*emuenv.renderer, context->renderer.get(), vertex_program_gptr, false);
-
     // Set uniforms
     const SceGxmProgram &vertex_program_gxp = *vertex_program->program.get(emuenv.mem);
     const SceGxmProgram &fragment_program_gxp = *fragment_program->program.get(emuenv.mem);
@@ -2245,24 +2305,17 @@ EXPORT(int, sceGxmDrawPrecomputed, SceGxmContext *context, SceGxmPrecomputedDraw
     std::span<UniformBuffer> vertex_buffers = vertex_state ? std::span(vertex_state->uniform_buffers.get(emuenv.mem), vertex_state->buffer_count) : context->state.vertex_uniform_buffers;
     std::span<UniformBuffer> fragment_buffers = fragment_state ? std::span(fragment_state->uniform_buffers.get(emuenv.mem), fragment_state->buffer_count) : context->state.fragment_uniform_buffers;
 
-    gxmSetUniformBuffers(*emuenv.renderer, emuenv.gxm, context, vertex_program_gxp, vertex_buffers, vertex_program->renderer_data->uniform_buffer_sizes,
-        emuenv.kernel, emuenv.mem, thread_id);
-
-    gxmSetUniformBuffers(*emuenv.renderer, emuenv.gxm, context, fragment_program_gxp, fragment_buffers, fragment_program->renderer_data->uniform_buffer_sizes,
-        emuenv.kernel, emuenv.mem, thread_id);
+    // everything is sent to the renderer as a single command
+    std::array<renderer::PrecomputedUniformBuffer, 2 * std::tuple_size_v<UniformBufferSizes>> uniform_buffers;
+    size_t uniform_buffer_count = gxmGetUniformBuffers(emuenv.gxm, vertex_program_gxp, vertex_buffers, vertex_program->renderer_data->uniform_buffer_sizes, uniform_buffers.data());
+    uniform_buffer_count += gxmGetUniformBuffers(emuenv.gxm, fragment_program_gxp, fragment_buffers, fragment_program->renderer_data->uniform_buffer_sizes, uniform_buffers.data() + uniform_buffer_count);
 
     // Update vertex data. We should stores a copy of the data to pass it to GPU later, since another scene
     // may start to overwrite stuff when this scene is being processed in our queue (in case of OpenGL).
     uint32_t max_index = 0;
     if (!emuenv.renderer->features.support_memory_mapping) {
         // we don't need to get the vertex buffer size with memory mapping
-        if (draw->index_format == SCE_GXM_INDEX_FORMAT_U16) {
-            const uint16_t *const data = draw->index_data.cast<const uint16_t>().get(emuenv.mem);
-            max_index = *std::max_element(&data[0], &data[draw->vertex_count]);
-        } else {
-            const uint32_t *const data = draw->index_data.cast<const uint32_t>().get(emuenv.mem);
-            max_index = *std::max_element(&data[0], &data[draw->vertex_count]);
-        }
+        max_index = get_max_index(emuenv, draw->index_data, draw->vertex_count, draw->index_format);
     }
 
     // set all textures that are used and mark them as dirty
@@ -2272,46 +2325,41 @@ EXPORT(int, sceGxmDrawPrecomputed, SceGxmContext *context, SceGxmPrecomputedDraw
     context->is_frag_texture_dirty |= frag_textures_sync;
     const SceGxmTexture *frag_textures = fragment_state ? fragment_state->textures.get(emuenv.mem) : context->state.textures.data();
     SceGxmTexture *vert_textures = vertex_state ? vertex_state->textures.get(emuenv.mem) : (context->state.textures.data() + SCE_GXM_MAX_TEXTURE_UNITS);
+    std::array<renderer::PrecomputedTexture, 2 * SCE_GXM_MAX_TEXTURE_UNITS> textures;
+    size_t texture_count = 0;
     for (uint16_t texture_index = 0; texture_index < SCE_GXM_MAX_TEXTURE_UNITS; texture_index++) {
         if (vert_textures_sync[texture_index]) {
             const uint16_t index_position = SCE_GXM_MAX_TEXTURE_UNITS + texture_index;
-            renderer::set_texture(*emuenv.renderer, context->renderer.get(), index_position, vert_textures[texture_index]);
+            textures[texture_count++] = { index_position, vert_textures[texture_index] };
         }
 
         if (frag_textures_sync[texture_index])
-            renderer::set_texture(*emuenv.renderer, context->renderer.get(), texture_index, frag_textures[texture_index]);
-    }
-
-    size_t max_data_length[SCE_GXM_MAX_VERTEX_STREAMS] = {};
-    std::uint32_t stream_used = 0;
-    for (const SceGxmVertexAttribute &attribute : vertex_program->attributes) {
-        if (!emuenv.renderer->features.support_memory_mapping) {
-            const SceGxmAttributeFormat attribute_format = static_cast<SceGxmAttributeFormat>(attribute.format);
-            const size_t attribute_size = gxm::attribute_format_size(attribute_format) * attribute.componentCount;
-            const SceGxmVertexStream &stream = vertex_program->streams[attribute.streamIndex];
-            const SceGxmIndexSource index_source = static_cast<SceGxmIndexSource>(stream.indexSource);
-            const size_t data_passed_length = gxm::is_stream_instancing(index_source) ? ((draw->instance_count - 1) * stream.stride) : (max_index * stream.stride);
-            const size_t data_length = attribute.offset + data_passed_length + attribute_size;
-            max_data_length[attribute.streamIndex] = std::max<size_t>(max_data_length[attribute.streamIndex], data_length);
-        }
-
-        stream_used |= (1 << attribute.streamIndex);
+            textures[texture_count++] = { texture_index, frag_textures[texture_index] };
     }
 
     auto stream_data = draw->stream_data.get(emuenv.mem);
-    // Copy and queue upload
+    std::array<renderer::PrecomputedVertexStream, SCE_GXM_MAX_VERTEX_STREAMS> vertex_streams;
+    size_t vertex_stream_count = 0;
     for (size_t stream_index = 0; stream_index < SCE_GXM_MAX_VERTEX_STREAMS; ++stream_index) {
-        // Upload it
-        if (stream_used & (1 << static_cast<std::uint16_t>(stream_index))) {
-            const size_t data_length = max_data_length[stream_index];
-            const Ptr<const void> data = stream_data[stream_index];
-
-            renderer::set_vertex_stream(*emuenv.renderer, context->renderer.get(), stream_index,
-                data_length, data);
+        if (vertex_program->stream_used & (1 << static_cast<std::uint16_t>(stream_index))) {
+            const size_t data_length = emuenv.renderer->features.support_memory_mapping ? 0 : gxmGetVertexStreamSize(*vertex_program, stream_index, max_index, draw->instance_count);
+            vertex_streams[vertex_stream_count++] = { stream_index, data_length, stream_data[stream_index] };
         }
     }
 
-    renderer::draw(*emuenv.renderer, context->renderer.get(), draw->type, draw->index_format, draw->index_data, draw->vertex_count, draw->instance_count);
+    renderer::draw_precomputed(*emuenv.renderer, context->renderer.get(),
+        {
+            .vertex_program = vertex_program_gptr,
+            .fragment_program = fragment_program_gptr,
+            .uniform_buffers = std::span(uniform_buffers.data(), uniform_buffer_count),
+            .textures = std::span(textures.data(), texture_count),
+            .vertex_streams = std::span(vertex_streams.data(), vertex_stream_count),
+            .prim_type = draw->type,
+            .index_type = draw->index_format,
+            .index_data = draw->index_data,
+            .index_count = draw->vertex_count,
+            .instance_count = draw->instance_count,
+        });
 
     // increase the ringbuffer position if a default vertex or fragment buffer was reserved, we know the new position will fit in the ringbuffer
     // also even in a precomputed draw, this is needed as some parts of the pipeline can be not precomputed
@@ -2343,7 +2391,7 @@ EXPORT(int, sceGxmEndCommandList, SceGxmContext *deferredContext, SceGxmCommandL
 
     // only set the first two fields for commandList (its size is assumed to be 32 bytes by the game)
     commandList->list = deferredContext->linearly_allocate<renderer::CommandList>(emuenv.kernel, emuenv.mem,
-        thread_id);
+        thread);
 
     // also update our own command list
     deferredContext->curr_command_list->list = commandList->list;
@@ -2582,17 +2630,155 @@ EXPORT(int, sceGxmGetRenderTargetMemSize, const SceGxmRenderTargetParams *params
 }
 
 struct GxmThreadParams {
+    EmuEnvState *emuenv = nullptr;
     KernelState *kernel = nullptr;
     MemState *mem = nullptr;
     SceUID thid = SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
     GxmState *gxm = nullptr;
     renderer::State *renderer = nullptr;
+    bool host_display_callbacks = false;
     std::shared_ptr<SDL_semaphore> emuenv_may_destroy_params = std::shared_ptr<SDL_semaphore>(SDL_CreateSemaphore(0), SDL_DestroySemaphore);
 };
 
+static constexpr uint32_t NID_SCE_DISPLAY_SET_FRAME_BUF = 0x7A410B64;
+static constexpr uint32_t NID_SCE_DISPLAY_SET_FRAME_BUF_INTERNAL = 0xF51523CB;
+// the display callback data is at most 0x200 bytes
+static constexpr size_t MAX_DISPLAY_CALLBACK_DATA_WORDS = 0x200 / sizeof(uint32_t);
+// consecutive calls to observe before doing the callback on the host
+static constexpr uint32_t HOST_DISPLAY_CALLBACK_OBSERVED_CALLS = 8;
+
+// The display callback of most games only gives to sceDisplaySetFrameBuf the address found in the callback data.
+// Once the callback is known to do only that, it is done by the display queue thread instead of running the guest code.
+struct HostDisplayCallback {
+    enum class Status {
+        Observing,
+        Enabled,
+        Disabled
+    };
+
+    Status status = Status::Observing;
+    uint32_t observed_calls = 0;
+    // words of the callback data which were the frame buffer address in all the observed calls
+    std::bitset<MAX_DISPLAY_CALLBACK_DATA_WORDS> base_words;
+    // the same in all the observed calls
+    DisplayFrameInfo frame;
+};
+
+// Return true if the guest function only writes to its stack and calls a single function, without any other branch.
+// Everything else it does then only depends on the memory it reads, which is seen by observing the function.
+static bool is_display_callback_simple(MemState &mem, CPUState &cpu, const Address pc) {
+    const bool thumb = pc & 1;
+    Address address = pc & ~1;
+    uint32_t call_count = 0;
+    // the callbacks doing only this are short
+    for (int i = 0; i < 64; i++) {
+        if (!is_valid_addr_range(mem, address, address + 4))
+            return false;
+
+        uint16_t size = 0;
+        const std::string insn = disassemble(cpu, address, thumb, &size);
+        if (size == 0)
+            return false;
+        address += size;
+
+        const size_t space = insn.find(' ');
+        const std::string mnemonic = insn.substr(0, space);
+        const std::string operands = (space == std::string::npos) ? "" : insn.substr(space + 1);
+
+        if (mnemonic == "bx")
+            return operands == "lr" && call_count == 1;
+        if (mnemonic.starts_with("pop")) {
+            if (operands.find("pc") != std::string::npos)
+                return call_count == 1;
+            continue;
+        }
+        if (mnemonic == "bl" || mnemonic == "blx") {
+            // the import stub is called directly
+            if (!operands.starts_with('#'))
+                return false;
+            call_count++;
+            continue;
+        }
+        if (mnemonic.starts_with("str") || mnemonic.starts_with("vst")) {
+            if (operands.find("[sp") == std::string::npos)
+                return false;
+            continue;
+        }
+        if (mnemonic.starts_with("stm")) {
+            if (!operands.starts_with("sp"))
+                return false;
+            continue;
+        }
+
+        // any other branch or write to pc, or data
+        const bool is_branch = mnemonic[0] == 'b' && !mnemonic.starts_with("bic") && !mnemonic.starts_with("bf");
+        if (is_branch || mnemonic.starts_with("cb") || mnemonic.starts_with("tb") || mnemonic.starts_with("ldm") || mnemonic == "svc"
+            || mnemonic.starts_with(".") || operands.starts_with("pc"))
+            return false;
+    }
+
+    return false;
+}
+
+static void observe_display_callback(HostDisplayCallback &host, const uint32_t *data, const size_t word_count, const DisplayFrameInfo &frame) {
+    std::bitset<MAX_DISPLAY_CALLBACK_DATA_WORDS> base_words;
+    for (size_t i = 0; i < word_count; i++)
+        base_words[i] = (data[i] == frame.base.address());
+
+    if (host.observed_calls == 0) {
+        host.base_words = base_words;
+        host.frame = frame;
+    } else {
+        host.base_words &= base_words;
+        if (frame.pitch != host.frame.pitch || frame.pixelformat != host.frame.pixelformat
+            || frame.image_size.x != host.frame.image_size.x || frame.image_size.y != host.frame.image_size.y) {
+            host.status = HostDisplayCallback::Status::Disabled;
+            return;
+        }
+    }
+
+    if (host.base_words.none()) {
+        host.status = HostDisplayCallback::Status::Disabled;
+        return;
+    }
+
+    if (++host.observed_calls == HOST_DISPLAY_CALLBACK_OBSERVED_CALLS) {
+        host.status = HostDisplayCallback::Status::Enabled;
+        LOG_INFO("The display callback only sets the frame buffer, it is now done on the host");
+    }
+}
+
+static void run_host_display_callback(EmuEnvState &emuenv, const ThreadStatePtr &thread, const HostDisplayCallback &host, const uint32_t *data) {
+    size_t base_word = 0;
+    while (!host.base_words[base_word])
+        base_word++;
+
+    SceDisplayFrameBuf frame_buf;
+    frame_buf.size = sizeof(SceDisplayFrameBuf);
+    frame_buf.base = Ptr<const void>(data[base_word]);
+    frame_buf.pitch = host.frame.pitch;
+    frame_buf.pixelformat = host.frame.pixelformat;
+    frame_buf.width = host.frame.image_size.x;
+    frame_buf.height = host.frame.image_size.y;
+
+    uint32_t frame_buf_size = 0;
+    export__sceDisplaySetFrameBuf(emuenv, thread, "_sceDisplaySetFrameBuf", &frame_buf, SCE_DISPLAY_SETBUF_NEXTFRAME, &frame_buf_size);
+}
+
 static int SDLCALL thread_function(void *data) {
     const GxmThreadParams params = *static_cast<const GxmThreadParams *>(data);
     SDL_SemPost(params.emuenv_may_destroy_params.get());
+    // the display queue runs at the highest user priority on the Vita
+    if (params.kernel->host_thread_priority)
+        set_current_thread_priority(HostThreadPriority::Highest);
+
+    HostDisplayCallback host_callback;
+    const ThreadStatePtr callback_thread = params.kernel->get_thread(params.thid);
+    if (!params.host_display_callbacks || !callback_thread
+        || !is_display_callback_simple(*params.mem, *callback_thread->cpu, params.gxm->params.displayQueueCallback.address()))
+        host_callback.status = HostDisplayCallback::Status::Disabled;
+    const size_t data_words = std::min<size_t>(params.gxm->params.displayQueueCallbackDataSize / sizeof(uint32_t), MAX_DISPLAY_CALLBACK_DATA_WORDS);
+
     while (true) {
         auto display_callback = params.gxm->display_queue.top();
         if (!display_callback)
@@ -2608,8 +2794,27 @@ static int SDLCALL thread_function(void *data) {
 
         // Now run callback
         const ThreadStatePtr display_thread = params.kernel->get_thread(params.thid);
-        if (display_thread) {
+        const uint32_t *data = Ptr<const uint32_t>(display_callback->data).get(*params.mem);
+        if (display_thread && host_callback.status == HostDisplayCallback::Status::Enabled) {
+            run_host_display_callback(*params.emuenv, display_thread, host_callback, data);
+        } else if (display_thread) {
+            const uint32_t import_call_count = display_thread->import_call_count;
             display_thread->run_guest_function(display_callback->pc, display_callback->data);
+
+            if (host_callback.status == HostDisplayCallback::Status::Observing) {
+                const uint32_t nid = display_thread->last_import_nid;
+                if (display_thread->import_call_count == import_call_count + 1
+                    && (nid == NID_SCE_DISPLAY_SET_FRAME_BUF || nid == NID_SCE_DISPLAY_SET_FRAME_BUF_INTERNAL)) {
+                    DisplayFrameInfo frame;
+                    {
+                        const std::lock_guard<std::mutex> guard(params.emuenv->display.display_info_mutex);
+                        frame = params.emuenv->display.next_frame;
+                    }
+                    observe_display_callback(host_callback, data, data_words, frame);
+                } else {
+                    host_callback.status = HostDisplayCallback::Status::Disabled;
+                }
+            }
         } else {
             LOG_ERROR("display_thread not found. thid:{} display_callback function: {}", params.thid, log_hex(display_callback->pc));
         }
@@ -2617,7 +2822,7 @@ static int SDLCALL thread_function(void *data) {
         free(*params.mem, display_callback->data);
 
         // The only thing old buffer should be waiting for is to stop being displayed
-        renderer::subject_done(oldBuffer, std::min(oldBuffer->timestamp_current + 1, oldBuffer->timestamp_ahead.load()));
+        renderer::subject_done(*params.emuenv->renderer, oldBuffer, std::min(oldBuffer->timestamp_current + 1, oldBuffer->timestamp_ahead.load()));
     }
 
     return 0;
@@ -2643,7 +2848,7 @@ EXPORT(int, sceGxmInitialize, const SceGxmInitializeParams *params) {
     const uint32_t max_queue_size = std::min(std::max(params->displayQueueMaxPendingCount, 2U), 3U) - 1;
     emuenv.gxm.display_queue.maxPendingCount_ = max_queue_size;
 
-    const ThreadStatePtr main_thread = util::find(thread_id, emuenv.kernel.threads);
+    const ThreadStatePtr main_thread = util::find(thread->id, emuenv.kernel.threads);
     const ThreadStatePtr display_queue_thread = emuenv.kernel.create_thread(emuenv.mem, "SceGxmDisplayQueue", Ptr<void>(0), SCE_KERNEL_HIGHEST_PRIORITY_USER, SCE_KERNEL_THREAD_CPU_AFFINITY_MASK_DEFAULT, SCE_KERNEL_STACK_SIZE_USER_DEFAULT, nullptr);
     if (!display_queue_thread) {
         return RET_ERROR(SCE_GXM_ERROR_DRIVER);
@@ -2651,11 +2856,13 @@ EXPORT(int, sceGxmInitialize, const SceGxmInitializeParams *params) {
     emuenv.gxm.display_queue_thread = display_queue_thread->id;
 
     GxmThreadParams gxm_params;
+    gxm_params.emuenv = &emuenv;
     gxm_params.mem = &emuenv.mem;
     gxm_params.kernel = &emuenv.kernel;
     gxm_params.thid = emuenv.gxm.display_queue_thread;
     gxm_params.gxm = &emuenv.gxm;
     gxm_params.renderer = emuenv.renderer.get();
+    gxm_params.host_display_callbacks = emuenv.cfg.host_display_callbacks;
 
     // Reset the queue in case sceGxmTerminate was called earlier
     emuenv.gxm.display_queue.reset();
@@ -2709,7 +2916,7 @@ EXPORT(int, sceGxmMapMemory, Ptr<void> base, uint32_t size, uint32_t attribs) {
 
         // little big planet maps regions of size 0
         if (emuenv.renderer->features.support_memory_mapping && size > 0)
-            renderer::send_single_command(*emuenv.renderer, nullptr, renderer::CommandOpcode::MemoryMap, true, base, size);
+            renderer::send_single_command(*emuenv.renderer, nullptr, renderer::CommandOpcode::MemoryMap, true, base, size, attribs);
 
         return 0;
     }
@@ -3192,7 +3399,7 @@ EXPORT(Ptr<SceGxmProgramParameter>, sceGxmProgramFindParameterBySemantic, const
 
 EXPORT(Ptr<SceGxmProgramParameter>, _sceGxmProgramFindParameterBySemantic, const SceGxmProgram *program, SceGxmParameterSemantic semantic, uint32_t index) {
     TRACY_FUNC(_sceGxmProgramFindParameterBySemantic, program, semantic, index);
-    return export_sceGxmProgramFindParameterBySemantic(emuenv, thread_id, export_name, program, semantic, index);
+    return export_sceGxmProgramFindParameterBySemantic(emuenv, thread, export_name, program, semantic, index);
 }
 
 EXPORT(uint32_t, sceGxmProgramGetDefaultUniformBufferSize, const SceGxmProgram *program) {
@@ -3358,7 +3565,7 @@ EXPORT(int, sceGxmProgramParameterGetSemantic, const SceGxmProgramParameter *par
 
 EXPORT(int, _sceGxmProgramParameterGetSemantic, const SceGxmProgramParameter *parameter) {
     TRACY_FUNC(_sceGxmProgramParameterGetSemantic, parameter);
-    return export_sceGxmProgramParameterGetSemantic(emuenv, thread_id, export_name, parameter);
+    return export_sceGxmProgramParameterGetSemantic(emuenv, thread, export_name, parameter);
 }
 
 EXPORT(uint32_t, sceGxmProgramParameterGetSemanticIndex, const SceGxmProgramParameter *parameter) {
@@ -3434,7 +3641,7 @@ EXPORT(int, sceGxmReserveFragmentDefaultUniformBuffer, SceGxmContext *context, P
     if (next_used > context->state.fragment_ring_buffer_size) {
         if (context->state.type != SCE_GXM_CONTEXT_TYPE_IMMEDIATE) {
             context->state.fragment_ring_buffer = gxmRunDeferredMemoryCallback(emuenv.kernel, emuenv.mem, emuenv.gxm.callback_lock, context->state.fragment_ring_buffer_size,
-                context->state.fragment_memory_callback, context->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread_id);
+                context->state.fragment_memory_callback, context->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread);
 
             if (!context->state.fragment_ring_buffer) {
                 return RET_ERROR(SCE_GXM_ERROR_RESERVE_FAILED);
@@ -3479,7 +3686,7 @@ EXPORT(int, sceGxmReserveVertexDefaultUniformBuffer, SceGxmContext *context, Ptr
     if (next_used > context->state.vertex_ring_buffer_size) {
         if (context->state.type != SCE_GXM_CONTEXT_TYPE_IMMEDIATE) {
             context->state.vertex_ring_buffer = gxmRunDeferredMemoryCallback(emuenv.kernel, emuenv.mem, emuenv.gxm.callback_lock, context->state.vertex_ring_buffer_size,
-                context->state.vertex_memory_callback, context->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread_id);
+                context->state.vertex_memory_callback, context->state.memory_callback_userdata, DEFAULT_RING_SIZE, thread);
 
             if (!context->state.vertex_ring_buffer) {
                 return RET_ERROR(SCE_GXM_ERROR_RESERVE_FAILED);
@@ -3949,10 +4156,7 @@ EXPORT(void, sceGxmSetTwoSidedEnable, SceGxmContext *context, SceGxmTwoSidedMode
 template <typename T>
 static void convert_uniform_data(std::vector<std::uint8_t> &converted_data, const float *sourceData, uint32_t componentCount) {
     converted_data.resize(componentCount * sizeof(T));
-    for (std::uint32_t i = 0; i < componentCount; ++i) {
-        T converted = static_cast<T>(sourceData[i]);
-        std::memcpy(&converted_data[i * sizeof(T)], &converted, sizeof(T));
-    }
+    float_to_integer(sourceData, reinterpret_cast<T *>(converted_data.data()), componentCount);
 }
 
 EXPORT(int, sceGxmSetUniformDataF, void *uniformBuffer, const SceGxmProgramParameter *parameter, uint32_t componentOffset, uint32_t componentCount, const float *sourceData) {
@@ -3974,7 +4178,8 @@ EXPORT(int, sceGxmSetUniformDataF, void *uniformBuffer, const SceGxmProgramParam
     // Component size is in bytes
     int comp_size = gxp::get_parameter_type_size(static_cast<SceGxmParameterType>(param_type));
     const std::uint8_t *source = reinterpret_cast<const std::uint8_t *>(sourceData);
-    std::vector<std::uint8_t> converted_data;
+    // kept by the thread, the skinned meshes set thousands of uniforms each frame
+    static thread_local std::vector<std::uint8_t> converted_data;
 
     switch (parameter->type) {
     case SCE_GXM_PARAMETER_TYPE_S8: {
@@ -4069,6 +4274,12 @@ EXPORT(int, sceGxmSetUniformDataF, void *uniformBuffer, const SceGxmProgramParam
         int component_to_copy_remain_per_elem = parameter->component_count - component_cursor_inside_vector;
         int component_left_to_copy = componentCount;
 
+        if (align_bytes == 0 && component_cursor_inside_vector == 0 && parameter->component_count <= 4) {
+            // the vectors are not padded, like the rows of a matrix palette, they are copied at once
+            memcpy(dest, source, componentCount * comp_size);
+            component_left_to_copy = 0;
+        }
+
         while (component_left_to_copy > 0) {
             memcpy(dest, source, component_to_copy_remain_per_elem * comp_size);
 
@@ -4246,18 +4457,17 @@ EXPORT(int, sceGxmSetYuvProfile) {
     return UNIMPLEMENTED();
 }
 
-Address alloc_callbacked(EmuEnvState &emuenv, SceUID thread_id, const SceGxmShaderPatcherParams &shaderPatcherParams, unsigned int size) {
+Address alloc_callbacked(EmuEnvState &emuenv, const ThreadStatePtr &thread, const SceGxmShaderPatcherParams &shaderPatcherParams, unsigned int size) {
     if (!shaderPatcherParams.hostAllocCallback) {
         LOG_ERROR("Empty hostAllocCallback");
     }
-    const auto thread = emuenv.kernel.get_thread(thread_id);
     auto result = thread->run_callback(shaderPatcherParams.hostAllocCallback.address(), { shaderPatcherParams.userData.address(), size });
     return result;
 }
 
 template <typename T>
-Ptr<T> alloc_callbacked(EmuEnvState &emuenv, SceUID thread_id, const SceGxmShaderPatcherParams &shaderPatcherParams) {
-    const Address address = alloc_callbacked(emuenv, thread_id, shaderPatcherParams, sizeof(T));
+Ptr<T> alloc_callbacked(EmuEnvState &emuenv, const ThreadStatePtr &thread, const SceGxmShaderPatcherParams &shaderPatcherParams) {
+    const Address address = alloc_callbacked(emuenv, thread, shaderPatcherParams, sizeof(T));
     const Ptr<T> ptr(address);
     if (!ptr) {
         return ptr;
@@ -4268,21 +4478,20 @@ Ptr<T> alloc_callbacked(EmuEnvState &emuenv, SceUID thread_id, const SceGxmShade
 }
 
 template <typename T>
-Ptr<T> alloc_callbacked(EmuEnvState &emuenv, SceUID thread_id, SceGxmShaderPatcher *shaderPatcher) {
-    return alloc_callbacked<T>(emuenv, thread_id, shaderPatcher->params);
+Ptr<T> alloc_callbacked(EmuEnvState &emuenv, const ThreadStatePtr &thread, SceGxmShaderPatcher *shaderPatcher) {
+    return alloc_callbacked<T>(emuenv, thread, shaderPatcher->params);
 }
 
-void free_callbacked(EmuEnvState &emuenv, SceUID thread_id, SceGxmShaderPatcher *shaderPatcher, Address data) {
+void free_callbacked(EmuEnvState &emuenv, const ThreadStatePtr &thread, SceGxmShaderPatcher *shaderPatcher, Address data) {
     if (!shaderPatcher->params.hostFreeCallback) {
         LOG_ERROR("Empty hostFreeCallback");
     }
-    const auto thread = emuenv.kernel.get_thread(thread_id);
     thread->run_callback(shaderPatcher->params.hostFreeCallback.address(), { shaderPatcher->params.userData.address(), data });
 }
 
 template <typename T>
-void free_callbacked(EmuEnvState &emuenv, SceUID thread_id, SceGxmShaderPatcher *shaderPatcher, Ptr<T> data) {
-    free_callbacked(emuenv, thread_id, shaderPatcher, data.address());
+void free_callbacked(EmuEnvState &emuenv, const ThreadStatePtr &thread, SceGxmShaderPatcher *shaderPatcher, Ptr<T> data) {
+    free_callbacked(emuenv, thread, shaderPatcher, data.address());
 }
 
 EXPORT(int, sceGxmShaderPatcherAddRefFragmentProgram, SceGxmShaderPatcher *shaderPatcher, SceGxmFragmentProgram *fragmentProgram) {
@@ -4310,7 +4519,7 @@ EXPORT(int, sceGxmShaderPatcherCreate, const SceGxmShaderPatcherParams *params,
     if (!params || !shaderPatcher)
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
 
-    *shaderPatcher = alloc_callbacked<SceGxmShaderPatcher>(emuenv, thread_id, *params);
+    *shaderPatcher = alloc_callbacked<SceGxmShaderPatcher>(emuenv, thread, *params);
     assert(*shaderPatcher);
     if (!*shaderPatcher) {
         return RET_ERROR(SCE_GXM_ERROR_OUT_OF_MEMORY);
@@ -4346,7 +4555,7 @@ EXPORT(int, sceGxmShaderPatcherCreateFragmentProgram, SceGxmShaderPatcher *shade
         return 0;
     }
 
-    *fragmentProgram = alloc_callbacked<SceGxmFragmentProgram>(emuenv, thread_id, shaderPatcher);
+    *fragmentProgram = alloc_callbacked<SceGxmFragmentProgram>(emuenv, thread, shaderPatcher);
     assert(*fragmentProgram);
     if (!*fragmentProgram) {
         return RET_ERROR(SCE_GXM_ERROR_OUT_OF_MEMORY);
@@ -4372,7 +4581,7 @@ EXPORT(int, sceGxmShaderPatcherCreateMaskUpdateFragmentProgram, SceGxmShaderPatc
     if (!shaderPatcher || !fragmentProgram)
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
 
-    *fragmentProgram = alloc_callbacked<SceGxmFragmentProgram>(emuenv, thread_id, shaderPatcher);
+    *fragmentProgram = alloc_callbacked<SceGxmFragmentProgram>(emuenv, thread, shaderPatcher);
     assert(*fragmentProgram);
     if (!*fragmentProgram) {
         return RET_ERROR(SCE_GXM_ERROR_OUT_OF_MEMORY);
@@ -4380,7 +4589,7 @@ EXPORT(int, sceGxmShaderPatcherCreateMaskUpdateFragmentProgram, SceGxmShaderPatc
 
     SceGxmFragmentProgram *const fp = fragmentProgram->get(mem);
     fp->is_maskupdate = true;
-    fp->program = Ptr<const SceGxmProgram>(alloc_callbacked(emuenv, thread_id, shaderPatcher->params, size_mask_gxp));
+    fp->program = Ptr<const SceGxmProgram>(alloc_callbacked(emuenv, thread, shaderPatcher->params, size_mask_gxp));
     memcpy(const_cast<SceGxmProgram *>(fp->program.get(mem)), mask_gxp, size_mask_gxp);
 
     if (!renderer::create(fp->renderer_data, *emuenv.renderer, *fp->program.get(mem), nullptr, emuenv.renderer->gxp_ptr_map, emuenv.cache_path.string().c_str(), emuenv.io.title_id.c_str())) {
@@ -4417,7 +4626,7 @@ EXPORT(int, sceGxmShaderPatcherCreateVertexProgram, SceGxmShaderPatcher *shaderP
         return 0;
     }
 
-    *vertexProgram = alloc_callbacked<SceGxmVertexProgram>(emuenv, thread_id, shaderPatcher);
+    *vertexProgram = alloc_callbacked<SceGxmVertexProgram>(emuenv, thread, shaderPatcher);
     assert(*vertexProgram);
     if (!*vertexProgram) {
         return RET_ERROR(SCE_GXM_ERROR_OUT_OF_MEMORY);
@@ -4435,7 +4644,9 @@ EXPORT(int, sceGxmShaderPatcherCreateVertexProgram, SceGxmShaderPatcher *shaderP
         vp->attributes.insert(vp->attributes.end(), &attributes[0], &attributes[attributeCount]);
     }
 
-    if (!renderer::create(vp->renderer_data, *emuenv.renderer, *programId->program.get(mem), emuenv.renderer->gxp_ptr_map, emuenv.cache_path.string().c_str(), emuenv.io.title_id.c_str())) {
+    gxmBakeVertexStreams(*vp);
+
+    if (!renderer::create(vp->renderer_data, *emuenv.renderer, *programId->program.get(mem), vp->attributes, emuenv.renderer->gxp_ptr_map, emuenv.cache_path.string().c_str(), emuenv.io.title_id.c_str())) {
         return RET_ERROR(SCE_GXM_ERROR_DRIVER);
     }
 
@@ -4449,7 +4660,7 @@ EXPORT(int, sceGxmShaderPatcherDestroy, Ptr<SceGxmShaderPatcher> shaderPatcher)
     if (!shaderPatcher)
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
 
-    free_callbacked(emuenv, thread_id, shaderPatcher.get(emuenv.mem), shaderPatcher);
+    free_callbacked(emuenv, thread, shaderPatcher.get(emuenv.mem), shaderPatcher);
 
     return 0;
 }
@@ -4466,7 +4677,7 @@ EXPORT(int, sceGxmShaderPatcherForceUnregisterProgram, SceGxmShaderPatcher *shad
     if (rp->program.get(emuenv.mem)->is_vertex()) {
         for (auto it = shaderPatcher->vertex_program_cache.begin(); it != shaderPatcher->vertex_program_cache.end();) {
             if (it->first.vertex_program.program == rp->program) {
-                free_callbacked(emuenv, thread_id, shaderPatcher, it->second.address());
+                free_callbacked(emuenv, thread, shaderPatcher, it->second.address());
                 it = shaderPatcher->vertex_program_cache.erase(it);
             } else {
                 it++;
@@ -4475,7 +4686,7 @@ EXPORT(int, sceGxmShaderPatcherForceUnregisterProgram, SceGxmShaderPatcher *shad
     } else {
         for (auto it = shaderPatcher->fragment_program_cache.begin(); it != shaderPatcher->fragment_program_cache.end();) {
             if (it->first.fragment_program.program == rp->program) {
-                free_callbacked(emuenv, thread_id, shaderPatcher, it->second.address());
+                free_callbacked(emuenv, thread, shaderPatcher, it->second.address());
                 it = shaderPatcher->fragment_program_cache.erase(it);
             } else {
                 it++;
@@ -4484,7 +4695,7 @@ EXPORT(int, sceGxmShaderPatcherForceUnregisterProgram, SceGxmShaderPatcher *shad
     }
 
     rp->program.reset();
-    free_callbacked(emuenv, thread_id, shaderPatcher, programId);
+    free_callbacked(emuenv, thread, shaderPatcher, programId);
 
     return 0;
 }
@@ -4551,7 +4762,7 @@ EXPORT(int, sceGxmShaderPatcherRegisterProgram, SceGxmShaderPatcher *shaderPatch
     if (!shaderPatcher || !programHeader || !programId)
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
 
-    *programId = alloc_callbacked<SceGxmRegisteredProgram>(emuenv, thread_id, shaderPatcher);
+    *programId = alloc_callbacked<SceGxmRegisteredProgram>(emuenv, thread, shaderPatcher);
     assert(*programId);
     if (!*programId) {
         return RET_ERROR(SCE_GXM_ERROR_OUT_OF_MEMORY);
@@ -4577,7 +4788,7 @@ EXPORT(int, sceGxmShaderPatcherReleaseFragmentProgram, SceGxmShaderPatcher *shad
                 break;
             }
         }
-        free_callbacked(emuenv, thread_id, shaderPatcher, fragmentProgram);
+        free_callbacked(emuenv, thread, shaderPatcher, fragmentProgram);
     }
 
     return 0;
@@ -4597,7 +4808,7 @@ EXPORT(int, sceGxmShaderPatcherReleaseVertexProgram, SceGxmShaderPatcher *shader
                 break;
             }
         }
-        free_callbacked(emuenv, thread_id, shaderPatcher, vertexProgram);
+        free_callbacked(emuenv, thread, shaderPatcher, vertexProgram);
     }
 
     return 0;
@@ -4625,7 +4836,7 @@ EXPORT(int, sceGxmShaderPatcherUnregisterProgram, SceGxmShaderPatcher *shaderPat
     SceGxmRegisteredProgram *const rp = programId.get(emuenv.mem);
     rp->program.reset();
 
-    free_callbacked(emuenv, thread_id, shaderPatcher, programId);
+    free_callbacked(emuenv, thread, shaderPatcher, programId);
 
     return 0;
 }
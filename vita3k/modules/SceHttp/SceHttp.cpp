@@ -22,17 +22,17 @@
 #include <http/state.h>
 
 #ifdef WIN32 // windows moment
-#include <io.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
-#define write(x, y, z) _write(x, y, z)
-#define read(x, y, z) _read(x, y, z)
 #else
 #include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <unistd.h>
 #endif
 
 #include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
 #include <net/state.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
@@ -42,6 +42,8 @@
 #include <util/string_utils.h>
 #include <util/tracy.h>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <thread>
 
@@ -117,6 +119,415 @@ std::string to_debug_str<SceHttpsFlags>(const MemState &mem, SceHttpsFlags type)
     return out;
 }
 
+// Request being sent by an io thread, the calling thread waits for done
+struct HttpTransfer {
+    std::string url;
+    std::string pool_key;
+    std::string hostname;
+    std::string port;
+    // null for http
+    SSL_CTX *ssl_ctx = nullptr;
+    bool keep_alive = false;
+    bool is_head = false;
+    std::string message;
+    const char *post_data = nullptr;
+    SceSize post_size = 0;
+    int header_max_size = 0;
+    int response_timeout_ms = 0;
+    int read_timeout_ms = 0;
+
+    SceInt result = 0;
+    SceRequestResponse res;
+    size_t header_length = 0;
+    bool done = false;
+};
+
+static constexpr int HOST_RECV_TIMEOUT = -2;
+#ifdef MSG_NOSIGNAL
+// a write to a connection closed by the server must fail instead of raising SIGPIPE
+static constexpr int HOST_SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static constexpr int HOST_SEND_FLAGS = 0;
+#endif
+
+static uint64_t http_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void close_host_socket(int sockfd) {
+#ifdef WIN32
+    closesocket(sockfd);
+#else
+    close(sockfd);
+#endif
+}
+
+static void close_host_connection(HttpHostConnection &conn) {
+    // no close_notify is sent, the server may already have closed its side
+    if (conn.ssl)
+        SSL_free((SSL *)conn.ssl);
+    close_host_socket(conn.sockfd);
+    conn = {};
+}
+
+static void set_receive_timeout(int sockfd, int timeout_ms) {
+#ifdef WIN32
+    const DWORD timeout = timeout_ms;
+#else
+    const timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+#endif
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+}
+
+static bool is_receive_timeout() {
+#ifdef WIN32
+    return WSAGetLastError() == WSAETIMEDOUT;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// an idle connection has nothing to read, unless the server closed it
+static bool is_host_connection_alive(const HttpHostConnection &conn) {
+    if (conn.ssl && SSL_pending((SSL *)conn.ssl) > 0)
+        return false;
+#ifdef WIN32
+    WSAPOLLFD fd = { (SOCKET)conn.sockfd, POLLRDNORM, 0 };
+    return WSAPoll(&fd, 1, 0) == 0;
+#else
+    pollfd fd = { conn.sockfd, POLLIN, 0 };
+    return poll(&fd, 1, 0) == 0;
+#endif
+}
+
+static bool host_send_all(HttpHostConnection &conn, const char *data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        int bytes = 0;
+        if (conn.ssl)
+            bytes = SSL_write((SSL *)conn.ssl, data + sent, size - sent);
+        else
+            bytes = send(conn.sockfd, data + sent, size - sent, HOST_SEND_FLAGS);
+        if (bytes <= 0)
+            return false;
+
+        sent += bytes;
+    }
+
+    return true;
+}
+
+// returns the number of bytes received, 0 once the server closed the connection or HOST_RECV_TIMEOUT
+static int host_recv(HttpHostConnection &conn, uint8_t *data, size_t size) {
+    if (conn.ssl) {
+        const int bytes = SSL_read((SSL *)conn.ssl, data, size);
+        if (bytes > 0)
+            return bytes;
+
+        switch (SSL_get_error((SSL *)conn.ssl, bytes)) {
+        case SSL_ERROR_ZERO_RETURN: return 0;
+        case SSL_ERROR_WANT_READ: return HOST_RECV_TIMEOUT;
+        default: return -1;
+        }
+    }
+
+    const int bytes = recv(conn.sockfd, (char *)data, size, 0);
+    if (bytes < 0 && is_receive_timeout())
+        return HOST_RECV_TIMEOUT;
+
+    return bytes;
+}
+
+static bool acquire_pooled_connection(HttpConnectionPool &pool, const std::string &key, HttpHostConnection &conn) {
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    const auto it = pool.idle_connections.find(key);
+    if (it == pool.idle_connections.end())
+        return false;
+
+    // the most recently used connection is the least likely to have been closed by the server
+    const uint64_t now = http_now_ms();
+    std::vector<HttpHostConnection> &idle = it->second;
+    while (!idle.empty()) {
+        HttpHostConnection candidate = idle.back();
+        idle.pop_back();
+        if (now - candidate.idle_since < HttpConnectionPool::IDLE_TIMEOUT_MS && is_host_connection_alive(candidate)) {
+            conn = candidate;
+            return true;
+        }
+        close_host_connection(candidate);
+    }
+
+    return false;
+}
+
+static void release_pooled_connection(HttpConnectionPool &pool, const std::string &key, HttpHostConnection &conn) {
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    const uint64_t now = http_now_ms();
+    for (auto &[host, idle] : pool.idle_connections) {
+        std::erase_if(idle, [&](HttpHostConnection &candidate) {
+            if (now - candidate.idle_since < HttpConnectionPool::IDLE_TIMEOUT_MS)
+                return false;
+            close_host_connection(candidate);
+            return true;
+        });
+    }
+
+    std::vector<HttpHostConnection> &idle = pool.idle_connections[key];
+    if (idle.size() >= HttpConnectionPool::MAX_IDLE_PER_HOST) {
+        close_host_connection(idle.front());
+        idle.erase(idle.begin());
+    }
+
+    conn.idle_since = now;
+    idle.push_back(conn);
+    conn = {};
+}
+
+static void store_tls_session(HttpConnectionPool &pool, const std::string &key, SSL *ssl) {
+    // with TLS 1.3, the session is only resumable once its ticket was received with the response
+    SSL_SESSION *session = SSL_get1_session(ssl);
+    if (!session)
+        return;
+    if (!SSL_SESSION_is_resumable(session)) {
+        SSL_SESSION_free(session);
+        return;
+    }
+
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    void *&stored = pool.tls_sessions[key];
+    if (stored)
+        SSL_SESSION_free((SSL_SESSION *)stored);
+    stored = session;
+}
+
+static void clear_connection_pool(HttpConnectionPool &pool) {
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    for (auto &[key, idle] : pool.idle_connections) {
+        for (HttpHostConnection &conn : idle)
+            close_host_connection(conn);
+    }
+    pool.idle_connections.clear();
+
+    for (auto &[key, session] : pool.tls_sessions)
+        SSL_SESSION_free((SSL_SESSION *)session);
+    pool.tls_sessions.clear();
+}
+
+static SceInt connect_host(HttpConnectionPool &pool, const HttpTransfer &transfer, HttpHostConnection &conn) {
+    const addrinfo hints = {
+        0,
+        AF_UNSPEC, /* Allow IPv4 or IPv6 */
+        SOCK_STREAM,
+        0, /* Any protocol */
+    };
+    addrinfo *result = nullptr;
+
+    const int ret = getaddrinfo(transfer.hostname.c_str(), transfer.port.c_str(), &hints, &result);
+    if (ret != 0) {
+        LOG_ERROR("getaddrinfo({},{},...) = {}", transfer.hostname, transfer.port, ret);
+        return SCE_HTTP_ERROR_RESOLVER_ENODNS;
+    }
+
+    int sockfd = -1;
+    for (const addrinfo *addr = result; addr; addr = addr->ai_next) {
+        sockfd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (sockfd < 0)
+            continue;
+        if (connect(sockfd, addr->ai_addr, addr->ai_addrlen) == 0)
+            break;
+
+        close_host_socket(sockfd);
+        sockfd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (sockfd < 0) {
+        LOG_ERROR("Could not connect to {}:{}, errno={}({})", transfer.hostname, transfer.port, errno, strerror(errno));
+        return SCE_HTTP_ERROR_RESOLVER_ENOHOST;
+    }
+
+    LOG_TRACE("Connected to {}", transfer.url);
+    conn.sockfd = sockfd;
+
+    if (!transfer.ssl_ctx)
+        return 0;
+
+    SSL *ssl = SSL_new(transfer.ssl_ctx);
+    conn.ssl = ssl;
+    SSL_set_fd(ssl, sockfd);
+    SSL_set_tlsext_host_name(ssl, transfer.hostname.c_str());
+
+    // This is needed as some servers are using handshake protocols older than the person writing this code
+    SSL_set_security_level(ssl, 0);
+
+    {
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        const auto session = pool.tls_sessions.find(transfer.pool_key);
+        if (session != pool.tls_sessions.end())
+            SSL_set_session(ssl, (SSL_SESSION *)session->second);
+    }
+
+    const int err = SSL_connect(ssl);
+    if (err != 1) {
+        const int sslErr = SSL_get_error(ssl, err);
+        LOG_ERROR("SSL_connect(...) = {}, SSLERR = {}", err, sslErr);
+        if (sslErr == SSL_ERROR_SSL) {
+            close_host_connection(conn);
+            return SCE_HTTP_ERROR_SSL;
+        }
+    }
+
+    if (SSL_session_reused(ssl))
+        LOG_TRACE("Resumed TLS session of {}", transfer.url);
+
+    const long verify_flag = SSL_get_verify_result(ssl);
+    if (verify_flag != X509_V_OK && verify_flag != X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY)
+        LOG_ERROR("Certificate verification error ({}) but continuing...\n", (int)verify_flag);
+
+    return 0;
+}
+
+// Sends the request on conn and reads the whole response.
+// retry is set when a kept alive connection turns out to be closed before any byte of the response was received.
+static SceInt send_and_receive(HttpTransfer &transfer, HttpHostConnection &conn, bool reused, bool &reusable, bool &retry) {
+    reusable = false;
+    retry = false;
+
+    if (!host_send_all(conn, transfer.message.c_str(), transfer.message.length())
+        || (transfer.post_size != 0 && !host_send_all(conn, transfer.post_data, transfer.post_size))) {
+        retry = reused;
+        if (!retry)
+            LOG_ERROR("ERROR writing request to socket");
+        return SCE_HTTP_ERROR_NETWORK;
+    }
+    LOG_TRACE("Sent {} bytes to {}", transfer.message.length() + transfer.post_size, transfer.url);
+
+    /* receive the headers, with maybe the start of the body */
+    std::vector<uint8_t> headers(transfer.header_max_size);
+    size_t totalReceived = 0;
+    size_t headersEnd = std::string_view::npos;
+    set_receive_timeout(conn.sockfd, transfer.response_timeout_ms);
+    while (headersEnd == std::string_view::npos) {
+        if (totalReceived == headers.size())
+            return SCE_HTTP_ERROR_TOO_LARGE_RESPONSE_HEADER;
+
+        const int bytes = host_recv(conn, headers.data() + totalReceived, headers.size() - totalReceived);
+        if (bytes == HOST_RECV_TIMEOUT)
+            return SCE_HTTP_ERROR_TIMEOUT;
+        if (bytes <= 0) {
+            retry = reused && totalReceived == 0;
+            if (!retry)
+                LOG_ERROR("ERROR reading response headers");
+            return SCE_HTTP_ERROR_NETWORK;
+        }
+        LOG_TRACE("Received {} bytes from {}", bytes, transfer.url);
+
+        if (totalReceived == 0)
+            set_receive_timeout(conn.sockfd, transfer.read_timeout_ms);
+        totalReceived += bytes;
+        headersEnd = std::string_view((const char *)headers.data(), totalReceived).find("\r\n\r\n");
+    }
+
+    transfer.header_length = headersEnd + strlen("\r\n\r\n");
+    if (!net_utils::parseResponse(std::string((const char *)headers.data(), headersEnd), transfer.res))
+        return SCE_HTTP_ERROR_PARSE_HTTP_INVALID_RESPONSE;
+
+    LOG_TRACE("Request replied with status code {}", transfer.res.statusCode);
+
+    // even if we have content-length, there will be no body
+    const bool hasBody = !transfer.is_head && transfer.res.statusCode != SCE_HTTP_STATUS_CODE_NO_CONTENT && transfer.res.statusCode != SCE_HTTP_STATUS_CODE_NOT_MODIFIED;
+    const size_t responseLength = transfer.header_length + (hasBody ? transfer.res.contentLength : 0);
+
+    // This is the entire response, including headers and everything
+    auto reqResponse = new uint8_t[responseLength]();
+    memcpy(reqResponse, headers.data(), std::min(totalReceived, responseLength));
+
+    while (totalReceived < responseLength) {
+        const int bytes = host_recv(conn, reqResponse + totalReceived, responseLength - totalReceived);
+        if (bytes <= 0) {
+            LOG_WARN("Could not read entire body length");
+            delete[] reqResponse;
+            return bytes == HOST_RECV_TIMEOUT ? SCE_HTTP_ERROR_TIMEOUT : SCE_HTTP_ERROR_NETWORK;
+        }
+        LOG_TRACE("Received {} bytes from {}", bytes, transfer.url);
+
+        totalReceived += bytes;
+    }
+
+    transfer.res.responseRaw = reqResponse;
+    transfer.res.body = reqResponse + transfer.header_length;
+
+    // without a length, the end of the body is not known so the connection can't be used again
+    const auto connectionHeader = transfer.res.headers.find("Connection");
+    const bool serverKeepsAlive = connectionHeader == transfer.res.headers.end()
+        ? transfer.res.httpVer != "1.0"
+        : !boost::iequals(connectionHeader->second, "close") && (transfer.res.httpVer != "1.0" || boost::iequals(connectionHeader->second, "keep-alive"));
+    reusable = transfer.keep_alive && serverKeepsAlive && totalReceived == responseLength
+        && (!hasBody || transfer.res.headers.contains("Content-Length"));
+
+    return 0;
+}
+
+static void run_http_transfer(HttpConnectionPool &pool, HttpTransfer &transfer) {
+    // a request sent on a kept alive connection closed by the server is sent again once on a new connection
+    for (int attempt = 0; attempt < 2; attempt++) {
+        HttpHostConnection conn;
+        const bool reused = attempt == 0 && acquire_pooled_connection(pool, transfer.pool_key, conn);
+        if (!reused) {
+            transfer.result = connect_host(pool, transfer, conn);
+            if (transfer.result < 0)
+                return;
+        }
+
+        bool reusable = false;
+        bool retry = false;
+        transfer.result = send_and_receive(transfer, conn, reused, reusable, retry);
+
+        if (conn.ssl && transfer.result == 0)
+            store_tls_session(pool, transfer.pool_key, (SSL *)conn.ssl);
+
+        if (reusable)
+            release_pooled_connection(pool, transfer.pool_key, conn);
+        else
+            close_host_connection(conn);
+
+        if (!retry)
+            return;
+
+        LOG_TRACE("Kept alive connection to {} was closed, sending the request again", transfer.url);
+    }
+}
+
+static void run_http_io_thread(HttpIoThreads &io) {
+    std::unique_lock<std::mutex> lock(io.mutex);
+    while (true) {
+        io.cond.wait(lock, [&]() { return io.exiting || !io.jobs.empty(); });
+        if (io.exiting)
+            return;
+
+        std::function<void()> job = std::move(io.jobs.front());
+        io.jobs.pop_front();
+        io.idle_threads--;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        io.idle_threads++;
+    }
+}
+
+static void post_http_job(HttpIoThreads &io, std::function<void()> job) {
+    const std::lock_guard<std::mutex> lock(io.mutex);
+    io.jobs.push_back(std::move(job));
+    if (io.idle_threads == 0 && io.threads.size() < HttpIoThreads::MAX_THREADS) {
+        io.threads.emplace_back(run_http_io_thread, std::ref(io));
+        io.idle_threads++;
+    }
+
+    io.cond.notify_one();
+}
+
 EXPORT(int, sceHttpAbortRequest) {
     TRACY_FUNC(sceHttpAbortRequest);
     return UNIMPLEMENTED();
@@ -252,25 +663,21 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
         port = parsed.port;
     // If fifth character is an s (meaning https) use 443, else 80
 
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    assert(sockfd);
-    if (sockfd < 0) {
-        LOG_ERROR("ERROR opening socket");
-        return RET_ERROR(SCE_HTTP_ERROR_UNKNOWN);
+    if (isSecure && emuenv.cfg.http_enable && !emuenv.http.sslInited) {
+        LOG_ERROR("SSL not inited on secure connection");
+        return RET_ERROR(SCE_HTTP_ERROR_SSL);
     }
 
     const addrinfo hints = {
-        AI_PASSIVE, /* For wildcard IP address */
+        0,
         AF_UNSPEC, /* Allow IPv4 or IPv6 */
-        SOCK_DGRAM, /* Datagram socket */
+        SOCK_STREAM,
         0, /* Any protocol */
     };
     addrinfo *result = { 0 };
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-
     auto ret = getaddrinfo(parsed.hostname.c_str(), port.c_str(), &hints, &result);
-    if (ret < 0) {
+    if (ret != 0) {
         if (!emuenv.cfg.http_enable) {
             LOG_WARN("getaddrinfo failed, but http is disabled, asume we still got it");
 
@@ -281,7 +688,7 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
                 }
             }
             // Need to push the connection here so the id exists when "sending" the request
-            emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd });
+            emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, parsed.hostname, port });
 
             return connId;
         }
@@ -289,6 +696,7 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
         LOG_ERROR("getaddrinfo({},{},...) = {}", url, port, ret);
         return RET_ERROR(SCE_HTTP_ERROR_RESOLVER_ENODNS);
     }
+    freeaddrinfo(result);
 
     // We got the ip, send the IPOPBTAINED callback event
     for (auto &callback : emuenv.netctl.callbacks) {
@@ -297,45 +705,8 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
         }
     }
 
-    if (!emuenv.cfg.http_enable) {
-        // Need to push the connection here so the id exists when "sending" the request
-        emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd });
-        return connId;
-    }
-
-    ret = connect(sockfd, result->ai_addr, result->ai_addrlen);
-    if (ret < 0) {
-        LOG_ERROR("connect({},...) = {}, errno={}({})", sockfd, ret, errno, strerror(errno));
-        return RET_ERROR(SCE_HTTP_ERROR_RESOLVER_ENOHOST);
-    }
-
-    LOG_TRACE("Connected to {}", url);
-
-    if (isSecure) {
-        if (!emuenv.http.sslInited) {
-            LOG_ERROR("SSL not inited on secure connection");
-            return RET_ERROR(SCE_HTTP_ERROR_SSL);
-        }
-
-        SSL_set_fd((SSL *)tmpl->second.ssl, sockfd);
-
-        // This is needed as some servers are using handshake protocols older than the person writing this code
-        SSL_set_security_level((SSL *)tmpl->second.ssl, 0);
-
-        int err = SSL_connect((SSL *)tmpl->second.ssl);
-        if (err != 1) {
-            int sslErr = SSL_get_error((SSL *)tmpl->second.ssl, err);
-            LOG_ERROR("SSL_connect(...) = {}, SSLERR = {}", err, sslErr);
-            if (sslErr == SSL_ERROR_SSL)
-                return RET_ERROR(SCE_HTTP_ERROR_SSL);
-        }
-
-        long verify_flag = SSL_get_verify_result((SSL *)tmpl->second.ssl);
-        if (verify_flag != X509_V_OK && verify_flag != X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY)
-            LOG_ERROR("Certificate verification error ({}) but continuing...\n", (int)verify_flag);
-    }
-
-    emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd });
+    // The host socket is connected when the first request is sent, or taken from the connection pool
+    emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, parsed.hostname, port });
 
     return connId;
 }
@@ -549,7 +920,7 @@ EXPORT(SceInt, sceHttpCreateTemplate, const char *userAgent, SceHttpVersion http
     else
         ssl_ctx = SSL_CTX_new(TLS_method());
 
-    SSL_set_mode((SSL *)ssl_ctx, SSL_MODE_AUTO_RETRY);
+    SSL_CTX_set_mode((SSL_CTX *)ssl_ctx, SSL_MODE_AUTO_RETRY);
 
     auto ssl = SSL_new((SSL_CTX *)ssl_ctx);
 
@@ -567,12 +938,8 @@ EXPORT(SceInt, sceHttpDeleteConnection, SceInt connId) {
 
     if (connIt == emuenv.http.connections.end())
         return RET_ERROR(SCE_HTTP_ERROR_INVALID_ID);
-#ifdef WIN32
-    closesocket(connIt->second.sockfd);
-#else
-    close(connIt->second.sockfd);
-#endif // WIN32
 
+    // host sockets belong to the connection pool, they are closed by sceHttpTerm
     emuenv.http.connections.erase(connIt);
 
     return 0;
@@ -1010,196 +1377,47 @@ EXPORT(SceInt, sceHttpSendRequest, SceInt reqId, const char *postData, SceSize s
 
     req->second.message = req->second.requestLine + "\r\n" + headers + "\r\n";
 
-    int msgLength = req->second.message.length();
-    int reqBytesSent = 0;
-    do {
-        int bytes = 0;
-        if (conn->second.isSecure)
-            bytes = SSL_write((SSL *)tmpl->second.ssl, req->second.message.c_str() + reqBytesSent, msgLength - reqBytesSent);
-        else
-            bytes = write(conn->second.sockfd, req->second.message.c_str() + reqBytesSent, msgLength - reqBytesSent);
-
-        if (bytes < 0) {
-            LOG_ERROR("ERROR writing GET message to socket");
-            assert(false);
-            return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-        }
-        LOG_TRACE("Sent {} bytes to {}", bytes, req->second.url);
-        if (bytes == 0)
-            break;
-        reqBytesSent += bytes;
-    } while (reqBytesSent < msgLength);
-
-    if (req->second.method == SCE_HTTP_METHOD_POST || req->second.method == SCE_HTTP_METHOD_PUT) {
-        //  Once we send the request we need to send the actual data
-        SceSize dataSent = 0;
-        auto dataBytes = 0;
-        do {
-            if (conn->second.isSecure)
-                dataBytes = SSL_write((SSL *)tmpl->second.ssl, postData + dataSent, size - dataSent);
-            else
-                dataBytes = write(conn->second.sockfd, postData + dataSent, size - dataSent);
-
-            if (dataBytes < 0) {
-                LOG_ERROR("ERROR writing POST data to socket");
-                assert(false);
-                return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-            }
-            LOG_TRACE("Sent {} data bytes to {}", dataBytes, req->second.url);
-            if (dataBytes == 0)
-                break;
-            dataSent += dataBytes;
-        } while (dataSent < size);
-    }
-
-    // Make sockets non blocking only for the response
-    // as we can run out of data to read so it blocks like a whole minute
-    if (!net_utils::socketSetBlocking(conn->second.sockfd, false)) {
-        LOG_WARN("Failed to change blocking, socket={}, blocking={}", conn->second.sockfd, false);
-        assert(false);
-    }
-
-    /* receive the response */
-    int attempts = 1;
-
-    auto resHeaders = new char[emuenv.http.defaultResponseHeaderSize]();
-    auto resHeadersMaxSize = emuenv.http.defaultResponseHeaderSize;
-    int totalReceived = 0;
-    do {
-        int bytes = 0;
-        if (conn->second.isSecure)
-            bytes = SSL_read((SSL *)tmpl->second.ssl, resHeaders + totalReceived, resHeadersMaxSize - totalReceived);
-        else
-            bytes = read(conn->second.sockfd, resHeaders + totalReceived, resHeadersMaxSize - totalReceived);
-        if (bytes < 0) {
-            if (bytes == -1) {
-                if (errno == EWOULDBLOCK) {
-                    if (attempts > emuenv.cfg.http_read_end_attempts)
-                        break; // we can assume there is no more data to read
-                    LOG_TRACE("No data available. Sleep for {}. Attempt {}", emuenv.cfg.http_read_end_sleep_ms, attempts);
-                    std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_read_end_sleep_ms));
-                    attempts++;
-                    continue;
-                } else {
-                    LOG_ERROR("ERROR reading GET response headers");
-                    assert(false);
-                    delete[] resHeaders;
-                    return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-                }
-            }
-        }
-        LOG_TRACE("Received {} bytes from {}", bytes, req->second.url);
-        if (bytes == 0) {
-            if (strcmp(resHeaders, "") == 0) {
-                if (attempts > emuenv.cfg.http_timeout_attempts)
-                    break; // Give up
-                LOG_TRACE("Response is null. Sleep for {}. Attempt {}", emuenv.cfg.http_timeout_sleep_ms, attempts);
-                std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_timeout_sleep_ms));
-                attempts++;
-                continue;
-            }
-            break;
-        }
-
-        totalReceived += bytes;
-    } while (std::string_view(resHeaders).find("\r\n\r\n") == std::string::npos || totalReceived == resHeadersMaxSize); // receive headers until we start receiving body
-
-    if (totalReceived != resHeadersMaxSize && std::string_view(resHeaders).find("\r\n\r\n") == std::string::npos) {
-        delete[] resHeaders;
-        return RET_ERROR(SCE_HTTP_ERROR_TIMEOUT);
-    }
-
-    // Headers are too big
-    if (totalReceived == resHeadersMaxSize && std::string_view(resHeaders).find("\r\n\r\n") == std::string::npos) {
-        delete[] resHeaders;
-        return RET_ERROR(SCE_HTTP_ERROR_TOO_LARGE_RESPONSE_HEADER);
-    }
-
-    const auto resHeadersStr = std::string(resHeaders);
-    const auto resHeadersOnly = resHeadersStr.substr(0, resHeadersStr.find("\r\n\r\n"));
-    if (!net_utils::parseResponse(resHeadersOnly, req->second.res)) {
-        delete[] resHeaders;
-        return RET_ERROR(SCE_HTTP_ERROR_PARSE_HTTP_INVALID_RESPONSE);
+    HttpTransfer transfer;
+    transfer.url = req->second.url;
+    transfer.hostname = conn->second.hostname;
+    transfer.port = conn->second.port;
+    transfer.pool_key = (conn->second.isSecure ? "https://" : "http://") + conn->second.hostname + ":" + conn->second.port;
+    if (conn->second.isSecure) {
+        // templates with their own context can have other verify options, so they get their own connections
+        transfer.ssl_ctx = SSL_get_SSL_CTX((SSL *)tmpl->second.ssl);
+        transfer.pool_key += "#" + std::to_string((uintptr_t)transfer.ssl_ctx);
     }
-
-    // TODO: does a HEAD/OPTIONS request need content-length to exist?
-    if (req->second.res.headers.find("content-length") == req->second.headers.end()) {
-        delete[] resHeaders;
-        return RET_ERROR(SCE_HTTP_ERROR_NO_CONTENT_LENGTH);
-    }
-
-    LOG_TRACE("Request replied with status code {}", req->second.res.statusCode);
-
-    // Now we get the body or the rest of the body
-    attempts = 1; // Reset attempts
-    const int responseLength = resHeadersStr.find("\r\n\r\n") + strlen("\r\n\r\n") + req->second.res.contentLength;
-    if (req->second.method == SCE_HTTP_METHOD_HEAD || req->second.method == SCE_HTTP_METHOD_OPTIONS) // even if we have content-length, there will be no body
-        const int responseLength = resHeadersStr.find("\r\n\r\n") + strlen("\r\n\r\n");
-
-    // This is the entire response, including headers and everything
-    auto reqResponse = new uint8_t[responseLength]();
-    memcpy(reqResponse, resHeaders, std::min(emuenv.http.defaultResponseHeaderSize, responseLength));
-    delete[] resHeaders;
-
-    int remainingToRead = responseLength - totalReceived;
-
-    while (remainingToRead != 0) {
-        int bytes = 0;
-        if (conn->second.isSecure)
-            bytes = SSL_read((SSL *)tmpl->second.ssl, reqResponse + totalReceived, remainingToRead);
-        else
-            bytes = read(conn->second.sockfd, reqResponse + totalReceived, remainingToRead);
-        if (bytes < 0) {
-            if (bytes == -1) {
-                if (errno == EWOULDBLOCK) {
-                    if (attempts > emuenv.cfg.http_read_end_attempts)
-                        break; // we can assume there is no more data to read
-                    LOG_TRACE("No data available. Sleep for {}. Attempt {}", emuenv.cfg.http_read_end_sleep_ms, attempts);
-                    std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_read_end_sleep_ms));
-                    attempts++;
-                    continue;
-                } else {
-                    LOG_ERROR("ERROR reading GET response");
-                    assert(false);
-                    delete[] reqResponse;
-                    return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-                }
-            }
-        }
-        LOG_TRACE("Received {} bytes from {}", bytes, req->second.url);
-        if (bytes == 0) {
-            if (attempts > emuenv.cfg.http_timeout_attempts)
-                break; // Give up
-            LOG_TRACE("Response is null. Sleep for {}. Attempt {}", emuenv.cfg.http_timeout_sleep_ms, attempts);
-            std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_timeout_sleep_ms));
-            attempts++;
-            continue;
-        }
-
-        totalReceived += bytes;
-        remainingToRead -= bytes;
-    }
-
-    if (!net_utils::socketSetBlocking(conn->second.sockfd, true)) {
-        LOG_WARN("Failed to change blocking, socket={}, blocking={}", conn->second.sockfd, true);
-        assert(false);
+    transfer.keep_alive = tmpl->second.httpVersion == SCE_HTTP_VERSION_1_1 && conn->second.keepAlive;
+    transfer.is_head = req->second.method == SCE_HTTP_METHOD_HEAD;
+    transfer.message = req->second.message;
+    if (req->second.method == SCE_HTTP_METHOD_POST || req->second.method == SCE_HTTP_METHOD_PUT) {
+        transfer.post_data = postData;
+        transfer.post_size = size;
     }
-
-    if (remainingToRead != 0) {
-        LOG_WARN("Could not read entire body length");
-        delete[] reqResponse;
-        return RET_ERROR(SCE_HTTP_ERROR_TIMEOUT);
+    transfer.header_max_size = emuenv.http.defaultResponseHeaderSize;
+    transfer.response_timeout_ms = std::max(emuenv.cfg.http_timeout_attempts, 1) * emuenv.cfg.http_timeout_sleep_ms;
+    transfer.read_timeout_ms = std::max(emuenv.cfg.http_read_end_attempts, 1) * emuenv.cfg.http_read_end_sleep_ms;
+
+    // The round trip is done by an io thread, the calling thread waits like for any other blocking call
+    {
+        auto thread_lock = std::unique_lock(thread->mutex);
+        thread->update_status(ThreadStatus::wait);
+        post_http_job(emuenv.http.io_threads, [&, thread = thread]() {
+            run_http_transfer(emuenv.http.pool, transfer);
+
+            const std::lock_guard<std::mutex> lock(thread->mutex);
+            transfer.done = true;
+            thread->update_status(ThreadStatus::run);
+        });
+        thread->status_cond.wait(thread_lock, [&]() { return transfer.done; });
     }
 
-    if (*reqResponse == 0) {
-        LOG_ERROR("Received empty GET response. Probably due to unknown protocol");
-        assert(false);
-        delete[] reqResponse;
-        return RET_ERROR(SCE_HTTP_ERROR_BAD_RESPONSE);
-    }
+    if (transfer.result < 0)
+        return RET_ERROR(transfer.result);
 
-    req->second.res.responseRaw = reqResponse;
-    req->second.res.body = reqResponse + resHeadersOnly.length() + strlen("\r\n\r\n");
+    if (req->second.res.responseRaw)
+        delete[] req->second.res.responseRaw;
+    req->second.res = std::move(transfer.res);
 
     LOG_TRACE("Request finished nicely");
 
@@ -1384,6 +1602,8 @@ EXPORT(SceInt, sceHttpTerm) {
         free(emuenv.mem, pointer.address());
     }
 
+    clear_connection_pool(emuenv.http.pool);
+
     return 0;
 }
 
@@ -17,12 +17,34 @@
 
 #include "SceIofilemgr.h"
 
+#include <io/device.h>
 #include <io/functions.h>
+#include <io/io.h>
+#include <io/state.h>
+#include <kernel/state.h>
+#include <kernel/sync_primitives.h>
 #include <kernel/types.h>
 
 #include <util/tracy.h>
 TRACY_MODULE_NAME(SceIofilemgr);
 
+// The operation is done on the worker of the device, its UID is a kernel event set once it is done,
+// so that the guest can also wait for it with sceKernelWaitEvent.
+static SceUID submit_async(EmuEnvState &emuenv, const ThreadStatePtr &thread, const char *export_name, VitaIoDevice device, AsyncIoRequest request) {
+    const SceUID op_id = simple_event_create(emuenv.kernel, emuenv.mem, export_name, "SceIoAsyncOp", thread, SCE_KERNEL_EVENT_ATTR_MANUAL_RESET, 0);
+    if (op_id < 0)
+        return op_id;
+
+    submit_async_io_op(emuenv.io.async_io, op_id, device, std::move(request), [&emuenv, thread, export_name, op_id]() {
+        simple_event_setorpulse(emuenv.kernel, export_name, thread, op_id, SCE_KERNEL_EVENT_IN | SCE_KERNEL_EVENT_OUT, 0, true);
+    });
+    return op_id;
+}
+
+static SceUID submit_async_by_fd(EmuEnvState &emuenv, const ThreadStatePtr &thread, const char *export_name, const SceUID fd, AsyncIoRequest request) {
+    return submit_async(emuenv, thread, export_name, get_fd_device(emuenv.io, fd), std::move(request));
+}
+
 EXPORT(int, _sceIoChstat) {
     TRACY_FUNC(_sceIoChstat);
     return UNIMPLEMENTED();
@@ -71,9 +93,14 @@ EXPORT(int, _sceIoGetstat, const char *file, SceIoStat *stat) {
     return stat_file(emuenv.io, file, stat, emuenv.pref_path.wstring(), export_name);
 }
 
-EXPORT(int, _sceIoGetstatAsync) {
-    TRACY_FUNC(_sceIoGetstatAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoGetstatAsync, const char *file, SceIoStat *stat) {
+    TRACY_FUNC(_sceIoGetstatAsync, file, stat);
+    if (file == nullptr || stat == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async(emuenv, thread, export_name, device::get_device(file), [&emuenv, file = std::string(file), stat, export_name]() {
+        return stat_file(emuenv.io, file.c_str(), stat, emuenv.pref_path.wstring(), export_name);
+    });
 }
 
 EXPORT(int, _sceIoGetstatByFd, const SceUID fd, SceIoStat *stat) {
@@ -96,9 +123,13 @@ EXPORT(SceOff, _sceIoLseek, const SceUID fd, Ptr<_sceIoLseekOpt> opt) {
     return seek_file(fd, opt.get(emuenv.mem)->offset, opt.get(emuenv.mem)->whence, emuenv.io, export_name);
 }
 
-EXPORT(int, _sceIoLseekAsync) {
-    TRACY_FUNC(_sceIoLseekAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoLseekAsync, const SceUID fd, Ptr<_sceIoLseekOpt> opt) {
+    TRACY_FUNC(_sceIoLseekAsync, fd, opt);
+    const SceOff offset = opt.get(emuenv.mem)->offset;
+    const SceIoSeekMode whence = opt.get(emuenv.mem)->whence;
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, offset, whence, export_name]() {
+        return seek_file(fd, offset, whence, emuenv.io, export_name);
+    });
 }
 
 EXPORT(int, _sceIoMkdir, const char *dir, const SceMode mode) {
@@ -106,9 +137,14 @@ EXPORT(int, _sceIoMkdir, const char *dir, const SceMode mode) {
     return create_dir(emuenv.io, dir, mode, emuenv.pref_path.wstring(), export_name);
 }
 
-EXPORT(int, _sceIoMkdirAsync) {
-    TRACY_FUNC(_sceIoMkdirAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoMkdirAsync, const char *dir, const SceMode mode) {
+    TRACY_FUNC(_sceIoMkdirAsync, dir, mode);
+    if (dir == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async(emuenv, thread, export_name, device::get_device(dir), [&emuenv, dir = std::string(dir), mode, export_name]() {
+        return create_dir(emuenv.io, dir.c_str(), mode, emuenv.pref_path.wstring(), export_name);
+    });
 }
 
 EXPORT(int, _sceIoOpen, const char *file, const int flags, const SceMode mode) {
@@ -120,9 +156,15 @@ EXPORT(int, _sceIoOpen, const char *file, const int flags, const SceMode mode) {
     return open_file(emuenv.io, file, flags, emuenv.pref_path.wstring(), export_name);
 }
 
-EXPORT(int, _sceIoOpenAsync) {
-    TRACY_FUNC(_sceIoOpenAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoOpenAsync, const char *file, const int flags, const SceMode mode) {
+    TRACY_FUNC(_sceIoOpenAsync, file, flags, mode);
+    if (file == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    LOG_INFO("Opening file asynchronously: {}", file);
+    return submit_async(emuenv, thread, export_name, device::get_device(file), [&emuenv, file = std::string(file), flags, export_name]() {
+        return open_file(emuenv.io, file.c_str(), flags, emuenv.pref_path.wstring(), export_name);
+    });
 }
 
 EXPORT(int, _sceIoPread) {
@@ -130,9 +172,15 @@ EXPORT(int, _sceIoPread) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, _sceIoPreadAsync) {
-    TRACY_FUNC(_sceIoPreadAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoPreadAsync, const SceUID fd, void *data, const SceSize size, Ptr<_sceIoPreadOpt> opt) {
+    TRACY_FUNC(_sceIoPreadAsync, fd, data, size, opt);
+    if (data == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    const SceOff offset = opt.get(emuenv.mem)->offset;
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, data, size, offset, export_name]() {
+        return pread_file(data, emuenv.io, fd, size, offset, export_name);
+    });
 }
 
 EXPORT(int, _sceIoPwrite) {
@@ -140,9 +188,15 @@ EXPORT(int, _sceIoPwrite) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, _sceIoPwriteAsync) {
-    TRACY_FUNC(_sceIoPwriteAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoPwriteAsync, const SceUID fd, const void *data, const SceSize size, Ptr<_sceIoPreadOpt> opt) {
+    TRACY_FUNC(_sceIoPwriteAsync, fd, data, size, opt);
+    if (data == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    const SceOff offset = opt.get(emuenv.mem)->offset;
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, data, size, offset, export_name]() {
+        return pwrite_file(fd, data, size, offset, emuenv.io, export_name);
+    });
 }
 
 EXPORT(int, _sceIoRemove) {
@@ -150,9 +204,14 @@ EXPORT(int, _sceIoRemove) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, _sceIoRemoveAsync) {
-    TRACY_FUNC(_sceIoRemoveAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoRemoveAsync, const char *file) {
+    TRACY_FUNC(_sceIoRemoveAsync, file);
+    if (file == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async(emuenv, thread, export_name, device::get_device(file), [&emuenv, file = std::string(file), export_name]() {
+        return remove_file(emuenv.io, file.c_str(), emuenv.pref_path.wstring(), export_name);
+    });
 }
 
 EXPORT(int, _sceIoRename) {
@@ -160,9 +219,15 @@ EXPORT(int, _sceIoRename) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, _sceIoRenameAsync) {
-    TRACY_FUNC(_sceIoRenameAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoRenameAsync, const char *oldname, const char *newname) {
+    TRACY_FUNC(_sceIoRenameAsync, oldname, newname);
+    if (oldname == nullptr || newname == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    LOG_INFO("Renaming asynchronously: {} to {}", oldname, newname);
+    return submit_async(emuenv, thread, export_name, device::get_device(oldname), [&emuenv, oldname = std::string(oldname), newname = std::string(newname), export_name]() {
+        return rename(emuenv.io, oldname.c_str(), newname.c_str(), emuenv.pref_path.wstring(), export_name);
+    });
 }
 
 EXPORT(int, _sceIoRmdir) {
@@ -170,24 +235,44 @@ EXPORT(int, _sceIoRmdir) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, _sceIoRmdirAsync) {
-    TRACY_FUNC(_sceIoRmdirAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoRmdirAsync, const char *dir) {
+    TRACY_FUNC(_sceIoRmdirAsync, dir);
+    if (dir == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async(emuenv, thread, export_name, device::get_device(dir), [&emuenv, dir = std::string(dir), export_name]() {
+        return remove_dir(emuenv.io, dir.c_str(), emuenv.pref_path.wstring(), export_name);
+    });
 }
 
-EXPORT(int, _sceIoSync) {
-    TRACY_FUNC(_sceIoSync);
-    return UNIMPLEMENTED();
+EXPORT(int, _sceIoSync, const char *device, const unsigned int unk) {
+    TRACY_FUNC(_sceIoSync, device, unk);
+    if (device == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return sync_device(emuenv.io, device, export_name);
 }
 
-EXPORT(int, _sceIoSyncAsync) {
-    TRACY_FUNC(_sceIoSyncAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoSyncAsync, const char *device, const unsigned int unk) {
+    TRACY_FUNC(_sceIoSyncAsync, device, unk);
+    if (device == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async(emuenv, thread, export_name, device::get_device(device), [&emuenv, device = std::string(device), export_name]() {
+        return sync_device(emuenv.io, device.c_str(), export_name);
+    });
 }
 
-EXPORT(int, sceIoCancel) {
-    TRACY_FUNC(sceIoCancel);
-    return UNIMPLEMENTED();
+EXPORT(int, sceIoCancel, const SceUID op_id) {
+    TRACY_FUNC(sceIoCancel, op_id);
+    if (!is_async_io_op(emuenv.io.async_io, op_id)) {
+        return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_UID);
+    }
+    // the operation still sets its event, with a cancelled result
+    if (!cancel_async_io_op(emuenv.io.async_io, op_id)) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EBUSY);
+    }
+    return 0;
 }
 
 EXPORT(int, sceIoChstatByFdAsync) {
@@ -200,14 +285,29 @@ EXPORT(int, sceIoClose, const SceUID fd) {
     return close_file(emuenv.io, fd, export_name);
 }
 
-EXPORT(int, sceIoCloseAsync) {
-    TRACY_FUNC(sceIoCloseAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoCloseAsync, const SceUID fd) {
+    TRACY_FUNC(sceIoCloseAsync, fd);
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, export_name]() {
+        return close_file(emuenv.io, fd, export_name);
+    });
 }
 
-EXPORT(int, sceIoComplete) {
-    TRACY_FUNC(sceIoComplete);
-    return UNIMPLEMENTED();
+EXPORT(SceInt64, sceIoComplete, const SceUID op_id) {
+    TRACY_FUNC(sceIoComplete, op_id);
+    if (!is_async_io_op(emuenv.io.async_io, op_id)) {
+        return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_UID);
+    }
+
+    const SceInt32 res = simple_event_waitorpoll(emuenv.kernel, export_name, thread, op_id, SCE_KERNEL_EVENT_IN | SCE_KERNEL_EVENT_OUT, nullptr, nullptr, nullptr, true);
+    if (res < 0)
+        return res;
+
+    SceInt64 result = 0;
+    if (!take_async_io_result(emuenv.io.async_io, op_id, result)) {
+        return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_UID);
+    }
+    simple_event_delete(emuenv.kernel, export_name, thread, op_id);
+    return result;
 }
 
 EXPORT(int, sceIoDclose, const SceUID fd) {
@@ -215,19 +315,31 @@ EXPORT(int, sceIoDclose, const SceUID fd) {
     return close_dir(emuenv.io, fd, export_name);
 }
 
-EXPORT(int, sceIoDcloseAsync) {
-    TRACY_FUNC(sceIoDcloseAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoDcloseAsync, const SceUID fd) {
+    TRACY_FUNC(sceIoDcloseAsync, fd);
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, export_name]() {
+        return close_dir(emuenv.io, fd, export_name);
+    });
 }
 
-EXPORT(int, sceIoDopenAsync) {
-    TRACY_FUNC(sceIoDopenAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoDopenAsync, const char *dir) {
+    TRACY_FUNC(sceIoDopenAsync, dir);
+    if (dir == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async(emuenv, thread, export_name, device::get_device(dir), [&emuenv, dir = std::string(dir), export_name]() {
+        return open_dir(emuenv.io, dir.c_str(), emuenv.pref_path.wstring(), export_name);
+    });
 }
 
-EXPORT(int, sceIoDreadAsync) {
-    TRACY_FUNC(sceIoDreadAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoDreadAsync, const SceUID fd, SceIoDirent *dir) {
+    TRACY_FUNC(sceIoDreadAsync, fd, dir);
+    if (dir == nullptr) {
+        return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_ADDR);
+    }
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, dir, export_name]() {
+        return read_dir(emuenv.io, fd, dir, emuenv.pref_path.wstring(), export_name);
+    });
 }
 
 EXPORT(int, sceIoFlockForSystem) {
@@ -260,9 +372,14 @@ EXPORT(int, sceIoGetThreadDefaultPriorityForSystem) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceIoGetstatByFdAsync) {
-    TRACY_FUNC(sceIoGetstatByFdAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoGetstatByFdAsync, const SceUID fd, SceIoStat *stat) {
+    TRACY_FUNC(sceIoGetstatByFdAsync, fd, stat);
+    if (stat == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, stat, export_name]() {
+        return stat_file_by_fd(emuenv.io, fd, stat, emuenv.pref_path.wstring(), export_name);
+    });
 }
 
 EXPORT(int, sceIoLseek32, const SceUID fd, const int32_t offset, const SceIoSeekMode whence) {
@@ -275,9 +392,14 @@ EXPORT(int, sceIoRead, const SceUID fd, void *data, const SceSize size) {
     return read_file(data, emuenv.io, fd, size, export_name);
 }
 
-EXPORT(int, sceIoReadAsync) {
-    TRACY_FUNC(sceIoReadAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoReadAsync, const SceUID fd, void *data, const SceSize size) {
+    TRACY_FUNC(sceIoReadAsync, fd, data, size);
+    if (data == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, data, size, export_name]() {
+        return read_file(data, emuenv.io, fd, size, export_name);
+    });
 }
 
 EXPORT(int, sceIoSetPriority) {
@@ -305,14 +427,16 @@ EXPORT(int, sceIoSetThreadDefaultPriorityForSystem) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceIoSyncByFd) {
-    TRACY_FUNC(sceIoSyncByFd);
-    return UNIMPLEMENTED();
+EXPORT(int, sceIoSyncByFd, const SceUID fd, const int flag) {
+    TRACY_FUNC(sceIoSyncByFd, fd, flag);
+    return sync_file(emuenv.io, fd, export_name);
 }
 
-EXPORT(int, sceIoSyncByFdAsync) {
-    TRACY_FUNC(sceIoSyncByFdAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoSyncByFdAsync, const SceUID fd, const int flag) {
+    TRACY_FUNC(sceIoSyncByFdAsync, fd, flag);
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, export_name]() {
+        return sync_file(emuenv.io, fd, export_name);
+    });
 }
 
 EXPORT(int, sceIoWrite, const SceUID fd, const void *data, const SceSize size) {
@@ -320,7 +444,12 @@ EXPORT(int, sceIoWrite, const SceUID fd, const void *data, const SceSize size) {
     return write_file(fd, data, size, emuenv.io, export_name);
 }
 
-EXPORT(int, sceIoWriteAsync) {
-    TRACY_FUNC(sceIoWriteAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoWriteAsync, const SceUID fd, const void *data, const SceSize size) {
+    TRACY_FUNC(sceIoWriteAsync, fd, data, size);
+    if (data == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    return submit_async_by_fd(emuenv, thread, export_name, fd, [&emuenv, fd, data, size, export_name]() {
+        return write_file(fd, data, size, emuenv.io, export_name);
+    });
 }
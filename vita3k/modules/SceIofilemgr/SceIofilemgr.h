@@ -26,8 +26,25 @@ typedef struct _sceIoLseekOpt {
     uint32_t unk;
 } _sceIoLseekOpt;
 
+// also used by _sceIoPwrite
+typedef struct _sceIoPreadOpt {
+    SceOff offset;
+    uint32_t unk;
+} _sceIoPreadOpt;
+
 DECL_EXPORT(int, _sceIoDopen, const char *dir);
 DECL_EXPORT(int, _sceIoDread, const SceUID fd, SceIoDirent *dir);
 DECL_EXPORT(int, _sceIoMkdir, const char *dir, const SceMode mode);
 DECL_EXPORT(SceOff, _sceIoLseek, const SceUID fd, Ptr<_sceIoLseekOpt> opt);
 DECL_EXPORT(int, _sceIoGetstat, const char *file, SceIoStat *stat);
+DECL_EXPORT(SceUID, _sceIoGetstatAsync, const char *file, SceIoStat *stat);
+DECL_EXPORT(SceUID, _sceIoLseekAsync, const SceUID fd, Ptr<_sceIoLseekOpt> opt);
+DECL_EXPORT(SceUID, _sceIoMkdirAsync, const char *dir, const SceMode mode);
+DECL_EXPORT(SceUID, _sceIoOpenAsync, const char *file, const int flags, const SceMode mode);
+DECL_EXPORT(SceUID, _sceIoPreadAsync, const SceUID fd, void *data, const SceSize size, Ptr<_sceIoPreadOpt> opt);
+DECL_EXPORT(SceUID, _sceIoPwriteAsync, const SceUID fd, const void *data, const SceSize size, Ptr<_sceIoPreadOpt> opt);
+DECL_EXPORT(SceUID, _sceIoRemoveAsync, const char *file);
+DECL_EXPORT(SceUID, _sceIoRenameAsync, const char *oldname, const char *newname);
+DECL_EXPORT(SceUID, _sceIoRmdirAsync, const char *dir);
+DECL_EXPORT(int, _sceIoSync, const char *device, const unsigned int unk);
+DECL_EXPORT(SceUID, _sceIoSyncAsync, const char *device, const unsigned int unk);
@@ -28,7 +28,42 @@ typedef std::shared_ptr<MjpegDecoderState> DecoderPtr;
 
 struct MJpegState {
     bool initialized = false;
+    std::mutex mutex;
+    // decoders not used by a thread, the threads decoding at the same time each take their own
+    std::vector<DecoderPtr> free_decoders;
+};
+
+// allocate the decoders asked by the game
+static void init_decoders(MJpegState &state, int32_t decoder_count) {
+    const std::lock_guard<std::mutex> lock(state.mutex);
+    state.free_decoders.clear();
+    for (int32_t i = 0; i < std::max(decoder_count, 1); i++)
+        state.free_decoders.push_back(std::make_shared<MjpegDecoderState>());
+}
+
+// Decoder used by a thread until it goes out of scope.
+// If another thread is using all the decoders, a new one is created instead of waiting for it.
+class DecoderLock {
+    MJpegState &state;
+
+public:
     DecoderPtr decoder;
+
+    explicit DecoderLock(MJpegState &state)
+        : state(state) {
+        const std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.free_decoders.empty()) {
+            decoder = std::make_shared<MjpegDecoderState>();
+        } else {
+            decoder = std::move(state.free_decoders.back());
+            state.free_decoders.pop_back();
+        }
+    }
+
+    ~DecoderLock() {
+        const std::lock_guard<std::mutex> lock(state.mutex);
+        state.free_decoders.push_back(std::move(decoder));
+    }
 };
 
 struct SceJpegMJpegInitInfo {
@@ -106,16 +141,12 @@ EXPORT(int, sceJpegDecodeMJpeg, const unsigned char *pJpeg, SceSize isize, uint8
     TRACY_FUNC(sceJpegDecodeMJpeg, pJpeg, isize, pRGBA, osize, decodeMode, pTempBuffer, tempBufferSize, pCoefBuffer, coefBufferSize);
 
     const auto state = emuenv.kernel.obj_store.get<MJpegState>();
+    const DecoderLock lock(*state);
 
     DecoderSize size = {};
 
-    // allocates i think an extra frame but i want to be careful here
-    std::vector<uint8_t> temporary(osize);
-
-    state->decoder->send(pJpeg, isize);
-    state->decoder->receive(temporary.data(), &size);
-
-    convert_yuv_to_rgb(temporary.data(), pRGBA, size.width, size.height, state->decoder->get_color_space());
+    lock.decoder->send(pJpeg, isize);
+    lock.decoder->receive_rgba(pRGBA, osize, &size);
 
     // Top 16 bits = width, bottom 16 bits = height.
     return (size.width << 16u) | size.height;
@@ -125,11 +156,12 @@ EXPORT(int, sceJpegDecodeMJpegYCbCr, const uint8_t *jpeg_data, uint32_t jpeg_siz
     uint8_t *output, uint32_t output_size, int mode, void *buffer, uint32_t buffer_size) {
     TRACY_FUNC(sceJpegDecodeMJpegYCbCr, jpeg_data, jpeg_size, output, output_size, mode, buffer, buffer_size);
     const auto state = emuenv.kernel.obj_store.get<MJpegState>();
+    const DecoderLock lock(*state);
 
     DecoderSize size = {};
 
-    state->decoder->send(jpeg_data, jpeg_size);
-    state->decoder->receive(output, &size);
+    lock.decoder->send(jpeg_data, jpeg_size);
+    lock.decoder->receive(output, &size);
 
     // Top 16 bits = width, bottom 16 bits = height.
     return (size.width << 16u) | size.height;
@@ -169,13 +201,19 @@ EXPORT(int, sceJpegGetOutputInfo, const uint8_t *jpeg_data, uint32_t jpeg_size,
     }
 
     DecoderSize size = {};
-
-    state->decoder->send(jpeg_data, jpeg_size);
-    state->decoder->receive(nullptr, &size);
+    DecoderColorSpace color_space;
+
+    // the frame header is enough to get the info, only decode the images it can't be read from
+    if (!read_jpeg_info(jpeg_data, jpeg_size, size, color_space)) {
+        const DecoderLock lock(*state);
+        lock.decoder->send(jpeg_data, jpeg_size);
+        lock.decoder->receive(nullptr, &size);
+        color_space = lock.decoder->get_color_space();
+    }
 
     output->width = size.width;
     output->height = size.height;
-    output->color_space = convert_color_space_decoder_to_jpeg(state->decoder->get_color_space());
+    output->color_space = convert_color_space_decoder_to_jpeg(color_space);
     if (format == 0) {
         output->output_size = size.width * size.height * 4;
     } else {
@@ -208,7 +246,7 @@ EXPORT(int, sceJpegInitMJpeg, int32_t decoder_count) {
     TRACY_FUNC(sceJpegInitMJpeg, decoder_count);
     emuenv.kernel.obj_store.create<MJpegState>();
     const auto state = emuenv.kernel.obj_store.get<MJpegState>();
-    state->decoder = std::make_shared<MjpegDecoderState>();
+    init_decoders(*state, decoder_count);
 
     return 0;
 }
@@ -217,7 +255,7 @@ EXPORT(int, sceJpegInitMJpegWithParam, const SceJpegMJpegInitInfo *info) {
     TRACY_FUNC(sceJpegInitMJpegWithParam, info);
     emuenv.kernel.obj_store.create<MJpegState>();
     const auto state = emuenv.kernel.obj_store.get<MJpegState>();
-    state->decoder = std::make_shared<MjpegDecoderState>();
+    init_decoders(*state, info->decoder_count);
 
     return 0;
 }
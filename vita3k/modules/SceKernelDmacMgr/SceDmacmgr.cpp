@@ -17,10 +17,25 @@
 
 #include <module/module.h>
 
-EXPORT(int, sceDmacMemcpy) {
-    return UNIMPLEMENTED();
+#include <mem/functions.h>
+
+// The transfers are done on the host before returning, as the guest expects them to be done once the call returns.
+// The large ones are split between the calling thread and the transfer workers of the memory.
+
+EXPORT(Ptr<void>, sceDmacMemcpy, Ptr<void> dst, Ptr<const void> src, SceSize size) {
+    if (!copy_memory(emuenv.mem, dst.address(), src.address(), size)) {
+        LOG_ERROR("Invalid copy from {} to {} of size {}", log_hex(src.address()), log_hex(dst.address()), log_hex(size));
+        return Ptr<void>();
+    }
+
+    return dst;
 }
 
-EXPORT(int, sceDmacMemset) {
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, sceDmacMemset, Ptr<void> dst, int c, SceSize size) {
+    if (!fill_memory(emuenv.mem, dst.address(), static_cast<uint8_t>(c), size)) {
+        LOG_ERROR("Invalid fill of {} of size {}", log_hex(dst.address()), log_hex(size));
+        return Ptr<void>();
+    }
+
+    return dst;
 }
@@ -131,7 +131,7 @@ EXPORT(int, sceKernelGetModuleInfo, SceUID modid, SceKernelModuleInfo *info) {
 
 EXPORT(int, sceKernelGetModuleList, int flags, SceUID *modids, int *num) {
     TRACY_FUNC(sceKernelGetModuleList, flags, modids, num);
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
     // for Maidump main module should be the last module
     int i = 0;
     SceUID main_module_id = 0;
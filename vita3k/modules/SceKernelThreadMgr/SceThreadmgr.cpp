@@ -23,8 +23,10 @@
 #include <kernel/sync_primitives.h>
 #include <kernel/types.h>
 #include <packages/functions.h>
+#include <rtc/rtc.h>
 
 #include <util/lock_and_find.h>
+#include <util/precise_sleep.h>
 
 #include <chrono>
 #include <thread>
@@ -33,9 +35,7 @@
 TRACY_MODULE_NAME(SceThreadmgr);
 
 inline uint64_t get_current_time() {
-    return std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch())
-        .count();
+    return rtc_ticks_since_epoch();
 }
 
 EXPORT(int, __sceKernelCreateLwMutex, Ptr<SceKernelLwMutexWork> workarea, const char *name, unsigned int attr, Ptr<SceKernelCreateLwMutex_opt> opt) {
@@ -44,7 +44,7 @@ EXPORT(int, __sceKernelCreateLwMutex, Ptr<SceKernelLwMutexWork> workarea, const
     assert(opt.get(emuenv.mem)->init_count >= 0);
 
     auto uid_out = &workarea.get(emuenv.mem)->uid;
-    return mutex_create(uid_out, emuenv.kernel, emuenv.mem, export_name, name, thread_id, attr, opt.get(emuenv.mem)->init_count, workarea, SyncWeight::Light);
+    return mutex_create(uid_out, emuenv.kernel, emuenv.mem, export_name, name, thread, attr, opt.get(emuenv.mem)->init_count, workarea, SyncWeight::Light);
 }
 
 EXPORT(int, _sceKernelCancelEvent) {
@@ -54,7 +54,7 @@ EXPORT(int, _sceKernelCancelEvent) {
 
 EXPORT(SceInt32, _sceKernelCancelEventFlag, SceUID event_id, SceUInt pattern, SceUInt32 *num_wait_thread) {
     TRACY_FUNC(_sceKernelCancelEventFlag, event_id, pattern, num_wait_thread);
-    return eventflag_cancel(emuenv.kernel, export_name, thread_id, event_id, pattern, num_wait_thread);
+    return eventflag_cancel(emuenv.kernel, export_name, thread, event_id, pattern, num_wait_thread);
 }
 
 EXPORT(int, _sceKernelCancelEventWithSetPattern) {
@@ -79,7 +79,7 @@ EXPORT(int, _sceKernelCancelRWLock) {
 
 EXPORT(int, _sceKernelCancelSema, SceUID semaId, SceInt32 setCount, SceUInt32 *pNumWaitThreads) {
     TRACY_FUNC(_sceKernelCancelSema, semaId, setCount, pNumWaitThreads);
-    return semaphore_cancel(emuenv.kernel, export_name, thread_id, semaId, setCount, pNumWaitThreads);
+    return semaphore_cancel(emuenv.kernel, export_name, thread, semaId, setCount, pNumWaitThreads);
 }
 
 EXPORT(int, _sceKernelCancelTimer) {
@@ -91,7 +91,7 @@ EXPORT(SceUID, _sceKernelCreateCond, const char *pName, SceUInt32 attr, SceUID m
     TRACY_FUNC(_sceKernelCreateCond, pName, attr, mutexId, pOptParam);
     SceUID uid;
 
-    if (auto error = condvar_create(&uid, emuenv.kernel, export_name, pName, thread_id, attr, mutexId, SyncWeight::Heavy)) {
+    if (auto error = condvar_create(&uid, emuenv.kernel, emuenv.mem, export_name, pName, thread, attr, mutexId, Ptr<SceKernelLwCondWork>(0), SyncWeight::Heavy)) {
         return error;
     }
 
@@ -100,7 +100,7 @@ EXPORT(SceUID, _sceKernelCreateCond, const char *pName, SceUInt32 attr, SceUID m
 
 EXPORT(SceUID, _sceKernelCreateEventFlag, const char *pName, SceUInt32 attr, SceUInt32 initPattern, const SceKernelEventFlagOptParam *pOptParam) {
     TRACY_FUNC(_sceKernelCreateEventFlag, pName, attr, initPattern, pOptParam);
-    return eventflag_create(emuenv.kernel, export_name, thread_id, pName, attr, initPattern);
+    return eventflag_create(emuenv.kernel, export_name, thread, pName, attr, initPattern);
 }
 
 EXPORT(int, _sceKernelCreateLwCond, Ptr<SceKernelLwCondWork> workarea, const char *name, SceUInt attr, Ptr<SceKernelCreateLwCond_opt> opt) {
@@ -108,7 +108,7 @@ EXPORT(int, _sceKernelCreateLwCond, Ptr<SceKernelLwCondWork> workarea, const cha
     const auto uid_out = &workarea.get(emuenv.mem)->uid;
     const auto assoc_mutex_uid = opt.get(emuenv.mem)->workarea_mutex.get(emuenv.mem)->uid;
 
-    return condvar_create(uid_out, emuenv.kernel, export_name, name, thread_id, attr, assoc_mutex_uid, SyncWeight::Light);
+    return condvar_create(uid_out, emuenv.kernel, emuenv.mem, export_name, name, thread, attr, assoc_mutex_uid, workarea, SyncWeight::Light);
 }
 
 EXPORT(int, _sceKernelCreateMsgPipeWithLR) {
@@ -120,7 +120,7 @@ EXPORT(int, _sceKernelCreateMutex, const char *name, SceUInt attr, int init_coun
     TRACY_FUNC(_sceKernelCreateMutex, name, attr, init_count, opt_param);
     SceUID uid;
 
-    if (auto error = mutex_create(&uid, emuenv.kernel, emuenv.mem, export_name, name, thread_id, attr, init_count, Ptr<SceKernelLwMutexWork>(0), SyncWeight::Heavy)) {
+    if (auto error = mutex_create(&uid, emuenv.kernel, emuenv.mem, export_name, name, thread, attr, init_count, Ptr<SceKernelLwMutexWork>(0), SyncWeight::Heavy)) {
         return error;
     }
     return uid;
@@ -128,34 +128,34 @@ EXPORT(int, _sceKernelCreateMutex, const char *name, SceUInt attr, int init_coun
 
 EXPORT(SceUID, _sceKernelCreateRWLock, const char *name, SceUInt32 attr, SceKernelMutexOptParam *opt_param) {
     TRACY_FUNC(_sceKernelCreateRWLock, name, attr, opt_param);
-    return rwlock_create(emuenv.kernel, emuenv.mem, export_name, name, thread_id, attr);
+    return rwlock_create(emuenv.kernel, emuenv.mem, export_name, name, thread, attr);
 }
 
 EXPORT(int, _sceKernelCreateSema, const char *name, SceUInt attr, int initVal, Ptr<SceKernelCreateSema_opt> opt) {
     TRACY_FUNC(_sceKernelCreateSema, name, attr, initVal, opt);
-    return semaphore_create(emuenv.kernel, export_name, name, thread_id, attr, initVal, opt.get(emuenv.mem)->maxVal);
+    return semaphore_create(emuenv.kernel, export_name, name, thread, attr, initVal, opt.get(emuenv.mem)->maxVal);
 }
 
 EXPORT(int, _sceKernelCreateSema_16XX, const char *name, SceUInt attr, int initVal, Ptr<SceKernelCreateSema_opt> opt) {
     TRACY_FUNC(_sceKernelCreateSema_16XX, name, attr, initVal, opt);
-    return semaphore_create(emuenv.kernel, export_name, name, thread_id, attr, initVal, opt.get(emuenv.mem)->maxVal);
+    return semaphore_create(emuenv.kernel, export_name, name, thread, attr, initVal, opt.get(emuenv.mem)->maxVal);
 }
 
 EXPORT(SceUID, _sceKernelCreateSimpleEvent, const char *name, SceUInt32 attr, SceUInt32 init_pattern, const SceKernelSimpleEventOptParam *pOptParam) {
     TRACY_FUNC(_sceKernelCreateSimpleEvent, name, attr, init_pattern, pOptParam);
-    return simple_event_create(emuenv.kernel, emuenv.mem, export_name, name, thread_id, attr, init_pattern);
+    return simple_event_create(emuenv.kernel, emuenv.mem, export_name, name, thread, attr, init_pattern);
 }
 
 EXPORT(int, _sceKernelCreateTimer, const char *name, SceUInt32 attr, const uint32_t *opt_params) {
     TRACY_FUNC(_sceKernelCreateTimer, name, attr, opt_params);
-    return timer_create(emuenv.kernel, emuenv.mem, export_name, name, thread_id, attr);
+    return timer_create(emuenv.kernel, emuenv.mem, export_name, name, thread, attr);
 }
 
 EXPORT(int, _sceKernelDeleteLwCond, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(_sceKernelDeleteLwCond, workarea);
     SceUID lightweight_condition_id = workarea.get(emuenv.mem)->uid;
 
-    return condvar_delete(emuenv.kernel, export_name, thread_id, lightweight_condition_id, SyncWeight::Light);
+    return condvar_delete(emuenv.kernel, export_name, thread, lightweight_condition_id, SyncWeight::Light);
 }
 
 EXPORT(int, _sceKernelDeleteLwMutex, Ptr<SceKernelLwMutexWork> workarea) {
@@ -165,7 +165,7 @@ EXPORT(int, _sceKernelDeleteLwMutex, Ptr<SceKernelLwMutexWork> workarea) {
 
     const auto lightweight_mutex_id = workarea.get(emuenv.mem)->uid;
 
-    return mutex_delete(emuenv.kernel, export_name, thread_id, lightweight_mutex_id, SyncWeight::Light);
+    return mutex_delete(emuenv.kernel, export_name, thread, lightweight_mutex_id, SyncWeight::Light);
 }
 
 EXPORT(int, _sceKernelExitCallback) {
@@ -201,7 +201,7 @@ EXPORT(SceInt32, _sceKernelGetCallbackInfo, SceUID callbackId, SceKernelCallback
 
 EXPORT(SceInt32, _sceKernelGetCondInfo, SceUID condId, Ptr<SceKernelCondInfo> pInfo) {
     TRACY_FUNC(_sceKernelGetCondInfo, condId, pInfo);
-    const CondvarPtr condvar = lock_and_find(condId, emuenv.kernel.condvars, emuenv.kernel.mutex);
+    const CondvarPtr condvar = lock_and_find(condId, emuenv.kernel.condvars, emuenv.kernel.mutex, emuenv.kernel.condvar_table);
     if (!condvar)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
 
@@ -223,7 +223,7 @@ EXPORT(SceInt32, _sceKernelGetCondInfo, SceUID condId, Ptr<SceKernelCondInfo> pI
 
 EXPORT(SceInt32, _sceKernelGetEventFlagInfo, SceUID evfId, Ptr<SceKernelEventFlagInfo> pInfo) {
     TRACY_FUNC(_sceKernelGetEventFlagInfo, evfId, pInfo);
-    const EventFlagPtr eventflag = lock_and_find(evfId, emuenv.kernel.eventflags, emuenv.kernel.mutex);
+    const EventFlagPtr eventflag = lock_and_find(evfId, emuenv.kernel.eventflags, emuenv.kernel.mutex, emuenv.kernel.eventflag_table);
     if (!eventflag)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
 
@@ -273,19 +273,15 @@ EXPORT(int, _sceKernelGetLwMutexInfoById, SceUID lightweight_mutex_id, Ptr<SceKe
         info_data = &info_data_local;
         info_data_local.size = info_size;
     }
-    MutexPtr mutex = mutex_get(emuenv.kernel, export_name, thread_id, lightweight_mutex_id, SyncWeight::Light);
+    MutexPtr mutex = mutex_get(emuenv.kernel, export_name, thread, lightweight_mutex_id, SyncWeight::Light);
     if (mutex) {
         info_data->uid = lightweight_mutex_id;
         strncpy(info_data->name, mutex->name, KERNELOBJECT_MAX_NAME_LENGTH + 1);
         info_data->attr = mutex->attr;
         info_data->pWork = mutex->workarea;
         info_data->initCount = mutex->init_count;
-        info_data->currentCount = mutex->lock_count;
-        if (mutex->owner == 0) {
-            info_data->currentOwnerId = 0;
-        } else {
-            info_data->currentOwnerId = mutex->owner->id;
-        }
+        info_data->currentCount = mutex->workarea.get(emuenv.mem)->lockCount;
+        info_data->currentOwnerId = lwmutex_get_owner(emuenv.mem, mutex->workarea);
         info_data->numWaitThreads = static_cast<SceUInt32>(mutex->waiting_threads->size());
         if (info_size < sizeof(SceKernelLwMutexInfo)) {
             memcpy(info.get(emuenv.mem), &info_data_local, info_size);
@@ -314,7 +310,7 @@ EXPORT(int, _sceKernelGetMutexInfo, SceUID mutexId, SceKernelMutexInfo *pInfo) {
         info_data = &info_data_local;
         info_data_local.size = info_size;
     }
-    const MutexPtr mutex = lock_and_find(mutexId, emuenv.kernel.mutexes, emuenv.kernel.mutex);
+    const MutexPtr mutex = lock_and_find(mutexId, emuenv.kernel.mutexes, emuenv.kernel.mutex, emuenv.kernel.mutex_table);
     if (!mutex)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MUTEX_ID);
     info_data->mutexId = mutexId;
@@ -391,7 +387,7 @@ EXPORT(int, _sceKernelGetRWLockInfo, SceUID rwlockId, SceKernelRWLockInfo *info)
 
 EXPORT(SceInt32, _sceKernelGetSemaInfo, SceUID semaId, Ptr<SceKernelSemaInfo> pInfo) {
     TRACY_FUNC(_sceKernelGetSemaInfo, semaId, pInfo);
-    const SemaphorePtr semaphore = lock_and_find(semaId, emuenv.kernel.semaphores, emuenv.kernel.mutex);
+    const SemaphorePtr semaphore = lock_and_find(semaId, emuenv.kernel.semaphores, emuenv.kernel.mutex, emuenv.kernel.semaphore_table);
     if (!semaphore)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
 
@@ -427,11 +423,11 @@ EXPORT(int, _sceKernelGetThreadContextForVM, SceUID threadId, Ptr<SceKernelThrea
     TRACY_FUNC(_sceKernelGetThreadContextForVM, threadId, pCpuRegisterInfo, pVfpRegisterInfo);
     STUBBED("Stub");
 
-    const ThreadStatePtr thread = lock_and_find(threadId, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread)
+    const ThreadStatePtr target = emuenv.kernel.get_thread(threadId);
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
-    const auto context = save_context(*thread->cpu);
+    const auto context = save_context(*target->cpu);
     SceKernelThreadCpuRegisterInfo *infoCpu = pCpuRegisterInfo.get(emuenv.mem);
     if (infoCpu) {
         if (infoCpu->size != sizeof(*infoCpu))
@@ -442,7 +438,7 @@ EXPORT(int, _sceKernelGetThreadContextForVM, SceUID threadId, Ptr<SceKernelThrea
         infoCpu->sb = 100000; // Todo
         infoCpu->st = 100000; // Todo
         infoCpu->teehbr = 100000; // Todo
-        infoCpu->tpidrurw = read_tpidruro(*thread->cpu);
+        infoCpu->tpidrurw = read_tpidruro(*target->cpu);
     }
 
     SceKernelThreadVfpRegisterInfo *infoVfp = pVfpRegisterInfo.get(emuenv.mem);
@@ -459,14 +455,14 @@ EXPORT(int, _sceKernelGetThreadContextForVM, SceUID threadId, Ptr<SceKernelThrea
 
 EXPORT(SceInt32, _sceKernelGetThreadCpuAffinityMask, SceUID thid) {
     TRACY_FUNC(_sceKernelGetThreadCpuAffinityMask, thid);
-    const ThreadStatePtr thread = emuenv.kernel.get_thread(thid ? thid : thread_id);
+    const ThreadStatePtr target = emuenv.kernel.get_thread(thid ? thid : thread->id);
 
-    if (!thread)
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
-    if (thread->affinity_mask == 0)
+    if (target->affinity_mask == 0)
         return SCE_KERNEL_CPU_MASK_USER_ALL;
 
-    return thread->affinity_mask;
+    return target->affinity_mask;
 }
 
 EXPORT(int, _sceKernelGetThreadEventInfo) {
@@ -483,8 +479,8 @@ EXPORT(SceInt32, _sceKernelGetThreadInfo, SceUID threadId, Ptr<SceKernelThreadIn
     TRACY_FUNC(_sceKernelGetThreadInfo, threadId, pInfo);
     STUBBED("STUB");
 
-    const ThreadStatePtr thread = lock_and_find(threadId ? threadId : thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread)
+    const ThreadStatePtr target = emuenv.kernel.get_thread(threadId ? threadId : thread->id);
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
     SceKernelThreadInfo *info = pInfo.get(emuenv.mem);
@@ -496,16 +492,16 @@ EXPORT(SceInt32, _sceKernelGetThreadInfo, SceUID threadId, Ptr<SceKernelThreadIn
 
     // TODO: SCE_KERNEL_ERROR_ILLEGAL_CONTEXT check
 
-    std::copy(thread->name.c_str(), thread->name.c_str() + KERNELOBJECT_MAX_NAME_LENGTH, info->name);
-    info->stack = Ptr<void>(thread->stack.get());
-    info->stackSize = thread->stack_size;
-    info->initPriority = thread->priority; // Todo Give only current priority
-    info->currentPriority = thread->priority;
-    info->initCpuAffinityMask = thread->affinity_mask; // Todo Give init affinity
-    info->currentCpuAffinityMask = thread->affinity_mask;
-    info->entry = SceKernelThreadEntry(thread->entry_point);
-    if (thread->status == ThreadStatus::dormant) {
-        info->exitStatus = thread->returned_value;
+    std::copy(target->name.c_str(), target->name.c_str() + KERNELOBJECT_MAX_NAME_LENGTH, info->name);
+    info->stack = Ptr<void>(target->stack.get());
+    info->stackSize = target->stack_size;
+    info->initPriority = target->priority; // Todo Give only current priority
+    info->currentPriority = target->priority;
+    info->initCpuAffinityMask = target->affinity_mask; // Todo Give init affinity
+    info->currentCpuAffinityMask = target->affinity_mask;
+    info->entry = SceKernelThreadEntry(target->entry_point);
+    if (target->status == ThreadStatus::dormant) {
+        info->exitStatus = target->returned_value;
     }
     return SCE_KERNEL_OK;
 }
@@ -540,41 +536,44 @@ EXPORT(int, _sceKernelLockLwMutex, Ptr<SceKernelLwMutexWork> workarea, int lock_
     if (!workarea)
         return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
 
+    if (lwmutex_try_lock_fast(emuenv.mem, workarea, thread, lock_count))
+        return SCE_KERNEL_OK;
+
     const auto lwmutexid = workarea.get(emuenv.mem)->uid;
-    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lwmutexid, lock_count, ptimeout, SyncWeight::Light);
+    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread, lwmutexid, lock_count, ptimeout, SyncWeight::Light);
 }
 
 EXPORT(int, _sceKernelLockMutex, SceUID mutexid, int lock_count, unsigned int *timeout) {
     TRACY_FUNC(_sceKernelLockMutex, mutexid, lock_count, timeout);
-    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, mutexid, lock_count, timeout, SyncWeight::Heavy);
+    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread, mutexid, lock_count, timeout, SyncWeight::Heavy);
 }
 
 EXPORT(SceInt32, _sceKernelLockMutexCB, SceUID mutexId, SceInt32 lockCount, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelLockMutexCB, mutexId, lockCount, pTimeout);
-    process_callbacks(emuenv.kernel, thread_id);
-    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, mutexId, lockCount, pTimeout, SyncWeight::Heavy);
+    process_callbacks(emuenv.kernel, thread);
+    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread, mutexId, lockCount, pTimeout, SyncWeight::Heavy);
 }
 
 EXPORT(SceInt32, _sceKernelLockReadRWLock, SceUID lock_id, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelLockReadRWLock, lock_id, timeout);
-    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lock_id, timeout, false);
+    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread, lock_id, timeout, false);
 }
 
 EXPORT(SceInt32, _sceKernelLockReadRWLockCB, SceUID lock_id, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelLockReadRWLockCB, lock_id, timeout);
-    process_callbacks(emuenv.kernel, thread_id);
-    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lock_id, timeout, false);
+    process_callbacks(emuenv.kernel, thread);
+    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread, lock_id, timeout, false);
 }
 
 EXPORT(SceInt32, _sceKernelLockWriteRWLock, SceUID lock_id, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelLockWriteRWLock, lock_id, timeout);
-    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lock_id, timeout, true);
+    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread, lock_id, timeout, true);
 }
 
 EXPORT(SceInt32, _sceKernelLockWriteRWLockCB, SceUID lock_id, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelLockWriteRWLockCB, lock_id, timeout);
-    process_callbacks(emuenv.kernel, thread_id);
-    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lock_id, timeout, true);
+    process_callbacks(emuenv.kernel, thread);
+    return rwlock_lock(emuenv.kernel, emuenv.mem, export_name, thread, lock_id, timeout, true);
 }
 
 EXPORT(int, _sceKernelPMonThreadGetCounter) {
@@ -584,12 +583,12 @@ EXPORT(int, _sceKernelPMonThreadGetCounter) {
 
 EXPORT(int, _sceKernelPollEvent, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data) {
     TRACY_FUNC(_sceKernelPollEvent, event_id, bit_pattern, result_pattern, user_data);
-    return simple_event_waitorpoll(emuenv.kernel, export_name, thread_id, event_id, bit_pattern, result_pattern, user_data, nullptr, false);
+    return simple_event_waitorpoll(emuenv.kernel, export_name, thread, event_id, bit_pattern, result_pattern, user_data, nullptr, false);
 }
 
 EXPORT(int, _sceKernelPollEventFlag, SceUID event_id, unsigned int flags, unsigned int wait, unsigned int *outBits) {
     TRACY_FUNC(_sceKernelPollEventFlag, event_id, flags, wait, outBits);
-    return eventflag_poll(emuenv.kernel, export_name, thread_id, event_id, flags, wait, outBits);
+    return eventflag_poll(emuenv.kernel, export_name, thread, event_id, flags, wait, outBits);
 }
 
 EXPORT(int, _sceKernelPulseEventWithNotifyCallback) {
@@ -648,8 +647,8 @@ EXPORT(int, _sceKernelSetEventWithNotifyCallback) {
 
 EXPORT(int, _sceKernelSetThreadContextForVM, SceUID threadId, Ptr<SceKernelThreadCpuRegisterInfo> pCpuRegisterInfo, Ptr<SceKernelThreadVfpRegisterInfo> pVfpRegisterInfo) {
     TRACY_FUNC(_sceKernelSetThreadContextForVM, threadId, pCpuRegisterInfo, pVfpRegisterInfo);
-    const ThreadStatePtr thread = lock_and_find(threadId, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread)
+    const ThreadStatePtr target = emuenv.kernel.get_thread(threadId);
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
     SceKernelThreadCpuRegisterInfo *infoCpu = pCpuRegisterInfo.get(emuenv.mem);
@@ -683,15 +682,21 @@ EXPORT(int, _sceKernelSetTimerTime) {
 
 EXPORT(int, _sceKernelSignalLwCond, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(_sceKernelSignalLwCond, workarea);
+    if (!lwcond_has_waiters(emuenv.mem, workarea))
+        return SCE_KERNEL_OK;
+
     SceUID condid = workarea.get(emuenv.mem)->uid;
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::Any), SyncWeight::Light);
 }
 
 EXPORT(int, _sceKernelSignalLwCondAll, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(_sceKernelSignalLwCondAll, workarea);
+    if (!lwcond_has_waiters(emuenv.mem, workarea))
+        return SCE_KERNEL_OK;
+
     SceUID condid = workarea.get(emuenv.mem)->uid;
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::All), SyncWeight::Light);
 }
 
@@ -702,18 +707,18 @@ EXPORT(int, _sceKernelSignalLwCondTo) {
 
 EXPORT(int, _sceKernelStartThread, SceUID thid, SceSize arglen, Ptr<void> argp) {
     TRACY_FUNC(_sceKernelStartThread, thid, arglen, argp);
-    auto thread = lock_and_find(thid, emuenv.kernel.threads, emuenv.kernel.mutex);
+    auto target = emuenv.kernel.get_thread(thid);
     Ptr<void> new_argp(0);
 
-    if (!thread) {
+    if (!target) {
         return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
     }
 
-    if (thread->status == ThreadStatus::run) {
+    if (target->status == ThreadStatus::run) {
         return SCE_KERNEL_ERROR_RUNNING;
     }
 
-    const int res = thread->start(arglen, argp, true);
+    const int res = target->start(arglen, argp, true);
     if (res < 0) {
         return RET_ERROR(res);
     }
@@ -737,35 +742,35 @@ EXPORT(int, _sceKernelUnlockLwMutex) {
 
 EXPORT(SceInt32, _sceKernelWaitCond, SceUID condId, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitCond, condId, pTimeout);
-    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, condId, pTimeout, SyncWeight::Heavy);
+    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread, condId, pTimeout, SyncWeight::Heavy);
 }
 
 EXPORT(SceInt32, _sceKernelWaitCondCB, SceUID condId, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitCondCB, condId, pTimeout);
-    process_callbacks(emuenv.kernel, thread_id);
-    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, condId, pTimeout, SyncWeight::Heavy);
+    process_callbacks(emuenv.kernel, thread);
+    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread, condId, pTimeout, SyncWeight::Heavy);
 }
 
 EXPORT(SceInt32, _sceKernelWaitEvent, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelWaitEvent, event_id, bit_pattern, result_pattern, user_data, timeout);
-    return simple_event_waitorpoll(emuenv.kernel, export_name, thread_id, event_id, bit_pattern, result_pattern, user_data, timeout, true);
+    return simple_event_waitorpoll(emuenv.kernel, export_name, thread, event_id, bit_pattern, result_pattern, user_data, timeout, true);
 }
 
 EXPORT(SceInt32, _sceKernelWaitEventCB, SceUID event_id, SceUInt32 bit_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelWaitEventCB, event_id, bit_pattern, result_pattern, user_data, timeout);
-    process_callbacks(emuenv.kernel, thread_id);
-    return simple_event_waitorpoll(emuenv.kernel, export_name, thread_id, event_id, bit_pattern, result_pattern, user_data, timeout, false);
+    process_callbacks(emuenv.kernel, thread);
+    return simple_event_waitorpoll(emuenv.kernel, export_name, thread, event_id, bit_pattern, result_pattern, user_data, timeout, false);
 }
 
 EXPORT(SceInt32, _sceKernelWaitEventFlag, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitEventFlag, evfId, bitPattern, waitMode, pResultPat, pTimeout);
-    return eventflag_wait(emuenv.kernel, export_name, thread_id, evfId, bitPattern, waitMode, pResultPat, pTimeout);
+    return eventflag_wait(emuenv.kernel, export_name, thread, evfId, bitPattern, waitMode, pResultPat, pTimeout);
 }
 
 EXPORT(SceInt32, _sceKernelWaitEventFlagCB, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitEventFlagCB, evfId, bitPattern, waitMode, pResultPat, pTimeout);
-    process_callbacks(emuenv.kernel, thread_id);
-    return eventflag_wait(emuenv.kernel, export_name, thread_id, evfId, bitPattern, waitMode, pResultPat, pTimeout);
+    process_callbacks(emuenv.kernel, thread);
+    return eventflag_wait(emuenv.kernel, export_name, thread, evfId, bitPattern, waitMode, pResultPat, pTimeout);
 }
 
 EXPORT(int, _sceKernelWaitException) {
@@ -781,14 +786,14 @@ EXPORT(int, _sceKernelWaitExceptionCB) {
 EXPORT(int, _sceKernelWaitLwCond, Ptr<SceKernelLwCondWork> workarea, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelWaitLwCond, workarea, timeout);
     const auto cond_id = workarea.get(emuenv.mem)->uid;
-    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, cond_id, timeout, SyncWeight::Light);
+    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread, cond_id, timeout, SyncWeight::Light);
 }
 
 EXPORT(SceInt32, _sceKernelWaitLwCondCB, Ptr<SceKernelLwCondWork> pWork, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitLwCondCB, pWork, pTimeout);
-    process_callbacks(emuenv.kernel, thread_id);
+    process_callbacks(emuenv.kernel, thread);
     const auto cond_id = pWork.get(emuenv.mem)->uid;
-    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, cond_id, pTimeout, SyncWeight::Light);
+    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread, cond_id, pTimeout, SyncWeight::Light);
 }
 
 EXPORT(int, _sceKernelWaitMultipleEvents) {
@@ -803,19 +808,18 @@ EXPORT(int, _sceKernelWaitMultipleEventsCB) {
 
 EXPORT(SceInt32, _sceKernelWaitSema, SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitSema, semaId, needCount, pTimeout);
-    return semaphore_wait(emuenv.kernel, export_name, thread_id, semaId, needCount, pTimeout);
+    return semaphore_wait(emuenv.kernel, export_name, thread, semaId, needCount, pTimeout);
 }
 
 EXPORT(SceInt32, _sceKernelWaitSemaCB, SceUID semaId, SceInt32 needCount, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitSemaCB, semaId, needCount, pTimeout);
-    process_callbacks(emuenv.kernel, thread_id);
-    return semaphore_wait(emuenv.kernel, export_name, thread_id, semaId, needCount, pTimeout);
+    process_callbacks(emuenv.kernel, thread);
+    return semaphore_wait(emuenv.kernel, export_name, thread, semaId, needCount, pTimeout);
 }
 
 EXPORT(int, _sceKernelWaitSignal, uint32_t unknown, uint32_t delay, uint32_t timeout) {
     TRACY_FUNC(_sceKernelWaitSignal, unknown, delay, timeout);
     STUBBED("sceKernelWaitSignal");
-    const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     thread->update_status(ThreadStatus::wait);
     thread->signal.wait();
     thread->update_status(ThreadStatus::run);
@@ -824,11 +828,11 @@ EXPORT(int, _sceKernelWaitSignal, uint32_t unknown, uint32_t delay, uint32_t tim
 
 EXPORT(int, _sceKernelWaitSignalCB, uint32_t unknown, uint32_t delay, uint32_t timeout) {
     TRACY_FUNC(_sceKernelWaitSignalCB, unknown, delay, timeout);
-    process_callbacks(emuenv.kernel, thread_id);
+    process_callbacks(emuenv.kernel, thread);
     return CALL_EXPORT(_sceKernelWaitSignal, unknown, delay, timeout);
 }
 
-int wait_thread_end(ThreadStatePtr &waiter, ThreadStatePtr &target, int *stat) {
+int wait_thread_end(const ThreadStatePtr &waiter, const ThreadStatePtr &target, int *stat) {
     std::unique_lock<std::mutex> waiter_lock(waiter->mutex);
     {
         const std::unique_lock<std::mutex> thread_lock(target->mutex);
@@ -848,23 +852,21 @@ int wait_thread_end(ThreadStatePtr &waiter, ThreadStatePtr &target, int *stat) {
 
 EXPORT(int, _sceKernelWaitThreadEnd, SceUID thid, int *stat, SceUInt *timeout) {
     TRACY_FUNC(_sceKernelWaitThreadEnd, thid, stat, timeout);
-    auto waiter = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    auto target = lock_and_find(thid, emuenv.kernel.threads, emuenv.kernel.mutex);
+    auto target = emuenv.kernel.get_thread(thid);
     if (!target) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
     }
-    return wait_thread_end(waiter, target, stat);
+    return wait_thread_end(thread, target, stat);
 }
 
 EXPORT(int, _sceKernelWaitThreadEndCB, SceUID thid, int *stat, SceUInt *timeout) {
     TRACY_FUNC(_sceKernelWaitThreadEndCB, thid, stat, timeout);
-    auto waiter = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    auto target = lock_and_find(thid, emuenv.kernel.threads, emuenv.kernel.mutex);
+    auto target = emuenv.kernel.get_thread(thid);
     if (!target) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
     }
-    process_callbacks(emuenv.kernel, thread_id);
-    return wait_thread_end(waiter, target, stat);
+    process_callbacks(emuenv.kernel, thread);
+    return wait_thread_end(thread, target, stat);
 }
 
 EXPORT(SceInt32, sceKernelCancelCallback, SceUID callbackId) {
@@ -885,30 +887,31 @@ EXPORT(int, sceKernelChangeActiveCpuMask) {
 
 EXPORT(SceInt32, sceKernelChangeThreadCpuAffinityMask, SceUID thid, SceInt32 affinity_mask) {
     TRACY_FUNC(sceKernelChangeThreadCpuAffinityMask, thid, affinity_mask);
-    const ThreadStatePtr thread = emuenv.kernel.get_thread(thid ? thid : thread_id);
+    const ThreadStatePtr target = emuenv.kernel.get_thread(thid ? thid : thread->id);
 
-    if (!thread)
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
-    const SceInt32 old_affinity = thread->affinity_mask;
+    const SceInt32 old_affinity = target->affinity_mask;
 
     if (affinity_mask & ~SCE_KERNEL_CPU_MASK_USER_ALL)
         return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_CPU_AFFINITY_MASK);
 
-    thread->affinity_mask = affinity_mask;
+    target->affinity_mask = affinity_mask;
+    target->host_scheduling_changed = true;
     return old_affinity;
 }
 
 EXPORT(SceInt32, sceKernelChangeThreadPriority2, SceUID thid, SceInt32 priority) {
     TRACY_FUNC(sceKernelChangeThreadPriority2, thid, priority);
-    const ThreadStatePtr thread = emuenv.kernel.get_thread(thid ? thid : thread_id);
-    if (!thread)
+    const ThreadStatePtr target = emuenv.kernel.get_thread(thid ? thid : thread->id);
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
-    const SceInt32 old_priority = thread->priority;
+    const SceInt32 old_priority = target->priority;
 
     if (priority == SCE_KERNEL_CURRENT_THREAD_PRIORITY) {
-        priority = emuenv.kernel.get_thread(thread_id)->priority;
+        priority = target->priority;
     }
 
     if (priority >= SCE_KERNEL_HIGHEST_DEFAULT_PRIORITY
@@ -919,7 +922,8 @@ EXPORT(SceInt32, sceKernelChangeThreadPriority2, SceUID thid, SceInt32 priority)
     if (priority < SCE_KERNEL_HIGHEST_PRIORITY_USER || priority > SCE_KERNEL_LOWEST_PRIORITY_USER)
         return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_PRIORITY);
 
-    thread->priority = priority;
+    target->priority = priority;
+    target->host_scheduling_changed = true;
 
     return old_priority;
 }
@@ -940,7 +944,7 @@ EXPORT(int, sceKernelChangeThreadVfpException, SceInt32 clearMask, SceInt32 setM
 
 EXPORT(SceInt32, sceKernelCheckCallback) {
     TRACY_FUNC(sceKernelCheckCallback);
-    return process_callbacks(emuenv.kernel, thread_id);
+    return process_callbacks(emuenv.kernel, thread);
 }
 
 EXPORT(int, sceKernelCheckWaitableStatus) {
@@ -950,7 +954,7 @@ EXPORT(int, sceKernelCheckWaitableStatus) {
 
 EXPORT(SceInt32, sceKernelClearEvent, SceUID event_id, SceUInt32 clear_pattern) {
     TRACY_FUNC(sceKernelClearEvent, event_id, clear_pattern);
-    return simple_event_clear(emuenv.kernel, export_name, thread_id, event_id, clear_pattern);
+    return simple_event_clear(emuenv.kernel, export_name, thread, event_id, clear_pattern);
 }
 
 EXPORT(SceInt32, sceKernelClearEventFlag, SceUID evfId, SceUInt32 bitPattern) {
@@ -1008,10 +1012,9 @@ EXPORT(SceUID, sceKernelCreateCallback, char *name, SceUInt32 attr, Ptr<SceKerne
     if (attr || !callbackFunc.address())
         return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_ATTR);
 
-    ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     std::string cb_name = name;
-    auto cb = std::make_shared<Callback>(thread_id, thread, cb_name, callbackFunc, pCommon);
-    std::lock_guard lock(emuenv.kernel.mutex);
+    auto cb = std::make_shared<Callback>(thread->id, thread, cb_name, callbackFunc, pCommon);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
     SceUID cb_uid = emuenv.kernel.get_next_uid();
     emuenv.kernel.callbacks.emplace(cb_uid, cb);
     thread->callbacks.push_back(cb);
@@ -1024,55 +1027,56 @@ EXPORT(int, sceKernelCreateThreadForUser, const char *name, SceKernelThreadEntry
         return RET_ERROR(SCE_KERNEL_ERROR_INVALID_CPU_AFFINITY);
     }
 
-    const ThreadStatePtr thread = emuenv.kernel.create_thread(emuenv.mem, name, entry.cast<void>(), init_priority, options->cpu_affinity_mask, options->stack_size, options->option.get(emuenv.mem));
-    if (!thread)
+    const ThreadStatePtr new_thread = emuenv.kernel.create_thread(emuenv.mem, name, entry.cast<void>(), init_priority, options->cpu_affinity_mask, options->stack_size, options->option.get(emuenv.mem));
+    if (!new_thread)
         return RET_ERROR(SCE_KERNEL_ERROR_ERROR);
-    return thread->id;
+    return new_thread->id;
 }
 
-int delay_thread(SceUInt delay_us) {
+int delay_thread(KernelState &kernel, SceUInt delay_us) {
     if (delay_us == 0)
         return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
 
-    std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+    // the delay is in guest time, shorter when the emulation is sped up
+    precise_sleep_for(std::chrono::microseconds(rtc_host_duration(delay_us)), kernel.delay_spin_us);
 
     return SCE_KERNEL_OK;
 }
 
-int delay_thread_cb(EmuEnvState &emuenv, SceUID thread_id, SceUInt delay_us) {
+int delay_thread_cb(EmuEnvState &emuenv, const ThreadStatePtr &thread, SceUInt delay_us) {
     auto start = std::chrono::high_resolution_clock::now(); // Meseaure the time taken to process callbacks
-    process_callbacks(emuenv.kernel, thread_id);
+    process_callbacks(emuenv.kernel, thread);
     auto end = std::chrono::high_resolution_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    const uint64_t elapsed = rtc_guest_duration(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
 
-    if (delay_us > elapsed.count()) // If we spent less time than requested processing callbacks, sleep the remaining time
-        return delay_thread(delay_us - elapsed.count());
+    if (delay_us > elapsed) // If we spent less time than requested processing callbacks, sleep the remaining time
+        return delay_thread(emuenv.kernel, static_cast<SceUInt>(delay_us - elapsed));
     else // Else return directly
         return SCE_KERNEL_OK;
 }
 
 EXPORT(int, sceKernelDelayThread, SceUInt delay) {
     TRACY_FUNC(sceKernelDelayThread, delay);
-    return delay_thread(delay);
+    return delay_thread(emuenv.kernel, delay);
 }
 
 EXPORT(int, sceKernelDelayThread200, SceUInt delay) {
     TRACY_FUNC(sceKernelDelayThread200, delay);
     if (delay < 201)
         delay = 201;
-    return delay_thread(delay);
+    return delay_thread(emuenv.kernel, delay);
 }
 
 EXPORT(int, sceKernelDelayThreadCB, SceUInt delay) {
     TRACY_FUNC(sceKernelDelayThreadCB, delay);
-    return delay_thread_cb(emuenv, thread_id, delay);
+    return delay_thread_cb(emuenv, thread, delay);
 }
 
 EXPORT(int, sceKernelDelayThreadCB200, SceUInt delay) {
     TRACY_FUNC(sceKernelDelayThreadCB200, delay);
     if (delay < 201)
         delay = 201;
-    return delay_thread_cb(emuenv, thread_id, delay);
+    return delay_thread_cb(emuenv, thread, delay);
 }
 
 EXPORT(int, sceKernelDeleteCallback, SceUID callbackId) {
@@ -1081,7 +1085,7 @@ EXPORT(int, sceKernelDeleteCallback, SceUID callbackId) {
     if (!cb)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_CALLBACK_ID);
     auto cb_owner_thread = emuenv.kernel.get_thread(cb->get_owner_thread_id());
-    std::lock_guard lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
     emuenv.kernel.callbacks.erase(callbackId);
     if (cb_owner_thread) {
         auto &v = cb_owner_thread->callbacks;
@@ -1092,52 +1096,52 @@ EXPORT(int, sceKernelDeleteCallback, SceUID callbackId) {
 
 EXPORT(int, sceKernelDeleteCond, SceUID condition_variable_id) {
     TRACY_FUNC(sceKernelDeleteCond, condition_variable_id);
-    return condvar_delete(emuenv.kernel, export_name, thread_id, condition_variable_id, SyncWeight::Heavy);
+    return condvar_delete(emuenv.kernel, export_name, thread, condition_variable_id, SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelDeleteEventFlag, SceUID event_id) {
     TRACY_FUNC(sceKernelDeleteEventFlag, event_id);
-    return eventflag_delete(emuenv.kernel, export_name, thread_id, event_id);
+    return eventflag_delete(emuenv.kernel, export_name, thread, event_id);
 }
 
 EXPORT(SceInt32, sceKernelDeleteMsgPipe, SceUID msgPipeId) {
     TRACY_FUNC(sceKernelDeleteMsgPipe, msgPipeId);
-    return msgpipe_delete(emuenv.kernel, export_name, thread_id, msgPipeId);
+    return msgpipe_delete(emuenv.kernel, export_name, thread, msgPipeId);
 }
 
 EXPORT(int, sceKernelDeleteMutex, SceUID mutexid) {
     TRACY_FUNC(sceKernelDeleteMutex, mutexid);
-    return mutex_delete(emuenv.kernel, export_name, thread_id, mutexid, SyncWeight::Heavy);
+    return mutex_delete(emuenv.kernel, export_name, thread, mutexid, SyncWeight::Heavy);
 }
 
 EXPORT(SceInt32, sceKernelDeleteRWLock, SceUID lock_id) {
     TRACY_FUNC(sceKernelDeleteRWLock, lock_id);
-    return rwlock_delete(emuenv.kernel, emuenv.mem, export_name, thread_id, lock_id);
+    return rwlock_delete(emuenv.kernel, emuenv.mem, export_name, thread, lock_id);
 }
 
 EXPORT(int, sceKernelDeleteSema, SceUID semaid) {
     TRACY_FUNC(sceKernelDeleteSema, semaid);
-    return semaphore_delete(emuenv.kernel, export_name, thread_id, semaid);
+    return semaphore_delete(emuenv.kernel, export_name, thread, semaid);
 }
 
 EXPORT(int, sceKernelDeleteSimpleEvent, SceUID event_id) {
     TRACY_FUNC(sceKernelDeleteSimpleEvent, event_id);
-    return simple_event_delete(emuenv.kernel, export_name, thread_id, event_id);
+    return simple_event_delete(emuenv.kernel, export_name, thread, event_id);
 }
 
 EXPORT(int, sceKernelDeleteThread, SceUID thid) {
     TRACY_FUNC(sceKernelDeleteThread, thid);
-    const ThreadStatePtr thread = lock_and_find(thid, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread || thread->status != ThreadStatus::dormant) {
+    const ThreadStatePtr target = emuenv.kernel.get_thread(thid);
+    if (!target || target->status != ThreadStatus::dormant) {
         return SCE_KERNEL_ERROR_NOT_DORMANT;
     }
-    thread->exit_delete(false);
+    target->exit_delete(false);
     return 0;
 }
 
 EXPORT(int, sceKernelDeleteTimer, SceUID timer_handle) {
     TRACY_FUNC(sceKernelDeleteTimer, timer_handle);
-    std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
     emuenv.kernel.timers.erase(timer_handle);
 
     return 0;
@@ -1145,7 +1149,6 @@ EXPORT(int, sceKernelDeleteTimer, SceUID timer_handle) {
 
 EXPORT(int, sceKernelExitDeleteThread, int status) {
     TRACY_FUNC(sceKernelExitDeleteThread, status);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     thread->exit_delete();
 
     return status;
@@ -1276,7 +1279,7 @@ EXPORT(SceUID, sceKernelOpenTimer, const char *pName) {
 EXPORT(int, sceKernelPollSema, SceUID semaid, int32_t needCount) {
     TRACY_FUNC(sceKernelPollSema, semaid, needCount);
     assert(needCount >= 0);
-    const SemaphorePtr semaphore = lock_and_find(semaid, emuenv.kernel.semaphores, emuenv.kernel.mutex);
+    const SemaphorePtr semaphore = lock_and_find(semaid, emuenv.kernel.semaphores, emuenv.kernel.mutex, emuenv.kernel.semaphore_table);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -1290,7 +1293,7 @@ EXPORT(int, sceKernelPollSema, SceUID semaid, int32_t needCount) {
 
 EXPORT(SceInt32, sceKernelPulseEvent, SceUID event_id, SceUInt32 set_pattern, SceUInt64 user_data) {
     TRACY_FUNC(sceKernelPulseEvent, event_id, set_pattern, user_data);
-    return simple_event_setorpulse(emuenv.kernel, export_name, thread_id, event_id, set_pattern, user_data, false);
+    return simple_event_setorpulse(emuenv.kernel, export_name, thread, event_id, set_pattern, user_data, false);
 }
 
 EXPORT(int, sceKernelRegisterCallbackToEvent) {
@@ -1302,11 +1305,11 @@ EXPORT(int, sceKernelResumeThreadForVM, SceUID threadId) {
     TRACY_FUNC(sceKernelResumeThreadForVM, threadId);
     STUBBED("STUB");
 
-    const ThreadStatePtr thread = lock_and_find(threadId, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread)
+    const ThreadStatePtr target = emuenv.kernel.get_thread(threadId);
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
-    thread->resume();
+    target->resume();
 
     return 0;
 }
@@ -1314,8 +1317,8 @@ EXPORT(int, sceKernelResumeThreadForVM, SceUID threadId) {
 EXPORT(int, sceKernelSendSignal, SceUID target_thread_id) {
     TRACY_FUNC(sceKernelSendSignal, target_thread_id);
     STUBBED("sceKernelSendSignal");
-    const auto thread = lock_and_find(target_thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread->signal.send()) {
+    const auto target = emuenv.kernel.get_thread(target_thread_id);
+    if (!target->signal.send()) {
         return SCE_KERNEL_ERROR_ALREADY_SENT;
     }
     return SCE_KERNEL_OK;
@@ -1323,12 +1326,12 @@ EXPORT(int, sceKernelSendSignal, SceUID target_thread_id) {
 
 EXPORT(SceInt32, sceKernelSetEvent, SceUID event_id, SceUInt32 set_pattern, SceUInt64 user_data) {
     TRACY_FUNC(sceKernelSetEvent, event_id, set_pattern, user_data);
-    return simple_event_setorpulse(emuenv.kernel, export_name, thread_id, event_id, set_pattern, user_data, true);
+    return simple_event_setorpulse(emuenv.kernel, export_name, thread, event_id, set_pattern, user_data, true);
 }
 
 EXPORT(SceInt32, sceKernelSetEventFlag, SceUID evfId, SceUInt32 bitPattern) {
     TRACY_FUNC(sceKernelSetEventFlag, evfId, bitPattern);
-    return eventflag_set(emuenv.kernel, export_name, thread_id, evfId, bitPattern);
+    return eventflag_set(emuenv.kernel, export_name, thread, evfId, bitPattern);
 }
 
 EXPORT(int, sceKernelSetTimerTimeWide, SceUID timer_handle, SceUInt64 time) {
@@ -1345,53 +1348,53 @@ EXPORT(int, sceKernelSetTimerTimeWide, SceUID timer_handle, SceUInt64 time) {
 
 EXPORT(int, sceKernelSignalCond, SceUID condid) {
     TRACY_FUNC(sceKernelSignalCond, condid);
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::Any), SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelSignalCondAll, SceUID condid) {
     TRACY_FUNC(sceKernelSignalCondAll, condid);
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::All), SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelSignalCondTo, SceUID condid, SceUID thread_target) {
     TRACY_FUNC(sceKernelSignalCondTo, condid, thread_target);
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::Specific, thread_target), SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelSignalSema, SceUID semaid, int signal) {
     TRACY_FUNC(sceKernelSignalSema, semaid, signal);
-    return semaphore_signal(emuenv.kernel, export_name, thread_id, semaid, signal);
+    return semaphore_signal(emuenv.kernel, export_name, thread, semaid, signal);
 }
 
 EXPORT(int, sceKernelStartTimer, SceUID timer_handle) {
     TRACY_FUNC(sceKernelStartTimer, timer_handle);
-    return timer_start(emuenv.kernel, export_name, thread_id, timer_handle);
+    return timer_start(emuenv.kernel, export_name, thread, timer_handle);
 }
 
 EXPORT(int, sceKernelStopTimer, SceUID timer_handle) {
     TRACY_FUNC(sceKernelStopTimer, timer_handle);
-    return timer_stop(emuenv.kernel, export_name, thread_id, timer_handle);
+    return timer_stop(emuenv.kernel, export_name, thread, timer_handle);
 }
 
 EXPORT(int, sceKernelSuspendThreadForVM, SceUID threadId) {
     TRACY_FUNC(sceKernelSuspendThreadForVM, threadId);
     STUBBED("STUB");
 
-    const ThreadStatePtr thread = lock_and_find(threadId, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread)
+    const ThreadStatePtr target = emuenv.kernel.get_thread(threadId);
+    if (!target)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
-    thread->suspend();
+    target->suspend();
 
     return 0;
 }
 
 EXPORT(int, sceKernelTryLockMutex, SceUID mutexid, int lock_count) {
     TRACY_FUNC(sceKernelTryLockMutex, mutexid, lock_count);
-    return mutex_try_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, mutexid, lock_count, SyncWeight::Heavy);
+    return mutex_try_lock(emuenv.kernel, emuenv.mem, export_name, thread, mutexid, lock_count, SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelTryLockReadRWLock) {
@@ -1406,17 +1409,17 @@ EXPORT(int, sceKernelTryLockWriteRWLock) {
 
 EXPORT(int, sceKernelUnlockMutex, SceUID mutexid, int unlock_count) {
     TRACY_FUNC(sceKernelUnlockMutex, mutexid, unlock_count);
-    return mutex_unlock(emuenv.kernel, export_name, thread_id, mutexid, unlock_count, SyncWeight::Heavy);
+    return mutex_unlock(emuenv.kernel, emuenv.mem, export_name, thread, mutexid, unlock_count, SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelUnlockReadRWLock, SceUID lock_id) {
     TRACY_FUNC(sceKernelUnlockReadRWLock, lock_id);
-    return rwlock_unlock(emuenv.kernel, emuenv.mem, export_name, thread_id, lock_id, false);
+    return rwlock_unlock(emuenv.kernel, emuenv.mem, export_name, thread, lock_id, false);
 }
 
 EXPORT(int, sceKernelUnlockWriteRWLock, SceUID lock_id) {
     TRACY_FUNC(sceKernelUnlockWriteRWLock, lock_id);
-    return rwlock_unlock(emuenv.kernel, emuenv.mem, export_name, thread_id, lock_id, true);
+    return rwlock_unlock(emuenv.kernel, emuenv.mem, export_name, thread, lock_id, true);
 }
 
 EXPORT(int, sceKernelUnregisterCallbackFromEvent) {
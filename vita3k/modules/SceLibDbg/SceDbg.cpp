@@ -26,11 +26,6 @@ TRACY_MODULE_NAME(SceDbg);
 
 EXPORT(int, sceDbgAssertionHandler, const char *filename, int line, bool do_stop, const char *component, module::vargs messages) {
     TRACY_FUNC(sceDbgAssertionHandler, filename, line, do_stop, component);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-
-    if (!thread) {
-        return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
-    }
 
     std::vector<char> buffer(KiB(1));
 
@@ -53,11 +48,6 @@ EXPORT(int, sceDbgAssertionHandler, const char *filename, int line, bool do_stop
 
 EXPORT(int, sceDbgLoggingHandler, const char *pFile, int line, int severity, const char *pComponent, module::vargs messages) {
     TRACY_FUNC(sceDbgLoggingHandler, pFile, line, severity, pComponent);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-
-    if (!thread) {
-        return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
-    }
 
     std::string output = fmt::format("SCE libdbg LOG, LEVEL: {}", severity);
 
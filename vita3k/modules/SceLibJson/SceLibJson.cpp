@@ -17,6 +17,9 @@
 
 #include <module/module.h>
 
+// The sce::Json classes are only known through their mangled names, the layout of their objects is not.
+// SCE_SYSMODULE_JSON is in the auto LLE list of load_module.cpp, so these stubs are only used in the manual modules mode.
+
 EXPORT(int, _ZN3sce4Json11Initializer10initializeEPKNS0_13InitParameterE) {
     return UNIMPLEMENTED();
 }
@@ -58,9 +58,7 @@ enum class TimerFlags : uint32_t {
 TRACY_MODULE_NAME(SceLibKernel);
 
 inline uint64_t get_current_time() {
-    return std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch())
-        .count();
+    return rtc_ticks_since_epoch();
 }
 
 VAR_EXPORT(__sce_libcparam) {
@@ -89,9 +87,8 @@ EXPORT(int, __sce_aeabi_ldiv0) {
 
 EXPORT(int, __stack_chk_fail) {
     TRACY_FUNC(__stack_chk_fail);
-    LOG_CRITICAL("Stack corruption on TID: {}", thread_id);
+    LOG_CRITICAL("Stack corruption on TID: {}", thread->id);
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     auto ctx = save_context(*thread->cpu);
     LOG_ERROR("{}", ctx.description());
 
@@ -102,7 +99,6 @@ EXPORT(int, __stack_chk_fail) {
 
 EXPORT(int, _sceKernelCreateLwMutex, Ptr<SceKernelLwMutexWork> workarea, const char *name, unsigned int attr, int init_count, Ptr<SceKernelLwMutexOptParam> opt_param) {
     TRACY_FUNC(_sceKernelCreateLwMutex, workarea, name, attr, init_count, opt_param);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
     Ptr<SceKernelCreateLwMutex_opt> options = Ptr<SceKernelCreateLwMutex_opt>(stack_alloc(*thread->cpu, sizeof(SceKernelCreateLwMutex_opt)));
     options.get(emuenv.mem)->init_count = init_count;
@@ -218,7 +214,7 @@ EXPORT(int, sceClibMemsetChk) {
 
 EXPORT(Ptr<void>, sceClibMspaceCalloc, Ptr<void> space, uint32_t elements, uint32_t size) {
     TRACY_FUNC(sceClibMspaceCalloc, space, elements, size);
-    const std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
 
     void *address = mspace_calloc(space.get(emuenv.mem), elements, size);
     return Ptr<void>(address, emuenv.mem);
@@ -226,7 +222,7 @@ EXPORT(Ptr<void>, sceClibMspaceCalloc, Ptr<void> space, uint32_t elements, uint3
 
 EXPORT(Ptr<void>, sceClibMspaceCreate, Ptr<void> base, uint32_t capacity) {
     TRACY_FUNC(sceClibMspaceCreate, base, capacity);
-    const std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
 
     mspace space = create_mspace_with_base(base.get(emuenv.mem), capacity, 0);
     return Ptr<void>(space, emuenv.mem);
@@ -234,14 +230,14 @@ EXPORT(Ptr<void>, sceClibMspaceCreate, Ptr<void> base, uint32_t capacity) {
 
 EXPORT(uint32_t, sceClibMspaceDestroy, Ptr<void> space) {
     TRACY_FUNC(sceClibMspaceDestroy, space);
-    const std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
 
     return static_cast<uint32_t>(destroy_mspace(space.get(emuenv.mem)));
 }
 
 EXPORT(void, sceClibMspaceFree, Ptr<void> space, Ptr<void> address) {
     TRACY_FUNC(sceClibMspaceFree, space, address);
-    const std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
 
     mspace_free(space.get(emuenv.mem), address.get(emuenv.mem));
 }
@@ -253,7 +249,7 @@ EXPORT(int, sceClibMspaceIsHeapEmpty) {
 
 EXPORT(Ptr<void>, sceClibMspaceMalloc, Ptr<void> space, uint32_t size) {
     TRACY_FUNC(sceClibMspaceMalloc, space, size);
-    const std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
 
     void *address = mspace_malloc(space.get(emuenv.mem), size);
     return Ptr<void>(address, emuenv.mem);
@@ -276,7 +272,7 @@ EXPORT(int, sceClibMspaceMallocUsableSize) {
 
 EXPORT(Ptr<void>, sceClibMspaceMemalign, Ptr<void> space, uint32_t alignment, uint32_t size) {
     TRACY_FUNC(sceClibMspaceMemalign, space, alignment, size);
-    const std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
 
     void *address = mspace_memalign(space.get(emuenv.mem), alignment, size);
     return Ptr<void>(address, emuenv.mem);
@@ -284,7 +280,7 @@ EXPORT(Ptr<void>, sceClibMspaceMemalign, Ptr<void> space, uint32_t alignment, ui
 
 EXPORT(Ptr<void>, sceClibMspaceRealloc, Ptr<void> space, Ptr<void> address, uint32_t size) {
     TRACY_FUNC(sceClibMspaceRealloc, space, address, size);
-    const std::lock_guard<std::mutex> guard(emuenv.kernel.mutex);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
 
     void *new_address = mspace_realloc(space.get(emuenv.mem), address.get(emuenv.mem), size);
     return Ptr<void>(new_address, emuenv.mem);
@@ -299,12 +295,6 @@ EXPORT(int, sceClibPrintf, const char *fmt, module::vargs args) {
     TRACY_FUNC(sceClibPrintf, fmt);
     std::vector<char> buffer(KiB(1));
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-
-    if (!thread) {
-        return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
-    }
-
     const int result = utils::snprintf(buffer.data(), buffer.size(), fmt, *(thread->cpu), emuenv.mem, args);
 
     if (!result) {
@@ -318,11 +308,6 @@ EXPORT(int, sceClibPrintf, const char *fmt, module::vargs args) {
 
 EXPORT(int, sceClibSnprintf, char *dst, SceSize dst_max_size, const char *fmt, module::vargs args) {
     TRACY_FUNC(sceClibSnprintf, dst, dst_max_size, fmt);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-
-    if (!thread) {
-        return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
-    }
 
     int result = utils::snprintf(dst, dst_max_size, fmt, *(thread->cpu), emuenv.mem, args);
 
@@ -456,10 +441,6 @@ EXPORT(int, sceClibVdprintf) {
 
 EXPORT(int, sceClibVprintf, const char *fmt, module::vargs args) {
     TRACY_FUNC(sceClibVprintf, fmt);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread) {
-        return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
-    }
     constexpr int dst_max_size = 1024;
     char dst[dst_max_size];
     int result = utils::snprintf(dst, dst_max_size, fmt, *(thread->cpu), emuenv.mem, args);
@@ -475,13 +456,8 @@ EXPORT(int, sceClibVprintf, const char *fmt, module::vargs args) {
 
 EXPORT(int, sceClibVsnprintf, char *dst, SceSize dst_max_size, const char *fmt, Address list) {
     TRACY_FUNC(sceClibVsnprintf, dst, dst_max_size, fmt, list);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
     module::vargs args(list);
-    if (!thread) {
-        return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
-    }
-
     int result = utils::snprintf(dst, dst_max_size, fmt, *(thread->cpu), emuenv.mem, args);
 
     if (!result) {
@@ -577,9 +553,9 @@ EXPORT(int, sceIoGetstat, const char *file, SceIoStat *stat) {
     return CALL_EXPORT(_sceIoGetstat, file, stat);
 }
 
-EXPORT(int, sceIoGetstatAsync) {
-    TRACY_FUNC(sceIoGetstatAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoGetstatAsync, const char *file, SceIoStat *stat) {
+    TRACY_FUNC(sceIoGetstatAsync, file, stat);
+    return CALL_EXPORT(_sceIoGetstatAsync, file, stat);
 }
 
 EXPORT(int, sceIoGetstatByFd, const SceUID fd, SceIoStat *stat) {
@@ -599,7 +575,6 @@ EXPORT(int, sceIoIoctlAsync) {
 
 EXPORT(SceOff, sceIoLseek, const SceUID fd, const SceOff offset, const SceIoSeekMode whence) {
     TRACY_FUNC(sceIoLseek, fd, offset, whence);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
     Ptr<_sceIoLseekOpt> options = Ptr<_sceIoLseekOpt>(stack_alloc(*thread->cpu, sizeof(_sceIoLseekOpt)));
     options.get(emuenv.mem)->offset = offset;
@@ -609,9 +584,14 @@ EXPORT(SceOff, sceIoLseek, const SceUID fd, const SceOff offset, const SceIoSeek
     return res;
 }
 
-EXPORT(int, sceIoLseekAsync) {
-    TRACY_FUNC(sceIoLseekAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoLseekAsync, const SceUID fd, const SceOff offset, const SceIoSeekMode whence) {
+    TRACY_FUNC(sceIoLseekAsync, fd, offset, whence);
+    Ptr<_sceIoLseekOpt> options = Ptr<_sceIoLseekOpt>(stack_alloc(*thread->cpu, sizeof(_sceIoLseekOpt)));
+    options.get(emuenv.mem)->offset = offset;
+    options.get(emuenv.mem)->whence = whence;
+    const SceUID res = CALL_EXPORT(_sceIoLseekAsync, fd, options);
+    stack_free(*thread->cpu, sizeof(_sceIoLseekOpt));
+    return res;
 }
 
 EXPORT(int, sceIoMkdir, const char *dir, const SceMode mode) {
@@ -619,9 +599,9 @@ EXPORT(int, sceIoMkdir, const char *dir, const SceMode mode) {
     return CALL_EXPORT(_sceIoMkdir, dir, mode);
 }
 
-EXPORT(int, sceIoMkdirAsync) {
-    TRACY_FUNC(sceIoMkdirAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoMkdirAsync, const char *dir, const SceMode mode) {
+    TRACY_FUNC(sceIoMkdirAsync, dir, mode);
+    return CALL_EXPORT(_sceIoMkdirAsync, dir, mode);
 }
 
 EXPORT(SceUID, sceIoOpen, const char *file, const int flags, const SceMode mode) {
@@ -633,43 +613,37 @@ EXPORT(SceUID, sceIoOpen, const char *file, const int flags, const SceMode mode)
     return open_file(emuenv.io, file, flags, emuenv.pref_path.wstring(), export_name);
 }
 
-EXPORT(int, sceIoOpenAsync) {
-    TRACY_FUNC(sceIoOpenAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoOpenAsync, const char *file, const int flags, const SceMode mode) {
+    TRACY_FUNC(sceIoOpenAsync, file, flags, mode);
+    return CALL_EXPORT(_sceIoOpenAsync, file, flags, mode);
 }
 
 EXPORT(SceSSize, sceIoPread, SceUID fd, void *buf, SceSize nbyte, SceOff offset) {
     TRACY_FUNC(sceIoPread, fd, buf, nbyte, offset);
-    auto pos = tell_file(emuenv.io, fd, export_name);
-    if (pos < 0) {
-        return static_cast<SceSSize>(pos);
-    }
-    seek_file(fd, offset, SCE_SEEK_SET, emuenv.io, export_name);
-    const auto res = read_file(buf, emuenv.io, fd, nbyte, export_name);
-    seek_file(fd, pos, SCE_SEEK_SET, emuenv.io, export_name);
-    return res;
+    return pread_file(buf, emuenv.io, fd, nbyte, offset, export_name);
 }
 
-EXPORT(int, sceIoPreadAsync) {
-    TRACY_FUNC(sceIoPreadAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoPreadAsync, SceUID fd, void *buf, SceSize nbyte, SceOff offset) {
+    TRACY_FUNC(sceIoPreadAsync, fd, buf, nbyte, offset);
+    Ptr<_sceIoPreadOpt> options = Ptr<_sceIoPreadOpt>(stack_alloc(*thread->cpu, sizeof(_sceIoPreadOpt)));
+    options.get(emuenv.mem)->offset = offset;
+    const SceUID res = CALL_EXPORT(_sceIoPreadAsync, fd, buf, nbyte, options);
+    stack_free(*thread->cpu, sizeof(_sceIoPreadOpt));
+    return res;
 }
 
 EXPORT(SceSSize, sceIoPwrite, SceUID fd, const void *buf, SceSize nbyte, SceOff offset) {
     TRACY_FUNC(sceIoPwrite, fd, buf, nbyte, offset);
-    auto pos = tell_file(emuenv.io, fd, export_name);
-    if (pos < 0) {
-        return static_cast<SceSSize>(pos);
-    }
-    seek_file(fd, offset, SCE_SEEK_SET, emuenv.io, export_name);
-    const auto res = write_file(fd, buf, nbyte, emuenv.io, export_name);
-    seek_file(fd, pos, SCE_SEEK_SET, emuenv.io, export_name);
-    return res;
+    return pwrite_file(fd, buf, nbyte, offset, emuenv.io, export_name);
 }
 
-EXPORT(int, sceIoPwriteAsync) {
-    TRACY_FUNC(sceIoPwriteAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoPwriteAsync, SceUID fd, const void *buf, SceSize nbyte, SceOff offset) {
+    TRACY_FUNC(sceIoPwriteAsync, fd, buf, nbyte, offset);
+    Ptr<_sceIoPreadOpt> options = Ptr<_sceIoPreadOpt>(stack_alloc(*thread->cpu, sizeof(_sceIoPreadOpt)));
+    options.get(emuenv.mem)->offset = offset;
+    const SceUID res = CALL_EXPORT(_sceIoPwriteAsync, fd, buf, nbyte, options);
+    stack_free(*thread->cpu, sizeof(_sceIoPreadOpt));
+    return res;
 }
 
 EXPORT(int, sceIoRead2) {
@@ -685,9 +659,9 @@ EXPORT(int, sceIoRemove, const char *path) {
     return remove_file(emuenv.io, path, emuenv.pref_path.wstring(), export_name);
 }
 
-EXPORT(int, sceIoRemoveAsync) {
-    TRACY_FUNC(sceIoRemoveAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoRemoveAsync, const char *path) {
+    TRACY_FUNC(sceIoRemoveAsync, path);
+    return CALL_EXPORT(_sceIoRemoveAsync, path);
 }
 
 EXPORT(int, sceIoRename, const char *oldname, const char *newname) {
@@ -699,9 +673,9 @@ EXPORT(int, sceIoRename, const char *oldname, const char *newname) {
     return rename(emuenv.io, oldname, newname, emuenv.pref_path.wstring(), export_name);
 }
 
-EXPORT(int, sceIoRenameAsync) {
-    TRACY_FUNC(sceIoRenameAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoRenameAsync, const char *oldname, const char *newname) {
+    TRACY_FUNC(sceIoRenameAsync, oldname, newname);
+    return CALL_EXPORT(_sceIoRenameAsync, oldname, newname);
 }
 
 EXPORT(int, sceIoRmdir, const char *path) {
@@ -712,19 +686,19 @@ EXPORT(int, sceIoRmdir, const char *path) {
     return remove_dir(emuenv.io, path, emuenv.pref_path.wstring(), export_name);
 }
 
-EXPORT(int, sceIoRmdirAsync) {
-    TRACY_FUNC(sceIoRmdirAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoRmdirAsync, const char *path) {
+    TRACY_FUNC(sceIoRmdirAsync, path);
+    return CALL_EXPORT(_sceIoRmdirAsync, path);
 }
 
-EXPORT(int, sceIoSync) {
-    TRACY_FUNC(sceIoSync);
-    return UNIMPLEMENTED();
+EXPORT(int, sceIoSync, const char *device, const unsigned int unk) {
+    TRACY_FUNC(sceIoSync, device, unk);
+    return CALL_EXPORT(_sceIoSync, device, unk);
 }
 
-EXPORT(int, sceIoSyncAsync) {
-    TRACY_FUNC(sceIoSyncAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoSyncAsync, const char *device, const unsigned int unk) {
+    TRACY_FUNC(sceIoSyncAsync, device, unk);
+    return CALL_EXPORT(_sceIoSyncAsync, device, unk);
 }
 
 EXPORT(int, sceIoWrite2) {
@@ -1159,7 +1133,6 @@ EXPORT(int, sceKernelChangeCurrentThreadAttr) {
 
 EXPORT(int, sceKernelCheckThreadStack) {
     TRACY_FUNC(sceKernelCheckThreadStack);
-    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     int stack_size = read_sp(*thread->cpu) - (thread->stack.get());
     if (stack_size < 0 || stack_size > thread->stack_size)
         stack_size = 0;
@@ -1183,7 +1156,6 @@ EXPORT(int, sceKernelCreateEventFlag, const char *name, unsigned int attr, unsig
 
 EXPORT(int, sceKernelCreateLwCond, Ptr<SceKernelLwCondWork> workarea, const char *name, SceUInt attr, Ptr<SceKernelLwMutexWork> workarea_mutex, Ptr<SceKernelLwCondOptParam> opt_param) {
     TRACY_FUNC(sceKernelCreateLwCond, workarea, name, attr, workarea_mutex, opt_param);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
     Ptr<SceKernelCreateLwCond_opt> options = Ptr<SceKernelCreateLwCond_opt>(stack_alloc(*thread->cpu, sizeof(SceKernelCreateLwCond_opt)));
     options.get(emuenv.mem)->workarea_mutex = workarea_mutex;
@@ -1200,7 +1172,7 @@ EXPORT(int, sceKernelCreateLwMutex, Ptr<SceKernelLwMutexWork> workarea, const ch
 
 EXPORT(int, sceKernelCreateMsgPipe, const char *name, uint32_t type, uint32_t attr, SceSize bufSize, const SceKernelCreateMsgPipeOpt *opt) {
     TRACY_FUNC(sceKernelCreateMsgPipe, name, type, attr, bufSize, opt);
-    return msgpipe_create(emuenv.kernel, export_name, name, thread_id, attr, bufSize);
+    return msgpipe_create(emuenv.kernel, export_name, name, thread, attr, bufSize);
 }
 
 EXPORT(int, sceKernelCreateMsgPipeWithLR) {
@@ -1215,7 +1187,7 @@ EXPORT(int, sceKernelCreateMutex, const char *name, SceUInt attr, int init_count
     }
 
     SceUID uid;
-    if (auto error = mutex_create(&uid, emuenv.kernel, emuenv.mem, export_name, name, thread_id, attr, init_count, Ptr<SceKernelLwMutexWork>(0), SyncWeight::Heavy)) {
+    if (auto error = mutex_create(&uid, emuenv.kernel, emuenv.mem, export_name, name, thread, attr, init_count, Ptr<SceKernelLwMutexWork>(0), SyncWeight::Heavy)) {
         return error;
     }
     return uid;
@@ -1228,7 +1200,6 @@ EXPORT(SceUID, sceKernelCreateRWLock, const char *name, SceUInt32 attr, SceKerne
 
 EXPORT(SceUID, sceKernelCreateSema, const char *name, SceUInt attr, int initVal, int maxVal, Ptr<SceKernelSemaOptParam> option) {
     TRACY_FUNC(sceKernelCreateSema, name, attr, initVal, maxVal, option);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
     Ptr<SceKernelCreateSema_opt> options = Ptr<SceKernelCreateSema_opt>(stack_alloc(*thread->cpu, sizeof(SceKernelCreateSema_opt)));
     options.get(emuenv.mem)->maxVal = maxVal;
@@ -1240,7 +1211,6 @@ EXPORT(SceUID, sceKernelCreateSema, const char *name, SceUInt attr, int initVal,
 
 EXPORT(int, sceKernelCreateSema_16XX, const char *name, SceUInt attr, int initVal, int maxVal, Ptr<SceKernelSemaOptParam> option) {
     TRACY_FUNC(sceKernelCreateSema_16XX, name, attr, initVal, maxVal, option);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
     Ptr<SceKernelCreateSema_opt> options = Ptr<SceKernelCreateSema_opt>(stack_alloc(*thread->cpu, sizeof(SceKernelCreateSema_opt)));
     options.get(emuenv.mem)->maxVal = maxVal;
@@ -1257,7 +1227,6 @@ EXPORT(SceUID, sceKernelCreateSimpleEvent, const char *name, SceUInt32 attr, Sce
 
 EXPORT(SceUID, sceKernelCreateThread, const char *name, SceKernelThreadEntry entry, int init_priority, int stack_size, SceUInt attr, int cpu_affinity_mask, Ptr<SceKernelThreadOptParam> option) {
     TRACY_FUNC(sceKernelCreateThread, name, entry, init_priority, stack_size, attr, cpu_affinity_mask, option);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
     auto options = Ptr<SceKernelCreateThread_opt>(stack_alloc(*thread->cpu, sizeof(SceKernelCreateThread_opt))).get(emuenv.mem);
     options->stack_size = stack_size;
@@ -1278,7 +1247,7 @@ EXPORT(int, sceKernelDeleteLwCond, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(sceKernelDeleteLwCond, workarea);
     SceUID lightweight_condition_id = workarea.get(emuenv.mem)->uid;
 
-    return condvar_delete(emuenv.kernel, export_name, thread_id, lightweight_condition_id, SyncWeight::Light);
+    return condvar_delete(emuenv.kernel, export_name, thread, lightweight_condition_id, SyncWeight::Light);
 }
 
 EXPORT(int, sceKernelDeleteLwMutex, Ptr<SceKernelLwMutexWork> workarea) {
@@ -1419,7 +1388,8 @@ EXPORT(int, sceKernelGetSystemTime) {
 
 EXPORT(Ptr<Ptr<void>>, sceKernelGetTLSAddr, int key) {
     TRACY_FUNC(sceKernelGetTLSAddr, key);
-    return emuenv.kernel.get_thread_tls_addr(emuenv.mem, thread_id, key);
+    // called very often, the calling thread is known so the thread map is not looked up
+    return thread->get_tls_addr(key);
 }
 
 EXPORT(int, sceKernelGetThreadContextForVM, SceUID threadId, Ptr<SceKernelThreadCpuRegisterInfo> pCpuRegisterInfo, Ptr<SceKernelThreadVfpRegisterInfo> pVfpRegisterInfo) {
@@ -1443,10 +1413,6 @@ EXPORT(SceInt32, sceKernelGetThreadCpuAffinityMask2, SceUID thid) {
 
 EXPORT(SceInt32, sceKernelGetThreadCurrentPriority) {
     TRACY_FUNC(sceKernelGetThreadCurrentPriority);
-    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
-
-    if (!thread)
-        return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
 
     return thread->priority;
 }
@@ -1458,22 +1424,22 @@ EXPORT(int, sceKernelGetThreadEventInfo) {
 
 EXPORT(int, sceKernelGetThreadExitStatus, SceUID thid, SceInt32 *pExitStatus) {
     TRACY_FUNC(sceKernelGetThreadExitStatus, thid, pExitStatus);
-    const ThreadStatePtr thread = lock_and_find(thid ? thid : thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    if (!thread) {
+    const ThreadStatePtr target = emuenv.kernel.get_thread(thid ? thid : thread->id);
+    if (!target) {
         return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
     }
-    if (thread->status != ThreadStatus::dormant) {
+    if (target->status != ThreadStatus::dormant) {
         return SCE_KERNEL_ERROR_NOT_DORMANT;
     }
     if (pExitStatus) {
-        *pExitStatus = thread->returned_value;
+        *pExitStatus = target->returned_value;
     }
     return 0;
 }
 
 EXPORT(int, sceKernelGetThreadId) {
     TRACY_FUNC(sceKernelGetThreadId);
-    return thread_id;
+    return thread->id;
 }
 
 EXPORT(SceInt32, sceKernelGetThreadInfo, SceUID threadId, Ptr<SceKernelThreadInfo> pInfo) {
@@ -1542,7 +1508,7 @@ EXPORT(int, sceKernelLockLwMutex_0, Ptr<SceKernelLwMutexWork> workarea, int lock
 
 EXPORT(int, sceKernelLockLwMutexCB, Ptr<SceKernelLwMutexWork> workarea, int lock_count, unsigned int *ptimeout) {
     TRACY_FUNC(sceKernelLockLwMutexCB, workarea, lock_count, ptimeout);
-    process_callbacks(emuenv.kernel, thread_id);
+    process_callbacks(emuenv.kernel, thread);
     return CALL_EXPORT(_sceKernelLockLwMutex, workarea, lock_count, ptimeout);
 }
 
@@ -1608,7 +1574,7 @@ EXPORT(int, sceKernelPulseEventWithNotifyCallback) {
 
 EXPORT(SceInt32, sceKernelReceiveMsgPipe, SceUID msgPipeId, void *pRecvBuf, SceSize recvSize, SceUInt32 waitMode, SceSize *pResult, SceUInt32 *pTimeout) {
     TRACY_FUNC(sceKernelReceiveMsgPipe, msgPipeId, pRecvBuf, recvSize, waitMode, pResult, pTimeout);
-    const auto ret = msgpipe_recv(emuenv.kernel, export_name, thread_id, msgPipeId, waitMode, pRecvBuf, recvSize, pTimeout);
+    const auto ret = msgpipe_recv(emuenv.kernel, export_name, thread, msgPipeId, waitMode, pRecvBuf, recvSize, pTimeout);
     if (static_cast<int>(ret) < 0) {
         return ret;
     }
@@ -1620,7 +1586,7 @@ EXPORT(SceInt32, sceKernelReceiveMsgPipe, SceUID msgPipeId, void *pRecvBuf, SceS
 
 EXPORT(SceInt32, sceKernelReceiveMsgPipeCB, SceUID msgPipeId, void *pRecvBuf, SceSize recvSize, SceUInt32 waitMode, SceSize *pResult, SceUInt32 *pTimeout) {
     TRACY_FUNC(sceKernelReceiveMsgPipeCB, msgPipeId, pRecvBuf, recvSize, waitMode, pResult, pTimeout);
-    process_callbacks(emuenv.kernel, thread_id);
+    process_callbacks(emuenv.kernel, thread);
     return CALL_EXPORT(sceKernelReceiveMsgPipe, msgPipeId, pRecvBuf, recvSize, waitMode, pResult, pTimeout);
 }
 
@@ -1645,7 +1611,7 @@ EXPORT(int, sceKernelRegisterThreadEventHandler, const char *name, SceUID thread
 
 EXPORT(SceInt32, sceKernelSendMsgPipe, SceUID msgPipeId, const void *pSendBuf, SceSize sendSize, SceUInt32 waitMode, SceSize *pResult, SceUInt32 *pTimeout) {
     TRACY_FUNC(sceKernelSendMsgPipe, msgPipeId, pSendBuf, sendSize, waitMode, pResult, pTimeout);
-    const auto ret = msgpipe_send(emuenv.kernel, export_name, thread_id, msgPipeId, waitMode, pSendBuf, sendSize, pTimeout);
+    const auto ret = msgpipe_send(emuenv.kernel, export_name, thread, msgPipeId, waitMode, pSendBuf, sendSize, pTimeout);
     if (static_cast<int>(ret) < 0) {
         return ret;
     }
@@ -1657,7 +1623,7 @@ EXPORT(SceInt32, sceKernelSendMsgPipe, SceUID msgPipeId, const void *pSendBuf, S
 
 EXPORT(SceInt32, sceKernelSendMsgPipeCB, SceUID msgPipeId, const void *pSendBuf, SceSize sendSize, SceUInt32 waitMode, SceSize *pResult, SceUInt32 *pTimeout) {
     TRACY_FUNC(sceKernelSendMsgPipeCB, msgPipeId, pSendBuf, sendSize, waitMode, pResult, pTimeout);
-    process_callbacks(emuenv.kernel, thread_id);
+    process_callbacks(emuenv.kernel, thread);
     return CALL_EXPORT(sceKernelSendMsgPipe, msgPipeId, pSendBuf, sendSize, waitMode, pResult, pTimeout);
 }
 
@@ -1684,7 +1650,7 @@ EXPORT(int, sceKernelSetThreadContextForVM, SceUID threadId, Ptr<SceKernelThread
 EXPORT(int, sceKernelSetTimerEvent, SceUID timer_handle, SceInt32 type, SceKernelSysClock *interval, SceInt32 repeats) {
     TRACY_FUNC(sceKernelSetTimerEvent, timer_handle, type, interval, repeats);
 
-    return timer_set(emuenv.kernel, export_name, thread_id, timer_handle, type, interval, repeats);
+    return timer_set(emuenv.kernel, export_name, thread, timer_handle, type, interval, repeats);
 }
 
 EXPORT(int, sceKernelSetTimerTime) {
@@ -1694,22 +1660,31 @@ EXPORT(int, sceKernelSetTimerTime) {
 
 EXPORT(int, sceKernelSignalLwCond, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(sceKernelSignalLwCond, workarea);
+    if (!lwcond_has_waiters(emuenv.mem, workarea))
+        return SCE_KERNEL_OK;
+
     SceUID condid = workarea.get(emuenv.mem)->uid;
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::Any), SyncWeight::Light);
 }
 
 EXPORT(int, sceKernelSignalLwCondAll, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(sceKernelSignalLwCondAll, workarea);
+    if (!lwcond_has_waiters(emuenv.mem, workarea))
+        return SCE_KERNEL_OK;
+
     SceUID condid = workarea.get(emuenv.mem)->uid;
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::All), SyncWeight::Light);
 }
 
 EXPORT(int, sceKernelSignalLwCondTo, Ptr<SceKernelLwCondWork> workarea, SceUID thread_target) {
     TRACY_FUNC(sceKernelSignalLwCondTo, workarea, thread_target);
+    if (!lwcond_has_waiters(emuenv.mem, workarea))
+        return SCE_KERNEL_OK;
+
     SceUID condid = workarea.get(emuenv.mem)->uid;
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
+    return condvar_signal(emuenv.kernel, emuenv.mem, export_name, thread, condid,
         Condvar::SignalTarget(Condvar::SignalTarget::Type::Specific, thread_target), SyncWeight::Light);
 }
 
@@ -1740,13 +1715,16 @@ EXPORT(int, sceKernelStopUnloadModule) {
 
 EXPORT(int, sceKernelTryLockLwMutex, Ptr<SceKernelLwMutexWork> workarea, int lock_count) {
     TRACY_FUNC(sceKernelTryLockLwMutex, workarea, lock_count);
+    if (lwmutex_try_lock_fast(emuenv.mem, workarea, thread, lock_count))
+        return SCE_KERNEL_OK;
+
     const auto lwmutexid = workarea.get(emuenv.mem)->uid;
-    return mutex_try_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lwmutexid, lock_count, SyncWeight::Light);
+    return mutex_try_lock(emuenv.kernel, emuenv.mem, export_name, thread, lwmutexid, lock_count, SyncWeight::Light);
 }
 
 EXPORT(int, sceKernelTryReceiveMsgPipe, SceUID msgpipe_id, char *recv_buf, SceSize msg_size, SceUInt32 wait_mode, SceSize *result) {
     TRACY_FUNC(sceKernelTryReceiveMsgPipe, msgpipe_id, recv_buf, msg_size, wait_mode, result);
-    const auto ret = msgpipe_recv(emuenv.kernel, export_name, thread_id, msgpipe_id, wait_mode | SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT, recv_buf, msg_size, 0);
+    const auto ret = msgpipe_recv(emuenv.kernel, export_name, thread, msgpipe_id, wait_mode | SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT, recv_buf, msg_size, 0);
     if (ret == 0) {
         return SCE_KERNEL_ERROR_MPP_EMPTY;
     }
@@ -1766,7 +1744,7 @@ EXPORT(int, sceKernelTrySendMsgPipe, SceUID msgPipeId, const void *pSendBuf, Sce
     STUBBED("");
     waitMode |= SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT;
     SceUInt32 pTimeout = 0;
-    const auto ret = msgpipe_send(emuenv.kernel, export_name, thread_id, msgPipeId, waitMode, pSendBuf, sendSize, &pTimeout);
+    const auto ret = msgpipe_send(emuenv.kernel, export_name, thread, msgPipeId, waitMode, pSendBuf, sendSize, &pTimeout);
     if (static_cast<int>(ret) < 0) {
         return ret;
     }
@@ -1789,8 +1767,11 @@ EXPORT(int, sceKernelUnloadModule) {
 
 EXPORT(int, sceKernelUnlockLwMutex, Ptr<SceKernelLwMutexWork> workarea, int unlock_count) {
     TRACY_FUNC(sceKernelUnlockLwMutex, workarea, unlock_count);
+    if (lwmutex_unlock_fast(emuenv.mem, workarea, thread, unlock_count))
+        return SCE_KERNEL_OK;
+
     const auto lwmutexid = workarea.get(emuenv.mem)->uid;
-    return mutex_unlock(emuenv.kernel, export_name, thread_id, lwmutexid, unlock_count, SyncWeight::Light);
+    return mutex_unlock(emuenv.kernel, emuenv.mem, export_name, thread, lwmutexid, unlock_count, SyncWeight::Light);
 }
 
 EXPORT(int, sceKernelUnlockLwMutex_0, Ptr<SceKernelLwMutexWork> workarea, int unlock_count) {
@@ -1800,8 +1781,11 @@ EXPORT(int, sceKernelUnlockLwMutex_0, Ptr<SceKernelLwMutexWork> workarea, int un
 
 EXPORT(int, sceKernelUnlockLwMutex2, Ptr<SceKernelLwMutexWork> workarea, int unlock_count) {
     TRACY_FUNC(sceKernelUnlockLwMutex2, workarea, unlock_count);
+    if (lwmutex_unlock_fast(emuenv.mem, workarea, thread, unlock_count))
+        return SCE_KERNEL_OK;
+
     const auto lwmutexid = workarea.get(emuenv.mem)->uid;
-    return mutex_unlock(emuenv.kernel, export_name, thread_id, lwmutexid, unlock_count, SyncWeight::Light);
+    return mutex_unlock(emuenv.kernel, emuenv.mem, export_name, thread, lwmutexid, unlock_count, SyncWeight::Light);
 }
 
 EXPORT(SceInt32, sceKernelWaitCond, SceUID condId, SceUInt32 *pTimeout) {
@@ -1826,7 +1810,7 @@ EXPORT(SceInt32, sceKernelWaitEventCB, SceUID event_id, SceUInt32 bit_pattern, S
 
 EXPORT(SceInt32, sceKernelWaitEventFlag, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout) {
     TRACY_FUNC(sceKernelWaitEventFlag, evfId, bitPattern, waitMode, pResultPat, pTimeout);
-    return eventflag_wait(emuenv.kernel, export_name, thread_id, evfId, bitPattern, waitMode, pResultPat, pTimeout);
+    return eventflag_wait(emuenv.kernel, export_name, thread, evfId, bitPattern, waitMode, pResultPat, pTimeout);
 }
 
 EXPORT(SceInt32, sceKernelWaitEventFlagCB, SceUID evfId, SceUInt32 bitPattern, SceUInt32 waitMode, SceUInt32 *pResultPat, SceUInt32 *pTimeout) {
@@ -1847,7 +1831,7 @@ EXPORT(int, sceKernelWaitExceptionCB) {
 EXPORT(int, sceKernelWaitLwCond, Ptr<SceKernelLwCondWork> workarea, SceUInt32 *timeout) {
     TRACY_FUNC(sceKernelWaitLwCond, workarea, timeout);
     const auto cond_id = workarea.get(emuenv.mem)->uid;
-    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, cond_id, timeout, SyncWeight::Light);
+    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread, cond_id, timeout, SyncWeight::Light);
 }
 
 EXPORT(SceInt32, sceKernelWaitLwCondCB, Ptr<SceKernelLwCondWork> pWork, SceUInt32 *pTimeout) {
@@ -19,6 +19,7 @@
 
 #include <io/functions.h>
 #include <kernel/state.h>
+#include <mem/slab.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 #include <util/tracy.h>
@@ -255,7 +256,7 @@ EXPORT(int, _sceLdTlsUnregisterModuleInfo) {
 EXPORT(Ptr<int>, _sceLibcErrnoLoc) {
     TRACY_FUNC(_sceLibcErrnoLoc);
     // tls key from disasmed source
-    auto res = emuenv.kernel.get_thread_tls_addr(emuenv.mem, thread_id, 0x88);
+    auto res = thread->get_tls_addr(0x88);
     return res.cast<int>();
 }
 
@@ -334,9 +335,16 @@ EXPORT(int, c32rtomb) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, calloc) {
-    TRACY_FUNC(calloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, calloc, SceSize elements, SceSize size) {
+    TRACY_FUNC(calloc, elements, size);
+    const uint64_t total_size = static_cast<uint64_t>(elements) * size;
+    if (total_size > std::numeric_limits<uint32_t>::max())
+        return Ptr<void>();
+
+    const Address address = slab_alloc(emuenv.mem, thread->slab_cache, static_cast<uint32_t>(total_size), __FUNCTION__);
+    if (address)
+        memset(Ptr<void>(address).get(emuenv.mem), 0, total_size);
+    return Ptr<void>(address);
 }
 
 EXPORT(int, clearerr) {
@@ -477,7 +485,7 @@ EXPORT(int, fread) {
 
 EXPORT(void, free, Address mem) {
     TRACY_FUNC(free, mem);
-    free(emuenv.mem, mem);
+    slab_free(emuenv.mem, thread->slab_cache, mem);
 }
 
 EXPORT(int, freopen) {
@@ -762,7 +770,7 @@ EXPORT(int, longjmp) {
 
 EXPORT(int, malloc, SceSize size) {
     TRACY_FUNC(malloc, size);
-    return alloc(emuenv.mem, size, __FUNCTION__);
+    return slab_alloc(emuenv.mem, thread->slab_cache, size, __FUNCTION__);
 }
 
 EXPORT(int, malloc_stats) {
@@ -775,9 +783,9 @@ EXPORT(int, malloc_stats_fast) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, malloc_usable_size) {
-    TRACY_FUNC(malloc_usable_size);
-    return UNIMPLEMENTED();
+EXPORT(SceSize, malloc_usable_size, Address ptr) {
+    TRACY_FUNC(malloc_usable_size, ptr);
+    return slab_usable_size(emuenv.mem, ptr);
 }
 
 EXPORT(int, mblen) {
@@ -835,14 +843,40 @@ EXPORT(int, mbtowc) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(Ptr<void>, memalign, uint32_t alignment, uint32_t size) {
-    TRACY_FUNC(memalign, alignment, size);
-    Address address = alloc(emuenv.mem, size, "memalign", alignment);
+static Address libc_memalign(EmuEnvState &emuenv, const ThreadStatePtr &thread, uint32_t alignment, uint32_t size) {
+    if (alignment <= SLAB_BLOCK_ALIGNMENT)
+        return slab_alloc(emuenv.mem, thread->slab_cache, size, "memalign");
 
-    STUBBED("No actual alignment.");
+    // the page allocations are always aligned on a page
+    const Address address = alloc(emuenv.mem, size, "memalign", alignment > emuenv.mem.page_size ? alignment : 0);
     LOG_WARN_IF(address % alignment != 0, "Address {} does not fit alignment of {}.", log_hex(address), alignment);
+    return address;
+}
 
-    return Ptr<void>(address);
+// move the block to a new one if it is too small or not aligned enough, it is only shrunk in place
+static Address libc_realloc(EmuEnvState &emuenv, const ThreadStatePtr &thread, Address address, uint32_t size, uint32_t alignment) {
+    if (!address)
+        return libc_memalign(emuenv, thread, alignment, size);
+    if (size == 0) {
+        slab_free(emuenv.mem, thread->slab_cache, address);
+        return 0;
+    }
+
+    const uint32_t usable_size = slab_usable_size(emuenv.mem, address);
+    if (usable_size >= size && address % alignment == 0)
+        return address;
+
+    const Address new_address = libc_memalign(emuenv, thread, alignment, size);
+    if (!new_address)
+        return 0;
+    memcpy(Ptr<void>(new_address).get(emuenv.mem), Ptr<void>(address).get(emuenv.mem), std::min(usable_size, size));
+    slab_free(emuenv.mem, thread->slab_cache, address);
+    return new_address;
+}
+
+EXPORT(Ptr<void>, memalign, uint32_t alignment, uint32_t size) {
+    TRACY_FUNC(memalign, alignment, size);
+    return Ptr<void>(libc_memalign(emuenv, thread, alignment, size));
 }
 
 EXPORT(int, memchr) {
@@ -885,14 +919,21 @@ EXPORT(int, mktime) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_calloc) {
-    TRACY_FUNC(mspace_calloc);
-    return UNIMPLEMENTED();
+// the mspaces are in memory given by the app, so they are managed by dlmalloc like the ones of SceLibKernel
+EXPORT(Ptr<void>, mspace_calloc, Ptr<void> space, uint32_t elements, uint32_t size) {
+    TRACY_FUNC(mspace_calloc, space, elements, size);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    void *address = mspace_calloc(space.get(emuenv.mem), elements, size);
+    return Ptr<void>(address, emuenv.mem);
 }
 
-EXPORT(int, mspace_create) {
-    TRACY_FUNC(mspace_create);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_create, Ptr<void> base, uint32_t capacity) {
+    TRACY_FUNC(mspace_create, base, capacity);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    mspace space = create_mspace_with_base(base.get(emuenv.mem), capacity, 0);
+    return Ptr<void>(space, emuenv.mem);
 }
 
 EXPORT(int, mspace_create_internal) {
@@ -900,19 +941,27 @@ EXPORT(int, mspace_create_internal) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_create_with_flag) {
-    TRACY_FUNC(mspace_create_with_flag);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_create_with_flag, Ptr<void> base, uint32_t capacity, int flag) {
+    TRACY_FUNC(mspace_create_with_flag, base, capacity, flag);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    // the flags only enable the checks of the heap
+    mspace space = create_mspace_with_base(base.get(emuenv.mem), capacity, 0);
+    return Ptr<void>(space, emuenv.mem);
 }
 
-EXPORT(int, mspace_destroy) {
-    TRACY_FUNC(mspace_destroy);
-    return UNIMPLEMENTED();
+EXPORT(uint32_t, mspace_destroy, Ptr<void> space) {
+    TRACY_FUNC(mspace_destroy, space);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    return static_cast<uint32_t>(destroy_mspace(space.get(emuenv.mem)));
 }
 
-EXPORT(int, mspace_free) {
-    TRACY_FUNC(mspace_free);
-    return UNIMPLEMENTED();
+EXPORT(void, mspace_free, Ptr<void> space, Ptr<void> address) {
+    TRACY_FUNC(mspace_free, space, address);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    mspace_free(space.get(emuenv.mem), address.get(emuenv.mem));
 }
 
 EXPORT(int, mspace_is_heap_empty) {
@@ -920,9 +969,12 @@ EXPORT(int, mspace_is_heap_empty) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_malloc) {
-    TRACY_FUNC(mspace_malloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_malloc, Ptr<void> space, uint32_t size) {
+    TRACY_FUNC(mspace_malloc, space, size);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    void *address = mspace_malloc(space.get(emuenv.mem), size);
+    return Ptr<void>(address, emuenv.mem);
 }
 
 EXPORT(int, mspace_malloc_stats) {
@@ -935,24 +987,46 @@ EXPORT(int, mspace_malloc_stats_fast) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_malloc_usable_size) {
-    TRACY_FUNC(mspace_malloc_usable_size);
-    return UNIMPLEMENTED();
+EXPORT(uint32_t, mspace_malloc_usable_size, Ptr<void> address) {
+    TRACY_FUNC(mspace_malloc_usable_size, address);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    return address ? static_cast<uint32_t>(mspace_usable_size(address.get(emuenv.mem))) : 0;
 }
 
-EXPORT(int, mspace_memalign) {
-    TRACY_FUNC(mspace_memalign);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_memalign, Ptr<void> space, uint32_t alignment, uint32_t size) {
+    TRACY_FUNC(mspace_memalign, space, alignment, size);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    void *address = mspace_memalign(space.get(emuenv.mem), alignment, size);
+    return Ptr<void>(address, emuenv.mem);
 }
 
-EXPORT(int, mspace_realloc) {
-    TRACY_FUNC(mspace_realloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_realloc, Ptr<void> space, Ptr<void> address, uint32_t size) {
+    TRACY_FUNC(mspace_realloc, space, address, size);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    void *new_address = mspace_realloc(space.get(emuenv.mem), address.get(emuenv.mem), size);
+    return Ptr<void>(new_address, emuenv.mem);
 }
 
-EXPORT(int, mspace_reallocalign) {
-    TRACY_FUNC(mspace_reallocalign);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_reallocalign, Ptr<void> space, Ptr<void> address, uint32_t size, uint32_t alignment) {
+    TRACY_FUNC(mspace_reallocalign, space, address, size, alignment);
+    const ProfiledLockGuard guard(emuenv.kernel.mutex);
+
+    // mspace_realloc could move the block to an address not aligned enough, it is only shrunk in place
+    mspace msp = space.get(emuenv.mem);
+    void *old_address = address.get(emuenv.mem);
+    const size_t usable_size = old_address ? mspace_usable_size(old_address) : 0;
+    if (old_address && usable_size >= size && (alignment == 0 || address.address() % alignment == 0))
+        return address;
+
+    void *new_address = mspace_memalign(msp, alignment, size);
+    if (new_address && old_address) {
+        memcpy(new_address, old_address, std::min<size_t>(usable_size, size));
+        mspace_free(msp, old_address);
+    }
+    return Ptr<void>(new_address, emuenv.mem);
 }
 
 EXPORT(int, perror) {
@@ -965,12 +1039,6 @@ EXPORT(int, printf, const char *format, module::vargs args) {
     // TODO: add args to tracy func
     std::vector<char> buffer(1024);
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-
-    if (!thread) {
-        return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
-    }
-
     const int result = utils::snprintf(buffer.data(), buffer.size(), format, *(thread->cpu), emuenv.mem, args);
 
     if (!result) {
@@ -1037,14 +1105,14 @@ EXPORT(int, rand_r) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, realloc) {
-    TRACY_FUNC(realloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, realloc, Address ptr, SceSize size) {
+    TRACY_FUNC(realloc, ptr, size);
+    return Ptr<void>(libc_realloc(emuenv, thread, ptr, size, SLAB_BLOCK_ALIGNMENT));
 }
 
-EXPORT(int, reallocalign) {
-    TRACY_FUNC(reallocalign);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, reallocalign, Address ptr, SceSize size, SceSize alignment) {
+    TRACY_FUNC(reallocalign, ptr, size, alignment);
+    return Ptr<void>(libc_realloc(emuenv, thread, ptr, size, std::max<uint32_t>(alignment, 1)));
 }
 
 EXPORT(int, remove) {
@@ -1126,7 +1194,6 @@ EXPORT(int, snprintf, char *s, size_t n, const char *format, module::vargs args)
     // TODO: add args to tracy func
     TRACY_FUNC(snprintf, s, n, format);
 
-    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     return utils::snprintf(s, n, format, *(thread->cpu), emuenv.mem, args);
 }
 
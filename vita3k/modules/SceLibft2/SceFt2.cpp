@@ -17,6 +17,77 @@
 
 #include <module/module.h>
 
+#include <algorithm>
+#include <cstdlib>
+
+// The glyph loading and rendering functions need a font engine and are left to the LLE module.
+// Only the fixed point and geometry helpers, which do not depend on any library state, are implemented here.
+// They follow the FreeType 2 code exactly, including its rounding, as the results are used as pixel positions.
+
+// FT_Long and FT_Pos are 32 bits long on the Vita
+typedef int32_t FT_Long;
+typedef int32_t FT_Fixed;
+typedef int32_t FT_Pos;
+typedef int FT_Error;
+
+static constexpr FT_Error FT_Err_Invalid_Argument = 0x06;
+static constexpr int FT_OUTLINE_REVERSE_FILL = 0x4;
+
+struct FT_Vector {
+    FT_Pos x;
+    FT_Pos y;
+};
+
+struct FT_Matrix {
+    FT_Fixed xx, xy;
+    FT_Fixed yx, yy;
+};
+
+struct FT_BBox {
+    FT_Pos xMin, yMin;
+    FT_Pos xMax, yMax;
+};
+
+struct FT_Outline {
+    int16_t n_contours;
+    int16_t n_points;
+    Ptr<FT_Vector> points;
+    Ptr<char> tags;
+    Ptr<int16_t> contours;
+    int flags;
+};
+
+static FT_Long ft_mul_fix(FT_Long a, FT_Long b) {
+    // rounded away from zero
+    const int64_t ab = static_cast<int64_t>(a) * b;
+    const uint64_t c = (static_cast<uint64_t>(std::abs(ab)) + 0x8000) >> 16;
+    return static_cast<FT_Long>(ab < 0 ? -static_cast<int64_t>(c) : static_cast<int64_t>(c));
+}
+
+static FT_Long ft_div_fix(FT_Long a, FT_Long b) {
+    const bool negative = (a < 0) != (b < 0);
+    const uint64_t ua = std::abs(static_cast<int64_t>(a));
+    const uint64_t ub = std::abs(static_cast<int64_t>(b));
+    const uint32_t q = (ub == 0) ? 0x7FFFFFFF : static_cast<uint32_t>(((ua << 16) + (ub >> 1)) / ub);
+    return negative ? -static_cast<FT_Long>(q) : static_cast<FT_Long>(q);
+}
+
+static FT_Long ft_mul_div(FT_Long a, FT_Long b, FT_Long c, bool round) {
+    const bool negative = ((a < 0) != (b < 0)) != (c < 0);
+    const uint64_t ua = std::abs(static_cast<int64_t>(a));
+    const uint64_t ub = std::abs(static_cast<int64_t>(b));
+    const uint64_t uc = std::abs(static_cast<int64_t>(c));
+    const uint32_t d = (uc > 0) ? static_cast<uint32_t>((ua * ub + (round ? uc >> 1 : 0)) / uc) : 0x7FFFFFFF;
+    return negative ? -static_cast<FT_Long>(d) : static_cast<FT_Long>(d);
+}
+
+static void ft_vector_transform(FT_Vector &vector, const FT_Matrix &matrix) {
+    const FT_Pos xz = ft_mul_fix(vector.x, matrix.xx) + ft_mul_fix(vector.y, matrix.xy);
+    const FT_Pos yz = ft_mul_fix(vector.x, matrix.yx) + ft_mul_fix(vector.y, matrix.yy);
+    vector.x = xz;
+    vector.y = yz;
+}
+
 EXPORT(int, FT_Activate_Size) {
     return UNIMPLEMENTED();
 }
@@ -77,16 +148,16 @@ EXPORT(int, FT_CMap_New) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_CeilFix) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Fixed, FT_CeilFix, FT_Fixed a) {
+    return a >= 0 ? (a + 0xFFFF) & ~0xFFFF : -((-a) & ~0xFFFF);
 }
 
 EXPORT(int, FT_Cos) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_DivFix) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Long, FT_DivFix, FT_Long a, FT_Long b) {
+    return ft_div_fix(a, b);
 }
 
 EXPORT(int, FT_Done_Face) {
@@ -137,8 +208,8 @@ EXPORT(int, FT_Face_GetVariantsOfChar) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_FloorFix) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Fixed, FT_FloorFix, FT_Fixed a) {
+    return a >= 0 ? a & ~0xFFFF : -((-a + 0xFFFF) & ~0xFFFF);
 }
 
 EXPORT(int, FT_Free) {
@@ -345,28 +416,54 @@ EXPORT(int, FT_Match_Size) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_Matrix_Invert) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Error, FT_Matrix_Invert, FT_Matrix *matrix) {
+    if (!matrix)
+        return FT_Err_Invalid_Argument;
+
+    const FT_Pos delta = ft_mul_fix(matrix->xx, matrix->yy) - ft_mul_fix(matrix->xy, matrix->yx);
+    if (delta == 0)
+        return FT_Err_Invalid_Argument;
+
+    matrix->xy = -ft_div_fix(matrix->xy, delta);
+    matrix->yx = -ft_div_fix(matrix->yx, delta);
+
+    const FT_Fixed xx = matrix->xx;
+    const FT_Fixed yy = matrix->yy;
+    matrix->xx = ft_div_fix(yy, delta);
+    matrix->yy = ft_div_fix(xx, delta);
+
+    return 0;
 }
 
-EXPORT(int, FT_Matrix_Multiply) {
-    return UNIMPLEMENTED();
+EXPORT(void, FT_Matrix_Multiply, const FT_Matrix *a, FT_Matrix *b) {
+    if (!a || !b)
+        return;
+
+    const FT_Fixed xx = ft_mul_fix(a->xx, b->xx) + ft_mul_fix(a->xy, b->yx);
+    const FT_Fixed xy = ft_mul_fix(a->xx, b->xy) + ft_mul_fix(a->xy, b->yy);
+    const FT_Fixed yx = ft_mul_fix(a->yx, b->xx) + ft_mul_fix(a->yy, b->yx);
+    const FT_Fixed yy = ft_mul_fix(a->yx, b->xy) + ft_mul_fix(a->yy, b->yy);
+
+    b->xx = xx;
+    b->xy = xy;
+    b->yx = yx;
+    b->yy = yy;
 }
 
 EXPORT(int, FT_Matrix_Multiply_Scaled) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_MulDiv) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Long, FT_MulDiv, FT_Long a, FT_Long b, FT_Long c) {
+    return ft_mul_div(a, b, c, true);
 }
 
-EXPORT(int, FT_MulDiv_No_Round) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Long, FT_MulDiv_No_Round, FT_Long a, FT_Long b, FT_Long c) {
+    return ft_mul_div(a, b, c, false);
 }
 
-EXPORT(int, FT_MulFix) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Long, FT_MulFix, FT_Long a, FT_Long b) {
+    return ft_mul_fix(a, b);
 }
 
 EXPORT(int, FT_New_Face) {
@@ -425,8 +522,22 @@ EXPORT(int, FT_Outline_Get_Bitmap) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_Outline_Get_CBox) {
-    return UNIMPLEMENTED();
+EXPORT(void, FT_Outline_Get_CBox, const FT_Outline *outline, FT_BBox *acbox) {
+    if (!outline || !acbox)
+        return;
+
+    *acbox = {};
+    if (outline->n_points <= 0)
+        return;
+
+    const FT_Vector *points = outline->points.get(emuenv.mem);
+    *acbox = { points[0].x, points[0].y, points[0].x, points[0].y };
+    for (int16_t i = 1; i < outline->n_points; i++) {
+        acbox->xMin = std::min(acbox->xMin, points[i].x);
+        acbox->yMin = std::min(acbox->yMin, points[i].y);
+        acbox->xMax = std::max(acbox->xMax, points[i].x);
+        acbox->yMax = std::max(acbox->yMax, points[i].y);
+    }
 }
 
 EXPORT(int, FT_Outline_Get_Orientation) {
@@ -445,16 +556,42 @@ EXPORT(int, FT_Outline_Render) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_Outline_Reverse) {
-    return UNIMPLEMENTED();
+EXPORT(void, FT_Outline_Reverse, FT_Outline *outline) {
+    if (!outline)
+        return;
+
+    FT_Vector *points = outline->points.get(emuenv.mem);
+    char *tags = outline->tags.get(emuenv.mem);
+    const int16_t *contours = outline->contours.get(emuenv.mem);
+    int first = 0;
+    for (int16_t n = 0; n < outline->n_contours; n++) {
+        const int last = contours[n];
+        std::reverse(points + first, points + last + 1);
+        std::reverse(tags + first, tags + last + 1);
+        first = last + 1;
+    }
+
+    outline->flags ^= FT_OUTLINE_REVERSE_FILL;
 }
 
-EXPORT(int, FT_Outline_Transform) {
-    return UNIMPLEMENTED();
+EXPORT(void, FT_Outline_Transform, const FT_Outline *outline, const FT_Matrix *matrix) {
+    if (!outline || !matrix)
+        return;
+
+    FT_Vector *points = outline->points.get(emuenv.mem);
+    for (int16_t i = 0; i < outline->n_points; i++)
+        ft_vector_transform(points[i], *matrix);
 }
 
-EXPORT(int, FT_Outline_Translate) {
-    return UNIMPLEMENTED();
+EXPORT(void, FT_Outline_Translate, const FT_Outline *outline, FT_Pos xOffset, FT_Pos yOffset) {
+    if (!outline)
+        return;
+
+    FT_Vector *points = outline->points.get(emuenv.mem);
+    for (int16_t i = 0; i < outline->n_points; i++) {
+        points[i].x += xOffset;
+        points[i].y += yOffset;
+    }
 }
 
 EXPORT(int, FT_QAlloc) {
@@ -509,8 +646,8 @@ EXPORT(int, FT_Request_Size) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_RoundFix) {
-    return UNIMPLEMENTED();
+EXPORT(FT_Fixed, FT_RoundFix, FT_Fixed a) {
+    return a >= 0 ? (a + 0x8000) & ~0xFFFF : -((-a + 0x8000) & ~0xFFFF);
 }
 
 EXPORT(int, FT_Select_Charmap) {
@@ -557,8 +694,21 @@ EXPORT(int, FT_Sin) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_Sqrt32) {
-    return UNIMPLEMENTED();
+EXPORT(uint32_t, FT_Sqrt32, int32_t x) {
+    uint32_t val = static_cast<uint32_t>(x);
+    uint32_t root = 0;
+    uint32_t mask = 0x40000000;
+    do {
+        const uint32_t new_root = root + mask;
+        if (new_root <= val) {
+            val -= new_root;
+            root = new_root + mask;
+        }
+        root >>= 1;
+        mask >>= 2;
+    } while (mask != 0);
+
+    return root;
 }
 
 EXPORT(int, FT_SqrtFixed) {
@@ -657,8 +807,11 @@ EXPORT(int, FT_Vector_Rotate) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, FT_Vector_Transform) {
-    return UNIMPLEMENTED();
+EXPORT(void, FT_Vector_Transform, FT_Vector *vector, const FT_Matrix *matrix) {
+    if (!vector || !matrix)
+        return;
+
+    ft_vector_transform(*vector, *matrix);
 }
 
 EXPORT(int, FT_Vector_Transform_Scaled) {
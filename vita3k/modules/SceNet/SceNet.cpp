@@ -207,7 +207,7 @@ EXPORT(int, sceNetEpollControl, int eid, SceNetEpollControlFlag op, int id, SceN
 
     switch (op) {
     case SCE_NET_EPOLL_CTL_ADD:
-        return epoll->add(id, posixSocket->sock, ev);
+        return epoll->add(id, posixSocket->sock, ev, posixSocket->received);
     case SCE_NET_EPOLL_CTL_DEL:
         return epoll->del(id, posixSocket->sock, ev);
     case SCE_NET_EPOLL_CTL_MOD:
@@ -221,7 +221,7 @@ EXPORT(int, sceNetEpollCreate, const char *name, int flags) {
     TRACY_FUNC(sceNetEpollCreate, name, flags);
     auto id = ++emuenv.net.next_epoll_id;
     auto epoll = std::make_shared<Epoll>();
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
     emuenv.net.epolls.emplace(id, epoll);
     return id;
 }
@@ -229,7 +229,7 @@ EXPORT(int, sceNetEpollCreate, const char *name, int flags) {
 EXPORT(int, sceNetEpollDestroy, int eid) {
     TRACY_FUNC(sceNetEpollDestroy, eid);
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
     if (emuenv.net.epolls.erase(eid) == 0) {
         return RET_ERROR(SCE_NET_EBADF);
     }
@@ -255,7 +255,7 @@ EXPORT(int, sceNetEpollWaitCB) {
 EXPORT(Ptr<int>, sceNetErrnoLoc) {
     TRACY_FUNC(sceNetErrnoLoc);
     // TLS id was taken from disasm source
-    auto addr = emuenv.kernel.get_thread_tls_addr(emuenv.mem, thread_id, 0x40);
+    auto addr = thread->get_tls_addr(0x40);
     return addr.cast<int>();
 }
 
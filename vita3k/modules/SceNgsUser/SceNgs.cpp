@@ -17,6 +17,7 @@
 
 #include <module/module.h>
 
+#include <kernel/thread/thread_state.h>
 #include <modules/module_parent.h>
 #include <ngs/state.h>
 #include <ngs/system.h>
@@ -360,7 +361,7 @@ EXPORT(SceUInt32, sceNgsSystemUpdate, ngs::System *system) {
         return 0;
     }
 
-    system->voice_scheduler.update(emuenv.kernel, emuenv.mem, thread_id);
+    system->voice_scheduler.update(emuenv.kernel, emuenv.mem, thread->id);
 
     return SCE_NGS_OK;
 }
@@ -749,7 +750,7 @@ EXPORT(SceInt32, sceNgsVoiceKeyOff, ngs::Voice *voice) {
     voice->rack->system->voice_scheduler.off(voice);
 
     // call the finish callback, I got no idea what the module id should be in this case
-    voice->invoke_callback(emuenv.kernel, emuenv.mem, thread_id, voice->finished_callback, voice->finished_callback_user_data, 0);
+    voice->invoke_callback(emuenv.kernel, emuenv.mem, thread->id, voice->finished_callback, voice->finished_callback_user_data, 0);
 
     voice->is_keyed_off = false;
     voice->rack->system->voice_scheduler.stop(voice);
@@ -944,8 +945,7 @@ EXPORT(SceInt32, sceNgsVoiceSetParamsBlock, ngs::Voice *voice, const SceNgsModul
     if (!voice)
         return RET_ERROR(SCE_NGS_ERROR_INVALID_ARG);
 
-    const std::lock_guard<std::mutex> guard(*voice->voice_mutex);
-
+    // the parameters are published to the scheduler without waiting for it
     const SceInt32 num_errors = voice->parse_params_block(emuenv.mem, header, size);
     if (pNumErrors != nullptr) {
         *pNumErrors = num_errors;
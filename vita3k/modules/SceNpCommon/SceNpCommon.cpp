@@ -43,7 +43,6 @@ struct SceNpAuthRequestParameter {
 
 EXPORT(int, sceNpAuthCreateStartRequest, const SceNpAuthRequestParameter *param) {
     TRACY_FUNC(sceNpAuthCreateStartRequest, param);
-    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     // todo: this callback function should be called from sceNpCheckCallback
     STUBBED("Immediately call ticket callback");
     thread->run_callback(param->ticketCb.address(), { 1, 1, param->cbArg.address() });
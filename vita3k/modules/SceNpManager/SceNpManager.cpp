@@ -69,7 +69,6 @@ EXPORT(int, sceNpCheckCallback) {
 
     emuenv.np.state = emuenv.cfg.current_config.psn_status;
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
     for (auto &callback : emuenv.np.cbs) {
         thread->run_callback(callback.second.pc, { (uint32_t)emuenv.np.state, 0, callback.second.data });
     }
@@ -141,7 +140,7 @@ EXPORT(int, sceNpManagerGetNpId, np::SceNpId *id) {
 
 EXPORT(int, sceNpRegisterServiceStateCallback, Ptr<void> callback, Ptr<void> data) {
     TRACY_FUNC(sceNpRegisterServiceStateCallback, callback, data);
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    const ProfiledLockGuard lock(emuenv.kernel.mutex);
     uint32_t cid = emuenv.kernel.get_next_uid();
     SceNpServiceStateCallback sceNpServiceStateCallback;
     sceNpServiceStateCallback.pc = callback.address();
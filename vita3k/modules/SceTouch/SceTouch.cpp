@@ -17,6 +17,7 @@
 
 #include <module/module.h>
 
+#include <kernel/thread/thread_state.h>
 #include <touch/functions.h>
 #include <touch/state.h>
 #include <touch/touch.h>
@@ -196,7 +197,7 @@ EXPORT(int, sceTouchPeek, SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs)
         return RET_ERROR(SCE_TOUCH_ERROR_INVALID_ARG);
     }
 
-    return touch_get(thread_id, emuenv, port, pData, nBufs, true);
+    return touch_get(thread->id, emuenv, port, pData, nBufs, true);
 }
 
 EXPORT(int, sceTouchPeek2, SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs) {
@@ -208,7 +209,7 @@ EXPORT(int, sceTouchPeek2, SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs)
         return RET_ERROR(SCE_TOUCH_ERROR_INVALID_ARG);
     }
 
-    return touch_get(thread_id, emuenv, port, pData, nBufs, true);
+    return touch_get(thread->id, emuenv, port, pData, nBufs, true);
 }
 
 EXPORT(int, sceTouchPeekRegion, SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs, int region) {
@@ -230,7 +231,7 @@ EXPORT(int, sceTouchRead, SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs)
     if (pData == nullptr) {
         return RET_ERROR(SCE_TOUCH_ERROR_INVALID_ARG);
     }
-    return touch_get(thread_id, emuenv, port, pData, nBufs, false);
+    return touch_get(thread->id, emuenv, port, pData, nBufs, false);
 }
 
 EXPORT(int, sceTouchRead2, SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs) {
@@ -242,7 +243,7 @@ EXPORT(int, sceTouchRead2, SceUInt32 port, SceTouchData *pData, SceUInt32 nBufs)
         return RET_ERROR(SCE_TOUCH_ERROR_INVALID_ARG);
     }
 
-    return touch_get(thread_id, emuenv, port, pData, nBufs, false);
+    return touch_get(thread->id, emuenv, port, pData, nBufs, false);
 }
 
 EXPORT(int, sceTouchReadRegion) {
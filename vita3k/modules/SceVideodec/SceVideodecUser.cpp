@@ -19,6 +19,7 @@
 
 #include <codec/state.h>
 #include <kernel/state.h>
+#include <renderer/state.h>
 #include <util/lock_and_find.h>
 
 #include <util/tracy.h>
@@ -158,7 +159,7 @@ EXPORT(int, sceAvcdecCreateDecoder, uint32_t codec_type, SceAvcdecCtrl *decoder,
     SceUID handle = emuenv.kernel.get_next_uid();
     decoder->handle = handle;
 
-    state->decoders[handle] = std::make_shared<H264DecoderState>(query->horizontal, query->vertical);
+    state->decoders[handle] = std::make_shared<H264DecoderState>(query->horizontal, query->vertical, emuenv.cfg.video_hw_decoding);
 
     return 0;
 }
@@ -205,6 +206,8 @@ EXPORT(int, sceAvcdecDecode, SceAvcdecCtrl *decoder, const SceAvcdecAu *au, SceA
     const auto send = decoder_info->send(reinterpret_cast<uint8_t *>(au->es.pBuf.get(emuenv.mem)), au->es.size);
     decoder_info->set_res(pPicture->frame.frameWidth, pPicture->frame.frameHeight);
     if (send && decoder_info->receive(output)) {
+        emuenv.renderer->video_frames.frame_written(pPicture->frame.pPicture[0].address(),
+            H264DecoderState::buffer_size({ { pPicture->frame.frameWidth, pPicture->frame.frameHeight } }));
         decoder_info->get_res(pPicture->frame.horizontalSize, pPicture->frame.verticalSize);
         decoder_info->get_pts(pPicture->info.pts.upper, pPicture->info.pts.lower);
         picture->numOfOutput++;
@@ -26,7 +26,7 @@ struct EmuEnvState;
 struct KernelState;
 
 void init_libraries(EmuEnvState &emuenv);
-void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread_id);
+void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, uint32_t import_index, const ThreadStatePtr &thread);
 
 /**
  * \brief Loads a dynamic module into memory if it wasn't already loaded. If it was, find it and return it.
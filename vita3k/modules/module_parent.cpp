@@ -27,14 +27,19 @@
 #include <io/vfs.h>
 #include <kernel/load_self.h>
 #include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
 #include <module/load_module.h>
 #include <nids/functions.h>
 #include <util/arm.h>
+#include <util/boot_profiler.h>
 #include <util/find.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 #include <util/string_utils.h>
+#include <util/trace_log.h>
 
+#include <chrono>
+#include <optional>
 #include <unordered_set>
 
 static constexpr bool LOG_UNK_NIDS_ALWAYS = false;
@@ -51,20 +56,29 @@ static constexpr bool LOG_UNK_NIDS_ALWAYS = false;
 
 struct EmuEnvState;
 
-static ImportFn resolve_import(uint32_t nid) {
+static const ImportFn *resolve_import(uint32_t nid) {
     switch (nid) {
 #define VAR_NID(name, nid)
 #define NID(name, nid) \
     case nid:          \
-        return import_##name;
+        return &import_##name;
 #include <nids/nids.inc>
 #undef NID
 #undef VAR_NID
     }
 
-    return ImportFn();
+    return nullptr;
 }
 
+// the HLE functions in the order of import_index, used by the stubs resolved at load time
+static const ImportFn *const import_table[] = {
+#define VAR_NID(name, nid)
+#define NID(name, nid) &import_##name,
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+};
+
 const std::array<VarExport, var_exports_size> &get_var_exports() {
     static std::array<VarExport, var_exports_size> var_exports = { {
 #define NID(name, nid)
@@ -98,36 +112,46 @@ Address resolve_export(KernelState &kernel, uint32_t nid) {
 }
 
 static void log_import_call(char emulation_level, uint32_t nid, SceUID thread_id, const std::unordered_set<uint32_t> &nid_blacklist, Address lr) {
-    if (!nid_blacklist.contains(nid)) {
-        const char *const name = import_name(nid);
-        LOG_TRACE("[{}LE] TID: {:<3} FUNC: {} {} at {}", emulation_level, thread_id, log_hex(nid), name, log_hex(lr));
-    }
+    if (!nid_blacklist.contains(nid))
+        LOG_TRACE("[{}LE] TID: {:<3} FUNC: {} {} at {}", emulation_level, thread_id, log_hex(nid), import_name(nid), log_hex(lr));
 }
 
-void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread_id) {
-    Address export_pc = resolve_export(emuenv.kernel, nid);
+void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, uint32_t import_index, const ThreadStatePtr &thread) {
+    thread->import_call_count++;
+    thread->last_import_nid = nid;
+
+    // the stub already knows its HLE function, the exports only need to be looked up if a module loaded since then provides it
+    const bool is_resolved = import_index < std::size(import_table) && !emuenv.kernel.hle_import_exported[import_index];
+    const Address export_pc = is_resolved ? 0 : resolve_export(emuenv.kernel, nid);
 
     if (!export_pc) {
         // HLE - call our C++ function
+        TRACE_EVENT(TraceEvent::HleImportCall, nid, read_lr(cpu));
         if (emuenv.kernel.debugger.watch_import_calls) {
-            const std::unordered_set<uint32_t> hle_nid_blacklist = {
+            static const std::unordered_set<uint32_t> hle_nid_blacklist = {
                 0xB295EB61, // sceKernelGetTLSAddr
                 0x46E7BE7B, // sceKernelLockLwMutex
                 0x91FA6614, // sceKernelUnlockLwMutex
             };
             auto lr = read_lr(cpu);
-            log_import_call('H', nid, thread_id, hle_nid_blacklist, lr);
+            log_import_call('H', nid, thread->id, hle_nid_blacklist, lr);
         }
-        const ImportFn fn = resolve_import(nid);
-        if (fn) {
-            fn(emuenv, cpu, thread_id);
+        const ImportFn *const fn = is_resolved ? import_table[import_index] : resolve_import(nid);
+        std::optional<HleHostTimeScope> host_time;
+        if (fn && emuenv.kernel.measure_host_time.load(std::memory_order_relaxed))
+            host_time.emplace(emuenv.kernel, *thread);
+        if (fn && emuenv.kernel.hle_profiler.enabled) {
+            const auto start = std::chrono::steady_clock::now();
+            (*fn)(emuenv, cpu, thread);
+            record_hle_call(emuenv.kernel.hle_profiler, *thread, is_resolved ? import_index : ::import_index(nid), std::chrono::steady_clock::now() - start);
+        } else if (fn) {
+            (*fn)(emuenv, cpu, thread);
         } else {
-            const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
             // make the function return 0
             write_reg(*thread->cpu, 0, 0);
 
             if (emuenv.missing_nids.count(nid) == 0 || LOG_UNK_NIDS_ALWAYS) {
-                LOG_ERROR("Import function for NID {} not found (thread name: {}, thread ID: {})", log_hex(nid), thread->name, thread_id);
+                LOG_ERROR("Import function for NID {} not found (thread name: {}, thread ID: {})", log_hex(nid), thread->name, thread->id);
 
                 if (!LOG_UNK_NIDS_ALWAYS)
                     emuenv.missing_nids.insert(nid);
@@ -149,15 +173,16 @@ void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread
         // LLE - directly run ARM code imported from some loaded module
         // TODO: resurrect this
         /*if (is_returning(cpu)) {
-            LOG_TRACE("[LLE] TID: {:<3} FUNC: {} returned {}", thread_id, import_name(nid), log_hex(read_reg(cpu, 0)));
+            LOG_TRACE("[LLE] TID: {:<3} FUNC: {} returned {}", thread->id, import_name(nid), log_hex(read_reg(cpu, 0)));
             return;
         }*/
 
+        TRACE_EVENT(TraceEvent::LleImportCall, nid, pc);
         const std::unordered_set<uint32_t> lle_nid_blacklist = {};
-        log_import_call('L', nid, thread_id, lle_nid_blacklist, pc);
+        log_import_call('L', nid, thread->id, lle_nid_blacklist, pc);
         write_pc(cpu, export_pc);
-        // TODO: invalidate cache for all threads. Now invalidate_jit_cache is not thread safe.
-        invalidate_jit_cache(cpu, pc, 4 * 3);
+        // the stub can be in the jit cache of every thread
+        emuenv.kernel.invalidate_jit_cache(pc, 4 * 3);
     }
 }
 
@@ -172,6 +197,7 @@ SceUID load_module(EmuEnvState &emuenv, const std::string &module_path) {
         return module_iter->first;
     }
     LOG_INFO("Loading module \"{}\"", module_path);
+    const BootScope boot_scope(emuenv.boot_profiler, module_path, "module");
     vfs::FileBuffer module_buffer;
     bool res;
     VitaIoDevice device = device::get_device(module_path);
@@ -184,7 +210,7 @@ SceUID load_module(EmuEnvState &emuenv, const std::string &module_path) {
         LOG_ERROR("Failed to read module file {}", module_path);
         return SCE_ERROR_ERRNO_ENOENT;
     }
-    SceUID module_id = load_self(emuenv.kernel, emuenv.mem, module_buffer.data(), module_path, emuenv.log_path.string());
+    SceUID module_id = load_self(emuenv.kernel, emuenv.mem, module_buffer.data(), module_buffer.size(), module_path, emuenv.log_path.string());
     if (module_id >= 0) {
         const auto module = emuenv.kernel.loaded_modules[module_id];
         LOG_INFO("Module {} (at \"{}\") loaded", module->module_name, module_path);
@@ -198,6 +224,7 @@ uint32_t start_module(EmuEnvState &emuenv, const std::shared_ptr<SceKernelModule
     const auto module_start = module->start_entry;
     if (module_start) {
         const auto module_name = module->module_name;
+        const BootScope boot_scope(emuenv.boot_profiler, module_name, "module_start");
 
         LOG_DEBUG("Running module_start of library: {} at address {}", module_name, log_hex(module_start.address()));
         SceInt32 priority = SCE_KERNEL_DEFAULT_PRIORITY_USER;
@@ -220,6 +247,7 @@ uint32_t start_module(EmuEnvState &emuenv, const std::shared_ptr<SceKernelModule
  */
 bool load_sys_module(EmuEnvState &emuenv, SceSysmoduleModuleId module_id) {
     const auto &module_paths = sysmodule_paths[module_id];
+    const BootScope boot_scope(emuenv.boot_profiler, fmt::format("sysmodule {}", log_hex(static_cast<uint32_t>(module_id))), "sysmodule");
     for (const auto module_filename : module_paths) {
         std::string module_path;
         if (module_id == SCE_SYSMODULE_SMART || module_id == SCE_SYSMODULE_FACE || module_id == SCE_SYSMODULE_ULT) {
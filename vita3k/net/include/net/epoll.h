@@ -2,6 +2,10 @@
 
 #include <net/socket.h>
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 struct Epoll;
 
 typedef std::shared_ptr<Epoll> EpollPtr;
@@ -10,12 +14,30 @@ struct EpollSocket {
     unsigned int events;
     SceNetEpollData data;
     abs_socket sock;
+    // datagrams already read from the socket, which the host wait does not report
+    DatagramQueuePtr received;
 };
 
+// The sockets are registered in a host epoll (Linux) or kqueue (macOS and BSD) when they are added,
+// a wait only goes through the ready sockets. On Windows, they are kept in the array given to WSAPoll.
 struct Epoll {
+    // the waits only take it once the host wait returned
+    std::mutex mutex;
     std::map<int, EpollSocket> eventEntries;
+#ifdef _WIN32
+    // poll_ids[i] is the id of the socket of poll_fds[i]
+    std::vector<WSAPOLLFD> poll_fds;
+    std::vector<int> poll_ids;
+#else
+    int host_fd = -1;
+#endif
+
+    Epoll();
+    ~Epoll();
+    Epoll(const Epoll &) = delete;
+    Epoll &operator=(const Epoll &) = delete;
 
-    int add(int id, abs_socket sock, SceNetEpollEvent *ev);
+    int add(int id, abs_socket sock, SceNetEpollEvent *ev, DatagramQueuePtr received = nullptr);
     int del(int id, abs_socket sock, SceNetEpollEvent *ev);
     int mod(int id, abs_socket sock, SceNetEpollEvent *ev);
     int wait(SceNetEpollEvent *events, int maxevents, int timeout);
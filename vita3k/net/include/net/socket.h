@@ -19,7 +19,11 @@
 
 #include <net/types.h>
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -63,9 +67,29 @@ struct Socket {
     virtual int get_socket_address(SceNetSockaddr *name, unsigned int *namelen) = 0;
 };
 
+// datagrams read ahead by a batched receive, they are returned before reading the socket again
+struct DatagramQueue {
+    static constexpr uint32_t BATCH_SIZE = 8;
+    // large enough for any udp datagram, so none is truncated when read ahead
+    static constexpr uint32_t DATAGRAM_SIZE = 65536;
+
+    std::mutex mutex;
+    // BATCH_SIZE datagrams of DATAGRAM_SIZE bytes, allocated on the first receive
+    std::vector<char> buffer;
+    sockaddr_in from[BATCH_SIZE];
+    uint32_t sizes[BATCH_SIZE];
+    uint32_t first = 0;
+    // read by the epoll waits without the mutex
+    std::atomic<uint32_t> count = 0;
+};
+
+typedef std::shared_ptr<DatagramQueue> DatagramQueuePtr;
+
 // udp, tcp
 struct PosixSocket : public Socket {
     abs_socket sock;
+    // only set for udp sockets on the hosts with recvmmsg
+    DatagramQueuePtr received;
 
     int sockopt_so_reuseport = 0;
     int sockopt_so_onesbcast = 0;
@@ -79,7 +103,12 @@ struct PosixSocket : public Socket {
 
     explicit PosixSocket(int domain, int type, int protocol)
         : Socket(domain, type, protocol)
-        , sock(socket(domain, type, protocol)){};
+        , sock(socket(domain, type, protocol)) {
+#ifdef __linux__
+        if (type == SOCK_DGRAM)
+            received = std::make_shared<DatagramQueue>();
+#endif
+    };
 
     explicit PosixSocket(abs_socket sock)
         : Socket(0, 0, 0)
@@ -95,6 +124,9 @@ struct PosixSocket : public Socket {
     SocketPtr accept(SceNetSockaddr *addr, unsigned int *addrlen) override;
     int listen(int backlog) override;
     int get_socket_address(SceNetSockaddr *name, unsigned int *namelen) override;
+
+private:
+    int recv_datagram(void *buf, unsigned int len, SceNetSockaddr *from, unsigned int *fromlen);
 };
 
 struct P2PSocket : public Socket {
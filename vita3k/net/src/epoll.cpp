@@ -1,89 +1,364 @@
 #include <net/epoll.h>
 
-int Epoll::add(int id, abs_socket sock, SceNetEpollEvent *ev) {
-    if (!eventEntries.try_emplace(id, EpollSocket{ ev->events, ev->data, sock }).second) {
-        return SCE_NET_ERROR_EEXIST;
-    }
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
-    return 0;
+#ifdef __linux__
+#include <sys/epoll.h>
+#elif !defined(_WIN32)
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+// the sockets in error are also reported as readable and writable, like with select
+static unsigned int get_guest_events(unsigned int requested, bool readable, bool writable, bool error) {
+    unsigned int events = 0;
+    if (readable || error)
+        events |= SCE_NET_EPOLLIN;
+    if (writable || error)
+        events |= SCE_NET_EPOLLOUT;
+    if (error)
+        events |= SCE_NET_EPOLLERR;
+    return events & requested;
 }
 
-int Epoll::del(int id, abs_socket sock, SceNetEpollEvent *ev) {
-    if (eventEntries.erase(id) == 0) {
-        return SCE_NET_ERROR_ENOENT;
-    }
+// the guest timeout is in microseconds, a negative one waits forever
+static int get_timeout_ms(int timeout_microseconds) {
+    if (timeout_microseconds < 0)
+        return -1;
+    return (timeout_microseconds + 999) / 1000;
+}
 
-    return 0;
+#if defined(__linux__)
+
+static uint32_t get_host_events(unsigned int events) {
+    // errors and hang-ups are always reported
+    uint32_t host_events = 0;
+    if (events & SCE_NET_EPOLLIN)
+        host_events |= EPOLLIN;
+    if (events & SCE_NET_EPOLLOUT)
+        host_events |= EPOLLOUT;
+    return host_events;
 }
 
-int Epoll::mod(int id, abs_socket sock, SceNetEpollEvent *ev) {
-    auto it = eventEntries.find(id);
-    if (it == eventEntries.end()) {
-        return SCE_NET_ERROR_ENOENT;
-    }
+static int host_epoll_ctl(int host_fd, int op, int id, abs_socket sock, unsigned int events) {
+    epoll_event host_event{};
+    host_event.events = get_host_events(events);
+    host_event.data.u64 = static_cast<uint64_t>(id);
+    return epoll_ctl(host_fd, op, sock, &host_event);
+}
 
-    it->second.events = ev->events;
-    it->second.data = ev->data;
-    return 0;
+Epoll::Epoll()
+    : host_fd(epoll_create1(EPOLL_CLOEXEC)) {
 }
 
-static void add_event_fd_set(fd_set *set, int *maxFd, abs_socket sock) {
-    FD_SET(sock, set);
-#ifndef _WIN32
-    if (sock > *maxFd) {
-        *maxFd = sock;
-    }
-#endif
+Epoll::~Epoll() {
+    if (host_fd >= 0)
+        close(host_fd);
+}
+
+static int add_host_socket(Epoll &epoll, int id, const EpollSocket &socket) {
+    return host_epoll_ctl(epoll.host_fd, EPOLL_CTL_ADD, id, socket.sock, socket.events);
+}
+
+static void del_host_socket(Epoll &epoll, int id, const EpollSocket &socket) {
+    // the socket is already unregistered if it was closed
+    host_epoll_ctl(epoll.host_fd, EPOLL_CTL_DEL, id, socket.sock, 0);
+}
+
+static int mod_host_socket(Epoll &epoll, int id, const EpollSocket &socket, unsigned int old_events) {
+    return host_epoll_ctl(epoll.host_fd, EPOLL_CTL_MOD, id, socket.sock, socket.events);
 }
 
 int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
-    fd_set readFds, writeFds, exceptFds;
-    FD_ZERO(&readFds);
-    FD_ZERO(&writeFds);
-    FD_ZERO(&exceptFds);
-    int maxFd = 0;
-
-    for (auto &pair : eventEntries) {
-        if (pair.second.events & SCE_NET_EPOLLIN) {
-            add_event_fd_set(&readFds, &maxFd, pair.second.sock);
-        }
-        if (pair.second.events & SCE_NET_EPOLLOUT) {
-            add_event_fd_set(&writeFds, &maxFd, pair.second.sock);
+    if (maxevents <= 0)
+        return SCE_NET_ERROR_EINVAL;
+
+    // the sockets with datagrams read ahead are readable without their host socket being ready
+    std::vector<int> queued_ids;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &[id, socket] : eventEntries) {
+            if (socket.received && (socket.events & SCE_NET_EPOLLIN) && socket.received->count != 0)
+                queued_ids.push_back(id);
         }
-        if (pair.second.events & SCE_NET_EPOLLERR) {
-            add_event_fd_set(&exceptFds, &maxFd, pair.second.sock);
+    }
+
+    std::vector<epoll_event> host_events(maxevents);
+    const int ret = epoll_wait(host_fd, host_events.data(), maxevents, queued_ids.empty() ? get_timeout_ms(timeout_microseconds) : 0);
+    if (ret < 0 && queued_ids.empty()) {
+        // TODO: translate error code
+        return errno == EINTR ? 0 : -1;
+    }
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    int eventCount = 0;
+    for (int i = 0; i < ret; i++) {
+        // the socket may have been removed during the wait
+        const int id = static_cast<int>(host_events[i].data.u64);
+        const auto it = eventEntries.find(id);
+        if (it == eventEntries.end())
+            continue;
+
+        const auto queued = std::find(queued_ids.begin(), queued_ids.end(), id);
+        const bool has_queued = queued != queued_ids.end();
+        if (has_queued)
+            queued_ids.erase(queued);
+
+        const uint32_t host_event = host_events[i].events;
+        const unsigned int eventTypes = get_guest_events(it->second.events, has_queued || (host_event & EPOLLIN), host_event & EPOLLOUT, host_event & (EPOLLERR | EPOLLHUP));
+        if (eventTypes != 0) {
+            events[eventCount].events = eventTypes;
+            events[eventCount].data = it->second.data;
+            eventCount++;
         }
     }
 
-    timeval timeout;
+    for (const int id : queued_ids) {
+        if (eventCount == maxevents)
+            break;
+
+        const auto it = eventEntries.find(id);
+        if (it == eventEntries.end())
+            continue;
+
+        events[eventCount].events = SCE_NET_EPOLLIN;
+        events[eventCount].data = it->second.data;
+        eventCount++;
+    }
+
+    return eventCount;
+}
+
+#elif !defined(_WIN32)
+
+// the read filter also reports the errors, so it is used for SCE_NET_EPOLLERR too
+static bool has_read_filter(unsigned int events) {
+    return events & (SCE_NET_EPOLLIN | SCE_NET_EPOLLERR);
+}
+
+static bool has_write_filter(unsigned int events) {
+    return events & SCE_NET_EPOLLOUT;
+}
+
+static int update_host_filters(Epoll &epoll, int id, abs_socket sock, unsigned int old_events, unsigned int events) {
+    struct kevent changes[2];
+    int change_count = 0;
+    const auto update_filter = [&](int16_t filter, bool old_filter, bool new_filter) {
+        if (old_filter == new_filter)
+            return;
+        EV_SET(&changes[change_count++], sock, filter, new_filter ? (EV_ADD | EV_ENABLE) : EV_DELETE, 0, 0, reinterpret_cast<void *>(static_cast<intptr_t>(id)));
+    };
+    update_filter(EVFILT_READ, has_read_filter(old_events), has_read_filter(events));
+    update_filter(EVFILT_WRITE, has_write_filter(old_events), has_write_filter(events));
+    if (change_count == 0)
+        return 0;
+
+    return kevent(epoll.host_fd, changes, change_count, nullptr, 0, nullptr);
+}
+
+Epoll::Epoll()
+    : host_fd(kqueue()) {
+}
+
+Epoll::~Epoll() {
+    if (host_fd >= 0)
+        close(host_fd);
+}
+
+static int add_host_socket(Epoll &epoll, int id, const EpollSocket &socket) {
+    return update_host_filters(epoll, id, socket.sock, 0, socket.events);
+}
+
+static void del_host_socket(Epoll &epoll, int id, const EpollSocket &socket) {
+    // the filters are already removed if the socket was closed
+    update_host_filters(epoll, id, socket.sock, socket.events, 0);
+}
+
+static int mod_host_socket(Epoll &epoll, int id, const EpollSocket &socket, unsigned int old_events) {
+    return update_host_filters(epoll, id, socket.sock, old_events, socket.events);
+}
+
+int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
+    if (maxevents <= 0)
+        return SCE_NET_ERROR_EINVAL;
+
+    // a socket can be returned once for each of its filters
+    std::vector<struct kevent> host_events(maxevents * 2);
+    timespec timeout;
     timeout.tv_sec = timeout_microseconds / 1000000;
-    timeout.tv_usec = timeout_microseconds % 1000000;
-    auto ret = select(maxFd + 1, &readFds, &writeFds, &exceptFds, &timeout);
+    timeout.tv_nsec = (timeout_microseconds % 1000000) * 1000;
+    const int ret = kevent(host_fd, nullptr, 0, host_events.data(), static_cast<int>(host_events.size()), timeout_microseconds < 0 ? nullptr : &timeout);
     if (ret < 0) {
         // TODO: translate error code
-        return -1;
+        return errno == EINTR ? 0 : -1;
     }
 
+    const std::lock_guard<std::mutex> lock(mutex);
     int eventCount = 0;
-    for (auto &pair : eventEntries) {
-        unsigned int eventTypes = 0;
-        if (FD_ISSET(pair.second.sock, &readFds)) {
-            eventTypes |= SCE_NET_EPOLLIN;
-        }
-        if (FD_ISSET(pair.second.sock, &writeFds)) {
-            eventTypes |= SCE_NET_EPOLLOUT;
-        }
-        if (FD_ISSET(pair.second.sock, &exceptFds)) {
-            eventTypes |= SCE_NET_EPOLLERR;
+    std::vector<int> event_ids;
+    for (int i = 0; i < ret; i++) {
+        const struct kevent &host_event = host_events[i];
+        const int id = static_cast<int>(reinterpret_cast<intptr_t>(host_event.udata));
+        // the socket may have been removed during the wait
+        const auto it = eventEntries.find(id);
+        if (it == eventEntries.end())
+            continue;
+
+        const bool error = host_event.flags & (EV_EOF | EV_ERROR);
+        const unsigned int eventTypes = get_guest_events(it->second.events, host_event.filter == EVFILT_READ, host_event.filter == EVFILT_WRITE, error);
+        if (eventTypes == 0)
+            continue;
+
+        // merge the events of the read and write filters of the same socket
+        const auto event_it = std::find(event_ids.begin(), event_ids.end(), id);
+        if (event_it != event_ids.end()) {
+            events[event_it - event_ids.begin()].events |= eventTypes;
+        } else if (eventCount < maxevents) {
+            events[eventCount].events = eventTypes;
+            events[eventCount].data = it->second.data;
+            event_ids.push_back(id);
+            eventCount++;
         }
+    }
+
+    return eventCount;
+}
+
+#else
+
+static short get_host_events(unsigned int events) {
+    // WSAPoll fails with the other read flags, errors and hang-ups are always reported
+    short host_events = 0;
+    if (events & SCE_NET_EPOLLIN)
+        host_events |= POLLRDNORM;
+    if (events & SCE_NET_EPOLLOUT)
+        host_events |= POLLWRNORM;
+    return host_events;
+}
+
+Epoll::Epoll() = default;
+
+Epoll::~Epoll() = default;
+
+static int add_host_socket(Epoll &epoll, int id, const EpollSocket &socket) {
+    epoll.poll_fds.push_back({ socket.sock, get_host_events(socket.events), 0 });
+    epoll.poll_ids.push_back(id);
+    return 0;
+}
+
+static void del_host_socket(Epoll &epoll, int id, const EpollSocket &socket) {
+    const auto it = std::find(epoll.poll_ids.begin(), epoll.poll_ids.end(), id);
+    if (it == epoll.poll_ids.end())
+        return;
+
+    // the order does not matter, the last socket takes the place of the removed one
+    const size_t index = it - epoll.poll_ids.begin();
+    epoll.poll_fds[index] = epoll.poll_fds.back();
+    epoll.poll_ids[index] = epoll.poll_ids.back();
+    epoll.poll_fds.pop_back();
+    epoll.poll_ids.pop_back();
+}
+
+static int mod_host_socket(Epoll &epoll, int id, const EpollSocket &socket, unsigned int old_events) {
+    const auto it = std::find(epoll.poll_ids.begin(), epoll.poll_ids.end(), id);
+    if (it != epoll.poll_ids.end())
+        epoll.poll_fds[it - epoll.poll_ids.begin()].events = get_host_events(socket.events);
+    return 0;
+}
+
+int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
+    if (maxevents <= 0)
+        return SCE_NET_ERROR_EINVAL;
+
+    // the sockets can be changed by other threads during the wait
+    std::vector<WSAPOLLFD> fds;
+    std::vector<int> ids;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        fds = poll_fds;
+        ids = poll_ids;
+    }
+
+    const int timeout_ms = get_timeout_ms(timeout_microseconds);
+    if (fds.empty()) {
+        // WSAPoll fails without sockets
+        if (timeout_ms > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        return 0;
+    }
+
+    const int ret = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout_ms);
+    if (ret < 0) {
+        // TODO: translate error code
+        return -1;
+    }
 
-        if (eventTypes != 0 && eventCount < maxevents) {
-            auto i = eventCount++;
+    const std::lock_guard<std::mutex> lock(mutex);
+    int eventCount = 0;
+    for (size_t i = 0; i < fds.size() && eventCount < ret && eventCount < maxevents; i++) {
+        const short host_event = fds[i].revents;
+        if (host_event == 0)
+            continue;
+
+        // the socket may have been removed during the wait
+        const auto it = eventEntries.find(ids[i]);
+        if (it == eventEntries.end())
+            continue;
 
-            events[i].events = eventTypes;
-            events[i].data = pair.second.data;
+        const unsigned int eventTypes = get_guest_events(it->second.events, host_event & POLLRDNORM, host_event & POLLWRNORM, host_event & (POLLERR | POLLHUP));
+        if (eventTypes != 0) {
+            events[eventCount].events = eventTypes;
+            events[eventCount].data = it->second.data;
+            eventCount++;
         }
     }
 
     return eventCount;
 }
+
+#endif
+
+int Epoll::add(int id, abs_socket sock, SceNetEpollEvent *ev, DatagramQueuePtr received) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto [it, inserted] = eventEntries.try_emplace(id, EpollSocket{ ev->events, ev->data, sock, std::move(received) });
+    if (!inserted) {
+        return SCE_NET_ERROR_EEXIST;
+    }
+
+    if (add_host_socket(*this, id, it->second) < 0) {
+        eventEntries.erase(it);
+        return SCE_NET_ERROR_EBADF;
+    }
+
+    return 0;
+}
+
+int Epoll::del(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it == eventEntries.end()) {
+        return SCE_NET_ERROR_ENOENT;
+    }
+
+    del_host_socket(*this, id, it->second);
+    eventEntries.erase(it);
+    return 0;
+}
+
+int Epoll::mod(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it == eventEntries.end()) {
+        return SCE_NET_ERROR_ENOENT;
+    }
+
+    const unsigned int old_events = it->second.events;
+    it->second.events = ev->events;
+    it->second.data = ev->data;
+    if (mod_host_socket(*this, id, it->second, old_events) < 0)
+        return SCE_NET_ERROR_EBADF;
+
+    return 0;
+}
@@ -339,7 +339,57 @@ int PosixSocket::get_socket_options(int level, int optname, void *optval, unsign
     return SCE_NET_ERROR_EINVAL;
 }
 
+int PosixSocket::recv_datagram(void *buf, unsigned int len, SceNetSockaddr *from, unsigned int *fromlen) {
+    DatagramQueue &queue = *received;
+    const std::lock_guard<std::mutex> lock(queue.mutex);
+
+#ifdef __linux__
+    if (queue.count == 0) {
+        if (queue.buffer.empty())
+            queue.buffer.resize(DatagramQueue::BATCH_SIZE * DatagramQueue::DATAGRAM_SIZE);
+
+        mmsghdr msgs[DatagramQueue::BATCH_SIZE] = {};
+        iovec iovs[DatagramQueue::BATCH_SIZE];
+        for (uint32_t i = 0; i < DatagramQueue::BATCH_SIZE; i++) {
+            iovs[i].iov_base = queue.buffer.data() + i * DatagramQueue::DATAGRAM_SIZE;
+            iovs[i].iov_len = DatagramQueue::DATAGRAM_SIZE;
+            msgs[i].msg_hdr.msg_name = &queue.from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // only the first datagram is waited for, the ones already there come with it
+        const int res = recvmmsg(sock, msgs, DatagramQueue::BATCH_SIZE, MSG_WAITFORONE, nullptr);
+        if (res < 0)
+            return translate_return_value(res);
+
+        for (int i = 0; i < res; i++)
+            queue.sizes[i] = msgs[i].msg_len;
+        queue.first = 0;
+        queue.count = res;
+    }
+#endif
+
+    const uint32_t index = queue.first;
+    const uint32_t size = std::min<uint32_t>(queue.sizes[index], len);
+    memcpy(buf, queue.buffer.data() + index * DatagramQueue::DATAGRAM_SIZE, size);
+    if (from != nullptr) {
+        convertPosixSockaddrToSce(reinterpret_cast<sockaddr *>(&queue.from[index]), from);
+        *fromlen = sizeof(SceNetSockaddrIn);
+    }
+
+    queue.first++;
+    queue.count--;
+
+    return size;
+}
+
 int PosixSocket::recv_packet(void *buf, unsigned int len, int flags, SceNetSockaddr *from, unsigned int *fromlen) {
+    // the datagrams of a udp socket are read in batches, unless the call needs special flags
+    if (received && (flags == 0 || received->count != 0))
+        return recv_datagram(buf, len, from, fromlen);
+
     if (from != nullptr) {
         struct sockaddr addr;
         int res = recvfrom(sock, (char *)buf, len, flags, &addr, (socklen_t *)fromlen);
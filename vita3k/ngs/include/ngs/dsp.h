@@ -0,0 +1,47 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstdint>
+
+// DSP kernels used by the modules, the buffers hold interleaved stereo float samples
+namespace ngs::dsp {
+
+// y = b0 * x + b1 * x[-1] + b2 * x[-2] - a1 * y[-1] - a2 * y[-2]
+struct BiquadCoefficients {
+    float b0 = 1.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+};
+
+// state of one biquad for both channels, kept between the updates
+struct BiquadState {
+    float z1[2] = {};
+    float z2[2] = {};
+};
+
+// dest = clamp(dest + src * matrix), matrix[i][j] being the volume of the source channel i in the destination channel j
+void mix_accumulate(float *dest, const float *src, const float matrix[2][2], uint32_t frame_count);
+void apply_gain(float *dest, const float *src, float left_gain, float right_gain, uint32_t frame_count);
+// runs the frames through the stages one after the other, src and dest can be the same buffer
+void apply_biquads(float *dest, const float *src, const BiquadCoefficients *coefficients, BiquadState *states, uint32_t stage_count, uint32_t frame_count);
+void float_to_s16(int16_t *dest, const float *src, uint32_t sample_count);
+
+} // namespace ngs::dsp
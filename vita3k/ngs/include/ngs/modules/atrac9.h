@@ -82,15 +82,21 @@ private:
     std::unique_ptr<Atrac9DecoderState> decoder;
     uint32_t last_config = 0;
     std::vector<uint8_t> temp_buffer;
+    // kept between the calls to not allocate them for each superframe
+    std::vector<int16_t> pcm_buffer;
+    std::vector<uint8_t> decoded_buffer;
     SceNgsAT9States *last_state = nullptr;
 
-    static SwrContext *swr_mono_to_stereo;
-    static SwrContext *swr_stereo;
+    // shared by all the modules, the voices of different racks can be processed at the same time by different threads
+    static thread_local SwrContext *swr_mono_to_stereo;
+    static thread_local SwrContext *swr_stereo;
 
     // return false if data could not be decoded (error or no more data available)
     bool decode_more_data(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, const SceNgsAT9Params *params, SceNgsAT9States *state, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock);
 
 public:
+    ~Atrac9Module() override;
+
     bool process(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) override;
     uint32_t module_id() const override { return 0x5CAA; }
     void on_state_change(ModuleData &v, const VoiceState previous) override;
@@ -100,6 +100,8 @@ namespace ngs {
 class PlayerModule : public Module {
 private:
     std::unique_ptr<PCMDecoderState> decoder;
+    // samples waiting to be resampled, reused by all the voices of the rack
+    std::vector<uint8_t> decoded_data;
 
 public:
     bool process(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) override;
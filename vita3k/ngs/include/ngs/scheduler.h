@@ -20,10 +20,15 @@
 #include <util/types.h>
 
 #include <mem/ptr.h>
+#include <util/task_pool.h>
 
 #include <thread>
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <vector>
@@ -59,6 +64,18 @@ struct OperationPending {
     };
 };
 
+// voices of an update, with the patches between them
+struct VoiceGraph {
+    std::vector<Voice *> voices;
+    // indexes of the voices each voice sends data to
+    std::vector<std::vector<size_t>> dependants;
+    // number of voices each voice still waits data from
+    std::unique_ptr<std::atomic<uint32_t>[]> pending_inputs;
+    // voices which finished playing during the update, they are stopped once all the voices are processed
+    std::vector<Voice *> finished_voices;
+    size_t remaining = 0;
+};
+
 struct VoiceScheduler {
     std::vector<Voice *> queue;
     std::queue<OperationPending> operations_pending;
@@ -67,7 +84,16 @@ struct VoiceScheduler {
     std::condition_variable_any condvar;
     bool is_updating = false;
 
+    VoiceScheduler() = default;
+
 protected:
+    // The voices which don't depend on each other are processed in parallel by the workers.
+    // The guest callbacks they invoke are still run by the thread updating the scheduler.
+    TaskGroup voice_tasks{ TaskPriority::LatencyCritical };
+    std::mutex worker_mutex;
+    std::condition_variable worker_cond;
+    std::queue<std::pair<const std::function<void()> *, bool *>> callback_requests;
+
     bool deque_voice_impl(Voice *voice);
     void deque_insert(const MemState &mem, Voice *voice);
 
@@ -75,7 +101,15 @@ protected:
 
     std::int32_t get_position(Voice *v);
 
+    // returns false if the patches are making a loop, the voices must be processed in the queue order then
+    bool build_graph(const MemState &mem, VoiceGraph &graph);
+    void process_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, Voice *voice, std::unique_lock<std::recursive_mutex> &scheduler_lock, VoiceGraph &graph);
+    void process_graph_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, VoiceGraph &graph, size_t index);
+
 public:
+    // run a callback on the thread updating the scheduler, directly if it is the one calling
+    void run_on_update_thread(const std::function<void()> &callback);
+
     bool deque_voice(Voice *voice);
 
     bool play(const MemState &mem, Voice *voice);
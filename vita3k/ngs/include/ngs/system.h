@@ -18,6 +18,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <mutex>
 #include <vector>
@@ -58,6 +59,28 @@ struct Patch {
     float volume_matrix[2][2];
 };
 
+// copies of the module parameters made by the game, the scheduler takes the latest one at the start of a granule
+// three slots let the game publish again while the scheduler still reads the previous copy, so neither side waits
+struct ParamsBuffers {
+    enum : uint32_t {
+        SLOT_MASK = 3,
+        PUBLISHED = 1 << 2,
+        GENERATION_SHIFT = 3,
+    };
+
+    std::array<std::vector<uint8_t>, 3> slots;
+    // slot of the latest copy, with PUBLISHED set until the scheduler takes it and its generation in the upper bits
+    std::atomic<uint32_t> shared = 1;
+
+    // only used by the game thread
+    uint32_t game_slot = 0;
+    uint32_t game_generation = 0;
+
+    // only used by the scheduler, a generation of 0 means the parameters were never published
+    uint32_t scheduler_slot = 2;
+    uint32_t scheduler_generation = 0;
+};
+
 struct ModuleData {
     Voice *parent;
     uint32_t index;
@@ -71,7 +94,9 @@ struct ModuleData {
     std::vector<uint8_t> extra_storage; ///< Local data storage for module.
 
     SceNgsBufferInfo info;
+    // parameters used by the scheduler before the last change
     std::vector<uint8_t> last_info;
+    std::unique_ptr<ParamsBuffers> params_buffers;
 
     enum Flags {
         PARAMS_LOCK = 1 << 0,
@@ -91,16 +116,23 @@ struct ModuleData {
         return reinterpret_cast<T *>(&voice_state_data[0]);
     }
 
+    // must only be called by the scheduler
     template <typename T>
     T *get_parameters(const MemState &mem) {
-        if (flags & PARAMS_LOCK) {
-            // Use our previous set of data
-            return reinterpret_cast<T *>(&last_info[0]);
+        if (params_buffers->scheduler_generation != 0) {
+            // Use the latest set of data published by the game
+            return reinterpret_cast<T *>(params_buffers->slots[params_buffers->scheduler_slot].data());
         }
 
         return info.data.cast<T>().get(mem);
     }
 
+    void init_params();
+    // copy the parameters written by the game and make them available to the scheduler
+    void publish_params(const MemState &mem);
+    // take the parameters published since the last granule, returns true if there were some
+    bool update_params(const MemState &mem);
+
     void fill_to_fit_granularity();
 
     void invoke_callback(KernelState &kern, const MemState &mem, const SceUID thread_id, const uint32_t reason1,
@@ -138,6 +170,13 @@ struct VoiceInputManager {
     using PCMInputs = std::vector<PCMInput>;
 
     PCMInputs inputs;
+    // reported to the memory accounting
+    uint64_t accounted_bytes = 0;
+
+    VoiceInputManager() = default;
+    VoiceInputManager(const VoiceInputManager &) = delete;
+    VoiceInputManager &operator=(const VoiceInputManager &) = delete;
+    ~VoiceInputManager();
 
     void init(const uint32_t granularity, const uint16_t total_input);
     void reset_inputs();
@@ -191,6 +230,9 @@ struct Rack : public MempoolObject {
     System *system;
     VoiceDefinition *vdef;
 
+    // the modules are shared by the voices of the rack, so only one of them is processed at a time
+    std::mutex process_mutex;
+
     int32_t channels_per_voice;
     int32_t max_patches_per_input;
     int32_t patches_per_output;
@@ -0,0 +1,136 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <ngs/dsp.h>
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VITA3K_X86_64
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VITA3K_AARCH64
+#include <arm_neon.h>
+#endif
+
+namespace ngs::dsp {
+
+// SSE2 and NEON are always available on these architectures, each vector holds 2 stereo frames
+void mix_accumulate(float *dest, const float *src, const float matrix[2][2], uint32_t frame_count) {
+    uint32_t frame = 0;
+#if defined(VITA3K_X86_64)
+    const __m128 left_volume = _mm_setr_ps(matrix[0][0], matrix[0][1], matrix[0][0], matrix[0][1]);
+    const __m128 right_volume = _mm_setr_ps(matrix[1][0], matrix[1][1], matrix[1][0], matrix[1][1]);
+    const __m128 min = _mm_set1_ps(-1.0f);
+    const __m128 max = _mm_set1_ps(1.0f);
+    for (; frame + 2 <= frame_count; frame += 2) {
+        const __m128 samples = _mm_loadu_ps(src + frame * 2);
+        const __m128 left = _mm_shuffle_ps(samples, samples, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m128 right = _mm_shuffle_ps(samples, samples, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 mixed = _mm_add_ps(_mm_loadu_ps(dest + frame * 2), _mm_add_ps(_mm_mul_ps(left, left_volume), _mm_mul_ps(right, right_volume)));
+        mixed = _mm_min_ps(_mm_max_ps(mixed, min), max);
+        _mm_storeu_ps(dest + frame * 2, mixed);
+    }
+#elif defined(VITA3K_AARCH64)
+    const float32x4_t left_volume = { matrix[0][0], matrix[0][1], matrix[0][0], matrix[0][1] };
+    const float32x4_t right_volume = { matrix[1][0], matrix[1][1], matrix[1][0], matrix[1][1] };
+    const float32x4_t min = vdupq_n_f32(-1.0f);
+    const float32x4_t max = vdupq_n_f32(1.0f);
+    for (; frame + 2 <= frame_count; frame += 2) {
+        const float32x4_t samples = vld1q_f32(src + frame * 2);
+        const float32x4_t left = vtrn1q_f32(samples, samples);
+        const float32x4_t right = vtrn2q_f32(samples, samples);
+        float32x4_t mixed = vmlaq_f32(vld1q_f32(dest + frame * 2), left, left_volume);
+        mixed = vmlaq_f32(mixed, right, right_volume);
+        vst1q_f32(dest + frame * 2, vminq_f32(vmaxq_f32(mixed, min), max));
+    }
+#endif
+    for (; frame < frame_count; frame++) {
+        const float left = src[frame * 2];
+        const float right = src[frame * 2 + 1];
+        dest[frame * 2] = std::clamp(dest[frame * 2] + left * matrix[0][0] + right * matrix[1][0], -1.0f, 1.0f);
+        dest[frame * 2 + 1] = std::clamp(dest[frame * 2 + 1] + left * matrix[0][1] + right * matrix[1][1], -1.0f, 1.0f);
+    }
+}
+
+void apply_gain(float *dest, const float *src, float left_gain, float right_gain, uint32_t frame_count) {
+    uint32_t frame = 0;
+#if defined(VITA3K_X86_64)
+    const __m128 gain = _mm_setr_ps(left_gain, right_gain, left_gain, right_gain);
+    for (; frame + 2 <= frame_count; frame += 2)
+        _mm_storeu_ps(dest + frame * 2, _mm_mul_ps(_mm_loadu_ps(src + frame * 2), gain));
+#elif defined(VITA3K_AARCH64)
+    const float32x4_t gain = { left_gain, right_gain, left_gain, right_gain };
+    for (; frame + 2 <= frame_count; frame += 2)
+        vst1q_f32(dest + frame * 2, vmulq_f32(vld1q_f32(src + frame * 2), gain));
+#endif
+    for (; frame < frame_count; frame++) {
+        dest[frame * 2] = src[frame * 2] * left_gain;
+        dest[frame * 2 + 1] = src[frame * 2 + 1] * right_gain;
+    }
+}
+
+void apply_biquads(float *dest, const float *src, const BiquadCoefficients *coefficients, BiquadState *states, uint32_t stage_count, uint32_t frame_count) {
+    if (dest != src)
+        std::copy_n(src, frame_count * 2, dest);
+
+    // each output depends on the previous one, so only the 2 channels are computed together
+    for (uint32_t stage = 0; stage < stage_count; stage++) {
+        const BiquadCoefficients &coeff = coefficients[stage];
+        BiquadState &state = states[stage];
+        float z1[2] = { state.z1[0], state.z1[1] };
+        float z2[2] = { state.z2[0], state.z2[1] };
+        for (uint32_t frame = 0; frame < frame_count; frame++) {
+            for (int channel = 0; channel < 2; channel++) {
+                // transposed direct form II
+                const float input = dest[frame * 2 + channel];
+                const float output = coeff.b0 * input + z1[channel];
+                z1[channel] = coeff.b1 * input - coeff.a1 * output + z2[channel];
+                z2[channel] = coeff.b2 * input - coeff.a2 * output;
+                dest[frame * 2 + channel] = output;
+            }
+        }
+        std::copy_n(z1, 2, state.z1);
+        std::copy_n(z2, 2, state.z2);
+    }
+}
+
+void float_to_s16(int16_t *dest, const float *src, uint32_t sample_count) {
+    uint32_t sample = 0;
+#if defined(VITA3K_X86_64)
+    // the conversion truncates like the scalar version, the clamp keeps it in the range of int32
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    for (; sample + 8 <= sample_count; sample += 8) {
+        const __m128i low = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + sample), scale), min), max));
+        const __m128i high = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + sample + 4), scale), min), max));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + sample), _mm_packs_epi32(low, high));
+    }
+#elif defined(VITA3K_AARCH64)
+    const float32x4_t scale = vdupq_n_f32(32768.0f);
+    for (; sample + 8 <= sample_count; sample += 8) {
+        const int32x4_t low = vcvtq_s32_f32(vmulq_f32(vld1q_f32(src + sample), scale));
+        const int32x4_t high = vcvtq_s32_f32(vmulq_f32(vld1q_f32(src + sample + 4), scale));
+        vst1q_s16(dest + sample, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+    }
+#endif
+    for (; sample < sample_count; sample++)
+        dest[sample] = static_cast<int16_t>(std::clamp(src[sample] * 32768.0f, -32768.0f, 32767.0f));
+}
+
+} // namespace ngs::dsp
@@ -25,8 +25,8 @@ extern "C" {
 
 namespace ngs {
 
-SwrContext *Atrac9Module::swr_mono_to_stereo = nullptr;
-SwrContext *Atrac9Module::swr_stereo = nullptr;
+thread_local SwrContext *Atrac9Module::swr_mono_to_stereo = nullptr;
+thread_local SwrContext *Atrac9Module::swr_stereo = nullptr;
 
 void atrac9_get_buffer_parameter(const uint32_t start_sample, const uint32_t num_samples, const uint32_t info, SceNgsAT9SkipBufferInfo &parameter) {
     const uint8_t sample_rate_index = ((info & (0b1111 << 12)) >> 12);
@@ -56,12 +56,17 @@ void atrac9_get_buffer_parameter(const uint32_t start_sample, const uint32_t num
     parameter.end_skip = (start_superframe + num_superframe) * samples_per_superframe - (start_sample + num_samples);
 }
 
+Atrac9Module::~Atrac9Module() {
+    release_atrac9_decoder(std::move(decoder));
+}
+
 void Atrac9Module::on_state_change(ModuleData &data, const VoiceState previous) {
     SceNgsAT9States *state = data.get_state<SceNgsAT9States>();
     if (data.parent->state == VOICE_STATE_AVAILABLE) {
         state->current_byte_position_in_buffer = 0;
         state->current_loop_count = 0;
         state->current_buffer = 0;
+        release_resampler(state->swr);
     } else if (data.parent->is_keyed_off) {
         state->samples_generated_since_key_on = 0;
         state->bytes_consumed_since_key_on = 0;
@@ -71,11 +76,11 @@ void Atrac9Module::on_state_change(ModuleData &data, const VoiceState previous)
 void Atrac9Module::on_param_change(const MemState &mem, ModuleData &data) {
     SceNgsAT9States *state = data.get_state<SceNgsAT9States>();
     const SceNgsAT9Params *old_params = reinterpret_cast<SceNgsAT9Params *>(data.last_info.data());
-    const SceNgsAT9Params *new_params = reinterpret_cast<SceNgsAT9Params *>(data.info.data.get(mem));
+    const SceNgsAT9Params *new_params = data.get_parameters<SceNgsAT9Params>(mem);
 
     // if playback scaling changed, reset the resampler
     if (state->swr && (old_params->playback_frequency != new_params->playback_frequency || old_params->playback_scalar != new_params->playback_scalar)) {
-        swr_free(&state->swr);
+        release_resampler(state->swr);
     }
 }
 
@@ -93,9 +98,10 @@ bool Atrac9Module::decode_more_data(KernelState &kern, const MemState &mem, cons
         decoder->export_state(&last_state->saved_state);
     }
 
-    // re-create the decoder if necessary
+    // change the decoder if necessary, the voices with different configs switch between the decoders of the pool
     if (!decoder || params->config_data != last_config) {
-        decoder = std::make_unique<Atrac9DecoderState>(params->config_data);
+        release_atrac9_decoder(std::move(decoder));
+        decoder = acquire_atrac9_decoder(params->config_data);
         last_config = params->config_data;
     }
 
@@ -206,41 +212,51 @@ bool Atrac9Module::decode_more_data(KernelState &kern, const MemState &mem, cons
         return true;
     }
 
+    // decode whole superframes at a time
+    uint32_t superframe_count = 1;
+
     // if the superframe is across two buffers, I don't know how to interpret the skipped samples (which are in the middle of the frame)...
     if (temp_buffer.empty()) {
         // remove skipped samples at the beginnning and the end of the buffer
         // in case you have more than a superframe of samples skipped (I don't know if this can happen)
         const uint32_t sample_index = (state->current_byte_position_in_buffer / superframe_size) * samples_per_superframe;
+        const uint32_t superframes_left = frame_bytes_gotten / superframe_size;
         if (bufparam.samples_discard_start_off > sample_index) {
             // first chunk
             const uint32_t skipped_samples = std::min(samples_per_superframe, bufparam.samples_discard_start_off - sample_index);
             decoded_start_offset += skipped_samples;
             decoded_size -= skipped_samples;
+        } else {
+            // decode at once the superframes needed to fill the granularity, as long as none of their samples is skipped
+            const uint32_t granularity = data.parent->rack->system->granularity;
+            const uint32_t samples_needed = granularity - std::min(state->decoded_samples_pending, granularity);
+            superframe_count = std::clamp((samples_needed + samples_per_superframe - 1) / samples_per_superframe, 1U, superframes_left);
+            while (superframe_count > 1 && bufparam.samples_discard_end_off > (superframes_left - superframe_count) * samples_per_superframe)
+                superframe_count--;
+            decoded_size = superframe_count * samples_per_superframe;
         }
 
-        const uint32_t samples_left_after = (frame_bytes_gotten / superframe_size - 1) * samples_per_superframe;
+        const uint32_t samples_left_after = (superframes_left - superframe_count) * samples_per_superframe;
         if (bufparam.samples_discard_end_off > samples_left_after) {
             // last chunk
             decoded_size -= bufparam.samples_discard_end_off;
         }
     }
 
-    std::vector<uint8_t> decoded_superframe_samples(decoder->get(DecoderQuery::AT9_SAMPLE_PER_SUPERFRAME) * sizeof(float) * 2);
-    uint32_t decoded_superframe_pos = 0;
-    bool got_decode_error = false;
-    // decode a whole superframe at a time
-    for (uint32_t frame = 0; frame < decoder->get(DecoderQuery::AT9_FRAMES_IN_SUPERFRAME); frame++) {
-        if (!decoder->send(input, 0)) {
-            got_decode_error = true;
-            break;
-        }
+    // the frames not decoded because of an error stay silent
+    uint32_t const channel_count = decoder->get(DecoderQuery::CHANNELS);
+    const uint32_t frame_count = superframe_count * decoder->get(DecoderQuery::AT9_FRAMES_IN_SUPERFRAME);
+    const uint32_t total_samples = frame_count * samples_per_frame;
+    pcm_buffer.assign(total_samples * channel_count, 0);
+    decoded_buffer.resize(total_samples * sizeof(float) * 2);
 
-        // convert from int16 to float
-        uint32_t const channel_count = decoder->get(DecoderQuery::CHANNELS);
-        std::vector<uint8_t> temporary_bytes(samples_per_frame * sizeof(int16_t) * channel_count);
-        DecoderSize decoder_size;
-        decoder->receive(temporary_bytes.data(), &decoder_size);
+    uint32_t bytes_used = 0;
+    const bool got_decode_error = decoder->decode_frames(input, frame_count, pcm_buffer.data(), bytes_used) < frame_count;
+    input += bytes_used;
+    state->current_byte_position_in_buffer += bytes_used;
 
+    // convert from int16 to float
+    {
         SwrContext *swr;
         if (channel_count == 1) {
             if (!swr_mono_to_stereo) {
@@ -272,13 +288,9 @@ bool Atrac9Module::decode_more_data(KernelState &kern, const MemState &mem, cons
             swr = swr_stereo;
         }
 
-        const uint8_t *swr_data_in = reinterpret_cast<uint8_t *>(temporary_bytes.data());
-        uint8_t *swr_data_out = reinterpret_cast<uint8_t *>(decoded_superframe_samples.data() + decoded_superframe_pos);
-        const int result = swr_convert(swr, &swr_data_out, decoder_size.samples, &swr_data_in, decoder_size.samples);
-
-        decoded_superframe_pos += decoder_size.samples * sizeof(float) * 2;
-        input += decoder->get_es_size();
-        state->current_byte_position_in_buffer += decoder->get_es_size();
+        const uint8_t *swr_data_in = reinterpret_cast<uint8_t *>(pcm_buffer.data());
+        uint8_t *swr_data_out = decoded_buffer.data();
+        swr_convert(swr, &swr_data_out, total_samples, &swr_data_in, total_samples);
     }
 
     const int32_t sample_rate = data.parent->rack->system->sample_rate;
@@ -292,37 +304,27 @@ bool Atrac9Module::decode_more_data(KernelState &kern, const MemState &mem, cons
         if (params->playback_scalar != 1.0)
             src_sample_rate *= params->playback_scalar;
 
-        if (!state->swr) {
-            AVChannelLayout layout_stereo = AV_CHANNEL_LAYOUT_STEREO;
-            int ret = swr_alloc_set_opts2(&state->swr,
-                &layout_stereo, AV_SAMPLE_FMT_FLT, sample_rate,
-                &layout_stereo, AV_SAMPLE_FMT_FLT, src_sample_rate,
-                0, nullptr);
-            assert(ret == 0);
+        if (!state->swr)
+            state->swr = acquire_resampler(src_sample_rate, sample_rate);
 
-            ret = swr_init(state->swr);
-            assert(ret == 0);
-        }
         // assume the skipped samples happen before the scaling
         int scaled_samples_amount = swr_get_out_samples(state->swr, decoded_size);
-        std::vector<uint8_t> scaled_data(scaled_samples_amount * sizeof(float) * 2, 0);
-
-        uint8_t *scaled_dest_data = scaled_data.data();
-        const uint8_t *scaled_src_data = decoded_superframe_samples.data() + decoded_start_offset * sizeof(float) * 2;
-        scaled_samples_amount = swr_convert(state->swr, &scaled_dest_data, scaled_samples_amount, &scaled_src_data, decoded_size);
-        assert(scaled_samples_amount > 0);
 
         // Allocate memory to accommodate the result of the scaling process into the queue for the final audio buffer
         data.extra_storage.resize(curr_pos + scaled_samples_amount * sizeof(float) * 2);
 
         // Pass scaled audio data into the queue for the final audio buffer
-        memcpy(data.extra_storage.data() + curr_pos, scaled_data.data(), scaled_samples_amount * sizeof(float) * 2);
-        decoded_size = scaled_samples_amount;
+        uint8_t *scaled_dest_data = data.extra_storage.data() + curr_pos;
+        const uint8_t *scaled_src_data = decoded_buffer.data() + decoded_start_offset * sizeof(float) * 2;
+        scaled_samples_amount = swr_convert(state->swr, &scaled_dest_data, scaled_samples_amount, &scaled_src_data, decoded_size);
+        assert(scaled_samples_amount >= 0);
+        data.extra_storage.resize(curr_pos + std::max(scaled_samples_amount, 0) * sizeof(float) * 2);
+        decoded_size = std::max(scaled_samples_amount, 0);
 
     } else {
         data.extra_storage.resize(curr_pos + decoded_size * sizeof(float) * 2);
 
-        memcpy(data.extra_storage.data() + curr_pos, decoded_superframe_samples.data() + decoded_start_offset * sizeof(float) * 2, decoded_size * sizeof(float) * 2);
+        memcpy(data.extra_storage.data() + curr_pos, decoded_buffer.data() + decoded_start_offset * sizeof(float) * 2, decoded_size * sizeof(float) * 2);
     }
 
     if (got_decode_error) {
@@ -343,8 +345,8 @@ bool Atrac9Module::decode_more_data(KernelState &kern, const MemState &mem, cons
 
     state->samples_generated_since_key_on += decoded_size * params->channels;
     state->samples_generated_total += decoded_size * params->channels;
-    state->bytes_consumed_since_key_on += superframe_size;
-    state->total_bytes_consumed += superframe_size;
+    state->bytes_consumed_since_key_on += superframe_size * superframe_count;
+    state->total_bytes_consumed += superframe_size * superframe_count;
 
     state->decoded_samples_pending += decoded_size;
     return true;
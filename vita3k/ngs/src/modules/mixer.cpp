@@ -15,6 +15,7 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <ngs/dsp.h>
 #include <ngs/modules/mixer.h>
 #include <util/log.h>
 
@@ -27,13 +28,23 @@ bool InputMixerModule::process(KernelState &kern, const MemState &mem, const Sce
 }
 
 bool MixerModule::process(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) {
-    if (!data.is_bypassed) {
-        const SceNgsParamsDescriptor *desc = data.get_parameters<SceNgsParamsDescriptor>(mem);
-        if (desc->id == SCE_NGS_MIXER_PARAMS_STRUCT_ID) {
-            LOG_WARN_ONCE("Game is using unimplemented mixer audio module");
-        }
+    if (data.is_bypassed || !data.parent->products[0].data) {
+        return false;
     }
 
+    const SceNgsMixerParams *params = data.get_parameters<SceNgsMixerParams>(mem);
+    if (params->desc.id != SCE_NGS_MIXER_PARAMS_STRUCT_ID) {
+        return false;
+    }
+
+    // the generator is not implemented and lets the decoded stream through, so only the gain of the first input applies
+    const uint32_t granularity = data.parent->rack->system->granularity;
+    data.extra_storage.resize(granularity * 2 * sizeof(float));
+    float *dest = reinterpret_cast<float *>(data.extra_storage.data());
+    const float *src = reinterpret_cast<const float *>(data.parent->products[0].data);
+    dsp::apply_gain(dest, src, params->fGainIn[0], params->fGainIn[0], granularity);
+    data.parent->products[0].data = data.extra_storage.data();
+
     return false;
 }
 } // namespace ngs
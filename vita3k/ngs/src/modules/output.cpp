@@ -15,6 +15,7 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <ngs/dsp.h>
 #include <ngs/modules/output.h>
 #include <util/log.h>
 
@@ -38,9 +39,7 @@ bool OutputModule::process(KernelState &kern, const MemState &mem, const SceUID
     float *source_data = reinterpret_cast<float *>(data.parent->inputs.inputs[0].data());
 
     // Convert FLTP to S16
-    for (int i = 0; i < data.parent->rack->system->granularity * 2; i++) {
-        dest_data[i] = static_cast<std::int16_t>(std::clamp(source_data[i] * 32768.0f, -32768.0f, 32767.0f));
-    }
+    dsp::float_to_s16(dest_data, source_data, data.parent->rack->system->granularity * 2);
 
     return false;
 }
@@ -27,12 +27,37 @@ extern "C" {
 
 namespace ngs {
 
+// the output of a granule is at most MAX_RESAMPLE_RATIO times the granularity before the storage has to grow
+static constexpr uint32_t MAX_RESAMPLE_RATIO = 4;
+
+static float *get_samples(ModuleData &data, const uint32_t offset) {
+    return reinterpret_cast<float *>(data.extra_storage.data()) + offset * 2;
+}
+
+// make room for at least frames samples after the pending ones, moving them to the start of the storage if needed
+static float *reserve_samples(ModuleData &data, SceNgsPlayerStates *state, const uint32_t frames) {
+    const uint32_t capacity = data.extra_storage.size() / (2 * sizeof(float));
+    if (state->decoded_samples_passed + state->decoded_samples_pending + frames > capacity) {
+        float *samples = get_samples(data, 0);
+        std::memmove(samples, samples + state->decoded_samples_passed * 2, state->decoded_samples_pending * 2 * sizeof(float));
+        state->decoded_samples_passed = 0;
+
+        if (state->decoded_samples_pending + frames > capacity)
+            data.extra_storage.resize((state->decoded_samples_pending + frames) * 2 * sizeof(float));
+    }
+
+    return get_samples(data, state->decoded_samples_passed + state->decoded_samples_pending);
+}
+
 void PlayerModule::on_state_change(ModuleData &data, const VoiceState previous) {
     SceNgsPlayerStates *state = data.get_state<SceNgsPlayerStates>();
     if (data.parent->state == VOICE_STATE_AVAILABLE) {
         state->current_byte_position_in_buffer = 0;
         state->current_loop_count = 0;
         state->current_buffer = 0;
+        state->decoded_samples_pending = 0;
+        state->decoded_samples_passed = 0;
+        release_resampler(state->swr);
     } else if (data.parent->is_keyed_off) {
         state->samples_generated_since_key_on = 0;
         state->bytes_consumed_since_key_on = 0;
@@ -47,7 +72,7 @@ void PlayerModule::on_state_change(ModuleData &data, const VoiceState previous)
 void PlayerModule::on_param_change(const MemState &mem, ModuleData &data) {
     SceNgsPlayerStates *state = data.get_state<SceNgsPlayerStates>();
     const SceNgsPlayerParams *old_params = reinterpret_cast<SceNgsPlayerParams *>(data.last_info.data());
-    SceNgsPlayerParams *new_params = reinterpret_cast<SceNgsPlayerParams *>(data.info.data.get(mem));
+    SceNgsPlayerParams *new_params = data.get_parameters<SceNgsPlayerParams>(mem);
 
     if (isnan(new_params->playback_scalar) || new_params->playback_scalar <= 0) {
         new_params->playback_scalar = old_params->playback_scalar;
@@ -92,17 +117,13 @@ bool PlayerModule::process(KernelState &kern, const MemState &mem, const SceUID
         decoder = std::make_unique<PCMDecoderState>(sample_rate);
     }
 
+    // the leftover samples are kept in extra_storage, starting at decoded_samples_passed
+    const uint32_t storage_size = granularity * (MAX_RESAMPLE_RATIO + 2) * 2 * sizeof(float);
+    if (data.extra_storage.size() < storage_size)
+        data.extra_storage.resize(storage_size);
+
     // If the amount of samples already processed and pending to be passed is smaller than the amount of samples of the audio buffer
     if (static_cast<int>(state->decoded_samples_pending) < granularity) {
-        // Memory cleaning check
-        if (!data.extra_storage.empty()) {
-            // Delete data from previous processing if memory isn't empty
-            data.extra_storage.erase(data.extra_storage.begin(), data.extra_storage.begin() + state->decoded_samples_passed * 2 * sizeof(float));
-        }
-
-        // Reset the passed samples count to 0
-        state->decoded_samples_passed = 0;
-
         while (static_cast<int>(state->decoded_samples_pending) < granularity) {
             // Ran out of data, supply new
             // Decode new data and deliver them
@@ -178,8 +199,7 @@ bool PlayerModule::process(KernelState &kern, const MemState &mem, const SceUID
                 state->current_byte_position_in_buffer = 0;
             }
 
-            if (data.extra_storage.size() < sizeof(float) * 2 * granularity
-                && state->current_buffer != -1
+            if (state->current_buffer != -1
                 && params->buffer_params[state->current_buffer].bytes_count != 0) {
                 // Set up decoder
                 decoder->source_channels = params->channels;
@@ -234,7 +254,9 @@ bool PlayerModule::process(KernelState &kern, const MemState &mem, const SceUID
                     LOG_PLAYBACK_SCALING = false;
 
                     // Received decoded samples from decoder
-                    std::vector<uint8_t> decoded_data(samples_count.samples * sizeof(float) * 2, 0);
+                    const size_t decoded_size = samples_count.samples * sizeof(float) * 2;
+                    if (decoded_data.size() < decoded_size)
+                        decoded_data.resize(std::max<size_t>(decoded_size, granularity * MAX_RESAMPLE_RATIO * sizeof(float) * 2));
 
                     // Receive the samples processed by the decoder
                     decoder->receive(decoded_data.data(), nullptr);
@@ -245,66 +267,37 @@ bool PlayerModule::process(KernelState &kern, const MemState &mem, const SceUID
                         src_sample_rate = static_cast<int>(src_sample_rate * params->playback_scalar);
 
                     if (!state->swr || state->reset_swr) {
-                        if (state->swr)
-                            swr_free(&state->swr);
-
-                        AVChannelLayout layout_stereo = AV_CHANNEL_LAYOUT_STEREO;
-                        int ret = swr_alloc_set_opts2(&state->swr,
-                            &layout_stereo, AV_SAMPLE_FMT_FLT, sample_rate,
-                            &layout_stereo, AV_SAMPLE_FMT_FLT, src_sample_rate,
-                            0, nullptr);
-                        assert(ret == 0);
-
-                        ret = swr_init(state->swr);
-                        assert(ret == 0);
+                        release_resampler(state->swr);
+                        state->swr = acquire_resampler(src_sample_rate, sample_rate);
                         state->reset_swr = false;
                     }
                     int scaled_samples_amount = swr_get_out_samples(state->swr, samples_count.samples);
-                    std::vector<uint8_t> scaled_data(scaled_samples_amount * sizeof(float) * 2, 0);
 
-                    uint8_t *scaled_dest_data = scaled_data.data();
+                    // Resample straight after the pending samples
+                    uint8_t *scaled_dest_data = reinterpret_cast<uint8_t *>(reserve_samples(data, state, scaled_samples_amount));
                     const uint8_t *scaled_src_data = decoded_data.data();
                     scaled_samples_amount = swr_convert(state->swr, &scaled_dest_data, scaled_samples_amount, &scaled_src_data, samples_count.samples);
                     assert(scaled_samples_amount > 0);
 
-                    // Get current size of audio queue for processed samples in memory
-                    const uint32_t current_count = state->decoded_samples_pending * sizeof(float) * 2;
-
-                    // Allocate memory to accommodate the result of the scaling process into the queue for the final audio buffer
-                    data.extra_storage.resize(current_count + scaled_samples_amount * sizeof(float) * 2);
-
-                    // Pass scaled audio data into the queue for the final audio buffer
-                    memcpy(data.extra_storage.data() + current_count, scaled_data.data(), scaled_samples_amount * sizeof(float) * 2);
-
+                    state->decoded_samples_pending += std::max(scaled_samples_amount, 0);
                 } else {
-                    // Get current size of audio buffer for processed samples in memory
-                    const uint32_t current_count = state->decoded_samples_pending * sizeof(float) * 2;
-
-                    // Increase the size the audio buffer for processed samples to accommodate the new about-to-be-received samples
-                    data.extra_storage.resize(current_count + samples_count.samples * sizeof(float) * 2);
+                    // Receive the samples processed by the decoder and append them to the already processed samples
+                    float *dest = reserve_samples(data, state, samples_count.samples);
+                    decoder->receive(reinterpret_cast<uint8_t *>(dest), nullptr);
 
-                    // Receive the samples processed by the decoder and append them to the buffer of already processed samples
-                    decoder->receive(current_count + data.extra_storage.data(), nullptr);
+                    state->decoded_samples_pending += samples_count.samples;
                 }
             }
-
-            uint32_t bytes_left_in_buffer = data.extra_storage.size();
-            uint32_t samples_to_take_per_channel = bytes_left_in_buffer / sizeof(float) / 2;
-
-            state->decoded_samples_pending = samples_to_take_per_channel;
         }
     }
 
     uint32_t samples_to_be_passed = std::min<uint32_t>(state->decoded_samples_pending, granularity);
 
-    auto const new_size = 2 * sizeof(float) * (state->decoded_samples_passed + granularity);
-    if (data.extra_storage.size() < new_size) {
-        data.extra_storage.resize(new_size);
-    }
-    uint8_t *data_ptr = data.extra_storage.data();
-    data_ptr += 2 * sizeof(float) * state->decoded_samples_passed;
+    // the product is a whole granule, fill what could not be decoded with silence
+    float *data_ptr = reserve_samples(data, state, granularity - samples_to_be_passed) - state->decoded_samples_pending * 2;
+    std::fill_n(data_ptr + samples_to_be_passed * 2, (granularity - samples_to_be_passed) * 2, 0.0f);
 
-    data.parent->products[0].data = data_ptr;
+    data.parent->products[0].data = reinterpret_cast<uint8_t *>(data_ptr);
 
     state->decoded_samples_pending -= samples_to_be_passed;
     state->decoded_samples_passed += samples_to_be_passed;
@@ -17,11 +17,13 @@
 
 #include <kernel/state.h>
 
+#include <ngs/dsp.h>
 #include <ngs/state.h>
 #include <ngs/system.h>
 #include <util/lock_and_find.h>
 
 #include <util/log.h>
+#include <util/memory_accounting.h>
 
 namespace ngs {
 Rack::Rack(System *mama, const Ptr<void> memspace, const uint32_t memspace_size)
@@ -42,9 +44,17 @@ void VoiceInputManager::init(const uint32_t granularity, const uint16_t total_in
         input.resize(granularity * 8);
     }
 
+    remove_memory_usage(MemoryCategory::NgsVoices, accounted_bytes);
+    accounted_bytes = static_cast<uint64_t>(total_input) * granularity * 8;
+    add_memory_usage(MemoryCategory::NgsVoices, accounted_bytes);
+
     reset_inputs();
 }
 
+VoiceInputManager::~VoiceInputManager() {
+    remove_memory_usage(MemoryCategory::NgsVoices, accounted_bytes);
+}
+
 void VoiceInputManager::reset_inputs() {
     for (auto &input : inputs) {
         std::fill(input.begin(), input.end(), 0);
@@ -85,12 +95,7 @@ int32_t VoiceInputManager::receive(ngs::Patch *patch, const VoiceProduct &produc
 
     // Try mixing, also with the use of this volume matrix
     // Dest is our voice to receive this data.
-    for (int32_t k = 0; k < patch->dest->rack->system->granularity; k++) {
-        dest_buffer[k * 2] = std::clamp(dest_buffer[k * 2] + data_to_mix_in[k * 2] * volume_matrix[0][0]
-                + data_to_mix_in[k * 2 + 1] * volume_matrix[1][0],
-            -1.0f, 1.0f);
-        dest_buffer[k * 2 + 1] = std::clamp(dest_buffer[k * 2 + 1] + data_to_mix_in[k * 2] * volume_matrix[0][1] + data_to_mix_in[k * 2 + 1] * volume_matrix[1][1], -1.0f, 1.0f);
-    }
+    dsp::mix_accumulate(dest_buffer, data_to_mix_in, volume_matrix, patch->dest->rack->system->granularity);
 
     return 0;
 }
@@ -102,30 +107,56 @@ ModuleData::ModuleData()
     , flags(0) {
 }
 
-SceNgsBufferInfo *ModuleData::lock_params(const MemState &mem) {
-    const std::lock_guard<std::mutex> guard(*parent->voice_mutex);
+void ModuleData::init_params() {
+    params_buffers = std::make_unique<ParamsBuffers>();
+    for (auto &slot : params_buffers->slots)
+        slot.resize(info.size);
+    last_info.resize(info.size);
+}
+
+void ModuleData::publish_params(const MemState &mem) {
+    ParamsBuffers &buffers = *params_buffers;
+    memcpy(buffers.slots[buffers.game_slot].data(), info.data.cast<const uint8_t>().get(mem), info.size);
+
+    // the generation skips 0, it is kept for parameters never published
+    buffers.game_generation = (buffers.game_generation + 1) & ((1U << (32 - ParamsBuffers::GENERATION_SHIFT)) - 1);
+    if (buffers.game_generation == 0)
+        buffers.game_generation = 1;
+
+    const uint32_t published = buffers.game_slot | ParamsBuffers::PUBLISHED | (buffers.game_generation << ParamsBuffers::GENERATION_SHIFT);
+    buffers.game_slot = buffers.shared.exchange(published, std::memory_order_acq_rel) & ParamsBuffers::SLOT_MASK;
+}
+
+bool ModuleData::update_params(const MemState &mem) {
+    ParamsBuffers &buffers = *params_buffers;
+    if (!(buffers.shared.load(std::memory_order_relaxed) & ParamsBuffers::PUBLISHED))
+        return false;
 
-    // Save a copy of previous set of data
+    // keep the parameters used until now for the module to compare them with the new ones
+    memcpy(last_info.data(), get_parameters<uint8_t>(mem), info.size);
+
+    const uint32_t taken = buffers.shared.exchange(buffers.scheduler_slot, std::memory_order_acq_rel);
+    buffers.scheduler_slot = taken & ParamsBuffers::SLOT_MASK;
+    buffers.scheduler_generation = taken >> ParamsBuffers::GENERATION_SHIFT;
+
+    return true;
+}
+
+SceNgsBufferInfo *ModuleData::lock_params(const MemState &mem) {
+    // the scheduler keeps using the last published parameters until they are unlocked
     if (flags & PARAMS_LOCK) {
         return nullptr;
     }
 
-    const uint8_t *current_data = info.data.cast<const uint8_t>().get(mem);
-    last_info.resize(info.size);
-    memcpy(last_info.data(), current_data, info.size);
-
     flags |= PARAMS_LOCK;
 
     return &info;
 }
 
 bool ModuleData::unlock_params(const MemState &mem) {
-    const std::lock_guard<std::mutex> guard(*parent->voice_mutex);
-
-    parent->rack->modules[index]->on_param_change(mem, *this);
-
     if (flags & PARAMS_LOCK) {
         flags &= ~PARAMS_LOCK;
+        publish_params(mem);
         return true;
     }
 
@@ -269,6 +300,7 @@ bool Voice::parse_params(const MemState &mem, const SceNgsModuleParamHeader *hea
         return false;
 
     memcpy(storage->info.data.get(mem), descr, descr->size);
+    storage->publish_params(mem);
 
     return true;
 }
@@ -327,20 +359,23 @@ void Voice::invoke_callback(KernelState &kernel, const MemState &mem, const SceU
         return;
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
-    const Address callback_info_addr = stack_alloc(*thread->cpu, sizeof(SceNgsCallbackInfo));
-
-    SceNgsCallbackInfo *info = Ptr<SceNgsCallbackInfo>(callback_info_addr).get(mem);
-    info->rack_handle = Ptr<void>(rack, mem);
-    info->voice_handle = Ptr<void>(this, mem);
-    info->module_id = module_id;
-    info->callback_reason = reason1;
-    info->callback_reason_2 = reason2;
-    info->callback_ptr = Ptr<void>(reason_ptr);
-    info->userdata = user_data;
-
-    thread->run_callback(callback.address(), { callback_info_addr });
-    stack_free(*thread->cpu, sizeof(SceNgsCallbackInfo));
+    // the callback runs guest code on the thread updating the system, even if a worker processes the voice
+    rack->system->voice_scheduler.run_on_update_thread([&]() {
+        const ThreadStatePtr thread = kernel.get_thread(thread_id);
+        const Address callback_info_addr = stack_alloc(*thread->cpu, sizeof(SceNgsCallbackInfo));
+
+        SceNgsCallbackInfo *info = Ptr<SceNgsCallbackInfo>(callback_info_addr).get(mem);
+        info->rack_handle = Ptr<void>(rack, mem);
+        info->voice_handle = Ptr<void>(this, mem);
+        info->module_id = module_id;
+        info->callback_reason = reason1;
+        info->callback_reason_2 = reason2;
+        info->callback_ptr = Ptr<void>(reason_ptr);
+        info->userdata = user_data;
+
+        thread->run_callback(callback.address(), { callback_info_addr });
+        stack_free(*thread->cpu, sizeof(SceNgsCallbackInfo));
+    });
 }
 
 uint32_t System::get_required_memspace_size(SceNgsSystemInitParams *parameters) {
@@ -436,6 +471,7 @@ bool init_rack(State &ngs, const MemState &mem, System *system, SceNgsBufferInfo
 
             v->datas[i].parent = v;
             v->datas[i].index = static_cast<uint32_t>(i);
+            v->datas[i].init_params();
         }
     }
 
@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include <unordered_map>
 
 namespace ngs {
 bool VoiceScheduler::deque_voice_impl(Voice *voice) {
@@ -128,57 +129,198 @@ bool VoiceScheduler::off(Voice *voice) {
     return true;
 }
 
-void VoiceScheduler::update(KernelState &kern, const MemState &mem, const SceUID thread_id) {
-    std::unique_lock<std::recursive_mutex> scheduler_lock(mutex);
-    is_updating = true;
+// set on the pool threads processing a voice, the callbacks they invoke are run by the thread updating the scheduler
+static thread_local bool is_worker_thread = false;
 
-    // make a copy of the queue, this way we have no issue if it is modified in a callbck
-    std::vector<ngs::Voice *> queue_copy = queue;
+static bool use_parallel_voices() {
+    // the task pool has cores to spare only if the host has more than the guest threads and the renderer need
+    static const bool parallel = std::thread::hardware_concurrency() >= 4;
+    return parallel;
+}
 
-    // Do a first routine to clear inputs from previous update session
-    for (ngs::Voice *voice : queue_copy) {
-        voice->inputs.reset_inputs();
+void VoiceScheduler::run_on_update_thread(const std::function<void()> &callback) {
+    if (!is_worker_thread) {
+        callback();
+        return;
     }
 
-    for (ngs::Voice *voice : queue_copy) {
-        // Modify the state, in peace....
-        std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
-        memset(voice->products, 0, sizeof(voice->products));
-
-        bool finished = false;
-        uint32_t finished_module = 0;
+    bool done = false;
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    callback_requests.push({ &callback, &done });
+    worker_cond.notify_all();
+    worker_cond.wait(lock, [&] { return done; });
+}
 
-        for (size_t i = 0; i < voice->rack->modules.size(); i++) {
-            if (voice->rack->modules[i]) {
-                if (voice->rack->modules[i]->process(kern, mem, thread_id, voice->datas[i], scheduler_lock, voice_lock)) {
-                    finished = true;
-                    finished_module = voice->rack->modules[i]->module_id();
-                }
+bool VoiceScheduler::build_graph(const MemState &mem, VoiceGraph &graph) {
+    const size_t voice_count = graph.voices.size();
+    std::unordered_map<Voice *, size_t> indexes;
+    for (size_t i = 0; i < voice_count; i++)
+        indexes.emplace(graph.voices[i], i);
+
+    graph.dependants.assign(voice_count, {});
+    std::vector<uint32_t> input_counts(voice_count, 0);
+    for (size_t i = 0; i < voice_count; i++) {
+        for (const auto &patches : graph.voices[i]->patches) {
+            for (const auto &patch : patches) {
+                if (!patch || patch.get(mem)->output_sub_index == -1)
+                    continue;
+
+                const auto dest = indexes.find(patch.get(mem)->dest);
+                if (dest == indexes.end() || dest->second == i)
+                    continue;
+
+                graph.dependants[i].push_back(dest->second);
+                input_counts[dest->second]++;
             }
         }
-        if (finished) {
-            voice->is_keyed_off = true;
-            voice->transition(VOICE_STATE_FINALIZING);
-            if (voice->finished_callback) {
-                voice_lock.unlock();
-                scheduler_lock.unlock();
-                voice->invoke_callback(kern, mem, thread_id, voice->finished_callback, voice->finished_callback_user_data, finished_module);
-                scheduler_lock.lock();
-                voice_lock.lock();
-            }
-            voice->is_keyed_off = false;
+    }
 
-            stop(voice);
+    // check that all the voices can be reached in the order of the patches
+    std::vector<uint32_t> remaining_inputs = input_counts;
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < voice_count; i++) {
+        if (input_counts[i] == 0)
+            ready.push_back(i);
+    }
+    size_t reached = 0;
+    while (!ready.empty()) {
+        const size_t index = ready.back();
+        ready.pop_back();
+        reached++;
+        for (const size_t dependant : graph.dependants[index]) {
+            if (--remaining_inputs[dependant] == 0)
+                ready.push_back(dependant);
         }
+    }
+    if (reached != voice_count)
+        return false;
+
+    graph.pending_inputs = std::make_unique<std::atomic<uint32_t>[]>(voice_count);
+    for (size_t i = 0; i < voice_count; i++)
+        graph.pending_inputs[i] = input_counts[i];
+    graph.remaining = voice_count;
+
+    return true;
+}
+
+void VoiceScheduler::process_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, Voice *voice, std::unique_lock<std::recursive_mutex> &scheduler_lock, VoiceGraph &graph) {
+    // Modify the state, in peace....
+    std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
+    memset(voice->products, 0, sizeof(voice->products));
 
-        for (size_t i = 0; i < voice->rack->vdef->output_count; i++) {
-            if (voice->products[i].data)
-                deliver_data(mem, voice, static_cast<uint8_t>(i), voice->products[i]);
+    bool finished = false;
+    uint32_t finished_module = 0;
+
+    // the parameters changed by the game since the last granule are applied before processing it
+    for (size_t i = 0; i < voice->rack->modules.size(); i++) {
+        if (voice->rack->modules[i] && voice->datas[i].update_params(mem))
+            voice->rack->modules[i]->on_param_change(mem, voice->datas[i]);
+    }
+
+    for (size_t i = 0; i < voice->rack->modules.size(); i++) {
+        if (voice->rack->modules[i]) {
+            if (voice->rack->modules[i]->process(kern, mem, thread_id, voice->datas[i], scheduler_lock, voice_lock)) {
+                finished = true;
+                finished_module = voice->rack->modules[i]->module_id();
+            }
+        }
+    }
+    if (finished) {
+        voice->is_keyed_off = true;
+        voice->transition(VOICE_STATE_FINALIZING);
+        if (voice->finished_callback) {
+            voice_lock.unlock();
+            scheduler_lock.unlock();
+            voice->invoke_callback(kern, mem, thread_id, voice->finished_callback, voice->finished_callback_user_data, finished_module);
+            scheduler_lock.lock();
+            voice_lock.lock();
         }
+        voice->is_keyed_off = false;
 
-        voice->frame_count++;
+        // stopping the voice needs the lock of the scheduler, which the workers can't take
+        const std::lock_guard<std::mutex> lock(worker_mutex);
+        graph.finished_voices.push_back(voice);
     }
 
+    for (size_t i = 0; i < voice->rack->vdef->output_count; i++) {
+        if (voice->products[i].data)
+            deliver_data(mem, voice, static_cast<uint8_t>(i), voice->products[i]);
+    }
+
+    voice->frame_count++;
+}
+
+void VoiceScheduler::process_graph_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, VoiceGraph &graph, size_t index) {
+    // the pool threads also run other tasks, only mark them while they process a voice
+    is_worker_thread = true;
+    Voice *voice = graph.voices[index];
+    {
+        // the lock of the scheduler stays held by the updating thread, the modules only unlock it around their callbacks
+        std::recursive_mutex worker_scheduler_mutex;
+        std::unique_lock<std::recursive_mutex> scheduler_lock(worker_scheduler_mutex);
+        const std::lock_guard<std::mutex> rack_lock(voice->rack->process_mutex);
+        process_voice(kern, mem, thread_id, voice, scheduler_lock, graph);
+    }
+
+    // the voices this one sends data to can be processed once they got the data of all their sources
+    for (const size_t dependant : graph.dependants[index]) {
+        if (graph.pending_inputs[dependant].fetch_sub(1) == 1)
+            voice_tasks.submit([this, &kern, &mem, thread_id, &graph, dependant]() { process_graph_voice(kern, mem, thread_id, graph, dependant); });
+    }
+    is_worker_thread = false;
+
+    const std::lock_guard<std::mutex> lock(worker_mutex);
+    if (--graph.remaining == 0)
+        worker_cond.notify_all();
+}
+
+void VoiceScheduler::update(KernelState &kern, const MemState &mem, const SceUID thread_id) {
+    std::unique_lock<std::recursive_mutex> scheduler_lock(mutex);
+    is_updating = true;
+
+    // make a copy of the queue, this way we have no issue if it is modified in a callbck
+    VoiceGraph graph;
+    graph.voices = queue;
+
+    // Do a first routine to clear inputs from previous update session
+    for (ngs::Voice *voice : graph.voices) {
+        voice->inputs.reset_inputs();
+    }
+
+    if (use_parallel_voices() && graph.voices.size() > 1 && build_graph(mem, graph)) {
+        std::vector<size_t> ready;
+        for (size_t i = 0; i < graph.voices.size(); i++) {
+            if (graph.pending_inputs[i] == 0)
+                ready.push_back(i);
+        }
+        for (const size_t index : ready)
+            voice_tasks.submit([this, &kern, &mem, thread_id, &graph, index]() { process_graph_voice(kern, mem, thread_id, graph, index); });
+
+        // run the callbacks invoked by the workers until all the voices are processed
+        std::unique_lock<std::mutex> lock(worker_mutex);
+        while (true) {
+            worker_cond.wait(lock, [&] { return graph.remaining == 0 || !callback_requests.empty(); });
+            if (callback_requests.empty())
+                break;
+
+            const auto [callback, done] = callback_requests.front();
+            callback_requests.pop();
+            lock.unlock();
+            scheduler_lock.unlock();
+            (*callback)();
+            scheduler_lock.lock();
+            lock.lock();
+            *done = true;
+            worker_cond.notify_all();
+        }
+    } else {
+        for (ngs::Voice *voice : graph.voices)
+            process_voice(kern, mem, thread_id, voice, scheduler_lock, graph);
+    }
+
+    for (ngs::Voice *voice : graph.finished_voices)
+        stop(voice);
+
     while (!operations_pending.empty()) {
         OperationPending &op = operations_pending.front();
 
@@ -20,3 +20,12 @@
 #include <cstdint>
 
 const char *import_name(uint32_t nid);
+
+constexpr uint32_t INVALID_IMPORT_INDEX = ~0U;
+
+// dense index of the function NIDs, in the order of nids.inc, INVALID_IMPORT_INDEX if the NID is unknown
+uint32_t import_index(uint32_t nid);
+// number of function NIDs, all the indices are below it
+uint32_t import_count();
+// NID of the given import_index, 0 if it is out of range
+uint32_t import_nid(uint32_t index);
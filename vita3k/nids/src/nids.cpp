@@ -38,3 +38,41 @@ const char *import_name(uint32_t nid) {
         return "UNRECOGNISED";
     }
 }
+
+enum ImportIndex : uint32_t {
+#define VAR_NID(name, nid)
+#define NID(name, nid) import_index_##name,
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+    import_index_count
+};
+
+uint32_t import_index(uint32_t nid) {
+    switch (nid) {
+#define VAR_NID(name, nid)
+#define NID(name, nid) \
+    case nid:          \
+        return import_index_##name;
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+    default:
+        return INVALID_IMPORT_INDEX;
+    }
+}
+
+uint32_t import_count() {
+    return import_index_count;
+}
+
+uint32_t import_nid(uint32_t index) {
+    static const uint32_t nids[] = {
+#define VAR_NID(name, nid)
+#define NID(name, nid) nid,
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+    };
+    return index < import_index_count ? nids[index] : 0;
+}
@@ -66,7 +66,16 @@ struct Context {
     int32_t platinum_trophy_id{ SCE_NP_TROPHY_INVALID_TROPHY_ID };
 
     std::string trophy_progress_output_file_path;
-    std::string trophy_detail_xml;
+
+    struct TrophyDetails {
+        std::string name;
+        std::string detail;
+    };
+
+    // parsed once from the detail file of the language, instead of on each query
+    bool trophy_details_loaded{ false };
+    std::array<TrophyDetails, MAX_TROPHIES> trophy_details;
+    TrophyDetails trophy_set_details;
 
     uint32_t lang{ 1 };
 
@@ -84,6 +93,7 @@ struct Context {
     const bool is_trophy_hidden(const uint32_t &trophy_index);
     const bool is_trophy_unlocked(const uint32_t &trophy_index);
     const int total_trophy_unlocked();
+    bool load_trophy_details();
     bool get_trophy_details(const int32_t id, std::string &name, std::string &detail);
     bool get_trophy_set(std::string &name, std::string &detail);
 
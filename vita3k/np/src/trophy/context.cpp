@@ -294,64 +294,68 @@ const int Context::total_trophy_unlocked() {
     return total;
 }
 
-bool Context::get_trophy_details(const int32_t id, std::string &name, std::string &detail) {
-    if (id < 0 || id >= MAX_TROPHIES) {
-        return false;
-    }
-
-    if (trophy_detail_xml.empty()) {
-        const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+bool Context::load_trophy_details() {
+    if (trophy_details_loaded)
+        return true;
 
-        if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
-            if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
-                return false;
-            }
+    std::string detail_xml;
+    const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+    if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), detail_xml)) {
+        if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", detail_xml)) {
+            return false;
         }
     }
 
     // Parse it
     pugi::xml_document doc;
-    const auto result = doc.load_string(trophy_detail_xml.c_str());
+    const auto result = doc.load_string(detail_xml.c_str());
 
     if (!result) {
         return false;
     }
 
-    // Try to find the description for the id
-    for (const auto &trop : doc.child("trophyconf")) {
-        if ((trop.name() == std::string("trophy")) && (trop.attribute("id").as_uint() == id)) {
-            name = trop.child("name").text().as_string();
-            detail = trop.child("detail").text().as_string();
+    std::fill(trophy_details.begin(), trophy_details.end(), TrophyDetails{});
 
-            break;
-        }
-    }
+    const auto trophy_conf = doc.child("trophyconf");
+    trophy_set_details.name = trophy_conf.child("title-name").text().as_string();
+    trophy_set_details.detail = trophy_conf.child("title-detail").text().as_string();
 
-    return !name.empty() && !detail.empty();
-}
+    for (const auto &trop : trophy_conf) {
+        if (trop.name() != std::string("trophy"))
+            continue;
 
-bool Context::get_trophy_set(std::string &name, std::string &detail) {
-    if (trophy_detail_xml.empty()) {
-        const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+        const std::uint32_t id = trop.attribute("id").as_uint();
+        if (id >= MAX_TROPHIES)
+            continue;
 
-        if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
-            if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
-                return false;
-            }
-        }
+        trophy_details[id].name = trop.child("name").text().as_string();
+        trophy_details[id].detail = trop.child("detail").text().as_string();
     }
 
-    // Parse it
-    pugi::xml_document doc;
-    const auto result = doc.load_string(trophy_detail_xml.c_str());
+    trophy_details_loaded = true;
+    return true;
+}
 
-    if (!result) {
+bool Context::get_trophy_details(const int32_t id, std::string &name, std::string &detail) {
+    if (id < 0 || id >= MAX_TROPHIES) {
         return false;
     }
 
-    const auto trophy_conf = doc.child("trophyconf");
-    name = trophy_conf.child("title-name").text().as_string();
-    detail = trophy_conf.child("title-detail").text().as_string();
+    if (!load_trophy_details())
+        return false;
+
+    name = trophy_details[id].name;
+    detail = trophy_details[id].detail;
+
+    return !name.empty() && !detail.empty();
+}
+
+bool Context::get_trophy_set(std::string &name, std::string &detail) {
+    if (!load_trophy_details())
+        return false;
+
+    name = trophy_set_details.name;
+    detail = trophy_set_details.detail;
 
     return !name.empty() && !detail.empty();
 }
@@ -362,6 +366,13 @@ int Context::install_trophy_conf(IOState *io, const std::wstring &pref_path, con
     create_dir(*io, trophy_conf_path.c_str(), 0, pref_path, "create_trophy_context", true);
 
     for (const auto &file : trophy_file.entries) {
+        auto trophy_conf_file = trophy_conf_path + file.filename;
+
+        // the conf is installed again on each context creation, only copy the files missing or changed since
+        SceIoStat stat;
+        if ((stat_file(*io, trophy_conf_file.c_str(), &stat, pref_path, "install_trophy_context") >= 0) && (static_cast<uint64_t>(stat.st_size) == file.size))
+            continue;
+
         std::vector<uint8_t> buf;
         uint32_t size = (uint32_t)file.size;
 
@@ -369,8 +380,7 @@ int Context::install_trophy_conf(IOState *io, const std::wstring &pref_path, con
 
         copy_file_data_from_trophy_file(file.filename.c_str(), &buf[0], &size);
 
-        auto trophy_conf_file = trophy_conf_path + file.filename;
-        const SceUID trophy_conf_id = open_file(*io, trophy_conf_file.c_str(), SCE_O_WRONLY | SCE_O_CREAT, pref_path, "install_trophy_context");
+        const SceUID trophy_conf_id = open_file(*io, trophy_conf_file.c_str(), SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, pref_path, "install_trophy_context");
 
         write_file(trophy_conf_id, buf.data(), size, *io, "install_trophy_context");
 
@@ -446,6 +456,7 @@ np::trophy::ContextHandle create_trophy_context(NpState &np, IOState *io, const
     }
 
     new_context->lang = lang;
+    new_context->trophy_details_loaded = false;
     new_context->trophy_file.header_parse();
 
     new_context->install_trophy_conf(io, pref_path, unique_trophy_folder);
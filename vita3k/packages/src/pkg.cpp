@@ -40,6 +40,14 @@
 #include <util/log.h>
 #include <util/string_utils.h>
 
+#include <openssl/evp.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 // Credits to mmozeiko https://github.com/mmozeiko/pkg2zip
 
 static void ctr_add(uint8_t *counter, uint64_t n) {
@@ -75,6 +83,163 @@ static void aes128_ctr_xor(aes_context *ctx, const uint8_t *iv, uint64_t block,
     }
 }
 
+// size of the pieces of the package files decrypted in parallel, a multiple of the AES block size
+constexpr size_t PKG_CHUNK_SIZE = 1024 * 1024;
+// the reader waits once this many chunks are not written yet
+constexpr size_t PKG_MAX_PENDING_CHUNKS = 32;
+
+struct PkgChunk {
+    // host file written, opened by the writer with the first chunk of the file and closed after the last one
+    std::shared_ptr<const fs::path> path;
+    // offset in the data of the package, it gives the counter of the first AES block
+    uint64_t offset = 0;
+    std::vector<uint8_t> data;
+    bool first = false;
+    bool last = false;
+    bool decrypted = false;
+};
+
+typedef std::shared_ptr<PkgChunk> PkgChunkPtr;
+
+// The data of the package files is read by the installing thread, its chunks are decrypted in parallel
+// at their own counter, which CTR mode allows, and written in order by the writer thread.
+struct PkgPipeline {
+    uint8_t key[16];
+    uint8_t iv[16];
+
+    std::mutex mutex;
+    // notified when a chunk is read, decrypted or written, or when the pipeline stops
+    std::condition_variable cond;
+    // chunks in the order they are written
+    std::deque<PkgChunkPtr> pending;
+    std::deque<PkgChunkPtr> to_decrypt;
+    // set once all the chunks have been read
+    bool reading_done = false;
+    bool failed = false;
+
+    std::vector<std::thread> decryptors;
+    std::thread writer;
+};
+
+// decrypts with the AES instructions of the host when it has them
+static bool aes128_ctr_xor_evp(EVP_CIPHER_CTX *ctx, const uint8_t *key, const uint8_t *iv, uint64_t block, uint8_t *data, size_t size) {
+    uint8_t counter[16];
+    memcpy(counter, iv, sizeof(counter));
+    ctr_add(counter, block);
+
+    // OpenSSL increments the whole 128-bit counter as a big-endian number, like ctr_add
+    int out_size = 0;
+    return EVP_EncryptInit_ex(ctx, EVP_aes_128_ctr(), nullptr, key, counter) == 1
+        && EVP_EncryptUpdate(ctx, data, &out_size, data, static_cast<int>(size)) == 1;
+}
+
+static void run_pkg_decryptor(PkgPipeline &pipeline) {
+    const std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+
+    std::unique_lock<std::mutex> lock(pipeline.mutex);
+    while (true) {
+        pipeline.cond.wait(lock, [&] { return !pipeline.to_decrypt.empty() || pipeline.reading_done || pipeline.failed; });
+        if (pipeline.to_decrypt.empty() || pipeline.failed)
+            return;
+
+        const PkgChunkPtr chunk = std::move(pipeline.to_decrypt.front());
+        pipeline.to_decrypt.pop_front();
+        lock.unlock();
+        const bool decrypted = ctx && aes128_ctr_xor_evp(ctx.get(), pipeline.key, pipeline.iv, chunk->offset / 16, chunk->data.data(), chunk->data.size());
+        lock.lock();
+
+        if (!decrypted) {
+            LOG_ERROR("Could not decrypt {} bytes of {}", chunk->data.size(), chunk->path->string());
+            pipeline.failed = true;
+        }
+        chunk->decrypted = true;
+        pipeline.cond.notify_all();
+    }
+}
+
+static void run_pkg_writer(PkgPipeline &pipeline) {
+    std::ofstream outfile;
+
+    std::unique_lock<std::mutex> lock(pipeline.mutex);
+    while (true) {
+        pipeline.cond.wait(lock, [&] { return (!pipeline.pending.empty() && pipeline.pending.front()->decrypted) || (pipeline.pending.empty() && pipeline.reading_done) || pipeline.failed; });
+        if (pipeline.pending.empty() || pipeline.failed)
+            return;
+
+        const PkgChunkPtr chunk = std::move(pipeline.pending.front());
+        pipeline.pending.pop_front();
+        // the reader waits for room in the queue
+        pipeline.cond.notify_all();
+        lock.unlock();
+
+        if (chunk->first)
+            outfile.open(*chunk->path, std::ios::binary);
+        outfile.write(reinterpret_cast<const char *>(chunk->data.data()), chunk->data.size());
+        const bool written = outfile.good();
+        if (chunk->last)
+            outfile.close();
+
+        lock.lock();
+        if (!written) {
+            LOG_ERROR("Could not write file {}", chunk->path->string());
+            pipeline.failed = true;
+            pipeline.cond.notify_all();
+        }
+    }
+}
+
+static void start_pkg_pipeline(PkgPipeline &pipeline) {
+    const size_t decryptor_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (size_t i = 0; i < decryptor_count; i++)
+        pipeline.decryptors.emplace_back(run_pkg_decryptor, std::ref(pipeline));
+    pipeline.writer = std::thread(run_pkg_writer, std::ref(pipeline));
+}
+
+// returns false if a chunk could not be decrypted or written
+static bool stop_pkg_pipeline(PkgPipeline &pipeline) {
+    {
+        const std::lock_guard<std::mutex> lock(pipeline.mutex);
+        pipeline.reading_done = true;
+        pipeline.cond.notify_all();
+    }
+
+    for (std::thread &decryptor : pipeline.decryptors)
+        decryptor.join();
+    pipeline.writer.join();
+
+    return !pipeline.failed;
+}
+
+// reads the data of a file of the package and queues its chunks, returns false if the pipeline failed
+static bool read_pkg_file(PkgPipeline &pipeline, fs::ifstream &infile, const uint64_t data_offset, const fs::path &path, uint64_t offset, uint64_t size) {
+    const auto shared_path = std::make_shared<const fs::path>(path);
+    bool first = true;
+    do {
+        const PkgChunkPtr chunk = std::make_shared<PkgChunk>();
+        chunk->path = shared_path;
+        chunk->offset = offset;
+        chunk->data.resize(std::min<uint64_t>(size, PKG_CHUNK_SIZE));
+        chunk->first = first;
+        chunk->last = chunk->data.size() == size;
+
+        infile.seekg(data_offset + offset);
+        infile.read(reinterpret_cast<char *>(chunk->data.data()), chunk->data.size());
+        offset += chunk->data.size();
+        size -= chunk->data.size();
+        first = false;
+
+        std::unique_lock<std::mutex> lock(pipeline.mutex);
+        pipeline.cond.wait(lock, [&] { return pipeline.pending.size() < PKG_MAX_PENDING_CHUNKS || pipeline.failed; });
+        if (pipeline.failed)
+            return false;
+        pipeline.pending.push_back(chunk);
+        pipeline.to_decrypt.push_back(chunk);
+        pipeline.cond.notify_all();
+    } while (size != 0);
+
+    return true;
+}
+
 bool decrypt_install_nonpdrm(EmuEnvState &emuenv, std::string &drmlicpath, const std::string &title_path) {
     std::string title_id_src = title_path;
     std::string title_id_dst = title_path + "_dec";
@@ -210,6 +375,10 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
 
     aes_setkey_enc(&aes_ctx, main_key, 128);
 
+    PkgPipeline pipeline;
+    memcpy(pipeline.key, main_key, sizeof(main_key));
+    memcpy(pipeline.iv, pkg_header.pkg_data_iv, sizeof(pipeline.iv));
+
     std::vector<uint8_t> sfo_buffer(sfo_size);
     SfoFile sfo_file;
     infile.seekg(sfo_offset);
@@ -248,6 +417,7 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
         break;
     }
 
+    start_pkg_pipeline(pipeline);
     for (uint32_t i = 0; i < byte_swap(pkg_header.file_count); i++) {
         PkgEntry entry;
         uint64_t file_offset = items_offset + i * 32;
@@ -257,6 +427,7 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
 
         if (fs::file_size(pkg_path) < byte_swap(pkg_header.data_offset) + byte_swap(entry.name_offset) + byte_swap(entry.name_size) || fs::file_size(pkg_path) < byte_swap(pkg_header.data_offset) + byte_swap(entry.data_offset) + byte_swap(entry.data_size)) {
             LOG_ERROR("The pkg file size is too small, possibly corrupted");
+            stop_pkg_pipeline(pipeline);
             return false;
         }
         const auto file_count = (float)byte_swap(pkg_header.file_count);
@@ -271,27 +442,15 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
 
         if ((byte_swap(entry.type) & 0xFF) == 4 || (byte_swap(entry.type) & 0xFF) == 18) { // Directory
             fs::create_directories(path.string() + "/" + string_name);
-        } else { // File
-            std::ofstream outfile(path.string() + "/" + string_name, std::ios::binary);
-
-            auto offset = byte_swap(entry.data_offset);
-            auto data_size = byte_swap(entry.data_size);
-            while (data_size != 0) {
-                unsigned char buffer[0x10000];
-                auto size = data_size < sizeof(buffer) ? data_size : sizeof(buffer);
-                infile.seekg(byte_swap(pkg_header.data_offset) + offset);
-                infile.read((char *)buffer, size);
-
-                aes128_ctr_xor(&aes_ctx, pkg_header.pkg_data_iv, offset / 16, buffer, size);
-
-                outfile.write((char *)buffer, size);
-                offset += size;
-                data_size -= size;
-            }
-            outfile.close();
+        } else if (!read_pkg_file(pipeline, infile, byte_swap(pkg_header.data_offset), path.string() + "/" + string_name, byte_swap(entry.data_offset), byte_swap(entry.data_size))) { // File
+            break;
         }
     }
     infile.close();
+    if (!stop_pkg_pipeline(pipeline)) {
+        LOG_ERROR("Could not extract the files of the pkg");
+        return false;
+    }
 
     std::string title_id_src = path.string();
     std::string title_id_dst = path.string() + "_dec";
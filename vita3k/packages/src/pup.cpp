@@ -31,7 +31,11 @@
 #include <fmt/xchar.h>
 
 #include <algorithm>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 // Credits to TeamMolecule for their original work on this https://github.com/TeamMolecule/sceutils
 
@@ -167,7 +171,50 @@ static void extract_pup_files(const std::wstring &pup, const std::wstring &outpu
     infile.close();
 }
 
-static void decrypt_segments(std::ifstream &infile, const std::wstring &outdir, const std::wstring &filename, KeyStore &SCE_KEYS) {
+// the packages and the SELF files are decrypted with all the host cores
+static size_t get_worker_count() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Runs task(i) for each i below count on a pool of threads.
+// on_done is called on the calling thread after each task, with the number of tasks done.
+static void run_in_parallel(const size_t count, const std::function<void(size_t)> &task, const std::function<void(size_t)> &on_done) {
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next_index = 0;
+    size_t done_count = 0;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(get_worker_count(), count); i++) {
+        workers.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (next_index < count) {
+                const size_t index = next_index++;
+                lock.unlock();
+                task(index);
+                lock.lock();
+                done_count++;
+                cond.notify_one();
+            }
+        });
+    }
+
+    size_t reported_count = 0;
+    while (reported_count < count) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] { return done_count > reported_count; });
+            reported_count = done_count;
+        }
+        on_done(reported_count);
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// each segment used to overwrite the output of the package, so only the last one is kept
+static std::string decrypt_segments(std::ifstream &infile, KeyStore &SCE_KEYS) {
     char sceheaderbuffer[SceHeader::Size];
     infile.read(sceheaderbuffer, SceHeader::Size);
     const SceHeader sce_hdr = SceHeader(sceheaderbuffer);
@@ -175,9 +222,9 @@ static void decrypt_segments(std::ifstream &infile, const std::wstring &outdir,
     const auto sysver = std::get<0>(get_key_type(infile, sce_hdr));
     const SelfType selftype = std::get<1>(get_key_type(infile, sce_hdr));
 
+    std::string output;
     const auto scesegs = get_segments(infile, sce_hdr, SCE_KEYS, sysver, selftype);
     for (const auto &sceseg : scesegs) {
-        fs::ofstream outfile(fmt::format(L"{}/{}.seg02", outdir, filename), std::ios::binary);
         infile.seekg(sceseg.offset);
         std::vector<unsigned char> encrypted_data(sceseg.size);
         infile.read((char *)&encrypted_data[0], sceseg.size);
@@ -185,59 +232,96 @@ static void decrypt_segments(std::ifstream &infile, const std::wstring &outdir,
         aes_setkey_enc(&aes_ctx, (unsigned char *)sceseg.key.c_str(), 128);
         size_t ctr_nc_off = 0;
         unsigned char ctr_stream_block[0x10];
+        unsigned char ctr_iv[0x10];
+        memcpy(ctr_iv, sceseg.iv.c_str(), sizeof(ctr_iv));
         std::vector<unsigned char> decrypted_data(sceseg.size);
-        aes_crypt_ctr(&aes_ctx, sceseg.size, &ctr_nc_off, (unsigned char *)sceseg.iv.c_str(), ctr_stream_block, &encrypted_data[0], &decrypted_data[0]);
-        if (sceseg.compressed) {
-            const std::string decompressed_data = decompress_segments(decrypted_data, sceseg.size);
-            outfile.write(decompressed_data.c_str(), decompressed_data.size());
-        } else {
-            outfile.write((char *)&decrypted_data[0], sceseg.size);
-        }
-        outfile.close();
-    }
-};
-
-static void join_files(const std::wstring &path, const std::string &filename, const std::wstring &output) {
-    std::vector<std::string> files;
-
-    for (auto &p : fs::directory_iterator(path)) {
-        if (p.path().filename().string().substr(0, 4) == filename) {
-            files.push_back(p.path().string());
-        }
+        aes_crypt_ctr(&aes_ctx, sceseg.size, &ctr_nc_off, ctr_iv, ctr_stream_block, &encrypted_data[0], &decrypted_data[0]);
+        if (sceseg.compressed)
+            output = decompress_segments(decrypted_data, sceseg.size);
+        else
+            output.assign((char *)&decrypted_data[0], sceseg.size);
     }
+    return output;
+}
 
-    std::sort(files.begin(), files.end());
+// the packages of these partitions are joined into their image, in the order of their names
+static const char *PARTITION_IMAGES[] = { "os0", "vs0", "sa0" };
 
-    fs::ofstream fileout(output, std::ios::binary);
-    for (const auto &file : files) {
-        fs::ifstream filein(file, std::ios::binary);
-        std::vector<char> buffer(fs::file_size(file));
-        filein.read(&buffer[0], fs::file_size(file));
-        fileout.write(&buffer[0], fs::file_size(file));
-        filein.close();
-        fs::remove(file);
+static const char *get_partition_image(const std::wstring &filename) {
+    for (const char *partition : PARTITION_IMAGES) {
+        if (filename.starts_with(string_utils::utf_to_wide(partition) + L"-"))
+            return partition;
     }
-    fileout.close();
+    return nullptr;
 }
 
-static void decrypt_pup_packages(const std::wstring &src, const std::wstring &dest, KeyStore &SCE_KEYS) {
+// The packages are decrypted in parallel; their data is written in their name order straight
+// to the partition images, or to a .seg02 file for the other packages.
+static void decrypt_pup_packages(const std::wstring &src, const std::wstring &dest, KeyStore &SCE_KEYS, const std::function<void(float)> &progress_callback) {
     std::vector<std::wstring> pkgfiles;
 
     for (const auto &p : fs::directory_iterator(src)) {
         if (p.path().filename().extension().string() == ".pkg")
             pkgfiles.push_back(p.path().filename().generic_wstring());
     }
+    std::sort(pkgfiles.begin(), pkgfiles.end());
+
+    std::map<std::string, fs::ofstream> images;
+    for (const char *partition : PARTITION_IMAGES)
+        images[partition].open(fmt::format(L"{}/{}.img", dest, string_utils::utf_to_wide(partition)), std::ios::binary);
+
+    std::mutex results_mutex;
+    std::vector<std::optional<std::string>> results(pkgfiles.size());
+    size_t written_count = 0;
+
+    run_in_parallel(
+        pkgfiles.size(),
+        [&](const size_t index) {
+            fs::ifstream infile(fmt::format(L"{}/{}", src, pkgfiles[index]), std::ios::binary);
+            std::string data = decrypt_segments(infile, SCE_KEYS);
+            const std::lock_guard<std::mutex> lock(results_mutex);
+            results[index] = std::move(data);
+        },
+        [&](const size_t done_count) {
+            while (written_count < pkgfiles.size()) {
+                std::string data;
+                {
+                    const std::lock_guard<std::mutex> lock(results_mutex);
+                    if (!results[written_count])
+                        break;
+                    data = std::move(*results[written_count]);
+                    results[written_count].reset();
+                }
+
+                const std::wstring &filename = pkgfiles[written_count];
+                if (const char *partition = get_partition_image(filename)) {
+                    images[partition].write(data.data(), data.size());
+                } else {
+                    fs::ofstream outfile(fmt::format(L"{}/{}.seg02", dest, filename), std::ios::binary);
+                    outfile.write(data.data(), data.size());
+                }
+                written_count++;
+            }
+            progress_callback(static_cast<float>(done_count) / pkgfiles.size());
+        });
+}
 
-    for (const auto &filename : pkgfiles) {
-        const std::wstring &filepath = fmt::format(L"{}/{}", src, filename);
-        fs::ifstream infile(filepath, std::ios::binary);
-        decrypt_segments(infile, dest, filename, SCE_KEYS);
-        infile.close();
+// decrypts the SELF files of the partition extracted, on all the host cores
+static void decrypt_partition_selfs(const std::wstring &partition_path, KeyStore &SCE_KEYS, const std::function<void(float)> &progress_callback) {
+    std::vector<fs::path> self_files;
+    for (const auto &file : fs::recursive_directory_iterator(partition_path)) {
+        if (fs::is_regular_file(file.path()) && is_self(file.path()))
+            self_files.push_back(file.path());
     }
 
-    join_files(dest, "os0-", dest + L"/os0.img");
-    join_files(dest, "vs0-", dest + L"/vs0.img");
-    join_files(dest, "sa0-", dest + L"/sa0.img");
+    run_in_parallel(
+        self_files.size(),
+        [&](const size_t index) {
+            decrypt_fself(self_files[index], SCE_KEYS, 0);
+        },
+        [&](const size_t done_count) {
+            progress_callback(static_cast<float>(done_count) / self_files.size());
+        });
 }
 
 void install_pup(const std::wstring &pref_path, const std::string &pup_path, const std::function<void(uint32_t)> &progress_callback) {
@@ -262,30 +346,33 @@ void install_pup(const std::wstring &pref_path, const std::string &pup_path, con
     register_keys(SCE_KEYS, 0);
 
     progress_callback(30);
-    decrypt_pup_packages(pup_dest, pup_dec, SCE_KEYS);
-
-    progress_callback(70);
-    if (fs::file_size(pup_dec + L"/os0.img") > 0) {
-        extract_fat(pup_dec, "os0.img", pref_path);
-        for (const auto &file : fs::recursive_directory_iterator(pref_path + L"/os0")) {
-            if (fs::is_regular_file(file.path())) {
-                if (is_self(file.path())) {
-                    decrypt_fself(file.path(), SCE_KEYS, 0);
-                }
-            }
+    decrypt_pup_packages(pup_dest, pup_dec, SCE_KEYS, [&](const float progress) {
+        progress_callback(30 + static_cast<uint32_t>(progress * 30));
+    });
+
+    // the partitions are separate images, they are extracted at the same time
+    progress_callback(60);
+    std::vector<std::wstring> extracted;
+    std::vector<std::thread> extractions;
+    for (const char *partition : PARTITION_IMAGES) {
+        const std::string image = std::string(partition) + ".img";
+        if (fs::file_size(pup_dec + L"/" + string_utils::utf_to_wide(image)) > 0) {
+            extracted.push_back(string_utils::utf_to_wide(partition));
+            extractions.emplace_back([&pup_dec, &pref_path, image]() { extract_fat(pup_dec, image, pref_path); });
         }
     }
-    if (fs::file_size(pup_dec + L"/sa0.img") > 0)
-        extract_fat(pup_dec, "sa0.img", pref_path);
-    if (fs::file_size(pup_dec + L"/vs0.img") > 0) {
-        extract_fat(pup_dec, "vs0.img", pref_path);
-        for (const auto &file : fs::recursive_directory_iterator(pref_path + L"/vs0")) {
-            if (fs::is_regular_file(file.path())) {
-                if (is_self(file.path())) {
-                    decrypt_fself(file.path(), SCE_KEYS, 0);
-                }
-            }
-        }
+    for (std::thread &extraction : extractions)
+        extraction.join();
+
+    progress_callback(70);
+    for (const std::wstring partition : { L"os0", L"vs0" }) {
+        if (std::find(extracted.begin(), extracted.end(), partition) == extracted.end())
+            continue;
+        const uint32_t progress_start = partition == L"os0" ? 70 : 80;
+        const uint32_t progress_range = partition == L"os0" ? 10 : 20;
+        decrypt_partition_selfs(pref_path + L"/" + partition, SCE_KEYS, [&](const float progress) {
+            progress_callback(progress_start + static_cast<uint32_t>(progress * progress_range));
+        });
     }
     progress_callback(100);
 }
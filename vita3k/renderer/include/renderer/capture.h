@@ -0,0 +1,145 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <gxm/types.h>
+#include <mem/ptr.h>
+#include <renderer/commands.h>
+#include <util/fs.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct MemState;
+
+namespace renderer {
+struct Context;
+struct RenderTarget;
+struct State;
+
+// Capture of the commands processed by the renderer thread during a few frames, along with the guest
+// memory they read, so that vita3k-replay can run them again without the app.
+// The file is made of a header followed by records, each one followed by its data. The guest memory
+// and the programs are recorded before the first command using them, and only again if they changed.
+// The host pointers of the payloads are replaced by ids or by the data they point to, but the other
+// payloads are copied as they are: a capture can only be replayed by the build which recorded it.
+namespace capture {
+
+constexpr uint32_t FORMAT_VERSION = 2;
+
+struct Header {
+    char magic[4];
+    uint32_t format_version;
+    // the payloads are only valid for the same pointer size
+    uint32_t pointer_size;
+    uint32_t reserved;
+    char title_id[16];
+    char self_name[48];
+};
+
+enum class RecordType : uint8_t {
+    // content of guest memory read by the next commands
+    Memory,
+    // guest memory only written by the next commands, it has to exist but its content does not matter
+    Allocation,
+    // a SceGxmFragmentProgram or SceGxmVertexProgram created at the address of the record
+    FragmentProgram,
+    VertexProgram,
+    Command,
+    End
+};
+
+struct Record {
+    RecordType type;
+    CommandOpcode opcode = CommandOpcode::Nop;
+    // for Command records, whether the command was sent with a status to complete
+    uint8_t has_status = 0;
+    uint8_t reserved = 0;
+    // context of the command list, 0 for the commands sent without context
+    uint32_t context_id = 0;
+    // guest address of the memory or of the program object
+    Address address = 0;
+    // size of the guest memory range
+    uint32_t size = 0;
+    // size of the data following the record
+    uint32_t data_size = 0;
+};
+
+struct FragmentProgram {
+    Ptr<const SceGxmProgram> program;
+    uint8_t is_maskupdate;
+    uint8_t has_blend;
+    SceGxmBlendInfo blend;
+};
+
+// followed by the streams then the attributes
+struct VertexProgram {
+    Ptr<const SceGxmProgram> program;
+    uint32_t stream_count;
+    uint32_t attribute_count;
+    uint64_t key_hash;
+};
+
+// state of a context which has to be recreated when the capture starts in the middle of the app
+struct ContextState {
+    // portable payload of the last SetContext command
+    std::vector<uint8_t> set_context;
+    // payload of the last SetState command for each state, see get_state_key
+    std::map<uint64_t, std::vector<uint8_t>> states;
+};
+
+struct Writer {
+    fs::path path;
+    // number of frames (NewFrame commands) to wait before starting, then to capture
+    uint32_t start_frame = 0;
+    uint32_t frame_count = 0;
+
+    // frames processed since the renderer started
+    uint32_t frames_seen = 0;
+    bool done = false;
+    fs::ofstream file;
+
+    // ids of the live contexts and render targets, by address of their unique_ptr then by address of the object
+    uint32_t next_id = 1;
+    std::unordered_map<const void *, uint32_t> slot_ids;
+    std::unordered_map<const void *, uint32_t> object_ids;
+    std::map<uint32_t, ContextState> contexts;
+    std::map<uint32_t, SceGxmRenderTargetParams> render_targets;
+    // size and attributes of the mapped blocks
+    std::map<Address, std::pair<uint32_t, uint32_t>> memory_maps;
+
+    // what was last written for each guest address, to only write it again if it changed
+    std::unordered_map<Address, std::pair<uint32_t, uint64_t>> memory_hashes;
+    std::unordered_map<Address, const void *> programs;
+};
+
+// the capture starts once start_frame frames have been processed
+void init(State &state, const fs::path &path, uint32_t start_frame, uint32_t frame_count);
+// called by the renderer thread for every command, before and after its handler
+void record_command(Writer &writer, State &state, MemState &mem, const Command &cmd, Context *context);
+void command_done(Writer &writer, const Command &cmd);
+
+bool read_header(fs::ifstream &file, Header &header);
+// return false at the end of the file, data holds the record data
+bool read_record(fs::ifstream &file, Record &record, std::vector<uint8_t> &data);
+
+} // namespace capture
+} // namespace renderer
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <vector>
@@ -30,7 +31,8 @@ namespace renderer {
 
 struct Command;
 
-using CommandAllocFunc = std::function<Command *()>;
+// allocate a command with room for at least data_size bytes of payload, return nullptr if it can't
+using CommandAllocFunc = std::function<Command *(std::size_t data_size)>;
 using CommandFreeFunc = std::function<void(Command *)>;
 
 struct Context;
@@ -49,6 +51,12 @@ enum class CommandOpcode : std::uint8_t {
      */
     Draw,
 
+    /**
+     * Set the programs, uniform buffers, textures and vertex streams of a precomputed draw, then do it.
+     * The states are stored with the payload of their SetState command.
+     */
+    DrawPrecomputed,
+
     /**
      * Transfer functions
      */
@@ -84,7 +92,10 @@ enum class CommandOpcode : std::uint8_t {
     NewFrame,
 
     DestroyRenderTarget,
-    DestroyContext
+    DestroyContext,
+
+    // Not a command, number of opcodes. Must stay last.
+    Count
 };
 
 enum CommandErrorCode {
@@ -93,8 +104,12 @@ enum CommandErrorCode {
     CommandErrorArgumentsTooLarge = -2
 };
 
+// payload size of the commands which are not allocated linearly
 constexpr std::size_t MAX_COMMAND_DATA_SIZE = 0x20;
 
+// Commands allocated in a linear buffer (the ones of the gxm contexts) are packed: the payload
+// has the exact size of the arguments, which can be smaller or bigger than MAX_COMMAND_DATA_SIZE
+// and the next command starts right after it.
 struct Command {
     enum {
         FLAG_FROM_HOST = 1 << 0,
@@ -103,13 +118,28 @@ struct Command {
 
     CommandOpcode opcode;
     std::uint8_t flags = 0;
+    // size of the payload
+    std::uint16_t size = MAX_COMMAND_DATA_SIZE;
+    // size taken by this command in the allocator it comes from
+    std::uint32_t alloc_size = 0;
 
-    std::uint8_t data[MAX_COMMAND_DATA_SIZE];
     int *status;
 
     Command *next = nullptr;
+
+    // must stay last, the payload continues after the end of the struct for big commands
+    std::uint8_t data[MAX_COMMAND_DATA_SIZE];
 };
 
+constexpr std::size_t COMMAND_HEADER_SIZE = offsetof(Command, data);
+// commands are aligned on 8 bytes so that the pointers in their header are aligned
+constexpr std::size_t COMMAND_ALIGNMENT = alignof(Command);
+
+// size needed to store a command with the given payload size
+constexpr std::size_t get_command_alloc_size(const std::size_t data_size) {
+    return (COMMAND_HEADER_SIZE + data_size + COMMAND_ALIGNMENT - 1) & ~(COMMAND_ALIGNMENT - 1);
+}
+
 using CommandPool = std::vector<Command>;
 
 // It's to split a command list easier when ExecuteCommandList is used.
@@ -131,7 +161,7 @@ struct CommandHelper {
 
     template <typename T>
     bool push(T &val) {
-        if (point + sizeof(T) > MAX_COMMAND_DATA_SIZE) {
+        if (point + sizeof(T) > cmd->size) {
             return false;
         }
 
@@ -143,7 +173,7 @@ struct CommandHelper {
 
     template <typename T>
     T pop() {
-        if (point + sizeof(T) > MAX_COMMAND_DATA_SIZE) {
+        if (point + sizeof(T) > cmd->size) {
             // Shouldn't happen
             assert(false);
         }
@@ -174,7 +204,10 @@ bool do_command_push_data(CommandHelper &helper, Head arg1, Args... args2) {
 
 template <typename... Args>
 Command *make_command(CommandAllocFunc alloc_func, CommandFreeFunc free_func, const CommandOpcode opcode, int *status, Args... arguments) {
-    Command *new_command = alloc_func();
+    constexpr std::size_t data_size = (sizeof(Args) + ... + 0);
+    Command *new_command = alloc_func(data_size);
+    if (!new_command)
+        return nullptr;
 
     new_command->opcode = opcode;
     new_command->status = status;
@@ -46,6 +46,9 @@ COMMAND_SET_STATE(polygon_mode);
 COMMAND_SET_STATE(point_line_width);
 COMMAND_SET_STATE(stencil_func);
 COMMAND_SET_STATE(fragment_texture);
+COMMAND_SET_STATE(texture);
+COMMAND_SET_STATE(uniform_buffer);
+COMMAND_SET_STATE(vertex_stream);
 
 // State set
 COMMAND(handle_set_state);
@@ -64,6 +67,7 @@ COMMAND(handle_sync_surface_data);
 COMMAND(handle_mid_scene_flush);
 
 COMMAND(handle_draw);
+COMMAND(handle_draw_precomputed);
 
 COMMAND(handle_transfer_copy);
 COMMAND(handle_transfer_downscale);
@@ -0,0 +1,41 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace renderer {
+
+// a presented frame handed to the gameplay recorder, the data is only valid during the call of the callback
+struct RecordedFrame {
+    // the luma plane followed by the interleaved chroma plane, both with the same pitch, when true, RGBA otherwise
+    bool nv12;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    const uint8_t *data;
+    // host time at which the frame was presented, from the steady clock
+    uint64_t timestamp_ns;
+};
+
+// called on the thread swapping the window
+using RecordFrameCallback = std::function<void(const RecordedFrame &frame)>;
+
+} // namespace renderer
@@ -0,0 +1,80 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#pragma once
+
+#include <mem/ptr.h>
+
+#include <array>
+#include <cstdint>
+
+namespace renderer {
+
+// Drop the presentation of some frames while the host takes longer to render them than the guest gives it,
+// so that the game logic and the audio keep running at full speed on a slow host.
+// The draws to the surfaces displayed are dropped along, the other surfaces can be read by the next frames so
+// they are always rendered. Only used by the renderer thread.
+class FrameSkip {
+public:
+    void init(bool enabled, int max_consecutive);
+    // the frame being rendered is not presented
+    bool is_skipping() const {
+        return skipping;
+    }
+
+    // called once the frame was presented or skipped with the host time spent on it, the vblank count and the surface
+    // the guest displays, decide if the next frame is skipped
+    void end_frame(uint64_t frame_ns, uint64_t vblank_count, Address displayed_surface);
+
+    // the draws of a skipped frame are dropped when they only write a surface which is displayed
+    bool is_draw_skipped(Address color_surface) const {
+        return skipping && !displayed_surface_sampled && is_displayed_surface(color_surface);
+    }
+    // a game sampling the surfaces it displays needs all their draws
+    void texture_used(Address texture) {
+        if (enabled && !displayed_surface_sampled && is_displayed_surface(texture))
+            displayed_surface_sampled = true;
+    }
+
+private:
+    bool enabled = false;
+    uint32_t max_consecutive = 2;
+    bool skipping = false;
+    uint32_t consecutive = 0;
+
+    // moving average of the host time spent on the presented frames, in milliseconds
+    float average_frame_time = 0.f;
+    // least vblanks between two frames over the last window, the time the guest gives for a frame when it runs at full speed
+    uint32_t vblanks_per_frame = 1;
+    uint32_t window_min_vblanks = UINT32_MAX;
+    uint32_t window_frames = 0;
+    uint64_t last_vblank_count = 0;
+
+    // the guest usually rotates between 2 or 3 display buffers
+    std::array<Address, 4> displayed_surfaces = {};
+    uint32_t next_displayed_surface = 0;
+    bool displayed_surface_sampled = false;
+
+    bool is_displayed_surface(Address address) const {
+        for (const Address displayed : displayed_surfaces) {
+            if (displayed != 0 && displayed == address)
+                return true;
+        }
+        return false;
+    }
+};
+
+} // namespace renderer
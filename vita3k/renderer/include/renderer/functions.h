@@ -20,6 +20,9 @@
 #include <renderer/commands.h>
 #include <renderer/types.h>
 
+#include <array>
+#include <span>
+
 struct MemState;
 struct FeatureState;
 struct Config;
@@ -32,30 +35,28 @@ struct State;
 struct VertexProgram;
 
 bool create(std::unique_ptr<FragmentProgram> &fp, State &state, const SceGxmProgram &program, const SceGxmBlendInfo *blend, GXPPtrMap &gxp_ptr_map, const char *cache_path, const char *title_id);
-bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgram &program, GXPPtrMap &gxp_ptr_map, const char *cache_path, const char *title_id);
+bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgram &program, const std::vector<SceGxmVertexAttribute> &attributes, GXPPtrMap &gxp_ptr_map, const char *cache_path, const char *title_id);
 void create(SceGxmSyncObject *sync, State &state);
 void destroy(SceGxmSyncObject *sync, State &state);
 void finish(State &state, Context *context);
 
 /**
  * \brief Wait for all subjects to be done with the given sync object.
- *
- * Return true if the wait didn't timeout
  */
-bool wishlist(SceGxmSyncObject *sync_object, const uint32_t timestamp, const int32_t timeout_micros = -1);
+void wishlist(SceGxmSyncObject *sync_object, const uint32_t timestamp);
 
 /**
  * \brief Set list of subject with sync object to done.
  *
  * This will also signals wishlists that are waiting.
  */
-void subject_done(SceGxmSyncObject *sync_object, const uint32_t timestamp);
+void subject_done(State &state, SceGxmSyncObject *sync_object, const uint32_t timestamp);
 
 int wait_for_status(State &state, int *status, int signal, bool wake_on_equal);
 void reset_command_list(CommandList &command_list);
 void submit_command_list(State &state, renderer::Context *context, CommandList &command_list);
 bool is_cmd_ready(MemState &mem, CommandList &command_list);
-void process_batch(State &state, MemState &mem, Config &config, CommandList &command_list);
+void process_batch(State &state, const FeatureState &features, MemState &mem, Config &config, CommandList &command_list);
 void process_batches(State &state, const FeatureState &features, MemState &mem, Config &config);
 bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, const Config &config, const Root &root_paths);
 
@@ -80,7 +81,41 @@ void set_visibility_index(State &state, Context *ctx, bool enable, uint32_t inde
 
 void set_context(State &state, Context *ctx, RenderTarget *target, SceGxmColorSurface *color_surface, SceGxmDepthStencilSurface *depth_stencil_surface);
 void set_vertex_stream(State &state, Context *ctx, const std::size_t index, const std::size_t data_len, const Ptr<const void> stream);
+
+struct PrecomputedUniformBuffer {
+    bool is_vertex;
+    int block_num;
+    std::uint16_t size;
+    Ptr<const void> buffer;
+};
+
+struct PrecomputedTexture {
+    std::uint32_t index;
+    SceGxmTexture texture;
+};
+
+struct PrecomputedVertexStream {
+    std::size_t index;
+    std::size_t data_len;
+    Ptr<const void> stream;
+};
+
+// everything set by a precomputed draw, sent to the renderer as a single command
+struct PrecomputedDraw {
+    Ptr<const void> vertex_program;
+    Ptr<const void> fragment_program;
+    std::span<const PrecomputedUniformBuffer> uniform_buffers;
+    std::span<const PrecomputedTexture> textures;
+    std::span<const PrecomputedVertexStream> vertex_streams;
+    SceGxmPrimitiveType prim_type;
+    SceGxmIndexFormat index_type;
+    Ptr<const void> index_data;
+    std::uint32_t index_count;
+    std::uint32_t instance_count;
+};
+
 void draw(State &state, Context *ctx, SceGxmPrimitiveType prim_type, SceGxmIndexFormat index_type, Ptr<const void> index_data, const std::uint32_t index_count, const std::uint32_t instance_count);
+void draw_precomputed(State &state, Context *ctx, const PrecomputedDraw &draw);
 void transfer_copy(State &state, uint32_t colorKeyValue, uint32_t colorKeyMask, SceGxmTransferColorKeyMode colorKeyMode, const SceGxmTransferImage *images, SceGxmTransferType srcType, SceGxmTransferType destType);
 void transfer_downscale(State &state, const SceGxmTransferImage *src, const SceGxmTransferImage *dest);
 void transfer_fill(State &state, uint32_t fillColor, const SceGxmTransferImage *dest);
@@ -91,8 +126,22 @@ void destroy_context(State &state, std::unique_ptr<Context> &context);
 bool create_render_target(State &state, std::unique_ptr<RenderTarget> &rt, const SceGxmRenderTargetParams *params);
 void destroy_render_target(State &state, std::unique_ptr<RenderTarget> &rt);
 
-Command *generic_command_allocate();
+// allocate a command not stored in the guest memory, can be called from any thread
+// the payload of these commands is at most MAX_COMMAND_DATA_SIZE bytes
+Command *generic_command_allocate(size_t data_size);
 void generic_command_free(Command *cmd);
+// highest number of commands allocated with generic_command_allocate alive at the same time
+size_t get_peak_commands_in_flight();
+
+inline void append_command(CommandList &command_list, Command *cmd) {
+    if (!command_list.first) {
+        command_list.first = cmd;
+        command_list.last = cmd;
+    } else {
+        command_list.last->next = cmd;
+        command_list.last = cmd;
+    }
+}
 
 template <typename... Args>
 bool add_command(Context *ctx, const CommandOpcode opcode, int *status, Args... arguments) {
@@ -105,14 +154,7 @@ bool add_command(Context *ctx, const CommandOpcode opcode, int *status, Args...
         return false;
     }
 
-    if (!ctx->command_list.first) {
-        ctx->command_list.first = cmd_maked;
-        ctx->command_list.last = cmd_maked;
-    } else {
-        ctx->command_list.last->next = cmd_maked;
-        ctx->command_list.last = cmd_maked;
-    }
-
+    append_command(ctx->command_list, cmd_maked);
     return true;
 }
 
@@ -151,6 +193,8 @@ namespace texture {
 // Paletted textures.
 void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *palette);
 void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *palette);
+// store each 4-bit index in its own byte
+void palette_indices_4_to_8(uint8_t *dst, const uint8_t *src, uint32_t width, uint32_t height);
 void yuv420P3_texture_to_rgb(uint8_t *dst, const uint8_t *src, uint32_t width, uint32_t height, uint32_t layout_width, uint32_t layout_height);
 const uint32_t *get_texture_palette(const SceGxmTexture &texture, const MemState &mem);
 
@@ -227,6 +271,12 @@ void convert_x8u24_to_u24x8(void *dest, const void *data, const uint32_t width,
 void convert_f32m_to_f32(void *dest, const void *data, const uint32_t width, const uint32_t height);
 void convert_u2f10f10f10_to_f16f16f16f16(void *dest, const void *data, const uint32_t width, const uint32_t height, const SceGxmTextureFormat format);
 
+// Reorder the bytes of each 16 bytes chunk of the pixels: byte i of a chunk is replaced with its byte mask[i]
+void shuffle_pixel_bytes(void *pixels, size_t size, const std::array<uint8_t, 16> &mask);
+// Mask for shuffle_pixel_bytes where component i of each pixel is read from its component components[i]
+// The pixel size (component_count * component_size) must divide 16
+std::array<uint8_t, 16> get_component_shuffle_mask(const std::array<uint8_t, 4> &components, uint32_t component_count, uint32_t component_size);
+
 void swizzled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel);
 void tiled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel);
 
@@ -32,6 +32,8 @@ public:
 
     void insert();
     bool wait_for_signal();
+    // true once the GPU has reached the fence, does not wait for it
+    bool is_signaled();
 
     bool empty() const {
         return !sync_;
@@ -38,6 +38,9 @@ namespace renderer::gl {
 // Compile program.
 SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmRecordState &state, const FeatureState &features, const MemState &mem, bool shader_cache, bool spirv, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name);
 void pre_compile_program(GLState &renderer, const char *cache_path, const char *title_id, const char *self_name, const ShadersHash &hashs);
+// only when the driver compiles in parallel, submit all the programs then poll them until they are all linked
+bool start_parallel_pre_compile(GLState &renderer);
+bool is_parallel_pre_compile_done(GLState &renderer);
 
 // Uniforms.
 bool set_uniform_buffer(GLContext &context, const ShaderProgram *program, const bool vertex_shader, const int block_num, const int size, const uint8_t *data);
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <glutil/object_array.h>
 #include <renderer/gl/fence.h>
@@ -26,28 +27,38 @@ namespace renderer::gl {
 
 struct RingBuffer {
 private:
+    // the buffer is split in segments, a segment can only be written again once the GPU is done with its previous content
+    static constexpr std::size_t SEGMENT_COUNT = 8;
+
     GLObjectArray<1> buffer_;
-    Fence safe_segment_consumed_fence_;
+    // signaled when the draws using the content of each segment are done
+    std::array<Fence, SEGMENT_COUNT> segment_fences_;
+    // bitmask of the segments left by the cursor whose fence must be inserted after the next draw
+    std::uint32_t segments_to_fence_;
 
     std::uint8_t *base_;
     std::size_t cursor_;
     std::size_t capacity_;
+    std::size_t segment_size_;
+    // segment containing the last allocated byte
+    std::size_t current_segment_;
 
     GLenum purpose_;
 
     void create_and_map();
+    void enter_segment(const std::size_t segment);
 
 public:
     explicit RingBuffer(GLenum purpose, const std::size_t capacity);
     ~RingBuffer();
 
     // Allocate new data from ring buffer, return offset of the data resided in the buffer
-    // In case the data is full, it will wait for fence to notify previous draw commands has finished on previous buffer part
-    // and then reset the cursor
+    // The data is written by the CPU into the persistently mapped buffer, no copy is done by the driver
+    // If the allocation reaches a segment still being used by the GPU, it waits for the segment fence first
     std::pair<std::uint8_t *, std::size_t> allocate(const std::size_t data_size);
 
-    // Notify the buffer that a draw call is done. This inserts a fence depends on the amount of data that has been consumed
-    // previously by push
+    // Notify the buffer that a draw call is done. This inserts the fences of the segments
+    // which were entirely allocated before this draw
     void draw_call_done();
 
     GLint handle() const {
@@ -19,6 +19,7 @@
 
 #include <renderer/gl/screen_render.h>
 #include <renderer/gl/surface_cache.h>
+#include <renderer/gl/surface_readback.h>
 #include <renderer/state.h>
 #include <renderer/types.h>
 
@@ -43,6 +44,12 @@ struct GLState : public renderer::State {
     GLSurfaceCache surface_cache;
 
     ScreenRenderer screen_renderer;
+    SurfaceReadback surface_readback;
+
+    // identifies the driver the program binaries come from, empty if they cannot be retrieved
+    std::string program_binary_driver;
+    bool support_parallel_shader_compile = false;
+    std::vector<PendingProgram> pending_programs;
 
     bool init(const char *shared_path, const bool hashless_texture_cache) override;
     void late_init(const Config &cfg, const std::string_view game_id) override;
@@ -56,6 +63,8 @@ struct GLState : public renderer::State {
     void set_texture_state(bool import_textures, bool export_textures, bool export_as_png) override;
 
     void precompile_shader(const ShadersHash &hash) override;
+    bool start_parallel_precompile() override;
+    bool is_parallel_precompile_done() override;
     void preclose_action() override;
 };
 
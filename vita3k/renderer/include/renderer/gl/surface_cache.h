@@ -80,7 +80,7 @@ class GLSurfaceCache : public SurfaceCache {
 private:
     static constexpr std::uint32_t MAX_CACHE_SIZE_PER_CONTAINER = 20;
 
-    std::map<std::uint64_t, std::unique_ptr<GLColorSurfaceCacheInfo>, std::greater<std::uint64_t>> color_surface_textures;
+    SurfaceRangeIndex<std::unique_ptr<GLColorSurfaceCacheInfo>> color_surface_textures;
     std::array<GLDepthStencilSurfaceCacheInfo, MAX_CACHE_SIZE_PER_CONTAINER> depth_stencil_textures;
     std::unordered_map<std::uint64_t, GLObjectArray<1>> framebuffer_array;
 
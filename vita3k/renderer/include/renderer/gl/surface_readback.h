@@ -0,0 +1,63 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <glutil/object_array.h>
+#include <mem/ptr.h>
+#include <renderer/gl/fence.h>
+
+#include <array>
+#include <cstdint>
+
+struct SceGxmColorSurface;
+
+namespace renderer {
+struct SurfaceCapture;
+}
+
+namespace renderer::gl {
+
+// Reads the captured color surfaces into pixel buffers without waiting for the GPU, used by the color surface
+// capture when the surfaces are not synced with the guest memory. A readback is handed to the capture once its
+// fence is signaled, a surface is dropped if all the slots are still used by the GPU.
+struct SurfaceReadback {
+    static constexpr size_t SLOT_COUNT = 4;
+
+    struct Slot {
+        GLObjectArray<1> buffer;
+        size_t capacity = 0;
+        Fence fence;
+        bool pending = false;
+
+        Address address = 0;
+        uint32_t frame = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    std::array<Slot, SLOT_COUNT> slots;
+    size_t next_slot = 0;
+};
+
+// read the pixels of the framebuffer currently bound, which renders to the surface
+void queue_surface_readback(SurfaceReadback &readback, SurfaceCapture &capture, const SceGxmColorSurface &surface, int res_multiplier);
+// hand the readbacks done by the GPU to the capture
+void poll_surface_readbacks(SurfaceReadback &readback, SurfaceCapture &capture);
+
+} // namespace renderer::gl
@@ -53,11 +53,50 @@ typedef std::map<ProgramHashes, SharedGLObject> ProgramCache;
 typedef std::vector<ExcludedUniform> ExcludedUniforms; // vector instead of unordered_set since it's much faster for few elements
 typedef std::map<GLuint, GLenum> UniformTypes;
 
+// program linked by the driver threads, only usable once its completion status is set
+struct PendingProgram {
+    ProgramHashes hashes;
+    SharedGLObject program;
+    SharedGLObject frag_shader;
+    SharedGLObject vert_shader;
+};
+
+// copy from the upload ring recorded while a decode worker writes the pixels
+struct GLPendingUpload {
+    GLuint texture;
+    GLenum bind_type;
+    GLenum upload_type;
+    SceGxmTextureBaseFormat base_format;
+    uint32_t mip_index;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixels_per_stride;
+    size_t offset;
+    size_t size;
+    // set if the pixels did not fit in the upload ring, they are then uploaded from this copy
+    std::shared_ptr<std::vector<uint8_t>> client_data;
+};
+
 class GLTextureCache : public TextureCache {
+private:
+    // persistently mapped pixel unpack buffer the textures are uploaded from, the driver does not have to copy them
+    std::unique_ptr<RingBuffer> upload_ring;
+    std::vector<GLPendingUpload> pending_uploads;
+    // allocated from the upload ring since the last flush
+    size_t upload_ring_used = 0;
+    // the pending copies are issued on this unit to keep the textures bound for the draw
+    GLenum upload_texture_unit = GL_TEXTURE0;
+
+    void copy_texture(const GLPendingUpload &upload, const void *pixels);
+
 public:
     GLObjectArray<TextureCacheSize> textures;
 
+    ~GLTextureCache() override;
+
     bool init(const bool hashless_texture_cache, const fs::path &texture_folder, const std::string_view game_id);
+    // issue the copies of the textures written by the decode workers, must be called before drawing
+    void flush_uploads();
     void select(size_t index, const SceGxmTexture &texture) override;
     void configure_texture(const SceGxmTexture &texture) override;
     void upload_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride) override;
@@ -25,7 +25,8 @@
 
 #include <gxm/types.h>
 
-#include <condition_variable>
+#include <array>
+#include <atomic>
 #include <memory>
 #include <mutex>
 
@@ -167,6 +168,7 @@ enum class SceGxmLastReserveStatus {
 
 struct SceGxmSyncObject {
     // timestamp_current is the timestamp for what has already been processed by the renderer
+    // it only increases, the waiters sleep directly on it
     std::atomic<uint32_t> timestamp_current;
     // timestamp_ahead is the timestamp for everything that has been asked to SceGxm so far (timestamp_ahead >= timestamp_current)
     std::atomic<uint32_t> timestamp_ahead;
@@ -174,8 +176,6 @@ struct SceGxmSyncObject {
     // timestamp for the last time the object was displayed
     std::uint32_t last_display;
 
-    std::mutex lock;
-    std::condition_variable cond;
     // some extra space for additional data, on the Vulkan renderer this points to a RenderTarget* a,d a vector of fences
     void *extra;
 };
@@ -328,6 +328,12 @@ struct SceGxmVertexProgram {
     std::vector<SceGxmVertexAttribute> attributes;
     std::unique_ptr<renderer::VertexProgram> renderer_data;
     uint64_t key_hash;
+
+    // baked from the attributes when the program is created, gives the size of the streams read by a draw
+    // bit i is set if the stream i is read by an attribute
+    uint16_t stream_used = 0;
+    // bytes read in the element of each stream, the end of its last attribute
+    std::array<uint32_t, SCE_GXM_MAX_VERTEX_STREAMS> stream_element_size{};
 };
 
 struct SceGxmPrecomputedDraw {
@@ -0,0 +1,71 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <crypto/hash.h>
+#include <shader/usse_program_analyzer.h>
+#include <util/fs.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+struct SceGxmProgram;
+
+namespace renderer {
+
+// What is computed from a gxp program each time a patched program is created from it.
+struct ProgramInfo {
+    Sha256Hash hash;
+    UniformBufferSizes uniform_buffer_sizes;
+    int buffer_count;
+    uint32_t textures_used;
+    // only filled for the vertex programs
+    shader::usse::AttributeInformationMap attribute_infos;
+};
+
+// The shader patcher creates many variants of the same gxp programs (one per blending or vertex layout),
+// and the same ones every time a game boots. Their info is kept for the whole run and stored next to the
+// shaders cache, so that the next boot does not have to hash and analyze the programs again.
+class ProgramInfoCache {
+public:
+    static constexpr const char *file_name = "programs.dat";
+
+    // load the infos saved in this folder, the new ones will be saved there
+    void open(const fs::path &shaders_path);
+    // write the file if infos were added since it was read, called along the shaders cache
+    void save();
+
+    // get the info of the program, computed if it is not in the cache yet
+    // can be called from multiple threads at the same time
+    ProgramInfo get(const SceGxmProgram &program, bool is_vertex);
+
+private:
+    struct Entry {
+        uint32_t program_size;
+        ProgramInfo info;
+    };
+
+    std::mutex mutex;
+    // the key is the xxh3 of the program
+    std::unordered_map<uint64_t, Entry> entries;
+    fs::path path;
+    bool dirty = false;
+};
+
+} // namespace renderer
@@ -0,0 +1,94 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+#include <util/mapped_file.h>
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace renderer {
+
+// All the cached shaders of a game stored in a single file, so that booting a game
+// with thousands of shaders does not need thousands of open/read/close calls.
+// The file is made of a header, the index sorted by key, then the shader blobs.
+// Shaders generated during a run are still written as loose files next to the pack,
+// they are appended to it the next time it is opened.
+// A pack can also be shared read-only by several instances, each one keeping its own pack as an
+// overlay for the shaders it generates, which are merged into the shared pack on request.
+class ShaderPack {
+public:
+    static constexpr const char *file_name = "shaders.pack";
+
+    struct Header {
+        char magic[4];
+        uint32_t format_version;
+        uint32_t entry_count;
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        // xxh3 of the name the loose file had ("<version>-<hash>.<extension>")
+        uint64_t key;
+        // shader::CURRENT_VERSION when the shader was generated
+        uint32_t shader_version;
+        uint32_t size;
+        // from the start of the blobs
+        uint64_t offset;
+    };
+
+    // append the loose shader files of this folder to the pack, remove the entries from other
+    // shader versions, then map it
+    void open(const fs::path &shaders_path);
+    // only map the pack of this folder, it is never written
+    void open_shared(const fs::path &shaders_path);
+    void close();
+
+    // return the shader content or an empty span if it is not in the pack nor in the shared one
+    // can be called from multiple threads at the same time
+    std::span<const uint8_t> find(std::string_view hash_text, std::string_view extension) const;
+
+    // add the shaders of the overlay pack and of its loose files missing from the shared pack, the shared pack is replaced
+    // at once so that the instances using it keep their mapping of the old one, returns the number of shaders added
+    // if the host does not allow replacing a mapped file, the merge fails while an instance uses the shared pack
+    // the caller must hold the lock of the shared folder
+    static size_t merge(const fs::path &overlay_path, const fs::path &shared_path);
+
+    // looked up when a shader is not in this pack
+    const ShaderPack *shared = nullptr;
+
+private:
+    MappedFile file;
+    const Entry *entries = nullptr;
+    uint32_t entry_count = 0;
+    const uint8_t *blobs = nullptr;
+    size_t blobs_size = 0;
+
+    bool map(const fs::path &pack_path);
+    std::span<const uint8_t> find_key(uint64_t key) const;
+};
+
+// the shared cache is split by backend and GPU features as the shaders generated depend on them
+fs::path get_shared_shaders_path(const fs::path &shared_cache_path, const char *title_id, const char *self_name, const char *backend, uint32_t features_mask);
+
+// write the file next to its destination then rename it over, a reader or another writer never sees a partial file
+bool publish_cache_file(const fs::path &path, const void *data, size_t size);
+
+} // namespace renderer
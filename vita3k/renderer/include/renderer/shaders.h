@@ -32,13 +32,16 @@ struct SceGxmVertexAttribute;
 namespace renderer {
 
 struct ShadersHash;
+class ShaderPack;
 struct State;
 
 // Shaders.
 bool get_shaders_cache_hashs(State &renderer);
 void save_shaders_cache_hashs(State &renderer, std::vector<ShadersHash> &shaders_cache_hashs);
-std::string load_glsl_shader(const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache);
-std::vector<uint32_t> load_spirv_shader(const SceGxmProgram &program, const FeatureState &features, bool is_vulkan, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache);
-std::string pre_load_shader_glsl(const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name);
-std::vector<uint32_t> pre_load_shader_spirv(const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name);
+std::string load_glsl_shader(const ShaderPack &pack, const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache);
+std::vector<uint32_t> load_spirv_shader(const ShaderPack &pack, const SceGxmProgram &program, const FeatureState &features, bool is_vulkan, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache);
+std::string pre_load_shader_glsl(const ShaderPack &pack, const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name);
+std::vector<uint32_t> pre_load_shader_spirv(const ShaderPack &pack, const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name);
+// merge the shaders and pipeline caches of this instance into the shared cache, returns the number of shaders added
+size_t merge_shader_cache(const char *cache_path, const char *shared_cache_path);
 } // namespace renderer
\ No newline at end of file
@@ -18,13 +18,24 @@
 #pragma once
 
 #include <features/state.h>
+#include <renderer/capture.h>
 #include <renderer/commands.h>
+#include <renderer/frame_recording.h>
+#include <renderer/frame_skip.h>
+#include <renderer/program_info_cache.h>
+#include <renderer/shader_pack.h>
+#include <renderer/surface_capture.h>
 #include <renderer/types.h>
-#include <threads/queue.h>
+#include <renderer/video_frames.h>
+#include <threads/event_count.h>
+#include <threads/ring_queue.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <string_view>
+#include <vector>
 
 struct SDL_Cursor;
 struct SDL_Window;
@@ -42,8 +53,21 @@ enum struct Filter : int {
     FSR = 1 << 4
 };
 
+// GPU time spent on a scene, tagged with the color surface it rendered to
+struct GpuSceneTime {
+    // 0 if the scene has no color surface
+    Address color_address;
+    uint32_t width;
+    uint32_t height;
+    // in milliseconds, the render passes exclude the copies and barriers of the scene
+    float time;
+    float render_pass_time;
+};
+
 struct State {
     std::string cache_path;
+    // read-only shader cache shared by several instances, empty if there is none
+    std::string shared_cache_path;
     std::string log_path;
     std::string shared_path;
     const char *title_id;
@@ -52,13 +76,19 @@ struct State {
     Backend current_backend;
     FeatureState features;
     int res_multiplier;
+    // resolution multiplier chosen by the user, res_multiplier can be lowered below it by the dynamic resolution
+    int max_res_multiplier;
     bool disable_surface_sync;
     bool stretch_the_display_area;
 
     Context *context;
 
     GXPPtrMap gxp_ptr_map;
-    Queue<CommandList> command_buffer_queue;
+    // command lists can be submitted by any guest thread, only the renderer thread processes them
+    RingQueue<CommandList, 32, true> command_buffer_queue;
+    // the renderer thread sleeps on it when it has nothing to do, notified when a command list is submitted,
+    // a sync object is signaled or a frame has to be displayed
+    EventCount wake_up;
     std::condition_variable command_finish_one;
     std::mutex command_finish_one_mutex;
 
@@ -67,22 +97,85 @@ struct State {
 
     std::vector<ShadersHash> shaders_cache_hashs;
     std::string shader_version;
+    // opened along the shaders cache hashs, shaders are looked up there before the loose files
+    ShaderPack shader_pack;
+    // looked up after the shader pack, never written
+    ShaderPack shared_shader_pack;
+    // opened along the shaders cache hashs, saved along them
+    ProgramInfoCache program_info_cache;
 
     int last_scene_id = 0;
 
     uint32_t shaders_count_compiled = 0;
-    uint32_t programs_count_pre_compiled = 0;
-
-    bool should_display;
+    // can be increased by multiple threads when precompiling in parallel
+    std::atomic<uint32_t> programs_count_pre_compiled = 0;
+    // pipelines created since the start, 0 if the backend does not use pipelines
+    std::atomic<uint32_t> pipelines_count_compiled = 0;
+
+    // GPU memory used by the texture cache, in bytes, 0 if the backend does not track it
+    std::atomic<uint64_t> texture_memory_used = 0;
+    std::atomic<uint64_t> texture_memory_peak = 0;
+
+    // draws done by the game during the last frame and draw commands actually recorded, 0 if the backend does not merge draws
+    std::atomic<uint32_t> frame_draw_count = 0;
+    std::atomic<uint32_t> frame_draw_command_count = 0;
+    // render passes begun during the last frame and attachment loads and stores they skipped, 0 if the backend does not track them
+    std::atomic<uint32_t> frame_render_pass_count = 0;
+    std::atomic<uint32_t> frame_elided_load_count = 0;
+    std::atomic<uint32_t> frame_elided_store_count = 0;
+    // guest memory mapped for the GPU, in bytes, in the device-local heap (resizable BAR) and in the host memory, 0 if the backend does not map it
+    std::atomic<uint64_t> mapped_device_local_bytes = 0;
+    std::atomic<uint64_t> mapped_host_bytes = 0;
+
+    // time spent by the GPU rendering the last frame, in milliseconds, 0 if the backend does not measure it
+    std::atomic<float> gpu_frame_time = 0.f;
+    // time spent by the GPU on each scene of the last measured frame, in submission order, empty if the backend does not measure it
+    std::mutex gpu_scene_times_mutex;
+    std::vector<GpuSceneTime> gpu_scene_times;
+
+    // work done since the start, the stutter detector reads them from the main thread to find what made a frame long
+    std::atomic<uint64_t> shader_translation_count = 0;
+    TextureUploadStats texture_uploads;
+    // surfaces copied back to the guest memory, 0 if the backend does not sync them
+    std::atomic<uint64_t> surface_sync_count = 0;
+
+    // host time spent processing the command lists and waiting for the swapchain, in nanoseconds
+    std::atomic<uint64_t> process_batches_ns = 0;
+    std::atomic<uint64_t> present_wait_ns = 0;
+
+    // set from the guest and main threads, use request_display so that the renderer thread is woken up
+    std::atomic<bool> should_display = false;
+
+    // written by the video decoders, read by the texture cache
+    VideoFrameTracker video_frames;
+    FrameSkip frame_skip;
 
     bool need_page_table = false;
 
+    // set when the commands have to be captured, only used by the renderer thread
+    std::unique_ptr<capture::Writer> capture;
+
+    // only used by the renderer thread, enabled by color-surface-debug
+    SurfaceCapture surface_capture;
+
+    // make process_batches return so that the current frame is displayed
+    void request_display() {
+        should_display = true;
+        wake_up.notify_all();
+    }
+
     virtual bool init(const char *shared_path, const bool hashless_texture_cache) = 0;
     virtual void late_init(const Config &cfg, const std::string_view game_id) = 0;
     virtual void render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &viewport_size, const DisplayState &display,
         const GxmState &gxm, MemState &mem)
         = 0;
     virtual void swap_window(SDL_Window *window) = 0;
+    // hand the presented frames to the callback until stop_recording, both called on the thread swapping the window
+    // return false if the backend cannot record them
+    virtual bool start_recording(RecordFrameCallback callback) {
+        return false;
+    }
+    virtual void stop_recording() {}
     // return a mask of the features which can influence the compiled shaders
     virtual uint32_t get_features_mask() {
         return 0;
@@ -99,7 +192,8 @@ struct State {
     void set_stretch_display(bool enable) {
         stretch_the_display_area = enable;
     }
-    virtual bool map_memory(MemState &mem, Ptr<void> address, uint32_t size) {
+    // attribs are the SceGxmMemoryAttribFlags the block was mapped with
+    virtual bool map_memory(MemState &mem, Ptr<void> address, uint32_t size, uint32_t attribs) {
         return true;
     }
     virtual void unmap_memory(MemState &mem, Ptr<void> address) {}
@@ -108,6 +202,20 @@ struct State {
     }
 
     virtual void precompile_shader(const ShadersHash &hash) = 0;
+    // called when a program is created, the backend can start translating it before its first draw
+    // attributes is empty for fragment programs
+    virtual void prepare_shader(const SceGxmProgram &program, const Sha256Hash &hash, bool is_vertex, const std::vector<SceGxmVertexAttribute> &attributes, const TextureInfo &textures_used) {}
+    // start precompiling all the shaders from shaders_cache_hashs on worker threads
+    // return false if the backend can only precompile them one at a time using precompile_shader
+    virtual bool start_parallel_precompile() {
+        return false;
+    }
+    // return true once all the shaders have been precompiled by start_parallel_precompile
+    virtual bool is_parallel_precompile_done() {
+        return true;
+    }
+    // create the pipelines used during the previous runs, if the backend supports it
+    virtual void precompile_pipelines() {}
     virtual void preclose_action() = 0;
 
     virtual ~State() = default;
@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 #include <gxm/types.h>
 #include <mem/ptr.h>
@@ -34,5 +36,123 @@ enum SurfaceTextureRetrievePurpose {
     WRITING,
 };
 
+// Index of the [start, start + size) memory ranges of the surfaces
+// Surfaces can overlap (a small render target inside a bigger one), looking for the surface containing an address
+// returns among those containing it the one starting the closest to it
+// Lookups are done in O(log n), insertions and removals in O(n) as they are much less frequent
+template <typename T>
+class SurfaceRangeIndex {
+public:
+    struct Range {
+        Address start;
+        uint64_t size;
+        T value;
+    };
+
+    // return false and do nothing if a surface already starts at this address
+    bool emplace(Address start, uint64_t size, T value) {
+        auto it = lower_bound(start);
+        if (it != ranges.end() && it->start == start)
+            return false;
+
+        ranges.insert(it, Range{ start, size, std::move(value) });
+        rebuild();
+        return true;
+    }
+
+    // replace the surface starting at this address if there is one
+    void insert_or_assign(Address start, uint64_t size, T value) {
+        auto it = lower_bound(start);
+        if (it != ranges.end() && it->start == start)
+            *it = Range{ start, size, std::move(value) };
+        else
+            ranges.insert(it, Range{ start, size, std::move(value) });
+        rebuild();
+    }
+
+    bool erase(Address start) {
+        auto it = lower_bound(start);
+        if (it == ranges.end() || it->start != start)
+            return false;
+
+        ranges.erase(it);
+        rebuild();
+        return true;
+    }
+
+    // surface starting exactly at this address
+    Range *find(Address start) {
+        auto it = lower_bound(start);
+        if (it == ranges.end() || it->start != start)
+            return nullptr;
+        return &*it;
+    }
+
+    // surface containing the address which starts the closest to it, nullptr if there is none
+    Range *find_containing(Address address) {
+        const auto it = std::upper_bound(ranges.begin(), ranges.end(), address, [](Address addr, const Range &range) {
+            return addr < range.start;
+        });
+        if (it == ranges.begin())
+            return nullptr;
+
+        // fast path, the closest surface before the address contains it
+        const size_t last = std::distance(ranges.begin(), it) - 1;
+        if (ranges[last].start + ranges[last].size > address)
+            return &ranges[last];
+
+        const int found = find_last_ending_after(1, 0, leaf_count - 1, last, address);
+        return (found < 0) ? nullptr : &ranges[found];
+    }
+
+    bool empty() const {
+        return ranges.empty();
+    }
+
+    void clear() {
+        ranges.clear();
+        rebuild();
+    }
+
+private:
+    // sorted by start address
+    std::vector<Range> ranges;
+    // segment tree containing for each node the biggest end address of the ranges below it
+    std::vector<uint64_t> max_end;
+    size_t leaf_count = 0;
+
+    typename std::vector<Range>::iterator lower_bound(Address start) {
+        return std::lower_bound(ranges.begin(), ranges.end(), start, [](const Range &range, Address addr) {
+            return range.start < addr;
+        });
+    }
+
+    void rebuild() {
+        leaf_count = 1;
+        while (leaf_count < ranges.size())
+            leaf_count *= 2;
+
+        max_end.assign(2 * leaf_count, 0);
+        for (size_t i = 0; i < ranges.size(); i++)
+            max_end[leaf_count + i] = ranges[i].start + ranges[i].size;
+        for (size_t node = leaf_count - 1; node > 0; node--)
+            max_end[node] = std::max(max_end[2 * node], max_end[2 * node + 1]);
+    }
+
+    // biggest range index in [0, last] whose end is after address, -1 if there is none
+    int find_last_ending_after(size_t node, size_t node_first, size_t node_last, size_t last, Address address) const {
+        if (node_first > last || max_end[node] <= address)
+            return -1;
+        if (node_first == node_last)
+            return static_cast<int>(node_first);
+
+        const size_t middle = (node_first + node_last) / 2;
+        const int found = find_last_ending_after(2 * node + 1, middle + 1, node_last, last, address);
+        if (found >= 0)
+            return found;
+        return find_last_ending_after(2 * node, node_first, middle, last, address);
+    }
+};
+
 class SurfaceCache {};
 } // namespace renderer
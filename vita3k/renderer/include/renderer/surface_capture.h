@@ -0,0 +1,71 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <mem/ptr.h>
+#include <threads/queue.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <vector>
+
+struct Config;
+
+namespace renderer {
+
+// Writes the color surfaces rendered by the app to png files for debugging, enabled by color-surface-debug.
+// The pixels are copied by the renderer thread and encoded by worker threads, so a sequence of frames can be
+// captured in a live session. The surfaces which do not fit in the memory budget are dropped instead of waiting
+// for the workers, to not change the timing of the app.
+struct SurfaceCapture {
+    static constexpr size_t MEMORY_BUDGET = 256 * 1024 * 1024;
+
+    // NewFrame commands processed since the renderer started
+    uint32_t frame = 0;
+
+    // addresses of the color surfaces to capture, empty to capture all of them, parsed on the first capture
+    std::set<Address> targets;
+    bool targets_parsed = false;
+
+    Queue<std::function<void()>> queue;
+    std::vector<std::thread> workers;
+    // size of the pixels waiting to be encoded
+    std::atomic<size_t> memory_used = 0;
+    uint32_t dropped_count = 0;
+
+    SurfaceCapture() = default;
+    SurfaceCapture(const SurfaceCapture &) = delete;
+    SurfaceCapture &operator=(const SurfaceCapture &) = delete;
+    // the surfaces already copied are still written
+    ~SurfaceCapture();
+};
+
+// true if the color surface at this address is captured in the current frame
+bool should_capture_surface(SurfaceCapture &capture, const Config &config, Address address);
+// copy the RGBA pixels of the surface and write them from a worker, stride is in pixels
+void capture_surface(SurfaceCapture &capture, Address address, uint32_t frame, uint32_t width, uint32_t height, uint32_t stride, const void *pixels);
+// same, the pixels are already a copy tightly packed
+void capture_surface(SurfaceCapture &capture, Address address, uint32_t frame, uint32_t width, uint32_t height, std::vector<uint8_t> pixels);
+
+} // namespace renderer
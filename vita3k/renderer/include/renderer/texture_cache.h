@@ -18,35 +18,67 @@
 #pragma once
 
 #include <gxm/types.h>
+#include <threads/queue.h>
 #include <util/containers.h>
 #include <util/fs.h>
+#include <util/lock_profiler.h>
+#include <util/task_pool.h>
 
 #include <array>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
-
-namespace ddspp {
-struct Descriptor;
-}
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 struct MemState;
+class MappedFile;
+
+namespace renderer {
+class VideoFrameTracker;
+struct TextureUploadStats;
+}
 
 enum SceGxmTextureBaseFormat : uint32_t;
 
 namespace renderer {
 enum class Backend : uint32_t;
+// number of textures in the cache when it is created, backends which do not track the texture memory never go past it
 static constexpr size_t TextureCacheSize = 1024;
+// the cache grows up to this number of textures as long as the texture memory stays within the budget
+static constexpr size_t TextureCacheMaxSize = 16384;
+// textures smaller than this are decoded by the renderer thread even if the backend supports deferred uploads
+static constexpr uint32_t DeferredUploadMinSize = 16 * 1024;
+// memory used by the copies of the textures waiting to be exported, the renderer waits for the export workers past it
+static constexpr size_t ExportMemoryBudget = 256 * 1024 * 1024;
+
+// writes the decoded pixels of a mip to the memory reserved by upload_texture_impl, called by a decode worker
+typedef std::function<void(const void *pixels)> DeferredUploadWrite;
 
 typedef std::array<uint32_t, 4> TextureGxmDataRepr;
 struct TextureCacheInfo {
     uint64_t hash = 0;
+    // hash of a sample of the data of the large textures, checked before hashing them again
+    uint64_t sample_hash = 0;
+    // returned by track_writes when the texture was last hashed, 0 if its memory is not tracked
+    uint64_t write_stamp = 0;
+    // generation of the video frame uploaded if the texture reads a buffer written by a video decoder, 0 otherwise
+    uint64_t video_generation = 0;
     SceGxmTexture texture;
     int index = 0;
     uint32_t texture_size = 0;
+    // GPU memory used by the texture, set by the backend when configuring it
+    uint32_t memory_size = 0;
     bool use_hash = false;
+    // the texture had changed when it was last hashed
+    bool changed = false;
     bool dirty = false;
     // used for texture importation
     bool is_imported = false;
+    // a replacement texture exists for this hash but is still being loaded
+    bool import_pending = false;
     bool is_srgb = false;
     uint16_t width = 0;
     uint16_t height = 0;
@@ -62,9 +94,19 @@ struct SamplerCacheInfo {
 
 struct AvailableTexture {
     bool is_dds;
+    // folder containing the file, null if the texture is stored in a texture pack
     std::shared_ptr<fs::path> folder_path;
+    // texture pack containing the file, the file content is at [pack_offset, pack_offset + pack_size)
+    std::shared_ptr<MappedFile> pack;
+    uint64_t pack_offset = 0;
+    uint64_t pack_size = 0;
 };
 
+// replacement texture loaded by an import worker, defined in replacement.cpp
+struct ImportedTexture;
+// texture written by an export worker, defined in replacement.cpp
+struct ExportedTexture;
+
 class TextureCache {
 protected:
     // current texture info the cache is looking at
@@ -75,25 +117,75 @@ protected:
     // are we in the process of importing a texture
     bool importing_texture = false;
 
-    // dds/png raw file
-    std::vector<uint8_t> imported_texture_raw_data;
-    // pointer to the decoded content
-    uint8_t *imported_texture_decoded = nullptr;
-    // Info about the texture currently loading
-    AvailableTexture loading_texture;
-    // contain the decrypted header when loading dds
-    ddspp::Descriptor *dds_descriptor = nullptr;
-    // file being written to when exporting dds
-    fs::ofstream output_file;
-    // used when exporting dds
-    bool export_dds_swap_rb = false;
+    // replacement texture currently being imported
+    std::shared_ptr<ImportedTexture> current_import;
+    // replacement textures loaded or being loaded by the import workers, key = hash
+    // only accessed by the renderer thread, the workers only write to the ImportedTexture they were given
+    unordered_map_fast<uint64_t, std::shared_ptr<ImportedTexture>> imported_textures;
+    Queue<std::function<void()>> import_queue;
+    std::vector<std::thread> import_workers;
+    // texture being exported, its mips are copied until export_done hands it to the export workers
+    std::shared_ptr<ExportedTexture> current_export;
+    Queue<std::function<void()>> export_queue;
+    std::vector<std::thread> export_workers;
+    // protects exported_textures_hash and export_memory_used
+    std::mutex export_mutex;
+    // notified once an export worker has written a texture
+    std::condition_variable export_cond;
+    // size of the pixels copied for the textures waiting to be written
+    size_t export_memory_used = 0;
+
+    // palette of the P8 texture being uploaded when it is expanded by upload_texture_impl
+    const uint32_t *current_palette = nullptr;
+    uint32_t current_palette_count = 0;
+
+    // decode workers, they convert the textures and write them to the memory reserved by the backend
+    Queue<std::function<void()>> decode_queue;
+    std::vector<std::thread> decode_workers;
+    ProfiledMutex decode_mutex{ "TextureCache::decode_mutex" };
+    // notified once no decode job is left
+    std::condition_variable_any decode_done_cond;
+    uint32_t decode_pending = 0;
+
+    void schedule_decode_job(std::function<void()> job);
+
+    // the large textures are hashed by chunks by the renderer thread and these tasks
+    TaskGroup hash_tasks{ TaskPriority::LatencyCritical };
+
+    // same hash as texture::hash_texture_data
+    uint64_t hash_texture(const SceGxmTexture &texture, uint32_t texture_size, const MemState &mem);
+
+    // return the entry to use for a texture not in the cache, evicting textures if needed
+    TextureCacheInfo *get_free_entry();
 
 public:
     Backend backend;
     bool use_protect = false;
+    // write protect the hashed textures and only hash them again once their pages have been written
+    bool use_write_tracking = false;
     // use a separate sampler cache
     bool use_sampler_cache = false;
+    // set by the backend if upload_texture_impl can expand P8 and YUV420P3 textures to RGBA8 by itself
+    // P4 textures are then uploaded as P8 textures with a 16 colors palette
+    bool support_gpu_expansion = false;
+    // set by the backend if upload_texture_impl can be called with null pixels to only reserve the memory and record the copy
+    // it must then set deferred_upload_write, the texture is decoded by a worker which calls it with the pixels
+    bool support_deferred_upload = false;
+    // set by upload_texture_impl when called with null pixels
+    DeferredUploadWrite deferred_upload_write;
     int anisotropic_filtering = 1;
+    // set by the backend, the textures reading video frames are uploaded when the decoder writes a new frame instead of being hashed
+    VideoFrameTracker *video_frames = nullptr;
+    // set by the backend, counts the textures uploaded
+    TextureUploadStats *upload_stats = nullptr;
+
+    // maximum number of textures in the cache, set by the backend before init
+    size_t max_texture_count = TextureCacheSize;
+    // textures are evicted once they use more GPU memory than this, updated by the backend
+    uint64_t memory_budget = std::numeric_limits<uint64_t>::max();
+    // GPU memory used by all the textures in the cache
+    uint64_t memory_used = 0;
+    uint64_t memory_peak = 0;
 
     // used to quicky get the info from a hash of a gxm_texture
     unordered_map_fast<TextureGxmDataRepr, TextureCacheInfo *> texture_lookup;
@@ -113,19 +205,25 @@ public:
 
     // folder where the exported textures will be saved
     fs::path export_folder;
-    // hash of the textures that have already been exported
+    // hash of the textures that have already been exported or are being exported, protected by export_mutex
     unordered_set_fast<uint64_t> exported_textures_hash;
     bool export_textures = false;
 
+    virtual ~TextureCache();
+
     bool init(const bool hashless_texture_cache, const fs::path &texture_folder, const std::string_view game_id, const size_t sampler_cache_size = 0);
     virtual void select(size_t index, const SceGxmTexture &texture) = 0;
     virtual void configure_texture(const SceGxmTexture &texture) = 0;
     virtual void upload_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride) = 0;
     virtual void upload_done() {}
+    // free the GPU memory used by a texture, it may still be used by the commands being recorded
+    virtual void release_texture(size_t index) {}
 
     virtual void configure_sampler(size_t index, const SceGxmTexture &texture) {}
 
     void upload_texture(const SceGxmTexture &gxm_texture, MemState &mem);
+    // must be called by the backend before submitting the copies of the textures uploaded with deferred writes
+    void wait_decode_jobs();
     void cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemState &mem);
 
     // is called by cache_and_bind_texture if use_sampler_cache is set to true
@@ -139,6 +237,10 @@ public:
     void export_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride);
     void export_done();
 
+    // return true if the replacement texture for this hash is loaded and set as current_import
+    // otherwise its loading is started in the background if it is not already
+    bool retrieve_imported_texture(uint64_t hash, const AvailableTexture &available, const SceGxmTexture &texture);
+    bool is_imported_texture_loaded(uint64_t hash) const;
     // return false if there was an issue with the replacement texture
     bool import_configure_texture();
     virtual void import_configure_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, bool is_srgb, uint16_t nb_components, uint16_t mipcount, bool swap_rb) = 0;
@@ -27,6 +27,7 @@
 #include <shader/usse_program_analyzer.h>
 
 #include <array>
+#include <atomic>
 #include <bit>
 #include <bitset>
 #include <map>
@@ -87,6 +88,12 @@ enum class GXMState : std::uint16_t {
 
 struct RenderTarget;
 
+// textures uploaded by the texture cache since the start and the guest size of their data
+struct TextureUploadStats {
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> bytes = 0;
+};
+
 struct GXMStreamInfo {
     Ptr<const uint8_t> data = Ptr<const uint8_t>(0);
     size_t size = 0;
@@ -199,6 +206,9 @@ struct ShaderProgram {
 };
 
 struct FragmentProgram : ShaderProgram {
+    // blending the program was created with, kept to create it again when replaying a capture
+    bool has_blend = false;
+    SceGxmBlendInfo blend{};
 };
 
 struct VertexProgram : ShaderProgram {
@@ -0,0 +1,52 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/ptr.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+namespace renderer {
+
+// Guest buffers the video decoders write their frames to.
+// The textures reading them are uploaded again when a new frame is written instead of being hashed.
+class VideoFrameTracker {
+    struct FrameBuffer {
+        uint32_t size;
+        // value of next_generation when the last frame was written
+        uint64_t generation;
+    };
+
+    // enough for the buffers of a few decoders and their ring of frames
+    static constexpr size_t MAX_BUFFERS = 64;
+
+    std::mutex mutex;
+    // key = address of the buffer
+    std::map<Address, FrameBuffer> buffers;
+    uint64_t next_generation = 1;
+
+public:
+    // called by the decoders each time they write a frame to the buffer
+    void frame_written(Address address, uint32_t size);
+    // return the generation of the last frame written to the buffer containing the range, 0 if it is not a video frame buffer
+    uint64_t get_generation(Address address, uint32_t size);
+};
+
+} // namespace renderer
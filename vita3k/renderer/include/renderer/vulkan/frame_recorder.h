@@ -0,0 +1,75 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <renderer/frame_recording.h>
+
+#include <vkutil/objects.h>
+
+#include <array>
+
+namespace renderer::vulkan {
+
+class ScreenRenderer;
+
+// copies the presented frames for the gameplay recorder: the swapchain image is scaled to the size of the recording,
+// converted to NV12 by frame_record.comp and read back by the CPU once the fence of the frame is signaled
+// the CPU only reads 1.5 bytes per pixel and never waits for the GPU
+class FrameRecorder {
+public:
+    FrameRecorder(ScreenRenderer &screen, RecordFrameCallback callback);
+    ~FrameRecorder();
+
+    // the recording keeps the size of the swapchain when it starts
+    bool init();
+    // called once the render pass of the frame is ended, before its command buffer is submitted
+    void record(vk::CommandBuffer cmd_buffer, uint32_t image_idx);
+    // hand the frames whose copy is done to the callback, in presentation order
+    // all the recorded frames are collected if the device is idle
+    void collect(bool device_idle);
+
+private:
+    // one per swapchain image, its fence tells when the copy is done
+    struct Slot {
+        vkutil::Buffer buffer;
+        vk::DescriptorSet descriptor_set;
+        bool pending = false;
+        uint64_t timestamp_ns = 0;
+    };
+    static constexpr uint32_t MAX_SLOTS = 8;
+
+    void init_slot(Slot &slot);
+
+    ScreenRenderer &screen;
+    RecordFrameCallback callback;
+
+    vk::Extent2D extent;
+    vk::Filter blit_filter = vk::Filter::eLinear;
+    // the swapchain image is blitted there
+    vkutil::Image image;
+    std::array<Slot, MAX_SLOTS> slots;
+
+    // not created if frame_record.comp.spv is missing, the RGBA frames are read back instead
+    vk::DescriptorSetLayout descriptor_set_layout;
+    vk::DescriptorPool descriptor_pool;
+    vk::PipelineLayout pipeline_layout;
+    vk::Pipeline pipeline;
+};
+
+} // namespace renderer::vulkan
@@ -36,6 +36,10 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     Ptr<void> indices, size_t count, uint32_t instance_count, MemState &mem, const Config &config);
 
 void mid_scene_flush(VKContext &context, const SceGxmNotification notification);
+// GXM transfers between surfaces of the surface cache, return true if the CPU transfer is not needed anymore
+bool transfer_copy(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest);
+bool transfer_downscale(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest);
+bool transfer_fill(VKContext &context, uint32_t fill_color, const SceGxmTransferImage &dest);
 void new_frame(VKContext &context);
 
 void set_context(VKContext &context, MemState &mem, VKRenderTarget *rt, const FeatureState &features);
@@ -43,6 +47,11 @@ void set_uniform_buffer(VKContext &context, const MemState &mem, const ShaderPro
 
 void sync_clipping(VKContext &context);
 void sync_stencil_func(VKContext &context, const bool is_back);
+// the following states are dynamic only with VK_EXT_extended_dynamic_state, the pipeline is refreshed otherwise
+void sync_stencil_op(VKContext &context);
+void sync_cull(VKContext &context);
+void sync_depth_func(VKContext &context);
+void sync_depth_write_enable(VKContext &context);
 void sync_mask(VKContext &context, const MemState &mem);
 void sync_depth_bias(VKContext &context);
 void sync_depth_data(VKContext &context);
@@ -18,10 +18,19 @@
 #pragma once
 
 #include <array>
+#include <condition_variable>
+#include <functional>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <renderer/types.h>
+#include <util/task_pool.h>
 
 #include <vkutil/objects.h>
 
@@ -35,6 +44,23 @@ using Sha256Hash = std::array<uint8_t, 32>;
 namespace renderer::vulkan {
 struct VKState;
 struct VKContext;
+struct PipelineCreateData;
+
+// everything needed to create a pipeline without any access to the guest memory
+// these are saved on disk so that the pipelines can be created again before the game starts
+struct PipelineDescription {
+    uint64_t key;
+    // only the part before vertex_streams is relevant
+    GxmRecordState record;
+    SceGxmPrimitiveType type;
+    vk::Format color_format;
+    bool is_frag_color_used;
+    uint16_t vert_texture_count;
+    uint16_t frag_texture_count;
+    vk::PipelineColorBlendAttachmentState blending;
+    std::vector<vk::VertexInputBindingDescription> binding_descr;
+    std::vector<vk::VertexInputAttributeDescription> attr_descr;
+};
 
 class PipelineCache {
 private:
@@ -51,13 +77,53 @@ private:
 
     vk::PipelineCache pipeline_cache;
 
-    // first index: 1 if depth-stencil is force loaded, 0 otherwise
-    // second index: 1 if depth-stencil is force stored, 0 otherwise
-    std::map<vk::Format, vk::RenderPass> render_passes[2][2];
+    // first index: 1 if the color is discarded, 0 otherwise
+    // second index: 1 if depth-stencil is force loaded, 0 otherwise
+    // third index: 1 if depth-stencil is force stored, 0 otherwise
+    std::map<vk::Format, vk::RenderPass> render_passes[2][2][2];
     // render passes used along shader interlock
     std::map<vk::Format, vk::RenderPass> shader_interlock_pass;
     std::map<Sha256Hash, vk::ShaderModule> shaders;
+    // shaders are also created by the precompile and translate workers
+    std::mutex shaders_mutex;
+
+    // speculative shader translation, done by the translate workers when a program is created
+    // shaders waiting to be translated, the value is true once a worker has started translating it
+    std::map<Sha256Hash, bool> pending_shaders;
+    // notified when a worker is done with a pending shader
+    std::condition_variable shaders_cond;
+    // used to check that the guessed hints match the ones of the first draw using the shader
+    struct SpeculativeShader {
+        TextureInfo textures_used;
+        bool is_vertex;
+    };
+    // shaders translated by the workers but not used by a draw yet
+    std::map<Sha256Hash, SpeculativeShader> speculative_shaders;
+    TaskGroup translate_tasks{ TaskPriority::Normal };
+    void translate_speculative_shader(const SceGxmProgram &program, const Sha256Hash &hash, bool is_vertex, const std::vector<SceGxmVertexAttribute> &attributes, const TextureInfo &textures_used);
+    // save the shader in the list of shaders to precompile during the next runs
+    void on_shader_translated(const Sha256Hash &hash, bool is_vertex);
     std::unordered_map<uint64_t, vk::Pipeline> pipelines;
+    // parts of pipelines used with VK_EXT_graphics_pipeline_library, can be shared by multiple pipelines
+    std::unordered_map<uint64_t, vk::Pipeline> pipeline_libraries;
+    std::mutex libraries_mutex;
+
+    // description of all the pipelines created by this game, saved along the pipeline cache
+    std::vector<PipelineDescription> pipeline_descriptions;
+    bool pipeline_descriptions_changed = false;
+
+    // async pipeline compilation
+    // pipelines which have been sent to a worker but are not available yet
+    std::unordered_set<uint64_t> pending_pipelines;
+    // pipelines compiled by the workers, moved to pipelines by the renderer thread
+    std::vector<std::pair<uint64_t, vk::Pipeline>> compiled_pipelines;
+    std::mutex compiled_pipelines_mutex;
+    TaskGroup compile_tasks{ TaskPriority::Normal };
+
+    // shaders waiting to be optimized, the optimized version is only saved in the shader cache
+    TaskGroup optimize_tasks{ TaskPriority::Background };
+    // optimize the shader in a background task and save it next to the original one
+    void queue_shader_optimization(const Sha256Hash &hash, const std::vector<uint32_t> &source);
 
     // temp vars used to store the result computed by auxialiary functions before createPipeline is called
     std::vector<vk::VertexInputBindingDescription> binding_descr;
@@ -66,11 +132,34 @@ private:
     vk::PipelineShaderStageCreateInfo retrieve_shader(const SceGxmProgram *program, const Sha256Hash &hash, bool is_vertex, bool maskupdate, MemState &mem, const std::vector<SceGxmVertexAttribute> *hint_attributes);
     vk::PipelineLayout retrieve_pipeline_layout(const uint16_t vert_texture_count, const uint16_t frag_texture_count);
     vk::PipelineVertexInputStateCreateInfo get_vertex_input_state(MemState &mem);
+    // move all the pipelines compiled by the workers to the pipelines map
+    void collect_compiled_pipelines();
+    std::shared_ptr<PipelineCreateData> get_pipeline_create_data(const PipelineDescription &desc, vk::ShaderModule vertex_module, vk::ShaderModule fragment_module, vk::RenderPass render_pass);
+
+    // create the pipeline, either directly or by linking pipeline libraries
+    // if link_only is set, a null pipeline is returned unless it can be linked from existing libraries
+    vk::Pipeline create_pipeline(const PipelineCreateData &data, bool link_only = false);
+    vk::Pipeline retrieve_library(uint64_t key, const vk::GraphicsPipelineCreateInfo &library_info, bool only_existing);
+
+    void read_pipeline_descriptions();
+    void save_pipeline_descriptions();
 
 public:
     // if not 0, next time the pipeline cache should be saved (in seconds since epoch)
     uint64_t next_pipeline_cache_save = std::numeric_limits<uint64_t>::max();
 
+    // if true, pipelines are compiled by worker threads and retrieve_pipeline returns
+    // a null pipeline until the compilation is done
+    bool async_compilation = false;
+    // use VK_EXT_graphics_pipeline_library to build pipelines from pre-compiled parts
+    bool use_pipeline_library = false;
+    // use VK_EXT_extended_dynamic_state to set the cull mode, depth and stencil ops and primitive topology
+    // dynamically, these states are then not part of the pipeline key
+    bool use_extended_dynamic_state = false;
+    // run the SPIR-V optimizer on the shaders in the background, the optimized shaders
+    // are used from the next time they are loaded from the shader cache
+    bool optimize_shaders = false;
+
     vk::DescriptorSetLayout uniforms_layout;
     // used for the mask, color attachment
     vk::DescriptorSetLayout attachments_layout;
@@ -83,13 +172,20 @@ public:
 
     explicit PipelineCache(VKState &state);
     void init();
+    void cleanup();
 
     void read_pipeline_cache();
     void save_pipeline_cache();
 
-    vk::RenderPass retrieve_render_pass(vk::Format format, bool force_load, bool force_store, bool no_color = false);
+    // discard_color: the color attachment is only a placeholder, it is neither loaded nor stored
+    vk::RenderPass retrieve_render_pass(vk::Format format, bool force_load, bool force_store, bool no_color = false, bool discard_color = false);
+    // can return a null pipeline if async_compilation is enabled, in this case the draw should be skipped
     vk::Pipeline retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem);
 
     bool precompile_shader(const Sha256Hash &hash);
+    // start translating the shader on a translate worker, so that it is usually ready by its first draw
+    void prepare_shader(const SceGxmProgram &program, const Sha256Hash &hash, bool is_vertex, const std::vector<SceGxmVertexAttribute> &attributes, const TextureInfo &textures_used);
+    // create all the pipelines used during the previous runs of the game
+    void precompile_pipelines();
 };
 } // namespace renderer::vulkan
\ No newline at end of file
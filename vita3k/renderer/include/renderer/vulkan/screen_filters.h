@@ -145,6 +145,11 @@ private:
     vk::Pipeline pipeline_easu;
     vk::Pipeline pipeline_rcas;
 
+    // easu and rcas in one dispatch writing to the swapchain image, used instead of the two passes when available
+    vk::ShaderModule single_pass_shader;
+    vk::PipelineLayout pipeline_layout_single_pass;
+    vk::Pipeline pipeline_single_pass;
+
     vk::Extent2D output_offset;
     vk::Extent2D output_size;
 
@@ -19,9 +19,15 @@
 
 #include <vkutil/objects.h>
 
+#include "frame_recorder.h"
 #include "screen_filters.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 struct SDL_Window;
 
@@ -72,6 +78,25 @@ public:
     // set to true after a window resize, in this case the pipeline needs to be rebuilt
     bool need_rebuild = false;
 
+    // frame pacing, set from the config before setup
+    // low latency: wait for the previous frame to be displayed before letting the game start the next one
+    bool low_latency = false;
+    // high throughput: prefer presenting immediately and use one more swapchain image
+    bool high_throughput = false;
+    // VK_KHR_present_id and VK_KHR_present_wait are supported and enabled
+    bool support_present_wait = false;
+    // id of the last present done on the current swapchain
+    uint64_t present_id = 0;
+
+    // the frames are presented on a dedicated thread so a slow present does not stall the main loop
+    // not used in low latency mode, which waits for the present on purpose
+    bool use_present_thread = false;
+
+    // the swapchain images can be copied from, needed to record them
+    bool support_transfer_src = false;
+    // set while the gameplay is recorded
+    std::unique_ptr<FrameRecorder> frame_recorder;
+
     ScreenRenderer(VKState &state);
 
     bool create(SDL_Window *window);
@@ -83,6 +108,8 @@ public:
     void render(vk::ImageView image_view, vk::ImageLayout layout, const Viewport &viewport);
     void swap_window();
     void set_filter(const std::string_view &filter);
+    bool start_recording(RecordFrameCallback callback);
+    void stop_recording();
 
 private:
     void create_render_pass();
@@ -93,5 +120,27 @@ private:
     void copy_to_vao(const void *data);
     void create_surface_image();
     void destroy_swapchain();
+    void recreate_swapchain();
+
+    struct PresentFrame {
+        uint32_t image_idx;
+        // index of the semaphores
+        int frame;
+    };
+    // return false if the swapchain is out of date
+    bool present(const PresentFrame &frame);
+    void present_thread_loop();
+    // wait for all the frames handed to the present thread to be presented
+    void wait_present_idle();
+
+    std::thread present_thread;
+    std::mutex present_mutex;
+    std::condition_variable present_cond;
+    std::deque<PresentFrame> present_queue;
+    // frames handed to the present thread and not presented yet
+    uint32_t present_pending = 0;
+    bool present_exiting = false;
+    // set by the present thread, the swapchain is recreated by the next acquire
+    std::atomic<bool> swapchain_out_of_date = false;
 };
 } // namespace renderer::vulkan
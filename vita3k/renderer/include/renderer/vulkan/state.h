@@ -24,6 +24,7 @@
 #include <renderer/vulkan/screen_renderer.h>
 #include <renderer/vulkan/surface_cache.h>
 #include <renderer/vulkan/types.h>
+#include <util/lock_profiler.h>
 
 typedef void *ImTextureID;
 struct Config;
@@ -51,6 +52,8 @@ struct VKState : public renderer::State {
     vk::Device device;
 
     ScreenRenderer screen_renderer;
+    // no window was given, the frames are rendered but never presented
+    bool headless = false;
 
     // Used for memory allocation and general query later.
     vk::PhysicalDevice physical_device;
@@ -67,6 +70,8 @@ struct VKState : public renderer::State {
     uint32_t transfer_queue_last = 0;
     vk::Queue general_queue;
     vk::Queue transfer_queue;
+    // the frames are presented from another thread, it must be locked to use the general queue
+    ProfiledMutex general_queue_mutex{ "VKState::general_queue_mutex" };
 
     // These might be merged into one queue, but for now they are different.
     vk::CommandPool general_command_pool;
@@ -75,13 +80,52 @@ struct VKState : public renderer::State {
 
     // only used when memory mapping is enabled
     std::map<Address, MappedMemory, std::greater<Address>> mapped_memories;
+    // for each 4 KiB page of the guest memory, the mapped memory containing it or null, allocated on the first mapping
+    std::unique_ptr<const MappedMemory *[]> mapped_pages;
+    // when supported, one sparse buffer over the whole guest address space, the imported guest blocks are bound to it
+    // the buffer and device address of a guest address are then the same for all the blocks bound to it
+    bool support_mapped_heap = false;
+    MappedHeap mapped_heap;
+    // the imported guest blocks are extended to this alignment, at most the host page size
+    uint32_t imported_host_pointer_alignment = KiB(4);
+    // size of the device-local heap the CPU can map entirely (resizable BAR), 0 if there is none
+    uint64_t rebar_heap_size = 0;
+    // the blocks only read by the GPU are placed in this heap, up to rebar_mapped_budget bytes, with rebar-mapped-memory
+    bool use_rebar_mapped_memory = false;
+    uint64_t rebar_mapped_budget = 0;
 
     vkutil::Image default_image;
     vkutil::Buffer default_buffer;
 
+    // used to precompile the shaders in parallel at boot
+    std::vector<std::thread> precompile_workers;
+    std::atomic<size_t> next_precompile_idx = 0;
+    std::atomic<uint32_t> precompile_workers_running = 0;
+
     bool support_fsr = false;
     // support for the VK_KHR_uniform_buffer_standard_layout extension, needed for memory mapping and texture viewport
     bool support_standard_layout = false;
+    // number of frames the GPU can be working on, between 1 and MAX_FRAMES_RENDERING
+    int frames_in_flight = 3;
+    // submissions are tracked with a timeline semaphore instead of fences
+    bool support_timeline_semaphore = false;
+    // merge consecutive draws sharing the same state into indirect draws, only possible with memory mapping
+    bool use_draw_batching = false;
+    // the GPU time of each frame is measured with timestamp queries
+    bool support_timestamp_queries = false;
+    // valid bits of the general queue timestamps
+    uint64_t timestamp_mask = 0;
+    // the GPU has memory only committed when used (tile-based GPUs), the depth-stencil kept on the tiles uses it
+    bool support_lazily_allocated_memory = false;
+    // support for VK_EXT_rasterization_order_attachment_access, the subpass input then sees the color
+    // written by the previous fragments without any barrier between the draws
+    bool support_rasterization_order = false;
+    bool use_rasterization_order = false;
+    // lower the resolution multiplier of the next render targets when the GPU cannot keep up
+    bool use_dynamic_resolution = false;
+    DynamicResolution dynamic_resolution;
+    // the resolution multiplier can only change while no render target is alive
+    uint32_t render_target_count = 0;
 
     VKState(int gpu_idx);
 
@@ -92,6 +136,8 @@ struct VKState : public renderer::State {
     void render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &viewport_size, const DisplayState &display,
         const GxmState &gxm, MemState &mem) override;
     void swap_window(SDL_Window *window) override;
+    bool start_recording(RecordFrameCallback callback) override;
+    void stop_recording() override;
     uint32_t get_features_mask() override;
     int get_supported_filters() override;
     void set_screen_filter(const std::string_view &filter) override;
@@ -99,7 +145,7 @@ struct VKState : public renderer::State {
     void set_anisotropic_filtering(int anisotropic_filtering) override;
     void set_texture_state(bool import_textures, bool export_textures, bool export_as_png) override;
 
-    bool map_memory(MemState &mem, Ptr<void> address, uint32_t size) override;
+    bool map_memory(MemState &mem, Ptr<void> address, uint32_t size, uint32_t attribs) override;
     void unmap_memory(MemState &mem, Ptr<void> address) override;
     // return the matching buffer and offset for the memory location
     std::tuple<vk::Buffer, uint32_t> get_matching_mapping(const Ptr<void> address);
@@ -108,6 +154,10 @@ struct VKState : public renderer::State {
     std::vector<std::string> get_gpu_list() override;
 
     void precompile_shader(const ShadersHash &hash) override;
+    void prepare_shader(const SceGxmProgram &program, const Sha256Hash &hash, bool is_vertex, const std::vector<SceGxmVertexAttribute> &attributes, const TextureInfo &textures_used) override;
+    bool start_parallel_precompile() override;
+    bool is_parallel_precompile_done() override;
+    void precompile_pipelines() override;
     void preclose_action() override;
 };
 } // namespace renderer::vulkan
@@ -22,6 +22,7 @@
 #include <util/containers.h>
 #include <vkutil/objects.h>
 
+#include <array>
 #include <optional>
 
 struct SwsContext;
@@ -46,6 +47,11 @@ struct SurfaceCacheInfo {
 
     std::uint32_t flags = FLAG_FREE;
     vkutil::Image texture;
+    // the texture goes back to the image pool of the surface cache with them once the surface is destroyed
+    vk::ImageUsageFlags texture_usage;
+    vk::ImageCreateFlags texture_flags;
+    // the surface can't be used anymore once the dynamic resolution changes the multiplier
+    int res_multiplier = 1;
 };
 
 struct Framebuffer {
@@ -55,6 +61,28 @@ struct Framebuffer {
     vk::Framebuffer shader_interlock;
     // base color image used by the framebuffer
     vkutil::Image *base_image;
+    // frame_timestamp when the framebuffer was last retrieved, the least recently used one is evicted
+    uint64_t last_used_frame = 0;
+};
+
+// attachments and extent of a framebuffer, hashed once when the key is built
+struct FramebufferKey {
+    vk::ImageView color;
+    vk::ImageView depth_stencil;
+    uint32_t width;
+    uint32_t height;
+    size_t hash;
+
+    FramebufferKey(vk::ImageView color, vk::ImageView depth_stencil, uint32_t width, uint32_t height);
+
+    bool operator==(const FramebufferKey &other) const {
+        return color == other.color && depth_stencil == other.depth_stencil && width == other.width && height == other.height;
+    }
+
+    // used by boost::hash
+    friend size_t hash_value(const FramebufferKey &key) {
+        return key.hash;
+    }
 };
 
 struct CastedTexture {
@@ -93,6 +121,11 @@ struct ColorSurfaceCacheInfo : public SurfaceCacheInfo {
     // only used for 3-component rgb textures which can't be copied directly
     std::unique_ptr<vkutil::Buffer> copy_buffer;
 
+    // only used when the surface is converted to its guest layout on the GPU
+    std::unique_ptr<vkutil::Buffer> readback_buffer;
+    // set by the last surface sync if readback_buffer was written to guest memory
+    bool is_readback_converted = false;
+
     // pointer shared with the memory trap indicating if this surface sync is needed
     std::shared_ptr<bool> need_surface_sync;
 
@@ -120,6 +153,11 @@ struct DepthStencilSurfaceCacheInfo : public SurfaceCacheInfo {
     int32_t memory_height;
     SceGxmMultisampleMode multisample_mode;
 
+    // loaded or stored by a render pass or read as a texture, the content must be kept in memory
+    bool need_memory = false;
+    // only usable as an attachment, it is never written back from the tiles
+    bool is_transient = false;
+
     // used when reading from this depth stencil in a shader with texture viewport enabled
     vk::ImageView depth_view = nullptr;
     vk::ImageView stencil_view = nullptr;
@@ -128,6 +166,27 @@ struct DepthStencilSurfaceCacheInfo : public SurfaceCacheInfo {
     std::vector<DepthSurfaceView> read_surfaces;
 };
 
+// push constants of surface_readback.comp
+struct SurfaceReadbackInfo {
+    uint64_t src_address;
+    uint64_t dst_address;
+    uint32_t dst_size;
+    uint32_t component_bits;
+    uint32_t src_components;
+    uint32_t dst_components;
+    // index in the source pixel of each component of the destination pixel
+    std::array<uint32_t, 4> swizzle;
+};
+
+// image of a destroyed surface, kept to be used again by a new surface with the same properties
+struct PooledSurfaceImage {
+    vkutil::Image image;
+    vk::ImageUsageFlags usage;
+    vk::ImageCreateFlags flags;
+    // frame_timestamp when the surface was destroyed, the GPU may use the image for frames_in_flight frames after it
+    uint64_t release_frame;
+};
+
 // result when looking in the surface cache for a texture
 struct TextureLookupResult {
     vk::ImageView view;
@@ -148,7 +207,7 @@ private:
     // only have 20 color surfaces and 20 depth surfaces allocated at most at a given time
     static constexpr uint32_t max_surfaces_allowed = 20;
 
-    std::map<Address, ColorSurfaceCacheInfo *> color_address_lookup;
+    SurfaceRangeIndex<ColorSurfaceCacheInfo *> color_address_lookup;
 
     std::map<Address, DepthStencilSurfaceCacheInfo *> depth_address_lookup;
     std::map<Address, DepthStencilSurfaceCacheInfo *> stencil_address_lookup;
@@ -157,17 +216,32 @@ private:
     lru::Queue<ColorSurfaceCacheInfo> color_surface_queue;
     lru::Queue<DepthStencilSurfaceCacheInfo> ds_surface_queue;
 
-    std::map<std::pair<vk::ImageView, vk::ImageView>, Framebuffer> framebuffer_array;
+    // framebuffers kept at most, more would only be piling up for surfaces which are not rendered to anymore
+    static constexpr size_t max_framebuffers = 256;
+    unordered_map_fast<FramebufferKey, Framebuffer> framebuffer_array;
+
+    // an image not used again for this many frames is destroyed
+    static constexpr uint64_t image_pool_idle_frames = 600;
+    // images of the destroyed surfaces, the oldest ones first
+    std::vector<PooledSurfaceImage> image_pool;
 
     VKRenderTarget *target = nullptr;
     ColorSurfaceCacheInfo *last_written_surface = nullptr;
 
+    // swizzle and convert synced surfaces on the GPU, null if surface_readback.comp could not be loaded
+    vk::PipelineLayout readback_pipeline_layout;
+    vk::Pipeline readback_pipeline;
+
     // destroy all framebuffers using view as their color or depth-stencil
     void destroy_framebuffers(vk::ImageView view);
 
     void destroy_surface(ColorSurfaceCacheInfo &info);
     void destroy_surface(DepthStencilSurfaceCacheInfo &info);
 
+    // create the texture of the surface or take it from the image pool, its size and format must be set
+    void acquire_surface_image(SurfaceCacheInfo &info, vk::ImageUsageFlags usage, vk::ImageCreateFlags flags, const void *pNext = nullptr, const vma::AllocationCreateInfo &alloc_info = vkutil::vma_auto_alloc);
+    void release_surface_image(SurfaceCacheInfo &info);
+
 public:
     // when creating a mutable image, can we pass as an argument
     // the possible format used for an image view to improve performance ?
@@ -180,6 +254,9 @@ public:
 
     explicit VKSurfaceCache(VKState &state);
 
+    void init();
+    void cleanup();
+
     SurfaceRetrieveResult retrieve_color_surface_for_framebuffer(MemState &mem, SceGxmColorSurface *color);
     std::optional<TextureLookupResult> retrieve_color_surface_as_texture(const SceGxmTexture &texture, const SceGxmColorBaseFormat base_format, TextureViewport *texture_viewport);
 
@@ -189,11 +266,15 @@ public:
     Framebuffer &retrieve_framebuffer_handle(MemState &mem, SceGxmColorSurface *color, SceGxmDepthStencilSurface *depth_stencil,
         vk::RenderPass standard_render_pass, vk::RenderPass interlock_render_pass, vk::ImageView &color_view, vk::ImageView &ds_view);
 
+    // return the color surface containing the whole transfer image and set the upscaled region of the image in it
+    // null if the image is not fully backed by a surface with the same layout
+    ColorSurfaceCacheInfo *retrieve_color_surface_for_transfer(const SceGxmTransferImage &image, vk::Offset3D &offset, vk::Extent3D &extent);
+
     // If non-null, the return value must be sent as a PostSurfaceSyncRequest
     ColorSurfaceCacheInfo *perform_surface_sync();
 
-    // Called after the render has been done
-    void perform_post_surface_sync(const MemState &mem, ColorSurfaceCacheInfo *surface);
+    // Called after the render has been done, swizzles the synced surface if it was not done on the GPU
+    void perform_post_surface_sync(MemState &mem, ColorSurfaceCacheInfo *surface);
 
     // destroy all framebuffers associated with render_target
     // (meaning their color or depth-stencil surface is not backed by memory)
@@ -203,6 +284,9 @@ public:
     // Viewport should already have its fields width and height filled
     vk::ImageView sourcing_color_surface_for_presentation(Ptr<const void> address, uint32_t pitch, Viewport &viewport);
 
+    // destroy the pooled images which have not been used again for a while, called once per frame
+    void purge_image_pool();
+
     void set_render_target(VKRenderTarget *new_target) {
         target = new_target;
     }
@@ -21,8 +21,13 @@
 #include <renderer/types.h>
 
 #include <threads/queue.h>
+#include <util/tracy.h>
 #include <vkutil/objects.h>
 
+#include <deque>
+#include <optional>
+#include <unordered_map>
+
 struct MemState;
 
 namespace renderer::vulkan {
@@ -30,33 +35,98 @@ namespace renderer::vulkan {
 struct VKState;
 struct VKRenderTarget;
 
-constexpr int MAX_FRAMES_RENDERING = 3;
-constexpr int NB_TEXTURE_STAGING_BUFFERS = 16;
+// maximum number of frames the GPU can be working on, the number actually used is VKState::frames_in_flight
+constexpr int MAX_FRAMES_RENDERING = 4;
+// maximum number of draws merged into a single indirect draw
+constexpr uint32_t MAX_BATCHED_DRAWS = 256;
+// maximum number of timestamps written in a frame, two for each scene and two for each of its render passes
+constexpr uint32_t MAX_FRAME_TIMESTAMPS = 512;
+// initial size of the texture staging ring, it grows if a texture does not fit in it
+constexpr uint32_t TEXTURE_STAGING_RING_SIZE = 64 * 1024 * 1024;
+
+// timestamps of a scene in the frame timestamp pool, the ones of its render passes are the pairs between begin_idx and end_idx
+struct SceneTimestamps {
+    // color surface rendered to, 0 if there is none
+    Address color_address;
+    uint32_t width;
+    uint32_t height;
+    uint32_t begin_idx;
+    uint32_t end_idx;
+};
 
-struct TextureStagingBuffer {
+// part of the staging ring which may still be read by the GPU
+struct StagingRegion {
+    uint32_t begin;
+    uint32_t end;
+    uint64_t scene_timestamp;
+    uint64_t frame_timestamp;
+    // fence of the submission using this region
+    vk::Fence fence;
+    // or the timeline semaphore value it signals
+    uint64_t timeline_value;
+};
+
+// persistently mapped buffer all the textures are uploaded from
+struct TextureStagingRing {
     vkutil::Buffer buffer;
-    uint32_t used_so_far;
-    uint64_t scene_timestamp = ~0;
-    uint64_t frame_timestamp = ~0;
-    vk::Fence waiting_fence;
+    // regions in use, oldest first, they are allocated one after the other in the ring
+    std::deque<StagingRegion> regions;
 };
 
 struct TextureCacheEntry {
     vkutil::Image texture;
     bool is_cube;
+    // the upload uses compute shaders, so it can't be done on the transfer queue
+    bool needs_decoding;
     uint16_t mip_count;
     uint32_t memory_needed;
 };
 
+// push constants of the texture decoding shaders, all the offsets are in bytes in the staging buffer
+struct TextureDecodeInfo {
+    // in blocks for BCn textures
+    uint32_t width;
+    uint32_t height;
+    uint32_t format_id;
+    uint32_t src_offset;
+    uint32_t dst_offset;
+    // P8: offset of the palette, YUV420: offsets of the U and V planes
+    uint32_t extra_offsets[2];
+};
+
+// compute pipelines turning the data in the staging buffer into what is copied to the image
+struct TextureDecoder {
+    vk::DescriptorSetLayout descriptor_set_layout;
+    vk::DescriptorPool descriptor_pool;
+    // bound to the staging ring
+    vk::DescriptorSet descriptor_set;
+    vk::PipelineLayout pipeline_layout;
+    // decode BC1-5 textures, only created if the GPU doesn't support BCn formats
+    vk::Pipeline bcn_pipeline;
+    // expand paletted and YUV420 textures to RGBA8
+    vk::Pipeline expand_pipeline;
+};
+
 struct VKTextureCache : public TextureCache {
     VKState &state;
 
-    TextureStagingBuffer staging_buffers[NB_TEXTURE_STAGING_BUFFERS];
-    uint32_t staging_idx = 0;
+    TextureStagingRing staging_ring;
+    // part of the staging ring reserved for the texture being uploaded
+    uint32_t staging_used_so_far = 0;
+    uint32_t staging_end = 0;
     uint64_t last_waited_scene = 0;
     uint64_t current_scene_timestamp;
 
-    std::array<TextureCacheEntry, TextureCacheSize> textures;
+    // new textures are uploaded using the dedicated transfer queue if there is one
+    bool use_transfer_queue = false;
+    // true if the current texture is uploaded with transfer_cmd
+    bool is_transfer_upload = false;
+    // transfer command being recorded, submitted along the next general queue submission
+    vk::CommandBuffer transfer_cmd = nullptr;
+    vk::Semaphore transfer_semaphore = nullptr;
+
+    // grows along the texture queue, a deque so that current_texture is never invalidated
+    std::deque<TextureCacheEntry> textures;
     std::vector<vk::Sampler> samplers;
 
     TextureCacheEntry *current_texture = nullptr;
@@ -64,15 +134,39 @@ struct VKTextureCache : public TextureCache {
     vk::CommandBuffer cmd_buffer = nullptr;
     bool is_texture_transfer_ready = false;
 
+    // set if the GPU doesn't support BCn textures, they are then stored decoded
+    bool decode_bcn = false;
+    // if the bcn pipeline is null, the BCn textures are decoded on the CPU
+    TextureDecoder texture_decoder;
+
+    // index of the device local heap the texture memory budget is computed from
+    uint32_t device_local_heap = 0;
+
     VKTextureCache(VKState &state);
-    // get an available staging buffer, wait for one if all are busy
+    // reserve some space in the staging ring for the current texture, wait for the GPU if it is full
     void prepare_staging_buffer(bool is_configure = false);
+    // return the offset of a free part of the staging ring of at least size bytes, -1 if there is none
+    int64_t allocate_staging(uint32_t size);
+    void free_staging_regions();
+    // submit everything recorded so far and wait for it to be done, the staging ring is then empty
+    void flush_and_wait();
+    void grow_staging_ring(uint32_t size);
+    void begin_transfer_cmd();
+    // end and submit the transfer command if there is one, return the semaphore the next submission must wait for
+    vk::Semaphore submit_transfer_cmd();
+    void init_texture_decoder();
+    // run one of the texture decoder pipelines on the current staging buffer, decoded_size bytes are written at info.dst_offset
+    void decode_texture(vk::Pipeline pipeline, const TextureDecodeInfo &info, uint32_t group_count_x, uint32_t group_count_y, uint32_t decoded_size);
 
     bool init(const bool hashless_texture_cache, const fs::path &texture_folder, const std::string_view game_id);
+    void cleanup();
+    // compute the memory budget of the textures from the memory the driver allows us to use, called every frame
+    void update_memory_budget();
     void select(size_t index, const SceGxmTexture &texture) override;
     void configure_texture(const SceGxmTexture &texture) override;
     void upload_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride) override;
     void upload_done() override;
+    void release_texture(size_t index) override;
 
     void configure_sampler(size_t index, const SceGxmTexture &texture) override;
 
@@ -89,26 +183,73 @@ struct FrameObject {
     // can be reset if we use too many new textures at once
     vk::CommandPool prerender_pool;
     vk::DescriptorPool descriptor_pool;
+    // texture descriptor sets allocated from descriptor_pool, indexed by the hash of the textures they contain
+    // games tend to use the same textures many times in a frame, they can be bound again without writing a new set
+    unordered_map_fast<uint64_t, vk::DescriptorSet> texture_descriptor_sets;
+    // created on the transfer queue family, only used if there is a dedicated transfer queue
+    vk::CommandPool transfer_pool;
+    std::vector<vk::CommandBuffer> transfer_cmds;
+    std::vector<vk::Semaphore> transfer_semaphores;
+    uint32_t transfer_idx = 0;
+
+    // timestamps written at the beginning and the end of each scene and of each of its render passes, used to measure the GPU time of the frame
+    vk::QueryPool timestamp_pool;
+    uint32_t timestamp_count = 0;
+    // the scenes measured in this frame, in submission order
+    std::vector<SceneTimestamps> scene_timestamps;
+
+    // GXM transfers done on the GPU between the scenes, their fences are only used without timeline semaphore
+    std::vector<vk::CommandBuffer> gxm_transfer_cmds;
+    std::vector<vk::Fence> gxm_transfer_fences;
+    uint32_t gxm_transfer_idx = 0;
 
     std::vector<vk::Fence> rendered_fences;
+    // value signaled by the last submission of this frame, used instead of the fences with timeline semaphores
+    uint64_t last_timeline_value = 0;
     // equals to context.frame_timestamp when the frame object is used
     uint64_t frame_timestamp;
 
-    // destroy gpu objects MAX_FRAMES_RENDERING frames later to make sure they are no longer being used
+    // destroy gpu objects frames_in_flight frames later to make sure they are no longer being used
     vkutil::DestroyQueue destroy_queue;
 };
 
+// pick the resolution multiplier of the next render targets from the GPU time of the last frames
+struct DynamicResolution {
+    int min_multiplier = 1;
+    // GPU time budget of a frame, in milliseconds
+    float target_frame_time = 0.f;
+    // moving average of the GPU frame time, 0 while the current multiplier has not been measured
+    float average_frame_time = 0.f;
+    // used as soon as no render target is alive anymore
+    int desired_multiplier = 1;
+    // frames measured since the average was reset or the desired multiplier changed
+    uint32_t stable_frames = 0;
+    // lower the highest multiplier when the host device heats up
+    bool thermal_governor = false;
+};
+
 struct MappedMemoryBuffer {
     vk::DeviceMemory memory;
     vk::Buffer buffer;
 };
 
 struct MappedMemory {
+    // guest address of the start of the buffer, 0 for the blocks bound to the mapped heap
     Address address;
     std::variant<vk::DeviceMemory, vkutil::Buffer> buffer_impl;
     vk::Buffer buffer;
     uint32_t size;
     uint64_t buffer_address;
+    // allocated in the device-local heap instead of the host memory
+    bool device_local = false;
+};
+
+struct MappedHeap {
+    vk::Buffer buffer;
+    uint64_t buffer_address = 0;
+    // sparse block size, the blocks not aligned on it get their own buffer
+    uint64_t alignment = 0;
+    uint32_t memory_type_bits = 0;
 };
 
 struct ColorSurfaceCacheInfo;
@@ -120,7 +261,28 @@ struct VisibilityBuffer {
     uint64_t buffer_offset;
     uint32_t size;
     vk::QueryPool query_pool;
-    std::vector<bool> queries_used; // the queries that were used in the current scene
+    // bitset of the queries that were used in the current scene
+    std::vector<uint64_t> queries_used;
+
+    bool is_query_used(uint32_t idx) const {
+        return (queries_used[idx / 64] >> (idx % 64)) & 1;
+    }
+
+    void set_query_used(uint32_t idx) {
+        queries_used[idx / 64] |= 1ULL << (idx % 64);
+    }
+
+    // first query at or after from and before end which is used (or unused), end if there is none
+    uint32_t find_query(uint32_t from, uint32_t end, bool used) const {
+        while (from < end) {
+            uint64_t word = used ? queries_used[from / 64] : ~queries_used[from / 64];
+            word &= ~0ULL << (from % 64);
+            if (word != 0)
+                return std::min(end, from / 64 * 64 + static_cast<uint32_t>(std::countr_zero(word)));
+            from = (from / 64 + 1) * 64;
+        }
+        return end;
+    }
 };
 
 struct FenceWaitRequest {
@@ -128,8 +290,10 @@ struct FenceWaitRequest {
 };
 
 // request to trigger a notification after the previous fences have been waited for
+// or after the timeline semaphore has reached timeline_value
 struct NotificationRequest {
     SceGxmNotification notifications[2];
+    uint64_t timeline_value = 0;
 };
 
 struct FrameDoneRequest {
@@ -138,6 +302,7 @@ struct FrameDoneRequest {
 
 struct PostSurfaceSyncRequest {
     ColorSurfaceCacheInfo *cache_info;
+    uint64_t timeline_value = 0;
 };
 
 // A parallel thread is handling these request and telling other waiting threads
@@ -145,6 +310,25 @@ struct PostSurfaceSyncRequest {
 // only used if memory mapping is enabled
 typedef std::variant<FenceWaitRequest, NotificationRequest, FrameDoneRequest, PostSurfaceSyncRequest> WaitThreadRequest;
 
+// everything bound by a draw before it is recorded
+// consecutive draws with the same state can be recorded as a single indirect draw
+struct DrawState {
+    vk::PipelineLayout pipeline_layout;
+    std::array<vk::DescriptorSet, 4> descriptors;
+    uint32_t dynamic_offset_count;
+    std::array<uint32_t, 4> dynamic_offsets;
+
+    uint32_t vertex_stream_count;
+    std::array<vk::Buffer, SCE_GXM_MAX_VERTEX_STREAMS> vertex_buffers;
+    std::array<vk::DeviceSize, SCE_GXM_MAX_VERTEX_STREAMS> vertex_offsets;
+
+    vk::Buffer index_buffer;
+    vk::DeviceSize index_offset;
+    vk::IndexType index_type;
+
+    bool operator==(const DrawState &) const = default;
+};
+
 struct VKContext : public renderer::Context {
     // GXM Context Info
     VKState &state;
@@ -164,6 +348,8 @@ struct VKContext : public renderer::Context {
     vkutil::HostRingBuffer fragment_uniform_stream_ring_buffer;
     vkutil::HostRingBuffer vertex_info_uniform_buffer;
     vkutil::HostRingBuffer fragment_info_uniform_buffer;
+    // only used with draw batching
+    vkutil::HostRingBuffer indirect_draw_buffer;
 
     vk::DescriptorImageInfo vertex_textures[SCE_GXM_MAX_TEXTURE_UNITS] = {};
     vk::DescriptorImageInfo fragment_textures[SCE_GXM_MAX_TEXTURE_UNITS] = {};
@@ -174,8 +360,21 @@ struct VKContext : public renderer::Context {
     vk::Buffer vertex_stream_buffers[SCE_GXM_MAX_VERTEX_STREAMS];
     vk::DeviceSize vertex_stream_offsets[SCE_GXM_MAX_VERTEX_STREAMS] = {};
 
+    // state bound by the last draw recorded and draws using it which have not been recorded yet
+    DrawState bound_draw_state;
+    std::vector<vk::DrawIndexedIndirectCommand> pending_draws;
+    // draws done by the game and draw commands recorded during the current frame
+    uint32_t frame_draw_count = 0;
+    uint32_t frame_draw_command_count = 0;
+    // render passes begun during the current frame and attachment loads and stores they skipped
+    uint32_t frame_render_pass_count = 0;
+    uint32_t frame_elided_load_count = 0;
+    uint32_t frame_elided_store_count = 0;
+
+    // base blocks last pushed as push constants, they must be pushed again in each new command buffer
     shader::RenderVertUniformBlock prev_vert_ublock;
     shader::RenderFragUniformBlock prev_frag_ublock;
+    bool render_info_pushed = false;
 
     shader::RenderVertUniformBlockExtended curr_vert_ublock;
     shader::RenderFragUniformBlockExtended curr_frag_ublock;
@@ -184,13 +383,23 @@ struct VKContext : public renderer::Context {
     uint8_t shader_info_temp[std::max(shader::RenderVertUniformBlockExtended::get_max_size(), shader::RenderFragUniformBlockExtended::get_max_size())];
 
     // used to implement the Visibility Buffer
-    std::map<Address, VisibilityBuffer> visibility_buffers;
+    // node based so current_visibility_buffer stays valid when a new buffer is added
+    std::unordered_map<Address, VisibilityBuffer> visibility_buffers;
     VisibilityBuffer *current_visibility_buffer = nullptr;
     int visibility_max_used_idx = -1;
     bool is_in_query = false;
     int current_query_idx = -1;
     bool is_query_op_increment = false;
 
+    // the current recording is measured, its timestamps are the last ones of frame().scene_timestamps
+    bool is_timing_scene = false;
+    // a timestamp has been written before the current render pass, its end has to be written too
+    bool is_timing_render_pass = false;
+#ifdef TRACY_ENABLE
+    // timeline of the scenes on the GPU, only created once a profiler is connected
+    std::optional<TracyGpuContext> tracy_gpu_context;
+#endif
+
     // descriptor pool for dynamic uniforms (allocated once for the whole game)
     vk::DescriptorPool global_descriptor_pool;
     // we will use this descriptor set for all the draws
@@ -210,6 +419,11 @@ struct VKContext : public renderer::Context {
     SceGxmPrimitiveType last_primitive;
 
     vk::RenderPass current_render_pass;
+    // without color surface, the color attachment is neither loaded nor stored
+    bool discard_color = false;
+    // attachments not loaded or not stored by current_render_pass
+    uint8_t current_pass_elided_loads = 0;
+    uint8_t current_pass_elided_stores = 0;
     vk::RenderPass current_shader_interlock_pass = nullptr;
     vk::Pipeline current_pipeline;
 
@@ -231,6 +445,10 @@ struct VKContext : public renderer::Context {
     vk::CommandBuffer prerender_cmd{};
     // next fence to be used to wait for the current scene
     vk::Fence next_fence{};
+    // used instead of the fences if VK_KHR_timeline_semaphore is supported
+    // each submission signals the value following the one of the previous submission
+    vk::Semaphore timeline_semaphore{};
+    uint64_t last_timeline_value = 0;
     VKRenderTarget *cmd_target = nullptr;
 
     // used for macroblock sync emulation
@@ -261,15 +479,29 @@ struct VKContext : public renderer::Context {
     ~VKContext() override = default;
 
     void start_recording();
+    // set current_render_pass for the depth-stencil operations of the scene
+    void select_render_pass(bool force_load, bool force_store);
     void start_render_pass(bool create_descriptor_set = true);
     void stop_render_pass();
     void stop_recording(const SceGxmNotification &notif1, const SceGxmNotification &notif2, bool submit = true);
+    // record the draws waiting to be merged, must be called before anything else is recorded in render_cmd
+    void flush_pending_draws();
+
+    // submit to the general queue, signaling either next_fence or the next timeline value
+    void submit(vk::SubmitInfo &submit_info);
+    // wait for the submission which signaled this fence or timeline value
+    void wait_for_submission(vk::Fence fence, uint64_t timeline_value);
+
+    // return a command buffer for the GXM transfers, it is render_cmd (outside of the render pass) during a scene
+    vk::CommandBuffer start_transfer_recording();
+    // submit the command buffer returned by start_transfer_recording if it was not render_cmd
+    void stop_transfer_recording(vk::CommandBuffer cmd_buffer);
 
     // check (when the render target has macroblock set) if we are drawing to another block
     void check_for_macroblock_change(bool is_draw);
 
 private:
-    void wait_thread_function(const MemState &mem);
+    void wait_thread_function(MemState &mem);
 };
 
 struct VKRenderTarget : public renderer::RenderTarget {
@@ -24,19 +24,76 @@
 #include <renderer/vulkan/types.h>
 
 #include <config/state.h>
-#include <functional>
 #include <util/log.h>
 #include <util/string_utils.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 struct FeatureState;
 
 namespace renderer {
-Command *generic_command_allocate() {
-    return new Command;
+// Commands created by the host are allocated from slabs which are never given back to the system.
+// A freed command is pushed on recycled_commands (usually by the renderer thread), producer threads
+// then take the whole list at once and keep it as a thread-local free list, so no lock is needed.
+static constexpr size_t command_slab_size = 256;
+
+static std::mutex command_slabs_mutex;
+static std::vector<std::unique_ptr<Command[]>> command_slabs;
+static std::atomic<Command *> recycled_commands = nullptr;
+static thread_local Command *free_commands = nullptr;
+
+static std::atomic<size_t> commands_in_flight = 0;
+static std::atomic<size_t> peak_commands_in_flight = 0;
+
+Command *generic_command_allocate(const size_t data_size) {
+    if (data_size > MAX_COMMAND_DATA_SIZE) {
+        LOG_ERROR("Command payload of {} bytes is too big for a generic command", data_size);
+        return nullptr;
+    }
+
+    if (!free_commands)
+        free_commands = recycled_commands.exchange(nullptr, std::memory_order_acquire);
+
+    if (!free_commands) {
+        auto slab = std::make_unique<Command[]>(command_slab_size);
+        for (size_t i = 0; i < command_slab_size - 1; i++)
+            slab[i].next = &slab[i + 1];
+        free_commands = slab.get();
+
+        const std::lock_guard<std::mutex> lock(command_slabs_mutex);
+        command_slabs.push_back(std::move(slab));
+        LOG_DEBUG("Allocated command slab {} (peak of {} commands in flight)", command_slabs.size(), peak_commands_in_flight.load());
+    }
+
+    Command *cmd = free_commands;
+    free_commands = cmd->next;
+    cmd->flags = 0;
+    cmd->next = nullptr;
+
+    const size_t in_flight = commands_in_flight.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t peak = peak_commands_in_flight.load(std::memory_order_relaxed);
+    while (in_flight > peak && !peak_commands_in_flight.compare_exchange_weak(peak, in_flight, std::memory_order_relaxed)) {
+    }
+
+    return cmd;
 }
 
 void generic_command_free(Command *cmd) {
-    delete cmd;
+    commands_in_flight.fetch_sub(1, std::memory_order_relaxed);
+
+    cmd->next = recycled_commands.load(std::memory_order_relaxed);
+    while (!recycled_commands.compare_exchange_weak(cmd->next, cmd, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+size_t get_peak_commands_in_flight() {
+    return peak_commands_in_flight.load(std::memory_order_relaxed);
 }
 
 void complete_command(State &state, CommandHelper &helper, const int code) {
@@ -56,41 +113,39 @@ bool is_cmd_ready(MemState &mem, CommandList &command_list) {
     return sync->timestamp_current >= timestamp;
 }
 
-bool wait_cmd(MemState &mem, CommandList &command_list) {
-    // we assume here that the cmd starts with a WaitSyncObject
-
-    SceGxmSyncObject *sync = reinterpret_cast<Ptr<SceGxmSyncObject> *>(&command_list.first->data[0])->get(mem);
-    const uint32_t timestamp = *reinterpret_cast<uint32_t *>(&command_list.first->data[sizeof(uint32_t) + 2 * sizeof(void *)]);
-
-    // wait 500 micro secibds and then return in case should_display is set to true
-    return renderer::wishlist(sync, timestamp, 500);
-}
+using CommandHandlerFunc = decltype(cmd_handle_set_context);
+using CommandHandlerTable = std::array<CommandHandlerFunc *, static_cast<size_t>(CommandOpcode::Count)>;
+
+// handlers indexed by opcode, this is called for every command so avoid any lookup
+static constexpr CommandHandlerTable command_handlers = [] {
+    CommandHandlerTable handlers{};
+    handlers[static_cast<size_t>(CommandOpcode::SetContext)] = cmd_handle_set_context;
+    handlers[static_cast<size_t>(CommandOpcode::SyncSurfaceData)] = cmd_handle_sync_surface_data;
+    handlers[static_cast<size_t>(CommandOpcode::MidSceneFlush)] = cmd_handle_mid_scene_flush;
+    handlers[static_cast<size_t>(CommandOpcode::CreateContext)] = cmd_handle_create_context;
+    handlers[static_cast<size_t>(CommandOpcode::CreateRenderTarget)] = cmd_handle_create_render_target;
+    handlers[static_cast<size_t>(CommandOpcode::MemoryMap)] = cmd_handle_memory_map;
+    handlers[static_cast<size_t>(CommandOpcode::MemoryUnmap)] = cmd_handle_memory_unmap;
+    handlers[static_cast<size_t>(CommandOpcode::Draw)] = cmd_handle_draw;
+    handlers[static_cast<size_t>(CommandOpcode::DrawPrecomputed)] = cmd_handle_draw_precomputed;
+    handlers[static_cast<size_t>(CommandOpcode::TransferCopy)] = cmd_handle_transfer_copy;
+    handlers[static_cast<size_t>(CommandOpcode::TransferDownscale)] = cmd_handle_transfer_downscale;
+    handlers[static_cast<size_t>(CommandOpcode::TransferFill)] = cmd_handle_transfer_fill;
+    handlers[static_cast<size_t>(CommandOpcode::Nop)] = cmd_handle_nop;
+    handlers[static_cast<size_t>(CommandOpcode::SetState)] = cmd_handle_set_state;
+    handlers[static_cast<size_t>(CommandOpcode::SignalSyncObject)] = cmd_handle_signal_sync_object;
+    handlers[static_cast<size_t>(CommandOpcode::WaitSyncObject)] = cmd_handle_wait_sync_object;
+    handlers[static_cast<size_t>(CommandOpcode::SignalNotification)] = cmd_handle_notification;
+    handlers[static_cast<size_t>(CommandOpcode::NewFrame)] = cmd_new_frame;
+    handlers[static_cast<size_t>(CommandOpcode::DestroyRenderTarget)] = cmd_handle_destroy_render_target;
+    handlers[static_cast<size_t>(CommandOpcode::DestroyContext)] = cmd_handle_destroy_context;
+    return handlers;
+}();
+
+static_assert(std::ranges::none_of(command_handlers, [](CommandHandlerFunc *handler) { return handler == nullptr; }),
+    "Every command opcode must have a handler");
 
 void process_batch(renderer::State &state, const FeatureState &features, MemState &mem, Config &config, CommandList &command_list) {
-    using CommandHandlerFunc = decltype(cmd_handle_set_context);
-
-    const static std::map<CommandOpcode, CommandHandlerFunc *> handlers = {
-        { CommandOpcode::SetContext, cmd_handle_set_context },
-        { CommandOpcode::SyncSurfaceData, cmd_handle_sync_surface_data },
-        { CommandOpcode::MidSceneFlush, cmd_handle_mid_scene_flush },
-        { CommandOpcode::CreateContext, cmd_handle_create_context },
-        { CommandOpcode::CreateRenderTarget, cmd_handle_create_render_target },
-        { CommandOpcode::MemoryMap, cmd_handle_memory_map },
-        { CommandOpcode::MemoryUnmap, cmd_handle_memory_unmap },
-        { CommandOpcode::Draw, cmd_handle_draw },
-        { CommandOpcode::TransferCopy, cmd_handle_transfer_copy },
-        { CommandOpcode::TransferDownscale, cmd_handle_transfer_downscale },
-        { CommandOpcode::TransferFill, cmd_handle_transfer_fill },
-        { CommandOpcode::Nop, cmd_handle_nop },
-        { CommandOpcode::SetState, cmd_handle_set_state },
-        { CommandOpcode::SignalSyncObject, cmd_handle_signal_sync_object },
-        { CommandOpcode::WaitSyncObject, cmd_handle_wait_sync_object },
-        { CommandOpcode::SignalNotification, cmd_handle_notification },
-        { CommandOpcode::NewFrame, cmd_new_frame },
-        { CommandOpcode::DestroyRenderTarget, cmd_handle_destroy_render_target },
-        { CommandOpcode::DestroyContext, cmd_handle_destroy_context }
-    };
-
     Command *cmd = command_list.first;
 
     // Take a batch, and execute it. Hope it's not too large
@@ -99,12 +154,18 @@ void process_batch(renderer::State &state, const FeatureState &features, MemStat
             break;
         }
 
-        auto handler = handlers.find(cmd->opcode);
-        if (handler == handlers.end()) {
-            LOG_ERROR("Unimplemented command opcode {}", static_cast<int>(cmd->opcode));
+        const size_t opcode = static_cast<size_t>(cmd->opcode);
+        if (opcode >= command_handlers.size()) {
+            LOG_ERROR("Unimplemented command opcode {}", opcode);
         } else {
+            if (state.capture)
+                capture::record_command(*state.capture, state, mem, *cmd, command_list.context);
+
             CommandHelper helper(cmd);
-            handler->second(state, mem, config, helper, features, command_list.context, state.cache_path.c_str(), state.title_id, state.self_name);
+            command_handlers[opcode](state, mem, config, helper, features, command_list.context, state.cache_path.c_str(), state.title_id, state.self_name);
+
+            if (state.capture)
+                capture::command_done(*state.capture, *cmd);
         }
 
         Command *last_cmd = cmd;
@@ -120,8 +181,7 @@ void process_batch(renderer::State &state, const FeatureState &features, MemStat
 
 void process_batches(renderer::State &state, const FeatureState &features, MemState &mem, Config &config) {
     while (!state.should_display) {
-        // Try to wait for a batch (about 2 or 3ms, game should be fast for this)
-        auto cmd_list = state.command_buffer_queue.top(3);
+        CommandList *cmd_list = state.command_buffer_queue.front();
 
         if (!cmd_list || !is_cmd_ready(mem, *cmd_list)) {
             // beginning of the game or homebrew not using gxm
@@ -132,13 +192,24 @@ void process_batches(renderer::State &state, const FeatureState &features, MemSt
             if (state.current_backend == Backend::OpenGL && config.current_config.v_sync)
                 return;
 
-            if (!cmd_list || !wait_cmd(mem, *cmd_list))
-                // this mean the command is still not ready, check if we can display it again
-                continue;
+            // sleep until a command list is submitted, a sync object is signaled or the frame has to be displayed
+            // the state is checked again after prepare_wait so that a wake up done in between is not lost
+            const uint32_t key = state.wake_up.prepare_wait();
+            cmd_list = state.command_buffer_queue.front();
+            if (state.should_display || (cmd_list && is_cmd_ready(mem, *cmd_list)))
+                state.wake_up.cancel_wait();
+            else
+                state.wake_up.wait(key);
+            continue;
         }
 
+        // the slot can be reused as soon as it is popped
+        CommandList command_list = *cmd_list;
         state.command_buffer_queue.pop();
-        process_batch(state, features, mem, config, *cmd_list);
+        // the waits for the command lists are not counted
+        const auto start = std::chrono::steady_clock::now();
+        process_batch(state, features, mem, config, command_list);
+        state.process_batches_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
     }
 }
 
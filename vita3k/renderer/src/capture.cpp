@@ -0,0 +1,577 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/capture.h>
+
+#include <renderer/state.h>
+#include <renderer/types.h>
+
+#include <gxm/functions.h>
+#include <mem/functions.h>
+#include <util/log.h>
+
+#include <xxh3.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace renderer::capture {
+
+static constexpr char MAGIC[4] = { 'V', '3', 'K', 'C' };
+
+template <typename T>
+static void append(std::vector<uint8_t> &payload, const T &value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+
+// the payloads are packed, the values are not aligned
+template <typename T>
+static T read_at(const std::vector<uint8_t> &payload, const size_t offset) {
+    T value{};
+    if (offset + sizeof(T) <= payload.size())
+        memcpy(&value, payload.data() + offset, sizeof(T));
+    return value;
+}
+
+// the states which are set separately for each side, texture, stream or uniform buffer get one key for each
+static uint64_t get_state_key(const std::vector<uint8_t> &payload) {
+    const GXMState state = read_at<GXMState>(payload, 0);
+    constexpr size_t args = sizeof(GXMState);
+
+    uint64_t sub_key = 0;
+    switch (state) {
+    case GXMState::Program:
+        sub_key = read_at<bool>(payload, args + sizeof(Ptr<const void>));
+        break;
+    case GXMState::UniformBuffer:
+        sub_key = (read_at<bool>(payload, args + sizeof(Ptr<uint8_t>)) << 8) | static_cast<uint8_t>(read_at<int>(payload, args + sizeof(Ptr<uint8_t>) + sizeof(bool)));
+        break;
+    case GXMState::Texture:
+        sub_key = read_at<uint32_t>(payload, args);
+        break;
+    case GXMState::VertexStream:
+        sub_key = read_at<size_t>(payload, args + sizeof(Ptr<const uint8_t>));
+        break;
+    case GXMState::DepthBias:
+    case GXMState::DepthFunc:
+    case GXMState::DepthWriteEnable:
+    case GXMState::PolygonMode:
+    case GXMState::PointLineWidth:
+    case GXMState::StencilFunc:
+    case GXMState::StencilRef:
+    case GXMState::FragmentProgramEnable:
+        sub_key = read_at<bool>(payload, args);
+        break;
+    default:
+        break;
+    }
+
+    return (static_cast<uint64_t>(state) << 32) | sub_key;
+}
+
+static void write_record(Writer &writer, const Record &record, const void *data) {
+    writer.file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    if (record.data_size > 0)
+        writer.file.write(static_cast<const char *>(data), record.data_size);
+}
+
+static bool is_valid_range(MemState &mem, const Address address, const uint32_t size) {
+    return address != 0 && size != 0 && size <= std::numeric_limits<Address>::max() - address
+        && is_valid_addr_range(mem, address, address + size);
+}
+
+// write the content of the guest memory range, unless the capture already has this content for it
+static void write_memory(Writer &writer, MemState &mem, const Address address, const uint32_t size) {
+    if (!is_valid_range(mem, address, size))
+        return;
+
+    const uint8_t *data = Ptr<const uint8_t>(address).get(mem);
+    const uint64_t hash = XXH3_64bits(data, size);
+    auto &last = writer.memory_hashes[address];
+    if (last.first == size && last.second == hash)
+        return;
+    last = { size, hash };
+
+    write_record(writer, Record{ .type = RecordType::Memory, .address = address, .size = size, .data_size = size }, data);
+}
+
+static void write_allocation(Writer &writer, const Address address, const uint32_t size) {
+    if (address != 0 && size != 0)
+        write_record(writer, Record{ .type = RecordType::Allocation, .address = address, .size = size }, nullptr);
+}
+
+static void write_transfer_image(Writer &writer, MemState &mem, const SceGxmTransferImage &image) {
+    if (image.height == 0)
+        return;
+
+    // the rows go towards the lower addresses with a negative stride, only full rows are captured
+    const int64_t first_row = image.stride >= 0 ? image.y : image.y + image.height - 1;
+    const Address start = static_cast<Address>(image.address.address() + first_row * image.stride);
+    write_memory(writer, mem, start, image.height * static_cast<uint32_t>(std::abs(image.stride)));
+}
+
+static void write_texture(Writer &writer, MemState &mem, const SceGxmTexture &texture) {
+    write_memory(writer, mem, texture.data_addr << 2, gxm::texture_size_full(texture));
+
+    switch (gxm::get_base_format(gxm::get_format(texture))) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
+        write_memory(writer, mem, texture.palette_addr << 6, 16 * sizeof(uint32_t));
+        break;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
+        write_memory(writer, mem, texture.palette_addr << 6, 256 * sizeof(uint32_t));
+        break;
+    default:
+        break;
+    }
+}
+
+// write the program object and its program, unless the capture already has this object at this address
+static void write_program(Writer &writer, MemState &mem, const Ptr<const void> object, const bool is_fragment) {
+    const Address address = object.address();
+    if (!is_valid_range(mem, address, is_fragment ? sizeof(SceGxmFragmentProgram) : sizeof(SceGxmVertexProgram)))
+        return;
+
+    if (is_fragment) {
+        const SceGxmFragmentProgram &program = *object.cast<const SceGxmFragmentProgram>().get(mem);
+        if (!program.renderer_data || writer.programs[address] == program.renderer_data.get())
+            return;
+        writer.programs[address] = program.renderer_data.get();
+
+        write_memory(writer, mem, program.program.address(), program.program.get(mem)->size);
+        const FragmentProgram data{
+            .program = program.program,
+            .is_maskupdate = program.is_maskupdate,
+            .has_blend = program.renderer_data->has_blend,
+            .blend = program.renderer_data->blend
+        };
+        write_record(writer, Record{ .type = RecordType::FragmentProgram, .address = address, .data_size = sizeof(data) }, &data);
+    } else {
+        const SceGxmVertexProgram &program = *object.cast<const SceGxmVertexProgram>().get(mem);
+        if (!program.renderer_data || writer.programs[address] == program.renderer_data.get())
+            return;
+        writer.programs[address] = program.renderer_data.get();
+
+        write_memory(writer, mem, program.program.address(), program.program.get(mem)->size);
+        std::vector<uint8_t> data;
+        append(data, VertexProgram{
+                         .program = program.program,
+                         .stream_count = static_cast<uint32_t>(program.streams.size()),
+                         .attribute_count = static_cast<uint32_t>(program.attributes.size()),
+                         .key_hash = program.key_hash,
+                     });
+        for (const SceGxmVertexStream &stream : program.streams)
+            append(data, stream);
+        for (const SceGxmVertexAttribute &attribute : program.attributes)
+            append(data, attribute);
+        write_record(writer, Record{ .type = RecordType::VertexProgram, .address = address, .data_size = static_cast<uint32_t>(data.size()) }, data.data());
+    }
+}
+
+// write the guest memory and the programs the command reads, payload is the portable one
+static void write_referenced_memory(Writer &writer, MemState &mem, const CommandOpcode opcode, const std::vector<uint8_t> &payload, Context *context) {
+    switch (opcode) {
+    case CommandOpcode::MemoryMap:
+        write_allocation(writer, read_at<Address>(payload, 0), read_at<uint32_t>(payload, sizeof(Ptr<void>)));
+        break;
+
+    case CommandOpcode::SetContext:
+        if (read_at<uint8_t>(payload, sizeof(uint32_t))) {
+            const SceGxmColorSurface surface = read_at<SceGxmColorSurface>(payload, sizeof(uint32_t) + 1);
+            if (!surface.disabled)
+                write_memory(writer, mem, surface.data.address(), surface.height * gxm::get_stride_in_bytes(surface.colorFormat, surface.strideInPixels));
+        }
+        break;
+
+    case CommandOpcode::Draw: {
+        constexpr size_t indices_offset = sizeof(SceGxmPrimitiveType) + sizeof(SceGxmIndexFormat);
+        const SceGxmIndexFormat format = read_at<SceGxmIndexFormat>(payload, sizeof(SceGxmPrimitiveType));
+        const Ptr<const void> indices = read_at<Ptr<const void>>(payload, indices_offset);
+        const uint32_t count = read_at<uint32_t>(payload, indices_offset + sizeof(Ptr<const void>));
+        write_memory(writer, mem, indices.address(), count * gxm::index_element_size(format));
+
+        if (context) {
+            for (const GXMStreamInfo &stream : context->record.vertex_streams)
+                write_memory(writer, mem, stream.data.address(), static_cast<uint32_t>(stream.size));
+        }
+        break;
+    }
+
+    case CommandOpcode::TransferCopy: {
+        constexpr size_t images_offset = 2 * sizeof(uint32_t) + sizeof(SceGxmTransferColorKeyMode);
+        write_transfer_image(writer, mem, read_at<SceGxmTransferImage>(payload, images_offset));
+        write_transfer_image(writer, mem, read_at<SceGxmTransferImage>(payload, images_offset + sizeof(SceGxmTransferImage)));
+        break;
+    }
+
+    case CommandOpcode::TransferDownscale:
+        write_transfer_image(writer, mem, read_at<SceGxmTransferImage>(payload, 0));
+        write_transfer_image(writer, mem, read_at<SceGxmTransferImage>(payload, sizeof(SceGxmTransferImage)));
+        break;
+
+    case CommandOpcode::TransferFill:
+        write_transfer_image(writer, mem, read_at<SceGxmTransferImage>(payload, sizeof(uint32_t)));
+        break;
+
+    case CommandOpcode::SyncSurfaceData:
+        write_allocation(writer, read_at<SceGxmNotification>(payload, 0).address.address(), sizeof(uint32_t));
+        write_allocation(writer, read_at<SceGxmNotification>(payload, sizeof(SceGxmNotification)).address.address(), sizeof(uint32_t));
+        break;
+
+    case CommandOpcode::MidSceneFlush:
+    case CommandOpcode::SignalNotification:
+        write_allocation(writer, read_at<SceGxmNotification>(payload, 0).address.address(), sizeof(uint32_t));
+        break;
+
+    case CommandOpcode::SetState: {
+        constexpr size_t args = sizeof(GXMState);
+        switch (read_at<GXMState>(payload, 0)) {
+        case GXMState::Program:
+            write_program(writer, mem, read_at<Ptr<const void>>(payload, args), read_at<bool>(payload, args + sizeof(Ptr<const void>)));
+            break;
+        case GXMState::UniformBuffer:
+            write_memory(writer, mem, read_at<Address>(payload, args), read_at<uint32_t>(payload, args + sizeof(Ptr<uint8_t>) + sizeof(bool) + sizeof(int)));
+            break;
+        case GXMState::Texture:
+            write_texture(writer, mem, read_at<SceGxmTexture>(payload, args + sizeof(uint32_t)));
+            break;
+        default:
+            break;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+static void write_command(Writer &writer, MemState &mem, const CommandOpcode opcode, const bool has_status, const uint32_t context_id,
+    const std::vector<uint8_t> &payload, Context *context) {
+    write_referenced_memory(writer, mem, opcode, payload, context);
+    write_record(writer,
+        Record{
+            .type = RecordType::Command,
+            .opcode = opcode,
+            .has_status = has_status,
+            .context_id = context_id,
+            .data_size = static_cast<uint32_t>(payload.size()),
+        },
+        payload.data());
+}
+
+static uint32_t find_id(const std::unordered_map<const void *, uint32_t> &ids, const void *key) {
+    const auto it = ids.find(key);
+    return it == ids.end() ? 0 : it->second;
+}
+
+static void forget_id(Writer &writer, const void *slot) {
+    const uint32_t id = find_id(writer.slot_ids, slot);
+    writer.slot_ids.erase(slot);
+    std::erase_if(writer.object_ids, [id](const auto &entry) { return entry.second == id; });
+    writer.contexts.erase(id);
+    writer.render_targets.erase(id);
+}
+
+// replace the host pointers of the payload by ids or by the data they point to
+static std::vector<uint8_t> encode_payload(Writer &writer, const Command &cmd) {
+    CommandHelper helper(const_cast<Command *>(&cmd));
+    std::vector<uint8_t> payload;
+
+    switch (cmd.opcode) {
+    case CommandOpcode::CreateContext:
+    case CommandOpcode::CreateRenderTarget: {
+        // the object is only known once created, see command_done
+        const void *slot = helper.pop<void *>();
+        const uint32_t id = writer.next_id++;
+        writer.slot_ids[slot] = id;
+        append(payload, id);
+        if (cmd.opcode == CommandOpcode::CreateRenderTarget)
+            append(payload, *helper.pop<SceGxmRenderTargetParams *>());
+        break;
+    }
+
+    case CommandOpcode::DestroyContext:
+    case CommandOpcode::DestroyRenderTarget:
+        append(payload, find_id(writer.slot_ids, helper.pop<void *>()));
+        break;
+
+    case CommandOpcode::SetContext: {
+        append(payload, find_id(writer.object_ids, helper.pop<RenderTarget *>()));
+        const SceGxmColorSurface *color_surface = helper.pop<SceGxmColorSurface *>();
+        const SceGxmDepthStencilSurface *depth_stencil_surface = helper.pop<SceGxmDepthStencilSurface *>();
+        append<uint8_t>(payload, color_surface != nullptr);
+        append(payload, color_surface ? *color_surface : SceGxmColorSurface{});
+        append<uint8_t>(payload, depth_stencil_surface != nullptr);
+        append(payload, depth_stencil_surface ? *depth_stencil_surface : SceGxmDepthStencilSurface{});
+        break;
+    }
+
+    case CommandOpcode::TransferCopy: {
+        append(payload, helper.pop<uint32_t>());
+        append(payload, helper.pop<uint32_t>());
+        append(payload, helper.pop<SceGxmTransferColorKeyMode>());
+        const SceGxmTransferImage *images = helper.pop<SceGxmTransferImage *>();
+        append(payload, images[0]);
+        append(payload, images[1]);
+        append(payload, helper.pop<SceGxmTransferType>());
+        append(payload, helper.pop<SceGxmTransferType>());
+        break;
+    }
+
+    case CommandOpcode::TransferDownscale:
+        append(payload, *helper.pop<SceGxmTransferImage *>());
+        append(payload, *helper.pop<SceGxmTransferImage *>());
+        break;
+
+    case CommandOpcode::TransferFill:
+        append(payload, helper.pop<uint32_t>());
+        append(payload, *helper.pop<SceGxmTransferImage *>());
+        break;
+
+    case CommandOpcode::SyncSurfaceData:
+        // the surface given with a status is a host one, these commands are not replayed
+        append(payload, helper.pop<SceGxmNotification>());
+        append(payload, helper.pop<SceGxmNotification>());
+        break;
+
+    default:
+        payload.assign(cmd.data, cmd.data + cmd.size);
+        break;
+    }
+
+    return payload;
+}
+
+// the replay only handles small payloads, a precomputed draw is recorded as the commands it replaces
+static void record_precomputed_draw(Writer &writer, MemState &mem, const Command &cmd, const uint32_t context_id, Context *context) {
+    CommandHelper helper(const_cast<Command *>(&cmd));
+    const uint8_t uniform_buffer_count = helper.pop<uint8_t>();
+    const uint8_t texture_count = helper.pop<uint8_t>();
+    const uint8_t vertex_stream_count = helper.pop<uint8_t>();
+
+    // the states are stored with the payload of their SetState command
+    const auto record_state = [&](const GXMState state, const size_t args_size) {
+        std::vector<uint8_t> payload;
+        append(payload, state);
+        payload.insert(payload.end(), cmd.data + helper.point, cmd.data + helper.point + args_size);
+        helper.point += static_cast<uint32_t>(args_size);
+
+        if (writer.file.is_open())
+            write_command(writer, mem, CommandOpcode::SetState, false, context_id, payload, context);
+        if (writer.contexts.contains(context_id))
+            writer.contexts[context_id].states[get_state_key(payload)] = payload;
+        return payload;
+    };
+
+    for (int i = 0; i < 2; i++)
+        record_state(GXMState::Program, sizeof(Ptr<const void>) + sizeof(bool));
+    for (uint8_t i = 0; i < uniform_buffer_count; i++)
+        record_state(GXMState::UniformBuffer, sizeof(Ptr<uint8_t>) + sizeof(bool) + sizeof(int) + sizeof(uint32_t));
+    for (uint8_t i = 0; i < texture_count; i++)
+        record_state(GXMState::Texture, sizeof(uint32_t) + sizeof(SceGxmTexture));
+    for (uint8_t i = 0; i < vertex_stream_count; i++) {
+        // the streams of the context are only set once the command is processed, write their memory here
+        const std::vector<uint8_t> payload = record_state(GXMState::VertexStream, sizeof(Ptr<const uint8_t>) + 2 * sizeof(size_t));
+        if (writer.file.is_open())
+            write_memory(writer, mem, read_at<Address>(payload, sizeof(GXMState)), static_cast<uint32_t>(read_at<size_t>(payload, sizeof(GXMState) + sizeof(Ptr<const uint8_t>) + sizeof(size_t))));
+    }
+
+    if (writer.file.is_open()) {
+        const std::vector<uint8_t> payload(cmd.data + helper.point, cmd.data + cmd.size);
+        write_command(writer, mem, CommandOpcode::Draw, false, context_id, payload, context);
+    }
+}
+
+// open the file and write the commands recreating the objects and states used by the next commands
+static bool start(Writer &writer, State &state, MemState &mem) {
+    writer.file.open(writer.path, std::ios::out | std::ios::binary);
+    if (!writer.file.is_open()) {
+        LOG_ERROR("Failed to open the renderer capture file {}", writer.path.string());
+        return false;
+    }
+
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format_version = FORMAT_VERSION;
+    header.pointer_size = sizeof(void *);
+    if (state.title_id)
+        strncpy(header.title_id, state.title_id, sizeof(header.title_id) - 1);
+    if (state.self_name)
+        strncpy(header.self_name, state.self_name, sizeof(header.self_name) - 1);
+    writer.file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (const auto &[id, context] : writer.contexts) {
+        std::vector<uint8_t> payload;
+        append(payload, id);
+        write_command(writer, mem, CommandOpcode::CreateContext, true, 0, payload, nullptr);
+    }
+    for (const auto &[id, params] : writer.render_targets) {
+        std::vector<uint8_t> payload;
+        append(payload, id);
+        append(payload, params);
+        write_command(writer, mem, CommandOpcode::CreateRenderTarget, true, 0, payload, nullptr);
+    }
+    for (const auto &[address, map] : writer.memory_maps) {
+        std::vector<uint8_t> payload;
+        append(payload, Ptr<void>(address));
+        append(payload, map.first);
+        append(payload, map.second);
+        write_command(writer, mem, CommandOpcode::MemoryMap, true, 0, payload, nullptr);
+    }
+    for (const auto &[id, context] : writer.contexts) {
+        if (!context.set_context.empty() && writer.render_targets.contains(read_at<uint32_t>(context.set_context, 0)))
+            write_command(writer, mem, CommandOpcode::SetContext, false, id, context.set_context, nullptr);
+        for (const auto &[key, payload] : context.states)
+            write_command(writer, mem, CommandOpcode::SetState, false, id, payload, nullptr);
+    }
+
+    LOG_INFO("Capturing {} frames of renderer commands to {}", writer.frame_count, writer.path.string());
+    return true;
+}
+
+static void finish(Writer &writer) {
+    if (writer.file.is_open()) {
+        write_record(writer, Record{ .type = RecordType::End }, nullptr);
+        writer.file.close();
+        LOG_INFO("Renderer capture saved to {}", writer.path.string());
+    }
+
+    writer.done = true;
+    writer.slot_ids.clear();
+    writer.object_ids.clear();
+    writer.contexts.clear();
+    writer.render_targets.clear();
+    writer.memory_maps.clear();
+    writer.memory_hashes.clear();
+    writer.programs.clear();
+}
+
+void init(State &state, const fs::path &path, const uint32_t start_frame, const uint32_t frame_count) {
+    state.capture = std::make_unique<Writer>();
+    state.capture->path = path;
+    state.capture->start_frame = start_frame;
+    state.capture->frame_count = frame_count;
+}
+
+void record_command(Writer &writer, State &state, MemState &mem, const Command &cmd, Context *context) {
+    if (writer.done)
+        return;
+
+    // the sync objects hold host objects and only matter to the guest threads, they are not replayed
+    if (cmd.opcode == CommandOpcode::SignalSyncObject || cmd.opcode == CommandOpcode::WaitSyncObject)
+        return;
+
+    // the objects and states are recreated from what was tracked until now, before recording this command
+    if (!writer.file.is_open() && writer.frames_seen >= writer.start_frame && !start(writer, state, mem)) {
+        finish(writer);
+        return;
+    }
+
+    const uint32_t context_id = find_id(writer.object_ids, context);
+    if (cmd.opcode == CommandOpcode::DrawPrecomputed) {
+        record_precomputed_draw(writer, mem, cmd, context_id, context);
+        return;
+    }
+
+    const std::vector<uint8_t> payload = encode_payload(writer, cmd);
+
+    if (writer.file.is_open()) {
+        // the status of SyncSurfaceData comes with a host surface, which is not captured
+        const bool has_status = cmd.status && cmd.opcode != CommandOpcode::SyncSurfaceData;
+        write_command(writer, mem, cmd.opcode, has_status, context_id, payload, context);
+    }
+
+    switch (cmd.opcode) {
+    case CommandOpcode::SetContext:
+        if (writer.contexts.contains(context_id))
+            writer.contexts[context_id].set_context = payload;
+        break;
+    case CommandOpcode::SetState:
+        if (writer.contexts.contains(context_id))
+            writer.contexts[context_id].states[get_state_key(payload)] = payload;
+        break;
+    case CommandOpcode::MemoryMap:
+        writer.memory_maps[read_at<Address>(payload, 0)] = { read_at<uint32_t>(payload, sizeof(Ptr<void>)), read_at<uint32_t>(payload, sizeof(Ptr<void>) + sizeof(uint32_t)) };
+        break;
+    case CommandOpcode::MemoryUnmap:
+        writer.memory_maps.erase(read_at<Address>(payload, 0));
+        break;
+    case CommandOpcode::DestroyContext:
+    case CommandOpcode::DestroyRenderTarget:
+        forget_id(writer, *reinterpret_cast<void *const *>(cmd.data));
+        break;
+    case CommandOpcode::NewFrame:
+        writer.frames_seen++;
+        if (writer.file.is_open() && writer.frames_seen >= writer.start_frame + writer.frame_count)
+            finish(writer);
+        break;
+    default:
+        break;
+    }
+}
+
+void command_done(Writer &writer, const Command &cmd) {
+    if (writer.done || (cmd.opcode != CommandOpcode::CreateContext && cmd.opcode != CommandOpcode::CreateRenderTarget))
+        return;
+
+    CommandHelper helper(const_cast<Command *>(&cmd));
+    if (cmd.opcode == CommandOpcode::CreateContext) {
+        const std::unique_ptr<Context> *context = helper.pop<std::unique_ptr<Context> *>();
+        const uint32_t id = find_id(writer.slot_ids, context);
+        if (*context) {
+            writer.object_ids[context->get()] = id;
+            writer.contexts[id];
+        }
+    } else {
+        const std::unique_ptr<RenderTarget> *render_target = helper.pop<std::unique_ptr<RenderTarget> *>();
+        const SceGxmRenderTargetParams *params = helper.pop<SceGxmRenderTargetParams *>();
+        const uint32_t id = find_id(writer.slot_ids, render_target);
+        if (*render_target) {
+            writer.object_ids[render_target->get()] = id;
+            writer.render_targets[id] = *params;
+        }
+    }
+}
+
+bool read_header(fs::ifstream &file, Header &header) {
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        LOG_ERROR("The file is not a renderer capture");
+        return false;
+    }
+
+    if (header.format_version != FORMAT_VERSION || header.pointer_size != sizeof(void *)) {
+        LOG_ERROR("The renderer capture was recorded by another build (format version {}, {} bytes pointers)", header.format_version, header.pointer_size);
+        return false;
+    }
+
+    return true;
+}
+
+bool read_record(fs::ifstream &file, Record &record, std::vector<uint8_t> &data) {
+    if (!file.read(reinterpret_cast<char *>(&record), sizeof(record)))
+        return false;
+
+    data.resize(record.data_size);
+    if (record.data_size > 0 && !file.read(reinterpret_cast<char *>(data.data()), record.data_size))
+        return false;
+
+    return record.type != RecordType::End;
+}
+
+} // namespace renderer::capture
@@ -157,9 +157,10 @@ COMMAND(handle_memory_map) {
     TRACY_FUNC_COMMANDS(handle_memory_map);
     const Ptr<void> addr = helper.pop<Ptr<void>>();
     const uint32_t size = helper.pop<uint32_t>();
+    const uint32_t attribs = helper.pop<uint32_t>();
 
     if (renderer.current_backend == Backend::Vulkan) {
-        dynamic_cast<vulkan::VKState &>(renderer).map_memory(mem, addr, size);
+        dynamic_cast<vulkan::VKState &>(renderer).map_memory(mem, addr, size, attribs);
     }
 
     complete_command(renderer, helper, 0);
@@ -193,19 +194,26 @@ bool create(std::unique_ptr<FragmentProgram> &fp, State &state, const SceGxmProg
         return false;
     }
 
-    // Try to hash this shader
-    fp->hash = sha256(&program, program.size);
+    fp->has_blend = blend != nullptr;
+    if (blend)
+        fp->blend = *blend;
+
+    const ProgramInfo info = state.program_info_cache.get(program, false);
+    fp->hash = info.hash;
     gxp_ptr_map.emplace(fp->hash, &program);
 
-    fp->buffer_count = shader::usse::get_uniform_buffer_sizes(program, fp->uniform_buffer_sizes);
+    fp->uniform_buffer_sizes = info.uniform_buffer_sizes;
+    fp->buffer_count = info.buffer_count;
     layout_ssbo_offset_from_uniform_buffer_sizes(fp->uniform_buffer_sizes, fp->uniform_buffer_data_offsets, fp->max_total_uniform_buffer_storage);
-    fp->textures_used = gxp::get_textures_used(program);
+    fp->textures_used = info.textures_used;
     fp->texture_count = std::bit_width(fp->textures_used.to_ulong());
 
+    state.prepare_shader(program, fp->hash, false, {}, fp->textures_used);
+
     return true;
 }
 
-bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgram &program, GXPPtrMap &gxp_ptr_map, const char *cache_path, const char *title_id) {
+bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgram &program, const std::vector<SceGxmVertexAttribute> &attributes, GXPPtrMap &gxp_ptr_map, const char *cache_path, const char *title_id) {
     switch (state.current_backend) {
     case Backend::OpenGL:
         gl::create(vp, dynamic_cast<gl::GLState &>(state), program);
@@ -220,14 +228,15 @@ bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgra
         return false;
     }
 
-    // Hash this shader
-    vp->hash = sha256(&program, program.size);
+    ProgramInfo info = state.program_info_cache.get(program, true);
+    vp->hash = info.hash;
     gxp_ptr_map.emplace(vp->hash, &program);
 
-    vp->buffer_count = shader::usse::get_uniform_buffer_sizes(program, vp->uniform_buffer_sizes);
-    shader::usse::get_attribute_informations(program, vp->attribute_infos);
+    vp->uniform_buffer_sizes = info.uniform_buffer_sizes;
+    vp->buffer_count = info.buffer_count;
+    vp->attribute_infos = std::move(info.attribute_infos);
     layout_ssbo_offset_from_uniform_buffer_sizes(vp->uniform_buffer_sizes, vp->uniform_buffer_data_offsets, vp->max_total_uniform_buffer_storage);
-    vp->textures_used = gxp::get_textures_used(program);
+    vp->textures_used = info.textures_used;
     vp->texture_count = std::bit_width(vp->textures_used.to_ulong());
 
     if (vp->attribute_infos.empty()) {
@@ -236,6 +245,8 @@ bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgra
         vp->stripped_symbols_checked = true;
     }
 
+    state.prepare_shader(program, vp->hash, true, attributes, vp->textures_used);
+
     return true;
 }
 
@@ -256,6 +267,7 @@ bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, co
     case Backend::OpenGL:
         state = std::make_unique<gl::GLState>();
         state->cache_path = root_paths.get_cache_path_string();
+        state->shared_cache_path = config.shared_shader_cache_path;
         state->log_path = root_paths.get_log_path_string();
         state->shared_path = root_paths.get_shared_path_string();
         if (!gl::create(window, state, config))
@@ -265,6 +277,7 @@ bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, co
     case Backend::Vulkan:
         state = std::make_unique<vulkan::VKState>(config.gpu_idx);
         state->cache_path = root_paths.get_cache_path_string();
+        state->shared_cache_path = config.shared_shader_cache_path;
         state->log_path = root_paths.get_log_path_string();
         state->shared_path = root_paths.get_shared_path_string();
         if (!vulkan::create(window, state, config))
@@ -277,9 +290,7 @@ bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, co
     }
 
     state->current_backend = backend;
-
-    // Can change this
-    state->command_buffer_queue.maxPendingCount_ = 30;
+    state->frame_skip.init(config.auto_frameskip, config.auto_frameskip_max);
 
     return true;
 }
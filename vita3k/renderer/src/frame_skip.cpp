@@ -0,0 +1,74 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <renderer/frame_skip.h>
+
+#include <util/log.h>
+
+#include <algorithm>
+
+namespace renderer {
+
+// the vblanks between the frames are measured again after this many frames
+static constexpr uint32_t VBLANK_WINDOW_FRAMES = 120;
+static constexpr float VBLANK_PERIOD_MS = 1000.f / 60.f;
+
+void FrameSkip::init(bool enabled, int max_consecutive) {
+    this->enabled = enabled;
+    this->max_consecutive = std::clamp(max_consecutive, 1, 10);
+    if (enabled)
+        LOG_INFO("Automatic frameskip is enabled, up to {} consecutive frames are not presented when the host is too slow", this->max_consecutive);
+}
+
+void FrameSkip::end_frame(uint64_t frame_ns, uint64_t vblank_count, Address displayed_surface) {
+    if (!enabled)
+        return;
+
+    if (displayed_surface != 0 && !is_displayed_surface(displayed_surface)) {
+        displayed_surfaces[next_displayed_surface] = displayed_surface;
+        next_displayed_surface = (next_displayed_surface + 1) % displayed_surfaces.size();
+    }
+
+    if (last_vblank_count != 0 && vblank_count > last_vblank_count) {
+        window_min_vblanks = std::min<uint32_t>(window_min_vblanks, vblank_count - last_vblank_count);
+        if (++window_frames >= VBLANK_WINDOW_FRAMES) {
+            vblanks_per_frame = window_min_vblanks;
+            window_min_vblanks = UINT32_MAX;
+            window_frames = 0;
+        }
+    }
+    last_vblank_count = vblank_count;
+
+    // the skipped frames are cheaper, they would hide that the host is too slow
+    if (!skipping) {
+        const float frame_time = frame_ns / 1'000'000.f;
+        if (average_frame_time == 0.f)
+            average_frame_time = frame_time;
+        else
+            average_frame_time = average_frame_time * 0.9f + frame_time * 0.1f;
+    }
+
+    const float budget = VBLANK_PERIOD_MS * vblanks_per_frame;
+    if (average_frame_time > budget * 1.05f && consecutive < max_consecutive) {
+        skipping = true;
+        consecutive++;
+    } else {
+        skipping = false;
+        consecutive = 0;
+    }
+}
+
+} // namespace renderer
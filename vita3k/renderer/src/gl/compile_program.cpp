@@ -28,12 +28,19 @@
 #include <shader/spirv_recompiler.h>
 
 #include <gxm/functions.h>
+#include <util/fs.h>
+
+#include <iterator>
 #include <vector>
 
 namespace renderer::gl {
-static SharedGLObject compile_glsl(GLenum type, const std::string &source) {
-    R_PROFILE(__func__);
+// from GL_KHR_parallel_shader_compile, which is not part of the loaded extensions
+static constexpr GLenum COMPLETION_STATUS_KHR = 0x91B1;
 
+static constexpr uint32_t PROGRAM_BINARY_MAGIC = 0x42504C47; // GLPB
+
+// with GL_KHR_parallel_shader_compile, the compilation only finishes once its status is queried
+static SharedGLObject submit_glsl(GLenum type, const std::string &source) {
     const SharedGLObject shader = std::make_shared<GLObject>();
     if (!shader->init(glCreateShader(type), glDeleteShader)) {
         return SharedGLObject();
@@ -45,22 +52,34 @@ static SharedGLObject compile_glsl(GLenum type, const std::string &source) {
 
     glCompileShader(shader->get());
 
+    return shader;
+}
+
+static bool check_shader_compiled(const GLObject &shader) {
     GLint log_length = 0;
-    glGetShaderiv(shader->get(), GL_INFO_LOG_LENGTH, &log_length);
+    glGetShaderiv(shader.get(), GL_INFO_LOG_LENGTH, &log_length);
 
     // Intel driver returns an info log length of at least 1 even if it is empty.
     if (log_length > 1) {
         std::vector<GLchar> log;
         log.resize(log_length);
-        glGetShaderInfoLog(shader->get(), log_length, nullptr, log.data());
+        glGetShaderInfoLog(shader.get(), log_length, nullptr, log.data());
 
         LOG_ERROR("{}", log.data());
     }
 
     GLint is_compiled = GL_FALSE;
-    glGetShaderiv(shader->get(), GL_COMPILE_STATUS, &is_compiled);
+    glGetShaderiv(shader.get(), GL_COMPILE_STATUS, &is_compiled);
     assert(is_compiled != GL_FALSE);
-    if (!is_compiled) {
+
+    return is_compiled != GL_FALSE;
+}
+
+static SharedGLObject compile_glsl(GLenum type, const std::string &source) {
+    R_PROFILE(__func__);
+
+    const SharedGLObject shader = submit_glsl(type, source);
+    if (!shader || !check_shader_compiled(*shader)) {
         return SharedGLObject();
     }
 
@@ -116,57 +135,151 @@ static std::string convert_hash_to_hex(const Sha256Hash &hash) {
     return ss.str();
 }
 
-static SharedGLObject compile_program(ProgramCache &program_cache, const SharedGLObject frag_shader, const SharedGLObject vert_shader, const ProgramHashes &hashes) {
+static fs::path get_program_binary_path(const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, const ProgramHashes &hashes) {
+    const std::string file_name = fmt::format("{}-{}-{}", shader_version, convert_hash_to_hex(std::get<0>(hashes)), convert_hash_to_hex(std::get<1>(hashes)));
+    return fs_utils::construct_file_name(cache_path, fs::path("shaders") / title_id / self_name, file_name, "glbin");
+}
+
+static SharedGLObject load_program_binary(const GLState &renderer, const fs::path &path) {
+    R_PROFILE(__func__);
+
+    if (renderer.program_binary_driver.empty())
+        return SharedGLObject();
+
+    fs::ifstream binary_file(path, std::ios::in | std::ios::binary);
+    if (!binary_file.is_open())
+        return SharedGLObject();
+
+    uint32_t magic = 0;
+    uint32_t driver_size = 0;
+    binary_file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    binary_file.read(reinterpret_cast<char *>(&driver_size), sizeof(driver_size));
+    if (!binary_file || (magic != PROGRAM_BINARY_MAGIC) || (driver_size != renderer.program_binary_driver.size()))
+        return SharedGLObject();
+
+    // the binary is only valid for the driver which created it
+    std::string driver(driver_size, '\0');
+    GLenum format = 0;
+    binary_file.read(driver.data(), driver_size);
+    binary_file.read(reinterpret_cast<char *>(&format), sizeof(format));
+    if (!binary_file || (driver != renderer.program_binary_driver))
+        return SharedGLObject();
+
+    const std::vector<char> binary((std::istreambuf_iterator<char>(binary_file)), std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return SharedGLObject();
+
+    const SharedGLObject program = std::make_shared<GLObject>();
+    if (!program->init(glCreateProgram(), glDeleteProgram)) {
+        return SharedGLObject();
+    }
+
+    glProgramBinary(program->get(), format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    // the driver can still reject it, the program is then compiled again and its binary replaced
+    GLint is_linked = GL_FALSE;
+    glGetProgramiv(program->get(), GL_LINK_STATUS, &is_linked);
+    if (is_linked == GL_FALSE) {
+        return SharedGLObject();
+    }
+
+    return program;
+}
+
+static void save_program_binary(const GLState &renderer, const fs::path &path, const GLObject &program) {
+    if (renderer.program_binary_driver.empty())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program.get(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program.get(), length, &length, &format, binary.data());
+
+    fs::ofstream binary_file(path, std::ios::out | std::ios::binary);
+    if (!binary_file.is_open())
+        return;
+
+    const uint32_t driver_size = static_cast<uint32_t>(renderer.program_binary_driver.size());
+    binary_file.write(reinterpret_cast<const char *>(&PROGRAM_BINARY_MAGIC), sizeof(PROGRAM_BINARY_MAGIC));
+    binary_file.write(reinterpret_cast<const char *>(&driver_size), sizeof(driver_size));
+    binary_file.write(renderer.program_binary_driver.data(), driver_size);
+    binary_file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    binary_file.write(binary.data(), length);
+}
+
+static SharedGLObject submit_program(const GLState &renderer, const SharedGLObject frag_shader, const SharedGLObject vert_shader) {
     const SharedGLObject program = std::make_shared<GLObject>();
     if (!program->init(glCreateProgram(), glDeleteProgram)) {
         return SharedGLObject();
     }
 
+    if (!renderer.program_binary_driver.empty())
+        glProgramParameteri(program->get(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     glAttachShader(program->get(), frag_shader->get());
     glAttachShader(program->get(), vert_shader->get());
     glLinkProgram(program->get());
 
+    return program;
+}
+
+static bool check_program_linked(const GLObject &program) {
     GLint log_length = 0;
-    glGetProgramiv(program->get(), GL_INFO_LOG_LENGTH, &log_length);
+    glGetProgramiv(program.get(), GL_INFO_LOG_LENGTH, &log_length);
 
     // Intel driver returns an info log length of at least 1 even if it is empty.
     if (log_length > 1) {
         std::vector<GLchar> log;
         log.resize(log_length);
-        glGetProgramInfoLog(program->get(), log_length, nullptr, log.data());
+        glGetProgramInfoLog(program.get(), log_length, nullptr, log.data());
 
         LOG_ERROR("{}\n", log.data());
     }
 
     GLint is_linked = GL_FALSE;
-    glGetProgramiv(program->get(), GL_LINK_STATUS, &is_linked);
+    glGetProgramiv(program.get(), GL_LINK_STATUS, &is_linked);
     assert(is_linked != GL_FALSE);
-    if (is_linked == GL_FALSE) {
+
+    return is_linked != GL_FALSE;
+}
+
+static SharedGLObject compile_program(GLState &renderer, const SharedGLObject frag_shader, const SharedGLObject vert_shader, const ProgramHashes &hashes) {
+    const SharedGLObject program = submit_program(renderer, frag_shader, vert_shader);
+    if (!program || !check_program_linked(*program)) {
         return SharedGLObject();
     }
 
     glDetachShader(program->get(), frag_shader->get());
     glDetachShader(program->get(), vert_shader->get());
 
-    program_cache.emplace(hashes, program);
+    renderer.program_cache.emplace(hashes, program);
 
     return program;
 }
 
-static SharedGLObject compile_shader(const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, const std::string &hash_hex,
-    const char *type_str, const GLenum type, ShaderCache &cache, const Sha256Hash &hash) {
+static SharedGLObject compile_shader(const ShaderPack &pack, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, const std::string &hash_hex,
+    const char *type_str, const GLenum type, ShaderCache &cache, const Sha256Hash &hash, const bool parallel) {
+    // Shared by several programs
+    const auto cached = cache.find(hash);
+    if (cached != cache.end())
+        return cached->second;
+
     // Set Shader version with hash
     const std::string hash_hex_ver = shader_version + "-" + hash_hex;
 
     // Load Shader
-    const std::string shader = pre_load_shader_glsl(hash_hex_ver.c_str(), type_str, cache_path, title_id, self_name);
+    const std::string shader = pre_load_shader_glsl(pack, hash_hex_ver.c_str(), type_str, cache_path, title_id, self_name);
     if (shader.empty()) {
         LOG_WARN("{} shader is empty or not found:\n{}", type_str, hash_hex);
         return SharedGLObject();
     }
 
-    // Compile Shader
-    const SharedGLObject obj = compile_glsl(type, shader);
+    // Compile Shader, its status is checked with the one of the program when compiled in parallel
+    const SharedGLObject obj = parallel ? submit_glsl(type, shader) : compile_glsl(type, shader);
     if (!obj) {
         LOG_CRITICAL("Error in compile {} shader:\n{}", type_str, hash_hex);
         return SharedGLObject();
@@ -174,7 +287,8 @@ static SharedGLObject compile_shader(const char *cache_path, const char *title_i
 
     // Push shader Compiled
     cache.emplace(hash, obj);
-    LOG_INFO("{} shader compiled: {}", type_str, hash_hex);
+    if (!parallel)
+        LOG_INFO("{} shader compiled: {}", type_str, hash_hex);
 
     return obj;
 }
@@ -187,49 +301,137 @@ static std::vector<ShadersHash>::iterator get_shaders_hash_index(std::vector<Sha
     return shader_hash_index;
 }
 
-void pre_compile_program(GLState &renderer, const char *cache_path, const char *title_id, const char *self_name, const ShadersHash &hash) {
+static bool has_shaders_cache(const char *cache_path, const char *title_id, const char *self_name) {
     const auto shader_path{ fs::path(cache_path) / "shaders" / title_id / self_name };
-    if (fs::exists(shader_path) && !fs::is_empty(shader_path)) {
+    return fs::exists(shader_path) && !fs::is_empty(shader_path);
+}
+
+void pre_compile_program(GLState &renderer, const char *cache_path, const char *title_id, const char *self_name, const ShadersHash &hash) {
+    if (has_shaders_cache(cache_path, title_id, self_name)) {
+        const ProgramHashes hashes(hash.frag, hash.vert);
+        const auto binary_path = get_program_binary_path(cache_path, title_id, self_name, renderer.shader_version, hashes);
+
+        // Load the program linked during a previous run
+        const SharedGLObject program_binary = load_program_binary(renderer, binary_path);
+        if (program_binary) {
+            renderer.program_cache.emplace(hashes, program_binary);
+            const uint32_t programs_count = ++renderer.programs_count_pre_compiled;
+            LOG_INFO("Program Loaded {}/{}", programs_count, renderer.shaders_cache_hashs.size());
+            return;
+        }
+
         // Compile Fragment Shader
         const auto frag_hash_hex = convert_hash_to_hex(hash.frag);
-        const SharedGLObject frag_shader = compile_shader(cache_path, title_id, self_name, renderer.shader_version,
-            frag_hash_hex, "frag", GL_FRAGMENT_SHADER, renderer.fragment_shader_cache, hash.frag);
+        const SharedGLObject frag_shader = compile_shader(renderer.shader_pack, cache_path, title_id, self_name, renderer.shader_version,
+            frag_hash_hex, "frag", GL_FRAGMENT_SHADER, renderer.fragment_shader_cache, hash.frag, false);
         if (!frag_shader) {
             return;
         }
 
         // Compile Vertex Shader
         const auto vert_hash_hex = convert_hash_to_hex(hash.vert);
-        const SharedGLObject vert_shader = compile_shader(cache_path, title_id, self_name, renderer.shader_version,
-            vert_hash_hex, "vert", GL_VERTEX_SHADER, renderer.vertex_shader_cache, hash.vert);
+        const SharedGLObject vert_shader = compile_shader(renderer.shader_pack, cache_path, title_id, self_name, renderer.shader_version,
+            vert_hash_hex, "vert", GL_VERTEX_SHADER, renderer.vertex_shader_cache, hash.vert, false);
         if (!vert_shader) {
             return;
         }
 
         // Compile Program
+        const SharedGLObject program = compile_program(renderer, frag_shader, vert_shader, hashes);
+        if (program)
+            save_program_binary(renderer, binary_path, *program);
+        const uint32_t programs_count = ++renderer.programs_count_pre_compiled;
+        LOG_INFO("Program Compiled {}/{}", programs_count, renderer.shaders_cache_hashs.size());
+    }
+}
+
+bool start_parallel_pre_compile(GLState &renderer) {
+    if (!renderer.support_parallel_shader_compile)
+        return false;
+
+    const char *cache_path = renderer.cache_path.c_str();
+    if (!has_shaders_cache(cache_path, renderer.title_id, renderer.self_name))
+        return true;
+
+    // Submit all the programs, the driver compiles and links them on its own threads
+    for (const ShadersHash &hash : renderer.shaders_cache_hashs) {
         const ProgramHashes hashes(hash.frag, hash.vert);
-        compile_program(renderer.program_cache, frag_shader, vert_shader, hashes);
-        renderer.programs_count_pre_compiled++;
-        LOG_INFO("Program Compiled {}/{}", renderer.programs_count_pre_compiled, renderer.shaders_cache_hashs.size());
+        const auto binary_path = get_program_binary_path(cache_path, renderer.title_id, renderer.self_name, renderer.shader_version, hashes);
+
+        const SharedGLObject program_binary = load_program_binary(renderer, binary_path);
+        if (program_binary) {
+            renderer.program_cache.emplace(hashes, program_binary);
+            ++renderer.programs_count_pre_compiled;
+            continue;
+        }
+
+        const SharedGLObject frag_shader = compile_shader(renderer.shader_pack, cache_path, renderer.title_id, renderer.self_name, renderer.shader_version,
+            convert_hash_to_hex(hash.frag), "frag", GL_FRAGMENT_SHADER, renderer.fragment_shader_cache, hash.frag, true);
+        const SharedGLObject vert_shader = compile_shader(renderer.shader_pack, cache_path, renderer.title_id, renderer.self_name, renderer.shader_version,
+            convert_hash_to_hex(hash.vert), "vert", GL_VERTEX_SHADER, renderer.vertex_shader_cache, hash.vert, true);
+        if (!frag_shader || !vert_shader)
+            continue;
+
+        const SharedGLObject program = submit_program(renderer, frag_shader, vert_shader);
+        if (program)
+            renderer.pending_programs.push_back({ hashes, program, frag_shader, vert_shader });
     }
+
+    LOG_INFO("Loaded {} programs, compiling {} programs in parallel", renderer.programs_count_pre_compiled.load(), renderer.pending_programs.size());
+
+    return true;
 }
 
-static SharedGLObject get_or_compile_shader(const SceGxmProgram *program, const FeatureState &features, const Sha256Hash &hash,
-    ShaderCache &cache, const GLenum type, const shader::Hints &hints, bool shader_cache, bool spirv, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, uint32_t &shaders_count_compiled) {
+bool is_parallel_pre_compile_done(GLState &renderer) {
+    for (auto pending = renderer.pending_programs.begin(); pending != renderer.pending_programs.end();) {
+        GLint is_completed = GL_FALSE;
+        glGetProgramiv(pending->program->get(), COMPLETION_STATUS_KHR, &is_completed);
+        if (is_completed == GL_FALSE) {
+            ++pending;
+            continue;
+        }
+
+        // A shader failing to compile must not be used by the programs linked later
+        const bool frag_compiled = check_shader_compiled(*pending->frag_shader);
+        if (!frag_compiled)
+            renderer.fragment_shader_cache.erase(std::get<0>(pending->hashes));
+        const bool vert_compiled = check_shader_compiled(*pending->vert_shader);
+        if (!vert_compiled)
+            renderer.vertex_shader_cache.erase(std::get<1>(pending->hashes));
+
+        if (frag_compiled && vert_compiled && check_program_linked(*pending->program)) {
+            glDetachShader(pending->program->get(), pending->frag_shader->get());
+            glDetachShader(pending->program->get(), pending->vert_shader->get());
+
+            renderer.program_cache.emplace(pending->hashes, pending->program);
+            save_program_binary(renderer, get_program_binary_path(renderer.cache_path.c_str(), renderer.title_id, renderer.self_name, renderer.shader_version, pending->hashes), *pending->program);
+        }
+
+        const uint32_t programs_count = ++renderer.programs_count_pre_compiled;
+        LOG_INFO("Program Compiled {}/{}", programs_count, renderer.shaders_cache_hashs.size());
+        pending = renderer.pending_programs.erase(pending);
+    }
+
+    return renderer.pending_programs.empty();
+}
+
+static SharedGLObject get_or_compile_shader(const ShaderPack &pack, const SceGxmProgram *program, const FeatureState &features, const Sha256Hash &hash,
+    ShaderCache &cache, const GLenum type, const shader::Hints &hints, bool shader_cache, bool spirv, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, uint32_t &shaders_count_compiled, std::atomic<uint64_t> &shader_translation_count) {
     const auto cached = cache.find(hash);
     if (cached == cache.end()) {
         SharedGLObject obj = nullptr;
 
         // Need to compile new one and add it to cache
         if (features.spirv_shader && spirv) {
-            obj = compile_spirv(type, load_spirv_shader(*program, features, false, hints, maskupdate, cache_path, title_id, self_name, shader_version + "spv", shader_cache));
+            obj = compile_spirv(type, load_spirv_shader(pack, *program, features, false, hints, maskupdate, cache_path, title_id, self_name, shader_version + "spv", shader_cache));
         } else {
-            obj = compile_glsl(type, load_glsl_shader(*program, features, hints, maskupdate, cache_path, title_id, self_name, shader_version, shader_cache));
+            obj = compile_glsl(type, load_glsl_shader(pack, *program, features, hints, maskupdate, cache_path, title_id, self_name, shader_version, shader_cache));
         }
 
         cache.emplace(hash, obj);
 
         shaders_count_compiled++;
+        shader_translation_count.fetch_add(1, std::memory_order_relaxed);
 
         return obj;
     }
@@ -261,6 +463,17 @@ SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmR
         return cached->second;
     }
 
+    // Then for the program linked during a previous run
+    const std::string program_version = (features.spirv_shader && spirv) ? renderer.shader_version + "spv" : renderer.shader_version;
+    const auto binary_path = get_program_binary_path(cache_path, title_id, self_name, program_version, hashes);
+    if (shader_cache) {
+        const SharedGLObject program_binary = load_program_binary(renderer, binary_path);
+        if (program_binary) {
+            renderer.program_cache.emplace(hashes, program_binary);
+            return program_binary;
+        }
+    }
+
     // No... It doesn't exist. Now we try to find each object. If it doesn't exist then we can kind
     // of compile it again.
 
@@ -268,23 +481,25 @@ SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmR
     context.shader_hints.color_format = state.color_surface.colorFormat;
     context.shader_hints.attributes = &vertex_program_gxm.attributes;
 
-    const SharedGLObject fragment_shader = get_or_compile_shader(fragment_program_gxm.program.get(mem), features, fragment_program.hash, renderer.fragment_shader_cache,
-        GL_FRAGMENT_SHADER, context.shader_hints, shader_cache, spirv, maskupdate, cache_path, title_id, self_name, renderer.shader_version, renderer.shaders_count_compiled);
+    const SharedGLObject fragment_shader = get_or_compile_shader(renderer.shader_pack, fragment_program_gxm.program.get(mem), features, fragment_program.hash, renderer.fragment_shader_cache,
+        GL_FRAGMENT_SHADER, context.shader_hints, shader_cache, spirv, maskupdate, cache_path, title_id, self_name, renderer.shader_version, renderer.shaders_count_compiled, renderer.shader_translation_count);
 
     if (!fragment_shader) {
         LOG_CRITICAL("Error in get/compile fragment vertex shader:\n{}", hex_string(fragment_program.hash));
         return SharedGLObject();
     }
 
-    const SharedGLObject vertex_shader = get_or_compile_shader(vertex_program_gxm.program.get(mem), features, vertex_program.hash, renderer.vertex_shader_cache,
-        GL_VERTEX_SHADER, context.shader_hints, shader_cache, spirv, maskupdate, cache_path, title_id, self_name, renderer.shader_version, renderer.shaders_count_compiled);
+    const SharedGLObject vertex_shader = get_or_compile_shader(renderer.shader_pack, vertex_program_gxm.program.get(mem), features, vertex_program.hash, renderer.vertex_shader_cache,
+        GL_VERTEX_SHADER, context.shader_hints, shader_cache, spirv, maskupdate, cache_path, title_id, self_name, renderer.shader_version, renderer.shaders_count_compiled, renderer.shader_translation_count);
 
     if (!vertex_shader) {
         LOG_CRITICAL("Error in get/compiled vertex shader:\n{}", hex_string(vertex_program.hash));
         return SharedGLObject();
     }
 
-    const SharedGLObject program = compile_program(renderer.program_cache, fragment_shader, vertex_shader, hashes);
+    const SharedGLObject program = compile_program(renderer, fragment_shader, vertex_shader, hashes);
+    if (program && shader_cache)
+        save_program_binary(renderer, binary_path, *program);
 
     // Save shader cache haches
     const auto shader_cache_hash_index = get_shaders_hash_index(renderer.shaders_cache_hashs, fragment_program.hash, vertex_program.hash);
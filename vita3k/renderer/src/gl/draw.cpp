@@ -209,6 +209,9 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
         }
     }
 
+    // the textures written by the decode workers must be copied before they are sampled
+    renderer.texture_cache.flush_uploads();
+
     // Draw.
     const GLenum mode = translate_primitive(type);
     const GLenum gl_type = format == SCE_GXM_INDEX_FORMAT_U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
@@ -38,6 +38,7 @@
 #include <SDL_video.h>
 
 #include <array>
+#include <chrono>
 #include <sstream>
 
 namespace renderer::gl {
@@ -229,7 +230,8 @@ bool create(SDL_Window *window, std::unique_ptr<State> &state, const Config &con
         { "GL_EXT_shader_framebuffer_fetch", &gl_state.features.direct_fragcolor },
         { "GL_ARB_gl_spirv", &gl_state.features.spirv_shader },
         { "GL_ARB_get_texture_sub_image", &gl_state.features.support_get_texture_sub_image },
-        { "GL_EXT_shader_image_load_formatted", &gl_state.features.support_unknown_format }
+        { "GL_EXT_shader_image_load_formatted", &gl_state.features.support_unknown_format },
+        { "GL_KHR_parallel_shader_compile", &gl_state.support_parallel_shader_compile }
     };
 
     for (int i = 0; i < total_extensions; i++) {
@@ -257,6 +259,22 @@ bool create(SDL_Window *window, std::unique_ptr<State> &state, const Config &con
     // always enabled in the opengl renderer
     gl_state.features.use_mask_bit = true;
 
+    // the program binaries are only valid for the driver which created them
+    GLint program_binary_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &program_binary_formats);
+    if (program_binary_formats > 0)
+        gl_state.program_binary_driver = fmt::format("{} {} {}", reinterpret_cast<const char *>(glGetString(GL_VENDOR)), gpu_name, reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+
+    if (gl_state.support_parallel_shader_compile) {
+        // not part of the loaded extensions, let the driver use as many threads as it wants
+        typedef void(GLAD_API_PTR *MaxShaderCompilerThreadsProc)(GLuint count);
+        const auto max_shader_compiler_threads = reinterpret_cast<MaxShaderCompilerThreadsProc>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        if (max_shader_compiler_threads)
+            max_shader_compiler_threads(0xFFFFFFFF);
+        else
+            gl_state.support_parallel_shader_compile = false;
+    }
+
     return gl_state.init(gl_state.shared_path.c_str(), hashless_texture_cache);
 }
 
@@ -274,6 +292,9 @@ bool GLState::init(const char *shared_path, const bool hashless_texture_cache) {
 void GLState::late_init(const Config &cfg, const std::string_view game_id) {
     const fs::path texture_folder = fs::path(shared_path) / "textures";
     texture_cache.init(cfg.hashless_texture_cache, texture_folder, game_id);
+    texture_cache.use_write_tracking = cfg.texture_write_tracking;
+    texture_cache.video_frames = &video_frames;
+    texture_cache.upload_stats = &texture_uploads;
 }
 
 bool create(std::unique_ptr<Context> &context) {
@@ -708,7 +729,9 @@ void GLState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &v
 }
 
 void GLState::swap_window(SDL_Window *window) {
+    const auto start = std::chrono::steady_clock::now();
     SDL_GL_SwapWindow(window);
+    present_wait_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
 }
 
 int GLState::get_supported_filters() {
@@ -743,6 +766,16 @@ void GLState::precompile_shader(const ShadersHash &hash) {
     pre_compile_program(*this, cache_path.c_str(), title_id, self_name, hash);
 }
 
-void GLState::preclose_action() {}
+bool GLState::start_parallel_precompile() {
+    return start_parallel_pre_compile(*this);
+}
+
+bool GLState::is_parallel_precompile_done() {
+    return is_parallel_pre_compile_done(*this);
+}
+
+void GLState::preclose_action() {
+    program_info_cache.save();
+}
 
 } // namespace renderer::gl
@@ -22,12 +22,17 @@
 #include <util/align.h>
 #include <util/log.h>
 
+#include <algorithm>
+
 namespace renderer::gl {
 
 RingBuffer::RingBuffer(GLenum purpose, const std::size_t capacity)
-    : base_(nullptr)
+    : segments_to_fence_(0)
+    , base_(nullptr)
     , cursor_(0)
     , capacity_(capacity)
+    , segment_size_(capacity / SEGMENT_COUNT)
+    , current_segment_(0)
     , purpose_(purpose) {
     buffer_.init(reinterpret_cast<renderer::Generator *>(glGenBuffers), reinterpret_cast<renderer::Deleter *>(glDeleteBuffers));
 }
@@ -50,6 +55,22 @@ void RingBuffer::create_and_map() {
     }
 }
 
+void RingBuffer::enter_segment(const std::size_t segment) {
+    // the draws using the segment we are leaving may not have been submitted yet
+    segments_to_fence_ |= 1U << current_segment_;
+    current_segment_ = segment;
+
+    Fence &fence = segment_fences_[segment];
+    if (!fence.empty()) {
+        fence.wait_for_signal();
+    } else if (segments_to_fence_ & (1U << segment)) {
+        // the whole buffer was allocated without a single draw being done
+        LOG_ERROR("Ring buffer segment has been reused before a sync fence could be inserted!");
+        glFinish();
+        segments_to_fence_ &= ~(1U << segment);
+    }
+}
+
 std::pair<std::uint8_t *, std::size_t> RingBuffer::allocate(const std::size_t data_size) {
     if (!base_) {
         create_and_map();
@@ -58,29 +79,36 @@ std::pair<std::uint8_t *, std::size_t> RingBuffer::allocate(const std::size_t da
         }
     }
 
-    std::size_t offset = align(cursor_, 256);
-
-    if ((offset + data_size) >= capacity_) {
-        if (!safe_segment_consumed_fence_.empty()) {
-            safe_segment_consumed_fence_.wait_for_signal();
-        } else {
-            LOG_ERROR("Sync fence has not been inserted but the size of the ring buffer has already reached full!");
-            glFinish();
-        }
+    if (data_size > capacity_) {
+        LOG_ERROR("Trying to allocate {} bytes from a ring buffer of {} bytes!", data_size, capacity_);
+        return std::make_pair(nullptr, static_cast<std::size_t>(-1));
+    }
 
+    std::size_t offset = align(cursor_, 256);
+    if (offset + data_size > capacity_)
         offset = 0;
-        cursor_ = 0;
-    }
 
-    cursor_ = align(offset + data_size, 256);
+    // wait for all the segments newly reached by the allocation
+    const std::size_t first_segment = std::min(offset / segment_size_, SEGMENT_COUNT - 1);
+    const std::size_t last_segment = std::min((offset + std::max<std::size_t>(data_size, 1) - 1) / segment_size_, SEGMENT_COUNT - 1);
+    if (first_segment != current_segment_ || offset < cursor_)
+        enter_segment(first_segment);
+    for (std::size_t segment = first_segment + 1; segment <= last_segment; segment++)
+        enter_segment(segment);
+
+    cursor_ = offset + data_size;
     return std::make_pair(base_ + offset, offset);
 }
 
 void RingBuffer::draw_call_done() {
-    // Insert a fence when the buffer has been consumed about 25% (same as RPCS3)
-    if (safe_segment_consumed_fence_.empty() && (cursor_ >= (capacity_ >> 2))) {
-        safe_segment_consumed_fence_.insert();
+    if (segments_to_fence_ == 0)
+        return;
+
+    for (std::size_t segment = 0; segment < SEGMENT_COUNT; segment++) {
+        if (segments_to_fence_ & (1U << segment))
+            segment_fences_[segment].insert();
     }
+    segments_to_fence_ = 0;
 }
 
 } // namespace renderer::gl
@@ -69,15 +69,11 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
     width *= state.res_multiplier;
     height *= state.res_multiplier;
 
-    // Of course, this works under the assumption that range must be unique :D
-    auto ite = color_surface_textures.lower_bound(key);
+    // closest surface containing the address, if the surface found does not overlap the surface we want, it's useless to look at it
+    auto ite = color_surface_textures.find_containing(key);
     bool invalidated = false;
 
-    bool overlap = false;
-    if (ite != color_surface_textures.end()) {
-        // if the surface found does not overlap the surface we want, it's useless to look at it
-        overlap = (ite->first + ite->second->total_bytes) > key;
-    }
+    const bool overlap = ite != nullptr;
 
     if (!overlap && purpose != SurfaceTextureRetrievePurpose::WRITING) {
         // not part of a surface, let the texture cache handle it
@@ -92,8 +88,8 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
     std::size_t total_surface_size = bytes_per_stride * original_height;
 
     if (overlap) {
-        GLColorSurfaceCacheInfo &info = *ite->second;
-        auto used_iterator = std::find(last_use_color_surface_index.begin(), last_use_color_surface_index.end(), ite->first);
+        GLColorSurfaceCacheInfo &info = *ite->value;
+        auto used_iterator = std::find(last_use_color_surface_index.begin(), last_use_color_surface_index.end(), ite->start);
 
         if (stored_height) {
             *stored_height = info.original_height;
@@ -115,12 +111,12 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
         // 2. Same base address, but width and height change to be larger, or format change if write. Remake a new one for both read and write sitatation.
         // 3. Out of cache range. In write case, create a new one, in read case, lul
         // 4. Read situation with smaller width and height, probably need to extract the needed region out.
-        const bool addr_in_range_of_cache = ((key + total_surface_size) <= (ite->first + info.total_bytes));
-        const bool cache_probably_freed = ((ite->first != key) && addr_in_range_of_cache && (purpose == SurfaceTextureRetrievePurpose::WRITING));
+        const bool addr_in_range_of_cache = ((key + total_surface_size) <= (ite->start + info.total_bytes));
+        const bool cache_probably_freed = ((ite->start != key) && addr_in_range_of_cache && (purpose == SurfaceTextureRetrievePurpose::WRITING));
         const bool surface_extent_changed = (info.width < width) || (info.height < height);
         bool surface_stat_changed = false;
 
-        if (ite->first == key) {
+        if (ite->start == key) {
             if (purpose == SurfaceTextureRetrievePurpose::WRITING) {
                 surface_stat_changed = surface_extent_changed || (base_format != info.format);
             } else {
@@ -138,7 +134,7 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
                 }
             }
             // Clear out. We will recreate later
-            color_surface_textures.erase(ite);
+            color_surface_textures.erase(ite->start);
             invalidated = true;
         } else if (surface_stat_changed) {
             // Remake locally to avoid making changes to framebuffer array
@@ -234,7 +230,7 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
                 last_use_color_surface_index.erase(used_iterator);
             }
 
-            last_use_color_surface_index.push_back(ite->first);
+            last_use_color_surface_index.push_back(ite->start);
 
             if (info.flags & GLSurfaceCacheInfo::FLAG_DIRTY) {
                 // We can't use this texture sadly :( If it uses for writing of course it will be gud gud
@@ -270,7 +266,7 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
             }
 
             if (castable) {
-                const std::size_t data_delta = address.address() - ite->first;
+                const std::size_t data_delta = address.address() - ite->start;
                 std::size_t start_sourced_line = (data_delta / bytes_per_stride) * state.res_multiplier;
                 std::size_t start_x = (data_delta % bytes_per_stride) / color::bytes_per_pixel(base_format) * state.res_multiplier;
 
@@ -296,7 +292,7 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
                         source_data_type = color::translate_type(info.format);
                     }
 
-                    if ((base_format != info.format) || (info.height != height) || (info.width != width) || (ite->first != address.address())) {
+                    if ((base_format != info.format) || (info.height != height) || (info.width != width) || (ite->start != address.address())) {
                         // Look in cast cache and grab one. The cache really does not store immediate grab on now, but rather to reduce the synchronization in the pipeline (use different texture)
                         for (std::size_t i = 0; i < casted_vec.size();) {
                             if ((casted_vec[i]->cropped_height == height) && (casted_vec[i]->cropped_width == width) && (casted_vec[i]->cropped_y == start_sourced_line) && (casted_vec[i]->cropped_x == start_x) && (casted_vec[i]->format == base_format)) {
@@ -396,7 +392,7 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
                     last_use_color_surface_index.erase(used_iterator);
                 }
 
-                last_use_color_surface_index.push_back(ite->first);
+                last_use_color_surface_index.push_back(ite->start);
                 return info.gl_texture[0];
             } else {
                 return 0;
@@ -448,17 +444,18 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
 
-    if (color_surface_textures.count(key) > 0) {
+    if (color_surface_textures.find(key)) {
         LOG_WARN_ONCE("Two different surfaces have the same base adress, this is not handled, an openGL error will happen.");
     }
-    color_surface_textures.emplace(key, std::move(info_added));
+    const std::size_t total_bytes = info_added->total_bytes;
+    color_surface_textures.emplace(key, total_bytes, std::move(info_added));
 
     // Now that everything goes well, we can start rearranging
     if (last_use_color_surface_index.size() >= MAX_CACHE_SIZE_PER_CONTAINER) {
         // We have to purge a cache along with framebuffer
         // So choose the one that is last used
         const std::uint64_t first_key = last_use_color_surface_index.front();
-        GLuint texture_handle = color_surface_textures.find(first_key)->second->gl_texture[0];
+        GLuint texture_handle = color_surface_textures.find(first_key)->value->gl_texture[0];
 
         for (auto it = framebuffer_array.cbegin(); it != framebuffer_array.cend();) {
             if ((it->first & 0xFFFFFFFF) == texture_handle) {
@@ -487,11 +484,11 @@ GLuint GLSurfaceCache::retrieve_color_surface_texture_handle(const State &state,
 
 GLuint GLSurfaceCache::retrieve_ping_pong_color_surface_texture_handle(Ptr<void> address) {
     auto ite = color_surface_textures.find(address.address());
-    if (ite == color_surface_textures.end()) {
+    if (ite == nullptr) {
         return 0;
     }
 
-    GLColorSurfaceCacheInfo &info = *ite->second;
+    GLColorSurfaceCacheInfo &info = *ite->value;
 
     GLenum surface_internal_format = color::translate_internal_format(info.format);
     GLenum surface_upload_format = color::translate_format(info.format);
@@ -716,19 +713,19 @@ GLuint GLSurfaceCache::retrieve_framebuffer_handle(const State &state, const Mem
 }
 
 GLuint GLSurfaceCache::sourcing_color_surface_for_presentation(Ptr<const void> address, uint32_t width, uint32_t height, const std::uint32_t pitch, float *uvs, const int res_multiplier, SceFVector2 &texture_size) {
-    auto ite = color_surface_textures.lower_bound(address.address());
-    if (ite == color_surface_textures.end()) {
+    auto ite = color_surface_textures.find_containing(address.address());
+    if (ite == nullptr) {
         return 0;
     }
 
     width *= res_multiplier;
     height *= res_multiplier;
 
-    const GLColorSurfaceCacheInfo &info = *ite->second;
+    const GLColorSurfaceCacheInfo &info = *ite->value;
 
     if (info.pixel_stride == pitch) {
         // In assumption the format is RGBA8
-        const std::size_t data_delta = address.address() - ite->first;
+        const std::size_t data_delta = address.address() - ite->start;
         std::uint32_t limited_height = height;
         if ((data_delta % (pitch * 4)) == 0) {
             std::uint32_t start_sourced_line = (data_delta / (pitch * 4)) * res_multiplier;
@@ -0,0 +1,91 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <renderer/gl/surface_readback.h>
+
+#include <renderer/gxm_types.h>
+#include <renderer/surface_capture.h>
+#include <util/log.h>
+
+#include <cstring>
+#include <vector>
+
+namespace renderer::gl {
+
+static void hand_readback(SurfaceReadback::Slot &slot, SurfaceCapture &capture) {
+    slot.pending = false;
+
+    const size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer[0]);
+    const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels) {
+        std::vector<uint8_t> copy(size);
+        memcpy(copy.data(), pixels, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        capture_surface(capture, slot.address, slot.frame, slot.width, slot.height, std::move(copy));
+    } else {
+        LOG_ERROR("Failed to map the readback of color surface 0x{:X}", slot.address);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void queue_surface_readback(SurfaceReadback &readback, SurfaceCapture &capture, const SceGxmColorSurface &surface, int res_multiplier) {
+    SurfaceReadback::Slot &slot = readback.slots[readback.next_slot];
+    if (slot.pending) {
+        // the capture must not make the renderer wait for the GPU
+        if (!slot.fence.is_signaled()) {
+            if (capture.dropped_count++ == 0)
+                LOG_WARN("The color surfaces are captured faster than the GPU reads them back, some of them are dropped");
+            return;
+        }
+        hand_readback(slot, capture);
+    }
+    readback.next_slot = (readback.next_slot + 1) % SurfaceReadback::SLOT_COUNT;
+
+    slot.address = surface.data.address();
+    slot.frame = capture.frame;
+    slot.width = surface.width * res_multiplier;
+    slot.height = surface.height * res_multiplier;
+
+    if (!slot.buffer[0])
+        slot.buffer.init(reinterpret_cast<renderer::Generator *>(glGenBuffers), reinterpret_cast<renderer::Deleter *>(glDeleteBuffers));
+
+    const size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer[0]);
+    if (slot.capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+
+    // the pixels are converted to rgba8 by the driver, the copy is done by the GPU
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glReadPixels(0, 0, static_cast<GLsizei>(slot.width), static_cast<GLsizei>(slot.height), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence.insert();
+    slot.pending = true;
+}
+
+void poll_surface_readbacks(SurfaceReadback &readback, SurfaceCapture &capture) {
+    for (auto &slot : readback.slots) {
+        if (slot.pending && slot.fence.is_signaled())
+            hand_readback(slot, capture);
+    }
+}
+
+} // namespace renderer::gl
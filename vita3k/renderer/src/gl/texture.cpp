@@ -29,6 +29,9 @@
 
 static constexpr bool log_parameter = false;
 
+// at most half of it is allocated between two flushes, so the region of a pending copy is not reused before it is issued
+static constexpr size_t UPLOAD_RING_SIZE = 64 * 1024 * 1024;
+
 namespace renderer::gl {
 
 using namespace texture;
@@ -55,13 +58,81 @@ static void apply_sampler_state(const SceGxmTexture &gxm_texture, const GLenum t
         glTexParameterf(texture_bind_type, GL_TEXTURE_MAX_ANISOTROPY_EXT, static_cast<float>(anisotropic_filtering));
 }
 
+GLTextureCache::~GLTextureCache() {
+    // the decode workers may still be writing to the upload ring
+    wait_decode_jobs();
+}
+
 bool GLTextureCache::init(const bool hashless_texture_cache, const fs::path &texture_folder, const std::string_view game_id) {
     TextureCache::init(hashless_texture_cache, texture_folder, game_id);
     backend = Backend::OpenGL;
 
+    upload_ring = std::make_unique<RingBuffer>(GL_PIXEL_UNPACK_BUFFER, UPLOAD_RING_SIZE);
+    // the pixels are written to the upload ring which stays mapped, the copies are issued before the next draw
+    support_deferred_upload = true;
+
+    GLint texture_unit_count = 0;
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &texture_unit_count);
+    upload_texture_unit = GL_TEXTURE0 + std::max(texture_unit_count - 1, 0);
+
     return textures.init(reinterpret_cast<renderer::Generator *>(glGenTextures), reinterpret_cast<renderer::Deleter *>(glDeleteTextures));
 }
 
+// pixels is either an offset in the bound pixel unpack buffer or a pointer to the client memory
+void GLTextureCache::copy_texture(const GLPendingUpload &upload, const void *pixels) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(upload.pixels_per_stride));
+
+    if (gxm::is_bcn_format(upload.base_format)) {
+        const GLint block_size = (upload.base_format == SCE_GXM_TEXTURE_BASE_FORMAT_UBC1 || upload.base_format == SCE_GXM_TEXTURE_BASE_FORMAT_UBC4 || upload.base_format == SCE_GXM_TEXTURE_BASE_FORMAT_SBC4)
+            ? 8
+            : 16;
+        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_SIZE, block_size);
+        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_WIDTH, 4);
+        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_HEIGHT, 4);
+
+        const GLenum format = translate_format(upload.base_format);
+        glCompressedTexSubImage2D(upload.upload_type, upload.mip_index, 0, 0, upload.width, upload.height, format, static_cast<GLsizei>(upload.size), pixels);
+
+        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_SIZE, 0);
+        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_WIDTH, 0);
+        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_HEIGHT, 0);
+    } else {
+        const GLenum format = translate_format(upload.base_format);
+        const GLenum type = translate_type(upload.base_format);
+        glTexSubImage2D(upload.upload_type, upload.mip_index, 0, 0, upload.width, upload.height, format, type, pixels);
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void GLTextureCache::flush_uploads() {
+    if (!upload_ring)
+        return;
+
+    if (!pending_uploads.empty()) {
+        R_PROFILE(__func__);
+
+        // the upload ring must be filled before any copy from it is issued
+        wait_decode_jobs();
+
+        glActiveTexture(upload_texture_unit);
+        for (const GLPendingUpload &upload : pending_uploads) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.client_data ? 0 : upload_ring->handle());
+            glBindTexture(upload.bind_type, upload.texture);
+            copy_texture(upload, upload.client_data ? upload.client_data->data() : reinterpret_cast<const void *>(upload.offset));
+            glBindTexture(upload.bind_type, 0);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+
+        pending_uploads.clear();
+    }
+
+    // fence the segments holding the pixels of the copies issued since the last flush
+    upload_ring->draw_call_done();
+    upload_ring_used = 0;
+}
+
 void GLTextureCache::select(size_t index, const SceGxmTexture &texture) {
     const GLuint gl_texture = textures[index];
     glBindTexture(get_gl_texture_type(texture), gl_texture);
@@ -144,33 +215,69 @@ void GLTextureCache::upload_texture_impl(SceGxmTextureBaseFormat base_format, ui
         // GXM's cube map index is same as OpenGL: right, left, top, bottom, front, back
         upload_type = GL_TEXTURE_CUBE_MAP_POSITIVE_X + (face - 1);
 
-    if (gxm::is_bcn_format(base_format)) {
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(pixels_per_stride));
-
-        const GLint block_size = (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_UBC1 || base_format == SCE_GXM_TEXTURE_BASE_FORMAT_UBC4 || base_format == SCE_GXM_TEXTURE_BASE_FORMAT_SBC4)
-            ? 8
-            : 16;
-        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_SIZE, block_size);
-        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_WIDTH, 4);
-        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_HEIGHT, 4);
+    size_t upload_size;
+    if (gxm::is_bcn_format(base_format))
+        upload_size = renderer::texture::get_compressed_size(base_format, pixels_per_stride, height);
+    else
+        upload_size = static_cast<size_t>(pixels_per_stride) * height * ((gxm::bits_per_pixel(base_format) + 7) >> 3);
+
+    GLPendingUpload upload{
+        .bind_type = face > 0 ? static_cast<GLenum>(GL_TEXTURE_CUBE_MAP) : static_cast<GLenum>(GL_TEXTURE_2D),
+        .upload_type = upload_type,
+        .base_format = base_format,
+        .mip_index = mip_index,
+        .width = width,
+        .height = height,
+        .pixels_per_stride = pixels_per_stride,
+        .size = upload_size
+    };
+
+    if (!pixels) {
+        // the copy is issued before the next draw, once the decode workers are done
+        GLint bound_texture = 0;
+        glGetIntegerv(face > 0 ? GL_TEXTURE_BINDING_CUBE_MAP : GL_TEXTURE_BINDING_2D, &bound_texture);
+        upload.texture = static_cast<GLuint>(bound_texture);
+
+        // the copies of the mips of this texture are not scheduled yet, so the ring can't be flushed to make room
+        uint8_t *ring_data = nullptr;
+        if (upload_ring_used + upload_size <= UPLOAD_RING_SIZE / 2)
+            std::tie(ring_data, upload.offset) = upload_ring->allocate(upload_size);
+
+        if (ring_data) {
+            upload_ring_used += upload_size;
+            deferred_upload_write = [ring_data, upload_size](const void *pixels) {
+                memcpy(ring_data, pixels, upload_size);
+            };
+        } else {
+            upload.client_data = std::make_shared<std::vector<uint8_t>>(upload_size);
+            deferred_upload_write = [data = upload.client_data](const void *pixels) {
+                memcpy(data->data(), pixels, data->size());
+            };
+        }
 
-        const GLenum format = translate_format(base_format);
-        size_t compressed_size = renderer::texture::get_compressed_size(base_format, pixels_per_stride, height);
-        glCompressedTexSubImage2D(upload_type, mip_index, 0, 0, width, height, format, static_cast<GLsizei>(compressed_size), pixels);
+        pending_uploads.push_back(std::move(upload));
+        return;
+    }
 
-        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_SIZE, 0);
-        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_WIDTH, 0);
-        glPixelStorei(GL_UNPACK_COMPRESSED_BLOCK_HEIGHT, 0);
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    } else {
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(pixels_per_stride));
+    if (upload_ring && upload_size <= UPLOAD_RING_SIZE / 2) {
+        if (upload_ring_used + upload_size > UPLOAD_RING_SIZE / 2)
+            flush_uploads();
 
-        const GLenum format = translate_format(base_format);
-        const GLenum type = translate_type(base_format);
-        glTexSubImage2D(upload_type, mip_index, 0, 0, width, height, format, type, pixels);
+        uint8_t *ring_data;
+        std::tie(ring_data, upload.offset) = upload_ring->allocate(upload_size);
+        if (ring_data) {
+            upload_ring_used += upload_size;
+            memcpy(ring_data, pixels, upload_size);
 
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring->handle());
+            copy_texture(upload, reinterpret_cast<const void *>(upload.offset));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return;
+        }
     }
+
+    // the upload ring is not available, upload from the client memory
+    copy_texture(upload, pixels);
 }
 
 void GLTextureCache::import_configure_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, bool is_srgb, uint16_t nb_components, uint16_t mipcount, bool swap_rb) {
@@ -0,0 +1,175 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/program_info_cache.h>
+
+#include <gxm/functions.h>
+#include <gxm/types.h>
+#include <shader/spirv_recompiler.h>
+#include <util/log.h>
+
+#include <xxh3.h>
+
+#include <cstring>
+
+namespace renderer {
+
+static constexpr char cache_magic[4] = { 'V', 'P', 'I', 'C' };
+// increase this value when the format of the file changes
+static constexpr uint32_t cache_format_version = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t format_version;
+    // the analysis of the programs is done by the shader module
+    uint32_t shader_version;
+    uint32_t entry_count;
+};
+
+struct CacheAttribute {
+    int32_t index;
+    uint32_t info;
+    uint8_t is_integer;
+    uint8_t is_signed;
+    uint8_t regformat;
+    uint8_t padding;
+};
+
+template <typename T>
+static bool read_value(fs::ifstream &file, T &value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+template <typename T>
+static void write_value(fs::ofstream &file, const T &value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void ProgramInfoCache::open(const fs::path &shaders_path) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    path = shaders_path / file_name;
+    entries.clear();
+    dirty = false;
+
+    fs::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    CacheHeader header;
+    if (!read_value(file, header) || memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+        || header.format_version != cache_format_version || header.shader_version != shader::CURRENT_VERSION) {
+        LOG_WARN("Programs cache {} is outdated or invalid, recreating it", path.string());
+        dirty = true;
+        return;
+    }
+
+    for (uint32_t i = 0; i < header.entry_count; i++) {
+        uint64_t key;
+        Entry entry;
+        uint32_t attribute_count;
+        if (!read_value(file, key) || !read_value(file, entry.program_size) || !read_value(file, entry.info.hash)
+            || !read_value(file, entry.info.uniform_buffer_sizes) || !read_value(file, entry.info.buffer_count)
+            || !read_value(file, entry.info.textures_used) || !read_value(file, attribute_count))
+            break;
+
+        bool complete = true;
+        for (uint32_t j = 0; j < attribute_count && complete; j++) {
+            CacheAttribute attribute;
+            complete = read_value(file, attribute);
+            shader::usse::AttributeInformation &info = entry.info.attribute_infos[attribute.index];
+            info.info = attribute.info;
+            info.is_integer = attribute.is_integer;
+            info.is_signed = attribute.is_signed;
+            info.regformat = attribute.regformat;
+        }
+        if (!complete)
+            break;
+
+        entries.emplace(key, std::move(entry));
+    }
+
+    LOG_INFO("Loaded the info of {} programs from the cache", entries.size());
+}
+
+void ProgramInfoCache::save() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    // the file can also have been removed along the shaders cache
+    if (path.empty() || entries.empty() || (!dirty && fs::exists(path)))
+        return;
+
+    if (!fs::exists(path.parent_path()))
+        fs::create_directories(path.parent_path());
+
+    fs::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    CacheHeader header{};
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.format_version = cache_format_version;
+    header.shader_version = shader::CURRENT_VERSION;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    write_value(file, header);
+
+    for (const auto &[key, entry] : entries) {
+        write_value(file, key);
+        write_value(file, entry.program_size);
+        write_value(file, entry.info.hash);
+        write_value(file, entry.info.uniform_buffer_sizes);
+        write_value(file, entry.info.buffer_count);
+        write_value(file, entry.info.textures_used);
+        write_value(file, static_cast<uint32_t>(entry.info.attribute_infos.size()));
+        for (const auto &[index, info] : entry.info.attribute_infos) {
+            const CacheAttribute attribute{
+                .index = index,
+                .info = info.info,
+                .is_integer = info.is_integer,
+                .is_signed = info.is_signed,
+                .regformat = info.regformat,
+            };
+            write_value(file, attribute);
+        }
+    }
+
+    dirty = false;
+}
+
+ProgramInfo ProgramInfoCache::get(const SceGxmProgram &program, const bool is_vertex) {
+    const uint64_t key = XXH3_64bits(&program, program.size);
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto it = entries.find(key);
+        if (it != entries.end() && it->second.program_size == program.size)
+            return it->second.info;
+    }
+
+    // not computed with the mutex held, the analysis of a big program can be slow
+    ProgramInfo info;
+    info.hash = sha256(&program, program.size);
+    info.buffer_count = shader::usse::get_uniform_buffer_sizes(program, info.uniform_buffer_sizes);
+    info.textures_used = static_cast<uint32_t>(gxp::get_textures_used(program).to_ulong());
+    if (is_vertex)
+        shader::usse::get_attribute_informations(program, info.attribute_infos);
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = { program.size, info };
+    dirty = true;
+
+    return info;
+}
+
+} // namespace renderer
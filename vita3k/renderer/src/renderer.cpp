@@ -97,6 +97,64 @@ void draw(State &state, Context *ctx, SceGxmPrimitiveType prim_type, SceGxmIndex
     renderer::add_command(ctx, renderer::CommandOpcode::Draw, nullptr, prim_type, index_type, index_data, index_count, instance_count);
 }
 
+// the commands have their payload size on 16 bits, this can't be reached by a precomputed draw
+static std::size_t get_precomputed_draw_payload_size(const PrecomputedDraw &draw) {
+    constexpr std::size_t program_size = sizeof(Ptr<const void>) + sizeof(bool);
+    constexpr std::size_t uniform_buffer_size = sizeof(Ptr<const void>) + sizeof(bool) + sizeof(int) + sizeof(std::uint32_t);
+    constexpr std::size_t texture_size = sizeof(std::uint32_t) + sizeof(SceGxmTexture);
+    constexpr std::size_t vertex_stream_size = sizeof(Ptr<const void>) + 2 * sizeof(std::size_t);
+    constexpr std::size_t draw_size = sizeof(SceGxmPrimitiveType) + sizeof(SceGxmIndexFormat) + sizeof(Ptr<const void>) + 2 * sizeof(std::uint32_t);
+
+    return 3 * sizeof(std::uint8_t) + 2 * program_size + draw.uniform_buffers.size() * uniform_buffer_size
+        + draw.textures.size() * texture_size + draw.vertex_streams.size() * vertex_stream_size + draw_size;
+}
+
+void draw_precomputed(State &state, Context *ctx, const PrecomputedDraw &draw) {
+    if (!ctx) {
+        return;
+    }
+
+    Command *cmd = ctx->alloc_func(get_precomputed_draw_payload_size(draw));
+    if (!cmd) {
+        // no room for the whole draw, send its states one by one
+        set_program(state, ctx, draw.fragment_program, true);
+        set_program(state, ctx, draw.vertex_program, false);
+        for (const PrecomputedUniformBuffer &uniform_buffer : draw.uniform_buffers)
+            set_uniform_buffer(state, ctx, uniform_buffer.is_vertex, uniform_buffer.block_num, uniform_buffer.size, uniform_buffer.buffer);
+        for (const PrecomputedTexture &texture : draw.textures)
+            set_texture(state, ctx, texture.index, texture.texture);
+        for (const PrecomputedVertexStream &vertex_stream : draw.vertex_streams)
+            set_vertex_stream(state, ctx, vertex_stream.index, vertex_stream.data_len, vertex_stream.stream);
+        renderer::draw(state, ctx, draw.prim_type, draw.index_type, draw.index_data, draw.index_count, draw.instance_count);
+        return;
+    }
+
+    cmd->opcode = CommandOpcode::DrawPrecomputed;
+    cmd->status = nullptr;
+    cmd->next = nullptr;
+
+    // same arguments as the commands sent by the functions above
+    CommandHelper helper(cmd);
+    bool pushed = do_command_push_data(helper, static_cast<std::uint8_t>(draw.uniform_buffers.size()), static_cast<std::uint8_t>(draw.textures.size()),
+        static_cast<std::uint8_t>(draw.vertex_streams.size()), draw.fragment_program, true, draw.vertex_program, false);
+    for (const PrecomputedUniformBuffer &uniform_buffer : draw.uniform_buffers) {
+        const std::uint32_t bytes_to_copy_and_pad = (((uniform_buffer.size + 15) / 16)) * 16;
+        pushed = pushed && do_command_push_data(helper, uniform_buffer.buffer, uniform_buffer.is_vertex, uniform_buffer.block_num, bytes_to_copy_and_pad);
+    }
+    for (const PrecomputedTexture &texture : draw.textures)
+        pushed = pushed && do_command_push_data(helper, texture.index, texture.texture);
+    for (const PrecomputedVertexStream &vertex_stream : draw.vertex_streams)
+        pushed = pushed && do_command_push_data(helper, vertex_stream.stream, vertex_stream.index, vertex_stream.data_len);
+    pushed = pushed && do_command_push_data(helper, draw.prim_type, draw.index_type, draw.index_data, draw.index_count, draw.instance_count);
+
+    if (!pushed) {
+        ctx->free_func(cmd);
+        return;
+    }
+
+    append_command(ctx->command_list, cmd);
+}
+
 void transfer_copy(State &state, uint32_t colorKeyValue, uint32_t colorKeyMask, SceGxmTransferColorKeyMode colorKeyMode, const SceGxmTransferImage *images, SceGxmTransferType srcType, SceGxmTransferType destType) {
     renderer::send_single_command(state, nullptr, renderer::CommandOpcode::TransferCopy, false, colorKeyValue, colorKeyMask, colorKeyMode, images, srcType, destType);
 }
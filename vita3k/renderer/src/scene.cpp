@@ -23,6 +23,7 @@
 #include <renderer/types.h>
 
 #include <renderer/gl/functions.h>
+#include <renderer/gl/state.h>
 #include <renderer/gl/types.h>
 
 #include <renderer/vulkan/functions.h>
@@ -32,13 +33,6 @@
 #include <util/log.h>
 #include <util/tracy.h>
 
-#define DEBUG_FRAMEBUFFER 1
-
-#if DEBUG_FRAMEBUFFER
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
-#endif
-
 namespace renderer {
 COMMAND(handle_set_context) {
     TRACY_FUNC_COMMANDS(handle_set_context);
@@ -133,6 +127,12 @@ COMMAND(handle_sync_surface_data) {
     }
 
     if (renderer.disable_surface_sync || renderer.current_backend == Backend::Vulkan) {
+        // the pixels are not copied to the guest memory, read them back from the GPU without waiting for it
+        if (renderer.current_backend == Backend::OpenGL && !helper.cmd->status && should_capture_surface(renderer.surface_capture, config, surface->data.address())) {
+            gl::GLState &gl_state = static_cast<gl::GLState &>(renderer);
+            gl::queue_surface_readback(gl_state.surface_readback, renderer.surface_capture, *surface, gl_state.res_multiplier);
+        }
+
         if (helper.cmd->status) {
             complete_command(renderer, helper, 0);
         }
@@ -170,18 +170,10 @@ COMMAND(handle_sync_surface_data) {
         break;
     }
 
-#if DEBUG_FRAMEBUFFER
-    if (data != 0 && config.color_surface_debug) {
-        const std::string filename = fmt::format("color_surface_0x{:X}.png", data);
-
+    if (should_capture_surface(renderer.surface_capture, config, data)) {
         // Assuming output is RGBA
-        const int result = stbi_write_png(filename.c_str(), width, height, 4, pixels, stride_in_pixels * 4);
-
-        if (!result) {
-            LOG_TRACE("Fail to save color surface 0x{:X}", data);
-        }
+        capture_surface(renderer.surface_capture, data, renderer.surface_capture.frame, width, height, stride_in_pixels, pixels);
     }
-#endif
 
     // Need to reprotect. In the case of explicit get, 100% chance it will be unlock later anyway.
     // No need to bother. Assumption of course.
@@ -221,6 +213,10 @@ COMMAND(handle_draw) {
     const std::uint32_t count = helper.pop<const std::uint32_t>();
     const std::uint32_t instance_count = helper.pop<const std::uint32_t>();
 
+    // the frame is not presented and nothing reads this surface before it is drawn again
+    if (renderer.frame_skip.is_draw_skipped(render_context->record.color_surface.data.address()))
+        return;
+
     switch (renderer.current_backend) {
     case Backend::OpenGL:
         gl::draw(dynamic_cast<gl::GLState &>(renderer), *reinterpret_cast<gl::GLContext *>(render_context),
@@ -238,6 +234,25 @@ COMMAND(handle_draw) {
     }
 }
 
+COMMAND(handle_draw_precomputed) {
+    TRACY_FUNC_COMMANDS(handle_draw_precomputed);
+    const std::uint8_t uniform_buffer_count = helper.pop<std::uint8_t>();
+    const std::uint8_t texture_count = helper.pop<std::uint8_t>();
+    const std::uint8_t vertex_stream_count = helper.pop<std::uint8_t>();
+
+    // the fragment program then the vertex one, the uniform buffers need both
+    cmd_set_state_program(renderer, mem, config, helper, render_context, cache_path, title_id);
+    cmd_set_state_program(renderer, mem, config, helper, render_context, cache_path, title_id);
+    for (std::uint8_t i = 0; i < uniform_buffer_count; i++)
+        cmd_set_state_uniform_buffer(renderer, mem, config, helper, render_context, cache_path, title_id);
+    for (std::uint8_t i = 0; i < texture_count; i++)
+        cmd_set_state_texture(renderer, mem, config, helper, render_context, cache_path, title_id);
+    for (std::uint8_t i = 0; i < vertex_stream_count; i++)
+        cmd_set_state_vertex_stream(renderer, mem, config, helper, render_context, cache_path, title_id);
+
+    cmd_handle_draw(renderer, mem, config, helper, features, render_context, cache_path, title_id, self_name);
+}
+
 COMMAND(handle_transfer_copy) {
     TRACY_FUNC_COMMANDS(handle_transfer_copy);
     const uint32_t colorKeyValue = helper.pop<uint32_t>();
@@ -249,6 +264,14 @@ COMMAND(handle_transfer_copy) {
     const SceGxmTransferType src_type = helper.pop<SceGxmTransferType>();
     const SceGxmTransferType dst_type = helper.pop<SceGxmTransferType>();
 
+    // color keys can't be applied by a GPU copy
+    if (renderer.current_backend == Backend::Vulkan && render_context && colorKeyMode == SCE_GXM_TRANSFER_COLORKEY_NONE
+        && src_type == SCE_GXM_TRANSFER_LINEAR && dst_type == SCE_GXM_TRANSFER_LINEAR
+        && vulkan::transfer_copy(*reinterpret_cast<vulkan::VKContext *>(render_context), *src, *dest)) {
+        delete[] images;
+        return;
+    }
+
     const auto src_is_linear = src_type == SCE_GXM_TRANSFER_LINEAR;
     const auto dest_is_swizzled = dst_type == SCE_GXM_TRANSFER_SWIZZLED;
 
@@ -349,7 +372,7 @@ COMMAND(handle_transfer_copy) {
     } else
         LOG_WARN("No convertion from SceGxmTransferType {} to {} is supported yet", (int)src_type, (int)dst_type);
 
-    // TODO: handle case where dest is a cached surface
+    // TODO: handle case where dest is a cached surface but the transfer could not be done on the GPU
 
     delete[] images;
 }
@@ -359,6 +382,13 @@ COMMAND(handle_transfer_downscale) {
     const SceGxmTransferImage *src = helper.pop<SceGxmTransferImage *>();
     const SceGxmTransferImage *dest = helper.pop<SceGxmTransferImage *>();
 
+    if (renderer.current_backend == Backend::Vulkan && render_context
+        && vulkan::transfer_downscale(*reinterpret_cast<vulkan::VKContext *>(render_context), *src, *dest)) {
+        delete src;
+        delete dest;
+        return;
+    }
+
     const auto src_bpp = gxm::get_bits_per_pixel(src->format);
     const auto dest_bpp = gxm::get_bits_per_pixel(dest->format);
     const uint32_t src_bytes_per_pixel = (src_bpp + 7) >> 3;
@@ -379,7 +409,7 @@ COMMAND(handle_transfer_downscale) {
         }
     }
 
-    // TODO: handle case where dest is a cached surface
+    // TODO: handle case where dest is a cached surface but the transfer could not be done on the GPU
 
     delete src;
     delete dest;
@@ -390,6 +420,12 @@ COMMAND(handle_transfer_fill) {
     const uint32_t fill_color = helper.pop<uint32_t>();
     const SceGxmTransferImage *dest = helper.pop<SceGxmTransferImage *>();
 
+    if (renderer.current_backend == Backend::Vulkan && render_context
+        && vulkan::transfer_fill(*reinterpret_cast<vulkan::VKContext *>(render_context), fill_color, *dest)) {
+        delete dest;
+        return;
+    }
+
     const auto bpp = gxm::get_bits_per_pixel(dest->format);
 
     const uint32_t bytes_per_pixel = (bpp + 7) >> 3;
@@ -406,7 +442,7 @@ COMMAND(handle_transfer_fill) {
         }
     }
 
-    // TODO: handle case where dest is a cached surface
+    // TODO: handle case where dest is a cached surface but the transfer could not be done on the GPU
 
     delete dest;
 }
@@ -0,0 +1,326 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/shader_pack.h>
+
+#include <shader/spirv_recompiler.h>
+#include <util/log.h>
+
+#include <fmt/format.h>
+#include <xxh3.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+namespace renderer {
+
+static constexpr char pack_magic[4] = { 'V', 'S', 'P', 'K' };
+// increase this value when the format of the pack changes
+static constexpr uint32_t pack_format_version = 1;
+
+static uint64_t get_key(std::string_view name) {
+    return XXH3_64bits(name.data(), name.size());
+}
+
+// loose shader files are named "<version>-<sha256 in hex>.<extension>"
+static bool is_loose_shader(const std::string &name) {
+    const size_t hash_start = name.find('-');
+    if (hash_start == std::string::npos || name.size() <= hash_start + 1 + 64 || name[hash_start + 1 + 64] != '.')
+        return false;
+
+    return std::all_of(name.begin() + hash_start + 1, name.begin() + hash_start + 1 + 64, [](char c) {
+        return std::isxdigit(static_cast<unsigned char>(c));
+    });
+}
+
+struct PendingEntry {
+    ShaderPack::Entry entry;
+    // points either to a mapped pack or to the content of a loose file
+    const uint8_t *data;
+};
+
+// a name no other instance can pick, several of them can write the same file at the same time
+static fs::path get_temp_path(const fs::path &path) {
+    return path.string() + fs::unique_path(".%%%%%%%%.tmp").string();
+}
+
+// the pending entries are written in their order, their offsets are updated
+static bool write_pack(const fs::path &temp_path, std::vector<PendingEntry> &pack_entries) {
+    std::vector<ShaderPack::Entry> index;
+    index.reserve(pack_entries.size());
+    uint64_t offset = 0;
+    for (PendingEntry &pending : pack_entries) {
+        pending.entry.offset = offset;
+        offset += pending.entry.size;
+        index.push_back(pending.entry);
+    }
+    std::sort(index.begin(), index.end(), [](const ShaderPack::Entry &a, const ShaderPack::Entry &b) {
+        return a.key < b.key;
+    });
+
+    fs::ofstream pack_file(temp_path, std::ios::out | std::ios::binary);
+    if (!pack_file.is_open()) {
+        LOG_ERROR("Failed to create shaders pack {}", temp_path.string());
+        return false;
+    }
+
+    ShaderPack::Header header{};
+    memcpy(header.magic, pack_magic, sizeof(pack_magic));
+    header.format_version = pack_format_version;
+    header.entry_count = static_cast<uint32_t>(index.size());
+    pack_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    pack_file.write(reinterpret_cast<const char *>(index.data()), sizeof(ShaderPack::Entry) * index.size());
+    for (const PendingEntry &pending : pack_entries)
+        pack_file.write(reinterpret_cast<const char *>(pending.data), pending.entry.size);
+
+    if (!pack_file.good()) {
+        LOG_ERROR("Failed to write shaders pack {}", temp_path.string());
+        pack_file.close();
+        fs::remove(temp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool ShaderPack::map(const fs::path &pack_path) {
+    if (!file.open(pack_path))
+        return false;
+
+    const Header *header = reinterpret_cast<const Header *>(file.data());
+    if (file.size() < sizeof(Header) || memcmp(header->magic, pack_magic, sizeof(pack_magic)) != 0
+        || header->format_version != pack_format_version
+        || file.size() < sizeof(Header) + sizeof(Entry) * static_cast<size_t>(header->entry_count)) {
+        LOG_WARN("Shaders pack {} is invalid, ignoring it", pack_path.string());
+        file.close();
+        return false;
+    }
+
+    entry_count = header->entry_count;
+    entries = reinterpret_cast<const Entry *>(file.data() + sizeof(Header));
+    blobs = reinterpret_cast<const uint8_t *>(entries + entry_count);
+    blobs_size = file.size() - (blobs - file.data());
+
+    return true;
+}
+
+void ShaderPack::open(const fs::path &shaders_path) {
+    close();
+    if (!fs::exists(shaders_path))
+        return;
+
+    const fs::path pack_path = shaders_path / file_name;
+    map(pack_path);
+
+    std::vector<PendingEntry> loose_entries;
+    std::vector<std::vector<uint8_t>> loose_contents;
+    std::vector<fs::path> loose_files;
+
+    for (const auto &dir_entry : fs::directory_iterator(shaders_path)) {
+        if (!fs::is_regular_file(dir_entry.status()))
+            continue;
+
+        const std::string name = dir_entry.path().filename().string();
+        if (!is_loose_shader(name))
+            continue;
+
+        loose_files.push_back(dir_entry.path());
+        fs::ifstream loose_file(dir_entry.path(), std::ios::in | std::ios::binary);
+        std::vector<uint8_t> content((std::istreambuf_iterator<char>(loose_file)), std::istreambuf_iterator<char>());
+        if (content.empty())
+            continue;
+
+        loose_entries.push_back({ { get_key(name), shader::CURRENT_VERSION, static_cast<uint32_t>(content.size()), 0 }, content.data() });
+        loose_contents.push_back(std::move(content));
+    }
+
+    // keep the entries which are still valid and have not been replaced by a loose file
+    std::vector<PendingEntry> pack_entries;
+    size_t dropped_entries = 0;
+    for (uint32_t i = 0; i < entry_count; i++) {
+        const Entry &entry = entries[i];
+        const bool replaced = std::any_of(loose_entries.begin(), loose_entries.end(), [&](const PendingEntry &loose_entry) {
+            return loose_entry.entry.key == entry.key;
+        });
+        if (entry.shader_version != shader::CURRENT_VERSION || replaced || entry.offset + entry.size > blobs_size) {
+            dropped_entries++;
+            continue;
+        }
+        pack_entries.push_back({ entry, blobs + entry.offset });
+    }
+
+    if (loose_files.empty() && dropped_entries == 0)
+        // the pack is up to date
+        return;
+
+    // the blobs already in the pack keep their order and the new ones are appended after them,
+    // the blobs of the dropped entries are removed at the same time
+    std::sort(pack_entries.begin(), pack_entries.end(), [](const PendingEntry &a, const PendingEntry &b) {
+        return a.entry.offset < b.entry.offset;
+    });
+    pack_entries.insert(pack_entries.end(), loose_entries.begin(), loose_entries.end());
+
+    const fs::path temp_path = get_temp_path(pack_path);
+    if (!write_pack(temp_path, pack_entries))
+        return;
+
+    // the old pack must be unmapped before it can be replaced
+    close();
+    boost::system::error_code error;
+    fs::rename(temp_path, pack_path, error);
+    if (error) {
+        LOG_ERROR("Failed to replace shaders pack {}: {}", pack_path.string(), error.message());
+        fs::remove(temp_path, error);
+    } else {
+        for (const fs::path &loose_file : loose_files)
+            fs::remove(loose_file, error);
+        if (dropped_entries > 0)
+            LOG_INFO("Removed {} outdated shaders from the shaders pack", dropped_entries);
+    }
+
+    map(pack_path);
+}
+
+void ShaderPack::open_shared(const fs::path &shaders_path) {
+    close();
+    if (fs::exists(shaders_path / file_name))
+        map(shaders_path / file_name);
+}
+
+size_t ShaderPack::merge(const fs::path &overlay_path, const fs::path &shared_path) {
+    ShaderPack overlay;
+    overlay.open(overlay_path);
+    ShaderPack shared_pack;
+    shared_pack.open_shared(shared_path);
+
+    std::vector<PendingEntry> pack_entries;
+    std::unordered_set<uint64_t> keys;
+    for (uint32_t i = 0; i < shared_pack.entry_count; i++) {
+        const Entry &entry = shared_pack.entries[i];
+        if (entry.shader_version == shader::CURRENT_VERSION && entry.offset + entry.size <= shared_pack.blobs_size) {
+            pack_entries.push_back({ entry, shared_pack.blobs + entry.offset });
+            keys.insert(entry.key);
+        }
+    }
+    std::sort(pack_entries.begin(), pack_entries.end(), [](const PendingEntry &a, const PendingEntry &b) {
+        return a.entry.offset < b.entry.offset;
+    });
+
+    size_t added = 0;
+    for (uint32_t i = 0; i < overlay.entry_count; i++) {
+        const Entry &entry = overlay.entries[i];
+        if (entry.shader_version != shader::CURRENT_VERSION || entry.offset + entry.size > overlay.blobs_size || !keys.insert(entry.key).second)
+            continue;
+        pack_entries.push_back({ entry, overlay.blobs + entry.offset });
+        added++;
+    }
+
+    if (added == 0 && pack_entries.size() == shared_pack.entry_count)
+        return 0;
+
+    const fs::path pack_path = shared_path / file_name;
+    const fs::path temp_path = get_temp_path(pack_path);
+    if (!write_pack(temp_path, pack_entries))
+        return 0;
+
+    shared_pack.close();
+    boost::system::error_code error;
+    fs::rename(temp_path, pack_path, error);
+    if (error) {
+        LOG_ERROR("Failed to replace shaders pack {}: {}, close the instances using the shared shader cache and merge again", pack_path.string(), error.message());
+        fs::remove(temp_path, error);
+        return 0;
+    }
+
+    return added;
+}
+
+void ShaderPack::close() {
+    file.close();
+    entries = nullptr;
+    entry_count = 0;
+    blobs = nullptr;
+    blobs_size = 0;
+}
+
+std::span<const uint8_t> ShaderPack::find_key(uint64_t key) const {
+    const Entry *end = entries + entry_count;
+    const Entry *entry = std::lower_bound(entries, end, key, [](const Entry &entry, uint64_t key) {
+        return entry.key < key;
+    });
+    if (entry == end || entry->key != key || entry->shader_version != shader::CURRENT_VERSION)
+        return {};
+
+    return { blobs + entry->offset, entry->size };
+}
+
+std::span<const uint8_t> ShaderPack::find(std::string_view hash_text, std::string_view extension) const {
+    if (entry_count == 0 && (!shared || shared->entry_count == 0))
+        return {};
+
+    if (extension.starts_with('.'))
+        extension.remove_prefix(1);
+
+    // same name as the one the loose file had
+    char name[256];
+    if (hash_text.size() + 1 + extension.size() > sizeof(name))
+        return {};
+    memcpy(name, hash_text.data(), hash_text.size());
+    name[hash_text.size()] = '.';
+    memcpy(name + hash_text.size() + 1, extension.data(), extension.size());
+    const uint64_t key = get_key(std::string_view(name, hash_text.size() + 1 + extension.size()));
+
+    const std::span<const uint8_t> content = find_key(key);
+    if (content.empty() && shared)
+        return shared->find_key(key);
+
+    return content;
+}
+
+fs::path get_shared_shaders_path(const fs::path &shared_cache_path, const char *title_id, const char *self_name, const char *backend, uint32_t features_mask) {
+    return shared_cache_path / "shaders" / title_id / self_name / fmt::format("{}-{:08x}", backend, features_mask);
+}
+
+bool publish_cache_file(const fs::path &path, const void *data, size_t size) {
+    const fs::path temp_path = get_temp_path(path);
+    {
+        fs::ofstream file(temp_path, std::ios::out | std::ios::binary);
+        if (!file.is_open())
+            return false;
+        file.write(static_cast<const char *>(data), size);
+        if (!file.good()) {
+            file.close();
+            fs::remove(temp_path);
+            return false;
+        }
+    }
+
+    boost::system::error_code error;
+    fs::rename(temp_path, path, error);
+    if (error) {
+        LOG_ERROR("Failed to replace {}: {}", path.string(), error.message());
+        fs::remove(temp_path, error);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace renderer
@@ -28,17 +28,45 @@
 #include <util/fs.h>
 #include <util/log.h>
 
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#include <cstring>
+#include <set>
+#include <span>
 #include <utility>
 
 namespace renderer {
 
+static const char *get_backend_name(const State &renderer) {
+    return (renderer.current_backend == Backend::OpenGL) ? "gl" : "vk";
+}
+
+static void open_shader_packs(State &renderer, const fs::path &shaders_path) {
+    renderer.shader_pack.open(shaders_path);
+    if (renderer.shared_cache_path.empty())
+        return;
+
+    renderer.shared_shader_pack.open_shared(get_shared_shaders_path(renderer.shared_cache_path, renderer.title_id, renderer.self_name, get_backend_name(renderer), renderer.get_features_mask()));
+    renderer.shader_pack.shared = &renderer.shared_shader_pack;
+}
+
 bool get_shaders_cache_hashs(State &renderer) {
     const auto shaders_path{ fs::path(renderer.cache_path) / "shaders" / renderer.title_id / renderer.self_name };
-    const std::string hash_file_name = fmt::format("hashs-{}.dat", (renderer.current_backend == Backend::OpenGL) ? "gl" : "vk");
+    const std::string hash_file_name = fmt::format("hashs-{}.dat", get_backend_name(renderer));
+
+    // the programs are created by the game before it draws anything, this must be opened even with no shader cached
+    renderer.program_info_cache.open(shaders_path);
 
     fs::ifstream shaders_hashs(shaders_path / hash_file_name, std::ios::in | std::ios::binary);
-    if (!shaders_hashs.is_open())
+    // an instance with no shader cached yet precompiles the ones of the shared cache
+    const bool from_shared_cache = !shaders_hashs.is_open() && !renderer.shared_cache_path.empty();
+    if (from_shared_cache)
+        shaders_hashs.open(get_shared_shaders_path(renderer.shared_cache_path, renderer.title_id, renderer.self_name, get_backend_name(renderer), renderer.get_features_mask()) / hash_file_name, std::ios::in | std::ios::binary);
+    if (!shaders_hashs.is_open()) {
+        open_shader_packs(renderer, shaders_path);
         return false;
+    }
 
     renderer.shaders_cache_hashs.clear();
     // Read size of hashes list
@@ -50,17 +78,34 @@ bool get_shaders_cache_hashs(State &renderer) {
     shaders_hashs.read((char *)&versionInFile, sizeof(uint32_t));
     uint32_t features_mask;
     shaders_hashs.read((char *)&features_mask, sizeof(uint32_t));
+    if (from_shared_cache && versionInFile != shader::CURRENT_VERSION) {
+        // the shared cache is only replaced by a merge
+        open_shader_packs(renderer, shaders_path);
+        return false;
+    }
     if (versionInFile != shader::CURRENT_VERSION || features_mask != renderer.get_features_mask()) {
         shaders_hashs.close();
-        fs::remove_all(shaders_path);
+        renderer.shader_pack.close();
+        if (features_mask != renderer.get_features_mask()) {
+            fs::remove_all(shaders_path);
+        } else {
+            // the shaders pack removes by itself the shaders from older versions when it is opened
+            for (const auto &entry : fs::directory_iterator(shaders_path)) {
+                if (entry.path().filename() != ShaderPack::file_name)
+                    fs::remove_all(entry.path());
+            }
+        }
         fs::remove_all(fs::path(renderer.log_path) / "shaderlog" / renderer.title_id / renderer.self_name);
         if (versionInFile != shader::CURRENT_VERSION)
             LOG_WARN("Current version of cache: {}, is outdated, recreate it.", versionInFile);
         else
             LOG_WARN("Incompatible GPU features enabled, recreating shader cache");
+        open_shader_packs(renderer, shaders_path);
         return false;
     }
 
+    open_shader_packs(renderer, shaders_path);
+
     if (renderer.current_backend == Backend::Vulkan) {
         // Read the pipeline cache
         dynamic_cast<vulkan::VKState &>(renderer).pipeline_cache.read_pipeline_cache();
@@ -92,31 +137,32 @@ void save_shaders_cache_hashs(State &renderer, std::vector<ShadersHash> &shaders
     const auto shaders_path{ fs::path(renderer.cache_path) / "shaders" / renderer.title_id / renderer.self_name };
     if (!fs::exists(shaders_path))
         fs::create_directory(shaders_path);
-    std::string hash_file_name = fmt::format("hashs-{}.dat", (renderer.current_backend == Backend::OpenGL) ? "gl" : "vk");
-    fs::ofstream shaders_hashs(shaders_path / hash_file_name, std::ios::out | std::ios::binary);
-
-    if (shaders_hashs.is_open()) {
-        // Write Size of shaders cache hashes list
-        const auto size = shaders_cache_hashs.size();
-        shaders_hashs.write((char *)&size, sizeof(size));
-
-        // Write version of cache
-        const uint32_t versionInFile = shader::CURRENT_VERSION;
-        shaders_hashs.write((char *)&versionInFile, sizeof(uint32_t));
-        const uint32_t features_mask = renderer.get_features_mask();
-        shaders_hashs.write((char *)&features_mask, sizeof(uint32_t));
-
-        // Write shader hash list
-        for (const auto &hash : shaders_cache_hashs) {
-            auto write = [&shaders_hashs](const Sha256Hash &hash) {
-                shaders_hashs.write(reinterpret_cast<const char *>(hash.data()), sizeof(Sha256Hash));
-            };
-
-            write(hash.frag);
-            write(hash.vert);
-        }
-        shaders_hashs.close();
+    std::string hash_file_name = fmt::format("hashs-{}.dat", get_backend_name(renderer));
+    std::vector<uint8_t> shaders_hashs;
+    const auto write = [&shaders_hashs](const void *data, size_t size) {
+        shaders_hashs.insert(shaders_hashs.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+    };
+
+    // Write Size of shaders cache hashes list
+    const auto size = shaders_cache_hashs.size();
+    write(&size, sizeof(size));
+
+    // Write version of cache
+    const uint32_t versionInFile = shader::CURRENT_VERSION;
+    write(&versionInFile, sizeof(uint32_t));
+    const uint32_t features_mask = renderer.get_features_mask();
+    write(&features_mask, sizeof(uint32_t));
+
+    // Write shader hash list
+    for (const auto &hash : shaders_cache_hashs) {
+        write(hash.frag.data(), sizeof(Sha256Hash));
+        write(hash.vert.data(), sizeof(Sha256Hash));
     }
+
+    // another instance using the same cache can be saving it at the same time
+    publish_cache_file(shaders_path / hash_file_name, shaders_hashs.data(), shaders_hashs.size());
+
+    renderer.program_info_cache.save();
 }
 
 static bool load_shader(const char *hash, const char *extension, const char *cache_path, const char *title_id, const char *self_name, char **destination, std::size_t &size_read) {
@@ -148,10 +194,17 @@ static const Sha256Hash get_shader_hash(const SceGxmProgram &program) {
 }
 
 template <typename R>
-R load_shader_generic(const char *hash_text, const char *cache_path, const char *title_id, const char *self_name, const char *shader_type_str) {
+R load_shader_generic(const ShaderPack &pack, const char *hash_text, const char *cache_path, const char *title_id, const char *self_name, const char *shader_type_str) {
     std::size_t read_size = 0;
     R source;
 
+    const std::span<const uint8_t> packed = pack.find(hash_text, shader_type_str);
+    if (!packed.empty()) {
+        source.resize((packed.size() + sizeof(typename R::value_type) - 1) / sizeof(typename R::value_type));
+        memcpy(source.data(), packed.data(), packed.size());
+        return source;
+    }
+
     if (load_shader(hash_text, shader_type_str, cache_path, title_id, self_name, nullptr, read_size)) {
         source.resize((read_size + sizeof(typename R::value_type) - 1) / sizeof(typename R::value_type));
 
@@ -162,7 +215,7 @@ R load_shader_generic(const char *hash_text, const char *cache_path, const char
     return source;
 }
 
-shader::GeneratedShader load_shader_generic(shader::Target target, const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const char *shader_type_str, const std::string &shader_version, bool shader_cache) {
+shader::GeneratedShader load_shader_generic(const ShaderPack &pack, shader::Target target, const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const char *shader_type_str, const std::string &shader_version, bool shader_cache) {
     // TODO: no need to recompute the hash here
     const std::string hash_text = hex_string(get_shader_hash(program));
     // Set Shader Hash with Version
@@ -170,12 +223,12 @@ shader::GeneratedShader load_shader_generic(shader::Target target, const SceGxmP
 
     if (shader_cache) {
         if (target == shader::Target::GLSLOpenGL) {
-            std::string source = load_shader_generic<std::string>(hash_hex_ver.c_str(), cache_path, title_id, self_name, shader_type_str);
+            std::string source = load_shader_generic<std::string>(pack, hash_hex_ver.c_str(), cache_path, title_id, self_name, shader_type_str);
             if (!source.empty()) {
                 return { source, std::vector<uint32_t>() };
             }
         } else {
-            std::vector<uint32_t> source = load_shader_generic<std::vector<uint32_t>>(hash_hex_ver.c_str(), cache_path, title_id, self_name, shader_type_str);
+            std::vector<uint32_t> source = load_shader_generic<std::vector<uint32_t>>(pack, hash_hex_ver.c_str(), cache_path, title_id, self_name, shader_type_str);
             if (!source.empty())
                 return { "", source };
         }
@@ -240,7 +293,7 @@ shader::GeneratedShader load_shader_generic(shader::Target target, const SceGxmP
     return source;
 }
 
-std::string load_glsl_shader(const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache) {
+std::string load_glsl_shader(const ShaderPack &pack, const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache) {
     SceGxmProgramType program_type = program.get_type();
 
     auto shader_type_to_str = [](SceGxmProgramType type) {
@@ -248,25 +301,143 @@ std::string load_glsl_shader(const SceGxmProgram &program, const FeatureState &f
     };
 
     const char *shader_type_str = shader_type_to_str(program_type);
-    return load_shader_generic(shader::Target::GLSLOpenGL, program, features, hints, maskupdate, cache_path, title_id, self_name, shader_type_str, shader_version, shader_cache).glsl;
+    return load_shader_generic(pack, shader::Target::GLSLOpenGL, program, features, hints, maskupdate, cache_path, title_id, self_name, shader_type_str, shader_version, shader_cache).glsl;
 }
 
-std::vector<uint32_t> load_spirv_shader(const SceGxmProgram &program, const FeatureState &features, bool is_vulkan, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache) {
+std::vector<uint32_t> load_spirv_shader(const ShaderPack &pack, const SceGxmProgram &program, const FeatureState &features, bool is_vulkan, const shader::Hints &hints, bool maskupdate, const char *cache_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache) {
     const shader::Target target = is_vulkan ? shader::Target::SpirVVulkan : shader::Target::SpirVOpenGL;
     auto shader_type_to_str = [](SceGxmProgramType type) {
         return (type == SceGxmProgramType::Vertex) ? "vert.spv.txt" : ((type == SceGxmProgramType::Fragment) ? "frag.spv.txt" : "unknown.spv.txt");
     };
     const char *shader_type_str = shader_type_to_str(program.get_type());
 
-    return load_shader_generic(target, program, features, hints, maskupdate, cache_path, title_id, self_name, shader_type_str, shader_version, shader_cache).spirv;
+    return load_shader_generic(pack, target, program, features, hints, maskupdate, cache_path, title_id, self_name, shader_type_str, shader_version, shader_cache).spirv;
+}
+
+std::string pre_load_shader_glsl(const ShaderPack &pack, const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name) {
+    return load_shader_generic<std::string>(pack, hash_text, cache_path, title_id, self_name, shader_type_str);
+}
+
+std::vector<uint32_t> pre_load_shader_spirv(const ShaderPack &pack, const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name) {
+    return load_shader_generic<std::vector<uint32_t>>(pack, hash_text, cache_path, title_id, self_name, shader_type_str);
+}
+
+// return false if the file does not exist or is from another shader version
+static bool read_shaders_hashs(const fs::path &path, uint32_t &features_mask, std::vector<ShadersHash> &hashs) {
+    fs::ifstream shaders_hashs(path, std::ios::in | std::ios::binary);
+    if (!shaders_hashs.is_open())
+        return false;
+
+    size_t size = 0;
+    uint32_t version = 0;
+    shaders_hashs.read(reinterpret_cast<char *>(&size), sizeof(size));
+    shaders_hashs.read(reinterpret_cast<char *>(&version), sizeof(uint32_t));
+    shaders_hashs.read(reinterpret_cast<char *>(&features_mask), sizeof(uint32_t));
+    if (!shaders_hashs.good() || version != shader::CURRENT_VERSION)
+        return false;
+
+    for (size_t i = 0; i < size; i++) {
+        ShadersHash hash;
+        shaders_hashs.read(reinterpret_cast<char *>(hash.frag.data()), sizeof(Sha256Hash));
+        shaders_hashs.read(reinterpret_cast<char *>(hash.vert.data()), sizeof(Sha256Hash));
+        if (!shaders_hashs.good())
+            break;
+        hashs.push_back(hash);
+    }
+
+    return true;
 }
 
-std::string pre_load_shader_glsl(const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name) {
-    return load_shader_generic<std::string>(hash_text, cache_path, title_id, self_name, shader_type_str);
+static void merge_shaders_hashs(const fs::path &path, uint32_t features_mask, const std::vector<ShadersHash> &overlay_hashs) {
+    std::vector<ShadersHash> hashs;
+    uint32_t shared_features_mask = 0;
+    read_shaders_hashs(path, shared_features_mask, hashs);
+
+    std::set<std::pair<Sha256Hash, Sha256Hash>> known;
+    for (const ShadersHash &hash : hashs)
+        known.emplace(hash.frag, hash.vert);
+    const size_t shared_count = hashs.size();
+    for (const ShadersHash &hash : overlay_hashs) {
+        if (known.emplace(hash.frag, hash.vert).second)
+            hashs.push_back(hash);
+    }
+    if (hashs.size() == shared_count)
+        return;
+
+    std::vector<uint8_t> content;
+    const auto write = [&content](const void *data, size_t size) {
+        content.insert(content.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+    };
+    const size_t size = hashs.size();
+    write(&size, sizeof(size));
+    const uint32_t version = shader::CURRENT_VERSION;
+    write(&version, sizeof(uint32_t));
+    write(&features_mask, sizeof(uint32_t));
+    for (const ShadersHash &hash : hashs) {
+        write(hash.frag.data(), sizeof(Sha256Hash));
+        write(hash.vert.data(), sizeof(Sha256Hash));
+    }
+    publish_cache_file(path, content.data(), content.size());
 }
 
-std::vector<uint32_t> pre_load_shader_spirv(const char *hash_text, const char *shader_type_str, const char *cache_path, const char *title_id, const char *self_name) {
-    return load_shader_generic<std::vector<uint32_t>>(hash_text, cache_path, title_id, self_name, shader_type_str);
+size_t merge_shader_cache(const char *cache_path, const char *shared_cache_path) {
+    const fs::path shaders_root = fs::path(cache_path) / "shaders";
+    if (!fs::exists(shaders_root))
+        return 0;
+
+    // the pipeline cache is created from the shared one, it contains all of it
+    const std::string pipeline_cache_name = fmt::format("pipeline-cache-vk{}.dat", shader::CURRENT_VERSION);
+    size_t added = 0;
+    for (const auto &title_entry : fs::directory_iterator(shaders_root)) {
+        if (!fs::is_directory(title_entry.status()))
+            continue;
+
+        for (const auto &self_entry : fs::directory_iterator(title_entry.path())) {
+            if (!fs::is_directory(self_entry.status()))
+                continue;
+
+            const std::string title_id = title_entry.path().filename().string();
+            const std::string self_name = self_entry.path().filename().string();
+            for (const char *backend : { "gl", "vk" }) {
+                uint32_t features_mask = 0;
+                std::vector<ShadersHash> hashs;
+                const std::string hash_file_name = fmt::format("hashs-{}.dat", backend);
+                if (!read_shaders_hashs(self_entry.path() / hash_file_name, features_mask, hashs))
+                    continue;
+
+                const fs::path shared_path = get_shared_shaders_path(shared_cache_path, title_id.c_str(), self_name.c_str(), backend, features_mask);
+                boost::system::error_code error;
+                fs::create_directories(shared_path, error);
+                const fs::path lock_path = shared_path / "merge.lock";
+                fs::ofstream(lock_path, std::ios::out | std::ios::app).close();
+
+                try {
+                    // only one instance can merge into a shared folder at a time, the others wait for it
+                    boost::interprocess::file_lock file_lock(lock_path.string().c_str());
+                    const boost::interprocess::scoped_lock<boost::interprocess::file_lock> guard(file_lock);
+
+                    const size_t pack_added = ShaderPack::merge(self_entry.path(), shared_path);
+                    merge_shaders_hashs(shared_path / hash_file_name, features_mask, hashs);
+                    if (pack_added > 0)
+                        LOG_INFO("Added {} shaders of {}/{} to the shared shader cache", pack_added, title_id, self_name);
+                    added += pack_added;
+
+                    const fs::path pipeline_cache_path = self_entry.path() / pipeline_cache_name;
+                    const fs::path shared_pipeline_cache_path = shared_path / pipeline_cache_name;
+                    if (std::string_view(backend) == "vk" && fs::exists(pipeline_cache_path)
+                        && (!fs::exists(shared_pipeline_cache_path) || fs::file_size(pipeline_cache_path) > fs::file_size(shared_pipeline_cache_path))) {
+                        fs::ifstream pipeline_cache_file(pipeline_cache_path, std::ios::in | std::ios::binary);
+                        const std::vector<char> pipeline_data((std::istreambuf_iterator<char>(pipeline_cache_file)), std::istreambuf_iterator<char>());
+                        publish_cache_file(shared_pipeline_cache_path, pipeline_data.data(), pipeline_data.size());
+                    }
+                } catch (const boost::interprocess::interprocess_exception &e) {
+                    LOG_ERROR("Failed to lock the shared shader cache {}: {}", shared_path.string(), e.what());
+                }
+            }
+        }
+    }
+
+    return added;
 }
 
 } // namespace renderer
@@ -275,7 +275,7 @@ COMMAND_SET_STATE(depth_func) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_depth_func(*reinterpret_cast<vulkan::VKContext *>(render_context));
         break;
 
     default:
@@ -300,7 +300,7 @@ COMMAND_SET_STATE(depth_write_enable) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_depth_write_enable(*reinterpret_cast<vulkan::VKContext *>(render_context));
         break;
 
     default:
@@ -386,7 +386,7 @@ COMMAND_SET_STATE(stencil_func) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(dynamic_cast<vulkan::VKContext &>(*render_context));
+        vulkan::sync_stencil_op(dynamic_cast<vulkan::VKContext &>(*render_context));
         vulkan::sync_stencil_func(dynamic_cast<vulkan::VKContext &>(*render_context), !is_front);
         break;
 
@@ -425,6 +425,7 @@ COMMAND_SET_STATE(texture) {
     TRACY_FUNC_COMMANDS_SET_STATE(texture);
     const std::uint32_t texture_index = helper.pop<std::uint32_t>();
     SceGxmTexture texture = helper.pop<SceGxmTexture>();
+    renderer.frame_skip.texture_used(texture.data_addr << 2);
 
     switch (renderer.current_backend) {
     case Backend::OpenGL:
@@ -454,7 +455,7 @@ COMMAND_SET_STATE(two_sided) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_stencil_op(*reinterpret_cast<vulkan::VKContext *>(render_context));
         vulkan::sync_stencil_func(dynamic_cast<vulkan::VKContext &>(*render_context), false);
         // this second call is useless if two_sided is disabled
         vulkan::sync_stencil_func(dynamic_cast<vulkan::VKContext &>(*render_context), true);
@@ -476,7 +477,7 @@ COMMAND_SET_STATE(cull_mode) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_cull(*reinterpret_cast<vulkan::VKContext *>(render_context));
         break;
 
     default:
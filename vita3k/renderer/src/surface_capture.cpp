@@ -0,0 +1,123 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <renderer/surface_capture.h>
+
+#include <config/state.h>
+#include <util/log.h>
+
+#include <fmt/format.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace renderer {
+
+static void parse_targets(SurfaceCapture &capture, const Config &config) {
+    capture.targets_parsed = true;
+    for (const auto &target : config.color_surface_debug_targets) {
+        try {
+            capture.targets.insert(static_cast<Address>(std::stoul(target, nullptr, 16)));
+        } catch (const std::exception &) {
+            LOG_ERROR("Invalid color surface address {}, it must be in hexadecimal", target);
+        }
+    }
+}
+
+bool should_capture_surface(SurfaceCapture &capture, const Config &config, Address address) {
+    if (!config.color_surface_debug || (address == 0))
+        return false;
+
+    const uint32_t start_frame = config.color_surface_debug_start_frame;
+    const uint32_t frame_count = config.color_surface_debug_frames;
+    if ((capture.frame < start_frame) || ((frame_count != 0) && (capture.frame - start_frame >= frame_count)))
+        return false;
+
+    if (!capture.targets_parsed)
+        parse_targets(capture, config);
+
+    return capture.targets.empty() || capture.targets.contains(address);
+}
+
+// a surface larger than the budget on its own is still captured once nothing else is pending
+static bool reserve_memory(SurfaceCapture &capture, size_t size) {
+    const size_t memory_used = capture.memory_used.load(std::memory_order_relaxed);
+    if ((memory_used != 0) && (memory_used + size > SurfaceCapture::MEMORY_BUDGET)) {
+        if (capture.dropped_count++ == 0)
+            LOG_WARN("The color surfaces are captured faster than they are written, some of them are dropped");
+        return false;
+    }
+
+    capture.memory_used.fetch_add(size, std::memory_order_relaxed);
+    return true;
+}
+
+static void queue_surface(SurfaceCapture &capture, Address address, uint32_t frame, uint32_t width, uint32_t height, std::vector<uint8_t> pixels) {
+    if (capture.workers.empty()) {
+        // png encoding is slow, but keep some cores for the emulated cpu and the renderer
+        const uint32_t nb_workers = std::clamp(std::thread::hardware_concurrency() / 4, 1U, 4U);
+        for (uint32_t i = 0; i < nb_workers; i++) {
+            capture.workers.emplace_back([&capture]() {
+                while (auto job = capture.queue.pop())
+                    (*job)();
+            });
+        }
+    }
+
+    auto shared_pixels = std::make_shared<std::vector<uint8_t>>(std::move(pixels));
+    capture.queue.push([&capture, address, frame, width, height, shared_pixels]() {
+        const std::string filename = fmt::format("color_surface_f{:06}_0x{:X}.png", frame, address);
+        if (!stbi_write_png(filename.c_str(), width, height, 4, shared_pixels->data(), width * 4))
+            LOG_TRACE("Fail to save color surface 0x{:X}", address);
+
+        capture.memory_used.fetch_sub(shared_pixels->size(), std::memory_order_relaxed);
+    });
+}
+
+void capture_surface(SurfaceCapture &capture, Address address, uint32_t frame, uint32_t width, uint32_t height, std::vector<uint8_t> pixels) {
+    if (reserve_memory(capture, pixels.size()))
+        queue_surface(capture, address, frame, width, height, std::move(pixels));
+}
+
+void capture_surface(SurfaceCapture &capture, Address address, uint32_t frame, uint32_t width, uint32_t height, uint32_t stride, const void *pixels) {
+    if (!reserve_memory(capture, static_cast<size_t>(width) * height * 4))
+        return;
+
+    // only the visible part of each row is kept
+    std::vector<uint8_t> copy(static_cast<size_t>(width) * height * 4);
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(pixels);
+    for (uint32_t y = 0; y < height; y++)
+        memcpy(copy.data() + static_cast<size_t>(y) * width * 4, src + static_cast<size_t>(y) * stride * 4, static_cast<size_t>(width) * 4);
+
+    queue_surface(capture, address, frame, width, height, std::move(copy));
+}
+
+SurfaceCapture::~SurfaceCapture() {
+    if (dropped_count > 0)
+        LOG_WARN("{} color surfaces were dropped from the capture", dropped_count);
+
+    queue.wait_empty();
+    queue.abort();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+} // namespace renderer
@@ -15,7 +15,7 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
-#include <chrono>
+#include <config/state.h>
 #include <gxm/types.h>
 #include <renderer/commands.h>
 #include <renderer/driver_functions.h>
@@ -23,6 +23,7 @@
 #include <renderer/types.h>
 
 #include <renderer/gl/functions.h>
+#include <renderer/gl/state.h>
 #include <renderer/vulkan/functions.h>
 #include <renderer/vulkan/types.h>
 
@@ -43,7 +44,7 @@ COMMAND(handle_signal_sync_object) {
     SceGxmSyncObject *sync = helper.pop<Ptr<SceGxmSyncObject>>().get(mem);
     const uint32_t timestamp = helper.pop<uint32_t>();
 
-    renderer::subject_done(sync, timestamp);
+    renderer::subject_done(renderer, sync, timestamp);
 }
 
 COMMAND(handle_wait_sync_object) {
@@ -71,7 +72,12 @@ COMMAND(new_frame) {
     TRACY_FUNC_COMMANDS(new_frame);
     if (renderer.current_backend == Backend::Vulkan) {
         vulkan::new_frame(*reinterpret_cast<vulkan::VKContext *>(renderer.context));
+    } else if (config.color_surface_debug) {
+        gl::GLState &gl_state = static_cast<gl::GLState &>(renderer);
+        gl::poll_surface_readbacks(gl_state.surface_readback, renderer.surface_capture);
     }
+
+    renderer.surface_capture.frame++;
 }
 
 // Client side function
@@ -93,34 +99,32 @@ int wait_for_status(State &state, int *status, int signal, bool wake_on_equal) {
     return *status;
 }
 
-bool wishlist(SceGxmSyncObject *sync_object, const uint32_t timestamp, const int32_t timeout_micros) {
-    std::unique_lock<std::mutex> lock(sync_object->lock);
-    if (sync_object->timestamp_current < timestamp) {
-        const auto &pred = [&]() { return sync_object->timestamp_current >= timestamp; };
-
-        if (timeout_micros == -1) {
-            sync_object->cond.wait(lock, pred);
-            return true;
-        } else {
-            return sync_object->cond.wait_for(lock, std::chrono::microseconds(timeout_micros), pred);
-        }
-    } else {
-        return true;
+void wishlist(SceGxmSyncObject *sync_object, const uint32_t timestamp) {
+    // a single futex wait (or its equivalent) per change of the timestamp, only the waiters of this sync object are woken up
+    uint32_t current = sync_object->timestamp_current.load(std::memory_order_acquire);
+    while (current < timestamp) {
+        sync_object->timestamp_current.wait(current, std::memory_order_acquire);
+        current = sync_object->timestamp_current.load(std::memory_order_acquire);
     }
 }
 
-void subject_done(SceGxmSyncObject *sync_object, const uint32_t timestamp) {
+void subject_done(State &state, SceGxmSyncObject *sync_object, const uint32_t timestamp) {
     assert(sync_object->timestamp_ahead >= timestamp);
-    {
-        std::unique_lock<std::mutex> lock(sync_object->lock);
-        sync_object->timestamp_current = std::max(sync_object->timestamp_current.load(), timestamp);
+    uint32_t current = sync_object->timestamp_current.load(std::memory_order_relaxed);
+    while (current < timestamp && !sync_object->timestamp_current.compare_exchange_weak(current, timestamp, std::memory_order_release, std::memory_order_relaxed)) {
     }
-    // maybe notify_one is enough
-    sync_object->cond.notify_all();
+    // nothing changed, no one can be waiting for it
+    if (current >= timestamp)
+        return;
+
+    sync_object->timestamp_current.notify_all();
+    // the renderer thread may be waiting for this sync object before processing its next command list
+    state.wake_up.notify_all();
 }
 
 void submit_command_list(State &state, renderer::Context *context, CommandList &command_list) {
     command_list.context = context;
-    state.command_buffer_queue.push(std::move(command_list));
+    state.command_buffer_queue.push(command_list);
+    state.wake_up.notify_all();
 }
 } // namespace renderer
@@ -19,6 +19,7 @@
 
 #include <renderer/profile.h>
 #include <renderer/texture_cache.h>
+#include <renderer/video_frames.h>
 
 #include <gxm/functions.h>
 #include <mem/ptr.h>
@@ -27,6 +28,7 @@
 #include <util/log.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <numeric>
 #include <xxh3.h>
@@ -46,26 +48,124 @@ static uint64_t hash_palette_data(const SceGxmTexture &texture, size_t count, co
     return hash_data(palette_bytes, count * sizeof(uint32_t));
 }
 
+static uint64_t add_palette_hash(const SceGxmTexture &texture, uint64_t data_hash, const MemState &mem) {
+    switch (gxm::get_base_format(gxm::get_format(texture))) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
+        return data_hash ^ hash_palette_data(texture, 16, mem);
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
+        return data_hash ^ hash_palette_data(texture, 256, mem);
+    default:
+        return data_hash;
+    }
+}
+
+// the textures this big are hashed by chunks, then the hashes of the chunks are hashed together
+// so the chunks can be hashed by several threads
+static constexpr uint32_t HashChunkSize = 256 * 1024;
+static constexpr uint32_t ChunkedHashMinSize = 4 * HashChunkSize;
+
+// return 0 if the texture is hashed in one go
+static uint32_t get_hash_chunk_count(uint32_t texture_size) {
+    return texture_size >= ChunkedHashMinSize ? (texture_size + HashChunkSize - 1) / HashChunkSize : 0;
+}
+
+static uint64_t hash_chunk(const uint8_t *data, uint32_t texture_size, uint32_t chunk) {
+    const uint32_t offset = chunk * HashChunkSize;
+    return hash_data(data + offset, std::min(HashChunkSize, texture_size - offset));
+}
+
 uint64_t hash_texture_data(const SceGxmTexture &texture, uint32_t texture_size, const MemState &mem) {
-    const SceGxmTextureFormat format = gxm::get_format(texture);
-    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(format);
-    const Ptr<const void> data(texture.data_addr << 2);
+    const Ptr<const uint8_t> data(texture.data_addr << 2);
     uint64_t data_hash = 0;
 
     if (data.address()) {
-        data_hash = hash_data(data.get(mem), texture_size);
+        const uint32_t chunk_count = get_hash_chunk_count(texture_size);
+        if (chunk_count == 0) {
+            data_hash = hash_data(data.get(mem), texture_size);
+        } else {
+            std::vector<uint64_t> chunk_hashes(chunk_count);
+            for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
+                chunk_hashes[chunk] = hash_chunk(data.get(mem), texture_size, chunk);
+            data_hash = hash_data(chunk_hashes.data(), chunk_count * sizeof(uint64_t));
+        }
     }
 
-    switch (base_format) {
+    return add_palette_hash(texture, data_hash, mem);
+}
+
+// the textures this big get a sample of their data hashed before the whole hash, most of the writes to them change it
+static constexpr uint32_t SampledHashMinSize = 64 * 1024;
+static constexpr uint32_t SampledPageSize = 4 * 1024;
+static constexpr uint32_t SampledLineSize = 64;
+static constexpr uint32_t SampledLineCount = 256;
+
+// hash the first and last pages of the texture and cache lines spread over the rest of it
+static uint64_t hash_texture_sample(const SceGxmTexture &texture, uint32_t texture_size, const MemState &mem) {
+    const Ptr<const uint8_t> data(texture.data_addr << 2);
+    if (!data.address())
+        return 0;
+
+    static XXH3_state_t *hash_state = XXH3_createState();
+    XXH3_64bits_reset(hash_state);
+
+    const uint8_t *pixels = data.get(mem);
+    const uint32_t last_page = texture_size - SampledPageSize;
+    const uint32_t stride = align_down(texture_size / SampledLineCount, SampledLineSize);
+    XXH3_64bits_update(hash_state, pixels, SampledPageSize);
+    for (uint32_t offset = SampledPageSize; offset < last_page; offset += stride)
+        XXH3_64bits_update(hash_state, pixels + offset, std::min(SampledLineSize, last_page - offset));
+    XXH3_64bits_update(hash_state, pixels + last_page, SampledPageSize);
+
+    return add_palette_hash(texture, XXH3_64bits_digest(hash_state), mem);
+}
+
+static uint32_t get_palette_size(const SceGxmTexture &texture) {
+    switch (gxm::get_base_format(gxm::get_format(texture))) {
     case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
-        return data_hash ^ hash_palette_data(texture, 16, mem);
+        return 16 * sizeof(uint32_t);
     case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
-        return data_hash ^ hash_palette_data(texture, 256, mem);
+        return 256 * sizeof(uint32_t);
     default:
-        return data_hash;
+        return 0;
     }
 }
 
+// write protect the memory hashed by hash_texture_data, must be called before hashing it
+// return the stamp to give to is_texture_written, 0 if the texture can't be tracked
+static uint64_t track_texture_writes(const SceGxmTexture &texture, uint32_t texture_size, MemState &mem) {
+    if (texture.data_addr == 0)
+        return 0;
+
+    const uint64_t stamp = track_writes(mem, texture.data_addr << 2, texture_size);
+    const uint32_t palette_size = get_palette_size(texture);
+    if (stamp == 0 || palette_size == 0)
+        return stamp;
+
+    // the palette is tracked last, the stamp of the data is the oldest one
+    return track_writes(mem, texture.palette_addr << 6, palette_size) != 0 ? stamp : 0;
+}
+
+// return false if the memory hashed by hash_texture_data was not written since track_texture_writes returned stamp
+static bool is_texture_written(const SceGxmTexture &texture, uint32_t texture_size, uint64_t stamp, const MemState &mem) {
+    if (texture.data_addr == 0 || is_range_written(mem, texture.data_addr << 2, texture_size, stamp))
+        return true;
+
+    const uint32_t palette_size = get_palette_size(texture);
+    return palette_size > 0 && is_range_written(mem, texture.palette_addr << 6, palette_size, stamp);
+}
+
+// return the generation of the video frame read by the texture, 0 if it does not read a video frame buffer
+static uint64_t get_video_generation(VideoFrameTracker *video_frames, const SceGxmTexture &texture, uint32_t texture_size) {
+    if (!video_frames || texture.data_addr == 0)
+        return 0;
+
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(gxm::get_format(texture));
+    if (base_format != SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2 && base_format != SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P3)
+        return 0;
+
+    return video_frames->get_generation(texture.data_addr << 2, texture_size);
+}
+
 // Function to hash an arbitrary swizzled texture in the most optimized way possible
 // this is a recursive function which calls itself on the 4 higher block making the sizzle
 // once a block entirely in the swizzle is found, it stops and hash it
@@ -291,10 +391,11 @@ using namespace texture;
 bool TextureCache::init(const bool hashless_texture_cache, const fs::path &texture_folder, std::string_view game_id, const size_t sampler_cache_size) {
     use_protect = hashless_texture_cache;
 
-    // initialize the texture queue
-    texture_queue.init(TextureCacheSize);
+    // initialize the texture queue, it can grow later up to max_texture_count
+    const size_t initial_texture_count = std::min(TextureCacheSize, max_texture_count);
+    texture_queue.init(initial_texture_count);
     // set the proper index of each entry
-    for (size_t i = 0; i < TextureCacheSize; i++)
+    for (size_t i = 0; i < initial_texture_count; i++)
         texture_queue.items[i].content.index = static_cast<int>(i);
 
     // prevent stutter caused by the hashmap resizing
@@ -318,19 +419,54 @@ bool TextureCache::init(const bool hashless_texture_cache, const fs::path &textu
     return true;
 }
 
-void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &mem) {
-    R_PROFILE(__func__);
+namespace {
+// hash of the chunks of a texture shared by the renderer thread and the hash workers
+struct ChunkedHash {
+    const uint8_t *data;
+    uint32_t texture_size;
+    std::vector<uint64_t> chunk_hashes;
+    std::atomic<uint32_t> next_chunk = 0;
+    uint32_t chunks_done = 0;
+    std::mutex mutex;
+    std::condition_variable done_cond;
+
+    // hash the chunks no other thread has taken
+    void hash_chunks() {
+        const uint32_t chunk_count = static_cast<uint32_t>(chunk_hashes.size());
+        uint32_t hashed = 0;
+        for (uint32_t chunk = next_chunk++; chunk < chunk_count; chunk = next_chunk++) {
+            chunk_hashes[chunk] = texture::hash_chunk(data, texture_size, chunk);
+            hashed++;
+        }
+        if (hashed == 0)
+            return;
+
+        const std::lock_guard<std::mutex> guard(mutex);
+        chunks_done += hashed;
+        if (chunks_done == chunk_count)
+            done_cond.notify_one();
+    }
+};
 
-    bool is_vulkan = (backend == renderer::Backend::Vulkan);
+// format and layout of a mip given to upload_texture_impl
+struct UploadMip {
+    SceGxmTextureBaseFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_index;
+    int face;
+    uint32_t pixels_per_stride;
+};
+} // namespace
 
+// go through the mips of the texture in the order they are uploaded, converted to a format the backend can upload
+// if decode is false, only the layout of the mips is computed and pixels is null
+// it does not use the texture cache, so it can be called by the decode workers
+static void for_each_upload_mip(const SceGxmTexture &gxm_texture, MemState &mem, bool is_vulkan, bool gpu_expansion, bool decode,
+    const std::function<void(const UploadMip &mip, const void *pixels)> &upload_mip) {
     const SceGxmTextureFormat fmt = gxm::get_format(gxm_texture);
     const SceGxmTextureBaseFormat base_format = gxm::get_base_format(fmt);
 
-    if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_YUV422) {
-        LOG_ERROR_ONCE("Unimplemented YUV format {}, please report it to the developers.", log_hex(fmt::underlying(base_format)));
-        return;
-    }
-
     const bool is_block_compressed = gxm::is_block_compressed_format(base_format);
     uint32_t width = gxm::get_width(gxm_texture);
     uint32_t height = gxm::get_height(gxm_texture);
@@ -338,10 +474,6 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
     const Ptr<uint8_t> data(gxm_texture.data_addr << 2);
     uint8_t *texture_data = data.get(mem);
 
-    if (!texture_data) {
-        return;
-    }
-
     std::vector<uint8_t> texture_data_decompressed;
     std::vector<uint8_t> texture_pixels_lineared;
 
@@ -445,15 +577,30 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
         switch (base_format) {
         case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
         case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
-            texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
-            if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P8) {
-                palette_texture_to_rgba_8(reinterpret_cast<uint32_t *>(texture_data_decompressed.data()),
-                    reinterpret_cast<const uint8_t *>(pixels), pixels_per_stride, memory_height, get_texture_palette(gxm_texture, mem));
-            } else {
-                palette_texture_to_rgba_4(reinterpret_cast<uint32_t *>(texture_data_decompressed.data()),
-                    reinterpret_cast<const uint8_t *>(pixels), pixels_per_stride, memory_height, get_texture_palette(gxm_texture, mem));
+            if (gpu_expansion) {
+                // only upload the indices (one byte each) and the palette, the backend does the lookup
+                if (decode && base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P4) {
+                    texture_data_decompressed.resize(pixels_per_stride * memory_height);
+                    palette_indices_4_to_8(texture_data_decompressed.data(), reinterpret_cast<const uint8_t *>(pixels), pixels_per_stride, memory_height);
+                    pixels = texture_data_decompressed.data();
+                }
+                bytes_per_pixel = 1;
+                bpp = 8;
+                upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_P8;
+                break;
+            }
+
+            if (decode) {
+                texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
+                if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P8) {
+                    palette_texture_to_rgba_8(reinterpret_cast<uint32_t *>(texture_data_decompressed.data()),
+                        reinterpret_cast<const uint8_t *>(pixels), pixels_per_stride, memory_height, get_texture_palette(gxm_texture, mem));
+                } else {
+                    palette_texture_to_rgba_4(reinterpret_cast<uint32_t *>(texture_data_decompressed.data()),
+                        reinterpret_cast<const uint8_t *>(pixels), pixels_per_stride, memory_height, get_texture_palette(gxm_texture, mem));
+                }
+                pixels = texture_data_decompressed.data();
             }
-            pixels = texture_data_decompressed.data();
             bytes_per_pixel = 4;
             bpp = 32;
             upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
@@ -465,25 +612,29 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
             if (!is_swizzled)
                 LOG_ERROR_ONCE("Unhandled non-swizzled PVRT format, please report it to the developers");
 
-            texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
-            // this actually also unswizzles the texture
-            source_size = decompress_compressed_texture(base_format, texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height);
+            if (decode) {
+                texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
+                // this actually also unswizzles the texture
+                source_size = decompress_compressed_texture(base_format, texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height);
+                pixels = texture_data_decompressed.data();
+            }
             bytes_per_pixel = 4;
             bpp = 32;
             upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
-            pixels = texture_data_decompressed.data();
             break;
         case SCE_GXM_TEXTURE_BASE_FORMAT_U8U3U3U2:
             // Convert U8U3U3U2 to U8U8U8U8
-            texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
-            convert_U8U3U3U2_to_U8U8U8U8(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height);
-            pixels = texture_data_decompressed.data();
+            if (decode) {
+                texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
+                convert_U8U3U3U2_to_U8U8U8U8(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height);
+                pixels = texture_data_decompressed.data();
+            }
             upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
             bpp = 32;
             break;
         case SCE_GXM_TEXTURE_BASE_FORMAT_SE5M9M9M9:
             // this format is supported on all GPUs with vulkan
-            if (is_vulkan)
+            if (is_vulkan || !decode)
                 break;
             texture_data_decompressed.resize(pixels_per_stride * memory_height * 6);
             decompress_packed_float_e5m9m9m9(base_format, texture_data_decompressed.data(), pixels, width, memory_height);
@@ -493,17 +644,23 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
             // don't change what openGL is doing (which is completely wrong)
             if (!is_vulkan)
                 break;
-            texture_data_decompressed.resize(pixels_per_stride * memory_height * 8);
-            convert_u2f10f10f10_to_f16f16f16f16(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height, fmt);
-            pixels = texture_data_decompressed.data();
+            if (decode) {
+                texture_data_decompressed.resize(pixels_per_stride * memory_height * 8);
+                convert_u2f10f10f10_to_f16f16f16f16(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height, fmt);
+                pixels = texture_data_decompressed.data();
+            }
             upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_F16F16F16F16;
             break;
         case SCE_GXM_TEXTURE_BASE_FORMAT_X8U24:
-            texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
             if (is_vulkan) {
                 // d24_u8 or x8_d24 is not supported on all GPUs (thanks AMD)
-                convert_x8u24_to_f32(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height, fmt);
                 upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_F32;
+            }
+            if (!decode)
+                break;
+            texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
+            if (is_vulkan) {
+                convert_x8u24_to_f32(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height, fmt);
             } else {
                 // X8 = [24-31], D24 = [0-23], technically this is GL_UNSIGNED_INT_24_8_REV which does not exist
                 // TODO: Requires shader to convert the normalized value read by GL to unsigned int. Just multiply by 2^24-1 when reading and you're done.
@@ -514,9 +671,11 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
             break;
         case SCE_GXM_TEXTURE_BASE_FORMAT_F32M:
             // Convert F32M to F32
-            texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
-            convert_f32m_to_f32(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height);
-            pixels = texture_data_decompressed.data();
+            if (decode) {
+                texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
+                convert_f32m_to_f32(texture_data_decompressed.data(), pixels, pixels_per_stride, memory_height);
+                pixels = texture_data_decompressed.data();
+            }
             upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_F32;
             break;
         // TODO: we are decoding YUV420P2 as YUV420P3, that's completely wrong...
@@ -525,10 +684,30 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
         // so this works in this case but that needs to be fixed
         case SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2:
         case SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P3:
-            texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
-            yuv420P3_texture_to_rgb(texture_data_decompressed.data(),
-                reinterpret_cast<const uint8_t *>(pixels), pixels_per_stride, memory_height, layout_width, layout_height);
-            pixels = texture_data_decompressed.data();
+            if (gpu_expansion && !is_swizzled && texture_type != SCE_GXM_TEXTURE_TILED) {
+                // give the three planes one after the other to the backend, which does the conversion
+                upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P3;
+                if (!decode || (pixels_per_stride == layout_width && memory_height == layout_height))
+                    // the planes already are one after the other in the guest memory (like the video frames), upload them from there
+                    break;
+
+                const uint32_t luma_size = pixels_per_stride * memory_height;
+                const uint32_t chroma_size = (pixels_per_stride / 2) * (memory_height / 2);
+                const uint8_t *planes = reinterpret_cast<const uint8_t *>(pixels);
+                texture_data_decompressed.resize(luma_size + 2 * chroma_size);
+                memcpy(texture_data_decompressed.data(), planes, luma_size);
+                memcpy(texture_data_decompressed.data() + luma_size, planes + layout_width * layout_height, chroma_size);
+                memcpy(texture_data_decompressed.data() + luma_size + chroma_size, planes + layout_width * layout_height + layout_width * layout_height / 4, chroma_size);
+                pixels = texture_data_decompressed.data();
+                break;
+            }
+
+            if (decode) {
+                texture_data_decompressed.resize(pixels_per_stride * memory_height * 4);
+                yuv420P3_texture_to_rgb(texture_data_decompressed.data(),
+                    reinterpret_cast<const uint8_t *>(pixels), pixels_per_stride, memory_height, layout_width, layout_height);
+                pixels = texture_data_decompressed.data();
+            }
             bpp = 32;
             upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
             break;
@@ -536,7 +715,7 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
             break;
         }
 
-        if (texture_type != SCE_GXM_TEXTURE_LINEAR && texture_type != SCE_GXM_TEXTURE_LINEAR_STRIDED && !gxm::is_pvrt_format(base_format)) {
+        if (decode && texture_type != SCE_GXM_TEXTURE_LINEAR && texture_type != SCE_GXM_TEXTURE_LINEAR_STRIDED && !gxm::is_pvrt_format(base_format)) {
             // Convert data to linear layout
             texture_pixels_lineared.resize(pixels_per_stride * memory_height * bytes_per_pixel);
 
@@ -553,9 +732,7 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
             pixels = texture_pixels_lineared.data();
         }
 
-        upload_texture_impl(upload_format, width, height, mip_index, pixels, upload_type, pixels_per_stride);
-        if (export_textures)
-            export_texture_impl(upload_format, width, height, mip_index, pixels, upload_type, pixels_per_stride);
+        upload_mip({ upload_format, width, height, mip_index, upload_type, pixels_per_stride }, decode ? pixels : nullptr);
 
         const uint32_t nb_pixels = align(layout_width, align_width) * align(layout_height, align_height);
         const uint32_t mip_size = (nb_pixels >> block_shift) * block_size;
@@ -599,6 +776,112 @@ void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &me
     }
 }
 
+void TextureCache::upload_texture(const SceGxmTexture &gxm_texture, MemState &mem) {
+    R_PROFILE(__func__);
+
+    const bool is_vulkan = (backend == renderer::Backend::Vulkan);
+    // exported textures must be expanded
+    const bool gpu_expansion = support_gpu_expansion && !export_textures;
+
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(gxm::get_format(gxm_texture));
+    if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_YUV422) {
+        LOG_ERROR_ONCE("Unimplemented YUV format {}, please report it to the developers.", log_hex(fmt::underlying(base_format)));
+        return;
+    }
+
+    if (!Ptr<uint8_t>(gxm_texture.data_addr << 2).get(mem))
+        return;
+
+    if (gpu_expansion && (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P4 || base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P8)) {
+        current_palette = get_texture_palette(gxm_texture, mem);
+        current_palette_count = (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P8) ? 256 : 16;
+    }
+
+    // small textures are faster to decode right away than to hand to a worker
+    const bool use_decode_workers = support_deferred_upload && !export_textures && current_info && current_info->texture_size >= DeferredUploadMinSize;
+    if (!use_decode_workers) {
+        for_each_upload_mip(gxm_texture, mem, is_vulkan, gpu_expansion, true, [&](const UploadMip &mip, const void *pixels) {
+            upload_texture_impl(mip.format, mip.width, mip.height, mip.mip_index, pixels, mip.face, mip.pixels_per_stride);
+            if (export_textures)
+                export_texture_impl(mip.format, mip.width, mip.height, mip.mip_index, pixels, mip.face, mip.pixels_per_stride);
+        });
+        return;
+    }
+
+    // the backend reserves the staging memory and records the copies now, the pixels are written by a worker
+    auto writes = std::make_shared<std::vector<DeferredUploadWrite>>();
+    for_each_upload_mip(gxm_texture, mem, is_vulkan, gpu_expansion, false, [&](const UploadMip &mip, const void *) {
+        deferred_upload_write = nullptr;
+        upload_texture_impl(mip.format, mip.width, mip.height, mip.mip_index, nullptr, mip.face, mip.pixels_per_stride);
+        writes->push_back(std::move(deferred_upload_write));
+    });
+    deferred_upload_write = nullptr;
+
+    schedule_decode_job([gxm_texture, &mem, is_vulkan, gpu_expansion, writes]() {
+        size_t mip_idx = 0;
+        for_each_upload_mip(gxm_texture, mem, is_vulkan, gpu_expansion, true, [&](const UploadMip &, const void *pixels) {
+            const DeferredUploadWrite &write = (*writes)[mip_idx++];
+            if (write)
+                write(pixels);
+        });
+    });
+}
+
+void TextureCache::schedule_decode_job(std::function<void()> job) {
+    if (decode_workers.empty()) {
+        // same as the import workers, keep some cores for the emulated cpu and the renderer
+        const uint32_t nb_workers = std::clamp(std::thread::hardware_concurrency() / 4, 1U, 4U);
+        for (uint32_t i = 0; i < nb_workers; i++) {
+            decode_workers.emplace_back([this]() {
+                while (auto job = decode_queue.pop()) {
+                    (*job)();
+
+                    const ProfiledLockGuard guard(decode_mutex);
+                    decode_pending--;
+                    if (decode_pending == 0)
+                        decode_done_cond.notify_all();
+                }
+            });
+        }
+    }
+
+    {
+        const ProfiledLockGuard guard(decode_mutex);
+        decode_pending++;
+    }
+    decode_queue.push(std::move(job));
+}
+
+uint64_t TextureCache::hash_texture(const SceGxmTexture &texture, uint32_t texture_size, const MemState &mem) {
+    const uint32_t chunk_count = texture::get_hash_chunk_count(texture_size);
+    if (chunk_count == 0 || texture.data_addr == 0)
+        return texture::hash_texture_data(texture, texture_size, mem);
+
+    // the renderer thread hashes the chunks as well, it does not wait for the tasks which have not started
+    // those find no chunk left, they keep the hash alive until then
+    const auto hash = std::make_shared<ChunkedHash>();
+    hash->data = Ptr<const uint8_t>(texture.data_addr << 2).get(mem);
+    hash->texture_size = texture_size;
+    hash->chunk_hashes.resize(chunk_count);
+    const uint32_t nb_tasks = std::clamp(get_task_pool_stats().worker_count, 1U, chunk_count - 1);
+    for (uint32_t i = 0; i < nb_tasks; i++)
+        hash_tasks.submit([hash]() { hash->hash_chunks(); });
+    hash->hash_chunks();
+
+    {
+        std::unique_lock<std::mutex> lock(hash->mutex);
+        hash->done_cond.wait(lock, [&] { return hash->chunks_done == chunk_count; });
+    }
+
+    const uint64_t data_hash = texture::hash_data(hash->chunk_hashes.data(), chunk_count * sizeof(uint64_t));
+    return texture::add_palette_hash(texture, data_hash, mem);
+}
+
+void TextureCache::wait_decode_jobs() {
+    std::unique_lock<ProfiledMutex> lock(decode_mutex);
+    decode_done_cond.wait(lock, [&] { return decode_pending == 0; });
+}
+
 // remove everything related to the sampler state
 static constexpr TextureGxmDataRepr default_texture_mask = {
     0x981E0000,
@@ -613,6 +896,57 @@ static constexpr TextureGxmDataRepr strided_texture_mask = {
     0xF3FFFFFF
 };
 
+TextureCacheInfo *TextureCache::get_free_entry() {
+    TextureCacheInfo *info = texture_queue.get_lru();
+    if (info->texture_size > 0 && memory_used < memory_budget && texture_queue.items.size() < max_texture_count) {
+        // all the entries are used but there is still some memory left, add a new one
+        info = texture_queue.add();
+        info->index = static_cast<int>(texture_queue.items.size() - 1);
+        return info;
+    }
+
+    if (info->texture_size > 0) {
+        // Cache is full.
+        LOG_WARN_ONCE("Texture cache is full. Starting to replace textures");
+        texture_lookup.erase(std::bit_cast<TextureGxmDataRepr>(info->texture));
+    }
+
+    // don't evict the textures which were just bound, they may be used by the current draw
+    constexpr size_t min_texture_count = 64;
+    // number of least recently used textures looked at when choosing which one to evict
+    constexpr int eviction_window = 8;
+    while (memory_used > memory_budget && texture_lookup.size() > min_texture_count) {
+        LOG_WARN_ONCE("Textures are using more memory than the GPU budget. Starting to evict textures");
+
+        // among the least recently used textures, evict the one using the most memory
+        TextureCacheInfo *evicted = nullptr;
+        int looked_at = 0;
+        lru::Item<TextureCacheInfo> *item = texture_queue.head->prev;
+        for (size_t i = 0; i < texture_queue.items.size() && looked_at < eviction_window; i++, item = item->prev) {
+            TextureCacheInfo &candidate = item->content;
+            // skip the entry we are going to use and the empty ones
+            if (&candidate == info || candidate.texture_size == 0)
+                continue;
+
+            looked_at++;
+            if (!evicted || candidate.memory_size > evicted->memory_size)
+                evicted = &candidate;
+        }
+        if (!evicted || evicted->memory_size == 0)
+            break;
+
+        texture_lookup.erase(std::bit_cast<TextureGxmDataRepr>(evicted->texture));
+        release_texture(evicted->index);
+        memory_used -= evicted->memory_size;
+        evicted->memory_size = 0;
+        evicted->texture_size = 0;
+        // it is now empty, it will be used by the next texture
+        texture_queue.set_as_lru(evicted);
+    }
+
+    return info;
+}
+
 void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemState &mem) {
     R_PROFILE(__func__);
 
@@ -640,14 +974,9 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
     TextureCacheInfo *info;
     if (cached_gxm_texture_index == -1) {
         // Texture not found in cache.
-        // get the least recently used texture, which info_list_head points to
-        info = texture_queue.get_lru();
+        // get the least recently used texture or a new one
+        info = get_free_entry();
         index = info->index;
-        if (info->texture_size > 0) {
-            // Cache is full.
-            LOG_WARN_ONCE("Texture cache is full. Starting to replace textures");
-            texture_lookup.erase(std::bit_cast<TextureGxmDataRepr>(info->texture));
-        }
         texture_lookup[texture_repr] = info;
 
         configure = true;
@@ -662,8 +991,10 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
         // (for example, uniform buffer value and texture data got mixed, so page faults are triggered too many, it's not always good).
         // This works under the assumption that once this big enough texture decided to modify. It will have to modify either all of its data,
         // or replace with an entire new texture.
-        bool should_use_hash = true;
-        if (use_protect && info->texture_size >= mem.page_size * 4) {
+        // the video frames do not need to be hashed, the decoder tells when a new one is written
+        info->video_generation = get_video_generation(video_frames, gxm_texture, info->texture_size);
+        bool should_use_hash = info->video_generation == 0;
+        if (should_use_hash && use_protect && info->texture_size >= mem.page_size * 4) {
             range_protect_begin = align(gxm_texture.data_addr << 2, mem.page_size);
             range_protect_end = align_down((gxm_texture.data_addr << 2) + info->texture_size, mem.page_size);
 
@@ -674,25 +1005,73 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
 
         info->use_hash = should_use_hash;
         if (info->use_hash) {
+            if (use_write_tracking)
+                info->write_stamp = track_texture_writes(gxm_texture, info->texture_size, mem);
+
             if (import_textures || export_textures)
                 info->hash = hash_texture_nostride(gxm_texture, mem);
             else
                 // the xor 1 is to make sure it won't be the same as hash_texture_nostride
-                info->hash = hash_texture_data(gxm_texture, info->texture_size, mem) ^ 1;
+                info->hash = hash_texture(gxm_texture, info->texture_size, mem) ^ 1;
+            if (info->texture_size >= texture::SampledHashMinSize)
+                info->sample_hash = texture::hash_texture_sample(gxm_texture, info->texture_size, mem);
         }
+        info->changed = false;
     } else {
         // Texture is cached.
         index = cached_gxm_texture_index;
         info = gxm_it->second;
         configure = false;
-        if (info->use_hash) {
-            const uint64_t previous_hash = info->hash;
+        const uint64_t video_generation = get_video_generation(video_frames, gxm_texture, info->texture_size);
+        if (video_generation != 0) {
+            // the texture may have been created before the decoder wrote its first frame to the buffer
+            upload = video_generation != info->video_generation;
+            info->video_generation = video_generation;
+            info->use_hash = false;
+        } else if (info->video_generation != 0) {
+            // the buffer is no longer used by a decoder, hash the texture from now on
+            info->video_generation = 0;
+            info->use_hash = true;
+            if (use_write_tracking)
+                info->write_stamp = track_texture_writes(gxm_texture, info->texture_size, mem);
             if (import_textures || export_textures)
                 info->hash = hash_texture_nostride(gxm_texture, mem);
             else
-                info->hash = hash_texture_data(gxm_texture, info->texture_size, mem) ^ 1;
+                info->hash = hash_texture(gxm_texture, info->texture_size, mem) ^ 1;
+            if (info->texture_size >= texture::SampledHashMinSize)
+                info->sample_hash = texture::hash_texture_sample(gxm_texture, info->texture_size, mem);
+            upload = true;
+        } else if (info->use_hash && use_write_tracking && !is_texture_written(gxm_texture, info->texture_size, info->write_stamp, mem)) {
+            // nothing was written to the texture since it was last hashed
+            upload = false;
+        } else if (info->use_hash) {
+            if (use_write_tracking)
+                info->write_stamp = track_texture_writes(gxm_texture, info->texture_size, mem);
+
+            const uint64_t previous_hash = info->hash;
+            // the replacement textures are found with the whole hash, it is always needed for them
+            const bool use_sample = info->texture_size >= texture::SampledHashMinSize && !import_textures && !export_textures;
+            bool sample_changed = false;
+            if (use_sample) {
+                const uint64_t sample_hash = texture::hash_texture_sample(gxm_texture, info->texture_size, mem);
+                sample_changed = sample_hash != info->sample_hash;
+                info->sample_hash = sample_hash;
+            }
 
-            upload = previous_hash != info->hash;
+            if (sample_changed && info->changed) {
+                // the texture is written again, skip the whole hash
+                // it is left to a value no hash matches so the texture is uploaded once it stops changing
+                info->hash = 0;
+                upload = true;
+            } else {
+                if (import_textures || export_textures)
+                    info->hash = hash_texture_nostride(gxm_texture, mem);
+                else
+                    info->hash = hash_texture(gxm_texture, info->texture_size, mem) ^ 1;
+
+                upload = previous_hash != info->hash;
+            }
+            info->changed = upload;
         } else {
             upload = info->dirty;
         }
@@ -711,15 +1090,25 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
     importing_texture = false;
     // to restore the state, in case for whatever reason we could not load the replacement texture
     bool previous_configure = configure;
+    if (!upload && import_textures && info->import_pending && is_imported_texture_loaded(info->hash)) {
+        // the replacement texture has been loaded in the background, it can now replace the original one
+        upload = true;
+    }
+
     if (upload && import_textures) {
+        info->import_pending = false;
         auto it = available_textures_hash.find(info->hash);
         if (it != available_textures_hash.end()) {
-            importing_texture = true;
-            loading_texture = it->second;
-            // always configure for replacement texture (although it may have no effect)
-            // the reason being that we may have two replacement textures for the same gxm identifier
-            // with different dimensions, so we can't assume
-            configure = true;
+            if (retrieve_imported_texture(info->hash, it->second, gxm_texture)) {
+                importing_texture = true;
+                // always configure for replacement texture (although it may have no effect)
+                // the reason being that we may have two replacement textures for the same gxm identifier
+                // with different dimensions, so we can't assume
+                configure = true;
+            } else {
+                // use the original texture until the replacement is loaded
+                info->import_pending = true;
+            }
         }
     }
 
@@ -729,6 +1118,10 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
     select(index, gxm_texture);
 
     if (configure) {
+        // the backend sets the memory used by the new texture
+        memory_used -= info->memory_size;
+        info->memory_size = 0;
+
         bool need_configure = true;
 
         if (importing_texture)
@@ -739,6 +1132,9 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
             importing_texture = false;
             info->is_imported = false;
         }
+
+        memory_used += info->memory_size;
+        memory_peak = std::max(memory_peak, memory_used);
     }
     if (upload) {
         if (export_textures && !importing_texture)
@@ -749,7 +1145,12 @@ void TextureCache::cache_and_bind_texture(const SceGxmTexture &gxm_texture, MemS
         else
             upload_texture(gxm_texture, mem);
 
-        if (!info->use_hash) {
+        if (upload_stats) {
+            upload_stats->count.fetch_add(1, std::memory_order_relaxed);
+            upload_stats->bytes.fetch_add(info->texture_size, std::memory_order_relaxed);
+        }
+
+        if (!info->use_hash && info->video_generation == 0) {
             info->dirty = false;
             add_protect(mem, range_protect_begin, range_protect_end - range_protect_begin, MemPerm::ReadOnly, [info, gxm_texture](Address, bool) {
                 if (memcmp(&info->texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
@@ -0,0 +1,414 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Pixel format conversions done on the CPU by the texture cache and the surface sync.
+// Each conversion has a scalar version, used for the remaining pixels and on other architectures,
+// and SIMD versions chosen once at runtime from the instruction sets supported by the host.
+
+#include <renderer/functions.h>
+
+#include <gxm/types.h>
+#include <util/instrset_detect.h>
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VITA3K_X86_64
+#include <immintrin.h>
+// msvc allows to use any intrinsic, other compilers need the functions to be marked
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VITA3K_AARCH64
+#include <arm_neon.h>
+#endif
+
+namespace renderer::texture {
+
+#ifdef VITA3K_X86_64
+static const bool use_ssse3 = util::instrset::instrset_detect() >= util::instrset::instrset_SSSE3;
+static const bool use_avx2 = util::instrset::instrset_detect() >= util::instrset::instrset_AVX2;
+#endif
+
+// x8u24 -> u24x8, rotate each pixel by 8 bits
+static void rotate_left_8_scalar(uint32_t *dst, const uint32_t *src, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        dst[i] = (src[i] << 8) | (src[i] >> 24);
+}
+
+void convert_x8u24_to_u24x8(void *dest, const void *data, const uint32_t width, const uint32_t height) {
+    auto dst = static_cast<uint32_t *>(dest);
+    auto src = static_cast<const uint32_t *>(data);
+    const size_t count = static_cast<size_t>(width) * height;
+
+    size_t i = 0;
+#ifdef VITA3K_X86_64
+    for (; i + 4 <= count; i += 4) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(_mm_slli_epi32(value, 8), _mm_srli_epi32(value, 24)));
+    }
+#elif defined(VITA3K_AARCH64)
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t value = vld1q_u32(src + i);
+        vst1q_u32(dst + i, vsriq_n_u32(vshlq_n_u32(value, 8), value, 24));
+    }
+#endif
+    rotate_left_8_scalar(dst + i, src + i, count - i);
+}
+
+static constexpr float U24_MAX = static_cast<float>((1U << 24) - 1);
+
+void convert_x8u24_to_f32(void *dest, const void *data, const uint32_t width, const uint32_t height, const SceGxmTextureFormat format) {
+    const SceGxmTextureSwizzle2ModeAlt swizzle = static_cast<SceGxmTextureSwizzle2ModeAlt>(format & SCE_GXM_TEXTURE_SWIZZLE_MASK);
+    // is the depth in the upper or lower 24 bits of the data?
+    const int shift_amount = (swizzle == SCE_GXM_TEXTURE_SWIZZLE2_DS) ? 8 : 0;
+    auto dst = static_cast<float *>(dest);
+    auto src = static_cast<const uint32_t *>(data);
+    const size_t count = static_cast<size_t>(width) * height;
+
+    size_t i = 0;
+#ifdef VITA3K_X86_64
+    // the 24 bits value fits in a signed int, so the signed conversion is exact
+    const __m128i shift = _mm_cvtsi32_si128(shift_amount);
+    const __m128i mask = _mm_set1_epi32((1U << 24) - 1);
+    const __m128 max_value = _mm_set1_ps(U24_MAX);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i d24 = _mm_and_si128(_mm_srl_epi32(value, shift), mask);
+        _mm_storeu_ps(dst + i, _mm_div_ps(_mm_cvtepi32_ps(d24), max_value));
+    }
+#elif defined(VITA3K_AARCH64)
+    const int32x4_t shift = vdupq_n_s32(-shift_amount);
+    const uint32x4_t mask = vdupq_n_u32((1U << 24) - 1);
+    const float32x4_t max_value = vdupq_n_f32(U24_MAX);
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t d24 = vandq_u32(vshlq_u32(vld1q_u32(src + i), shift), mask);
+        vst1q_f32(dst + i, vdivq_f32(vcvtq_f32_u32(d24), max_value));
+    }
+#endif
+    for (; i < count; i++) {
+        const uint32_t d24 = (src[i] >> shift_amount) & ((1U << 24) - 1);
+        dst[i] = static_cast<float>(d24) / U24_MAX;
+    }
+}
+
+void convert_f32m_to_f32(void *dest, const void *data, const uint32_t width, const uint32_t height) {
+    auto dst = static_cast<uint32_t *>(dest);
+    auto src = static_cast<const uint32_t *>(data);
+    const size_t count = static_cast<size_t>(width) * height;
+
+    size_t i = 0;
+#ifdef VITA3K_X86_64
+    const __m128i mask = _mm_set1_epi32(0x7FFFFFFF);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_and_si128(value, mask));
+    }
+#elif defined(VITA3K_AARCH64)
+    const uint32x4_t mask = vdupq_n_u32(0x7FFFFFFF);
+    for (; i + 4 <= count; i += 4)
+        vst1q_u32(dst + i, vandq_u32(vld1q_u32(src + i), mask));
+#endif
+    for (; i < count; i++)
+        dst[i] = src[i] & 0x7FFFFFFF;
+}
+
+// rgb part of a U8U3U3U2 pixel (its lower byte) expanded to U8U8U8
+static constexpr auto u3u3u2_to_u8u8u8 = []() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t value = 0; value < 256; value++) {
+        const uint32_t red = (value & 0xE0) >> 5;
+        const uint32_t green = (value & 0x1C) >> 2;
+        const uint32_t blue = value & 0x03;
+        table[value] = (blue << 22) | (blue << 20) | (blue << 18) | (blue << 16) | (green << 13) | (green << 10) | ((green & 0b110) << 7) | (red << 5) | (red << 2) | (red >> 1);
+    }
+    return table;
+}();
+
+#ifdef VITA3K_X86_64
+TARGET_AVX2 static size_t convert_U8U3U3U2_to_U8U8U8U8_avx2(uint32_t *dst, const uint16_t *src, size_t count) {
+    const __m256i low_byte = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i value = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        const __m256i rgb = _mm256_i32gather_epi32(reinterpret_cast<const int *>(u3u3u2_to_u8u8u8.data()), _mm256_and_si256(value, low_byte), 4);
+        const __m256i alpha = _mm256_slli_epi32(_mm256_srli_epi32(value, 8), 24);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(rgb, alpha));
+    }
+    return i;
+}
+#endif
+
+void convert_U8U3U3U2_to_U8U8U8U8(void *dest, const void *data, const uint32_t width, const uint32_t height) {
+    auto dst = static_cast<uint32_t *>(dest);
+    auto src = static_cast<const uint16_t *>(data);
+    const size_t count = static_cast<size_t>(width) * height;
+
+    size_t i = 0;
+#ifdef VITA3K_X86_64
+    if (use_avx2)
+        i = convert_U8U3U3U2_to_U8U8U8U8_avx2(dst, src, count);
+#endif
+    for (; i < count; i++)
+        dst[i] = ((src[i] & 0xFF00) << 16) | u3u3u2_to_u8u8u8[src[i] & 0xFF];
+}
+
+// the 2 bits alpha as f16: 0, 1/3, 2/3 and 1
+static constexpr std::array<uint16_t, 4> u2_to_f16 = { 0x0000, 0x3555, 0x3955, 0x3C00 };
+
+void convert_u2f10f10f10_to_f16f16f16f16(void *dest, const void *data, const uint32_t width, const uint32_t height, const SceGxmTextureFormat format) {
+    // each pixel is written as two 32 bits values, with two f16 in each
+    auto dst = static_cast<uint32_t *>(dest);
+    auto src = static_cast<const uint32_t *>(data);
+    const size_t count = static_cast<size_t>(width) * height;
+
+    // are the 2 alpha bits in the upper or lower bits of the pixel ?
+    const bool is_alpha_upper = (format == SCE_GXM_TEXTURE_FORMAT_U2F10F10F10_ABGR
+        || format == SCE_GXM_TEXTURE_FORMAT_U2F10F10F10_ARGB
+        || format == SCE_GXM_TEXTURE_FORMAT_X2F10F10F10_1BGR
+        || format == SCE_GXM_TEXTURE_FORMAT_X2F10F10F10_1RGB);
+    const int alpha_shift = is_alpha_upper ? 30 : 0;
+    const int color_shift = is_alpha_upper ? 0 : 2;
+
+    // f16 has a 10 bit mantissa and a 5 bit exponent
+    // f10 has a 5 bit mantissa and a 5 bit exponent
+    // so we just need to put the exponent in the right location and add zeros to the mantissa
+    // Note: I don't think this works for subnormal numbers
+    size_t i = 0;
+#ifdef VITA3K_X86_64
+    const __m128i f10_mask = _mm_set1_epi32(0x3FF);
+    const __m128i alpha_mask = _mm_set1_epi32(0b11);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i colors = _mm_srl_epi32(value, _mm_cvtsi32_si128(color_shift));
+        const __m128i c0 = _mm_slli_epi32(_mm_and_si128(colors, f10_mask), 5);
+        const __m128i c1 = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(colors, 10), f10_mask), 5);
+        const __m128i c2 = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(colors, 20), f10_mask), 5);
+
+        const __m128i alpha_bits = _mm_and_si128(_mm_srl_epi32(value, _mm_cvtsi32_si128(alpha_shift)), alpha_mask);
+        __m128i alpha = _mm_setzero_si128();
+        for (int a = 1; a < 4; a++)
+            alpha = _mm_or_si128(alpha, _mm_and_si128(_mm_cmpeq_epi32(alpha_bits, _mm_set1_epi32(a)), _mm_set1_epi32(u2_to_f16[a])));
+
+        // the two halves of each pixel, then the pixels one after the other
+        const __m128i first = is_alpha_upper ? _mm_or_si128(c0, _mm_slli_epi32(c1, 16)) : _mm_or_si128(alpha, _mm_slli_epi32(c0, 16));
+        const __m128i second = is_alpha_upper ? _mm_or_si128(c2, _mm_slli_epi32(alpha, 16)) : _mm_or_si128(c1, _mm_slli_epi32(c2, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i), _mm_unpacklo_epi32(first, second));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i + 4), _mm_unpackhi_epi32(first, second));
+    }
+#elif defined(VITA3K_AARCH64)
+    const uint32x4_t f10_mask = vdupq_n_u32(0x3FF);
+    const int32x4_t color_shift_vec = vdupq_n_s32(-color_shift);
+    const int32x4_t alpha_shift_vec = vdupq_n_s32(-alpha_shift);
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t value = vld1q_u32(src + i);
+        const uint32x4_t colors = vshlq_u32(value, color_shift_vec);
+        const uint32x4_t c0 = vshlq_n_u32(vandq_u32(colors, f10_mask), 5);
+        const uint32x4_t c1 = vshlq_n_u32(vandq_u32(vshrq_n_u32(colors, 10), f10_mask), 5);
+        const uint32x4_t c2 = vshlq_n_u32(vandq_u32(vshrq_n_u32(colors, 20), f10_mask), 5);
+
+        const uint32x4_t alpha_bits = vandq_u32(vshlq_u32(value, alpha_shift_vec), vdupq_n_u32(0b11));
+        uint32x4_t alpha = vdupq_n_u32(0);
+        for (uint32_t a = 1; a < 4; a++)
+            alpha = vorrq_u32(alpha, vandq_u32(vceqq_u32(alpha_bits, vdupq_n_u32(a)), vdupq_n_u32(u2_to_f16[a])));
+
+        uint32x4x2_t pixels;
+        pixels.val[0] = is_alpha_upper ? vorrq_u32(c0, vshlq_n_u32(c1, 16)) : vorrq_u32(alpha, vshlq_n_u32(c0, 16));
+        pixels.val[1] = is_alpha_upper ? vorrq_u32(c2, vshlq_n_u32(alpha, 16)) : vorrq_u32(c1, vshlq_n_u32(c2, 16));
+        // interleave the two halves
+        vst2q_u32(dst + 2 * i, pixels);
+    }
+#endif
+    for (; i < count; i++) {
+        const uint32_t colors = src[i] >> color_shift;
+        const uint32_t c0 = (colors & 0x3FF) << 5;
+        const uint32_t c1 = ((colors >> 10) & 0x3FF) << 5;
+        const uint32_t c2 = ((colors >> 20) & 0x3FF) << 5;
+        const uint32_t alpha = u2_to_f16[(src[i] >> alpha_shift) & 0b11];
+        if (is_alpha_upper) {
+            dst[2 * i] = c0 | (c1 << 16);
+            dst[2 * i + 1] = c2 | (alpha << 16);
+        } else {
+            dst[2 * i] = alpha | (c0 << 16);
+            dst[2 * i + 1] = c1 | (c2 << 16);
+        }
+    }
+}
+
+// store the 4-bit indices of a row in their own byte, the low nibble comes first
+static void split_nibbles_row(uint8_t *dst, const uint8_t *src, uint32_t width) {
+    uint32_t x = 0;
+#ifdef VITA3K_X86_64
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    for (; x + 32 <= width; x += 32) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x / 2));
+        const __m128i lo = _mm_and_si128(value, mask);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(value, 4), mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_unpacklo_epi8(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 16), _mm_unpackhi_epi8(lo, hi));
+    }
+#elif defined(VITA3K_AARCH64)
+    for (; x + 32 <= width; x += 32) {
+        const uint8x16_t value = vld1q_u8(src + x / 2);
+        uint8x16x2_t indices;
+        indices.val[0] = vandq_u8(value, vdupq_n_u8(0x0F));
+        indices.val[1] = vshrq_n_u8(value, 4);
+        vst2q_u8(dst + x, indices);
+    }
+#endif
+    for (; x < width; x += 2) {
+        const uint8_t lohi = src[x / 2];
+        dst[x] = lohi & 0xf;
+        if (x + 1 < width)
+            dst[x + 1] = lohi >> 4;
+    }
+}
+
+#ifdef VITA3K_X86_64
+TARGET_AVX2 static uint32_t palette_row_8_avx2(uint32_t *dst, const uint8_t *src, uint32_t width, const uint32_t *palette) {
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_i32gather_epi32(reinterpret_cast<const int *>(palette), indices, 4));
+    }
+    return x;
+}
+
+TARGET_AVX2 static uint32_t palette_row_4_avx2(uint32_t *dst, const uint8_t *src, uint32_t width, const uint32_t *palette) {
+    // each byte is used by two pixels, the first one takes the low nibble
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4);
+    const __m256i mask = _mm256_set1_epi32(0x0F);
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint32_t packed;
+        memcpy(&packed, src + x / 2, sizeof(packed));
+        const __m128i bytes = _mm_cvtsi32_si128(static_cast<int>(packed));
+        const __m256i doubled = _mm256_cvtepu8_epi32(_mm_unpacklo_epi8(bytes, bytes));
+        const __m256i indices = _mm256_and_si256(_mm256_srlv_epi32(doubled, shifts), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_i32gather_epi32(reinterpret_cast<const int *>(palette), indices, 4));
+    }
+    return x;
+}
+#endif
+
+void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *palette) {
+    for (uint32_t y = 0; y < height; ++y) {
+        uint32_t *dst_row = dst + y * width;
+        const uint8_t *src_row = src + y * (width / 2);
+
+        uint32_t x = 0;
+#ifdef VITA3K_X86_64
+        if (use_avx2)
+            x = palette_row_4_avx2(dst_row, src_row, width, palette);
+#endif
+        for (; x < width; x += 2) {
+            const uint8_t lohi = src_row[x / 2];
+            dst_row[x] = palette[lohi & 0xf];
+            if (x + 1 < width)
+                dst_row[x + 1] = palette[lohi >> 4];
+        }
+    }
+}
+
+void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *palette) {
+    const size_t count = static_cast<size_t>(width) * height;
+
+    size_t i = 0;
+#ifdef VITA3K_X86_64
+    // the image has no padding, it can be done as a single row
+    if (use_avx2 && count <= UINT32_MAX)
+        i = palette_row_8_avx2(dst, src, static_cast<uint32_t>(count), palette);
+#endif
+    for (; i < count; i++)
+        dst[i] = palette[src[i]];
+}
+
+void palette_indices_4_to_8(uint8_t *dst, const uint8_t *src, uint32_t width, uint32_t height) {
+    for (uint32_t y = 0; y < height; ++y)
+        split_nibbles_row(dst + y * width, src + y * (width / 2), width);
+}
+
+static void shuffle_pixel_bytes_scalar(uint8_t *pixels, size_t size, const std::array<uint8_t, 16> &mask) {
+    for (size_t offset = 0; offset < size; offset += 16) {
+        // the last chunk can be partial, the shuffle stays inside the pixels
+        const size_t chunk_size = std::min<size_t>(size - offset, 16);
+        std::array<uint8_t, 16> chunk;
+        memcpy(chunk.data(), pixels + offset, chunk_size);
+        for (size_t i = 0; i < chunk_size; i++)
+            pixels[offset + i] = chunk[mask[i]];
+    }
+}
+
+#ifdef VITA3K_X86_64
+TARGET_SSSE3 static size_t shuffle_pixel_bytes_ssse3(uint8_t *pixels, size_t size, const std::array<uint8_t, 16> &mask) {
+    const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask.data()));
+    size_t offset = 0;
+    for (; offset + 16 <= size; offset += 16) {
+        __m128i *chunk = reinterpret_cast<__m128i *>(pixels + offset);
+        _mm_storeu_si128(chunk, _mm_shuffle_epi8(_mm_loadu_si128(chunk), shuffle));
+    }
+    return offset;
+}
+
+TARGET_AVX2 static size_t shuffle_pixel_bytes_avx2(uint8_t *pixels, size_t size, const std::array<uint8_t, 16> &mask) {
+    // vpshufb shuffles each 128 bits lane on its own, which is what we want
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(mask.data())));
+    size_t offset = 0;
+    for (; offset + 32 <= size; offset += 32) {
+        __m256i *chunk = reinterpret_cast<__m256i *>(pixels + offset);
+        _mm256_storeu_si256(chunk, _mm256_shuffle_epi8(_mm256_loadu_si256(chunk), shuffle));
+    }
+    return offset;
+}
+#endif
+
+void shuffle_pixel_bytes(void *pixels, size_t size, const std::array<uint8_t, 16> &mask) {
+    uint8_t *bytes = static_cast<uint8_t *>(pixels);
+
+    size_t offset = 0;
+#ifdef VITA3K_X86_64
+    if (use_avx2)
+        offset = shuffle_pixel_bytes_avx2(bytes, size, mask);
+    if (use_ssse3)
+        offset += shuffle_pixel_bytes_ssse3(bytes + offset, size - offset, mask);
+#elif defined(VITA3K_AARCH64)
+    const uint8x16_t shuffle = vld1q_u8(mask.data());
+    for (; offset + 16 <= size; offset += 16)
+        vst1q_u8(bytes + offset, vqtbl1q_u8(vld1q_u8(bytes + offset), shuffle));
+#endif
+    shuffle_pixel_bytes_scalar(bytes + offset, size - offset, mask);
+}
+
+std::array<uint8_t, 16> get_component_shuffle_mask(const std::array<uint8_t, 4> &components, uint32_t component_count, uint32_t component_size) {
+    std::array<uint8_t, 16> mask{};
+    const uint32_t pixel_size = component_count * component_size;
+    for (uint32_t i = 0; i < 16; i++) {
+        const uint32_t pixel = i / pixel_size;
+        const uint32_t component = (i % pixel_size) / component_size;
+        const uint32_t byte = i % component_size;
+        mask[i] = static_cast<uint8_t>(pixel * pixel_size + components[component] * component_size + byte);
+    }
+    return mask;
+}
+
+} // namespace renderer::texture
@@ -26,8 +26,28 @@
 #include <renderer/pvrt-dec.h>
 #include <shader/spirv_recompiler.h>
 #include <util/align.h>
+#include <util/instrset_detect.h>
 #include <util/log.h>
 
+#include <array>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VITA3K_X86_64
+#include <immintrin.h>
+// msvc allows to use any intrinsic, other compilers need the functions to be marked
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#define TARGET_BMI2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_BMI2 __attribute__((target("bmi2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VITA3K_AARCH64
+#include <arm_neon.h>
+#endif
+
 namespace renderer::texture {
 
 bool convert_base_texture_format_to_base_color_format(SceGxmTextureBaseFormat format, SceGxmColorBaseFormat &color_format) {
@@ -166,112 +186,6 @@ void decompress_packed_float_e5m9m9m9(SceGxmTextureBaseFormat fmt, void *dest, c
     }
 }
 
-void convert_x8u24_to_u24x8(void *dest, const void *data, const uint32_t width, const uint32_t height) {
-    auto dst = static_cast<uint32_t *>(dest);
-    auto src = static_cast<const uint32_t *>(data);
-
-    for (uint32_t row = 0; row < height; ++row) {
-        for (uint32_t col = 0; col < width; ++col) {
-            uint32_t src_value = src[row * width + col];
-            dst[row * width + col] = (src_value << 8) | (src_value >> 24);
-        }
-    }
-}
-
-void convert_x8u24_to_f32(void *dest, const void *data, const uint32_t width, const uint32_t height, const SceGxmTextureFormat format) {
-    const SceGxmTextureSwizzle2ModeAlt swizzle = static_cast<SceGxmTextureSwizzle2ModeAlt>(format & SCE_GXM_TEXTURE_SWIZZLE_MASK);
-    // is the depth in the upper or lower 24 bits of the data?
-    int shift_amount = (swizzle == SCE_GXM_TEXTURE_SWIZZLE2_DS) ? 8 : 0;
-    auto dst = static_cast<float *>(dest);
-    auto src = static_cast<const uint32_t *>(data);
-
-    for (uint32_t row = 0; row < height; ++row) {
-        for (uint32_t col = 0; col < width; ++col) {
-            const uint32_t src_value = src[row * width + height];
-            const uint32_t d24 = (src_value >> shift_amount) & ((1U << 24) - 1);
-            dst[row * width + height] = static_cast<float>(d24) / ((1U << 24) - 1);
-        }
-    }
-}
-
-void convert_U8U3U3U2_to_U8U8U8U8(void *dest, const void *data, const uint32_t width, const uint32_t height) {
-    auto dst = static_cast<uint32_t *>(dest);
-    auto src = static_cast<const uint16_t *>(data);
-
-    for (uint32_t row = 0; row < height; ++row) {
-        for (uint32_t col = 0; col < width; ++col) {
-            const uint32_t src_value = src[row * width + height];
-
-            const uint8_t alpha = (src_value & 0xFF00) >> 8;
-            const uint8_t red = (src_value & 0x00E0) >> 5;
-            const uint8_t green = (src_value & 0x001C) >> 2;
-            const uint8_t blue = (src_value & 0x0003);
-
-            const uint32_t value = (alpha << 24) | (blue << 22) | (blue << 20) | (blue << 18) | (blue << 16) | (green << 13) | (green << 10) | ((green & 0b110) << 7) | (red << 5) | (red << 2) | (red >> 1);
-
-            dst[row * width + height] = value;
-        }
-    }
-}
-
-void convert_f32m_to_f32(void *dest, const void *data, const uint32_t width, const uint32_t height) {
-    auto dst = static_cast<uint32_t *>(dest);
-    auto src = static_cast<const uint32_t *>(data);
-
-    for (uint32_t row = 0; row < height; ++row) {
-        for (uint32_t col = 0; col < width; ++col) {
-            const uint32_t src_value = src[row * width + height];
-            dst[row * width + height] = src_value & 0x7FFFFFFF;
-        }
-    }
-}
-
-static uint16_t f10_to_f16(const uint16_t f10) {
-    // f16 has a 10 bit mantissa and a 5 bit exponent
-    // f10 has a 5 bit mantissa and a 5 bit exponent
-    // so we just need to put the exponent in the right location, add zeros to the mantissa
-    // and it should work
-    // Note: I don't think this works for subnormal numbers
-    const uint16_t exponent = (f10 >> 5) & 0b11111;
-    const uint16_t mantissa = f10 & 0b11111;
-    const uint16_t f16 = (exponent << 10) | (mantissa << 5);
-    return f16;
-}
-
-void convert_u2f10f10f10_to_f16f16f16f16(void *dest, const void *data, const uint32_t width, const uint32_t height, const SceGxmTextureFormat format) {
-    auto dst = static_cast<std::array<uint16_t, 4> *>(dest);
-    auto src = static_cast<const uint32_t *>(data);
-
-    // are the 2 alpha bits in the upper or lower bits of the pixel ?
-    bool is_alpha_upper = (format == SCE_GXM_TEXTURE_FORMAT_U2F10F10F10_ABGR
-        || format == SCE_GXM_TEXTURE_FORMAT_U2F10F10F10_ARGB
-        || format == SCE_GXM_TEXTURE_FORMAT_X2F10F10F10_1BGR
-        || format == SCE_GXM_TEXTURE_FORMAT_X2F10F10F10_1RGB);
-
-    for (uint32_t row = 0; row < height; ++row) {
-        for (uint32_t col = 0; col < width; ++col) {
-            uint32_t src_value = src[row * width + height];
-            int dst_idx;
-            // first get the 2 alpha bits
-            if (is_alpha_upper) {
-                dst[row * width + height][3] = (src_value >> 30) / 3.0f;
-                dst_idx = 0;
-            } else {
-                dst[row * width + height][0] = (src_value & 0b11) / 3.0f;
-                dst_idx = 1;
-                src_value >>= 2;
-            }
-
-            // decode the 3 rgb components
-            for (int i = 0; i < 3; i++) {
-                const uint16_t comp = src_value & ((1 << 10) - 1);
-                src_value >>= 10;
-                dst[row * width + height][dst_idx++] = f10_to_f16(comp);
-            }
-        }
-    }
-}
-
 // Based on this: http://xen.firefly.nu/up/rearrange.c.html
 // https://fgiesen.wordpress.com/2009/12/13/decoding-morton-codes/
 // Thanks daniel from GXTConvert finding this out first
@@ -286,21 +200,50 @@ static uint32_t compact_one_by_one(uint32_t x) {
     return x;
 }
 
+static uint32_t Part1By1(uint32_t x) {
+    x &= 0x0000ffff; // x = ---- ---- ---- ---- fedc ba98 7654 3210
+    x = (x ^ (x << 8)) & 0x00ff00ff; // x = ---- ---- fedc ba98 ---- ---- 7654 3210
+    x = (x ^ (x << 4)) & 0x0f0f0f0f; // x = ---- fedc ---- ba98 ---- 7654 ---- 3210
+    x = (x ^ (x << 2)) & 0x33333333; // x = --fe --dc --ba --98 --76 --54 --32 --10
+    x = (x ^ (x << 1)) & 0x55555555; // x = -f-e -d-c -b-a -9-8 -7-6 -5-4 -3-2 -1-0
+    return x;
+}
+
+#ifdef VITA3K_X86_64
+// pdep and pext do the same as Part1By1 and compact_one_by_one in one instruction
+static const bool use_bmi2 = util::instrset::hasFastBMI2();
+
+TARGET_BMI2 static uint32_t compact_one_by_one_bmi2(uint32_t x) {
+    return _pext_u32(x, 0x55555555);
+}
+
+TARGET_BMI2 static uint32_t Part1By1_bmi2(uint32_t x) {
+    return _pdep_u32(x, 0x55555555);
+}
+#endif
+
 uint32_t decode_morton2_y(uint32_t code) {
+#ifdef VITA3K_X86_64
+    if (use_bmi2)
+        return compact_one_by_one_bmi2(code >> 0);
+#endif
     return compact_one_by_one(code >> 0);
 }
 
 uint32_t decode_morton2_x(uint32_t code) {
+#ifdef VITA3K_X86_64
+    if (use_bmi2)
+        return compact_one_by_one_bmi2(code >> 1);
+#endif
     return compact_one_by_one(code >> 1);
 }
 
-static uint32_t Part1By1(uint32_t x) {
-    x &= 0x0000ffff; // x = ---- ---- ---- ---- fedc ba98 7654 3210
-    x = (x ^ (x << 8)) & 0x00ff00ff; // x = ---- ---- fedc ba98 ---- ---- 7654 3210
-    x = (x ^ (x << 4)) & 0x0f0f0f0f; // x = ---- fedc ---- ba98 ---- 7654 ---- 3210
-    x = (x ^ (x << 2)) & 0x33333333; // x = --fe --dc --ba --98 --76 --54 --32 --10
-    x = (x ^ (x << 1)) & 0x55555555; // x = -f-e -d-c -b-a -9-8 -7-6 -5-4 -3-2 -1-0
-    return x;
+static uint32_t part_1_by_1(uint32_t x) {
+#ifdef VITA3K_X86_64
+    if (use_bmi2)
+        return Part1By1_bmi2(x & 0x0000ffff);
+#endif
+    return Part1By1(x);
 }
 
 uint32_t encode_morton(uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
@@ -315,12 +258,182 @@ uint32_t encode_morton(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
     // xxx--------
     uint32_t result = static_cast<uint32_t>((x >> k) | (y >> k)) << 2 * k;
     // xxxx-x-x-x-
-    result |= (Part1By1(x & (min - 1)) << 1);
+    result |= (part_1_by_1(x & (min - 1)) << 1);
     // xxxxyxyxyxy
-    result |= Part1By1(y & (min - 1));
+    result |= part_1_by_1(y & (min - 1));
     return result;
 }
 
+// The swizzled texture is made of 8x8 tiles, each one being 64 consecutive pixels in the source.
+// Inside a tile, pixel i is at x = decode_morton2_x(i), y = decode_morton2_y(i).
+// The kernels below copy one tile to the linear texture, dest_stride is the size of a row of the linear texture in bytes.
+
+// offset in pixels in the source of the pixel (x, y) of a tile, indexed by [y][x]
+static constexpr auto tile_morton_offsets = []() {
+    std::array<std::array<uint8_t, 8>, 8> offsets{};
+    for (uint32_t i = 0; i < 64; i++) {
+        const uint32_t x = ((i >> 1) & 1) | ((i >> 2) & 2) | ((i >> 3) & 4);
+        const uint32_t y = (i & 1) | ((i >> 1) & 2) | ((i >> 2) & 4);
+        offsets[y][x] = static_cast<uint8_t>(i);
+    }
+    return offsets;
+}();
+
+template <size_t bytes_per_pixel>
+static void copy_morton_tile(uint8_t *dest, size_t dest_stride, const uint8_t *src) {
+    for (uint32_t y = 0; y < 8; y++) {
+        uint8_t *dest_row = dest + y * dest_stride;
+        for (uint32_t x = 0; x < 8; x++)
+            memcpy(dest_row + x * bytes_per_pixel, src + tile_morton_offsets[y][x] * bytes_per_pixel, bytes_per_pixel);
+    }
+}
+
+// In a 4x4 block of 4 bytes pixels, row y is made of the pixels y&1 + (y&2)*2 + { 0, 2, 8, 10 }
+// With the block loaded as 4 vectors of 4 pixels (a, b, c, d), the rows are:
+// (a0 a2 c0 c2), (a1 a3 c1 c3), (b0 b2 d0 d2), (b1 b3 d1 d3)
+// An 8x8 tile is made of 4 of these blocks: top left, bottom left, top right, bottom right.
+#ifdef VITA3K_X86_64
+static void copy_morton_tile_4bpp_sse2(uint8_t *dest, size_t dest_stride, const uint8_t *src) {
+    for (uint32_t block = 0; block < 4; block++) {
+        const float *block_src = reinterpret_cast<const float *>(src) + block * 16;
+        float *block_dest = reinterpret_cast<float *>(dest + (block & 1) * 4 * dest_stride) + (block >> 1) * 4;
+
+        const __m128 a = _mm_loadu_ps(block_src);
+        const __m128 b = _mm_loadu_ps(block_src + 4);
+        const __m128 c = _mm_loadu_ps(block_src + 8);
+        const __m128 d = _mm_loadu_ps(block_src + 12);
+
+        _mm_storeu_ps(block_dest, _mm_shuffle_ps(a, c, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(reinterpret_cast<float *>(reinterpret_cast<uint8_t *>(block_dest) + dest_stride), _mm_shuffle_ps(a, c, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_ps(reinterpret_cast<float *>(reinterpret_cast<uint8_t *>(block_dest) + 2 * dest_stride), _mm_shuffle_ps(b, d, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(reinterpret_cast<float *>(reinterpret_cast<uint8_t *>(block_dest) + 3 * dest_stride), _mm_shuffle_ps(b, d, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+}
+
+// same as the sse2 version, but the left and right blocks are done at the same time
+TARGET_AVX2 static void copy_morton_tile_4bpp_avx2(uint8_t *dest, size_t dest_stride, const uint8_t *src) {
+    const float *tile_src = reinterpret_cast<const float *>(src);
+    for (uint32_t block = 0; block < 2; block++) {
+        const float *left_src = tile_src + block * 16;
+        const float *right_src = left_src + 32;
+        uint8_t *block_dest = dest + block * 4 * dest_stride;
+
+        const __m256 left_ab = _mm256_loadu_ps(left_src);
+        const __m256 left_cd = _mm256_loadu_ps(left_src + 8);
+        const __m256 right_ab = _mm256_loadu_ps(right_src);
+        const __m256 right_cd = _mm256_loadu_ps(right_src + 8);
+
+        // (left a, right a), (left c, right c), ...
+        const __m256 a = _mm256_permute2f128_ps(left_ab, right_ab, 0x20);
+        const __m256 b = _mm256_permute2f128_ps(left_ab, right_ab, 0x31);
+        const __m256 c = _mm256_permute2f128_ps(left_cd, right_cd, 0x20);
+        const __m256 d = _mm256_permute2f128_ps(left_cd, right_cd, 0x31);
+
+        _mm256_storeu_ps(reinterpret_cast<float *>(block_dest), _mm256_shuffle_ps(a, c, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm256_storeu_ps(reinterpret_cast<float *>(block_dest + dest_stride), _mm256_shuffle_ps(a, c, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm256_storeu_ps(reinterpret_cast<float *>(block_dest + 2 * dest_stride), _mm256_shuffle_ps(b, d, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm256_storeu_ps(reinterpret_cast<float *>(block_dest + 3 * dest_stride), _mm256_shuffle_ps(b, d, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+}
+
+// with 8 bytes pixels, each vector contains 2 pixels (r0 = pixels 0 and 1, r1 = pixels 2 and 3...)
+// the rows of a 4x4 block are then (r0.lo r1.lo r4.lo r5.lo), (r0.hi r1.hi r4.hi r5.hi), (r2.lo r3.lo r6.lo r7.lo), (r2.hi r3.hi r6.hi r7.hi)
+static void copy_morton_tile_8bpp_sse2(uint8_t *dest, size_t dest_stride, const uint8_t *src) {
+    for (uint32_t block = 0; block < 4; block++) {
+        const __m128i *block_src = reinterpret_cast<const __m128i *>(src + block * 16 * 8);
+        uint8_t *block_dest = dest + (block & 1) * 4 * dest_stride + (block >> 1) * 4 * 8;
+
+        __m128i r[8];
+        for (int i = 0; i < 8; i++)
+            r[i] = _mm_loadu_si128(block_src + i);
+
+        for (int row = 0; row < 4; row++) {
+            const int first = (row >> 1) * 2;
+            __m128i *row_dest = reinterpret_cast<__m128i *>(block_dest + row * dest_stride);
+            if (row & 1) {
+                _mm_storeu_si128(row_dest, _mm_unpackhi_epi64(r[first], r[first + 1]));
+                _mm_storeu_si128(row_dest + 1, _mm_unpackhi_epi64(r[first + 4], r[first + 5]));
+            } else {
+                _mm_storeu_si128(row_dest, _mm_unpacklo_epi64(r[first], r[first + 1]));
+                _mm_storeu_si128(row_dest + 1, _mm_unpacklo_epi64(r[first + 4], r[first + 5]));
+            }
+        }
+    }
+}
+#elif defined(VITA3K_AARCH64)
+static void copy_morton_tile_4bpp_neon(uint8_t *dest, size_t dest_stride, const uint8_t *src) {
+    for (uint32_t block = 0; block < 4; block++) {
+        const uint32_t *block_src = reinterpret_cast<const uint32_t *>(src) + block * 16;
+        uint8_t *block_dest = dest + (block & 1) * 4 * dest_stride + (block >> 1) * 4 * 4;
+
+        const uint32x4_t a = vld1q_u32(block_src);
+        const uint32x4_t b = vld1q_u32(block_src + 4);
+        const uint32x4_t c = vld1q_u32(block_src + 8);
+        const uint32x4_t d = vld1q_u32(block_src + 12);
+
+        vst1q_u32(reinterpret_cast<uint32_t *>(block_dest), vuzp1q_u32(a, c));
+        vst1q_u32(reinterpret_cast<uint32_t *>(block_dest + dest_stride), vuzp2q_u32(a, c));
+        vst1q_u32(reinterpret_cast<uint32_t *>(block_dest + 2 * dest_stride), vuzp1q_u32(b, d));
+        vst1q_u32(reinterpret_cast<uint32_t *>(block_dest + 3 * dest_stride), vuzp2q_u32(b, d));
+    }
+}
+
+static void copy_morton_tile_8bpp_neon(uint8_t *dest, size_t dest_stride, const uint8_t *src) {
+    for (uint32_t block = 0; block < 4; block++) {
+        const uint64_t *block_src = reinterpret_cast<const uint64_t *>(src) + block * 16;
+        uint8_t *block_dest = dest + (block & 1) * 4 * dest_stride + (block >> 1) * 4 * 8;
+
+        uint64x2_t r[8];
+        for (int i = 0; i < 8; i++)
+            r[i] = vld1q_u64(block_src + i * 2);
+
+        for (int row = 0; row < 4; row++) {
+            const int first = (row >> 1) * 2;
+            uint64_t *row_dest = reinterpret_cast<uint64_t *>(block_dest + row * dest_stride);
+            if (row & 1) {
+                vst1q_u64(row_dest, vzip2q_u64(r[first], r[first + 1]));
+                vst1q_u64(row_dest + 2, vzip2q_u64(r[first + 4], r[first + 5]));
+            } else {
+                vst1q_u64(row_dest, vzip1q_u64(r[first], r[first + 1]));
+                vst1q_u64(row_dest + 2, vzip1q_u64(r[first + 4], r[first + 5]));
+            }
+        }
+    }
+}
+#endif
+
+using MortonTileCopy = void (*)(uint8_t *dest, size_t dest_stride, const uint8_t *src);
+
+static MortonTileCopy get_morton_tile_copy(uint32_t bytes_per_pixel) {
+    switch (bytes_per_pixel) {
+    case 1: return copy_morton_tile<1>;
+    case 2: return copy_morton_tile<2>;
+    case 3: return copy_morton_tile<3>;
+    case 4:
+#ifdef VITA3K_X86_64
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX2)
+            return copy_morton_tile_4bpp_avx2;
+        return copy_morton_tile_4bpp_sse2;
+#elif defined(VITA3K_AARCH64)
+        return copy_morton_tile_4bpp_neon;
+#else
+        return copy_morton_tile<4>;
+#endif
+    case 6: return copy_morton_tile<6>;
+    case 8:
+#ifdef VITA3K_X86_64
+        return copy_morton_tile_8bpp_sse2;
+#elif defined(VITA3K_AARCH64)
+        return copy_morton_tile_8bpp_neon;
+#else
+        return copy_morton_tile<8>;
+#endif
+    case 12: return copy_morton_tile<12>;
+    case 16: return copy_morton_tile<16>;
+    default: return nullptr;
+    }
+}
+
 void swizzled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
     if (bits_per_pixel % 8 != 0) {
         // Don't support yet
@@ -331,6 +444,29 @@ void swizzled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint1
     uint32_t min = std::min(width, height);
     uint32_t k = std::bit_width(min) - 1;
 
+    const MortonTileCopy copy_tile = get_morton_tile_copy(bytes_per_pixel);
+    if (copy_tile && min >= 8 && std::has_single_bit(width) && std::has_single_bit(height)) {
+        // the tiles are themselves in morton order, with the same layout as the pixels
+        const uint32_t tile_min = min / 8;
+        const uint32_t tile_k = k - 3;
+        const uint32_t tile_count = (width / 8) * (height / 8);
+        const size_t dest_stride = static_cast<size_t>(width) * bytes_per_pixel;
+
+        for (uint32_t i = 0; i < tile_count; i++) {
+            uint32_t x = decode_morton2_x(i) & (tile_min - 1);
+            uint32_t y = decode_morton2_y(i) & (tile_min - 1);
+            uint32_t upper_bits = (i >> (2 * tile_k)) << tile_k;
+            if (width >= height) {
+                x |= upper_bits;
+            } else {
+                y |= upper_bits;
+            }
+
+            copy_tile(dest + (y * 8) * dest_stride + (x * 8) * bytes_per_pixel, dest_stride, src + i * 64 * bytes_per_pixel);
+        }
+        return;
+    }
+
     for (uint32_t i = 0; i < width * static_cast<uint32_t>(height); i++) {
         uint32_t x = decode_morton2_x(i) & (min - 1);
         uint32_t y = decode_morton2_y(i) & (min - 1);
@@ -355,16 +491,17 @@ void tiled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t
     const uint32_t bpp = bits_per_pixel >> 3;
     const uint32_t width_in_tiles = (width + 31) >> 5;
 
+    // each row of a tile is 32 consecutive pixels in the source, copy it at once
     for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            // Calculate texel address in tile
-            const uint32_t texel_offset_in_tile = (x & 0b11111) | ((y & 0b11111) << 5);
+        for (uint16_t x = 0; x < width; x += 32) {
+            const uint32_t texel_offset_in_tile = (y & 0b11111) << 5;
             const uint32_t tile_address = (x >> 5) + width_in_tiles * (y >> 5);
 
             const uint32_t offset = ((tile_address << 10) | (texel_offset_in_tile)) * bpp;
+            const uint32_t row_size = std::min<uint32_t>(32, width - x) * bpp;
 
             // Make scanline
-            memcpy(dest + ((y * width) + x) * bpp, src + offset, bpp);
+            memcpy(dest + ((y * width) + x) * bpp, src + offset, row_size);
         }
     }
 }
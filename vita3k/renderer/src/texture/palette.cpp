@@ -25,26 +25,6 @@
 namespace renderer {
 namespace texture {
 
-void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *palette) {
-    for (uint32_t y = 0; y < height; ++y) {
-        for (uint32_t x = 0; x < width; x += 2) {
-            const uint8_t lohi = src[y * (width / 2) + x / 2];
-            const uint8_t lo = lohi & 0xf;
-            const uint8_t hi = lohi >> 4;
-            dst[y * width + x] = palette[lo];
-            dst[y * width + x + 1] = palette[hi];
-        }
-    }
-}
-
-void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *palette) {
-    for (uint32_t y = 0; y < height; ++y) {
-        for (uint32_t x = 0; x < width; ++x) {
-            dst[y * width + x] = palette[src[y * width + x]];
-        }
-    }
-}
-
 const uint32_t *get_texture_palette(const SceGxmTexture &texture, const MemState &mem) {
     const Ptr<const uint32_t> palette_ptr(texture.palette_addr << 6);
     return palette_ptr.get(mem);
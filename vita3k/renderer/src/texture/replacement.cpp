@@ -21,12 +21,16 @@
 #include "gxm/functions.h"
 #include "util/float_to_half.h"
 #include "util/log.h"
+#include "util/mapped_file.h"
 
 #include <ddspp.h>
 #include <fmt/format.h>
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include <algorithm>
+#include <atomic>
+
 static constexpr bool log_texture_import = false;
 static constexpr bool log_texture_export = true;
 
@@ -54,88 +58,48 @@ static void reverse_comp3_order(const void *src, void *dst, uint32_t nb_pixels);
 // some dds format are encoded in a bgra way, in this case the swizzle must be changed
 static bool dds_swap_rb(const ddspp::DXGIFormat format);
 
-void TextureCache::export_select(const SceGxmTexture &texture) {
-    const SceGxmTextureBaseFormat format = gxm::get_base_format(gxm::get_format(texture));
-    const bool is_cube = texture.texture_type() == SCE_GXM_TEXTURE_CUBE || texture.texture_type() == SCE_GXM_TEXTURE_CUBE_ARBITRARY;
-
-    if (is_cube && save_as_png) {
-        LOG_WARN_ONCE("Cubemaps can only be exported as a dds file");
-        return;
-    }
-
-    if (save_as_png && !allowed_png_textures(format))
-        return;
-    else if (!save_as_png && !allowed_dds_textures(format))
-        return;
-
-    if (exported_textures_hash.contains(current_info->hash))
-        // texture was already exported
-        return;
-
-    if (!save_as_png) {
-        if (!dds_descriptor)
-            dds_descriptor = new ddspp::Descriptor;
-
-        ddspp::DXGIFormat dxgi_format = gxm_to_dxgi(format);
-        if (dxgi_format == ddspp::UNKNOWN)
-            return;
-
-        if (texture.gamma_mode != 0)
-            dxgi_format = dxgi_apply_srgb(dxgi_format);
-        const uint32_t width = gxm::get_width(texture);
-        const uint32_t height = gxm::get_height(texture);
-        const uint32_t mipcount = texture::get_upload_mip(texture.true_mip_count(), width, height);
-        const uint32_t array_size = is_cube ? 6 : 1;
-        ddspp::TextureType texture_type = is_cube ? ddspp::Cubemap : ddspp::Texture2D;
-        ddspp::Header header;
-        memset(&header, 0, sizeof(header));
-        ddspp::HeaderDXT10 dxt_header;
-        memset(&dxt_header, 0, sizeof(dxt_header));
-        ddspp::encode_header(dxgi_format, width, height, 1, texture_type, mipcount, array_size, header, dxt_header);
-
-        // we need to do this to get the descriptor anyway
-        std::vector<uint8_t> file_header(ddspp::MAX_HEADER_SIZE);
-        memcpy(file_header.data(), &ddspp::DDS_MAGIC, sizeof(ddspp::DDS_MAGIC));
-        memcpy(file_header.data() + sizeof(ddspp::DDS_MAGIC), &header, sizeof(header));
-        memcpy(file_header.data() + sizeof(ddspp::DDS_MAGIC) + sizeof(header), &dxt_header, sizeof(dxt_header));
-
-        ddspp::decode_header(file_header.data(), *dds_descriptor);
-
-        const std::string file_name = fmt::format("{:016X}.dds", current_info->hash);
-        fs::path export_name = export_folder / file_name;
-        output_file.open(export_name, std::ios_base::binary | std::ios_base::trunc);
-
-        if (!output_file.is_open()) {
-            LOG_ERROR("Failed to open file {} for writing", file_name);
-            return;
-        }
-
-        output_file.write(reinterpret_cast<const char *>(file_header.data()), dds_descriptor->headerSize);
-
-        if (log_texture_export)
-            LOG_DEBUG("Exporting texture {} ({}x{})", file_name, width, height);
-
-        export_dds_swap_rb = dds_swap_rb(dxgi_format);
-    }
-
-    exporting_texture = true;
-}
-
-void TextureCache::export_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride) {
-    if (!exporting_texture)
-        return;
-
-    if (save_as_png && (mip_index != 0 || face != 0))
-        // png does not support mipmap / cubemap
-        return;
+// texture being exported, its mips are copied by the renderer thread and written by an export worker
+struct ExportedTexture {
+    struct Mip {
+        SceGxmTextureBaseFormat base_format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_index;
+        int face;
+        uint32_t pixels_per_stride;
+        std::vector<uint8_t> pixels;
+    };
 
-    SceGxmTexture &gxm_texture = current_info->texture;
+    uint64_t hash = 0;
+    SceGxmTexture texture;
+    bool save_as_png = true;
+    fs::path export_folder;
+    // header of the dds file and its decoded descriptor
+    std::vector<uint8_t> file_header;
+    ddspp::Descriptor dds_descriptor = {};
+    bool dds_swap_rb = false;
+
+    std::vector<Mip> mips;
+    // size of the copied pixels, counted in the export memory budget
+    size_t memory_size = 0;
+};
+
+// called by an export worker, converts a mip copied by the renderer thread and writes it
+// output_file is only used for dds files
+static bool export_mip(const ExportedTexture &exported, const ExportedTexture::Mip &mip, fs::ofstream *output_file) {
+    SceGxmTextureBaseFormat base_format = mip.base_format;
+    uint32_t width = mip.width;
+    uint32_t height = mip.height;
+    const uint32_t pixels_per_stride = mip.pixels_per_stride;
+    const void *pixels = mip.pixels.data();
+
+    const SceGxmTexture &gxm_texture = exported.texture;
     uint32_t nb_comp = gxm::get_num_components(base_format);
     bool alpha_is_1 = static_cast<bool>(gxm_texture.swizzle_format & 0b100);
     bool alpha_is_first = static_cast<bool>(gxm_texture.swizzle_format & 0b010);
     bool swap_rb = static_cast<bool>(gxm_texture.swizzle_format & 0b001);
 
-    if (!save_as_png && export_dds_swap_rb)
+    if (!exported.save_as_png && exported.dds_swap_rb)
         swap_rb = !swap_rb;
 
     const uint32_t nb_pixels = pixels_per_stride * height;
@@ -186,17 +150,13 @@ void TextureCache::export_texture_impl(SceGxmTextureBaseFormat base_format, uint
             break;
         default:
             LOG_ERROR("Unhandled swizzle for texture format {}, please report it to the developpers.", log_hex(fmt::underlying(base_format)));
-            return;
+            return false;
         }
 
         pixels = data_unswizzled.data();
     }
 
-    if (save_as_png) {
-        // only save the first mip (and no cube map)
-        if (mip_index != 0 || face != 0)
-            return;
-
+    if (exported.save_as_png) {
         // convert the texture if necessary
         std::vector<uint8_t> converted_data;
         if (base_format != SCE_GXM_TEXTURE_BASE_FORMAT_U8
@@ -313,7 +273,7 @@ void TextureCache::export_texture_impl(SceGxmTextureBaseFormat base_format, uint
         }
         default:
             LOG_ERROR("Unhandled format for png exportation {}, please report it to the developpers.", log_hex(fmt::underlying(base_format)));
-            return;
+            return false;
         }
 
         const uint8_t *data = converted_data.empty() ? reinterpret_cast<const uint8_t *>(pixels) : converted_data.data();
@@ -359,16 +319,17 @@ void TextureCache::export_texture_impl(SceGxmTextureBaseFormat base_format, uint
             }
         }
 
-        uint64_t hash = current_info->hash;
-        const std::string file_name = fmt::format("{:016X}.png", hash);
-        fs::path export_name = export_folder / file_name;
-        stbi_write_png(export_name.generic_string().c_str(), width, height, nb_comp, data, pixels_per_stride * nb_comp);
+        const std::string file_name = fmt::format("{:016X}.png", exported.hash);
+        fs::path export_name = exported.export_folder / file_name;
+        if (!stbi_write_png(export_name.generic_string().c_str(), width, height, nb_comp, data, pixels_per_stride * nb_comp)) {
+            LOG_ERROR("Failed to write texture {}", file_name);
+            return false;
+        }
 
         if (log_texture_export)
             LOG_DEBUG("Texture {} ({}x{}) exported", file_name, width, height);
 
-        exported_textures_hash.insert(hash);
-        return;
+        return true;
     }
 
     // export as dds
@@ -389,10 +350,9 @@ void TextureCache::export_texture_impl(SceGxmTextureBaseFormat base_format, uint
     auto [block_width, block_height] = gxm::get_block_size(base_format);
     width = align(width, block_width);
     height = align(height, block_height);
-    if (face > 0)
-        face--;
-    const size_t file_offset = ddspp::get_offset(*dds_descriptor, mip_index, face);
-    output_file.seekp(dds_descriptor->headerSize + file_offset);
+    const int face = (mip.face > 0) ? mip.face - 1 : 0;
+    const size_t file_offset = ddspp::get_offset(exported.dds_descriptor, mip.mip_index, face);
+    output_file->seekp(exported.dds_descriptor.headerSize + file_offset);
 
     const uint32_t bpp = gxm::bits_per_pixel(base_format);
     uint32_t block_stride_in_bytes = (pixels_per_stride * block_height * bpp) / 8;
@@ -400,143 +360,422 @@ void TextureCache::export_texture_impl(SceGxmTextureBaseFormat base_format, uint
     uint32_t nb_blocks_y = height / block_height;
     const char *data_loc = reinterpret_cast<const char *>(pixels);
     for (uint32_t block_y = 0; block_y < nb_blocks_y; block_y++) {
-        output_file.write(data_loc, block_width_in_bytes);
+        output_file->write(data_loc, block_width_in_bytes);
         data_loc += block_stride_in_bytes;
     }
+
+    return true;
 }
 
-void TextureCache::export_done() {
-    if (exporting_texture && !save_as_png) {
-        output_file.close();
-        exported_textures_hash.insert(current_info->hash);
+
+void TextureCache::export_select(const SceGxmTexture &texture) {
+    const SceGxmTextureBaseFormat format = gxm::get_base_format(gxm::get_format(texture));
+    const bool is_cube = texture.texture_type() == SCE_GXM_TEXTURE_CUBE || texture.texture_type() == SCE_GXM_TEXTURE_CUBE_ARBITRARY;
+
+    if (is_cube && save_as_png) {
+        LOG_WARN_ONCE("Cubemaps can only be exported as a dds file");
+        return;
     }
 
-    exporting_texture = false;
+    if (save_as_png && !allowed_png_textures(format))
+        return;
+    else if (!save_as_png && !allowed_dds_textures(format))
+        return;
+
+    {
+        const std::lock_guard<std::mutex> lock(export_mutex);
+        if (exported_textures_hash.contains(current_info->hash))
+            // texture was already exported
+            return;
+    }
+
+    auto exported = std::make_shared<ExportedTexture>();
+    exported->hash = current_info->hash;
+    exported->texture = texture;
+    exported->save_as_png = save_as_png;
+    exported->export_folder = export_folder;
+
+    if (!save_as_png) {
+        ddspp::DXGIFormat dxgi_format = gxm_to_dxgi(format);
+        if (dxgi_format == ddspp::UNKNOWN)
+            return;
+
+        if (texture.gamma_mode != 0)
+            dxgi_format = dxgi_apply_srgb(dxgi_format);
+        const uint32_t width = gxm::get_width(texture);
+        const uint32_t height = gxm::get_height(texture);
+        const uint32_t mipcount = texture::get_upload_mip(texture.true_mip_count(), width, height);
+        const uint32_t array_size = is_cube ? 6 : 1;
+        ddspp::TextureType texture_type = is_cube ? ddspp::Cubemap : ddspp::Texture2D;
+        ddspp::Header header;
+        memset(&header, 0, sizeof(header));
+        ddspp::HeaderDXT10 dxt_header;
+        memset(&dxt_header, 0, sizeof(dxt_header));
+        ddspp::encode_header(dxgi_format, width, height, 1, texture_type, mipcount, array_size, header, dxt_header);
+
+        // we need to do this to get the descriptor anyway
+        std::vector<uint8_t> &file_header = exported->file_header;
+        file_header.resize(ddspp::MAX_HEADER_SIZE);
+        memcpy(file_header.data(), &ddspp::DDS_MAGIC, sizeof(ddspp::DDS_MAGIC));
+        memcpy(file_header.data() + sizeof(ddspp::DDS_MAGIC), &header, sizeof(header));
+        memcpy(file_header.data() + sizeof(ddspp::DDS_MAGIC) + sizeof(header), &dxt_header, sizeof(dxt_header));
+
+        ddspp::decode_header(file_header.data(), exported->dds_descriptor);
+        file_header.resize(exported->dds_descriptor.headerSize);
+
+        if (log_texture_export)
+            LOG_DEBUG("Exporting texture {:016X}.dds ({}x{})", current_info->hash, width, height);
+
+        exported->dds_swap_rb = dds_swap_rb(dxgi_format);
+    }
+
+    current_export = std::move(exported);
+    exporting_texture = true;
 }
 
-bool TextureCache::import_configure_texture() {
-    uint64_t hash = current_info->hash;
-    const std::string file_name = fmt::format("{:016X}.{}", hash, loading_texture.is_dds ? "dds" : "png");
-    fs::path import_name = *loading_texture.folder_path / file_name;
+void TextureCache::export_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, uint32_t pixels_per_stride) {
+    if (!exporting_texture)
+        return;
+
+    if (save_as_png && (mip_index != 0 || face != 0))
+        // png does not support mipmap / cubemap
+        return;
 
-    if (!fs::exists(import_name)) {
-        LOG_ERROR("Texture {} was listed as available but was not found", file_name);
+    // the pixels are only valid during the upload, the export worker gets a copy
+    const auto [block_width, block_height] = gxm::get_block_size(base_format);
+    const size_t mip_size = (static_cast<size_t>(pixels_per_stride) * align(height, block_height) * gxm::bits_per_pixel(base_format)) / 8;
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(pixels);
+    current_export->mips.push_back({ base_format, width, height, mip_index, face, pixels_per_stride, std::vector<uint8_t>(src, src + mip_size) });
+    current_export->memory_size += mip_size;
+}
+
+// called by an export worker, returns false if the texture could not be written
+static bool write_exported_texture(const ExportedTexture &exported) {
+    if (exported.save_as_png)
+        return !exported.mips.empty() && export_mip(exported, exported.mips.front(), nullptr);
+
+    const std::string file_name = fmt::format("{:016X}.dds", exported.hash);
+    fs::ofstream output_file(exported.export_folder / file_name, std::ios_base::binary | std::ios_base::trunc);
+    if (!output_file.is_open()) {
+        LOG_ERROR("Failed to open file {} for writing", file_name);
         return false;
     }
 
-    SceGxmTexture &gxm_texture = current_info->texture;
-    const SceGxmTextureBaseFormat format = gxm::get_base_format(gxm::get_format(gxm_texture));
-    uint32_t nb_comp = gxm::get_num_components(format);
+    output_file.write(reinterpret_cast<const char *>(exported.file_header.data()), exported.file_header.size());
+    for (const auto &mip : exported.mips) {
+        if (!export_mip(exported, mip, &output_file))
+            return false;
+    }
 
-    const bool is_cube = gxm_texture.texture_type() == SCE_GXM_TEXTURE_CUBE || gxm_texture.texture_type() == SCE_GXM_TEXTURE_CUBE_ARBITRARY;
-    if (is_cube && !loading_texture.is_dds) {
-        LOG_ERROR("Trying to import cubemap as png {}", file_name);
+    if (!output_file.good()) {
+        LOG_ERROR("Failed to write texture {}", file_name);
         return false;
     }
 
-    // with 3-component or 4-component textures with a specific swizzle, upload them as 4 component
-    // (rgb8 textures are not that much supported on modern gpus)
-    bool alpha_is_1 = (nb_comp == 3) || (nb_comp == 4 && (gxm_texture.swizzle_format & 0b100));
-    if (nb_comp == 3)
-        nb_comp = 4;
+    return true;
+}
+
+void TextureCache::export_done() {
+    if (!exporting_texture)
+        return;
+
+    exporting_texture = false;
+    std::shared_ptr<ExportedTexture> exported = std::move(current_export);
+    if (exported->mips.empty())
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(export_mutex);
+        // the textures are marked as exported right away so they are not copied again while being written
+        exported_textures_hash.insert(exported->hash);
+
+        // the renderer waits for the workers once the copied textures use too much memory
+        // a texture larger than the budget on its own is still exported once nothing else is pending
+        export_cond.wait(lock, [&] { return (export_memory_used == 0) || (export_memory_used + exported->memory_size <= ExportMemoryBudget); });
+        export_memory_used += exported->memory_size;
+    }
+
+    if (export_workers.empty()) {
+        // encoding png files is slow, but keep some cores for the emulated cpu and the renderer
+        const uint32_t nb_workers = std::clamp(std::thread::hardware_concurrency() / 4, 1U, 4U);
+        for (uint32_t i = 0; i < nb_workers; i++) {
+            export_workers.emplace_back([this]() {
+                while (auto job = export_queue.pop())
+                    (*job)();
+            });
+        }
+    }
 
-    uint32_t width, height;
+    export_queue.push([this, exported]() {
+        const bool written = write_exported_texture(*exported);
+
+        const std::lock_guard<std::mutex> lock(export_mutex);
+        // it is tried again the next time the texture is uploaded
+        if (!written)
+            exported_textures_hash.erase(exported->hash);
+        export_memory_used -= exported->memory_size;
+        export_cond.notify_all();
+    });
+}
+
+struct ImportedTexture {
+    // set by the import worker once all the other fields have been filled
+    std::atomic<bool> loaded = false;
+    // false if the replacement texture could not be loaded
+    bool valid = false;
+
+    std::string file_name;
+    bool is_dds = false;
+    // mapping of the dds file (or of the texture pack containing it), pixels point inside it
+    std::shared_ptr<MappedFile> mapping;
+    ddspp::Descriptor dds_descriptor = {};
+    // pixels decoded by stb_image for png files
+    const uint8_t *pixels = nullptr;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
     uint16_t mipcount = 1;
+    // number of components png files are decoded to
+    uint32_t nb_comp = 0;
     SceGxmTextureBaseFormat base_format;
     bool is_srgb = false;
     bool swap_rb = false;
-    if (loading_texture.is_dds) {
-        if (dds_descriptor == nullptr)
-            dds_descriptor = new ddspp::Descriptor;
-
-        fs::ifstream file(import_name, std::ios_base::binary | std::ios_base::ate);
-        const size_t file_size = file.tellg();
-        imported_texture_raw_data.resize(std::max<size_t>(ddspp::MAX_HEADER_SIZE, file_size));
-
-        file.seekg(0);
-        file.read(reinterpret_cast<char *>(imported_texture_raw_data.data()), file_size);
-        if (file.gcount() != file_size) {
-            LOG_ERROR("Failed to read {}", file_name);
-            return false;
-        }
-        file.close();
 
-        if (ddspp::decode_header(imported_texture_raw_data.data(), *dds_descriptor) != ddspp::Success) {
-            LOG_ERROR("Failed to decode file {} header", file_name);
-            return false;
+    ~ImportedTexture() {
+        if (!is_dds && pixels)
+            stbi_image_free(const_cast<uint8_t *>(pixels));
+    }
+};
+
+// Layout of a texture pack, a single file containing all the replacement textures of a game
+// this avoids listing and opening thousands of files, all the values are little-endian
+// - header: magic "VTPK", format version (u32), number of entries (u32), padding (u32)
+// - entries: hash (u64), offset of the file from the start of the pack (u64), size of the file (u64), is_dds (u32), padding (u32)
+// - the content of the dds/png files, at the offsets given by the entries
+static constexpr char texture_pack_magic[4] = { 'V', 'T', 'P', 'K' };
+// increase this value when the format of the pack changes
+static constexpr uint32_t texture_pack_version = 1;
+static constexpr const char *texture_pack_extension = ".vtpack";
+
+struct TexturePackHeader {
+    char magic[4];
+    uint32_t format_version;
+    uint32_t entry_count;
+    uint32_t padding;
+};
+
+struct TexturePackEntry {
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t is_dds;
+    uint32_t padding;
+};
+
+static_assert(sizeof(TexturePackHeader) == 16);
+static_assert(sizeof(TexturePackEntry) == 32);
+
+static bool is_cube_texture(const SceGxmTexture &texture) {
+    return texture.texture_type() == SCE_GXM_TEXTURE_CUBE || texture.texture_type() == SCE_GXM_TEXTURE_CUBE_ARBITRARY;
+}
+
+// number of components the replacement texture is uploaded with
+static uint32_t get_import_nb_comp(const SceGxmTexture &texture) {
+    const uint32_t nb_comp = gxm::get_num_components(gxm::get_base_format(gxm::get_format(texture)));
+    // rgb8 textures are not that much supported on modern gpus, upload them as 4 component
+    return (nb_comp == 3) ? 4 : nb_comp;
+}
+
+// called by an import worker, the content of the dds files is never copied, only mapped
+static void load_imported_texture(ImportedTexture &imported, const AvailableTexture &available, uint64_t hash, const SceGxmTexture &texture) {
+    imported.file_name = fmt::format("{:016X}.{}", hash, available.is_dds ? "dds" : "png");
+    imported.is_dds = available.is_dds;
+
+    const uint8_t *file_data = nullptr;
+    size_t file_size = 0;
+    if (available.pack) {
+        imported.mapping = available.pack;
+        file_data = available.pack->data() + available.pack_offset;
+        file_size = available.pack_size;
+    } else if (available.is_dds) {
+        imported.mapping = std::make_shared<MappedFile>();
+        if (!imported.mapping->open(*available.folder_path / imported.file_name)) {
+            LOG_ERROR("Texture {} was listed as available but could not be opened", imported.file_name);
+            return;
         }
+        file_data = imported.mapping->data();
+        file_size = imported.mapping->size();
+    }
 
-        if ((dds_descriptor->type == ddspp::Cubemap) != is_cube) {
-            if (is_cube)
-                LOG_ERROR("Texture {} should be a cubemap but is a 2D texture", file_name);
-            else
-                LOG_ERROR("Texture {} should be a 2D texture but is cubemap", file_name);
-            return false;
+    if (is_cube_texture(texture) && !available.is_dds) {
+        LOG_ERROR("Trying to import cubemap as png {}", imported.file_name);
+        return;
+    }
+
+    if (available.is_dds) {
+        // decode_header may read up to MAX_HEADER_SIZE bytes, do not read past the end of small files
+        std::array<uint8_t, ddspp::MAX_HEADER_SIZE> header = {};
+        memcpy(header.data(), file_data, std::min<size_t>(header.size(), file_size));
+        ddspp::Descriptor &descriptor = imported.dds_descriptor;
+        if (ddspp::decode_header(header.data(), descriptor) != ddspp::Success) {
+            LOG_ERROR("Failed to decode file {} header", imported.file_name);
+            return;
         }
 
-        width = dds_descriptor->width;
-        height = dds_descriptor->height;
-        mipcount = dds_descriptor->numMips;
-        base_format = dxgi_to_gxm(dds_descriptor->format);
-        if (base_format == static_cast<SceGxmTextureBaseFormat>(-1)) {
-            LOG_ERROR("dds format {} used by texture {} is unhandled", fmt::underlying(dds_descriptor->format), file_name);
-            return false;
+        const uint32_t slice_count = (descriptor.type == ddspp::Cubemap) ? 6 : 1;
+        if (descriptor.headerSize + static_cast<size_t>(ddspp::get_offset(descriptor, descriptor.numMips, slice_count - 1)) > file_size) {
+            LOG_ERROR("Texture {} is truncated", imported.file_name);
+            return;
         }
-        is_srgb = ddspp::is_srgb(dds_descriptor->format);
-        swap_rb = dds_swap_rb(dds_descriptor->format);
 
-        imported_texture_decoded = imported_texture_raw_data.data() + dds_descriptor->headerSize;
+        imported.width = descriptor.width;
+        imported.height = descriptor.height;
+        imported.mipcount = descriptor.numMips;
+        imported.base_format = dxgi_to_gxm(descriptor.format);
+        if (imported.base_format == static_cast<SceGxmTextureBaseFormat>(-1)) {
+            LOG_ERROR("dds format {} used by texture {} is unhandled", fmt::underlying(descriptor.format), imported.file_name);
+            return;
+        }
+        imported.is_srgb = ddspp::is_srgb(descriptor.format);
+        imported.swap_rb = dds_swap_rb(descriptor.format);
+        imported.pixels = file_data + descriptor.headerSize;
     } else {
-        int nb_channels;
-        imported_texture_decoded = stbi_load(import_name.generic_string().c_str(), reinterpret_cast<int *>(&width), reinterpret_cast<int *>(&height), &nb_channels, nb_comp);
-        if (imported_texture_decoded == nullptr) {
-            LOG_ERROR("Failed to decode {}", file_name);
-            return false;
+        imported.nb_comp = get_import_nb_comp(texture);
+        int width, height, nb_channels;
+        if (available.pack)
+            imported.pixels = stbi_load_from_memory(file_data, static_cast<int>(file_size), &width, &height, &nb_channels, imported.nb_comp);
+        else
+            imported.pixels = stbi_load((*available.folder_path / imported.file_name).generic_string().c_str(), &width, &height, &nb_channels, imported.nb_comp);
+        if (imported.pixels == nullptr) {
+            LOG_ERROR("Failed to decode {}", imported.file_name);
+            return;
         }
 
-        if (nb_comp >= 3 && nb_channels <= 2) {
-            LOG_ERROR("Texture {} has {} channels, expected {}", file_name, nb_channels, nb_comp);
-            stbi_image_free(imported_texture_decoded);
-            return false;
+        if (imported.nb_comp >= 3 && nb_channels <= 2) {
+            LOG_ERROR("Texture {} has {} channels, expected {}", imported.file_name, nb_channels, imported.nb_comp);
+            return;
         }
 
-        if (nb_comp == 1)
-            base_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8;
-        else if (nb_comp == 2)
-            base_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8;
+        imported.width = width;
+        imported.height = height;
+        if (imported.nb_comp == 1)
+            imported.base_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8;
+        else if (imported.nb_comp == 2)
+            imported.base_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8;
         else
-            base_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
+            imported.base_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
+    }
+
+    imported.valid = true;
+}
+
+TextureCache::~TextureCache() {
+    // the textures waiting to be exported are still written
+    {
+        std::unique_lock<std::mutex> lock(export_mutex);
+        export_cond.wait(lock, [&] { return export_memory_used == 0; });
+    }
+    export_queue.abort();
+    for (auto &worker : export_workers)
+        worker.join();
+
+    import_queue.abort();
+    for (auto &worker : import_workers)
+        worker.join();
+
+    decode_queue.abort();
+    for (auto &worker : decode_workers)
+        worker.join();
+}
+
+bool TextureCache::retrieve_imported_texture(uint64_t hash, const AvailableTexture &available, const SceGxmTexture &texture) {
+    auto it = imported_textures.find(hash);
+    if (it == imported_textures.end()) {
+        if (import_workers.empty()) {
+            // decoding png files is slow, but keep some cores for the emulated cpu and the renderer
+            const uint32_t nb_workers = std::clamp(std::thread::hardware_concurrency() / 4, 1U, 4U);
+            for (uint32_t i = 0; i < nb_workers; i++) {
+                import_workers.emplace_back([this]() {
+                    while (auto job = import_queue.pop())
+                        (*job)();
+                });
+            }
+        }
+
+        auto imported = std::make_shared<ImportedTexture>();
+        imported_textures[hash] = imported;
+        import_queue.push([imported, available, hash, texture]() {
+            load_imported_texture(*imported, available, hash, texture);
+            imported->loaded.store(true, std::memory_order_release);
+        });
+        return false;
+    }
+
+    if (!it->second->loaded.load(std::memory_order_acquire))
+        return false;
+
+    current_import = it->second;
+    return true;
+}
+
+bool TextureCache::is_imported_texture_loaded(uint64_t hash) const {
+    auto it = imported_textures.find(hash);
+    return it != imported_textures.end() && it->second->loaded.load(std::memory_order_acquire);
+}
+
+bool TextureCache::import_configure_texture() {
+    // failed loads are kept in imported_textures so that they are not tried again for each upload
+    const ImportedTexture &imported = *current_import;
+    if (!imported.valid)
+        return false;
+
+    const SceGxmTexture &gxm_texture = current_info->texture;
+    const uint32_t nb_comp = get_import_nb_comp(gxm_texture);
+    const bool is_cube = is_cube_texture(gxm_texture);
+    if (imported.is_dds) {
+        if ((imported.dds_descriptor.type == ddspp::Cubemap) != is_cube) {
+            if (is_cube)
+                LOG_ERROR("Texture {} should be a cubemap but is a 2D texture", imported.file_name);
+            else
+                LOG_ERROR("Texture {} should be a 2D texture but is cubemap", imported.file_name);
+            return false;
+        }
+    } else if (is_cube || imported.nb_comp != nb_comp) {
+        // the same data was used with a texture with a different format
+        LOG_ERROR("Texture {} does not match the format of the original texture", imported.file_name);
+        return false;
     }
 
     if (log_texture_import)
-        LOG_DEBUG("Importing texture {} ({}x{})", file_name, width, height);
+        LOG_DEBUG("Importing texture {} ({}x{})", imported.file_name, imported.width, imported.height);
 
     if (current_info->is_imported
-        && current_info->width == width
-        && current_info->height == height
+        && current_info->width == imported.width
+        && current_info->height == imported.height
         && current_info->mip_count == 1
-        && current_info->format == base_format
-        && current_info->is_srgb == is_srgb) {
+        && current_info->format == imported.base_format
+        && current_info->is_srgb == imported.is_srgb) {
         // no parameter was changed, no need to reconfigure the texture
         return true;
     }
 
     current_info->is_imported = true;
-    current_info->width = width;
-    current_info->height = height;
-    current_info->mip_count = mipcount;
-    current_info->format = base_format;
-    current_info->is_srgb = is_srgb;
+    current_info->width = imported.width;
+    current_info->height = imported.height;
+    current_info->mip_count = imported.mipcount;
+    current_info->format = imported.base_format;
+    current_info->is_srgb = imported.is_srgb;
 
-    import_configure_impl(base_format, width, height, is_srgb, nb_comp, mipcount, swap_rb);
+    import_configure_impl(imported.base_format, imported.width, imported.height, imported.is_srgb, nb_comp, imported.mipcount, imported.swap_rb);
     return true;
 }
 
 void TextureCache::import_upload_texture() {
-    if (loading_texture.is_dds) {
+    const ImportedTexture &imported = *current_import;
+    if (imported.is_dds) {
         auto [block_width, _] = gxm::get_block_size(current_info->format);
         const uint32_t mipcount = current_info->mip_count;
-        const bool is_cube = current_info->texture.texture_type() == SCE_GXM_TEXTURE_CUBE || current_info->texture.texture_type() == SCE_GXM_TEXTURE_CUBE_ARBITRARY;
+        const bool is_cube = is_cube_texture(current_info->texture);
 
         // upload each face one by one
         for (uint32_t face = 0; face < (is_cube ? 6 : 1); face++) {
@@ -544,7 +783,8 @@ void TextureCache::import_upload_texture() {
             uint32_t height = current_info->height;
             // upload each mip one by one
             for (uint32_t mip = 0; mip < mipcount; mip++) {
-                const uint8_t *mip_data = imported_texture_decoded + ddspp::get_offset(*dds_descriptor, mip, face);
+                // the mips are read from the file mapping and copied directly to the staging buffer
+                const uint8_t *mip_data = imported.pixels + ddspp::get_offset(imported.dds_descriptor, mip, face);
                 // dds textures are tightly packed (up to the block size)
                 upload_texture_impl(current_info->format, width, height, mip, mip_data, is_cube + face, align(width, block_width));
 
@@ -555,19 +795,57 @@ void TextureCache::import_upload_texture() {
         }
     } else {
         // just upload the first mip and we are done (png does not support multiple mips / cubemaps)
-        upload_texture_impl(current_info->format, current_info->width, current_info->height, 0, imported_texture_decoded, 0, current_info->width);
+        upload_texture_impl(current_info->format, current_info->width, current_info->height, 0, imported.pixels, 0, current_info->width);
     }
 }
 
 void TextureCache::import_done() {
-    if (loading_texture.is_dds) {
-        imported_texture_raw_data.clear();
-        imported_texture_decoded = nullptr;
-    } else {
-        if (imported_texture_decoded) {
-            stbi_image_free(imported_texture_decoded);
-            imported_texture_decoded = nullptr;
+    // the texture is now on the GPU, release the decoded pixels and the file mapping
+    imported_textures.erase(current_info->hash);
+    current_import = nullptr;
+}
+
+// add the content of the texture pack to the available textures, the textures already found are kept
+static void read_texture_pack(const fs::path &pack_path, unordered_map_fast<uint64_t, AvailableTexture> &available_textures_hash) {
+    auto pack = std::make_shared<MappedFile>();
+    if (!pack->open(pack_path))
+        return;
+
+    TexturePackHeader header;
+    if (pack->size() < sizeof(header)) {
+        LOG_ERROR("Texture pack {} is too small", pack_path.string());
+        return;
+    }
+    memcpy(&header, pack->data(), sizeof(header));
+    if (memcmp(header.magic, texture_pack_magic, sizeof(texture_pack_magic)) != 0 || header.format_version != texture_pack_version) {
+        LOG_ERROR("Texture pack {} has an invalid header", pack_path.string());
+        return;
+    }
+    if (sizeof(header) + static_cast<uint64_t>(header.entry_count) * sizeof(TexturePackEntry) > pack->size()) {
+        LOG_ERROR("Texture pack {} is truncated", pack_path.string());
+        return;
+    }
+
+    available_textures_hash.reserve(available_textures_hash.size() + header.entry_count);
+    const uint8_t *entries = pack->data() + sizeof(header);
+    for (uint32_t i = 0; i < header.entry_count; i++) {
+        TexturePackEntry entry;
+        memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+        if (entry.offset > pack->size() || entry.size > pack->size() - entry.offset) {
+            LOG_ERROR("Texture {:016X} of pack {} is out of bounds", entry.hash, pack_path.string());
+            continue;
         }
+
+        // loose files have the priority over the pack content
+        if (available_textures_hash.contains(entry.hash))
+            continue;
+
+        available_textures_hash[entry.hash] = {
+            .is_dds = entry.is_dds != 0,
+            .pack = pack,
+            .pack_offset = entry.offset,
+            .pack_size = entry.size
+        };
     }
 }
 
@@ -598,6 +876,9 @@ void TextureCache::refresh_available_textures() {
         }
     };
 
+    // the textures still being written are found in the folder once they are done
+    std::unique_lock<std::mutex> export_lock(export_mutex);
+    export_cond.wait(export_lock, [&] { return export_memory_used == 0; });
     exported_textures_hash.clear();
     if (export_textures) {
         look_through_folder(export_folder, [&](uint64_t hash, const fs::path &file, bool is_dds) {
@@ -612,8 +893,12 @@ void TextureCache::refresh_available_textures() {
         if (!exported_textures_hash.empty())
             LOG_INFO("Found {} textures already exported", exported_textures_hash.size());
     }
+    export_lock.unlock();
 
     available_textures_hash.clear();
+    // the textures which were loaded may not be the right ones anymore
+    imported_textures.clear();
+    current_import = nullptr;
     if (import_textures) {
         // to reduce memory, reuse the same path for multiple textures in the same folder
         std::map<fs::path, std::shared_ptr<fs::path>> found_folders;
@@ -634,6 +919,11 @@ void TextureCache::refresh_available_textures() {
             }
         });
 
+        // the texture pack is next to the import folder of the game: import/<game_id>.vtpack
+        fs::path pack_path = import_folder;
+        pack_path += texture_pack_extension;
+        read_texture_pack(pack_path, available_textures_hash);
+
         if (!available_textures_hash.empty())
             LOG_INFO("Found {} textures ready to be imported", available_textures_hash.size());
     }
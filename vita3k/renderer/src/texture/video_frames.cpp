@@ -0,0 +1,65 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/video_frames.h>
+
+#include <iterator>
+
+namespace renderer {
+
+void VideoFrameTracker::frame_written(Address address, uint32_t size) {
+    const std::lock_guard<std::mutex> lock(mutex);
+
+    // a buffer overlapping the new one is no longer used for the frames
+    auto it = buffers.upper_bound(address);
+    if (it != buffers.begin() && std::prev(it)->first + std::prev(it)->second.size > address)
+        --it;
+    while (it != buffers.end() && it->first < address + size) {
+        if (it->first == address && it->second.size == size)
+            ++it;
+        else
+            it = buffers.erase(it);
+    }
+
+    if (buffers.size() >= MAX_BUFFERS && !buffers.contains(address)) {
+        // forget the buffer which has not been written for the longest time
+        auto oldest = buffers.begin();
+        for (auto buffer = buffers.begin(); buffer != buffers.end(); ++buffer) {
+            if (buffer->second.generation < oldest->second.generation)
+                oldest = buffer;
+        }
+        buffers.erase(oldest);
+    }
+
+    buffers[address] = { size, next_generation++ };
+}
+
+uint64_t VideoFrameTracker::get_generation(Address address, uint32_t size) {
+    const std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = buffers.upper_bound(address);
+    if (it == buffers.begin())
+        return 0;
+    --it;
+
+    if (address + size > it->first + it->second.size)
+        return 0;
+
+    return it->second.generation;
+}
+
+} // namespace renderer
@@ -28,7 +28,7 @@
 
 namespace renderer::vulkan {
 
-void VKContext::wait_thread_function(const MemState &mem) {
+void VKContext::wait_thread_function(MemState &mem) {
     // try to wait for multiple fences at the same time if possible
     std::vector<vk::Fence> fences;
 
@@ -45,6 +45,14 @@ void VKContext::wait_thread_function(const MemState &mem) {
         }
     };
 
+    // with timeline semaphores, each request tells which value it waits for
+    auto wait_for_submissions = [&](uint64_t timeline_value) {
+        if (timeline_semaphore)
+            wait_for_submission(nullptr, timeline_value);
+        else
+            wait_for_fences();
+    };
+
     while (true) {
         auto wait_request = request_queue.pop();
 
@@ -57,7 +65,7 @@ void VKContext::wait_thread_function(const MemState &mem) {
                        },
                        [&](NotificationRequest &request) {
                            if (request.notifications[0].address || request.notifications[1].address) {
-                               wait_for_fences();
+                               wait_for_submissions(request.timeline_value);
 
                                // same as in handle_sync_surface_data
                                std::unique_lock<std::mutex> lock(state.notification_mutex);
@@ -83,7 +91,7 @@ void VKContext::wait_thread_function(const MemState &mem) {
                            new_frame_condv.notify_one();
                        },
                        [&](PostSurfaceSyncRequest &request) {
-                           wait_for_fences();
+                           wait_for_submissions(request.timeline_value);
 
                            state.surface_cache.perform_post_surface_sync(mem, request.cache_info);
                        } },
@@ -117,6 +125,8 @@ void set_context(VKContext &context, MemState &mem, VKRenderTarget *rt, const Fe
         context.record.color_base_format = SCE_GXM_COLOR_BASE_FORMAT_U8U8U8U8;
     }
     context.current_color_format = vk_format;
+    // the render target color is only bound for the framebuffer, nothing reads what is drawn to it
+    context.discard_color = color_surface_fin == nullptr;
 
     if (rt->multisample_mode && !context.record.color_surface.downscale) {
         // using MSAA without downscaling, emulate this as best as we can by multiplying the width and height of the render target by 2
@@ -144,7 +154,7 @@ void set_context(VKContext &context, MemState &mem, VKRenderTarget *rt, const Fe
     if (context.state.features.support_shader_interlock)
         // we must always store the depth stencil
         force_store = true;
-    context.current_render_pass = context.state.pipeline_cache.retrieve_render_pass(vk_format, force_load, force_store);
+    context.select_render_pass(force_load, force_store);
     if (context.state.features.support_shader_interlock)
         // also retrieve / create the shader interlock pass
         context.current_shader_interlock_pass = context.state.pipeline_cache.retrieve_render_pass(vk_format, true, true, true);
@@ -203,12 +213,14 @@ void VKContext::start_recording() {
         cmd_buffer_info.commandPool = frame().prerender_pool;
         render_target->pre_cmd_buffers[current_frame_idx].push_back(state.device.allocateCommandBuffers(cmd_buffer_info)[0]);
 
-        vk::FenceCreateInfo fence_info{};
-        // make sure the next fence used is the one we created
-        render_target->fences.insert(render_target->fences.begin() + render_target->fence_idx, state.device.createFence(fence_info));
+        if (!timeline_semaphore) {
+            vk::FenceCreateInfo fence_info{};
+            // make sure the next fence used is the one we created
+            render_target->fences.insert(render_target->fences.begin() + render_target->fence_idx, state.device.createFence(fence_info));
+        }
     }
 
-    if (next_fence == nullptr) {
+    if (!timeline_semaphore && next_fence == nullptr) {
         next_fence = render_target->fences[render_target->fence_idx];
         // only increase the fence index if we used the previous one
         render_target->fence_idx = (render_target->fence_idx + 1) % render_target->fences.size();
@@ -224,7 +236,26 @@ void VKContext::start_recording() {
     render_cmd.begin(begin_info);
     prerender_cmd.begin(begin_info);
 
+    FrameObject &current_frame = frame();
+    if (current_frame.timestamp_pool && current_frame.timestamp_count + 2 <= MAX_FRAME_TIMESTAMPS) {
+        // the prerender cmd of the first scene is submitted first in the frame, it resets the whole pool
+        if (current_frame.timestamp_count == 0)
+            prerender_cmd.resetQueryPool(current_frame.timestamp_pool, 0, MAX_FRAME_TIMESTAMPS);
+
+        // the end timestamp is written by the render cmd
+        const uint32_t timestamp_idx = current_frame.timestamp_count++;
+        prerender_cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, current_frame.timestamp_pool, timestamp_idx);
+        current_frame.scene_timestamps.push_back({
+            .color_address = record.color_surface.data.address(),
+            .width = record.color_surface.width,
+            .height = record.color_surface.height,
+            .begin_idx = timestamp_idx,
+        });
+        is_timing_scene = true;
+    }
+
     is_recording = true;
+    render_info_pushed = false;
 
     // set all the dynamic state here
     render_cmd.setViewport(0, viewport);
@@ -235,6 +266,21 @@ void VKContext::start_recording() {
     if (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED) {
         sync_stencil_func(*this, true);
     }
+    if (state.pipeline_cache.use_extended_dynamic_state) {
+        // the primitive topology is set when the pipeline is bound
+        sync_stencil_op(*this);
+        sync_cull(*this);
+        sync_depth_func(*this);
+        sync_depth_write_enable(*this);
+    }
+}
+
+void VKContext::select_render_pass(bool force_load, bool force_store) {
+    current_render_pass = state.pipeline_cache.retrieve_render_pass(current_color_format, force_load, force_store, false, discard_color);
+
+    // the depth-stencil is cleared instead of being loaded when it is not force loaded
+    current_pass_elided_loads = (discard_color ? 1 : 0) + (force_load ? 0 : 1);
+    current_pass_elided_stores = (discard_color ? 1 : 0) + (force_store ? 0 : 1);
 }
 
 void VKContext::start_render_pass(bool create_descriptor_set) {
@@ -273,7 +319,18 @@ void VKContext::start_render_pass(bool create_descriptor_set) {
         .stencil = record.depth_stencil_surface.stencil
     };
     curr_renderpass_info.setClearValues(curr_clear_values);
+
+    // keep room for the end of the render pass and of the scene
+    FrameObject &current_frame = frame();
+    if (is_timing_scene && current_frame.timestamp_count + 3 <= MAX_FRAME_TIMESTAMPS) {
+        render_cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, current_frame.timestamp_pool, current_frame.timestamp_count++);
+        is_timing_render_pass = true;
+    }
+
     render_cmd.beginRenderPass(curr_renderpass_info, vk::SubpassContents::eInline);
+    frame_render_pass_count++;
+    frame_elided_load_count += current_pass_elided_loads;
+    frame_elided_store_count += current_pass_elided_stores;
 
     // set the renderpass info ready in case we need to switch between classic and framebuffer fetch usage
     curr_renderpass_info.setClearValues(nullptr);
@@ -331,6 +388,8 @@ void VKContext::stop_render_pass() {
         return;
     }
 
+    flush_pending_draws();
+
     // do this before ending the render pass
     if (is_in_query) {
         render_cmd.endQuery(current_visibility_buffer->query_pool, current_query_idx);
@@ -339,6 +398,12 @@ void VKContext::stop_render_pass() {
 
     render_cmd.endRenderPass();
 
+    if (is_timing_render_pass) {
+        FrameObject &current_frame = frame();
+        render_cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, current_frame.timestamp_pool, current_frame.timestamp_count++);
+        is_timing_render_pass = false;
+    }
+
     in_renderpass = false;
 }
 
@@ -352,45 +417,43 @@ void VKContext::stop_recording(const SceGxmNotification &notif1, const SceGxmNot
         stop_render_pass();
 
     if (visibility_max_used_idx != -1) {
-        // get all the entry ranges that were used
-        struct VisibilityRange {
-            uint32_t offset;
-            uint32_t size;
-        };
-        std::vector<VisibilityRange> ranges;
-        bool in_range = false;
-        uint32_t range_start = 0;
-        for (uint32_t entry = 0; entry <= visibility_max_used_idx + 1; entry++) {
-            if (current_visibility_buffer->queries_used[entry] == in_range)
-                continue;
-
-            if (in_range) {
-                ranges.push_back({ range_start, entry - range_start });
-                in_range = false;
-            } else {
-                range_start = entry;
-                in_range = true;
-            }
-        }
+        VisibilityBuffer &visibility_buffer = *current_visibility_buffer;
+        const uint32_t end = visibility_max_used_idx + 1;
+        const uint32_t first_used = visibility_buffer.find_query(0, end, true);
+
+        // reset all the queries used before the beginning of the render pass at once, the unused ones in between do not matter
+        prerender_cmd.resetQueryPool(visibility_buffer.query_pool, first_used, end - first_used);
 
-        for (auto &range : ranges) {
-            // reset before the beginning of the render pass
-            prerender_cmd.resetQueryPool(current_visibility_buffer->query_pool, range.offset, range.size);
+        // the unused queries are never available, so only the contiguous ranges of used queries can be copied
+        for (uint32_t range_start = first_used; range_start < end;) {
+            const uint32_t range_end = visibility_buffer.find_query(range_start, end, false);
 
             // wait for the range at the end
             // TODO: this will be wrong with upscaling enabled and precise mode set
-            render_cmd.copyQueryPoolResults(current_visibility_buffer->query_pool, range.offset, range.size,
-                current_visibility_buffer->gpu_buffer, current_visibility_buffer->buffer_offset + range.offset * sizeof(uint32_t),
+            render_cmd.copyQueryPoolResults(visibility_buffer.query_pool, range_start, range_end - range_start,
+                visibility_buffer.gpu_buffer, visibility_buffer.buffer_offset + range_start * sizeof(uint32_t),
                 sizeof(uint32_t), vk::QueryResultFlagBits::eWait);
+
+            range_start = visibility_buffer.find_query(range_end, end, true);
         }
+
+        // only the words holding used queries have to be cleared
+        std::fill_n(visibility_buffer.queries_used.begin() + first_used / 64, (end + 63) / 64 - first_used / 64, 0);
         visibility_max_used_idx = -1;
-        current_visibility_buffer->queries_used.assign(current_visibility_buffer->size, false);
     }
 
     ColorSurfaceCacheInfo *surface_info = nullptr;
     if (state.features.support_memory_mapping && !state.disable_surface_sync)
         surface_info = state.surface_cache.perform_surface_sync();
 
+    if (is_timing_scene) {
+        FrameObject &current_frame = frame();
+        const uint32_t timestamp_idx = current_frame.timestamp_count++;
+        render_cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, current_frame.timestamp_pool, timestamp_idx);
+        current_frame.scene_timestamps.back().end_idx = timestamp_idx;
+        is_timing_scene = false;
+    }
+
     prerender_cmd.end();
     render_cmd.end();
 
@@ -412,31 +475,149 @@ void VKContext::stop_recording(const SceGxmNotification &notif1, const SceGxmNot
     }
 
     vk::Fence fence = next_fence;
-    next_fence = nullptr;
 
     vk::SubmitInfo submit_info{};
     submit_info.setCommandBuffers(cmdbuffers_to_submit);
 
-    state.general_queue.submit(submit_info, fence);
+    // the textures uploaded on the transfer queue are acquired by the prerender cmd
+    const vk::Semaphore transfer_semaphore = state.texture_cache.submit_transfer_cmd();
+    const vk::PipelineStageFlags transfer_wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+    if (transfer_semaphore) {
+        submit_info.setWaitSemaphores(transfer_semaphore);
+        submit_info.setWaitDstStageMask(transfer_wait_stage);
+    }
+
+    submit(submit_info);
     cmdbuffers_to_submit.clear();
-    frame().rendered_fences.push_back(fence);
+    next_fence = nullptr;
+    if (timeline_semaphore)
+        frame().last_timeline_value = last_timeline_value;
+    else
+        frame().rendered_fences.push_back(fence);
 
     if (state.features.support_memory_mapping) {
         // send it to the wait queue
-        request_queue.push(FenceWaitRequest{ fence });
+        if (!timeline_semaphore)
+            request_queue.push(FenceWaitRequest{ fence });
 
         if (surface_info) {
-            request_queue.push(PostSurfaceSyncRequest{ surface_info });
+            request_queue.push(PostSurfaceSyncRequest{ surface_info, last_timeline_value });
         }
 
         // the notification must be the last thing sent
         NotificationRequest request = {
             .notifications = { notif1, notif2 },
+            .timeline_value = last_timeline_value
         };
         request_queue.push(request);
     }
 }
 
+void VKContext::submit(vk::SubmitInfo &submit_info) {
+    const ProfiledLockGuard guard(state.general_queue_mutex);
+    if (!timeline_semaphore) {
+        state.general_queue.submit(submit_info, next_fence);
+        return;
+    }
+
+    last_timeline_value++;
+    // the wait values are ignored for binary semaphores but their count must match
+    const std::vector<uint64_t> wait_values(submit_info.waitSemaphoreCount, 0);
+    vk::TimelineSemaphoreSubmitInfo timeline_info{};
+    timeline_info.setWaitSemaphoreValues(wait_values);
+    timeline_info.setSignalSemaphoreValues(last_timeline_value);
+
+    submit_info.setSignalSemaphores(timeline_semaphore);
+    submit_info.pNext = &timeline_info;
+    state.general_queue.submit(submit_info);
+}
+
+void VKContext::wait_for_submission(vk::Fence fence, uint64_t timeline_value) {
+    if (timeline_semaphore) {
+        vk::SemaphoreWaitInfo wait_info{};
+        wait_info.setSemaphores(timeline_semaphore);
+        wait_info.setValues(timeline_value);
+        if (state.device.waitSemaphoresKHR(wait_info, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+            LOG_ERROR("Could not wait for the timeline semaphore.");
+            assert(false);
+        }
+        return;
+    }
+
+    // wait for the fence, but don't reset it
+    if (state.device.waitForFences(fence, VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+        LOG_ERROR("Could not wait for fences.");
+        assert(false);
+    }
+}
+
+vk::CommandBuffer VKContext::start_transfer_recording() {
+    if (is_recording) {
+        // copies and clears can't be done in a render pass, it is restarted by the next draw
+        if (in_renderpass)
+            stop_render_pass();
+        return render_cmd;
+    }
+
+    FrameObject &current_frame = frame();
+    if (current_frame.gxm_transfer_idx == current_frame.gxm_transfer_cmds.size()) {
+        vk::CommandBufferAllocateInfo cmd_buffer_info{
+            .commandPool = current_frame.render_pool,
+            .commandBufferCount = 1
+        };
+        current_frame.gxm_transfer_cmds.push_back(state.device.allocateCommandBuffers(cmd_buffer_info)[0]);
+        if (!timeline_semaphore)
+            current_frame.gxm_transfer_fences.push_back(state.device.createFence(vk::FenceCreateInfo{}));
+    }
+
+    vk::CommandBuffer cmd_buffer = current_frame.gxm_transfer_cmds[current_frame.gxm_transfer_idx];
+    vk::CommandBufferBeginInfo begin_info{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    };
+    cmd_buffer.begin(begin_info);
+
+    return cmd_buffer;
+}
+
+void VKContext::stop_transfer_recording(vk::CommandBuffer cmd_buffer) {
+    if (cmd_buffer == render_cmd)
+        return;
+
+    cmd_buffer.end();
+
+    FrameObject &current_frame = frame();
+    vk::SubmitInfo submit_info{};
+    submit_info.setCommandBuffers(cmd_buffer);
+    // we are not recording, so next_fence is not in use
+    if (!timeline_semaphore)
+        next_fence = current_frame.gxm_transfer_fences[current_frame.gxm_transfer_idx];
+    submit(submit_info);
+    next_fence = nullptr;
+
+    if (timeline_semaphore)
+        current_frame.last_timeline_value = last_timeline_value;
+    current_frame.gxm_transfer_idx++;
+}
+
+void VKContext::flush_pending_draws() {
+    if (pending_draws.empty())
+        return;
+
+    const uint32_t draw_count = static_cast<uint32_t>(pending_draws.size());
+    if (draw_count > 1 && state.physical_device_features.multiDrawIndirect) {
+        indirect_draw_buffer.allocate(prerender_cmd, draw_count * sizeof(vk::DrawIndexedIndirectCommand), pending_draws.data());
+        render_cmd.drawIndexedIndirect(indirect_draw_buffer.handle(), indirect_draw_buffer.data_offset, draw_count, sizeof(vk::DrawIndexedIndirectCommand));
+        frame_draw_command_count++;
+    } else {
+        // without multi draw indirect, we still save the state binding between the draws
+        for (const vk::DrawIndexedIndirectCommand &draw : pending_draws)
+            render_cmd.drawIndexed(draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+        frame_draw_command_count += draw_count;
+    }
+
+    pending_draws.clear();
+}
+
 void VKContext::check_for_macroblock_change(bool is_draw) {
     if (!render_target->has_macroblock_sync)
         return;
@@ -447,7 +628,7 @@ void VKContext::check_for_macroblock_change(bool is_draw) {
         // TODO: with the feedback loop extension we can do better
         ignore_macroblock = true;
         // in this case we must load and store the depth stencil each time
-        current_render_pass = state.pipeline_cache.retrieve_render_pass(current_color_format, true, true);
+        select_render_pass(true, true);
     }
 
     // use the scissor to know in which macroblock we are
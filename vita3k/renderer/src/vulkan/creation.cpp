@@ -39,7 +39,8 @@ VKContext::VKContext(VKState &state, MemState &mem)
     , vertex_uniform_stream_ring_buffer(state.allocator, vk::BufferUsageFlagBits::eStorageBuffer, MiB(/*256*/ 64))
     , fragment_uniform_stream_ring_buffer(state.allocator, vk::BufferUsageFlagBits::eStorageBuffer, MiB(/*256*/ 64))
     , vertex_info_uniform_buffer(state.allocator, vk::BufferUsageFlagBits::eUniformBuffer, MiB(16))
-    , fragment_info_uniform_buffer(state.allocator, vk::BufferUsageFlagBits::eUniformBuffer, MiB(32)) {
+    , fragment_info_uniform_buffer(state.allocator, vk::BufferUsageFlagBits::eUniformBuffer, MiB(32))
+    , indirect_draw_buffer(state.allocator, vk::BufferUsageFlagBits::eIndirectBuffer, MiB(4)) {
     memset(&prev_vert_ublock, 0, sizeof(shader::RenderVertUniformBlock));
     memset(&prev_frag_ublock, 0, sizeof(shader::RenderFragUniformBlock));
 
@@ -56,6 +57,16 @@ VKContext::VKContext(VKState &state, MemState &mem)
     vertex_info_uniform_buffer.alignment = uniform_alignment;
     fragment_info_uniform_buffer.alignment = uniform_alignment;
 
+    if (state.support_timeline_semaphore) {
+        vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> semaphore_info{
+            {},
+            vk::SemaphoreTypeCreateInfo{
+                .semaphoreType = vk::SemaphoreType::eTimeline,
+                .initialValue = 0 }
+        };
+        timeline_semaphore = state.device.createSemaphore(semaphore_info.get());
+    }
+
     if (state.features.support_memory_mapping) {
         // use the default buffer
         std::fill_n(vertex_stream_buffers, SCE_GXM_MAX_VERTEX_STREAMS, state.default_buffer.buffer);
@@ -75,6 +86,13 @@ VKContext::VKContext(VKState &state, MemState &mem)
     vertex_info_uniform_buffer.create();
     fragment_info_uniform_buffer.create();
 
+    if (state.use_draw_batching) {
+        // the indirect draw commands only need to be aligned to 4 bytes
+        indirect_draw_buffer.alignment = sizeof(uint32_t);
+        indirect_draw_buffer.create();
+        pending_draws.reserve(MAX_BATCHED_DRAWS);
+    }
+
     // default values for the viewport and scissors
     viewport = vk::Viewport{
         .x = 0.f,
@@ -147,7 +165,8 @@ VKContext::VKContext(VKState &state, MemState &mem)
         state.device.updateDescriptorSets(nb_descriptor, write_descr.data(), 0, nullptr);
     }
 
-    for (int i = 0; i < MAX_FRAMES_RENDERING; i++) {
+    current_frame_idx = frame_timestamp % state.frames_in_flight;
+    for (int i = 0; i < state.frames_in_flight; i++) {
         FrameObject &frame = frames[i];
 
         vk::CommandPoolCreateInfo pool_info{
@@ -157,6 +176,13 @@ VKContext::VKContext(VKState &state, MemState &mem)
         frame.render_pool = state.device.createCommandPool(pool_info);
         pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
         frame.prerender_pool = state.device.createCommandPool(pool_info);
+        if (state.transfer_family_index != state.general_family_index) {
+            vk::CommandPoolCreateInfo transfer_pool_info{
+                .flags = vk::CommandPoolCreateFlagBits::eTransient,
+                .queueFamilyIndex = state.transfer_family_index
+            };
+            frame.transfer_pool = state.device.createCommandPool(transfer_pool_info);
+        }
 
         std::array<vk::DescriptorPoolSize, 3> pool_sizes = {
             vk::DescriptorPoolSize{ vk::DescriptorType::eStorageImage, 256 },
@@ -171,6 +197,14 @@ VKContext::VKContext(VKState &state, MemState &mem)
 
         frame.descriptor_pool = state.device.createDescriptorPool(descriptor_pool_info);
 
+        if (state.support_timestamp_queries) {
+            vk::QueryPoolCreateInfo query_pool_info{
+                .queryType = vk::QueryType::eTimestamp,
+                .queryCount = MAX_FRAME_TIMESTAMPS
+            };
+            frame.timestamp_pool = state.device.createQueryPool(query_pool_info);
+        }
+
         frame.destroy_queue.init(state.device, state.allocator);
     }
 }
@@ -217,19 +251,24 @@ VKRenderTarget::VKRenderTarget(VKState &state, const SceGxmRenderTargetParams &p
         cmd_buffer.clearDepthStencilImage(depthstencil.image, vk::ImageLayout::eTransferDstOptimal, clear_value, vkutil::ds_subresource_range);
         depthstencil.transition_to(cmd_buffer, vkutil::ImageLayout::DepthStencilAttachment, vkutil::ds_subresource_range);
     }
-    vkutil::end_single_time_command(state.device, state.general_queue, state.general_command_pool, cmd_buffer);
+    {
+        const ProfiledLockGuard guard(state.general_queue_mutex);
+        vkutil::end_single_time_command(state.device, state.general_queue, state.general_command_pool, cmd_buffer);
+    }
 
     constexpr uint16_t SCE_GXM_MAX_SCENES_PER_RENDERTARGET = 8;
     // hopefully this will always be enough
     const uint16_t samples_per_frame = std::min<uint16_t>(params.scenesPerFrame + 2, SCE_GXM_MAX_SCENES_PER_RENDERTARGET);
 
-    // the maximum number of fence we will ever need simultaneously is samples_per_frame * MAX_FRAMES_RENDERING
-    fences.resize(samples_per_frame * MAX_FRAMES_RENDERING);
-    vk::FenceCreateInfo fence_info{};
-    for (int i = 0; i < fences.size(); i++)
-        fences[i] = state.device.createFence(fence_info);
+    if (!state.support_timeline_semaphore) {
+        // the maximum number of fence we will ever need simultaneously is samples_per_frame * frames_in_flight
+        fences.resize(samples_per_frame * state.frames_in_flight);
+        vk::FenceCreateInfo fence_info{};
+        for (int i = 0; i < fences.size(); i++)
+            fences[i] = state.device.createFence(fence_info);
+    }
 
-    for (int i = 0; i < MAX_FRAMES_RENDERING; i++) {
+    for (int i = 0; i < state.frames_in_flight; i++) {
         vk::CommandBufferAllocateInfo buffer_info{
             .commandPool = reinterpret_cast<VKContext *>(state.context)->frames[i].render_pool,
             .commandBufferCount = static_cast<uint32_t>(samples_per_frame)
@@ -248,6 +287,16 @@ bool create(VKState &state, std::unique_ptr<Context> &context, MemState &mem) {
 }
 
 bool create(VKState &state, std::unique_ptr<RenderTarget> &rt, const SceGxmRenderTargetParams &params, const FeatureState &features) {
+    DynamicResolution &dynamic_resolution = state.dynamic_resolution;
+    if (state.use_dynamic_resolution && state.render_target_count == 0 && dynamic_resolution.desired_multiplier != state.res_multiplier) {
+        // nothing uses the previous multiplier anymore, the surfaces created with it are no longer used by the surface cache
+        LOG_INFO("Resolution multiplier changed from {} to {}", state.res_multiplier, dynamic_resolution.desired_multiplier);
+        state.res_multiplier = dynamic_resolution.desired_multiplier;
+        dynamic_resolution.average_frame_time = 0.f;
+        dynamic_resolution.stable_frames = 0;
+    }
+    state.render_target_count++;
+
     rt = std::make_unique<VKRenderTarget>(state, params);
 
     if (state.features.use_mask_bit) {
@@ -256,6 +305,7 @@ bool create(VKState &state, std::unique_ptr<RenderTarget> &rt, const SceGxmRende
         // transition it to general
         vk::CommandBuffer cmd_buffer = vkutil::create_single_time_command(state.device, state.general_command_pool);
         mask.transition_to(cmd_buffer, vkutil::ImageLayout::StorageImage);
+        const ProfiledLockGuard guard(state.general_queue_mutex);
         vkutil::end_single_time_command(state.device, state.general_queue, state.general_command_pool, cmd_buffer);
     }
     return true;
@@ -264,6 +314,7 @@ bool create(VKState &state, std::unique_ptr<RenderTarget> &rt, const SceGxmRende
 void destroy(VKState &state, std::unique_ptr<RenderTarget> &rt) {
     VKContext &context = *reinterpret_cast<VKContext *>(state.context);
     VKRenderTarget &render_target = *reinterpret_cast<VKRenderTarget *>(rt.get());
+    state.render_target_count--;
 
     // don't forget to destroy the framebuffers
     state.surface_cache.destroy_associated_framebuffers(&render_target);
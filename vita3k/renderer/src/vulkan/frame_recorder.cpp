@@ -0,0 +1,293 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <renderer/vulkan/frame_recorder.h>
+
+#include <renderer/vulkan/screen_renderer.h>
+#include <renderer/vulkan/state.h>
+
+#include <util/log.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace renderer::vulkan {
+
+// the frames are read by the CPU, the cached host memory makes it much faster
+static constexpr vma::AllocationCreateInfo vma_readback_alloc = {
+    .flags = vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped,
+    .usage = vma::MemoryUsage::eAuto,
+};
+
+FrameRecorder::FrameRecorder(ScreenRenderer &screen, RecordFrameCallback callback)
+    : screen(screen)
+    , callback(std::move(callback)) {
+}
+
+FrameRecorder::~FrameRecorder() {
+    vk::Device device = screen.state.device;
+    device.destroy(pipeline);
+    device.destroy(pipeline_layout);
+    device.destroy(descriptor_pool);
+    device.destroy(descriptor_set_layout);
+}
+
+bool FrameRecorder::init() {
+    VKState &state = screen.state;
+
+    const vk::FormatProperties format_properties = state.physical_device.getFormatProperties(screen.surface_format.format);
+    if (!screen.support_transfer_src || !(format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitSrc)) {
+        LOG_ERROR("The swapchain images cannot be copied, the gameplay cannot be recorded.");
+        return false;
+    }
+    if (!(format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear))
+        blit_filter = vk::Filter::eNearest;
+
+    // the NV12 conversion works on blocks of 4x2 pixels
+    extent = vk::Extent2D{ screen.extent.width & ~3u, screen.extent.height & ~1u };
+    if (extent.width == 0 || extent.height == 0)
+        return false;
+
+    image = vkutil::Image(state.allocator, extent.width, extent.height, vk::Format::eR8G8B8A8Unorm);
+    image.init_image(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage);
+
+    vk::ShaderModule shader = vkutil::load_shader(state.device, state.shared_path + "shaders-builtin/vulkan/frame_record.comp.spv");
+    if (!shader) {
+        LOG_WARN("Could not load frame_record.comp.spv, the recorded frames are converted on the CPU");
+        return true;
+    }
+
+    std::array<vk::DescriptorSetLayoutBinding, 2> layout_bindings = {
+        // src img
+        vk::DescriptorSetLayoutBinding{
+            .binding = 0,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute },
+        // dst buffer
+        vk::DescriptorSetLayoutBinding{
+            .binding = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute },
+    };
+    vk::DescriptorSetLayoutCreateInfo layout_create_info{};
+    layout_create_info.setBindings(layout_bindings);
+    descriptor_set_layout = state.device.createDescriptorSetLayout(layout_create_info);
+
+    std::array<vk::DescriptorPoolSize, 2> pool_sizes{
+        vk::DescriptorPoolSize{
+            .type = vk::DescriptorType::eStorageImage,
+            .descriptorCount = MAX_SLOTS },
+        vk::DescriptorPoolSize{
+            .type = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = MAX_SLOTS },
+    };
+    vk::DescriptorPoolCreateInfo pool_info{
+        .maxSets = MAX_SLOTS,
+    };
+    pool_info.setPoolSizes(pool_sizes);
+    descriptor_pool = state.device.createDescriptorPool(pool_info);
+
+    vk::DescriptorSetAllocateInfo descr_set_info{
+        .descriptorPool = descriptor_pool,
+    };
+    std::vector<vk::DescriptorSetLayout> descr_set_layouts(MAX_SLOTS, descriptor_set_layout);
+    descr_set_info.setSetLayouts(descr_set_layouts);
+    const std::vector<vk::DescriptorSet> descriptor_sets = state.device.allocateDescriptorSets(descr_set_info);
+    for (uint32_t i = 0; i < MAX_SLOTS; i++)
+        slots[i].descriptor_set = descriptor_sets[i];
+
+    vk::PushConstantRange push_constant{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset = 0,
+        .size = 2 * sizeof(uint32_t)
+    };
+    vk::PipelineLayoutCreateInfo layout_info{};
+    layout_info.setSetLayouts(descriptor_set_layout);
+    layout_info.setPushConstantRanges(push_constant);
+    pipeline_layout = state.device.createPipelineLayout(layout_info);
+
+    vk::ComputePipelineCreateInfo compute_info{
+        .stage = {
+            .stage = vk::ShaderStageFlagBits::eCompute,
+            .module = shader,
+            .pName = "main" },
+        .layout = pipeline_layout
+    };
+    auto result = state.device.createComputePipeline(nullptr, compute_info);
+    state.device.destroy(shader);
+    if (result.result != vk::Result::eSuccess) {
+        LOG_ERROR("Failed to create compute pipeline, the recorded frames are converted on the CPU");
+        return true;
+    }
+    pipeline = result.value;
+
+    return true;
+}
+
+void FrameRecorder::init_slot(Slot &slot) {
+    const vk::DeviceSize size = pipeline ? extent.width * extent.height * 3 / 2 : extent.width * extent.height * 4;
+    slot.buffer = vkutil::Buffer(screen.state.allocator, size);
+    slot.buffer.init_buffer(pipeline ? vk::BufferUsageFlagBits::eStorageBuffer : vk::BufferUsageFlagBits::eTransferDst, vma_readback_alloc);
+    if (!pipeline)
+        return;
+
+    vk::DescriptorImageInfo image_info{
+        .imageView = image.view,
+        .imageLayout = vk::ImageLayout::eGeneral
+    };
+    vk::DescriptorBufferInfo buffer_info{
+        .buffer = slot.buffer.buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE
+    };
+    std::array<vk::WriteDescriptorSet, 2> writes = {
+        vk::WriteDescriptorSet{
+            .dstSet = slot.descriptor_set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .pImageInfo = &image_info },
+        vk::WriteDescriptorSet{
+            .dstSet = slot.descriptor_set,
+            .dstBinding = 1,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &buffer_info },
+    };
+    screen.state.device.updateDescriptorSets(writes, {});
+}
+
+void FrameRecorder::record(vk::CommandBuffer cmd_buffer, uint32_t image_idx) {
+    if (image_idx >= MAX_SLOTS)
+        return;
+
+    // the frame previously copied with this swapchain image was collected when it was acquired
+    Slot &slot = slots[image_idx];
+    if (!slot.buffer.buffer)
+        init_slot(slot);
+
+    // the render pass left the swapchain image ready to be presented
+    const vk::Image swapchain_image = screen.swapchain_images[image_idx];
+    vk::ImageMemoryBarrier to_transfer{
+        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+        .oldLayout = vk::ImageLayout::ePresentSrcKHR,
+        .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = swapchain_image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, to_transfer);
+    image.transition_to_discard(cmd_buffer, vkutil::ImageLayout::TransferDst);
+
+    // scaled if the window was resized since the start of the recording
+    vk::ImageBlit blit{
+        .srcSubresource = vkutil::color_subresource_layer,
+        .srcOffsets = std::array<vk::Offset3D, 2>{
+            vk::Offset3D{ 0, 0, 0 },
+            vk::Offset3D{ static_cast<int32_t>(screen.extent.width), static_cast<int32_t>(screen.extent.height), 1 } },
+        .dstSubresource = vkutil::color_subresource_layer,
+        .dstOffsets = std::array<vk::Offset3D, 2>{
+            vk::Offset3D{ 0, 0, 0 },
+            vk::Offset3D{ static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 } }
+    };
+    cmd_buffer.blitImage(swapchain_image, vk::ImageLayout::eTransferSrcOptimal, image.image, vk::ImageLayout::eTransferDstOptimal, blit, blit_filter);
+
+    // the present waits for the semaphore signaled by the submission
+    vk::ImageMemoryBarrier to_present{
+        .srcAccessMask = vk::AccessFlagBits::eTransferRead,
+        .dstAccessMask = vk::AccessFlags(),
+        .oldLayout = vk::ImageLayout::eTransferSrcOptimal,
+        .newLayout = vk::ImageLayout::ePresentSrcKHR,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = swapchain_image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, to_present);
+
+    vk::PipelineStageFlags write_stage;
+    vk::AccessFlags write_access;
+    if (pipeline) {
+        image.transition_to(cmd_buffer, vkutil::ImageLayout::StorageImage);
+        cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout, 0, slot.descriptor_set, {});
+        const std::array<uint32_t, 2> size = { extent.width, extent.height };
+        cmd_buffer.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(size), size.data());
+        // groups of 8x8 invocations converting 4x2 pixels each
+        cmd_buffer.dispatch((extent.width / 4 + 7) / 8, (extent.height / 2 + 7) / 8, 1);
+        write_stage = vk::PipelineStageFlagBits::eComputeShader;
+        write_access = vk::AccessFlagBits::eShaderWrite;
+    } else {
+        image.transition_to(cmd_buffer, vkutil::ImageLayout::TransferSrc);
+        vk::BufferImageCopy copy{
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = vkutil::color_subresource_layer,
+            .imageOffset = { 0, 0, 0 },
+            .imageExtent = { extent.width, extent.height, 1 }
+        };
+        cmd_buffer.copyImageToBuffer(image.image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer.buffer, copy);
+        write_stage = vk::PipelineStageFlagBits::eTransfer;
+        write_access = vk::AccessFlagBits::eTransferWrite;
+    }
+
+    vk::MemoryBarrier to_host{
+        .srcAccessMask = write_access,
+        .dstAccessMask = vk::AccessFlagBits::eHostRead
+    };
+    cmd_buffer.pipelineBarrier(write_stage, vk::PipelineStageFlagBits::eHost, {}, to_host, {}, {});
+
+    slot.pending = true;
+    slot.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameRecorder::collect(bool device_idle) {
+    std::array<Slot *, MAX_SLOTS> ready;
+    size_t ready_count = 0;
+    for (uint32_t i = 0; i < MAX_SLOTS; i++) {
+        if (!slots[i].pending)
+            continue;
+        if (!device_idle && (i >= screen.fences.size() || screen.state.device.getFenceStatus(screen.fences[i]) != vk::Result::eSuccess))
+            continue;
+        ready[ready_count++] = &slots[i];
+    }
+    std::sort(ready.begin(), ready.begin() + ready_count, [](const Slot *a, const Slot *b) { return a->timestamp_ns < b->timestamp_ns; });
+
+    for (size_t i = 0; i < ready_count; i++) {
+        Slot &slot = *ready[i];
+        slot.pending = false;
+        screen.state.allocator.invalidateAllocation(slot.buffer.allocation, 0, VK_WHOLE_SIZE);
+
+        const RecordedFrame frame{
+            .nv12 = static_cast<bool>(pipeline),
+            .width = extent.width,
+            .height = extent.height,
+            .pitch = pipeline ? extent.width : extent.width * 4,
+            .data = static_cast<const uint8_t *>(slot.buffer.mapped_data),
+            .timestamp_ns = slot.timestamp_ns
+        };
+        callback(frame);
+    }
+}
+
+} // namespace renderer::vulkan
@@ -26,13 +26,22 @@
 #include <gxm/functions.h>
 #include <gxm/types.h>
 #include <renderer/shaders.h>
+#include <shader/gxp_parser.h>
 #include <shader/spirv_recompiler.h>
 
 #include <util/align.h>
 #include <util/fs.h>
 #include <util/log.h>
+#include <util/memory_accounting.h>
+
+#include <algorithm>
+#include <memory>
 
 namespace renderer::vulkan {
+// formats used by the shaders translated before their first draw
+static constexpr SceGxmColorFormat SPECULATIVE_COLOR_FORMAT = SCE_GXM_COLOR_FORMAT_U8U8U8U8_ABGR;
+static constexpr SceGxmTextureFormat SPECULATIVE_TEXTURE_FORMAT = SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR;
+
 PipelineCache::PipelineCache(VKState &state)
     : state(state) {
 }
@@ -155,16 +164,17 @@ void PipelineCache::init() {
     }
 }
 
-void PipelineCache::read_pipeline_cache() {
-    const auto shaders_path{ fs::path(state.cache_path) / "shaders" / state.title_id / state.self_name };
-    const std::string pipeline_cache_name = fmt::format("pipeline-cache-vk{}.dat", shader::CURRENT_VERSION);
-    const fs::path path = shaders_path / pipeline_cache_name;
+void PipelineCache::cleanup() {
+    compile_tasks.cancel();
+    translate_tasks.cancel();
+    // the shaders which have not been optimized yet will be the next time
+    optimize_tasks.cancel();
+}
 
+static std::vector<char> read_pipeline_cache_file(const fs::path &path) {
     fs::ifstream pipeline_cache_file(path, std::ios::in | std::ios::binary);
     if (!pipeline_cache_file.is_open())
-        return;
-
-    LOG_INFO("Found pipeline cache, reading...");
+        return {};
 
     pipeline_cache_file.seekg(0, fs::ifstream::end);
     const size_t pipeline_size = pipeline_cache_file.tellg();
@@ -172,19 +182,53 @@ void PipelineCache::read_pipeline_cache() {
 
     std::vector<char> pipeline_data(pipeline_size);
     pipeline_cache_file.read(pipeline_data.data(), pipeline_size);
-    pipeline_cache_file.close();
+    return pipeline_data;
+}
+
+void PipelineCache::read_pipeline_cache() {
+    read_pipeline_descriptions();
+
+    const auto shaders_path{ fs::path(state.cache_path) / "shaders" / state.title_id / state.self_name };
+    const std::string pipeline_cache_name = fmt::format("pipeline-cache-vk{}.dat", shader::CURRENT_VERSION);
+    const fs::path path = shaders_path / pipeline_cache_name;
+
+    const std::vector<char> pipeline_data = read_pipeline_cache_file(path);
+    if (!pipeline_data.empty()) {
+        LOG_INFO("Found pipeline cache, reading...");
+
+        vk::PipelineCacheCreateInfo cache_info{
+            .initialDataSize = pipeline_data.size(),
+            .pInitialData = pipeline_data.data()
+        };
+
+        state.device.destroyPipelineCache(pipeline_cache);
+        pipeline_cache = state.device.createPipelineCache(cache_info);
+        LOG_INFO("Pipeline cache read and loaded");
+    }
+
+    if (state.shared_cache_path.empty())
+        return;
+
+    // the pipelines from the shared cache are saved along the ones of this instance
+    const fs::path shared_path = get_shared_shaders_path(state.shared_cache_path, state.title_id, state.self_name, "vk", state.get_features_mask()) / pipeline_cache_name;
+    const std::vector<char> shared_pipeline_data = read_pipeline_cache_file(shared_path);
+    if (shared_pipeline_data.empty())
+        return;
 
     vk::PipelineCacheCreateInfo cache_info{
-        .initialDataSize = pipeline_size,
-        .pInitialData = pipeline_data.data()
+        .initialDataSize = shared_pipeline_data.size(),
+        .pInitialData = shared_pipeline_data.data()
     };
-
-    state.device.destroyPipelineCache(pipeline_cache);
-    pipeline_cache = state.device.createPipelineCache(cache_info);
-    LOG_INFO("Pipeline cache read and loaded");
+    const vk::PipelineCache shared_pipeline_cache = state.device.createPipelineCache(cache_info);
+    state.device.mergePipelineCaches(pipeline_cache, shared_pipeline_cache);
+    state.device.destroyPipelineCache(shared_pipeline_cache);
+    LOG_INFO("Shared pipeline cache merged");
 }
 
 void PipelineCache::save_pipeline_cache() {
+    save_pipeline_descriptions();
+    state.program_info_cache.save();
+
     const std::vector<uint8_t> pipeline_data = state.device.getPipelineCacheData(pipeline_cache);
     if (pipeline_data.empty())
         // No pipeline was created
@@ -194,35 +238,79 @@ void PipelineCache::save_pipeline_cache() {
     const std::string pipeline_cache_name = fmt::format("pipeline-cache-vk{}.dat", shader::CURRENT_VERSION);
     const fs::path path = shaders_path / pipeline_cache_name;
 
-    fs::ofstream pipeline_cache_file(path, std::ios::out | std::ios::binary);
-    if (!pipeline_cache_file.is_open())
-        return;
-
     LOG_INFO("Saving pipeline cache...");
 
-    pipeline_cache_file.write(reinterpret_cast<const char *>(pipeline_data.data()), pipeline_data.size());
-    pipeline_cache_file.close();
-    LOG_INFO("Pipeline cache saved");
+    // another instance using the same cache can be saving it at the same time
+    if (publish_cache_file(path, pipeline_data.data(), pipeline_data.size()))
+        LOG_INFO("Pipeline cache saved");
 }
 
 vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmProgram *program, const Sha256Hash &hash, bool is_vertex, bool maskupdate, MemState &mem, const std::vector<SceGxmVertexAttribute> *hint_attributes) {
     if (maskupdate)
         LOG_CRITICAL("Mask not implemented in the vulkan renderer!");
 
-    auto it = shaders.find(hash);
+    // update shader hints
+    current_context->shader_hints.color_format = current_context->record.color_surface.colorFormat;
+    current_context->shader_hints.attributes = hint_attributes;
+
+    vk::PipelineShaderStageCreateInfo shader_stage_info{
+        .stage = is_vertex ? vk::ShaderStageFlagBits::eVertex : vk::ShaderStageFlagBits::eFragment,
+        .pName = is_vertex ? "main_vs" : "main_fs"
+    };
+
+    // set if the shader translated by a worker used the wrong hints
+    bool translate_again = false;
+    {
+        std::unique_lock<std::mutex> lock(shaders_mutex);
+        auto pending = pending_shaders.find(hash);
+        if (pending != pending_shaders.end()) {
+            if (pending->second) {
+                // a worker is translating it, this is faster than starting over
+                shaders_cond.wait(lock, [&] { return !pending_shaders.contains(hash); });
+            } else {
+                // not started yet, the worker will skip it
+                pending_shaders.erase(pending);
+            }
+        }
+
+        auto it = shaders.find(hash);
+        if (it != shaders.end()) {
+            const auto speculative = speculative_shaders.find(hash);
+            if (speculative == speculative_shaders.end()) {
+                shader_stage_info.module = it->second;
+                return shader_stage_info;
+            }
+
+            // the texture formats and the color format were guessed, all the rest is known when the program is created
+            // the translation only depends on the component type and count of the textures
+            const shader::Hints &hints = current_context->shader_hints;
+            bool hints_match = gxm::get_base_format(hints.color_format) == gxm::get_base_format(SPECULATIVE_COLOR_FORMAT);
+            const SceGxmTextureFormat *texture_formats = is_vertex ? hints.vertex_textures : hints.fragment_textures;
+            for (size_t i = 0; i < SCE_GXM_MAX_TEXTURE_UNITS && hints_match; i++) {
+                if (speculative->second.textures_used[i])
+                    hints_match = shader::get_texture_component_type(texture_formats[i]) == shader::get_texture_component_type(SPECULATIVE_TEXTURE_FORMAT)
+                        && shader::get_texture_component_count(texture_formats[i]) == shader::get_texture_component_count(SPECULATIVE_TEXTURE_FORMAT);
+            }
+            speculative_shaders.erase(speculative);
 
-    if (it == shaders.end()) {
-        // look if it is in the cache
-        if (precompile_shader(hash))
-            it = shaders.find(hash);
+            if (hints_match) {
+                shader_stage_info.module = it->second;
+                lock.unlock();
+                on_shader_translated(hash, is_vertex);
+                return shader_stage_info;
+            }
+
+            // it has not been used by any pipeline yet
+            state.device.destroyShaderModule(it->second);
+            shaders.erase(it);
+            translate_again = true;
+        }
     }
 
-    if (it != shaders.end()) {
-        vk::PipelineShaderStageCreateInfo shader_stage_info{
-            .stage = is_vertex ? vk::ShaderStageFlagBits::eVertex : vk::ShaderStageFlagBits::eFragment,
-            .module = it->second,
-            .pName = is_vertex ? "main_vs" : "main_fs"
-        };
+    // look if it is in the cache
+    if (!translate_again && precompile_shader(hash)) {
+        const std::lock_guard<std::mutex> lock(shaders_mutex);
+        shader_stage_info.module = shaders[hash];
         return shader_stage_info;
     }
 
@@ -234,11 +322,8 @@ vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmPro
     LOG_INFO("Generating vulkan spv shader {}", hash_text.data());
     const std::string shader_version = fmt::format("vk{}", shader::CURRENT_VERSION);
 
-    // update shader hints
-    current_context->shader_hints.color_format = current_context->record.color_surface.colorFormat;
-    current_context->shader_hints.attributes = hint_attributes;
-
-    shader::usse::SpirvCode source = load_spirv_shader(*program, state.features, true, current_context->shader_hints, maskupdate, state.cache_path.c_str(), title_id, self_name, shader_version, true);
+    // do not read back the shader written by the worker if it used the wrong hints
+    shader::usse::SpirvCode source = load_spirv_shader(state.shader_pack, *program, state.features, true, current_context->shader_hints, maskupdate, state.cache_path.c_str(), title_id, self_name, shader_version, !translate_again);
 
     vk::ShaderModuleCreateInfo shader_info{
         .codeSize = sizeof(uint32_t) * source.size(),
@@ -246,8 +331,24 @@ vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmPro
     };
 
     vk::ShaderModule shader = current_context->state.device.createShaderModule(shader_info);
-    shaders[hash] = shader;
+    {
+        const std::lock_guard<std::mutex> lock(shaders_mutex);
+        shaders[hash] = shader;
+    }
+    // the driver does not tell how much it uses, the size of the spir-v is a lower bound
+    add_memory_usage(MemoryCategory::Pipelines, shader_info.codeSize);
+
+    if (optimize_shaders)
+        queue_shader_optimization(hash, source);
+
+    on_shader_translated(hash, is_vertex);
+    state.shader_translation_count.fetch_add(1, std::memory_order_relaxed);
 
+    shader_stage_info.module = shader;
+    return shader_stage_info;
+}
+
+void PipelineCache::on_shader_translated(const Sha256Hash &hash, bool is_vertex) {
     // Save shader cache haches
     // vertex and fragment shaders are not linked together so no need to associate them
     Sha256Hash empty_hash{};
@@ -261,15 +362,74 @@ vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmPro
     const auto time_s = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     next_pipeline_cache_save = time_s + pipeline_cache_save_delay;
 
-    vk::PipelineShaderStageCreateInfo shader_stage_info{
-        .stage = is_vertex ? vk::ShaderStageFlagBits::eVertex : vk::ShaderStageFlagBits::eFragment,
-        .module = shader,
-        .pName = is_vertex ? "main_vs" : "main_fs"
+    state.shaders_count_compiled++;
+}
+
+void PipelineCache::prepare_shader(const SceGxmProgram &program, const Sha256Hash &hash, bool is_vertex, const std::vector<SceGxmVertexAttribute> &attributes, const TextureInfo &textures_used) {
+    {
+        const std::lock_guard<std::mutex> lock(shaders_mutex);
+        if (shaders.contains(hash) || !pending_shaders.emplace(hash, false).second)
+            return;
+    }
+
+    // the program can be freed by the game before the worker reads it
+    auto program_data = std::make_shared<std::vector<uint8_t>>(program.size);
+    memcpy(program_data->data(), &program, program.size);
+
+    translate_tasks.submit([this, program_data, hash, is_vertex, attributes, textures_used]() {
+        {
+            const std::lock_guard<std::mutex> lock(shaders_mutex);
+            const auto pending = pending_shaders.find(hash);
+            if (pending == pending_shaders.end())
+                // the renderer thread needed it first
+                return;
+            pending->second = true;
+        }
+
+        translate_speculative_shader(*reinterpret_cast<const SceGxmProgram *>(program_data->data()), hash, is_vertex, attributes, textures_used);
+
+        const std::lock_guard<std::mutex> lock(shaders_mutex);
+        pending_shaders.erase(hash);
+        shaders_cond.notify_all();
+    });
+}
+
+void PipelineCache::translate_speculative_shader(const SceGxmProgram &program, const Sha256Hash &hash, bool is_vertex, const std::vector<SceGxmVertexAttribute> &attributes, const TextureInfo &textures_used) {
+    // it was translated during a previous run
+    if (precompile_shader(hash))
+        return;
+
+    // guess the most common formats, this is checked by retrieve_shader
+    shader::Hints hints{
+        .attributes = is_vertex ? &attributes : nullptr,
+        .color_format = SPECULATIVE_COLOR_FORMAT,
     };
+    std::fill_n(hints.vertex_textures, SCE_GXM_MAX_TEXTURE_UNITS, SPECULATIVE_TEXTURE_FORMAT);
+    std::fill_n(hints.fragment_textures, SCE_GXM_MAX_TEXTURE_UNITS, SPECULATIVE_TEXTURE_FORMAT);
 
-    state.shaders_count_compiled++;
+    const std::string shader_version = fmt::format("vk{}", shader::CURRENT_VERSION);
+    shader::usse::SpirvCode source = load_spirv_shader(state.shader_pack, program, state.features, true, hints, false, state.cache_path.c_str(), state.title_id, state.self_name, shader_version, false);
 
-    return shader_stage_info;
+    vk::ShaderModuleCreateInfo shader_info{
+        .codeSize = sizeof(uint32_t) * source.size(),
+        .pCode = source.data()
+    };
+    vk::ShaderModule shader = state.device.createShaderModule(shader_info);
+    state.shader_translation_count.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        const std::lock_guard<std::mutex> lock(shaders_mutex);
+        if (!shaders.emplace(hash, shader).second) {
+            // loaded by a precompile worker at the same time
+            state.device.destroyShaderModule(shader);
+            return;
+        }
+        speculative_shaders.emplace(hash, SpeculativeShader{ textures_used, is_vertex });
+    }
+    add_memory_usage(MemoryCategory::Pipelines, shader_info.codeSize);
+
+    if (optimize_shaders)
+        queue_shader_optimization(hash, source);
 }
 
 vk::PipelineLayout PipelineCache::retrieve_pipeline_layout(const uint16_t vert_texture_count, const uint16_t frag_texture_count) {
@@ -278,14 +438,26 @@ vk::PipelineLayout PipelineCache::retrieve_pipeline_layout(const uint16_t vert_t
         vk::PipelineLayoutCreateInfo layout_info{};
         vk::DescriptorSetLayout set_layouts[] = { uniforms_layout, attachments_layout, vertex_textures_layout[vert_texture_count], fragment_textures_layout[frag_texture_count] };
         layout_info.setSetLayouts(set_layouts);
+        // the base render info blocks, all the layouts have the same ranges so the push constants stay valid between pipelines
+        const vk::PushConstantRange push_constants[] = {
+            vk::PushConstantRange{
+                .stageFlags = vk::ShaderStageFlagBits::eVertex,
+                .offset = 0,
+                .size = sizeof(shader::RenderVertUniformBlock) },
+            vk::PushConstantRange{
+                .stageFlags = vk::ShaderStageFlagBits::eFragment,
+                .offset = shader::RENDER_FRAG_PUSH_CONSTANT_OFFSET,
+                .size = sizeof(shader::RenderFragUniformBlock) }
+        };
+        layout_info.setPushConstantRanges(push_constants);
         pipeline_layouts[vert_texture_count][frag_texture_count] = state.device.createPipelineLayout(layout_info);
     }
 
     return pipeline_layouts[vert_texture_count][frag_texture_count];
 }
 
-vk::RenderPass PipelineCache::retrieve_render_pass(vk::Format format, bool force_load, bool force_store, bool no_color) {
-    auto &render_passes_map = no_color ? shader_interlock_pass : render_passes[force_load][force_store];
+vk::RenderPass PipelineCache::retrieve_render_pass(vk::Format format, bool force_load, bool force_store, bool no_color, bool discard_color) {
+    auto &render_passes_map = no_color ? shader_interlock_pass : render_passes[discard_color][force_load][force_store];
 
     auto it = render_passes_map.find(format);
 
@@ -309,13 +481,15 @@ vk::RenderPass PipelineCache::retrieve_render_pass(vk::Format format, bool force
     if (!no_color) {
         subpass.setColorAttachments(color_ref);
         subpass.setInputAttachments(color_ref);
+        if (state.use_rasterization_order)
+            subpass.flags = vk::SubpassDescriptionFlagBits::eRasterizationOrderAttachmentColorAccessEXT;
     }
 
     vk::AttachmentDescription color_attachment{
         .format = format,
         .samples = vk::SampleCountFlagBits::e1,
-        .loadOp = vk::AttachmentLoadOp::eLoad,
-        .storeOp = vk::AttachmentStoreOp::eStore,
+        .loadOp = discard_color ? vk::AttachmentLoadOp::eDontCare : vk::AttachmentLoadOp::eLoad,
+        .storeOp = discard_color ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore,
         .initialLayout = vk::ImageLayout::eGeneral,
         .finalLayout = vk::ImageLayout::eGeneral
     };
@@ -518,64 +692,92 @@ static vk::StencilOpState convert_op_state(const GxmStencilStateOp &state) {
     };
 }
 
-vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem) {
-    current_context = &context;
-    const GxmRecordState &record = context.record;
-    // get the hash of the current context
-    constexpr size_t record_pipeline_len = offsetof(GxmRecordState, vertex_streams);
-    uint64_t key = XXH_INLINE_XXH3_64bits(&record, record_pipeline_len);
-
-    // add the hash of the blending
-    const SceGxmFragmentProgram &fragment_program_gxm = *record.fragment_program.get(mem);
-    const VKFragmentProgram &fragment_program = *reinterpret_cast<VKFragmentProgram *>(
-        fragment_program_gxm.renderer_data.get());
-    key ^= fragment_program.blending_hash;
+// everything needed to create a pipeline, kept alive until the pipeline has been created
+// (which can happen on a worker thread when async compilation is enabled)
+struct PipelineCreateData {
+    std::vector<vk::VertexInputBindingDescription> binding_descr;
+    std::vector<vk::VertexInputAttributeDescription> attr_descr;
+    std::array<vk::PipelineShaderStageCreateInfo, 2> shader_stages;
+    vk::PipelineVertexInputStateCreateInfo vertex_input;
+    vk::PipelineInputAssemblyStateCreateInfo input_assembly;
+    vk::PipelineViewportStateCreateInfo viewport;
+    vk::PipelineRasterizationStateCreateInfo rasterizer;
+    vk::PipelineMultisampleStateCreateInfo multisampling;
+    vk::PipelineDepthStencilStateCreateInfo ds_info;
+    vk::PipelineColorBlendAttachmentState blending;
+    vk::PipelineColorBlendStateCreateInfo color_blending;
+    vk::PipelineDynamicStateCreateInfo dynamic_info;
+    vk::GraphicsPipelineCreateInfo pipeline_info;
+
+    // make pipeline_info point to the members of this struct
+    void link() {
+        vertex_input.setVertexBindingDescriptions(binding_descr);
+        vertex_input.setVertexAttributeDescriptions(attr_descr);
+        color_blending.setAttachments(blending);
 
-    // add the hash of the attribute and stream layout
-    const SceGxmVertexProgram &vertex_program_gxm = *record.vertex_program.get(mem);
-    key ^= vertex_program_gxm.key_hash;
+        pipeline_info.pStages = shader_stages.data();
+        pipeline_info.pVertexInputState = &vertex_input;
+        pipeline_info.pInputAssemblyState = &input_assembly;
+        pipeline_info.pViewportState = &viewport;
+        pipeline_info.pRasterizationState = &rasterizer;
+        pipeline_info.pMultisampleState = &multisampling;
+        pipeline_info.pDepthStencilState = &ds_info;
+        pipeline_info.pColorBlendState = &color_blending;
+        pipeline_info.pDynamicState = &dynamic_info;
+    }
+};
 
-    // and also add the primitive type
-    key ^= static_cast<uint64_t>(type);
-    auto it = pipelines.find(key);
-    if (it != pipelines.end())
-        return it->second;
+void PipelineCache::collect_compiled_pipelines() {
+    std::lock_guard<std::mutex> lock(compiled_pipelines_mutex);
+    for (const auto &[key, pipeline] : compiled_pipelines) {
+        pipelines[key] = pipeline;
+        pending_pipelines.erase(key);
+    }
+    compiled_pipelines.clear();
+}
 
-    const VertexProgram &vertex_program = *reinterpret_cast<VertexProgram *>(
-        vertex_program_gxm.renderer_data.get());
-    const SceGxmProgram *gxm_fragment_shader = fragment_program_gxm.program.get(mem);
+std::shared_ptr<PipelineCreateData> PipelineCache::get_pipeline_create_data(const PipelineDescription &desc, vk::ShaderModule vertex_module, vk::ShaderModule fragment_module, vk::RenderPass render_pass) {
+    const GxmRecordState &record = desc.record;
+    auto data = std::make_shared<PipelineCreateData>();
 
-    // the vertex input state must be computed before shader are retrieved in case symbols are stripped
-    const vk::PipelineVertexInputStateCreateInfo vertex_input = get_vertex_input_state(mem);
+    data->binding_descr = desc.binding_descr;
+    data->attr_descr = desc.attr_descr;
 
-    const vk::PipelineShaderStageCreateInfo vertex_shader = retrieve_shader(vertex_program_gxm.program.get(mem), vertex_program.hash, true, fragment_program_gxm.is_maskupdate, mem, &vertex_program_gxm.attributes);
-    const vk::PipelineShaderStageCreateInfo fragment_shader = retrieve_shader(gxm_fragment_shader, fragment_program.hash, false, fragment_program_gxm.is_maskupdate, mem, nullptr);
-    const vk::PipelineShaderStageCreateInfo shader_stages[] = { vertex_shader, fragment_shader };
+    data->shader_stages[0] = vk::PipelineShaderStageCreateInfo{
+        .stage = vk::ShaderStageFlagBits::eVertex,
+        .module = vertex_module,
+        .pName = "main_vs"
+    };
+    data->shader_stages[1] = vk::PipelineShaderStageCreateInfo{
+        .stage = vk::ShaderStageFlagBits::eFragment,
+        .module = fragment_module,
+        .pName = "main_fs"
+    };
     // disable the fragment shader if gxm asks us to
     const bool is_fragment_disabled = record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED;
     const uint32_t shader_stage_count = is_fragment_disabled ? 1U : 2U;
 
-    const vk::PipelineInputAssemblyStateCreateInfo input_assembly{
-        .topology = translate_primitive(type)
+    data->input_assembly = vk::PipelineInputAssemblyStateCreateInfo{
+        .topology = translate_primitive(desc.type)
     };
 
     const bool two_sided = (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED);
 
-    const bool use_shader_interlock = state.features.support_shader_interlock && gxm_fragment_shader->is_frag_color_used();
+    const bool use_shader_interlock = state.features.support_shader_interlock && desc.is_frag_color_used;
 
-    const vk::PipelineRasterizationStateCreateInfo rasterizer{
+    data->rasterizer = vk::PipelineRasterizationStateCreateInfo{
         .polygonMode = translate_polygon_mode(record.front_polygon_mode),
         .cullMode = translate_cull_mode(record.cull_mode),
         // front face is always counter clockwise
         .frontFace = vk::FrontFace::eCounterClockwise,
         .depthBiasEnable = VK_TRUE
     };
-    const vk::PipelineMultisampleStateCreateInfo multisampling{
+    data->multisampling = vk::PipelineMultisampleStateCreateInfo{
         .rasterizationSamples = vk::SampleCountFlagBits::e1
     };
     // depth and stencil tests are always enabled on the ps vita as there is almost no cost in doing so
     // on a tiled renderer
-    const vk::PipelineDepthStencilStateCreateInfo ds_info{
+    data->ds_info = vk::PipelineDepthStencilStateCreateInfo{
         .depthTestEnable = VK_TRUE,
         .depthWriteEnable = (record.front_depth_write_mode == SCE_GXM_DEPTH_WRITE_ENABLED),
         .depthCompareOp = translate_depth_func(record.front_depth_func),
@@ -585,20 +787,21 @@ vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiv
         .back = convert_op_state(two_sided ? record.back_stencil_state_op : record.front_stencil_state_op)
     };
 
-    vk::PipelineColorBlendStateCreateInfo color_blending{};
     if (is_fragment_disabled || use_shader_interlock) {
         // The write mask must be empty as the lack of a fragment shader results in undefined values
-        static const vk::PipelineColorBlendAttachmentState blending = {
+        data->blending = vk::PipelineColorBlendAttachmentState{
             .blendEnable = VK_FALSE,
             .colorWriteMask = vk::ColorComponentFlags()
         };
-        color_blending.setAttachments(blending);
     } else {
-        const vk::PipelineColorBlendAttachmentState &blending = fragment_program.blending;
-        color_blending.setAttachments(blending);
+        data->blending = desc.blending;
     }
 
-    vk::PipelineLayout pipeline_layout = retrieve_pipeline_layout(vertex_program.texture_count, fragment_program.texture_count);
+    // the subpass input reads of this pipeline are ordered with the color writes of the previous fragments
+    if (state.use_rasterization_order && desc.is_frag_color_used)
+        data->color_blending.flags = vk::PipelineColorBlendStateCreateFlagBits::eRasterizationOrderAttachmentAccessEXT;
+
+    vk::PipelineLayout pipeline_layout = retrieve_pipeline_layout(desc.vert_texture_count, desc.frag_texture_count);
 
     // all of these can be changed at any time using the vita graphics api (like opengl)
     // Because each one can take a lot of different values, it's better to set them as dynamic
@@ -609,62 +812,480 @@ vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiv
         vk::DynamicState::eStencilCompareMask,
         vk::DynamicState::eStencilReference,
         vk::DynamicState::eStencilWriteMask,
-        vk::DynamicState::eDepthBias
+        vk::DynamicState::eDepthBias,
+        // the following ones need VK_EXT_extended_dynamic_state
+        vk::DynamicState::eCullModeEXT,
+        vk::DynamicState::ePrimitiveTopologyEXT,
+        vk::DynamicState::eDepthWriteEnableEXT,
+        vk::DynamicState::eDepthCompareOpEXT,
+        vk::DynamicState::eStencilOpEXT
     };
-    vk::PipelineDynamicStateCreateInfo dynamic_info{};
-    dynamic_info.setDynamicStates(dynamic_states);
+    constexpr uint32_t base_dynamic_states_count = 7;
+    const uint32_t dynamic_states_count = use_extended_dynamic_state ? static_cast<uint32_t>(std::size(dynamic_states)) : base_dynamic_states_count;
+    data->dynamic_info.setDynamicStateCount(dynamic_states_count);
+    data->dynamic_info.setPDynamicStates(dynamic_states);
 
     // we still need to specifiy the viewport and scissor count even though they are dynamic
-    vk::PipelineViewportStateCreateInfo viewport{
+    data->viewport = vk::PipelineViewportStateCreateInfo{
         .viewportCount = 1,
         .scissorCount = 1
     };
 
-    const vk::RenderPass render_pass = use_shader_interlock ? context.current_shader_interlock_pass : context.current_render_pass;
-    vk::GraphicsPipelineCreateInfo pipeline_info{
+    data->pipeline_info = vk::GraphicsPipelineCreateInfo{
         .stageCount = shader_stage_count,
-        .pStages = shader_stages,
-        .pVertexInputState = &vertex_input,
-        .pInputAssemblyState = &input_assembly,
-        .pViewportState = &viewport,
-        .pRasterizationState = &rasterizer,
-        .pMultisampleState = &multisampling,
-        .pDepthStencilState = &ds_info,
-        .pColorBlendState = &color_blending,
-        .pDynamicState = &dynamic_info,
         .layout = pipeline_layout,
         .renderPass = render_pass,
         .subpass = 0
     };
+    data->link();
 
-    const auto result = state.device.createGraphicsPipeline(pipeline_cache, pipeline_info);
+    return data;
+}
+
+// hash the given values, they must not contain any padding
+template <typename... Args>
+static uint64_t hash_values(const Args &...args) {
+    std::array<uint64_t, sizeof...(Args)> values = { static_cast<uint64_t>(args)... };
+    return XXH_INLINE_XXH3_64bits(values.data(), values.size() * sizeof(uint64_t));
+}
+
+vk::Pipeline PipelineCache::retrieve_library(uint64_t key, const vk::GraphicsPipelineCreateInfo &library_info, bool only_existing) {
+    std::lock_guard<std::mutex> lock(libraries_mutex);
+    auto it = pipeline_libraries.find(key);
+    if (it != pipeline_libraries.end())
+        return it->second;
+    if (only_existing)
+        return nullptr;
+
+    const auto result = state.device.createGraphicsPipeline(pipeline_cache, library_info);
     if (result.result != vk::Result::eSuccess) {
-        LOG_CRITICAL("Failed to create pipeline.");
+        LOG_CRITICAL("Failed to create pipeline library.");
         return nullptr;
     }
 
-    pipelines[key] = result.value;
+    pipeline_libraries[key] = result.value;
+    return result.value;
+}
+
+vk::Pipeline PipelineCache::create_pipeline(const PipelineCreateData &data, bool link_only) {
+    if (!use_pipeline_library) {
+        if (link_only)
+            return nullptr;
+
+        state.pipelines_count_compiled.fetch_add(1, std::memory_order_relaxed);
+        const auto result = state.device.createGraphicsPipeline(pipeline_cache, data.pipeline_info);
+        if (result.result != vk::Result::eSuccess) {
+            LOG_CRITICAL("Failed to create pipeline.");
+            return nullptr;
+        }
+        return result.value;
+    }
+
+    // with VK_EXT_graphics_pipeline_library, each of the four parts of the pipeline is created once
+    // and the final pipeline is only a (cheap) link of these libraries
+    const vk::GraphicsPipelineCreateInfo &info = data.pipeline_info;
+    const vk::PipelineCreateFlags library_flags = vk::PipelineCreateFlagBits::eLibraryKHR;
+    std::array<vk::Pipeline, 4> libraries;
+
+    // vertex input interface, depends on the vertex streams layout and the topology
+    {
+        const uint64_t key = hash_values(0, data.input_assembly.topology,
+            XXH_INLINE_XXH3_64bits(data.binding_descr.data(), data.binding_descr.size() * sizeof(vk::VertexInputBindingDescription)),
+            XXH_INLINE_XXH3_64bits(data.attr_descr.data(), data.attr_descr.size() * sizeof(vk::VertexInputAttributeDescription)));
+        vk::GraphicsPipelineLibraryCreateInfoEXT library_info{
+            .flags = vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface
+        };
+        const vk::GraphicsPipelineCreateInfo library_create_info{
+            .pNext = &library_info,
+            .flags = library_flags,
+            .pVertexInputState = &data.vertex_input,
+            .pInputAssemblyState = &data.input_assembly,
+            .pDynamicState = &data.dynamic_info
+        };
+        libraries[0] = retrieve_library(key, library_create_info, link_only);
+    }
+
+    // pre-rasterization shaders, only depends on the vertex shader and the rasterizer
+    {
+        const uint64_t key = hash_values(1, reinterpret_cast<uint64_t>(static_cast<VkShaderModule>(data.shader_stages[0].module)),
+            reinterpret_cast<uint64_t>(static_cast<VkPipelineLayout>(info.layout)), reinterpret_cast<uint64_t>(static_cast<VkRenderPass>(info.renderPass)),
+            data.rasterizer.polygonMode, static_cast<VkCullModeFlags>(data.rasterizer.cullMode));
+        vk::GraphicsPipelineLibraryCreateInfoEXT library_info{
+            .flags = vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders
+        };
+        const vk::GraphicsPipelineCreateInfo library_create_info{
+            .pNext = &library_info,
+            .flags = library_flags,
+            .stageCount = 1,
+            .pStages = &data.shader_stages[0],
+            .pViewportState = &data.viewport,
+            .pRasterizationState = &data.rasterizer,
+            .pDynamicState = &data.dynamic_info,
+            .layout = info.layout,
+            .renderPass = info.renderPass,
+            .subpass = 0
+        };
+        libraries[1] = retrieve_library(key, library_create_info, link_only);
+    }
+
+    // fragment shader, depends on the fragment shader and the depth stencil state
+    {
+        const bool has_fragment_shader = info.stageCount > 1;
+        const vk::ShaderModule fragment_module = has_fragment_shader ? data.shader_stages[1].module : vk::ShaderModule();
+        const uint64_t key = hash_values(2, reinterpret_cast<uint64_t>(static_cast<VkShaderModule>(fragment_module)),
+            reinterpret_cast<uint64_t>(static_cast<VkPipelineLayout>(info.layout)), reinterpret_cast<uint64_t>(static_cast<VkRenderPass>(info.renderPass)),
+            data.ds_info.depthWriteEnable, data.ds_info.depthCompareOp,
+            data.ds_info.front.failOp, data.ds_info.front.passOp, data.ds_info.front.depthFailOp, data.ds_info.front.compareOp,
+            data.ds_info.back.failOp, data.ds_info.back.passOp, data.ds_info.back.depthFailOp, data.ds_info.back.compareOp);
+        vk::GraphicsPipelineLibraryCreateInfoEXT library_info{
+            .flags = vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader
+        };
+        const vk::GraphicsPipelineCreateInfo library_create_info{
+            .pNext = &library_info,
+            .flags = library_flags,
+            .stageCount = has_fragment_shader ? 1U : 0U,
+            .pStages = has_fragment_shader ? &data.shader_stages[1] : nullptr,
+            .pMultisampleState = &data.multisampling,
+            .pDepthStencilState = &data.ds_info,
+            .pDynamicState = &data.dynamic_info,
+            .layout = info.layout,
+            .renderPass = info.renderPass,
+            .subpass = 0
+        };
+        libraries[2] = retrieve_library(key, library_create_info, link_only);
+    }
+
+    // fragment output, only depends on the blending
+    {
+        const vk::PipelineColorBlendAttachmentState &blend = data.blending;
+        const uint64_t key = hash_values(3, reinterpret_cast<uint64_t>(static_cast<VkRenderPass>(info.renderPass)),
+            static_cast<VkPipelineColorBlendStateCreateFlags>(data.color_blending.flags), blend.blendEnable, blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+            blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp, static_cast<VkColorComponentFlags>(blend.colorWriteMask));
+        vk::GraphicsPipelineLibraryCreateInfoEXT library_info{
+            .flags = vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface
+        };
+        const vk::GraphicsPipelineCreateInfo library_create_info{
+            .pNext = &library_info,
+            .flags = library_flags,
+            .pMultisampleState = &data.multisampling,
+            .pColorBlendState = &data.color_blending,
+            .pDynamicState = &data.dynamic_info,
+            .renderPass = info.renderPass,
+            .subpass = 0
+        };
+        libraries[3] = retrieve_library(key, library_create_info, link_only);
+    }
+
+    for (vk::Pipeline library : libraries) {
+        if (!library)
+            return nullptr;
+    }
+    state.pipelines_count_compiled.fetch_add(1, std::memory_order_relaxed);
+
+    vk::PipelineLibraryCreateInfoKHR link_info{};
+    link_info.setLibraries(libraries);
+    const vk::GraphicsPipelineCreateInfo pipeline_info{
+        .pNext = &link_info,
+        .layout = info.layout
+    };
+    const auto result = state.device.createGraphicsPipeline(pipeline_cache, pipeline_info);
+    if (result.result != vk::Result::eSuccess) {
+        LOG_CRITICAL("Failed to link pipeline libraries.");
+        return nullptr;
+    }
 
     return result.value;
 }
 
-bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
-    const auto shader_path{ fs::path(state.cache_path) / "shaders" / state.title_id / state.self_name };
+// with extended dynamic state, only the topology class (point, line or triangle) must match the pipeline
+static SceGxmPrimitiveType get_topology_class(SceGxmPrimitiveType type) {
+    switch (type) {
+    case SCE_GXM_PRIMITIVE_POINTS:
+        return SCE_GXM_PRIMITIVE_POINTS;
+    case SCE_GXM_PRIMITIVE_LINES:
+        return SCE_GXM_PRIMITIVE_LINES;
+    default:
+        return SCE_GXM_PRIMITIVE_TRIANGLES;
+    }
+}
+
+// give a fixed value to all the states set using extended dynamic state
+// so that they do not change the pipeline key
+static void clear_dynamic_states(GxmRecordState &record) {
+    record.cull_mode = SCE_GXM_CULL_NONE;
+    // two sided only changes the back stencil ops
+    record.two_sided = SCE_GXM_TWO_SIDED_DISABLED;
+    record.front_stencil_state_op = {};
+    record.back_stencil_state_op = {};
+    record.front_depth_func = SCE_GXM_DEPTH_FUNC_LESS_EQUAL;
+    record.back_depth_func = SCE_GXM_DEPTH_FUNC_LESS_EQUAL;
+    record.front_depth_write_mode = SCE_GXM_DEPTH_WRITE_ENABLED;
+    record.back_depth_write_mode = SCE_GXM_DEPTH_WRITE_ENABLED;
+}
+
+vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem) {
+    current_context = &context;
+    GxmRecordState dynamic_record;
+    if (use_extended_dynamic_state) {
+        dynamic_record = context.record;
+        clear_dynamic_states(dynamic_record);
+    }
+    const GxmRecordState &record = use_extended_dynamic_state ? dynamic_record : context.record;
+    const SceGxmPrimitiveType pipeline_type = use_extended_dynamic_state ? get_topology_class(type) : type;
+
+    // get the hash of the current context
+    constexpr size_t record_pipeline_len = offsetof(GxmRecordState, vertex_streams);
+    uint64_t key = XXH_INLINE_XXH3_64bits(&record, record_pipeline_len);
+
+    // add the hash of the blending
+    const SceGxmFragmentProgram &fragment_program_gxm = *record.fragment_program.get(mem);
+    const VKFragmentProgram &fragment_program = *reinterpret_cast<VKFragmentProgram *>(
+        fragment_program_gxm.renderer_data.get());
+    key ^= fragment_program.blending_hash;
+
+    // add the hash of the attribute and stream layout
+    const SceGxmVertexProgram &vertex_program_gxm = *record.vertex_program.get(mem);
+    key ^= vertex_program_gxm.key_hash;
+
+    // and also add the primitive type
+    key ^= static_cast<uint64_t>(pipeline_type);
+    auto it = pipelines.find(key);
+    if (it != pipelines.end())
+        return it->second;
+
+    if (async_compilation) {
+        // maybe it was compiled in the meantime
+        collect_compiled_pipelines();
+        it = pipelines.find(key);
+        if (it != pipelines.end())
+            return it->second;
+
+        if (pending_pipelines.contains(key))
+            return nullptr;
+    }
+
+    const VertexProgram &vertex_program = *reinterpret_cast<VertexProgram *>(
+        vertex_program_gxm.renderer_data.get());
+    const SceGxmProgram *gxm_fragment_shader = fragment_program_gxm.program.get(mem);
+
+    PipelineDescription desc{
+        .key = key,
+        .record = record,
+        .type = pipeline_type,
+        .color_format = context.current_color_format,
+        .is_frag_color_used = gxm_fragment_shader->is_frag_color_used(),
+        .vert_texture_count = vertex_program.texture_count,
+        .frag_texture_count = fragment_program.texture_count,
+        .blending = fragment_program.blending
+    };
+
+    // the vertex input state must be computed before shader are retrieved in case symbols are stripped
+    get_vertex_input_state(mem);
+    desc.binding_descr = binding_descr;
+    desc.attr_descr = attr_descr;
+
+    const vk::PipelineShaderStageCreateInfo vertex_shader = retrieve_shader(vertex_program_gxm.program.get(mem), vertex_program.hash, true, fragment_program_gxm.is_maskupdate, mem, &vertex_program_gxm.attributes);
+    const vk::PipelineShaderStageCreateInfo fragment_shader = retrieve_shader(gxm_fragment_shader, fragment_program.hash, false, fragment_program_gxm.is_maskupdate, mem, nullptr);
 
-    if (shaders.contains(hash))
-        return true;
+    const bool use_shader_interlock = state.features.support_shader_interlock && desc.is_frag_color_used;
+    const vk::RenderPass render_pass = use_shader_interlock ? context.current_shader_interlock_pass : context.current_render_pass;
+    auto data = get_pipeline_create_data(desc, vertex_shader.module, fragment_shader.module, render_pass);
+
+    // remember this pipeline so that it can be created at boot next time
+    pipeline_descriptions.push_back(std::move(desc));
+    pipeline_descriptions_changed = true;
+    const auto time_s = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    next_pipeline_cache_save = time_s + pipeline_cache_save_delay;
+
+    if (async_compilation) {
+        // once the shaders of a pipeline have been compiled in libraries, linking them is fast enough
+        // to be done right away, so only the draws using new shaders or states are skipped
+        const vk::Pipeline pipeline = create_pipeline(*data, true);
+        if (pipeline) {
+            pipelines[key] = pipeline;
+            return pipeline;
+        }
+
+        pending_pipelines.insert(key);
+        compile_tasks.submit([this, key, data]() {
+            const vk::Pipeline pipeline = create_pipeline(*data);
+
+            std::lock_guard<std::mutex> lock(compiled_pipelines_mutex);
+            compiled_pipelines.emplace_back(key, pipeline);
+        });
+        return nullptr;
+    }
+
+    const vk::Pipeline pipeline = create_pipeline(*data);
+    pipelines[key] = pipeline;
+
+    return pipeline;
+}
+
+void PipelineCache::precompile_pipelines() {
+    if (pipeline_descriptions.empty())
+        return;
+
+    LOG_INFO("Creating {} pipelines from the previous runs...", pipeline_descriptions.size());
+    uint32_t nb_created = 0;
+    for (const PipelineDescription &desc : pipeline_descriptions) {
+        if (pipelines.contains(desc.key))
+            continue;
+
+        // the shaders must be in the shader cache, otherwise this pipeline will be created on first use
+        if (!precompile_shader(desc.record.vertex_program_hash) || !precompile_shader(desc.record.fragment_program_hash))
+            continue;
+
+        const bool use_shader_interlock = state.features.support_shader_interlock && desc.is_frag_color_used;
+        // load and store operations do not matter for render pass compatibility
+        const vk::RenderPass render_pass = retrieve_render_pass(desc.color_format, true, true, use_shader_interlock);
+        auto data = get_pipeline_create_data(desc, shaders[desc.record.vertex_program_hash], shaders[desc.record.fragment_program_hash], render_pass);
+
+        const vk::Pipeline pipeline = create_pipeline(*data);
+        if (!pipeline)
+            continue;
+
+        pipelines[desc.key] = pipeline;
+        nb_created++;
+    }
+    LOG_INFO("{} pipelines created", nb_created);
+}
+
+// increase this value when the format of the pipeline descriptions file changes
+static constexpr uint32_t pipeline_descriptions_version = 2;
+
+void PipelineCache::read_pipeline_descriptions() {
+    const auto shaders_path{ fs::path(state.cache_path) / "shaders" / state.title_id / state.self_name };
+    const std::string descriptions_name = fmt::format("pipelines-vk{}.dat", shader::CURRENT_VERSION);
+
+    fs::ifstream descriptions_file(shaders_path / descriptions_name, std::ios::in | std::ios::binary);
+    if (!descriptions_file.is_open())
+        return;
+
+    uint32_t version;
+    descriptions_file.read(reinterpret_cast<char *>(&version), sizeof(uint32_t));
+    uint32_t features_mask;
+    descriptions_file.read(reinterpret_cast<char *>(&features_mask), sizeof(uint32_t));
+    // descriptions saved with extended dynamic state have a different key
+    bool extended_dynamic_state;
+    descriptions_file.read(reinterpret_cast<char *>(&extended_dynamic_state), sizeof(bool));
+    if (version != pipeline_descriptions_version || features_mask != state.get_features_mask()
+        || extended_dynamic_state != use_extended_dynamic_state) {
+        LOG_WARN("Pipeline descriptions are outdated, ignoring them");
+        return;
+    }
+
+    uint32_t count;
+    descriptions_file.read(reinterpret_cast<char *>(&count), sizeof(uint32_t));
+
+    constexpr size_t record_pipeline_len = offsetof(GxmRecordState, vertex_streams);
+    pipeline_descriptions.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        auto read = [&descriptions_file](auto &value) {
+            descriptions_file.read(reinterpret_cast<char *>(&value), sizeof(value));
+        };
+        auto read_vector = [&descriptions_file](auto &vector) {
+            uint32_t size = 0;
+            descriptions_file.read(reinterpret_cast<char *>(&size), sizeof(uint32_t));
+            vector.resize(size);
+            descriptions_file.read(reinterpret_cast<char *>(vector.data()), size * sizeof(vector[0]));
+        };
+
+        PipelineDescription desc{};
+        read(desc.key);
+        descriptions_file.read(reinterpret_cast<char *>(&desc.record), record_pipeline_len);
+        read(desc.type);
+        read(desc.color_format);
+        read(desc.is_frag_color_used);
+        read(desc.vert_texture_count);
+        read(desc.frag_texture_count);
+        read(desc.blending);
+        read_vector(desc.binding_descr);
+        read_vector(desc.attr_descr);
+
+        if (!descriptions_file) {
+            LOG_ERROR("Pipeline descriptions file is corrupted");
+            pipeline_descriptions.clear();
+            return;
+        }
+
+        pipeline_descriptions.push_back(std::move(desc));
+    }
+    pipeline_descriptions_changed = false;
+}
+
+void PipelineCache::save_pipeline_descriptions() {
+    if (!pipeline_descriptions_changed)
+        return;
+
+    const auto shaders_path{ fs::path(state.cache_path) / "shaders" / state.title_id / state.self_name };
+    const std::string descriptions_name = fmt::format("pipelines-vk{}.dat", shader::CURRENT_VERSION);
+
+    fs::ofstream descriptions_file(shaders_path / descriptions_name, std::ios::out | std::ios::binary);
+    if (!descriptions_file.is_open())
+        return;
 
-    if (!fs::exists(shader_path) || fs::is_empty(shader_path))
-        return false;
+    const uint32_t version = pipeline_descriptions_version;
+    descriptions_file.write(reinterpret_cast<const char *>(&version), sizeof(uint32_t));
+    const uint32_t features_mask = state.get_features_mask();
+    descriptions_file.write(reinterpret_cast<const char *>(&features_mask), sizeof(uint32_t));
+    descriptions_file.write(reinterpret_cast<const char *>(&use_extended_dynamic_state), sizeof(bool));
+    const uint32_t count = static_cast<uint32_t>(pipeline_descriptions.size());
+    descriptions_file.write(reinterpret_cast<const char *>(&count), sizeof(uint32_t));
+
+    constexpr size_t record_pipeline_len = offsetof(GxmRecordState, vertex_streams);
+    for (const PipelineDescription &desc : pipeline_descriptions) {
+        auto write = [&descriptions_file](const auto &value) {
+            descriptions_file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        };
+        auto write_vector = [&descriptions_file](const auto &vector) {
+            const uint32_t size = static_cast<uint32_t>(vector.size());
+            descriptions_file.write(reinterpret_cast<const char *>(&size), sizeof(uint32_t));
+            descriptions_file.write(reinterpret_cast<const char *>(vector.data()), size * sizeof(vector[0]));
+        };
+
+        write(desc.key);
+        descriptions_file.write(reinterpret_cast<const char *>(&desc.record), record_pipeline_len);
+        write(desc.type);
+        write(desc.color_format);
+        write(desc.is_frag_color_used);
+        write(desc.vert_texture_count);
+        write(desc.frag_texture_count);
+        write(desc.blending);
+        write_vector(desc.binding_descr);
+        write_vector(desc.attr_descr);
+    }
+    descriptions_file.close();
+    pipeline_descriptions_changed = false;
+}
+
+bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
+    {
+        std::lock_guard<std::mutex> lock(shaders_mutex);
+        if (shaders.contains(hash))
+            return true;
+    }
 
     Sha256Hash shader_hash;
     memcpy(shader_hash.data(), hash.data(), sizeof(Sha256Hash));
-    const std::string hash_ver = fmt::format("vk{}-{}", shader::CURRENT_VERSION, hex_string(shader_hash));
 
-    const std::vector<uint32_t> source = renderer::pre_load_shader_spirv(hash_ver.c_str(), "spv", state.cache_path.c_str(), state.title_id, state.self_name);
+    std::vector<uint32_t> source;
+    if (optimize_shaders) {
+        const std::string hash_ver = fmt::format("vk{}opt-{}", shader::CURRENT_VERSION, hex_string(shader_hash));
+        source = renderer::pre_load_shader_spirv(state.shader_pack, hash_ver.c_str(), "spv", state.cache_path.c_str(), state.title_id, state.self_name);
+    }
+
+    if (source.empty()) {
+        const std::string hash_ver = fmt::format("vk{}-{}", shader::CURRENT_VERSION, hex_string(shader_hash));
+        source = renderer::pre_load_shader_spirv(state.shader_pack, hash_ver.c_str(), "spv", state.cache_path.c_str(), state.title_id, state.self_name);
 
-    if (source.empty())
-        return false;
+        if (source.empty())
+            return false;
+
+        // this shader has not been optimized yet
+        if (optimize_shaders)
+            queue_shader_optimization(hash, source);
+    }
 
     vk::ShaderModuleCreateInfo shader_info{
         .codeSize = sizeof(uint32_t) * source.size(),
@@ -672,8 +1293,30 @@ bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
     };
 
     vk::ShaderModule shader = state.device.createShaderModule(shader_info);
-    shaders[hash] = shader;
+
+    std::lock_guard<std::mutex> lock(shaders_mutex);
+    if (!shaders.emplace(hash, shader).second)
+        // another thread created it at the same time
+        state.device.destroyShaderModule(shader);
+    else
+        add_memory_usage(MemoryCategory::Pipelines, shader_info.codeSize);
 
     return true;
 }
+
+void PipelineCache::queue_shader_optimization(const Sha256Hash &hash, const std::vector<uint32_t> &source) {
+    const std::string hash_ver = fmt::format("vk{}opt-{}", shader::CURRENT_VERSION, hex_string(hash));
+    const fs::path shader_path = fs_utils::construct_file_name(state.cache_path, fs::path("shaders") / state.title_id / state.self_name, hash_ver, "spv");
+
+    optimize_tasks.submit([hash_ver, shader_path, source]() mutable {
+        if (!shader::optimize_spirv(source)) {
+            LOG_WARN("Failed to optimize shader {}", hash_ver);
+            return;
+        }
+
+        fs::ofstream shader_file(shader_path, std::ios::out | std::ios::binary);
+        if (shader_file.is_open())
+            shader_file.write(reinterpret_cast<const char *>(source.data()), sizeof(uint32_t) * source.size());
+    });
+}
 } // namespace renderer::vulkan
\ No newline at end of file
@@ -23,12 +23,17 @@
 #include <config/state.h>
 #include <config/version.h>
 #include <display/state.h>
+#include <gxm/types.h>
+#include <mem/functions.h>
 #include <shader/spirv_recompiler.h>
 #include <util/align.h>
 #include <util/float_to_half.h>
 #include <util/log.h>
+#include <util/memory_accounting.h>
+#include <util/performance_hint.h>
 #include <vkutil/vkutil.h>
 
+#include <SDL_loadso.h>
 #include <SDL_vulkan.h>
 
 #ifdef __APPLE__
@@ -77,6 +82,8 @@ const static std::vector<const char *> required_device_extensions = {
     VK_KHR_MAINTENANCE1_EXTENSION_NAME
 };
 
+static constexpr vk::BufferUsageFlags mapped_memory_flags = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferDst;
+
 namespace renderer::vulkan {
 
 static bool device_is_compatible(const vk::PhysicalDevice &device) {
@@ -89,6 +96,30 @@ static bool device_is_compatible(const vk::PhysicalDevice &device) {
     return required_extensions.empty();
 }
 
+// the loader is usually loaded by SDL when the window is created, it has to be loaded by hand without one
+static PFN_vkGetInstanceProcAddr load_vulkan_loader() {
+#ifdef WIN32
+    const char *const loader_names[] = { "vulkan-1.dll" };
+#elif defined(__APPLE__)
+    const char *const loader_names[] = { "libvulkan.1.dylib", "libMoltenVK.dylib" };
+#else
+    const char *const loader_names[] = { "libvulkan.so.1", "libvulkan.so" };
+#endif
+    for (const char *name : loader_names) {
+        void *loader = SDL_LoadObject(name);
+        if (!loader)
+            continue;
+
+        // the loader is kept loaded until the process exits
+        void *proc = SDL_LoadFunction(loader, "vkGetInstanceProcAddr");
+        if (proc)
+            return reinterpret_cast<PFN_vkGetInstanceProcAddr>(proc);
+        SDL_UnloadObject(loader);
+    }
+
+    return nullptr;
+}
+
 static bool select_queues(VKState &vk_state,
     std::vector<vk::DeviceQueueCreateInfo> &queue_infos, std::vector<std::vector<float>> &queue_priorities) {
     // TODO: Better queue allocation.
@@ -108,13 +139,12 @@ static bool select_queues(VKState &vk_state,
     for (uint32_t i = 0; i < vk_state.physical_device_queue_families.size(); i++) {
         const auto &queue_family = vk_state.physical_device_queue_families[i];
 
-        // MoltenVK does not accept nullptr a pPriorities for some reason.
-        std::vector<float> &priorities = queue_priorities.emplace_back(queue_family.queueCount, 1.0f);
-
         // Only one DeviceQueueCreateInfo should be created per family.
-        if (!found_graphics && (queue_family.queueFlags & vk::QueueFlagBits::eGraphics)
+        if ((queue_family.queueFlags & vk::QueueFlagBits::eGraphics)
             && (queue_family.queueFlags & vk::QueueFlagBits::eTransfer)
-            && vk_state.physical_device.getSurfaceSupportKHR(i, vk_state.screen_renderer.surface)) {
+            && (vk_state.headless || vk_state.physical_device.getSurfaceSupportKHR(i, vk_state.screen_renderer.surface))) {
+            // MoltenVK does not accept nullptr a pPriorities for some reason.
+            std::vector<float> &priorities = queue_priorities.emplace_back(queue_family.queueCount, 1.0f);
             vk::DeviceQueueCreateInfo queue_create_info{
                 .queueFamilyIndex = i,
                 .queueCount = queue_family.queueCount,
@@ -122,12 +152,22 @@ static bool select_queues(VKState &vk_state,
             };
             queue_infos.emplace_back(std::move(queue_create_info));
             vk_state.general_family_index = i;
-            vk_state.transfer_family_index = i;
             found_graphics = true;
-            found_transfer = true;
+            break;
         }
-        // for now use the same queue for graphics and transfer, to be improved on later
-        /* else if (!found_transfer && queue_family.queueFlags & vk::QueueFlagBits::eTransfer) {
+    }
+
+    if (!found_graphics)
+        return false;
+
+    // a family with only the transfer bit is usually backed by the DMA engines of the GPU
+    // and can upload textures while the graphics queue is busy rendering
+    for (uint32_t i = 0; i < vk_state.physical_device_queue_families.size(); i++) {
+        const auto &queue_family = vk_state.physical_device_queue_families[i];
+
+        if ((queue_family.queueFlags & vk::QueueFlagBits::eTransfer)
+            && !(queue_family.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+            std::vector<float> &priorities = queue_priorities.emplace_back(queue_family.queueCount, 1.0f);
             vk::DeviceQueueCreateInfo queue_create_info{
                 .queueFamilyIndex = i,
                 .queueCount = queue_family.queueCount,
@@ -136,11 +176,14 @@ static bool select_queues(VKState &vk_state,
             queue_infos.emplace_back(std::move(queue_create_info));
             vk_state.transfer_family_index = i;
             found_transfer = true;
+            break;
         }
-        */
+    }
 
-        if (found_graphics && found_transfer)
-            break;
+    if (!found_transfer) {
+        // use the graphics queue for transfers too
+        vk_state.transfer_family_index = vk_state.general_family_index;
+        found_transfer = true;
     }
 
     return found_graphics && found_transfer;
@@ -184,7 +227,12 @@ bool VKState::init(const char *shared_path, const bool hashless_texture_cache) {
 bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state, const Config &config) {
     // Create Instance
     {
-        PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(SDL_Vulkan_GetVkGetInstanceProcAddr());
+        headless = window == nullptr;
+        PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = headless ? load_vulkan_loader() : reinterpret_cast<PFN_vkGetInstanceProcAddr>(SDL_Vulkan_GetVkGetInstanceProcAddr());
+        if (!vkGetInstanceProcAddr) {
+            LOG_ERROR("Could not load the Vulkan loader");
+            return false;
+        }
         VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
 
         vk::ApplicationInfo app_info{
@@ -195,15 +243,18 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             .apiVersion = VK_API_VERSION_1_0
         };
 
-        unsigned int instance_req_ext_count;
-        if (!SDL_Vulkan_GetInstanceExtensions(window, &instance_req_ext_count, nullptr)) {
-            LOG_ERROR("Could not get required extensions");
-            return false;
-        }
-
+        // without a window, nothing is presented so no surface extension is needed
         std::vector<const char *> instance_extensions;
-        instance_extensions.resize(instance_req_ext_count);
-        SDL_Vulkan_GetInstanceExtensions(window, &instance_req_ext_count, instance_extensions.data());
+        if (!headless) {
+            unsigned int instance_req_ext_count;
+            if (!SDL_Vulkan_GetInstanceExtensions(window, &instance_req_ext_count, nullptr)) {
+                LOG_ERROR("Could not get required extensions");
+                return false;
+            }
+
+            instance_extensions.resize(instance_req_ext_count);
+            SDL_Vulkan_GetInstanceExtensions(window, &instance_req_ext_count, instance_extensions.data());
+        }
 
         const std::set<std::string> optional_instance_extensions = {
             VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
@@ -300,9 +351,18 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
 #endif
 
     // Create Surface
-    if (!screen_renderer.create(window))
+    if (!headless && !screen_renderer.create(window))
         return false;
 
+    // frame pacing, 0 frames in flight means using the default of the pacing mode
+    screen_renderer.low_latency = config.frame_pacing == FRAME_PACING_LOW_LATENCY;
+    screen_renderer.high_throughput = config.frame_pacing == FRAME_PACING_THROUGHPUT;
+    frames_in_flight = config.frames_in_flight;
+    if (frames_in_flight <= 0)
+        frames_in_flight = screen_renderer.low_latency ? 2 : (screen_renderer.high_throughput ? MAX_FRAMES_RENDERING : 3);
+    frames_in_flight = std::clamp(frames_in_flight, 1, MAX_FRAMES_RENDERING);
+    LOG_INFO("Using {} frames in flight", frames_in_flight);
+
     // Select Physical Device
     {
         std::vector<vk::PhysicalDevice> physical_devices = instance.enumeratePhysicalDevices();
@@ -338,6 +398,7 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
     }
 
     bool support_dedicated_allocations = false;
+    bool support_memory_budget = false;
     // Create Device
     {
         std::vector<vk::DeviceQueueCreateInfo> queue_infos;
@@ -347,17 +408,18 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             return false;
         }
 
-        if (!physical_device.getSurfaceSupportKHR(
-                general_family_index, screen_renderer.surface)) {
+        if (!headless && !physical_device.getSurfaceSupportKHR(general_family_index, screen_renderer.surface)) {
             LOG_ERROR("Failed to select a Vulkan queue that supports presentation. This is likely a bug.");
             return false;
         }
 
         // use these features (because they are used by the vita GPU) if they are available
         vk::PhysicalDeviceFeatures enabled_features{
+            .multiDrawIndirect = physical_device_features.multiDrawIndirect,
             .fillModeNonSolid = physical_device_features.fillModeNonSolid,
             .wideLines = physical_device_features.wideLines,
             .samplerAnisotropy = physical_device_features.samplerAnisotropy,
+            .textureCompressionBC = physical_device_features.textureCompressionBC,
             .occlusionQueryPrecise = physical_device_features.occlusionQueryPrecise,
             .fragmentStoresAndAtomics = physical_device_features.fragmentStoresAndAtomics,
             .shaderStorageImageExtendedFormats = physical_device_features.shaderStorageImageExtendedFormats,
@@ -371,10 +433,17 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         bool support_buffer_device_address = false;
         bool support_external_memory = false;
         bool support_shader_interlock = false;
+        bool support_pipeline_library = false;
+        bool support_graphics_pipeline_library = false;
+        bool support_extended_dynamic_state = false;
+        bool support_present_id = false;
+        bool support_present_wait = false;
         const std::map<std::string_view, bool *> optional_extensions = {
             { VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, &temp_bool },
             // can be used by vma to improve performance
             { VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, &support_dedicated_allocations },
+            // used to know how much memory the texture cache can use
+            { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, &support_memory_budget },
             // used to tell the driver this application is high priority
             { VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME, &support_global_priority },
             // can be used to specify which format will be used by mutable images
@@ -391,6 +460,18 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             { VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME, &support_fsr },
             // used for accurate programmable blending on desktop GPUs
             { VK_EXT_FRAGMENT_SHADER_INTERLOCK_EXTENSION_NAME, &support_shader_interlock },
+            // lets the subpass input read the color of the previous fragments without a barrier
+            { VK_EXT_RASTERIZATION_ORDER_ATTACHMENT_ACCESS_EXTENSION_NAME, &support_rasterization_order },
+            // used to reduce the cost of creating new pipelines
+            { VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, &support_pipeline_library },
+            { VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, &support_graphics_pipeline_library },
+            // used to reduce the number of pipelines which are created
+            { VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME, &support_extended_dynamic_state },
+            // used to wait for the submissions without allocating and resetting fences
+            { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, &support_timeline_semaphore },
+            // used by the low latency frame pacing to wait for the frames to be displayed
+            { VK_KHR_PRESENT_ID_EXTENSION_NAME, &support_present_id },
+            { VK_KHR_PRESENT_WAIT_EXTENSION_NAME, &support_present_wait },
 #ifdef __APPLE__
             // Needed to create the MoltenVK device
             { VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME, &temp_bool },
@@ -425,11 +506,35 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
 #endif
 
         if (features.support_memory_mapping) {
+            // without resizable BAR, the device-local memory the CPU can map is at most 256 MiB
+            for (uint32_t i = 0; i < physical_device_memory.memoryTypeCount; i++) {
+                const vk::MemoryType &type = physical_device_memory.memoryTypes[i];
+                constexpr vk::MemoryPropertyFlags rebar_flags = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+                if ((type.propertyFlags & rebar_flags) == rebar_flags && physical_device_memory.memoryHeaps[type.heapIndex].size > MiB(256))
+                    rebar_heap_size = std::max(rebar_heap_size, physical_device_memory.memoryHeaps[type.heapIndex].size);
+            }
+
+            // the imported guest memory stays in the host memory, only the blocks allocated by the renderer can be placed in the heap
+            use_rebar_mapped_memory = config.rebar_mapped_memory && rebar_heap_size > 0;
+            if (use_rebar_mapped_memory) {
+                // leave most of the heap to the surfaces and the textures
+                rebar_mapped_budget = rebar_heap_size / 4;
+                support_external_memory = false;
+                LOG_INFO("Placing the guest memory only read by the GPU in the resizable BAR heap, up to {} MiB", rebar_mapped_budget >> 20);
+            } else if (config.rebar_mapped_memory) {
+                LOG_WARN("The GPU has no resizable BAR heap, the guest memory is mapped from the host memory");
+            }
+
             if (support_external_memory) {
-                // disable this extension on GPUs with an alignment requirement higher than 4096 (should only
-                // concern a few intel iGPUs)
+                // the imported blocks are extended to the alignment, it must not go outside the host pages of the block
+                // as the guest memory is allocated and protected with this granularity
+                // disable this extension on GPUs with an alignment requirement higher than the host page size (should only
+                // concern a few intel iGPUs), 16 KiB page hosts usually have the same requirement
                 auto props = physical_device.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>();
-                support_external_memory = static_cast<bool>(props.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>().minImportedHostPointerAlignment <= 4096);
+                const uint64_t alignment = props.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>().minImportedHostPointerAlignment;
+                support_external_memory = alignment <= get_host_page_size();
+                if (support_external_memory)
+                    imported_host_pointer_alignment = std::max(static_cast<uint32_t>(alignment), KiB(4));
             }
 
             if (!support_external_memory) {
@@ -438,6 +543,25 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             }
         }
 
+        if (features.support_memory_mapping && support_external_memory) {
+            // the unmapped guest memory is left unbound, which needs sparse residency
+            support_mapped_heap = physical_device_features.sparseBinding && physical_device_features.sparseResidencyBuffer
+                && physical_device_properties.limits.sparseAddressSpaceSize >= GiB(4)
+                && (physical_device_queue_families[general_family_index].queueFlags & vk::QueueFlagBits::eSparseBinding);
+            if (support_mapped_heap) {
+                // the imported host memory must be bindable to a sparse buffer
+                const vk::PhysicalDeviceExternalBufferInfo buffer_info{
+                    .flags = vk::BufferCreateFlagBits::eSparseBinding | vk::BufferCreateFlagBits::eSparseResidency,
+                    .usage = mapped_memory_flags,
+                    .handleType = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT
+                };
+                const vk::ExternalBufferProperties props = physical_device.getExternalBufferPropertiesKHR(buffer_info);
+                support_mapped_heap = static_cast<bool>(props.externalMemoryProperties.externalMemoryFeatures & vk::ExternalMemoryFeatureFlagBits::eImportable);
+            }
+            enabled_features.sparseBinding = support_mapped_heap;
+            enabled_features.sparseResidencyBuffer = support_mapped_heap;
+        }
+
         if (features.support_memory_mapping)
             LOG_INFO("Memory mapping is enabled");
 
@@ -471,11 +595,67 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             features.support_shader_interlock = support_shader_interlock;
         }
 
+        if (support_rasterization_order) {
+            auto props = physical_device.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceRasterizationOrderAttachmentAccessFeaturesEXT>();
+            support_rasterization_order = static_cast<bool>(props.get<vk::PhysicalDeviceRasterizationOrderAttachmentAccessFeaturesEXT>().rasterizationOrderColorAttachmentAccess);
+        }
+
+        support_graphics_pipeline_library &= support_pipeline_library;
+        if (support_graphics_pipeline_library) {
+            auto props = physical_device.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+            support_graphics_pipeline_library = static_cast<bool>(props.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary);
+        }
+        if (support_graphics_pipeline_library)
+            LOG_INFO("Using graphics pipeline libraries to speed up pipeline creation");
+        pipeline_cache.use_pipeline_library = support_graphics_pipeline_library;
+
+        if (support_extended_dynamic_state) {
+            auto props = physical_device.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+            support_extended_dynamic_state = static_cast<bool>(props.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState);
+        }
+        if (support_extended_dynamic_state)
+            LOG_INFO("Using extended dynamic state to reduce the number of pipelines");
+        pipeline_cache.use_extended_dynamic_state = support_extended_dynamic_state;
+
+        if (support_timeline_semaphore) {
+            auto props = physical_device.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+            support_timeline_semaphore = static_cast<bool>(props.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore);
+        }
+        if (support_timeline_semaphore)
+            LOG_INFO("Using a timeline semaphore to wait for the GPU");
+
+        support_present_wait &= support_present_id;
+        if (support_present_wait) {
+            auto props = physical_device.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+            support_present_wait = props.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId
+                && props.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+        }
+        screen_renderer.support_present_wait = support_present_wait;
+        if (support_present_wait && screen_renderer.low_latency)
+            LOG_INFO("Waiting for the frames to be presented before starting the next one");
+
+        // timestamps are only needed on the queue used for rendering
+        const uint32_t timestamp_valid_bits = physical_device_queue_families[general_family_index].timestampValidBits;
+        support_timestamp_queries = timestamp_valid_bits > 0 && physical_device_properties.limits.timestampPeriod > 0.f;
+        if (support_timestamp_queries)
+            timestamp_mask = timestamp_valid_bits >= 64 ? ~0ULL : ((1ULL << timestamp_valid_bits) - 1);
+
+        for (uint32_t i = 0; i < physical_device_memory.memoryTypeCount; i++) {
+            if (physical_device_memory.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated)
+                support_lazily_allocated_memory = true;
+        }
+
         vk::StructureChain<vk::DeviceCreateInfo,
             vk::PhysicalDeviceBufferDeviceAddressFeatures,
             vk::PhysicalDeviceUniformBufferStandardLayoutFeatures,
             vk::PhysicalDeviceShaderFloat16Int8Features,
-            vk::PhysicalDeviceFragmentShaderInterlockFeaturesEXT>
+            vk::PhysicalDeviceFragmentShaderInterlockFeaturesEXT,
+            vk::PhysicalDeviceRasterizationOrderAttachmentAccessFeaturesEXT,
+            vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT,
+            vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT,
+            vk::PhysicalDeviceTimelineSemaphoreFeatures,
+            vk::PhysicalDevicePresentIdFeaturesKHR,
+            vk::PhysicalDevicePresentWaitFeaturesKHR>
             device_info{
                 vk::DeviceCreateInfo{
                     .pEnabledFeatures = &enabled_features },
@@ -487,7 +667,19 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
                     // FSR uses float16
                     .shaderFloat16 = VK_TRUE },
                 vk::PhysicalDeviceFragmentShaderInterlockFeaturesEXT{
-                    .fragmentShaderSampleInterlock = VK_TRUE }
+                    .fragmentShaderSampleInterlock = VK_TRUE },
+                vk::PhysicalDeviceRasterizationOrderAttachmentAccessFeaturesEXT{
+                    .rasterizationOrderColorAttachmentAccess = VK_TRUE },
+                vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT{
+                    .graphicsPipelineLibrary = VK_TRUE },
+                vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT{
+                    .extendedDynamicState = VK_TRUE },
+                vk::PhysicalDeviceTimelineSemaphoreFeatures{
+                    .timelineSemaphore = VK_TRUE },
+                vk::PhysicalDevicePresentIdFeaturesKHR{
+                    .presentId = VK_TRUE },
+                vk::PhysicalDevicePresentWaitFeaturesKHR{
+                    .presentWait = VK_TRUE }
             };
         device_info.get().setQueueCreateInfos(queue_infos);
         device_info.get().setPEnabledExtensionNames(device_extensions);
@@ -504,6 +696,23 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         if (!support_shader_interlock)
             device_info.unlink<vk::PhysicalDeviceFragmentShaderInterlockFeaturesEXT>();
 
+        if (!support_rasterization_order)
+            device_info.unlink<vk::PhysicalDeviceRasterizationOrderAttachmentAccessFeaturesEXT>();
+
+        if (!support_graphics_pipeline_library)
+            device_info.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+
+        if (!support_extended_dynamic_state)
+            device_info.unlink<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+
+        if (!support_timeline_semaphore)
+            device_info.unlink<vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+
+        if (!support_present_wait) {
+            device_info.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+            device_info.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        }
+
         try {
             device = physical_device.createDevice(device_info.get());
         } catch (vk::NotPermittedKHRError &) {
@@ -556,6 +765,9 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         if (support_dedicated_allocations)
             allocator_info.flags |= vma::AllocatorCreateFlagBits::eKhrDedicatedAllocation;
 
+        if (support_memory_budget)
+            allocator_info.flags |= vma::AllocatorCreateFlagBits::eExtMemoryBudget;
+
         if (features.support_memory_mapping)
             allocator_info.flags |= vma::AllocatorCreateFlagBits::eBufferDeviceAddress;
 
@@ -595,10 +807,14 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         default_image.sampler = device.createSampler(sampler_info);
     }
 
-    if (!screen_renderer.setup(shared_path.c_str()))
-        return false;
+    if (headless) {
+        support_fsr = false;
+    } else {
+        if (!screen_renderer.setup(shared_path.c_str()))
+            return false;
 
-    support_fsr &= static_cast<bool>(screen_renderer.surface_capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eStorage);
+        support_fsr &= static_cast<bool>(screen_renderer.surface_capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eStorage);
+    }
 
 #ifdef __linux__
     // According to my tests (Macdu), mprotect on buffers (mapped with external memory host) only works with Nvidia drivers
@@ -612,12 +828,16 @@ void VKState::late_init(const Config &cfg, const std::string_view game_id) {
     bool use_high_accuracy = cfg.current_config.high_accuracy;
 
     // shader interlock is more accurate but slower
-    if (features.support_shader_interlock && use_high_accuracy) {
+    // rasterization order access is as accurate as shader interlock while keeping the subpass input, so it is always preferred
+    if (features.support_shader_interlock && use_high_accuracy && !support_rasterization_order) {
         LOG_INFO("Using shader interlock for accurate framebuffer fetch emulation");
     } else {
         // We use subpass input to get something similar to direct fragcolor access (there is no difference for the shader)
         features.direct_fragcolor = true;
         features.support_shader_interlock = false;
+        use_rasterization_order = support_rasterization_order;
+        if (use_rasterization_order)
+            LOG_INFO("Using rasterization order attachment access for accurate framebuffer fetch emulation");
     }
 
     // texture viewport is faster but not entirely accurate
@@ -626,14 +846,57 @@ void VKState::late_init(const Config &cfg, const std::string_view game_id) {
         features.use_texture_viewport = true;
     }
 
+    pipeline_cache.async_compilation = cfg.async_pipeline_compilation;
+    if (pipeline_cache.async_compilation)
+        LOG_INFO("Pipelines are compiled asynchronously, some draws may be skipped while they are compiling");
+    pipeline_cache.optimize_shaders = cfg.spirv_optimization && shader::is_spirv_optimizer_available();
+    if (pipeline_cache.optimize_shaders)
+        LOG_INFO("Translated shaders are optimized in the background");
     pipeline_cache.init();
 
     const fs::path texture_folder = fs::path(shared_path) / "textures";
     texture_cache.init(false, texture_folder, game_id);
+    texture_cache.use_write_tracking = cfg.texture_write_tracking;
+    texture_cache.video_frames = &video_frames;
+    texture_cache.upload_stats = &texture_uploads;
+
+    // the draws must read their vertices and indices directly from the guest memory to share the same buffers
+    use_draw_batching = cfg.draw_batching && features.support_memory_mapping;
+    if (use_draw_batching)
+        LOG_INFO("Consecutive draws with the same state are merged{}", physical_device_features.multiDrawIndirect ? " into indirect draws" : "");
+
+    // the GPU frame time is needed to know when to change the resolution
+    // with only the thermal governor, the resolution is lowered only when the device heats up
+    dynamic_resolution.thermal_governor = cfg.thermal_governor && get_thermal_status() != ThermalStatus::Unsupported;
+    use_dynamic_resolution = (cfg.dynamic_resolution || dynamic_resolution.thermal_governor) && support_timestamp_queries && res_multiplier > 1;
+    if (use_dynamic_resolution && !cfg.dynamic_resolution) {
+        dynamic_resolution.min_multiplier = 1;
+        dynamic_resolution.target_frame_time = std::numeric_limits<float>::max();
+        dynamic_resolution.desired_multiplier = res_multiplier;
+        LOG_INFO("The resolution multiplier goes down from {} when the device heats up", res_multiplier);
+    } else if (use_dynamic_resolution) {
+        dynamic_resolution.min_multiplier = std::clamp(cfg.dynamic_resolution_min, 1, res_multiplier);
+        dynamic_resolution.target_frame_time = 1000.f / std::max(cfg.dynamic_resolution_target_fps, 1);
+        dynamic_resolution.desired_multiplier = res_multiplier;
+        LOG_INFO("Dynamic resolution is enabled, the resolution multiplier goes from {} to {} to render a frame in {:.2f} ms",
+            dynamic_resolution.min_multiplier, res_multiplier, dynamic_resolution.target_frame_time);
+    }
+
+    surface_cache.init();
 }
 
 void VKState::cleanup() {
-    device.waitIdle();
+    pipeline_cache.cleanup();
+    {
+        const ProfiledLockGuard guard(general_queue_mutex);
+        device.waitIdle();
+    }
+
+    if (mapped_heap.buffer)
+        device.destroyBuffer(mapped_heap.buffer);
+
+    texture_cache.cleanup();
+    surface_cache.cleanup();
 
     screen_renderer.cleanup();
 
@@ -651,7 +914,8 @@ void VKState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &v
     // we are displaying this frame, wait for a new one
     should_display = false;
 
-    if (!display.frame.base)
+    // without a window, the guest still renders its frames but they are never presented
+    if (!display.frame.base || headless)
         return;
 
     if (!screen_renderer.acquire_swapchain_image())
@@ -710,7 +974,8 @@ void VKState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &v
 }
 
 void VKState::swap_window(SDL_Window *window) {
-    screen_renderer.swap_window();
+    if (!headless)
+        screen_renderer.swap_window();
 
     // look once a frame if we need to save the pipeline cache
     const auto time_s = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
@@ -721,6 +986,19 @@ void VKState::swap_window(SDL_Window *window) {
     }
 }
 
+bool VKState::start_recording(RecordFrameCallback callback) {
+    // without a window, nothing is presented
+    if (headless)
+        return false;
+
+    return screen_renderer.start_recording(std::move(callback));
+}
+
+void VKState::stop_recording() {
+    if (!headless)
+        screen_renderer.stop_recording();
+}
+
 uint32_t VKState::get_features_mask() {
     union {
         struct {
@@ -748,6 +1026,9 @@ int VKState::get_supported_filters() {
 }
 
 void VKState::set_screen_filter(const std::string_view &filter) {
+    if (headless)
+        return;
+
     if (filter == "FSR" && !support_fsr) {
         LOG_WARN("Trying to enable FSR but the GPU does not support it");
         screen_renderer.set_filter("");
@@ -756,23 +1037,115 @@ void VKState::set_screen_filter(const std::string_view &filter) {
     }
 }
 
-bool VKState::map_memory(MemState &mem, Ptr<void> address, uint32_t size) {
+static constexpr uint32_t MAPPED_PAGE_SIZE = KiB(4);
+
+static void set_mapped_pages(VKState &state, const Address address, const uint32_t size, const MappedMemory *mapped_memory) {
+    if (!state.mapped_pages)
+        state.mapped_pages = std::make_unique<const MappedMemory *[]>(GiB(4) / MAPPED_PAGE_SIZE);
+
+    const uint64_t end_page = (static_cast<uint64_t>(address) + size + MAPPED_PAGE_SIZE - 1) / MAPPED_PAGE_SIZE;
+    for (uint64_t page = address / MAPPED_PAGE_SIZE; page < end_page; page++)
+        state.mapped_pages[page] = mapped_memory;
+}
+
+static void init_mapped_heap(VKState &state) {
+    vk::StructureChain<vk::BufferCreateInfo, vk::ExternalMemoryBufferCreateInfoKHR> buffer_info{
+        vk::BufferCreateInfo{
+            .flags = vk::BufferCreateFlagBits::eSparseBinding | vk::BufferCreateFlagBits::eSparseResidency,
+            .size = GiB(4),
+            .usage = mapped_memory_flags,
+            .sharingMode = vk::SharingMode::eExclusive },
+        vk::ExternalMemoryBufferCreateInfoKHR{
+            .handleTypes = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT }
+    };
+
+    try {
+        state.mapped_heap.buffer = state.device.createBuffer(buffer_info.get());
+    } catch (vk::SystemError &err) {
+        LOG_WARN("Could not create the mapped memory heap, each mapped block gets its own buffer: {}", err.what());
+        state.support_mapped_heap = false;
+        return;
+    }
+
+    const vk::MemoryRequirements requirements = state.device.getBufferMemoryRequirements(state.mapped_heap.buffer);
+    state.mapped_heap.alignment = requirements.alignment;
+    state.mapped_heap.memory_type_bits = requirements.memoryTypeBits;
+
+    vk::BufferDeviceAddressInfoKHR address_info{
+        .buffer = state.mapped_heap.buffer
+    };
+    state.mapped_heap.buffer_address = state.device.getBufferAddress(address_info);
+    LOG_INFO("Mapped memory is bound to a single buffer over the guest memory, with {} KiB sparse blocks", state.mapped_heap.alignment / KiB(1));
+}
+
+// bind the given guest range of the mapped heap to the memory, or unbind it if the memory is null
+static void bind_mapped_heap(VKState &state, const Address address, const uint32_t size, const vk::DeviceMemory memory) {
+    const vk::SparseMemoryBind bind{
+        .resourceOffset = address,
+        .size = size,
+        .memory = memory,
+        .memoryOffset = 0
+    };
+    vk::SparseBufferMemoryBindInfo buffer_bind{
+        .buffer = state.mapped_heap.buffer
+    };
+    buffer_bind.setBinds(bind);
+    vk::BindSparseInfo bind_info{};
+    bind_info.setBufferBinds(buffer_bind);
+
+    // mapping and unmapping are rare, wait for the binding to be done before anything using it is submitted
+    const ProfiledLockGuard guard(state.general_queue_mutex);
+    state.general_queue.bindSparse(bind_info);
+    state.general_queue.waitIdle();
+}
+
+// allocate the buffer holding a guest block in the resizable BAR heap, return false if it does not fit
+static bool init_rebar_mapped_buffer(VKState &state, vkutil::Buffer &buffer, const uint32_t attribs) {
+    // the CPU reads of this heap are uncached, the blocks the GPU writes to (surfaces) are read back by the guest
+    if (!state.use_rebar_mapped_memory || (attribs & SCE_GXM_MEMORY_ATTRIB_WRITE))
+        return false;
+    if (state.mapped_device_local_bytes + buffer.size > state.rebar_mapped_budget)
+        return false;
+
+    constexpr vma::AllocationCreateInfo rebar_mapped_alloc = {
+        .flags = vma::AllocationCreateFlagBits::eMapped,
+        .requiredFlags = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+    };
+    try {
+        buffer.init_buffer(mapped_memory_flags, rebar_mapped_alloc);
+    } catch (vk::SystemError &) {
+        // the heap is also used by the other allocations, it can be full before the budget is reached
+        LOG_WARN_ONCE("The resizable BAR heap is full, the next guest blocks are mapped from the host memory");
+        return false;
+    }
+
+    return true;
+}
+
+bool VKState::map_memory(MemState &mem, Ptr<void> address, uint32_t size, uint32_t attribs) {
     assert(features.support_memory_mapping);
     // the adress should be 4K aligned
     assert((address.address() & 4095) == 0);
-    constexpr vk::BufferUsageFlags mapped_memory_flags = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferDst;
 
     if (mem.use_page_table) {
         // add 4 KiB because we can as an easy way to prevent crashes due to memory accesses right after the memory boundary
         // also make sure later the mapped address is 4K aligned
         vkutil::Buffer buffer(allocator, size + KiB(4));
-        constexpr vma::AllocationCreateInfo memory_mapped_alloc = {
-            .flags = vma::AllocationCreateFlagBits::eMapped,
-            .usage = vma::MemoryUsage::eAutoPreferHost,
-            .requiredFlags = vk::MemoryPropertyFlagBits::eHostCoherent,
-            .preferredFlags = vk::MemoryPropertyFlagBits::eHostCached,
-        };
-        buffer.init_buffer(mapped_memory_flags, memory_mapped_alloc);
+        const bool device_local = init_rebar_mapped_buffer(*this, buffer, attribs);
+        if (device_local) {
+            mapped_device_local_bytes += buffer.size;
+        } else {
+            constexpr vma::AllocationCreateInfo memory_mapped_alloc = {
+                .flags = vma::AllocationCreateFlagBits::eMapped,
+                .usage = vma::MemoryUsage::eAutoPreferHost,
+                .requiredFlags = vk::MemoryPropertyFlagBits::eHostCoherent,
+                .preferredFlags = vk::MemoryPropertyFlagBits::eHostCached,
+            };
+            buffer.init_buffer(mapped_memory_flags, memory_mapped_alloc);
+            // only this path allocates host memory, the other one imports the guest memory
+            add_memory_usage(MemoryCategory::MappedMemory, size + KiB(4));
+            mapped_host_bytes += buffer.size;
+        }
         const uint64_t buffer_ptr_val = std::bit_cast<uint64_t>(buffer.mapped_data);
         const uint64_t buffer_offset = align(buffer_ptr_val, KiB(4)) - buffer_ptr_val;
         buffer.mapped_data = std::bit_cast<void *>(buffer_ptr_val + buffer_offset);
@@ -784,15 +1157,28 @@ bool VKState::map_memory(MemState &mem, Ptr<void> address, uint32_t size) {
         const vk::Buffer mapped_buffer = buffer.buffer;
 
         add_external_mapping(mem, address.address(), size, reinterpret_cast<uint8_t *>(buffer.mapped_data));
-        mapped_memories[address.address()] = { address.address(), std::move(buffer), mapped_buffer, size, buffer_address };
+        const MappedMemory &mapped_memory = mapped_memories[address.address()] = { address.address(), std::move(buffer), mapped_buffer, size, buffer_address, device_local };
+        set_mapped_pages(*this, address.address(), size, &mapped_memory);
     } else {
-        void *host_address = address.get(mem);
+        // the guest blocks are only 4 KiB aligned, import the whole host pages containing them
+        const Address import_address = align_down(address.address(), imported_host_pointer_alignment);
+        const uint32_t import_size = align(address.address() + size, imported_host_pointer_alignment) - import_address;
+        void *host_address = Ptr<void>(import_address).get(mem);
         auto host_mem_props = device.getMemoryHostPointerPropertiesEXT(vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, host_address);
         assert(host_mem_props.memoryTypeBits != 0);
 
+        if (support_mapped_heap && !mapped_heap.buffer)
+            init_mapped_heap(*this);
+
+        // the block is bound to the mapped heap if it is aligned on its sparse blocks and can use its memory types
+        const bool use_mapped_heap = mapped_heap.buffer && import_address == address.address() && import_size == size
+            && address.address() % mapped_heap.alignment == 0 && size % mapped_heap.alignment == 0
+            && (host_mem_props.memoryTypeBits & mapped_heap.memory_type_bits) != 0;
+        const uint32_t memory_type_bits = use_mapped_heap ? (host_mem_props.memoryTypeBits & mapped_heap.memory_type_bits) : host_mem_props.memoryTypeBits;
+
         int mapped_memory_type = -1;
         auto find_mem_type_with_flag = [&](const vk::MemoryPropertyFlags flags) {
-            uint32_t host_mem_types = host_mem_props.memoryTypeBits;
+            uint32_t host_mem_types = memory_type_bits;
             while (host_mem_types != 0) {
                 // try to find a cached memory type
                 mapped_memory_type = std::countr_zero(host_mem_types);
@@ -813,12 +1199,12 @@ bool VKState::map_memory(MemState &mem, Ptr<void> address, uint32_t size) {
 
         if (mapped_memory_type == -1) {
             LOG_CRITICAL_ONCE("No coherent memory available for memory mapping, this may be caused by an old driver!");
-            mapped_memory_type = std::countr_zero(host_mem_props.memoryTypeBits);
+            mapped_memory_type = std::countr_zero(memory_type_bits);
         }
 
         vk::StructureChain<vk::MemoryAllocateInfo, vk::ImportMemoryHostPointerInfoEXT, vk::MemoryAllocateFlagsInfo> alloc_info{
             vk::MemoryAllocateInfo{
-                .allocationSize = size,
+                .allocationSize = import_size,
                 .memoryTypeIndex = static_cast<uint32_t>(mapped_memory_type) },
             vk::ImportMemoryHostPointerInfoEXT{
                 .handleType = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT,
@@ -827,10 +1213,19 @@ bool VKState::map_memory(MemState &mem, Ptr<void> address, uint32_t size) {
                 .flags = vk::MemoryAllocateFlagBits::eDeviceAddress }
         };
         const vk::DeviceMemory device_memory = device.allocateMemory(alloc_info.get());
+        mapped_host_bytes += import_size;
+
+        if (use_mapped_heap) {
+            // the buffer and device address of this block are the ones of the heap
+            bind_mapped_heap(*this, address.address(), size, device_memory);
+            const MappedMemory &mapped_memory = mapped_memories[address.address()] = { 0, device_memory, mapped_heap.buffer, size, mapped_heap.buffer_address };
+            set_mapped_pages(*this, address.address(), size, &mapped_memory);
+            return true;
+        }
 
         vk::StructureChain<vk::BufferCreateInfo, vk::ExternalMemoryBufferCreateInfoKHR> buffer_info{
             vk::BufferCreateInfo{
-                .size = size,
+                .size = import_size,
                 .usage = mapped_memory_flags,
                 .sharingMode = vk::SharingMode::eExclusive },
             vk::ExternalMemoryBufferCreateInfoKHR{
@@ -844,7 +1239,9 @@ bool VKState::map_memory(MemState &mem, Ptr<void> address, uint32_t size) {
         };
         const uint64_t buffer_address = device.getBufferAddress(address_info);
 
-        mapped_memories[address.address()] = { address.address(), device_memory, mapped_buffer, size, buffer_address };
+        // the offsets in the buffer are relative to the start of the imported pages
+        const MappedMemory &mapped_memory = mapped_memories[address.address()] = { import_address, device_memory, mapped_buffer, size, buffer_address };
+        set_mapped_pages(*this, address.address(), size, &mapped_memory);
     }
 
     return true;
@@ -860,37 +1257,49 @@ void VKState::unmap_memory(MemState &mem, Ptr<void> address) {
     }
 
     // we need to wait in case the buffer is being used
-    device.waitIdle();
+    {
+        const ProfiledLockGuard guard(general_queue_mutex);
+        device.waitIdle();
+    }
 
     if (!mem.use_page_table) {
-        device.destroyBuffer(ite->second.buffer);
+        if (ite->second.buffer == mapped_heap.buffer)
+            bind_mapped_heap(*this, ite->first, ite->second.size, nullptr);
+        else
+            device.destroyBuffer(ite->second.buffer);
         device.freeMemory(std::get<vk::DeviceMemory>(ite->second.buffer_impl));
+        mapped_host_bytes -= align(ite->first + ite->second.size, imported_host_pointer_alignment) - align_down(ite->first, imported_host_pointer_alignment);
     } else {
         remove_external_mapping(mem, address.cast<uint8_t>().get(mem));
+        if (ite->second.device_local) {
+            mapped_device_local_bytes -= ite->second.size + KiB(4);
+        } else {
+            remove_memory_usage(MemoryCategory::MappedMemory, ite->second.size + KiB(4));
+            mapped_host_bytes -= ite->second.size + KiB(4);
+        }
     }
+    set_mapped_pages(*this, ite->first, ite->second.size, nullptr);
     mapped_memories.erase(ite);
 }
 
 std::tuple<vk::Buffer, uint32_t> VKState::get_matching_mapping(const Ptr<void> address) {
-    auto mapped_memory = mapped_memories.lower_bound(address.address());
-    if (mapped_memory == mapped_memories.end()
-        || mapped_memory->first + mapped_memory->second.size < address.address()) {
+    const MappedMemory *mapped_memory = mapped_pages ? mapped_pages[address.address() / MAPPED_PAGE_SIZE] : nullptr;
+    if (!mapped_memory) {
         LOG_ERROR("Could not find matching mapped buffer for vertex stream");
         return { nullptr, 0 };
     }
 
-    return std::make_tuple(mapped_memory->second.buffer, address.address() - mapped_memory->first);
+    return std::make_tuple(mapped_memory->buffer, address.address() - mapped_memory->address);
 }
 
 uint64_t VKState::get_matching_device_address(const Address address) {
-    auto mapped_memory = mapped_memories.lower_bound(address);
-    if (mapped_memory == mapped_memories.end()
-        || mapped_memory->first + mapped_memory->second.size < address) {
+    const MappedMemory *mapped_memory = mapped_pages ? mapped_pages[address / MAPPED_PAGE_SIZE] : nullptr;
+    if (!mapped_memory) {
         LOG_ERROR("Could not find matching mapped buffer for vertex stream");
         return 0;
     }
 
-    return mapped_memory->second.buffer_address + address - mapped_memory->first;
+    return mapped_memory->buffer_address + address - mapped_memory->address;
 }
 
 int VKState::get_max_anisotropic_filtering() {
@@ -929,8 +1338,50 @@ void VKState::precompile_shader(const ShadersHash &hash) {
         pipeline_cache.precompile_shader(hash.frag);
     }
 
-    programs_count_pre_compiled++;
-    LOG_INFO("Program Compiled {}/{}", programs_count_pre_compiled, shaders_cache_hashs.size());
+    const uint32_t programs_count = ++programs_count_pre_compiled;
+    LOG_INFO("Program Compiled {}/{}", programs_count, shaders_cache_hashs.size());
+}
+
+void VKState::prepare_shader(const SceGxmProgram &program, const Sha256Hash &hash, bool is_vertex, const std::vector<SceGxmVertexAttribute> &attributes, const TextureInfo &textures_used) {
+    pipeline_cache.prepare_shader(program, hash, is_vertex, attributes, textures_used);
+}
+
+bool VKState::start_parallel_precompile() {
+    // loading the spir-v from the disk and creating the shader modules can be done on any thread
+    const uint32_t nb_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    LOG_INFO("Precompiling shaders using {} threads", nb_threads);
+
+    next_precompile_idx = 0;
+    precompile_workers_running = nb_threads;
+    for (uint32_t i = 0; i < nb_threads; i++) {
+        precompile_workers.emplace_back([this]() {
+            while (true) {
+                const size_t idx = next_precompile_idx++;
+                if (idx >= shaders_cache_hashs.size())
+                    break;
+
+                precompile_shader(shaders_cache_hashs[idx]);
+            }
+            precompile_workers_running--;
+        });
+    }
+
+    return true;
+}
+
+bool VKState::is_parallel_precompile_done() {
+    if (precompile_workers_running > 0)
+        return false;
+
+    for (auto &worker : precompile_workers)
+        worker.join();
+    precompile_workers.clear();
+
+    return true;
+}
+
+void VKState::precompile_pipelines() {
+    pipeline_cache.precompile_pipelines();
 }
 
 void VKState::preclose_action() {
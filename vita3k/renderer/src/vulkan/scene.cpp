@@ -25,6 +25,11 @@
 
 #include <util/align.h>
 #include <util/log.h>
+#include <util/performance_hint.h>
+
+#include <xxh3.h>
+
+#include <bit>
 
 namespace renderer::vulkan {
 
@@ -84,6 +89,7 @@ void mid_scene_flush(VKContext &context, const SceGxmNotification notification)
         .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
         .dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead,
     };
+    context.flush_pending_draws();
     context.render_cmd.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader, vk::PipelineStageFlagBits::eVertexInput,
         vk::DependencyFlags(), barrier, {}, {});
 
@@ -96,26 +102,175 @@ void mid_scene_flush(VKContext &context, const SceGxmNotification notification)
     }
 }
 
+// highest resolution multiplier the device can sustain without heating more
+static int get_thermal_max_multiplier(const VKState &state) {
+    if (!state.dynamic_resolution.thermal_governor)
+        return state.max_res_multiplier;
+
+    switch (get_thermal_status()) {
+    case ThermalStatus::Unsupported:
+    case ThermalStatus::None:
+    case ThermalStatus::Light:
+        return state.max_res_multiplier;
+    case ThermalStatus::Moderate:
+        return state.max_res_multiplier - 1;
+    case ThermalStatus::Severe:
+        return state.max_res_multiplier / 2;
+    default:
+        return 1;
+    }
+}
+
+static void update_dynamic_resolution(VKState &state, float gpu_frame_time) {
+    // frames needed for the average to settle before the multiplier is reconsidered
+    constexpr uint32_t SETTLE_FRAMES = 60;
+
+    DynamicResolution &dynamic_resolution = state.dynamic_resolution;
+    if (dynamic_resolution.average_frame_time == 0.f)
+        dynamic_resolution.average_frame_time = gpu_frame_time;
+    else
+        dynamic_resolution.average_frame_time = dynamic_resolution.average_frame_time * 0.9f + gpu_frame_time * 0.1f;
+
+    if (++dynamic_resolution.stable_frames < SETTLE_FRAMES)
+        return;
+
+    const int multiplier = state.res_multiplier;
+    const int max_multiplier = std::max(get_thermal_max_multiplier(state), dynamic_resolution.min_multiplier);
+    const float average = dynamic_resolution.average_frame_time;
+    const float target = dynamic_resolution.target_frame_time;
+    int desired_multiplier = multiplier;
+    if (multiplier > max_multiplier) {
+        desired_multiplier = max_multiplier;
+    } else if (average > target && multiplier > dynamic_resolution.min_multiplier) {
+        desired_multiplier = multiplier - 1;
+    } else if (multiplier < max_multiplier) {
+        // the GPU time grows with the number of pixels, keep some margin to not go back and forth
+        const float pixel_ratio = static_cast<float>((multiplier + 1) * (multiplier + 1)) / (multiplier * multiplier);
+        if (average * pixel_ratio < target * 0.8f)
+            desired_multiplier = multiplier + 1;
+    }
+
+    if (desired_multiplier != dynamic_resolution.desired_multiplier) {
+        dynamic_resolution.desired_multiplier = desired_multiplier;
+        dynamic_resolution.stable_frames = 0;
+    }
+}
+
+#ifdef TRACY_ENABLE
+static const ___tracy_source_location_data TRACY_SCENE_LOCATION = { "Scene", "read_frame_timestamps", __FILE__, __LINE__, 0 };
+static const ___tracy_source_location_data TRACY_RENDER_PASS_LOCATION = { "Render pass", "read_frame_timestamps", __FILE__, __LINE__, 0 };
+
+static void create_tracy_gpu_context(VKContext &context) {
+    // Tracy matches the GPU clock with the CPU one using a timestamp taken right now
+    VKState &state = context.state;
+    vk::CommandBuffer cmd_buffer = vkutil::create_single_time_command(state.device, state.general_command_pool);
+    cmd_buffer.resetQueryPool(context.frame().timestamp_pool, 0, 1);
+    cmd_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, context.frame().timestamp_pool, 0);
+    {
+        const ProfiledLockGuard guard(state.general_queue_mutex);
+        vkutil::end_single_time_command(state.device, state.general_queue, state.general_command_pool, cmd_buffer);
+    }
+
+    uint64_t gpu_time = 0;
+    if (state.device.getQueryPoolResults(context.frame().timestamp_pool, 0, 1, sizeof(uint64_t), &gpu_time, sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait) != vk::Result::eSuccess)
+        return;
+
+    context.tracy_gpu_context = tracy_gpu_new_context("Vita3K GPU", static_cast<int64_t>(gpu_time), state.physical_device_properties.limits.timestampPeriod);
+}
+#endif
+
+static void read_frame_timestamps(VKContext &context, FrameObject &frame) {
+    if (frame.timestamp_count == 0)
+        return;
+
+    VKState &state = context.state;
+    std::array<uint64_t, MAX_FRAME_TIMESTAMPS> timestamps;
+    const vk::Result result = state.device.getQueryPoolResults(frame.timestamp_pool, 0, frame.timestamp_count, frame.timestamp_count * sizeof(uint64_t),
+        timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    const std::vector<SceneTimestamps> scene_timestamps = std::move(frame.scene_timestamps);
+    frame.timestamp_count = 0;
+    frame.scene_timestamps.clear();
+
+    // some submissions of the frame may not have been done, don't wait for them
+    if (result != vk::Result::eSuccess)
+        return;
+
+#ifdef TRACY_ENABLE
+    const bool emit_tracy_zones = context.tracy_gpu_context.has_value() && TracyIsConnected;
+#endif
+
+    // sum the time of all the scenes, the time between them is spent waiting for the CPU
+    const float period = state.physical_device_properties.limits.timestampPeriod;
+    const auto to_ms = [&](uint64_t ticks) { return static_cast<float>(ticks) * period / 1e6f; };
+    std::vector<GpuSceneTime> scene_times;
+    scene_times.reserve(scene_timestamps.size());
+    uint64_t ticks = 0;
+    for (const SceneTimestamps &scene : scene_timestamps) {
+        const uint64_t scene_ticks = (timestamps[scene.end_idx] - timestamps[scene.begin_idx]) & state.timestamp_mask;
+        ticks += scene_ticks;
+
+        uint64_t render_pass_ticks = 0;
+        for (uint32_t i = scene.begin_idx + 1; i + 1 < scene.end_idx; i += 2)
+            render_pass_ticks += (timestamps[i + 1] - timestamps[i]) & state.timestamp_mask;
+
+        scene_times.push_back({
+            .color_address = scene.color_address,
+            .width = scene.width,
+            .height = scene.height,
+            .time = to_ms(scene_ticks),
+            .render_pass_time = to_ms(render_pass_ticks),
+        });
+
+#ifdef TRACY_ENABLE
+        if (emit_tracy_zones) {
+            TracyGpuContext &tracy_context = *context.tracy_gpu_context;
+            tracy_gpu_zone_begin(tracy_context, &TRACY_SCENE_LOCATION, timestamps[scene.begin_idx]);
+            for (uint32_t i = scene.begin_idx + 1; i + 1 < scene.end_idx; i += 2) {
+                tracy_gpu_zone_begin(tracy_context, &TRACY_RENDER_PASS_LOCATION, timestamps[i]);
+                tracy_gpu_zone_end(tracy_context, timestamps[i + 1]);
+            }
+            tracy_gpu_zone_end(tracy_context, timestamps[scene.end_idx]);
+        }
+#endif
+    }
+
+    const float gpu_frame_time = to_ms(ticks);
+    state.gpu_frame_time = gpu_frame_time;
+    {
+        const std::lock_guard<std::mutex> lock(state.gpu_scene_times_mutex);
+        state.gpu_scene_times = std::move(scene_times);
+    }
+    if (state.use_dynamic_resolution)
+        update_dynamic_resolution(state, gpu_frame_time);
+}
+
 void new_frame(VKContext &context) {
-    if (context.state.features.support_memory_mapping) {
+    if (context.state.features.support_memory_mapping && !context.timeline_semaphore) {
         FrameDoneRequest request = { context.frame_timestamp };
         context.request_queue.push(request);
     }
 
     context.frame_timestamp++;
-    context.current_frame_idx = context.frame_timestamp % MAX_FRAMES_RENDERING;
+    context.current_frame_idx = context.frame_timestamp % context.state.frames_in_flight;
 
     vk::Device device = context.state.device;
     FrameObject &frame = context.frame();
 
-    // wait on all fences still present to make sure
-    if (!frame.rendered_fences.empty()) {
+    if (context.timeline_semaphore) {
+        // the frame is no longer used once the timeline has reached the value of its last submission
+        // no fence to reset and no need to go through the wait thread
+        if (frame.last_timeline_value > 0) {
+            context.wait_for_submission(nullptr, frame.last_timeline_value);
+            frame.last_timeline_value = 0;
+        }
+    } else if (!frame.rendered_fences.empty()) {
+        // wait on all fences still present to make sure
         // wait for the fences, then reset them
 
         if (context.state.features.support_memory_mapping) {
-            // this will underflow for the first MAX_FRAMES_RENDERING frames
+            // this will underflow for the first frames_in_flight frames
             // but that's not an issue as frame.rendered_fences will be empty
-            uint64_t previous_frame_timestamp = context.frame_timestamp - MAX_FRAMES_RENDERING;
+            uint64_t previous_frame_timestamp = context.frame_timestamp - context.state.frames_in_flight;
 
             // the wait is done by the wait thread
             std::unique_lock<std::mutex> lock(context.new_frame_mutex);
@@ -136,16 +291,58 @@ void new_frame(VKContext &context) {
         frame.rendered_fences.clear();
     }
 
+    if (frame.gxm_transfer_idx > 0) {
+        // the transfers done between the scenes are not tracked by the rendered fences
+        if (!context.timeline_semaphore) {
+            const vk::ArrayProxy<const vk::Fence> transfer_fences(frame.gxm_transfer_idx, frame.gxm_transfer_fences.data());
+            if (device.waitForFences(transfer_fences, VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+                LOG_ERROR("Could not wait for fences.");
+                assert(false);
+            }
+            device.resetFences(transfer_fences);
+        }
+        frame.gxm_transfer_idx = 0;
+    }
+
+    // all the submissions of the frame are done, their timestamps are available
+    read_frame_timestamps(context, frame);
+#ifdef TRACY_ENABLE
+    if (frame.timestamp_pool && !context.tracy_gpu_context && TracyIsConnected)
+        create_tracy_gpu_context(context);
+#endif
+
     device.resetCommandPool(frame.prerender_pool);
     device.resetCommandPool(frame.render_pool);
+    if (frame.transfer_pool) {
+        device.resetCommandPool(frame.transfer_pool);
+        frame.transfer_idx = 0;
+    }
     device.resetDescriptorPool(frame.descriptor_pool);
+    frame.texture_descriptor_sets.clear();
 
     // deferred destruction of the objects
     frame.destroy_queue.destroy_objects();
 
+    context.state.texture_cache.update_memory_budget();
+    context.state.surface_cache.purge_image_pool();
+
     context.last_vert_texture_count = ~0;
     context.last_frag_texture_count = ~0;
 
+    if (context.state.use_draw_batching) {
+        context.state.frame_draw_count = context.frame_draw_count;
+        context.state.frame_draw_command_count = context.frame_draw_command_count;
+        context.frame_draw_count = 0;
+        context.frame_draw_command_count = 0;
+    }
+
+    context.state.frame_render_pass_count = context.frame_render_pass_count;
+    context.state.frame_elided_load_count = context.frame_elided_load_count;
+    context.state.frame_elided_store_count = context.frame_elided_store_count;
+    context.frame_render_pass_count = 0;
+    context.frame_elided_load_count = 0;
+    context.frame_elided_store_count = 0;
+
     frame.frame_timestamp = context.frame_timestamp;
 }
 
@@ -166,10 +363,10 @@ void restride_stream(const uint8_t *&stream, uint32_t &size, uint32_t stride) {
 }
 #endif
 
-static void draw_bind_descriptors(VKContext &context, MemState &mem) {
+static void draw_get_descriptors(VKContext &context, MemState &mem, DrawState &draw_state) {
     VKState &state = context.state;
 
-    std::array<vk::DescriptorSet, 4> descriptors;
+    std::array<vk::DescriptorSet, 4> &descriptors = draw_state.descriptors;
     descriptors[0] = context.global_set;
     descriptors[1] = context.rendertarget_set;
 
@@ -180,7 +377,7 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
         context.record.fragment_program.get(mem)->renderer_data.get())
                                                 ->texture_count;
 
-    vk::PipelineLayout pipeline_layout = state.pipeline_cache.pipeline_layouts[vertex_textures_count][fragment_texture_count];
+    draw_state.pipeline_layout = state.pipeline_cache.pipeline_layouts[vertex_textures_count][fragment_texture_count];
 
     // try to use last descriptor if it still matches
     bool need_vert_descr = (vertex_textures_count != context.last_vert_texture_count);
@@ -189,36 +386,6 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
     context.last_vert_texture_count = vertex_textures_count;
     context.last_frag_texture_count = fragment_texture_count;
 
-    {
-        vk::DescriptorSetAllocateInfo descr_set_info{
-            .descriptorPool = context.frame().descriptor_pool
-        };
-        std::vector<vk::DescriptorSetLayout> layouts;
-        if (need_vert_descr)
-            layouts.push_back(state.pipeline_cache.vertex_textures_layout[vertex_textures_count]);
-        if (need_frag_descr)
-            layouts.push_back(state.pipeline_cache.fragment_textures_layout[fragment_texture_count]);
-
-        std::vector<vk::DescriptorSet> sets;
-        if (!layouts.empty()) {
-            descr_set_info.setSetLayouts(layouts);
-            sets = state.device.allocateDescriptorSets(descr_set_info);
-        }
-
-        int set_idx = 0;
-        if (need_vert_descr) {
-            context.last_vert_texture_descriptor = sets[set_idx++];
-        }
-        descriptors[2] = context.last_vert_texture_descriptor;
-
-        if (need_frag_descr) {
-            context.last_frag_texture_descriptor = sets[set_idx++];
-        }
-        descriptors[3] = context.last_frag_texture_descriptor;
-    }
-
-    // bind textures
-    std::array<vk::WriteDescriptorSet, 16> write_descrs;
     // some default sampler in case a slot has never been set and we read a slot with higher idx
     vk::DescriptorImageInfo default_image_info{
         .sampler = context.state.default_image.sampler,
@@ -226,36 +393,60 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
         .imageLayout = vk::ImageLayout::eGeneral
     };
 
-    // vertex
-    if (need_vert_descr) {
-        for (uint32_t i = 0; i < vertex_textures_count; i++) {
-            write_descrs[i] = vk::WriteDescriptorSet{
-                .dstSet = descriptors[2],
-                .dstBinding = i,
-                .dstArrayElement = 0,
-                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            };
-            write_descrs[i].setImageInfo(context.vertex_textures[i].sampler ? context.vertex_textures[i] : default_image_info);
+    // look for a set with the same textures in the ones already allocated this frame, create it otherwise
+    auto get_texture_descriptor = [&](const bool is_vertex, const uint16_t texture_count) -> vk::DescriptorSet {
+        const vk::DescriptorImageInfo *bound_textures = is_vertex ? context.vertex_textures : context.fragment_textures;
+        std::array<vk::DescriptorImageInfo, SCE_GXM_MAX_TEXTURE_UNITS> image_infos;
+        // don't hash the structures directly, their padding is not initialized
+        std::array<uint64_t, SCE_GXM_MAX_TEXTURE_UNITS * 3> key;
+        for (uint32_t i = 0; i < texture_count; i++) {
+            image_infos[i] = bound_textures[i].sampler ? bound_textures[i] : default_image_info;
+            key[i * 3] = std::bit_cast<uint64_t>(static_cast<VkSampler>(image_infos[i].sampler));
+            key[i * 3 + 1] = std::bit_cast<uint64_t>(static_cast<VkImageView>(image_infos[i].imageView));
+            key[i * 3 + 2] = static_cast<uint64_t>(image_infos[i].imageLayout);
         }
-        state.device.updateDescriptorSets(vertex_textures_count, write_descrs.data(), 0, nullptr);
-    }
 
-    // fragment
-    if (need_frag_descr) {
-        for (uint32_t i = 0; i < fragment_texture_count; i++) {
+        // the set layout only depends on the stage and the texture count, both are part of the hash
+        const uint64_t hash = XXH3_64bits_withSeed(key.data(), texture_count * 3 * sizeof(uint64_t), is_vertex);
+        FrameObject &frame = context.frame();
+        auto it = frame.texture_descriptor_sets.find(hash);
+        if (it != frame.texture_descriptor_sets.end())
+            return it->second;
+
+        vk::DescriptorSetAllocateInfo descr_set_info{
+            .descriptorPool = frame.descriptor_pool
+        };
+        descr_set_info.setSetLayouts(is_vertex
+                ? state.pipeline_cache.vertex_textures_layout[texture_count]
+                : state.pipeline_cache.fragment_textures_layout[texture_count]);
+        const vk::DescriptorSet descriptor_set = state.device.allocateDescriptorSets(descr_set_info)[0];
+
+        std::array<vk::WriteDescriptorSet, SCE_GXM_MAX_TEXTURE_UNITS> write_descrs;
+        for (uint32_t i = 0; i < texture_count; i++) {
             write_descrs[i] = vk::WriteDescriptorSet{
-                .dstSet = descriptors[3],
+                .dstSet = descriptor_set,
                 .dstBinding = i,
                 .dstArrayElement = 0,
                 .descriptorType = vk::DescriptorType::eCombinedImageSampler,
             };
-            write_descrs[i].setImageInfo(context.fragment_textures[i].sampler ? context.fragment_textures[i] : default_image_info);
+            write_descrs[i].setImageInfo(image_infos[i]);
         }
-        state.device.updateDescriptorSets(fragment_texture_count, write_descrs.data(), 0, nullptr);
-    }
+        state.device.updateDescriptorSets(texture_count, write_descrs.data(), 0, nullptr);
+
+        frame.texture_descriptor_sets[hash] = descriptor_set;
+        return descriptor_set;
+    };
 
-    const uint32_t dynamic_offset_count = state.features.support_memory_mapping ? 2U : 4U;
-    const uint32_t dynamic_offsets[] = {
+    if (need_vert_descr)
+        context.last_vert_texture_descriptor = get_texture_descriptor(true, vertex_textures_count);
+    descriptors[2] = context.last_vert_texture_descriptor;
+
+    if (need_frag_descr)
+        context.last_frag_texture_descriptor = get_texture_descriptor(false, fragment_texture_count);
+    descriptors[3] = context.last_frag_texture_descriptor;
+
+    draw_state.dynamic_offset_count = state.features.support_memory_mapping ? 2U : 4U;
+    draw_state.dynamic_offsets = {
         // GXMRenderVertUniformBlock
         context.vertex_info_uniform_buffer.data_offset,
         // GXMRenderFragUniformBlock
@@ -265,12 +456,12 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
         // fragment ssbo
         context.fragment_uniform_stream_ring_buffer.data_offset
     };
-
-    context.render_cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0,
-        descriptors.size(), descriptors.data(), dynamic_offset_count, dynamic_offsets);
+    // only the used offsets are compared between draws
+    for (uint32_t i = draw_state.dynamic_offset_count; i < draw_state.dynamic_offsets.size(); i++)
+        draw_state.dynamic_offsets[i] = 0;
 }
 
-static void bind_vertex_streams(VKContext &context, MemState &mem) {
+static void get_vertex_streams(VKContext &context, MemState &mem, DrawState &draw_state) {
     GxmRecordState &state = context.record;
     const SceGxmVertexProgram &vertex_program = *state.vertex_program.get(mem);
     VertexProgram *vkvert = vertex_program.renderer_data.get();
@@ -299,6 +490,7 @@ static void bind_vertex_streams(VKContext &context, MemState &mem) {
     }
     max_stream_idx++;
 
+    draw_state.vertex_stream_count = max_stream_idx;
     if (max_stream_idx == 0)
         return;
 
@@ -334,7 +526,18 @@ static void bind_vertex_streams(VKContext &context, MemState &mem) {
         }
     }
 
-    context.render_cmd.bindVertexBuffers(0, max_stream_idx, context.vertex_stream_buffers, context.vertex_stream_offsets);
+    std::copy_n(context.vertex_stream_buffers, max_stream_idx, draw_state.vertex_buffers.begin());
+    std::copy_n(context.vertex_stream_offsets, max_stream_idx, draw_state.vertex_offsets.begin());
+}
+
+static void bind_draw_state(VKContext &context, const DrawState &draw_state) {
+    context.render_cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, draw_state.pipeline_layout, 0,
+        draw_state.descriptors.size(), draw_state.descriptors.data(), draw_state.dynamic_offset_count, draw_state.dynamic_offsets.data());
+
+    if (draw_state.vertex_stream_count > 0)
+        context.render_cmd.bindVertexBuffers(0, draw_state.vertex_stream_count, draw_state.vertex_buffers.data(), draw_state.vertex_offsets.data());
+
+    context.render_cmd.bindIndexBuffer(draw_state.index_buffer, draw_state.index_offset, draw_state.index_type);
 }
 
 void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format,
@@ -346,18 +549,21 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     if (!context.in_renderpass)
         context.start_render_pass();
 
+    context.frame_draw_count++;
+
     // when we do multiple render pass for one scene (shader interlock or slow macroblock),
     // we need to always load the depth-stencil after the first draw
     if (context.is_first_scene_draw && (context.state.features.support_shader_interlock || context.ignore_macroblock)) {
         // update the render pass to load and store the depth and stencil
-        context.current_render_pass = context.state.pipeline_cache.retrieve_render_pass(context.current_color_format, true, true);
+        context.select_render_pass(true, true);
         context.is_first_scene_draw = false;
     }
 
     const SceGxmFragmentProgram &gxm_fragment_program = *context.record.fragment_program.get(mem);
     const SceGxmProgram &fragment_program_gxp = *gxm_fragment_program.program.get(mem);
-    if (context.state.features.direct_fragcolor && fragment_program_gxp.is_frag_color_used()) {
+    if (context.state.features.direct_fragcolor && fragment_program_gxp.is_frag_color_used() && !context.state.use_rasterization_order) {
         // the fragment shader is using programmable blending with a subpass input
+        context.flush_pending_draws();
         vk::ImageMemoryBarrier barrier{
             .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
             .dstAccessMask = vk::AccessFlagBits::eInputAttachmentRead,
@@ -373,6 +579,7 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     } else if (context.state.features.support_shader_interlock
         && fragment_program_gxp.is_frag_color_used() != context.last_draw_was_framebuffer_fetch) {
         // restart the render pass to act as a barrier
+        context.flush_pending_draws();
         context.render_cmd.endRenderPass();
 
         if (fragment_program_gxp.is_frag_color_used()) {
@@ -388,29 +595,46 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     }
 
     if (context.current_visibility_buffer != nullptr && context.current_query_idx != -1 && !context.is_in_query) {
-        if (context.current_visibility_buffer->queries_used[context.current_query_idx]) {
+        if (context.current_visibility_buffer->is_query_used(context.current_query_idx)) {
             LOG_WARN_ONCE("Visibility buffer entry is used more than once in a scene");
             // still let this happen, this is a validation error but I think most GPUs should be fine with it
         }
-        context.current_visibility_buffer->queries_used[context.current_query_idx] = true;
+        context.current_visibility_buffer->set_query_used(context.current_query_idx);
 
         context.visibility_max_used_idx = std::max(context.visibility_max_used_idx, context.current_query_idx);
 
+        context.flush_pending_draws();
         const vk::QueryControlFlags control_flags = (context.is_query_op_increment && context.state.physical_device_features.occlusionQueryPrecise) ? vk::QueryControlFlagBits::ePrecise : vk::QueryControlFlags();
         context.render_cmd.beginQuery(context.current_visibility_buffer->query_pool, context.current_query_idx, control_flags);
         context.is_in_query = true;
     }
 
     // do we need to check for a pipeline change?
-    if (context.refresh_pipeline || type != context.last_primitive) {
+    const bool primitive_changed = type != context.last_primitive;
+    if (context.refresh_pipeline || primitive_changed) {
         context.refresh_pipeline = false;
         context.last_primitive = type;
         vk::Pipeline new_pipeline = context.state.pipeline_cache.retrieve_pipeline(context, type, mem);
 
+        if (!new_pipeline) {
+            // the pipeline is still being compiled (or failed to be), skip this draw
+            // and look for it again on the next one
+            context.refresh_pipeline = true;
+            return;
+        }
+
         if (new_pipeline != context.current_pipeline) {
+            context.flush_pending_draws();
             context.current_pipeline = new_pipeline;
             context.render_cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, context.current_pipeline);
         }
+
+        // the pipeline only knows about the topology class
+        // it is already set if there are draws waiting to be merged with the same primitive
+        if (context.state.pipeline_cache.use_extended_dynamic_state && (primitive_changed || context.pending_draws.empty())) {
+            context.flush_pending_draws();
+            context.render_cmd.setPrimitiveTopologyEXT(translate_primitive(type));
+        }
     }
 
     if (config.log_active_shaders) {
@@ -447,11 +671,11 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     vert_ublock.screen_width = static_cast<float>(context.render_target->width / context.state.res_multiplier);
     vert_ublock.screen_height = static_cast<float>(context.render_target->height / context.state.res_multiplier);
 
-    if (context.curr_vert_ublock.changed || memcmp(&context.prev_vert_ublock, &vert_ublock, sizeof(vert_ublock)) != 0) {
+    // the base block is pushed with the draw, the uniform buffer only changes with the buffer addresses and texture viewports
+    if (context.curr_vert_ublock.changed) {
         // TODO: this intermediate step can be avoided
         context.curr_vert_ublock.copy_to(context.shader_info_temp);
         context.vertex_info_uniform_buffer.allocate(context.prerender_cmd, context.curr_vert_ublock.get_size(), context.shader_info_temp);
-        memcpy(&context.prev_vert_ublock, &vert_ublock, sizeof(vert_ublock));
     }
 
     auto &frag_ublock = context.curr_frag_ublock.base_block;
@@ -464,33 +688,74 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     else if (!has_msaa && has_downscale)
         frag_ublock.res_multiplier /= 2;
 
-    if (context.curr_frag_ublock.changed || memcmp(&context.prev_frag_ublock, &frag_ublock, sizeof(frag_ublock)) != 0) {
+    if (context.curr_frag_ublock.changed) {
         // TODO: this intermediate step can be avoided
         context.curr_frag_ublock.copy_to(context.shader_info_temp);
         context.fragment_info_uniform_buffer.allocate(context.prerender_cmd, context.curr_frag_ublock.get_size(), context.shader_info_temp);
-        memcpy(&context.prev_frag_ublock, &frag_ublock, sizeof(frag_ublock));
     }
 
-    // create, update and bind descriptors (uniforms and textures)
-    draw_bind_descriptors(context, mem);
-    // bind the vertex streams
-    bind_vertex_streams(context, mem);
+    DrawState draw_state{};
+    // create and update descriptors (uniforms and textures)
+    draw_get_descriptors(context, mem, draw_state);
+    // get the vertex streams
+    get_vertex_streams(context, mem, draw_state);
 
     // Upload index data.
-    vk::IndexType index_type = (format == SCE_GXM_INDEX_FORMAT_U16) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+    draw_state.index_type = (format == SCE_GXM_INDEX_FORMAT_U16) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
     const size_t index_size = (format == SCE_GXM_INDEX_FORMAT_U16) ? 2 : 4;
+    uint32_t first_index = 0;
 
     if (use_memory_mapping) {
         auto [buffer, offset] = context.state.get_matching_mapping(indices);
-        context.render_cmd.bindIndexBuffer(buffer, offset, index_type);
+        draw_state.index_buffer = buffer;
+        draw_state.index_offset = offset;
     } else {
         const size_t index_buffer_size = index_size * count;
 
         context.index_stream_ring_buffer.allocate(context.prerender_cmd, index_buffer_size, indices_ptr);
-        context.render_cmd.bindIndexBuffer(context.index_stream_ring_buffer.handle(), context.index_stream_ring_buffer.data_offset, index_type);
+        draw_state.index_buffer = context.index_stream_ring_buffer.handle();
+        draw_state.index_offset = context.index_stream_ring_buffer.data_offset;
+    }
+
+    // draws reading indices from the same buffer can be merged, the offset is given as the first index instead
+    const bool can_batch = context.state.use_draw_batching && draw_state.index_offset % index_size == 0;
+    if (can_batch) {
+        first_index = static_cast<uint32_t>(draw_state.index_offset / index_size);
+        draw_state.index_offset = 0;
+    }
+
+    if (!can_batch || context.pending_draws.empty() || draw_state != context.bound_draw_state) {
+        context.flush_pending_draws();
+        bind_draw_state(context, draw_state);
+        context.bound_draw_state = draw_state;
+    }
+
+    if (!context.render_info_pushed
+        || memcmp(&context.prev_vert_ublock, &vert_ublock, sizeof(vert_ublock)) != 0
+        || memcmp(&context.prev_frag_ublock, &frag_ublock, sizeof(frag_ublock)) != 0) {
+        // the pending draws must still see the previous values
+        context.flush_pending_draws();
+        context.render_cmd.pushConstants(draw_state.pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(vert_ublock), &vert_ublock);
+        context.render_cmd.pushConstants(draw_state.pipeline_layout, vk::ShaderStageFlagBits::eFragment, shader::RENDER_FRAG_PUSH_CONSTANT_OFFSET, sizeof(frag_ublock), &frag_ublock);
+        memcpy(&context.prev_vert_ublock, &vert_ublock, sizeof(vert_ublock));
+        memcpy(&context.prev_frag_ublock, &frag_ublock, sizeof(frag_ublock));
+        context.render_info_pushed = true;
     }
 
-    context.render_cmd.drawIndexed(count, instance_count, 0, 0, 0);
+    if (can_batch) {
+        context.pending_draws.push_back(vk::DrawIndexedIndirectCommand{
+            .indexCount = static_cast<uint32_t>(count),
+            .instanceCount = instance_count,
+            .firstIndex = first_index,
+            .vertexOffset = 0,
+            .firstInstance = 0 });
+
+        if (context.pending_draws.size() == MAX_BATCHED_DRAWS)
+            context.flush_pending_draws();
+    } else {
+        context.render_cmd.drawIndexed(count, instance_count, first_index, 0, 0);
+        context.frame_draw_command_count++;
+    }
 
     context.vertex_uniform_storage_allocated = false;
     context.fragment_uniform_storage_allocated = false;
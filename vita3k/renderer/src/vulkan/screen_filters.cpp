@@ -377,6 +377,16 @@ struct RcasConstant {
     float sharpening;
 };
 
+struct FsrConstant {
+    Viewport viewport;
+    vk::Extent2D output_size;
+    vk::Extent2D output_offset;
+    float sharpening;
+};
+
+// some default value for sharpening
+static constexpr float FSR_SHARPENING = 0.2f;
+
 FSRScreenFilter::~FSRScreenFilter() {
     vk::Device device = screen.state.device;
     device.waitIdle();
@@ -385,14 +395,17 @@ FSRScreenFilter::~FSRScreenFilter() {
 
     device.destroy(pipeline_easu);
     device.destroy(pipeline_rcas);
+    device.destroy(pipeline_single_pass);
     device.destroy(pipeline_layout_easu);
     device.destroy(pipeline_layout_rcas);
+    device.destroy(pipeline_layout_single_pass);
     device.freeDescriptorSets(descriptor_pool, descriptor_sets);
     device.destroy(descriptor_pool);
     device.destroy(descriptor_set_layout);
 
     device.destroy(rcas_shader);
     device.destroy(easu_shader);
+    device.destroy(single_pass_shader);
 }
 
 void FSRScreenFilter::init() {
@@ -411,6 +424,7 @@ void FSRScreenFilter::init() {
     const auto builtin_shaders_path = std::string(screen.state.shared_path) + "shaders-builtin/vulkan/";
     easu_shader = vkutil::load_shader(screen.state.device, builtin_shaders_path + "fsr_filter_easu.comp.spv");
     rcas_shader = vkutil::load_shader(screen.state.device, builtin_shaders_path + "fsr_filter_rcas.comp.spv");
+    single_pass_shader = vkutil::load_shader(screen.state.device, builtin_shaders_path + "fsr_filter.comp.spv");
 
     std::array<vk::DescriptorSetLayoutBinding, 3> layout_bindings = {
         // src img
@@ -475,6 +489,11 @@ void FSRScreenFilter::init() {
     push_constant.size = sizeof(RcasConstant);
     pipeline_layout_rcas = device.createPipelineLayout(layout_info);
 
+    if (single_pass_shader) {
+        push_constant.size = sizeof(FsrConstant);
+        pipeline_layout_single_pass = device.createPipelineLayout(layout_info);
+    }
+
     // create easu and rcas pipelines
     vk::ComputePipelineCreateInfo compute_info{
         .stage = {
@@ -495,6 +514,16 @@ void FSRScreenFilter::init() {
         LOG_ERROR("Failed to create compute pipeline");
     pipeline_rcas = result.value;
 
+    if (single_pass_shader) {
+        compute_info.stage.module = single_pass_shader;
+        compute_info.layout = pipeline_layout_single_pass;
+        result = device.createComputePipeline(nullptr, compute_info);
+        if (result.result == vk::Result::eSuccess)
+            pipeline_single_pass = result.value;
+        else
+            LOG_ERROR("Failed to create the single pass FSR pipeline, using two passes");
+    }
+
     // create intermediate images
     intermediate_images.resize(screen.swapchain_size);
     for (auto &img : intermediate_images) {
@@ -528,6 +557,24 @@ void FSRScreenFilter::on_resize() {
         output_offset.height = static_cast<uint32_t>(std::round((screen.extent.height - output_size.height) / 2.0f));
     }
 
+    if (pipeline_single_pass) {
+        // no intermediate image, the first descriptor set writes to the swapchain image
+        std::vector<vk::DescriptorImageInfo> descr_images(screen.swapchain_size);
+        std::vector<vk::WriteDescriptorSet> write_descr(screen.swapchain_size);
+        for (int i = 0; i < screen.swapchain_size; i++) {
+            descr_images[i]
+                .setImageView(screen.swapchain_views[i])
+                .setImageLayout(vk::ImageLayout::eGeneral);
+            write_descr[i]
+                .setDstSet(descriptor_sets[i * 2])
+                .setDstBinding(2)
+                .setDescriptorType(vk::DescriptorType::eStorageImage)
+                .setImageInfo(descr_images[i]);
+        }
+        screen.state.device.updateDescriptorSets(write_descr, {});
+        return;
+    }
+
     // recreate the intermediate images
     for (auto &img : intermediate_images) {
         img.destroy();
@@ -569,6 +616,38 @@ void FSRScreenFilter::on_resize() {
     screen.state.device.updateDescriptorSets(write_descr, {});
 }
 
+// clear the swapchain image and transition it to general for the compute shader writing to it
+static void clear_swapchain_image(vk::CommandBuffer cmd_buffer, vk::Image image, vk::PipelineStageFlags src_stage) {
+    vk::ImageMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .oldLayout = vk::ImageLayout::eUndefined,
+        .newLayout = vk::ImageLayout::eTransferDstOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd_buffer.pipelineBarrier(src_stage, vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(), {}, {}, barrier);
+
+    vk::ClearColorValue clear_color{ std::array<float, 4>({ 0.0f, 0.0f, 0.0f, 0.0f }) };
+    cmd_buffer.clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, clear_color, vkutil::color_subresource_range);
+
+    barrier = {
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+        .newLayout = vk::ImageLayout::eGeneral,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(), {}, {}, barrier);
+}
+
 void FSRScreenFilter::render(bool is_pre_renderpass, vk::ImageView src_img, vk::ImageLayout src_layout, const Viewport &viewport) {
     if (!is_pre_renderpass)
         // we are using compute shaders
@@ -589,6 +668,25 @@ void FSRScreenFilter::render(bool is_pre_renderpass, vk::ImageView src_img, vk::
     screen.state.device.updateDescriptorSets(write_descr, {});
 
     vk::CommandBuffer cmd_buffer = screen.current_cmd_buffer;
+    const int dispatch_x = (output_size.width + 15) / 16;
+    const int dispatch_y = (output_size.height + 15) / 16;
+
+    if (pipeline_single_pass) {
+        clear_swapchain_image(cmd_buffer, screen.swapchain_images[screen.swapchain_image_idx], vk::PipelineStageFlagBits::eColorAttachmentOutput);
+
+        cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_single_pass);
+        cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_single_pass, 0, descriptor_sets[2 * screen.swapchain_image_idx], {});
+        FsrConstant fsr_constant{
+            .viewport = viewport,
+            .output_size = output_size,
+            .output_offset = output_offset,
+            .sharpening = FSR_SHARPENING
+        };
+        cmd_buffer.pushConstants(pipeline_layout_single_pass, vk::ShaderStageFlagBits::eCompute, 0, sizeof(FsrConstant), &fsr_constant);
+        cmd_buffer.dispatch(dispatch_x, dispatch_y, 1);
+        return;
+    }
+
     // first, make a barrier to make sure we can write to the intermediate texture
     // we don't care about the previous content
     intermediate_images[screen.swapchain_image_idx].transition_to_discard(cmd_buffer, vkutil::ImageLayout::StorageImage);
@@ -602,51 +700,20 @@ void FSRScreenFilter::render(bool is_pre_renderpass, vk::ImageView src_img, vk::
         .output_size = output_size
     };
     cmd_buffer.pushConstants(pipeline_layout_easu, vk::ShaderStageFlagBits::eCompute, 0, sizeof(EasuConstant), &easu_constant);
-    const int dispatch_x = (output_size.width + 15) / 16;
-    const int dispatch_y = (output_size.height + 15) / 16;
     cmd_buffer.dispatch(dispatch_x, dispatch_y, 1);
 
     // meanwhile, we need to clear the swapchain surface
-    vk::ImageMemoryBarrier barrier{
-        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
-        .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
-        .oldLayout = vk::ImageLayout::eUndefined,
-        .newLayout = vk::ImageLayout::eTransferDstOptimal,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = screen.swapchain_images[screen.swapchain_image_idx],
-        .subresourceRange = vkutil::color_subresource_range
-    };
-    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
-        vk::DependencyFlags(), {}, {}, barrier);
-
-    vk::ClearColorValue clear_color{ std::array<float, 4>({ 0.0f, 0.0f, 0.0f, 0.0f }) };
-    cmd_buffer.clearColorImage(screen.swapchain_images[screen.swapchain_image_idx], vk::ImageLayout::eTransferDstOptimal, clear_color, vkutil::color_subresource_range);
+    clear_swapchain_image(cmd_buffer, screen.swapchain_images[screen.swapchain_image_idx], vk::PipelineStageFlagBits::eColorAttachmentOutput);
 
     // then transition the read texture to sampled // wait for the previous compute shader to be done
     intermediate_images[screen.swapchain_image_idx].transition_to(cmd_buffer, vkutil::ImageLayout::SampledImage);
 
-    // also transition the swapchain image to general
-    barrier = {
-        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
-        .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
-        .oldLayout = vk::ImageLayout::eTransferDstOptimal,
-        .newLayout = vk::ImageLayout::eGeneral,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = screen.swapchain_images[screen.swapchain_image_idx],
-        .subresourceRange = vkutil::color_subresource_range
-    };
-    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
-        vk::DependencyFlags(), {}, {}, barrier);
-
     // sharpening pass
     cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_rcas);
     cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_rcas, 0, descriptor_sets[2 * screen.swapchain_image_idx + 1], {});
     RcasConstant rcas_constant{
         .offset = output_offset,
-        // some default value for sharpening
-        .sharpening = 0.2f
+        .sharpening = FSR_SHARPENING
     };
     cmd_buffer.pushConstants(pipeline_layout_rcas, vk::ShaderStageFlagBits::eCompute, 0, sizeof(RcasConstant), &rcas_constant);
     cmd_buffer.dispatch(dispatch_x, dispatch_y, 1);
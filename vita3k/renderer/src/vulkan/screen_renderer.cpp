@@ -19,6 +19,9 @@
 
 #include <SDL_vulkan.h>
 
+#include <algorithm>
+#include <chrono>
+
 #include "renderer/vulkan/state.h"
 #include "util/log.h"
 #include "vkutil/vkutil.h"
@@ -64,7 +67,12 @@ bool ScreenRenderer::setup(const char *cache_path) {
     const auto present_modes = state.physical_device.getSurfacePresentModesKHR(surface);
     // this one should always be available
     present_mode = vk::PresentModeKHR::eImmediate;
+    // when benchmarking, never wait for the display
+    const bool use_immediate = high_throughput && std::ranges::find(present_modes, vk::PresentModeKHR::eImmediate) != present_modes.end();
     for (const auto &mode : present_modes) {
+        if (use_immediate)
+            break;
+
         if (mode == vk::PresentModeKHR::eMailbox) {
             present_mode = mode;
             break;
@@ -93,6 +101,10 @@ bool ScreenRenderer::setup(const char *cache_path) {
     filter = std::make_unique<FXAAScreenFilter>(*this);
     filter->init();
 
+    use_present_thread = !low_latency;
+    if (use_present_thread)
+        present_thread = std::thread(&ScreenRenderer::present_thread_loop, this);
+
     return true;
 }
 
@@ -112,7 +124,7 @@ void ScreenRenderer::create_swapchain() {
     if (extent.width == 0 || extent.height == 0)
         return;
 
-    swapchain_size = surface_capabilities.minImageCount + 1;
+    swapchain_size = surface_capabilities.minImageCount + (high_throughput ? 2 : 1);
     if (surface_capabilities.maxImageCount != 0)
         swapchain_size = std::min(swapchain_size, surface_capabilities.maxImageCount);
 
@@ -122,6 +134,10 @@ void ScreenRenderer::create_swapchain() {
         if (surface_capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eStorage)
             // needed for FSR
             surface_usage |= vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage;
+        // needed to record the frames
+        support_transfer_src = static_cast<bool>(surface_capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+        if (support_transfer_src)
+            surface_usage |= vk::ImageUsageFlagBits::eTransferSrc;
 
         vk::SwapchainCreateInfoKHR swapchain_info{
             .surface = surface,
@@ -139,6 +155,8 @@ void ScreenRenderer::create_swapchain() {
         };
 
         swapchain = state.device.createSwapchainKHR(swapchain_info);
+        // present ids are specific to a swapchain
+        present_id = 0;
     }
 
     // Get Swapchain Images
@@ -191,8 +209,40 @@ void ScreenRenderer::destroy_swapchain() {
     }
 }
 
+void ScreenRenderer::recreate_swapchain() {
+    wait_present_idle();
+    {
+        const ProfiledLockGuard guard(state.general_queue_mutex);
+        state.device.waitIdle();
+    }
+    // the recorded frames are indexed by swapchain image
+    if (frame_recorder)
+        frame_recorder->collect(true);
+    destroy_swapchain();
+
+    int width, height;
+    SDL_Vulkan_GetDrawableSize(window, &width, &height);
+    // don't render anything when the window is minimized
+    if (width == 0 || height == 0)
+        return;
+
+    create_swapchain();
+    if (swapchain)
+        need_rebuild = true;
+}
+
 void ScreenRenderer::cleanup() {
+    if (present_thread.joinable()) {
+        {
+            const std::lock_guard<std::mutex> guard(present_mutex);
+            present_exiting = true;
+        }
+        present_cond.notify_all();
+        present_thread.join();
+    }
+
     state.device.waitIdle();
+    frame_recorder.reset();
     for (vk::Framebuffer fb : swapchain_framebuffers)
         state.device.destroy(fb);
 
@@ -212,32 +262,45 @@ void ScreenRenderer::cleanup() {
     state.instance.destroy(surface);
 }
 
+static void add_present_wait(renderer::State &state, std::chrono::steady_clock::time_point start) {
+    state.present_wait_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+}
+
 static constexpr uint64_t next_image_timeout = std::numeric_limits<uint64_t>::max();
+// frames waiting for the present thread, more would only add latency
+static constexpr uint32_t max_pending_presents = 2;
+// how long the main loop waits for the present thread before skipping the frame
+static constexpr auto present_skip_timeout = std::chrono::milliseconds(4);
 
 bool ScreenRenderer::acquire_swapchain_image(bool start_render_pass) {
     vk::Result acquire_result = vk::Result::eErrorOutOfDateKHR;
 
+    // the acquire and the wait for the fence of the image are counted as present wait
+    const auto acquire_start = std::chrono::steady_clock::now();
+    if (use_present_thread) {
+        // the semaphores of a frame are reused swapchain_size frames later, they must not be in use anymore
+        const uint32_t max_pending = std::max<uint32_t>(std::min(max_pending_presents, swapchain_size - 1), 1);
+        std::unique_lock<std::mutex> lock(present_mutex);
+        if (!present_cond.wait_for(lock, present_skip_timeout, [&] { return present_pending < max_pending; })) {
+            swapchain_image_idx = 0xDEADBEAF;
+            return false;
+        }
+    }
+
     current_frame++;
     if (current_frame == swapchain_size)
         current_frame = 0;
 
-    if (swapchain)
+    // with the present thread, never block on the presentation engine, the frame is skipped instead
+    if (swapchain && !swapchain_out_of_date.exchange(false))
         acquire_result = state.device.acquireNextImageKHR(swapchain,
-            next_image_timeout, image_acquired_semaphores[current_frame], vk::Fence(), &swapchain_image_idx);
+            use_present_thread ? 0 : next_image_timeout, image_acquired_semaphores[current_frame], vk::Fence(), &swapchain_image_idx);
 
     if (acquire_result != vk::Result::eSuccess) {
         if (acquire_result == vk::Result::eErrorOutOfDateKHR || acquire_result == vk::Result::eSuboptimalKHR) {
-            state.device.waitIdle();
-            destroy_swapchain();
-            int width, height;
-            SDL_Vulkan_GetDrawableSize(window, &width, &height);
-            // don't render anything when the window is minimized
-            if (width == 0 || height == 0)
-                return false;
-
-            create_swapchain();
-            if (swapchain)
-                need_rebuild = true;
+            recreate_swapchain();
+        } else if (acquire_result == vk::Result::eTimeout || acquire_result == vk::Result::eNotReady) {
+            // no image available yet, try again on the next frame
         } else {
             LOG_WARN("Failed to get next image. Error: {}", vk::to_string(acquire_result));
         }
@@ -254,7 +317,10 @@ bool ScreenRenderer::acquire_swapchain_image(bool start_render_pass) {
         assert(false);
         return false;
     }
+    if (frame_recorder)
+        frame_recorder->collect(false);
     state.device.resetFences(fences[swapchain_image_idx]);
+    add_present_wait(state, acquire_start);
 
     // begin the render command
     current_cmd_buffer = command_buffers[swapchain_image_idx];
@@ -316,7 +382,10 @@ void ScreenRenderer::swap_window() {
     }
 
     // first submit the command buffer
+    // this is done here and not on the present thread so it stays ordered with the guest submissions
     current_cmd_buffer.endRenderPass();
+    if (frame_recorder)
+        frame_recorder->record(current_cmd_buffer, swapchain_image_idx);
     current_cmd_buffer.end();
     vk::SubmitInfo submit_info{};
     std::array<vk::Semaphore, 1> wait_semaphores = { image_acquired_semaphores[current_frame] };
@@ -326,38 +395,101 @@ void ScreenRenderer::swap_window() {
     submit_info.setWaitDstStageMask(dst_masks);
     submit_info.setSignalSemaphores(image_ready_semaphores[current_frame]);
     submit_info.setCommandBuffers(current_cmd_buffer);
-    state.general_queue.submit(submit_info, fences[swapchain_image_idx]);
+    {
+        const ProfiledLockGuard guard(state.general_queue_mutex);
+        state.general_queue.submit(submit_info, fences[swapchain_image_idx]);
+    }
+
+    const PresentFrame frame{ swapchain_image_idx, current_frame };
+    swapchain_image_idx = ~0;
+    current_cmd_buffer = nullptr;
 
     // then present the surface
+    if (use_present_thread) {
+        {
+            const std::lock_guard<std::mutex> guard(present_mutex);
+            present_queue.push_back(frame);
+            present_pending++;
+        }
+        present_cond.notify_all();
+    } else if (!present(frame)) {
+        recreate_swapchain();
+    }
+}
+
+bool ScreenRenderer::present(const PresentFrame &frame) {
     vk::PresentInfoKHR present_info{
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &image_ready_semaphores[current_frame],
+        .pWaitSemaphores = &image_ready_semaphores[frame.frame],
         .swapchainCount = 1,
         .pSwapchains = &swapchain,
-        .pImageIndices = &swapchain_image_idx,
+        .pImageIndices = &frame.image_idx,
     };
+    const bool use_present_wait = low_latency && support_present_wait;
+    const uint64_t next_present_id = present_id + 1;
+    const vk::PresentIdKHR present_id_info{
+        .swapchainCount = 1,
+        .pPresentIds = &next_present_id
+    };
+    if (use_present_wait)
+        present_info.pNext = &present_id_info;
+
+    const auto present_start = std::chrono::steady_clock::now();
     try {
-        auto result = state.general_queue.presentKHR(present_info);
+        vk::Result result;
+        {
+            const ProfiledLockGuard guard(state.general_queue_mutex);
+            result = state.general_queue.presentKHR(present_info);
+        }
         if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR) {
             LOG_ERROR("Could not present KHR.");
             assert(false);
-            return;
+            return true;
         }
-    } catch (vk::OutOfDateKHRError &) {
-        state.device.waitIdle();
-        destroy_swapchain();
 
-        int width, height;
-        SDL_Vulkan_GetDrawableSize(window, &width, &height);
-        if (width > 0 && height > 0) {
-            create_swapchain();
-            if (swapchain)
-                need_rebuild = true;
+        if (use_present_wait) {
+            present_id = next_present_id;
+            // wait before the game starts its next frame, not when it is done with it
+            // at most one frame is waiting to be displayed, the timeout prevents hangs if the window is hidden
+            constexpr uint64_t present_wait_timeout = 100'000'000;
+            if (present_id > 1)
+                (void)state.device.waitForPresentKHR(swapchain, present_id - 1, present_wait_timeout);
         }
+        add_present_wait(state, present_start);
+    } catch (vk::OutOfDateKHRError &) {
+        return false;
     }
 
-    swapchain_image_idx = ~0;
-    current_cmd_buffer = nullptr;
+    return true;
+}
+
+void ScreenRenderer::present_thread_loop() {
+    std::unique_lock<std::mutex> lock(present_mutex);
+    while (true) {
+        present_cond.wait(lock, [&] { return present_exiting || !present_queue.empty(); });
+        // the frames already submitted are still presented before exiting
+        if (present_queue.empty())
+            return;
+
+        const PresentFrame frame = present_queue.front();
+        present_queue.pop_front();
+
+        lock.unlock();
+        if (!present(frame))
+            swapchain_out_of_date = true;
+        lock.lock();
+
+        present_pending--;
+        present_cond.notify_all();
+    }
+}
+
+void ScreenRenderer::wait_present_idle() {
+    if (!use_present_thread)
+        return;
+
+    std::unique_lock<std::mutex> lock(present_mutex);
+    present_cond.wait(lock, [&] { return present_pending == 0; });
 }
 
 void ScreenRenderer::set_filter(const std::string_view &filter) {
@@ -365,6 +497,9 @@ void ScreenRenderer::set_filter(const std::string_view &filter) {
         // we are already using this filter
         return;
 
+    // the frames waiting to be presented may still use the previous filter
+    wait_present_idle();
+
     this->filter.reset();
     if (filter == "FSR")
         this->filter = std::make_unique<FSRScreenFilter>(*this);
@@ -380,6 +515,32 @@ void ScreenRenderer::set_filter(const std::string_view &filter) {
     this->filter->init();
 }
 
+bool ScreenRenderer::start_recording(RecordFrameCallback callback) {
+    if (frame_recorder || !swapchain)
+        return false;
+
+    frame_recorder = std::make_unique<FrameRecorder>(*this, std::move(callback));
+    if (!frame_recorder->init()) {
+        frame_recorder.reset();
+        return false;
+    }
+
+    return true;
+}
+
+void ScreenRenderer::stop_recording() {
+    if (!frame_recorder)
+        return;
+
+    wait_present_idle();
+    {
+        const ProfiledLockGuard guard(state.general_queue_mutex);
+        state.device.waitIdle();
+    }
+    frame_recorder->collect(true);
+    frame_recorder.reset();
+}
+
 void ScreenRenderer::create_layout_sync() {
     vk::CommandBufferAllocateInfo cmd_buffer_info{
         .commandPool = state.general_command_pool,
@@ -18,6 +18,7 @@
 #include <renderer/vulkan/surface_cache.h>
 
 #include <gxm/functions.h>
+#include <renderer/functions.h>
 #include <renderer/vulkan/gxm_to_vulkan.h>
 #include <renderer/vulkan/state.h>
 #include <renderer/vulkan/types.h>
@@ -28,6 +29,9 @@
 #include <util/align.h>
 #include <util/keywords.h>
 #include <util/log.h>
+#include <util/memory_accounting.h>
+
+#include <algorithm>
 
 extern "C" {
 #include <libswscale/swscale.h>
@@ -38,6 +42,11 @@ static bool format_support_surface_sync(SceGxmColorBaseFormat format) {
     return format != SCE_GXM_COLOR_BASE_FORMAT_U2F10F10F10;
 }
 
+// the surfaces are not evicted because of a budget, the usage is only reported
+static uint64_t get_image_memory_size(const vkutil::Image &image) {
+    return image.allocation ? image.allocator.getAllocationInfo(image.allocation).size : 0;
+}
+
 static bool format_support_swizzle(SceGxmColorBaseFormat format) {
     // do we support something more than the identity swizzle
     // for now we do not support any texture whose component size
@@ -65,11 +74,25 @@ ColorSurfaceCacheInfo::~ColorSurfaceCacheInfo() {
     sws_freeContext(sws_context);
 }
 
+FramebufferKey::FramebufferKey(vk::ImageView color, vk::ImageView depth_stencil, uint32_t width, uint32_t height)
+    : color(color)
+    , depth_stencil(depth_stencil)
+    , width(width)
+    , height(height) {
+    // the handles are pointers or unique 64-bit values, mix them so that all the bits of the hash are used
+    uint64_t value = reinterpret_cast<uint64_t>(static_cast<VkImageView>(color));
+    value = (value ^ (value >> 33)) * 0xFF51AFD7ED558CCDULL;
+    value ^= reinterpret_cast<uint64_t>(static_cast<VkImageView>(depth_stencil)) + 0x9E3779B97F4A7C15ULL + (value << 6) + (value >> 2);
+    value ^= ((static_cast<uint64_t>(width) << 32) | height) + 0x9E3779B97F4A7C15ULL + (value << 6) + (value >> 2);
+    value = (value ^ (value >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+    hash = static_cast<size_t>(value ^ (value >> 33));
+}
+
 void VKSurfaceCache::destroy_framebuffers(vk::ImageView view) {
     vkutil::DestroyQueue &destroy_queue = reinterpret_cast<VKContext *>(state.context)->frame().destroy_queue;
     for (auto it = framebuffer_array.begin(); it != framebuffer_array.end();) {
         // if the color of depth-stencil match the one of the render_target, this won't be used anymore
-        if (it->first.first == view || it->first.second == view) {
+        if (it->first.color == view || it->first.depth_stencil == view) {
             destroy_queue.add(it->second.standard);
             destroy_queue.add(it->second.shader_interlock);
             it = framebuffer_array.erase(it);
@@ -85,6 +108,7 @@ void VKSurfaceCache::destroy_surface(ColorSurfaceCacheInfo &info) {
 
     // don't forget to destroy in the right order
     for (auto &casted : info.casted_textures) {
+        remove_memory_usage(MemoryCategory::Surfaces, get_image_memory_size(casted.texture));
         destroy_queue.add_buffer(casted.transition_buffer);
         destroy_queue.add_image(casted.texture);
     }
@@ -93,21 +117,73 @@ void VKSurfaceCache::destroy_surface(ColorSurfaceCacheInfo &info) {
     destroy_queue.add(info.alternate_view);
 
     destroy_framebuffers(info.texture.view);
-    destroy_queue.add_image(info.texture);
+    release_surface_image(info);
 }
 
 void VKSurfaceCache::destroy_surface(DepthStencilSurfaceCacheInfo &info) {
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
     vkutil::DestroyQueue &destroy_queue = context->frame().destroy_queue;
 
-    for (auto &read_only : info.read_surfaces)
+    for (auto &read_only : info.read_surfaces) {
+        remove_memory_usage(MemoryCategory::Surfaces, get_image_memory_size(read_only.depth_view));
         destroy_queue.add_image(read_only.depth_view);
+    }
 
     destroy_queue.add(info.depth_view);
     destroy_queue.add(info.stencil_view);
 
     destroy_framebuffers(info.texture.view);
-    destroy_queue.add_image(info.texture);
+    release_surface_image(info);
+}
+
+void VKSurfaceCache::acquire_surface_image(SurfaceCacheInfo &info, vk::ImageUsageFlags usage, vk::ImageCreateFlags flags, const void *pNext, const vma::AllocationCreateInfo &alloc_info) {
+    vkutil::Image &image = info.texture;
+    info.texture_usage = usage;
+    info.texture_flags = flags;
+
+    // the images are taken from the pool once the GPU is done with them, they are transitioned from their last layout
+    // the view was created with the default mapping and the other creation parameters follow from the format and the flags
+    const uint64_t frame_timestamp = reinterpret_cast<VKContext *>(state.context)->frame_timestamp;
+    for (auto it = image_pool.begin(); it != image_pool.end(); ++it) {
+        if (it->image.width == image.width && it->image.height == image.height && it->image.format == image.format
+            && it->usage == usage && it->flags == flags && it->release_frame + state.frames_in_flight <= frame_timestamp) {
+            image = std::move(it->image);
+            image_pool.erase(it);
+            return;
+        }
+    }
+
+    image.init_image(usage, vkutil::default_comp_mapping, flags, pNext, alloc_info);
+    add_memory_usage(MemoryCategory::Surfaces, get_image_memory_size(image));
+}
+
+void VKSurfaceCache::release_surface_image(SurfaceCacheInfo &info) {
+    if (!info.texture.image)
+        return;
+
+    image_pool.push_back({ .image = std::move(info.texture),
+        .usage = info.texture_usage,
+        .flags = info.texture_flags,
+        .release_frame = reinterpret_cast<VKContext *>(state.context)->frame_timestamp });
+
+    // do not keep more images than the color and depth-stencil surfaces alive at once
+    if (image_pool.size() > max_surfaces_allowed * 2) {
+        vkutil::DestroyQueue &destroy_queue = reinterpret_cast<VKContext *>(state.context)->frame().destroy_queue;
+        remove_memory_usage(MemoryCategory::Surfaces, get_image_memory_size(image_pool.front().image));
+        destroy_queue.add_image(image_pool.front().image);
+        image_pool.erase(image_pool.begin());
+    }
+}
+
+void VKSurfaceCache::purge_image_pool() {
+    VKContext *context = reinterpret_cast<VKContext *>(state.context);
+    auto it = image_pool.begin();
+    while (it != image_pool.end() && it->release_frame + image_pool_idle_frames <= context->frame_timestamp) {
+        remove_memory_usage(MemoryCategory::Surfaces, get_image_memory_size(it->image));
+        context->frame().destroy_queue.add_image(it->image);
+        ++it;
+    }
+    image_pool.erase(image_pool.begin(), it);
 }
 
 VKSurfaceCache::VKSurfaceCache(VKState &state)
@@ -116,6 +192,50 @@ VKSurfaceCache::VKSurfaceCache(VKState &state)
     ds_surface_queue.init(max_surfaces_allowed);
 }
 
+void VKSurfaceCache::init() {
+    // surface sync is supported only if memory mapping is enabled
+    if (!state.features.support_memory_mapping)
+        return;
+
+    vk::ShaderModule readback_shader = vkutil::load_shader(state.device, state.shared_path + "shaders-builtin/vulkan/surface_readback.comp.spv");
+    if (!readback_shader) {
+        LOG_WARN("Could not load surface_readback.comp.spv, synced surfaces will be swizzled on the CPU");
+        return;
+    }
+
+    // the shader only uses buffer addresses, no descriptor set is needed
+    vk::PushConstantRange push_constant{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset = 0,
+        .size = sizeof(SurfaceReadbackInfo)
+    };
+    vk::PipelineLayoutCreateInfo layout_info{};
+    layout_info.setPushConstantRanges(push_constant);
+    readback_pipeline_layout = state.device.createPipelineLayout(layout_info);
+
+    vk::ComputePipelineCreateInfo compute_info{
+        .stage = {
+            .stage = vk::ShaderStageFlagBits::eCompute,
+            .module = readback_shader,
+            .pName = "main" },
+        .layout = readback_pipeline_layout
+    };
+    auto result = state.device.createComputePipeline(nullptr, compute_info);
+    state.device.destroy(readback_shader);
+    if (result.result != vk::Result::eSuccess) {
+        LOG_ERROR("Failed to create compute pipeline");
+        return;
+    }
+    readback_pipeline = result.value;
+}
+
+void VKSurfaceCache::cleanup() {
+    state.device.destroy(readback_pipeline);
+    state.device.destroy(readback_pipeline_layout);
+    readback_pipeline = nullptr;
+    readback_pipeline_layout = nullptr;
+}
+
 SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(MemState &mem, SceGxmColorSurface *color) {
     // Create the key to access the cache struct
     const uint32_t address = color->data.address();
@@ -126,18 +246,9 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
     uint32_t width = original_width * state.res_multiplier;
     uint32_t height = original_height * state.res_multiplier;
 
-    bool overlap = true;
-
-    // Of course, this works under the assumption that range must be unique :D
-    auto ite = color_address_lookup.upper_bound(address);
-    if (ite == color_address_lookup.begin())
-        // no match
-        overlap = false;
-    else
-        ite--;
-    // ite is now the first item with an adress lower or equal to key
-
-    overlap = (overlap && (ite->first + ite->second->total_bytes) > address);
+    // closest surface containing the address
+    auto ite = color_address_lookup.find_containing(address);
+    const bool overlap = ite != nullptr;
 
     const SceGxmColorBaseFormat base_format = gxm::get_base_format(color->colorFormat);
     vk::Format vk_format = color::translate_format(base_format);
@@ -155,7 +266,7 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
     uint32_t total_surface_size = bytes_per_stride * original_height;
 
     if (overlap) {
-        ColorSurfaceCacheInfo &info = *ite->second;
+        ColorSurfaceCacheInfo &info = *ite->value;
 
         // There are four situations I think of:
         // 1. Different base address, lookup for write, in this case, if the cached surface range contains the given address, then
@@ -163,19 +274,21 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
         // 2. Same base address, but width and height change to be larger, or format change if write. Remake a new one for both read and write sitatation.
         // 3. Out of cache range. In write case, create a new one, in read case, lul
         // 4. Read situation with smaller width and height, probably need to extract the needed region out.
-        // 5. the surface is a gbuffer and we are currently trying to read the 2nd component, in this case key == ite->first + 4
-        const bool addr_in_range_of_cache = ((address + total_surface_size) <= (ite->first + info.total_bytes + 4));
-        const bool cache_probably_freed = (ite->first != address) && addr_in_range_of_cache;
+        // 5. the surface is a gbuffer and we are currently trying to read the 2nd component, in this case key == ite->start + 4
+        const bool addr_in_range_of_cache = ((address + total_surface_size) <= (ite->start + info.total_bytes + 4));
+        const bool cache_probably_freed = (ite->start != address) && addr_in_range_of_cache;
         const bool surface_extent_changed = info.height < height;
         bool surface_stat_changed = false;
 
-        if (ite->first == address)
+        if (ite->start == address)
             surface_stat_changed = surface_extent_changed || info.width < width || base_format != info.format;
 
-        const bool invalidated = cache_probably_freed || surface_stat_changed || !addr_in_range_of_cache;
+        const bool multiplier_changed = info.res_multiplier != state.res_multiplier;
+
+        const bool invalidated = cache_probably_freed || surface_stat_changed || !addr_in_range_of_cache || multiplier_changed;
         if (invalidated) {
             destroy_surface(info);
-            color_address_lookup.erase(ite);
+            color_address_lookup.erase(ite->start);
             color_surface_queue.set_as_lru(&info);
         } else {
             color_surface_queue.set_as_mru(&info);
@@ -211,7 +324,7 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
         color_address_lookup.erase(info_added.data.address());
 
     color_surface_queue.set_as_mru(&info_added);
-    color_address_lookup[address] = &info_added;
+    color_address_lookup.insert_or_assign(address, total_surface_size, &info_added);
 
     info_added.width = width;
     info_added.height = height;
@@ -224,6 +337,7 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
     // only remember the swizzle here, it will be useful if we get to present or sample from this image with a different swizzle
     info_added.swizzle = color::translate_swizzle(color->colorFormat);
     info_added.flags = 0;
+    info_added.res_multiplier = state.res_multiplier;
 
     vkutil::Image &image = info_added.texture;
     image.allocator = state.allocator;
@@ -248,7 +362,7 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_color_surface_for_framebuffer(Mem
     vk::ImageUsageFlags surface_usages = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eInputAttachment;
     if (state.features.support_shader_interlock)
         surface_usages |= vk::ImageUsageFlagBits::eStorage;
-    image.init_image(surface_usages, vkutil::default_comp_mapping, image_create_flags, image_info_pNext);
+    acquire_surface_image(info_added, surface_usages, image_create_flags, image_info_pNext);
 
     // do it in the prerender if we read from this texture in the same scene (although this would be useless)
     vk::CommandBuffer cmd_buffer = context->prerender_cmd;
@@ -296,20 +410,12 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
     const uint32_t width = original_width * state.res_multiplier;
     const uint32_t height = original_height * state.res_multiplier;
 
-    bool overlap = true;
-    // Of course, this works under the assumption that range must be unique :D
-    auto ite = color_address_lookup.upper_bound(address);
-    if (ite == color_address_lookup.begin())
-        // no match
-        overlap = false;
-    else
-        ite--;
-    // ite is now the first item with an adress lower or equal to key
+    // closest surface containing the address
+    auto ite = color_address_lookup.find_containing(address);
     bool invalidated = false;
 
-    overlap = (overlap && (ite->first + ite->second->total_bytes) > address);
-
-    if (!overlap)
+    // a surface rendered with another resolution multiplier is read from memory instead
+    if (ite == nullptr || ite->value->res_multiplier != state.res_multiplier)
         return std::nullopt;
 
     const vk::ComponentMapping swizzle = texture::translate_swizzle(gxm::get_format(texture));
@@ -346,7 +452,7 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
     uint32_t bytes_per_stride = pixel_stride * gxm::bits_per_pixel(base_format) / 8;
     uint32_t total_surface_size = bytes_per_stride * original_height;
 
-    ColorSurfaceCacheInfo &info = *ite->second;
+    ColorSurfaceCacheInfo &info = *ite->value;
 
     if ((base_format == SCE_GXM_COLOR_BASE_FORMAT_U8U8U8 || info.format == SCE_GXM_COLOR_BASE_FORMAT_U8U8U8)
         && base_format != info.format)
@@ -359,12 +465,12 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
     // 2. Same base address, but width and height change to be larger, or format change if write. Remake a new one for both read and write sitatation.
     // 3. Out of cache range. In write case, create a new one, in read case, lul
     // 4. Read situation with smaller width and height, probably need to extract the needed region out.
-    // 5. the surface is a gbuffer and we are currently trying to read the 2nd component, in this case key == ite->first + 4
-    bool addr_in_range_of_cache = ((address + total_surface_size) <= (ite->first + info.total_bytes + 4));
+    // 5. the surface is a gbuffer and we are currently trying to read the 2nd component, in this case key == ite->start + 4
+    bool addr_in_range_of_cache = ((address + total_surface_size) <= (ite->start + info.total_bytes + 4));
     const bool surface_extent_changed = (info.height < height);
     bool surface_stat_changed = false;
 
-    if (ite->first == address) {
+    if (ite->start == address) {
         // If the extent changed but format is not the same, then the probability of it being a cast is high
         surface_stat_changed = info.pixel_stride < pixel_stride && base_format == info.format;
         // persona 4 sample from the top of a texture while the bottom wasn't rendered to, the fact that both the surface and
@@ -396,7 +502,7 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
 
     // TODO: this is true only for linear textures (and also kind of for tiled textures) (and in this case start_x = 0),
     // for swizzled textures this is different
-    const uint32_t data_delta = address - ite->first;
+    const uint32_t data_delta = address - ite->start;
     uint32_t start_sourced_line = (data_delta / bytes_per_stride) * state.res_multiplier;
     uint32_t start_x = (data_delta % bytes_per_stride) / bytes_per_pixel_requested * state.res_multiplier;
 
@@ -506,6 +612,7 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_color_surface_as_tex
                 resulting_swizzle = swizzle;
 
             casted->texture.init_image(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, resulting_swizzle);
+            add_memory_usage(MemoryCategory::Surfaces, get_image_memory_size(casted->texture));
             casted->texture.transition_to(cmd_buffer, vkutil::ImageLayout::TransferDst);
         } else {
             casted->texture.transition_to_discard(cmd_buffer, vkutil::ImageLayout::TransferDst);
@@ -613,6 +720,8 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
         memory_height *= 2;
 
     const bool is_stencil_only = depth_stencil->depth_data.address() == 0;
+    // with shader interlock the depth-stencil is always stored
+    const bool need_memory = depth_stencil->force_load || depth_stencil->force_store || state.features.support_shader_interlock;
     DepthStencilSurfaceCacheInfo *cached_info = nullptr;
 
     if (!is_stencil_only) {
@@ -628,8 +737,11 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
     if (cached_info != nullptr) {
         // this the most recently used depth-stencil surface
         ds_surface_queue.set_as_mru(cached_info);
+        cached_info->need_memory |= need_memory;
 
-        bool need_remake = cached_info->texture.width < width || cached_info->texture.height < height;
+        // the content of a transient surface was never stored, nothing is lost by remaking it
+        bool need_remake = cached_info->texture.width < width || cached_info->texture.height < height
+            || cached_info->res_multiplier != state.res_multiplier || (cached_info->is_transient && cached_info->need_memory);
 
         if (!need_remake)
             return {
@@ -639,6 +751,7 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
     } else {
         // retrieve a new depth stencil
         cached_info = ds_surface_queue.get_lru();
+        cached_info->need_memory = need_memory;
     }
 
     // erase it if it was used previously
@@ -660,6 +773,7 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
     cached_info->memory_width = memory_width;
     cached_info->memory_height = memory_height;
     cached_info->multisample_mode = target->multisample_mode;
+    cached_info->res_multiplier = state.res_multiplier;
 
     vkutil::Image &image = cached_info->texture;
 
@@ -672,7 +786,20 @@ SurfaceRetrieveResult VKSurfaceCache::retrieve_depth_stencil_for_framebuffer(Sce
     image.height = height;
     image.format = vk::Format::eD32SfloatS8Uint;
     image.layout = vkutil::ImageLayout::Undefined;
-    image.init_image(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled);
+
+    cached_info->is_transient = state.support_lazily_allocated_memory && !cached_info->need_memory;
+    if (cached_info->is_transient) {
+        // the first render pass clears it, it can't be cleared by a transfer
+        acquire_surface_image(*cached_info, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransientAttachment, vk::ImageCreateFlags(), nullptr, vkutil::vma_lazy_alloc);
+        image.transition_to(cmd_buffer, vkutil::ImageLayout::DepthReadOnly, vkutil::ds_subresource_range);
+
+        return {
+            image.view,
+            &image
+        };
+    }
+
+    acquire_surface_image(*cached_info, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled, vk::ImageCreateFlags());
 
     image.transition_to(cmd_buffer, vkutil::ImageLayout::TransferDst, vkutil::ds_subresource_range);
     vk::ClearDepthStencilValue clear_value{
@@ -732,7 +859,14 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_depth_stencil_as_tex
         return std::nullopt;
 
     DepthStencilSurfaceCacheInfo &cached_info = *found_info;
-    if (cached_info.memory_width < memory_width || cached_info.memory_height < memory_height)
+    if (cached_info.is_transient) {
+        // it can't be sampled and was never stored, it gets backed by memory the next time it is rendered to
+        cached_info.need_memory = true;
+        return std::nullopt;
+    }
+
+    if (cached_info.memory_width < memory_width || cached_info.memory_height < memory_height
+        || cached_info.res_multiplier != state.res_multiplier)
         return std::nullopt;
 
     // we sample from it, set the surface as most recently used
@@ -800,6 +934,7 @@ std::optional<TextureLookupResult> VKSurfaceCache::retrieve_depth_stencil_as_tex
             .scene_timestamp = 0
         };
         read_only.depth_view.init_image(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+        add_memory_usage(MemoryCategory::Surfaces, get_image_memory_size(read_only.depth_view));
         // we want a texture view with only the depth or stencil aspect bit
         // TODO: not efficient
         state.device.destroy(read_only.depth_view.view);
@@ -898,17 +1033,29 @@ Framebuffer &VKSurfaceCache::retrieve_framebuffer_handle(MemState &mem, SceGxmCo
     color_view = color_result.view;
     ds_view = ds_result.view;
 
-    std::pair<vk::ImageView, vk::ImageView> key = { color_view, ds_view };
+    // make the framebuffer as big as possible
+    const uint32_t framebuffer_width = std::min(color_result.base_image->width, ds_result.base_image->width);
+    const uint32_t framebuffer_height = std::min(color_result.base_image->height, ds_result.base_image->height);
+
+    VKContext *context = reinterpret_cast<VKContext *>(state.context);
+    const FramebufferKey key(color_view, ds_view, framebuffer_width, framebuffer_height);
     auto it = framebuffer_array.find(key);
 
     if (it != framebuffer_array.end()) {
         // we already created a framebuffer for this pair
+        it->second.last_used_frame = context->frame_timestamp;
         return it->second;
     }
 
-    // make the framebuffer as big as possible
-    const uint32_t framebuffer_width = std::min(color_result.base_image->width, ds_result.base_image->width);
-    const uint32_t framebuffer_height = std::min(color_result.base_image->height, ds_result.base_image->height);
+    if (framebuffer_array.size() >= max_framebuffers) {
+        // the framebuffer is destroyed frames_in_flight frames later, so it can still be used by the current frame
+        auto lru = std::min_element(framebuffer_array.begin(), framebuffer_array.end(), [](const auto &a, const auto &b) {
+            return a.second.last_used_frame < b.second.last_used_frame;
+        });
+        context->frame().destroy_queue.add(lru->second.standard);
+        context->frame().destroy_queue.add(lru->second.shader_interlock);
+        framebuffer_array.erase(lru);
+    }
 
     vk::FramebufferCreateInfo fb_info{
         .renderPass = standard_render_pass,
@@ -929,7 +1076,63 @@ Framebuffer &VKSurfaceCache::retrieve_framebuffer_handle(MemState &mem, SceGxmCo
         fb_interlock = state.device.createFramebuffer(fb_info);
     }
 
-    return (framebuffer_array[key] = { fb_standard, fb_interlock, color_result.base_image });
+    return (framebuffer_array[key] = { fb_standard, fb_interlock, color_result.base_image, context->frame_timestamp });
+}
+
+// index in the host pixel of each component of the guest pixel, the swizzles are inversed
+static std::array<uint32_t, 4> get_readback_swizzle(const ColorSurfaceCacheInfo &surface, bool is_swizzle_identity) {
+    if (format_need_additional_memory(surface.format))
+        return is_swizzle_identity ? std::array<uint32_t, 4>{ 0, 1, 2, 0 } : std::array<uint32_t, 4>{ 2, 1, 0, 0 };
+
+    if (is_swizzle_identity || vk::componentCount(surface.texture.format) == 1)
+        return { 0, 1, 2, 3 };
+
+    if (vk::componentCount(surface.texture.format) == 2)
+        return { 1, 0, 0, 0 };
+
+    switch (surface.swizzle.r) {
+    case vk::ComponentSwizzle::eB:
+        // BGRA
+        return { 2, 1, 0, 3 };
+    case vk::ComponentSwizzle::eA:
+        // ABGR
+        return { 3, 2, 1, 0 };
+    case vk::ComponentSwizzle::eG:
+        // ARGB
+        return { 3, 0, 1, 2 };
+    default:
+        return { 0, 1, 2, 3 };
+    }
+}
+
+ColorSurfaceCacheInfo *VKSurfaceCache::retrieve_color_surface_for_transfer(const SceGxmTransferImage &image, vk::Offset3D &offset, vk::Extent3D &extent) {
+    auto ite = color_address_lookup.find_containing(image.address.address());
+    if (ite == nullptr)
+        return nullptr;
+
+    ColorSurfaceCacheInfo &info = *ite->value;
+    if (info.res_multiplier != state.res_multiplier)
+        return nullptr;
+
+    // the transfer and the surface must agree on how the pixels are laid out in memory
+    const uint32_t bytes_per_pixel = (gxm::get_bits_per_pixel(image.format) + 7) >> 3;
+    const uint32_t bytes_per_pixel_in_store = gxm::bits_per_pixel(info.format) >> 3;
+    const uint32_t bytes_per_stride = info.pixel_stride * bytes_per_pixel_in_store;
+    if (bytes_per_pixel != bytes_per_pixel_in_store || image.stride != static_cast<int32_t>(bytes_per_stride))
+        return nullptr;
+
+    const uint32_t data_delta = image.address.address() - ite->start;
+    if ((data_delta % bytes_per_stride) % bytes_per_pixel != 0)
+        return nullptr;
+
+    const uint32_t x = (data_delta % bytes_per_stride) / bytes_per_pixel + image.x;
+    const uint32_t y = data_delta / bytes_per_stride + image.y;
+    if (x + image.width > info.original_width || y + image.height > info.original_height)
+        return nullptr;
+
+    offset = vk::Offset3D{ static_cast<int32_t>(x * state.res_multiplier), static_cast<int32_t>(y * state.res_multiplier), 0 };
+    extent = vk::Extent3D{ image.width * state.res_multiplier, image.height * state.res_multiplier, 1 };
+    return &info;
 }
 
 ColorSurfaceCacheInfo *VKSurfaceCache::perform_surface_sync() {
@@ -940,6 +1143,8 @@ ColorSurfaceCacheInfo *VKSurfaceCache::perform_surface_sync() {
     if (last_written_surface == nullptr || !*last_written_surface->need_surface_sync)
         return nullptr;
 
+    state.surface_sync_count.fetch_add(1, std::memory_order_relaxed);
+
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
     vk::CommandBuffer cmd_buffer = context->render_cmd;
 
@@ -988,109 +1193,132 @@ ColorSurfaceCacheInfo *VKSurfaceCache::perform_surface_sync() {
         image_layout = vk::ImageLayout::eTransferSrcOptimal;
     }
 
-    vk::Buffer buffer;
-    uint32_t offset;
-    if (format_need_additional_memory(last_written_surface->format)) {
-        if (!last_written_surface->copy_buffer)
-            last_written_surface->copy_buffer = std::make_unique<vkutil::Buffer>();
-
-        vkutil::Buffer &copy_buffer = *last_written_surface->copy_buffer;
-
-        if (!copy_buffer.buffer) {
-            copy_buffer.allocator = state.allocator;
-            // TODO: change the 4 if the format pixel size can become something else than 4 bytes (not the case now)
-            copy_buffer.size = last_written_surface->pixel_stride * last_written_surface->original_height * 4;
-            copy_buffer.init_buffer(vk::BufferUsageFlagBits::eTransferDst, vkutil::vma_mapped_alloc);
-        }
-
-        buffer = copy_buffer.buffer;
-        offset = 0;
-    } else {
-        std::tie(buffer, offset) = state.get_matching_mapping(last_written_surface->data);
-    }
     vk::BufferImageCopy copy{
-        .bufferOffset = offset,
+        .bufferOffset = 0,
         .bufferRowLength = last_written_surface->pixel_stride,
         .bufferImageHeight = last_written_surface->original_height,
         .imageSubresource = vkutil::color_subresource_layer,
         .imageOffset = { 0, 0, 0 },
         .imageExtent = { last_written_surface->original_width, last_written_surface->original_height, 1 }
     };
-    cmd_buffer.copyImageToBuffer(image_to_copy, image_layout, buffer, copy);
 
-    const bool need_post_sync = !is_swizzle_identity || format_need_additional_memory(last_written_surface->format);
-    ColorSurfaceCacheInfo *return_value = need_post_sync ? last_written_surface : nullptr;
-    last_written_surface = nullptr;
+    const bool need_conversion = !is_swizzle_identity || format_need_additional_memory(last_written_surface->format);
+    // the shader writes whole words of guest memory
+    last_written_surface->is_readback_converted = need_conversion && readback_pipeline
+        && (last_written_surface->data.address() % 4) == 0;
+
+    if (last_written_surface->is_readback_converted) {
+        // copy the surface as it is in a device buffer, then write it with the guest layout to the mapped memory
+        if (!last_written_surface->readback_buffer)
+            last_written_surface->readback_buffer = std::make_unique<vkutil::Buffer>();
+
+        vkutil::Buffer &readback_buffer = *last_written_surface->readback_buffer;
+        const uint32_t src_pixel_size = vk::blockSize(last_written_surface->texture.format);
+        if (!readback_buffer.buffer) {
+            readback_buffer.allocator = state.allocator;
+            readback_buffer.size = last_written_surface->pixel_stride * last_written_surface->original_height * src_pixel_size;
+            readback_buffer.init_buffer(vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress);
+        }
+        cmd_buffer.copyImageToBuffer(image_to_copy, image_layout, readback_buffer.buffer, copy);
+
+        vk::BufferMemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = readback_buffer.buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+        };
+        cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, {}, barrier, {});
 
-    return return_value;
-}
+        const uint32_t dst_components = format_need_additional_memory(last_written_surface->format) ? 3 : vk::componentCount(last_written_surface->texture.format);
+        const uint32_t component_bits = vk::componentBits(last_written_surface->texture.format, 0);
+        vk::BufferDeviceAddressInfoKHR address_info{
+            .buffer = readback_buffer.buffer
+        };
+        const SurfaceReadbackInfo info{
+            .src_address = state.device.getBufferAddress(address_info),
+            .dst_address = state.get_matching_device_address(last_written_surface->data.address()),
+            .dst_size = last_written_surface->pixel_stride * last_written_surface->original_height * dst_components * component_bits / 8,
+            .component_bits = component_bits,
+            .src_components = vk::componentCount(last_written_surface->texture.format),
+            .dst_components = dst_components,
+            .swizzle = get_readback_swizzle(*last_written_surface, is_swizzle_identity)
+        };
 
-template <typename T>
-void swizzle_text_T_2(T *pixels, uint32_t nb_pixel) {
-    for (int i = 0; i < nb_pixel; i++) {
-        std::swap(pixels[2 * i], pixels[2 * i + 1]);
-    }
-}
+        cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, readback_pipeline);
+        cmd_buffer.pushConstants(readback_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(SurfaceReadbackInfo), &info);
+        cmd_buffer.dispatch((info.dst_size + 255) / 256, 1, 1);
+    } else {
+        vk::Buffer buffer;
+        uint32_t offset;
+        if (format_need_additional_memory(last_written_surface->format)) {
+            if (!last_written_surface->copy_buffer)
+                last_written_surface->copy_buffer = std::make_unique<vkutil::Buffer>();
+
+            vkutil::Buffer &copy_buffer = *last_written_surface->copy_buffer;
+
+            if (!copy_buffer.buffer) {
+                copy_buffer.allocator = state.allocator;
+                // TODO: change the 4 if the format pixel size can become something else than 4 bytes (not the case now)
+                copy_buffer.size = last_written_surface->pixel_stride * last_written_surface->original_height * 4;
+                copy_buffer.init_buffer(vk::BufferUsageFlagBits::eTransferDst, vkutil::vma_mapped_alloc);
+            }
 
-template <typename T, size_t type>
-void swizzle_text_T_4(T *pixels, uint32_t nb_pixel) {
-    for (int i = 0; i < nb_pixel; i++) {
-        if constexpr (type == 0) {
-            // BGRA
-            std::swap(pixels[4 * i], pixels[4 * i + 2]);
-        } else if constexpr (type == 1) {
-            // ABGR
-            std::swap(pixels[4 * i], pixels[4 * i + 3]);
-            std::swap(pixels[4 * i + 1], pixels[4 * i + 2]);
+            buffer = copy_buffer.buffer;
+            offset = 0;
         } else {
-            // ARGB
-            T copy[] = { pixels[4 * i],
-                pixels[4 * i + 1],
-                pixels[4 * i + 2],
-                pixels[4 * i + 3] };
-            pixels[4 * i] = copy[3];
-            pixels[4 * i + 1] = copy[0];
-            pixels[4 * i + 2] = copy[1];
-            pixels[4 * i + 3] = copy[2];
+            std::tie(buffer, offset) = state.get_matching_mapping(last_written_surface->data);
         }
+        copy.bufferOffset = offset;
+        cmd_buffer.copyImageToBuffer(image_to_copy, image_layout, buffer, copy);
     }
+
+    ColorSurfaceCacheInfo *return_value = last_written_surface;
+    last_written_surface = nullptr;
+
+    return return_value;
 }
 
-template <typename T>
-void swizzle_text_T(T *pixels, uint32_t nb_pixel, ColorSurfaceCacheInfo *surface) {
+// returns for each component of the pixel written by the GPU the component it must be read from
+static std::array<uint8_t, 4> get_swizzle_components(const ColorSurfaceCacheInfo *surface) {
     // there can only be 2 or 4 component textures here
-    if (vk::componentCount(surface->texture.format) == 2) {
-        swizzle_text_T_2<T>(pixels, nb_pixel);
-    } else {
-        // find the swizzle
-        // swizzles are inversed
-        switch (surface->swizzle.r) {
-        case vk::ComponentSwizzle::eB:
-            // BGRA
-            swizzle_text_T_4<T, 0>(pixels, nb_pixel);
-            break;
-        case vk::ComponentSwizzle::eA:
-            // ABGR
-            swizzle_text_T_4<T, 1>(pixels, nb_pixel);
-            break;
-        case vk::ComponentSwizzle::eG:
-            // ARGB
-            swizzle_text_T_4<T, 2>(pixels, nb_pixel);
-            break;
-        }
+    if (vk::componentCount(surface->texture.format) == 2)
+        return { 1, 0, 2, 3 };
+
+    // find the swizzle
+    // swizzles are inversed
+    switch (surface->swizzle.r) {
+    case vk::ComponentSwizzle::eB:
+        // BGRA
+        return { 2, 1, 0, 3 };
+    case vk::ComponentSwizzle::eA:
+        // ABGR
+        return { 3, 2, 1, 0 };
+    case vk::ComponentSwizzle::eG:
+        // ARGB
+        return { 3, 0, 1, 2 };
+    default:
+        return { 0, 1, 2, 3 };
     }
 }
 
-void VKSurfaceCache::perform_post_surface_sync(const MemState &mem, ColorSurfaceCacheInfo *surface) {
+void VKSurfaceCache::perform_post_surface_sync(MemState &mem, ColorSurfaceCacheInfo *surface) {
     if (surface == nullptr)
         return;
 
+    // the copy was done by the GPU, the write tracking of the textures could not see it
+    mark_range_written(mem, surface->data.address(), surface->total_bytes);
+    if (surface->is_readback_converted)
+        return;
+
     const uint32_t nb_pixels = surface->pixel_stride * surface->original_height;
     uint8_t *pixels = surface->data.cast<uint8_t>().get(mem);
+    const bool is_swizzle_identity = surface->swizzle.r == vk::ComponentSwizzle::eR || !format_support_swizzle(surface->format);
 
     if (format_need_additional_memory(surface->format)) {
         // special case, use a custom function
-        const bool is_swizzle_identity = surface->swizzle.r == vk::ComponentSwizzle::eR;
         if (!surface->sws_context) {
             const AVPixelFormat dst_fmt = is_swizzle_identity ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_BGR24;
             surface->sws_context = sws_getContext(surface->original_width, surface->original_height, AV_PIX_FMT_RGB0, surface->original_width, surface->original_height, dst_fmt, 0, nullptr, nullptr, nullptr);
@@ -1103,17 +1331,17 @@ void VKSurfaceCache::perform_post_surface_sync(const MemState &mem, ColorSurface
         return;
     }
 
-    switch (vk::componentBits(surface->texture.format, 0)) {
-    case 8:
-        swizzle_text_T<uint8_t>(pixels, nb_pixels, surface);
-        break;
-    case 16:
-        swizzle_text_T<uint16_t>(reinterpret_cast<uint16_t *>(pixels), nb_pixels, surface);
-        break;
-    case 32:
-        swizzle_text_T<uint32_t>(reinterpret_cast<uint32_t *>(pixels), nb_pixels, surface);
-        break;
-    }
+    if (is_swizzle_identity)
+        return;
+
+    const uint32_t component_bits = vk::componentBits(surface->texture.format, 0);
+    if (component_bits != 8 && component_bits != 16 && component_bits != 32)
+        return;
+
+    const uint32_t component_count = vk::componentCount(surface->texture.format);
+    const uint32_t component_size = component_bits / 8;
+    const auto mask = texture::get_component_shuffle_mask(get_swizzle_components(surface), component_count, component_size);
+    texture::shuffle_pixel_bytes(pixels, static_cast<size_t>(nb_pixels) * component_count * component_size, mask);
 }
 
 void VKSurfaceCache::destroy_associated_framebuffers(const VKRenderTarget *render_target) {
@@ -1122,21 +1350,18 @@ void VKSurfaceCache::destroy_associated_framebuffers(const VKRenderTarget *rende
 }
 
 vk::ImageView VKSurfaceCache::sourcing_color_surface_for_presentation(Ptr<const void> address, uint32_t pitch, Viewport &viewport) {
-    // get closest surface with an address below address
-    auto ite = color_address_lookup.upper_bound(address.address());
-    if (ite == color_address_lookup.begin()) {
+    // get closest surface containing the address
+    auto ite = color_address_lookup.find_containing(address.address());
+    if (ite == nullptr)
         return nullptr;
-    }
-    ite--;
 
-    ColorSurfaceCacheInfo &info = *ite->second;
-    if (info.data.address() + info.total_bytes <= address.address())
-        // they do not overlap
+    ColorSurfaceCacheInfo &info = *ite->value;
+    if (info.res_multiplier != state.res_multiplier)
         return nullptr;
 
     if (info.pixel_stride == pitch) {
         // In assumption the format is RGBA8
-        const size_t data_delta = address.address() - ite->first;
+        const size_t data_delta = address.address() - ite->start;
         uint32_t limited_height = viewport.height;
         if ((data_delta % (pitch * 4)) == 0) {
             uint32_t start_sourced_line = (data_delta / (pitch * 4)) * state.res_multiplier;
@@ -73,6 +73,7 @@ void sync_clipping(VKContext &context) {
     if (!context.is_recording)
         return;
 
+    context.flush_pending_draws();
     context.render_cmd.setScissor(0, context.scissor);
 }
 
@@ -94,11 +95,75 @@ void sync_stencil_func(VKContext &context, const bool is_back) {
         state = is_back ? &context.record.back_stencil_state_values : &context.record.front_stencil_state_values;
     }
 
+    context.flush_pending_draws();
     context.render_cmd.setStencilCompareMask(face, state->compare_mask);
     context.render_cmd.setStencilReference(face, state->ref);
     context.render_cmd.setStencilWriteMask(face, state->write_mask);
 }
 
+void sync_stencil_op(VKContext &context) {
+    if (!context.state.pipeline_cache.use_extended_dynamic_state) {
+        // the stencil ops are part of the pipeline
+        refresh_pipeline(context);
+        return;
+    }
+
+    if (!context.is_recording)
+        return;
+
+    auto set_stencil_op = [&](vk::StencilFaceFlags face, const GxmStencilStateOp &state) {
+        context.render_cmd.setStencilOpEXT(face, translate_stencil_op(state.stencil_fail), translate_stencil_op(state.depth_pass),
+            translate_stencil_op(state.depth_fail), translate_stencil_func(state.func));
+    };
+
+    context.flush_pending_draws();
+    if (context.record.two_sided == SCE_GXM_TWO_SIDED_DISABLED) {
+        set_stencil_op(vk::StencilFaceFlagBits::eFrontAndBack, context.record.front_stencil_state_op);
+    } else {
+        set_stencil_op(vk::StencilFaceFlagBits::eFront, context.record.front_stencil_state_op);
+        set_stencil_op(vk::StencilFaceFlagBits::eBack, context.record.back_stencil_state_op);
+    }
+}
+
+void sync_cull(VKContext &context) {
+    if (!context.state.pipeline_cache.use_extended_dynamic_state) {
+        refresh_pipeline(context);
+        return;
+    }
+
+    if (!context.is_recording)
+        return;
+
+    context.flush_pending_draws();
+    context.render_cmd.setCullModeEXT(translate_cull_mode(context.record.cull_mode));
+}
+
+void sync_depth_func(VKContext &context) {
+    if (!context.state.pipeline_cache.use_extended_dynamic_state) {
+        refresh_pipeline(context);
+        return;
+    }
+
+    if (!context.is_recording)
+        return;
+
+    context.flush_pending_draws();
+    context.render_cmd.setDepthCompareOpEXT(translate_depth_func(context.record.front_depth_func));
+}
+
+void sync_depth_write_enable(VKContext &context) {
+    if (!context.state.pipeline_cache.use_extended_dynamic_state) {
+        refresh_pipeline(context);
+        return;
+    }
+
+    if (!context.is_recording)
+        return;
+
+    context.flush_pending_draws();
+    context.render_cmd.setDepthWriteEnableEXT(context.record.front_depth_write_mode == SCE_GXM_DEPTH_WRITE_ENABLED);
+}
+
 void sync_mask(VKContext &context, const MemState &mem) {
     if (!context.state.features.use_mask_bit)
         return;
@@ -107,6 +172,7 @@ void sync_mask(VKContext &context, const MemState &mem) {
 
     std::array<float, 4> clear_bytes = { initial_val, initial_val, initial_val, initial_val };
     vk::ClearColorValue clear_color{ clear_bytes };
+    context.flush_pending_draws();
     context.render_target->mask.transition_to_discard(context.render_cmd, vkutil::ImageLayout::TransferDst);
     context.render_cmd.clearColorImage(context.render_target->mask.image, vk::ImageLayout::eTransferDstOptimal, clear_color, vkutil::color_subresource_range);
     context.render_target->mask.transition_to(context.render_cmd, vkutil::ImageLayout::StorageImage);
@@ -116,6 +182,7 @@ void sync_depth_bias(VKContext &context) {
     if (!context.is_recording)
         return;
 
+    context.flush_pending_draws();
     context.render_cmd.setDepthBias(static_cast<float>(context.record.depth_bias_unit), 0.0, static_cast<float>(context.record.depth_bias_slope));
 }
 
@@ -137,6 +204,7 @@ void sync_depth_data(VKContext &context) {
         .baseArrayLayer = 0,
         .layerCount = 1
     };
+    context.flush_pending_draws();
     context.render_cmd.clearAttachments(clear_attachment, clear_rect);
 }
 
@@ -158,6 +226,7 @@ void sync_stencil_data(VKContext &context, const MemState &mem) {
         .baseArrayLayer = 0,
         .layerCount = 1
     };
+    context.flush_pending_draws();
     context.render_cmd.clearAttachments(clear_attachment, clear_rect);
 }
 
@@ -165,8 +234,10 @@ void sync_point_line_width(VKContext &context, const bool is_front) {
     if (!context.is_recording)
         return;
 
-    if (is_front && context.state.physical_device_features.wideLines)
+    if (is_front && context.state.physical_device_features.wideLines) {
+        context.flush_pending_draws();
         context.render_cmd.setLineWidth(static_cast<float>(context.record.line_width * context.state.res_multiplier));
+    }
 }
 
 void sync_viewport_flat(VKContext &context) {
@@ -181,6 +252,7 @@ void sync_viewport_flat(VKContext &context) {
 
     if (!context.is_recording)
         return;
+    context.flush_pending_draws();
     context.render_cmd.setViewport(0, context.viewport);
 }
 
@@ -212,6 +284,7 @@ void sync_viewport_real(VKContext &context, const float xOffset, const float yOf
 
     if (!context.is_recording)
         return;
+    context.flush_pending_draws();
     context.render_cmd.setViewport(0, context.viewport);
 }
 
@@ -234,8 +307,7 @@ void sync_visibility_buffer(VKContext &context, Ptr<uint32_t> buffer, uint32_t s
         ite = context.visibility_buffers.find(buffer.address());
 
         std::tie(ite->second.gpu_buffer, ite->second.buffer_offset) = context.state.get_matching_mapping(buffer.cast<void>());
-        // the + 1 is to make computing the ranges easier in context.cpp
-        ite->second.queries_used.resize(ite->second.size + 1, false);
+        ite->second.queries_used.resize((ite->second.size + 63) / 64, 0);
     }
 
     context.current_visibility_buffer = &ite->second;
@@ -255,6 +327,7 @@ void sync_visibility_index(VKContext &context, bool enable, uint32_t index, bool
 
     if (!enable) {
         if (context.is_in_query) {
+            context.flush_pending_draws();
             context.render_cmd.endQuery(context.current_visibility_buffer->query_pool, context.current_query_idx);
             context.is_in_query = false;
         }
@@ -265,6 +338,7 @@ void sync_visibility_index(VKContext &context, bool enable, uint32_t index, bool
 
     // do not end the query if it's the same index
     if (context.is_in_query && context.current_query_idx != index) {
+        context.flush_pending_draws();
         context.render_cmd.endQuery(context.current_visibility_buffer->query_pool, context.current_query_idx);
         context.is_in_query = false;
     }
@@ -23,8 +23,10 @@
 
 #include <gxm/functions.h>
 #include <gxm/types.h>
+#include <mem/util.h>
 #include <renderer/functions.h>
 #include <util/align.h>
+#include <util/memory_accounting.h>
 #include <vkutil/vkutil.h>
 
 namespace renderer::vulkan {
@@ -142,89 +144,203 @@ void sync_texture(VKContext &context, MemState &mem, std::size_t index, SceGxmTe
     }
 }
 
-void VKTextureCache::prepare_staging_buffer(bool is_configure) {
-    assert(!is_texture_transfer_ready);
+void VKTextureCache::free_staging_regions() {
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
 
-    TextureStagingBuffer *staging_buffer = &staging_buffers[staging_idx];
-    // some textures must be 16-bytes aligned, and staging_buffer->buffer.size is 16-bytes aligned
-    staging_buffer->used_so_far = align(staging_buffer->used_so_far, 16);
-    // we can keep using the same buffer as before if we are in the same scene and there is enough memory left
-    bool use_previous_buffer = (current_scene_timestamp == staging_buffer->scene_timestamp) && (staging_buffer->buffer.size - staging_buffer->used_so_far) >= current_texture->memory_needed;
+    // a region is no longer used if it was used at least frames_in_flight frames ago
+    // or if we have already waited for the fence of its scene
+    while (!staging_ring.regions.empty()) {
+        const StagingRegion &region = staging_ring.regions.front();
+        if (region.frame_timestamp + state.frames_in_flight > context->frame_timestamp
+            && region.scene_timestamp > last_waited_scene)
+            break;
+
+        staging_ring.regions.pop_front();
+    }
+}
 
-    if (!use_previous_buffer) {
-        staging_idx = (staging_idx + 1) % NB_TEXTURE_STAGING_BUFFERS;
-        staging_buffer = &staging_buffers[staging_idx];
+int64_t VKTextureCache::allocate_staging(uint32_t size) {
+    const uint64_t ring_size = staging_ring.buffer.size;
+    if (staging_ring.regions.empty())
+        return size <= ring_size ? 0 : -1;
+
+    // some textures must be 16-bytes aligned
+    const uint64_t head = align(staging_ring.regions.back().end, 16);
+    const uint64_t tail = staging_ring.regions.front().begin;
+    if (staging_ring.regions.back().begin >= tail) {
+        // the used part does not wrap around, we can use the end of the ring or its beginning
+        if (head + size <= ring_size)
+            return head;
+        if (size <= tail)
+            return 0;
+    } else if (head + size <= tail) {
+        return head;
     }
 
-    // if we are not using the previous buffer, we wait if the buffer was used at least once,
-    // less than MAX_FRAMES_RENDERING frames ago and we have not yet waited for its fence
-    const bool need_wait = !use_previous_buffer
-        && staging_buffer->frame_timestamp != ~0
-        && staging_buffer->frame_timestamp > context->frame_timestamp - MAX_FRAMES_RENDERING
-        && staging_buffer->scene_timestamp > last_waited_scene;
+    return -1;
+}
+
+void VKTextureCache::flush_and_wait() {
+    VKContext *context = reinterpret_cast<VKContext *>(state.context);
     const vk::Fence current_fence = context->next_fence;
 
-    if (need_wait) {
-        if (staging_buffer->scene_timestamp == current_scene_timestamp) {
-            assert(current_fence == staging_buffer->waiting_fence);
-            // special case, all the staging buffer are occupied by the current scene
-            // submit the command buffer and wait for it
-            context->prerender_cmd.end();
-            context->cmdbuffers_to_submit.push_back(context->prerender_cmd);
-
-            vk::SubmitInfo submit_info{};
-            submit_info.setCommandBuffers(context->cmdbuffers_to_submit);
-            state.general_queue.submit(submit_info, current_fence);
-            context->cmdbuffers_to_submit.clear();
-
-            auto result = state.device.waitForFences(current_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
-            if (result != vk::Result::eSuccess) {
-                LOG_ERROR("Could not wait for fences.");
-                assert(false);
-                return;
-            }
-            state.device.resetFences(current_fence);
-
-            // also call begin again on the prerender command
-            vk::CommandBufferBeginInfo begin_info{
-                .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
-            };
-            context->prerender_cmd.begin(begin_info);
-
-            // then set all buffers as unused
-            for (auto &buffer : staging_buffers) {
-                buffer.frame_timestamp = ~0;
-                buffer.scene_timestamp = ~0;
-            }
-        } else {
-            // wait for the fence, but don't reset it
-            auto result = state.device.waitForFences(staging_buffer->waiting_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
-            if (result != vk::Result::eSuccess) {
-                LOG_ERROR("Could not wait for fences.");
-                assert(false);
-                return;
-            }
-            last_waited_scene = staging_buffer->scene_timestamp;
-        }
+    // submit the command buffer and wait for it
+    context->prerender_cmd.end();
+    context->cmdbuffers_to_submit.push_back(context->prerender_cmd);
+
+    vk::SubmitInfo submit_info{};
+    submit_info.setCommandBuffers(context->cmdbuffers_to_submit);
+    const vk::Semaphore semaphore = submit_transfer_cmd();
+    const vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+    if (semaphore) {
+        submit_info.setWaitSemaphores(semaphore);
+        submit_info.setWaitDstStageMask(wait_stage);
     }
+    context->submit(submit_info);
+    context->cmdbuffers_to_submit.clear();
+
+    context->wait_for_submission(current_fence, context->last_timeline_value);
+    if (current_fence)
+        state.device.resetFences(current_fence);
+
+    // also call begin again on the prerender command
+    vk::CommandBufferBeginInfo begin_info{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    };
+    context->prerender_cmd.begin(begin_info);
+
+    // then the whole ring is unused
+    staging_ring.regions.clear();
+}
+
+void VKTextureCache::grow_staging_ring(uint32_t size) {
+    // this is rare enough (a texture using more than the whole ring) that we can wait for the GPU
+    if (!staging_ring.regions.empty())
+        flush_and_wait();
+
+    // no need to defer destroy it as we know it is no longer being used
+    staging_ring.buffer.destroy();
+    staging_ring.buffer.size = align(size, 16);
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eTransferSrc;
+    if (texture_decoder.pipeline_layout)
+        usage |= vk::BufferUsageFlagBits::eStorageBuffer;
+    // the copies can be done by both the transfer and the general queue
+    std::vector<uint32_t> queue_families;
+    if (use_transfer_queue)
+        queue_families = { state.general_family_index, state.transfer_family_index };
+    staging_ring.buffer.init_buffer(usage, vkutil::vma_mapped_alloc, queue_families);
+
+    if (texture_decoder.pipeline_layout) {
+        // same as the buffer, the descriptor set is not being used
+        vk::DescriptorBufferInfo buffer_info{
+            .buffer = staging_ring.buffer.buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+        vk::WriteDescriptorSet write_descr{
+            .dstSet = texture_decoder.descriptor_set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &buffer_info
+        };
+        state.device.updateDescriptorSets(write_descr, {});
+    }
+}
+
+void VKTextureCache::begin_transfer_cmd() {
+    VKContext *context = reinterpret_cast<VKContext *>(state.context);
+    FrameObject &frame = context->frame();
+
+    if (frame.transfer_idx == frame.transfer_cmds.size()) {
+        vk::CommandBufferAllocateInfo buffer_info{
+            .commandPool = frame.transfer_pool,
+            .commandBufferCount = 1
+        };
+        frame.transfer_cmds.push_back(state.device.allocateCommandBuffers(buffer_info)[0]);
+        frame.transfer_semaphores.push_back(state.device.createSemaphore({}));
+    }
+
+    transfer_cmd = frame.transfer_cmds[frame.transfer_idx];
+    transfer_semaphore = frame.transfer_semaphores[frame.transfer_idx];
+    frame.transfer_idx++;
 
-    // then we can use the buffer
-    cmd_buffer = context->prerender_cmd;
-    if (!use_previous_buffer) {
-        staging_buffer->scene_timestamp = current_scene_timestamp;
-        staging_buffer->frame_timestamp = context->frame_timestamp;
-        staging_buffer->waiting_fence = current_fence;
-        staging_buffer->used_so_far = 0;
+    vk::CommandBufferBeginInfo begin_info{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    };
+    transfer_cmd.begin(begin_info);
+}
+
+vk::Semaphore VKTextureCache::submit_transfer_cmd() {
+    // the staging buffer must be filled before any copy from it is submitted
+    wait_decode_jobs();
+
+    if (!transfer_cmd)
+        return nullptr;
 
-        if (staging_buffer->buffer.size < current_texture->memory_needed) {
-            // we need to create a bigger buffer
-            // destroy the previous one if there is, no need to defer destroy it as we know it is no longer being used
-            staging_buffer->buffer.destroy();
+    transfer_cmd.end();
+    vk::SubmitInfo submit_info{};
+    submit_info.setCommandBuffers(transfer_cmd);
+    submit_info.setSignalSemaphores(transfer_semaphore);
+    state.transfer_queue.submit(submit_info);
 
-            staging_buffer->buffer.size = current_texture->memory_needed;
-            staging_buffer->buffer.init_buffer(vk::BufferUsageFlagBits::eTransferSrc, vkutil::vma_mapped_alloc);
+    transfer_cmd = nullptr;
+    return transfer_semaphore;
+}
+
+void VKTextureCache::prepare_staging_buffer(bool is_configure) {
+    assert(!is_texture_transfer_ready);
+    VKContext *context = reinterpret_cast<VKContext *>(state.context);
+
+    const uint32_t memory_needed = current_texture->memory_needed;
+    if (memory_needed > staging_ring.buffer.size)
+        grow_staging_ring(memory_needed);
+
+    free_staging_regions();
+    int64_t offset = allocate_staging(memory_needed);
+    while (offset < 0) {
+        // the ring is full, wait for the oldest region to be available
+        const StagingRegion &oldest = staging_ring.regions.front();
+        if (oldest.scene_timestamp == current_scene_timestamp) {
+            assert(oldest.fence == context->next_fence);
+            // special case, the whole ring is occupied by the current scene
+            flush_and_wait();
+        } else {
+            context->wait_for_submission(oldest.fence, oldest.timeline_value);
+            last_waited_scene = oldest.scene_timestamp;
+            free_staging_regions();
         }
+        offset = allocate_staging(memory_needed);
+    }
+
+    // reserve the memory, the part not used is given back in upload_done
+    staging_used_so_far = static_cast<uint32_t>(offset);
+    staging_end = staging_used_so_far + memory_needed;
+    if (!staging_ring.regions.empty() && staging_ring.regions.back().scene_timestamp == current_scene_timestamp
+        && align(staging_ring.regions.back().end, 16) == staging_used_so_far) {
+        // extend the region of the previous texture
+        staging_ring.regions.back().end = staging_end;
+    } else {
+        staging_ring.regions.push_back(StagingRegion{
+            .begin = staging_used_so_far,
+            .end = staging_end,
+            .scene_timestamp = current_scene_timestamp,
+            .frame_timestamp = context->frame_timestamp,
+            .fence = context->next_fence,
+            // the value the submission of the current scene will signal
+            .timeline_value = context->last_timeline_value + 1 });
+    }
+
+    // new textures are not used by the GPU yet, they can be uploaded by the transfer queue
+    // textures already in use are uploaded in order with the draws reading them
+    is_transfer_upload = use_transfer_queue && is_configure && !current_texture->needs_decoding;
+    if (is_transfer_upload) {
+        if (!transfer_cmd)
+            begin_transfer_cmd();
+        cmd_buffer = transfer_cmd;
+    } else {
+        cmd_buffer = context->prerender_cmd;
     }
 
     // now the transition
@@ -249,23 +365,224 @@ bool VKTextureCache::init(const bool hashless_texture_cache, const fs::path &tex
     // set a limit to the number of samplers which can be allocated at the same time
     const size_t max_sampler_used = std::min(state.physical_device_properties.limits.maxSamplerAllocationCount / 2, 512U);
 
+    // the cache can grow as long as the textures fit in the memory budget
+    max_texture_count = TextureCacheMaxSize;
     TextureCache::init(hashless_texture_cache, texture_folder, game_id, max_sampler_used);
     backend = Backend::Vulkan;
 
-    // don't forget to specify the allocator for all the staging buffers
-    for (int i = 0; i < NB_TEXTURE_STAGING_BUFFERS; i++)
-        staging_buffers[i].buffer.allocator = state.allocator;
-
     samplers.resize(max_sampler_used);
 
+    decode_bcn = !state.physical_device_features.textureCompressionBC;
+    if (decode_bcn)
+        LOG_INFO("BCn textures are not supported by the GPU, they will be decoded before being uploaded");
+    init_texture_decoder();
+    support_gpu_expansion = static_cast<bool>(texture_decoder.expand_pipeline);
+    // the pixels are written to the staging buffer which stays mapped, the copies only have to be recorded
+    support_deferred_upload = true;
+
+    use_transfer_queue = state.transfer_family_index != state.general_family_index;
+    if (use_transfer_queue)
+        LOG_INFO("New textures are uploaded using a dedicated transfer queue");
+
+    // the textures are put in the biggest device local heap
+    vk::DeviceSize heap_size = 0;
+    for (uint32_t i = 0; i < state.physical_device_memory.memoryHeapCount; i++) {
+        const vk::MemoryHeap &heap = state.physical_device_memory.memoryHeaps[i];
+        if ((heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal) && heap.size > heap_size) {
+            device_local_heap = i;
+            heap_size = heap.size;
+        }
+    }
+    update_memory_budget();
+
+    // don't forget to specify the allocator for the staging ring
+    staging_ring.buffer.allocator = state.allocator;
+    grow_staging_ring(TEXTURE_STAGING_RING_SIZE);
+
     return true;
 }
 
+void VKTextureCache::cleanup() {
+    wait_decode_jobs();
+
+    staging_ring.buffer.destroy();
+    staging_ring.regions.clear();
+
+    state.device.destroy(texture_decoder.bcn_pipeline);
+    state.device.destroy(texture_decoder.expand_pipeline);
+    state.device.destroy(texture_decoder.pipeline_layout);
+    state.device.destroy(texture_decoder.descriptor_pool);
+    state.device.destroy(texture_decoder.descriptor_set_layout);
+    texture_decoder = {};
+}
+
+void VKTextureCache::init_texture_decoder() {
+    const std::string builtin_shaders_path = state.shared_path + "shaders-builtin/vulkan/";
+    vk::ShaderModule expand_shader = vkutil::load_shader(state.device, builtin_shaders_path + "texture_expand.comp.spv");
+    if (!expand_shader)
+        LOG_WARN("Could not load texture_expand.comp.spv, paletted and YUV textures will be expanded on the CPU");
+    vk::ShaderModule bcn_shader;
+    if (decode_bcn) {
+        bcn_shader = vkutil::load_shader(state.device, builtin_shaders_path + "texture_decode_bcn.comp.spv");
+        if (!bcn_shader)
+            LOG_WARN("Could not load texture_decode_bcn.comp.spv, BCn textures will be decoded on the CPU");
+    }
+    if (!expand_shader && !bcn_shader)
+        return;
+
+    vk::DescriptorSetLayoutBinding binding{
+        .binding = 0,
+        .descriptorType = vk::DescriptorType::eStorageBuffer,
+        .descriptorCount = 1,
+        .stageFlags = vk::ShaderStageFlagBits::eCompute
+    };
+    vk::DescriptorSetLayoutCreateInfo descriptor_info{};
+    descriptor_info.setBindings(binding);
+    texture_decoder.descriptor_set_layout = state.device.createDescriptorSetLayout(descriptor_info);
+
+    vk::DescriptorPoolSize pool_size{
+        .type = vk::DescriptorType::eStorageBuffer,
+        .descriptorCount = 1
+    };
+    vk::DescriptorPoolCreateInfo pool_info{
+        .maxSets = 1
+    };
+    pool_info.setPoolSizes(pool_size);
+    texture_decoder.descriptor_pool = state.device.createDescriptorPool(pool_info);
+
+    vk::DescriptorSetAllocateInfo descr_set_info{
+        .descriptorPool = texture_decoder.descriptor_pool
+    };
+    descr_set_info.setSetLayouts(texture_decoder.descriptor_set_layout);
+    texture_decoder.descriptor_set = state.device.allocateDescriptorSets(descr_set_info)[0];
+
+    vk::PushConstantRange push_constant{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset = 0,
+        .size = sizeof(TextureDecodeInfo)
+    };
+    vk::PipelineLayoutCreateInfo layout_info{};
+    layout_info.setSetLayouts(texture_decoder.descriptor_set_layout);
+    layout_info.setPushConstantRanges(push_constant);
+    texture_decoder.pipeline_layout = state.device.createPipelineLayout(layout_info);
+
+    auto create_pipeline = [&](vk::ShaderModule shader) -> vk::Pipeline {
+        if (!shader)
+            return {};
+
+        vk::ComputePipelineCreateInfo compute_info{
+            .stage = {
+                .stage = vk::ShaderStageFlagBits::eCompute,
+                .module = shader,
+                .pName = "main" },
+            .layout = texture_decoder.pipeline_layout
+        };
+        auto result = state.device.createComputePipeline(nullptr, compute_info);
+        state.device.destroy(shader);
+        if (result.result != vk::Result::eSuccess) {
+            LOG_ERROR("Failed to create compute pipeline");
+            return {};
+        }
+        return result.value;
+    };
+    texture_decoder.bcn_pipeline = create_pipeline(bcn_shader);
+    texture_decoder.expand_pipeline = create_pipeline(expand_shader);
+}
+
+void VKTextureCache::decode_texture(vk::Pipeline pipeline, const TextureDecodeInfo &info, uint32_t group_count_x, uint32_t group_count_y, uint32_t decoded_size) {
+    // the shaders write whole words
+    assert(info.dst_offset % 4 == 0);
+
+    cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, texture_decoder.pipeline_layout, 0, texture_decoder.descriptor_set, {});
+    cmd_buffer.pushConstants(texture_decoder.pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(TextureDecodeInfo), &info);
+    cmd_buffer.dispatch(group_count_x, group_count_y, 1);
+
+    // the decoded texture is then copied to the image
+    vk::BufferMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = staging_ring.buffer.buffer,
+        .offset = info.dst_offset,
+        .size = decoded_size
+    };
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, {}, barrier, {});
+}
+
+void VKTextureCache::update_memory_budget() {
+    // the budget is exact with VK_EXT_memory_budget, vma estimates it otherwise
+    std::array<vma::Budget, VK_MAX_MEMORY_HEAPS> budgets;
+    state.allocator.getHeapBudgets(budgets.data());
+    const vma::Budget &budget = budgets[device_local_heap];
+
+    // memory used by everything else (surfaces, buffers, other applications...)
+    const uint64_t other_usage = budget.usage > memory_used ? budget.usage - memory_used : 0;
+    // keep some room for the other allocations to grow
+    const uint64_t margin = budget.budget / 8;
+    const uint64_t available = budget.budget > other_usage + margin ? budget.budget - other_usage - margin : 0;
+    // always allow some textures, even if the driver is asking us to use less memory
+    memory_budget = std::max<uint64_t>(available, MiB(128));
+    // the soft budget set by the user can only lower it
+    const uint64_t soft_budget = get_memory_budget(MemoryCategory::Textures);
+    if (soft_budget != 0)
+        memory_budget = std::min(memory_budget, soft_budget);
+
+    set_memory_usage(MemoryCategory::Textures, memory_used);
+    state.texture_memory_used = memory_used;
+    state.texture_memory_peak = memory_peak;
+}
+
 void VKTextureCache::select(size_t index, const SceGxmTexture &texture) {
+    if (index >= textures.size())
+        textures.resize(index + 1);
     current_texture = &textures[index];
     is_texture_transfer_ready = false;
 }
 
+// format of a BCn texture once decoded, this is the format decompress_bc_image outputs
+static vk::Format get_bcn_decoded_format(const SceGxmTextureBaseFormat base_format) {
+    switch (base_format) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC1:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC2:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC3:
+        return vk::Format::eR8G8B8A8Unorm;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC4:
+        return vk::Format::eR8Unorm;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_SBC4:
+        return vk::Format::eR8Snorm;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC5:
+        return vk::Format::eR8G8Unorm;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_SBC5:
+        return vk::Format::eR8G8Snorm;
+    default:
+        return vk::Format::eUndefined;
+    }
+}
+
+// same as the format_id used by decompress_bc_image
+static uint8_t get_bcn_format_id(const SceGxmTextureBaseFormat base_format) {
+    switch (base_format) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC1:
+        return 1;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC2:
+        return 2;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC3:
+        return 3;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC4:
+        return 4;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_SBC4:
+        return 5;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_UBC5:
+        return 6;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_SBC5:
+        return 7;
+    default:
+        return 0;
+    }
+}
+
 static vk::Format linear_to_srgb(const vk::Format format) {
     switch (format) {
     case vk::Format::eR8Unorm:
@@ -320,17 +637,31 @@ void VKTextureCache::configure_texture(const SceGxmTexture &gxm_texture) {
     const uint16_t mip_count = renderer::texture::get_upload_mip(gxm_texture.true_mip_count(), width, height);
 
     vk::Format vk_format = texture::translate_format(base_format);
+    const bool is_decoded = decode_bcn && get_bcn_format_id(base_format) != 0;
+    if (is_decoded)
+        vk_format = get_bcn_decoded_format(base_format);
+    else if (decode_bcn && gxm::is_bcn_format(base_format))
+        LOG_ERROR_ONCE("BCn format {} is not supported by the GPU and can't be decoded", log_hex(base_format));
     if (gxm_texture.gamma_mode) {
         vk_format = linear_to_srgb(vk_format);
     }
 
     current_texture->mip_count = mip_count;
     current_texture->is_cube = is_cube;
+    current_texture->needs_decoding = (is_decoded && texture_decoder.bcn_pipeline)
+        || (support_gpu_expansion && (gxm::is_paletted_format(base_format) || gxm::is_yuv_format(base_format)));
     uint32_t memory_needed = get_image_memory_upper_bound(gxm_texture, vk_format, base_format);
     if (mip_count > 1)
         // using mips, the overall memory needed will be 4/3 of the base memory
         // round up to 3/2
         memory_needed += memory_needed / 2;
+    if (is_decoded)
+        // the compressed data is at most half the size of the decoded one and is also put in the staging buffer
+        // each decoded mip is 16-byte aligned
+        memory_needed += memory_needed / 2 + mip_count * 16;
+    else if (support_gpu_expansion && (gxm::is_paletted_format(base_format) || gxm::is_yuv_format(base_format)))
+        // same for the indices or the YUV planes, each mip also has its own copy of the palette
+        memory_needed += memory_needed / 2 + mip_count * (256 * 4 + 32);
     if (is_cube)
         memory_needed *= 6;
     current_texture->memory_needed = align(memory_needed, 16);
@@ -366,6 +697,7 @@ void VKTextureCache::configure_texture(const SceGxmTexture &gxm_texture) {
     };
 
     std::tie(image.image, image.allocation) = image.allocator.createImage(image_info, vkutil::vma_auto_alloc);
+    current_info->memory_size = static_cast<uint32_t>(image.allocator.getAllocationInfo(image.allocation).size);
 
     // create image view
     vk::ImageSubresourceRange range{
@@ -392,11 +724,8 @@ void VKTextureCache::configure_texture(const SceGxmTexture &gxm_texture) {
 }
 
 // add an alpha channel to u8u8u8 textures
-static void *add_alpha_channel(const void *pixels, const uint32_t width, const uint32_t height, std::vector<uint8_t> &data) {
-    data.resize(width * height * 4);
-
+static void add_alpha_channel(uint8_t *dst, const void *pixels, const uint32_t width, const uint32_t height) {
     const uint8_t *src = reinterpret_cast<const uint8_t *>(pixels);
-    uint8_t *dst = data.data();
     for (uint32_t y = 0; y < height; y++) {
         for (uint32_t x = 0; x < width; x++) {
             dst[0] = src[0];
@@ -409,8 +738,6 @@ static void *add_alpha_channel(const void *pixels, const uint32_t width, const u
             dst += 4;
         }
     }
-
-    return data.data();
 }
 
 void VKTextureCache::upload_texture_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height,
@@ -419,7 +746,6 @@ void VKTextureCache::upload_texture_impl(SceGxmTextureBaseFormat base_format, ui
         prepare_staging_buffer();
 
     vkutil::Image &image = current_texture->texture;
-    TextureStagingBuffer &staging_buffer = staging_buffers[staging_idx];
 
     if (face > 0)
         face--;
@@ -427,31 +753,106 @@ void VKTextureCache::upload_texture_impl(SceGxmTextureBaseFormat base_format, ui
     if (pixels_per_stride == 0)
         pixels_per_stride = width;
 
-    const void *text_data = pixels;
-    std::vector<uint8_t> temp_data;
-    if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8 || base_format == SCE_GXM_TEXTURE_BASE_FORMAT_S8S8S8) {
-        text_data = add_alpha_channel(pixels, pixels_per_stride, height, temp_data);
+    const bool needs_alpha = base_format == SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8 || base_format == SCE_GXM_TEXTURE_BASE_FORMAT_S8S8S8;
+    if (needs_alpha)
         base_format = (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8) ? SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8 : SCE_GXM_TEXTURE_BASE_FORMAT_S8S8S8S8;
     }
 
     vk::DeviceSize upload_size;
     uint32_t buffer_height = height;
+    // if not 0, the texture must be decoded before being copied to the image
+    uint8_t bcn_format_id = 0;
     if (gxm::is_bcn_format(base_format)) {
         upload_size = renderer::texture::get_compressed_size(base_format, pixels_per_stride, height);
+        if (decode_bcn)
+            bcn_format_id = get_bcn_format_id(base_format);
         pixels_per_stride = align(pixels_per_stride, 4);
         buffer_height = align(buffer_height, 4);
+    } else if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P3) {
+        // the upload only supports this format if it is expanded on the GPU, the three planes follow each other
+        upload_size = pixels_per_stride * height + 2 * (pixels_per_stride / 2) * (height / 2);
     } else {
         size_t bpp = gxm::bits_per_pixel(base_format);
         size_t bytes_per_pixel = (bpp + 7) >> 3;
         upload_size = pixels_per_stride * height * bytes_per_pixel;
     }
 
-    if (staging_buffer.used_so_far + upload_size > staging_buffer.buffer.size) {
-        LOG_ERROR("Staging buffer size left ({}) is too small for texture size {}!", staging_buffer.buffer.size - staging_buffer.used_so_far, upload_size);
+    // paletted and YUV420 textures are expanded to RGBA8 by the GPU
+    const bool is_expanded = base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P8 || base_format == SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P3;
+    if (is_expanded && !support_gpu_expansion) {
+        LOG_ERROR("Texture format {} must be expanded before being uploaded", log_hex(base_format));
+        return;
+    }
+
+    // location in the staging buffer of the data copied to the image
+    vk::DeviceSize copy_offset = staging_used_so_far;
+    vk::DeviceSize copy_size = upload_size;
+    vk::DeviceSize palette_offset = 0;
+    if (bcn_format_id) {
+        copy_size = pixels_per_stride * buffer_height * vk::blockSize(image.format);
+        // the GPU decodes the texture right after the compressed one
+        if (texture_decoder.bcn_pipeline)
+            copy_offset = align(staging_used_so_far + upload_size, 16);
+    } else if (is_expanded) {
+        copy_size = pixels_per_stride * height * 4;
+        copy_offset = align(staging_used_so_far + upload_size, 16);
+        if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P8) {
+            // the palette goes between the indices and the expanded texture
+            palette_offset = copy_offset;
+            copy_offset = align(palette_offset + current_palette_count * sizeof(uint32_t), 16);
+        }
+    }
+
+    if (copy_offset + copy_size > staging_end) {
+        LOG_ERROR("Staging buffer size left ({}) is too small for texture size {}!", staging_end - staging_used_so_far, copy_offset + copy_size - staging_used_so_far);
         return;
     }
 
-    memcpy(reinterpret_cast<uint8_t *>(staging_buffer.buffer.mapped_data) + staging_buffer.used_so_far, text_data, upload_size);
+    uint8_t *staging_data = reinterpret_cast<uint8_t *>(staging_ring.buffer.mapped_data) + staging_used_so_far;
+    const bool decode_on_cpu = bcn_format_id && !texture_decoder.bcn_pipeline;
+    // the reserved memory is not reused before the submission, which waits for the decode workers
+    const auto write_pixels = [=](const void *pixels) {
+        if (decode_on_cpu)
+            // decode it directly in the staging buffer
+            renderer::texture::decompress_compressed_texture(base_format, staging_data, pixels, pixels_per_stride, buffer_height);
+        else if (needs_alpha)
+            add_alpha_channel(staging_data, pixels, pixels_per_stride, height);
+        else
+            memcpy(staging_data, pixels, upload_size);
+    };
+    if (pixels)
+        write_pixels(pixels);
+    else
+        deferred_upload_write = write_pixels;
+
+    if (!decode_on_cpu) {
+        TextureDecodeInfo decode_info{
+            .src_offset = staging_used_so_far,
+            .dst_offset = static_cast<uint32_t>(copy_offset)
+        };
+        if (bcn_format_id) {
+            decode_info.width = pixels_per_stride / 4;
+            decode_info.height = buffer_height / 4;
+            decode_info.format_id = bcn_format_id;
+            // one invocation per block
+            const uint32_t block_count = decode_info.width * decode_info.height;
+            decode_texture(texture_decoder.bcn_pipeline, decode_info, (block_count + 63) / 64, 1, copy_size);
+        } else if (is_expanded) {
+            decode_info.width = pixels_per_stride;
+            decode_info.height = height;
+            if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P8) {
+                memcpy(reinterpret_cast<uint8_t *>(staging_ring.buffer.mapped_data) + palette_offset, current_palette, current_palette_count * sizeof(uint32_t));
+                decode_info.format_id = 1;
+                decode_info.extra_offsets[0] = static_cast<uint32_t>(palette_offset);
+            } else {
+                decode_info.format_id = 2;
+                decode_info.extra_offsets[0] = decode_info.src_offset + pixels_per_stride * height;
+                decode_info.extra_offsets[1] = decode_info.extra_offsets[0] + (pixels_per_stride / 2) * (height / 2);
+            }
+            // one invocation per texel, in 8x8 groups
+            decode_texture(texture_decoder.expand_pipeline, decode_info, (pixels_per_stride + 7) / 8, (height + 7) / 8, copy_size);
+        }
+    }
 
     vk::ImageSubresourceLayers layer{
         .aspectMask = vk::ImageAspectFlagBits::eColor,
@@ -460,15 +861,15 @@ void VKTextureCache::upload_texture_impl(SceGxmTextureBaseFormat base_format, ui
         .layerCount = 1
     };
     vk::BufferImageCopy region{
-        .bufferOffset = staging_buffer.used_so_far,
+        .bufferOffset = copy_offset,
         .bufferRowLength = static_cast<uint32_t>(pixels_per_stride),
         .bufferImageHeight = buffer_height,
         .imageSubresource = layer,
         .imageOffset = { 0, 0, 0 },
         .imageExtent = { width, height, 1 }
     };
-    cmd_buffer.copyBufferToImage(staging_buffer.buffer.buffer, image.image, vk::ImageLayout::eTransferDstOptimal, region);
-    staging_buffer.used_so_far += upload_size;
+    cmd_buffer.copyBufferToImage(staging_ring.buffer.buffer, image.image, vk::ImageLayout::eTransferDstOptimal, region);
+    staging_used_so_far = static_cast<uint32_t>(copy_offset + copy_size);
 }
 
 void VKTextureCache::upload_done() {
@@ -480,11 +881,48 @@ void VKTextureCache::upload_done() {
         .baseArrayLayer = 0,
         .layerCount = current_texture->is_cube ? 6U : 1U
     };
-    vkutil::transition_image_layout(cmd_buffer, current_texture->texture.image, vkutil::ImageLayout::TransferDst, vkutil::ImageLayout::SampledImage, range);
+    if (is_transfer_upload) {
+        // release the image from the transfer queue and acquire it on the general queue
+        // the pipeline stages on the side that is not part of the queue family are ignored
+        vk::ImageMemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+            .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .srcQueueFamilyIndex = state.transfer_family_index,
+            .dstQueueFamilyIndex = state.general_family_index,
+            .image = current_texture->texture.image,
+            .subresourceRange = range
+        };
+        cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier);
+
+        barrier.srcAccessMask = {};
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        VKContext *context = reinterpret_cast<VKContext *>(state.context);
+        context->prerender_cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+            vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+            {}, {}, {}, barrier);
+    } else {
+        vkutil::transition_image_layout(cmd_buffer, current_texture->texture.image, vkutil::ImageLayout::TransferDst, vkutil::ImageLayout::SampledImage, range);
+    }
     current_texture->texture.layout = vkutil::ImageLayout::SampledImage;
+
+    // give back the part of the reservation which was not used
+    if (!staging_ring.regions.empty()) {
+        StagingRegion &region = staging_ring.regions.back();
+        region.end = std::max(region.begin, std::min(region.end, staging_used_so_far));
+        if (region.begin == region.end)
+            staging_ring.regions.pop_back();
+    }
+
     // this should not be necessary
     cmd_buffer = nullptr;
     is_texture_transfer_ready = false;
+    is_transfer_upload = false;
+}
+
+void VKTextureCache::release_texture(size_t index) {
+    // the texture may still be used by the GPU
+    reinterpret_cast<VKContext *>(state.context)->frame().destroy_queue.add_image(textures[index].texture);
 }
 
 void VKTextureCache::configure_sampler(size_t index, const SceGxmTexture &texture) {
@@ -526,8 +964,18 @@ void VKTextureCache::configure_sampler(size_t index, const SceGxmTexture &textur
 }
 
 void VKTextureCache::import_configure_impl(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, bool is_srgb, uint16_t nb_components, uint16_t mipcount, bool swap_rb) {
+    vk::Format vk_format = texture::translate_format(base_format);
+    const bool is_decoded = decode_bcn && get_bcn_format_id(base_format) != 0;
+    if (is_decoded)
+        vk_format = get_bcn_decoded_format(base_format);
+    if (is_srgb)
+        vk_format = linear_to_srgb(vk_format);
+
     const size_t bpp = gxm::bits_per_pixel(base_format);
-    const uint32_t texture_size = static_cast<uint32_t>((align(width, 4) * align(height, 4) * bpp) / 8);
+    uint32_t texture_size = static_cast<uint32_t>((align(width, 4) * align(height, 4) * bpp) / 8);
+    if (is_decoded)
+        // room for both the compressed and the decoded texture
+        texture_size += align(width, 4) * align(height, 4) * vk::blockSize(vk_format) + 16 * mipcount;
     current_texture->memory_needed = align(texture_size, 16);
 
     current_texture->mip_count = mipcount;
@@ -536,6 +984,7 @@ void VKTextureCache::import_configure_impl(SceGxmTextureBaseFormat base_format,
 
     const bool is_cube = current_info->texture.texture_type() == SCE_GXM_TEXTURE_CUBE || current_info->texture.texture_type() == SCE_GXM_TEXTURE_CUBE_ARBITRARY;
     current_texture->is_cube = is_cube;
+    current_texture->needs_decoding = is_decoded && texture_decoder.bcn_pipeline;
     if (is_cube)
         current_texture->memory_needed *= 6;
 
@@ -545,10 +994,6 @@ void VKTextureCache::import_configure_impl(SceGxmTextureBaseFormat base_format,
     if (image.image)
         reinterpret_cast<VKContext *>(state.context)->frame().destroy_queue.add_image(image);
 
-    vk::Format vk_format = texture::translate_format(base_format);
-    if (is_srgb)
-        vk_format = linear_to_srgb(vk_format);
-
     // manually initialize the image
     image.allocator = state.allocator;
     image.width = width;
@@ -574,6 +1019,7 @@ void VKTextureCache::import_configure_impl(SceGxmTextureBaseFormat base_format,
     };
 
     std::tie(image.image, image.allocation) = image.allocator.createImage(image_info, vkutil::vma_auto_alloc);
+    current_info->memory_size = static_cast<uint32_t>(image.allocator.getAllocationInfo(image.allocation).size);
 
     // create image view
     vk::ImageSubresourceRange range{
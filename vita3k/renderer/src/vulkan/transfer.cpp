@@ -0,0 +1,145 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/vulkan/functions.h>
+
+#include <renderer/vulkan/types.h>
+#include <vkutil/vkutil.h>
+
+#include <vulkan/vulkan_format_traits.hpp>
+
+namespace renderer::vulkan {
+
+// the CPU transfer keeps the guest memory up to date, it is only useful if the surfaces are synced with it
+static bool can_skip_cpu_transfer(VKContext &context) {
+    return context.state.disable_surface_sync || !context.state.features.support_memory_mapping;
+}
+
+bool transfer_copy(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest) {
+    VKSurfaceCache &surface_cache = context.state.surface_cache;
+
+    vk::Offset3D src_offset, dest_offset;
+    vk::Extent3D src_extent, dest_extent;
+    ColorSurfaceCacheInfo *src_info = surface_cache.retrieve_color_surface_for_transfer(src, src_offset, src_extent);
+    if (!src_info)
+        return false;
+    ColorSurfaceCacheInfo *dest_info = surface_cache.retrieve_color_surface_for_transfer(dest, dest_offset, dest_extent);
+    // copying inside the same image would need both regions not to overlap
+    if (!dest_info || dest_info == src_info)
+        return false;
+
+    // the copy is done texel by texel, the formats only need to have the same size
+    if (vk::blockSize(src_info->texture.format) != vk::blockSize(dest_info->texture.format))
+        return false;
+
+    vk::CommandBuffer cmd_buffer = context.start_transfer_recording();
+    src_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::TransferSrc);
+    dest_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::TransferDst);
+
+    vk::ImageCopy image_copy{
+        .srcSubresource = vkutil::color_subresource_layer,
+        .srcOffset = src_offset,
+        .dstSubresource = vkutil::color_subresource_layer,
+        .dstOffset = dest_offset,
+        .extent = src_extent
+    };
+    cmd_buffer.copyImage(src_info->texture.image, vk::ImageLayout::eTransferSrcOptimal, dest_info->texture.image, vk::ImageLayout::eTransferDstOptimal, image_copy);
+
+    src_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::ColorAttachmentReadWrite);
+    dest_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::ColorAttachmentReadWrite);
+    context.stop_transfer_recording(cmd_buffer);
+
+    return can_skip_cpu_transfer(context);
+}
+
+bool transfer_downscale(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest) {
+    VKSurfaceCache &surface_cache = context.state.surface_cache;
+
+    // the destination image has half the size of the source
+    SceGxmTransferImage dest_image = dest;
+    dest_image.width = src.width / 2;
+    dest_image.height = src.height / 2;
+
+    vk::Offset3D src_offset, dest_offset;
+    vk::Extent3D src_extent, dest_extent;
+    ColorSurfaceCacheInfo *src_info = surface_cache.retrieve_color_surface_for_transfer(src, src_offset, src_extent);
+    if (!src_info)
+        return false;
+    ColorSurfaceCacheInfo *dest_info = surface_cache.retrieve_color_surface_for_transfer(dest_image, dest_offset, dest_extent);
+    if (!dest_info || dest_info == src_info || dest_extent.width == 0 || dest_extent.height == 0)
+        return false;
+
+    // a blit converts the values, keep the texels as they are
+    const vk::Format format = src_info->texture.format;
+    if (format != dest_info->texture.format)
+        return false;
+
+    vk::CommandBuffer cmd_buffer = context.start_transfer_recording();
+    src_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::TransferSrc);
+    dest_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::TransferDst);
+
+    vk::ImageBlit blit{
+        .srcSubresource = vkutil::color_subresource_layer,
+        .srcOffsets = std::array<vk::Offset3D, 2>{
+            src_offset,
+            vk::Offset3D{ src_offset.x + static_cast<int32_t>(dest_extent.width * 2), src_offset.y + static_cast<int32_t>(dest_extent.height * 2), 1 } },
+        .dstSubresource = vkutil::color_subresource_layer,
+        .dstOffsets = std::array<vk::Offset3D, 2>{
+            dest_offset,
+            vk::Offset3D{ dest_offset.x + static_cast<int32_t>(dest_extent.width), dest_offset.y + static_cast<int32_t>(dest_extent.height), 1 } }
+    };
+    // a linear filter with an exact 2:1 ratio averages each 2x2 block, like the downscale done by the GPU
+    const bool is_rgba8 = format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb;
+    cmd_buffer.blitImage(src_info->texture.image, vk::ImageLayout::eTransferSrcOptimal, dest_info->texture.image, vk::ImageLayout::eTransferDstOptimal,
+        blit, is_rgba8 ? vk::Filter::eLinear : vk::Filter::eNearest);
+
+    src_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::ColorAttachmentReadWrite);
+    dest_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::ColorAttachmentReadWrite);
+    context.stop_transfer_recording(cmd_buffer);
+
+    return can_skip_cpu_transfer(context);
+}
+
+bool transfer_fill(VKContext &context, uint32_t fill_color, const SceGxmTransferImage &dest) {
+    vk::Offset3D dest_offset;
+    vk::Extent3D dest_extent;
+    ColorSurfaceCacheInfo *dest_info = context.state.surface_cache.retrieve_color_surface_for_transfer(dest, dest_offset, dest_extent);
+    if (!dest_info)
+        return false;
+
+    // clearColorImage can only clear the whole image
+    // the value is only converted correctly if the texels have the same layout as the guest memory
+    if (dest_offset.x != 0 || dest_offset.y != 0 || dest.width != dest_info->original_width || dest.height != dest_info->original_height
+        || dest_info->texture.format != vk::Format::eR8G8B8A8Unorm)
+        return false;
+
+    const vk::ClearColorValue clear_color{ std::array<float, 4>({
+        static_cast<float>(fill_color & 0xFF) / 255.0f,
+        static_cast<float>((fill_color >> 8) & 0xFF) / 255.0f,
+        static_cast<float>((fill_color >> 16) & 0xFF) / 255.0f,
+        static_cast<float>(fill_color >> 24) / 255.0f }) };
+
+    vk::CommandBuffer cmd_buffer = context.start_transfer_recording();
+    dest_info->texture.transition_to_discard(cmd_buffer, vkutil::ImageLayout::TransferDst);
+    cmd_buffer.clearColorImage(dest_info->texture.image, vk::ImageLayout::eTransferDstOptimal, clear_color, vkutil::color_subresource_range);
+    dest_info->texture.transition_to(cmd_buffer, vkutil::ImageLayout::ColorAttachmentReadWrite);
+    context.stop_transfer_recording(cmd_buffer);
+
+    return can_skip_cpu_transfer(context);
+}
+
+} // namespace renderer::vulkan
@@ -0,0 +1,426 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Runs the renderer commands captured with --gxm-capture on a headless Vulkan renderer, without the app,
+// and reports the time taken by each frame.
+
+#include <config/state.h>
+#include <mem/functions.h>
+#include <renderer/capture.h>
+#include <renderer/functions.h>
+#include <renderer/state.h>
+#include <renderer/types.h>
+#include <util/fs.h>
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace renderer;
+
+struct Replay {
+    State &renderer;
+    MemState &mem;
+    Config &cfg;
+
+    std::map<uint32_t, std::unique_ptr<Context>> contexts;
+    std::map<uint32_t, std::unique_ptr<RenderTarget>> render_targets;
+    std::map<uint32_t, SceGxmRenderTargetParams> render_target_params;
+    // the program objects created in the guest memory, true for the fragment ones
+    std::map<Address, bool> programs;
+};
+
+template <typename T>
+static void append(std::vector<uint8_t> &payload, const T &value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static T read_at(const std::vector<uint8_t> &payload, const size_t offset) {
+    T value{};
+    if (offset + sizeof(T) <= payload.size())
+        memcpy(&value, payload.data() + offset, sizeof(T));
+    return value;
+}
+
+// allocate the pages of the range which are not allocated yet
+static void allocate(MemState &mem, const Address address, const uint32_t size) {
+    const uint64_t end = static_cast<uint64_t>(address) + size;
+    for (uint64_t page = address - address % mem.page_size; page < end; page += mem.page_size) {
+        if (!is_valid_addr(mem, static_cast<Address>(page)))
+            alloc_at(mem, static_cast<Address>(page), mem.page_size, "capture");
+    }
+}
+
+static void destroy_program(Replay &replay, const Address address) {
+    const auto it = replay.programs.find(address);
+    if (it == replay.programs.end())
+        return;
+
+    if (it->second)
+        Ptr<SceGxmFragmentProgram>(address).get(replay.mem)->~SceGxmFragmentProgram();
+    else
+        Ptr<SceGxmVertexProgram>(address).get(replay.mem)->~SceGxmVertexProgram();
+    replay.programs.erase(it);
+}
+
+static void create_fragment_program(Replay &replay, const capture::Record &record, const std::vector<uint8_t> &data) {
+    const capture::FragmentProgram info = read_at<capture::FragmentProgram>(data, 0);
+    destroy_program(replay, record.address);
+    allocate(replay.mem, record.address, sizeof(SceGxmFragmentProgram));
+
+    SceGxmFragmentProgram *program = new (Ptr<SceGxmFragmentProgram>(record.address).get(replay.mem)) SceGxmFragmentProgram();
+    replay.programs[record.address] = true;
+    program->program = info.program;
+    program->is_maskupdate = info.is_maskupdate;
+    if (!create(program->renderer_data, replay.renderer, *info.program.get(replay.mem), info.has_blend ? &info.blend : nullptr,
+            replay.renderer.gxp_ptr_map, replay.renderer.cache_path.c_str(), replay.renderer.title_id))
+        LOG_ERROR("Failed to create the fragment program at 0x{:X}", record.address);
+}
+
+static void create_vertex_program(Replay &replay, const capture::Record &record, const std::vector<uint8_t> &data) {
+    const capture::VertexProgram info = read_at<capture::VertexProgram>(data, 0);
+    destroy_program(replay, record.address);
+    allocate(replay.mem, record.address, sizeof(SceGxmVertexProgram));
+
+    SceGxmVertexProgram *program = new (Ptr<SceGxmVertexProgram>(record.address).get(replay.mem)) SceGxmVertexProgram();
+    replay.programs[record.address] = false;
+    program->program = info.program;
+    program->key_hash = info.key_hash;
+    size_t offset = sizeof(info);
+    for (uint32_t i = 0; i < info.stream_count; i++, offset += sizeof(SceGxmVertexStream))
+        program->streams.push_back(read_at<SceGxmVertexStream>(data, offset));
+    for (uint32_t i = 0; i < info.attribute_count; i++, offset += sizeof(SceGxmVertexAttribute))
+        program->attributes.push_back(read_at<SceGxmVertexAttribute>(data, offset));
+
+    if (!create(program->renderer_data, replay.renderer, *info.program.get(replay.mem), replay.renderer.gxp_ptr_map,
+            replay.renderer.cache_path.c_str(), replay.renderer.title_id))
+        LOG_ERROR("Failed to create the vertex program at 0x{:X}", record.address);
+}
+
+// turn the portable payload back into the one the handler expects, return false if the command can't be replayed
+static bool decode_payload(Replay &replay, const CommandOpcode opcode, const std::vector<uint8_t> &data, std::vector<uint8_t> &payload) {
+    switch (opcode) {
+    case CommandOpcode::CreateContext:
+        append(payload, &replay.contexts[read_at<uint32_t>(data, 0)]);
+        return true;
+
+    case CommandOpcode::CreateRenderTarget: {
+        const uint32_t id = read_at<uint32_t>(data, 0);
+        replay.render_target_params[id] = read_at<SceGxmRenderTargetParams>(data, sizeof(uint32_t));
+        append(payload, &replay.render_targets[id]);
+        append(payload, &replay.render_target_params[id]);
+        return true;
+    }
+
+    case CommandOpcode::DestroyContext: {
+        const auto it = replay.contexts.find(read_at<uint32_t>(data, 0));
+        if (it == replay.contexts.end())
+            return false;
+        append(payload, &it->second);
+        return true;
+    }
+
+    case CommandOpcode::DestroyRenderTarget: {
+        const auto it = replay.render_targets.find(read_at<uint32_t>(data, 0));
+        if (it == replay.render_targets.end())
+            return false;
+        append(payload, &it->second);
+        return true;
+    }
+
+    case CommandOpcode::SetContext: {
+        const auto it = replay.render_targets.find(read_at<uint32_t>(data, 0));
+        if (it == replay.render_targets.end() || !it->second)
+            return false;
+
+        // the handler deletes the surfaces
+        constexpr size_t color_offset = sizeof(uint32_t);
+        constexpr size_t depth_stencil_offset = color_offset + 1 + sizeof(SceGxmColorSurface);
+        SceGxmColorSurface *color_surface = nullptr;
+        if (read_at<uint8_t>(data, color_offset))
+            color_surface = new SceGxmColorSurface(read_at<SceGxmColorSurface>(data, color_offset + 1));
+        SceGxmDepthStencilSurface *depth_stencil_surface = nullptr;
+        if (read_at<uint8_t>(data, depth_stencil_offset))
+            depth_stencil_surface = new SceGxmDepthStencilSurface(read_at<SceGxmDepthStencilSurface>(data, depth_stencil_offset + 1));
+
+        append(payload, it->second.get());
+        append(payload, color_surface);
+        append(payload, depth_stencil_surface);
+        return true;
+    }
+
+    case CommandOpcode::TransferCopy: {
+        constexpr size_t images_offset = 2 * sizeof(uint32_t) + sizeof(SceGxmTransferColorKeyMode);
+        SceGxmTransferImage *images = new SceGxmTransferImage[2];
+        images[0] = read_at<SceGxmTransferImage>(data, images_offset);
+        images[1] = read_at<SceGxmTransferImage>(data, images_offset + sizeof(SceGxmTransferImage));
+
+        payload.assign(data.begin(), data.begin() + images_offset);
+        append(payload, images);
+        payload.insert(payload.end(), data.begin() + images_offset + 2 * sizeof(SceGxmTransferImage), data.end());
+        return true;
+    }
+
+    case CommandOpcode::TransferDownscale:
+        append(payload, new SceGxmTransferImage(read_at<SceGxmTransferImage>(data, 0)));
+        append(payload, new SceGxmTransferImage(read_at<SceGxmTransferImage>(data, sizeof(SceGxmTransferImage))));
+        return true;
+
+    case CommandOpcode::TransferFill:
+        append(payload, read_at<uint32_t>(data, 0));
+        append(payload, new SceGxmTransferImage(read_at<SceGxmTransferImage>(data, sizeof(uint32_t))));
+        return true;
+
+    case CommandOpcode::SetState:
+        // the size of the visibility buffer is not known, it is only used if its memory was captured
+        if (read_at<GXMState>(data, 0) == GXMState::VisibilityBuffer && !is_valid_addr(replay.mem, read_at<Address>(data, sizeof(GXMState))))
+            return false;
+        payload = data;
+        return true;
+
+    default:
+        payload = data;
+        return true;
+    }
+}
+
+static void replay_command(Replay &replay, const capture::Record &record, const std::vector<uint8_t> &data) {
+    Context *context = nullptr;
+    if (record.context_id != 0) {
+        const auto it = replay.contexts.find(record.context_id);
+        if (it == replay.contexts.end() || !it->second)
+            return;
+        context = it->second.get();
+    }
+
+    std::vector<uint8_t> payload;
+    if (!decode_payload(replay, record.opcode, data, payload))
+        return;
+    if (payload.size() > MAX_COMMAND_DATA_SIZE) {
+        LOG_ERROR("Payload of {} bytes of command {} is too big", payload.size(), static_cast<int>(record.opcode));
+        return;
+    }
+
+    int status = CommandErrorCodePending;
+    Command *cmd = generic_command_allocate(payload.size());
+    cmd->opcode = record.opcode;
+    cmd->status = record.has_status ? &status : nullptr;
+    cmd->size = static_cast<uint16_t>(payload.size());
+    std::copy(payload.begin(), payload.end(), cmd->data);
+
+    CommandList command_list{ .first = cmd, .last = cmd, .context = context };
+    process_batch(replay.renderer, replay.renderer.features, replay.mem, replay.cfg, command_list);
+
+    if (record.opcode == CommandOpcode::CreateContext) {
+        // the commands of the context are generic ones here
+        const uint32_t id = read_at<uint32_t>(data, 0);
+        if (replay.contexts[id]) {
+            replay.contexts[id]->alloc_func = generic_command_allocate;
+            replay.contexts[id]->free_func = generic_command_free;
+        }
+    } else if (record.opcode == CommandOpcode::DestroyContext) {
+        replay.contexts.erase(read_at<uint32_t>(data, 0));
+    } else if (record.opcode == CommandOpcode::DestroyRenderTarget) {
+        replay.render_targets.erase(read_at<uint32_t>(data, 0));
+    }
+}
+
+static bool write_report(const fs::path &path, const capture::Header &header, const std::vector<double> &frame_times, const double duration_ms) {
+    std::vector<double> sorted = frame_times;
+    std::sort(sorted.begin(), sorted.end());
+    const auto percentile = [&](double p) {
+        if (sorted.empty())
+            return 0.0;
+        return sorted[std::min(static_cast<size_t>(p * sorted.size()), sorted.size() - 1)];
+    };
+
+    fs::ofstream report(path, std::ios::out);
+    if (!report.is_open()) {
+        LOG_ERROR("Could not write the replay report to {}", path.string());
+        return false;
+    }
+
+    report << "{\n";
+    report << fmt::format("  \"title_id\": \"{}\",\n", string_utils::escape_json(header.title_id));
+    report << fmt::format("  \"frames\": {},\n", frame_times.size());
+    report << fmt::format("  \"duration_ms\": {:.3f},\n", duration_ms);
+    report << "  \"frame_time_ms\": {\n";
+    report << fmt::format("    \"average\": {:.3f},\n", sorted.empty() ? 0.0 : std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size());
+    report << fmt::format("    \"min\": {:.3f},\n", sorted.empty() ? 0.0 : sorted.front());
+    report << fmt::format("    \"p50\": {:.3f},\n", percentile(0.5));
+    report << fmt::format("    \"p90\": {:.3f},\n", percentile(0.9));
+    report << fmt::format("    \"p99\": {:.3f},\n", percentile(0.99));
+    report << fmt::format("    \"max\": {:.3f}\n", sorted.empty() ? 0.0 : sorted.back());
+    report << "  },\n";
+    report << "  \"frame_times_ms\": [";
+    for (size_t i = 0; i < frame_times.size(); i++)
+        report << fmt::format("{}{:.3f}", i == 0 ? "" : ", ", frame_times[i]);
+    report << "]\n";
+    report << "}\n";
+
+    return report.good();
+}
+
+static void print_usage() {
+    std::cout << "Usage: vita3k-replay <capture file> [options]\n"
+              << "Runs the renderer commands captured with vita3k --gxm-capture on a headless Vulkan renderer.\n"
+              << "  --shared-path <dir>       Vita3K folder holding shaders-builtin, the folder of this executable by default\n"
+              << "  --cache-path <dir>        Folder of the shaders and pipelines cache, the current folder by default\n"
+              << "  --resolution-multiplier <n>\n"
+              << "  --report <file>           Write the frame times to this JSON file\n";
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+
+    fs::path capture_path;
+    fs::path shared_path = fs::path(string_utils::utf_to_wide(argv[0])).parent_path();
+    fs::path cache_path = fs::current_path();
+    fs::path report_path;
+    int resolution_multiplier = 1;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--shared-path" && has_value)
+            shared_path = fs::path(string_utils::utf_to_wide(argv[++i]));
+        else if (arg == "--cache-path" && has_value)
+            cache_path = fs::path(string_utils::utf_to_wide(argv[++i]));
+        else if (arg == "--report" && has_value)
+            report_path = fs::path(string_utils::utf_to_wide(argv[++i]));
+        else if (arg == "--resolution-multiplier" && has_value)
+            resolution_multiplier = std::max(1, std::atoi(argv[++i]));
+        else if (capture_path.empty() && !arg.starts_with("--"))
+            capture_path = fs::path(string_utils::utf_to_wide(arg));
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    // the renderer appends the file names to these paths
+    const auto dir_sep = std::string{ fs::path::preferred_separator };
+    Root root_paths;
+    root_paths.set_shared_path(shared_path / dir_sep);
+    root_paths.set_cache_path(cache_path / dir_sep);
+    root_paths.set_log_path(cache_path / dir_sep);
+    if (logging::init(root_paths, true) != Success)
+        return 1;
+
+    fs::ifstream file(capture_path, std::ios::in | std::ios::binary);
+    capture::Header header{};
+    if (!file.is_open()) {
+        LOG_ERROR("Could not open the capture {}", capture_path.string());
+        return 1;
+    }
+    if (!capture::read_header(file, header))
+        return 1;
+
+    Config cfg;
+    std::unique_ptr<State> renderer;
+    if (!renderer::init(nullptr, renderer, Backend::Vulkan, cfg, root_paths)) {
+        LOG_ERROR("Could not create a headless Vulkan renderer");
+        return 1;
+    }
+
+    const std::string title_id = header.title_id;
+    const std::string self_name = header.self_name;
+    renderer->late_init(cfg, title_id);
+    renderer->title_id = title_id.c_str();
+    renderer->self_name = self_name.c_str();
+    renderer->res_multiplier = resolution_multiplier;
+    renderer->max_res_multiplier = resolution_multiplier;
+    renderer->set_surface_sync_state(cfg.current_config.disable_surface_sync);
+    renderer->set_anisotropic_filtering(cfg.current_config.anisotropic_filtering);
+    renderer->set_texture_state(false, false, false);
+
+    MemState mem;
+    if (!init(mem, renderer->need_page_table)) {
+        LOG_ERROR("Failed to initialize the guest memory");
+        return 1;
+    }
+
+    Replay replay{ *renderer, mem, cfg };
+    std::vector<double> frame_times;
+    capture::Record record;
+    std::vector<uint8_t> data;
+    const auto start = std::chrono::steady_clock::now();
+    auto frame_start = start;
+    while (capture::read_record(file, record, data)) {
+        switch (record.type) {
+        case capture::RecordType::Memory:
+            allocate(mem, record.address, record.size);
+            memcpy(Ptr<uint8_t>(record.address).get(mem), data.data(), std::min<size_t>(record.size, data.size()));
+            break;
+
+        case capture::RecordType::Allocation:
+            allocate(mem, record.address, record.size);
+            break;
+
+        case capture::RecordType::FragmentProgram:
+            create_fragment_program(replay, record, data);
+            break;
+
+        case capture::RecordType::VertexProgram:
+            create_vertex_program(replay, record, data);
+            break;
+
+        case capture::RecordType::Command:
+            replay_command(replay, record, data);
+            if (record.opcode == CommandOpcode::NewFrame) {
+                const auto now = std::chrono::steady_clock::now();
+                frame_times.push_back(std::chrono::duration<double, std::milli>(now - frame_start).count());
+                frame_start = now;
+            }
+            break;
+
+        default:
+            LOG_ERROR("Unknown record type {} in the capture", static_cast<int>(record.type));
+            return 1;
+        }
+    }
+
+    const double duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const double average_ms = frame_times.empty() ? 0.0 : std::accumulate(frame_times.begin(), frame_times.end(), 0.0) / frame_times.size();
+    LOG_INFO("Replayed {} frames of {} in {:.2f} ms, {:.3f} ms per frame", frame_times.size(), title_id, duration_ms, average_ms);
+
+    int result = 0;
+    if (!report_path.empty() && !write_report(report_path, header, frame_times, duration_ms))
+        result = 1;
+
+    renderer->preclose_action();
+    while (!replay.programs.empty())
+        destroy_program(replay, replay.programs.begin()->first);
+    replay.render_targets.clear();
+    replay.contexts.clear();
+    renderer.reset();
+
+    return result;
+}
@@ -94,6 +94,13 @@ inline time_t rtc_timegm(struct tm *tm) {
 
 std::uint64_t rtc_base_ticks();
 std::uint64_t rtc_get_ticks(uint64_t base_tick);
+// ticks of the guest clock, which runs faster than the host one when the emulation is sped up
+std::uint64_t rtc_ticks_since_epoch();
+// multiplier of the guest clock speed, 1 for real time
+void rtc_set_speed(std::uint32_t speed);
+// convert a guest duration to the host duration it takes at the current speed, and the other way around
+std::uint64_t rtc_host_duration(std::uint64_t guest_ticks);
+std::uint64_t rtc_guest_duration(std::uint64_t host_ticks);
 void __RtcPspTimeToTm(tm *val, const SceDateTime *pt);
 void __RtcTicksToPspTime(SceDateTime *t, std::uint64_t ticks);
 std::uint64_t __RtcPspTimeToTicks(const SceDateTime *pt);
@@ -17,14 +17,261 @@
 
 #include <rtc/rtc.h>
 
+#include <util/instrset_detect.h>
 #include <util/log.h>
 
-std::uint64_t rtc_ticks_since_epoch() {
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RTC_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+#define RTC_CNTVCT
+#endif
+
+static std::uint64_t chrono_ticks_since_epoch() {
     const auto now = std::chrono::high_resolution_clock::now();
     const auto now_timepoint = std::chrono::time_point_cast<VitaClocks>(now);
     return now_timepoint.time_since_epoch().count();
 }
 
+#if defined(RTC_TSC) || defined(RTC_CNTVCT)
+// the counter is measured against a clock which is not adjusted
+static std::uint64_t steady_ticks() {
+    return std::chrono::duration_cast<VitaClocks>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// some games query the time thousands of times per frame, reading the CPU counter is much cheaper than the host clock
+static std::uint64_t read_cpu_counter() {
+#ifdef RTC_TSC
+    return __rdtsc();
+#else
+    std::uint64_t counter;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(counter));
+    return counter;
+#endif
+}
+
+// ticks of the host clock elapsed during counter ticks of the CPU counter, the multiplier is in 32.32 fixed point
+static std::uint64_t scale_counter(const std::uint64_t counter, const std::uint64_t multiplier) {
+    return (counter >> 32) * multiplier + (((counter & 0xFFFFFFFF) * multiplier) >> 32);
+}
+
+// the converted time is anchored to the steady clock, the TSC frequency is measured against it over a longer time
+// at each recalibration, which is done at doubling intervals up to a fixed one, so the drift is always checked
+struct CounterClock {
+    std::atomic<bool> enabled = false;
+    // even when the conversion can be read, odd while it is changed
+    std::atomic<std::uint32_t> sequence = 0;
+    std::atomic<std::uint64_t> anchor_counter = 0;
+    std::atomic<std::uint64_t> anchor_ticks = 0;
+    std::atomic<std::uint64_t> multiplier = 0;
+    // counter value after which the frequency is measured again, max if it is never (it is given by the system)
+    std::atomic<std::uint64_t> next_calibration = std::numeric_limits<std::uint64_t>::max();
+    // counter difference between the cores which is still not a drift
+    std::uint64_t max_counter_skew = 0;
+    // set once the counter drifted, the time is then read from the steady clock, never before the last counter time
+    std::atomic<bool> drifted = false;
+    std::atomic<std::uint64_t> drift_ticks = 0;
+    std::mutex calibration_mutex;
+    std::uint64_t start_counter = 0;
+    std::uint64_t start_ticks = 0;
+    // from the steady clock to the host clock
+    std::uint64_t epoch_offset = 0;
+
+    CounterClock();
+};
+
+// more difference than this with the host clock means the counter is not reliable (it was reset or the host was suspended)
+static constexpr std::uint64_t MAX_COUNTER_DRIFT = 5000;
+// the longest interval between two recalibrations, in ticks of the host clock
+static constexpr std::uint64_t MAX_CALIBRATION_INTERVAL = 60ULL * VITA_CLOCKS_PER_SEC;
+
+static std::uint64_t make_multiplier(const std::uint64_t ticks, const std::uint64_t counter) {
+    return static_cast<std::uint64_t>(static_cast<double>(ticks) * 4294967296.0 / static_cast<double>(counter));
+}
+
+CounterClock::CounterClock() {
+#ifdef RTC_TSC
+    if (!util::instrset::hasInvariantTSC()) {
+        LOG_INFO("The TSC is not invariant, the guest time is read from the host clock");
+        return;
+    }
+
+    // measure the first frequency over 1 ms, it is refined after 100 ms then at doubling intervals
+    start_ticks = steady_ticks();
+    start_counter = read_cpu_counter();
+    std::uint64_t ticks;
+    do {
+        ticks = steady_ticks();
+    } while (ticks < start_ticks + 1000);
+    const std::uint64_t counter = read_cpu_counter();
+    if (counter <= start_counter) {
+        LOG_INFO("The TSC does not increase, the guest time is read from the host clock");
+        return;
+    }
+    multiplier = make_multiplier(ticks - start_ticks, counter - start_counter);
+    max_counter_skew = (counter - start_counter) * 1000 / (ticks - start_ticks);
+    next_calibration = counter + (counter - start_counter) * 100;
+    LOG_INFO("Reading the guest time from the TSC, measured at {} MHz", (counter - start_counter) / (ticks - start_ticks));
+#else
+    // the frequency of the generic timer is given by the system
+    std::uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    if (frequency < VITA_CLOCKS_PER_SEC)
+        return;
+    start_ticks = steady_ticks();
+    start_counter = read_cpu_counter();
+    multiplier = make_multiplier(VITA_CLOCKS_PER_SEC, frequency);
+    max_counter_skew = frequency / 1000;
+#endif
+    epoch_offset = chrono_ticks_since_epoch() - steady_ticks();
+    anchor_counter = start_counter;
+    anchor_ticks = start_ticks;
+    enabled = true;
+}
+
+static CounterClock &get_counter_clock() {
+    static CounterClock clock;
+    return clock;
+}
+
+// ticks of the steady clock at this counter value
+static std::uint64_t counter_to_ticks(const CounterClock &clock, const std::uint64_t counter) {
+    std::uint32_t sequence;
+    std::uint64_t ticks;
+    do {
+        sequence = clock.sequence.load(std::memory_order_acquire);
+        const std::uint64_t anchor_counter = clock.anchor_counter.load(std::memory_order_relaxed);
+        const std::uint64_t anchor_ticks = clock.anchor_ticks.load(std::memory_order_relaxed);
+        const std::uint64_t multiplier = clock.multiplier.load(std::memory_order_relaxed);
+        // the counters of the cores can be slightly apart, never go before the anchor
+        ticks = anchor_ticks + (counter > anchor_counter ? scale_counter(counter - anchor_counter, multiplier) : 0);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || clock.sequence.load(std::memory_order_relaxed) != sequence);
+
+    return ticks;
+}
+
+// the steady clock is used from now on, it is not adjusted so the time can only stop for up to MAX_COUNTER_DRIFT
+static void disable_counter_clock(CounterClock &clock, const std::uint64_t last_ticks) {
+    LOG_WARN("The TSC drifted from the host clock, the guest time is read from the steady clock again");
+    clock.drift_ticks.store(last_ticks, std::memory_order_relaxed);
+    clock.drifted.store(true, std::memory_order_relaxed);
+    clock.enabled.store(false, std::memory_order_release);
+}
+
+static void recalibrate_counter_clock(CounterClock &clock) {
+    const std::unique_lock<std::mutex> lock(clock.calibration_mutex, std::try_to_lock);
+    // another thread is already doing it
+    if (!lock.owns_lock() || !clock.enabled.load(std::memory_order_relaxed))
+        return;
+
+    const std::uint64_t host_ticks = steady_ticks();
+    const std::uint64_t counter = read_cpu_counter();
+    if (counter < clock.next_calibration.load(std::memory_order_relaxed))
+        return;
+
+    const std::uint64_t ticks = counter_to_ticks(clock, counter);
+    if (counter <= clock.start_counter || std::max(ticks, host_ticks) - std::min(ticks, host_ticks) > MAX_COUNTER_DRIFT) {
+        disable_counter_clock(clock, std::max(ticks, host_ticks));
+        return;
+    }
+
+    // keep the converted time continuous, only its rate changes
+    const std::uint32_t sequence = clock.sequence.load(std::memory_order_relaxed);
+    clock.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    clock.anchor_counter.store(counter, std::memory_order_relaxed);
+    clock.anchor_ticks.store(ticks, std::memory_order_relaxed);
+    clock.multiplier.store(make_multiplier(host_ticks - clock.start_ticks, counter - clock.start_counter), std::memory_order_relaxed);
+    clock.sequence.store(sequence + 2, std::memory_order_release);
+
+    // the elapsed counter is the next interval until it reaches MAX_CALIBRATION_INTERVAL
+    const std::uint64_t elapsed_ticks = host_ticks - clock.start_ticks;
+    const std::uint64_t elapsed_counter = counter - clock.start_counter;
+    const std::uint64_t interval = elapsed_ticks <= MAX_CALIBRATION_INTERVAL
+        ? elapsed_counter
+        : static_cast<std::uint64_t>(static_cast<double>(elapsed_counter) * MAX_CALIBRATION_INTERVAL / elapsed_ticks);
+    clock.next_calibration.store(counter + interval, std::memory_order_relaxed);
+}
+
+static std::uint64_t host_ticks_since_epoch() {
+    CounterClock &clock = get_counter_clock();
+    if (!clock.enabled.load(std::memory_order_acquire)) {
+        if (!clock.drifted.load(std::memory_order_relaxed))
+            return chrono_ticks_since_epoch();
+        return std::max(steady_ticks(), clock.drift_ticks.load(std::memory_order_relaxed)) + clock.epoch_offset;
+    }
+
+    const std::uint64_t counter = read_cpu_counter();
+    if (counter >= clock.next_calibration.load(std::memory_order_relaxed))
+        recalibrate_counter_clock(clock);
+
+    // the counters of the cores can be slightly apart, more than that is a counter which was reset
+    const std::uint64_t anchor_counter = clock.anchor_counter.load(std::memory_order_relaxed);
+    if (counter + clock.max_counter_skew < anchor_counter) {
+        const std::lock_guard<std::mutex> lock(clock.calibration_mutex);
+        if (clock.enabled.load(std::memory_order_relaxed))
+            disable_counter_clock(clock, std::max(counter_to_ticks(clock, anchor_counter), steady_ticks()));
+        return host_ticks_since_epoch();
+    }
+
+    return counter_to_ticks(clock, counter) + clock.epoch_offset;
+}
+#else
+static std::uint64_t host_ticks_since_epoch() {
+    return chrono_ticks_since_epoch();
+}
+#endif
+
+// the guest clock runs at the emulation speed, it is anchored to the host clock each time the speed changes
+// until the speed is changed once, both clocks are the same
+static std::mutex speed_mutex;
+static std::atomic<bool> clock_scaled = false;
+static std::atomic<std::uint32_t> clock_speed = 1;
+static std::uint64_t anchor_host_ticks = 0;
+static std::uint64_t anchor_guest_ticks = 0;
+
+std::uint64_t rtc_ticks_since_epoch() {
+    if (!clock_scaled.load(std::memory_order_acquire))
+        return host_ticks_since_epoch();
+
+    const std::lock_guard<std::mutex> guard(speed_mutex);
+    return anchor_guest_ticks + (host_ticks_since_epoch() - anchor_host_ticks) * clock_speed.load(std::memory_order_relaxed);
+}
+
+void rtc_set_speed(std::uint32_t speed) {
+    speed = std::max<std::uint32_t>(speed, 1);
+    const std::lock_guard<std::mutex> guard(speed_mutex);
+    if (speed == clock_speed.load(std::memory_order_relaxed))
+        return;
+
+    const std::uint64_t host_ticks = host_ticks_since_epoch();
+    if (clock_scaled.load(std::memory_order_relaxed))
+        anchor_guest_ticks += (host_ticks - anchor_host_ticks) * clock_speed.load(std::memory_order_relaxed);
+    else
+        anchor_guest_ticks = host_ticks;
+    anchor_host_ticks = host_ticks;
+    clock_speed.store(speed, std::memory_order_relaxed);
+    clock_scaled.store(true, std::memory_order_release);
+}
+
+std::uint64_t rtc_host_duration(std::uint64_t guest_ticks) {
+    return guest_ticks / clock_speed.load(std::memory_order_relaxed);
+}
+
+std::uint64_t rtc_guest_duration(std::uint64_t host_ticks) {
+    return host_ticks * clock_speed.load(std::memory_order_relaxed);
+}
+
 std::uint64_t rtc_base_ticks() {
     return RTC_OFFSET + std::time(nullptr) * VITA_CLOCKS_PER_SEC - rtc_ticks_since_epoch();
 }
@@ -37,7 +37,7 @@ namespace shader {
 static constexpr int COLOR_ATTACHMENT_TEXTURE_SLOT_IMAGE = 0;
 static constexpr int MASK_TEXTURE_SLOT_IMAGE = 1;
 static constexpr int COLOR_ATTACHMENT_RAW_TEXTURE_SLOT_IMAGE = 3;
-static constexpr uint32_t CURRENT_VERSION = 12;
+static constexpr uint32_t CURRENT_VERSION = 13;
 
 enum struct Target {
     GLSLOpenGL,
@@ -76,4 +76,10 @@ GeneratedShader convert_gxp(const SceGxmProgram &program, const std::string &sha
 
 void convert_gxp_to_glsl_from_filepath(const std::string &shader_filepath);
 
+// return false if this build does not include the SPIR-V optimizer
+bool is_spirv_optimizer_available();
+// run dead code elimination, mem2reg, copy propagation and local load/store elimination on a vulkan shader
+// return false and keep the shader untouched if the optimizer is not available or failed
+bool optimize_spirv(usse::SpirvCode &spirv);
+
 } // namespace shader
@@ -45,6 +45,10 @@ enum FragUniformFieldId : uint32_t {
     FRAG_UNIFORM_res_multiplier
 };
 
+// On Vulkan, the base blocks change with most draws and are push constants instead of being part of the uniform buffer
+// the fragment block is right after the vertex block
+static constexpr uint32_t RENDER_FRAG_PUSH_CONSTANT_OFFSET = static_cast<uint32_t>(align(sizeof(RenderVertUniformBlock), 16));
+
 template <typename T>
 struct UniformBlockExtended {
     T base_block;
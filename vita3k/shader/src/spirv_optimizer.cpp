@@ -0,0 +1,79 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <shader/spirv_recompiler.h>
+
+#include <util/log.h>
+
+#ifdef USE_SPIRV_OPTIMIZER
+#include <spirv-tools/optimizer.hpp>
+#endif
+
+namespace shader {
+
+#ifdef USE_SPIRV_OPTIMIZER
+bool is_spirv_optimizer_available() {
+    return true;
+}
+
+bool optimize_spirv(usse::SpirvCode &spirv) {
+    // the vulkan shaders are generated with SPIR-V 1.0
+    spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_0);
+    optimizer.SetMessageConsumer([](spv_message_level_t level, const char *, const spv_position_t &position, const char *message) {
+        if (level <= SPV_MSG_ERROR)
+            LOG_ERROR("SPIR-V optimizer: {} (at word {})", message, position.index);
+    });
+
+    // most of the redundant code comes from the register banks: every access goes through
+    // a function variable, so the goal is mainly to turn them back into SSA values
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass())
+        .RegisterPass(spvtools::CreateMergeReturnPass())
+        .RegisterPass(spvtools::CreateInlineExhaustivePass())
+        .RegisterPass(spvtools::CreateEliminateDeadFunctionsPass())
+        .RegisterPass(spvtools::CreateLocalAccessChainConvertPass())
+        .RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass())
+        .RegisterPass(spvtools::CreateLocalSingleStoreElimPass())
+        .RegisterPass(spvtools::CreateAggressiveDCEPass())
+        .RegisterPass(spvtools::CreateSSARewritePass())
+        .RegisterPass(spvtools::CreateAggressiveDCEPass())
+        .RegisterPass(spvtools::CreateCopyPropagateArraysPass())
+        .RegisterPass(spvtools::CreateLocalRedundancyEliminationPass())
+        .RegisterPass(spvtools::CreateAggressiveDCEPass())
+        .RegisterPass(spvtools::CreateCFGCleanupPass());
+
+    spvtools::OptimizerOptions options;
+    // the translated shaders are not validated anywhere else either
+    options.set_run_validator(false);
+
+    usse::SpirvCode optimized;
+    if (!optimizer.Run(spirv.data(), spirv.size(), &optimized, options) || optimized.empty())
+        return false;
+
+    spirv = std::move(optimized);
+    return true;
+}
+#else
+bool is_spirv_optimizer_available() {
+    return false;
+}
+
+bool optimize_spirv(usse::SpirvCode &) {
+    return false;
+}
+#endif
+
+} // namespace shader
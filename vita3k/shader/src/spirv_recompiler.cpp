@@ -108,6 +108,9 @@ struct TranslationState {
     spv::Id mask_id = spv::NoResult;
     spv::Id frag_coord_id = spv::NoResult;
     spv::Id render_info_id = spv::NoResult;
+    // variable holding the base fields of the render info, the push constant block on vulkan
+    spv::Id render_info_base_id = spv::NoResult;
+    spv::StorageClass render_info_base_storage = spv::StorageClassUniform;
     std::vector<VarToReg> var_to_regs;
     std::vector<spv::Id> interfaces;
     bool is_maskupdate = false;
@@ -461,7 +464,7 @@ static void create_fragment_inputs(spv::Builder &b, SpirvShaderParameters &param
                 pa_iter_var = b.createLoad(translation_state.frag_coord_id, spv::NoPrecision);
 
                 // divide by the resolution multiplier
-                spv::Id res_multiplier = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(FRAG_UNIFORM_res_multiplier) });
+                spv::Id res_multiplier = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(FRAG_UNIFORM_res_multiplier) });
                 res_multiplier = b.createLoad(res_multiplier, spv::NoPrecision);
                 // don't change the z and w coords
                 spv::Id one = b.makeFloatConstant(1.0f);
@@ -768,7 +771,8 @@ static void create_fragment_inputs(spv::Builder &b, SpirvShaderParameters &param
                 }
                 translation_state.color_attachment_raw_id = color_attachment_raw;
 
-                spv::Id load_normal_cond = b.createBinOp(spv::OpFOrdLessThan, b.makeBoolType(), utils::create_access_chain(b, spv::StorageClassPrivate, translation_state.render_info_id, { b.makeIntConstant(FRAG_UNIFORM_use_raw_image) }), b.makeFloatConstant(0.5f));
+                const spv::Id use_raw_image = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(FRAG_UNIFORM_use_raw_image) });
+                spv::Id load_normal_cond = b.createBinOp(spv::OpFOrdLessThan, b.makeBoolType(), b.createLoad(use_raw_image, spv::NoPrecision), b.makeFloatConstant(0.5f));
                 spv::Builder::If cond_builder(load_normal_cond, spv::SelectionControlMaskNone, b);
 
                 source = b.createOp(spv::OpImageRead, v4, { b.createLoad(color_attachment, spv::NoPrecision), current_coord });
@@ -960,15 +964,20 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
         b.addDecoration(viewport_fields_type, spv::DecorationArrayStride, 8);
     }
 
-    spv::Id render_buf_type;
     int curr_field_id = 0;
 
     const uint16_t uniform_buffer_count = features.support_memory_mapping ? buffer_count : 0;
     const uint16_t uniform_texture_count = features.use_texture_viewport ? texture_count : 0;
+    // on vulkan, the uniform buffer only holds the fields depending on the buffers and textures used
+    // they keep the same offset so the uniform buffer content is the same with both renderers
+    const bool use_push_constants = translation_state.is_vulkan;
 
     if (program_type == SceGxmProgramType::Vertex) {
         // Create the default reg uniform buffer
-        std::vector<spv::Id> uniform_composition = { v4, f32, f32, f32, f32, f32 };
+        const std::vector<spv::Id> base_composition = { v4, f32, f32, f32, f32, f32 };
+        std::vector<spv::Id> uniform_composition;
+        if (!use_push_constants)
+            uniform_composition = base_composition;
         if (uniform_buffer_count > 0)
             uniform_composition.push_back(buffer_addresses_type);
         if (uniform_texture_count > 0) {
@@ -976,15 +985,25 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
             uniform_composition.push_back(viewport_fields_type);
         }
 
-        render_buf_type = b.makeStructType(uniform_composition, "GxmRenderVertBufferBlock");
-        b.addDecoration(render_buf_type, spv::DecorationBlock);
-        if (translation_state.is_target_glsl)
-            b.addDecoration(render_buf_type, spv::DecorationGLSLShared);
+        spv::Id render_buf_type = spv::NoResult;
+        if (!uniform_composition.empty()) {
+            render_buf_type = b.makeStructType(uniform_composition, "GxmRenderVertBufferBlock");
+            b.addDecoration(render_buf_type, spv::DecorationBlock);
+            if (translation_state.is_target_glsl)
+                b.addDecoration(render_buf_type, spv::DecorationGLSLShared);
+        }
 
-#define ADD_VERT_UNIFORM_MEMBER(name)                                                                                                             \
-    curr_field_id++;                                                                                                                              \
-    b.addMemberDecoration(render_buf_type, VERT_UNIFORM_##name, spv::DecorationOffset, static_cast<int>(offsetof(RenderVertUniformBlock, name))); \
-    b.addMemberName(render_buf_type, VERT_UNIFORM_##name, #name)
+        spv::Id base_type = render_buf_type;
+        if (use_push_constants) {
+            base_type = b.makeStructType(base_composition, "GxmRenderVertPushBlock");
+            b.addDecoration(base_type, spv::DecorationBlock);
+        } else {
+            curr_field_id = static_cast<int>(base_composition.size());
+        }
+
+#define ADD_VERT_UNIFORM_MEMBER(name)                                                                                                       \
+    b.addMemberDecoration(base_type, VERT_UNIFORM_##name, spv::DecorationOffset, static_cast<int>(offsetof(RenderVertUniformBlock, name))); \
+    b.addMemberName(base_type, VERT_UNIFORM_##name, #name)
 
         ADD_VERT_UNIFORM_MEMBER(viewport_flip);
         ADD_VERT_UNIFORM_MEMBER(viewport_flag);
@@ -1009,15 +1028,27 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
 
 #undef ADD_EXT_UNIFORM_MEMBER
 
-        translation_state.render_info_id = b.createVariable(spv::NoPrecision, spv::StorageClassUniform, render_buf_type, "renderVertInfo");
+        if (render_buf_type != spv::NoResult) {
+            translation_state.render_info_id = b.createVariable(spv::NoPrecision, spv::StorageClassUniform, render_buf_type, "renderVertInfo");
 
-        b.addDecoration(translation_state.render_info_id, spv::DecorationBinding, translation_state.is_vulkan ? 0 : 2);
-        if (translation_state.is_vulkan)
-            b.addDecoration(translation_state.render_info_id, spv::DecorationDescriptorSet, 0);
+            b.addDecoration(translation_state.render_info_id, spv::DecorationBinding, translation_state.is_vulkan ? 0 : 2);
+            if (translation_state.is_vulkan)
+                b.addDecoration(translation_state.render_info_id, spv::DecorationDescriptorSet, 0);
+        }
+
+        if (use_push_constants) {
+            translation_state.render_info_base_id = b.createVariable(spv::NoPrecision, spv::StorageClassPushConstant, base_type, "renderVertPushInfo");
+            translation_state.render_info_base_storage = spv::StorageClassPushConstant;
+        } else {
+            translation_state.render_info_base_id = translation_state.render_info_id;
+        }
     }
 
     if (program_type == SceGxmProgramType::Fragment) {
-        std::vector<spv::Id> uniform_composition = { f32, f32, f32, f32, f32 };
+        const std::vector<spv::Id> base_composition = { f32, f32, f32, f32, f32 };
+        std::vector<spv::Id> uniform_composition;
+        if (!use_push_constants)
+            uniform_composition = base_composition;
         if (uniform_buffer_count > 0)
             uniform_composition.push_back(buffer_addresses_type);
         if (uniform_texture_count > 0) {
@@ -1025,16 +1056,28 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
             uniform_composition.push_back(viewport_fields_type);
         }
 
-        render_buf_type = b.makeStructType(uniform_composition, "GxmRenderFragBufferBlock");
+        spv::Id render_buf_type = spv::NoResult;
+        if (!uniform_composition.empty()) {
+            render_buf_type = b.makeStructType(uniform_composition, "GxmRenderFragBufferBlock");
+            b.addDecoration(render_buf_type, spv::DecorationBlock);
+            if (translation_state.is_target_glsl)
+                b.addDecoration(render_buf_type, spv::DecorationGLSLShared);
+        }
 
-        b.addDecoration(render_buf_type, spv::DecorationBlock);
-        if (translation_state.is_target_glsl)
-            b.addDecoration(render_buf_type, spv::DecorationGLSLShared);
+        spv::Id base_type = render_buf_type;
+        // the push constant range of the fragment stage is after the vertex one
+        int base_offset = 0;
+        if (use_push_constants) {
+            base_type = b.makeStructType(base_composition, "GxmRenderFragPushBlock");
+            b.addDecoration(base_type, spv::DecorationBlock);
+            base_offset = static_cast<int>(RENDER_FRAG_PUSH_CONSTANT_OFFSET);
+        } else {
+            curr_field_id = static_cast<int>(base_composition.size());
+        }
 
-#define ADD_FRAG_UNIFORM_MEMBER(name)                                                                                                             \
-    curr_field_id++;                                                                                                                              \
-    b.addMemberDecoration(render_buf_type, FRAG_UNIFORM_##name, spv::DecorationOffset, static_cast<int>(offsetof(RenderFragUniformBlock, name))); \
-    b.addMemberName(render_buf_type, FRAG_UNIFORM_##name, #name)
+#define ADD_FRAG_UNIFORM_MEMBER(name)                                                                                                                     \
+    b.addMemberDecoration(base_type, FRAG_UNIFORM_##name, spv::DecorationOffset, base_offset + static_cast<int>(offsetof(RenderFragUniformBlock, name))); \
+    b.addMemberName(base_type, FRAG_UNIFORM_##name, #name)
 
         ADD_FRAG_UNIFORM_MEMBER(back_disabled);
         ADD_FRAG_UNIFORM_MEMBER(front_disabled);
@@ -1058,11 +1101,20 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
 
 #undef ADD_EXT_UNIFORM_MEMBER
 
-        translation_state.render_info_id = b.createVariable(spv::NoPrecision, spv::StorageClassUniform, render_buf_type, "renderFragInfo");
+        if (render_buf_type != spv::NoResult) {
+            translation_state.render_info_id = b.createVariable(spv::NoPrecision, spv::StorageClassUniform, render_buf_type, "renderFragInfo");
 
-        b.addDecoration(translation_state.render_info_id, spv::DecorationBinding, translation_state.is_vulkan ? 1 : 3);
-        if (translation_state.is_vulkan)
-            b.addDecoration(translation_state.render_info_id, spv::DecorationDescriptorSet, 0);
+            b.addDecoration(translation_state.render_info_id, spv::DecorationBinding, translation_state.is_vulkan ? 1 : 3);
+            if (translation_state.is_vulkan)
+                b.addDecoration(translation_state.render_info_id, spv::DecorationDescriptorSet, 0);
+        }
+
+        if (use_push_constants) {
+            translation_state.render_info_base_id = b.createVariable(spv::NoPrecision, spv::StorageClassPushConstant, base_type, "renderFragPushInfo");
+            translation_state.render_info_base_storage = spv::StorageClassPushConstant;
+        } else {
+            translation_state.render_info_base_id = translation_state.render_info_id;
+        }
     }
 
     spv_params.render_info_id = translation_state.render_info_id;
@@ -1561,13 +1613,13 @@ static spv::Function *make_vert_finalize_function(spv::Builder &b, const SpirvSh
                     screen_offset = b.makeCompositeConstant(v4, { neg_one, one, zero, zero });
                 }
 
-                const spv::Id viewport_flag = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_viewport_flag) });
+                const spv::Id viewport_flag = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(VERT_UNIFORM_viewport_flag) });
                 const spv::Id pred = b.createOp(spv::OpFOrdLessThan, b.makeBoolType(), { b.createLoad(viewport_flag, spv::NoPrecision), half });
                 spv::Builder::If cond_builder(pred, spv::SelectionControlMaskNone, b);
 
-                spv::Id screen_width = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_screen_width) });
+                spv::Id screen_width = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(VERT_UNIFORM_screen_width) });
                 screen_width = b.createLoad(screen_width, spv::NoPrecision);
-                spv::Id screen_height = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_screen_height) });
+                spv::Id screen_height = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(VERT_UNIFORM_screen_height) });
                 screen_height = b.createLoad(screen_height, spv::NoPrecision);
 
                 // o_val2 = (x,y,z,w) * (2/width, -2/height, 1, 1) + (-1,1,0,0)
@@ -1577,8 +1629,8 @@ static spv::Function *make_vert_finalize_function(spv::Builder &b, const SpirvSh
                 o_val2 = b.createBinOp(spv::OpFAdd, v4, o_val2, screen_offset);
 
                 // on vulkan this is done using the viewport directly
-                if (!translation_state.is_vulkan && translation_state.render_info_id != spv::NoResult) {
-                    spv::Id flip_vec_id = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_viewport_flip) });
+                if (!translation_state.is_vulkan && translation_state.render_info_base_id != spv::NoResult) {
+                    spv::Id flip_vec_id = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(VERT_UNIFORM_viewport_flip) });
                     flip_vec_id = b.createLoad(flip_vec_id, spv::NoPrecision);
                     o_val2 = b.createBinOp(spv::OpFMul, v4, o_val2, flip_vec_id);
                 }
@@ -1595,22 +1647,22 @@ static spv::Function *make_vert_finalize_function(spv::Builder &b, const SpirvSh
                 cond_builder.makeBeginElse();
 
                 // Apply the viewport flip if opengl
-                if (!translation_state.is_vulkan && translation_state.render_info_id != spv::NoResult) {
-                    spv::Id flip_vec_id = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_viewport_flip) });
+                if (!translation_state.is_vulkan && translation_state.render_info_base_id != spv::NoResult) {
+                    spv::Id flip_vec_id = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(VERT_UNIFORM_viewport_flip) });
                     flip_vec_id = b.createLoad(flip_vec_id, spv::NoPrecision);
                     o_val = b.createBinOp(spv::OpFMul, out_type, o_val, flip_vec_id);
                 }
                 b.createStore(o_val, out_var);
 
                 // scale the depth and w coordinate
-                if (translation_state.render_info_id != spv::NoResult) {
+                if (translation_state.render_info_base_id != spv::NoResult) {
                     spv::Id z_ref = utils::create_access_chain(b, spv::StorageClassOutput, out_var, { b.makeIntConstant(2) });
                     spv::Id w_ref = utils::create_access_chain(b, spv::StorageClassOutput, out_var, { b.makeIntConstant(3) });
                     spv::Id z = b.createLoad(z_ref, spv::NoPrecision);
                     const spv::Id w = b.createLoad(w_ref, spv::NoPrecision);
 
-                    spv::Id z_offset = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_z_offset) });
-                    spv::Id z_scale = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_z_scale) });
+                    spv::Id z_offset = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(VERT_UNIFORM_z_offset) });
+                    spv::Id z_scale = utils::create_access_chain(b, translation_state.render_info_base_storage, translation_state.render_info_base_id, { b.makeIntConstant(VERT_UNIFORM_z_scale) });
                     z_offset = b.createLoad(z_offset, spv::NoPrecision);
                     z_scale = b.createLoad(z_scale, spv::NoPrecision);
 
@@ -1664,8 +1716,8 @@ static spv::Function *make_frag_initialize_function(spv::Builder &b, Translation
     spv::Id zero = b.makeFloatConstant(0.0f);
 
     spv::Id front_facing = b.createVariable(spv::NoPrecision, spv::StorageClassInput, booltype, "gl_FrontFacing");
-    spv::Id front_disabled = utils::create_access_chain(b, spv::StorageClassUniform, translate_state.render_info_id, { b.makeIntConstant(FRAG_UNIFORM_front_disabled) });
-    spv::Id back_disabled = utils::create_access_chain(b, spv::StorageClassUniform, translate_state.render_info_id, { b.makeIntConstant(FRAG_UNIFORM_back_disabled) });
+    spv::Id front_disabled = utils::create_access_chain(b, translate_state.render_info_base_storage, translate_state.render_info_base_id, { b.makeIntConstant(FRAG_UNIFORM_front_disabled) });
+    spv::Id back_disabled = utils::create_access_chain(b, translate_state.render_info_base_storage, translate_state.render_info_base_id, { b.makeIntConstant(FRAG_UNIFORM_back_disabled) });
     b.addDecoration(front_facing, spv::DecorationBuiltIn, spv::BuiltInFrontFacing);
     translate_state.interfaces.push_back(front_facing);
 
@@ -1690,7 +1742,7 @@ static spv::Function *make_frag_initialize_function(spv::Builder &b, Translation
 }
 
 static void generate_update_mask_body(spv::Builder &b, utils::SpirvUtilFunctions &utils, const FeatureState &features, TranslationState &translate_state) {
-    const spv::Id writing_mask_var = utils::create_access_chain(b, spv::StorageClassUniform, translate_state.render_info_id, { b.makeIntConstant(FRAG_UNIFORM_writing_mask) });
+    const spv::Id writing_mask_var = utils::create_access_chain(b, translate_state.render_info_base_storage, translate_state.render_info_base_id, { b.makeIntConstant(FRAG_UNIFORM_writing_mask) });
     const spv::Id writing_mask = b.createLoad(writing_mask_var, spv::NoPrecision);
 
     const spv::Id v4 = b.makeVectorType(b.makeFloatType(32), 4);
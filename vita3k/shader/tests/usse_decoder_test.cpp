@@ -0,0 +1,176 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gtest/gtest.h>
+#include <gxm/types.h>
+#include <shader/usse_translator_entry.h>
+#include <util/fs.h>
+
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace shader;
+
+// Load the instructions of all the gxp files found in the folder pointed by VITA3K_GXP_CORPUS
+// (for example the shaders dumped with the log shaders option).
+static std::vector<uint64_t> load_gxp_corpus() {
+    std::vector<uint64_t> instructions;
+    const char *corpus_path = std::getenv("VITA3K_GXP_CORPUS");
+    if (!corpus_path || !fs::is_directory(corpus_path))
+        return instructions;
+
+    for (const auto &entry : fs::recursive_directory_iterator(corpus_path)) {
+        if (entry.path().extension() != ".gxp")
+            continue;
+
+        fs::ifstream file(entry.path(), std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < sizeof(SceGxmProgram))
+            continue;
+
+        const SceGxmProgram &program = *reinterpret_cast<const SceGxmProgram *>(data.data());
+        const uint64_t *primary = program.primary_program_start();
+        const uint64_t *secondary = program.secondary_program_start();
+        const uint8_t *end = data.data() + data.size();
+        if (reinterpret_cast<const uint8_t *>(primary + program.primary_program_instr_count) <= end)
+            instructions.insert(instructions.end(), primary, primary + program.primary_program_instr_count);
+        if (reinterpret_cast<const uint8_t *>(secondary + program.secondary_program_instr_count) <= end)
+            instructions.insert(instructions.end(), secondary, secondary + program.secondary_program_instr_count);
+    }
+
+    return instructions;
+}
+
+// the bit patterns of the matchers of the decoder, in the same order
+struct InstructionPattern {
+    const char *name;
+    const char *bits;
+};
+
+static const InstructionPattern patterns[] = {
+    { "VMAD2 ()", "00000dpps-ry-cbawwwineeeemmookttffgghhhhhhzzjjllllllqqqqqquuuuuu" },
+    { "V32NMAD ()", "00001pppsrrydcbawwwwneeeemmoiittkkllffffffzzzzzzzggghhhhhhjjjjjj" },
+    { "V16NMAD ()", "00010pppsrrydcbawwwwneeeemmoiittkkllffffffzzzzzzzggghhhhhhjjjjjj" },
+    { "VMAD ()", "00011pppsg1oderaaittnwwwwcbfhzkkjjllmmmmmmqqqquuuuvvxyAAAABBBBBB" },
+    { "VDP ()", "00011pppsc0oderaagttnwwwwbflllkkhhiijjjjjjzzzzmmmqqqyyyxxxuuuuuu" },
+    { "VDUAL ()", "0010cgsskdtpuuuunaaalriiiiwwwwmmffeebbbbbbbooohhjqvvxxyyyzzzzzzz" },
+    { "VCOMP ()", "00110pppsddyenr-aaaaobbccmmff-ttkk--ggggggg-------hhhhhhh---wwww" },
+    { "VMOV ()", "00111pppstrydecbmmaanoooiwwwwkllffgghhhhjjjjjjqqqqqquuuuuuvvvvvv" },
+    { "VPCK ()", "01000pppsnuydercaaaaffftttmmmmbbkkllgggggggoohiijjqqqqqqvwwwwwwx" },
+    { "VTST ()", "01001ppps-oydrceavttiizzmhhhnnbbkkffgggggggwlluuuujjjjjjjqqqqqqq" },
+    { "VTSTMSK ()", "01111ppps-oydtrcevuuiizzm-aa--bbnnkkfffffffwllgggghhhhhhhjjjjjjj" },
+    { "VBW ()", "01ooopppsnrydecxaaaaittttthhbwkkffggjjjjjjjlllllllmmmmmmmqqqqqqq" },
+    { "SOP2 ()", "10000ppcsnaaderbmooofllggghhhittkkjjqqqqqqquvvwwxyzzzzzzzAAAAAAA" },
+    { "SOP2M ()", "10010ppmsnccderbowwwwaalllfff-ttkkgguuuuuuu-------hhhhhhhiiiiiii" },
+    { "SOP3 ()", "10001ppcsnooderbmallfgghhhiiikttjjqquuuuuuuvvvvvvvwwwwwwwxxxxxxx" },
+    { "I8MAD ()", "10011ppcsneedarbmtttuolfghijkqvvwwxxyyyyyyyzzzzzzzAAAAAAABBBBBBB" },
+    { "I16MAD ()", "10100ppasnredbck-tttmmffoolhhgiijjqquuuuuuuvvvvvvvwwwwwwwxxxxxxx" },
+    { "I32MAD ()", "10101pps-nrcdeba0tttif00yy000kgghhjjlllllllmmmmmmmoooooooqqqqqqq" },
+    { "ILLEGAL22 ()", "10110-----------------------------------------------------------" },
+    { "ILLEGAL23 ()", "10111-----------------------------------------------------------" },
+    { "ILLEGAL24 ()", "11000-----------------------------------------------------------" },
+    { "I8MAD2 ()", "11001-----------------------------------------------------------" },
+    { "I32MAD2 ()", "11010ppp-nssdercbooo00iga0000kttffhhjjjjjjjlllllllmmmmmmmqqqqqqq" },
+    { "ILLEGAL27 ()", "11011-----------------------------------------------------------" },
+    { "SMP ()", "11100pppsn-ymrceffaaddlltbbggkhhiijjoooooooqqqqqqquuuuuuuvvvvvvv" },
+    { "PHAS ()", "11111010s100eirc--matwwwppppppppbbnn--------xxxxxxoooooooddddddd" },
+    { "NOP ()", "11111----000-----------101--------------------------------------" },
+    { "BR ()", "11111ppps000e-----wynba00r----------------iloooooooooooooooooooo" },
+    { "SMLSI ()", "11111010--01-n--ttttppppssssdrcieeeeeeeeaaaaaaaabbbbbbbbffffffff" },
+    { "KILL ()", "11111001--11000000000pp0000001101111----------------------------" },
+    { "LIMM ()", "11111100sn10deiiiiiipppmmmmm--tt----uuuuuuuvvvvvvvvvvvvvvvvvvvvv" },
+    { "DEPTHF ()", "11111011s-11recb----npp---tffa--kkddggggggghhhhhhhiiiiiiijjjjjjj" },
+    { "SPEC ()", "11111----scc----------------------------------------------------" },
+    { "VLDST ()", "111oopppsnmycrbakkkkddeetgffihjlqquuvvvvvvvwwwwwwwxxxxxxxzzzzzzz" },
+};
+
+static bool matches(const InstructionPattern &pattern, const uint64_t instruction) {
+    for (int bit = 0; bit < 64; bit++) {
+        const char expected = pattern.bits[bit];
+        const bool set = (instruction >> (63 - bit)) & 1;
+        if ((expected == '0' && set) || (expected == '1' && !set))
+            return false;
+    }
+    return true;
+}
+
+// the decoder must give the first matcher of the table matching the instruction, as a linear search would
+static const char *find_instruction_name(const uint64_t instruction) {
+    for (const InstructionPattern &pattern : patterns) {
+        if (matches(pattern, instruction))
+            return pattern.name;
+    }
+    return nullptr;
+}
+
+// an instruction with the fixed bits of the pattern, the others random
+static uint64_t make_instruction(const InstructionPattern &pattern, std::mt19937_64 &rng) {
+    uint64_t instruction = rng();
+    for (int bit = 0; bit < 64; bit++) {
+        const uint64_t mask = 1ULL << (63 - bit);
+        if (pattern.bits[bit] == '0')
+            instruction &= ~mask;
+        else if (pattern.bits[bit] == '1')
+            instruction |= mask;
+    }
+    return instruction;
+}
+
+static ::testing::AssertionResult decodes_as_table(const uint64_t instruction) {
+    const char *name = usse::get_instruction_name(instruction);
+    const char *expected = find_instruction_name(instruction);
+    if (name == expected || (name && expected && std::string(name) == expected))
+        return ::testing::AssertionSuccess();
+    return ::testing::AssertionFailure() << fmt::format("{:016X} decoded as {} instead of {}", instruction, name ? name : "nothing", expected ? expected : "nothing");
+}
+
+TEST(usse_decoder, each_matcher_is_found) {
+    std::mt19937_64 rng(0x5553534500000000ULL);
+    for (const InstructionPattern &pattern : patterns) {
+        for (int i = 0; i < 256; i++) {
+            const uint64_t instruction = make_instruction(pattern, rng);
+            ASSERT_TRUE(decodes_as_table(instruction));
+        }
+    }
+}
+
+TEST(usse_decoder, random_instructions_match_the_table) {
+    std::mt19937_64 rng(0x5553534500000001ULL);
+    for (int i = 0; i < (1 << 16); i++)
+        ASSERT_TRUE(decodes_as_table(rng()));
+}
+
+TEST(usse_decoder, gxp_corpus_matches_the_table) {
+    const std::vector<uint64_t> instructions = load_gxp_corpus();
+    if (instructions.empty())
+        GTEST_SKIP() << "VITA3K_GXP_CORPUS is not set";
+
+    for (const uint64_t instruction : instructions)
+        ASSERT_TRUE(decodes_as_table(instruction));
+}
+
+TEST(usse_decoder, primary_opcode_lookup) {
+    // the lookup on the primary opcode must still find the right matcher
+    EXPECT_STREQ(usse::get_instruction_name(0x0000000000000000ULL), "VMAD2 ()");
+    // vldst covers all the 111xx primary opcodes
+    EXPECT_STREQ(usse::get_instruction_name(0b11101ULL << 59), "VLDST ()");
+    EXPECT_STREQ(usse::get_instruction_name(0b11110ULL << 59), "VLDST ()");
+}
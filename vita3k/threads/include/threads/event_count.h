@@ -0,0 +1,58 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lets a thread sleep until a condition it checks by itself becomes true, without lost wake ups.
+// The waiter calls prepare_wait, checks its condition, then either calls cancel_wait or wait with the returned key.
+// A notify done after prepare_wait makes wait return right away. The sleep is done on the atomic itself
+// (a futex or its equivalent), notify only does a system call when someone is waiting.
+class EventCount {
+public:
+    EventCount() = default;
+    EventCount(const EventCount &) = delete;
+    EventCount &operator=(const EventCount &) = delete;
+
+    uint32_t prepare_wait() {
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_seq_cst);
+    }
+
+    void cancel_wait() {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wait(const uint32_t key) {
+        epoch.wait(key, std::memory_order_seq_cst);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // must be called after the change making the condition true
+    void notify_all() {
+        // pairs with prepare_wait, either the waiter sees the new epoch or we see that it is waiting
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst) != 0)
+            epoch.notify_all();
+    }
+
+private:
+    std::atomic<uint32_t> epoch = 0;
+    std::atomic<uint32_t> waiters = 0;
+};
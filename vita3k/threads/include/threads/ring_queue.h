@@ -0,0 +1,176 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Bounded lock-free queue with a single consumer.
+// If MultiProducer is false, only one thread is allowed to push, otherwise any number of threads can.
+// Threads waiting for the queue spin for a short time before sleeping on a condition variable,
+// and the condition variable is only touched when someone is actually sleeping on it.
+template <typename T, size_t Capacity, bool MultiProducer = false>
+class RingQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+public:
+    RingQueue() {
+        for (size_t i = 0; i < Capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    RingQueue(const RingQueue &) = delete;
+    RingQueue &operator=(const RingQueue &) = delete;
+
+    // return false if the queue is full
+    bool try_push(const T &item) {
+        if (!push_item(item))
+            return false;
+
+        wake_up();
+        return true;
+    }
+
+    // wait until there is some space in the queue, the item is dropped if the queue is aborted
+    void push(const T &item) {
+        bool pushed = false;
+        wait_for([&]() { return aborted || (pushed = push_item(item)); }, std::chrono::microseconds(0));
+        if (pushed)
+            wake_up();
+    }
+
+    // consumer only, return the first item of the queue or nullptr if it is empty
+    // the item stays valid until pop is called
+    T *front() {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        Cell &cell = cells[pos & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+            return nullptr;
+        return &cell.data;
+    }
+
+    // consumer only, wait for an item for at most timeout (forever if it is 0)
+    // return nullptr if no item was pushed during this time or if the queue is aborted
+    T *top(const std::chrono::microseconds timeout = std::chrono::microseconds(0)) {
+        T *item = nullptr;
+        wait_for([&]() { return aborted || (item = front()) != nullptr; }, timeout);
+        return aborted ? nullptr : item;
+    }
+
+    // consumer only, remove the first item, the queue must not be empty
+    void pop() {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        cells[pos & mask].sequence.store(pos + Capacity, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_relaxed);
+        wake_up();
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed);
+    }
+
+    void abort() {
+        aborted = true;
+        std::lock_guard<std::mutex> lock(park_mutex);
+        park_cond.notify_all();
+    }
+
+private:
+    // number of times the condition is checked before sleeping
+    static constexpr int spin_count = 64;
+    static constexpr size_t mask = Capacity - 1;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data{};
+    };
+
+    // same as try_push without waking up the consumer
+    bool push_item(const T &item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if constexpr (MultiProducer) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else {
+                    tail.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                }
+            } else if (diff < 0) {
+                // the consumer has not popped this cell yet
+                return false;
+            } else {
+                // another producer took this cell
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Pred>
+    void wait_for(Pred pred, const std::chrono::microseconds timeout) {
+        for (int i = 0; i < spin_count; i++) {
+            if (pred())
+                return;
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(park_mutex);
+        parked.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (timeout.count() == 0)
+            park_cond.wait(lock, pred);
+        else
+            park_cond.wait_for(lock, timeout, pred);
+        parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake_up() {
+        // pairs with the increment of parked, either the sleeping thread sees our change
+        // or we see that it is sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(park_mutex);
+        park_cond.notify_all();
+    }
+
+    std::array<Cell, Capacity> cells;
+    // keep the producer and consumer positions on different cache lines
+    alignas(64) std::atomic<size_t> tail = 0;
+    alignas(64) std::atomic<size_t> head = 0;
+
+    std::atomic<bool> aborted = false;
+    std::atomic<int> parked = 0;
+    std::mutex park_mutex;
+    std::condition_variable park_cond;
+};
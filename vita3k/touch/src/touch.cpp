@@ -15,6 +15,7 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <ctrl/state.h>
 #include <display/functions.h>
 #include <display/state.h>
 #include <emuenv/state.h>
@@ -89,11 +90,45 @@ static SceTouchData recover_touchpad_events(const EmuEnvState &emuenv) {
     return touch_data;
 }
 
+static void recover_script_touches(const EmuEnvState &emuenv, SceTouchData *buffers) {
+    const std::lock_guard<std::mutex> guard(emuenv.ctrl.mutex);
+    const InputScriptEntry &entry = emuenv.ctrl.input_script->current;
+    for (int port = 0; port < 2; port++) {
+        if (!entry.touched[port]) {
+            is_touched[port] = false;
+            continue;
+        }
+
+        // a new id for each touch, like with the mouse
+        if (!is_touched[port]) {
+            curr_touch_id[port] = (curr_touch_id[port] + 1) % 128;
+            is_touched[port] = true;
+        }
+        if (!emuenv.touch.touch_mode[port])
+            continue;
+
+        SceTouchReport &report = buffers[port].report[0];
+        report.id = static_cast<uint8_t>(curr_touch_id[port]);
+        report.force = forceTouchEnabled[port] ? 128 : 0;
+        report.x = entry.touch_x[port];
+        report.y = entry.touch_y[port];
+        buffers[port].reportNum = 1;
+    }
+}
+
 void touch_vsync_update(const EmuEnvState &emuenv) {
     std::chrono::time_point<std::chrono::steady_clock> ts = std::chrono::steady_clock::now();
     uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(ts.time_since_epoch()).count();
 
-    if (finger_count > 0) {
+    if (emuenv.ctrl.input_script) {
+        // the host touches are ignored for the replay to be the same on every run
+        SceTouchData *buffers = touch_buffers[(touch_buffer_idx + 1) % MAX_TOUCH_BUFFER_SAVED];
+        for (int port = 0; port < 2; port++) {
+            memset(&buffers[port], 0, sizeof(SceTouchData));
+            buffers[port].timeStamp = timestamp;
+        }
+        recover_script_touches(emuenv, buffers);
+    } else if (finger_count > 0) {
         SceTouchData touch_data = is_touchpad ? recover_touchpad_events(emuenv) : recover_touch_events(emuenv);
         touch_data.timeStamp = timestamp;
 
@@ -0,0 +1,76 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+// Turns the binary trace saved with --trace-log into text, one line per event ordered by time.
+
+#include <nids/functions.h>
+#include <util/fs.h>
+#include <util/string_utils.h>
+#include <util/trace_log.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void print_usage() {
+    std::cout << "Usage: vita3k-trace <trace file> [options]\n"
+              << "Prints the events recorded with vita3k --trace-log.\n"
+              << "  --output <file>           Write the events to this file instead of the standard output\n";
+}
+
+int main(int argc, char *argv[]) {
+    fs::path trace_path;
+    fs::path output_path;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc)
+            output_path = fs::path(string_utils::utf_to_wide(argv[++i]));
+        else if (trace_path.empty() && !arg.starts_with("--"))
+            trace_path = fs::path(string_utils::utf_to_wide(arg));
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (trace_path.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    if (!load_trace_log(trace_path, records)) {
+        std::cerr << "Could not read the trace log " << trace_path.string() << "\n";
+        return 1;
+    }
+
+    fs::ofstream output_file;
+    if (!output_path.empty()) {
+        output_file.open(output_path);
+        if (!output_file) {
+            std::cerr << "Could not create " << output_path.string() << "\n";
+            return 1;
+        }
+    }
+    std::ostream &output = output_path.empty() ? std::cout : output_file;
+
+    const TraceNidNameFunc nid_name = [](uint32_t nid) { return std::string(import_name(nid)); };
+    for (const TraceRecord &record : records)
+        output << format_trace_record(record, nid_name) << "\n";
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BootEvent {
+    std::string name;
+    // phases of the same category are summed in the summary
+    std::string category;
+    // from the start of the profiler
+    uint64_t start_us;
+    uint64_t duration_us;
+    uint32_t thread_index;
+};
+
+// Timeline of the boot of an app, from the start of the emulator to the first frame of the app.
+// Logged as a one-line summary and saved as a Chrome trace (chrome://tracing or Perfetto) when trace_path is set.
+struct BootProfiler {
+    std::mutex mutex;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // the events are not recorded anymore once the first frame is reached
+    bool finished = false;
+    std::vector<BootEvent> events;
+    // the threads, numbered in the order of their first event
+    std::map<std::thread::id, uint32_t> thread_indices;
+    fs::path trace_path;
+};
+
+void record_boot_event(BootProfiler &profiler, const std::string &name, const std::string &category, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+// logs the summary and saves the trace, the events recorded after it are dropped
+void finish_boot_profile(BootProfiler &profiler);
+
+// records the time spent in its scope as an event of the boot
+class BootScope {
+public:
+    BootScope(BootProfiler &profiler, std::string name, std::string category)
+        : profiler(profiler)
+        , name(std::move(name))
+        , category(std::move(category))
+        , start(std::chrono::steady_clock::now()) {
+    }
+    ~BootScope() {
+        record_boot_event(profiler, name, category, start, std::chrono::steady_clock::now());
+    }
+    BootScope(const BootScope &) = delete;
+    BootScope &operator=(const BootScope &) = delete;
+
+private:
+    BootProfiler &profiler;
+    std::string name;
+    std::string category;
+    std::chrono::steady_clock::time_point start;
+};
@@ -47,3 +47,11 @@ T network_to_host_order(T val) {
 }
 
 void float_to_half(const float *src, std::uint16_t *dest, const int total);
+
+// truncated toward zero like a cast, the values out of the range of the type (and nan) are saturated
+void float_to_integer(const float *src, std::int8_t *dest, const int total);
+void float_to_integer(const float *src, std::uint8_t *dest, const int total);
+void float_to_integer(const float *src, std::int16_t *dest, const int total);
+void float_to_integer(const float *src, std::uint16_t *dest, const int total);
+void float_to_integer(const float *src, std::int32_t *dest, const int total);
+void float_to_integer(const float *src, std::uint32_t *dest, const int total);
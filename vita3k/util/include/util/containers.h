@@ -19,6 +19,7 @@
 
 #include <boost/version.hpp>
 
+#include <deque>
 #include <vector>
 
 #if BOOST_VERSION >= 108100
@@ -49,14 +50,15 @@ struct Item {
 };
 
 // A container which supports getting the least recently used item and setting an item as the most recently used
+// items are never moved in memory, even when new ones are added
 template <typename T>
 struct Queue {
-    std::vector<Item<T>> items;
+    std::deque<Item<T>> items;
     Item<T> *head;
 
     void init(const size_t size) {
         // workaround in case T is not copy/move constructible
-        items = std::vector<Item<T>>(size);
+        items = std::deque<Item<T>>(size);
 
         // initialize the doubly linked list
         // make it so that items are first considered in the order of the array
@@ -101,5 +103,23 @@ struct Queue {
         set_as_mru(ptr);
         head = head->next;
     }
+
+    // add a new element, it is the least recently used one
+    T *add() {
+        Item<T> *item = &items.emplace_back();
+        if (items.size() == 1) {
+            item->prev = item;
+            item->next = item;
+            head = item;
+            return &item->content;
+        }
+
+        // insert it between the least recently used element and the head
+        item->prev = head->prev;
+        item->next = head;
+        item->prev->next = item;
+        item->next->prev = item;
+        return &item->content;
+    }
 };
 } // namespace lru
@@ -122,4 +122,7 @@ typedef struct {
 #define PT_LOPROC (0x70000000U) // Lowest processor-specific value
 #define PT_HIPROC (0x7FFFFFFFU) // Highest processor-specific value
 
-// TODO: possible values for p_flags
+// Possible values for p_flags
+#define PF_X (0x1U) // Executable
+#define PF_W (0x2U) // Writable
+#define PF_R (0x4U) // Readable
@@ -0,0 +1,73 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// host time spent on a frame, in milliseconds
+struct FrameSample {
+    float frame_time;
+    // summed over all the guest threads, can be more than the frame time
+    float guest_cpu_time;
+    float hle_time;
+    float batches_time;
+    float gpu_time;
+    float present_time;
+};
+
+// host time spent by the subsystems since the start, in nanoseconds
+struct FrameCounters {
+    uint64_t guest_cpu_ns;
+    uint64_t hle_ns;
+    uint64_t batches_ns;
+    uint64_t present_ns;
+};
+
+// Times of the last frames displayed, shown by the detailed performance overlay
+struct FrameStats {
+    static constexpr size_t HISTORY_SIZE = 2048;
+    std::array<FrameSample, HISTORY_SIZE> samples = {};
+    // index of the next sample
+    size_t next_sample = 0;
+    size_t sample_count = 0;
+
+    // not set before the first frame
+    std::chrono::steady_clock::time_point last_frame;
+    FrameCounters last_counters = {};
+
+    // updated by update_frame_stats
+    // frame rates of the slowest 1% and 0.1% frames of the history
+    float low_1_fps = 0.f;
+    float low_01_fps = 0.f;
+    // share of the duration of the mixed audio spent in the host callback, in percent
+    float audio_load = 0.f;
+    uint64_t last_audio_callback_ns = 0;
+    uint64_t last_audio_ns = 0;
+};
+
+// the gpu time is the one of the last frame rendered, the other times are taken from the difference with the last counters
+void add_frame_sample(FrameStats &stats, std::chrono::steady_clock::time_point now, const FrameCounters &counters, float gpu_time);
+// called about once per second
+void update_frame_stats(FrameStats &stats, uint64_t audio_callback_ns, uint64_t audio_ns);
+// the next frame only starts the measure, the history is kept unless clear_history is set
+void reset_frame_stats(FrameStats &stats, bool clear_history);
+// age 0 is the last sample
+const FrameSample &get_frame_sample(const FrameStats &stats, size_t age);
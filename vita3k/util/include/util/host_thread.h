@@ -0,0 +1,32 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstdint>
+
+enum class HostThreadPriority {
+    Low,
+    Normal,
+    High,
+    Highest,
+};
+
+// These only change the calling thread, they return false if the host refused the change
+bool set_current_thread_priority(HostThreadPriority priority);
+// bit i of core_mask is the host core i, 0 lets the thread run on every core
+bool set_current_thread_affinity(uint64_t core_mask);
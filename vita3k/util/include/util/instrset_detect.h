@@ -29,9 +29,13 @@ bool hasFMA3(void); // true if FMA3 instructions supported
 bool hasFMA4(void); // true if FMA4 instructions supported
 bool hasXOP(void); // true if XOP  instructions supported
 bool hasF16C(void); // true if F16C instructions supported
+bool hasBMI2(void); // true if BMI2 instructions supported
+bool hasFastBMI2(void); // true if BMI2 instructions supported and pdep/pext are not microcoded
 bool hasAVX512ER(void); // true if AVX512ER instructions supported
 bool hasAVX512VBMI(void); // true if AVX512VBMI instructions supported
 bool hasAVX512VBMI2(void); // true if AVX512VBMI2 instructions supported
+bool hasAES(void); // true if AES-NI (x86-64) or the ARMv8 AES instructions (arm64) are supported
+bool hasInvariantTSC(void); // true if the TSC runs at a constant rate on all the cores and in all the power states (x86-64)
 
 // return values of function instrset_detect.
 // usage sample: if (instrset_detect()>=instrset_AVX) {/*AVX supported*/}
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "find.h"
+#include "lock_profiler.h"
 
 #include <mutex>
 
@@ -26,3 +27,9 @@ std::shared_ptr<T> lock_and_find(Key key, const std::map<Key, std::shared_ptr<T>
     const std::lock_guard<std::mutex> lock(mutex);
     return util::find(key, map);
 }
+
+template <typename T, typename Key>
+std::shared_ptr<T> lock_and_find(Key key, const std::map<Key, std::shared_ptr<T>> &map, ProfiledMutex &mutex, const std::source_location &location = std::source_location::current()) {
+    const ProfiledLockGuard lock(mutex, location);
+    return util::find(key, map);
+}
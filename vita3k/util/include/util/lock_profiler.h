@@ -0,0 +1,109 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <source_location>
+
+// Wait time, hold time and lock count of the profiled mutexes for each call site locking them.
+// The mutexes cost a relaxed load over a std::mutex while the profiler is stopped, the contended waits show in Tracy.
+struct LockSiteStats;
+
+inline std::atomic<bool> lock_profiler_enabled = false;
+
+inline bool is_lock_profiler_enabled() {
+    return lock_profiler_enabled.load(std::memory_order_relaxed);
+}
+
+void start_lock_profiler();
+void stop_lock_profiler();
+// the sites are sorted by total wait time
+bool save_lock_report(const fs::path &path);
+
+// Mutex usable with the std lock types and std::condition_variable_any.
+// The locks taken through them are attributed to the std headers, ProfiledLockGuard gives the call site.
+class ProfiledMutex {
+public:
+    // the name must outlive the mutex, the sites of the mutexes with the same name are merged
+    explicit ProfiledMutex(const char *name)
+        : name(name) {}
+    ProfiledMutex(const ProfiledMutex &) = delete;
+    ProfiledMutex &operator=(const ProfiledMutex &) = delete;
+
+    void lock(const std::source_location &location = std::source_location::current()) {
+        if (is_lock_profiler_enabled())
+            profiled_lock(location);
+        else
+            mutex.lock();
+    }
+
+    bool try_lock(const std::source_location &location = std::source_location::current()) {
+        if (!mutex.try_lock())
+            return false;
+        if (is_lock_profiler_enabled())
+            record_lock(location, 0);
+        return true;
+    }
+
+    void unlock() {
+        if (holder)
+            record_unlock();
+        mutex.unlock();
+    }
+
+    const char *get_name() const {
+        return name;
+    }
+
+    // for the std::condition_variable waiting with it, the locks taken through it are not profiled
+    std::mutex &get_mutex() {
+        return mutex;
+    }
+
+private:
+    void profiled_lock(const std::source_location &location);
+    void record_lock(const std::source_location &location, uint64_t wait_ns);
+    void record_unlock();
+
+    std::mutex mutex;
+    const char *name;
+    // site which locked the mutex while the profiler was running, only used by the owner
+    LockSiteStats *holder = nullptr;
+    int64_t locked_ns = 0;
+};
+
+class ProfiledLockGuard {
+public:
+    explicit ProfiledLockGuard(ProfiledMutex &mutex, const std::source_location &location = std::source_location::current())
+        : mutex(mutex) {
+        mutex.lock(location);
+    }
+    ~ProfiledLockGuard() {
+        mutex.unlock();
+    }
+    ProfiledLockGuard(const ProfiledLockGuard &) = delete;
+    ProfiledLockGuard &operator=(const ProfiledLockGuard &) = delete;
+
+private:
+    ProfiledMutex &mutex;
+};
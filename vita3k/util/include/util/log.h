@@ -30,12 +30,20 @@
 #include <sstream>
 #include <vector>
 
-#define LOG_TRACE SPDLOG_TRACE
-#define LOG_DEBUG SPDLOG_DEBUG
-#define LOG_INFO SPDLOG_INFO
-#define LOG_WARN SPDLOG_WARN
-#define LOG_ERROR SPDLOG_ERROR
-#define LOG_CRITICAL SPDLOG_CRITICAL
+// the arguments are only evaluated when the level is enabled, log_hex or import_name cost more than the check
+#define LOG_AT_LEVEL(level, ...)                                         \
+    do {                                                                 \
+        spdlog::logger *const LOG_LOGGER = spdlog::default_logger_raw(); \
+        if (LOG_LOGGER->should_log(level))                               \
+            SPDLOG_LOGGER_CALL(LOG_LOGGER, level, __VA_ARGS__);          \
+    } while (0)
+
+#define LOG_TRACE(...) LOG_AT_LEVEL(spdlog::level::trace, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT_LEVEL(spdlog::level::debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT_LEVEL(spdlog::level::info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT_LEVEL(spdlog::level::warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT_LEVEL(spdlog::level::err, __VA_ARGS__)
+#define LOG_CRITICAL(...) LOG_AT_LEVEL(spdlog::level::critical, __VA_ARGS__)
 
 #define LOG_TRACE_IF(flag, ...) \
     if (flag)                   \
@@ -0,0 +1,65 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <cstddef>
+#include <cstdint>
+
+enum class MappedFileAdvice {
+    // the file is read from start to end, the pages can be read far ahead
+    Sequential,
+    // the range is about to be read
+    WillNeed,
+};
+
+// Read-only memory mapping of a whole file.
+// The content can then be accessed directly without going through read calls.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // return false if the file does not exist, is empty or could not be mapped
+    bool open(const fs::path &path);
+    void close();
+    // hint given to the host about how the content is used, does nothing on hosts without it
+    void advise(size_t offset, size_t length, MappedFileAdvice advice) const;
+
+    bool is_open() const {
+        return data_ != nullptr;
+    }
+    const uint8_t *data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef WIN32
+    void *mapping = nullptr;
+#endif
+};
@@ -0,0 +1,66 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Host memory used by the emulator, grouped by the module owning it.
+// Every owner reports the bytes it holds, the registry keeps the peak and an optional soft budget
+// that the owner checks to evict from its caches.
+enum class MemoryCategory {
+    Textures,
+    Surfaces,
+    Pipelines,
+    MappedMemory,
+    JitCode,
+    NgsVoices,
+    IoReadBuffers,
+    GuestPages,
+    COUNT
+};
+
+constexpr size_t MEMORY_CATEGORY_COUNT = static_cast<size_t>(MemoryCategory::COUNT);
+
+struct MemoryCategoryUsage {
+    uint64_t used;
+    uint64_t peak;
+    // 0 if the category has no budget
+    uint64_t budget;
+};
+
+void add_memory_usage(MemoryCategory category, uint64_t bytes);
+void remove_memory_usage(MemoryCategory category, uint64_t bytes);
+// for the owners computing their usage themselves
+void set_memory_usage(MemoryCategory category, uint64_t bytes);
+
+MemoryCategoryUsage get_memory_usage(MemoryCategory category);
+std::array<MemoryCategoryUsage, MEMORY_CATEGORY_COUNT> get_all_memory_usage();
+uint64_t get_total_memory_usage();
+
+// 0 removes the budget
+void set_memory_budget(MemoryCategory category, uint64_t bytes);
+uint64_t get_memory_budget(MemoryCategory category);
+bool is_over_memory_budget(MemoryCategory category);
+// only the owners able to evict from their caches check the budget
+bool is_memory_budget_enforced(MemoryCategory category);
+// the peaks start again from the current usage
+void reset_memory_peaks();
+
+const char *get_memory_category_name(MemoryCategory category);
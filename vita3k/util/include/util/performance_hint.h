@@ -0,0 +1,44 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstdint>
+
+// same order as the thermal status of Android
+enum class ThermalStatus {
+    Unsupported,
+    None,
+    Light,
+    Moderate,
+    Severe,
+    Critical,
+    Emergency,
+    Shutdown,
+};
+
+// Add the calling thread to the threads doing the work of a frame, the host uses it to pick their cores and clocks.
+// Adding the same thread again does nothing
+void add_performance_hint_thread();
+// The work of each frame should take at most target_frame_ns, returns false if the host has no performance hints
+bool start_performance_hint(int64_t target_frame_ns);
+// time spent by the threads on the last frame, without the time spent waiting for the vsync
+void report_frame_work_duration(int64_t duration_ns);
+void stop_performance_hint();
+
+// the thermal status is listened to from the first call
+ThermalStatus get_thermal_status();
@@ -0,0 +1,25 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Sleep until the deadline with the most precise timer of the host, the last spin_us microseconds are spent yielding
+// as the host timers can wake the thread too late
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline, uint32_t spin_us);
+void precise_sleep_for(std::chrono::microseconds duration, uint32_t spin_us);
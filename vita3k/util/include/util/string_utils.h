@@ -35,5 +35,7 @@ std::basic_string<uint8_t> string_to_byte_array(std::string string);
 std::string toupper(const std::string &s);
 std::string tolower(const std::string &s);
 int stoi_def(const std::string &str, int default_value = 0, const char *name = "value");
+// escapes the string to be put between the quotes of a JSON string
+std::string escape_json(const std::string &str);
 
 } // namespace string_utils
@@ -0,0 +1,74 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// work done by the emulator since the start, the work done during a frame is the difference of two snapshots
+struct StutterCounters {
+    uint64_t shader_translations;
+    uint64_t pipeline_creations;
+    uint64_t texture_uploads;
+    uint64_t texture_upload_bytes;
+    uint64_t surface_syncs;
+    uint64_t protect_faults;
+    uint64_t write_track_faults;
+    uint64_t module_loads;
+    uint64_t translated_blocks;
+};
+
+// frame longer than the threshold and the work done during it
+struct StutterEvent {
+    // index of the frame since the start of the detection
+    uint64_t frame;
+    // time since the start of the detection, in seconds
+    float time;
+    // in milliseconds, the gpu time is the one of the last frame measured by the backend
+    float frame_time;
+    float gpu_time;
+    StutterCounters work;
+};
+
+// Keeps the last frames which took longer than the threshold, to find what made the app stutter
+struct StutterDetector {
+    static constexpr size_t HISTORY_SIZE = 128;
+    std::array<StutterEvent, HISTORY_SIZE> events = {};
+    // index of the next event
+    size_t next_event = 0;
+    size_t event_count = 0;
+    // events overwritten by newer ones
+    uint64_t dropped_count = 0;
+
+    std::chrono::steady_clock::time_point start;
+    // not set before the first frame
+    std::chrono::steady_clock::time_point last_frame;
+    StutterCounters last_counters = {};
+    uint64_t frame_count = 0;
+};
+
+// returns true if the frame took longer than threshold_ms, which is then added to the events
+bool add_stutter_frame(StutterDetector &detector, std::chrono::steady_clock::time_point now, const StutterCounters &counters, float threshold_ms, float gpu_time);
+// the next frame only starts the measure, used when the frames are not displayed because the app is paused
+void reset_stutter_frame(StutterDetector &detector);
+// the work done during the event, or "no work recorded" if the frame was only spent running the app
+std::string describe_stutter_event(const StutterEvent &event);
+// writes the events in the log, the oldest first
+void dump_stutter_events(const StutterDetector &detector);
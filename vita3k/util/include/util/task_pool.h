@@ -0,0 +1,82 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Background work of the emulator, run by one pool of host threads sized to the cores not used by the guest
+// cpu, the renderer and the audio. Each worker takes the tasks it submits first and steals from the others
+// when it has none left. The tasks are always taken by priority.
+enum class TaskPriority {
+    // the guest is waiting for the result (NGS voices), one worker only runs these
+    LatencyCritical,
+    // shown to the user soon (shaders, icons)
+    Normal,
+    // can take as long as needed (installs, downloads, shader optimization), at least one worker is kept for the others
+    Background,
+    COUNT
+};
+
+constexpr size_t TASK_PRIORITY_COUNT = static_cast<size_t>(TaskPriority::COUNT);
+
+struct TaskPoolStats {
+    uint32_t worker_count;
+    // tasks waiting to be run, for each priority
+    std::array<uint32_t, TASK_PRIORITY_COUNT> queued;
+    uint32_t running;
+    uint64_t completed;
+    // tasks run by another worker than the one which submitted them
+    uint64_t stolen;
+};
+
+// host threads kept for the guest cpu, the renderer and the audio, only used when the pool starts with the first task
+void set_task_pool_reserved_threads(uint32_t count);
+void submit_task(TaskPriority priority, std::function<void()> task);
+TaskPoolStats get_task_pool_stats();
+
+// Tasks which can be waited for and cancelled together, the group must outlive them so its destructor waits.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPriority priority = TaskPriority::Normal);
+    ~TaskGroup();
+
+    void submit(std::function<void()> task);
+    // wait for the tasks submitted to be done, runs the queued tasks at least as urgent meanwhile if called from a worker
+    void wait();
+    // drop the tasks which have not started yet and wait for the running ones, tasks can be submitted again after
+    void cancel();
+    // submitted and not done yet
+    uint32_t pending() const;
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+private:
+    TaskPriority priority;
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    uint32_t pending_count = 0;
+    std::atomic<bool> cancelled = false;
+};
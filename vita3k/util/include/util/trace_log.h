@@ -0,0 +1,85 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Compact binary log of the events of the hot paths, cheap enough to stay enabled in captures.
+// Each host thread writes fixed size records to its own ring without locking, the oldest ones are overwritten.
+// The saved file is turned into text offline by vita3k-trace.
+enum class TraceEvent : uint16_t {
+    HleImportCall, // nid, lr
+    LleImportCall, // nid, pc
+    FileRead, // fd, size, result
+    FileWrite, // fd, size, result
+    FileSeek, // fd, offset, whence
+    COUNT
+};
+
+constexpr size_t TRACE_MAX_ARGS = 3;
+
+struct TraceRecord {
+    // from the start of the trace log
+    uint64_t timestamp_ns;
+    uint32_t thread_id;
+    uint16_t event;
+    uint16_t arg_count;
+    uint64_t args[TRACE_MAX_ARGS];
+};
+
+// only read before recording, the events cost a relaxed load when the log is stopped
+inline std::atomic<bool> trace_log_enabled = false;
+
+inline bool is_trace_log_enabled() {
+    return trace_log_enabled.load(std::memory_order_relaxed);
+}
+
+// the rings of the threads already recording keep their size when it is started again, their records are cleared
+void start_trace_log(size_t records_per_thread);
+void stop_trace_log();
+// the events are recorded with the guest thread id given to the current host thread
+void set_trace_thread_id(uint32_t thread_id);
+void record_trace_event(TraceEvent event, const uint64_t *args, uint16_t arg_count);
+// the records being written by the threads still running can be torn, stop the log before
+bool save_trace_log(const fs::path &path);
+
+// offline formatting, the records of all the threads are sorted by timestamp
+bool load_trace_log(const fs::path &path, std::vector<TraceRecord> &records);
+typedef std::function<std::string(uint32_t nid)> TraceNidNameFunc;
+std::string format_trace_record(const TraceRecord &record, const TraceNidNameFunc &nid_name);
+
+template <typename... Args>
+void trace_event(TraceEvent event, Args... args) {
+    static_assert(sizeof...(Args) <= TRACE_MAX_ARGS);
+    const uint64_t values[] = { static_cast<uint64_t>(args)..., 0 };
+    record_trace_event(event, values, sizeof...(Args));
+}
+
+// the arguments are not evaluated while the log is stopped
+#define TRACE_EVENT(event, ...)              \
+    do {                                     \
+        if (is_trace_log_enabled())          \
+            trace_event(event, __VA_ARGS__); \
+    } while (0)
@@ -77,6 +77,39 @@ inline std::string to_debug_str(const MemState &mem) {
 #ifdef TRACY_ENABLE
 #include "tracy_module_utils.h"
 #include <tracy/Tracy.hpp>
+#include <tracy/TracyC.h>
+
+#include <atomic>
+#include <cstring>
+
+// GPU timeline whose zones are sent once their timestamps have been read back, long after they were recorded
+struct TracyGpuContext {
+    uint8_t id;
+    uint16_t next_query = 0;
+};
+
+// gpu_time is a timestamp written by the GPU just before the call, period is the duration of a GPU tick in nanoseconds
+inline TracyGpuContext tracy_gpu_new_context(const char *name, int64_t gpu_time, float period) {
+    static std::atomic<uint8_t> next_id = 0;
+    const TracyGpuContext context = { next_id++ };
+    // the type of the context is the one of a Vulkan context
+    ___tracy_emit_gpu_new_context_serial({ .gpuTime = gpu_time, .period = period, .context = context.id, .flags = 0, .type = 2 });
+    ___tracy_emit_gpu_context_name_serial({ .context = context.id, .name = name, .len = static_cast<uint16_t>(strlen(name)) });
+    return context;
+}
+
+// the zones of a context must be sent in order, a zone begun after another one is nested inside it until it ends
+inline void tracy_gpu_zone_begin(TracyGpuContext &context, const ___tracy_source_location_data *location, uint64_t gpu_time) {
+    const uint16_t query = context.next_query++;
+    ___tracy_emit_gpu_zone_begin_serial({ .srcloc = reinterpret_cast<uint64_t>(location), .queryId = query, .context = context.id });
+    ___tracy_emit_gpu_time_serial({ .gpuTime = static_cast<int64_t>(gpu_time), .queryId = query, .context = context.id });
+}
+
+inline void tracy_gpu_zone_end(TracyGpuContext &context, uint64_t gpu_time) {
+    const uint16_t query = context.next_query++;
+    ___tracy_emit_gpu_zone_end_serial({ .queryId = query, .context = context.id });
+    ___tracy_emit_gpu_time_serial({ .gpuTime = static_cast<int64_t>(gpu_time), .queryId = query, .context = context.id });
+}
 
 #if (defined(_MSC_VER) && !defined(__clang__) && (!defined(_MSVC_TRADITIONAL) || _MSVC_TRADITIONAL))
 #define __ARGS_WITH_COMMA(...) , ##__VA_ARGS__
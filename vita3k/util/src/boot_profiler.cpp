@@ -0,0 +1,100 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/boot_profiler.h>
+
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+static uint64_t get_profiler_us(const BootProfiler &profiler, std::chrono::steady_clock::time_point time) {
+    if (time < profiler.start)
+        return 0;
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - profiler.start).count();
+}
+
+void record_boot_event(BootProfiler &profiler, const std::string &name, const std::string &category, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    const std::lock_guard<std::mutex> lock(profiler.mutex);
+    if (profiler.finished)
+        return;
+
+    const auto thread_index = profiler.thread_indices.emplace(std::this_thread::get_id(), static_cast<uint32_t>(profiler.thread_indices.size())).first->second;
+    const uint64_t start_us = get_profiler_us(profiler, start);
+    profiler.events.push_back({ name, category, start_us, get_profiler_us(profiler, end) - start_us, thread_index });
+}
+
+static void save_boot_trace(const BootProfiler &profiler, uint64_t total_us) {
+    if (profiler.trace_path.has_parent_path())
+        fs::create_directories(profiler.trace_path.parent_path());
+    fs::ofstream trace(profiler.trace_path, std::ios::out);
+    if (!trace.is_open()) {
+        LOG_ERROR("Failed to save the boot profile to {}", profiler.trace_path.string());
+        return;
+    }
+
+    trace << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for (const auto &[id, index] : profiler.thread_indices)
+        trace << fmt::format("  {{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{ \"name\": \"{}\" }} }},\n", index, index == 0 ? "main" : fmt::format("thread {}", index));
+    for (const BootEvent &event : profiler.events)
+        trace << fmt::format("  {{ \"name\": \"{}\", \"cat\": \"{}\", \"ph\": \"X\", \"ts\": {}, \"dur\": {}, \"pid\": 1, \"tid\": {} }},\n",
+            string_utils::escape_json(event.name), string_utils::escape_json(event.category), event.start_us, event.duration_us, event.thread_index);
+    trace << fmt::format("  {{ \"name\": \"first frame\", \"cat\": \"boot\", \"ph\": \"i\", \"s\": \"g\", \"ts\": {}, \"pid\": 1, \"tid\": 0 }}\n", total_us);
+    trace << "] }\n";
+
+    LOG_INFO("Boot profile saved to {}", profiler.trace_path.string());
+}
+
+void finish_boot_profile(BootProfiler &profiler) {
+    const auto now = std::chrono::steady_clock::now();
+    const std::lock_guard<std::mutex> lock(profiler.mutex);
+    if (profiler.finished)
+        return;
+    profiler.finished = true;
+
+    // the categories are listed in the order of their first event
+    struct CategoryTime {
+        std::string category;
+        uint64_t duration_us = 0;
+        uint32_t count = 0;
+    };
+    std::vector<CategoryTime> categories;
+    for (const BootEvent &event : profiler.events) {
+        auto it = std::find_if(categories.begin(), categories.end(), [&](const CategoryTime &time) {
+            return time.category == event.category;
+        });
+        if (it == categories.end())
+            it = categories.insert(categories.end(), { event.category });
+        it->duration_us += event.duration_us;
+        it->count++;
+    }
+
+    const uint64_t total_us = get_profiler_us(profiler, now);
+    std::string summary = fmt::format("Boot: {} ms to the first frame", total_us / 1000);
+    for (const CategoryTime &time : categories) {
+        if (time.count > 1)
+            summary += fmt::format(", {}: {} ms ({})", time.category, time.duration_us / 1000, time.count);
+        else
+            summary += fmt::format(", {}: {} ms", time.category, time.duration_us / 1000);
+    }
+    LOG_INFO("{}", summary);
+
+    if (!profiler.trace_path.empty())
+        save_boot_trace(profiler, total_us);
+}
@@ -0,0 +1,83 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/frame_stats.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+static float get_delta_ms(uint64_t now_ns, uint64_t last_ns) {
+    return now_ns >= last_ns ? static_cast<float>(now_ns - last_ns) / 1e6f : 0.f;
+}
+
+void add_frame_sample(FrameStats &stats, std::chrono::steady_clock::time_point now, const FrameCounters &counters, float gpu_time) {
+    if (stats.last_frame != std::chrono::steady_clock::time_point()) {
+        FrameSample &sample = stats.samples[stats.next_sample];
+        sample.frame_time = std::chrono::duration<float, std::milli>(now - stats.last_frame).count();
+        sample.guest_cpu_time = get_delta_ms(counters.guest_cpu_ns, stats.last_counters.guest_cpu_ns);
+        sample.hle_time = get_delta_ms(counters.hle_ns, stats.last_counters.hle_ns);
+        sample.batches_time = get_delta_ms(counters.batches_ns, stats.last_counters.batches_ns);
+        sample.gpu_time = gpu_time;
+        sample.present_time = get_delta_ms(counters.present_ns, stats.last_counters.present_ns);
+
+        stats.next_sample = (stats.next_sample + 1) % FrameStats::HISTORY_SIZE;
+        stats.sample_count = std::min(stats.sample_count + 1, FrameStats::HISTORY_SIZE);
+    }
+
+    stats.last_frame = now;
+    stats.last_counters = counters;
+}
+
+void update_frame_stats(FrameStats &stats, uint64_t audio_callback_ns, uint64_t audio_ns) {
+    if (audio_ns > stats.last_audio_ns && audio_callback_ns >= stats.last_audio_callback_ns)
+        stats.audio_load = static_cast<float>(audio_callback_ns - stats.last_audio_callback_ns) * 100.f / static_cast<float>(audio_ns - stats.last_audio_ns);
+    stats.last_audio_callback_ns = audio_callback_ns;
+    stats.last_audio_ns = audio_ns;
+
+    if (stats.sample_count == 0)
+        return;
+
+    // the lows are the frame rates matching the 99th and 99.9th percentiles of the frame times
+    std::vector<float> frame_times(stats.sample_count);
+    for (size_t i = 0; i < stats.sample_count; i++)
+        frame_times[i] = stats.samples[i].frame_time;
+
+    const auto get_low_fps = [&](size_t slowest_frames) {
+        const auto nth = frame_times.begin() + std::min(slowest_frames, frame_times.size() - 1);
+        std::nth_element(frame_times.begin(), nth, frame_times.end(), std::greater<float>());
+        return *nth > 0.f ? 1000.f / *nth : 0.f;
+    };
+    stats.low_1_fps = get_low_fps(stats.sample_count / 100);
+    stats.low_01_fps = get_low_fps(stats.sample_count / 1000);
+}
+
+void reset_frame_stats(FrameStats &stats, bool clear_history) {
+    stats.last_frame = std::chrono::steady_clock::time_point();
+    if (!clear_history)
+        return;
+
+    stats.next_sample = 0;
+    stats.sample_count = 0;
+    stats.low_1_fps = 0.f;
+    stats.low_01_fps = 0.f;
+    stats.audio_load = 0.f;
+}
+
+const FrameSample &get_frame_sample(const FrameStats &stats, size_t age) {
+    return stats.samples[(stats.next_sample + FrameStats::HISTORY_SIZE - 1 - age) % FrameStats::HISTORY_SIZE];
+}
@@ -0,0 +1,99 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/host_thread.h>
+
+#include <thread>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static uint64_t all_cores_mask() {
+    const uint32_t core_count = std::thread::hardware_concurrency();
+    return (core_count == 0 || core_count >= 64) ? ~0ULL : (1ULL << core_count) - 1;
+}
+
+#ifdef WIN32
+bool set_current_thread_priority(HostThreadPriority priority) {
+    int value = THREAD_PRIORITY_NORMAL;
+    switch (priority) {
+    case HostThreadPriority::Low: value = THREAD_PRIORITY_BELOW_NORMAL; break;
+    case HostThreadPriority::Normal: value = THREAD_PRIORITY_NORMAL; break;
+    case HostThreadPriority::High: value = THREAD_PRIORITY_ABOVE_NORMAL; break;
+    case HostThreadPriority::Highest: value = THREAD_PRIORITY_HIGHEST; break;
+    }
+    return SetThreadPriority(GetCurrentThread(), value);
+}
+
+bool set_current_thread_affinity(uint64_t core_mask) {
+    if (core_mask == 0)
+        core_mask = all_cores_mask();
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(core_mask)) != 0;
+}
+#elif defined(__APPLE__)
+bool set_current_thread_priority(HostThreadPriority priority) {
+    qos_class_t qos = QOS_CLASS_DEFAULT;
+    switch (priority) {
+    case HostThreadPriority::Low: qos = QOS_CLASS_UTILITY; break;
+    case HostThreadPriority::Normal: qos = QOS_CLASS_DEFAULT; break;
+    case HostThreadPriority::High: qos = QOS_CLASS_USER_INITIATED; break;
+    case HostThreadPriority::Highest: qos = QOS_CLASS_USER_INTERACTIVE; break;
+    }
+    return pthread_set_qos_class_self_np(qos, 0) == 0;
+}
+
+bool set_current_thread_affinity(uint64_t core_mask) {
+    // macOS has no way to pin a thread to cores
+    return core_mask == 0;
+}
+#else
+bool set_current_thread_priority(HostThreadPriority priority) {
+    // the nice value is per thread on Linux, going below 0 needs privileges
+    int nice = 0;
+    switch (priority) {
+    case HostThreadPriority::Low: nice = 5; break;
+    case HostThreadPriority::Normal: nice = 0; break;
+    case HostThreadPriority::High: nice = -5; break;
+    case HostThreadPriority::Highest: nice = -10; break;
+    }
+    return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) == 0;
+}
+
+bool set_current_thread_affinity(uint64_t core_mask) {
+    if (core_mask == 0)
+        core_mask = all_cores_mask();
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core = 0; core < 64 && core < CPU_SETSIZE; core++) {
+        if (core_mask & (1ULL << core))
+            CPU_SET(core, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#endif
@@ -21,6 +21,15 @@
 #include <x86intrin.h> // Gcc or Clang compiler
 #endif
 
+#if defined(__aarch64__) || defined(_M_ARM64)
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#endif
+
 #include <stdint.h> // Define integer types with known size
 namespace util {
 
@@ -212,6 +221,32 @@ bool hasF16C(void) {
     return ((abcd[2] & (1 << 29)) != 0); // ecx bit 29 indicates F16C
 }
 
+// detect if CPU supports the BMI2 instruction set
+bool hasBMI2(void) {
+    if (instrset_detect() < 7)
+        return false; // all the CPUs with BMI2 have AVX
+    int abcd[4]; // cpuid results
+    cpuid(abcd, 7); // call cpuid function 7
+    return ((abcd[1] & (1 << 8)) != 0); // ebx bit 8 indicates BMI2
+}
+
+// detect if CPU supports the BMI2 instruction set with fast pdep and pext
+// these two instructions are microcoded and very slow on AMD CPUs before Zen 3
+bool hasFastBMI2(void) {
+    if (!hasBMI2())
+        return false;
+    int abcd[4]; // cpuid results
+    cpuid(abcd, 0); // call cpuid function 0
+    const bool is_amd = abcd[1] == 0x68747541 && abcd[3] == 0x69746e65 && abcd[2] == 0x444d4163; // "AuthenticAMD"
+    if (!is_amd)
+        return true;
+    cpuid(abcd, 1); // call cpuid function 1
+    int family = (abcd[0] >> 8) & 0xF;
+    if (family == 0xF)
+        family += (abcd[0] >> 20) & 0xFF; // extended family
+    return family >= 0x19; // Zen 3 or later
+}
+
 // detect if CPU supports the AVX512ER instruction set
 bool hasAVX512ER(void) {
     if (instrset_detect() < 9)
@@ -238,5 +273,40 @@ bool hasAVX512VBMI2(void) {
     cpuid(abcd, 7); // call cpuid function 7
     return ((abcd[2] & (1 << 6)) != 0); // ecx bit 6 indicates AVX512VBMI2
 }
+
+// detect if CPU supports the AES instructions
+bool hasAES(void) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+#if defined(__APPLE__)
+    return true; // all the Apple arm64 CPUs have the crypto extension
+#elif defined(_WIN32)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+    return false;
+#endif
+#else
+    if (instrset_detect() < 2)
+        return false; // must have SSE2
+    int abcd[4]; // cpuid results
+    cpuid(abcd, 1); // call cpuid function 1
+    return ((abcd[2] & (1 << 25)) != 0); // ecx bit 25 indicates AES-NI
+#endif
+}
+
+// detect if the TSC can be used as a clock source
+bool hasInvariantTSC(void) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return false;
+#else
+    int abcd[4]; // cpuid results
+    cpuid(abcd, 0x80000000); // call cpuid function 0x80000000
+    if (static_cast<unsigned int>(abcd[0]) < 0x80000007)
+        return false; // function 0x80000007 not supported
+    cpuid(abcd, 0x80000007); // call cpuid function 0x80000007
+    return ((abcd[3] & (1 << 8)) != 0); // edx bit 8 indicates invariant TSC
+#endif
+}
 } // namespace instrset
 } // namespace util
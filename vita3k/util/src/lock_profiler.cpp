@@ -0,0 +1,224 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <util/lock_profiler.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#endif
+
+struct LockSiteStats {
+    std::string mutex_name;
+    std::string file;
+    std::string function;
+    uint32_t line = 0;
+    // shown in the Tracy zones of the contended waits
+    std::string label;
+
+    std::atomic<uint64_t> lock_count = 0;
+    std::atomic<uint64_t> contended_count = 0;
+    std::atomic<uint64_t> wait_ns = 0;
+    std::atomic<uint64_t> max_wait_ns = 0;
+    std::atomic<uint64_t> hold_ns = 0;
+    std::atomic<uint64_t> max_hold_ns = 0;
+};
+
+namespace {
+
+typedef std::tuple<const char *, const char *, uint32_t> SitePtrKey;
+typedef std::tuple<std::string, std::string, uint32_t> SiteKey;
+
+std::mutex sites_mutex;
+// the sites are kept until the exit, the threads keep pointers to them
+std::map<SiteKey, std::unique_ptr<LockSiteStats>> sites;
+std::atomic<int64_t> start_ns = 0;
+std::atomic<int64_t> stop_ns = 0;
+
+// the names and the file names of the sources locations are literals, so looking them up by pointer avoids the global lock
+thread_local std::map<SitePtrKey, LockSiteStats *> thread_sites;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LockSiteStats *get_site(const char *mutex_name, const std::source_location &location) {
+    const SitePtrKey ptr_key = { mutex_name, location.file_name(), location.line() };
+    const auto cached = thread_sites.find(ptr_key);
+    if (cached != thread_sites.end())
+        return cached->second;
+
+    const std::lock_guard<std::mutex> lock(sites_mutex);
+    std::unique_ptr<LockSiteStats> &site = sites[{ mutex_name, location.file_name(), location.line() }];
+    if (!site) {
+        site = std::make_unique<LockSiteStats>();
+        site->mutex_name = mutex_name;
+        site->file = location.file_name();
+        site->function = location.function_name();
+        site->line = location.line();
+        site->label = fmt::format("{} at {}:{}", mutex_name, fs::path(site->file).filename().string(), site->line);
+    }
+    thread_sites.emplace(ptr_key, site.get());
+    return site.get();
+}
+
+void update_max(std::atomic<uint64_t> &max, uint64_t value) {
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+void ProfiledMutex::profiled_lock(const std::source_location &location) {
+    if (mutex.try_lock()) {
+        record_lock(location, 0);
+        return;
+    }
+
+    const int64_t wait_start = now_ns();
+    {
+#ifdef TRACY_ENABLE
+        ZoneScopedNC("Lock wait", 0xFF4040);
+        const std::string &label = get_site(name, location)->label;
+        ZoneText(label.c_str(), label.size());
+#endif
+        mutex.lock();
+    }
+    record_lock(location, std::max<int64_t>(now_ns() - wait_start, 1));
+}
+
+void ProfiledMutex::record_lock(const std::source_location &location, uint64_t wait_ns) {
+    LockSiteStats *site = get_site(name, location);
+    site->lock_count.fetch_add(1, std::memory_order_relaxed);
+    if (wait_ns > 0) {
+        site->contended_count.fetch_add(1, std::memory_order_relaxed);
+        site->wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        update_max(site->max_wait_ns, wait_ns);
+    }
+
+    holder = site;
+    locked_ns = now_ns();
+}
+
+void ProfiledMutex::record_unlock() {
+    const uint64_t hold_ns = static_cast<uint64_t>(std::max<int64_t>(now_ns() - locked_ns, 0));
+    holder->hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+    update_max(holder->max_hold_ns, hold_ns);
+    holder = nullptr;
+}
+
+void start_lock_profiler() {
+    {
+        const std::lock_guard<std::mutex> lock(sites_mutex);
+        for (const auto &[key, site] : sites) {
+            site->lock_count = 0;
+            site->contended_count = 0;
+            site->wait_ns = 0;
+            site->max_wait_ns = 0;
+            site->hold_ns = 0;
+            site->max_hold_ns = 0;
+        }
+    }
+    start_ns.store(now_ns(), std::memory_order_relaxed);
+    stop_ns.store(0, std::memory_order_relaxed);
+    lock_profiler_enabled.store(true, std::memory_order_release);
+}
+
+void stop_lock_profiler() {
+    lock_profiler_enabled.store(false, std::memory_order_release);
+    stop_ns.store(now_ns(), std::memory_order_relaxed);
+}
+
+bool save_lock_report(const fs::path &path) {
+    struct SiteReport {
+        const LockSiteStats *site;
+        uint64_t lock_count;
+        uint64_t contended_count;
+        uint64_t wait_ns;
+        uint64_t max_wait_ns;
+        uint64_t hold_ns;
+        uint64_t max_hold_ns;
+    };
+    struct MutexReport {
+        uint64_t lock_count = 0;
+        uint64_t contended_count = 0;
+        uint64_t wait_ns = 0;
+        uint64_t hold_ns = 0;
+    };
+
+    std::vector<SiteReport> reports;
+    std::map<std::string, MutexReport> mutexes;
+    {
+        const std::lock_guard<std::mutex> lock(sites_mutex);
+        for (const auto &[key, site] : sites) {
+            const SiteReport report = { site.get(), site->lock_count.load(std::memory_order_relaxed), site->contended_count.load(std::memory_order_relaxed),
+                site->wait_ns.load(std::memory_order_relaxed), site->max_wait_ns.load(std::memory_order_relaxed),
+                site->hold_ns.load(std::memory_order_relaxed), site->max_hold_ns.load(std::memory_order_relaxed) };
+            if (report.lock_count == 0)
+                continue;
+            reports.push_back(report);
+
+            MutexReport &mutex = mutexes[site->mutex_name];
+            mutex.lock_count += report.lock_count;
+            mutex.contended_count += report.contended_count;
+            mutex.wait_ns += report.wait_ns;
+            mutex.hold_ns += report.hold_ns;
+        }
+    }
+    std::sort(reports.begin(), reports.end(), [](const SiteReport &a, const SiteReport &b) {
+        return a.wait_ns > b.wait_ns;
+    });
+
+    std::vector<std::pair<std::string, MutexReport>> sorted_mutexes(mutexes.begin(), mutexes.end());
+    std::sort(sorted_mutexes.begin(), sorted_mutexes.end(), [](const auto &a, const auto &b) {
+        return a.second.wait_ns > b.second.wait_ns;
+    });
+
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    const int64_t end_ns = stop_ns.load(std::memory_order_relaxed) != 0 ? stop_ns.load(std::memory_order_relaxed) : now_ns();
+    const double profiled_ms = (end_ns - start_ns.load(std::memory_order_relaxed)) / 1e6;
+    file << fmt::format("Lock report over {:.3f} s\n\n", profiled_ms / 1000.0);
+
+    file << fmt::format("{:<32} {:>12} {:>12} {:>12} {:>12}\n", "Mutex", "Locks", "Contended", "Wait ms", "Hold ms");
+    for (const auto &[name, mutex] : sorted_mutexes)
+        file << fmt::format("{:<32} {:>12} {:>12} {:>12.3f} {:>12.3f}\n", name, mutex.lock_count, mutex.contended_count, mutex.wait_ns / 1e6, mutex.hold_ns / 1e6);
+
+    file << fmt::format("\n{:<32} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12}  {}\n", "Mutex", "Locks", "Contended", "Wait ms", "Max wait us", "Hold ms", "Max hold us", "Site");
+    for (const SiteReport &report : reports) {
+        const LockSiteStats &site = *report.site;
+        file << fmt::format("{:<32} {:>12} {:>12} {:>12.3f} {:>12.1f} {:>12.3f} {:>12.1f}  {}:{} ({})\n", site.mutex_name, report.lock_count, report.contended_count,
+            report.wait_ns / 1e6, report.max_wait_ns / 1e3, report.hold_ns / 1e6, report.max_hold_ns / 1e3, site.file, site.line, site.function);
+    }
+
+    return static_cast<bool>(file);
+}
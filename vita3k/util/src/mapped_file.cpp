@@ -0,0 +1,149 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/mapped_file.h>
+
+#include <util/log.h>
+
+#include <algorithm>
+#include <utility>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+#ifdef WIN32
+        mapping = std::exchange(other.mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#ifdef WIN32
+bool MappedFile::open(const fs::path &path) {
+    close();
+
+    // the file can be replaced while it is mapped, the mapping keeps the old content
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // the file handle is not needed anymore once the mapping object exists
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        LOG_ERROR("Failed to create a file mapping for {}", path.string());
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+        LOG_ERROR("Failed to map {}", path.string());
+        CloseHandle(mapping);
+        mapping = nullptr;
+        return false;
+    }
+    size_ = static_cast<size_t>(file_size.QuadPart);
+
+    return true;
+}
+
+void MappedFile::advise(size_t offset, size_t length, MappedFileAdvice advice) const {
+}
+
+void MappedFile::close() {
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping)
+        CloseHandle(mapping);
+    data_ = nullptr;
+    size_ = 0;
+    mapping = nullptr;
+}
+#else
+bool MappedFile::open(const fs::path &path) {
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // the mapping stays valid after the file descriptor is closed
+    void *addr = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("Failed to map {}", path.string());
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t *>(addr);
+    size_ = static_cast<size_t>(file_stat.st_size);
+
+    return true;
+}
+
+void MappedFile::advise(size_t offset, size_t length, MappedFileAdvice advice) const {
+    if (!data_ || offset >= size_)
+        return;
+
+    // madvise needs an address aligned on a page
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t aligned_offset = offset & ~(page_size - 1);
+    length = std::min(length + offset - aligned_offset, size_ - aligned_offset);
+
+    const int host_advice = advice == MappedFileAdvice::Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED;
+    madvise(const_cast<uint8_t *>(data_) + aligned_offset, length, host_advice);
+}
+
+void MappedFile::close() {
+    if (data_)
+        munmap(const_cast<uint8_t *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+#endif
@@ -0,0 +1,130 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/memory_accounting.h>
+
+#include <atomic>
+
+namespace {
+
+struct CategoryCounters {
+    std::atomic<uint64_t> used = 0;
+    std::atomic<uint64_t> peak = 0;
+    std::atomic<uint64_t> budget = 0;
+};
+
+// the owners report from their own threads, the counters are never locked
+std::array<CategoryCounters, MEMORY_CATEGORY_COUNT> counters;
+
+CategoryCounters &get_counters(MemoryCategory category) {
+    return counters[static_cast<size_t>(category)];
+}
+
+void update_peak(CategoryCounters &category, uint64_t used) {
+    uint64_t peak = category.peak.load(std::memory_order_relaxed);
+    while (used > peak && !category.peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+void add_memory_usage(MemoryCategory category, uint64_t bytes) {
+    CategoryCounters &category_counters = get_counters(category);
+    const uint64_t used = category_counters.used.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    update_peak(category_counters, used);
+}
+
+void remove_memory_usage(MemoryCategory category, uint64_t bytes) {
+    CategoryCounters &category_counters = get_counters(category);
+    // an owner removing more than it added must not wrap the counter around
+    uint64_t used = category_counters.used.load(std::memory_order_relaxed);
+    while (!category_counters.used.compare_exchange_weak(used, used > bytes ? used - bytes : 0, std::memory_order_relaxed)) {
+    }
+}
+
+void set_memory_usage(MemoryCategory category, uint64_t bytes) {
+    CategoryCounters &category_counters = get_counters(category);
+    category_counters.used.store(bytes, std::memory_order_relaxed);
+    update_peak(category_counters, bytes);
+}
+
+MemoryCategoryUsage get_memory_usage(MemoryCategory category) {
+    const CategoryCounters &category_counters = get_counters(category);
+    return {
+        category_counters.used.load(std::memory_order_relaxed),
+        category_counters.peak.load(std::memory_order_relaxed),
+        category_counters.budget.load(std::memory_order_relaxed),
+    };
+}
+
+std::array<MemoryCategoryUsage, MEMORY_CATEGORY_COUNT> get_all_memory_usage() {
+    std::array<MemoryCategoryUsage, MEMORY_CATEGORY_COUNT> usage;
+    for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        usage[i] = get_memory_usage(static_cast<MemoryCategory>(i));
+    return usage;
+}
+
+uint64_t get_total_memory_usage() {
+    uint64_t total = 0;
+    for (const CategoryCounters &category_counters : counters)
+        total += category_counters.used.load(std::memory_order_relaxed);
+    return total;
+}
+
+void set_memory_budget(MemoryCategory category, uint64_t bytes) {
+    get_counters(category).budget.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t get_memory_budget(MemoryCategory category) {
+    return get_counters(category).budget.load(std::memory_order_relaxed);
+}
+
+bool is_over_memory_budget(MemoryCategory category) {
+    const CategoryCounters &category_counters = get_counters(category);
+    const uint64_t budget = category_counters.budget.load(std::memory_order_relaxed);
+    return budget != 0 && category_counters.used.load(std::memory_order_relaxed) > budget;
+}
+
+bool is_memory_budget_enforced(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::Textures:
+    case MemoryCategory::JitCode:
+    case MemoryCategory::IoReadBuffers:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void reset_memory_peaks() {
+    for (CategoryCounters &category_counters : counters)
+        category_counters.peak.store(category_counters.used.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+const char *get_memory_category_name(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::Textures: return "Textures";
+    case MemoryCategory::Surfaces: return "Surfaces";
+    case MemoryCategory::Pipelines: return "Pipelines";
+    case MemoryCategory::MappedMemory: return "Mapped memory";
+    case MemoryCategory::JitCode: return "JIT code";
+    case MemoryCategory::NgsVoices: return "NGS voices";
+    case MemoryCategory::IoReadBuffers: return "IO read buffers";
+    case MemoryCategory::GuestPages: return "Guest pages";
+    default: return "Unknown";
+    }
+}
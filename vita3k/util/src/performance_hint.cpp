@@ -0,0 +1,150 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/performance_hint.h>
+
+#ifdef __ANDROID__
+#include <util/log.h>
+
+#include <android/performance_hint.h>
+#include <android/thermal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct PerformanceHint {
+    std::mutex mutex;
+    std::vector<int32_t> threads;
+    APerformanceHintSession *session = nullptr;
+    int64_t target_frame_ns = 0;
+    bool started = false;
+};
+
+PerformanceHint performance_hint;
+std::atomic<ThermalStatus> thermal_status = ThermalStatus::Unsupported;
+
+void thermal_status_callback(void *, AThermalStatus status) {
+    thermal_status = status < ATHERMAL_STATUS_NONE ? ThermalStatus::Unsupported : static_cast<ThermalStatus>(status + 1);
+    LOG_INFO("The thermal status of the device is now {}", static_cast<int>(status));
+}
+
+// the performance hint manager only exists since Android 13
+void create_session() {
+    if (__builtin_available(android 33, *)) {
+        if (performance_hint.session)
+            APerformanceHint_closeSession(performance_hint.session);
+        APerformanceHintManager *manager = APerformanceHint_getManager();
+        performance_hint.session = manager ? APerformanceHint_createSession(manager, performance_hint.threads.data(), performance_hint.threads.size(), performance_hint.target_frame_ns) : nullptr;
+    }
+}
+
+} // namespace
+
+void add_performance_hint_thread() {
+    // it is called on each frame by the threads presenting them
+    static thread_local bool added = false;
+    if (added)
+        return;
+    added = true;
+
+    const int32_t tid = gettid();
+    const std::lock_guard<std::mutex> guard(performance_hint.mutex);
+    if (std::find(performance_hint.threads.begin(), performance_hint.threads.end(), tid) != performance_hint.threads.end())
+        return;
+
+    performance_hint.threads.push_back(tid);
+    if (!performance_hint.started)
+        return;
+
+    // the threads of a session can only be changed since Android 14, before it is created again
+    if (__builtin_available(android 34, *)) {
+        if (performance_hint.session) {
+            APerformanceHint_setThreads(performance_hint.session, performance_hint.threads.data(), performance_hint.threads.size());
+            return;
+        }
+    }
+    create_session();
+}
+
+bool start_performance_hint(int64_t target_frame_ns) {
+    const std::lock_guard<std::mutex> guard(performance_hint.mutex);
+    performance_hint.target_frame_ns = target_frame_ns;
+    performance_hint.started = true;
+    if (!performance_hint.threads.empty())
+        create_session();
+    return performance_hint.session != nullptr;
+}
+
+void report_frame_work_duration(int64_t duration_ns) {
+    const std::lock_guard<std::mutex> guard(performance_hint.mutex);
+    if (!performance_hint.session || duration_ns <= 0)
+        return;
+
+    if (__builtin_available(android 33, *))
+        APerformanceHint_reportActualWorkDuration(performance_hint.session, duration_ns);
+}
+
+void stop_performance_hint() {
+    const std::lock_guard<std::mutex> guard(performance_hint.mutex);
+    performance_hint.started = false;
+    if (!performance_hint.session)
+        return;
+
+    if (__builtin_available(android 33, *))
+        APerformanceHint_closeSession(performance_hint.session);
+    performance_hint.session = nullptr;
+}
+
+ThermalStatus get_thermal_status() {
+    // the listener stays registered until the emulator exits
+    static const bool listening = [] {
+        if (__builtin_available(android 30, *)) {
+            AThermalManager *manager = AThermal_acquireManager();
+            if (!manager)
+                return false;
+            thermal_status_callback(nullptr, AThermal_getCurrentThermalStatus(manager));
+            return AThermal_registerThermalStatusListener(manager, thermal_status_callback, nullptr) == 0;
+        }
+        return false;
+    }();
+
+    return listening ? thermal_status.load() : ThermalStatus::Unsupported;
+}
+#else
+// the other hosts do not expose their performance hints or thermal status to the apps
+void add_performance_hint_thread() {
+}
+
+bool start_performance_hint(int64_t target_frame_ns) {
+    return false;
+}
+
+void report_frame_work_duration(int64_t duration_ns) {
+}
+
+void stop_performance_hint() {
+}
+
+ThermalStatus get_thermal_status() {
+    return ThermalStatus::Unsupported;
+}
+#endif
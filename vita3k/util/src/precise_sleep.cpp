@@ -0,0 +1,83 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <util/precise_sleep.h>
+
+#include <thread>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <time.h>
+#endif
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// sleep for about duration, the host may wake the thread later
+static void host_sleep(std::chrono::nanoseconds duration) {
+#ifdef WIN32
+    // the high resolution timers are only available since Windows 10 1803, the other ones have the resolution of the system timer
+    thread_local const HANDLE timer = [] {
+        HANDLE handle = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!handle)
+            handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+        return handle;
+    }();
+    if (!timer) {
+        std::this_thread::sleep_for(duration);
+        return;
+    }
+
+    // negative values are relative, in units of 100 ns
+    LARGE_INTEGER due_time;
+    due_time.QuadPart = -static_cast<LONGLONG>(duration.count() / 100);
+    if (SetWaitableTimer(timer, &due_time, 0, nullptr, nullptr, FALSE))
+        WaitForSingleObject(timer, INFINITE);
+    else
+        std::this_thread::sleep_for(duration);
+#elif defined(__APPLE__)
+    timespec request{ static_cast<time_t>(duration.count() / 1000000000), static_cast<long>(duration.count() % 1000000000) };
+    while (nanosleep(&request, &request) == -1 && errno == EINTR) {
+    }
+#else
+    // an absolute deadline is not moved by the signals interrupting the sleep
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    const int64_t nanoseconds = deadline.tv_nsec + duration.count();
+    deadline.tv_sec += nanoseconds / 1000000000;
+    deadline.tv_nsec = nanoseconds % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+#endif
+}
+
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline, uint32_t spin_us) {
+    const auto spin_start = deadline - std::chrono::microseconds(spin_us);
+    const auto now = std::chrono::steady_clock::now();
+    if (now < spin_start)
+        host_sleep(spin_start - now);
+
+    while (std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+void precise_sleep_for(std::chrono::microseconds duration, uint32_t spin_us) {
+    precise_sleep_until(std::chrono::steady_clock::now() + duration, spin_us);
+}
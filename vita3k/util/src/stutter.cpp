@@ -0,0 +1,103 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <util/stutter.h>
+
+#include <util/log.h>
+
+#include <fmt/format.h>
+
+bool add_stutter_frame(StutterDetector &detector, std::chrono::steady_clock::time_point now, const StutterCounters &counters, float threshold_ms, float gpu_time) {
+    if (detector.start == std::chrono::steady_clock::time_point())
+        detector.start = now;
+
+    bool is_stutter = false;
+    if (detector.last_frame != std::chrono::steady_clock::time_point()) {
+        const float frame_time = std::chrono::duration<float, std::milli>(now - detector.last_frame).count();
+        is_stutter = frame_time > threshold_ms;
+        if (is_stutter) {
+            const StutterCounters &last = detector.last_counters;
+            detector.events[detector.next_event] = {
+                .frame = detector.frame_count,
+                .time = std::chrono::duration<float>(now - detector.start).count(),
+                .frame_time = frame_time,
+                .gpu_time = gpu_time,
+                .work = {
+                    .shader_translations = counters.shader_translations - last.shader_translations,
+                    .pipeline_creations = counters.pipeline_creations - last.pipeline_creations,
+                    .texture_uploads = counters.texture_uploads - last.texture_uploads,
+                    .texture_upload_bytes = counters.texture_upload_bytes - last.texture_upload_bytes,
+                    .surface_syncs = counters.surface_syncs - last.surface_syncs,
+                    .protect_faults = counters.protect_faults - last.protect_faults,
+                    .write_track_faults = counters.write_track_faults - last.write_track_faults,
+                    .module_loads = counters.module_loads - last.module_loads,
+                    .translated_blocks = counters.translated_blocks - last.translated_blocks,
+                },
+            };
+            detector.next_event = (detector.next_event + 1) % StutterDetector::HISTORY_SIZE;
+            if (detector.event_count == StutterDetector::HISTORY_SIZE)
+                detector.dropped_count++;
+            else
+                detector.event_count++;
+        }
+    }
+
+    detector.last_frame = now;
+    detector.last_counters = counters;
+    detector.frame_count++;
+    return is_stutter;
+}
+
+void reset_stutter_frame(StutterDetector &detector) {
+    detector.last_frame = std::chrono::steady_clock::time_point();
+}
+
+std::string describe_stutter_event(const StutterEvent &event) {
+    const StutterCounters &work = event.work;
+    std::string causes;
+    const auto add_cause = [&](uint64_t count, const std::string &name) {
+        if (count == 0)
+            return;
+        if (!causes.empty())
+            causes += ", ";
+        causes += fmt::format("{} {}", count, name);
+    };
+    add_cause(work.shader_translations, "shader translations");
+    add_cause(work.pipeline_creations, "pipeline creations");
+    add_cause(work.texture_uploads, fmt::format("texture uploads ({} KiB)", work.texture_upload_bytes >> 10));
+    add_cause(work.surface_syncs, "surface syncs");
+    add_cause(work.protect_faults, "protect faults");
+    add_cause(work.write_track_faults, "write tracking faults");
+    add_cause(work.module_loads, "module loads");
+    add_cause(work.translated_blocks, "jit blocks translated");
+
+    return causes.empty() ? "no work recorded" : causes;
+}
+
+void dump_stutter_events(const StutterDetector &detector) {
+    if (detector.event_count == 0) {
+        LOG_INFO("No stutter detected in {} frames", detector.frame_count);
+        return;
+    }
+
+    LOG_INFO("{} stutters detected in {} frames{}:", detector.event_count + detector.dropped_count, detector.frame_count,
+        detector.dropped_count > 0 ? fmt::format(", the {} oldest ones were dropped", detector.dropped_count) : "");
+    for (size_t i = 0; i < detector.event_count; i++) {
+        const size_t index = (detector.next_event + StutterDetector::HISTORY_SIZE - detector.event_count + i) % StutterDetector::HISTORY_SIZE;
+        const StutterEvent &event = detector.events[index];
+        LOG_INFO("Frame {} at {:.1f} s took {:.1f} ms (gpu: {:.1f} ms): {}", event.frame, event.time, event.frame_time, event.gpu_time, describe_stutter_event(event));
+    }
+}
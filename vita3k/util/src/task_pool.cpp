@@ -0,0 +1,349 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <util/task_pool.h>
+
+#include <util/host_thread.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace {
+struct Worker {
+    std::mutex mutex;
+    // the tasks submitted by this worker, it takes the last ones and the others steal the first ones
+    std::array<std::deque<std::function<void()>>, TASK_PRIORITY_COUNT> tasks;
+    std::thread thread;
+    // the lowest priority this worker takes, one worker only takes the latency critical tasks
+    TaskPriority last_priority = TaskPriority::Background;
+};
+
+struct TaskPool {
+    std::once_flag started;
+    uint32_t reserved_threads = 3;
+    std::vector<std::unique_ptr<Worker>> workers;
+    // at most this many background tasks run at once, so that the others are never stuck behind them
+    uint32_t max_background_running = 1;
+
+    // the tasks submitted by the other threads
+    std::mutex mutex;
+    std::condition_variable cond;
+    // only waited on by the latency critical worker, so that the other tasks never wake it instead of another worker
+    std::condition_variable latency_cond;
+    std::array<std::deque<std::function<void()>>, TASK_PRIORITY_COUNT> tasks;
+    bool exiting = false;
+
+    std::array<std::atomic<uint32_t>, TASK_PRIORITY_COUNT> queued{};
+    std::atomic<uint32_t> background_running = 0;
+    std::atomic<uint32_t> running = 0;
+    std::atomic<uint64_t> completed = 0;
+    std::atomic<uint64_t> stolen = 0;
+
+    ~TaskPool();
+};
+} // namespace
+
+// the worker the current thread is, null for the threads outside the pool
+static thread_local Worker *current_worker = nullptr;
+
+static TaskPool &get_pool() {
+    static TaskPool pool;
+    return pool;
+}
+
+static bool has_queued_task(const TaskPool &pool) {
+    for (size_t i = 0; i < TASK_PRIORITY_COUNT; i++) {
+        if (pool.queued[i].load(std::memory_order_relaxed) > 0)
+            return true;
+    }
+    return false;
+}
+
+static bool pop_task(std::deque<std::function<void()>> &tasks, std::function<void()> &task, const bool from_back) {
+    if (tasks.empty())
+        return false;
+    if (from_back) {
+        task = std::move(tasks.back());
+        tasks.pop_back();
+    } else {
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    return true;
+}
+
+static void release_background(TaskPool &pool) {
+    if (pool.background_running.fetch_sub(1, std::memory_order_relaxed) == pool.max_background_running) {
+        // a worker may have gone to sleep with only background tasks left
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.cond.notify_one();
+    }
+}
+
+// reserve a slot for a background task, released by run_task once it is done
+static bool reserve_background(TaskPool &pool) {
+    uint32_t running = pool.background_running.load(std::memory_order_relaxed);
+    while (running < pool.max_background_running) {
+        if (pool.background_running.compare_exchange_weak(running, running + 1, std::memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+// take the task with the highest priority, first from the tasks of this worker, then from the shared ones,
+// then from the other workers, up to last_priority
+// a nested worker (waiting for a group) is already busy, the background tasks it runs do not count against the limit
+static bool take_task(TaskPool &pool, Worker *self, std::function<void()> &task, TaskPriority &priority, const TaskPriority last_priority, const bool nested = false) {
+    for (size_t i = 0; i <= static_cast<size_t>(last_priority); i++) {
+        if (pool.queued[i].load(std::memory_order_relaxed) == 0)
+            continue;
+        const bool background = static_cast<TaskPriority>(i) == TaskPriority::Background;
+        if (background) {
+            if (nested)
+                pool.background_running.fetch_add(1, std::memory_order_relaxed);
+            else if (!reserve_background(pool))
+                continue;
+        }
+
+        bool found = false;
+        if (self) {
+            const std::lock_guard<std::mutex> lock(self->mutex);
+            found = pop_task(self->tasks[i], task, true);
+        }
+        if (!found) {
+            const std::lock_guard<std::mutex> lock(pool.mutex);
+            found = pop_task(pool.tasks[i], task, false);
+        }
+        for (size_t w = 0; !found && w < pool.workers.size(); w++) {
+            Worker &other = *pool.workers[w];
+            if (&other == self)
+                continue;
+            const std::lock_guard<std::mutex> lock(other.mutex);
+            found = pop_task(other.tasks[i], task, false);
+            if (found)
+                pool.stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (found) {
+            pool.queued[i].fetch_sub(1, std::memory_order_relaxed);
+            priority = static_cast<TaskPriority>(i);
+            return true;
+        }
+        if (background)
+            release_background(pool);
+    }
+
+    return false;
+}
+
+static HostThreadPriority get_host_priority(const TaskPriority priority) {
+    switch (priority) {
+    case TaskPriority::LatencyCritical: return HostThreadPriority::High;
+    case TaskPriority::Normal: return HostThreadPriority::Normal;
+    case TaskPriority::Background:
+    default: return HostThreadPriority::Low;
+    }
+}
+
+static void run_task(TaskPool &pool, std::function<void()> &task, const TaskPriority priority) {
+    pool.running.fetch_add(1, std::memory_order_relaxed);
+
+    task();
+    task = nullptr;
+
+    pool.running.fetch_sub(1, std::memory_order_relaxed);
+    pool.completed.fetch_add(1, std::memory_order_relaxed);
+    if (priority == TaskPriority::Background)
+        release_background(pool);
+}
+
+static void run_worker(TaskPool &pool, Worker &self) {
+    current_worker = &self;
+    // the host priority follows the priority of the task, only changed when it is different
+    HostThreadPriority host_priority = HostThreadPriority::Low;
+    set_current_thread_priority(host_priority);
+
+    std::function<void()> task;
+    TaskPriority priority;
+    while (true) {
+        if (take_task(pool, &self, task, priority, self.last_priority)) {
+            if (get_host_priority(priority) != host_priority) {
+                host_priority = get_host_priority(priority);
+                set_current_thread_priority(host_priority);
+            }
+            run_task(pool, task, priority);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        if (pool.exiting)
+            return;
+        if (self.last_priority == TaskPriority::LatencyCritical) {
+            pool.latency_cond.wait(lock, [&] {
+                return pool.exiting || pool.queued[0].load(std::memory_order_relaxed) > 0;
+            });
+            continue;
+        }
+        // only background tasks which cannot run yet may be left, they wake a worker when one ends
+        pool.cond.wait(lock, [&] {
+            if (pool.exiting)
+                return true;
+            for (size_t i = 0; i < TASK_PRIORITY_COUNT - 1; i++) {
+                if (pool.queued[i].load(std::memory_order_relaxed) > 0)
+                    return true;
+            }
+            return pool.queued[TASK_PRIORITY_COUNT - 1].load(std::memory_order_relaxed) > 0
+                && pool.background_running.load(std::memory_order_relaxed) < pool.max_background_running;
+        });
+    }
+}
+
+static void start_pool(TaskPool &pool) {
+    // at least two workers so that one is always left by the background tasks
+    const uint32_t host_threads = std::thread::hardware_concurrency();
+    const uint32_t worker_count = std::max<uint32_t>(host_threads > pool.reserved_threads ? host_threads - pool.reserved_threads : 0, 2);
+    pool.max_background_running = worker_count - 1;
+    LOG_INFO("Using {} threads for the background tasks", worker_count);
+
+    for (uint32_t i = 0; i < worker_count; i++)
+        pool.workers.push_back(std::make_unique<Worker>());
+    // one more worker which only takes the latency critical tasks, so that they never wait for long compilations
+    // it sleeps most of the time so it is not counted against the reserved threads
+    pool.workers.push_back(std::make_unique<Worker>());
+    pool.workers.back()->last_priority = TaskPriority::LatencyCritical;
+    // the workers steal from each other, they can only start once all of them exist
+    for (auto &worker : pool.workers)
+        worker->thread = std::thread(run_worker, std::ref(pool), std::ref(*worker));
+}
+
+TaskPool::~TaskPool() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        cond.notify_all();
+        latency_cond.notify_all();
+    }
+    for (auto &worker : workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+void set_task_pool_reserved_threads(uint32_t count) {
+    get_pool().reserved_threads = count;
+}
+
+void submit_task(TaskPriority priority, std::function<void()> task) {
+    TaskPool &pool = get_pool();
+    std::call_once(pool.started, start_pool, std::ref(pool));
+
+    const size_t index = static_cast<size_t>(priority);
+    if (current_worker) {
+        const std::lock_guard<std::mutex> lock(current_worker->mutex);
+        current_worker->tasks[index].push_back(std::move(task));
+        pool.queued[index].fetch_add(1, std::memory_order_relaxed);
+    } else {
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.tasks[index].push_back(std::move(task));
+        pool.queued[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // taken so that a worker checking for tasks before going to sleep cannot miss this one
+    const std::lock_guard<std::mutex> lock(pool.mutex);
+    if (priority == TaskPriority::LatencyCritical)
+        pool.latency_cond.notify_one();
+    pool.cond.notify_one();
+}
+
+TaskPoolStats get_task_pool_stats() {
+    TaskPool &pool = get_pool();
+    TaskPoolStats stats{};
+    {
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        stats.worker_count = static_cast<uint32_t>(pool.workers.size());
+    }
+    for (size_t i = 0; i < TASK_PRIORITY_COUNT; i++)
+        stats.queued[i] = pool.queued[i].load(std::memory_order_relaxed);
+    stats.running = pool.running.load(std::memory_order_relaxed);
+    stats.completed = pool.completed.load(std::memory_order_relaxed);
+    stats.stolen = pool.stolen.load(std::memory_order_relaxed);
+    return stats;
+}
+
+TaskGroup::TaskGroup(TaskPriority priority)
+    : priority(priority) {
+}
+
+TaskGroup::~TaskGroup() {
+    wait();
+}
+
+void TaskGroup::submit(std::function<void()> task) {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        pending_count++;
+    }
+
+    submit_task(priority, [this, task = std::move(task)]() {
+        if (!cancelled.load(std::memory_order_relaxed))
+            task();
+
+        // the group can be destroyed as soon as the mutex is released
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (--pending_count == 0)
+            cond.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!current_worker) {
+        cond.wait(lock, [&] { return pending_count == 0; });
+        return;
+    }
+
+    // the tasks of the group may be queued behind this one, run them or others at least as urgent instead of
+    // blocking a worker, once none are left the ones of the group are running elsewhere
+    TaskPool &pool = get_pool();
+    const TaskPriority last_priority = std::min(priority, current_worker->last_priority);
+    std::function<void()> task;
+    TaskPriority task_priority;
+    while (pending_count > 0) {
+        lock.unlock();
+        const bool found = take_task(pool, current_worker, task, task_priority, last_priority, true);
+        if (found)
+            run_task(pool, task, task_priority);
+        lock.lock();
+        if (!found)
+            cond.wait(lock, [&] { return pending_count == 0; });
+    }
+}
+
+void TaskGroup::cancel() {
+    cancelled = true;
+    wait();
+    cancelled = false;
+}
+
+uint32_t TaskGroup::pending() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return pending_count;
+}
@@ -0,0 +1,180 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <util/trace_log.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+constexpr uint32_t TRACE_LOG_MAGIC = 0x544B3356; // V3KT
+constexpr uint32_t TRACE_LOG_VERSION = 1;
+
+namespace {
+
+struct TraceLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t record_count;
+};
+
+struct TraceRing {
+    std::unique_ptr<TraceRecord[]> records;
+    size_t capacity = 0;
+    // records written since the start, the ring holds the last capacity ones
+    std::atomic<uint64_t> count = 0;
+};
+
+struct TraceEventInfo {
+    const char *name;
+    std::array<const char *, TRACE_MAX_ARGS> arg_names;
+};
+
+constexpr std::array<TraceEventInfo, static_cast<size_t>(TraceEvent::COUNT)> event_infos = { {
+    { "HLE import", { "nid", "lr" } },
+    { "LLE import", { "nid", "pc" } },
+    { "File read", { "fd", "size", "result" } },
+    { "File write", { "fd", "size", "result" } },
+    { "File seek", { "fd", "offset", "whence" } },
+} };
+
+std::mutex rings_mutex;
+// the rings are kept until the exit, a host thread can run several guest threads and the next traces
+std::vector<std::unique_ptr<TraceRing>> rings;
+size_t ring_capacity = 0;
+std::atomic<int64_t> start_ns = 0;
+
+thread_local TraceRing *current_ring = nullptr;
+thread_local uint32_t current_thread_id = 0;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceRing *create_ring() {
+    const std::lock_guard<std::mutex> lock(rings_mutex);
+    auto ring = std::make_unique<TraceRing>();
+    ring->capacity = ring_capacity;
+    ring->records = std::make_unique<TraceRecord[]>(ring->capacity);
+    rings.push_back(std::move(ring));
+    return rings.back().get();
+}
+
+} // namespace
+
+void start_trace_log(size_t records_per_thread) {
+    {
+        const std::lock_guard<std::mutex> lock(rings_mutex);
+        ring_capacity = std::max<size_t>(records_per_thread, 1);
+        for (const auto &ring : rings)
+            ring->count.store(0, std::memory_order_relaxed);
+    }
+    start_ns.store(now_ns(), std::memory_order_relaxed);
+    trace_log_enabled.store(true, std::memory_order_release);
+}
+
+void stop_trace_log() {
+    trace_log_enabled.store(false, std::memory_order_release);
+}
+
+void set_trace_thread_id(uint32_t thread_id) {
+    current_thread_id = thread_id;
+}
+
+void record_trace_event(TraceEvent event, const uint64_t *args, uint16_t arg_count) {
+    TraceRing *ring = current_ring;
+    if (!ring) {
+        ring = create_ring();
+        current_ring = ring;
+    }
+
+    // only this thread writes to its ring
+    const uint64_t index = ring->count.load(std::memory_order_relaxed);
+    TraceRecord &record = ring->records[index % ring->capacity];
+    record.timestamp_ns = static_cast<uint64_t>(now_ns() - start_ns.load(std::memory_order_relaxed));
+    record.thread_id = current_thread_id;
+    record.event = static_cast<uint16_t>(event);
+    record.arg_count = arg_count;
+    std::copy_n(args, arg_count, record.args);
+    std::fill(record.args + arg_count, record.args + TRACE_MAX_ARGS, 0);
+    ring->count.store(index + 1, std::memory_order_release);
+}
+
+bool save_trace_log(const fs::path &path) {
+    std::vector<TraceRecord> records;
+    {
+        const std::lock_guard<std::mutex> lock(rings_mutex);
+        for (const auto &ring : rings) {
+            const uint64_t count = ring->count.load(std::memory_order_acquire);
+            const uint64_t kept = std::min<uint64_t>(count, ring->capacity);
+            for (uint64_t index = count - kept; index < count; index++)
+                records.push_back(ring->records[index % ring->capacity]);
+        }
+    }
+
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    const TraceLogHeader header = { TRACE_LOG_MAGIC, TRACE_LOG_VERSION, sizeof(TraceRecord), static_cast<uint32_t>(records.size()) };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(TraceRecord));
+    return static_cast<bool>(file);
+}
+
+bool load_trace_log(const fs::path &path, std::vector<TraceRecord> &records) {
+    std::ifstream file(path, std::ios::binary);
+    TraceLogHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return false;
+    if (header.magic != TRACE_LOG_MAGIC || header.version != TRACE_LOG_VERSION || header.record_size != sizeof(TraceRecord))
+        return false;
+
+    records.resize(header.record_count);
+    if (!file.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(TraceRecord)))
+        return false;
+
+    std::stable_sort(records.begin(), records.end(), [](const TraceRecord &a, const TraceRecord &b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+    return true;
+}
+
+std::string format_trace_record(const TraceRecord &record, const TraceNidNameFunc &nid_name) {
+    std::string text = fmt::format("{:>14.6f} TID: {:<4} ", record.timestamp_ns / 1e9, record.thread_id);
+    if (record.event >= event_infos.size())
+        return text + fmt::format("unknown event {}", record.event);
+
+    const TraceEventInfo &info = event_infos[record.event];
+    text += info.name;
+    for (uint16_t i = 0; i < std::min<size_t>(record.arg_count, TRACE_MAX_ARGS); i++) {
+        const char *const arg_name = info.arg_names[i] ? info.arg_names[i] : "arg";
+        text += fmt::format(" {}: {:#x}", arg_name, record.args[i]);
+        if (nid_name && std::strcmp(arg_name, "nid") == 0)
+            text += fmt::format(" ({})", nid_name(static_cast<uint32_t>(record.args[i])));
+    }
+    return text;
+}
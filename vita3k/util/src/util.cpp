@@ -23,6 +23,7 @@
 #include <util/string_utils.h>
 #include <util/vector_utils.h>
 
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/msvc_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -46,12 +47,15 @@
 #include <bitset>
 #include <codecvt> // std::codecvt_utf8
 #include <iostream>
+#include <limits>
 #include <locale> // std::wstring_convert
 #include <map>
 #include <memory>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
 
 #include <memory>
 #include <stdexcept>
@@ -60,12 +64,22 @@ namespace logging {
 
 static const fs::path &LOG_FILE_NAME = "vita3k.log";
 static const char *LOG_PATTERN = "%^[%H:%M:%S.%e] |%L| [%!]: %v%$";
+// messages waiting to be written by the logger thread, the threads logging only block once it is full
+static constexpr size_t LOG_QUEUE_SIZE = 8192;
 std::vector<spdlog::sink_ptr> sinks;
 
 void register_log_exception_handler();
 
 void flush() {
     spdlog::details::registry::instance().flush_all();
+    // the messages and the flush are written by the logger thread
+    if (const auto thread_pool = spdlog::thread_pool()) {
+        while (thread_pool->queue_size() > 0)
+            std::this_thread::yield();
+        // the last message taken from the queue may still be written
+        for (const auto &sink : sinks)
+            sink->flush();
+    }
 }
 
 ExitCode init(const Root &root_paths, bool use_stdout) {
@@ -127,7 +141,10 @@ ExitCode add_sink(const fs::path &log_path) {
     }
 #endif
 
-    spdlog::set_default_logger(std::make_shared<spdlog::logger>("vita3k logger", begin(sinks), end(sinks)));
+    // the sinks are written on the logger thread, so that the threads logging do not wait for the disk
+    if (!spdlog::thread_pool())
+        spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+    spdlog::set_default_logger(std::make_shared<spdlog::async_logger>("vita3k logger", begin(sinks), end(sinks), spdlog::thread_pool(), spdlog::async_overflow_policy::block));
     spdlog::set_pattern(LOG_PATTERN);
     return Success;
 }
@@ -381,6 +398,21 @@ int stoi_def(const std::string &str, int default_value, const char *name) {
     return default_value;
 }
 
+std::string escape_json(const std::string &str) {
+    std::string escaped;
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
 } // namespace string_utils
 
 namespace net_utils {
@@ -825,6 +857,152 @@ void float_to_half(const float *src, std::uint16_t *dest, const int total) {
 #endif
 #endif
 
+/*
+float32 to integer conversion
+SSE2 is always available on x86-64 and NEON on arm64, so there is no runtime detection
+the values are clamped to the range of the type as floats first, the packs that follow never saturate
+*/
+template <typename T>
+static constexpr float float_to_integer_min() {
+    return static_cast<float>(std::numeric_limits<T>::min());
+}
+
+// the maximum of the 32-bit types is rounded up to the next power of two, the values from it are saturated
+template <typename T>
+static constexpr float float_to_integer_max() {
+    return static_cast<float>(std::numeric_limits<T>::max());
+}
+
+template <typename T>
+static T float_to_integer_scalar(const float value) {
+    // written so that nan gives the minimum, like the vector versions
+    if (!(value >= float_to_integer_min<T>()))
+        return std::numeric_limits<T>::min();
+    if (value >= float_to_integer_max<T>())
+        return std::numeric_limits<T>::max();
+    return static_cast<T>(value);
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FLOAT_TO_INTEGER_VECTOR
+
+// for the types smaller than 32 bits
+template <typename T>
+static __m128i load_clamped_x4(const float *src) {
+    // maxps returns its second operand for nan
+    const __m128 value = _mm_max_ps(_mm_loadu_ps(src), _mm_set1_ps(float_to_integer_min<T>()));
+    return _mm_cvttps_epi32(_mm_min_ps(value, _mm_set1_ps(float_to_integer_max<T>())));
+}
+
+// converts 16 bytes of integers
+template <typename T>
+static void float_to_integer_block(const float *src, T *dest) {
+    __m128i result;
+    if constexpr (std::is_same_v<T, std::uint32_t>) {
+        // cvttps only converts to signed integers, 2^31 is removed from the values above it and added back as the top bit
+        const __m128 two_31 = _mm_set1_ps(2147483648.f);
+        const __m128 value = _mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps());
+        const __m128 is_high = _mm_cmpge_ps(value, two_31);
+        const __m128 is_over = _mm_cmpge_ps(value, _mm_set1_ps(float_to_integer_max<T>()));
+        const __m128i low_bits = _mm_cvttps_epi32(_mm_sub_ps(value, _mm_and_ps(is_high, two_31)));
+        result = _mm_or_si128(_mm_xor_si128(low_bits, _mm_slli_epi32(_mm_castps_si128(is_high), 31)), _mm_castps_si128(is_over));
+    } else if constexpr (sizeof(T) == 4) {
+        // cvttps gives 0x80000000 for the values too high, turned into 0x7fffffff
+        const __m128 value = _mm_max_ps(_mm_loadu_ps(src), _mm_set1_ps(float_to_integer_min<T>()));
+        const __m128 is_over = _mm_cmpge_ps(value, _mm_set1_ps(float_to_integer_max<T>()));
+        result = _mm_xor_si128(_mm_cvttps_epi32(value), _mm_castps_si128(is_over));
+    } else if constexpr (sizeof(T) == 2) {
+        const __m128i low = load_clamped_x4<T>(src);
+        const __m128i high = load_clamped_x4<T>(src + 4);
+        if constexpr (std::is_signed_v<T>) {
+            result = _mm_packs_epi32(low, high);
+        } else {
+            // there is no unsigned pack from 32 bits before SSE4.1, the values are moved to the signed range and back
+            const __m128i bias = _mm_set1_epi32(32768);
+            result = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(low, bias), _mm_sub_epi32(high, bias)), _mm_set1_epi16(static_cast<short>(0x8000)));
+        }
+    } else {
+        const __m128i low = _mm_packs_epi32(load_clamped_x4<T>(src), load_clamped_x4<T>(src + 4));
+        const __m128i high = _mm_packs_epi32(load_clamped_x4<T>(src + 8), load_clamped_x4<T>(src + 12));
+        result = std::is_signed_v<T> ? _mm_packs_epi16(low, high) : _mm_packus_epi16(low, high);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), result);
+}
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FLOAT_TO_INTEGER_VECTOR
+
+// the conversions saturate, clamping the values is only needed for the types smaller than 32 bits
+template <typename T>
+static float32x4_t load_clamped_x4(const float *src) {
+    // maxnm returns the number for nan
+    const float32x4_t value = vmaxnmq_f32(vld1q_f32(src), vdupq_n_f32(float_to_integer_min<T>()));
+    return vminq_f32(value, vdupq_n_f32(float_to_integer_max<T>()));
+}
+
+template <typename T>
+static int16x8_t load_clamped_x8(const float *src) {
+    return vcombine_s16(vmovn_s32(vcvtq_s32_f32(load_clamped_x4<T>(src))), vmovn_s32(vcvtq_s32_f32(load_clamped_x4<T>(src + 4))));
+}
+
+// converts 16 bytes of integers
+template <typename T>
+static void float_to_integer_block(const float *src, T *dest) {
+    if constexpr (std::is_same_v<T, std::uint32_t>) {
+        vst1q_u32(dest, vcvtq_u32_f32(load_clamped_x4<T>(src)));
+    } else if constexpr (std::is_same_v<T, std::int32_t>) {
+        vst1q_s32(dest, vcvtq_s32_f32(load_clamped_x4<T>(src)));
+    } else if constexpr (std::is_same_v<T, std::uint16_t>) {
+        const uint16x4_t low = vqmovun_s32(vcvtq_s32_f32(load_clamped_x4<T>(src)));
+        const uint16x4_t high = vqmovun_s32(vcvtq_s32_f32(load_clamped_x4<T>(src + 4)));
+        vst1q_u16(dest, vcombine_u16(low, high));
+    } else if constexpr (std::is_same_v<T, std::int16_t>) {
+        vst1q_s16(dest, load_clamped_x8<T>(src));
+    } else if constexpr (std::is_same_v<T, std::uint8_t>) {
+        vst1q_u8(dest, vcombine_u8(vqmovun_s16(load_clamped_x8<T>(src)), vqmovun_s16(load_clamped_x8<T>(src + 8))));
+    } else {
+        vst1q_s8(dest, vcombine_s8(vmovn_s16(load_clamped_x8<T>(src)), vmovn_s16(load_clamped_x8<T>(src + 8))));
+    }
+}
+#endif
+
+template <typename T>
+static void float_to_integer_impl(const float *src, T *dest, const int total) {
+    int i = 0;
+#ifdef FLOAT_TO_INTEGER_VECTOR
+    constexpr int lanes = 16 / sizeof(T);
+    for (; i + lanes <= total; i += lanes)
+        float_to_integer_block(src + i, dest + i);
+#endif
+    for (; i < total; i++)
+        dest[i] = float_to_integer_scalar<T>(src[i]);
+}
+
+void float_to_integer(const float *src, std::int8_t *dest, const int total) {
+    float_to_integer_impl(src, dest, total);
+}
+
+void float_to_integer(const float *src, std::uint8_t *dest, const int total) {
+    float_to_integer_impl(src, dest, total);
+}
+
+void float_to_integer(const float *src, std::int16_t *dest, const int total) {
+    float_to_integer_impl(src, dest, total);
+}
+
+void float_to_integer(const float *src, std::uint16_t *dest, const int total) {
+    float_to_integer_impl(src, dest, total);
+}
+
+void float_to_integer(const float *src, std::int32_t *dest, const int total) {
+    float_to_integer_impl(src, dest, total);
+}
+
+void float_to_integer(const float *src, std::uint32_t *dest, const int total) {
+    float_to_integer_impl(src, dest, total);
+}
+
 // Encode code taken from https://github.com/yifanlu/UVLoader/blob/master/resolve.c
 
 uint32_t encode_arm_inst(uint8_t type, uint32_t immed, uint16_t reg) {
@@ -49,7 +49,7 @@ struct Image {
     Image(const Image &) = delete;
     Image &operator=(Image const &) = delete;
 
-    void init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping = default_comp_mapping, const vk::ImageCreateFlags image_create_flags = vk::ImageCreateFlags(), const void *pNext = nullptr);
+    void init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping = default_comp_mapping, const vk::ImageCreateFlags image_create_flags = vk::ImageCreateFlags(), const void *pNext = nullptr, const vma::AllocationCreateInfo &alloc_info = vma_auto_alloc);
     // called by ~Image
     void destroy();
 
@@ -81,7 +81,8 @@ struct Buffer {
     Buffer(const Buffer &) = delete;
     Buffer &operator=(Buffer const &) = delete;
 
-    void init_buffer(vk::BufferUsageFlags usage_flags, const vma::AllocationCreateInfo &alloc_create_info = vma_auto_alloc);
+    // if more than one queue family is given, the buffer can be used by all of them without ownership transfer
+    void init_buffer(vk::BufferUsageFlags usage_flags, const vma::AllocationCreateInfo &alloc_create_info = vma_auto_alloc, const std::vector<uint32_t> &queue_families = {});
     // called by ~Image
     void destroy();
 };
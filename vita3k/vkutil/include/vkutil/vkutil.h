@@ -86,6 +86,11 @@ static constexpr vma::AllocationCreateInfo vma_auto_alloc = {
     .usage = vma::MemoryUsage::eAuto
 };
 
+// only for transient attachments
+static constexpr vma::AllocationCreateInfo vma_lazy_alloc = {
+    .usage = vma::MemoryUsage::eGpuLazilyAllocated
+};
+
 static constexpr vma::AllocationCreateInfo vma_mapped_alloc = {
     .flags = vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped,
     .usage = vma::MemoryUsage::eAuto,
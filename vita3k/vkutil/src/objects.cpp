@@ -71,7 +71,7 @@ Image::~Image() {
     destroy();
 }
 
-void Image::init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping, const vk::ImageCreateFlags image_create_flags, const void *pNext) {
+void Image::init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping, const vk::ImageCreateFlags image_create_flags, const void *pNext, const vma::AllocationCreateInfo &alloc_info) {
     vk::ImageCreateInfo image_info{
         .pNext = pNext,
         .flags = image_create_flags,
@@ -90,7 +90,7 @@ void Image::init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping,
         .initialLayout = vk::ImageLayout::eUndefined,
     };
 
-    std::tie(image, allocation) = allocator.createImage(image_info, vma_auto_alloc);
+    std::tie(image, allocation) = allocator.createImage(image_info, alloc_info);
 
     // only create a view if one of these flags is set
     constexpr vk::ImageUsageFlags view_usages = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eStorage;
@@ -155,12 +155,16 @@ Buffer::~Buffer() {
     destroy();
 }
 
-void Buffer::init_buffer(vk::BufferUsageFlags usage_flags, const vma::AllocationCreateInfo &alloc_create_info) {
+void Buffer::init_buffer(vk::BufferUsageFlags usage_flags, const vma::AllocationCreateInfo &alloc_create_info, const std::vector<uint32_t> &queue_families) {
     vk::BufferCreateInfo buffer_info{
         .size = size,
         .usage = usage_flags,
         .sharingMode = vk::SharingMode::eExclusive
     };
+    if (queue_families.size() > 1) {
+        buffer_info.sharingMode = vk::SharingMode::eConcurrent;
+        buffer_info.setQueueFamilyIndices(queue_families);
+    }
     vma::AllocationInfo alloc_info;
     std::tie(buffer, allocation) = allocator.createBuffer(buffer_info, alloc_create_info, alloc_info);
     mapped_data = alloc_info.pMappedData;